@@ -0,0 +1,132 @@
+/** Task affinity benchmark.
+ * Scans continuously with the scan report queue and runs a timing task that wakes every millisecond,
+ * every few seconds prints:
+ *  - The average and maximum wake up delay of the timing task.
+ *  - The number of onResult callbacks per second and the reports dropped by the report queue.
+ *  - The core each BLE task runs on.
+ *
+ * Change the cores below and compare the results to find the best split for the application,
+ * the timing task stands in for the time critical work of the application. ESP32 only.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+
+/** Benchmark settings, -1 = default / no affinity */
+#define BENCH_HOST_CORE          0
+#define BENCH_CONTROLLER_CORE    0
+#define BENCH_APP_CORE           1     // Core of the scan report task.
+#define BENCH_TIMING_CORE        1     // Core of the timing task.
+#define BENCH_TIMING_PRIORITY    2
+#define BENCH_REPORT_QUEUE_SIZE  32
+#define BENCH_PRINT_INTERVAL_MS  5000
+
+static volatile uint32_t resultCount  = 0;
+static volatile uint32_t wakeCount    = 0;
+static volatile uint64_t wakeTotal    = 0;
+static volatile uint32_t wakeMax      = 0;
+
+NimBLEScan* pBLEScan;
+
+class MyAdvertisedDeviceCallbacks: public NimBLEAdvertisedDeviceCallbacks {
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+      resultCount++;
+
+      /** Some typical work done with a result. */
+      size_t len = 0;
+      advertisedDevice->getManufacturerDataPtr(&len);
+      advertisedDevice->getNamePtr(&len);
+    }
+};
+
+/** Wakes every tick and records how much later than one tick after the previous wake up it was woken. */
+void timingTask(void* arg) {
+  TickType_t lastWake = xTaskGetTickCount();
+  int64_t lastTime = esp_timer_get_time();
+
+  for (;;) {
+    vTaskDelayUntil(&lastWake, 1);
+
+    int64_t now = esp_timer_get_time();
+    int64_t late = now - lastTime - portTICK_PERIOD_MS * 1000;
+    lastTime = now;
+    if (late < 0) {
+      late = 0;
+    }
+    wakeCount++;
+    wakeTotal += late;
+    if (late > wakeMax) {
+      wakeMax = late;
+    }
+  }
+}
+
+void printTaskCore(const char* name) {
+  TaskHandle_t task = xTaskGetHandle(name);
+  if (task != nullptr) {
+    BaseType_t core = xTaskGetAffinity(task);
+    Serial.printf("%s: %s ", name, core == tskNO_AFFINITY ? "any" : String(core).c_str());
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting affinity benchmark...");
+
+  if (!NimBLEDevice::setTaskAffinity(BENCH_HOST_CORE, BENCH_CONTROLLER_CORE, BENCH_APP_CORE)) {
+    Serial.println("Invalid task affinity, using the defaults");
+  }
+
+  NimBLEDevice::init("");
+
+  pBLEScan = NimBLEDevice::getScan();
+  pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks(), true);
+  pBLEScan->setActiveScan(true);
+  pBLEScan->setInterval(100);
+  pBLEScan->setWindow(100);
+  pBLEScan->setMaxResults(0);
+  pBLEScan->setReportQueue(BENCH_REPORT_QUEUE_SIZE);
+
+  xTaskCreatePinnedToCore(timingTask, "timing", 2048, nullptr, BENCH_TIMING_PRIORITY, nullptr,
+                          BENCH_TIMING_CORE < 0 ? tskNO_AFFINITY : BENCH_TIMING_CORE);
+
+  Serial.printf("Host core: %d, controller core: %d, app core: %d, timing core: %d\n",
+                BENCH_HOST_CORE, BENCH_CONTROLLER_CORE, BENCH_APP_CORE, BENCH_TIMING_CORE);
+  printTaskCore("nimble_host");
+  printTaskCore("btController");
+  printTaskCore("nimble_scan");
+  printTaskCore("timing");
+  Serial.println();
+}
+
+void loop() {
+  static uint32_t lastPrint = millis();
+
+  if (pBLEScan->isScanning() == false) {
+    pBLEScan->start(0, nullptr, false);
+  }
+
+  delay(100);
+
+  uint32_t now = millis();
+  if (now - lastPrint < BENCH_PRINT_INTERVAL_MS) {
+    return;
+  }
+
+  float seconds = (now - lastPrint) / 1000.0;
+  lastPrint = now;
+
+  uint32_t results = resultCount;
+  uint32_t wakes   = wakeCount;
+  uint64_t total   = wakeTotal;
+  uint32_t maxLate = wakeMax;
+  resultCount = wakeCount = wakeMax = 0;
+  wakeTotal = 0;
+
+  Serial.printf("wake latency avg: %u us, max: %u us, results/s: %.1f, report queue drops: %u\n",
+                wakes ? (uint32_t)(total / wakes) : 0, maxLate, results / seconds,
+                pBLEScan->getReportDropCount());
+}
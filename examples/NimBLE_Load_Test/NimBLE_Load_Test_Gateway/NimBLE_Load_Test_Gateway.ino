@@ -0,0 +1,227 @@
+/** Load test gateway, use with the NimBLE_Load_Test_Peripherals example on one or more boards.
+ * Scans for the emulated peripherals, then adds one link at a time up to CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+ * and after each one measures for a few seconds with all links subscribed. Each row prints:
+ *  - The time to connect and to discover the services of the link just added.
+ *  - The aggregate notification throughput of all links and the notifications dropped,
+ *    counted from the gaps in the sequence numbers sent by the peripherals.
+ *  - The free heap and its low mark, and the lowest free stack of the loop task and of the host task.
+ *    The host task is only measured with CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE enabled.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+
+#define LOAD_SERVICE_UUID   "5f1c0e00-3b7a-4c61-8d2e-6a9b4f7c1d01"
+#define LOAD_DATA_UUID      "5f1c0e00-3b7a-4c61-8d2e-6a9b4f7c1d02"
+
+#define LOAD_SCAN_SECONDS   5   // Time to look for peripherals before the test.
+#define LOAD_TEST_SECONDS   5   // Time measured after each link is added.
+#define LOAD_PAYLOAD_SIZE   100 // Same as the peripherals.
+#define LOAD_INTERVAL       40  // Connection interval in 1.25ms units, long enough for every link to get events.
+
+/** The state of one gateway link, updated by the notification callback. */
+struct Link {
+  NimBLEClient*     pClient;
+  volatile uint32_t rxPackets;
+  volatile uint32_t rxBytes;
+  volatile uint32_t drops;
+  uint32_t          lastSeq;
+  bool              haveSeq;
+};
+
+static std::vector<NimBLEAddress> peers;
+static Link                       links[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+static size_t                     linkCount = 0;
+static uint32_t                   connectFailures = 0;
+
+class AdvertisedDeviceCallbacks: public NimBLEAdvertisedDeviceCallbacks {
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+      if (!advertisedDevice->isAdvertisingService(NimBLEUUID(LOAD_SERVICE_UUID))) {
+        return;
+      }
+
+      NimBLEAddress address = advertisedDevice->getAddress();
+      for (auto& it : peers) {
+        if (it == address) {
+          return;
+        }
+      }
+
+      if (peers.size() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        Serial.printf("Found peripheral %s\n", address.toString().c_str());
+        peers.push_back(address);
+      }
+    };
+};
+
+/** Counts the notifications of a link and the sequence numbers missed. */
+static void notifyCB(NimBLERemoteCharacteristic* pChr, uint8_t* pData, size_t length, bool isNotify) {
+  NimBLEClient* pClient = pChr->getRemoteService()->getClient();
+  for (size_t i = 0; i < linkCount; i++) {
+    Link& link = links[i];
+    if (link.pClient != pClient) {
+      continue;
+    }
+
+    link.rxPackets++;
+    link.rxBytes += length;
+    if (length >= sizeof(uint32_t)) {
+      uint32_t seq;
+      memcpy(&seq, pData, sizeof(seq));
+      if (link.haveSeq && seq - link.lastSeq > 1) {
+        link.drops += seq - link.lastSeq - 1;
+      }
+      link.lastSeq = seq;
+      link.haveSeq = true;
+    }
+    return;
+  }
+}
+
+/** Disconnects a client that could not be used and deletes it. */
+static void dropClient(NimBLEClient* pClient) {
+  pClient->disconnect();
+  while (pClient->isConnected()) {
+    delay(10);
+  }
+  NimBLEDevice::deleteClient(pClient);
+}
+
+/** Connects, discovers and subscribes a new link, returns the time of each step. */
+static bool addLink(const NimBLEAddress& address, uint32_t* connectMs, uint32_t* discoverMs) {
+  NimBLEClient* pClient = NimBLEDevice::createClient();
+  pClient->setConnectionParams(LOAD_INTERVAL, LOAD_INTERVAL, 0, 400);
+
+  uint32_t start = millis();
+  if (!pClient->connect(address)) {
+    NimBLEDevice::deleteClient(pClient);
+    return false;
+  }
+  *connectMs = millis() - start;
+
+  start = millis();
+  NimBLERemoteService* pSvc = pClient->getService(LOAD_SERVICE_UUID);
+  NimBLERemoteCharacteristic* pChr = pSvc ? pSvc->getCharacteristic(LOAD_DATA_UUID) : nullptr;
+  *discoverMs = millis() - start;
+  if (pChr == nullptr) {
+    dropClient(pClient);
+    return false;
+  }
+
+  Link& link = links[linkCount];
+  link.pClient = pClient;
+  link.haveSeq = false;
+  // The link is counted before subscribing so the callback finds it.
+  linkCount++;
+
+  if (!pChr->subscribe(true, notifyCB)) {
+    linkCount--;
+    dropClient(pClient);
+    return false;
+  }
+  return true;
+}
+
+/** Sets the counters of all links back to 0. */
+static void resetCounters() {
+  for (size_t i = 0; i < linkCount; i++) {
+    links[i].rxPackets = 0;
+    links[i].rxBytes = 0;
+    links[i].drops = 0;
+  }
+}
+
+/** Measures all links for the test time and prints a row. */
+static void measure(uint32_t connectMs, uint32_t discoverMs) {
+  resetCounters();
+  UBaseType_t loopStackLow = uxTaskGetStackHighWaterMark(NULL);
+  uint32_t start = millis();
+  delay(LOAD_TEST_SECONDS * 1000);
+  uint32_t elapsed = millis() - start;
+
+  uint32_t packets = 0, bytes = 0, drops = 0, connected = 0;
+  for (size_t i = 0; i < linkCount; i++) {
+    packets += links[i].rxPackets;
+    bytes   += links[i].rxBytes;
+    drops   += links[i].drops;
+    connected += links[i].pClient->isConnected();
+  }
+
+  UBaseType_t loopStack = uxTaskGetStackHighWaterMark(NULL);
+  if (loopStack < loopStackLow) {
+    loopStackLow = loopStack;
+  }
+
+#ifdef ESP_PLATFORM
+  uint32_t heapFree = esp_get_free_heap_size();
+  uint32_t heapLow  = esp_get_minimum_free_heap_size();
+#else
+  uint32_t heapFree = 0, heapLow = 0;
+#endif
+#if CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+  uint32_t hostStack = NimBLEStackProfile::getHostStackUsed();
+#else
+  uint32_t hostStack = 0;
+#endif
+
+  Serial.printf("%2u %2u | %5u %5u | %7.1f %6u %5u | %6u %6u | %5u %5u | %u\n",
+                (unsigned)linkCount, (unsigned)connected, (unsigned)connectMs, (unsigned)discoverMs,
+                elapsed ? bytes * 8.0f / elapsed : 0, (unsigned)packets, (unsigned)drops,
+                (unsigned)heapFree, (unsigned)heapLow, (unsigned)loopStackLow, (unsigned)hostStack,
+                (unsigned)connectFailures);
+}
+
+/** Disconnects and deletes all links. */
+static void removeLinks() {
+  for (size_t i = 0; i < linkCount; i++) {
+    links[i].pClient->disconnect();
+  }
+  for (size_t i = 0; i < linkCount; i++) {
+    dropClient(links[i].pClient);
+  }
+  linkCount = 0;
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting NimBLE Load Test Gateway");
+
+  NimBLEDevice::init("");
+  NimBLEDevice::setMTU(LOAD_PAYLOAD_SIZE + 3);
+
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->setAdvertisedDeviceCallbacks(new AdvertisedDeviceCallbacks());
+  pScan->setActiveScan(true);
+}
+
+void loop() {
+  peers.clear();
+  NimBLEDevice::getScan()->start(LOAD_SCAN_SECONDS, false);
+  NimBLEDevice::getScan()->clearResults();
+
+  if (peers.empty()) {
+    Serial.println("No peripherals found, scanning again");
+    return;
+  }
+
+  Serial.printf("Testing up to %u links\n", (unsigned)peers.size());
+  Serial.println(" N up | conn  disc |    kbps  notif  drop |   heap   low  | stack  host | fails");
+
+  connectFailures = 0;
+  for (auto& address : peers) {
+    uint32_t connectMs = 0, discoverMs = 0;
+    if (!addLink(address, &connectMs, &discoverMs)) {
+      Serial.printf("Failed to add %s\n", address.toString().c_str());
+      connectFailures++;
+      continue;
+    }
+    measure(connectMs, discoverMs);
+  }
+
+  removeLinks();
+  Serial.println("Test done, starting again");
+  delay(2000);
+}
@@ -0,0 +1,125 @@
+/** Load test peripherals, use with the NimBLE_Load_Test_Gateway example.
+ * Emulates several peripherals on one board: with extended advertising enabled each advertising
+ * instance advertises as a separate connectable device with its own random static address, without
+ * it the board is a single peripheral and more boards are needed to reach the connection count.
+ * Every connected and subscribed gateway link is notified a sequence number followed by filler bytes
+ * at a fixed rate, the gateway counts the gaps in the sequence as drops.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+
+#define LOAD_SERVICE_UUID   "5f1c0e00-3b7a-4c61-8d2e-6a9b4f7c1d01"
+#define LOAD_DATA_UUID      "5f1c0e00-3b7a-4c61-8d2e-6a9b4f7c1d02"
+
+#define LOAD_NOTIFY_MS      20  // Time between notifications.
+#define LOAD_PAYLOAD_SIZE   100 // Bytes of each notification, including the sequence number.
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+/** The instances that can advertise at the same time, each one is an emulated peripheral. */
+#  define LOAD_INSTANCES    (CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES + 1)
+#endif
+
+static NimBLECharacteristic* pDataChr;
+static uint8_t               payload[LOAD_PAYLOAD_SIZE];
+static uint32_t              seq = 0;
+
+/** Starts advertising the instances or the device again after a disconnection. */
+static void startAdvertising() {
+#if CONFIG_BT_NIMBLE_EXT_ADV
+  NimBLEExtAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  for (uint8_t i = 0; i < LOAD_INSTANCES; i++) {
+    if (!pAdvertising->isActive(i)) {
+      pAdvertising->start(i);
+    }
+  }
+#else
+  NimBLEDevice::startAdvertising();
+#endif
+}
+
+class ServerCallbacks: public NimBLEServerCallbacks {
+    void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+      Serial.printf("Gateway connected, %u links\n", (unsigned)pServer->getConnectedCount());
+      // An undirected instance stops when a link is made on it, the others keep running.
+#if !CONFIG_BT_NIMBLE_EXT_ADV
+      if (pServer->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        startAdvertising();
+      }
+#endif
+    };
+
+    void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+      Serial.printf("Gateway disconnected, %u links\n", (unsigned)pServer->getConnectedCount());
+      startAdvertising();
+    };
+};
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting NimBLE Load Test Peripherals");
+
+  NimBLEDevice::init("Load Test");
+  NimBLEDevice::setMTU(LOAD_PAYLOAD_SIZE + 3);
+
+  NimBLEServer* pServer = NimBLEDevice::createServer();
+  pServer->setCallbacks(new ServerCallbacks());
+
+  NimBLEService* pService = pServer->createService(LOAD_SERVICE_UUID);
+  pDataChr = pService->createCharacteristic(LOAD_DATA_UUID, NIMBLE_PROPERTY::NOTIFY);
+  pService->start();
+
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = i;
+  }
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+  NimBLEExtAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  // Random static addresses derived from the device address, the 2 top bits are set.
+  uint64_t base = (uint64_t)NimBLEDevice::getAddress() | 0xC00000000000ULL;
+
+  for (uint8_t i = 0; i < LOAD_INSTANCES; i++) {
+    NimBLEExtAdvertisement adv;
+    // Legacy PDU's so a gateway without extended advertising finds the instances too.
+    adv.setLegacyAdvertising(true);
+    adv.setConnectable(true);
+    adv.setAddress(NimBLEAddress((base & ~0xFFULL) | (uint8_t)(base + i), BLE_ADDR_RANDOM));
+    adv.setName("Load " + std::to_string(i));
+    adv.setCompleteServices(NimBLEUUID(LOAD_SERVICE_UUID));
+    adv.setMinInterval(160);
+    adv.setMaxInterval(240);
+
+    if (!pAdvertising->setInstanceData(i, adv)) {
+      Serial.printf("Failed to configure instance %u\n", i);
+    }
+  }
+#else
+  NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  pAdvertising->addServiceUUID(LOAD_SERVICE_UUID);
+  pAdvertising->setScanResponse(true);
+#endif
+
+  startAdvertising();
+  Serial.println("Advertising");
+}
+
+void loop() {
+  static uint32_t last = 0;
+  uint32_t now = millis();
+  if (now - last < LOAD_NOTIFY_MS) {
+    delay(1);
+    return;
+  }
+  last = now;
+
+  if (pDataChr->getSubscribedCount() > 0) {
+    memcpy(payload, &seq, sizeof(seq));
+    pDataChr->notify(payload, sizeof(payload));
+  }
+
+  // Every link gets the same sequence number, the gateway counts the gaps on each of them.
+  seq++;
+}
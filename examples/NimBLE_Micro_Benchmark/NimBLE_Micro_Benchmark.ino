@@ -0,0 +1,259 @@
+/** Micro benchmark of the library code that runs for every packet.
+ * Runs each operation in a loop and prints the time per operation in nanoseconds
+ * and the number of C++ heap allocations per operation for:
+ *  - Advertisement field lookups of NimBLEAdvertisedDevice (findAdvField).
+ *  - NimBLEAttValue setValue and append.
+ *  - NimBLEUUID parsing and comparison.
+ *  - NimBLEAddress construction and comparison.
+ *  - NimBLEAdvertisementData building.
+ *  - os_mbuf append and copydata.
+ *  - os_mempool block get and put, alone and, on dual core ESP32, with a task on the other core
+ *    using the same pool. Build with CONFIG_BT_NIMBLE_MEMPOOL_LOCK_FREE 1 and 0 to compare.
+ *
+ * The advertisement lookups use the device with the largest payload found by a short scan,
+ * they are skipped when no device is found.
+ * Send any character over serial to run the benchmarks again.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+#include <new>
+
+/** Benchmark settings */
+#define BENCH_ITERATIONS  10000
+#define BENCH_SCAN_TIME   3     // Seconds to scan for a device to run the advertisement lookups on.
+
+static volatile uint32_t allocCount = 0;
+static volatile uint32_t sink = 0;
+
+static os_membuf_t poolMem[OS_MEMPOOL_SIZE(16, 64)];
+static struct os_mempool benchPool;
+static volatile bool contend = false;
+
+static NimBLEAdvertisedDevice benchDevice;
+static bool haveDevice = false;
+
+/** Count every C++ heap allocation, including those made by the library. */
+void* operator new(size_t size) {
+  allocCount++;
+  void* ptr = malloc(size);
+  if (ptr == nullptr) {
+    abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+/** Run fn BENCH_ITERATIONS times and print the time and allocations per call. */
+template <typename F>
+void bench(const char* name, F fn) {
+  /** Warm up caches and lazily allocated state. */
+  for (int i = 0; i < 100; i++) {
+    fn();
+  }
+
+  uint32_t allocs = allocCount;
+  uint32_t start = micros();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    fn();
+  }
+  uint32_t elapsed = micros() - start;
+  allocs = allocCount - allocs;
+
+  Serial.printf("%-36s %8.1f ns/op %6.2f allocs/op\n", name,
+                elapsed * 1000.0 / BENCH_ITERATIONS, (float)allocs / BENCH_ITERATIONS);
+}
+
+void findDevice() {
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->setActiveScan(true);
+  NimBLEScanResults results = pScan->start(BENCH_SCAN_TIME, false);
+
+  size_t maxLen = 0;
+  for (int i = 0; i < results.getCount(); i++) {
+    NimBLEAdvertisedDevice device = results.getDevice(i);
+    if (device.getPayloadLength() > maxLen) {
+      maxLen = device.getPayloadLength();
+      benchDevice = device;
+      haveDevice = true;
+    }
+  }
+  pScan->clearResults();
+
+  if (haveDevice) {
+    Serial.printf("Advertisement lookups use %s, payload length %d\n",
+                  benchDevice.getAddress().toString().c_str(), maxLen);
+  }
+}
+
+void runBenchmarks() {
+  Serial.printf("\n%d iterations per benchmark\n", BENCH_ITERATIONS);
+
+  if (haveDevice) {
+    bench("findAdvField: getNamePtr", [] {
+      size_t len;
+      sink += (uintptr_t)benchDevice.getNamePtr(&len);
+    });
+    bench("findAdvField: getManufacturerDataPtr", [] {
+      size_t len;
+      sink += (uintptr_t)benchDevice.getManufacturerDataPtr(&len);
+    });
+    bench("findAdvField: haveServiceUUID", [] {
+      sink += benchDevice.haveServiceUUID();
+    });
+    bench("findAdvField: getServiceData", [] {
+      sink += benchDevice.getServiceData().size();
+    });
+  }
+
+  static const uint8_t data[64] = {0};
+  static NimBLEAttValue attValue;
+  bench("NimBLEAttValue::setValue(20)", [] {
+    attValue.setValue(data, 20);
+  });
+  bench("NimBLEAttValue::setValue(64)", [] {
+    attValue.setValue(data, 64);
+  });
+  bench("NimBLEAttValue::append(16)", [] {
+    if (attValue.size() > 200) {
+      attValue.setValue(data, 0);
+    }
+    attValue.append(data, 16);
+  });
+
+  static const std::string uuidStr = "ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6";
+  static const NimBLEUUID uuid16((uint16_t)0x180d);
+  static const NimBLEUUID uuid128(uuidStr);
+  bench("NimBLEUUID(std::string) 128 bit", [] {
+    NimBLEUUID uuid(uuidStr);
+    sink += uuid.bitSize();
+  });
+  bench("NimBLEUUID(\"180d\")", [] {
+    NimBLEUUID uuid("180d");
+    sink += uuid.bitSize();
+  });
+  bench("NimBLEUUID == 16 bit", [] {
+    sink += (uuid16 == NimBLEUUID((uint16_t)0x180d));
+  });
+  bench("NimBLEUUID == 128 bit", [] {
+    sink += (uuid128 == NimBLEUUID(0xebe0ccb0, 0x7a0a, 0x4b0c, 0x8a1a6ff2997da3a6));
+  });
+  bench("NimBLEUUID == 16 bit vs 128 bit", [] {
+    sink += (uuid16 == uuid128);
+  });
+
+  static const std::string addrStr = "aa:bb:cc:dd:ee:ff";
+  static uint8_t addrBytes[6] = {0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa};
+  static const NimBLEAddress address(addrStr);
+  bench("NimBLEAddress(std::string)", [] {
+    NimBLEAddress addr(addrStr);
+    sink += addr.getType();
+  });
+  bench("NimBLEAddress(uint8_t[6])", [] {
+    NimBLEAddress addr(addrBytes);
+    sink += addr.getType();
+  });
+  bench("NimBLEAddress ==", [] {
+    sink += (address == NimBLEAddress(addrBytes));
+  });
+
+  bench("NimBLEAdvertisementData build", [] {
+    NimBLEAdvertisementData advData;
+    advData.setFlags(BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP);
+    advData.setName("NimBLE");
+    advData.setCompleteServices(uuid16);
+    advData.setManufacturerData(std::string("\x4c\x00\x02\x15", 4));
+    sink += advData.getPayload().size();
+  });
+
+  bench("os_mbuf get + append(64) + free", [] {
+    struct os_mbuf* om = os_msys_get_pkthdr(0, 0);
+    if (om != nullptr) {
+      os_mbuf_append(om, data, sizeof(data));
+      os_mbuf_free_chain(om);
+    }
+  });
+
+  static struct os_mbuf* chain = nullptr;
+  if (chain == nullptr) {
+    chain = os_msys_get_pkthdr(0, 0);
+    for (int i = 0; chain != nullptr && i < 4; i++) {
+      os_mbuf_append(chain, data, sizeof(data));
+    }
+  }
+  if (chain != nullptr) {
+    bench("os_mbuf_copydata(256)", [] {
+      static uint8_t buf[256];
+      os_mbuf_copydata(chain, 0, sizeof(buf), buf);
+      sink += buf[0];
+    });
+  }
+}
+
+/** Takes and gives back pool blocks while contend is set, from the other core. */
+void contendTask(void* param) {
+  for (;;) {
+    if (contend) {
+      void* block = os_memblock_get(&benchPool);
+      if (block != nullptr) {
+        os_memblock_put(&benchPool, block);
+      }
+    } else {
+      vTaskDelay(1);
+    }
+  }
+}
+
+void runMempoolBenchmarks() {
+  Serial.printf("os_mempool lock free: %d\n", MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE));
+
+  bench("os_memblock get + put", [] {
+    void* block = os_memblock_get(&benchPool);
+    if (block != nullptr) {
+      os_memblock_put(&benchPool, block);
+    }
+  });
+
+#if defined(ESP_PLATFORM) && !CONFIG_FREERTOS_UNICORE
+  contend = true;
+  bench("os_memblock get + put, other core too", [] {
+    void* block = os_memblock_get(&benchPool);
+    if (block != nullptr) {
+      os_memblock_put(&benchPool, block);
+    }
+  });
+  contend = false;
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting micro benchmark...");
+
+  os_mempool_init(&benchPool, 16, 64, poolMem, "bench");
+#if defined(ESP_PLATFORM) && !CONFIG_FREERTOS_UNICORE
+  xTaskCreatePinnedToCore(contendTask, "contend", 2048, nullptr, 1, nullptr, xPortGetCoreID() ? 0 : 1);
+#endif
+
+  NimBLEDevice::init("");
+  findDevice();
+  runBenchmarks();
+  runMempoolBenchmarks();
+}
+
+void loop() {
+  if (Serial.available()) {
+    while (Serial.available()) {
+      Serial.read();
+    }
+    runBenchmarks();
+    runMempoolBenchmarks();
+  }
+  delay(100);
+}
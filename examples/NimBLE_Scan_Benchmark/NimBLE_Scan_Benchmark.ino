@@ -0,0 +1,171 @@
+/** Scan throughput benchmark.
+ * Scans continuously and every few seconds prints:
+ *  - The number of advertisement reports per second received by the host.
+ *  - The number of onResult callbacks per second and the time spent in them.
+ *  - The number of C++ heap allocations per second.
+ *  - The reports dropped by the scan report queue, if used.
+ *  - The host task stack high water mark and CPU usage (when FreeRTOS run time stats are enabled).
+ *
+ * Change the settings below to compare the effect of each scan option, extended advertising
+ * scanning is used when CONFIG_BT_NIMBLE_EXT_ADV is enabled in nimconfig.h.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+#include <new>
+
+/** Benchmark settings */
+#define BENCH_ACTIVE_SCAN        true  // Request scan responses.
+#define BENCH_DUPLICATE_FILTER   false // Let the controller filter duplicate advertisements.
+#define BENCH_MAX_RESULTS        0     // 0 = callbacks only, 0xFF = unlimited, any other value is the limit.
+#define BENCH_REPORT_QUEUE_SIZE  0     // > 0 processes reports in a separate task with a queue of this size.
+#define BENCH_PRINT_INTERVAL_MS  5000
+
+static volatile uint32_t reportCount = 0;
+static volatile uint32_t resultCount = 0;
+static volatile uint32_t allocCount  = 0;
+static volatile uint32_t cbTimeTotal = 0;
+static volatile uint32_t cbTimeMax   = 0;
+
+NimBLEScan* pBLEScan;
+
+/** Count every C++ heap allocation, including those made by the library. */
+void* operator new(size_t size) {
+  allocCount++;
+  void* ptr = malloc(size);
+  if (ptr == nullptr) {
+    abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+/** Listens to all GAP events, the host calls this after the scan has processed each report. */
+int gapListener(ble_gap_event* event, void* arg) {
+  if (event->type == BLE_GAP_EVENT_DISC || event->type == BLE_GAP_EVENT_EXT_DISC) {
+    reportCount++;
+  }
+  return 0;
+}
+
+class MyAdvertisedDeviceCallbacks: public NimBLEAdvertisedDeviceCallbacks {
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+      uint32_t start = micros();
+      resultCount++;
+
+      /** Some typical work done with a result. */
+      size_t len = 0;
+      advertisedDevice->getManufacturerDataPtr(&len);
+      advertisedDevice->getNamePtr(&len);
+      advertisedDevice->getRSSI();
+
+      uint32_t elapsed = micros() - start;
+      cbTimeTotal += elapsed;
+      if (elapsed > cbTimeMax) {
+        cbTimeMax = elapsed;
+      }
+    }
+};
+
+/** Get the run time of the host task, 0 if FreeRTOS run time stats are not enabled. */
+uint32_t getHostRunTime(TaskHandle_t hostTask, uint32_t* totalRunTime) {
+  *totalRunTime = 0;
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+  UBaseType_t numTasks = uxTaskGetNumberOfTasks();
+  TaskStatus_t* tasks = (TaskStatus_t*)malloc(numTasks * sizeof(TaskStatus_t));
+  uint32_t hostRunTime = 0;
+  if (tasks != nullptr) {
+    numTasks = uxTaskGetSystemState(tasks, numTasks, totalRunTime);
+    for (UBaseType_t i = 0; i < numTasks; i++) {
+      if (tasks[i].xHandle == hostTask) {
+        hostRunTime = tasks[i].ulRunTimeCounter;
+      }
+    }
+    free(tasks);
+  }
+  return hostRunTime;
+#else
+  return 0;
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting scan benchmark...");
+
+  NimBLEDevice::setScanDuplicateCacheSize(200);
+  NimBLEDevice::init("");
+  NimBLEDevice::setCustomGapHandler(gapListener);
+
+  pBLEScan = NimBLEDevice::getScan();
+  pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks(), !BENCH_DUPLICATE_FILTER);
+  pBLEScan->setActiveScan(BENCH_ACTIVE_SCAN);
+  pBLEScan->setInterval(100);
+  pBLEScan->setWindow(100);
+  pBLEScan->setMaxResults(BENCH_MAX_RESULTS);
+#if BENCH_REPORT_QUEUE_SIZE > 0
+  pBLEScan->setReportQueue(BENCH_REPORT_QUEUE_SIZE);
+#endif
+
+  Serial.printf("Active scan: %d, duplicate filter: %d, max results: %d, report queue: %d, ext adv: %d\n",
+                BENCH_ACTIVE_SCAN, BENCH_DUPLICATE_FILTER, BENCH_MAX_RESULTS, BENCH_REPORT_QUEUE_SIZE,
+                CONFIG_BT_NIMBLE_EXT_ADV + 0);
+}
+
+void loop() {
+  static uint32_t lastPrint = millis();
+  static uint32_t lastHostRunTime = 0;
+  static uint32_t lastTotalRunTime = 0;
+
+  if (pBLEScan->isScanning() == false) {
+    pBLEScan->start(0, nullptr, false);
+  }
+
+  delay(100);
+
+  uint32_t now = millis();
+  if (now - lastPrint < BENCH_PRINT_INTERVAL_MS) {
+    return;
+  }
+
+  float seconds = (now - lastPrint) / 1000.0;
+  lastPrint = now;
+
+  uint32_t reports = reportCount;
+  uint32_t results = resultCount;
+  uint32_t allocs  = allocCount;
+  uint32_t cbTotal = cbTimeTotal;
+  uint32_t cbMax   = cbTimeMax;
+  reportCount = resultCount = allocCount = cbTimeTotal = cbTimeMax = 0;
+
+  Serial.printf("reports/s: %.1f, results/s: %.1f, allocs/s: %.1f, callback avg: %u us, max: %u us\n",
+                reports / seconds, results / seconds, allocs / seconds,
+                results ? cbTotal / results : 0, cbMax);
+
+#if BENCH_REPORT_QUEUE_SIZE > 0
+  Serial.printf("report queue drops: %u\n", pBLEScan->getReportDropCount());
+#endif
+
+#ifdef ESP_PLATFORM
+  TaskHandle_t hostTask = xTaskGetHandle("nimble_host");
+  if (hostTask != nullptr) {
+    uint32_t totalRunTime = 0;
+    uint32_t hostRunTime = getHostRunTime(hostTask, &totalRunTime);
+    if (totalRunTime > lastTotalRunTime) {
+      Serial.printf("host task CPU: %.1f%%, ", 100.0 * (hostRunTime - lastHostRunTime) /
+                                               (totalRunTime - lastTotalRunTime));
+    }
+    lastHostRunTime = hostRunTime;
+    lastTotalRunTime = totalRunTime;
+    Serial.printf("host stack free: %u bytes, ", uxTaskGetStackHighWaterMark(hostTask));
+  }
+  Serial.printf("free heap: %u bytes, min free heap: %u bytes\n", esp_get_free_heap_size(),
+                esp_get_minimum_free_heap_size());
+#endif
+}
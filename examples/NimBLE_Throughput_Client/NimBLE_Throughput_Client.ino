@@ -0,0 +1,259 @@
+/** Throughput benchmark client, use with the NimBLE_Throughput_Server example.
+ * Connects to the server once for each entry of the sweep table below, negotiates the MTU, PHY,
+ * data length and connection interval of the entry and runs three tests:
+ *  - Notify: the server notifies as fast as it can, prints kbps and packets per connection event.
+ *  - Indicate: the server indicates one at a time, prints the round trip latency percentiles.
+ *  - Write: writes without response as fast as buffers allow, prints kbps received by the server.
+ * Each row also prints the lowest number of free mbufs seen on the server and on the client.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+
+#define BENCH_SERVICE_UUID  "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0001"
+#define BENCH_TX_UUID       "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0002"
+#define BENCH_IND_UUID      "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0003"
+#define BENCH_RX_UUID       "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0004"
+#define BENCH_CTRL_UUID     "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0005"
+#define BENCH_RESULT_UUID   "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0006"
+
+#define BENCH_CMD_NOTIFY    1
+#define BENCH_CMD_INDICATE  2
+#define BENCH_CMD_WRITE     3
+
+#define BENCH_TEST_SECONDS  5   // Duration of each test.
+#define BENCH_MBUF_RESERVE  4   // Stop writing while fewer mbufs than this are free.
+
+/** Same as the server example, all values are little endian. */
+struct __attribute__((packed)) BenchResult {
+  uint32_t sentCount;
+  uint32_t dropCount;
+  uint32_t rxBytes;
+  uint32_t rxMs;
+  uint32_t latP50;
+  uint32_t latP90;
+  uint32_t latP99;
+  uint32_t latMax;
+  uint16_t latCount;
+  uint16_t mbufLow;
+};
+
+/** The link settings to sweep, the interval is in 1.25ms units. */
+struct BenchConfig {
+  uint16_t mtu;
+  uint8_t  phyMask;
+  uint16_t txOctets;
+  uint16_t interval;
+};
+
+static const BenchConfig sweep[] = {
+  {23,  BLE_GAP_LE_PHY_1M_MASK, 27,  24},
+  {247, BLE_GAP_LE_PHY_1M_MASK, 27,  24},
+  {247, BLE_GAP_LE_PHY_1M_MASK, 251, 24},
+  {247, BLE_GAP_LE_PHY_2M_MASK, 251, 24},
+  {247, BLE_GAP_LE_PHY_2M_MASK, 251, 12},
+  {247, BLE_GAP_LE_PHY_2M_MASK, 251, 6},
+  {517, BLE_GAP_LE_PHY_2M_MASK, 251, 12},
+  {517, BLE_GAP_LE_PHY_2M_MASK, 251, 80},
+};
+
+static NimBLEAdvertisedDevice*  advDevice;
+static volatile bool            doConnect   = false;
+static volatile bool            linkDone    = false;
+static NimBLELinkProfileResult  linkResult;
+static volatile uint32_t        rxPackets   = 0;
+static volatile uint32_t        rxBytes     = 0;
+static volatile uint32_t        rxFirst     = 0;
+static volatile uint32_t        rxLast      = 0;
+static uint16_t                 mbufLow     = 0;
+static uint8_t                  payload[BLE_ATT_MTU_MAX];
+
+static void trackMbufs() {
+  uint16_t free = os_msys_num_free();
+  if (free < mbufLow) {
+    mbufLow = free;
+  }
+}
+
+class AdvertisedDeviceCallbacks: public NimBLEAdvertisedDeviceCallbacks {
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+      if (advertisedDevice->isAdvertisingService(NimBLEUUID(BENCH_SERVICE_UUID))) {
+        Serial.printf("Found server: %s\n", advertisedDevice->getAddress().toString().c_str());
+        NimBLEDevice::getScan()->stop();
+        advDevice = advertisedDevice;
+        doConnect = true;
+      }
+    };
+};
+
+/** Counts the notifications received during the notify test. */
+static void notifyCB(NimBLERemoteCharacteristic* pChr, uint8_t* pData, size_t length, bool isNotify) {
+  uint32_t now = millis();
+  if (rxPackets == 0) {
+    rxFirst = now;
+  }
+  rxPackets++;
+  rxBytes += length;
+  rxLast = now;
+  trackMbufs();
+}
+
+/** Starts a test on the server, waits for it to finish and reads the result. */
+static bool runTest(NimBLERemoteService* pSvc, uint8_t cmd, BenchResult* pResult) {
+  uint8_t ctrl[2] = {cmd, BENCH_TEST_SECONDS};
+  if (!pSvc->getCharacteristic(BENCH_CTRL_UUID)->writeValue(ctrl, sizeof(ctrl), true)) {
+    return false;
+  }
+
+  uint32_t end = millis() + BENCH_TEST_SECONDS * 1000;
+  if (cmd == BENCH_CMD_WRITE) {
+    NimBLERemoteCharacteristic* pRx = pSvc->getCharacteristic(BENCH_RX_UUID);
+    size_t len = pSvc->getClient()->getMTU() - 3;
+    while ((int32_t)(millis() - end) < 0 && pSvc->getClient()->isConnected()) {
+      trackMbufs();
+      if (os_msys_num_free() < BENCH_MBUF_RESERVE || !pRx->writeValue(payload, len, false)) {
+        delay(1);
+      }
+    }
+  } else {
+    while ((int32_t)(millis() - end) < 0) {
+      trackMbufs();
+      delay(10);
+    }
+  }
+
+  // Give the server time to finish the last indication and store the result.
+  delay(500);
+  NimBLEAttValue value = pSvc->getCharacteristic(BENCH_RESULT_UUID)->readValue();
+  if (value.size() < sizeof(BenchResult)) {
+    return false;
+  }
+
+  memcpy(pResult, value.data(), sizeof(BenchResult));
+  return true;
+}
+
+/** Connects with the settings of one sweep entry and prints a row of results. */
+static void runConfig(const BenchConfig& cfg) {
+  // The MTU is exchanged when connecting so it must be set first.
+  NimBLEDevice::setMTU(cfg.mtu);
+
+  NimBLEClient* pClient = NimBLEDevice::createClient();
+  if (!pClient->connect(advDevice)) {
+    Serial.println("Failed to connect");
+    NimBLEDevice::deleteClient(pClient);
+    return;
+  }
+
+  NimBLELinkProfile profile = NimBLELinkProfile::throughput();
+  profile.phyMask     = cfg.phyMask;
+  profile.txOctets    = cfg.txOctets;
+  profile.exchangeMTU = false;
+  profile.minInterval = cfg.interval;
+  profile.maxInterval = cfg.interval;
+
+  linkDone = false;
+  pClient->applyLinkProfile(profile, [](const NimBLELinkProfileResult& result) {
+    linkResult = result;
+    linkDone = true;
+  });
+
+  while (!linkDone && pClient->isConnected()) {
+    delay(10);
+  }
+
+  NimBLERemoteService* pSvc = pClient->getService(BENCH_SERVICE_UUID);
+  if (pSvc == nullptr) {
+    Serial.println("Benchmark service not found");
+    pClient->disconnect();
+    while (pClient->isConnected()) {
+      delay(10);
+    }
+    NimBLEDevice::deleteClient(pClient);
+    return;
+  }
+
+  BenchResult notifyRes = {}, indRes = {}, writeRes = {};
+  mbufLow = os_msys_num_free();
+
+  rxPackets = rxBytes = 0;
+  NimBLERemoteCharacteristic* pTx = pSvc->getCharacteristic(BENCH_TX_UUID);
+  pTx->subscribe(true, notifyCB);
+  runTest(pSvc, BENCH_CMD_NOTIFY, &notifyRes);
+  pTx->unsubscribe();
+  uint32_t notifyMs = rxLast - rxFirst;
+
+  NimBLERemoteCharacteristic* pInd = pSvc->getCharacteristic(BENCH_IND_UUID);
+  pInd->subscribe(false);
+  runTest(pSvc, BENCH_CMD_INDICATE, &indRes);
+  pInd->unsubscribe();
+
+  runTest(pSvc, BENCH_CMD_WRITE, &writeRes);
+
+  float intervalMs = linkResult.interval * 1.25f;
+  float notifyKbps = notifyMs ? rxBytes * 8.0f / notifyMs : 0;
+  float pktPerEvt  = (notifyMs && intervalMs > 0) ? rxPackets / (notifyMs / intervalMs) : 0;
+  float writeKbps  = writeRes.rxMs ? writeRes.rxBytes * 8.0f / writeRes.rxMs : 0;
+  uint16_t srvMbufLow = notifyRes.mbufLow;
+  if (indRes.mbufLow < srvMbufLow) {
+    srvMbufLow = indRes.mbufLow;
+  }
+  if (writeRes.mbufLow < srvMbufLow) {
+    srvMbufLow = writeRes.mbufLow;
+  }
+
+  Serial.printf("%4u %2u/%u %3u %6.2f | %7.1f %5.2f %4u | %6u %6u %6u %6u | %7.1f | %3u %3u\n",
+                linkResult.mtu, linkResult.txPhy, linkResult.rxPhy, cfg.txOctets, intervalMs,
+                notifyKbps, pktPerEvt, notifyRes.dropCount,
+                indRes.latP50, indRes.latP90, indRes.latP99, indRes.latMax,
+                writeKbps, srvMbufLow, mbufLow);
+
+  pClient->disconnect();
+  while (pClient->isConnected()) {
+    delay(10);
+  }
+  NimBLEDevice::deleteClient(pClient);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting NimBLE Throughput Client");
+
+  NimBLEDevice::init("");
+#ifdef ESP_PLATFORM
+  NimBLEDevice::setPower(ESP_PWR_LVL_P9);
+#else
+  NimBLEDevice::setPower(9);
+#endif
+
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = i;
+  }
+
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->setAdvertisedDeviceCallbacks(new AdvertisedDeviceCallbacks());
+  pScan->setActiveScan(true);
+  pScan->start(0, nullptr, false);
+}
+
+void loop() {
+  if (!doConnect) {
+    delay(10);
+    return;
+  }
+
+  doConnect = false;
+
+  Serial.println("                      | notify             | indicate latency (us)       | write   | mbuf low");
+  Serial.println(" MTU  PHY DLE   itvl |    kbps pkt/e drop |    p50    p90    p99    max |    kbps | srv cli");
+  for (const BenchConfig& cfg : sweep) {
+    runConfig(cfg);
+  }
+
+  Serial.println("Sweep done, scanning to run again");
+  NimBLEDevice::getScan()->clearResults();
+  NimBLEDevice::getScan()->start(0, nullptr, false);
+}
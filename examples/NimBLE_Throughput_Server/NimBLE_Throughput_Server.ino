@@ -0,0 +1,237 @@
+/** Throughput benchmark server, use with the NimBLE_Throughput_Client example.
+ * The client writes a command to the control characteristic to start a test:
+ *  - Notify: sends notifications of MTU - 3 bytes as fast as buffers allow.
+ *  - Indicate: sends one indication at a time and records the round trip time of each.
+ *  - Write: counts the data the client writes without response.
+ * When a test ends the results are stored in the result characteristic for the client to read,
+ * including the indication latency percentiles and the lowest number of free mbufs seen.
+ *
+ * Created: on October 14 2026
+ *      Author: H2zero
+ *
+ */
+
+#include "NimBLEDevice.h"
+#include <algorithm>
+
+#define BENCH_SERVICE_UUID  "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0001"
+#define BENCH_TX_UUID       "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0002" // Notify
+#define BENCH_IND_UUID      "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0003" // Indicate
+#define BENCH_RX_UUID       "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0004" // Write without response
+#define BENCH_CTRL_UUID     "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0005" // Write [command, seconds]
+#define BENCH_RESULT_UUID   "a9c1b100-7d3a-4d2e-9f3c-1e6a5c2b0006" // Read BenchResult
+
+#define BENCH_CMD_NOTIFY    1
+#define BENCH_CMD_INDICATE  2
+#define BENCH_CMD_WRITE     3
+
+#define BENCH_MAX_SAMPLES   256 // Indication latency samples kept per test.
+#define BENCH_MBUF_RESERVE  4   // Stop sending while fewer mbufs than this are free.
+
+/** Shared with the client example, all values are little endian. */
+struct __attribute__((packed)) BenchResult {
+  uint32_t sentCount; // Notifications or indications sent.
+  uint32_t dropCount; // Notifications that could not be sent because no buffers were available.
+  uint32_t rxBytes;   // Bytes written by the client.
+  uint32_t rxMs;      // Time from the first to the last write received.
+  uint32_t latP50;    // Indication round trip percentiles in microseconds.
+  uint32_t latP90;
+  uint32_t latP99;
+  uint32_t latMax;
+  uint16_t latCount;
+  uint16_t mbufLow;   // Lowest number of free mbufs during the test.
+};
+
+static NimBLECharacteristic* pTxChr;
+static NimBLECharacteristic* pIndChr;
+static NimBLECharacteristic* pRxChr;
+static NimBLECharacteristic* pResultChr;
+
+static uint16_t          connHandle = BLE_HS_CONN_HANDLE_NONE;
+static volatile uint8_t  testCmd    = 0;
+static volatile uint32_t testEnd    = 0;
+static volatile bool     indPending = false;
+static volatile uint32_t indStart   = 0;
+static volatile uint32_t latCount   = 0;
+static volatile uint32_t rxBytes    = 0;
+static volatile uint32_t rxFirst    = 0;
+static volatile uint32_t rxLast     = 0;
+static uint32_t          latSamples[BENCH_MAX_SAMPLES];
+static BenchResult       result;
+static uint8_t           payload[BLE_ATT_MTU_MAX];
+
+static void trackMbufs() {
+  uint16_t free = os_msys_num_free();
+  if (free < result.mbufLow) {
+    result.mbufLow = free;
+  }
+}
+
+class ServerCallbacks : public NimBLEServerCallbacks {
+    void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+      Serial.printf("Client connected: %s\n", NimBLEAddress(desc->peer_ota_addr).toString().c_str());
+      connHandle = desc->conn_handle;
+    };
+
+    void onDisconnect(NimBLEServer* pServer) {
+      Serial.println("Client disconnected");
+      connHandle = BLE_HS_CONN_HANDLE_NONE;
+      testCmd = 0;
+      indPending = false;
+    };
+};
+
+class BenchCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic) {
+      if (pCharacteristic == pRxChr) {
+        uint32_t now = millis();
+        if (rxBytes == 0) {
+          rxFirst = now;
+        }
+        rxBytes += pCharacteristic->getDataLength();
+        rxLast = now;
+        return;
+      }
+
+      // Control characteristic: [command, seconds]
+      NimBLEAttValue cmd = pCharacteristic->getValue();
+      if (cmd.size() < 2) {
+        return;
+      }
+
+      memset(&result, 0, sizeof(result));
+      result.mbufLow = os_msys_num_free();
+      latCount   = 0;
+      rxBytes    = 0;
+      indPending = false;
+      testEnd    = millis() + cmd[1] * 1000;
+      testCmd    = cmd[0];
+      Serial.printf("Starting test %u for %us\n", cmd[0], cmd[1]);
+    };
+
+    void onStatus(NimBLECharacteristic* pCharacteristic, Status status, int code) {
+      if (status == SUCCESS_INDICATE && indPending) {
+        if (latCount < BENCH_MAX_SAMPLES) {
+          latSamples[latCount++] = micros() - indStart;
+        }
+        indPending = false;
+      } else if (status == ERROR_INDICATE_TIMEOUT || status == ERROR_INDICATE_FAILURE) {
+        indPending = false;
+      } else if (status == ERROR_GATT && code == BLE_HS_ENOMEM) {
+        result.dropCount++;
+      }
+    };
+};
+
+static BenchCallbacks benchCallbacks;
+
+/** Store the results of the finished test in the result characteristic. */
+static void finishTest() {
+  uint32_t count = latCount;
+  if (count > 0) {
+    std::sort(latSamples, latSamples + count);
+    result.latP50 = latSamples[count * 50 / 100];
+    result.latP90 = latSamples[count * 90 / 100];
+    result.latP99 = latSamples[count * 99 / 100];
+    result.latMax = latSamples[count - 1];
+  }
+
+  result.latCount = count;
+  result.rxBytes  = rxBytes;
+  result.rxMs     = rxLast - rxFirst;
+  pResultChr->setValue((uint8_t*)&result, sizeof(result));
+
+  Serial.printf("Test %u done: sent %u, dropped %u, rx %u bytes, mbuf low %u\n",
+                testCmd, result.sentCount, result.dropCount, result.rxBytes, result.mbufLow);
+  testCmd = 0;
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Starting NimBLE Throughput Server");
+
+  NimBLEDevice::init("NimBLE-Bench");
+  NimBLEDevice::setMTU(BLE_ATT_MTU_MAX);
+#ifdef ESP_PLATFORM
+  NimBLEDevice::setPower(ESP_PWR_LVL_P9);
+#else
+  NimBLEDevice::setPower(9);
+#endif
+
+  NimBLEServer* pServer = NimBLEDevice::createServer();
+  pServer->setCallbacks(new ServerCallbacks());
+
+  NimBLEService* pService = pServer->createService(BENCH_SERVICE_UUID);
+  pTxChr = pService->createCharacteristic(BENCH_TX_UUID, NIMBLE_PROPERTY::NOTIFY);
+  pIndChr = pService->createCharacteristic(BENCH_IND_UUID, NIMBLE_PROPERTY::INDICATE);
+  pRxChr = pService->createCharacteristic(BENCH_RX_UUID, NIMBLE_PROPERTY::WRITE_NR, BLE_ATT_MTU_MAX);
+  NimBLECharacteristic* pCtrlChr = pService->createCharacteristic(BENCH_CTRL_UUID, NIMBLE_PROPERTY::WRITE);
+  pResultChr = pService->createCharacteristic(BENCH_RESULT_UUID, NIMBLE_PROPERTY::READ);
+
+  pTxChr->setCallbacks(&benchCallbacks);
+  pIndChr->setCallbacks(&benchCallbacks);
+  pRxChr->setCallbacks(&benchCallbacks);
+  pCtrlChr->setCallbacks(&benchCallbacks);
+  pResultChr->setValue((uint8_t*)&result, sizeof(result));
+
+  pService->start();
+  pServer->start();
+
+  NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  pAdvertising->addServiceUUID(pService->getUUID());
+  pAdvertising->setScanResponse(true);
+  pAdvertising->start();
+
+  Serial.println("Advertising");
+}
+
+void loop() {
+  if (testCmd == 0 || connHandle == BLE_HS_CONN_HANDLE_NONE) {
+    delay(10);
+    return;
+  }
+
+  if ((int32_t)(millis() - testEnd) >= 0) {
+    // Wait for the last indication before reporting.
+    if (!indPending) {
+      finishTest();
+    }
+    delay(1);
+    return;
+  }
+
+  trackMbufs();
+
+  switch (testCmd) {
+    case BENCH_CMD_NOTIFY: {
+      if (os_msys_num_free() < BENCH_MBUF_RESERVE) {
+        delay(1);
+        break;
+      }
+
+      size_t len = NimBLEDevice::getServer()->getPeerMTU(connHandle) - 3;
+      memcpy(payload, (const void*)&result.sentCount, sizeof(result.sentCount));
+      pTxChr->notify(payload, len);
+      result.sentCount++;
+      break;
+    }
+
+    case BENCH_CMD_INDICATE: {
+      if (indPending) {
+        break;
+      }
+
+      memcpy(payload, (const void*)&result.sentCount, sizeof(result.sentCount));
+      indPending = true;
+      indStart = micros();
+      pIndChr->indicate(payload, sizeof(result.sentCount));
+      result.sentCount++;
+      break;
+    }
+
+    default:
+      // Write test, the data is counted in onWrite.
+      delay(10);
+      break;
+  }
+}
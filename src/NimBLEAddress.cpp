@@ -27,24 +27,6 @@ static const char* LOG_TAG = "NimBLEAddress";
  * We will accomodate that fact in these methods.
 *************************************************/
 
-/**
- * @brief Create an address from the native NimBLE representation.
- * @param [in] address The native NimBLE address.
- */
-NimBLEAddress::NimBLEAddress(ble_addr_t address) {
-    memcpy(m_address, address.val, 6);
-    m_addrType = address.type;
-} // NimBLEAddress
-
-
-/**
- * @brief Create a blank address, i.e. 00:00:00:00:00:00, type 0.
- */
-NimBLEAddress::NimBLEAddress() {
-    NimBLEAddress("");
-} // NimBLEAddress
-
-
 /**
  * @brief Create an address from a hex string
  *
@@ -57,33 +39,12 @@ NimBLEAddress::NimBLEAddress() {
  * @param [in] stringAddress The hex string representation of the address.
  * @param [in] type The type of the address.
  */
-NimBLEAddress::NimBLEAddress(const std::string &stringAddress, uint8_t type) {
-    m_addrType = type;
-
-    if (stringAddress.length() == 0) {
-        memset(m_address, 0, 6);
-        return;
-    }
-
-    if (stringAddress.length() == 6) {
-        std::reverse_copy(stringAddress.data(), stringAddress.data() + 6, m_address);
-        return;
-    }
-
-    if (stringAddress.length() != 17) {
-        memset(m_address, 0, sizeof m_address); // "00:00:00:00:00:00" represents an invalid address
-        NIMBLE_LOGD(LOG_TAG, "Invalid address '%s'", stringAddress.c_str());
-        return;
-    }
-
-    int data[6];
-    if(sscanf(stringAddress.c_str(), "%x:%x:%x:%x:%x:%x", &data[5], &data[4], &data[3], &data[2], &data[1], &data[0]) != 6) {
-        memset(m_address, 0, sizeof m_address); // "00:00:00:00:00:00" represents an invalid address
+NimBLEAddress::NimBLEAddress(const std::string &stringAddress, uint8_t type)
+: NimBLEAddress(parse(stringAddress.data(), stringAddress.length()), type) {
+    if (stringAddress.length() != 0 && stringAddress.length() != 6 &&
+        !(stringAddress.length() == 17 && isValid(stringAddress.data()))) {
         NIMBLE_LOGD(LOG_TAG, "Invalid address '%s'", stringAddress.c_str());
     }
-    for(size_t index = 0; index < sizeof m_address; index++) {
-        m_address[index] = data[index];
-    }
 } // NimBLEAddress
 
 
@@ -92,21 +53,10 @@ NimBLEAddress::NimBLEAddress(const std::string &stringAddress, uint8_t type) {
  * @param [in] address A uint8_t[6] or esp_bd_addr_t containing the address.
  * @param [in] type The type of the address.
  */
-NimBLEAddress::NimBLEAddress(uint8_t address[6], uint8_t type) {
-    std::reverse_copy(address, address + sizeof m_address, m_address);
-    m_addrType = type;
-} // NimBLEAddress
-
-
-/**
- * @brief Constructor for address using a hex value.\n
- * Use the same byte order, so use 0xa4c1385def16 for "a4:c1:38:5d:ef:16"
- * @param [in] address uint64_t containing the address.
- * @param [in] type The type of the address.
- */
-NimBLEAddress::NimBLEAddress(const uint64_t &address, uint8_t type) {
-    memcpy(m_address, &address, sizeof m_address);
-    m_addrType = type;
+NimBLEAddress::NimBLEAddress(uint8_t address[6], uint8_t type)
+: NimBLEAddress(((uint64_t)address[0] << 40) | ((uint64_t)address[1] << 32) |
+                ((uint64_t)address[2] << 24) | ((uint64_t)address[3] << 16) |
+                ((uint64_t)address[4] << 8)  |  (uint64_t)address[5], type) {
 } // NimBLEAddress
 
 
@@ -125,7 +75,7 @@ bool NimBLEAddress::equals(const NimBLEAddress &otherAddress) const {
  * @return a pointer to the uint8_t[6] array of the address.
  */
 const uint8_t *NimBLEAddress::getNative() const {
-    return m_address;
+    return reinterpret_cast<const uint8_t*>(&m_value);
 } // getNative
 
 
@@ -134,10 +84,21 @@ const uint8_t *NimBLEAddress::getNative() const {
  * @return The address type.
  */
 uint8_t NimBLEAddress::getType() const {
-    return m_addrType;
+    return (uint8_t)(m_value >> TYPE_SHIFT);
 } // getType
 
 
+/**
+ * @brief Get a hash of the address, for use with hashed containers.
+ * @details The type is not included, matching the equality operator.
+ * @return A 32 bit hash of the address.
+ */
+uint32_t NimBLEAddress::hash() const {
+    uint64_t h = (m_value & ADDR_MASK) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32);
+} // hash
+
+
 /**
  * @brief Convert a BLE address to a string.
  *
@@ -155,11 +116,39 @@ std::string NimBLEAddress::toString() const {
 } // toString
 
 
+/**
+ * @brief Write the string representation of the address to a buffer without allocating.
+ * @param [in] buf The buffer to write to, it should be at least 18 bytes.
+ * @param [in] size The size of the buffer.
+ * @return A pointer to buf, which holds "xx:xx:xx:xx:xx:xx" or an empty string if it is too small.
+ */
+char* NimBLEAddress::toString(char* buf, size_t size) const {
+    static const char hex[] = "0123456789abcdef";
+
+    if(size < 18) {
+        if(size > 0) {
+            buf[0] = '\0';
+        }
+        return buf;
+    }
+
+    char* p = buf;
+    for(int shift = 40; shift >= 0; shift -= 8) {
+        uint8_t byte = (uint8_t)(m_value >> shift);
+        *p++ = hex[byte >> 4];
+        *p++ = hex[byte & 0x0f];
+        *p++ = ':';
+    }
+    buf[17] = '\0';
+    return buf;
+} // toString
+
+
 /**
  * @brief Convenience operator to check if this address is equal to another.
  */
 bool NimBLEAddress::operator ==(const NimBLEAddress & rhs) const {
-    return memcmp(rhs.m_address, m_address, sizeof m_address) == 0;
+    return ((m_value ^ rhs.m_value) & ADDR_MASK) == 0;
 } // operator ==
 
 
@@ -171,6 +160,15 @@ bool NimBLEAddress::operator !=(const NimBLEAddress & rhs) const {
 } // operator !=
 
 
+/**
+ * @brief Convenience operator to order addresses, allowing them to be used in sorted containers.
+ * @details Addresses are ordered by their 48 bit value, the type is ignored as in the equality operator.
+ */
+bool NimBLEAddress::operator <(const NimBLEAddress & rhs) const {
+    return (m_value & ADDR_MASK) < (rhs.m_value & ADDR_MASK);
+} // operator <
+
+
 /**
  * @brief Convienience operator to convert this address to string representation.
  * @details This allows passing NimBLEAddress to functions
@@ -178,10 +176,7 @@ bool NimBLEAddress::operator !=(const NimBLEAddress & rhs) const {
  */
 NimBLEAddress::operator std::string() const {
     char buffer[18];
-    snprintf(buffer, sizeof(buffer), "%02x:%02x:%02x:%02x:%02x:%02x",
-                                     m_address[5], m_address[4], m_address[3],
-                                     m_address[2], m_address[1], m_address[0]);
-    return std::string(buffer);
+    return std::string(toString(buffer, sizeof(buffer)));
 } // operator std::string
 
 
@@ -189,9 +184,7 @@ NimBLEAddress::operator std::string() const {
  * @brief Convenience operator to convert the native address representation to uint_64.
  */
 NimBLEAddress::operator uint64_t() const {
-    uint64_t address = 0;
-    memcpy(&address, m_address, sizeof m_address);
-    return address;
+    return m_value & ADDR_MASK;
 } // operator uint64_t
 
 #endif
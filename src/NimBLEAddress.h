@@ -31,6 +31,10 @@
 #include <string>
 #include <algorithm>
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "NimBLEAddress stores the native address in an integer and requires a little endian host"
+#endif
+
 /**
  * @brief A %BLE device address.
  *
@@ -38,24 +42,96 @@
  */
 class NimBLEAddress {
 public:
-    NimBLEAddress();
-    NimBLEAddress(ble_addr_t address);
     NimBLEAddress(uint8_t address[6], uint8_t type = BLE_ADDR_PUBLIC);
     NimBLEAddress(const std::string &stringAddress, uint8_t type = BLE_ADDR_PUBLIC);
-    NimBLEAddress(const uint64_t &address, uint8_t type = BLE_ADDR_PUBLIC);
+
+    /**
+     * @brief Create a blank address, i.e. 00:00:00:00:00:00, type 0.
+     */
+    constexpr NimBLEAddress()
+    : m_value(0) {}
+
+    /**
+     * @brief Create an address from a string, parsed at compile time when the string is a literal.
+     * @details Accepts the same formats as NimBLEAddress(const std::string&, uint8_t), a constant declared with\n
+     * <tt>static constexpr NimBLEAddress addr("a4:c1:38:5d:ef:16");</tt> is stored in flash.
+     * @param [in] stringAddress The hex string representation of the address.
+     * @param [in] type The type of the address.
+     */
+    constexpr NimBLEAddress(const char* stringAddress, uint8_t type = BLE_ADDR_PUBLIC)
+    : NimBLEAddress(parse(stringAddress, strLen(stringAddress)), type) {}
+
+    /**
+     * @brief Constructor for address using a hex value.\n
+     * Use the same byte order, so use 0xa4c1385def16 for "a4:c1:38:5d:ef:16"
+     * @param [in] address uint64_t containing the address.
+     * @param [in] type The type of the address.
+     */
+    constexpr NimBLEAddress(const uint64_t &address, uint8_t type = BLE_ADDR_PUBLIC)
+    : m_value((address & ADDR_MASK) | ((uint64_t)type << TYPE_SHIFT)) {}
+
+    /**
+     * @brief Create an address from the native NimBLE representation.
+     * @param [in] address The native NimBLE address.
+     */
+    constexpr NimBLEAddress(const ble_addr_t &address)
+    : NimBLEAddress((uint64_t)address.val[0]         | ((uint64_t)address.val[1] << 8)  |
+                    ((uint64_t)address.val[2] << 16) | ((uint64_t)address.val[3] << 24) |
+                    ((uint64_t)address.val[4] << 32) | ((uint64_t)address.val[5] << 40), address.type) {}
+
     bool            equals(const NimBLEAddress &otherAddress) const;
     const uint8_t*  getNative() const;
     std::string     toString() const;
+    char*           toString(char* buf, size_t size) const;
     uint8_t         getType() const;
+    uint32_t        hash() const;
 
     bool operator   ==(const NimBLEAddress & rhs) const;
     bool operator   !=(const NimBLEAddress & rhs) const;
+    bool operator   <(const NimBLEAddress & rhs) const;
     operator        std::string() const;
     operator        uint64_t() const;
 
 private:
-    uint8_t        m_address[6];
-    uint8_t        m_addrType;
+    static constexpr uint64_t ADDR_MASK  = 0xffffffffffffULL;
+    static constexpr int      TYPE_SHIFT = 48;
+
+    /*********************** Compile time parsing ************************/
+
+    static constexpr size_t   strLen(const char* s, size_t n = 0) { return s[n] ? strLen(s, n + 1) : n; }
+
+    static constexpr uint8_t  hexVal(char c) {
+        return (c >= '0' && c <= '9') ? c - '0' :
+               (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+               (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0xff;
+    }
+
+    /** @brief Check that the string is 6 hex pairs separated by colons, starting from pair idx. */
+    static constexpr bool     isValid(const char* s, size_t idx = 0) {
+        return idx == 6 || (hexVal(s[idx * 3]) != 0xff && hexVal(s[idx * 3 + 1]) != 0xff &&
+                            (idx == 5 || s[idx * 3 + 2] == ':') && isValid(s, idx + 1));
+    }
+
+    /** @brief Get the value of the address starting from pair idx, the first pair is the most significant. */
+    static constexpr uint64_t valueOf(const char* s, size_t idx = 0, uint64_t acc = 0) {
+        return idx == 6 ? acc : valueOf(s, idx + 1, (acc << 8) | (hexVal(s[idx * 3]) << 4) | hexVal(s[idx * 3 + 1]));
+    }
+
+    /** @brief Get the value of 6 bytes with the most significant first. */
+    static constexpr uint64_t bytesOf(const char* s, size_t idx = 0, uint64_t acc = 0) {
+        return idx == 6 ? acc : bytesOf(s, idx + 1, (acc << 8) | (uint8_t)s[idx]);
+    }
+
+    static constexpr uint64_t parse(const char* s, size_t len) {
+        return len == 6 ? bytesOf(s) : (len == 17 && isValid(s)) ? valueOf(s) : 0;
+    }
+
+    /**
+     * @brief The address in the low 48 bits, least significant byte first in memory, and the type in bits 48-55.
+     * @details Stored as a single integer so that comparing, ordering and hashing an address is a few
+     * instructions, the low 6 bytes are also the native NimBLE representation on little endian hosts.
+     */
+    uint64_t       m_value;
 };
 
 #endif /* CONFIG_BT_ENABLED */
@@ -20,25 +20,118 @@
 #include "NimBLEUtils.h"
 #include "NimBLELog.h"
 
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0
+#  if defined(CONFIG_NIMBLE_CPP_IDF)
+#    include "os/os_mempool.h"
+#  else
+#    include "nimble/porting/nimble/include/os/os_mempool.h"
+#  endif
+#endif
+
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+#  if defined(CONFIG_NIMBLE_CPP_IDF)
+#    include "host/ble_hs_pvcy.h"
+#  else
+#    include "nimble/nimble/host/include/host/ble_hs_pvcy.h"
+#  endif
+#endif
+
 #include <climits>
 
+// The weight of a new sample in the RSSI and report interval averages is 1 / (1 << shift).
+#define NIMBLE_CPP_RSSI_AVG_SHIFT 3
+
 static const char* LOG_TAG = "NimBLEAdvertisedDevice";
 
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0
+static os_membuf_t advDevicePoolMem[OS_MEMPOOL_SIZE(CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE,
+                                                    sizeof(NimBLEAdvertisedDevice))];
+static struct os_mempool advDevicePool;
+static bool advDevicePoolInit = false;
+#endif
+
 
 /**
  * @brief Constructor
  */
-NimBLEAdvertisedDevice::NimBLEAdvertisedDevice() :
-    m_payload(62,0)
-{
+NimBLEAdvertisedDevice::NimBLEAdvertisedDevice() {
     m_advType          = 0;
     m_rssi             = -9999;
     m_callbackSent     = false;
+    m_batchPending     = false;
+    m_reportedHash     = 0;
+    m_reportedRssi     = 0;
+    resetRSSIStats();
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    m_dataIncomplete   = false;
+#endif
     m_timestamp        = 0;
+    m_callbackTime     = 0;
     m_advLength        = 0;
+    m_payloadTruncated = false;
+    m_payloadLength    = 0;
+    m_advFieldCount    = 0;
+    m_advParsedLength  = 0;
+    memset(m_advTypeMask, 0, sizeof(m_advTypeMask));
 } // NimBLEAdvertisedDevice
 
 
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0 || CONFIG_NIMBLE_CPP_SCAN_PSRAM
+/**
+ * @brief Allocate a new advertised device from the device pool.
+ * @details Falls back to the heap if the pool is exhausted, to PSRAM when CONFIG_NIMBLE_CPP_SCAN_PSRAM is set.
+ */
+void* NimBLEAdvertisedDevice::operator new(size_t size) {
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0
+    if(!advDevicePoolInit) {
+        int rc = os_mempool_init(&advDevicePool, CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE,
+                                 sizeof(NimBLEAdvertisedDevice), advDevicePoolMem,
+                                 "nimble_cpp_adv_dev_pool");
+        assert(rc == 0);
+        advDevicePoolInit = true;
+    }
+
+    void* ptr = os_memblock_get(&advDevicePool);
+    if(ptr != nullptr) {
+        return ptr;
+    }
+    NIMBLE_LOGD(LOG_TAG, "Advertised device pool exhausted, using heap");
+#endif
+
+#if CONFIG_NIMBLE_CPP_SCAN_PSRAM
+    void* res = nimble_cpp_psram_malloc(size);
+    assert(res && "NimBLEAdvertisedDevice: alloc failed");
+    return res;
+#else
+    return ::operator new(size);
+#endif
+} // operator new
+
+
+/**
+ * @brief Return an advertised device to the device pool, or the heap if it was not allocated from the pool.
+ */
+void NimBLEAdvertisedDevice::operator delete(void* ptr) {
+    if(ptr == nullptr) {
+        return;
+    }
+
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0
+    if(advDevicePoolInit && os_memblock_from(&advDevicePool, ptr)) {
+        os_memblock_put(&advDevicePool, ptr);
+        return;
+    }
+#endif
+
+#if CONFIG_NIMBLE_CPP_SCAN_PSRAM
+    free(ptr);
+#else
+    ::operator delete(ptr);
+#endif
+} // operator delete
+#endif
+
+
 /**
  * @brief Get the address of the advertising device.
  * @return The address of the advertised device.
@@ -48,6 +141,28 @@ NimBLEAddress NimBLEAdvertisedDevice::getAddress() {
 } // getAddress
 
 
+/**
+ * @brief Get the identity address of the advertising device.
+ * @details When the device advertises with a resolvable private address, the address is resolved with the\n
+ * IRKs of the bonded peers. Results are cached by the host so calling this for every report is cheap.
+ * @return The identity address of the bonded peer that owns the address, or the advertised address\n
+ * if it is not an RPA or no bonded peer resolves it.
+ */
+NimBLEAddress NimBLEAdvertisedDevice::getIdentityAddress() {
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+    ble_addr_t addr;
+    ble_addr_t idAddr;
+
+    addr.type = m_address.getType();
+    memcpy(addr.val, m_address.getNative(), sizeof(addr.val));
+    if (ble_hs_pvcy_resolve_addr(&addr, &idAddr) == 0) {
+        return NimBLEAddress(idAddr);
+    }
+#endif
+    return m_address;
+} // getIdentityAddress
+
+
 /**
  * @brief Get the advertisement type.
  * @return The advertising type the device is reporting:
@@ -74,7 +189,7 @@ uint16_t NimBLEAdvertisedDevice::getAppearance() {
     size_t data_loc = 0;
 
     if(findAdvField(BLE_HS_ADV_TYPE_APPEARANCE, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
+        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length == BLE_HS_ADV_APPEARANCE_LEN + 1) {
             return *field->value | *(field->value + 1) << 8;
         }
@@ -92,7 +207,7 @@ uint16_t NimBLEAdvertisedDevice::getAdvInterval() {
     size_t data_loc = 0;
 
     if(findAdvField(BLE_HS_ADV_TYPE_ADV_ITVL, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
+        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length == BLE_HS_ADV_ADV_ITVL_LEN + 1) {
             return *field->value | *(field->value + 1) << 8;
         }
@@ -110,7 +225,7 @@ uint16_t NimBLEAdvertisedDevice::getMinInterval() {
     size_t data_loc = 0;
 
     if(findAdvField(BLE_HS_ADV_TYPE_SLAVE_ITVL_RANGE, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
+        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length == BLE_HS_ADV_SLAVE_ITVL_RANGE_LEN + 1) {
             return *field->value | *(field->value + 1) << 8;
         }
@@ -128,7 +243,7 @@ uint16_t NimBLEAdvertisedDevice::getMaxInterval() {
     size_t data_loc = 0;
 
     if(findAdvField(BLE_HS_ADV_TYPE_SLAVE_ITVL_RANGE, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
+        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length == BLE_HS_ADV_SLAVE_ITVL_RANGE_LEN + 1) {
             return *(field->value + 2) | *(field->value + 3) << 8;
         }
@@ -143,17 +258,21 @@ uint16_t NimBLEAdvertisedDevice::getMaxInterval() {
  * @return The manufacturer data of the advertised device.
  */
 std::string NimBLEAdvertisedDevice::getManufacturerData() {
-    size_t data_loc = 0;
+    size_t length = 0;
+    const uint8_t* pData = getManufacturerDataPtr(&length);
+    return pData != nullptr ? std::string((char*)pData, length) : "";
+} // getManufacturerData
 
-    if(findAdvField(BLE_HS_ADV_TYPE_MFG_DATA, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
-        if(field->length > 1) {
-            return std::string((char*)field->value, field->length - 1);
-        }
-    }
 
-    return "";
-} // getManufacturerData
+/**
+ * @brief Get a pointer to the manufacturer data in the payload, the data is not copied.
+ * @param [out] length A pointer to storage for the length of the data.
+ * @return A pointer to the manufacturer data or nullptr if not present.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getManufacturerDataPtr(size_t* length) {
+    return getPayloadField(BLE_HS_ADV_TYPE_MFG_DATA, length);
+} // getManufacturerDataPtr
 
 
 /**
@@ -161,17 +280,21 @@ std::string NimBLEAdvertisedDevice::getManufacturerData() {
  * @return The URI data.
  */
 std::string NimBLEAdvertisedDevice::getURI() {
-    size_t data_loc = 0;
+    size_t length = 0;
+    const uint8_t* pData = getURIPtr(&length);
+    return pData != nullptr ? std::string((char*)pData, length) : "";
+} // getURI
 
-    if(findAdvField(BLE_HS_ADV_TYPE_URI, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
-        if(field->length > 1) {
-            return std::string((char*)field->value, field->length - 1);
-        }
-    }
 
-    return "";
-} // getURI
+/**
+ * @brief Get a pointer to the URI in the payload, the data is not copied.
+ * @param [out] length A pointer to storage for the length of the URI.
+ * @return A pointer to the URI or nullptr if not present.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getURIPtr(size_t* length) {
+    return getPayloadField(BLE_HS_ADV_TYPE_URI, length);
+} // getURIPtr
 
 
 /**
@@ -179,19 +302,58 @@ std::string NimBLEAdvertisedDevice::getURI() {
  * @return The name of the advertised device.
  */
 std::string NimBLEAdvertisedDevice::getName() {
-    size_t data_loc = 0;
+    size_t length = 0;
+    const uint8_t* pData = getNamePtr(&length);
+    return pData != nullptr ? std::string((char*)pData, length) : "";
+} // getName
+
+
+/**
+ * @brief Get a pointer to the advertised name in the payload, the data is not copied.
+ * @param [out] length A pointer to storage for the length of the name.
+ * @return A pointer to the complete name, or the shortened name if the complete name is not present,
+ * nullptr if neither are present. The name is not null terminated.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getNamePtr(size_t* length) {
+    const uint8_t* pData = getPayloadField(BLE_HS_ADV_TYPE_COMP_NAME, length);
+    if(pData == nullptr) {
+        pData = getPayloadField(BLE_HS_ADV_TYPE_INCOMP_NAME, length);
+    }
+
+    return pData;
+} // getNamePtr
 
-    if(findAdvField(BLE_HS_ADV_TYPE_COMP_NAME, 0, &data_loc) > 0 ||
-       findAdvField(BLE_HS_ADV_TYPE_INCOMP_NAME, 0, &data_loc) > 0)
-    {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
-        if(field->length > 1) {
-            return std::string((char*)field->value, field->length - 1);
+
+/**
+ * @brief Get a pointer to the value of an AD structure in the payload, the data is not copied.
+ * @param [in] type The AD type of the structure.
+ * @param [out] length A pointer to storage for the length of the value.
+ * @param [in] index The index of the structure if the type is present more than once.
+ * @return A pointer to the value of the AD structure or nullptr if not found or the value is empty.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getPayloadField(uint8_t type, size_t* length, uint8_t index) {
+    *length = 0;
+
+    if (!(m_advTypeMask[type >> 5] & (1UL << (type & 0x1F)))) {
+        return nullptr;
+    }
+
+    for (uint16_t i = 0; i < m_advFieldCount; i++) {
+        ble_hs_adv_field *field = (ble_hs_adv_field*)&m_payload.data[m_payload.fields[i]];
+        if (field->type == type && index-- == 0) {
+            if (field->length < 2) {
+                return nullptr;
+            }
+
+            *length = field->length - 1;
+            return field->value;
         }
     }
 
-    return "";
-} // getName
+    return nullptr;
+} // getPayloadField
 
 
 /**
@@ -203,6 +365,63 @@ int NimBLEAdvertisedDevice::getRSSI() {
 } // getRSSI
 
 
+/**
+ * @brief Get the exponential moving average of the RSSI of the reports.
+ * @return The average RSSI, each new report has a weight of 1/8.
+ */
+int NimBLEAdvertisedDevice::getRSSIAverage() {
+    return m_rssiAvg >= 0 ? (m_rssiAvg + 8) / 16 : (m_rssiAvg - 8) / 16;
+} // getRSSIAverage
+
+
+/**
+ * @brief Get the lowest RSSI of the reports.
+ */
+int NimBLEAdvertisedDevice::getRSSIMin() {
+    return m_rssiMin;
+} // getRSSIMin
+
+
+/**
+ * @brief Get the highest RSSI of the reports.
+ */
+int NimBLEAdvertisedDevice::getRSSIMax() {
+    return m_rssiMax;
+} // getRSSIMax
+
+
+/**
+ * @brief Get the number of advertisement and scan response reports received from the device.
+ */
+uint32_t NimBLEAdvertisedDevice::getReportCount() {
+    return m_reportCount;
+} // getReportCount
+
+
+/**
+ * @brief Get the estimated time between the advertisements received from the device.
+ * @return The moving average of the time between advertisements in milliseconds, 0 until two were received.
+ * @details Scan responses are not included. Advertisements missed by the scanner make the estimate
+ * a multiple of the advertising interval.
+ */
+uint32_t NimBLEAdvertisedDevice::getReportInterval() {
+    return m_reportItvlAvg / 16;
+} // getReportInterval
+
+
+/**
+ * @brief Reset the RSSI statistics and report count, for instance to start a new measurement.
+ */
+void NimBLEAdvertisedDevice::resetRSSIStats() {
+    m_rssiAvg       = 0;
+    m_rssiMin       = 0;
+    m_rssiMax       = 0;
+    m_reportCount   = 0;
+    m_lastReport    = 0;
+    m_reportItvlAvg = 0;
+} // resetRSSIStats
+
+
 /**
  * @brief Get the scan object that created this advertised device.
  * @return The scan object.
@@ -245,7 +464,7 @@ NimBLEAddress NimBLEAdvertisedDevice::getTargetAddress(uint8_t index) {
     }
 
     if(count > 0 && data_loc != ULONG_MAX) {
-        field = (ble_hs_adv_field *)&m_payload[data_loc];
+        field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length < index *  BLE_HS_ADV_PUBLIC_TGT_ADDR_ENTRY_LEN) {
             index -= count - field->length / BLE_HS_ADV_PUBLIC_TGT_ADDR_ENTRY_LEN;
         }
@@ -264,19 +483,35 @@ NimBLEAddress NimBLEAdvertisedDevice::getTargetAddress(uint8_t index) {
  * @return The advertised service data or empty string if no data.
  */
 std::string NimBLEAdvertisedDevice::getServiceData(uint8_t index) {
+    size_t length = 0;
+    const uint8_t* pData = getServiceDataPtr(index, &length);
+    return pData != nullptr ? std::string((char*)pData, length) : "";
+} //getServiceData
+
+
+/**
+ * @brief Get a pointer to the service data in the payload, the data is not copied.
+ * @param [in] index The index of the service data requested.
+ * @param [out] length A pointer to storage for the length of the data.
+ * @return A pointer to the service data following the UUID or nullptr if not found.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getServiceDataPtr(uint8_t index, size_t* length) {
     ble_hs_adv_field *field = nullptr;
     uint8_t bytes;
     size_t data_loc = findServiceData(index, &bytes);
 
+    *length = 0;
     if(data_loc != ULONG_MAX) {
-        field = (ble_hs_adv_field *)&m_payload[data_loc];
+        field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length > bytes) {
-            return std::string((char*)(field->value + bytes), field->length - bytes - 1);
+            *length = field->length - bytes - 1;
+            return field->value + bytes;
         }
     }
 
-    return "";
-} //getServiceData
+    return nullptr;
+} // getServiceDataPtr
 
 
 /**
@@ -285,17 +520,33 @@ std::string NimBLEAdvertisedDevice::getServiceData(uint8_t index) {
  * @return The advertised service data or empty string if no data.
  */
 std::string NimBLEAdvertisedDevice::getServiceData(const NimBLEUUID &uuid) {
+    size_t length = 0;
+    const uint8_t* pData = getServiceDataPtr(uuid, &length);
+    return pData != nullptr ? std::string((char*)pData, length) : "";
+} //getServiceData
+
+
+/**
+ * @brief Get a pointer to the service data in the payload, the data is not copied.
+ * @param [in] uuid The uuid of the service data requested.
+ * @param [out] length A pointer to storage for the length of the data.
+ * @return A pointer to the service data following the UUID or nullptr if not found.
+ * @details The pointer is only valid until the payload is updated by the next advertisement.
+ */
+const uint8_t* NimBLEAdvertisedDevice::getServiceDataPtr(const NimBLEUUID &uuid, size_t* length) {
     ble_hs_adv_field *field = nullptr;
     uint8_t bytes;
     uint8_t index = 0;
     size_t  data_loc = findServiceData(index, &bytes);
-    size_t  plSize = m_payload.size() - 2;
+    size_t  plSize = m_payloadLength - 2;
     uint8_t uuidBytes = uuid.bitSize() / 8;
 
+    *length = 0;
     while(data_loc < plSize) {
-        field = (ble_hs_adv_field *)&m_payload[data_loc];
+        field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(bytes == uuidBytes && NimBLEUUID(field->value, bytes, false) == uuid) {
-           return std::string((char*)(field->value + bytes), field->length - bytes - 1);
+            *length = field->length - bytes - 1;
+            return field->value + bytes;
         }
 
         index++;
@@ -303,8 +554,8 @@ std::string NimBLEAdvertisedDevice::getServiceData(const NimBLEUUID &uuid) {
     }
 
     NIMBLE_LOGI(LOG_TAG, "No service data found");
-    return "";
-} //getServiceData
+    return nullptr;
+} // getServiceDataPtr
 
 
 /**
@@ -318,7 +569,7 @@ NimBLEUUID NimBLEAdvertisedDevice::getServiceDataUUID(uint8_t index) {
     size_t data_loc = findServiceData(index, &bytes);
 
     if(data_loc != ULONG_MAX) {
-        field = (ble_hs_adv_field *)&m_payload[data_loc];
+        field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length >= bytes) {
             return NimBLEUUID(field->value, bytes, false);
         }
@@ -413,7 +664,7 @@ NimBLEUUID NimBLEAdvertisedDevice::getServiceUUID(uint8_t index) {
     } while(type <= BLE_HS_ADV_TYPE_COMP_UUIDS128);
 
     if(uuidBytes > 0) {
-        field = (ble_hs_adv_field *)&m_payload[data_loc];
+        field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         // In the case of more than one field of service uuid's we need to adjust
         // the index to account for the uuids of the previous fields.
         if(field->length < index * uuidBytes) {
@@ -472,7 +723,7 @@ int8_t NimBLEAdvertisedDevice::getTXPower() {
     size_t data_loc = 0;
 
     if(findAdvField(BLE_HS_ADV_TYPE_TX_PWR_LVL, 0, &data_loc) > 0) {
-        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload[data_loc];
+        ble_hs_adv_field *field = (ble_hs_adv_field *)&m_payload.data[data_loc];
         if(field->length == BLE_HS_ADV_TX_PWR_LVL_LEN + 1) {
             return *(int8_t*)field->value;
         }
@@ -626,67 +877,97 @@ uint16_t NimBLEAdvertisedDevice::getPeriodicInterval() {
 #endif
 
 
+/**
+ * @brief Parse the AD structures of the payload into the field table.
+ * @param [in] start The offset in the payload to start parsing from.
+ * @details Parsing stops at the first AD structure that does not fit in the payload,
+ * the offset of that structure is saved so parsing can resume from there when a scan response is appended.
+ */
+void NimBLEAdvertisedDevice::parseAdvFields(size_t start) {
+    size_t data   = start;
+    size_t length = m_payloadLength - start;
+
+    while (length > 2 && m_advFieldCount < NIMBLE_CPP_ADV_MAX_FIELDS(m_payload.capacity)) {
+        ble_hs_adv_field *field = (ble_hs_adv_field*)&m_payload.data[data];
+
+        if (field->length >= length) {
+            break;
+        }
+
+        if (field->length > 0) {
+            m_payload.fields[m_advFieldCount++] = data;
+            m_advTypeMask[field->type >> 5] |= 1UL << (field->type & 0x1F);
+        }
+
+        length -= 1 + field->length;
+        data += 1 + field->length;
+    }
+
+    m_advParsedLength = data;
+} // parseAdvFields
+
+
+/**
+ * @brief Find an AD structure of the type in the payload.
+ * @param [in] type The AD type to find.
+ * @param [in] index The index of the value to find, 0 to count all the values of the type.
+ * @param [out] data_loc A pointer to storage for the payload offset of the AD structure containing the value.
+ * @return The number of values of the type found, up to the index if data_loc is not nullptr.
+ */
 uint8_t NimBLEAdvertisedDevice::findAdvField(uint8_t type, uint8_t index, size_t * data_loc) {
-    ble_hs_adv_field *field = nullptr;
-    size_t  length = m_payload.size();
-    size_t  data   = 0;
-    uint8_t count  = 0;
+    uint8_t count = 0;
 
-    if (length < 3) {
+    if (!(m_advTypeMask[type >> 5] & (1UL << (type & 0x1F)))) {
         return count;
     }
 
-    while (length > 2) {
-        field = (ble_hs_adv_field*)&m_payload[data];
+    for (uint16_t i = 0; i < m_advFieldCount; i++) {
+        ble_hs_adv_field *field = (ble_hs_adv_field*)&m_payload.data[m_payload.fields[i]];
 
-        if (field->length >= length) {
-            return count;
+        if (field->type != type) {
+            continue;
         }
 
-        if (field->type == type) {
-            switch (type) {
-                case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
-                case BLE_HS_ADV_TYPE_COMP_UUIDS16:
-                    count += field->length / 2;
-                    break;
-
-                case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
-                case BLE_HS_ADV_TYPE_COMP_UUIDS32:
-                    count += field->length / 4;
-                    break;
-
-                case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
-                case BLE_HS_ADV_TYPE_COMP_UUIDS128:
-                    count += field->length / 16;
-                    break;
-
-                case BLE_HS_ADV_TYPE_PUBLIC_TGT_ADDR:
-                case BLE_HS_ADV_TYPE_RANDOM_TGT_ADDR:
-                    count += field->length / 6;
-                    break;
-
-                default:
-                    count++;
-                    break;
-            }
+        switch (type) {
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+                count += field->length / 2;
+                break;
+
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+                count += field->length / 4;
+                break;
+
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS128:
+                count += field->length / 16;
+                break;
+
+            case BLE_HS_ADV_TYPE_PUBLIC_TGT_ADDR:
+            case BLE_HS_ADV_TYPE_RANDOM_TGT_ADDR:
+                count += field->length / 6;
+                break;
+
+            default:
+                count++;
+                break;
+        }
 
-            if (data_loc != nullptr) {
-                if (index == 0 || count >= index) {
-                    break;
-                }
+        if (data_loc != nullptr) {
+            if (index == 0 || count >= index) {
+                *data_loc = m_payload.fields[i];
+                return count;
             }
         }
-
-        length -= 1 + field->length;
-        data += 1 + field->length;
     }
 
-    if (data_loc != nullptr && field != nullptr) {
-        *data_loc = data;
+    if (data_loc != nullptr) {
+        *data_loc = m_advParsedLength;
     }
 
     return count;
-}
+} // findAdvField
 
 
 /**
@@ -716,8 +997,38 @@ void NimBLEAdvertisedDevice::setAdvType(uint8_t advType, bool isLegacyAdv) {
  * @brief Set the RSSI for this device.
  * @param [in] rssi The RSSI of the discovered device.
  */
-void NimBLEAdvertisedDevice::setRSSI(int rssi) {
+void NimBLEAdvertisedDevice::setRSSI(int rssi, bool isScanRsp) {
     m_rssi = rssi;
+
+    if(m_reportCount == 0) {
+        m_rssiAvg = rssi * 16;
+        m_rssiMin = rssi;
+        m_rssiMax = rssi;
+    } else {
+        m_rssiAvg += (rssi * 16 - m_rssiAvg) / (1 << NIMBLE_CPP_RSSI_AVG_SHIFT);
+        m_rssiMin = std::min<int>(m_rssiMin, rssi);
+        m_rssiMax = std::max<int>(m_rssiMax, rssi);
+    }
+
+    if(m_reportCount < UINT32_MAX) {
+        m_reportCount++;
+    }
+
+    if(isScanRsp) {
+        return;
+    }
+
+    uint32_t now = ble_npl_time_ticks_to_ms32(ble_npl_time_get());
+    if(m_lastReport != 0) {
+        int32_t itvl = (int32_t)((now - m_lastReport) * 16);
+        if(m_reportItvlAvg == 0) {
+            m_reportItvlAvg = itvl;
+        } else {
+            m_reportItvlAvg += (itvl - (int32_t)m_reportItvlAvg) / (1 << NIMBLE_CPP_RSSI_AVG_SHIFT);
+        }
+    }
+    // 0 marks no advertisement received yet.
+    m_lastReport = now != 0 ? now : 1;
 } // setRSSI
 
 
@@ -772,23 +1083,174 @@ std::string NimBLEAdvertisedDevice::toString() {
  * @return The advertisement payload.
  */
 uint8_t* NimBLEAdvertisedDevice::getPayload() {
-    return &m_payload[0];
+    return &m_payload.data[0];
 } // getPayload
 
 
 /**
- * @brief Stores the payload of the advertised device in a vector.
+ * @brief Construct an empty payload in the inline buffers.
+ */
+NimBLEAdvertisedDevice::PayloadBuffer::PayloadBuffer() {
+    data     = inlineData;
+    fields   = inlineFields;
+    capacity = NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN;
+} // PayloadBuffer
+
+
+/**
+ * @brief Copy a payload, a payload on the heap is copied to a new heap block.
+ */
+NimBLEAdvertisedDevice::PayloadBuffer::PayloadBuffer(const PayloadBuffer& other) {
+    copy(other);
+} // PayloadBuffer
+
+
+/**
+ * @brief Replace the payload with a copy of another one.
+ */
+NimBLEAdvertisedDevice::PayloadBuffer& NimBLEAdvertisedDevice::PayloadBuffer::operator=(const PayloadBuffer& other) {
+    if(this != &other) {
+        release();
+        copy(other);
+    }
+    return *this;
+} // operator=
+
+
+/**
+ * @brief Destructor, frees the heap block if the payload was moved there.
+ */
+NimBLEAdvertisedDevice::PayloadBuffer::~PayloadBuffer() {
+    release();
+} // ~PayloadBuffer
+
+
+/**
+ * @brief Copy the payload and field offsets of another buffer, this buffer must not hold a heap block.
+ * @param [in] other The buffer to copy.
+ */
+void NimBLEAdvertisedDevice::PayloadBuffer::copy(const PayloadBuffer& other) {
+    data     = inlineData;
+    fields   = inlineFields;
+    capacity = NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN;
+
+    if(other.data != other.inlineData) {
+        bool res = grow(other.capacity, 0, 0);
+        assert(res && "NimBLEAdvertisedDevice: alloc failed");
+        (void)res;
+    }
+
+    memcpy(data, other.data, other.capacity);
+    memcpy(fields, other.fields, NIMBLE_CPP_ADV_MAX_FIELDS(other.capacity) * sizeof(adv_field_off_t));
+} // copy
+
+
+/**
+ * @brief Free the heap block, if any, and return to the inline buffers.
+ */
+void NimBLEAdvertisedDevice::PayloadBuffer::release() {
+    if(data != inlineData) {
+        free(data);
+    }
+
+    data     = inlineData;
+    fields   = inlineFields;
+    capacity = NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN;
+} // release
+
+
+/**
+ * @brief Move the payload and its field offsets to a heap block that holds length bytes, up to the maximum.
+ * @param [in] length The payload length needed.
+ * @param [in] used The number of payload bytes to keep.
+ * @param [in] fieldCount The number of field offsets to keep.
+ * @return False if the buffer is already at the maximum or no memory is available, it is unchanged then.
+ */
+bool NimBLEAdvertisedDevice::PayloadBuffer::grow(size_t length, uint16_t used, uint16_t fieldCount) {
+    if(capacity >= NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN) {
+        return false;
+    }
+
+    // Chained extended advertisement data arrives in fragments, double the capacity to not grow for each one.
+    size_t cap = capacity * 2;
+    if(cap < length) {
+        cap = length;
+    }
+    if(cap > NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN) {
+        cap = NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN;
+    }
+
+    // The offsets follow the payload in the block, aligned for their type.
+    size_t fieldsOffset = (cap + sizeof(adv_field_off_t) - 1) & ~(sizeof(adv_field_off_t) - 1);
+    size_t size = fieldsOffset + NIMBLE_CPP_ADV_MAX_FIELDS(cap) * sizeof(adv_field_off_t);
+#if CONFIG_NIMBLE_CPP_SCAN_PSRAM
+    uint8_t* block = (uint8_t*)nimble_cpp_psram_malloc(size);
+#else
+    uint8_t* block = (uint8_t*)malloc(size);
+#endif
+    if(block == nullptr) {
+        return false;
+    }
+
+    adv_field_off_t* blockFields = (adv_field_off_t*)(block + fieldsOffset);
+    memcpy(block, data, used);
+    memcpy(blockFields, fields, fieldCount * sizeof(adv_field_off_t));
+
+    if(data != inlineData) {
+        free(data);
+    }
+
+    data     = block;
+    fields   = blockFields;
+    capacity = cap;
+    return true;
+} // grow
+
+
+/**
+ * @brief Stores the payload of the advertised device.
  * @param [in] payload The advertisement payload.
  * @param [in] length The length of the payload in bytes.
- * @param [in] append Indicates if the the data should be appended (scan response).
+ * @param [in] append Indicates if the the data should be appended (scan response or
+ * chained extended advertisement data).
+ * @details Payloads longer than the inline buffer are moved to the heap, the buffer is kept for the
+ * next advertisements of the device.
  */
 void NimBLEAdvertisedDevice::setPayload(const uint8_t *payload, uint8_t length, bool append) {
+    if(!append) {
+        m_payloadLength = 0;
+        m_payloadTruncated = false;
+        m_advFieldCount = 0;
+        m_advParsedLength = 0;
+        memset(m_advTypeMask, 0, sizeof(m_advTypeMask));
+    }
+
+    if(m_payloadLength + length > m_payload.capacity) {
+        m_payload.grow(m_payloadLength + length, m_payloadLength, m_advFieldCount);
+    }
+
+    if(m_payloadLength + length > m_payload.capacity) {
+        if(!m_payloadTruncated) {
+            NIMBLE_LOGW(LOG_TAG, "Advertisement payload truncated to %d bytes", m_payload.capacity);
+            m_payloadTruncated = true;
+        }
+        length = m_payload.capacity - m_payloadLength;
+    }
+
+    memcpy(&m_payload.data[m_payloadLength], payload, length);
+    m_payloadLength += length;
+
     if(!append) {
         m_advLength = length;
-        m_payload.assign(payload, payload + length);
-    } else {
-        m_payload.insert(m_payload.end(), payload, payload + length);
     }
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    else if(!m_isLegacyAdv) {
+        // Chained extended advertisement data is all advertisement data.
+        m_advLength = m_payloadLength;
+    }
+#endif
+
+    parseAdvFields(m_advParsedLength);
 }
 
 
@@ -796,11 +1258,20 @@ void NimBLEAdvertisedDevice::setPayload(const uint8_t *payload, uint8_t length,
  * @brief Get the length of the advertisement data in the payload.
  * @return The number of bytes in the payload that is from the advertisement.
  */
-uint8_t NimBLEAdvertisedDevice::getAdvLength() {
+uint16_t NimBLEAdvertisedDevice::getAdvLength() {
     return m_advLength;
 }
 
 
+/**
+ * @brief Check if the payload was cut short, when it was longer than the maximum or no memory was available.
+ * @return True if the payload of the last advertisement is incomplete.
+ */
+bool NimBLEAdvertisedDevice::isPayloadTruncated() {
+    return m_payloadTruncated;
+} // isPayloadTruncated
+
+
 /**
  * @brief Get the advertised device address type.
  * @return The device address type:
@@ -816,19 +1287,29 @@ uint8_t NimBLEAdvertisedDevice::getAddressType() {
 
 /**
  * @brief Get the timeStamp of when the device last advertised.
- * @return The timeStamp of when the device was last seen.
+ * @return The timeStamp of when the device was last seen, in seconds of the time of day clock.
+ * @details Converted from getTimestampUs() when called, the reports are not timestamped with time().
  */
 time_t NimBLEAdvertisedDevice::getTimestamp() {
-    return m_timestamp;
+    return time(nullptr) - (time_t)((NimBLEUtils::getTimeUs() - m_timestamp) / 1000000);
 } // getTimestamp
 
 
+/**
+ * @brief Get the monotonic timestamp of when the device last advertised.
+ * @return The time since boot in microseconds when the report was received, see NimBLEUtils::getTimeUs.
+ */
+uint64_t NimBLEAdvertisedDevice::getTimestampUs() {
+    return m_timestamp;
+} // getTimestampUs
+
+
 /**
  * @brief Get the length of the payload advertised by the device.
  * @return The size of the payload in bytes.
  */
 size_t NimBLEAdvertisedDevice::getPayloadLength() {
-    return m_payload.size();
+    return m_payloadLength;
 } // getPayloadLength
 
 
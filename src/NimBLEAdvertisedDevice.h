@@ -20,6 +20,7 @@
 #include "NimBLEAddress.h"
 #include "NimBLEScan.h"
 #include "NimBLEUUID.h"
+#include "NimBLEMemory.h"
 
 #if defined(CONFIG_NIMBLE_CPP_IDF)
 #include "host/ble_hs_adv.h"
@@ -29,8 +30,35 @@
 
 #include <map>
 #include <vector>
+#include <cstring>
 #include <time.h>
 
+#ifndef CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE
+#    define CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE 0
+#endif
+
+/* Legacy advertisements can have a 31 byte scan response appended to the 31 byte payload. */
+#if CONFIG_BT_NIMBLE_EXT_ADV && (CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN > 62)
+#    define NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN
+#else
+#    define NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN 62
+#endif
+
+/* Payloads up to this length are stored in the device, longer extended advertisements are moved to the heap. */
+#ifndef CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN
+#    define CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN 255
+#endif
+
+#if CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN < 62
+#    define NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN 62
+#elif CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN < NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN
+#    define NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN
+#else
+#    define NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN
+#endif
+
+/* Each AD structure is at least 2 bytes, so this is the most that can fit in the payload. */
+#define NIMBLE_CPP_ADV_MAX_FIELDS(len) ((len) / 2)
 
 class NimBLEScan;
 /**
@@ -43,14 +71,23 @@ class NimBLEAdvertisedDevice {
 public:
     NimBLEAdvertisedDevice();
 
+#if CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE > 0 || CONFIG_NIMBLE_CPP_SCAN_PSRAM
+    static void*    operator new(size_t size);
+    static void     operator delete(void* ptr);
+#endif
+
     NimBLEAddress   getAddress();
+    NimBLEAddress   getIdentityAddress();
     uint8_t         getAdvType();
     uint16_t        getAppearance();
     uint16_t        getAdvInterval();
     uint16_t        getMinInterval();
     uint16_t        getMaxInterval();
     std::string     getManufacturerData();
+    const uint8_t*  getManufacturerDataPtr(size_t* length);
     std::string     getURI();
+    const uint8_t*  getURIPtr(size_t* length);
+    const uint8_t*  getPayloadField(uint8_t type, size_t* length, uint8_t index = 0);
 
     /**
      * @brief A template to convert the service data to <type\>.
@@ -62,18 +99,26 @@ public:
      */
     template<typename T>
     T       getManufacturerData(bool skipSizeCheck = false) {
-        std::string data = getManufacturerData();
-        if(!skipSizeCheck && data.size() < sizeof(T)) return T();
-        const char *pData = data.data();
-        return *((T *)pData);
+        size_t length = 0;
+        const uint8_t *pData = getManufacturerDataPtr(&length);
+        return dataToType<T>(pData, length, skipSizeCheck);
     }
 
     std::string     getName();
+    const uint8_t*  getNamePtr(size_t* length);
     int             getRSSI();
+    int             getRSSIAverage();
+    int             getRSSIMin();
+    int             getRSSIMax();
+    uint32_t        getReportCount();
+    uint32_t        getReportInterval();
+    void            resetRSSIStats();
     NimBLEScan*     getScan();
     uint8_t         getServiceDataCount();
     std::string     getServiceData(uint8_t index = 0);
     std::string     getServiceData(const NimBLEUUID &uuid);
+    const uint8_t*  getServiceDataPtr(uint8_t index, size_t* length);
+    const uint8_t*  getServiceDataPtr(const NimBLEUUID &uuid, size_t* length);
 
     /**
      * @brief A template to convert the service data to <tt><type\></tt>.
@@ -86,10 +131,9 @@ public:
      */
     template<typename T>
     T       getServiceData(uint8_t index = 0, bool skipSizeCheck = false) {
-        std::string data = getServiceData(index);
-        if(!skipSizeCheck && data.size() < sizeof(T)) return T();
-        const char *pData = data.data();
-        return *((T *)pData);
+        size_t length = 0;
+        const uint8_t *pData = getServiceDataPtr(index, &length);
+        return dataToType<T>(pData, length, skipSizeCheck);
     }
 
     /**
@@ -103,10 +147,9 @@ public:
      */
     template<typename T>
     T       getServiceData(const NimBLEUUID &uuid, bool skipSizeCheck = false) {
-        std::string data = getServiceData(uuid);
-        if(!skipSizeCheck && data.size() < sizeof(T)) return T();
-        const char *pData = data.data();
-        return *((T *)pData);
+        size_t length = 0;
+        const uint8_t *pData = getServiceDataPtr(uuid, &length);
+        return dataToType<T>(pData, length, skipSizeCheck);
     }
 
     NimBLEUUID      getServiceDataUUID(uint8_t index = 0);
@@ -116,10 +159,12 @@ public:
     uint8_t         getTargetAddressCount();
     int8_t          getTXPower();
     uint8_t*        getPayload();
-    uint8_t         getAdvLength();
+    uint16_t        getAdvLength();
     size_t          getPayloadLength();
+    bool            isPayloadTruncated();
     uint8_t         getAddressType();
     time_t          getTimestamp();
+    uint64_t        getTimestampUs();
     bool            isAdvertisingService(const NimBLEUUID &uuid);
     bool            haveAppearance();
     bool            haveManufacturerData();
@@ -145,34 +190,90 @@ public:
 private:
     friend class NimBLEScan;
 
+#if NIMBLE_CPP_ADV_PAYLOAD_MAX_LEN > 255
+    typedef uint16_t adv_field_off_t;
+#else
+    typedef uint8_t adv_field_off_t;
+#endif
+
+    /**
+     * @brief Copy payload data to a <type\>, used by the template getters.
+     * @details If skipSizeCheck is true and the data is shorter than <tt>sizeof(<type\>)</tt>
+     * the remaining bytes are zero.
+     */
+    template<typename T>
+    static T dataToType(const uint8_t *pData, size_t length, bool skipSizeCheck) {
+        if(pData == nullptr || (!skipSizeCheck && length < sizeof(T))) return T();
+        T value = T();
+        memcpy((void*)&value, pData, std::min(length, sizeof(T)));
+        return value;
+    }
+
     void    setAddress(NimBLEAddress address);
     void    setAdvType(uint8_t advType, bool isLegacyAdv);
     void    setPayload(const uint8_t *payload, uint8_t length, bool append);
-    void    setRSSI(int rssi);
+    void    setRSSI(int rssi, bool isScanRsp = false);
 #if CONFIG_BT_NIMBLE_EXT_ADV
     void    setSetId(uint8_t sid)              { m_sid = sid; }
     void    setPrimaryPhy(uint8_t phy)         { m_primPhy = phy; }
     void    setSecondaryPhy(uint8_t phy)       { m_secPhy = phy; }
     void    setPeriodicInterval(uint16_t itvl) { m_periodicItvl = itvl; }
 #endif
+    void    parseAdvFields(size_t start);
     uint8_t findAdvField(uint8_t type, uint8_t index = 0, size_t * data_loc = nullptr);
     size_t  findServiceData(uint8_t index, uint8_t* bytes);
 
     NimBLEAddress   m_address = NimBLEAddress("");
     uint8_t         m_advType;
     int             m_rssi;
-    time_t          m_timestamp;
+    uint64_t        m_timestamp;
+    uint64_t        m_callbackTime;
     bool            m_callbackSent;
-    uint8_t         m_advLength;
+    bool            m_batchPending;
+    bool            m_payloadTruncated;
+    uint16_t        m_advLength;
+    // RSSI statistics, the averages are kept in 1/16 units.
+    int16_t         m_rssiAvg;
+    int8_t          m_rssiMin;
+    int8_t          m_rssiMax;
+    uint32_t        m_reportCount;
+    uint32_t        m_lastReport;
+    uint32_t        m_reportItvlAvg;
+    // The content hash and RSSI of the last report, see NimBLEScan::setReportOnChange.
+    uint32_t        m_reportedHash;
+    int             m_reportedRssi;
 #if CONFIG_BT_NIMBLE_EXT_ADV
     bool            m_isLegacyAdv;
+    bool            m_dataIncomplete;
     uint8_t         m_sid;
     uint8_t         m_primPhy;
     uint8_t         m_secPhy;
     uint16_t        m_periodicItvl;
 #endif
 
-    std::vector<uint8_t>    m_payload;
+    /* The payload and the offsets of its AD structures, built when the payload is set. They are kept in the
+     * inline buffers, or in one heap block when the payload does not fit, which is copied with the device. */
+    struct PayloadBuffer {
+        uint8_t*        data;
+        adv_field_off_t* fields;
+        uint16_t        capacity;
+        uint8_t         inlineData[NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN];
+        adv_field_off_t inlineFields[NIMBLE_CPP_ADV_MAX_FIELDS(NIMBLE_CPP_ADV_PAYLOAD_INLINE_LEN)];
+
+        PayloadBuffer();
+        PayloadBuffer(const PayloadBuffer& other);
+        PayloadBuffer& operator=(const PayloadBuffer& other);
+        ~PayloadBuffer();
+        bool grow(size_t length, uint16_t used, uint16_t fieldCount);
+        void copy(const PayloadBuffer& other);
+        void release();
+    };
+
+    PayloadBuffer   m_payload;
+    uint16_t        m_payloadLength;
+    uint16_t        m_advFieldCount;
+    uint16_t        m_advParsedLength;
+    uint32_t        m_advTypeMask[8];
 };
 
 /**
@@ -191,7 +292,23 @@ public:
      * As we are scanning, we will find new devices.  When found, this call back is invoked with a reference to the
      * device that was found.  During any individual scan, a device will only be detected one time.
      */
-    virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) = 0;
+    virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) {};
+
+    /**
+     * @brief Called with a batch of scan results when batched delivery is enabled.
+     * @param [in] advertisedDevices An array of pointers to the devices found.
+     * @param [in] count The number of devices in the array.
+     * @details Enabled with NimBLEScan::setBatchSize, onResult is not called when batching is enabled.
+     * The array is only valid for the duration of the callback.
+     */
+    virtual void onResults(NimBLEAdvertisedDevice** advertisedDevices, size_t count) {};
+
+    /**
+     * @brief Called before a device is removed from the scan results by aging or eviction.
+     * @param [in] advertisedDevice A pointer to the device being removed, it is deleted after this returns.
+     * @details See NimBLEScan::setMaxResultAge and NimBLEScan::setEvictOldest.
+     */
+    virtual void onEvicted(NimBLEAdvertisedDevice* advertisedDevice) {};
 };
 
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_OBSERVER */
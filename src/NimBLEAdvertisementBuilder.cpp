@@ -0,0 +1,253 @@
+/*
+ * NimBLEAdvertisementBuilder.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+
+#include "NimBLEAdvertisementBuilder.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#include <string.h>
+
+static const char* LOG_TAG = "NimBLEAdvertisementBuilder";
+
+
+/**
+ * @brief Construct a builder that writes to a caller owned buffer.
+ * @param [in] buf The buffer to write the payload to.
+ * @param [in] capacity The size of the buffer.
+ */
+NimBLEAdvertisementBuilder::NimBLEAdvertisementBuilder(uint8_t* buf, size_t capacity)
+: m_buf(buf), m_capacity(capacity), m_length(0) {
+} // NimBLEAdvertisementBuilder
+
+
+/**
+ * @brief Add an AD structure to the payload.
+ * @param [in] type The AD type of the field.
+ * @param [in] data The value of the field.
+ * @param [in] length The length of the value.
+ * @return True if the field was added, false if it does not fit.
+ */
+bool NimBLEAdvertisementBuilder::addField(uint8_t type, const uint8_t* data, size_t length) {
+    return addField(type, nullptr, 0, data, length);
+} // addField
+
+
+/**
+ * @brief Add an AD structure with a value in two parts to the payload.
+ * @param [in] type The AD type of the field.
+ * @param [in] prefix The first part of the value, e.g. a UUID or company ID.
+ * @param [in] prefixLen The length of the prefix.
+ * @param [in] data The rest of the value.
+ * @param [in] length The length of the rest of the value.
+ * @return True if the field was added, false if it does not fit.
+ */
+bool NimBLEAdvertisementBuilder::addField(uint8_t type, const uint8_t* prefix, size_t prefixLen,
+                                          const uint8_t* data, size_t length) {
+    size_t valueLen = prefixLen + length;
+    if(valueLen > 254 || valueLen + 2 > m_capacity - m_length) {
+        NIMBLE_LOGE(LOG_TAG, "Field type 0x%02x does not fit, %u bytes left",
+                    type, (unsigned)(m_capacity - m_length));
+        return false;
+    }
+
+    uint8_t* p = m_buf + m_length;
+    *p++ = valueLen + 1;
+    *p++ = type;
+    if(prefixLen > 0) {
+        memcpy(p, prefix, prefixLen);
+        p += prefixLen;
+    }
+    if(length > 0) {
+        memcpy(p, data, length);
+    }
+
+    m_length += valueLen + 2;
+    return true;
+} // addField
+
+
+/**
+ * @brief Add the advertisement flags.
+ * @param [in] flag The flags, BLE_HS_ADV_F_BREDR_UNSUP is always added.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setFlags(uint8_t flag) {
+    uint8_t value = flag | BLE_HS_ADV_F_BREDR_UNSUP;
+    return addField(BLE_HS_ADV_TYPE_FLAGS, &value, 1);
+} // setFlags
+
+
+/**
+ * @brief Add the appearance of the device.
+ * @param [in] appearance The appearance code.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setAppearance(uint16_t appearance) {
+    uint8_t value[2] = {(uint8_t)appearance, (uint8_t)(appearance >> 8)};
+    return addField(BLE_HS_ADV_TYPE_APPEARANCE, value, 2);
+} // setAppearance
+
+
+/**
+ * @brief Add the name of the device.
+ * @param [in] name The name, it does not need to be null terminated.
+ * @param [in] length The length of the name.
+ * @param [in] complete True for the complete name, false for a shortened name.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setName(const char* name, size_t length, bool complete) {
+    return addField(complete ? BLE_HS_ADV_TYPE_COMP_NAME : BLE_HS_ADV_TYPE_INCOMP_NAME,
+                    (const uint8_t*)name, length);
+} // setName
+
+
+/**
+ * @brief Add the name of the device.
+ * @param [in] name The null terminated name.
+ * @param [in] complete True for the complete name, false for a shortened name.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setName(const char* name, bool complete) {
+    return setName(name, strlen(name), complete);
+} // setName
+
+
+/**
+ * @brief Add manufacturer specific data.
+ * @param [in] data The data, starting with the company ID.
+ * @param [in] length The length of the data.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setManufacturerData(const uint8_t* data, size_t length) {
+    return addField(BLE_HS_ADV_TYPE_MFG_DATA, data, length);
+} // setManufacturerData
+
+
+/**
+ * @brief Add data for a service.
+ * @param [in] uuid The UUID of the service.
+ * @param [in] data The service data.
+ * @param [in] length The length of the data.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setServiceData(const NimBLEUUID &uuid, const uint8_t* data, size_t length) {
+    const ble_uuid_any_t* native = uuid.getNative();
+    switch (uuid.bitSize()) {
+        case 16:
+            return addField(BLE_HS_ADV_TYPE_SVC_DATA_UUID16,
+                            (const uint8_t*)&native->u16.value, 2, data, length);
+        case 32:
+            return addField(BLE_HS_ADV_TYPE_SVC_DATA_UUID32,
+                            (const uint8_t*)&native->u32.value, 4, data, length);
+        case 128:
+            return addField(BLE_HS_ADV_TYPE_SVC_DATA_UUID128,
+                            native->u128.value, 16, data, length);
+        default:
+            return false;
+    }
+} // setServiceData
+
+
+/**
+ * @brief Add a list of services.
+ * @param [in] complete True if the list is complete, false if partial.
+ * @param [in] uuids The services, all must have the same size.
+ * @param [in] count The number of services.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setServices(bool complete, const NimBLEUUID* uuids, size_t count) {
+    if(count == 0) {
+        return false;
+    }
+
+    uint8_t bitSize = uuids[0].bitSize();
+    uint8_t type;
+    switch (bitSize) {
+        case 16:
+            type = complete ? BLE_HS_ADV_TYPE_COMP_UUIDS16 : BLE_HS_ADV_TYPE_INCOMP_UUIDS16;
+            break;
+        case 32:
+            type = complete ? BLE_HS_ADV_TYPE_COMP_UUIDS32 : BLE_HS_ADV_TYPE_INCOMP_UUIDS32;
+            break;
+        case 128:
+            type = complete ? BLE_HS_ADV_TYPE_COMP_UUIDS128 : BLE_HS_ADV_TYPE_INCOMP_UUIDS128;
+            break;
+        default:
+            return false;
+    }
+
+    size_t uuidLen = bitSize / 8;
+    size_t valueLen = uuidLen * count;
+    if(valueLen > 254 || valueLen + 2 > m_capacity - m_length) {
+        NIMBLE_LOGE(LOG_TAG, "Service list does not fit, %u bytes left", (unsigned)(m_capacity - m_length));
+        return false;
+    }
+
+    uint8_t* p = m_buf + m_length;
+    *p++ = valueLen + 1;
+    *p++ = type;
+    for(size_t i = 0; i < count; i++) {
+        if(uuids[i].bitSize() != bitSize) {
+            NIMBLE_LOGE(LOG_TAG, "Service UUID's must be the same size");
+            return false;
+        }
+
+        const ble_uuid_any_t* native = uuids[i].getNative();
+        switch (bitSize) {
+            case 16:
+                memcpy(p, &native->u16.value, 2);
+                break;
+            case 32:
+                memcpy(p, &native->u32.value, 4);
+                break;
+            default:
+                memcpy(p, native->u128.value, 16);
+                break;
+        }
+        p += uuidLen;
+    }
+
+    m_length += valueLen + 2;
+    return true;
+} // setServices
+
+
+/**
+ * @brief Add the transmit power level of the device.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::addTxPower() {
+    uint8_t value = NimBLEDevice::getPower();
+    return addField(BLE_HS_ADV_TYPE_TX_PWR_LVL, &value, BLE_HS_ADV_TX_PWR_LVL_LEN);
+} // addTxPower
+
+
+/**
+ * @brief Add the preferred connection interval range.
+ * @param [in] min The minimum interval desired.
+ * @param [in] max The maximum interval desired.
+ * @return True if the field was added.
+ */
+bool NimBLEAdvertisementBuilder::setPreferredParams(uint16_t min, uint16_t max) {
+    uint8_t value[BLE_HS_ADV_SLAVE_ITVL_RANGE_LEN] = {(uint8_t)min, (uint8_t)(min >> 8),
+                                                      (uint8_t)max, (uint8_t)(max >> 8)};
+    return addField(BLE_HS_ADV_TYPE_SLAVE_ITVL_RANGE, value, sizeof(value));
+} // setPreferredParams
+
+
+/**
+ * @brief Remove all fields from the payload.
+ */
+void NimBLEAdvertisementBuilder::clear() {
+    m_length = 0;
+} // clear
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_BROADCASTER */
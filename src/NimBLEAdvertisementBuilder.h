@@ -0,0 +1,127 @@
+/*
+ * NimBLEAdvertisementBuilder.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEADVERTISEMENTBUILDER_H_
+#define NIMBLEADVERTISEMENTBUILDER_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include "NimBLEUUID.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Builds advertisement payloads in place, without heap allocations.
+ * @details Each AD structure is written directly to the buffer given to the constructor.
+ * A field that does not fit is not written and the call returns false, leaving the
+ * payload as it was. The result can be used with NimBLEAdvertising::setAdvertisementData,
+ * NimBLEAdvertising::setScanResponseData or NimBLEExtAdvertisement::setData.
+ * Use NimBLEAdvertisementBuffer for a builder with its own storage.
+ */
+class NimBLEAdvertisementBuilder {
+public:
+    NimBLEAdvertisementBuilder(uint8_t* buf, size_t capacity);
+
+    bool           addField(uint8_t type, const uint8_t* data, size_t length);
+    bool           addField(uint8_t type, const uint8_t* prefix, size_t prefixLen,
+                            const uint8_t* data, size_t length);
+    bool           setFlags(uint8_t flag);
+    bool           setAppearance(uint16_t appearance);
+    bool           setName(const char* name, size_t length, bool complete = true);
+    bool           setName(const char* name, bool complete = true);
+    bool           setManufacturerData(const uint8_t* data, size_t length);
+    bool           setServiceData(const NimBLEUUID &uuid, const uint8_t* data, size_t length);
+    bool           setServices(bool complete, const NimBLEUUID* uuids, size_t count);
+    bool           addTxPower();
+    bool           setPreferredParams(uint16_t min, uint16_t max);
+    void           clear();
+
+    /**
+     * @brief Get a pointer to the payload.
+     */
+    const uint8_t* getData() const { return m_buf; }
+
+    /**
+     * @brief Get the length of the payload.
+     */
+    size_t         getLength() const { return m_length; }
+
+    /**
+     * @brief Get the number of bytes that can still be added.
+     */
+    size_t         getRemaining() const { return m_capacity - m_length; }
+
+protected:
+    uint8_t*       m_buf;
+    size_t         m_capacity;
+    size_t         m_length;
+}; // NimBLEAdvertisementBuilder
+
+
+/**
+ * @brief An advertisement builder with its own fixed size storage, suitable for the stack.
+ * @tparam CAPACITY The size of the storage, BLE_HS_ADV_MAX_SZ for legacy advertising or up to
+ * CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN for extended advertising.
+ * @details Fields with a constant size can be added with the array overloads of addField,
+ * these fail to compile if the field can never fit in the storage.
+ */
+template<size_t CAPACITY = BLE_HS_ADV_MAX_SZ>
+class NimBLEAdvertisementBuffer : public NimBLEAdvertisementBuilder {
+    static_assert(CAPACITY > 2, "Advertisement buffer is too small for any field");
+
+public:
+    NimBLEAdvertisementBuffer() : NimBLEAdvertisementBuilder(m_storage, CAPACITY) {}
+
+    using NimBLEAdvertisementBuilder::addField;
+
+    /**
+     * @brief Add a field with a constant size.
+     * @param [in] type The AD type of the field.
+     * @param [in] data The value of the field.
+     * @return True if the field was added.
+     */
+    template<size_t N>
+    bool addField(uint8_t type, const uint8_t (&data)[N]) {
+        static_assert(N + 2 <= CAPACITY, "Field does not fit in the advertisement buffer");
+        static_assert(N < 255, "Field is too long for an AD structure");
+        return addField(type, data, N);
+    }
+
+    /**
+     * @brief Add a field with a constant size prefix and constant size data.
+     * @param [in] type The AD type of the field.
+     * @param [in] prefix The first part of the value, e.g. a company ID.
+     * @param [in] data The rest of the value.
+     * @return True if the field was added.
+     */
+    template<size_t P, size_t N>
+    bool addField(uint8_t type, const uint8_t (&prefix)[P], const uint8_t (&data)[N]) {
+        static_assert(P + N + 2 <= CAPACITY, "Field does not fit in the advertisement buffer");
+        static_assert(P + N < 255, "Field is too long for an AD structure");
+        return addField(type, prefix, P, data, N);
+    }
+
+private:
+    uint8_t m_storage[CAPACITY];
+}; // NimBLEAdvertisementBuffer
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_BROADCASTER */
+#endif /* NIMBLEADVERTISEMENTBUILDER_H_ */
@@ -69,6 +69,7 @@ void NimBLEAdvertising::reset() {
     m_customScanResponseData         = false;
     m_scanResp                       = true;
     m_advDataSet                     = false;
+    m_advPayloadLen                  = 0;
     // Set this to non-zero to prevent auto start if host reset before started by app.
     m_duration                       = BLE_HS_FOREVER;
     m_advCompCB                      = nullptr;
@@ -208,6 +209,136 @@ void NimBLEAdvertising::setServiceData(const NimBLEUUID &uuid, const std::string
 } // setServiceData
 
 
+/**
+ * @brief Replace one field of the advertisement payload and send it to the controller.
+ * @param [in] type The AD type of the field.
+ * @param [in] prefix The bytes the field must start with, e.g. the service UUID.
+ * @param [in] prefixLen The length of the prefix.
+ * @param [in] data The new value of the field after the prefix.
+ * @param [in] length The length of the new value.
+ * @return True if the field was found and updated.
+ */
+bool NimBLEAdvertising::patchField(uint8_t type, const uint8_t *prefix, uint8_t prefixLen,
+                                   const uint8_t *data, size_t length)
+{
+    uint8_t *p = m_advPayload;
+    uint8_t i = 0;
+
+    while(i + 1 < m_advPayloadLen) {
+        uint8_t fieldLen = p[i];
+        if(fieldLen == 0 || i + 1 + fieldLen > m_advPayloadLen) {
+            break;
+        }
+
+        if(p[i + 1] == type && fieldLen - 1 >= prefixLen &&
+           (prefixLen == 0 || memcmp(&p[i + 2], prefix, prefixLen) == 0)) {
+            size_t newFieldLen = 1 + prefixLen + length;
+            size_t newLen = m_advPayloadLen - fieldLen + newFieldLen;
+            if(newLen > BLE_HS_ADV_MAX_SZ) {
+                NIMBLE_LOGE(LOG_TAG, "Advertisement data too long");
+                return false;
+            }
+
+            // Move the following fields if the length changed.
+            if(newFieldLen != fieldLen) {
+                memmove(&p[i + 1 + newFieldLen], &p[i + 1 + fieldLen], m_advPayloadLen - (i + 1 + fieldLen));
+                p[i] = newFieldLen;
+                m_advPayloadLen = newLen;
+            }
+
+            memcpy(&p[i + 2 + prefixLen], data, length);
+
+            int rc = ble_gap_adv_set_data(m_advPayload, m_advPayloadLen);
+            if(rc != 0) {
+                NIMBLE_LOGE(LOG_TAG, "ble_gap_adv_set_data: %d %s",
+                            rc, NimBLEUtils::returnCodeToString(rc));
+                return false;
+            }
+
+            return true;
+        }
+
+        i += 1 + fieldLen;
+    }
+
+    NIMBLE_LOGE(LOG_TAG, "Field 0x%02x not in the advertisement", type);
+    return false;
+} // patchField
+
+
+/**
+ * @brief Update the service data advertised for the UUID without restarting advertising.
+ * @param [in] uuid The UUID the service data belongs to.
+ * @param [in] data The data to advertise.
+ * @return True if successful.
+ * @details Only the service data field of the payload already sent to the controller is changed,
+ * the advertisement must have been started with data for the UUID set by setServiceData
+ * or included in the data set with setAdvertisementData. Before the first start this is the same
+ * as setServiceData.
+ */
+bool NimBLEAdvertising::updateServiceData(const NimBLEUUID &uuid, const std::string &data) {
+    if(!m_customAdvData) {
+        bool dataSet = m_advDataSet;
+        setServiceData(uuid, data);
+        m_advDataSet = dataSet;
+        if(!dataSet) {
+            return true;
+        }
+    }
+
+    const ble_uuid_any_t *native = uuid.getNative();
+    bool updated = false;
+    switch(uuid.bitSize()) {
+        case 16:
+            updated = patchField(BLE_HS_ADV_TYPE_SVC_DATA_UUID16, (uint8_t*)&native->u16.value, 2,
+                                 (uint8_t*)data.data(), data.length());
+            break;
+        case 32:
+            updated = patchField(BLE_HS_ADV_TYPE_SVC_DATA_UUID32, (uint8_t*)&native->u32.value, 4,
+                                 (uint8_t*)data.data(), data.length());
+            break;
+        case 128:
+            updated = patchField(BLE_HS_ADV_TYPE_SVC_DATA_UUID128, native->u128.value, 16,
+                                 (uint8_t*)data.data(), data.length());
+            break;
+        default:
+            break;
+    }
+
+    // Rebuild the payload from the new data on the next start.
+    if(!updated && !m_customAdvData) {
+        m_advDataSet = false;
+    }
+
+    return updated;
+} // updateServiceData
+
+
+/**
+ * @brief Update the advertised manufacturer data without restarting advertising.
+ * @param [in] data The manufacturer data to advertise, including the company ID.
+ * @return True if successful.
+ * @details The advertisement must have been started with manufacturer data, see updateServiceData.
+ */
+bool NimBLEAdvertising::updateManufacturerData(const std::string &data) {
+    if(!m_customAdvData) {
+        bool dataSet = m_advDataSet;
+        setManufacturerData(data);
+        m_advDataSet = dataSet;
+        if(!dataSet) {
+            return true;
+        }
+    }
+
+    bool updated = patchField(BLE_HS_ADV_TYPE_MFG_DATA, nullptr, 0, (uint8_t*)data.data(), data.length());
+    if(!updated && !m_customAdvData) {
+        m_advDataSet = false;
+    }
+
+    return updated;
+} // updateManufacturerData
+
+
 /**
  * @brief Set the type of advertisment to use.
  * @param [in] adv_type:
@@ -350,13 +481,37 @@ void NimBLEAdvertising::setScanFilter(bool scanRequestWhitelistOnly, bool connec
  */
 
 void NimBLEAdvertising::setAdvertisementData(NimBLEAdvertisementData& advertisementData) {
+    const std::string &payload = advertisementData.m_payload;
+    setAdvertisementData((const uint8_t*)payload.data(), payload.length());
+} // setAdvertisementData
+
+
+/**
+ * @brief Set the advertisement data built with a NimBLEAdvertisementBuilder.
+ * @param [in] advertisementData The data to be advertised.
+ * @details The payload is copied, the builder can be reused or go out of scope afterwards.
+ */
+void NimBLEAdvertising::setAdvertisementData(const NimBLEAdvertisementBuilder& advertisementData) {
+    setAdvertisementData(advertisementData.getData(), advertisementData.getLength());
+} // setAdvertisementData
+
+
+/**
+ * @brief Set the raw advertisement data.
+ * @param [in] data The payload to advertise.
+ * @param [in] length The length of the payload.
+ */
+void NimBLEAdvertising::setAdvertisementData(const uint8_t *data, size_t length) {
     NIMBLE_LOGD(LOG_TAG, ">> setAdvertisementData");
-    int rc = ble_gap_adv_set_data(
-        (uint8_t*)advertisementData.getPayload().data(),
-        advertisementData.getPayload().length());
+    int rc = ble_gap_adv_set_data(data, length);
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "ble_gap_adv_set_data: %d %s",
                     rc, NimBLEUtils::returnCodeToString(rc));
+        m_advPayloadLen = 0;
+    } else {
+        // Keep a copy so single fields can be updated without rebuilding the payload.
+        memcpy(m_advPayload, data, length);
+        m_advPayloadLen = length;
     }
     m_customAdvData = true;   // Set the flag that indicates we are using custom advertising data.
     NIMBLE_LOGD(LOG_TAG, "<< setAdvertisementData");
@@ -370,10 +525,29 @@ void NimBLEAdvertising::setAdvertisementData(NimBLEAdvertisementData& advertisem
  * When using custom scan response data you must also use custom advertisement data.
  */
 void NimBLEAdvertising::setScanResponseData(NimBLEAdvertisementData& advertisementData) {
+    const std::string &payload = advertisementData.m_payload;
+    setScanResponseData((const uint8_t*)payload.data(), payload.length());
+} // setScanResponseData
+
+
+/**
+ * @brief Set the scan response data built with a NimBLEAdvertisementBuilder.
+ * @param [in] advertisementData The data to be published in a scan response.
+ * @details Calling this without also using setAdvertisementData will have no effect.
+ */
+void NimBLEAdvertising::setScanResponseData(const NimBLEAdvertisementBuilder& advertisementData) {
+    setScanResponseData(advertisementData.getData(), advertisementData.getLength());
+} // setScanResponseData
+
+
+/**
+ * @brief Set the raw scan response data.
+ * @param [in] data The scan response payload.
+ * @param [in] length The length of the payload.
+ */
+void NimBLEAdvertising::setScanResponseData(const uint8_t *data, size_t length) {
     NIMBLE_LOGD(LOG_TAG, ">> setScanResponseData");
-    int rc = ble_gap_adv_rsp_set_data(
-        (uint8_t*)advertisementData.getPayload().data(),
-        advertisementData.getPayload().length());
+    int rc = ble_gap_adv_rsp_set_data(data, length);
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "ble_gap_adv_rsp_set_data: %d %s",
                     rc,  NimBLEUtils::returnCodeToString(rc));
@@ -578,7 +752,11 @@ bool NimBLEAdvertising::start(uint32_t duration, void (*advCompleteCB)(NimBLEAdv
         }
 
         if(rc == 0) {
-            rc = ble_gap_adv_set_fields(&m_advData);
+            // Encode into the payload buffer so updates can patch it while advertising.
+            rc = ble_hs_adv_set_fields(&m_advData, m_advPayload, &m_advPayloadLen, sizeof(m_advPayload));
+            if(rc == 0) {
+                rc = ble_gap_adv_set_data(m_advPayload, m_advPayloadLen);
+            }
             switch(rc) {
                 case 0:
                     break;
@@ -623,18 +801,29 @@ bool NimBLEAdvertising::start(uint32_t duration, void (*advCompleteCB)(NimBLEAdv
         m_advDataSet = true;
     }
 
+    ble_gap_adv_params advParams = m_advParams;
+    if(NimBLEDevice::coexEnabled()) {
+        NimBLEDevice::coexAdvInterval(advParams.itvl_min, advParams.itvl_max,
+                                      m_scanResp && m_advParams.disc_mode != BLE_GAP_DISC_MODE_NON);
+    }
+
 #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
     rc = ble_gap_adv_start(NimBLEDevice::m_own_addr_type, NULL, duration,
-                           &m_advParams,
+                           &advParams,
                            (pServer != nullptr) ? NimBLEServer::handleGapEvent :
                                                   NimBLEAdvertising::handleGapEvent,
                            (void*)this);
 #else
     rc = ble_gap_adv_start(NimBLEDevice::m_own_addr_type, NULL, duration,
-                           &m_advParams, NimBLEAdvertising::handleGapEvent, this);
+                           &advParams, NimBLEAdvertising::handleGapEvent, this);
 #endif
     switch(rc) {
         case 0:
+             NIMBLE_CPP_RADIO_ADV_CONFIG(0, advParams.itvl_min, advParams.itvl_max,
+                                         NimBLERadioActivity::advEventUs(true,
+                                             m_scanResp || advParams.conn_mode != BLE_GAP_CONN_MODE_NON,
+                                             BLE_HCI_LE_PHY_1M));
+             NIMBLE_CPP_RADIO_ADV_START(0);
              break;
 
         case BLE_HS_EALREADY:
@@ -681,6 +870,8 @@ bool NimBLEAdvertising::stop() {
         return false;
     }
 
+    NIMBLE_CPP_RADIO_ADV_STOP(0);
+
     NIMBLE_LOGD(LOG_TAG, "<< stop");
     return true;
 } // stop
@@ -746,6 +937,7 @@ int NimBLEAdvertising::handleGapEvent(struct ble_gap_event *event, void *arg) {
             default:
                 break;
         }
+        NIMBLE_CPP_RADIO_ADV_STOP(0);
         pAdv->advCompleteCB();
     }
     return 0;
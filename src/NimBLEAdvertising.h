@@ -31,6 +31,7 @@
 /**************************/
 
 #include "NimBLEUUID.h"
+#include "NimBLEAdvertisementBuilder.h"
 
 #include <vector>
 
@@ -97,12 +98,16 @@ public:
     void setManufacturerData(const std::string &data);
     void setURI(const std::string &uri);
     void setServiceData(const NimBLEUUID &uuid, const std::string &data);
+    bool updateServiceData(const NimBLEUUID &uuid, const std::string &data);
+    bool updateManufacturerData(const std::string &data);
     void setAdvertisementType(uint8_t adv_type);
     void setMaxInterval(uint16_t maxinterval);
     void setMinInterval(uint16_t mininterval);
     void setAdvertisementData(NimBLEAdvertisementData& advertisementData);
+    void setAdvertisementData(const NimBLEAdvertisementBuilder& advertisementData);
     void setScanFilter(bool scanRequestWhitelistOnly, bool connectWhitelistOnly);
     void setScanResponseData(NimBLEAdvertisementData& advertisementData);
+    void setScanResponseData(const NimBLEAdvertisementBuilder& advertisementData);
     void setScanResponse(bool);
     void setMinPreferred(uint16_t);
     void setMaxPreferred(uint16_t);
@@ -117,6 +122,10 @@ private:
 
     void                    onHostSync();
     static int              handleGapEvent(struct ble_gap_event *event, void *arg);
+    bool                    patchField(uint8_t type, const uint8_t *prefix, uint8_t prefixLen,
+                                       const uint8_t *data, size_t length);
+    void                    setAdvertisementData(const uint8_t *data, size_t length);
+    void                    setScanResponseData(const uint8_t *data, size_t length);
 
     ble_hs_adv_fields       m_advData;
     ble_hs_adv_fields       m_scanData;
@@ -135,6 +144,8 @@ private:
     std::vector<uint8_t>    m_name;
     std::vector<uint8_t>    m_mfgData;
     std::vector<uint8_t>    m_uri;
+    uint8_t                 m_advPayload[BLE_HS_ADV_MAX_SZ];
+    uint8_t                 m_advPayloadLen;
 };
 
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_BROADCASTER  && !CONFIG_BT_NIMBLE_EXT_ADV */
@@ -0,0 +1,217 @@
+/*
+ * NimBLEArena.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEArena.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_npl.h"
+#else
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+#endif
+
+#include "NimBLEMemory.h"
+
+#include <stdlib.h>
+#include <new>
+
+// Alignment of each allocation.
+#define NIMBLE_CPP_ARENA_ALIGN 8
+
+static const char* LOG_TAG = "NimBLEArena";
+
+
+/**
+ * @brief Construct an arena, the memory is allocated on first use.
+ * @param [in] size The size of the arena in bytes.
+ */
+NimBLEArena::NimBLEArena(size_t size) {
+    m_pool = nullptr;
+    m_size = size;
+    m_used = 0;
+    m_live = 0;
+} // NimBLEArena
+
+
+/**
+ * @brief Allocate memory from the arena.
+ * @param [in] size The number of bytes to allocate.
+ * @return A pointer to the memory, allocated from the heap if the arena is full.
+ */
+void* NimBLEArena::alloc(size_t size) {
+    size = (size + NIMBLE_CPP_ARENA_ALIGN - 1) & ~(size_t)(NIMBLE_CPP_ARENA_ALIGN - 1);
+    void* ptr = nullptr;
+
+    ble_npl_hw_enter_critical();
+    if(m_pool == nullptr) {
+        ble_npl_hw_exit_critical(0);
+#if CONFIG_NIMBLE_CPP_ARENA_PSRAM && defined(ESP_PLATFORM)
+        // Without PSRAM the heap fallback below is used rather than taking the whole arena from internal RAM.
+        uint8_t* pool = (uint8_t*)heap_caps_malloc(m_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+        uint8_t* pool = (uint8_t*)malloc(m_size);
+#endif
+        ble_npl_hw_enter_critical();
+        if(m_pool == nullptr) {
+            m_pool = pool;
+            pool = nullptr;
+        }
+        ble_npl_hw_exit_critical(0);
+        // Another task created the pool first.
+        ::free(pool);
+        ble_npl_hw_enter_critical();
+    }
+
+    if(m_pool != nullptr && m_size - m_used >= size) {
+        ptr = m_pool + m_used;
+        m_used += size;
+        m_live++;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(ptr == nullptr) {
+        NIMBLE_LOGD(LOG_TAG, "Arena full, using heap");
+#if CONFIG_NIMBLE_CPP_ARENA_PSRAM
+        ptr = nimble_cpp_psram_malloc(size);
+        assert(ptr && "NimBLEArena: alloc failed");
+#else
+        ptr = ::operator new(size);
+#endif
+    }
+
+    return ptr;
+} // alloc
+
+
+/**
+ * @brief Free memory allocated with alloc.
+ * @param [in] ptr A pointer to the memory to free.
+ * @details The arena space is reused once all of the allocations from it have been freed.
+ */
+void NimBLEArena::free(void* ptr) {
+    if(ptr == nullptr) {
+        return;
+    }
+
+    ble_npl_hw_enter_critical();
+    if(m_pool != nullptr && (uint8_t*)ptr >= m_pool && (uint8_t*)ptr < m_pool + m_size) {
+        if(--m_live == 0) {
+            m_used = 0;
+        }
+        ptr = nullptr;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(ptr != nullptr) {
+#if CONFIG_NIMBLE_CPP_ARENA_PSRAM
+        ::free(ptr);
+#else
+        ::operator delete(ptr);
+#endif
+    }
+} // free
+
+
+/**
+ * @brief Allocate memory that records the arena it came from, so it can be freed without knowing the arena.
+ * @param [in] size The number of bytes to allocate.
+ * @return A pointer to the memory, allocated from the heap if the arena is full.
+ */
+void* NimBLEArena::allocOwned(size_t size) {
+    NimBLEArena** pOwner = (NimBLEArena**)alloc(size + NIMBLE_CPP_ARENA_ALIGN);
+    *pOwner = this;
+    return (uint8_t*)pOwner + NIMBLE_CPP_ARENA_ALIGN;
+} // allocOwned
+
+
+/**
+ * @brief Free memory allocated with allocOwned.
+ * @param [in] ptr A pointer to the memory to free.
+ */
+void NimBLEArena::freeOwned(void* ptr) {
+    if(ptr == nullptr) {
+        return;
+    }
+
+    NimBLEArena** pOwner = (NimBLEArena**)((uint8_t*)ptr - NIMBLE_CPP_ARENA_ALIGN);
+    (*pOwner)->free(pOwner);
+} // freeOwned
+
+
+/**
+ * @brief Return the arena memory to the heap if nothing is allocated from it.
+ * @return True if the memory was released or was not allocated.
+ */
+bool NimBLEArena::release() {
+    uint8_t* pool = nullptr;
+
+    ble_npl_hw_enter_critical();
+    if(m_live == 0) {
+        pool = m_pool;
+        m_pool = nullptr;
+        m_used = 0;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(pool != nullptr) {
+        ::free(pool);
+    }
+
+    return m_pool == nullptr;
+} // release
+
+
+/**
+ * @brief Get the size of the arena in bytes.
+ */
+size_t NimBLEArena::getSize() {
+    return m_size;
+} // getSize
+
+
+/**
+ * @brief Get the number of bytes allocated from the arena.
+ */
+size_t NimBLEArena::getUsed() {
+    return m_used;
+} // getUsed
+
+
+/**
+ * @brief Get the number of allocations from the arena that have not been freed.
+ */
+size_t NimBLEArena::getLiveCount() {
+    return m_live;
+} // getLiveCount
+
+
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+/**
+ * @brief Get the arena used for services, characteristics and descriptors of the server.
+ */
+NimBLEArena& NimBLEArena::server() {
+    static NimBLEArena arena(CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE);
+    return arena;
+} // server
+#endif
+
+
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE > 0
+/**
+ * @brief Get the arena used for the remote services, characteristics and descriptors of all clients.
+ */
+NimBLEArena& NimBLEArena::client() {
+    static NimBLEArena arena(CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE);
+    return arena;
+} // client
+#endif
+
+#endif /* CONFIG_BT_ENABLED */
@@ -0,0 +1,72 @@
+/*
+ * NimBLEArena.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEARENA_H_
+#define NIMBLEARENA_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE
+#    define CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE 0
+#endif
+
+#ifndef CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE
+#    define CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE 0
+#endif
+
+#ifndef CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+#    define CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER 0
+#endif
+
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER && CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE == 0
+#    error "CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER needs CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE"
+#endif
+
+#ifndef CONFIG_NIMBLE_CPP_ARENA_PSRAM
+#    define CONFIG_NIMBLE_CPP_ARENA_PSRAM 0
+#endif
+
+/**
+ * @brief A fixed size region that attribute objects are allocated from in sequence.
+ * @details Freeing an object only counts it, the whole region is reused once every object
+ * allocated from it has been freed, for example after deleting the server or the services of all clients.
+ * When the region is full objects are allocated from the heap.
+ */
+class NimBLEArena {
+public:
+    NimBLEArena(size_t size);
+
+    void*               alloc(size_t size);
+    void                free(void* ptr);
+    void*               allocOwned(size_t size);
+    static void         freeOwned(void* ptr);
+    bool                release();
+    size_t              getSize();
+    size_t              getUsed();
+    size_t              getLiveCount();
+
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+    static NimBLEArena& server();
+#endif
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE > 0
+    static NimBLEArena& client();
+#endif
+
+private:
+    uint8_t*            m_pool;
+    size_t              m_size;
+    size_t              m_used;
+    size_t              m_live;
+}; // NimBLEArena
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* NIMBLEARENA_H_ */
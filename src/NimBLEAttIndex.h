@@ -0,0 +1,129 @@
+/*
+ * NimBLEAttIndex.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEATTINDEX_H_
+#define NIMBLEATTINDEX_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEUUID.h"
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * @brief Sorted lookup tables for the attributes held by a server, service or characteristic.
+ * @tparam T NimBLEService, NimBLECharacteristic or NimBLEDescriptor.
+ * @details The index is built when the GATT server starts and the handles are known and is cleared
+ * when an attribute is added or removed, callers search the attribute vector while it is not built.
+ * Attributes with the same UUID keep the order of the vector so that instance ID's are unchanged.
+ */
+template<typename T>
+class NimBLEAttIndex {
+public:
+    NimBLEAttIndex() : m_built(false) {}
+
+    /**
+     * @brief Build the index from a vector of attributes.
+     * @param [in] attrs The attributes to index, in the order they were added.
+     */
+    void build(const std::vector<T*> &attrs) {
+        m_byHandle.clear();
+        m_byUUID.clear();
+        m_byHandle.reserve(attrs.size());
+        m_byUUID.reserve(attrs.size());
+
+        for(auto &it : attrs) {
+            if(it->getHandle() != 0) {
+                m_byHandle.push_back(it);
+            }
+            m_byUUID.push_back({it->getUUID().hash(), it});
+        }
+
+        std::stable_sort(m_byHandle.begin(), m_byHandle.end(), [](T* a, T* b) {
+            return a->getHandle() < b->getHandle();
+        });
+        std::stable_sort(m_byUUID.begin(), m_byUUID.end(), [](const uuid_entry_t &a, const uuid_entry_t &b) {
+            return a.hash < b.hash;
+        });
+
+        m_built = true;
+    } // build
+
+    /**
+     * @brief Clear the index, lookups must search the attribute vector until it is built again.
+     */
+    void clear() {
+        m_byHandle.clear();
+        m_byUUID.clear();
+        m_built = false;
+    } // clear
+
+    /**
+     * @brief Check if the index has been built.
+     */
+    bool isBuilt() const {
+        return m_built;
+    } // isBuilt
+
+    /**
+     * @brief Find an attribute by its handle.
+     * @param [in] handle The handle of the attribute.
+     * @return A pointer to the attribute or nullptr if not found.
+     */
+    T* getByHandle(uint16_t handle) const {
+        auto it = std::lower_bound(m_byHandle.begin(), m_byHandle.end(), handle, [](T* a, uint16_t h) {
+            return a->getHandle() < h;
+        });
+
+        if(it != m_byHandle.end() && (*it)->getHandle() == handle) {
+            return *it;
+        }
+
+        return nullptr;
+    } // getByHandle
+
+    /**
+     * @brief Find an attribute by its UUID.
+     * @param [in] uuid The UUID of the attribute.
+     * @param [in] instanceId The index of the attribute to return when more than one has the same UUID.
+     * @return A pointer to the attribute or nullptr if not found.
+     */
+    T* getByUUID(const NimBLEUUID &uuid, uint16_t instanceId = 0) const {
+        const uint32_t hash = uuid.hash();
+        auto it = std::lower_bound(m_byUUID.begin(), m_byUUID.end(), hash, [](const uuid_entry_t &a, uint32_t h) {
+            return a.hash < h;
+        });
+
+        uint16_t position = 0;
+        for(; it != m_byUUID.end() && it->hash == hash; ++it) {
+            if(it->attr->getUUID() == uuid) {
+                if(position == instanceId) {
+                    return it->attr;
+                }
+                position++;
+            }
+        }
+
+        return nullptr;
+    } // getByUUID
+
+private:
+    typedef struct {
+        uint32_t hash;
+        T*       attr;
+    } uuid_entry_t;
+
+    std::vector<T*>           m_byHandle;
+    std::vector<uuid_entry_t> m_byUUID;
+    bool                      m_built;
+}; // NimBLEAttIndex
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLEATTINDEX_H_ */
@@ -0,0 +1,142 @@
+/*
+ * NimBLEAttStream.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEAttStream.h"
+#include "NimBLELog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static const char* LOG_TAG = "NimBLEAttStream";
+
+
+/**
+ * @brief Construct a stream.
+ * @param [in] size The number of bytes the stream can hold.
+ */
+NimBLEAttStream::NimBLEAttStream(uint16_t size) {
+    m_buf  = (uint8_t*)malloc(size);
+    m_size = m_buf != nullptr ? size : 0;
+    m_head = 0;
+    m_tail = 0;
+    m_len  = 0;
+    m_sent = 0;
+
+    if(m_buf == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to allocate stream buffer, size=%u", size);
+    }
+} // NimBLEAttStream
+
+
+NimBLEAttStream::~NimBLEAttStream() {
+    free(m_buf);
+} // ~NimBLEAttStream
+
+
+/**
+ * @brief Write data to the end of the stream.
+ * @param [in] data A pointer to the data to write.
+ * @param [in] len The length of the data.
+ * @return The number of bytes written, less than len if the stream is full.
+ * @details Only one task should write to the stream.
+ */
+size_t NimBLEAttStream::write(const uint8_t* data, size_t len) {
+    len = std::min(len, (size_t)(m_size - __atomic_load_n(&m_len, __ATOMIC_ACQUIRE)));
+    if(len == 0) {
+        return 0;
+    }
+
+    size_t first = std::min(len, (size_t)(m_size - m_head));
+    memcpy(m_buf + m_head, data, first);
+    memcpy(m_buf, data + first, len - first);
+    m_head = (m_head + len) % m_size;
+
+    // Publish the data to the reader after it has been copied.
+    __atomic_add_fetch(&m_len, (uint16_t)len, __ATOMIC_RELEASE);
+    return len;
+} // write
+
+
+/**
+ * @brief Get the number of bytes in the stream that have not been read.
+ */
+size_t NimBLEAttStream::available() {
+    return __atomic_load_n(&m_len, __ATOMIC_ACQUIRE) - m_sent;
+} // available
+
+
+/**
+ * @brief Get the number of bytes the stream can hold.
+ */
+size_t NimBLEAttStream::getSize() {
+    return m_size;
+} // getSize
+
+
+/**
+ * @brief Remove all data from the stream.
+ * @details Must not be called while the stream is being written.
+ */
+void NimBLEAttStream::clear() {
+    ble_npl_hw_enter_critical();
+    m_head = 0;
+    m_tail = 0;
+    m_len  = 0;
+    m_sent = 0;
+    ble_npl_hw_exit_critical(0);
+} // clear
+
+
+/**
+ * @brief Remove data from the start of the stream.
+ * @param [in] len The number of bytes to remove.
+ */
+void NimBLEAttStream::consume(size_t len) {
+    if(len == 0) {
+        return;
+    }
+
+    m_tail = (m_tail + len) % m_size;
+    __atomic_sub_fetch(&m_len, (uint16_t)len, __ATOMIC_RELEASE);
+} // consume
+
+
+/**
+ * @brief Append the unread data of the stream to a read response.
+ * @param [in] om The mbuf to append to.
+ * @param [in] newRead True if this is the start of a read, false if it continues a long read.
+ * @param [in] mtu The ATT MTU of the connection.
+ * @return 0 on success, or an ATT error code.
+ * @details The data sent by the previous read is removed when a new read starts.
+ * Long reads require the data from offset 0, the host removes the part that was already sent.
+ * The number of bytes the client received is tracked from the MTU so that data cut off by
+ * a short read is sent again by the next read.
+ */
+int NimBLEAttStream::appendToMbuf(struct os_mbuf* om, bool newRead, uint16_t mtu) {
+    if(newRead) {
+        consume(m_sent);
+        m_sent = 0;
+    }
+
+    size_t len = std::min((size_t)__atomic_load_n(&m_len, __ATOMIC_ACQUIRE), (size_t)BLE_ATT_ATTR_MAX_LEN);
+    size_t first = std::min(len, (size_t)(m_size - m_tail));
+    if(os_mbuf_append(om, m_buf + m_tail, first) != 0 ||
+       os_mbuf_append(om, m_buf, len - first) != 0) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    // A read response holds up to MTU - 1 bytes of the value.
+    m_sent += std::min(len - std::min(len, (size_t)m_sent), (size_t)(mtu - 1));
+    return 0;
+} // appendToMbuf
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
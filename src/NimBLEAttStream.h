@@ -0,0 +1,60 @@
+/*
+ * NimBLEAttStream.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEATTSTREAM_H_
+#define NIMBLEATTSTREAM_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+class NimBLECharacteristic;
+
+/**
+ * @brief A circular buffer used as the value of a streaming characteristic.
+ * @details Data written to the stream is sent to the client in the order it was written,
+ * each read of the characteristic returns the oldest data that has not been read and
+ * long reads continue where the previous part ended. The data is removed from the stream
+ * when the client starts the next read.\n
+ * Writing and reading do not move the stored data, one task can write to the stream
+ * while the host task reads from it without locking.
+ */
+class NimBLEAttStream {
+public:
+    NimBLEAttStream(uint16_t size);
+    ~NimBLEAttStream();
+
+    size_t      write(const uint8_t* data, size_t len);
+    size_t      available();
+    size_t      getSize();
+    void        clear();
+
+private:
+    friend class NimBLECharacteristic;
+
+    int         appendToMbuf(struct os_mbuf* om, bool newRead, uint16_t mtu);
+    void        consume(size_t len);
+
+    uint8_t*    m_buf;
+    uint16_t    m_size;
+    uint16_t    m_head;
+    uint16_t    m_tail;
+    uint16_t    m_len;
+    uint16_t    m_sent;
+}; // NimBLEAttStream
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLEATTSTREAM_H_ */
@@ -16,6 +16,8 @@
 #endif
 
 #include "NimBLELog.h"
+#include "NimBLEMemory.h"
+#include "NimBLEUtils.h"
 
 /****  FIX COMPILATION ****/
 #undef min
@@ -24,6 +26,7 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 
 #ifndef CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
 #    define CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED 0
@@ -41,6 +44,14 @@
 #    error CONFIG_NIMBLE_CPP_ATT_VALUE_INIT_LENGTH cannot be less than 1; Range = 1 : 512
 #endif
 
+#if !defined(CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH)
+#    define CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH 20
+#elif CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH > BLE_ATT_ATTR_MAX_LEN
+#    error CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH cannot be larger than 512 (BLE_ATT_ATTR_MAX_LEN)
+#elif CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH < 0
+#    error CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH cannot be less than 0; Range = 0 : 512
+#endif
+
 
 /* Used to determine if the type passed to a template has a c_str() and length() method. */
 template <typename T, typename = void, typename = void>
@@ -51,22 +62,60 @@ struct Has_c_str_len<T, decltype(void(std::declval<T &>().c_str())),
                      decltype(void(std::declval<T &>().length()))> : std::true_type {};
 
 
+/* Heap value buffers are preceded by a reference count of the values sharing them. */
+#define NIMBLE_ATT_VALUE_REFS(buf) ((uint32_t*)((buf) - sizeof(uint32_t)))
+
+/**
+ * @brief Allocate a heap value buffer with a reference count of 1.
+ * @param[in] len The size of the value the buffer can hold, a null terminator is added.
+ * @return A pointer to the value buffer.
+ */
+inline uint8_t* nimble_att_value_alloc(uint16_t len) {
+#if CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH > 0
+    uint8_t* base = (uint8_t*)(len >= CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH ?
+                               nimble_cpp_psram_calloc(sizeof(uint32_t) + len + 1) :
+                               calloc(sizeof(uint32_t) + len + 1, 1));
+#else
+    uint8_t* base = (uint8_t*)calloc(sizeof(uint32_t) + len + 1, 1);
+#endif
+    assert(base && "NimBLEAttValue: alloc failed");
+    *(uint32_t*)base = 1;
+    return base + sizeof(uint32_t);
+}
+
+
 /**
  * @brief A specialized container class to hold BLE attribute values.
  * @details This class is designed to be more memory efficient than using\n
  * standard container types for value storage, while being convertible to\n
- * many different container classes.
+ * many different container classes.\n
+ * Values up to CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH bytes are stored in the object,\n
+ * larger values are moved to the heap.\n
+ * Updates are guarded by a sequence counter instead of a critical section, copies of the value\n
+ * are retried if they overlap an update so readers never block writers.\n
+ * Copies of a value stored on the heap share the buffer, which is reference counted and\n
+ * only copied when one of the values is modified.
  */
 class NimBLEAttValue
 {
-    uint8_t*     m_attr_value = nullptr;
+    uint8_t*     m_attr_value = m_inline;
     uint16_t     m_attr_max_len = 0;
     uint16_t     m_attr_len = 0;
-    uint16_t     m_capacity = 0;
+    uint16_t     m_capacity = CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH;
 #if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
-    time_t       m_timestamp = 0;
+    uint64_t     m_timestamp = 0;
 #endif
+    mutable uint32_t m_seq = 0;
+    uint8_t      m_inline[CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH + 1] = {0};
     void         deepCopy(const NimBLEAttValue & source);
+    bool         shareFrom(const NimBLEAttValue & source);
+    uint8_t*     reserve(uint16_t len);
+    void         releaseBuf();
+    bool         isShared() const;
+    void         writeBegin() const;
+    void         writeEnd() const;
+    uint32_t     readBegin() const;
+    bool         readRetry(uint32_t seq) const;
 
 public:
     /**
@@ -163,21 +212,39 @@ public:
     const uint8_t*  end()          const   { return m_attr_value + m_attr_len; }
 
 #if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
-    /** @brief Returns a timestamp of when the value was last updated */
-    time_t          getTimeStamp() const   { return m_timestamp; }
+    /**
+     * @brief Returns a timestamp of when the value was last updated, in seconds of the time of day clock.
+     * @details Converted from getTimeStampUs() when called, values are not timestamped with time().
+     */
+    time_t          getTimeStamp() const   {
+        return time(nullptr) - (time_t)((NimBLEUtils::getTimeUs() - m_timestamp) / 1000000);
+    }
+
+    /** @brief Returns the time since boot in microseconds when the value was last updated, see NimBLEUtils::getTimeUs */
+    uint64_t        getTimeStampUs() const { return m_timestamp; }
 
     /** @brief Set the timestamp to the current time */
-    void            setTimeStamp()         { m_timestamp = time(nullptr); }
+    void            setTimeStamp()         { m_timestamp = NimBLEUtils::getTimeUs(); }
 
     /**
      * @brief Set the timestamp to the specified time
-     * @param[in] t The timestamp value to set
+     * @param[in] t The timestamp value to set, in seconds of the time of day clock
      */
-    void            setTimeStamp(time_t t) { m_timestamp = t; }
+    void            setTimeStamp(time_t t) {
+        m_timestamp = NimBLEUtils::getTimeUs() - (uint64_t)(time(nullptr) - t) * 1000000;
+    }
+
+    /**
+     * @brief Set the timestamp to the specified monotonic time
+     * @param[in] t The time since boot in microseconds
+     */
+    void            setTimeStampUs(uint64_t t) { m_timestamp = t; }
 #else
     time_t          getTimeStamp() const   { return 0; }
+    uint64_t        getTimeStampUs() const { return 0; }
     void            setTimeStamp()         { }
     void            setTimeStamp(time_t t) { }
+    void            setTimeStampUs(uint64_t t) { }
 #endif
 
     /**
@@ -195,6 +262,28 @@ public:
     bool            setValue(const char* s) {
                          return setValue((uint8_t*)s, (uint16_t)strlen(s)); }
 
+    /**
+     * @brief Set the value from the data of an mbuf chain without an intermediate buffer.
+     * @param[in] om A pointer to the first mbuf of the chain.
+     * @returns True if successful, false if the data is larger than the max size.
+     */
+    bool            setValueFromMbuf(const struct os_mbuf *om);
+
+    /**
+     * @brief Append a consistent copy of the value to an mbuf chain.
+     * @param[in] om A pointer to the mbuf chain to append to.
+     * @returns True if successful, false if the mbuf could not be extended.
+     */
+    bool            appendToMbuf(struct os_mbuf *om) const;
+
+    /**
+     * @brief Copy a consistent copy of the value to a buffer.
+     * @param[in] buf A pointer to the buffer to copy to.
+     * @param[in] len The size of the buffer in bytes.
+     * @returns The number of bytes copied.
+     */
+    uint16_t        copyTo(uint8_t *buf, uint16_t len) const;
+
     /**
      * @brief Get a pointer to the value buffer with timestamp.
      * @param[in] timestamp A ponter to a time_t variable to store the timestamp.
@@ -258,7 +347,10 @@ public:
             if(!skipSizeCheck && size() < sizeof(T)) {
                 return T();
             }
-            return *((T *)getValue(timestamp));
+            T res = T();
+            getValue(timestamp);
+            copyTo((uint8_t*)&res, sizeof(T));
+            return res;
     }
 
 
@@ -270,11 +362,25 @@ public:
 
     /** @brief Operator; Get the value as a std::vector<uint8_t>. */
     operator std::vector<uint8_t>() const {
-        return std::vector<uint8_t>(m_attr_value, m_attr_value + m_attr_len); }
+        std::vector<uint8_t> res;
+        uint32_t seq;
+        do {
+            seq = readBegin();
+            res.assign(m_attr_value, m_attr_value + m_attr_len);
+        } while (readRetry(seq));
+        return res;
+    }
 
     /** @brief Operator; Get the value as a std::string. */
     operator std::string() const {
-        return std::string((char*)m_attr_value, m_attr_len); }
+        std::string res;
+        uint32_t seq;
+        do {
+            seq = readBegin();
+            res.assign((char*)m_attr_value, m_attr_len);
+        } while (readRetry(seq));
+        return res;
+    }
 
     /** @brief Operator; Get the value as a const uint8_t*. */
     operator const uint8_t*() const { return m_attr_value; }
@@ -310,12 +416,13 @@ public:
 
 
 inline NimBLEAttValue::NimBLEAttValue(uint16_t init_len, uint16_t max_len) {
-    m_attr_value   = (uint8_t*)calloc(init_len + 1, 1);
-    assert(m_attr_value && "No Mem");
+    if (init_len > CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH) {
+        m_attr_value = nimble_att_value_alloc(init_len);
+        m_capacity   = init_len;
+    }
     m_attr_max_len = std::min(BLE_ATT_ATTR_MAX_LEN, (int)max_len);
     m_attr_len     = 0;
-    m_capacity     = init_len;
-    setTimeStamp(0);
+    setTimeStampUs(0);
 }
 
 inline NimBLEAttValue::NimBLEAttValue(const uint8_t *value, uint16_t len, uint16_t max_len)
@@ -326,21 +433,32 @@ inline NimBLEAttValue::NimBLEAttValue(const uint8_t *value, uint16_t len, uint16
 }
 
 inline NimBLEAttValue::~NimBLEAttValue() {
-    if(m_attr_value != nullptr) {
-        free(m_attr_value);
-    }
+    releaseBuf();
 }
 
 inline NimBLEAttValue& NimBLEAttValue::operator =(NimBLEAttValue && source) {
     if (this != &source){
-        free(m_attr_value);
+        writeBegin();
+        releaseBuf();
+
+        if (source.m_attr_value == source.m_inline) {
+            memcpy(m_inline, source.m_inline, source.m_attr_len + 1);
+            m_attr_value = m_inline;
+        } else {
+            m_attr_value = source.m_attr_value;
+        }
 
-        m_attr_value   = source.m_attr_value;
         m_attr_max_len = source.m_attr_max_len;
         m_attr_len     = source.m_attr_len;
         m_capacity     = source.m_capacity;
-        setTimeStamp(source.getTimeStamp());
-        source.m_attr_value = nullptr;
+        setTimeStampUs(source.getTimeStampUs());
+
+        // Leave the source as an empty inline value.
+        source.m_attr_value = source.m_inline;
+        source.m_attr_len   = 0;
+        source.m_capacity   = CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH;
+        source.m_inline[0]  = '\0';
+        writeEnd();
     }
     return *this;
 }
@@ -353,23 +471,208 @@ inline NimBLEAttValue& NimBLEAttValue::operator =(const NimBLEAttValue & source)
 }
 
 inline void NimBLEAttValue::deepCopy(const NimBLEAttValue & source) {
-    uint8_t* res = (uint8_t*)realloc( m_attr_value, source.m_capacity + 1);
-    assert(res && "deepCopy: realloc failed");
-
-    ble_npl_hw_enter_critical();
-    m_attr_value   = res;
-    m_attr_max_len = source.m_attr_max_len;
-    m_attr_len     = source.m_attr_len;
-    m_capacity     = source.m_capacity;
-    setTimeStamp(source.getTimeStamp());
-    memcpy(m_attr_value, source.m_attr_value, m_attr_len + 1);
-    ble_npl_hw_exit_critical(0);
+    if (source.m_attr_value != source.m_inline && shareFrom(source)) {
+        return;
+    }
+
+    uint32_t seq;
+    do {
+        // The source is not waited on while this value is locked so that two values
+        // copied to each other at the same time cannot dead lock.
+        seq = source.readBegin();
+        uint16_t len = source.m_attr_len;
+
+        writeBegin();
+        m_attr_value   = reserve(len);
+        m_attr_max_len = source.m_attr_max_len;
+        m_attr_len     = len;
+        setTimeStampUs(source.getTimeStampUs());
+        memcpy(m_attr_value, source.m_attr_value, len);
+        m_attr_value[len] = '\0';
+        writeEnd();
+    } while (source.readRetry(seq));
+}
+
+/**
+ * @brief Share the heap buffer of another value instead of copying it.
+ * @details The source is locked while the reference is taken so that it cannot
+ * free or modify the buffer in place at the same time.
+ * @return False if the source value is not on the heap, it must be copied instead.
+ */
+inline bool NimBLEAttValue::shareFrom(const NimBLEAttValue & source) {
+    source.writeBegin();
+    uint8_t* buf = source.m_attr_value;
+    if (buf == source.m_inline) {
+        source.writeEnd();
+        return false;
+    }
+
+    __atomic_add_fetch(NIMBLE_ATT_VALUE_REFS(buf), 1, __ATOMIC_RELAXED);
+    uint16_t max_len  = source.m_attr_max_len;
+    uint16_t len      = source.m_attr_len;
+    uint16_t capacity = source.m_capacity;
+    uint64_t t        = source.getTimeStampUs();
+    source.writeEnd();
+
+    writeBegin();
+    releaseBuf();
+    m_attr_value   = buf;
+    m_attr_max_len = max_len;
+    m_attr_len     = len;
+    m_capacity     = capacity;
+    setTimeStampUs(t);
+    writeEnd();
+    return true;
+}
+
+/**
+ * @brief Drop the reference to the heap buffer, it is freed when no other value shares it.
+ * @details Does not reset the buffer pointer.
+ */
+inline void NimBLEAttValue::releaseBuf() {
+    if (m_attr_value != m_inline &&
+        __atomic_sub_fetch(NIMBLE_ATT_VALUE_REFS(m_attr_value), 1, __ATOMIC_ACQ_REL) == 0) {
+        free(NIMBLE_ATT_VALUE_REFS(m_attr_value));
+    }
+}
+
+/** @brief Check if the heap buffer of this value is shared with another value. */
+inline bool NimBLEAttValue::isShared() const {
+    return m_attr_value != m_inline &&
+           __atomic_load_n(NIMBLE_ATT_VALUE_REFS(m_attr_value), __ATOMIC_ACQUIRE) > 1;
+}
+
+/**
+ * @brief Start an update of the value, waits for any other update to finish.
+ * @details The sequence counter is odd while an update is in progress.
+ */
+inline void NimBLEAttValue::writeBegin() const {
+    uint32_t seq = __atomic_load_n(&m_seq, __ATOMIC_RELAXED);
+    for (;;) {
+        if (!(seq & 1) &&
+            __atomic_compare_exchange_n(&m_seq, &seq, seq + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+        // Another task is updating the value, let it run.
+        ble_npl_time_delay(1);
+        seq = __atomic_load_n(&m_seq, __ATOMIC_RELAXED);
+    }
+}
+
+/** @brief Finish an update of the value. */
+inline void NimBLEAttValue::writeEnd() const {
+    __atomic_store_n(&m_seq, m_seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Start reading the value, waits while an update is in progress.
+ * @return The sequence number to pass to readRetry.
+ */
+inline uint32_t NimBLEAttValue::readBegin() const {
+    uint32_t seq;
+    uint8_t  spins = 0;
+    while ((seq = __atomic_load_n(&m_seq, __ATOMIC_ACQUIRE)) & 1) {
+        // The writer may be a lower priority task on this core, let it finish.
+        if (++spins > 16) {
+            ble_npl_time_delay(1);
+        }
+    }
+    return seq;
+}
+
+/**
+ * @brief Check if the value was updated while it was being read.
+ * @param[in] seq The sequence number returned by readBegin.
+ * @return True if the read must be repeated.
+ */
+inline bool NimBLEAttValue::readRetry(uint32_t seq) const {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&m_seq, __ATOMIC_RELAXED) != seq;
+}
+
+inline bool NimBLEAttValue::appendToMbuf(struct os_mbuf *om) const {
+    uint16_t start = OS_MBUF_PKTLEN(om);
+    for (;;) {
+        uint32_t seq = readBegin();
+        if (os_mbuf_append(om, m_attr_value, m_attr_len) != 0) {
+            return false;
+        }
+
+        if (!readRetry(seq)) {
+            return true;
+        }
+
+        // Updated while copying, remove the partial copy and try again.
+        os_mbuf_adj(om, -(int)(OS_MBUF_PKTLEN(om) - start));
+    }
+}
+
+inline uint16_t NimBLEAttValue::copyTo(uint8_t *buf, uint16_t len) const {
+    uint16_t copied;
+    uint32_t seq;
+    do {
+        seq = readBegin();
+        copied = std::min(len, m_attr_len);
+        memcpy(buf, m_attr_value, copied);
+    } while (readRetry(seq));
+    return copied;
+}
+
+/**
+ * @brief Get a buffer that can hold a value of len bytes.
+ * @details Returns the current buffer if it is large enough and not shared, otherwise the value
+ * is moved from the inline storage to the heap, the heap buffer is reallocated or a shared buffer
+ * is copied. The current value is kept.\n
+ * Must be called between writeBegin and writeEnd.
+ */
+inline uint8_t* NimBLEAttValue::reserve(uint16_t len) {
+    bool shared = isShared();
+    if (len <= m_capacity && !shared) {
+        return m_attr_value;
+    }
+
+    uint8_t* res;
+    if (shared) {
+        // Keep the shared buffer unchanged for the other values and copy it.
+        uint16_t capacity = std::max(len, m_attr_len);
+        if (capacity <= CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH) {
+            res = m_inline;
+            capacity = CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH;
+        } else {
+            res = nimble_att_value_alloc(capacity);
+        }
+        memcpy(res, m_attr_value, m_attr_len + 1);
+        releaseBuf();
+        m_capacity = capacity;
+        return res;
+    }
+
+    if (m_attr_value == m_inline) {
+        res = nimble_att_value_alloc(len);
+        memcpy(res, m_inline, m_attr_len + 1);
+    } else {
+#if CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH > 0
+        uint8_t* base = (uint8_t*)(len >= CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH ?
+                                   nimble_cpp_psram_realloc(NIMBLE_ATT_VALUE_REFS(m_attr_value),
+                                                            sizeof(uint32_t) + len + 1) :
+                                   realloc(NIMBLE_ATT_VALUE_REFS(m_attr_value), sizeof(uint32_t) + len + 1));
+#else
+        uint8_t* base = (uint8_t*)realloc(NIMBLE_ATT_VALUE_REFS(m_attr_value),
+                                          sizeof(uint32_t) + len + 1);
+#endif
+        assert(base && "NimBLEAttValue: alloc failed");
+        res = base + sizeof(uint32_t);
+    }
+
+    m_capacity = len;
+    return res;
 }
 
 inline const uint8_t*  NimBLEAttValue::getValue(time_t *timestamp) {
     if(timestamp != nullptr) {
 #if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
-        *timestamp = m_timestamp;
+        *timestamp = getTimeStamp();
 #else
         *timestamp = 0;
 #endif
@@ -384,26 +687,47 @@ inline bool NimBLEAttValue::setValue(const uint8_t *value, uint16_t len) {
         return false;
     }
 
-    uint8_t *res = m_attr_value;
-    if (len > m_capacity) {
-        res = (uint8_t*)realloc(m_attr_value, (len + 1));
-        m_capacity = len;
+#if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
+    uint64_t t = NimBLEUtils::getTimeUs();
+#else
+    uint64_t t = 0;
+#endif
+
+    writeBegin();
+    m_attr_value = reserve(len);
+    memcpy(m_attr_value, value, len);
+    m_attr_value[len] = '\0';
+    m_attr_len = len;
+    setTimeStampUs(t);
+    writeEnd();
+    return true;
+}
+
+inline bool NimBLEAttValue::setValueFromMbuf(const struct os_mbuf *om) {
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    if (len > m_attr_max_len) {
+        NIMBLE_LOGE("NimBLEAttValue", "value exceeds max, len=%u, max=%u",
+                     len, m_attr_max_len);
+        return false;
     }
-    assert(res && "setValue: realloc failed");
 
 #if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
-    time_t t = time(nullptr);
+    uint64_t t = NimBLEUtils::getTimeUs();
 #else
-    time_t t = 0;
+    uint64_t t = 0;
 #endif
 
-    ble_npl_hw_enter_critical();
-    m_attr_value = res;
-    memcpy(m_attr_value, value, len);
+    writeBegin();
+    m_attr_value = reserve(len);
+    uint16_t offset = 0;
+    for (const struct os_mbuf *next = om; next != nullptr; next = SLIST_NEXT(next, om_next)) {
+        memcpy(m_attr_value + offset, next->om_data, next->om_len);
+        offset += next->om_len;
+    }
     m_attr_value[len] = '\0';
     m_attr_len = len;
-    setTimeStamp(t);
-    ble_npl_hw_exit_critical(0);
+    setTimeStampUs(t);
+    writeEnd();
     return true;
 }
 
@@ -418,27 +742,20 @@ inline NimBLEAttValue& NimBLEAttValue::append(const uint8_t *value, uint16_t len
         return *this;
     }
 
-    uint8_t* res = m_attr_value;
-    uint16_t new_len = m_attr_len + len;
-    if (new_len > m_capacity) {
-        res = (uint8_t*)realloc(m_attr_value, (new_len + 1));
-        m_capacity = new_len;
-    }
-    assert(res && "append: realloc failed");
-
 #if CONFIG_NIMBLE_CPP_ATT_VALUE_TIMESTAMP_ENABLED
-    time_t t = time(nullptr);
+    uint64_t t = NimBLEUtils::getTimeUs();
 #else
-    time_t t = 0;
+    uint64_t t = 0;
 #endif
 
-    ble_npl_hw_enter_critical();
-    m_attr_value = res;
+    writeBegin();
+    uint16_t new_len = m_attr_len + len;
+    m_attr_value = reserve(new_len);
     memcpy(m_attr_value + m_attr_len, value, len);
     m_attr_len = new_len;
     m_attr_value[m_attr_len] = '\0';
-    setTimeStamp(t);
-    ble_npl_hw_exit_critical(0);
+    setTimeStampUs(t);
+    writeEnd();
 
     return *this;
 }
@@ -38,6 +38,53 @@ NimBLEBeacon::NimBLEBeacon() {
 } // NimBLEBeacon
 
 
+/**
+ * @brief Decode an iBeacon frame without copying or allocating.
+ * @param [in] data A pointer to the manufacturer data, as from NimBLEAdvertisedDevice::getManufacturerDataPtr.
+ * @param [in] length The length of the data.
+ * @param [out] pBeacon A pointer to storage for the decoded fields.
+ * @return True if the data is an iBeacon frame, pBeacon is not modified otherwise.
+ */
+bool NimBLEBeacon::decode(const uint8_t* data, size_t length, BeaconData* pBeacon) {
+    if (data == nullptr || length != FRAME_LENGTH || data[2] != 0x02 || data[3] != 0x15) {
+        return false;
+    }
+
+    pBeacon->manufacturerId = data[0] | (data[1] << 8);
+    memcpy(pBeacon->proximityUUID, data + 4, sizeof(pBeacon->proximityUUID));
+    pBeacon->major          = (data[20] << 8) | data[21];
+    pBeacon->minor          = (data[22] << 8) | data[23];
+    pBeacon->signalPower    = (int8_t)data[24];
+    return true;
+} // decode
+
+
+/**
+ * @brief Encode an iBeacon frame into a buffer for the manufacturer data of an advertisement.
+ * @param [in] beacon The fields of the frame.
+ * @param [in] buf A pointer to the buffer to write the frame to.
+ * @param [in] size The size of the buffer.
+ * @return The number of bytes written, 0 if the buffer is smaller than FRAME_LENGTH.
+ */
+size_t NimBLEBeacon::encode(const BeaconData& beacon, uint8_t* buf, size_t size) {
+    if (buf == nullptr || size < FRAME_LENGTH) {
+        return 0;
+    }
+
+    buf[0]  = beacon.manufacturerId & 0xFF;
+    buf[1]  = beacon.manufacturerId >> 8;
+    buf[2]  = 0x02;
+    buf[3]  = 0x15;
+    memcpy(buf + 4, beacon.proximityUUID, sizeof(beacon.proximityUUID));
+    buf[20] = beacon.major >> 8;
+    buf[21] = beacon.major & 0xFF;
+    buf[22] = beacon.minor >> 8;
+    buf[23] = beacon.minor & 0xFF;
+    buf[24] = (uint8_t)beacon.signalPower;
+    return FRAME_LENGTH;
+} // encode
+
+
 /**
  * @brief Retrieve the data that is being advertised.
  * @return The advertised data.
@@ -33,7 +33,23 @@ private:
         int8_t   signalPower;
     } __attribute__((packed)) m_beaconData;
 public:
+    /**
+     * @brief The fields of an iBeacon frame in host byte order, used to decode and encode frames without allocating.
+     */
+    struct BeaconData {
+        uint16_t manufacturerId;
+        uint8_t  proximityUUID[16]; /**< In the frame order, most significant byte first. */
+        uint16_t major;
+        uint16_t minor;
+        int8_t   signalPower;
+    };
+
+    /** @brief The length of an iBeacon frame in the manufacturer data. */
+    static const size_t FRAME_LENGTH = 25;
+
     NimBLEBeacon();
+    static bool   decode(const uint8_t* data, size_t length, BeaconData* pBeacon);
+    static size_t encode(const BeaconData& beacon, uint8_t* buf, size_t size);
     std::string getData();
     uint16_t    getMajor();
     uint16_t    getMinor();
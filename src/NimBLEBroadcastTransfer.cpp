@@ -0,0 +1,565 @@
+/*
+ * NimBLEBroadcastTransfer.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER) || \
+    (defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER) && CONFIG_BT_NIMBLE_EXT_ADV))
+
+#include "NimBLEBroadcastTransfer.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+static const char* LOG_TAG = "NimBLEBroadcast";
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER) && CONFIG_BT_NIMBLE_EXT_ADV
+
+/**
+ * @brief Construct a broadcast sender.
+ * @param [in] instId The extended advertising instance to send the frames with, it is configured by start().
+ * @param [in] companyId The company ID of the manufacturer data holding the frames, the receivers must use the same.
+ */
+NimBLEBroadcastSender::NimBLEBroadcastSender(uint8_t instId, uint16_t companyId)
+: m_data(nullptr),
+  m_length(0),
+  m_blobId(0),
+  m_frameSize(0),
+  m_dataFrames(0),
+  m_groupSize(0),
+  m_companyId(companyId),
+  m_instId(instId),
+  m_crc(0),
+  m_parity(nullptr),
+  m_group(0),
+  m_pos(0),
+  m_cycles(0),
+  m_frameTicks(1),
+  m_active(false)
+{
+    ble_npl_callout_init(&m_frameTimer, nimble_port_get_dflt_eventq(),
+                         NimBLEBroadcastSender::frameTimerCb, this);
+} // NimBLEBroadcastSender
+
+
+NimBLEBroadcastSender::~NimBLEBroadcastSender() {
+    stop();
+    ble_npl_callout_deinit(&m_frameTimer);
+    delete[] m_parity;
+} // ~NimBLEBroadcastSender
+
+
+/**
+ * @brief Set the blob to broadcast.
+ * @param [in] data A pointer to the blob, it is not copied and must remain valid while broadcasting.
+ * @param [in] length The length of the blob.
+ * @param [in] blobId An ID for the blob, change it when the content changes.
+ * @param [in] frameSize The number of bytes of the blob in each frame, at most NIMBLE_BROADCAST_MAX_FRAME_SIZE.
+ * @param [in] groupSize The number of data frames covered by each parity frame, 0 to send no parity frames.
+ * Smaller groups recover more losses at the cost of more frames per cycle.
+ * @return True if the blob was set, it cannot be changed while broadcasting.
+ */
+bool NimBLEBroadcastSender::setBlob(const uint8_t* data, size_t length, uint16_t blobId,
+                                    uint16_t frameSize, uint8_t groupSize)
+{
+    if(m_active) {
+        NIMBLE_LOGE(LOG_TAG, "Blob cannot be changed while broadcasting");
+        return false;
+    }
+
+    if(length == 0 || frameSize == 0 || frameSize > NIMBLE_BROADCAST_MAX_FRAME_SIZE) {
+        return false;
+    }
+
+    // Data and parity frame indexes are both sent as 16 bit values.
+    size_t dataFrames = (length + frameSize - 1) / frameSize;
+    size_t groups = groupSize > 0 ? (dataFrames + groupSize - 1) / groupSize : 0;
+    if(dataFrames + groups > 0xFFFF) {
+        NIMBLE_LOGE(LOG_TAG, "Blob of %u bytes needs too many frames", (unsigned)length);
+        return false;
+    }
+
+    delete[] m_parity;
+    m_parity = groupSize > 0 ? new uint8_t[frameSize] : nullptr;
+
+    m_data = data;
+    m_length = length;
+    m_blobId = blobId;
+    m_frameSize = frameSize;
+    m_dataFrames = dataFrames;
+    m_groupSize = groupSize;
+    m_crc = NimBLEUtils::crc32(0, data, length);
+    return true;
+} // setBlob
+
+
+/**
+ * @brief Start broadcasting the blob.
+ * @param [in] frameIntervalMs The time each frame is advertised for, also used as the advertising interval.
+ * @param [in] priPhy The primary PHY of the advertisements.
+ * @param [in] secPhy The secondary PHY, the frames are sent on it. BLE_HCI_LE_PHY_2M halves the airtime.
+ * @return True if broadcasting started.
+ */
+bool NimBLEBroadcastSender::start(uint32_t frameIntervalMs, uint8_t priPhy, uint8_t secPhy) {
+    if(m_data == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "No blob set");
+        return false;
+    }
+
+    if(m_active) {
+        return true;
+    }
+
+    // The advertising interval is at least 20ms and in 0.625ms units.
+    uint32_t itvl = std::max<uint32_t>(frameIntervalMs, 20) * 1000 / 625;
+
+    NimBLEExtAdvertisement adv(priPhy, secPhy);
+    adv.setLegacyAdvertising(false);
+    adv.setConnectable(false);
+    adv.setScannable(false);
+    adv.setMinInterval(itvl);
+    adv.setMaxInterval(itvl);
+
+    NimBLEExtAdvertising* pAdv = NimBLEDevice::getAdvertising();
+    if(!pAdv->setInstanceData(m_instId, adv)) {
+        return false;
+    }
+
+    m_group = 0;
+    m_pos = 0;
+    m_cycles = 0;
+    if(!sendNext() || !pAdv->start(m_instId)) {
+        return false;
+    }
+
+    m_active = true;
+    m_frameTicks = std::max<uint32_t>(ble_npl_time_ms_to_ticks32(std::max<uint32_t>(frameIntervalMs, 20)), 1);
+    ble_npl_callout_reset(&m_frameTimer, m_frameTicks);
+    return true;
+} // start
+
+
+/**
+ * @brief Stop broadcasting.
+ */
+void NimBLEBroadcastSender::stop() {
+    ble_npl_callout_stop(&m_frameTimer);
+    if(m_active) {
+        m_active = false;
+        NimBLEDevice::getAdvertising()->stop(m_instId);
+    }
+} // stop
+
+
+/**
+ * @brief Check if the blob is being broadcast.
+ */
+bool NimBLEBroadcastSender::isActive() {
+    return m_active;
+} // isActive
+
+
+/**
+ * @brief Get the number of times all of the frames were sent since start().
+ */
+uint32_t NimBLEBroadcastSender::getCycleCount() {
+    return m_cycles;
+} // getCycleCount
+
+
+/**
+ * @brief Get the number of frames in a cycle, data and parity frames.
+ */
+uint32_t NimBLEBroadcastSender::getFrameCount() {
+    uint32_t groups = m_groupSize > 0 ? (m_dataFrames + m_groupSize - 1) / m_groupSize : 0;
+    return m_dataFrames + groups;
+} // getFrameCount
+
+
+/**
+ * @brief Advertise the next frame, called from the host task.
+ */
+void NimBLEBroadcastSender::frameTimerCb(struct ble_npl_event *event) {
+    NimBLEBroadcastSender* pSender = (NimBLEBroadcastSender*)ble_npl_event_get_arg(event);
+    if(!pSender->m_active) {
+        return;
+    }
+
+    pSender->sendNext();
+    ble_npl_callout_reset(&pSender->m_frameTimer, pSender->m_frameTicks);
+} // frameTimerCb
+
+
+/**
+ * @brief Set the next frame of the carousel as the advertising data.
+ * @details Each group of data frames is followed by its parity frame.
+ */
+bool NimBLEBroadcastSender::sendNext() {
+    uint16_t first = m_group * (m_groupSize > 0 ? m_groupSize : m_dataFrames);
+    uint16_t count = m_groupSize > 0 ? std::min<uint16_t>(m_groupSize, m_dataFrames - first) : m_dataFrames;
+    bool rc;
+
+    if(m_pos < count) {
+        uint16_t index = first + m_pos;
+        size_t offset = (size_t)index * m_frameSize;
+        rc = sendFrame(index, m_data + offset, std::min<size_t>(m_frameSize, m_length - offset));
+        m_pos++;
+        if(m_pos < count || m_groupSize > 0) {
+            return rc;
+        }
+    } else {
+        // The parity of the frames of the group, the last frame is padded with zeros.
+        memset(m_parity, 0, m_frameSize);
+        for(uint16_t i = first; i < first + count; i++) {
+            size_t offset = (size_t)i * m_frameSize;
+            size_t len = std::min<size_t>(m_frameSize, m_length - offset);
+            for(size_t j = 0; j < len; j++) {
+                m_parity[j] ^= m_data[offset + j];
+            }
+        }
+        rc = sendFrame(m_dataFrames + m_group, m_parity, m_frameSize);
+    }
+
+    m_pos = 0;
+    m_group++;
+    if((uint32_t)m_group * (m_groupSize > 0 ? m_groupSize : m_dataFrames) >= m_dataFrames) {
+        m_group = 0;
+        m_cycles++;
+    }
+    return rc;
+} // sendNext
+
+
+/**
+ * @brief Set a frame as the advertising data of the instance.
+ * @param [in] index The index of the frame.
+ * @param [in] payload A pointer to the data of the frame.
+ * @param [in] length The length of the data.
+ * @return True if the data was set.
+ */
+bool NimBLEBroadcastSender::sendFrame(uint16_t index, const uint8_t* payload, uint16_t length) {
+    uint8_t hdr[4 + NIMBLE_BROADCAST_HEADER_LEN] = {
+        (uint8_t)(3 + NIMBLE_BROADCAST_HEADER_LEN + length), BLE_HS_ADV_TYPE_MFG_DATA,
+        (uint8_t)m_companyId, (uint8_t)(m_companyId >> 8),
+        NIMBLE_BROADCAST_VERSION,
+        (uint8_t)m_blobId, (uint8_t)(m_blobId >> 8),
+        (uint8_t)index, (uint8_t)(index >> 8),
+        (uint8_t)m_dataFrames, (uint8_t)(m_dataFrames >> 8),
+        m_groupSize,
+        (uint8_t)m_frameSize, (uint8_t)(m_frameSize >> 8),
+        (uint8_t)m_length, (uint8_t)(m_length >> 8), (uint8_t)(m_length >> 16), (uint8_t)(m_length >> 24),
+        (uint8_t)m_crc, (uint8_t)(m_crc >> 8), (uint8_t)(m_crc >> 16), (uint8_t)(m_crc >> 24),
+    };
+
+    NimBLEExtAdvertising::ext_adv_segment_t segments[2] = {
+        {hdr, sizeof(hdr)},
+        {payload, length},
+    };
+    return NimBLEDevice::getAdvertising()->setData(m_instId, segments, 2);
+} // sendFrame
+
+#endif /* CONFIG_BT_NIMBLE_ROLE_BROADCASTER && CONFIG_BT_NIMBLE_EXT_ADV */
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+
+static NimBLEBroadcastReceiverCallbacks defaultCallbacks;
+
+/**
+ * @brief Construct a broadcast receiver.
+ * @param [in] companyId The company ID of the manufacturer data holding the frames.
+ * @param [in] maxBlobSize The largest blob to receive, the blob is stored in a buffer of its size.
+ */
+NimBLEBroadcastReceiver::NimBLEBroadcastReceiver(uint16_t companyId, size_t maxBlobSize)
+: m_pCallbacks(&defaultCallbacks),
+  m_companyId(companyId),
+  m_maxBlobSize(maxBlobSize),
+  m_buf(nullptr),
+  m_blobId(0),
+  m_length(0),
+  m_crc(0),
+  m_frameSize(0),
+  m_dataFrames(0),
+  m_groupSize(0),
+  m_received(0),
+  m_recovered(0),
+  m_session(false),
+  m_accepted(false),
+  m_complete(false)
+{
+} // NimBLEBroadcastReceiver
+
+
+NimBLEBroadcastReceiver::~NimBLEBroadcastReceiver() {
+    delete[] m_buf;
+} // ~NimBLEBroadcastReceiver
+
+
+/**
+ * @brief Set the callbacks for the received blobs.
+ * @param [in] pCallbacks A pointer to the callbacks, nullptr for the default.
+ */
+void NimBLEBroadcastReceiver::setCallbacks(NimBLEBroadcastReceiverCallbacks* pCallbacks) {
+    m_pCallbacks = pCallbacks != nullptr ? pCallbacks : &defaultCallbacks;
+} // setCallbacks
+
+
+/**
+ * @brief Discard the blob being received, or received, and free its buffer.
+ * @details A blob that was complete is received again if its frames are still broadcast.
+ * Must not be called while scanning with the receiver set.
+ */
+void NimBLEBroadcastReceiver::reset() {
+    delete[] m_buf;
+    m_buf = nullptr;
+    m_bitmap.clear();
+    m_session = false;
+    m_accepted = false;
+    m_complete = false;
+    m_received = 0;
+    m_recovered = 0;
+} // reset
+
+
+/**
+ * @brief Check if all of the current blob was received.
+ */
+bool NimBLEBroadcastReceiver::isComplete() {
+    return m_complete;
+} // isComplete
+
+
+/**
+ * @brief Get the ID of the current blob.
+ */
+uint16_t NimBLEBroadcastReceiver::getBlobId() {
+    return m_blobId;
+} // getBlobId
+
+
+/**
+ * @brief Get the length of the current blob.
+ */
+size_t NimBLEBroadcastReceiver::getBlobLength() {
+    return m_length;
+} // getBlobLength
+
+
+/**
+ * @brief Get the number of data frames of the current blob.
+ */
+uint16_t NimBLEBroadcastReceiver::getFrameCount() {
+    return m_dataFrames;
+} // getFrameCount
+
+
+/**
+ * @brief Get the number of data frames of the current blob received or recovered.
+ */
+uint16_t NimBLEBroadcastReceiver::getFramesReceived() {
+    return m_received;
+} // getFramesReceived
+
+
+/**
+ * @brief Get the number of data frames of the current blob recovered from parity frames.
+ */
+uint32_t NimBLEBroadcastReceiver::getFramesRecovered() {
+    return m_recovered;
+} // getFramesRecovered
+
+
+/**
+ * @brief Look for a frame in the data of an advertisement report.
+ * @param [in] data The advertisement data.
+ * @param [in] length The length of the data.
+ * @return True if the report holds a frame, it is not processed further by the scan.
+ */
+bool NimBLEBroadcastReceiver::handleReport(const uint8_t* data, size_t length) {
+    size_t pos = 0;
+    while(pos + 1 < length) {
+        uint8_t len = data[pos];
+        if(len == 0 || pos + 1 + len > length) {
+            break;
+        }
+
+        if(data[pos + 1] == BLE_HS_ADV_TYPE_MFG_DATA && len >= 3 + NIMBLE_BROADCAST_HEADER_LEN &&
+           (data[pos + 2] | (data[pos + 3] << 8)) == m_companyId &&
+           data[pos + 4] == NIMBLE_BROADCAST_VERSION)
+        {
+            handleFrame(data + pos + 4, len - 3);
+            return true;
+        }
+        pos += len + 1;
+    }
+    return false;
+} // handleReport
+
+
+/**
+ * @brief Get the length of a data frame of the current blob.
+ */
+uint16_t NimBLEBroadcastReceiver::frameLength(uint16_t index) {
+    return std::min<size_t>(m_frameSize, m_length - (size_t)index * m_frameSize);
+} // frameLength
+
+
+/**
+ * @brief Store a data frame and call the callbacks when the blob is complete.
+ */
+void NimBLEBroadcastReceiver::setFrame(uint16_t index, const uint8_t* payload, uint16_t length) {
+    memcpy(m_buf + (size_t)index * m_frameSize, payload, length);
+    m_bitmap[index / 32] |= 1UL << (index % 32);
+    m_received++;
+
+    if(m_received < m_dataFrames) {
+        return;
+    }
+
+    if(NimBLEUtils::crc32(0, m_buf, m_length) != m_crc) {
+        NIMBLE_LOGE(LOG_TAG, "Blob %u CRC mismatch, receiving it again", m_blobId);
+        std::fill(m_bitmap.begin(), m_bitmap.end(), 0);
+        m_received = 0;
+        return;
+    }
+
+    NIMBLE_LOGI(LOG_TAG, "Blob %u complete, %u frames recovered", m_blobId, m_recovered);
+    m_complete = true;
+    m_pCallbacks->onComplete(this, m_blobId, m_buf, m_length);
+} // setFrame
+
+
+/**
+ * @brief Recover the data frame of a group that is missing, if it is the only one.
+ * @param [in] group The group of the parity frame.
+ * @param [in] parity The payload of the parity frame, the frame size long.
+ */
+void NimBLEBroadcastReceiver::recoverFrame(uint16_t group, const uint8_t* parity) {
+    uint16_t first = group * m_groupSize;
+    uint16_t last = std::min<uint32_t>((uint32_t)first + m_groupSize, m_dataFrames);
+    uint16_t missing = 0xFFFF;
+
+    for(uint16_t i = first; i < last; i++) {
+        if(!haveFrame(i)) {
+            if(missing != 0xFFFF) {
+                return;
+            }
+            missing = i;
+        }
+    }
+
+    if(missing == 0xFFFF) {
+        return;
+    }
+
+    // The missing frame is the parity XOR the other frames of the group, padded with zeros.
+    uint16_t len = frameLength(missing);
+    uint8_t* dst = m_buf + (size_t)missing * m_frameSize;
+    memcpy(dst, parity, len);
+    for(uint16_t i = first; i < last; i++) {
+        if(i == missing) {
+            continue;
+        }
+
+        const uint8_t* src = m_buf + (size_t)i * m_frameSize;
+        uint16_t n = std::min(len, frameLength(i));
+        for(uint16_t j = 0; j < n; j++) {
+            dst[j] ^= src[j];
+        }
+    }
+
+    m_recovered++;
+    setFrame(missing, dst, len);
+} // recoverFrame
+
+
+/**
+ * @brief Handle a frame, starting a new blob if it belongs to a different one.
+ * @param [in] frame The frame, starting at the header.
+ * @param [in] length The length of the frame.
+ */
+void NimBLEBroadcastReceiver::handleFrame(const uint8_t* frame, size_t length) {
+    uint16_t blobId     = frame[1] | (frame[2] << 8);
+    uint16_t index      = frame[3] | (frame[4] << 8);
+    uint16_t dataFrames = frame[5] | (frame[6] << 8);
+    uint8_t  groupSize  = frame[7];
+    uint16_t frameSize  = frame[8] | (frame[9] << 8);
+    uint32_t blobLength = frame[10] | (frame[11] << 8) | (frame[12] << 16) | ((uint32_t)frame[13] << 24);
+    uint32_t crc        = frame[14] | (frame[15] << 8) | (frame[16] << 16) | ((uint32_t)frame[17] << 24);
+    const uint8_t* payload = frame + NIMBLE_BROADCAST_HEADER_LEN;
+    uint16_t payloadLen = length - NIMBLE_BROADCAST_HEADER_LEN;
+
+    if(!m_session || blobId != m_blobId || blobLength != m_length || crc != m_crc) {
+        if(frameSize == 0 || frameSize > NIMBLE_BROADCAST_MAX_FRAME_SIZE || blobLength == 0 ||
+           dataFrames != (blobLength + frameSize - 1) / frameSize)
+        {
+            return;
+        }
+
+        reset();
+        m_session = true;
+        m_blobId = blobId;
+        m_length = blobLength;
+        m_crc = crc;
+        m_frameSize = frameSize;
+        m_dataFrames = dataFrames;
+        m_groupSize = groupSize;
+
+        if(blobLength > m_maxBlobSize) {
+            NIMBLE_LOGW(LOG_TAG, "Blob %u of %u bytes exceeds the max size", blobId, blobLength);
+            return;
+        }
+
+        m_accepted = m_pCallbacks->onStart(this, blobId, blobLength);
+        if(!m_accepted) {
+            return;
+        }
+
+        m_buf = new uint8_t[blobLength];
+        m_bitmap.assign((dataFrames + 31) / 32, 0);
+        NIMBLE_LOGI(LOG_TAG, "Receiving blob %u, %u bytes in %u frames", blobId, blobLength, dataFrames);
+    }
+
+    if(!m_accepted || m_complete) {
+        return;
+    }
+
+    if(index < m_dataFrames) {
+        if(!haveFrame(index) && payloadLen == frameLength(index)) {
+            setFrame(index, payload, payloadLen);
+        }
+    } else if(m_groupSize > 0 && payloadLen == m_frameSize &&
+              (uint32_t)(index - m_dataFrames) * m_groupSize < m_dataFrames)
+    {
+        recoverFrame(index - m_dataFrames, payload);
+    }
+} // handleFrame
+
+
+bool NimBLEBroadcastReceiverCallbacks::onStart(NimBLEBroadcastReceiver* pReceiver, uint16_t blobId,
+                                               size_t length) {
+    NIMBLE_LOGD("NimBLEBroadcastReceiverCallbacks", "onStart: default");
+    return true;
+} // onStart
+
+void NimBLEBroadcastReceiverCallbacks::onComplete(NimBLEBroadcastReceiver* pReceiver, uint16_t blobId,
+                                                  const uint8_t* data, size_t length) {
+    NIMBLE_LOGD("NimBLEBroadcastReceiverCallbacks", "onComplete: default");
+} // onComplete
+
+#endif /* CONFIG_BT_NIMBLE_ROLE_OBSERVER */
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_OBSERVER || CONFIG_BT_NIMBLE_ROLE_BROADCASTER) */
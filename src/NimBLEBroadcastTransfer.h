@@ -0,0 +1,177 @@
+/*
+ * NimBLEBroadcastTransfer.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEBROADCASTTRANSFER_H_
+#define NIMBLEBROADCASTTRANSFER_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER) || \
+    (defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER) && CONFIG_BT_NIMBLE_EXT_ADV))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <vector>
+
+/** Length of the frame header following the company ID of the manufacturer data */
+#define NIMBLE_BROADCAST_HEADER_LEN     18
+/** Largest frame payload, the frame fits in one HCI extended advertising report */
+#define NIMBLE_BROADCAST_MAX_FRAME_SIZE 207
+/** Version of the frame format */
+#define NIMBLE_BROADCAST_VERSION        1
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER) && CONFIG_BT_NIMBLE_EXT_ADV
+/**
+ * @brief Broadcasts a blob to any number of receivers with extended advertising, without connections.
+ * @details The blob is split in numbered frames sent as manufacturer data, one frame per advertising
+ * interval. After each group of frames a parity frame, the XOR of the group, lets a receiver recover
+ * one frame of the group it missed. The frames are sent in a carousel until stopped, so receivers can
+ * start at any time and fill the frames they missed in the next cycles.\n
+ * Each frame carries, after the company ID, in little endian: `uint8 version, uint16 blob ID,
+ * uint16 frame index, uint16 data frame count, uint8 group size, uint16 frame size, uint32 blob length,
+ * uint32 CRC-32 of the blob`. Frame indexes from the data frame count are the parity frames of each group.
+ */
+class NimBLEBroadcastSender {
+public:
+    NimBLEBroadcastSender(uint8_t instId = 0, uint16_t companyId = 0xFFFF);
+    ~NimBLEBroadcastSender();
+
+    bool            setBlob(const uint8_t* data, size_t length, uint16_t blobId,
+                            uint16_t frameSize = NIMBLE_BROADCAST_MAX_FRAME_SIZE, uint8_t groupSize = 8);
+    bool            start(uint32_t frameIntervalMs = 20, uint8_t priPhy = BLE_HCI_LE_PHY_1M,
+                          uint8_t secPhy = BLE_HCI_LE_PHY_1M);
+    void            stop();
+    bool            isActive();
+    uint32_t        getCycleCount();
+    uint32_t        getFrameCount();
+
+private:
+    static void     frameTimerCb(struct ble_npl_event *event);
+    bool            sendFrame(uint16_t index, const uint8_t* payload, uint16_t length);
+    bool            sendNext();
+
+    const uint8_t*  m_data;
+    size_t          m_length;
+    uint16_t        m_blobId;
+    uint16_t        m_frameSize;
+    uint16_t        m_dataFrames;
+    uint8_t         m_groupSize;
+    uint16_t        m_companyId;
+    uint8_t         m_instId;
+    uint32_t        m_crc;
+    uint8_t*        m_parity;
+    uint16_t        m_group;
+    uint8_t         m_pos;
+    uint32_t        m_cycles;
+    uint32_t        m_frameTicks;
+    bool            m_active;
+    ble_npl_callout m_frameTimer;
+}; // NimBLEBroadcastSender
+#endif /* CONFIG_BT_NIMBLE_ROLE_BROADCASTER && CONFIG_BT_NIMBLE_EXT_ADV */
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+class NimBLEBroadcastReceiverCallbacks;
+
+/**
+ * @brief Reassembles a blob broadcast by a NimBLEBroadcastSender from the scan reports.
+ * @details Set it on the scan with NimBLEScan::setBroadcastReceiver. Reports holding a frame are
+ * consumed before any device lookup, no NimBLEAdvertisedDevice is created for them. The received
+ * frames are tracked in a bitmap, a missed frame is recovered from the parity frame of its group
+ * when it is the only one missing. When all frames are received the CRC of the blob is checked and
+ * NimBLEBroadcastReceiverCallbacks::onComplete is called.\n
+ * The frames are handled on the task the scan reports are handled on.
+ */
+class NimBLEBroadcastReceiver {
+public:
+    NimBLEBroadcastReceiver(uint16_t companyId = 0xFFFF, size_t maxBlobSize = 65536);
+    ~NimBLEBroadcastReceiver();
+
+    void            setCallbacks(NimBLEBroadcastReceiverCallbacks* pCallbacks);
+    void            reset();
+    bool            isComplete();
+    uint16_t        getBlobId();
+    size_t          getBlobLength();
+    uint16_t        getFrameCount();
+    uint16_t        getFramesReceived();
+    uint32_t        getFramesRecovered();
+
+private:
+    friend class NimBLEScan;
+
+    bool            handleReport(const uint8_t* data, size_t length);
+    void            handleFrame(const uint8_t* frame, size_t length);
+    void            recoverFrame(uint16_t group, const uint8_t* parity);
+    void            setFrame(uint16_t index, const uint8_t* payload, uint16_t length);
+    uint16_t        frameLength(uint16_t index);
+
+    /**
+     * @brief Check if a data frame was received.
+     */
+    bool haveFrame(uint16_t index) {
+        return m_bitmap[index / 32] & (1UL << (index % 32));
+    }
+
+    NimBLEBroadcastReceiverCallbacks* m_pCallbacks;
+    uint16_t              m_companyId;
+    size_t                m_maxBlobSize;
+    uint8_t*              m_buf;
+    std::vector<uint32_t> m_bitmap;
+    uint16_t              m_blobId;
+    size_t                m_length;
+    uint32_t              m_crc;
+    uint16_t              m_frameSize;
+    uint16_t              m_dataFrames;
+    uint8_t               m_groupSize;
+    uint16_t              m_received;
+    uint32_t              m_recovered;
+    bool                  m_session;
+    bool                  m_accepted;
+    bool                  m_complete;
+}; // NimBLEBroadcastReceiver
+
+
+/**
+ * @brief Callbacks for the blobs received by a NimBLEBroadcastReceiver.
+ */
+class NimBLEBroadcastReceiverCallbacks {
+public:
+    virtual ~NimBLEBroadcastReceiverCallbacks() {};
+
+    /**
+     * @brief Called when the first frame of a blob is received.
+     * @param [in] pReceiver A pointer to the receiver.
+     * @param [in] blobId The ID of the blob.
+     * @param [in] length The length of the blob.
+     * @return True to receive the blob, false to ignore its frames.
+     */
+    virtual bool onStart(NimBLEBroadcastReceiver* pReceiver, uint16_t blobId, size_t length);
+
+    /**
+     * @brief Called when all of a blob is received and its CRC matches.
+     * @param [in] pReceiver A pointer to the receiver.
+     * @param [in] blobId The ID of the blob.
+     * @param [in] data A pointer to the blob, valid until a different blob is received or the receiver is reset.
+     * @param [in] length The length of the blob.
+     */
+    virtual void onComplete(NimBLEBroadcastReceiver* pReceiver, uint16_t blobId,
+                            const uint8_t* data, size_t length);
+}; // NimBLEBroadcastReceiverCallbacks
+#endif /* CONFIG_BT_NIMBLE_ROLE_OBSERVER */
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_OBSERVER || CONFIG_BT_NIMBLE_ROLE_BROADCASTER) */
+#endif /* NIMBLEBROADCASTTRANSFER_H_ */
@@ -0,0 +1,54 @@
+/*
+ * NimBLECallbackBinding.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLECALLBACKBINDING_H_
+#define NIMBLECALLBACKBINDING_H_
+
+#include <type_traits>
+
+/**
+ * @brief Finds the class that declares a member function with the signature Sig.
+ * @details Deducing C from `&T::name` gives the class of the overload of `name` with that signature
+ * visible from T: T or one of its bases if it declares its own, the callbacks base class if it inherits it.
+ */
+template<class Sig>
+struct NimBLECallbackOwner {
+    template<class C> static C* of(Sig C::*);
+};
+
+/**
+ * @brief Declares NimBLECallbackOverrides_<name><T, Base, Sig>, true if T or a class between it and
+ * Base declares a public `name` with the signature Sig.
+ * @details A callback that is private, or hidden by an overload with another signature, is not found.
+ */
+#define NIMBLE_CPP_CALLBACK_DETECTOR(name)                                                      \
+    template<class T, class Base, class Sig, class = void>                                      \
+    struct NimBLECallbackOverrides_##name : std::false_type {};                                 \
+    template<class T, class Base, class Sig>                                                    \
+    struct NimBLECallbackOverrides_##name<T, Base, Sig, typename std::enable_if<                \
+        !std::is_same<decltype(NimBLECallbackOwner<Sig>::of(&T::name)), Base*>::value>::type>   \
+        : std::true_type {};
+
+/** @brief The bit if T overrides the callback `name` of Base with the signature Sig, otherwise 0. */
+#define NIMBLE_CPP_CALLBACK_BIT(T, Base, name, Sig, bit) \
+    (NimBLECallbackOverrides_##name<T, Base, Sig>::value ? (bit) : 0)
+
+NIMBLE_CPP_CALLBACK_DETECTOR(onRead)
+NIMBLE_CPP_CALLBACK_DETECTOR(onReadInto)
+NIMBLE_CPP_CALLBACK_DETECTOR(onWrite)
+NIMBLE_CPP_CALLBACK_DETECTOR(onNotify)
+NIMBLE_CPP_CALLBACK_DETECTOR(onStatus)
+NIMBLE_CPP_CALLBACK_DETECTOR(onSubscribe)
+NIMBLE_CPP_CALLBACK_DETECTOR(onConnect)
+NIMBLE_CPP_CALLBACK_DETECTOR(onDisconnect)
+NIMBLE_CPP_CALLBACK_DETECTOR(onMTUChange)
+NIMBLE_CPP_CALLBACK_DETECTOR(onPhyUpdate)
+NIMBLE_CPP_CALLBACK_DETECTOR(onAuthenticationComplete)
+NIMBLE_CPP_CALLBACK_DETECTOR(onConnParamsUpdateRequest)
+
+#endif /* NIMBLECALLBACKBINDING_H_ */
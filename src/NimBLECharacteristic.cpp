@@ -18,11 +18,23 @@
 #include "NimBLEDevice.h"
 #include "NimBLELog.h"
 
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
 #define NULL_HANDLE (0xffff)
 #define NIMBLE_SUB_NOTIFY   0x0001
 #define NIMBLE_SUB_INDICATE 0x0002
 
-static NimBLECharacteristicCallbacks defaultCallback;
+/** The callbacks of characteristics without their own, none of the CB_ON_* callbacks is called. */
+class NimBLEDefaultCharacteristicCallbacks : public NimBLECharacteristicCallbacks {
+public:
+    NimBLEDefaultCharacteristicCallbacks() : NimBLECharacteristicCallbacks(0) {}
+};
+
+static NimBLEDefaultCharacteristicCallbacks defaultCallback;
 static const char* LOG_TAG = "NimBLECharacteristic";
 
 
@@ -54,6 +66,16 @@ NimBLECharacteristic::NimBLECharacteristic(const NimBLEUUID &uuid, uint16_t prop
     m_pCallbacks  = &defaultCallback;
     m_pService    = pService;
     m_removed     = 0;
+    m_notifyCoalesce = false;
+    m_txPrio      = BLE_HS_TX_PRIO_NORMAL;
+    m_pNotifyPolicy = nullptr;
+    m_subscribed  = nullptr;
+    m_subscribedCount = 0;
+    m_pStream     = nullptr;
+    m_pStaticValue = nullptr;
+    m_staticLength = 0;
+    m_pWriteBatch = nullptr;
+    m_connValues  = nullptr;
 } // NimBLECharacteristic
 
 /**
@@ -63,9 +85,50 @@ NimBLECharacteristic::~NimBLECharacteristic() {
     for(auto &it : m_dscVec) {
         delete it;
     }
+
+    if(m_pStream != nullptr) {
+        delete m_pStream;
+    }
+
+    delete[] m_subscribed;
+    delete m_pNotifyPolicy;
+    setWriteBatch(0);
+
+    if(m_connValues != nullptr) {
+        NimBLEServer* pServer = NimBLEDevice::getServer();
+        if(pServer != nullptr) {
+            pServer->m_connValueChrVec.erase(std::remove(pServer->m_connValueChrVec.begin(),
+                                                         pServer->m_connValueChrVec.end(), this),
+                                             pServer->m_connValueChrVec.end());
+        }
+
+        for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+            delete m_connValues[i].second;
+        }
+        delete[] m_connValues;
+    }
 } // ~NimBLECharacteristic
 
 
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+/**
+ * @brief Allocate a characteristic from the server arena.
+ * @details Falls back to the heap if the arena is full.
+ */
+void* NimBLECharacteristic::operator new(size_t size) {
+    return NimBLEArena::server().alloc(size);
+} // operator new
+
+
+/**
+ * @brief Return a characteristic to the server arena, or the heap if it was not allocated from the arena.
+ */
+void NimBLECharacteristic::operator delete(void* ptr) {
+    NimBLEArena::server().free(ptr);
+} // operator delete
+#endif
+
+
 /**
  * @brief Create a new BLE Descriptor associated with this characteristic.
  * @param [in] uuid - The UUID of the descriptor.
@@ -118,6 +181,7 @@ void NimBLECharacteristic::addDescriptor(NimBLEDescriptor *pDescriptor) {
 
     if(!foundRemoved) {
         m_dscVec.push_back(pDescriptor);
+        m_dscIndex.clear();
     }
 
     pDescriptor->setCharacteristic(this);
@@ -140,6 +204,7 @@ void NimBLECharacteristic::removeDescriptor(NimBLEDescriptor *pDescriptor, bool
                 if ((*it) == pDescriptor) {
                     delete *it;
                     m_dscVec.erase(it);
+                    m_dscIndex.clear();
                     break;
                 }
             }
@@ -169,6 +234,10 @@ NimBLEDescriptor* NimBLECharacteristic::getDescriptorByUUID(const char* uuid) {
  * @return A pointer to the descriptor object or nullptr if not found.
  */
 NimBLEDescriptor* NimBLECharacteristic::getDescriptorByUUID(const NimBLEUUID &uuid) {
+    if(m_dscIndex.isBuilt()) {
+        return m_dscIndex.getByUUID(uuid);
+    }
+
     for (auto &it : m_dscVec) {
         if (it->getUUID() == uuid) {
             return it;
@@ -183,6 +252,10 @@ NimBLEDescriptor* NimBLECharacteristic::getDescriptorByUUID(const NimBLEUUID &uu
  * @return A pointer to the descriptor object or nullptr if not found.
  */
 NimBLEDescriptor *NimBLECharacteristic::getDescriptorByHandle(uint16_t handle) {
+    if(m_dscIndex.isBuilt()) {
+        return m_dscIndex.getByHandle(handle);
+    }
+
     for (auto &it : m_dscVec) {
         if (it->getHandle() == handle) {
             return it;
@@ -237,6 +310,10 @@ NimBLEUUID NimBLECharacteristic::getUUID() {
  * @return The NimBLEAttValue containing the current characteristic value.
  */
 NimBLEAttValue NimBLECharacteristic::getValue(time_t *timestamp) {
+    if(m_pStaticValue != nullptr) {
+        return NimBLEAttValue(m_pStaticValue, m_staticLength, m_staticLength);
+    }
+
     if(timestamp != nullptr) {
         m_value.getValue(timestamp);
     }
@@ -250,10 +327,146 @@ NimBLEAttValue NimBLECharacteristic::getValue(time_t *timestamp) {
  * @return The length of the current characteristic data.
  */
 size_t NimBLECharacteristic::getDataLength() {
+    if(m_pStaticValue != nullptr) {
+        return m_staticLength;
+    }
     return m_value.size();
 }
 
 
+/**
+ * @brief Serve reads of the characteristic from constant data.
+ * @param [in] data A pointer to the value, it must remain valid and unchanged while it is used, such as
+ * a const array in flash.
+ * @param [in] length The length of the value.
+ * @details Reads are answered by appending the data to the response, without calling the read callbacks,
+ * looking up the connection or locking the value. Meant for values that do not change, such as the
+ * device information or a HID report map. Setting a value or a write from a peer stops using the data.
+ */
+void NimBLECharacteristic::setStaticValue(const uint8_t* data, uint16_t length) {
+    m_staticLength = length;
+    m_pStaticValue = data;
+} // setStaticValue
+
+
+/**
+ * @brief Set the value read by one connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] data A pointer to the value.
+ * @param [in] length The length of the value.
+ * @return True on success, false if the peer is not connected, the value is too long or out of memory.
+ * @details Reads from this peer are answered with this value without calling the read callbacks,
+ * the other peers read the value of the characteristic. Writes from the peer still set the value of
+ * the characteristic. The value is removed when the peer disconnects.
+ */
+bool NimBLECharacteristic::setConnValue(uint16_t conn_handle, const uint8_t* data, size_t length) {
+    uint8_t slot;
+    if(ble_gap_conn_slot(conn_handle, &slot) != 0 || slot >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        NIMBLE_LOGE(LOG_TAG, "setConnValue: conn_handle=%d not connected", conn_handle);
+        return false;
+    }
+
+    if(length > m_value.max_size()) {
+        NIMBLE_LOGE(LOG_TAG, "setConnValue: length %d exceeds the max size", length);
+        return false;
+    }
+
+    if(m_connValues == nullptr) {
+        m_connValues = new(std::nothrow) std::pair<uint16_t, NimBLEAttValue*>[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+        if(m_connValues == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "setConnValue: out of memory");
+            return false;
+        }
+
+        for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+            m_connValues[i] = {BLE_HS_CONN_HANDLE_NONE, nullptr};
+        }
+
+        // The server drops the values of the peers that disconnect.
+        NimBLEServer* pServer = NimBLEDevice::getServer();
+        if(pServer != nullptr) {
+            pServer->m_connValueChrVec.push_back(this);
+        }
+    }
+
+    std::pair<uint16_t, NimBLEAttValue*> &it = m_connValues[slot];
+    if(it.second == nullptr) {
+        it.second = new(std::nothrow) NimBLEAttValue(data, length, m_value.max_size());
+        if(it.second == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "setConnValue: out of memory");
+            return false;
+        }
+    } else {
+        it.second->setValue(data, length);
+    }
+
+    it.first = conn_handle;
+    return true;
+} // setConnValue
+
+
+/**
+ * @brief Set the value read by one connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] vec The std::vector<uint8_t> reference to set the value to.
+ * @return True on success, false if the peer is not connected, the value is too long or out of memory.
+ */
+bool NimBLECharacteristic::setConnValue(uint16_t conn_handle, const std::vector<uint8_t>& vec) {
+    return setConnValue(conn_handle, vec.data(), vec.size());
+} // setConnValue
+
+
+/**
+ * @brief Get the value read by one connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return The value set for the peer with setConnValue, or the value of the characteristic if none is set.
+ */
+NimBLEAttValue NimBLECharacteristic::getConnValue(uint16_t conn_handle) {
+    NimBLEAttValue* pConnValue = findConnValue(conn_handle);
+    if(pConnValue != nullptr) {
+        return *pConnValue;
+    }
+    return getValue();
+} // getConnValue
+
+
+/**
+ * @brief Remove the value of one connection, it reads the value of the characteristic again.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @details The memory of the value is kept for the next connection using the slot.
+ */
+void NimBLECharacteristic::clearConnValue(uint16_t conn_handle) {
+    if(m_connValues == nullptr) {
+        return;
+    }
+
+    // Searched by handle, the host no longer knows the slot of a peer that disconnected.
+    for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        if(m_connValues[i].first == conn_handle) {
+            m_connValues[i].first = BLE_HS_CONN_HANDLE_NONE;
+            return;
+        }
+    }
+} // clearConnValue
+
+
+/**
+ * @brief Find the value set for a connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return A pointer to the value or nullptr if none is set for the peer.
+ */
+NimBLEAttValue* NimBLECharacteristic::findConnValue(uint16_t conn_handle) {
+    uint8_t slot;
+    if(m_connValues == nullptr || ble_gap_conn_slot(conn_handle, &slot) != 0 ||
+       slot >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        return nullptr;
+    }
+
+    std::pair<uint16_t, NimBLEAttValue*> &it = m_connValues[slot];
+    return it.first == conn_handle ? it.second : nullptr;
+} // findConnValue
+
+
 /**
  * @brief STATIC callback to handle events from the NimBLE stack.
  */
@@ -261,61 +474,97 @@ int NimBLECharacteristic::handleGapEvent(uint16_t conn_handle, uint16_t attr_han
                              struct ble_gatt_access_ctxt *ctxt,
                              void *arg)
 {
+    NIMBLE_CPP_STACK_PROFILE(CHR_ACCESS, -1);
+    NIMBLE_CPP_TRACE_ACCESS(CHR_ACCESS, conn_handle, attr_handle, ctxt);
     const ble_uuid_t *uuid;
     int rc;
     struct ble_gap_conn_desc desc;
     NimBLECharacteristic* pCharacteristic = (NimBLECharacteristic*)arg;
 
-    NIMBLE_LOGD(LOG_TAG, "Characteristic %s %s event", pCharacteristic->getUUID().toString().c_str(),
+    NIMBLE_LOGD(LOG_TAG, "Characteristic %s %s event", NIMBLE_CPP_STR(pCharacteristic->getUUID()),
                                     ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR ? "Read" : "Write");
 
     uuid = ctxt->chr->uuid;
-    if(ble_uuid_cmp(uuid, &pCharacteristic->getUUID().getNative()->u) == 0){
+    // The attribute definitions point to the UUID of the object, only compare the values if they do not.
+    if(uuid == &pCharacteristic->m_uuid.getNative()->u ||
+       ble_uuid_cmp(uuid, &pCharacteristic->m_uuid.getNative()->u) == 0){
         switch(ctxt->op) {
             case BLE_GATT_ACCESS_OP_READ_CHR: {
-                rc = ble_gap_conn_find(conn_handle, &desc);
-                assert(rc == 0);
+                NIMBLE_CPP_CONN_STATS_MARK(readStart, ctxt->om);
+                if(pCharacteristic->m_pStaticValue != nullptr) {
+                    rc = os_mbuf_append(ctxt->om, pCharacteristic->m_pStaticValue,
+                                        pCharacteristic->m_staticLength) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+                    NIMBLE_CPP_CONN_STATS_ACCESS(conn_handle, false, OS_MBUF_PKTLEN(ctxt->om) - readStart, rc);
+                    return rc;
+                }
+
+                if(pCharacteristic->m_connValues != nullptr) {
+                    NimBLEAttValue* pConnValue = pCharacteristic->findConnValue(conn_handle);
+                    if(pConnValue != nullptr) {
+                        rc = pConnValue->appendToMbuf(ctxt->om) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+                        NIMBLE_CPP_CONN_STATS_ACCESS(conn_handle, false, OS_MBUF_PKTLEN(ctxt->om) - readStart, rc);
+                        return rc;
+                    }
+                }
+
+                NimBLECharacteristicCallbacks* pCallbacks = pCharacteristic->m_pCallbacks;
+                uint8_t callbacks = pCallbacks->m_callbacks;
+                uint16_t mtu = ble_att_mtu(conn_handle);
+                if(callbacks & (NimBLECharacteristicCallbacks::CB_ON_READ_DESC |
+                                NimBLECharacteristicCallbacks::CB_ON_READ_INTO)) {
+                    rc = ble_gap_conn_find(conn_handle, &desc);
+                    assert(rc == 0);
+                }
 
                  // If the packet header is only 8 bytes this is a follow up of a long read
                  // so we don't want to call the onRead() callback again.
-                if(ctxt->om->om_pkthdr_len > 8 ||
-                   pCharacteristic->m_value.size() <= (ble_att_mtu(desc.conn_handle) - 3)) {
-                    pCharacteristic->m_pCallbacks->onRead(pCharacteristic);
-                    pCharacteristic->m_pCallbacks->onRead(pCharacteristic, &desc);
+                bool newRead = ctxt->om->om_pkthdr_len > 8;
+                if(newRead || (pCharacteristic->m_pStream == nullptr &&
+                   pCharacteristic->m_value.size() <= (size_t)(mtu - 3))) {
+                    if(callbacks & NimBLECharacteristicCallbacks::CB_ON_READ) {
+                        pCallbacks->onRead(pCharacteristic);
+                    }
+                    if(callbacks & NimBLECharacteristicCallbacks::CB_ON_READ_DESC) {
+                        pCallbacks->onRead(pCharacteristic, &desc);
+                    }
                 }
 
-                ble_npl_hw_enter_critical();
-                rc = os_mbuf_append(ctxt->om, pCharacteristic->m_value.data(), pCharacteristic->m_value.size());
-                ble_npl_hw_exit_critical(0);
-                return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+                rc = NIMBLE_CPP_READ_USE_VALUE;
+                if(callbacks & NimBLECharacteristicCallbacks::CB_ON_READ_INTO) {
+                    rc = pCallbacks->onReadInto(pCharacteristic, ctxt->om, &desc);
+                }
+                if(rc == NIMBLE_CPP_READ_USE_VALUE) {
+                    rc = pCharacteristic->readValueInto(ctxt->om, newRead, mtu);
+                }
+
+                NIMBLE_CPP_CONN_STATS_ACCESS(conn_handle, false, OS_MBUF_PKTLEN(ctxt->om) - readStart, rc);
+                return rc;
             }
 
             case BLE_GATT_ACCESS_OP_WRITE_CHR: {
-                uint16_t att_max_len = pCharacteristic->m_value.max_size();
-
-                if (ctxt->om->om_len > att_max_len) {
-                    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+                if(pCharacteristic->m_pWriteBatch != nullptr) {
+                    rc = pCharacteristic->appendWriteBatch(conn_handle, ctxt->om);
+                    NIMBLE_CPP_CONN_STATS_ACCESS(conn_handle, true, OS_MBUF_PKTLEN(ctxt->om), rc);
+                    return rc;
                 }
 
-                uint8_t buf[att_max_len];
-                size_t len = ctxt->om->om_len;
-                memcpy(buf, ctxt->om->om_data,len);
+                pCharacteristic->m_pStaticValue = nullptr;
+                rc = pCharacteristic->writeValueFrom(ctxt->om);
+                NIMBLE_CPP_CONN_STATS_ACCESS(conn_handle, true, OS_MBUF_PKTLEN(ctxt->om), rc);
+                if(rc != 0) {
+                    return rc;
+                }
 
-                os_mbuf *next;
-                next = SLIST_NEXT(ctxt->om, om_next);
-                while(next != NULL){
-                    if((len + next->om_len) > att_max_len) {
-                        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
-                    }
-                    memcpy(&buf[len], next->om_data, next->om_len);
-                    len += next->om_len;
-                    next = SLIST_NEXT(next, om_next);
+                uint8_t callbacks = pCharacteristic->m_pCallbacks->m_callbacks;
+                if(callbacks & NimBLECharacteristicCallbacks::CB_ON_WRITE_DESC) {
+                    rc = ble_gap_conn_find(conn_handle, &desc);
+                    assert(rc == 0);
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CHR_WRITE, pCharacteristic,
+                                                   desc.conn_handle, &desc);
+                } else if(callbacks & NimBLECharacteristicCallbacks::CB_ON_WRITE) {
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CHR_WRITE, pCharacteristic,
+                                                   conn_handle, nullptr);
                 }
-                rc = ble_gap_conn_find(conn_handle, &desc);
-                assert(rc == 0);
-                pCharacteristic->setValue(buf, len);
-                pCharacteristic->m_pCallbacks->onWrite(pCharacteristic);
-                pCharacteristic->m_pCallbacks->onWrite(pCharacteristic, &desc);
                 return 0;
             }
             default:
@@ -327,15 +576,128 @@ int NimBLECharacteristic::handleGapEvent(uint16_t conn_handle, uint16_t attr_han
 }
 
 
+/**
+ * @brief Append the value to a read response.
+ * @param [in] om The mbuf to append the value to.
+ * @param [in] newRead True if this is the start of a read, false if it continues a long read.
+ * @param [in] mtu The ATT MTU of the connection.
+ * @return 0 on success, or an ATT error code.
+ * @details Sends the data of the stream if the characteristic has one. Overridden by characteristics
+ * that store the value in another form, such as NimBLETypedCharacteristic.
+ */
+int NimBLECharacteristic::readValueInto(struct os_mbuf *om, bool newRead, uint16_t mtu) {
+    if(m_pStream != nullptr) {
+        return m_pStream->appendToMbuf(om, newRead, mtu);
+    }
+
+    return m_value.appendToMbuf(om) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+} // readValueInto
+
+
+/**
+ * @brief Store the data of a write request as the value.
+ * @param [in] om The mbuf chain containing the written data.
+ * @return 0 on success, or an ATT error code.
+ */
+int NimBLECharacteristic::writeValueFrom(const struct os_mbuf *om) {
+    // Copy the mbuf chain straight into the value storage.
+    if(!m_value.setValueFromMbuf(om)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    return 0;
+} // writeValueFrom
+
+
 /**
  * @brief Get the number of clients subscribed to the characteristic.
  * @returns Number of clients subscribed to notifications / indications.
  */
 size_t NimBLECharacteristic::getSubscribedCount() {
-    return m_subscribedVec.size();
+    return m_subscribedCount;
 }
 
 
+/**
+ * @brief Only send the latest value to peers that cannot keep up with the notifications.
+ * @param [in] enabled If true, a notification waiting in the notify queue of a peer is replaced by
+ * the newer value instead of queueing another one.
+ * @details Each peer has at most one waiting notification for this characteristic,
+ * it is queued even if the notify queue depth of the server is reached or set to 0.
+ * Indications are not affected.
+ */
+void NimBLECharacteristic::setNotifyCoalesce(bool enabled) {
+    m_notifyCoalesce = enabled;
+} // setNotifyCoalesce
+
+
+/**
+ * @brief Set the transmit priority class of the notifications and indications of this characteristic.
+ * @param [in] prio One of BLE_HS_TX_PRIO_LOW, BLE_HS_TX_PRIO_NORMAL (default), BLE_HS_TX_PRIO_HIGH
+ * or BLE_HS_TX_PRIO_HIGHEST.
+ * @details When the controller has no free buffer, the packets waiting for a connection are sent highest
+ * class first, so a latency sensitive value is not held behind a bulk transfer. Packets already given
+ * to the controller are not reordered.
+ */
+void NimBLECharacteristic::setTxPriority(uint8_t prio) {
+    m_txPrio = prio < BLE_HS_TX_PRIO_CNT ? prio : BLE_HS_TX_PRIO_HIGHEST;
+} // setTxPriority
+
+
+/**
+ * @brief Get the transmit priority class of the notifications and indications of this characteristic.
+ */
+uint8_t NimBLECharacteristic::getTxPriority() {
+    return m_txPrio;
+} // getTxPriority
+
+
+/**
+ * @brief Limit the rate of the notifications of this characteristic.
+ * @param [in] policy The notify policy, a default constructed policy sends every notification again.
+ * @return True if the policy was set, false if out of memory.
+ * @details With the policy enabled, notify() stores the value as the characteristic value and the server
+ * sends the latest value when the policy allows it, so a producer can call notify() on every sample.
+ */
+bool NimBLECharacteristic::setNotifyPolicy(const NimBLENotifyPolicy &policy) {
+    if(m_pNotifyPolicy == nullptr) {
+        if(!policy.isEnabled()) {
+            return true;
+        }
+
+        ble_notify_policy_state_t* pState = new(std::nothrow) ble_notify_policy_state_t{policy, {}, 0, false, false};
+        if(pState == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "setNotifyPolicy: out of memory");
+            return false;
+        }
+        m_pNotifyPolicy = pState;
+        NimBLEDevice::getServer()->scheduleNotify(this);
+        return true;
+    }
+
+    // The state is kept as the server may be using it from the host task.
+    ble_npl_hw_enter_critical();
+    m_pNotifyPolicy->policy = policy;
+    ble_npl_hw_exit_critical(0);
+
+    if(policy.isEnabled()) {
+        NimBLEDevice::getServer()->scheduleNotify(this);
+    }
+    return true;
+} // setNotifyPolicy
+
+
+/**
+ * @brief Get the notify policy of this characteristic.
+ */
+NimBLENotifyPolicy NimBLECharacteristic::getNotifyPolicy() {
+    if(m_pNotifyPolicy == nullptr) {
+        return NimBLENotifyPolicy();
+    }
+    return m_pNotifyPolicy->policy;
+} // getNotifyPolicy
+
+
 /**
  * @brief Set the subscribe status for this characteristic.\n
  * This will maintain a vector of subscribed clients and their indicate/notify status.
@@ -358,28 +720,46 @@ void NimBLECharacteristic::setSubscribe(struct ble_gap_event *event) {
                           event->subscribe.conn_handle, subVal);
 
     if(!event->subscribe.cur_indicate && event->subscribe.prev_indicate) {
-       NimBLEDevice::getServer()->clearIndicateWait(event->subscribe.conn_handle);
+       NimBLEServer* pServer = NimBLEDevice::getServer();
+       pServer->dropQueuedIndicate(event->subscribe.conn_handle, m_handle);
+       pServer->clearIndicateWait(event->subscribe.conn_handle);
+       pServer->sendQueuedIndicate();
     }
 
 
-    auto it = m_subscribedVec.begin();
-    for(;it != m_subscribedVec.end(); ++it) {
-        if((*it).first == event->subscribe.conn_handle) {
+    uint8_t idx = 0;
+    for(; idx < m_subscribedCount; idx++) {
+        if(m_subscribed[idx].first == event->subscribe.conn_handle) {
             break;
         }
     }
 
     if(subVal > 0) {
-        if(it == m_subscribedVec.end()) {
-            m_subscribedVec.push_back({event->subscribe.conn_handle, subVal});
-        } else {
-            (*it).second = subVal;
+        if(idx < m_subscribedCount) {
+            m_subscribed[idx].second = subVal;
+        } else if(m_subscribedCount < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+            if(m_subscribed == nullptr) {
+                m_subscribed = new(std::nothrow) std::pair<uint16_t, uint16_t>[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+            }
+            if(m_subscribed != nullptr) {
+                m_subscribed[m_subscribedCount++] = {event->subscribe.conn_handle, subVal};
+            } else {
+                NIMBLE_LOGE(LOG_TAG, "Out of memory for the subscription of conn: %d", event->subscribe.conn_handle);
+            }
         }
-    } else if(it != m_subscribedVec.end()) {
-        m_subscribedVec.erase(it);
+    } else if(idx < m_subscribedCount) {
+        // Keep the subscribers packed at the front by moving the last one into the free slot.
+        m_subscribed[idx] = m_subscribed[--m_subscribedCount];
+    }
+
+    // Start the heartbeat of a policy that was set before the server started.
+    if((subVal & NIMBLE_SUB_NOTIFY) && m_pNotifyPolicy != nullptr && m_pNotifyPolicy->policy.isEnabled()) {
+        NimBLEDevice::getServer()->scheduleNotify(this);
     }
 
-    m_pCallbacks->onSubscribe(this, &desc, subVal);
+    if(m_pCallbacks->m_callbacks & NimBLECharacteristicCallbacks::CB_ON_SUBSCRIBE) {
+        NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CHR_SUBSCRIBE, this, desc.conn_handle, &desc, subVal);
+    }
 }
 
 
@@ -415,6 +795,10 @@ void NimBLECharacteristic::indicate(const std::vector<uint8_t>& value) {
  * @param[in] is_notification if true sends a notification, false sends an indication.
  */
 void NimBLECharacteristic::notify(bool is_notification) {
+    if(m_pStaticValue != nullptr) {
+        notify(m_pStaticValue, m_staticLength, is_notification);
+        return;
+    }
     notify(m_value.data(), m_value.length(), is_notification);
 } // notify
 
@@ -436,6 +820,141 @@ void NimBLECharacteristic::notify(const std::vector<uint8_t>& value, bool is_not
  * @param[in] is_notification if true sends a notification, false sends an indication.
  */
 void NimBLECharacteristic::notify(const uint8_t* value, size_t length, bool is_notification) {
+    if(is_notification && m_pNotifyPolicy != nullptr && m_pNotifyPolicy->policy.isEnabled()) {
+        if(value != m_value.data()) {
+            m_pStaticValue = nullptr;
+            m_value.setValue(value, length);
+        }
+        m_pNotifyPolicy->dirty = true;
+        NimBLEDevice::getServer()->scheduleNotify(this);
+        return;
+    }
+
+    sendNotify(value, length, is_notification);
+} // notify
+
+
+/**
+ * @brief Allocate an mbuf for the application to write a notification or indication into.
+ * @param [in] length The length of the value, the packet length of the returned mbuf.
+ * @return The mbuf or nullptr if out of mbufs.
+ * @details The mbuf has the headroom for the HCI, L2CAP and ATT headers reserved so the host sends it
+ * without copying. A value larger than the mbuf block size is a chain, write it in place through the
+ * om_data and om_len of each mbuf of the chain or with os_mbuf_copyinto, then send it with notify(os_mbuf*).
+ * An mbuf that is not sent must be freed with os_mbuf_free_chain.
+ */
+os_mbuf* NimBLECharacteristic::allocNotifyBuffer(uint16_t length) {
+    os_mbuf* om = ble_hs_mbuf_att_pkt();
+    if(om == nullptr) {
+        return nullptr;
+    }
+
+    os_mbuf* last = om;
+    uint16_t remaining = length;
+    while(remaining > 0) {
+        uint16_t chunk = OS_MBUF_TRAILINGSPACE(last);
+        if(chunk == 0) {
+            chunk = om->om_omp->omp_databuf_len;
+        }
+        chunk = std::min(chunk, remaining);
+
+        if(os_mbuf_extend(om, chunk) == nullptr) {
+            os_mbuf_free_chain(om);
+            return nullptr;
+        }
+        while(SLIST_NEXT(last, om_next) != nullptr) {
+            last = SLIST_NEXT(last, om_next);
+        }
+        remaining -= chunk;
+    }
+
+    ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+    return om;
+} // allocNotifyBuffer
+
+
+/**
+ * @brief Send a notification or indication from an mbuf without copying it.
+ * @param[in] om The value, from allocNotifyBuffer, it is consumed.
+ * @param[in] is_notification if true sends a notification, false sends an indication.
+ * @details With a notify policy the value is copied into the characteristic value and sent as notify() does.
+ */
+void NimBLECharacteristic::notify(os_mbuf* om, bool is_notification) {
+    if(om == nullptr) {
+        return;
+    }
+
+    size_t length = OS_MBUF_PKTLEN(om);
+    if(is_notification && m_pNotifyPolicy != nullptr && m_pNotifyPolicy->policy.isEnabled()) {
+        std::vector<uint8_t> value(length);
+        os_mbuf_copydata(om, 0, length, value.data());
+        os_mbuf_free_chain(om);
+        notify(value.data(), length, is_notification);
+        return;
+    }
+
+    sendNotify(nullptr, length, is_notification, om);
+} // notify
+
+
+/**
+ * @brief Send a notification or indication to one subscribed peer.
+ * @param[in] conn_handle The connection handle of the peer.
+ * @param[in] is_notification if true sends a notification, false sends an indication.
+ * @details Sends the value set for the peer with setConnValue, or the value of the characteristic.
+ * Sent now, a notify policy only applies to the notifications sent to all peers.
+ */
+void NimBLECharacteristic::notify(uint16_t conn_handle, bool is_notification) {
+    NimBLEAttValue* pConnValue = findConnValue(conn_handle);
+    if(pConnValue != nullptr) {
+        // Copied, the value of the peer can be set again while it is sent.
+        NimBLEAttValue value = *pConnValue;
+        sendNotify(value.data(), value.length(), is_notification, nullptr, conn_handle);
+        return;
+    }
+
+    if(m_pStaticValue != nullptr) {
+        sendNotify(m_pStaticValue, m_staticLength, is_notification, nullptr, conn_handle);
+        return;
+    }
+    sendNotify(m_value.data(), m_value.length(), is_notification, nullptr, conn_handle);
+} // notify
+
+
+/**
+ * @brief Send a notification or indication to one subscribed peer.
+ * @param[in] conn_handle The connection handle of the peer.
+ * @param[in] value A pointer to the data to send.
+ * @param[in] length The length of the data to send.
+ * @param[in] is_notification if true sends a notification, false sends an indication.
+ * @details The value of the characteristic is not changed.
+ */
+void NimBLECharacteristic::notify(uint16_t conn_handle, const uint8_t* value, size_t length, bool is_notification) {
+    sendNotify(value, length, is_notification, nullptr, conn_handle);
+} // notify
+
+
+/**
+ * @brief Send a notification or indication to one subscribed peer.
+ * @param[in] conn_handle The connection handle of the peer.
+ * @param[in] value A std::vector<uint8_t> containing the value to send as the notification value.
+ * @param[in] is_notification if true sends a notification, false sends an indication.
+ */
+void NimBLECharacteristic::notify(uint16_t conn_handle, const std::vector<uint8_t>& value, bool is_notification) {
+    sendNotify(value.data(), value.size(), is_notification, nullptr, conn_handle);
+} // notify
+
+
+/**
+ * @brief Send a notification or indication to the subscribed peers now.
+ * @param[in] value A pointer to the data to send, nullptr if the data is in pOm.
+ * @param[in] length The length of the data to send.
+ * @param[in] is_notification if true sends a notification, false sends an indication.
+ * @param[in] pOm An mbuf holding the data to send instead of value, it is consumed.
+ * @param[in] target The connection handle of the peer to send to, BLE_HS_CONN_HANDLE_NONE for all subscribed peers.
+ */
+void NimBLECharacteristic::sendNotify(const uint8_t* value, size_t length, bool is_notification, os_mbuf* pOm,
+                                      uint16_t target) {
     NIMBLE_LOGD(LOG_TAG, ">> notify: length: %d", length);
 
     if(!(m_properties & NIMBLE_PROPERTY::NOTIFY) &&
@@ -443,77 +962,201 @@ void NimBLECharacteristic::notify(const uint8_t* value, size_t length, bool is_n
     {
         NIMBLE_LOGE(LOG_TAG,
                     "<< notify-Error; Notify/indicate not enabled for characteristic: %s",
-                    std::string(getUUID()).c_str());
+                    NIMBLE_CPP_STR(getUUID()));
     }
 
-    if (m_subscribedVec.size() == 0) {
+    if (m_subscribedCount == 0) {
         NIMBLE_LOGD(LOG_TAG, "<< notify: No clients subscribed.");
+        if(pOm != nullptr) {
+            os_mbuf_free_chain(pOm);
+        }
         return;
     }
 
-    m_pCallbacks->onNotify(this);
+    if(m_pCallbacks->m_callbacks & NimBLECharacteristicCallbacks::CB_ON_NOTIFY) {
+        m_pCallbacks->onNotify(this);
+    }
 
     bool reqSec = (m_properties & BLE_GATT_CHR_F_READ_AUTHEN) ||
                   (m_properties & BLE_GATT_CHR_F_READ_AUTHOR) ||
                   (m_properties & BLE_GATT_CHR_F_READ_ENC);
     int rc = 0;
+    NimBLEServer* pServer = NimBLEDevice::getServer();
+    // The connection handle of each subscriber to send to and whether to send a notification or indication.
+    std::pair<uint16_t, bool> targets[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t numTargets = 0;
+
+    uint8_t first = 0;
+    uint8_t end = m_subscribedCount;
+    if(target != BLE_HS_CONN_HANDLE_NONE) {
+        // Only the subscription of the peer is checked.
+        while(first < end && m_subscribed[first].first != target) {
+            first++;
+        }
+        end = first < end ? first + 1 : first;
+    }
 
-    for (auto &it : m_subscribedVec) {
-        uint16_t _mtu = getService()->getServer()->getPeerMTU(it.first) - 3;
-
-        // check if connected and subscribed
-        if(_mtu == 0 || it.second == 0) {
+    for (uint8_t i = first; i < end; i++) {
+        const std::pair<uint16_t, uint16_t> &it = m_subscribed[i];
+        if(it.second == 0) {
             continue;
         }
 
-        // check if security requirements are satisfied
-        if(reqSec) {
-            struct ble_gap_conn_desc desc;
-            rc = ble_gap_conn_find(it.first, &desc);
-            if(rc != 0 || !desc.sec_state.encrypted) {
+        uint16_t _mtu;
+        bool encrypted;
+        NimBLEServer::ble_peer_state_t* pPeer = pServer->getPeerState(it.first);
+        if(pPeer == nullptr) {
+            // Not a connection made to the server, cache it now, the client keeps it updated.
+            pServer->updatePeerState(it.first);
+            pPeer = pServer->getPeerState(it.first);
+            if(pPeer == nullptr) {
                 continue;
             }
         }
+        _mtu = pPeer->mtu;
+        encrypted = pPeer->encrypted;
+
+        // check if connected
+        if(_mtu == 0) {
+            continue;
+        }
+        _mtu -= 3;
+
+        // check if security requirements are satisfied
+        if(reqSec && !encrypted) {
+            continue;
+        }
 
         if (length > _mtu) {
             NIMBLE_LOGW(LOG_TAG, "- Truncating to %d bytes (maximum notify size)", _mtu);
         }
 
-        if(is_notification && (!(it.second & NIMBLE_SUB_NOTIFY))) {
+        bool sendNotification = is_notification;
+        if(sendNotification && (!(it.second & NIMBLE_SUB_NOTIFY))) {
             NIMBLE_LOGW(LOG_TAG,
             "Sending notification to client subscribed to indications, sending indication instead");
-            is_notification = false;
+            sendNotification = false;
         }
 
-        if(!is_notification && (!(it.second & NIMBLE_SUB_INDICATE))) {
+        if(!sendNotification && (!(it.second & NIMBLE_SUB_INDICATE))) {
             NIMBLE_LOGW(LOG_TAG,
             "Sending indication to client subscribed to notification, sending notification instead");
-            is_notification = true;
+            sendNotification = true;
+        }
+
+        targets[numTargets++] = {it.first, sendNotification};
+    }
+
+    // don't create the m_buf until we are sure to send the data or else
+    // we could be allocating a buffer that doesn't get released.
+    if(numTargets == 0) {
+        NIMBLE_LOGD(LOG_TAG, "<< notify: No clients to send to.");
+        if(pOm != nullptr) {
+            os_mbuf_free_chain(pOm);
         }
+        return;
+    }
 
-        // don't create the m_buf until we are sure to send the data or else
-        // we could be allocating a buffer that doesn't get released.
-        // We also must create it in each loop iteration because it is consumed with each host call.
-        os_mbuf *om = ble_hs_mbuf_from_flat(value, length);
+    // The payload is copied into an mbuf once. Each host call consumes its mbuf chain,
+    // so every subscriber but the last is sent a duplicate of the chain.
+    os_mbuf *om = pOm;
+    bool omUsed = false;
+    if(om == nullptr) {
+        om = ble_hs_mbuf_from_flat(value, length);
+        if(om != nullptr) {
+            ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+        }
+    }
+
+    // The queues keep a copy of the value, taken from the mbuf if the value was not given flat.
+    std::vector<uint8_t> flat;
+    auto queueValue = [&]() -> const uint8_t* {
+        if(value == nullptr) {
+            flat.resize(length);
+            os_mbuf_copydata(om, 0, length, flat.data());
+            value = flat.data();
+        }
+        return value;
+    };
+
+    for(size_t i = 0; i < numTargets; i++) {
+        uint16_t conn_handle = targets[i].first;
+        bool sendNotification = targets[i].second || !(m_properties & NIMBLE_PROPERTY::INDICATE);
+        os_mbuf *txom = nullptr;
+
+        // Notifications are queued behind any already waiting for this peer to keep them in order.
+        bool queueBehind = sendNotification && pServer->getNotifyQueueCount(conn_handle) > 0;
+        if(om != nullptr && !queueBehind) {
+            if(i + 1 == numTargets) {
+                txom = om;
+                omUsed = true;
+            } else {
+                txom = os_mbuf_dup(om);
+            }
+        }
 
-        if(!is_notification && (m_properties & NIMBLE_PROPERTY::INDICATE)) {
-            if(!NimBLEDevice::getServer()->setIndicateWait(it.first)) {
-               NIMBLE_LOGE(LOG_TAG, "prior Indication in progress");
-               os_mbuf_free_chain(om);
-               return;
+        if(txom == nullptr) {
+            if(!queueBehind) {
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, mbufAllocFailures, 1);
             }
 
-            rc = ble_gattc_indicate_custom(it.first, m_handle, om);
+            if(!sendNotification) {
+                NIMBLE_LOGE(LOG_TAG, "notify: Out of mbufs for conn_handle=%d", conn_handle);
+                m_pCallbacks->onStatus(this, NimBLECharacteristicCallbacks::Status::ERROR_INDICATE_FAILURE,
+                                       BLE_HS_ENOMEM);
+            } else if(!pServer->queueNotify(conn_handle, m_handle, queueValue(), length,
+                                                m_notifyCoalesce, m_txPrio)) {
+                if(queueBehind) {
+                    NIMBLE_CPP_CONN_STATS_ADD(conn_handle, mbufAllocFailures, 1);
+                }
+                NIMBLE_LOGE(LOG_TAG, "notify: Out of mbufs, dropped for conn_handle=%d", conn_handle);
+                m_pCallbacks->onStatus(this, NimBLECharacteristicCallbacks::Status::ERROR_GATT, BLE_HS_ENOMEM);
+            }
+            continue;
+        }
+
+        if(!sendNotification) {
+            // Indications to other peers are sent while this peer confirms the prior one.
+            if(!pServer->setIndicateWait(conn_handle)) {
+                if(txom != om) {
+                    os_mbuf_free_chain(txom);
+                } else {
+                    omUsed = false;
+                }
+
+                if(!pServer->queueIndicate(conn_handle, m_handle, queueValue(), length, m_txPrio)) {
+                    NIMBLE_LOGE(LOG_TAG, "prior Indication in progress, dropped for conn_handle=%d", conn_handle);
+                    m_pCallbacks->onStatus(this, NimBLECharacteristicCallbacks::Status::ERROR_INDICATE_FAILURE,
+                                           BLE_HS_ENOMEM);
+                }
+                continue;
+            }
+
+            rc = ble_gattc_indicate_custom(conn_handle, m_handle, txom);
             if(rc != 0){
-                NimBLEDevice::getServer()->clearIndicateWait(it.first);
+                pServer->clearIndicateWait(conn_handle);
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, txFailures, 1);
+            } else {
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, indicateTxPackets, 1);
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, indicateTxBytes, length);
             }
         } else {
-            ble_gattc_notify_custom(it.first, m_handle, om);
+            rc = ble_gattc_notify_custom(conn_handle, m_handle, txom);
+            if(rc != 0) {
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, txFailures, 1);
+            } else {
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, notifyTxPackets, 1);
+                NIMBLE_CPP_CONN_STATS_ADD(conn_handle, notifyTxBytes, length);
+            }
         }
     }
 
+    if(om != nullptr && !omUsed) {
+        os_mbuf_free_chain(om);
+    }
+
     NIMBLE_LOGD(LOG_TAG, "<< notify");
-} // Notify
+} // sendNotify
 
 
 /**
@@ -537,6 +1180,149 @@ NimBLECharacteristicCallbacks* NimBLECharacteristic::getCallbacks() {
 } //getCallbacks
 
 
+/**
+ * @brief Make this a streaming characteristic that is read from a circular buffer.
+ * @param [in] size The number of bytes the stream can hold.
+ * @return A pointer to the stream to write the data to, or nullptr if it could not be allocated.
+ * @details Reads of the characteristic return the data written to the stream that the client has not
+ * read yet instead of the value, see NimBLEAttStream. Any previous stream is deleted.
+ */
+NimBLEAttStream* NimBLECharacteristic::createStream(uint16_t size) {
+    NimBLEAttStream* pStream = new NimBLEAttStream(size);
+    if(pStream->getSize() != size) {
+        delete pStream;
+        return nullptr;
+    }
+
+    NimBLEAttStream* pOld = m_pStream;
+    m_pStream = pStream;
+    if(pOld != nullptr) {
+        delete pOld;
+    }
+
+    return pStream;
+} // createStream
+
+
+/**
+ * @brief Get the stream of a streaming characteristic.
+ * @return A pointer to the stream or nullptr if the characteristic does not stream.
+ */
+NimBLEAttStream* NimBLECharacteristic::getStream() {
+    return m_pStream;
+} // getStream
+
+
+/**
+ * @brief Deliver the data written to this characteristic in batches instead of one write at a time.
+ * @param [in] size The size of the batch buffer in bytes, 0 to deliver each write again as it is received.
+ * @param [in] batchBytes Deliver the batch as soon as it holds this many bytes, 0 to wait for the end of the burst.
+ * @return True on success, false if out of memory.
+ * @details For peers that stream data with write commands. The data of consecutive writes is copied
+ * into the buffer and given to NimBLECharacteristicCallbacks::onWriteBatch() from the host task once the writes
+ * received together have been processed, which is at most every connection event, when batchBytes are held,
+ * when the buffer is full or when a write comes from another connection. The value of the characteristic
+ * is not changed and onWrite() is not called for the batched writes.
+ *
+ * Should be set before the peers start writing, a pending batch is dropped when the setting is changed.
+ */
+bool NimBLECharacteristic::setWriteBatch(uint16_t size, uint16_t batchBytes) {
+    ble_write_batch_t* pBatch = nullptr;
+    if(size > 0) {
+        pBatch = new(std::nothrow) ble_write_batch_t;
+        uint8_t* pBuf = new(std::nothrow) uint8_t[size];
+        if(pBatch == nullptr || pBuf == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "setWriteBatch: out of memory");
+            delete pBatch;
+            delete[] pBuf;
+            return false;
+        }
+
+        ble_npl_event_init(&pBatch->ev, NimBLECharacteristic::writeBatchCb, this);
+        pBatch->buf        = pBuf;
+        pBatch->size       = size;
+        pBatch->len        = 0;
+        pBatch->batchBytes = std::min(batchBytes, size);
+        pBatch->connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
+
+    ble_write_batch_t* pOld = m_pWriteBatch;
+    m_pWriteBatch = pBatch;
+    if(pOld != nullptr) {
+        ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &pOld->ev);
+        ble_npl_event_deinit(&pOld->ev);
+        delete[] pOld->buf;
+        delete pOld;
+    }
+
+    return true;
+} // setWriteBatch
+
+
+/**
+ * @brief Add the data of a write to the batch.
+ * @param [in] conn_handle The connection that wrote the data.
+ * @param [in] om The mbuf chain containing the written data.
+ * @return 0 on success, or an ATT error code.
+ */
+int NimBLECharacteristic::appendWriteBatch(uint16_t conn_handle, const struct os_mbuf *om) {
+    ble_write_batch_t* pBatch = m_pWriteBatch;
+    uint16_t total = OS_MBUF_PKTLEN(om);
+    if(total > m_value.max_size()) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    // A batch only holds the data of one connection.
+    if(pBatch->connHandle != conn_handle) {
+        flushWriteBatch();
+        pBatch->connHandle = conn_handle;
+    }
+
+    uint16_t offset = 0;
+    while(offset < total) {
+        uint16_t copyLen = std::min<uint16_t>(total - offset, pBatch->size - pBatch->len);
+        os_mbuf_copydata(om, offset, copyLen, pBatch->buf + pBatch->len);
+        pBatch->len += copyLen;
+        offset += copyLen;
+        if(pBatch->len == pBatch->size) {
+            flushWriteBatch();
+        }
+    }
+
+    if(pBatch->batchBytes > 0 && pBatch->len >= pBatch->batchBytes) {
+        flushWriteBatch();
+    } else if(pBatch->len > 0 && !ble_npl_event_is_queued(&pBatch->ev)) {
+        // Runs after the packets already queued to the host task, the end of the burst.
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &pBatch->ev);
+    }
+
+    return 0;
+} // appendWriteBatch
+
+
+/**
+ * @brief Give the batched data to the application, called from the host task.
+ */
+void NimBLECharacteristic::flushWriteBatch() {
+    ble_write_batch_t* pBatch = m_pWriteBatch;
+    if(pBatch == nullptr || pBatch->len == 0) {
+        return;
+    }
+
+    m_pCallbacks->onWriteBatch(this, pBatch->buf, pBatch->len, pBatch->connHandle);
+    pBatch->len = 0;
+} // flushWriteBatch
+
+
+/**
+ * @brief Host task event that delivers a batch at the end of a burst of writes.
+ */
+/* STATIC */
+void NimBLECharacteristic::writeBatchCb(ble_npl_event *event) {
+    ((NimBLECharacteristic*)ble_npl_event_get_arg(event))->flushWriteBatch();
+} // writeBatchCb
+
+
 /**
  * @brief Set the value of the characteristic from a data buffer .
  * @param [in] data The data buffer to set for the characteristic.
@@ -546,10 +1332,11 @@ void NimBLECharacteristic::setValue(const uint8_t* data, size_t length) {
 #if CONFIG_NIMBLE_CPP_LOG_LEVEL >= 4
     char* pHex = NimBLEUtils::buildHexData(nullptr, data, length);
     NIMBLE_LOGD(LOG_TAG, ">> setValue: length=%d, data=%s, characteristic UUID=%s",
-                length, pHex, getUUID().toString().c_str());
+                length, pHex, NIMBLE_CPP_STR(getUUID()));
     free(pHex);
 #endif
 
+    m_pStaticValue = nullptr;
     m_value.setValue(data, length);
     NIMBLE_LOGD(LOG_TAG, "<< setValue");
 } // setValue
@@ -604,6 +1391,24 @@ void NimBLECharacteristicCallbacks::onRead(NimBLECharacteristic* pCharacteristic
     NIMBLE_LOGD("NimBLECharacteristicCallbacks", "onRead: default");
 } // onRead
 
+/**
+ * @brief Callback function to provide the data of a read request directly.
+ * @param [in] pCharacteristic The characteristic that is the source of the event.
+ * @param [in] om The response mbuf, append the full value to it with os_mbuf_append().
+ * @param [in] desc The connection description struct that is associated with the peer that performed the read.
+ * @return 0 if the value was appended, a BLE_ATT_ERR_* code to reject the read or
+ * NIMBLE_CPP_READ_USE_VALUE (default) to send the stored value of the characteristic.
+ * @details Called from the host task after onRead() for every read request, including each part of a long read.
+ * The full value must be appended each time, the host sends the part at the requested offset.
+ * Data can be appended from any source, such as a ring buffer or flash, without a copy into the stored value
+ * and without disabling interrupts while it is copied.
+ */
+int NimBLECharacteristicCallbacks::onReadInto(NimBLECharacteristic* pCharacteristic, struct os_mbuf* om,
+                                              ble_gap_conn_desc* desc)
+{
+    return NIMBLE_CPP_READ_USE_VALUE;
+} // onReadInto
+
 /**
  * @brief Callback function to support a write request.
  * @param [in] pCharacteristic The characteristic that is the source of the event.
@@ -658,4 +1463,19 @@ void NimBLECharacteristicCallbacks::onSubscribe(NimBLECharacteristic* pCharacter
     NIMBLE_LOGD("NimBLECharacteristicCallbacks", "onSubscribe: default");
 }
 
+
+/**
+ * @brief Callback function called with the data of a batch of writes, see NimBLECharacteristic::setWriteBatch().
+ * @param [in] pCharacteristic The characteristic that was written to.
+ * @param [in] data The data of the writes in the order they were received.
+ * @param [in] length The number of bytes of data.
+ * @param [in] connHandle The connection that wrote the data.
+ * @details Called from the host task, the data is only valid until the callback returns.
+ */
+void NimBLECharacteristicCallbacks::onWriteBatch(NimBLECharacteristic* pCharacteristic, const uint8_t* data,
+                                                 size_t length, uint16_t connHandle)
+{
+    NIMBLE_LOGD("NimBLECharacteristicCallbacks", "onWriteBatch: default");
+}
+
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
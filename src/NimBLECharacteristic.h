@@ -43,8 +43,13 @@ typedef enum {
 } NIMBLE_PROPERTY;
 
 #include "NimBLEService.h"
+#include "NimBLEArena.h"
 #include "NimBLEDescriptor.h"
 #include "NimBLEAttValue.h"
+#include "NimBLEAttStream.h"
+#include "NimBLEAttIndex.h"
+#include "NimBLENotifyPolicy.h"
+#include "NimBLECallbackBinding.h"
 
 #include <string>
 #include <vector>
@@ -62,6 +67,11 @@ class NimBLECharacteristicCallbacks;
  */
 class NimBLECharacteristic {
 public:
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+    static void*    operator new(size_t size);
+    static void     operator delete(void* ptr);
+#endif
+
     NimBLECharacteristic(const char* uuid,
                          uint16_t properties =
                          NIMBLE_PROPERTY::READ |
@@ -75,7 +85,7 @@ public:
                          uint16_t max_len = BLE_ATT_ATTR_MAX_LEN,
                          NimBLEService* pService = nullptr);
 
-    ~NimBLECharacteristic();
+    virtual ~NimBLECharacteristic();
 
     uint16_t          getHandle();
     NimBLEUUID        getUUID();
@@ -86,7 +96,19 @@ public:
     void              notify(bool is_notification = true);
     void              notify(const uint8_t* value, size_t length, bool is_notification = true);
     void              notify(const std::vector<uint8_t>& value, bool is_notification = true);
+    void              notify(os_mbuf* om, bool is_notification = true);
+    void              notify(uint16_t conn_handle, bool is_notification = true);
+    void              notify(uint16_t conn_handle, const uint8_t* value, size_t length,
+                             bool is_notification = true);
+    void              notify(uint16_t conn_handle, const std::vector<uint8_t>& value,
+                             bool is_notification = true);
+    os_mbuf*          allocNotifyBuffer(uint16_t length);
     size_t            getSubscribedCount();
+    void              setNotifyCoalesce(bool enabled);
+    void              setTxPriority(uint8_t prio);
+    uint8_t           getTxPriority();
+    bool              setNotifyPolicy(const NimBLENotifyPolicy &policy);
+    NimBLENotifyPolicy getNotifyPolicy();
     void              addDescriptor(NimBLEDescriptor *pDescriptor);
     NimBLEDescriptor* getDescriptorByUUID(const char* uuid);
     NimBLEDescriptor* getDescriptorByUUID(const NimBLEUUID &uuid);
@@ -98,6 +120,11 @@ public:
     size_t            getDataLength();
     void              setValue(const uint8_t* data, size_t size);
     void              setValue(const std::vector<uint8_t>& vec);
+    void              setStaticValue(const uint8_t* data, uint16_t length);
+    bool              setConnValue(uint16_t conn_handle, const uint8_t* data, size_t length);
+    bool              setConnValue(uint16_t conn_handle, const std::vector<uint8_t>& vec);
+    NimBLEAttValue    getConnValue(uint16_t conn_handle);
+    void              clearConnValue(uint16_t conn_handle);
     void              setCallbacks(NimBLECharacteristicCallbacks* pCallbacks);
     NimBLEDescriptor* createDescriptor(const char* uuid,
                                        uint32_t properties =
@@ -111,6 +138,9 @@ public:
                                        uint16_t max_len = BLE_ATT_ATTR_MAX_LEN);
 
     NimBLECharacteristicCallbacks* getCallbacks();
+    NimBLEAttStream*  createStream(uint16_t size);
+    NimBLEAttStream*  getStream();
+    bool              setWriteBatch(uint16_t size, uint16_t batchBytes = 0);
 
 
     /*********************** Template Functions ************************/
@@ -120,7 +150,7 @@ public:
      * @param [in] s The value to set.
      */
     template<typename T>
-    void              setValue(const T &s) { m_value.setValue<T>(s); }
+    void              setValue(const T &s) { m_pStaticValue = nullptr; m_value.setValue<T>(s); }
 
     /**
      * @brief Template to convert the characteristic data to <type\>.
@@ -168,15 +198,61 @@ public:
         indicate((uint8_t*)value.c_str(), value.length());
     }
 
+    /**
+     * @brief Get the access callback to use in a static characteristic definition, see NIMBLE_STATIC_CHR.
+     */
+    static constexpr ble_gatt_access_fn* staticAccessCb() { return handleGapEvent; }
+
+    /**
+     * @brief Get the handle storage of a characteristic to use in a static characteristic definition.
+     * @param [in] chr The characteristic object bound to the definition.
+     */
+    static constexpr uint16_t* staticValHandle(NimBLECharacteristic &chr) { return &chr.m_handle; }
+
+protected:
+    virtual int     readValueInto(struct os_mbuf *om, bool newRead, uint16_t mtu);
+    virtual int     writeValueFrom(const struct os_mbuf *om);
+
 private:
 
     friend class    NimBLEServer;
     friend class    NimBLEService;
+    friend class    NimBLEDevice;
+    friend class    NimBLEHIDReportSender;
+
+    /**
+     * @brief The notify policy of the characteristic and the value last sent under it.
+     */
+    typedef struct {
+        NimBLENotifyPolicy   policy;
+        std::vector<uint8_t> lastValue;
+        ble_npl_time_t       lastTx;
+        bool                 dirty;
+        bool                 sent;
+    } ble_notify_policy_state_t;
+
+    /**
+     * @brief The written data waiting to be delivered together with onWriteBatch().
+     */
+    typedef struct {
+        ble_npl_event        ev;
+        uint8_t*             buf;
+        uint16_t             size;
+        uint16_t             len;
+        uint16_t             batchBytes;
+        uint16_t             connHandle;
+    } ble_write_batch_t;
 
     void            setService(NimBLEService *pService);
     void            setSubscribe(struct ble_gap_event *event);
+    void            sendNotify(const uint8_t* value, size_t length, bool is_notification,
+                               os_mbuf* pOm = nullptr, uint16_t target = BLE_HS_CONN_HANDLE_NONE);
     static int      handleGapEvent(uint16_t conn_handle, uint16_t attr_handle,
                                    struct ble_gatt_access_ctxt *ctxt, void *arg);
+    int             appendWriteBatch(uint16_t conn_handle, const struct os_mbuf *om);
+    void            flushWriteBatch();
+    static void     writeBatchCb(ble_npl_event *event);
+    NimBLEAttValue* findConnValue(uint16_t conn_handle);
 
     NimBLEUUID                     m_uuid;
     uint16_t                       m_handle;
@@ -184,13 +260,33 @@ private:
     NimBLECharacteristicCallbacks* m_pCallbacks;
     NimBLEService*                 m_pService;
     NimBLEAttValue                 m_value;
+    NimBLEAttStream*               m_pStream;
+    const uint8_t*                 m_pStaticValue;
+    uint16_t                       m_staticLength;
     std::vector<NimBLEDescriptor*> m_dscVec;
+    NimBLEAttIndex<NimBLEDescriptor> m_dscIndex;
     uint8_t                        m_removed;
+    bool                           m_notifyCoalesce;
+    uint8_t                        m_txPrio;
+    // Allocated when a notify policy is first set and kept until deleted.
+    ble_notify_policy_state_t*     m_pNotifyPolicy;
 
-    std::vector<std::pair<uint16_t, uint16_t>>  m_subscribedVec;
+    // Connection handle and subscription value of each subscribed peer, the first m_subscribedCount are in use.
+    // Allocated for CONFIG_BT_NIMBLE_MAX_CONNECTIONS peers on the first subscription and kept until deleted.
+    std::pair<uint16_t, uint16_t>* m_subscribed;
+    uint8_t                        m_subscribedCount;
+    // Allocated by setWriteBatch, the written data is delivered in batches while set.
+    ble_write_batch_t*             m_pWriteBatch;
+    // Connection handle and value of each peer with its own value, indexed by the connection slot.
+    // Allocated for CONFIG_BT_NIMBLE_MAX_CONNECTIONS peers on the first value set, the values are kept for reuse.
+    std::pair<uint16_t, NimBLEAttValue*>* m_connValues;
 }; // NimBLECharacteristic
 
 
+/** Returned by NimBLECharacteristicCallbacks::onReadInto to send the stored value instead. */
+#define NIMBLE_CPP_READ_USE_VALUE (-1)
+
+
 /**
  * @brief Callbacks that can be associated with a %BLE characteristic to inform of events.
  *
@@ -217,15 +313,78 @@ public:
         ERROR_INDICATE_FAILURE
     }Status;
 
+    /** @brief The callbacks of a NimBLEBoundCharacteristicCallbacks class that are called. */
+    enum {
+        CB_ON_READ         = 0x01, /**< onRead(pCharacteristic) */
+        CB_ON_READ_DESC    = 0x02, /**< onRead(pCharacteristic, desc) */
+        CB_ON_READ_INTO    = 0x04, /**< onReadInto */
+        CB_ON_WRITE        = 0x08, /**< onWrite(pCharacteristic) */
+        CB_ON_WRITE_DESC   = 0x10, /**< onWrite(pCharacteristic, desc) */
+        CB_ON_NOTIFY       = 0x20, /**< onNotify */
+        CB_ON_STATUS       = 0x40, /**< onStatus */
+        CB_ON_SUBSCRIBE    = 0x80, /**< onSubscribe */
+        CB_ALL             = 0xFF
+    };
+
+                 NimBLECharacteristicCallbacks() : m_callbacks(CB_ALL) {}
     virtual      ~NimBLECharacteristicCallbacks();
     virtual void onRead(NimBLECharacteristic* pCharacteristic);
     virtual void onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc);
+    virtual int  onReadInto(NimBLECharacteristic* pCharacteristic, struct os_mbuf* om, ble_gap_conn_desc* desc);
     virtual void onWrite(NimBLECharacteristic* pCharacteristic);
     virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc);
     virtual void onNotify(NimBLECharacteristic* pCharacteristic);
     virtual void onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code);
     virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue);
+    virtual void onWriteBatch(NimBLECharacteristic* pCharacteristic, const uint8_t* data, size_t length,
+                              uint16_t connHandle);
+
+protected:
+    explicit     NimBLECharacteristicCallbacks(uint8_t callbacks) : m_callbacks(callbacks) {}
+
+private:
+    friend class NimBLECharacteristic;
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    uint8_t      m_callbacks;
 };
 
+
+/**
+ * @brief Characteristic callbacks bound at compile time, only the callbacks T overrides are called.
+ * @details Derive the callbacks class from this template with itself as T instead of from
+ * NimBLECharacteristicCallbacks, e.g. `class MyCallbacks : public NimBLEBoundCharacteristicCallbacks<MyCallbacks>`.
+ * The overload of onRead and onWrite that is not implemented is not called and the connection
+ * is not looked up for callbacks that do not take a ble_gap_conn_desc. The callbacks of T must be public.
+ */
+template<class T>
+class NimBLEBoundCharacteristicCallbacks : public NimBLECharacteristicCallbacks {
+public:
+    NimBLEBoundCharacteristicCallbacks() : NimBLECharacteristicCallbacks(callbacks()) {
+        static_assert(callbacks() != 0, "No public callbacks found, declare the overrides public");
+    }
+
+    /** @brief The CB_ON_* bits of the callbacks T overrides. */
+    static constexpr uint8_t callbacks() {
+        typedef NimBLECharacteristicCallbacks B;
+        return NIMBLE_CPP_CALLBACK_BIT(T, B, onRead, void(NimBLECharacteristic*), CB_ON_READ) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onRead, void(NimBLECharacteristic*, ble_gap_conn_desc*),
+                                       CB_ON_READ_DESC) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onReadInto,
+                                       int(NimBLECharacteristic*, struct os_mbuf*, ble_gap_conn_desc*),
+                                       CB_ON_READ_INTO) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onWrite, void(NimBLECharacteristic*), CB_ON_WRITE) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onWrite, void(NimBLECharacteristic*, ble_gap_conn_desc*),
+                                       CB_ON_WRITE_DESC) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onNotify, void(NimBLECharacteristic*), CB_ON_NOTIFY) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onStatus, void(NimBLECharacteristic*, Status, int),
+                                       CB_ON_STATUS) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onSubscribe,
+                                       void(NimBLECharacteristic*, ble_gap_conn_desc*, uint16_t),
+                                       CB_ON_SUBSCRIBE);
+    }
+}; // NimBLEBoundCharacteristicCallbacks
+
 #endif /* CONFIG_BT_ENABLED  && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
 #endif /*MAIN_NIMBLECHARACTERISTIC_H_*/
@@ -21,6 +21,7 @@
 #include <string>
 #include <unordered_set>
 #include <climits>
+#include <algorithm>
 
 #if defined(CONFIG_NIMBLE_CPP_IDF)
 #include "nimble/nimble_port.h"
@@ -28,8 +29,45 @@
 #include "nimble/porting/nimble/include/nimble/nimble_port.h"
 #endif
 
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+#include "nvs.h"
+#endif
+
+// Initiator scan interval and window of a fast reconnect in 0.625ms units, the window covers the interval.
+#define NIMBLE_CPP_FAST_RECONNECT_SCAN_ITVL 48
+// Highest connection interval requested by a fast reconnect in 1.25ms units.
+#define NIMBLE_CPP_FAST_RECONNECT_ITVL_MAX 12
+
 static const char* LOG_TAG = "NimBLEClient";
-static NimBLEClientCallbacks defaultCallbacks;
+
+/* State of the encryption started from the stored LTK when the connection is made. */
+#define NIMBLE_CPP_ENC_IDLE     0
+#define NIMBLE_CPP_ENC_PENDING  1 // Started, connect() is not waiting for it yet.
+#define NIMBLE_CPP_ENC_WAITING  2 // connect() is waiting for it to complete.
+
+/** The callbacks of a client without its own, none of the CB_ON_* callbacks is called. */
+class NimBLEDefaultClientCallbacks : public NimBLEClientCallbacks {
+public:
+    NimBLEDefaultClientCallbacks() : NimBLEClientCallbacks(0) {}
+};
+
+static NimBLEDefaultClientCallbacks defaultCallbacks;
+
+// Async discovery characteristic index value before the characteristics of the service are discovered.
+#define NIMBLE_CPP_DISC_CHRS_PENDING SIZE_MAX
+
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+#define NIMBLE_CPP_GATT_CACHE_NAMESPACE "nimble_cpp_gc"
+#define NIMBLE_CPP_GATT_CACHE_VERSION   1
+#define NIMBLE_CPP_GATT_CACHE_HASH_LEN  16
+
+// Database Hash read state used when the cache is saved from the host task.
+typedef struct {
+    NimBLEClient *pClient;
+    uint8_t       hash[NIMBLE_CPP_GATT_CACHE_HASH_LEN];
+    bool          hasHash;
+} ble_cache_hash_t;
+#endif
 
 /*
  * Design
@@ -57,14 +95,33 @@ static NimBLEClientCallbacks defaultCallbacks;
  * @brief Constructor, private - only callable by NimBLEDevice::createClient
  * to ensure proper handling of the list of client objects.
  */
-NimBLEClient::NimBLEClient(const NimBLEAddress &peerAddress) : m_peerAddress(peerAddress) {
+NimBLEClient::NimBLEClient(const NimBLEAddress &peerAddress) : m_peerAddress(peerAddress)
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+    , m_arena(CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE)
+#endif
+{
     m_pClientCallbacks = &defaultCallbacks;
     m_conn_id          = BLE_HS_CONN_HANDLE_NONE;
     m_connectTimeout   = 30000;
     m_deleteCallbacks  = false;
     m_pTaskData        = nullptr;
     m_connEstablished  = false;
+    m_autoEncrypt      = false;
+    m_useAcceptList    = false;
+    m_reconnectOnSync  = false;
+    m_encState         = NIMBLE_CPP_ENC_IDLE;
     m_lastErr          = 0;
+    m_useLinkProfile   = false;
+    m_prepareLink      = false;
+    m_prepareDiscover  = false;
+    m_discCallback     = nullptr;
+    m_charHandleMapValid = false;
+    m_charHandleMapGen = 0;
+    m_opOwner          = nullptr;
+    m_opDepth          = 0;
+    m_discSvcIdx       = 0;
+    m_discChrIdx       = NIMBLE_CPP_DISC_CHRS_PENDING;
+    m_singlePassDisc   = false;
 #if CONFIG_BT_NIMBLE_EXT_ADV
     m_phyMask          = BLE_GAP_LE_PHY_1M_MASK |
                          BLE_GAP_LE_PHY_2M_MASK |
@@ -94,6 +151,9 @@ NimBLEClient::~NimBLEClient() {
     // We may have allocated service references associated with this client.
     // Before we are finished with the client, we must release resources.
     deleteServices();
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+    m_arena.release();
+#endif
 
     if(m_deleteCallbacks && m_pClientCallbacks != &defaultCallbacks) {
         delete m_pClientCallbacks;
@@ -104,6 +164,39 @@ NimBLEClient::~NimBLEClient() {
 } // ~NimBLEClient
 
 
+/**
+ * @brief Allocate a remote service, characteristic or descriptor of a client.
+ * @param [in] size The size of the object.
+ * @param [in] pClient The client the object belongs to.
+ * @details With CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER the attributes of a peer are allocated in
+ * discovery order, which is handle order, from one region owned by the client.
+ */
+void* NimBLEClient::allocAttribute(size_t size, NimBLEClient* pClient) {
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+    return pClient->m_arena.allocOwned(size);
+#elif CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE > 0
+    return NimBLEArena::client().alloc(size);
+#else
+    return ::operator new(size);
+#endif
+} // allocAttribute
+
+
+/**
+ * @brief Free a remote service, characteristic or descriptor allocated with allocAttribute.
+ * @param [in] ptr A pointer to the object memory.
+ */
+void NimBLEClient::freeAttribute(void* ptr) {
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+    NimBLEArena::freeOwned(ptr);
+#elif CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE > 0
+    NimBLEArena::client().free(ptr);
+#else
+    ::operator delete(ptr);
+#endif
+} // freeAttribute
+
+
 /**
  * @brief If we have asked to disconnect and the event does not
  * occur within the supervision timeout + added delay, this will
@@ -112,7 +205,7 @@ NimBLEClient::~NimBLEClient() {
 void NimBLEClient::dcTimerCb(ble_npl_event *event) {
  /*   NimBLEClient *pClient = (NimBLEClient*)event->arg;
     NIMBLE_LOGC(LOG_TAG, "Timed out disconnecting from %s - resetting host",
-                std::string(pClient->getPeerAddress()).c_str());
+                NIMBLE_CPP_STR(pClient->getPeerAddress()));
  */
     ble_hs_sched_reset(BLE_HS_ECONTROLLER);
 }
@@ -128,6 +221,7 @@ void NimBLEClient::deleteServices() {
         delete it;
     }
     m_servicesVector.clear();
+    m_charHandleMapValid = false;
 
     NIMBLE_LOGD(LOG_TAG, "<< deleteServices");
 } // deleteServices
@@ -145,6 +239,7 @@ size_t NimBLEClient::deleteService(const NimBLEUUID &uuid) {
         if((*it)->getUUID() == uuid) {
             delete *it;
             m_servicesVector.erase(it);
+            m_charHandleMapValid = false;
             break;
         }
     }
@@ -186,7 +281,7 @@ bool NimBLEClient::connect(NimBLEAdvertisedDevice* device, bool deleteAttributes
  * @return True on success.
  */
 bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes) {
-    NIMBLE_LOGD(LOG_TAG, ">> connect(%s)", address.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> connect(%s)", NIMBLE_CPP_STR(address));
 
     if(!NimBLEDevice::m_synced) {
         NIMBLE_LOGC(LOG_TAG, "Host reset, wait for sync.");
@@ -195,7 +290,7 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
 
     if(isConnected() || m_connEstablished || m_pTaskData != nullptr) {
         NIMBLE_LOGE(LOG_TAG, "Client busy, connected to %s, id=%d",
-                    std::string(m_peerAddress).c_str(), getConnId());
+                    NIMBLE_CPP_STR(m_peerAddress), getConnId());
         return false;
     }
 
@@ -204,7 +299,7 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
     peerAddr_t.type = address.getType();
     if(ble_gap_conn_find_by_addr(&peerAddr_t, NULL) == 0) {
         NIMBLE_LOGE(LOG_TAG, "A connection to %s already exists",
-                    address.toString().c_str());
+                    NIMBLE_CPP_STR(address));
         return false;
     }
 
@@ -219,6 +314,24 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
     ble_task_data_t taskData = {this, cur_task, 0, nullptr};
     m_pTaskData = &taskData;
     int rc = 0;
+    NIMBLE_CPP_LATENCY_START(latencyStart);
+
+    ble_gap_conn_params connParams = m_pConnParams;
+    if(NimBLEDevice::coexEnabled()) {
+        NimBLEDevice::coexScanWindow(connParams.scan_itvl, connParams.scan_window,
+                                     NimBLEDevice::coexDuty(false, NimBLEDevice::coexAdvertising(),
+                                                            true).connect);
+    }
+
+    // Resumes the scan paused for the connection attempt once it ends, see NimBLEDevice::setCoexPriorities.
+    struct ScanPause {
+        bool paused = false;
+        ~ScanPause() {
+            if(paused) {
+                NimBLEDevice::getScan()->resume();
+            }
+        }
+    } scanPause;
 
     /* Try to connect the the advertiser.  Allow 30 seconds (30000 ms) for
      *  timeout (default value of m_connectTimeout).
@@ -227,18 +340,19 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
     do {
 #if CONFIG_BT_NIMBLE_EXT_ADV
         rc = ble_gap_ext_connect(NimBLEDevice::m_own_addr_type,
-                                 &peerAddr_t,
+                                 m_useAcceptList ? nullptr : &peerAddr_t,
                                  m_connectTimeout,
                                  m_phyMask,
-                                 &m_pConnParams,
-                                 &m_pConnParams,
-                                 &m_pConnParams,
+                                 &connParams,
+                                 &connParams,
+                                 &connParams,
                                  NimBLEClient::handleGapEvent,
                                  this);
 
 #else
-        rc = ble_gap_connect(NimBLEDevice::m_own_addr_type, &peerAddr_t,
-                             m_connectTimeout, &m_pConnParams,
+        rc = ble_gap_connect(NimBLEDevice::m_own_addr_type,
+                             m_useAcceptList ? nullptr : &peerAddr_t,
+                             m_connectTimeout, &connParams,
                              NimBLEClient::handleGapEvent, this);
 #endif
         switch (rc) {
@@ -246,8 +360,10 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
                 break;
 
             case BLE_HS_EBUSY:
-                // Scan was still running, stop it and try again
-                if (!NimBLEDevice::getScan()->stop()) {
+                // Scan was still running, stop it and try again, the scheduler pauses it instead.
+                if (NimBLEDevice::coexEnabled() && (scanPause.paused || NimBLEDevice::getScan()->pause())) {
+                    scanPause.paused = true;
+                } else if (!NimBLEDevice::getScan()->stop()) {
                     rc = BLE_HS_EUNKNOWN;
                 }
                 break;
@@ -255,20 +371,20 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
             case BLE_HS_EDONE:
                 // A connection to this device already exists, do not connect twice.
                 NIMBLE_LOGE(LOG_TAG, "Already connected to device; addr=%s",
-                            std::string(m_peerAddress).c_str());
+                            NIMBLE_CPP_STR(m_peerAddress));
                 break;
 
             case BLE_HS_EALREADY:
                 // Already attempting to connect to this device, cancel the previous
                 // attempt and report failure here so we don't get 2 connections.
                 NIMBLE_LOGE(LOG_TAG, "Already attempting to connect to %s - cancelling",
-                            std::string(m_peerAddress).c_str());
+                            NIMBLE_CPP_STR(m_peerAddress));
                 ble_gap_conn_cancel();
                 break;
 
             default:
                 NIMBLE_LOGE(LOG_TAG, "Failed to connect to %s, rc=%d; %s",
-                            std::string(m_peerAddress).c_str(),
+                            NIMBLE_CPP_STR(m_peerAddress),
                             rc, NimBLEUtils::returnCodeToString(rc));
                 break;
         }
@@ -314,15 +430,67 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
         }
         return false;
     } else {
+        NIMBLE_CPP_LATENCY_RECORD(this, CONNECT, latencyStart);
         NIMBLE_LOGI(LOG_TAG, "Connection established");
     }
 
+    // Wait for the encryption started with the connection so the first GATT
+    // request is not rejected for insufficient encryption.
+    if(m_encState != NIMBLE_CPP_ENC_IDLE) {
+        taskData.rc = 0;
+        m_pTaskData = &taskData;
+
+        ble_npl_hw_enter_critical();
+        bool wait = m_encState == NIMBLE_CPP_ENC_PENDING;
+        if(wait) {
+            m_encState = NIMBLE_CPP_ENC_WAITING;
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(wait && ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(m_connectTimeout)) == pdFALSE) {
+            m_encState = NIMBLE_CPP_ENC_IDLE;
+            taskData.rc = BLE_HS_ETIMEOUT;
+        }
+        m_pTaskData = nullptr;
+
+        if(taskData.rc != 0) {
+            // Not fatal, secureConnection() is still called when a request needs it.
+            NIMBLE_LOGW(LOG_TAG, "Auto encryption failed; rc=%d %s",
+                        taskData.rc, NimBLEUtils::returnCodeToString(taskData.rc));
+        }
+
+        if(!isConnected()) {
+            return false;
+        }
+    }
+
     if(deleteAttributes) {
         deleteServices();
     }
 
     m_connEstablished = true;
-    m_pClientCallbacks->onConnect(this);
+
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    if(m_servicesVector.empty()) {
+        loadAttributeCache();
+    }
+#endif
+
+    if(m_useLinkProfile && !m_prepareLink) {
+        NimBLELinkProfile::apply(m_conn_id, m_linkProfile, m_linkProfileCb);
+    }
+
+    NimBLEPhyPolicy::start(m_conn_id, m_phyPolicy);
+    NimBLEPowerPolicy::start(m_conn_id, m_powerPolicy);
+    NimBLEConnParamsPolicy::start(m_conn_id, m_connParamsPolicy);
+
+    if(m_pClientCallbacks->m_callbacks & NimBLEClientCallbacks::CB_ON_CONNECT) {
+        m_pClientCallbacks->onConnect(this);
+    }
+
+    if(m_prepareLink || m_prepareDiscover) {
+        prepareConnection();
+    }
 
     NIMBLE_LOGD(LOG_TAG, "<< connect()");
     // Check if still connected before returning
@@ -330,6 +498,58 @@ bool NimBLEClient::connect(const NimBLEAddress &address, bool deleteAttributes)
 } // connect
 
 
+/**
+ * @brief Reconnect quickly to a bonded server that is advertising, keeping the attributes already known.
+ * @param [in] address The identity address of the server.
+ * @param [in] timeoutMs The time to look for the server before giving up, in milliseconds.
+ * @return True on success.
+ * @details The connection is initiated from the white list with the scan window equal to the scan
+ * interval, so the controller answers the first advertisement of the server, including directed
+ * and resolvable private address advertisements of a bonded server. A short connection interval is
+ * requested so encryption with the stored keys, started right away, and the first requests complete
+ * quickly, the connection parameters policy or updateConnParams can lengthen it afterwards.
+ * The attributes from the last connection, or the attribute cache when enabled, are kept so
+ * service discovery is skipped. The address is removed from the white list again if it was added.
+ * The connection parameters, timeout and auto encryption setting of the client are unchanged.
+ */
+bool NimBLEClient::fastReconnect(const NimBLEAddress &address, uint32_t timeoutMs) {
+    NIMBLE_LOGD(LOG_TAG, ">> fastReconnect(%s)", NIMBLE_CPP_STR(address));
+
+    // The white list only takes effect once committed.
+    bool added = false;
+    if(!NimBLEDevice::m_whiteListBatch && !NimBLEDevice::onWhiteList(address)) {
+        added = NimBLEDevice::whiteListAdd(address);
+    }
+    m_useAcceptList = !NimBLEDevice::m_whiteListBatch && NimBLEDevice::onWhiteList(address);
+
+    ble_gap_conn_params connParams = m_pConnParams;
+    int32_t connectTimeout = m_connectTimeout;
+    bool autoEncrypt = m_autoEncrypt;
+
+    m_pConnParams.scan_itvl   = NIMBLE_CPP_FAST_RECONNECT_SCAN_ITVL;
+    m_pConnParams.scan_window = NIMBLE_CPP_FAST_RECONNECT_SCAN_ITVL;
+    m_pConnParams.itvl_min    = BLE_HCI_CONN_ITVL_MIN;
+    m_pConnParams.itvl_max    = NIMBLE_CPP_FAST_RECONNECT_ITVL_MAX;
+    m_pConnParams.latency     = 0;
+    m_connectTimeout          = timeoutMs;
+    m_autoEncrypt             = true;
+
+    bool connected = connect(address, false);
+
+    m_pConnParams    = connParams;
+    m_connectTimeout = connectTimeout;
+    m_autoEncrypt    = autoEncrypt;
+    m_useAcceptList  = false;
+
+    if(added) {
+        NimBLEDevice::whiteListRemove(address);
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< fastReconnect(), connected: %d", connected);
+    return connected;
+} // fastReconnect
+
+
 /**
  * @brief Initiate a secure connection (pair/bond) with the server.\n
  * Called automatically when a characteristic or descriptor requires encryption or authentication to access it.
@@ -516,6 +736,208 @@ void NimBLEClient::setDataLen(uint16_t tx_octets) {
 } // setDataLen
 
 
+/**
+ * @brief Set a link profile to negotiate each time this client connects.
+ * @param [in] profile The link parameters to request, see NimBLELinkProfile::throughput.
+ * @param [in] callback The function to call with the achieved parameters after each connection.
+ */
+void NimBLEClient::setLinkProfile(const NimBLELinkProfile &profile, link_profile_callback callback) {
+    m_linkProfile    = profile;
+    m_linkProfileCb  = callback;
+    m_useLinkProfile = true;
+} // setLinkProfile
+
+
+/**
+ * @brief Negotiate a link profile on the current connection.
+ * @details Requests the PHY, data length, MTU and connection parameters in that order, each step
+ * waits for the peer before the next is started. A rejected connection parameter update is retried
+ * with a longer interval.
+ * @param [in] profile The link parameters to request.
+ * @param [in] callback The function to call with the achieved parameters when done.
+ * @return True if the negotiation was started.
+ */
+bool NimBLEClient::applyLinkProfile(const NimBLELinkProfile &profile, link_profile_callback callback) {
+    if(!isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Not connected");
+        return false;
+    }
+
+    return NimBLELinkProfile::apply(m_conn_id, profile, callback);
+} // applyLinkProfile
+
+
+/**
+ * @brief Make connect() prepare the link and discover the attributes before it returns.
+ * @param [in] negotiateLink If true, connect() negotiates the link profile set with setLinkProfile or
+ * NimBLELinkProfile::discovery() if none is set, and waits for it to finish. Use a profile with parallel set
+ * to exchange the MTU and update the data length and PHY together.
+ * @param [in] discover If true, connect() then discovers all the attributes of the peer unless they are
+ * already known, kept from the last connection or loaded from the cache.
+ * @details Discovery then runs with the larger MTU and data length, with fewer and faster requests than
+ * at the default 23 byte MTU. NimBLEClientCallbacks::onConnect, onLinkReady and onDiscoveryComplete are
+ * called in that order from the task calling connect().
+ */
+void NimBLEClient::setPrepareOnConnect(bool negotiateLink, bool discover) {
+    m_prepareLink     = negotiateLink;
+    m_prepareDiscover = discover;
+} // setPrepareOnConnect
+
+
+/**
+ * @brief Negotiate the link and discover the attributes of a new connection, called by connect().
+ */
+void NimBLEClient::prepareConnection() {
+    if(m_prepareLink) {
+        NimBLELinkProfile profile = m_useLinkProfile ? m_linkProfile : NimBLELinkProfile::discovery();
+        NimBLELinkProfileResult result = {};
+        ble_task_data_t taskData = {this, xTaskGetCurrentTaskHandle(), 0, &result};
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(taskData.task, ULONG_MAX);
+#endif
+        // The negotiation always finishes, each step has a timeout and a disconnect ends it.
+        if(NimBLELinkProfile::apply(m_conn_id, profile, [&taskData](const NimBLELinkProfileResult &res) {
+            *(NimBLELinkProfileResult*)taskData.buf = res;
+            xTaskNotifyGive(taskData.task);
+        })) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            if(m_useLinkProfile && m_linkProfileCb != nullptr) {
+                m_linkProfileCb(result);
+            }
+            m_pClientCallbacks->onLinkReady(this, result);
+        }
+    }
+
+    if(m_prepareDiscover && isConnected()) {
+        int rc = 0;
+        if(m_servicesVector.empty() && !discoverAttributes()) {
+            rc = m_lastErr != 0 ? m_lastErr : BLE_HS_EUNKNOWN;
+        }
+        m_pClientCallbacks->onDiscoveryComplete(this, rc);
+    }
+} // prepareConnection
+
+
+/**
+ * @brief Request the PHY of the current connection.
+ * @param [in] txPhyMask The preferred transmit PHY mask, BLE_GAP_LE_PHY_1M_MASK, BLE_GAP_LE_PHY_2M_MASK,
+ * BLE_GAP_LE_PHY_CODED_MASK or BLE_GAP_LE_PHY_ANY_MASK.
+ * @param [in] rxPhyMask The preferred receive PHY mask.
+ * @param [in] phyOptions The Coded PHY option, BLE_GAP_LE_PHY_CODED_ANY, _S2 or _S8.
+ * @return True if the request was sent, NimBLEClientCallbacks::onPhyUpdate is called when the PHY changes.
+ */
+bool NimBLEClient::setPhy(uint8_t txPhyMask, uint8_t rxPhyMask, uint16_t phyOptions) {
+    int rc = ble_gap_set_prefered_le_phy(m_conn_id, txPhyMask, rxPhyMask, phyOptions);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Set PHY error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setPhy
+
+
+/**
+ * @brief Read the PHY of the current connection.
+ * @param [out] txPhy The transmit PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+ * @param [out] rxPhy The receive PHY.
+ * @return True if the PHY was read.
+ */
+bool NimBLEClient::getPhy(uint8_t* txPhy, uint8_t* rxPhy) {
+    int rc = ble_gap_read_le_phy(m_conn_id, txPhy, rxPhy);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Get PHY error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // getPhy
+
+
+/**
+ * @brief Set a policy to switch the PHY from the RSSI each time this client connects.
+ * @param [in] policy The thresholds to switch at, see NimBLEPhyPolicy::adaptive.
+ * A default constructed policy disables switching from the next connection.
+ */
+void NimBLEClient::setPhyPolicy(const NimBLEPhyPolicy &policy) {
+    m_phyPolicy = policy;
+} // setPhyPolicy
+
+
+/**
+ * @brief Set a policy to adjust the transmit power from the RSSI each time this client connects.
+ * @param [in] policy The target RSSI range and power limits, see NimBLEPowerPolicy::adaptive.
+ * A default constructed policy disables the adjustment from the next connection.
+ */
+void NimBLEClient::setPowerPolicy(const NimBLEPowerPolicy &policy) {
+    m_powerPolicy = policy;
+} // setPowerPolicy
+
+
+/**
+ * @brief Set a policy to switch the connection parameters from the traffic each time this client connects.
+ * @param [in] policy The profiles and rates to switch at, see NimBLEConnParamsPolicy::adaptive.
+ * A default constructed policy disables switching from the next connection.
+ */
+void NimBLEClient::setConnParamsPolicy(const NimBLEConnParamsPolicy &policy) {
+    m_connParamsPolicy = policy;
+} // setConnParamsPolicy
+
+
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+/**
+ * @brief Send a periodic advertising sync to the server so it can receive the train without scanning.
+ * @param [in] syncHandle The handle of a sync created with NimBLEScan::createPeriodicSync.
+ * @param [in] serviceData A value passed to the server with the sync.
+ * @return True if the transfer was started.
+ */
+bool NimBLEClient::transferPeriodicSync(uint16_t syncHandle, uint16_t serviceData) {
+    int rc = ble_gap_periodic_adv_sync_transfer(syncHandle, m_conn_id, serviceData);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Sync transfer error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // transferPeriodicSync
+
+
+#  if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+/**
+ * @brief Send the sync information of a periodic train this device advertises to the server.
+ * @param [in] instId The extended advertising instance running periodic advertising.
+ * @param [in] serviceData A value passed to the server with the sync.
+ * @return True if the transfer was started.
+ */
+bool NimBLEClient::transferPeriodicAdvInfo(uint8_t instId, uint16_t serviceData) {
+    int rc = ble_gap_periodic_adv_sync_set_info(instId, m_conn_id, serviceData);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Sync set info error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // transferPeriodicAdvInfo
+#  endif
+
+
+/**
+ * @brief Accept the next periodic advertising sync sent by the server.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The time without receiving the train before the sync is lost, 100 to 163840ms.
+ * @return True if successful.
+ * @details The sync is reported to NimBLEPeriodicSyncCallbacks::onSyncTransfer of the callbacks set with
+ * NimBLEScan::setPeriodicSyncCallbacks, followed by its reports. Only one sync is accepted per call.
+ */
+bool NimBLEClient::receivePeriodicSync(uint16_t skip, uint32_t timeoutMs) {
+    return NimBLEDevice::getScan()->receivePeriodicSync(m_conn_id, skip, timeoutMs);
+} // receivePeriodicSync
+#endif
+
+
 /**
  * @brief Get detailed information about the current peer connection.
  */
@@ -534,6 +956,70 @@ NimBLEConnInfo NimBLEClient::getConnInfo() {
 } // getConnInfo
 
 
+/**
+ * @brief Encrypt the link with the stored keys as soon as a bonded peer is connected.
+ * @param [in] enable True to start encryption when the connection is made, connect() returns
+ * once the link is encrypted. Peers that are not bonded are not paired.
+ * @details Avoids the insufficient authentication/encryption error and retry of the first
+ * request to a peer with secured characteristics.
+ */
+void NimBLEClient::setAutoEncrypt(bool enable) {
+    m_autoEncrypt = enable;
+} // setAutoEncrypt
+
+
+/**
+ * @brief Start encryption with the stored LTK if the connected peer is bonded.
+ * @return True if encryption was started.
+ */
+bool NimBLEClient::startAutoEncrypt() {
+    struct ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(m_conn_id, &desc) != 0) {
+        return false;
+    }
+
+    struct ble_store_key_sec key_sec;
+    struct ble_store_value_sec value_sec;
+    memset(&key_sec, 0, sizeof(key_sec));
+    key_sec.peer_addr = desc.peer_id_addr;
+    if(ble_store_read_peer_sec(&key_sec, &value_sec) != 0 || !value_sec.ltk_present) {
+        return false;
+    }
+
+    // The peer is bonded so this starts the encryption procedure, not pairing.
+    int rc = ble_gap_security_initiate(m_conn_id);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Auto encryption not started; rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // startAutoEncrypt
+
+
+/**
+ * @brief Keep the server's cached state of this connection current if the server has cached it.
+ * @param [in] conn_handle The connection handle of the event.
+ * @details The server caches connections it did not make when it first notifies a peer on them.
+ */
+void NimBLEClient::updateServerPeerState(uint16_t conn_handle) {
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    NimBLEServer* pServer = NimBLEDevice::getServer();
+    if(pServer == nullptr) {
+        return;
+    }
+
+    if(pServer->getPeerState(conn_handle) != nullptr) {
+        pServer->updatePeerState(conn_handle);
+    } else if(ble_gap_conn_find(conn_handle, nullptr) != 0) {
+        // Not cached, the values set for the connection are still dropped when it is gone.
+        pServer->clearConnValues(conn_handle);
+    }
+#endif
+} // updateServerPeerState
+
+
 /**
  * @brief Set the timeout to wait for connection attempt to complete.
  * @param [in] time The number of seconds before timeout.
@@ -572,7 +1058,7 @@ void NimBLEClient::setPeerAddress(const NimBLEAddress &address) {
     }
 
     m_peerAddress = address;
-    NIMBLE_LOGD(LOG_TAG, "Peer address set: %s", std::string(m_peerAddress).c_str());
+    NIMBLE_LOGD(LOG_TAG, "Peer address set: %s", NIMBLE_CPP_STR(m_peerAddress));
 } // setPeerAddress
 
 
@@ -634,11 +1120,11 @@ NimBLERemoteService* NimBLEClient::getService(const char* uuid) {
  * @return A pointer to the service or nullptr if not found.
  */
 NimBLERemoteService* NimBLEClient::getService(const NimBLEUUID &uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> getService: uuid: %s", uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> getService: uuid: %s", NIMBLE_CPP_STR(uuid));
 
     for(auto &it: m_servicesVector) {
         if(it->getUUID() == uuid) {
-            NIMBLE_LOGD(LOG_TAG, "<< getService: found the service with uuid: %s", uuid.toString().c_str());
+            NIMBLE_LOGD(LOG_TAG, "<< getService: found the service with uuid: %s", NIMBLE_CPP_STR(uuid));
             return it;
         }
     }
@@ -709,6 +1195,24 @@ std::vector<NimBLERemoteService*>* NimBLEClient::getServices(bool refresh) {
  * @return True if successful.
  */
 bool NimBLEClient::discoverAttributes() {
+    if(m_singlePassDisc) {
+        ble_task_data_t taskData = {this, xTaskGetCurrentTaskHandle(), 0, nullptr};
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(taskData.task, ULONG_MAX);
+#endif
+        if(!discoverAttributesAsync([&taskData](NimBLEClient* pClient, int rc) {
+            taskData.rc = rc;
+            xTaskNotifyGive(taskData.task);
+        })) {
+            return false;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        return taskData.rc == 0;
+    }
+
     deleteServices();
 
     if (!retrieveServices()){
@@ -728,97 +1232,848 @@ bool NimBLEClient::discoverAttributes() {
         }
     }
 
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    saveAttributeCache();
+#endif
     return true;
 } // discoverAttributes
 
 
 /**
- * @brief Ask the remote %BLE server for its services.\n
- * Here we ask the server for its set of services and wait until we have received them all.
- * @return true on success otherwise false if an error occurred
- */
-bool NimBLEClient::retrieveServices(const NimBLEUUID *uuid_filter) {
-/**
- * Design
- * ------
- * We invoke ble_gattc_disc_all_svcs.  This will request a list of the services exposed by the
- * peer BLE partner to be returned in the callback function provided.
+ * @brief Retrieves the full database of attributes that the peripheral has available
+ * without blocking the calling task.
+ * @param [in] discoverCallback The function to call when discovery completes.
+ * @return True if discovery was started, the callback will be called with the result.
+ * @details The callback is called from the host task with rc == 0 on success or the error code.
+ * The attribute vectors must not be accessed or refreshed until the callback is called.
  */
+bool NimBLEClient::discoverAttributesAsync(discover_callback discoverCallback) {
+    NIMBLE_LOGD(LOG_TAG, ">> discoverAttributesAsync");
 
-    NIMBLE_LOGD(LOG_TAG, ">> retrieveServices");
-
-    if(!isConnected()){
-        NIMBLE_LOGE(LOG_TAG, "Disconnected, could not retrieve services -aborting");
+    if(!isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected, could not discover attributes -aborting");
         return false;
     }
 
-    int rc = 0;
-    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
-    ble_task_data_t taskData = {this, cur_task, 0, nullptr};
-
-    if(uuid_filter == nullptr) {
-        rc = ble_gattc_disc_all_svcs(m_conn_id, NimBLEClient::serviceDiscoveredCB, &taskData);
-    } else {
-        rc = ble_gattc_disc_svc_by_uuid(m_conn_id, &uuid_filter->getNative()->u,
-                                        NimBLEClient::serviceDiscoveredCB, &taskData);
+    if(m_discCallback != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Discovery already in progress");
+        return false;
     }
 
+    deleteServices();
+
+    int rc = ble_gattc_disc_all_svcs(m_conn_id, NimBLEClient::serviceDiscAsyncCB, this);
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_svcs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
         m_lastErr = rc;
         return false;
     }
 
-#ifdef ulTaskNotifyValueClear
-    // Clear the task notification value to ensure we block
-    ulTaskNotifyValueClear(cur_task, ULONG_MAX);
-#endif
-
-    // wait until we have all the services
-    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-    m_lastErr = taskData.rc;
+    m_discCallback = discoverCallback;
+    m_discSvcIdx   = 0;
+    m_discChrIdx   = NIMBLE_CPP_DISC_CHRS_PENDING;
 
-    if(taskData.rc == 0){
-        NIMBLE_LOGD(LOG_TAG, "<< retrieveServices");
-        return true;
-    }
-    else {
-        NIMBLE_LOGE(LOG_TAG, "Could not retrieve services");
-        return false;
-    }
-} // getServices
+    NIMBLE_LOGD(LOG_TAG, "<< discoverAttributesAsync");
+    return true;
+} // discoverAttributesAsync
 
 
 /**
- * @brief STATIC Callback for the service discovery API function.\n
- * When a service is found or there is none left or there was an error
- * the API will call this and report findings.
+ * @brief Start the next step of an asynchronous discovery, or complete it if all
+ * attributes have been discovered.
  */
-int NimBLEClient::serviceDiscoveredCB(
-                uint16_t conn_handle,
-                const struct ble_gatt_error *error,
-                const struct ble_gatt_svc *service, void *arg)
-{
-    NIMBLE_LOGD(LOG_TAG,"Service Discovered >> status: %d handle: %d",
-                        error->status, (error->status == 0) ? service->start_handle : -1);
+void NimBLEClient::discoverNextAsync() {
+    int rc = 0;
 
-    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
-    NimBLEClient *client = (NimBLEClient*)pTaskData->pATT;
+    // Single pass: the characteristics of all services are discovered with one procedure.
+    if(m_singlePassDisc && m_discChrIdx == NIMBLE_CPP_DISC_CHRS_PENDING) {
+        if(m_servicesVector.empty()) {
+            discoverAsyncDone(0);
+            return;
+        }
 
-    // Make sure the service discovery is for this device
-    if(client->getConnId() != conn_handle){
-        return 0;
+        m_discSvcIdx = 0;
+        m_discChrIdx = 0;
+        rc = ble_gattc_disc_all_chrs(m_conn_id, m_servicesVector.front()->getStartHandle(),
+                                     m_servicesVector.back()->getEndHandle(),
+                                     NimBLEClient::allCharacteristicsDiscCB, this);
+        if(rc != 0) {
+            discoverAsyncDone(rc);
+        }
+        return;
     }
 
-    if(error->status == 0) {
-        // Found a service - add it to the vector
-        NimBLERemoteService* pRemoteService = new NimBLERemoteService(client, service);
-        client->m_servicesVector.push_back(pRemoteService);
-        return 0;
-    }
+    while(m_discSvcIdx < m_servicesVector.size()) {
+        NimBLERemoteService* pSvc = m_servicesVector[m_discSvcIdx];
 
-    if(error->status == BLE_HS_EDONE) {
-        pTaskData->rc = 0;
+        if(m_discChrIdx == NIMBLE_CPP_DISC_CHRS_PENDING) {
+            m_discChrIdx = 0;
+            rc = ble_gattc_disc_all_chrs(m_conn_id, pSvc->getStartHandle(), pSvc->getEndHandle(),
+                                         NimBLEClient::characteristicDiscAsyncCB, this);
+            if(rc != 0) {
+                discoverAsyncDone(rc);
+            }
+            return;
+        }
+
+        while(m_discChrIdx < pSvc->m_characteristicVector.size()) {
+            NimBLERemoteCharacteristic* pChr = pSvc->m_characteristicVector[m_discChrIdx++];
+
+            // No handles between the value and the next characteristic means no descriptors.
+            if(pChr->m_handle < pChr->m_endHandle) {
+                rc = ble_gattc_disc_all_dscs(m_conn_id, pChr->m_handle, pChr->m_endHandle,
+                                             NimBLEClient::descriptorDiscAsyncCB, pChr);
+                if(rc != 0) {
+                    discoverAsyncDone(rc);
+                }
+                return;
+            }
+        }
+
+        m_discSvcIdx++;
+        m_discChrIdx = NIMBLE_CPP_DISC_CHRS_PENDING;
+    }
+
+    discoverAsyncDone(0);
+} // discoverNextAsync
+
+
+/**
+ * @brief Complete an asynchronous discovery and call the application callback.
+ * @param [in] rc 0 on success or the error code that ended the discovery.
+ */
+void NimBLEClient::discoverAsyncDone(int rc) {
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Could not discover attributes rc=%d %s",
+                             rc, NimBLEUtils::returnCodeToString(rc));
+    }
+
+    m_lastErr = rc;
+
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    if(rc == 0) {
+        saveAttributeCacheAsync();
+    }
+#endif
+
+    // Clear the callback before calling it so a new discovery can be started from it.
+    discover_callback discCallback = m_discCallback;
+    m_discCallback = nullptr;
+    if(discCallback != nullptr) {
+        discCallback(this, rc);
+    }
+} // discoverAsyncDone
+
+
+/**
+ * @brief STATIC Callback for the asynchronous service discovery.
+ */
+int NimBLEClient::serviceDiscAsyncCB(uint16_t conn_handle,
+                                     const struct ble_gatt_error *error,
+                                     const struct ble_gatt_svc *service, void *arg)
+{
+    NimBLEClient *client = (NimBLEClient*)arg;
+
+    if(error->status == 0) {
+        client->m_servicesVector.push_back(new (client) NimBLERemoteService(client, service));
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        client->discoverNextAsync();
+    } else {
+        client->discoverAsyncDone(error->status);
+    }
+
+    return error->status;
+} // serviceDiscAsyncCB
+
+
+/**
+ * @brief STATIC Callback for the asynchronous characteristic discovery of the current service.
+ */
+int NimBLEClient::characteristicDiscAsyncCB(uint16_t conn_handle,
+                                            const struct ble_gatt_error *error,
+                                            const struct ble_gatt_chr *chr, void *arg)
+{
+    NimBLEClient *client = (NimBLEClient*)arg;
+    NimBLERemoteService *pSvc = client->m_servicesVector[client->m_discSvcIdx];
+
+    if(error->status == 0) {
+        pSvc->m_characteristicVector.push_back(new (client) NimBLERemoteCharacteristic(pSvc, chr));
+        client->m_charHandleMapValid = false;
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        pSvc->setCharacteristicEndHandles();
+        client->discoverNextAsync();
+    } else {
+        client->discoverAsyncDone(error->status);
+    }
+
+    return error->status;
+} // characteristicDiscAsyncCB
+
+
+/**
+ * @brief STATIC Callback for the asynchronous descriptor discovery of the current characteristic.
+ */
+int NimBLEClient::descriptorDiscAsyncCB(uint16_t conn_handle,
+                                        const struct ble_gatt_error *error,
+                                        uint16_t chr_val_handle,
+                                        const struct ble_gatt_dsc *dsc,
+                                        void *arg)
+{
+    NimBLERemoteCharacteristic *pChr = (NimBLERemoteCharacteristic*)arg;
+    NimBLEClient *client = pChr->getRemoteService()->getClient();
+
+    if(error->status == 0) {
+        pChr->m_descriptorVector.push_back(new (client) NimBLERemoteDescriptor(pChr, dsc));
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        client->discoverNextAsync();
+    } else {
+        client->discoverAsyncDone(error->status);
+    }
+
+    return error->status;
+} // descriptorDiscAsyncCB
+
+
+/**
+ * @brief Discover all descriptors of the database with one procedure, from the first
+ * characteristic that can have descriptors to the end of the last one.
+ */
+void NimBLEClient::discoverAllDescriptorsAsync() {
+    uint16_t startHandle = 0;
+    uint16_t endHandle = 0;
+
+    for(auto &svc : m_servicesVector) {
+        for(auto &chr : svc->m_characteristicVector) {
+            // No handles between the value and the next characteristic means no descriptors.
+            if(chr->m_handle < chr->m_endHandle) {
+                if(startHandle == 0) {
+                    startHandle = chr->m_handle;
+                }
+                endHandle = chr->m_endHandle;
+            }
+        }
+    }
+
+    if(startHandle == 0) {
+        discoverAsyncDone(0);
+        return;
+    }
+
+    m_discSvcIdx = 0;
+    m_discChrIdx = 0;
+    int rc = ble_gattc_disc_all_dscs(m_conn_id, startHandle, endHandle,
+                                     NimBLEClient::allDescriptorsDiscCB, this);
+    if(rc != 0) {
+        discoverAsyncDone(rc);
+    }
+} // discoverAllDescriptorsAsync
+
+
+/**
+ * @brief STATIC Callback for the single pass characteristic discovery, the characteristics
+ * are placed in the service holding their handle.
+ */
+int NimBLEClient::allCharacteristicsDiscCB(uint16_t conn_handle,
+                                           const struct ble_gatt_error *error,
+                                           const struct ble_gatt_chr *chr, void *arg)
+{
+    NimBLEClient *client = (NimBLEClient*)arg;
+
+    if(error->status == 0) {
+        // Results come in handle order, as do the services.
+        auto &svcs = client->m_servicesVector;
+        while(client->m_discSvcIdx < svcs.size() &&
+              svcs[client->m_discSvcIdx]->getEndHandle() < chr->def_handle) {
+            client->m_discSvcIdx++;
+        }
+
+        if(client->m_discSvcIdx < svcs.size() &&
+           svcs[client->m_discSvcIdx]->getStartHandle() < chr->def_handle) {
+            NimBLERemoteService *pSvc = svcs[client->m_discSvcIdx];
+            pSvc->m_characteristicVector.push_back(new (client) NimBLERemoteCharacteristic(pSvc, chr));
+            client->m_charHandleMapValid = false;
+        }
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        for(auto &it : client->m_servicesVector) {
+            it->setCharacteristicEndHandles();
+        }
+        client->discoverAllDescriptorsAsync();
+    } else {
+        client->discoverAsyncDone(error->status);
+    }
+
+    return error->status;
+} // allCharacteristicsDiscCB
+
+
+/**
+ * @brief STATIC Callback for the single pass descriptor discovery, the attributes are placed
+ * in the characteristic whose descriptor range holds their handle, declarations and values are skipped.
+ */
+int NimBLEClient::allDescriptorsDiscCB(uint16_t conn_handle,
+                                       const struct ble_gatt_error *error,
+                                       uint16_t chr_val_handle,
+                                       const struct ble_gatt_dsc *dsc,
+                                       void *arg)
+{
+    NimBLEClient *client = (NimBLEClient*)arg;
+
+    if(error->status == 0) {
+        auto &svcs = client->m_servicesVector;
+        while(client->m_discSvcIdx < svcs.size()) {
+            auto &chrs = svcs[client->m_discSvcIdx]->m_characteristicVector;
+            while(client->m_discChrIdx < chrs.size() &&
+                  chrs[client->m_discChrIdx]->m_endHandle < dsc->handle) {
+                client->m_discChrIdx++;
+            }
+
+            if(client->m_discChrIdx < chrs.size()) {
+                NimBLERemoteCharacteristic *pChr = chrs[client->m_discChrIdx];
+                if(pChr->m_handle < dsc->handle) {
+                    pChr->m_descriptorVector.push_back(new (client) NimBLERemoteDescriptor(pChr, dsc));
+                }
+                break;
+            }
+
+            client->m_discSvcIdx++;
+            client->m_discChrIdx = 0;
+        }
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        client->discoverAsyncDone(0);
+    } else {
+        client->discoverAsyncDone(error->status);
+    }
+
+    return error->status;
+} // allDescriptorsDiscCB
+
+
+/**
+ * @brief Discover the database with one characteristic and one descriptor discovery procedure
+ * over the handle range of all services instead of one per service and characteristic.
+ * @param [in] enable True to discover in a single pass, false (default) to discover per attribute.
+ * @details Used by discoverAttributes, discoverAttributesAsync and NimBLEDevice::queueConnect.
+ * Each response carries as many attributes as fit in the MTU, so a peer with many small services
+ * is discovered in a few round trips. Must not be changed while a discovery is in progress.
+ */
+void NimBLEClient::setSinglePassDiscovery(bool enable) {
+    m_singlePassDisc = enable;
+} // setSinglePassDiscovery
+
+
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+/**
+ * @brief Append a little endian 16 bit value to a cache buffer.
+ */
+static void cachePutU16(std::vector<uint8_t> &buf, uint16_t val) {
+    buf.push_back(val & 0xFF);
+    buf.push_back(val >> 8);
+} // cachePutU16
+
+
+/**
+ * @brief Append a UUID to a cache buffer as its length followed by its little endian value.
+ */
+static void cachePutUUID(std::vector<uint8_t> &buf, const NimBLEUUID &uuid) {
+    const ble_uuid_any_t *native = uuid.getNative();
+
+    switch(native->u.type) {
+        case BLE_UUID_TYPE_16:
+            buf.push_back(2);
+            cachePutU16(buf, native->u16.value);
+            break;
+        case BLE_UUID_TYPE_32:
+            buf.push_back(4);
+            cachePutU16(buf, native->u32.value & 0xFFFF);
+            cachePutU16(buf, native->u32.value >> 16);
+            break;
+        default:
+            buf.push_back(16);
+            buf.insert(buf.end(), native->u128.value, native->u128.value + 16);
+            break;
+    }
+} // cachePutUUID
+
+
+/**
+ * @brief Reads values from a cache buffer, setting an error flag instead of reading past the end.
+ */
+struct NimBLECacheReader {
+    const uint8_t *data;
+    size_t         len;
+    size_t         pos;
+    bool           error;
+
+    uint8_t getU8() {
+        if(pos + 1 > len) {
+            error = true;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint16_t getU16() {
+        uint16_t val = getU8();
+        return val | (getU8() << 8);
+    }
+
+    void getUUID(ble_uuid_any_t *uuid) {
+        uint8_t uuidLen = getU8();
+        if(error || pos + uuidLen > len || ble_uuid_init_from_buf(uuid, data + pos, uuidLen) != 0) {
+            error = true;
+            return;
+        }
+        pos += uuidLen;
+    }
+};
+
+
+/**
+ * @brief Erase an attribute cache entry from NVS.
+ * @param [in] key The NVS key of the entry, nullptr to erase all entries.
+ */
+static void cacheErase(const char *key) {
+    nvs_handle_t handle;
+    if(nvs_open(NIMBLE_CPP_GATT_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+
+    if(key == nullptr) {
+        nvs_erase_all(handle);
+    } else {
+        nvs_erase_key(handle, key);
+    }
+
+    nvs_commit(handle);
+    nvs_close(handle);
+} // cacheErase
+
+
+/**
+ * @brief Get the NVS key of the attribute cache for the connected peer.
+ * @param [out] key A buffer of at least 15 bytes for the key.
+ * @return True if the peer is bonded and has a key, the cache is only used for bonded peers.
+ */
+bool NimBLEClient::getCacheKey(char *key) {
+    ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(m_conn_id, &desc) != 0) {
+        return false;
+    }
+
+    // The identity address does not change when a bonded peer uses a resolvable private address.
+    if(!NimBLEDevice::isBonded(NimBLEAddress(desc.peer_id_addr))) {
+        return false;
+    }
+
+    const uint8_t *addr = desc.peer_id_addr.val;
+    snprintf(key, 15, "gc%02x%02x%02x%02x%02x%02x",
+             addr[5], addr[4], addr[3], addr[2], addr[1], addr[0]);
+    return true;
+} // getCacheKey
+
+
+/**
+ * @brief STATIC Callback for reading the peer Database Hash characteristic.
+ */
+int NimBLEClient::dbHashReadCB(uint16_t conn_handle,
+                               const struct ble_gatt_error *error,
+                               struct ble_gatt_attr *attr, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLEAttValue *valBuf = (NimBLEAttValue*)pTaskData->buf;
+
+    if(error->status == 0 && attr != nullptr) {
+        valBuf->setValue(attr->om->om_data, OS_MBUF_PKTLEN(attr->om));
+        return 0;
+    }
+
+    pTaskData->rc = (error->status == BLE_HS_EDONE) ? 0 : error->status;
+    xTaskNotifyGive(pTaskData->task);
+    return 0;
+} // dbHashReadCB
+
+
+/**
+ * @brief Read the Database Hash characteristic of the peer.
+ * @param [out] hash A buffer of 16 bytes for the hash.
+ * @return True if the peer has a Database Hash characteristic and it was read.
+ */
+bool NimBLEClient::readDatabaseHash(uint8_t *hash) {
+    NimBLEAttValue value;
+    NimBLEClientOperation op(this);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {this, cur_task, 0, &value};
+    ble_uuid16_t dbHashUUID = {BLE_UUID_TYPE_16, 0x2b2a};
+
+    int rc = ble_gattc_read_by_uuid(m_conn_id, 1, 0xffff, &dbHashUUID.u,
+                                    NimBLEClient::dbHashReadCB, &taskData);
+    if(rc != 0) {
+        return false;
+    }
+
+#ifdef ulTaskNotifyValueClear
+    // Clear the task notification value to ensure we block
+    ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    if(taskData.rc != 0 || value.size() != NIMBLE_CPP_GATT_CACHE_HASH_LEN) {
+        return false;
+    }
+
+    memcpy(hash, value.data(), NIMBLE_CPP_GATT_CACHE_HASH_LEN);
+    return true;
+} // readDatabaseHash
+
+
+/**
+ * @brief Save the attribute database of the connected peer to NVS.
+ * @details Only the attributes discovered so far are saved, this is called after a full discovery.\n
+ * This blocks while the Database Hash is read and must not be called from the host task.
+ */
+void NimBLEClient::saveAttributeCache() {
+    uint8_t hash[NIMBLE_CPP_GATT_CACHE_HASH_LEN] = {0};
+    bool hasHash = readDatabaseHash(hash);
+    writeAttributeCache(hasHash ? hash : nullptr);
+} // saveAttributeCache
+
+
+/**
+ * @brief STATIC Callback for reading the peer Database Hash before saving the cache from the host task.
+ */
+int NimBLEClient::dbHashSaveCB(uint16_t conn_handle,
+                               const struct ble_gatt_error *error,
+                               struct ble_gatt_attr *attr, void *arg)
+{
+    ble_cache_hash_t *pHash = (ble_cache_hash_t*)arg;
+
+    if(error->status == 0 && attr != nullptr) {
+        if(OS_MBUF_PKTLEN(attr->om) == NIMBLE_CPP_GATT_CACHE_HASH_LEN) {
+            os_mbuf_copydata(attr->om, 0, NIMBLE_CPP_GATT_CACHE_HASH_LEN, pHash->hash);
+            pHash->hasHash = true;
+        }
+        return 0;
+    }
+
+    pHash->pClient->writeAttributeCache(pHash->hasHash ? pHash->hash : nullptr);
+    delete pHash;
+    return 0;
+} // dbHashSaveCB
+
+
+/**
+ * @brief Save the attribute database of the connected peer to NVS without blocking.
+ * @details The Database Hash is read asynchronously and the cache is written from the callback,
+ * this is used when discovery completes in the host task.
+ */
+void NimBLEClient::saveAttributeCacheAsync() {
+    char key[15];
+    if(!getCacheKey(key)) {
+        return;
+    }
+
+    ble_cache_hash_t *pHash = new ble_cache_hash_t{this, {0}, false};
+    ble_uuid16_t dbHashUUID = {BLE_UUID_TYPE_16, 0x2b2a};
+
+    int rc = ble_gattc_read_by_uuid(m_conn_id, 1, 0xffff, &dbHashUUID.u,
+                                    NimBLEClient::dbHashSaveCB, pHash);
+    if(rc != 0) {
+        delete pHash;
+        writeAttributeCache(nullptr);
+    }
+} // saveAttributeCacheAsync
+
+
+/**
+ * @brief Write the attribute database of the connected peer to NVS.
+ * @param [in] hash The 16 byte Database Hash of the peer or nullptr if the peer does not have one.
+ */
+void NimBLEClient::writeAttributeCache(const uint8_t *hash) {
+    char key[15];
+    if(!getCacheKey(key)) {
+        return;
+    }
+
+    std::vector<uint8_t> buf;
+    buf.push_back(NIMBLE_CPP_GATT_CACHE_VERSION);
+    buf.push_back(hash != nullptr);
+    if(hash != nullptr) {
+        buf.insert(buf.end(), hash, hash + NIMBLE_CPP_GATT_CACHE_HASH_LEN);
+    } else {
+        buf.insert(buf.end(), NIMBLE_CPP_GATT_CACHE_HASH_LEN, 0);
+    }
+    cachePutU16(buf, m_servicesVector.size());
+
+    for(auto svc: m_servicesVector) {
+        cachePutU16(buf, svc->m_startHandle);
+        cachePutU16(buf, svc->m_endHandle);
+        cachePutUUID(buf, svc->m_uuid);
+        cachePutU16(buf, svc->m_characteristicVector.size());
+
+        for(auto chr: svc->m_characteristicVector) {
+            cachePutU16(buf, chr->m_defHandle);
+            cachePutU16(buf, chr->m_handle);
+            cachePutU16(buf, chr->m_endHandle);
+            buf.push_back(chr->m_charProp);
+            cachePutUUID(buf, chr->m_uuid);
+            cachePutU16(buf, chr->m_descriptorVector.size());
+
+            for(auto dsc: chr->m_descriptorVector) {
+                cachePutU16(buf, dsc->m_handle);
+                cachePutUUID(buf, dsc->m_uuid);
+            }
+        }
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NIMBLE_CPP_GATT_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "Attribute cache NVS open failed; err=%d", err);
+        return;
+    }
+
+    err = nvs_set_blob(handle, key, buf.data(), buf.size());
+    if(err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "Attribute cache save failed; err=%d", err);
+    } else {
+        NIMBLE_LOGI(LOG_TAG, "Attribute cache saved, %d bytes", buf.size());
+    }
+} // writeAttributeCache
+
+
+/**
+ * @brief Load the attribute database of the connected peer from NVS.
+ * @return True if a valid cache was found and the services were created from it.
+ * @details If the peer has a Database Hash characteristic the cache is only used if the hash
+ * has not changed, otherwise the cache is deleted.
+ */
+bool NimBLEClient::loadAttributeCache() {
+    char key[15];
+    if(!getCacheKey(key)) {
+        return false;
+    }
+
+    nvs_handle_t handle;
+    if(nvs_open(NIMBLE_CPP_GATT_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+
+    size_t len = 0;
+    std::vector<uint8_t> buf;
+    esp_err_t err = nvs_get_blob(handle, key, nullptr, &len);
+    if(err == ESP_OK) {
+        buf.resize(len);
+        err = nvs_get_blob(handle, key, buf.data(), &len);
+    }
+    nvs_close(handle);
+
+    if(err != ESP_OK) {
+        return false;
+    }
+
+    NimBLECacheReader rd = {buf.data(), len, 0, false};
+    uint8_t version = rd.getU8();
+    uint8_t hasHash = rd.getU8();
+    if(rd.error || version != NIMBLE_CPP_GATT_CACHE_VERSION ||
+       len < rd.pos + NIMBLE_CPP_GATT_CACHE_HASH_LEN) {
+        cacheErase(key);
+        return false;
+    }
+
+    uint8_t hash[NIMBLE_CPP_GATT_CACHE_HASH_LEN];
+    bool peerHasHash = readDatabaseHash(hash);
+    if(peerHasHash != (hasHash != 0) ||
+       (peerHasHash && memcmp(hash, rd.data + rd.pos, NIMBLE_CPP_GATT_CACHE_HASH_LEN) != 0)) {
+        NIMBLE_LOGI(LOG_TAG, "Peer database changed, deleting attribute cache");
+        cacheErase(key);
+        return false;
+    }
+    rd.pos += NIMBLE_CPP_GATT_CACHE_HASH_LEN;
+
+    uint16_t numSvcs = rd.getU16();
+    for(uint16_t i = 0; i < numSvcs && !rd.error; i++) {
+        ble_gatt_svc svc;
+        svc.start_handle = rd.getU16();
+        svc.end_handle = rd.getU16();
+        rd.getUUID(&svc.uuid);
+        if(rd.error) {
+            break;
+        }
+
+        NimBLERemoteService *pSvc = new (this) NimBLERemoteService(this, &svc);
+        m_servicesVector.push_back(pSvc);
+
+        uint16_t numChrs = rd.getU16();
+        for(uint16_t j = 0; j < numChrs && !rd.error; j++) {
+            ble_gatt_chr chr;
+            chr.def_handle = rd.getU16();
+            chr.val_handle = rd.getU16();
+            uint16_t endHandle = rd.getU16();
+            chr.properties = rd.getU8();
+            rd.getUUID(&chr.uuid);
+            if(rd.error) {
+                break;
+            }
+
+            NimBLERemoteCharacteristic *pChr = new (this) NimBLERemoteCharacteristic(pSvc, &chr);
+            pChr->m_endHandle = endHandle;
+            pSvc->m_characteristicVector.push_back(pChr);
+            m_charHandleMapValid = false;
+
+            uint16_t numDscs = rd.getU16();
+            for(uint16_t k = 0; k < numDscs && !rd.error; k++) {
+                ble_gatt_dsc dsc;
+                dsc.handle = rd.getU16();
+                rd.getUUID(&dsc.uuid);
+                if(rd.error) {
+                    break;
+                }
+
+                pChr->m_descriptorVector.push_back(new (this) NimBLERemoteDescriptor(pChr, &dsc));
+            }
+        }
+    }
+
+    if(rd.error) {
+        NIMBLE_LOGE(LOG_TAG, "Attribute cache corrupt, deleting");
+        deleteServices();
+        cacheErase(key);
+        return false;
+    }
+
+    NIMBLE_LOGI(LOG_TAG, "Loaded %d services from attribute cache", m_servicesVector.size());
+    return true;
+} // loadAttributeCache
+
+
+/**
+ * @brief STATIC Delete the attribute cache of a peer.
+ * @param [in] address The identity address of the peer, nullptr to delete the cache of all peers.
+ */
+void NimBLEClient::deleteAttributeCache(const NimBLEAddress *address) {
+    if(address == nullptr) {
+        cacheErase(nullptr);
+        return;
+    }
+
+    char key[15];
+    const uint8_t *addr = address->getNative();
+    snprintf(key, sizeof(key), "gc%02x%02x%02x%02x%02x%02x",
+             addr[5], addr[4], addr[3], addr[2], addr[1], addr[0]);
+    cacheErase(key);
+} // deleteAttributeCache
+#endif // CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+
+/**
+ * @brief Ask the remote %BLE server for its services.\n
+ * Here we ask the server for its set of services and wait until we have received them all.
+ * @return true on success otherwise false if an error occurred
+ */
+bool NimBLEClient::retrieveServices(const NimBLEUUID *uuid_filter) {
+/**
+ * Design
+ * ------
+ * We invoke ble_gattc_disc_all_svcs.  This will request a list of the services exposed by the
+ * peer BLE partner to be returned in the callback function provided.
+ */
+
+    NIMBLE_LOGD(LOG_TAG, ">> retrieveServices");
+
+    if(!isConnected()){
+        NIMBLE_LOGE(LOG_TAG, "Disconnected, could not retrieve services -aborting");
+        return false;
+    }
+
+    int rc = 0;
+    NimBLEClientOperation op(this);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {this, cur_task, 0, nullptr};
+    NIMBLE_CPP_LATENCY_START(latencyStart);
+
+    if(uuid_filter == nullptr) {
+        rc = ble_gattc_disc_all_svcs(m_conn_id, NimBLEClient::serviceDiscoveredCB, &taskData);
+    } else {
+        rc = ble_gattc_disc_svc_by_uuid(m_conn_id, &uuid_filter->getNative()->u,
+                                        NimBLEClient::serviceDiscoveredCB, &taskData);
+    }
+
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_svcs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_lastErr = rc;
+        return false;
+    }
+
+#ifdef ulTaskNotifyValueClear
+    // Clear the task notification value to ensure we block
+    ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+
+    // wait until we have all the services
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    NIMBLE_CPP_LATENCY_RECORD(this, DISCOVER_SERVICES, latencyStart);
+    m_lastErr = taskData.rc;
+
+    if(taskData.rc == 0){
+        NIMBLE_LOGD(LOG_TAG, "<< retrieveServices");
+        return true;
+    }
+    else {
+        NIMBLE_LOGE(LOG_TAG, "Could not retrieve services");
+        return false;
+    }
+} // getServices
+
+
+/**
+ * @brief STATIC Callback for the service discovery API function.\n
+ * When a service is found or there is none left or there was an error
+ * the API will call this and report findings.
+ */
+int NimBLEClient::serviceDiscoveredCB(
+                uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                const struct ble_gatt_svc *service, void *arg)
+{
+    NIMBLE_LOGD(LOG_TAG,"Service Discovered >> status: %d handle: %d",
+                        error->status, (error->status == 0) ? service->start_handle : -1);
+
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLEClient *client = (NimBLEClient*)pTaskData->pATT;
+
+    // Make sure the service discovery is for this device
+    if(client->getConnId() != conn_handle){
+        return 0;
+    }
+
+    if(error->status == 0) {
+        // Found a service - add it to the vector
+        NimBLERemoteService* pRemoteService = new (client) NimBLERemoteService(client, service);
+        client->m_servicesVector.push_back(pRemoteService);
+        return 0;
+    }
+
+    if(error->status == BLE_HS_EDONE) {
+        pTaskData->rc = 0;
     } else {
         NIMBLE_LOGE(LOG_TAG, "serviceDiscoveredCB() rc=%d %s",
                              error->status,
@@ -826,65 +2081,532 @@ int NimBLEClient::serviceDiscoveredCB(
         pTaskData->rc = error->status;
     }
 
-    xTaskNotifyGive(pTaskData->task);
+    xTaskNotifyGive(pTaskData->task);
+
+    NIMBLE_LOGD(LOG_TAG,"<< Service Discovered");
+    return error->status;
+}
+
+
+/**
+ * @brief Get the value of a specific characteristic associated with a specific service.
+ * @param [in] serviceUUID The service that owns the characteristic.
+ * @param [in] characteristicUUID The characteristic whose value we wish to read.
+ * @returns characteristic value or an empty string if not found
+ */
+NimBLEAttValue NimBLEClient::getValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &characteristicUUID) {
+    NIMBLE_LOGD(LOG_TAG, ">> getValue: serviceUUID: %s, characteristicUUID: %s",
+                         NIMBLE_CPP_STR(serviceUUID), NIMBLE_CPP_STR(characteristicUUID));
+
+    NimBLEAttValue ret;
+    NimBLERemoteService* pService = getService(serviceUUID);
+
+    if(pService != nullptr) {
+        NimBLERemoteCharacteristic* pChar = pService->getCharacteristic(characteristicUUID);
+        if(pChar != nullptr) {
+            ret = pChar->readValue();
+        }
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< getValue");
+    return ret;
+} // getValue
+
+
+/**
+ * @brief Set the value of a specific characteristic associated with a specific service.
+ * @param [in] serviceUUID The service that owns the characteristic.
+ * @param [in] characteristicUUID The characteristic whose value we wish to write.
+ * @param [in] value The value to write to the characteristic.
+ * @param [in] response If true, uses write with response operation.
+ * @returns true if successful otherwise false
+ */
+bool NimBLEClient::setValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &characteristicUUID,
+                            const NimBLEAttValue &value, bool response)
+{
+    NIMBLE_LOGD(LOG_TAG, ">> setValue: serviceUUID: %s, characteristicUUID: %s",
+                         NIMBLE_CPP_STR(serviceUUID), NIMBLE_CPP_STR(characteristicUUID));
+
+    bool ret = false;
+    NimBLERemoteService* pService = getService(serviceUUID);
+
+    if(pService != nullptr) {
+        NimBLERemoteCharacteristic* pChar = pService->getCharacteristic(characteristicUUID);
+        if(pChar != nullptr) {
+            ret = pChar->writeValue(value, response);
+        }
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< setValue");
+    return ret;
+} // setValue
+
+
+/**
+ * @brief Get a reference to a characteristic that reads and writes it by handle.
+ * @param [in] serviceUUID The service that owns the characteristic.
+ * @param [in] characteristicUUID The characteristic to reference.
+ * @return The reference, invalid if the characteristic was not found.
+ * @details The lookup by UUID is done once here, keep the reference for repeated access
+ * instead of calling getValue() and setValue().
+ */
+NimBLERemoteCharacteristicRef NimBLEClient::getCharacteristicRef(const NimBLEUUID &serviceUUID,
+                                                                 const NimBLEUUID &characteristicUUID)
+{
+    NimBLERemoteService* pService = getService(serviceUUID);
+    if(pService == nullptr) {
+        return NimBLERemoteCharacteristicRef();
+    }
+
+    return NimBLERemoteCharacteristicRef(pService->getCharacteristic(characteristicUUID));
+} // getCharacteristicRef
+
+
+/**
+ * @brief Read the values of several characteristics in one request using ATT Read Multiple.
+ * @param [in] characteristics The characteristics to read, 2 or more. The peer must allow
+ * reading all of them.
+ * @param [in] lengths The length of each value. The response contains the values back to back
+ * without their lengths, so every value except the last must have a known fixed length.
+ * The last length may be omitted, the last value takes the rest of the response.
+ * @return True if successful, the values are stored in the characteristics and can be retrieved with getValue().
+ * @details The response is limited to MTU - 1 bytes, values beyond that are truncated.
+ */
+bool NimBLEClient::readMultiple(const std::vector<NimBLERemoteCharacteristic*> &characteristics,
+                                const std::vector<uint16_t> &lengths)
+{
+    NIMBLE_LOGD(LOG_TAG, ">> readMultiple(): %d characteristics", characteristics.size());
+
+    if(!isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    if(characteristics.size() < 2 || characteristics.size() > (size_t)(getMTU() - 1) / 2 ||
+       lengths.size() + 1 < characteristics.size())
+    {
+        NIMBLE_LOGE(LOG_TAG, "readMultiple: invalid number of characteristics or lengths");
+        return false;
+    }
+
+    std::vector<uint16_t> handles;
+    handles.reserve(characteristics.size());
+    for(auto chr: characteristics) {
+        handles.push_back(chr->getHandle());
+    }
+
+    int rc = 0;
+    int retryCount = 1;
+    NimBLEAttValue value;
+    NimBLEClientOperation op(this);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {this, cur_task, 0, &value};
+
+    do {
+        rc = ble_gattc_read_mult(m_conn_id, handles.data(), handles.size(),
+                                 NimBLEClient::readMultipleCB, &taskData);
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristics; rc=%d, %s",
+                                 rc, NimBLEUtils::returnCodeToString(rc));
+            m_lastErr = rc;
+            return false;
+        }
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        rc = taskData.rc;
+
+        switch(rc) {
+            case 0:
+                break;
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHOR):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC):
+                if (retryCount && secureConnection())
+                    break;
+            /* Else falls through. */
+            default:
+                NIMBLE_LOGE(LOG_TAG, "<< readMultiple rc=%d", rc);
+                m_lastErr = rc;
+                return false;
+        }
+    } while(rc != 0 && retryCount--);
+
+    // Split the response into the characteristic values.
+    size_t offset = 0;
+    for(size_t i = 0; i < characteristics.size(); i++) {
+        size_t remaining = value.size() - offset;
+        size_t len = (i < characteristics.size() - 1 || i < lengths.size()) ?
+                     std::min((size_t)lengths[i], remaining) : remaining;
+
+        characteristics[i]->m_value.setValue(value.data() + offset, len);
+        offset += len;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< readMultiple length: %d", value.size());
+    return true;
+} // readMultiple
+
+
+/**
+ * @brief STATIC Callback for the read multiple operation.
+ */
+int NimBLEClient::readMultipleCB(uint16_t conn_handle,
+                                 const struct ble_gatt_error *error,
+                                 struct ble_gatt_attr *attr, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLEAttValue *valBuf = (NimBLEAttValue*)pTaskData->buf;
+
+    NIMBLE_LOGI(LOG_TAG, "Read multiple complete; status=%d conn_handle=%d", error->status, conn_handle);
+
+    if(error->status == 0 && attr != nullptr && attr->om != nullptr) {
+        for(const os_mbuf *om = attr->om; om != nullptr; om = SLIST_NEXT(om, om_next)) {
+            valBuf->append(om->om_data, om->om_len);
+        }
+    }
+
+    pTaskData->rc = error->status;
+    xTaskNotifyGive(pTaskData->task);
+    return 0;
+} // readMultipleCB
+
+
+/**
+ * @brief Write the values of several characteristics as one reliable write.
+ * @param [in] writes The characteristics and the values to write to them.
+ * @return True if the peer committed all of the values.
+ * @details The values are queued on the peer with prepare write requests. Each prepared value is
+ * checked against the value sent, then all of them are committed with a single execute write request.
+ * If any value is rejected, or comes back changed, the queue is cancelled and none are written.\n
+ * The number of values is limited by CONFIG_BT_NIMBLE_GATT_WRITE_MAX_ATTRS, 4 by default.
+ */
+bool NimBLEClient::writeReliable(const std::vector<std::pair<NimBLERemoteCharacteristic*, NimBLEAttValue>> &writes) {
+    NIMBLE_LOGD(LOG_TAG, ">> writeReliable(): %d characteristics", writes.size());
+
+    if(!isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    if(writes.empty() || writes.size() > MYNEWT_VAL(BLE_GATT_WRITE_MAX_ATTRS)) {
+        NIMBLE_LOGE(LOG_TAG, "writeReliable: invalid number of characteristics, max %d",
+                             MYNEWT_VAL(BLE_GATT_WRITE_MAX_ATTRS));
+        return false;
+    }
+
+    int rc = 0;
+    int retryCount = 1;
+    size_t length = 0;
+    std::vector<ble_gatt_attr> attrs(writes.size());
+    NimBLEClientOperation op(this);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {this, cur_task, 0, nullptr};
+
+    do {
+        // The host consumes the mbufs, so they are created again for a retry.
+        rc = 0;
+        length = 0;
+        for(size_t i = 0; i < writes.size(); i++) {
+            attrs[i].handle = writes[i].first->getHandle();
+            attrs[i].offset = 0;
+            attrs[i].om = ble_hs_mbuf_from_flat(writes[i].second.data(), writes[i].second.size());
+            length += writes[i].second.size();
+            if(attrs[i].om == nullptr) {
+                rc = BLE_HS_ENOMEM;
+            }
+        }
+
+        if(rc == 0) {
+            NIMBLE_CPP_LATENCY_START(latencyStart);
+            rc = ble_gattc_write_reliable(m_conn_id, attrs.data(), attrs.size(),
+                                          NimBLEClient::writeReliableCB, &taskData);
+            if(rc == 0) {
+#ifdef ulTaskNotifyValueClear
+                // Clear the task notification value to ensure we block
+                ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                NIMBLE_CPP_LATENCY_RECORD(this, WRITE, latencyStart);
+                rc = taskData.rc;
+                NIMBLE_CPP_CONN_STATS_ATT_RESULT(m_conn_id, rc);
+            }
+        } else {
+            for(auto &it : attrs) {
+                os_mbuf_free_chain(it.om);
+                it.om = nullptr;
+            }
+        }
+
+        switch(rc) {
+            case 0:
+                break;
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHOR):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC):
+                if (retryCount && secureConnection())
+                    break;
+            /* Else falls through. */
+            default:
+                NIMBLE_LOGE(LOG_TAG, "<< writeReliable rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+                m_lastErr = rc;
+                return false;
+        }
+    } while(rc != 0 && retryCount--);
+
+    NIMBLE_CPP_CONN_STATS_ADD(m_conn_id, writeTxPackets, writes.size());
+    NIMBLE_CPP_CONN_STATS_ADD(m_conn_id, writeTxBytes, length);
 
-    NIMBLE_LOGD(LOG_TAG,"<< Service Discovered");
-    return error->status;
-}
+    NIMBLE_LOGD(LOG_TAG, "<< writeReliable");
+    return true;
+} // writeReliable
 
 
 /**
- * @brief Get the value of a specific characteristic associated with a specific service.
- * @param [in] serviceUUID The service that owns the characteristic.
- * @param [in] characteristicUUID The characteristic whose value we wish to read.
- * @returns characteristic value or an empty string if not found
+ * @brief STATIC Callback for the reliable write operation.
  */
-NimBLEAttValue NimBLEClient::getValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &characteristicUUID) {
-    NIMBLE_LOGD(LOG_TAG, ">> getValue: serviceUUID: %s, characteristicUUID: %s",
-                         serviceUUID.toString().c_str(), characteristicUUID.toString().c_str());
+int NimBLEClient::writeReliableCB(uint16_t conn_handle,
+                                  const struct ble_gatt_error *error,
+                                  struct ble_gatt_attr *attrs,
+                                  uint8_t num_attrs, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
 
-    NimBLEAttValue ret;
-    NimBLERemoteService* pService = getService(serviceUUID);
+    NIMBLE_LOGI(LOG_TAG, "Reliable write complete; status=%d conn_handle=%d", error->status, conn_handle);
 
-    if(pService != nullptr) {
-        NimBLERemoteCharacteristic* pChar = pService->getCharacteristic(characteristicUUID);
-        if(pChar != nullptr) {
-            ret = pChar->readValue();
+    pTaskData->rc = error->status;
+    xTaskNotifyGive(pTaskData->task);
+    return 0;
+} // writeReliableCB
+
+
+/**
+ * @brief Subscribe to the notifications or indications of all the discovered characteristics.
+ * @param [in] filter A function returning true for the characteristics to subscribe to, nullptr for all of them.
+ * @param [in] notifications If true, subscribe for notifications, false subscribe for indications.
+ * A characteristic that only supports the other kind is subscribed with that kind.
+ * @param [in] notifyCallback A callback to be invoked for a notification of any of the characteristics.
+ * @param [in] response If true, write each descriptor with a write request, else the writes are sent
+ * back to back as write commands.
+ * @return True if all the descriptor writes were sent successfully.
+ * @details Only the services and characteristics already discovered are considered. The descriptors
+ * not yet known are found with a single discovery over the handles of all the characteristics instead
+ * of one discovery per characteristic.\n
+ * When the connection is bonded and encrypted the peer may have restored the subscriptions from
+ * the bond, the descriptors are then read together and those already set are not written again.
+ */
+bool NimBLEClient::subscribeAll(subscribe_filter filter, bool notifications,
+                                notify_callback notifyCallback, bool response)
+{
+    NIMBLE_LOGD(LOG_TAG, ">> subscribeAll()");
+
+    if(!isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    const NimBLEUUID cccdUUID((uint16_t)0x2902);
+    std::vector<NimBLERemoteCharacteristic*> chrs;
+    std::vector<NimBLERemoteDescriptor*> cccds;
+    uint16_t startHandle = 0;
+    uint16_t endHandle = 0;
+
+    for(auto svc : m_servicesVector) {
+        for(auto chr : svc->m_characteristicVector) {
+            if(!(chr->canNotify() || chr->canIndicate()) || (filter != nullptr && !filter(chr))) {
+                continue;
+            }
+
+            NimBLERemoteDescriptor* cccd = nullptr;
+            for(auto dsc : chr->m_descriptorVector) {
+                if(dsc->getUUID() == cccdUUID) {
+                    cccd = dsc;
+                    break;
+                }
+            }
+
+            if(cccd == nullptr) {
+                if(startHandle == 0) {
+                    startHandle = chr->m_handle;
+                }
+                endHandle = std::max(endHandle, chr->m_endHandle != 0 ? chr->m_endHandle : svc->getEndHandle());
+            }
+
+            chrs.push_back(chr);
+            cccds.push_back(cccd);
         }
     }
 
-    NIMBLE_LOGD(LOG_TAG, "<< getValue");
-    return ret;
-} // getValue
+    if(chrs.empty()) {
+        NIMBLE_LOGD(LOG_TAG, "<< subscribeAll(): no characteristics to subscribe to");
+        return true;
+    }
+
+    int rc = 0;
+    NimBLEClientOperation op(this);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+
+    if(startHandle != 0 && startHandle < endHandle) {
+        // The handle and 16 bit UUID, 0 if longer, of each attribute in the range.
+        std::vector<std::pair<uint16_t, uint16_t>> attrs;
+        ble_task_data_t taskData = {this, cur_task, 0, &attrs};
+        NIMBLE_CPP_LATENCY_START(latencyStart);
+
+        rc = ble_gattc_disc_all_dscs(m_conn_id, startHandle, endHandle, NimBLEClient::cccdDiscCB, &taskData);
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_dscs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+            m_lastErr = rc;
+            return false;
+        }
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        NIMBLE_CPP_LATENCY_RECORD(this, DISCOVER_DESCRIPTORS, latencyStart);
+
+        if(taskData.rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to discover descriptors; startHandle:%d endHandle:%d rc=%d",
+                                 startHandle, endHandle, taskData.rc);
+            m_lastErr = taskData.rc;
+            return false;
+        }
+
+        // A descriptor belongs to the last characteristic value before it, a declaration ends the characteristic.
+        size_t owner = 0;
+        while(chrs[owner]->m_handle != startHandle) {
+            owner++;
+        }
+
+        for(auto &attr : attrs) {
+            if(attr.second >= 0x2800 && attr.second <= 0x2803) {
+                owner = chrs.size();
+                continue;
+            }
+
+            auto it = std::find_if(chrs.begin(), chrs.end(), [&attr](NimBLERemoteCharacteristic* chr) {
+                return chr->m_handle == attr.first;
+            });
+            if(it != chrs.end()) {
+                owner = it - chrs.begin();
+                continue;
+            }
+
+            if(attr.second == 0x2902 && owner < chrs.size() && cccds[owner] == nullptr) {
+                ble_gatt_dsc dsc;
+                dsc.handle = attr.first;
+                dsc.uuid.u16.u.type = BLE_UUID_TYPE_16;
+                dsc.uuid.u16.value = 0x2902;
+                cccds[owner] = new (this) NimBLERemoteDescriptor(chrs[owner], &dsc);
+                chrs[owner]->m_descriptorVector.push_back(cccds[owner]);
+            }
+        }
+    }
+
+    // The values stored by the peer, 0xFFFF if not read.
+    std::vector<uint16_t> current(chrs.size(), 0xFFFF);
+    NimBLEConnInfo connInfo = getConnInfo();
+
+    if(connInfo.isBonded() && connInfo.isEncrypted()) {
+        size_t maxRead = std::min((size_t)MYNEWT_VAL(BLE_GATT_READ_MAX_ATTRS), (size_t)(getMTU() - 1) / 2);
+        std::vector<size_t> indexes;
+        std::vector<uint16_t> handles;
+
+        for(size_t i = 0; i <= chrs.size(); i++) {
+            if(i < chrs.size() && cccds[i] != nullptr) {
+                indexes.push_back(i);
+                handles.push_back(cccds[i]->getHandle());
+            }
+
+            if(handles.empty() || (handles.size() < maxRead && i < chrs.size())) {
+                continue;
+            }
+
+            NimBLEAttValue value;
+            ble_task_data_t taskData = {this, cur_task, 0, &value};
+            if(handles.size() == 1) {
+                rc = ble_gattc_read(m_conn_id, handles[0], NimBLEClient::readMultipleCB, &taskData);
+            } else {
+                rc = ble_gattc_read_mult(m_conn_id, handles.data(), handles.size(),
+                                         NimBLEClient::readMultipleCB, &taskData);
+            }
+
+            if(rc == 0) {
+#ifdef ulTaskNotifyValueClear
+                // Clear the task notification value to ensure we block
+                ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                rc = taskData.rc;
+            }
+
+            if(rc != 0 || value.size() != handles.size() * 2) {
+                // Not fatal, the descriptors that were not read are written.
+                NIMBLE_LOGW(LOG_TAG, "subscribeAll: could not read the descriptors; rc=%d", rc);
+                break;
+            }
+
+            for(size_t j = 0; j < indexes.size(); j++) {
+                current[indexes[j]] = value[j * 2] | (value[j * 2 + 1] << 8);
+            }
+            indexes.clear();
+            handles.clear();
+        }
+    }
+
+    bool success = true;
+    for(size_t i = 0; i < chrs.size(); i++) {
+        NimBLERemoteCharacteristic* chr = chrs[i];
+        chr->m_notifyCallback     = notifyCallback;
+        chr->m_notifyMbufCallback = nullptr;
+        chr->m_notifyUpdateValue  = true;
+
+        if(cccds[i] == nullptr) {
+            NIMBLE_LOGW(LOG_TAG, "subscribeAll: Callback set, CCCD not found for %s", NIMBLE_CPP_STR(chr->getUUID()));
+            continue;
+        }
+
+        uint16_t val = ((notifications && chr->canNotify()) || !chr->canIndicate()) ? 0x01 : 0x02;
+        if(current[i] == val) {
+            NIMBLE_LOGD(LOG_TAG, "subscribeAll: %s already subscribed", NIMBLE_CPP_STR(chr->getUUID()));
+            continue;
+        }
+
+        if(!cccds[i]->writeValue((uint8_t*)&val, 2, response)) {
+            success = false;
+        }
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< subscribeAll(): %d characteristics", chrs.size());
+    return success;
+} // subscribeAll
 
 
 /**
- * @brief Set the value of a specific characteristic associated with a specific service.
- * @param [in] serviceUUID The service that owns the characteristic.
- * @param [in] characteristicUUID The characteristic whose value we wish to write.
- * @param [in] value The value to write to the characteristic.
- * @param [in] response If true, uses write with response operation.
- * @returns true if successful otherwise false
+ * @brief STATIC Callback for the descriptor discovery of subscribeAll.
  */
-bool NimBLEClient::setValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &characteristicUUID,
-                            const NimBLEAttValue &value, bool response)
+int NimBLEClient::cccdDiscCB(uint16_t conn_handle,
+                             const struct ble_gatt_error *error,
+                             uint16_t chr_val_handle,
+                             const struct ble_gatt_dsc *dsc,
+                             void *arg)
 {
-    NIMBLE_LOGD(LOG_TAG, ">> setValue: serviceUUID: %s, characteristicUUID: %s",
-                         serviceUUID.toString().c_str(), characteristicUUID.toString().c_str());
-
-    bool ret = false;
-    NimBLERemoteService* pService = getService(serviceUUID);
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    auto *attrs = (std::vector<std::pair<uint16_t, uint16_t>>*)pTaskData->buf;
 
-    if(pService != nullptr) {
-        NimBLERemoteCharacteristic* pChar = pService->getCharacteristic(characteristicUUID);
-        if(pChar != nullptr) {
-            ret = pChar->writeValue(value, response);
-        }
+    if(error->status == 0) {
+        attrs->push_back({dsc->handle, dsc->uuid.u.type == BLE_UUID_TYPE_16 ? dsc->uuid.u16.value : 0});
+        return 0;
     }
 
-    NIMBLE_LOGD(LOG_TAG, "<< setValue");
-    return ret;
-} // setValue
+    pTaskData->rc = (error->status == BLE_HS_EDONE) ? 0 : error->status;
+    xTaskNotifyGive(pTaskData->task);
+    return error->status;
+} // cccdDiscCB
 
 
 /**
@@ -894,24 +2616,101 @@ bool NimBLEClient::setValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &cha
  */
 NimBLERemoteCharacteristic* NimBLEClient::getCharacteristic(const uint16_t handle)
 {
-    NimBLERemoteService *pService = nullptr;
-    for(auto it = m_servicesVector.begin(); it != m_servicesVector.end(); ++it) {
-      if ((*it)->getStartHandle() <= handle && handle <= (*it)->getEndHandle()) {
-          pService = *it;
-          break;
-      }
+    if(!m_charHandleMapValid) {
+        buildCharHandleMap();
     }
 
-    if (pService != nullptr) {
-        for (auto it = pService->begin(); it != pService->end(); ++it) {
-            if ((*it)->getHandle() == handle) {
-                return *it;
-            }
-        }
+    auto it = std::lower_bound(m_charHandleMap.begin(), m_charHandleMap.end(), handle,
+                               [](const NimBLERemoteCharacteristic *pChr, uint16_t h) {
+                                   return pChr->m_handle < h;
+                               });
+
+    if(it != m_charHandleMap.end() && (*it)->m_handle == handle) {
+        return *it;
     }
 
     return nullptr;
-}
+} // getCharacteristic
+
+
+/**
+ * @brief Rebuild the table of characteristics sorted by value handle used to find
+ * the characteristic of a notification without searching every service.
+ */
+void NimBLEClient::buildCharHandleMap() {
+    m_charHandleMap.clear();
+    for(auto svc: m_servicesVector) {
+        m_charHandleMap.insert(m_charHandleMap.end(), svc->m_characteristicVector.begin(),
+                               svc->m_characteristicVector.end());
+    }
+
+    std::sort(m_charHandleMap.begin(), m_charHandleMap.end(),
+              [](const NimBLERemoteCharacteristic *a, const NimBLERemoteCharacteristic *b) {
+                  return a->m_handle < b->m_handle;
+              });
+
+    m_charHandleMapValid = true;
+    m_charHandleMapGen++;
+} // buildCharHandleMap
+
+
+/**
+ * @brief Wait until this task may perform a GATT operation on this client.
+ * @details Tasks are served in order of their FreeRTOS priority and in the order they
+ * called within the same priority. A task that already owns the client may call again,
+ * each call must be matched by a call to releaseOperation().
+ */
+void NimBLEClient::acquireOperation() {
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    // Allocate the waiter entry here as memory cannot be allocated in the critical section.
+    std::list<ble_op_waiter_t> waiter{{cur_task, uxTaskPriorityGet(nullptr)}};
+
+    ble_npl_hw_enter_critical();
+    if(m_opOwner == nullptr || m_opOwner == cur_task) {
+        m_opOwner = cur_task;
+        m_opDepth++;
+        ble_npl_hw_exit_critical(0);
+        return;
+    }
+
+    auto it = m_opWaiters.begin();
+    while(it != m_opWaiters.end() && it->priority >= waiter.front().priority) {
+        ++it;
+    }
+    m_opWaiters.splice(it, waiter);
+    ble_npl_hw_exit_critical(0);
+
+    NIMBLE_LOGD(LOG_TAG, "Waiting for pending GATT operation to complete");
+    while(m_opOwner != cur_task) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+} // acquireOperation
+
+
+/**
+ * @brief Release the GATT operation slot of this client and wake the next waiting task.
+ */
+void NimBLEClient::releaseOperation() {
+    // Holds the entry of the next owner so that it is freed outside the critical section.
+    std::list<ble_op_waiter_t> next;
+
+    ble_npl_hw_enter_critical();
+    if(--m_opDepth == 0) {
+        if(m_opWaiters.empty()) {
+            m_opOwner = nullptr;
+        } else {
+            next.splice(next.begin(), m_opWaiters, m_opWaiters.begin());
+            m_opOwner = next.front().task;
+            m_opDepth = 1;
+        }
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(!next.empty()) {
+        xTaskNotifyGive(next.front().task);
+    }
+} // releaseOperation
+
 
 /**
  * @brief Get the current mtu of this connection.
@@ -929,11 +2728,15 @@ uint16_t NimBLEClient::getMTU() {
  */
  /*STATIC*/
 int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
+    NIMBLE_CPP_STACK_PROFILE(CLIENT_GAP_EVENT, event->type);
+    NIMBLE_CPP_TRACE_GAP(CLIENT_GAP, event);
     NimBLEClient* client = (NimBLEClient*)arg;
     int rc;
 
     NIMBLE_LOGD(LOG_TAG, "Got Client event %s", NimBLEUtils::gapEventToString(event->type));
 
+    NimBLEDevice::dispatchGapEvent(event);
+
     switch(event->type) {
 
         case BLE_GAP_EVENT_DISCONNECT: {
@@ -947,6 +2750,8 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 case BLE_HS_EOS:
                     NIMBLE_LOGC(LOG_TAG, "Disconnect - host reset, rc=%d", rc);
                     NimBLEDevice::onReset(rc);
+                    // Reconnected by the device when the host has synced again.
+                    client->m_reconnectOnSync = NimBLEDevice::m_resetRecovery && client->m_connEstablished;
                     break;
                 default:
                     // Check that the event is for this client.
@@ -963,7 +2768,10 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
             NimBLEDevice::removeIgnored(client->m_peerAddress);
 
             // No longer connected, clear the connection ID.
+            NimBLEDevice::clearClientSlot(client);
             client->m_conn_id = BLE_HS_CONN_HANDLE_NONE;
+            client->m_encState = NIMBLE_CPP_ENC_IDLE;
+            client->updateServerPeerState(event->disconnect.conn.conn_handle);
 
             // If we received a connected event but did not get established (no PDU)
             // then a disconnect event will be sent but we should not send it to the
@@ -976,7 +2784,11 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                         rc, NimBLEUtils::returnCodeToString(rc));
 
             client->m_connEstablished = false;
-            client->m_pClientCallbacks->onDisconnect(client);
+            if(client->m_pClientCallbacks->m_callbacks & NimBLEClientCallbacks::CB_ON_DISCONNECT) {
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CLIENT_DISCONNECT, client,
+                                               event->disconnect.conn.conn_handle,
+                                               &event->disconnect.conn);
+            }
             break;
         } // BLE_GAP_EVENT_DISCONNECT
 
@@ -994,6 +2806,21 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
 
                 client->m_conn_id = event->connect.conn_handle;
 
+                // A connection initiated from the white list can be to any device on it.
+                if(client->m_useAcceptList) {
+                    ble_gap_conn_desc desc;
+                    if(ble_gap_conn_find(client->m_conn_id, &desc) != 0 ||
+                       NimBLEAddress(desc.peer_id_addr) != client->m_peerAddress) {
+                        NIMBLE_LOGE(LOG_TAG, "Connected to another white listed device, disconnecting");
+                        ble_gap_terminate(client->m_conn_id, BLE_ERR_REM_USER_CONN_TERM);
+                        client->m_conn_id = BLE_HS_CONN_HANDLE_NONE;
+                        rc = BLE_HS_ENOENT;
+                        break;
+                    }
+                }
+
+                NimBLEDevice::setClientSlot(client->m_conn_id, client);
+
                 rc = ble_gattc_exchange_mtu(client->m_conn_id, NULL,NULL);
                 if(rc != 0) {
                     NIMBLE_LOGE(LOG_TAG, "MTU exchange error; rc=%d %s",
@@ -1001,6 +2828,10 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                     break;
                 }
 
+                if(client->m_autoEncrypt && client->startAutoEncrypt()) {
+                    client->m_encState = NIMBLE_CPP_ENC_PENDING;
+                }
+
                 // In the case of a multiconnecting device we ignore this device when
                 // scanning since we are already connected to it
                 NimBLEDevice::addIgnored(client->m_peerAddress);
@@ -1025,40 +2856,23 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
             NIMBLE_LOGD(LOG_TAG, "Notify Recieved for handle: %d",
                         event->notify_rx.attr_handle);
 
-            for(auto &it: client->m_servicesVector) {
-                // Dont waste cycles searching services without this handle in its range
-                if(it->getEndHandle() < event->notify_rx.attr_handle) {
-                    continue;
-                }
-
-                auto cVector = &it->m_characteristicVector;
-                NIMBLE_LOGD(LOG_TAG, "checking service %s for handle: %d",
-                            it->getUUID().toString().c_str(),
-                            event->notify_rx.attr_handle);
-
-                auto characteristic = cVector->cbegin();
-                for(; characteristic != cVector->cend(); ++characteristic) {
-                    if((*characteristic)->m_handle == event->notify_rx.attr_handle)
-                        break;
-                }
-
-                if(characteristic != cVector->cend()) {
-                    NIMBLE_LOGD(LOG_TAG, "Got Notification for characteristic %s",
-                                (*characteristic)->toString().c_str());
-
-                    uint32_t data_len = OS_MBUF_PKTLEN(event->notify_rx.om);
-                    (*characteristic)->m_value.setValue(event->notify_rx.om->om_data, data_len);
+            NimBLERemoteCharacteristic *pChr = client->getCharacteristic(event->notify_rx.attr_handle);
+            if(pChr == nullptr) {
+                return 0;
+            }
 
-                    if ((*characteristic)->m_notifyCallback != nullptr) {
-                        NIMBLE_LOGD(LOG_TAG, "Invoking callback for notification on characteristic %s",
-                                    (*characteristic)->toString().c_str());
-                        (*characteristic)->m_notifyCallback(*characteristic, event->notify_rx.om->om_data,
-                                                            data_len, !event->notify_rx.indication);
-                    }
-                    break;
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+            // Service Changed, the cached attributes of this peer are no longer valid.
+            if(pChr->m_uuid == NimBLEUUID((uint16_t)0x2a05)) {
+                char key[15];
+                if(client->getCacheKey(key)) {
+                    NIMBLE_LOGI(LOG_TAG, "Service changed, deleting attribute cache");
+                    cacheErase(key);
                 }
             }
+#endif
 
+            pChr->onNotify(event->notify_rx.om, !event->notify_rx.indication);
             return 0;
         } // BLE_GAP_EVENT_NOTIFY_RX
 
@@ -1074,8 +2888,11 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                         event->conn_update_req.peer_params->latency,
                         event->conn_update_req.peer_params->supervision_timeout);
 
-            rc = client->m_pClientCallbacks->onConnParamsUpdateRequest(client,
-                                    event->conn_update_req.peer_params) ? 0 : BLE_ERR_CONN_PARMS;
+            rc = 0;
+            if(client->m_pClientCallbacks->m_callbacks & NimBLEClientCallbacks::CB_ON_CONN_PARAMS_REQUEST) {
+                rc = client->m_pClientCallbacks->onConnParamsUpdateRequest(client,
+                                        event->conn_update_req.peer_params) ? 0 : BLE_ERR_CONN_PARMS;
+            }
 
 
             if(!rc && event->type == BLE_GAP_EVENT_CONN_UPDATE_REQ ) {
@@ -1119,14 +2936,41 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 } else if(NimBLEDevice::m_securityCallbacks != nullptr) {
                     NimBLEDevice::m_securityCallbacks->onAuthenticationComplete(&desc);
                 } else {
-                    client->m_pClientCallbacks->onAuthenticationComplete(&desc);
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CLIENT_AUTH_COMPLETE, client,
+                                                   desc.conn_handle, &desc);
                 }
             }
 
+            client->updateServerPeerState(event->enc_change.conn_handle);
             rc = event->enc_change.status;
+
+            // Encryption started with the connection only wakes connect() if it is waiting for it.
+            if(client->m_encState != NIMBLE_CPP_ENC_IDLE) {
+                ble_npl_hw_enter_critical();
+                bool waiting = client->m_encState == NIMBLE_CPP_ENC_WAITING;
+                client->m_encState = NIMBLE_CPP_ENC_IDLE;
+                ble_npl_hw_exit_critical(0);
+                if(!waiting) {
+                    return 0;
+                }
+            }
             break;
         } //BLE_GAP_EVENT_ENC_CHANGE
 
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: {
+            if(client->m_conn_id != event->phy_updated.conn_handle){
+                return 0;
+            }
+
+            if(event->phy_updated.status == 0 &&
+               (client->m_pClientCallbacks->m_callbacks & NimBLEClientCallbacks::CB_ON_PHY_UPDATE)) {
+                client->m_pClientCallbacks->onPhyUpdate(client, event->phy_updated.tx_phy,
+                                                        event->phy_updated.rx_phy);
+            }
+            rc = 0;
+            break;
+        } // BLE_GAP_EVENT_PHY_UPDATE_COMPLETE
+
         case BLE_GAP_EVENT_MTU: {
             if(client->m_conn_id != event->mtu.conn_handle){
                 return 0;
@@ -1134,39 +2978,29 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
             NIMBLE_LOGI(LOG_TAG, "mtu update event; conn_handle=%d mtu=%d",
                         event->mtu.conn_handle,
                         event->mtu.value);
+            client->updateServerPeerState(event->mtu.conn_handle);
             rc = 0;
             break;
         } // BLE_GAP_EVENT_MTU
 
         case BLE_GAP_EVENT_PASSKEY_ACTION: {
-            struct ble_sm_io pkey = {0,0};
-
             if(client->m_conn_id != event->passkey.conn_handle)
                 return 0;
 
-            if (event->passkey.params.action == BLE_SM_IOACT_DISP) {
-                pkey.action = event->passkey.params.action;
-                pkey.passkey = NimBLEDevice::m_passkey; // This is the passkey to be entered on peer
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
-
-            } else if (event->passkey.params.action == BLE_SM_IOACT_NUMCMP) {
-                NIMBLE_LOGD(LOG_TAG, "Passkey on device's display: %" PRIu32, event->passkey.params.numcmp);
-                pkey.action = event->passkey.params.action;
-                // Compatibility only - Do not use, should be removed the in future
-                if(NimBLEDevice::m_securityCallbacks != nullptr) {
-                    pkey.numcmp_accept = NimBLEDevice::m_securityCallbacks->onConfirmPIN(event->passkey.params.numcmp);
-                ////////////////////////////////////////////////////
-                } else {
-                    pkey.numcmp_accept = client->m_pClientCallbacks->onConfirmPIN(event->passkey.params.numcmp);
-                }
-
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
+            if (event->passkey.params.action == BLE_SM_IOACT_DISP ||
+                event->passkey.params.action == BLE_SM_IOACT_NUMCMP ||
+                event->passkey.params.action == BLE_SM_IOACT_INPUT) {
+                // The callbacks may wait for the user, the callback tasks run them when started
+                // so the host keeps serving the other pairings.
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CLIENT_PASSKEY, client,
+                                               event->passkey.conn_handle, nullptr,
+                                               event->passkey.params.action,
+                                               (int)event->passkey.params.numcmp);
 
             //TODO: Handle out of band pairing
             } else if (event->passkey.params.action == BLE_SM_IOACT_OOB) {
                 static uint8_t tem_oob[16] = {0};
+                struct ble_sm_io pkey = {0,0};
                 pkey.action = event->passkey.params.action;
                 for (int i = 0; i < 16; i++) {
                     pkey.oob[i] = tem_oob[i];
@@ -1174,21 +3008,6 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
                 NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
             ////////
-            } else if (event->passkey.params.action == BLE_SM_IOACT_INPUT) {
-                NIMBLE_LOGD(LOG_TAG, "Enter the passkey");
-                pkey.action = event->passkey.params.action;
-
-                // Compatibility only - Do not use, should be removed the in future
-                if(NimBLEDevice::m_securityCallbacks != nullptr) {
-                    pkey.passkey = NimBLEDevice::m_securityCallbacks->onPassKeyRequest();
-                /////////////////////////////////////////////
-                } else {
-                    pkey.passkey = client->m_pClientCallbacks->onPassKeyRequest();
-                }
-
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
-
             } else if (event->passkey.params.action == BLE_SM_IOACT_NONE) {
                 NIMBLE_LOGD(LOG_TAG, "No passkey action required");
             }
@@ -1213,6 +3032,55 @@ int NimBLEClient::handleGapEvent(struct ble_gap_event *event, void *arg) {
 } // handleGapEvent
 
 
+/**
+ * @brief Get the passkey or numeric comparison result from the callbacks and give it to the stack.
+ * @param [in] connHandle The connection being paired.
+ * @param [in] action The passkey action, BLE_SM_IOACT_DISP, BLE_SM_IOACT_NUMCMP or BLE_SM_IOACT_INPUT.
+ * @param [in] numcmp The number to compare for BLE_SM_IOACT_NUMCMP.
+ * @details Called from a callback task when they are started, otherwise from the host task.
+ */
+void NimBLEClient::injectPasskey(uint16_t connHandle, uint8_t action, uint32_t numcmp) {
+    struct ble_sm_io pkey = {0,0};
+    int rc = 0;
+
+    pkey.action = action;
+    if (action == BLE_SM_IOACT_DISP) {
+        pkey.passkey = NimBLEDevice::m_passkey; // This is the passkey to be entered on peer
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
+
+    } else if (action == BLE_SM_IOACT_NUMCMP) {
+        NIMBLE_LOGD(LOG_TAG, "Passkey on device's display: %" PRIu32, numcmp);
+        // Compatibility only - Do not use, should be removed the in future
+        if(NimBLEDevice::m_securityCallbacks != nullptr) {
+            pkey.numcmp_accept = NimBLEDevice::m_securityCallbacks->onConfirmPIN(numcmp);
+        ////////////////////////////////////////////////////
+        } else {
+            pkey.numcmp_accept = m_pClientCallbacks->onConfirmPIN(numcmp);
+        }
+
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
+
+    } else if (action == BLE_SM_IOACT_INPUT) {
+        NIMBLE_LOGD(LOG_TAG, "Enter the passkey");
+
+        // Compatibility only - Do not use, should be removed the in future
+        if(NimBLEDevice::m_securityCallbacks != nullptr) {
+            pkey.passkey = NimBLEDevice::m_securityCallbacks->onPassKeyRequest();
+        /////////////////////////////////////////////
+        } else {
+            pkey.passkey = m_pClientCallbacks->onPassKeyRequest();
+        }
+
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
+    }
+
+    (void)rc;
+} // injectPasskey
+
+
 /**
  * @brief Are we connected to a server?
  * @return True if we are connected and false if we are not connected.
@@ -1262,6 +3130,42 @@ int NimBLEClient::getLastError() {
 } // getLastError
 
 
+#if CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+/**
+ * @brief Get the latency histogram of a type of operation on this client.
+ * @param [in] op The operation type.
+ * @return A reference to the histogram, it is updated as operations complete.
+ * @details Only operations that completed are recorded, failures to start a request and connection timeouts are not.
+ */
+const NimBLELatencyHistogram& NimBLEClient::getLatencyHistogram(NimBLELatencyHistogram::op_t op) {
+    if(op >= NimBLELatencyHistogram::OP_COUNT) {
+        op = NimBLELatencyHistogram::CONNECT;
+    }
+    return m_latency[op];
+} // getLatencyHistogram
+
+
+/**
+ * @brief Clear the latency histograms of all operation types on this client.
+ */
+void NimBLEClient::resetLatencyHistograms() {
+    for(auto &it : m_latency) {
+        it.reset();
+    }
+} // resetLatencyHistograms
+
+
+/**
+ * @brief Record the latency of an operation that started at the given time and just completed.
+ * @param [in] op The operation type.
+ * @param [in] start The time the request was started.
+ */
+void NimBLEClient::recordLatency(NimBLELatencyHistogram::op_t op, ble_npl_time_t start) {
+    m_latency[op].record(ble_npl_time_ticks_to_ms32(ble_npl_time_get() - start));
+} // recordLatency
+#endif
+
+
 void NimBLEClientCallbacks::onConnect(NimBLEClient* pClient) {
     NIMBLE_LOGD("NimBLEClientCallbacks", "onConnect: default");
 }
@@ -1291,6 +3195,18 @@ bool NimBLEClientCallbacks::onSecurityRequest(){
 void NimBLEClientCallbacks::onAuthenticationComplete(ble_gap_conn_desc* desc){
     NIMBLE_LOGD("NimBLEClientCallbacks", "onAuthenticationComplete: default");
 }
+void NimBLEClientCallbacks::onPhyUpdate(NimBLEClient* pClient, uint8_t txPhy, uint8_t rxPhy) {
+    NIMBLE_LOGD("NimBLEClientCallbacks", "onPhyUpdate: default");
+}
+
+void NimBLEClientCallbacks::onLinkReady(NimBLEClient* pClient, const NimBLELinkProfileResult& result) {
+    NIMBLE_LOGD("NimBLEClientCallbacks", "onLinkReady: default");
+}
+
+void NimBLEClientCallbacks::onDiscoveryComplete(NimBLEClient* pClient, int rc) {
+    NIMBLE_LOGD("NimBLEClientCallbacks", "onDiscoveryComplete: default");
+}
+
 bool NimBLEClientCallbacks::onConfirmPIN(uint32_t pin){
     NIMBLE_LOGD("NimBLEClientCallbacks", "onConfirmPIN: default: true");
     return true;
@@ -21,17 +21,45 @@
 #include "NimBLEUUID.h"
 #include "NimBLEUtils.h"
 #include "NimBLEConnInfo.h"
+#include "NimBLELinkProfile.h"
+#include "NimBLEPhyPolicy.h"
+#include "NimBLEPowerPolicy.h"
+#include "NimBLEConnParamsPolicy.h"
+#include "NimBLELatencyHistogram.h"
 #include "NimBLEAttValue.h"
+#include "NimBLEArena.h"
 #include "NimBLEAdvertisedDevice.h"
 #include "NimBLERemoteService.h"
+#include "NimBLECallbackBinding.h"
 
 #include <vector>
 #include <string>
+#include <functional>
+#include <list>
+
+#ifndef CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+#define CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED 0
+#endif
+
+// The cache is stored in NVS which is only available on ESP32.
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED && !defined(ESP_PLATFORM)
+#undef CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+#define CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED 0
+#endif
 
 class NimBLERemoteService;
 class NimBLERemoteCharacteristic;
+class NimBLERemoteCharacteristicRef;
 class NimBLEClientCallbacks;
 class NimBLEAdvertisedDevice;
+class NimBLEClient;
+
+typedef std::function<void (NimBLEClient* pClient, int rc)> discover_callback;
+typedef std::function<void (NimBLEClient* pClient, int rc)> connect_callback;
+typedef std::function<bool (NimBLERemoteCharacteristic* pCharacteristic)> subscribe_filter;
+// Also declared in NimBLERemoteCharacteristic.h, which includes this header before its own declarations.
+typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                uint8_t* pData, size_t length, bool isNotify)> notify_callback;
 
 /**
  * @brief A model of a %BLE client.
@@ -41,6 +69,7 @@ public:
     bool                                        connect(NimBLEAdvertisedDevice* device, bool deleteAttributes = true);
     bool                                        connect(const NimBLEAddress &address, bool deleteAttributes = true);
     bool                                        connect(bool deleteAttributes = true);
+    bool                                        fastReconnect(const NimBLEAddress &address, uint32_t timeoutMs = 1000);
     int                                         disconnect(uint8_t reason = BLE_ERR_REM_USER_CONN_TERM);
     NimBLEAddress                               getPeerAddress();
     void                                        setPeerAddress(const NimBLEAddress &address);
@@ -56,6 +85,15 @@ public:
     bool                                        setValue(const NimBLEUUID &serviceUUID, const NimBLEUUID &characteristicUUID,
                                                          const NimBLEAttValue &value, bool response = false);
     NimBLERemoteCharacteristic*                 getCharacteristic(const uint16_t handle);
+    NimBLERemoteCharacteristicRef               getCharacteristicRef(const NimBLEUUID &serviceUUID,
+                                                                     const NimBLEUUID &characteristicUUID);
+    bool                                        readMultiple(const std::vector<NimBLERemoteCharacteristic*> &characteristics,
+                                                             const std::vector<uint16_t> &lengths);
+    bool                                        writeReliable(const std::vector<std::pair<NimBLERemoteCharacteristic*,
+                                                                                          NimBLEAttValue>> &writes);
+    bool                                        subscribeAll(subscribe_filter filter = nullptr, bool notifications = true,
+                                                             notify_callback notifyCallback = nullptr,
+                                                             bool response = false);
     bool                                        isConnected();
     void                                        setClientCallbacks(NimBLEClientCallbacks *pClientCallbacks,
                                                                    bool deleteCallbacks = true);
@@ -63,6 +101,7 @@ public:
     uint16_t                                    getConnId();
     uint16_t                                    getMTU();
     bool                                        secureConnection();
+    void                                        setAutoEncrypt(bool enable);
     void                                        setConnectTimeout(uint8_t timeout);
     void                                        setConnectionParams(uint16_t minInterval, uint16_t maxInterval,
                                                                     uint16_t latency, uint16_t timeout,
@@ -70,9 +109,32 @@ public:
     void                                        updateConnParams(uint16_t minInterval, uint16_t maxInterval,
                                                                  uint16_t latency, uint16_t timeout);
     void                                        setDataLen(uint16_t tx_octets);
+    void                                        setLinkProfile(const NimBLELinkProfile &profile,
+                                                                   link_profile_callback callback = nullptr);
+    bool                                        applyLinkProfile(const NimBLELinkProfile &profile,
+                                                                     link_profile_callback callback = nullptr);
+    void                                        setPrepareOnConnect(bool negotiateLink, bool discover = true);
+    bool                                        setPhy(uint8_t txPhyMask, uint8_t rxPhyMask, uint16_t phyOptions = 0);
+    bool                                        getPhy(uint8_t* txPhy, uint8_t* rxPhy);
+    void                                        setPhyPolicy(const NimBLEPhyPolicy &policy);
+    void                                        setPowerPolicy(const NimBLEPowerPolicy &policy);
+    void                                        setConnParamsPolicy(const NimBLEConnParamsPolicy &policy);
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+    bool                                        transferPeriodicSync(uint16_t syncHandle, uint16_t serviceData = 0);
+#  if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+    bool                                        transferPeriodicAdvInfo(uint8_t instId, uint16_t serviceData = 0);
+#  endif
+    bool                                        receivePeriodicSync(uint16_t skip = 0, uint32_t timeoutMs = 10000);
+#endif
     bool                                        discoverAttributes();
+    bool                                        discoverAttributesAsync(discover_callback discoverCallback);
+    void                                        setSinglePassDiscovery(bool enable);
     NimBLEConnInfo                              getConnInfo();
     int                                         getLastError();
+#if CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+    const NimBLELatencyHistogram&               getLatencyHistogram(NimBLELatencyHistogram::op_t op);
+    void                                        resetLatencyHistograms();
+#endif
 #if CONFIG_BT_NIMBLE_EXT_ADV
     void                                        setConnectPhy(uint8_t mask);
 #endif
@@ -83,29 +145,131 @@ private:
 
     friend class            NimBLEDevice;
     friend class            NimBLERemoteService;
+    friend class            NimBLERemoteCharacteristic;
+    friend class            NimBLERemoteDescriptor;
+    friend class            NimBLEClientOperation;
+    friend class            NimBLERemoteCharacteristicRef;
+
+    typedef struct {
+        TaskHandle_t task;
+        UBaseType_t  priority;
+    } ble_op_waiter_t;
+
+    bool                    startAutoEncrypt();
+    static void*            allocAttribute(size_t size, NimBLEClient* pClient);
+    static void             freeAttribute(void* ptr);
+    void                    updateServerPeerState(uint16_t conn_handle);
+    void                    acquireOperation();
+    void                    releaseOperation();
+#if CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+    void                    recordLatency(NimBLELatencyHistogram::op_t op, ble_npl_time_t start);
+#endif
 
     static int              handleGapEvent(struct ble_gap_event *event, void *arg);
+    void                    injectPasskey(uint16_t connHandle, uint8_t action, uint32_t numcmp);
     static int              serviceDiscoveredCB(uint16_t conn_handle,
                                                 const struct ble_gatt_error *error,
                                                 const struct ble_gatt_svc *service,
                                                 void *arg);
     static void             dcTimerCb(ble_npl_event *event);
     bool                    retrieveServices(const NimBLEUUID *uuid_filter = nullptr);
+    void                    prepareConnection();
+    void                    buildCharHandleMap();
+    static int              readMultipleCB(uint16_t conn_handle,
+                                           const struct ble_gatt_error *error,
+                                           struct ble_gatt_attr *attr, void *arg);
+    static int              writeReliableCB(uint16_t conn_handle,
+                                            const struct ble_gatt_error *error,
+                                            struct ble_gatt_attr *attrs,
+                                            uint8_t num_attrs, void *arg);
+    static int              cccdDiscCB(uint16_t conn_handle,
+                                       const struct ble_gatt_error *error,
+                                       uint16_t chr_val_handle,
+                                       const struct ble_gatt_dsc *dsc,
+                                       void *arg);
+    void                    discoverNextAsync();
+    void                    discoverAsyncDone(int rc);
+    void                    discoverAllDescriptorsAsync();
+    static int              serviceDiscAsyncCB(uint16_t conn_handle,
+                                               const struct ble_gatt_error *error,
+                                               const struct ble_gatt_svc *service,
+                                               void *arg);
+    static int              characteristicDiscAsyncCB(uint16_t conn_handle,
+                                                      const struct ble_gatt_error *error,
+                                                      const struct ble_gatt_chr *chr,
+                                                      void *arg);
+    static int              descriptorDiscAsyncCB(uint16_t conn_handle,
+                                                  const struct ble_gatt_error *error,
+                                                  uint16_t chr_val_handle,
+                                                  const struct ble_gatt_dsc *dsc,
+                                                  void *arg);
+    static int              allCharacteristicsDiscCB(uint16_t conn_handle,
+                                                     const struct ble_gatt_error *error,
+                                                     const struct ble_gatt_chr *chr,
+                                                     void *arg);
+    static int              allDescriptorsDiscCB(uint16_t conn_handle,
+                                                 const struct ble_gatt_error *error,
+                                                 uint16_t chr_val_handle,
+                                                 const struct ble_gatt_dsc *dsc,
+                                                 void *arg);
+#if CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    bool                    getCacheKey(char *key);
+    bool                    readDatabaseHash(uint8_t *hash);
+    bool                    loadAttributeCache();
+    void                    saveAttributeCache();
+    void                    saveAttributeCacheAsync();
+    void                    writeAttributeCache(const uint8_t *hash);
+    static void             deleteAttributeCache(const NimBLEAddress *address);
+    static int              dbHashReadCB(uint16_t conn_handle,
+                                         const struct ble_gatt_error *error,
+                                         struct ble_gatt_attr *attr, void *arg);
+    static int              dbHashSaveCB(uint16_t conn_handle,
+                                         const struct ble_gatt_error *error,
+                                         struct ble_gatt_attr *attr, void *arg);
+#endif
 
     NimBLEAddress           m_peerAddress;
     int                     m_lastErr;
     uint16_t                m_conn_id;
     bool                    m_connEstablished;
+    bool                    m_autoEncrypt;
+    bool                    m_useAcceptList;
+    bool                    m_reconnectOnSync;
+    volatile uint8_t        m_encState;
     bool                    m_deleteCallbacks;
     int32_t                 m_connectTimeout;
     NimBLEClientCallbacks*  m_pClientCallbacks;
     ble_task_data_t*        m_pTaskData;
     ble_npl_callout         m_dcTimer;
+    discover_callback       m_discCallback;
+    size_t                  m_discSvcIdx;
+    size_t                  m_discChrIdx;
+    bool                    m_singlePassDisc;
 #if CONFIG_BT_NIMBLE_EXT_ADV
     uint8_t                 m_phyMask;
 #endif
 
     std::vector<NimBLERemoteService*> m_servicesVector;
+    std::vector<NimBLERemoteCharacteristic*> m_charHandleMap;
+    bool                    m_charHandleMapValid;
+    uint16_t                m_charHandleMapGen;
+    TaskHandle_t            m_opOwner;
+    uint8_t                 m_opDepth;
+    std::list<ble_op_waiter_t> m_opWaiters;
+    bool                    m_useLinkProfile;
+    NimBLELinkProfile       m_linkProfile;
+    link_profile_callback   m_linkProfileCb;
+    bool                    m_prepareLink;
+    bool                    m_prepareDiscover;
+    NimBLEPhyPolicy         m_phyPolicy;
+    NimBLEPowerPolicy       m_powerPolicy;
+    NimBLEConnParamsPolicy  m_connParamsPolicy;
+#if CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+    NimBLELatencyHistogram  m_latency[NimBLELatencyHistogram::OP_COUNT];
+#endif
+#if CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER
+    NimBLEArena             m_arena;
+#endif
 
 private:
     friend class NimBLEClientCallbacks;
@@ -114,11 +278,41 @@ private:
 }; // class NimBLEClient
 
 
+/**
+ * @brief Holds the GATT operation slot of a client for the lifetime of the object.
+ * @details Blocking ATT requests create one of these before starting the request so that
+ * requests from different tasks on the same client are performed one at a time.
+ */
+class NimBLEClientOperation {
+public:
+    NimBLEClientOperation(NimBLEClient *pClient) : m_pClient(pClient) {
+        m_pClient->acquireOperation();
+    }
+
+    ~NimBLEClientOperation() {
+        m_pClient->releaseOperation();
+    }
+
+private:
+    NimBLEClient *m_pClient;
+}; // class NimBLEClientOperation
+
+
 /**
  * @brief Callbacks associated with a %BLE client.
  */
 class NimBLEClientCallbacks {
 public:
+    /** @brief The callbacks of a NimBLEBoundClientCallbacks class that are called. */
+    enum {
+        CB_ON_CONNECT             = 0x01, /**< onConnect */
+        CB_ON_DISCONNECT          = 0x02, /**< onDisconnect */
+        CB_ON_CONN_PARAMS_REQUEST = 0x04, /**< onConnParamsUpdateRequest, the parameters are accepted without it */
+        CB_ON_PHY_UPDATE          = 0x08, /**< onPhyUpdate */
+        CB_ALL                    = 0xFF
+    };
+
+    NimBLEClientCallbacks() : m_callbacks(CB_ALL) {}
     virtual ~NimBLEClientCallbacks() {};
 
     /**
@@ -141,6 +335,28 @@ public:
      */
     virtual bool onConnParamsUpdateRequest(NimBLEClient* pClient, const ble_gap_upd_params* params);
 
+    /**
+     * @brief Called when the PHY of the connection changes.
+     * @param [in] pClient A pointer to the calling client object.
+     * @param [in] txPhy The transmit PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+     * @param [in] rxPhy The receive PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+     */
+    virtual void onPhyUpdate(NimBLEClient* pClient, uint8_t txPhy, uint8_t rxPhy);
+
+    /**
+     * @brief Called by connect() when the link negotiated before discovery is ready, see NimBLEClient::setPrepareOnConnect.
+     * @param [in] pClient A pointer to the calling client object.
+     * @param [in] result The PHY, data length and MTU achieved with the result of each step.
+     */
+    virtual void onLinkReady(NimBLEClient* pClient, const NimBLELinkProfileResult& result);
+
+    /**
+     * @brief Called by connect() when the attributes of the peer are discovered, see NimBLEClient::setPrepareOnConnect.
+     * @param [in] pClient A pointer to the calling client object.
+     * @param [in] rc 0 on success, the attributes may also have been kept or loaded from the cache.
+     */
+    virtual void onDiscoveryComplete(NimBLEClient* pClient, int rc);
+
     /**
      * @brief Called when server requests a passkey for pairing.
      * @return The passkey to be sent to the server.
@@ -163,7 +379,42 @@ public:
      * @return True to accept the pin.
      */
     virtual bool onConfirmPIN(uint32_t pin);
+
+protected:
+    explicit NimBLEClientCallbacks(uint8_t callbacks) : m_callbacks(callbacks) {}
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLEDevice;
+
+    uint8_t m_callbacks;
 };
 
+
+/**
+ * @brief Client callbacks bound at compile time, only the callbacks T overrides are called.
+ * @details Derive the callbacks class from this template with itself as T instead of from NimBLEClientCallbacks,
+ * e.g. `class MyCallbacks : public NimBLEBoundClientCallbacks<MyCallbacks>`. A disconnection is not queued to the
+ * callback task without an onDisconnect. The link, discovery, passkey and authentication callbacks are always
+ * called. The callbacks of T must be public.
+ */
+template<class T>
+class NimBLEBoundClientCallbacks : public NimBLEClientCallbacks {
+public:
+    NimBLEBoundClientCallbacks() : NimBLEClientCallbacks(callbacks()) {
+        static_assert(callbacks() != 0, "No public callbacks found, declare the overrides public");
+    }
+
+    /** @brief The CB_ON_* bits of the callbacks T overrides. */
+    static constexpr uint8_t callbacks() {
+        typedef NimBLEClientCallbacks B;
+        return NIMBLE_CPP_CALLBACK_BIT(T, B, onConnect, void(NimBLEClient*), CB_ON_CONNECT) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onDisconnect, void(NimBLEClient*), CB_ON_DISCONNECT) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onConnParamsUpdateRequest,
+                                       bool(NimBLEClient*, const ble_gap_upd_params*), CB_ON_CONN_PARAMS_REQUEST) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onPhyUpdate, void(NimBLEClient*, uint8_t, uint8_t), CB_ON_PHY_UPDATE);
+    }
+}; // NimBLEBoundClientCallbacks
+
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL */
 #endif /* MAIN_NIMBLECLIENT_H_ */
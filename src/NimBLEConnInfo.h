@@ -2,6 +2,7 @@
 #define NIMBLECONNINFO_H_
 
 #include "NimBLEAddress.h"
+#include "NimBLEConnStats.h"
 
 /**
  * @brief Connection information.
@@ -51,5 +52,10 @@ public:
 
     /** @brief Gets the key size used to encrypt the connection */
     uint8_t          getSecKeySize()       { return m_desc.sec_state.key_size; }
+
+#if CONFIG_NIMBLE_CPP_CONN_STATS
+    /** @brief Gets the throughput and error counters of the connection */
+    NimBLEConnStats  getStats()            { return NimBLEConnStats::get(m_desc.conn_handle); }
+#endif
 };
 #endif
@@ -0,0 +1,259 @@
+/*
+ * NimBLEConnParamsPolicy.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#include "NimBLEConnParamsPolicy.h"
+#include "NimBLEConnStates.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+// Number of samples to wait for a requested update before requesting again.
+#define NIMBLE_CPP_CONN_PARAMS_PENDING_SAMPLES 10
+
+static const char* LOG_TAG = "NimBLEConnParamsPolicy";
+
+enum {
+    CONN_PARAMS_NONE,
+    CONN_PARAMS_BULK,
+    CONN_PARAMS_IDLE,
+};
+
+typedef struct {
+    uint16_t               connHandle = BLE_HS_CONN_HANDLE_NONE;
+    uint8_t                current    = CONN_PARAMS_NONE;
+    uint8_t                requested  = CONN_PARAMS_NONE;
+    uint8_t                pending    = 0;
+    uint8_t                quiet      = 0;
+    uint32_t               lastPkts   = 0;
+    NimBLEConnParamsPolicy policy;
+    ble_npl_callout        timer;
+} ble_conn_params_state_t;
+
+static NimBLEConnStates<ble_conn_params_state_t> connParamsStates;
+
+
+/**
+ * @brief Construct a disabled connection parameters policy.
+ */
+NimBLEConnParamsPolicy::NimBLEConnParamsPolicy() {
+    intervalMs         = 0;
+    bulkRate           = 20;
+    idleRate           = 2;
+    idleSamples        = 6;
+    bulkMinInterval    = 6;
+    bulkMaxInterval    = 12;
+    bulkLatency        = 0;
+    idleMinInterval    = 80;
+    idleMaxInterval    = 160;
+    idleLatency        = 4;
+    supervisionTimeout = 400;
+} // NimBLEConnParamsPolicy
+
+
+/**
+ * @brief Get a connection parameters policy that samples the traffic every 500ms, uses a
+ * 7.5 - 15ms interval at 20 packets per second or more and a 100 - 200ms interval with a
+ * latency of 4 after 3 seconds at 2 packets per second or less.
+ * @return The adaptive connection parameters policy.
+ */
+NimBLEConnParamsPolicy NimBLEConnParamsPolicy::adaptive() {
+    NimBLEConnParamsPolicy policy;
+    policy.intervalMs = 500;
+    return policy;
+} // adaptive
+
+
+/**
+ * @brief Find the policy state of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @return A pointer to the state or nullptr if the policy is not running on the connection.
+ */
+static ble_conn_params_state_t* connParamsFindState(uint16_t conn_handle) {
+    return connParamsStates.find(conn_handle);
+} // connParamsFindState
+
+
+/**
+ * @brief Request the parameters of a profile.
+ * @param [in] state The policy state.
+ * @param [in] profile CONN_PARAMS_BULK or CONN_PARAMS_IDLE.
+ */
+static void connParamsRequest(ble_conn_params_state_t *state, uint8_t profile) {
+    const NimBLEConnParamsPolicy &policy = state->policy;
+    ble_gap_upd_params params;
+
+    if(profile == CONN_PARAMS_BULK) {
+        params.itvl_min = policy.bulkMinInterval;
+        params.itvl_max = policy.bulkMaxInterval;
+        params.latency  = policy.bulkLatency;
+    } else {
+        params.itvl_min = policy.idleMinInterval;
+        params.itvl_max = policy.idleMaxInterval;
+        params.latency  = policy.idleLatency;
+    }
+
+    params.supervision_timeout = policy.supervisionTimeout;
+    params.min_ce_len          = 0;
+    params.max_ce_len          = 0;
+
+    NIMBLE_LOGD(LOG_TAG, "Requesting %s parameters; conn_handle=%u",
+                profile == CONN_PARAMS_BULK ? "bulk" : "idle", state->connHandle);
+
+    // Another update procedure is in progress, try again on the next sample.
+    int rc = ble_gap_update_params(state->connHandle, &params);
+    if(rc != 0) {
+        if(rc != BLE_HS_EALREADY) {
+            NIMBLE_LOGE(LOG_TAG, "Update params error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        }
+        return;
+    }
+
+    state->requested = profile;
+    state->pending   = NIMBLE_CPP_CONN_PARAMS_PENDING_SAMPLES;
+} // connParamsRequest
+
+
+/**
+ * @brief Timer callback, samples the traffic and requests the profile that matches the rate.
+ */
+static void connParamsTimerCb(ble_npl_event *event) {
+    ble_conn_params_state_t *state = (ble_conn_params_state_t*)ble_npl_event_get_arg(event);
+    const NimBLEConnParamsPolicy &policy = state->policy;
+    uint32_t txPkts;
+    uint32_t rxPkts;
+
+    if(state->connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+
+    if(ble_gap_conn_traffic(state->connHandle, &txPkts, &rxPkts) != 0) {
+        return;
+    }
+
+    uint32_t pkts = txPkts + rxPkts;
+    uint32_t rate = (uint32_t)((uint64_t)(pkts - state->lastPkts) * 1000 / policy.intervalMs);
+    state->lastPkts = pkts;
+
+    uint8_t profile = CONN_PARAMS_NONE;
+    if(rate >= policy.bulkRate) {
+        state->quiet = 0;
+        profile = CONN_PARAMS_BULK;
+    } else if(rate <= policy.idleRate) {
+        if(state->quiet < policy.idleSamples) {
+            state->quiet++;
+        }
+        if(state->quiet >= policy.idleSamples) {
+            profile = CONN_PARAMS_IDLE;
+        }
+    } else {
+        state->quiet = 0;
+    }
+
+    if(state->pending > 0) {
+        state->pending--;
+        return;
+    }
+
+    if(profile != CONN_PARAMS_NONE && profile != state->current) {
+        connParamsRequest(state, profile);
+    }
+} // connParamsTimerCb
+
+
+/**
+ * @brief Start switching the connection parameters of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] policy The profiles and rates to switch at, the policy is not started if intervalMs is 0.
+ * @return True if the policy was started.
+ */
+bool NimBLEConnParamsPolicy::start(uint16_t conn_handle, const NimBLEConnParamsPolicy &policy) {
+    if(policy.intervalMs == 0) {
+        return false;
+    }
+
+    ble_conn_params_state_t *state = connParamsStates.claim(conn_handle);
+    if(state == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Connection parameters policy already running or no state available");
+        return false;
+    }
+
+    NimBLEDevice::gapSubscribe(conn_handle, NimBLEDevice::GAP_SUB_CONN_PARAMS);
+
+    uint32_t txPkts = 0;
+    uint32_t rxPkts = 0;
+    ble_gap_conn_traffic(conn_handle, &txPkts, &rxPkts);
+
+    state->policy    = policy;
+    state->current   = CONN_PARAMS_NONE;
+    state->requested = CONN_PARAMS_NONE;
+    state->pending   = 0;
+    state->quiet     = 0;
+    state->lastPkts  = txPkts + rxPkts;
+
+    ble_npl_callout_init(&state->timer, nimble_port_get_dflt_eventq(), connParamsTimerCb, state);
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+    return true;
+} // start
+
+
+/**
+ * @brief Handle the GAP events of a connection the policy is running on.
+ * @param [in] event The GAP event, called by the client and server event handlers.
+ */
+void NimBLEConnParamsPolicy::handleGapEvent(struct ble_gap_event *event) {
+    ble_conn_params_state_t *state;
+
+    switch(event->type) {
+        case BLE_GAP_EVENT_CONN_UPDATE: {
+            state = connParamsFindState(event->conn_update.conn_handle);
+            if(state == nullptr || state->requested == CONN_PARAMS_NONE) {
+                break;
+            }
+
+            // A rejected profile is recorded as current so it is only requested again
+            // after the traffic has moved to the other profile.
+            if(event->conn_update.status != 0) {
+                NIMBLE_LOGD(LOG_TAG, "Update rejected; conn_handle=%u status=%d",
+                            state->connHandle, event->conn_update.status);
+            }
+
+            state->current   = state->requested;
+            state->requested = CONN_PARAMS_NONE;
+            state->pending   = 0;
+            break;
+        }
+
+        case BLE_GAP_EVENT_DISCONNECT: {
+            state = connParamsFindState(event->disconnect.conn.conn_handle);
+            if(state != nullptr) {
+                ble_npl_callout_stop(&state->timer);
+                ble_npl_callout_deinit(&state->timer);
+                state->connHandle = BLE_HS_CONN_HANDLE_NONE;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+} // handleGapEvent
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
@@ -0,0 +1,73 @@
+/*
+ * NimBLEConnParamsPolicy.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLECONNPARAMSPOLICY_H_
+#define NIMBLECONNPARAMSPOLICY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+/**
+ * @brief Switches the connection parameters between a bulk and an idle profile from the traffic
+ * on the connection.
+ * @details The ACL packets sent and received are counted every interval, when the rate reaches
+ * bulkRate the bulk parameters are requested at once. When the rate has been at or below idleRate
+ * for idleSamples intervals in a row the idle parameters are requested. Rates between the two keep
+ * the current parameters. A rejected request is not repeated until the traffic changes profile.
+ */
+class NimBLEConnParamsPolicy {
+public:
+    NimBLEConnParamsPolicy();
+
+    static NimBLEConnParamsPolicy adaptive();
+
+    /** @brief The time between traffic samples in milliseconds, 0 disables the policy. */
+    uint32_t intervalMs;
+    /** @brief The packets per second at or above which the bulk parameters are requested. */
+    uint16_t bulkRate;
+    /** @brief The packets per second at or below which the connection counts as idle. */
+    uint16_t idleRate;
+    /** @brief The number of idle samples in a row before the idle parameters are requested. */
+    uint8_t  idleSamples;
+    /** @brief The bulk minimum connection interval in 1.25ms units. */
+    uint16_t bulkMinInterval;
+    /** @brief The bulk maximum connection interval in 1.25ms units. */
+    uint16_t bulkMaxInterval;
+    /** @brief The bulk slave latency in connection events. */
+    uint16_t bulkLatency;
+    /** @brief The idle minimum connection interval in 1.25ms units. */
+    uint16_t idleMinInterval;
+    /** @brief The idle maximum connection interval in 1.25ms units. */
+    uint16_t idleMaxInterval;
+    /** @brief The idle slave latency in connection events. */
+    uint16_t idleLatency;
+    /** @brief The supervision timeout of both profiles in 10ms units. */
+    uint16_t supervisionTimeout;
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    static bool start(uint16_t conn_handle, const NimBLEConnParamsPolicy &policy);
+    static void handleGapEvent(struct ble_gap_event *event);
+}; // NimBLEConnParamsPolicy
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLECONNPARAMSPOLICY_H_ */
@@ -0,0 +1,107 @@
+/*
+ * NimBLEConnStates.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLECONNSTATES_H_
+#define NIMBLECONNSTATES_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <new>
+
+/**
+ * @brief A table of per connection states that are allocated on first use.
+ * @tparam T A state type with a connHandle member that defaults to BLE_HS_CONN_HANDLE_NONE.
+ * @details The table holds a pointer per connection. A state is allocated when no released one is
+ * available and is kept for reuse once released by setting its connHandle to BLE_HS_CONN_HANDLE_NONE,
+ * so a feature that is not used costs one pointer per connection. States are never freed as a timer
+ * of a released state can still have an event in the queue.
+ */
+template<typename T>
+class NimBLEConnStates {
+public:
+    /**
+     * @brief Find the state of a connection, call with interrupts disabled.
+     * @param [in] connHandle The connection handle, BLE_HS_CONN_HANDLE_NONE for a released state.
+     * @return A pointer to the state or nullptr if none was found.
+     */
+    T* find(uint16_t connHandle) {
+        for(auto &it : m_states) {
+            if(it != nullptr && it->connHandle == connHandle) {
+                return it;
+            }
+        }
+        return nullptr;
+    } // find
+
+    /**
+     * @brief Claim a state for a connection, reusing a released state or allocating a new one.
+     * @param [in] connHandle The connection handle.
+     * @return A pointer to the state or nullptr if the connection has one already or no memory is available.
+     */
+    T* claim(uint16_t connHandle) {
+        T* state = nullptr;
+
+        ble_npl_hw_enter_critical();
+        bool claimed = find(connHandle) != nullptr;
+        if(!claimed) {
+            state = find(BLE_HS_CONN_HANDLE_NONE);
+            if(state != nullptr) {
+                state->connHandle = connHandle;
+            }
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(claimed || state != nullptr) {
+            return state;
+        }
+
+        // Allocated outside of the critical section, then placed if the connection was not claimed meanwhile.
+        state = new(std::nothrow) T();
+        if(state == nullptr) {
+            return nullptr;
+        }
+        state->connHandle = connHandle;
+
+        bool placed = false;
+        ble_npl_hw_enter_critical();
+        if(find(connHandle) == nullptr) {
+            for(auto &it : m_states) {
+                if(it == nullptr) {
+                    it = state;
+                    placed = true;
+                    break;
+                }
+            }
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(!placed) {
+            delete state;
+            return nullptr;
+        }
+        return state;
+    } // claim
+
+private:
+    T* m_states[CONFIG_BT_NIMBLE_MAX_CONNECTIONS] = {};
+}; // NimBLEConnStates
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLECONNSTATES_H_ */
@@ -0,0 +1,254 @@
+/*
+ * NimBLEConnStats.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#include "NimBLEConnStats.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)) && \
+    CONFIG_NIMBLE_CPP_CONN_STATS
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+typedef struct {
+    uint16_t         connHandle = BLE_HS_CONN_HANDLE_NONE;
+    NimBLEConnStats  stats;
+} ble_conn_stats_t;
+
+static ble_conn_stats_t connStats[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+
+
+/**
+ * @brief Find the counters of a connection, call with interrupts disabled.
+ */
+static ble_conn_stats_t* findStats(uint16_t connHandle) {
+    for(auto &it : connStats) {
+        if(it.connHandle == connHandle) {
+            return &it;
+        }
+    }
+    return nullptr;
+} // findStats
+
+
+/**
+ * @brief Get a copy of the counters of a connection.
+ * @param [in] connHandle The connection handle.
+ * @return The counters, all 0 if the connection is not open.
+ * @details The received data counters are read from the host, they are 0 when using the NimBLE stack of esp-idf.
+ */
+NimBLEConnStats NimBLEConnStats::get(uint16_t connHandle) {
+    NimBLEConnStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    ble_npl_hw_enter_critical();
+    ble_conn_stats_t* pStats = findStats(connHandle);
+    if(pStats != nullptr) {
+        stats = pStats->stats;
+    }
+    ble_npl_hw_exit_critical(0);
+
+#ifndef CONFIG_NIMBLE_CPP_IDF
+    struct ble_hs_rx_work work;
+    if(pStats != nullptr && ble_hs_rx_work_get(connHandle, &work) == 0) {
+        stats.rxPackets   = work.packets;
+        stats.rxMaxQueued = work.max_queued;
+        stats.rxMaxWait   = work.max_wait;
+    }
+#endif
+    return stats;
+} // get
+
+
+/**
+ * @brief Set the counters of a connection back to 0, the MTU is kept.
+ * @param [in] connHandle The connection handle.
+ */
+void NimBLEConnStats::reset(uint16_t connHandle) {
+    ble_npl_hw_enter_critical();
+    ble_conn_stats_t* pStats = findStats(connHandle);
+    if(pStats != nullptr) {
+        uint16_t mtu = pStats->stats.mtu;
+        memset(&pStats->stats, 0, sizeof(pStats->stats));
+        pStats->stats.mtu = mtu;
+    }
+    ble_npl_hw_exit_critical(0);
+} // reset
+
+
+/**
+ * @brief Add to a counter of a connection.
+ * @param [in] connHandle The connection handle, ignored if the connection is not open.
+ * @param [in] counter The counter to add to.
+ * @param [in] value The value to add.
+ */
+void NimBLEConnStats::add(uint16_t connHandle, uint32_t NimBLEConnStats::*counter, uint32_t value) {
+    ble_npl_hw_enter_critical();
+    ble_conn_stats_t* pStats = findStats(connHandle);
+    if(pStats != nullptr) {
+        pStats->stats.*counter += value;
+    }
+    ble_npl_hw_exit_critical(0);
+} // add
+
+
+/**
+ * @brief Raise a counter of a connection to a value if it is lower.
+ * @param [in] connHandle The connection handle, ignored if the connection is not open.
+ * @param [in] counter The counter to raise.
+ * @param [in] value The value to compare with.
+ */
+void NimBLEConnStats::setMax(uint16_t connHandle, uint32_t NimBLEConnStats::*counter, uint32_t value) {
+    ble_npl_hw_enter_critical();
+    ble_conn_stats_t* pStats = findStats(connHandle);
+    if(pStats != nullptr && pStats->stats.*counter < value) {
+        pStats->stats.*counter = value;
+    }
+    ble_npl_hw_exit_critical(0);
+} // setMax
+
+
+/**
+ * @brief Count the result of a GATT read or write if it failed.
+ * @param [in] connHandle The connection handle.
+ * @param [in] rc The NimBLE return code of the operation.
+ */
+void NimBLEConnStats::addAttResult(uint16_t connHandle, int rc) {
+    if(rc >= BLE_HS_ERR_ATT_BASE && rc < BLE_HS_ERR_HCI_BASE) {
+        add(connHandle, &NimBLEConnStats::attErrors, 1);
+    } else if(rc == BLE_HS_ETIMEOUT) {
+        add(connHandle, &NimBLEConnStats::timeouts, 1);
+    }
+} // addAttResult
+
+
+/**
+ * @brief Count an access to a local characteristic by the peer.
+ * @param [in] connHandle The connection handle.
+ * @param [in] write True for a write, false for a read.
+ * @param [in] length The number of bytes read or written.
+ * @param [in] rc The ATT result returned to the peer, an error is counted instead of the access.
+ */
+void NimBLEConnStats::addAccess(uint16_t connHandle, bool write, uint32_t length, int rc) {
+    ble_npl_hw_enter_critical();
+    ble_conn_stats_t* pStats = findStats(connHandle);
+    if(pStats != nullptr) {
+        if(rc != 0) {
+            pStats->stats.attErrors++;
+        } else if(write) {
+            pStats->stats.writeRxPackets++;
+            pStats->stats.writeRxBytes += length;
+        } else {
+            pStats->stats.readRxPackets++;
+            pStats->stats.readRxBytes += length;
+        }
+    }
+    ble_npl_hw_exit_critical(0);
+} // addAccess
+
+
+/**
+ * @brief Open, close and update the counters from the GAP events of a connection.
+ * @param [in] event The event from the server or client GAP event handler.
+ */
+void NimBLEConnStats::handleGapEvent(struct ble_gap_event *event) {
+    switch(event->type) {
+        case BLE_GAP_EVENT_CONNECT: {
+            if(event->connect.status != 0) {
+                return;
+            }
+
+            ble_npl_hw_enter_critical();
+            ble_conn_stats_t* pStats = findStats(event->connect.conn_handle);
+            if(pStats == nullptr) {
+                pStats = findStats(BLE_HS_CONN_HANDLE_NONE);
+            }
+            if(pStats != nullptr) {
+                pStats->connHandle = event->connect.conn_handle;
+                memset(&pStats->stats, 0, sizeof(pStats->stats));
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        case BLE_GAP_EVENT_DISCONNECT: {
+            ble_npl_hw_enter_critical();
+            ble_conn_stats_t* pStats = findStats(event->disconnect.conn.conn_handle);
+            if(pStats != nullptr) {
+                pStats->connHandle = BLE_HS_CONN_HANDLE_NONE;
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        case BLE_GAP_EVENT_MTU: {
+            ble_npl_hw_enter_critical();
+            ble_conn_stats_t* pStats = findStats(event->mtu.conn_handle);
+            if(pStats != nullptr && event->mtu.channel_id == BLE_L2CAP_CID_ATT) {
+                pStats->stats.mtu = event->mtu.value;
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        case BLE_GAP_EVENT_NOTIFY_RX:
+            add(event->notify_rx.conn_handle, &NimBLEConnStats::notifyRxPackets, 1);
+            add(event->notify_rx.conn_handle, &NimBLEConnStats::notifyRxBytes,
+                OS_MBUF_PKTLEN(event->notify_rx.om));
+            return;
+
+        case BLE_GAP_EVENT_NOTIFY_TX: {
+            int status = event->notify_tx.status;
+            // An indication reports 0 when sent and BLE_HS_EDONE when acknowledged.
+            if(status == 0 || (event->notify_tx.indication && status == BLE_HS_EDONE)) {
+                return;
+            }
+            if(status == BLE_HS_ETIMEOUT) {
+                add(event->notify_tx.conn_handle, &NimBLEConnStats::timeouts, 1);
+            } else {
+                add(event->notify_tx.conn_handle, &NimBLEConnStats::txFailures, 1);
+            }
+            return;
+        }
+
+        default:
+            return;
+    }
+} // handleGapEvent
+
+
+/**
+ * @brief Get the counters as a string.
+ */
+std::string NimBLEConnStats::toString() const {
+    char buf[416];
+    snprintf(buf, sizeof(buf),
+             "notify tx %u/%uB, indicate tx %u/%uB, notify rx %u/%uB, "
+             "read rx %u/%uB, write rx %u/%uB, read tx %u/%uB, write tx %u/%uB, "
+             "att errors %u, mbuf failures %u, tx failures %u, timeouts %u, "
+             "notify queue max %ums, rx %u, rx queued max %u, rx wait max %u, mtu %u",
+             (unsigned)notifyTxPackets, (unsigned)notifyTxBytes,
+             (unsigned)indicateTxPackets, (unsigned)indicateTxBytes,
+             (unsigned)notifyRxPackets, (unsigned)notifyRxBytes,
+             (unsigned)readRxPackets, (unsigned)readRxBytes,
+             (unsigned)writeRxPackets, (unsigned)writeRxBytes,
+             (unsigned)readTxPackets, (unsigned)readTxBytes,
+             (unsigned)writeTxPackets, (unsigned)writeTxBytes,
+             (unsigned)attErrors, (unsigned)mbufAllocFailures,
+             (unsigned)txFailures, (unsigned)timeouts,
+             (unsigned)notifyQueueMaxMs, (unsigned)rxPackets,
+             (unsigned)rxMaxQueued, (unsigned)rxMaxWait, (unsigned)mtu);
+    return std::string(buf);
+} // toString
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) && CONFIG_NIMBLE_CPP_CONN_STATS */
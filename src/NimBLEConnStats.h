@@ -0,0 +1,134 @@
+/*
+ * NimBLEConnStats.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLECONNSTATS_H_
+#define NIMBLECONNSTATS_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#ifndef CONFIG_NIMBLE_CPP_CONN_STATS
+#    define CONFIG_NIMBLE_CPP_CONN_STATS 0
+#endif
+
+#if CONFIG_NIMBLE_CPP_CONN_STATS
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Throughput and error counters of a connection, get them with NimBLEConnInfo::getStats().
+ * @details The counters start at 0 when the connection is established and are kept until it is closed.
+ * Tx and rx are from the point of view of this device, reads and writes count the bytes of the values.
+ */
+struct NimBLEConnStats {
+    /** @brief Notifications sent. */
+    uint32_t notifyTxPackets;
+    /** @brief Bytes of the notifications sent. */
+    uint32_t notifyTxBytes;
+    /** @brief Indications sent. */
+    uint32_t indicateTxPackets;
+    /** @brief Bytes of the indications sent. */
+    uint32_t indicateTxBytes;
+    /** @brief Notifications and indications received. */
+    uint32_t notifyRxPackets;
+    /** @brief Bytes of the notifications and indications received. */
+    uint32_t notifyRxBytes;
+    /** @brief Reads of local attributes by the peer. */
+    uint32_t readRxPackets;
+    /** @brief Bytes returned to reads by the peer. */
+    uint32_t readRxBytes;
+    /** @brief Writes to local attributes by the peer. */
+    uint32_t writeRxPackets;
+    /** @brief Bytes written by the peer. */
+    uint32_t writeRxBytes;
+    /** @brief Reads of remote characteristics. */
+    uint32_t readTxPackets;
+    /** @brief Bytes read from remote characteristics. */
+    uint32_t readTxBytes;
+    /** @brief Writes to remote characteristics. */
+    uint32_t writeTxPackets;
+    /** @brief Bytes written to remote characteristics. */
+    uint32_t writeTxBytes;
+    /** @brief ATT errors received in response to reads and writes or returned to the peer. */
+    uint32_t attErrors;
+    /** @brief Notifications and indications that could not be sent for lack of mbufs. */
+    uint32_t mbufAllocFailures;
+    /** @brief Notifications and indications the host failed to send. */
+    uint32_t txFailures;
+    /** @brief Indications and GATT procedures that timed out. */
+    uint32_t timeouts;
+    /** @brief The longest time a queued notification waited to be sent, in ms. */
+    uint32_t notifyQueueMaxMs;
+    /** @brief ACL data packets received from the peer and processed by the host, not cleared by reset(). */
+    uint32_t rxPackets;
+    /** @brief The most packets of the peer waiting to be processed by the host at once, not cleared by reset(). */
+    uint16_t rxMaxQueued;
+    /** @brief The most packets the host processed before one of the peer, not cleared by reset(). */
+    uint16_t rxMaxWait;
+    /** @brief The ATT MTU of the connection, 0 until it is exchanged. */
+    uint16_t mtu;
+
+    std::string                toString() const;
+
+    static NimBLEConnStats     get(uint16_t connHandle);
+    static void                reset(uint16_t connHandle);
+
+private:
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+    friend class NimBLEClient;
+    friend class NimBLECharacteristic;
+    friend class NimBLERemoteCharacteristic;
+    friend class NimBLERemoteCharacteristicRef;
+    friend class NimBLEHIDReportSender;
+    friend class NimBLEUartService;
+    friend class NimBLEUartClient;
+
+    static void                handleGapEvent(struct ble_gap_event *event);
+    static void                add(uint16_t connHandle, uint32_t NimBLEConnStats::*counter, uint32_t value);
+    static void                setMax(uint16_t connHandle, uint32_t NimBLEConnStats::*counter, uint32_t value);
+    static void                addAttResult(uint16_t connHandle, int rc);
+    static void                addAccess(uint16_t connHandle, bool write, uint32_t length, int rc);
+}; // NimBLEConnStats
+
+#define NIMBLE_CPP_CONN_STATS_ADD(connHandle, counter, value) \
+    NimBLEConnStats::add(connHandle, &NimBLEConnStats::counter, value)
+#define NIMBLE_CPP_CONN_STATS_MAX(connHandle, counter, value) \
+    NimBLEConnStats::setMax(connHandle, &NimBLEConnStats::counter, value)
+#define NIMBLE_CPP_CONN_STATS_ATT_RESULT(connHandle, rc) \
+    NimBLEConnStats::addAttResult(connHandle, rc)
+#define NIMBLE_CPP_CONN_STATS_GAP_EVENT(event) \
+    NimBLEConnStats::handleGapEvent(event)
+#define NIMBLE_CPP_CONN_STATS_MARK(var, om) \
+    uint16_t var = OS_MBUF_PKTLEN(om)
+#define NIMBLE_CPP_CONN_STATS_ACCESS(connHandle, write, length, rc) \
+    NimBLEConnStats::addAccess(connHandle, write, length, rc)
+
+#else
+#define NIMBLE_CPP_CONN_STATS_ADD(connHandle, counter, value)
+#define NIMBLE_CPP_CONN_STATS_MAX(connHandle, counter, value)
+#define NIMBLE_CPP_CONN_STATS_ATT_RESULT(connHandle, rc)
+#define NIMBLE_CPP_CONN_STATS_GAP_EVENT(event)
+#define NIMBLE_CPP_CONN_STATS_MARK(var, om)
+#define NIMBLE_CPP_CONN_STATS_ACCESS(connHandle, write, length, rc)
+#endif /* CONFIG_NIMBLE_CPP_CONN_STATS */
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLECONNSTATS_H_ */
@@ -17,6 +17,7 @@
 
 #include "NimBLEService.h"
 #include "NimBLEDescriptor.h"
+#include "NimBLEDevice.h"
 #include "NimBLELog.h"
 
 #include <string>
@@ -91,6 +92,25 @@ NimBLEDescriptor::NimBLEDescriptor(NimBLEUUID uuid, uint16_t properties, uint16_
 NimBLEDescriptor::~NimBLEDescriptor() {
 } // ~NimBLEDescriptor
 
+
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+/**
+ * @brief Allocate a descriptor from the server arena.
+ * @details Falls back to the heap if the arena is full.
+ */
+void* NimBLEDescriptor::operator new(size_t size) {
+    return NimBLEArena::server().alloc(size);
+} // operator new
+
+
+/**
+ * @brief Return a descriptor to the server arena, or the heap if it was not allocated from the arena.
+ */
+void NimBLEDescriptor::operator delete(void* ptr) {
+    NimBLEArena::server().free(ptr);
+} // operator delete
+#endif
+
 /**
  * @brief Get the BLE handle for this descriptor.
  * @return The handle for this descriptor.
@@ -152,17 +172,21 @@ int NimBLEDescriptor::handleGapEvent(uint16_t conn_handle, uint16_t attr_handle,
                                      struct ble_gatt_access_ctxt *ctxt, void *arg) {
     (void)conn_handle;
     (void)attr_handle;
+    NIMBLE_CPP_STACK_PROFILE(DSC_ACCESS, -1);
+    NIMBLE_CPP_TRACE_ACCESS(DSC_ACCESS, conn_handle, attr_handle, ctxt);
 
     const ble_uuid_t *uuid;
     int rc;
     struct ble_gap_conn_desc desc;
     NimBLEDescriptor* pDescriptor = (NimBLEDescriptor*)arg;
 
-    NIMBLE_LOGD(LOG_TAG, "Descriptor %s %s event", pDescriptor->getUUID().toString().c_str(),
+    NIMBLE_LOGD(LOG_TAG, "Descriptor %s %s event", NIMBLE_CPP_STR(pDescriptor->getUUID()),
                                     ctxt->op == BLE_GATT_ACCESS_OP_READ_DSC ? "Read" : "Write");
 
     uuid = ctxt->chr->uuid;
-    if(ble_uuid_cmp(uuid, &pDescriptor->getUUID().getNative()->u) == 0){
+    // The attribute definitions point to the UUID of the object, only compare the values if they do not.
+    if(uuid == &pDescriptor->m_uuid.getNative()->u ||
+       ble_uuid_cmp(uuid, &pDescriptor->m_uuid.getNative()->u) == 0){
         switch(ctxt->op) {
             case BLE_GATT_ACCESS_OP_READ_DSC: {
                 rc = ble_gap_conn_find(conn_handle, &desc);
@@ -175,35 +199,17 @@ int NimBLEDescriptor::handleGapEvent(uint16_t conn_handle, uint16_t attr_handle,
                     pDescriptor->m_pCallbacks->onRead(pDescriptor);
                 }
 
-                ble_npl_hw_enter_critical();
-                rc = os_mbuf_append(ctxt->om, pDescriptor->m_value.data(), pDescriptor->m_value.size());
-                ble_npl_hw_exit_critical(0);
-                return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+                return pDescriptor->m_value.appendToMbuf(ctxt->om) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
             }
 
             case BLE_GATT_ACCESS_OP_WRITE_DSC: {
-                uint16_t att_max_len = pDescriptor->m_value.max_size();
-
-                if (ctxt->om->om_len > att_max_len) {
+                // Copy the mbuf chain straight into the value storage.
+                if(!pDescriptor->m_value.setValueFromMbuf(ctxt->om)) {
                     return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
                 }
 
-                uint8_t buf[att_max_len];
-                size_t len = ctxt->om->om_len;
-                memcpy(buf, ctxt->om->om_data,len);
-                os_mbuf *next;
-                next = SLIST_NEXT(ctxt->om, om_next);
-                while(next != NULL){
-                    if((len + next->om_len) > att_max_len) {
-                        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
-                    }
-                    memcpy(&buf[len], next->om_data, next->om_len);
-                    len += next->om_len;
-                    next = SLIST_NEXT(next, om_next);
-                }
-
-                pDescriptor->setValue(buf, len);
-                pDescriptor->m_pCallbacks->onWrite(pDescriptor);
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_DSC_WRITE, pDescriptor,
+                                               conn_handle, nullptr);
                 return 0;
             }
             default:
@@ -19,6 +19,7 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 
 #include "NimBLECharacteristic.h"
+#include "NimBLEArena.h"
 #include "NimBLEUUID.h"
 #include "NimBLEAttValue.h"
 
@@ -34,6 +35,11 @@ class NimBLEDescriptorCallbacks;
  */
 class NimBLEDescriptor {
 public:
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+    static void*    operator new(size_t size);
+    static void     operator delete(void* ptr);
+#endif
+
     NimBLEDescriptor(const char* uuid, uint16_t properties,
                      uint16_t max_len,
                      NimBLECharacteristic* pCharacteristic = nullptr);
@@ -79,10 +85,17 @@ public:
         return m_value.getValue<T>(timestamp, skipSizeCheck);
     }
 
+    /**
+     * @brief Get the access callback to use in a static descriptor definition, see NIMBLE_STATIC_DSC.
+     */
+    static constexpr ble_gatt_access_fn* staticAccessCb() { return handleGapEvent; }
+
 private:
     friend class NimBLECharacteristic;
     friend class NimBLEService;
+    friend class NimBLEServer;
     friend class NimBLE2904;
+    friend class NimBLEDevice;
 
     static int handleGapEvent(uint16_t conn_handle, uint16_t attr_handle,
                               struct ble_gatt_access_ctxt *ctxt, void *arg);
@@ -17,6 +17,7 @@
 
 #include "NimBLEDevice.h"
 #include "NimBLEUtils.h"
+#include "NimBLEArena.h"
 
 #ifdef ESP_PLATFORM
 #  include "esp_err.h"
@@ -34,8 +35,10 @@
 #  else
 #    include "nimble/esp_port/esp-hci/include/esp_nimble_hci.h"
 #  endif
-#else
+#elif !defined(NIMBLE_NPL_POSIX)
 #  include "nimble/nimble/controller/include/controller/ble_phy.h"
+#  include "nimble/nimble/controller/include/controller/ble_ll_scan.h"
+#  include "nimble/nimble/controller/include/controller/ble_ll_resolv.h"
 #endif
 
 #ifndef CONFIG_NIMBLE_CPP_IDF
@@ -54,20 +57,36 @@
 
 #include "NimBLELog.h"
 
+#include <algorithm>
+
 static const char* LOG_TAG = "NimBLEDevice";
 
+// Marks the end of a list of notify queue entries.
+#define NIMBLE_CPP_NOTIFY_NONE 0xffff
+
 /**
  * Singletons for the NimBLEDevice.
  */
 static bool            initialized = false;
+static bool            suspended = false;
+static struct ble_hs_stop_listener suspendListener;
+static struct ble_npl_event        resumeEvent;
 #if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
 NimBLEScan*     NimBLEDevice::m_pScan = nullptr;
 #endif
 #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 NimBLEServer*   NimBLEDevice::m_pServer = nullptr;
 #endif
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+NimBLEL2CAPServer* NimBLEDevice::m_pL2CAPServer = nullptr;
+#endif
 uint32_t        NimBLEDevice::m_passkey = 123456;
 bool            NimBLEDevice::m_synced = false;
+bool            NimBLEDevice::m_resetRecovery = false;
+ble_npl_time_t  NimBLEDevice::m_resetTime = 0;
+uint8_t         NimBLEDevice::m_recoveryPending = 0;
+NimBLEResetRecoveryStats NimBLEDevice::m_recoveryStats = {};
+uint8_t         NimBLEDevice::m_coexPriority[3] = {};
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
 #  if CONFIG_BT_NIMBLE_EXT_ADV
 NimBLEExtAdvertising* NimBLEDevice::m_bleAdvertising = nullptr;
@@ -80,14 +99,45 @@ gap_event_handler           NimBLEDevice::m_customGapHandler = nullptr;
 ble_gap_event_listener      NimBLEDevice::m_listener;
 #if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 std::list <NimBLEClient*>   NimBLEDevice::m_cList;
+NimBLEClient*               NimBLEDevice::m_clientSlots[NIMBLE_MAX_CONNECTIONS] = {};
+std::list <NimBLEDevice::ble_connect_req_t> NimBLEDevice::m_connectQueue;
+TaskHandle_t                NimBLEDevice::m_connectTask = nullptr;
+TaskHandle_t                NimBLEDevice::m_notifyTask = nullptr;
+NimBLEDevice::ble_notify_entry_t* NimBLEDevice::m_notifyPool = nullptr;
+uint8_t*                    NimBLEDevice::m_notifyData = nullptr;
+uint16_t                    NimBLEDevice::m_notifyMaxLength = 0;
+uint16_t                    NimBLEDevice::m_notifyFree = NIMBLE_CPP_NOTIFY_NONE;
+uint16_t                    NimBLEDevice::m_notifyHead = NIMBLE_CPP_NOTIFY_NONE;
+uint16_t                    NimBLEDevice::m_notifyTail = NIMBLE_CPP_NOTIFY_NONE;
+bool                        NimBLEDevice::m_notifyDropOldest = false;
+uint32_t                    NimBLEDevice::m_notifyDrops = 0;
+uint32_t                    NimBLEDevice::m_notifyTruncated = 0;
 #endif
-std::list <NimBLEAddress>   NimBLEDevice::m_ignoreList;
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+NimBLEDevice::ble_gap_subs_t NimBLEDevice::m_gapSubs[NIMBLE_MAX_CONNECTIONS];
+#endif
+std::vector<uint64_t>       NimBLEDevice::m_ignoreList;
 std::vector<NimBLEAddress>  NimBLEDevice::m_whiteList;
+std::vector<NimBLEAddress>  NimBLEDevice::m_whiteListCommitted;
+bool                        NimBLEDevice::m_whiteListBatch = false;
 NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
 uint8_t                     NimBLEDevice::m_own_addr_type = BLE_OWN_ADDR_PUBLIC;
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+NimBLEDevice::ble_callback_task_t*  NimBLEDevice::m_callbackTasks = nullptr;
+NimBLEDevice::ble_callback_entry_t* NimBLEDevice::m_callbackPool = nullptr;
+uint8_t                     NimBLEDevice::m_numCallbackTasks = 0;
+uint16_t                    NimBLEDevice::m_callbackFree = NIMBLE_CPP_NOTIFY_NONE;
+uint32_t                    NimBLEDevice::m_callbackQueueFull = 0;
+#endif
 #ifdef ESP_PLATFORM
 uint16_t                    NimBLEDevice::m_scanDuplicateSize = CONFIG_BTDM_SCAN_DUPL_CACHE_SIZE;
 uint8_t                     NimBLEDevice::m_scanFilterMode = CONFIG_BTDM_SCAN_DUPL_TYPE;
+int                         NimBLEDevice::m_hostCore = -1;
+int                         NimBLEDevice::m_controllerCore = -1;
+int                         NimBLEDevice::m_appCore = -1;
+#else
+uint16_t                    NimBLEDevice::m_scanDuplicateSize = MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS);
+uint8_t                     NimBLEDevice::m_scanFilterMode = 0;
 #endif
 
 /**
@@ -117,6 +167,30 @@ uint8_t                     NimBLEDevice::m_scanFilterMode = CONFIG_BTDM_SCAN_DU
 #endif // #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 
 
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+/**
+ * @brief Create the instance of the L2CAP server.
+ * @return A pointer to the L2CAP server.
+ */
+/* STATIC */ NimBLEL2CAPServer* NimBLEDevice::createL2CAPServer() {
+    if(NimBLEDevice::m_pL2CAPServer == nullptr) {
+        NimBLEDevice::m_pL2CAPServer = new NimBLEL2CAPServer();
+    }
+
+    return m_pL2CAPServer;
+} // createL2CAPServer
+
+
+/**
+ * @brief Get the instance of the L2CAP server.
+ * @return A pointer to the L2CAP server or nullptr if not created.
+ */
+/* STATIC */ NimBLEL2CAPServer* NimBLEDevice::getL2CAPServer() {
+    return m_pL2CAPServer;
+} // getL2CAPServer
+#endif // #if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+
+
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
 #  if CONFIG_BT_NIMBLE_EXT_ADV
 /**
@@ -265,6 +339,26 @@ bool NimBLEDevice::deleteClient(NimBLEClient* pClient) {
         }
     }
 
+    // Remove any queued connection requests for this client. The nodes are moved out of
+    // the queue in the critical section and freed after it.
+    std::list<ble_connect_req_t> removed;
+    ble_npl_hw_enter_critical();
+    for(auto it = m_connectQueue.begin(); it != m_connectQueue.end();) {
+        auto next = std::next(it);
+        if(it->pClient == pClient) {
+            removed.splice(removed.end(), m_connectQueue, it);
+        }
+        it = next;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    for(auto &it : removed) {
+        if(it.recovery) {
+            recoveryConnected(BLE_HS_ENOTCONN);
+        }
+    }
+
+    clearClientSlot(pClient);
     m_cList.remove(pClient);
     delete pClient;
 
@@ -272,6 +366,302 @@ bool NimBLEDevice::deleteClient(NimBLEClient* pClient) {
 } // deleteClient
 
 
+/**
+ * @brief Queue a client to be connected by the connection task.
+ * @param [in] pClient A pointer to the client, the peer address must be set.
+ * @param [in] callback The function to call when the client is connected and discovered, or failed.
+ * @param [in] discover If true, the attributes of the peer are discovered after connecting.
+ * @return True if the request was queued.
+ * @details The controller can only create one connection at a time so requests are connected
+ * one after another in the order they were queued. Attribute discovery does not block the queue,
+ * the next peer is connected while the previous one is being discovered. The callback is called
+ * with rc == 0 on success or the error code, from the connection task or the host task.
+ * A client must not be deleted while it is connecting.
+ */
+/* STATIC */
+bool NimBLEDevice::queueConnect(NimBLEClient* pClient, connect_callback callback, bool discover) {
+    if(pClient == nullptr) {
+        return false;
+    }
+
+    return queueConnect({pClient, callback, discover, false});
+} // queueConnect
+
+
+/**
+ * @brief Queue a connection request to be run by the connection task.
+ * @param [in] request The request, a reset recovery request keeps the attributes of the client.
+ * @return True if the request was queued.
+ */
+/* STATIC */
+bool NimBLEDevice::queueConnect(const ble_connect_req_t &request) {
+    if(m_connectTask == nullptr) {
+#ifdef ESP_PLATFORM
+        BaseType_t rc = xTaskCreatePinnedToCore(NimBLEDevice::connectTask, "nimble_connect", 4096,
+                                                nullptr, 1, &m_connectTask, getTaskCore(-1));
+#else
+        BaseType_t rc = xTaskCreate(NimBLEDevice::connectTask, "nimble_connect", 4096 / sizeof(StackType_t),
+                                    nullptr, 1, &m_connectTask);
+#endif
+        if(rc != pdPASS) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to create connect task");
+            m_connectTask = nullptr;
+            return false;
+        }
+    }
+
+    // Allocate the node outside of the critical section and splice it in.
+    std::list<ble_connect_req_t> req;
+    req.push_back(request);
+
+    ble_npl_hw_enter_critical();
+    m_connectQueue.splice(m_connectQueue.end(), req);
+    ble_npl_hw_exit_critical(0);
+
+    xTaskNotifyGive(m_connectTask);
+    return true;
+} // queueConnect
+
+
+/**
+ * @brief The task that connects the clients in the connect queue.
+ */
+/* STATIC */
+void NimBLEDevice::connectTask(void *param) {
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for(;;) {
+            std::list<ble_connect_req_t> req;
+            ble_npl_hw_enter_critical();
+            if(!m_connectQueue.empty()) {
+                req.splice(req.end(), m_connectQueue, m_connectQueue.begin());
+            }
+            ble_npl_hw_exit_critical(0);
+
+            if(req.empty()) {
+                break;
+            }
+
+            NimBLEClient* pClient = req.front().pClient;
+            connect_callback callback = req.front().callback;
+
+            // Reset recovery keeps the attributes discovered before the reset.
+            if(!pClient->connect(!req.front().recovery)) {
+                int rc = pClient->getLastError();
+                if(callback != nullptr) {
+                    callback(pClient, rc != 0 ? rc : BLE_HS_ETIMEOUT);
+                }
+                continue;
+            }
+
+            // Skip discovery if the attributes were loaded from the cache when connecting.
+            if(req.front().discover && pClient->getServices()->empty()) {
+                if(!pClient->discoverAttributesAsync(callback)) {
+                    int rc = pClient->getLastError();
+                    if(callback != nullptr) {
+                        callback(pClient, rc != 0 ? rc : BLE_HS_EUNKNOWN);
+                    }
+                }
+                continue;
+            }
+
+            if(callback != nullptr) {
+                callback(pClient, 0);
+            }
+        }
+    }
+} // connectTask
+
+
+/**
+ * @brief Deliver client notifications and indications from a separate task instead of the host task.
+ * @param [in] queueSize The number of notifications that can be waiting to be delivered.
+ * @param [in] maxLength The maximum length of a queued notification, longer notifications are truncated.
+ * @param [in] taskStackSize The stack size in bytes of the notify task.
+ * @param [in] taskPriority The priority of the notify task.
+ * @param [in] taskCore The core to run the notify task on, -1 for the core set with setTaskAffinity.
+ * Only used on ESP32.
+ * @param [in] dropOldest If true, the oldest waiting notification is dropped when the queue is full,
+ * otherwise the new notification is dropped.
+ * @return True if the notify task was started.
+ * @details The host task only copies the notification into a buffer from a pool allocated here,
+ * the value update and the notify_callback of the characteristic are run by the notify task.
+ * A notify_mbuf_callback is still called from the host task. Can only be set once.
+ */
+/* STATIC */
+bool NimBLEDevice::setNotifyQueue(uint16_t queueSize, uint16_t maxLength, uint32_t taskStackSize,
+                                  uint8_t taskPriority, int taskCore, bool dropOldest)
+{
+    if(m_notifyTask != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Notify queue already started");
+        return false;
+    }
+
+    if(queueSize == 0 || queueSize >= NIMBLE_CPP_NOTIFY_NONE || maxLength == 0) {
+        return false;
+    }
+
+    m_notifyPool = new ble_notify_entry_t[queueSize];
+    m_notifyData = new uint8_t[queueSize * maxLength];
+    m_notifyMaxLength = maxLength;
+    m_notifyDropOldest = dropOldest;
+    m_notifyHead = NIMBLE_CPP_NOTIFY_NONE;
+    m_notifyTail = NIMBLE_CPP_NOTIFY_NONE;
+
+    for(uint16_t i = 0; i < queueSize; i++) {
+        m_notifyPool[i].next = (i + 1 < queueSize) ? i + 1 : NIMBLE_CPP_NOTIFY_NONE;
+    }
+    m_notifyFree = 0;
+
+#ifdef ESP_PLATFORM
+    BaseType_t rc = xTaskCreatePinnedToCore(NimBLEDevice::notifyTask, "nimble_notify", taskStackSize,
+                                            nullptr, taskPriority, &m_notifyTask,
+                                            getTaskCore(taskCore));
+#else
+    (void)taskCore;
+    BaseType_t rc = xTaskCreate(NimBLEDevice::notifyTask, "nimble_notify", taskStackSize / sizeof(StackType_t),
+                                nullptr, taskPriority, &m_notifyTask);
+#endif
+
+    if(rc != pdPASS) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to create notify task");
+        m_notifyTask = nullptr;
+        delete[] m_notifyPool;
+        m_notifyPool = nullptr;
+        delete[] m_notifyData;
+        m_notifyData = nullptr;
+        return false;
+    }
+
+    return true;
+} // setNotifyQueue
+
+
+/**
+ * @brief Get the number of notifications dropped because the notify queue was full.
+ * @return The number of notifications dropped since the notify queue was started.
+ */
+/* STATIC */
+uint32_t NimBLEDevice::getNotifyDropCount() {
+    return m_notifyDrops;
+} // getNotifyDropCount
+
+
+/**
+ * @brief Get the number of notifications truncated because they were longer than the queue maximum length.
+ * @return The number of notifications truncated since the notify queue was started.
+ */
+/* STATIC */
+uint32_t NimBLEDevice::getNotifyTruncateCount() {
+    return m_notifyTruncated;
+} // getNotifyTruncateCount
+
+
+/**
+ * @brief Copy a notification into the notify queue and wake the notify task, called from the host task.
+ * @param [in] pChr The characteristic the notification was received for.
+ * @param [in] om The mbuf chain holding the notification data.
+ * @param [in] isNotify True if a notification, false if an indication.
+ * @return True if the notification was handled by the queue, even if it was dropped,
+ * false if the notify queue is not running.
+ */
+/* STATIC */
+bool NimBLEDevice::queueNotify(NimBLERemoteCharacteristic* pChr, const struct os_mbuf *om, bool isNotify) {
+    if(m_notifyTask == nullptr) {
+        return false;
+    }
+
+    ble_npl_hw_enter_critical();
+    uint16_t idx = m_notifyFree;
+    if(idx != NIMBLE_CPP_NOTIFY_NONE) {
+        m_notifyFree = m_notifyPool[idx].next;
+    } else if(m_notifyDropOldest && m_notifyHead != NIMBLE_CPP_NOTIFY_NONE) {
+        idx = m_notifyHead;
+        m_notifyHead = m_notifyPool[idx].next;
+        if(m_notifyHead == NIMBLE_CPP_NOTIFY_NONE) {
+            m_notifyTail = NIMBLE_CPP_NOTIFY_NONE;
+        }
+        m_notifyDrops++;
+    } else {
+        m_notifyDrops++;
+        ble_npl_hw_exit_critical(0);
+        return true;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    // The entry is not in either list while it is filled.
+    ble_notify_entry_t* pEntry = &m_notifyPool[idx];
+    uint16_t length = OS_MBUF_PKTLEN(om);
+    if(length > m_notifyMaxLength) {
+        length = m_notifyMaxLength;
+        m_notifyTruncated++;
+    }
+
+    os_mbuf_copydata(om, 0, length, m_notifyData + (idx * m_notifyMaxLength));
+    pEntry->connHandle = pChr->getRemoteService()->getClient()->getConnId();
+    pEntry->attrHandle = pChr->getHandle();
+    pEntry->length = length;
+    pEntry->isNotify = isNotify;
+    pEntry->next = NIMBLE_CPP_NOTIFY_NONE;
+
+    ble_npl_hw_enter_critical();
+    if(m_notifyTail != NIMBLE_CPP_NOTIFY_NONE) {
+        m_notifyPool[m_notifyTail].next = idx;
+    } else {
+        m_notifyHead = idx;
+    }
+    m_notifyTail = idx;
+    ble_npl_hw_exit_critical(0);
+
+    xTaskNotifyGive(m_notifyTask);
+    return true;
+} // queueNotify
+
+
+/**
+ * @brief The task that delivers the notifications in the notify queue.
+ */
+/* STATIC */
+void NimBLEDevice::notifyTask(void *param) {
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for(;;) {
+            ble_npl_hw_enter_critical();
+            uint16_t idx = m_notifyHead;
+            if(idx != NIMBLE_CPP_NOTIFY_NONE) {
+                m_notifyHead = m_notifyPool[idx].next;
+                if(m_notifyHead == NIMBLE_CPP_NOTIFY_NONE) {
+                    m_notifyTail = NIMBLE_CPP_NOTIFY_NONE;
+                }
+            }
+            ble_npl_hw_exit_critical(0);
+
+            if(idx == NIMBLE_CPP_NOTIFY_NONE) {
+                break;
+            }
+
+            // Look up the characteristic again, the client may have disconnected or been deleted since.
+            ble_notify_entry_t* pEntry = &m_notifyPool[idx];
+            NimBLEClient* pClient = getClientByID(pEntry->connHandle);
+            if(pClient != nullptr) {
+                NimBLERemoteCharacteristic* pChr = pClient->getCharacteristic(pEntry->attrHandle);
+                if(pChr != nullptr) {
+                    pChr->deliverNotify(m_notifyData + (idx * m_notifyMaxLength), pEntry->length,
+                                        pEntry->isNotify);
+                }
+            }
+
+            ble_npl_hw_enter_critical();
+            pEntry->next = m_notifyFree;
+            m_notifyFree = idx;
+            ble_npl_hw_exit_critical(0);
+        }
+    }
+} // notifyTask
+
+
 /**
  * @brief Get the list of created client objects.
  * @return A pointer to the list of clients.
@@ -299,16 +689,47 @@ size_t NimBLEDevice::getClientListSize() {
  */
 /* STATIC */
 NimBLEClient* NimBLEDevice::getClientByID(uint16_t conn_id) {
-    for(auto it = m_cList.cbegin(); it != m_cList.cend(); ++it) {
-        if((*it)->getConnId() == conn_id) {
-            return (*it);
-        }
+    uint8_t slot;
+    if(ble_gap_conn_slot(conn_id, &slot) != 0 || slot >= NIMBLE_MAX_CONNECTIONS) {
+        return nullptr;
+    }
+
+    NimBLEClient* pClient = m_clientSlots[slot];
+    if(pClient != nullptr && pClient->getConnId() == conn_id) {
+        return pClient;
     }
-    assert(0);
     return nullptr;
 } // getClientByID
 
 
+/**
+ * @brief Record the client owning a connection so it can be found from the connection handle.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] pClient A pointer to the client that made the connection.
+ */
+/* STATIC */
+void NimBLEDevice::setClientSlot(uint16_t conn_handle, NimBLEClient* pClient) {
+    uint8_t slot;
+    if(ble_gap_conn_slot(conn_handle, &slot) == 0 && slot < NIMBLE_MAX_CONNECTIONS) {
+        m_clientSlots[slot] = pClient;
+    }
+} // setClientSlot
+
+
+/**
+ * @brief Remove a client from the connection slots when it disconnects or is deleted.
+ * @param [in] pClient A pointer to the client.
+ */
+/* STATIC */
+void NimBLEDevice::clearClientSlot(NimBLEClient* pClient) {
+    for(auto &it : m_clientSlots) {
+        if(it == pClient) {
+            it = nullptr;
+        }
+    }
+} // clearClientSlot
+
+
 /**
  * @brief Get a reference to a client by peer address.
  * @param [in] peer_addr The address of the peer to search for.
@@ -341,6 +762,140 @@ NimBLEClient* NimBLEDevice::getDisconnectedClient() {
 
 #endif // #if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+/**
+ * @brief Route the events of a connection to a module until the connection is closed.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] sub The GAP_SUB_ flag of the module, set when it claims a state for the connection.
+ */
+/* STATIC */
+void NimBLEDevice::gapSubscribe(uint16_t conn_handle, uint8_t sub) {
+    ble_npl_hw_enter_critical();
+    ble_gap_subs_t* pFree = nullptr;
+    for(auto &it : m_gapSubs) {
+        if(it.connHandle == conn_handle) {
+            it.subs |= sub;
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+        if(pFree == nullptr && it.connHandle == BLE_HS_CONN_HANDLE_NONE) {
+            pFree = &it;
+        }
+    }
+
+    if(pFree != nullptr) {
+        pFree->connHandle = conn_handle;
+        pFree->subs = sub;
+    }
+    ble_npl_hw_exit_critical(0);
+} // gapSubscribe
+
+
+/**
+ * @brief Hand a connection event to the modules that handle its type and hold a state for its connection.
+ * @param [in] event The event from the server or client GAP event handler.
+ * @details The modules that are enabled for every connection, the statistics and radio activity,
+ * get all the events of the types they handle, the link profile and the policies only get those of
+ * the connections they were started on. Most events are not handled by any module and return at once.
+ */
+/* STATIC */
+void NimBLEDevice::dispatchGapEvent(struct ble_gap_event *event) {
+    // The modules handling each event type, indexed by the event type.
+    static const uint8_t typeSubs[] = {
+        /* CONNECT */             GAP_SUB_CONN_STATS | GAP_SUB_RADIO,
+        /* DISCONNECT */          GAP_SUB_LINK_PROFILE | GAP_SUB_PHY_POLICY | GAP_SUB_POWER_POLICY |
+                                  GAP_SUB_CONN_PARAMS | GAP_SUB_CONN_STATS | GAP_SUB_RADIO,
+        /* Reserved */            0,
+        /* CONN_UPDATE */         GAP_SUB_LINK_PROFILE | GAP_SUB_CONN_PARAMS | GAP_SUB_RADIO,
+        /* CONN_UPDATE_REQ */     0,
+        /* L2CAP_UPDATE_REQ */    0,
+        /* TERM_FAILURE */        0,
+        /* DISC */                0,
+        /* DISC_COMPLETE */       0,
+        /* ADV_COMPLETE */        0,
+        /* ENC_CHANGE */          0,
+        /* PASSKEY_ACTION */      0,
+        /* NOTIFY_RX */           GAP_SUB_CONN_STATS,
+        /* NOTIFY_TX */           GAP_SUB_CONN_STATS,
+        /* SUBSCRIBE */           0,
+        /* MTU */                 GAP_SUB_CONN_STATS,
+        /* IDENTITY_RESOLVED */   0,
+        /* REPEAT_PAIRING */      0,
+        /* PHY_UPDATE_COMPLETE */ GAP_SUB_LINK_PROFILE | GAP_SUB_PHY_POLICY,
+    };
+    // The modules getting the events of every connection, when they are built in.
+    const uint8_t always = (CONFIG_NIMBLE_CPP_CONN_STATS ? GAP_SUB_CONN_STATS : 0) |
+                           (CONFIG_NIMBLE_CPP_RADIO_ACTIVITY ? GAP_SUB_RADIO : 0);
+
+    if(event->type >= sizeof(typeSubs) || typeSubs[event->type] == 0) {
+        return;
+    }
+
+    uint16_t conn_handle;
+    switch(event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            conn_handle = event->connect.conn_handle;
+            break;
+        case BLE_GAP_EVENT_DISCONNECT:
+            conn_handle = event->disconnect.conn.conn_handle;
+            break;
+        case BLE_GAP_EVENT_CONN_UPDATE:
+            conn_handle = event->conn_update.conn_handle;
+            break;
+        case BLE_GAP_EVENT_NOTIFY_RX:
+            conn_handle = event->notify_rx.conn_handle;
+            break;
+        case BLE_GAP_EVENT_NOTIFY_TX:
+            conn_handle = event->notify_tx.conn_handle;
+            break;
+        case BLE_GAP_EVENT_MTU:
+            conn_handle = event->mtu.conn_handle;
+            break;
+        default:
+            conn_handle = event->phy_updated.conn_handle;
+            break;
+    }
+
+    uint8_t subs = always;
+    ble_npl_hw_enter_critical();
+    for(auto &it : m_gapSubs) {
+        if(it.connHandle == conn_handle) {
+            if(event->type == BLE_GAP_EVENT_CONNECT || event->type == BLE_GAP_EVENT_DISCONNECT) {
+                // A new connection starts with no module, a closed one releases its entry.
+                it.connHandle = BLE_HS_CONN_HANDLE_NONE;
+                it.subs = 0;
+            }
+            subs |= it.subs;
+            break;
+        }
+    }
+    ble_npl_hw_exit_critical(0);
+
+    subs &= typeSubs[event->type];
+    if(subs & GAP_SUB_LINK_PROFILE) {
+        NimBLELinkProfile::handleGapEvent(event);
+    }
+    if(subs & GAP_SUB_PHY_POLICY) {
+        NimBLEPhyPolicy::handleGapEvent(event);
+    }
+    if(subs & GAP_SUB_POWER_POLICY) {
+        NimBLEPowerPolicy::handleGapEvent(event);
+    }
+    if(subs & GAP_SUB_CONN_PARAMS) {
+        NimBLEConnParamsPolicy::handleGapEvent(event);
+    }
+    if(subs & GAP_SUB_CONN_STATS) {
+        NIMBLE_CPP_CONN_STATS_GAP_EVENT(event);
+    }
+    if(subs & GAP_SUB_RADIO) {
+        NIMBLE_CPP_RADIO_GAP_EVENT(event);
+    }
+} // dispatchGapEvent
+
+#endif // #if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+
 #ifdef ESP_PLATFORM
 /**
  * @brief Set the transmission power.
@@ -424,13 +979,46 @@ int NimBLEDevice::getPower(esp_ble_power_type_t powerType) {
 #else
 
 void NimBLEDevice::setPower(int dbm) {
+#if defined(NIMBLE_NPL_POSIX)
+    // The controller is behind an HCI transport, its power is not set by the host.
+    NIMBLE_LOGW(LOG_TAG, "setPower: not supported by the POSIX port");
+    (void)dbm;
+#else
     ble_phy_txpwr_set(dbm);
+#endif
 }
 
 
 int NimBLEDevice::getPower() {
+#if defined(NIMBLE_NPL_POSIX)
+    return 0;
+#else
     return ble_phy_txpwr_get();
+#endif
 }
+
+
+/**
+ * @brief Get the private address resolution statistics of the controller.
+ * @return A NimBLEResolvStats, all zero if the controller privacy feature is disabled.
+ * @details On nRF52 the radio resolves the RPAs of the first 16 resolving list entries with a peer IRK
+ * while receiving, the entries past those, up to MYNEWT_VAL_BLE_LL_RESOLV_LIST_SIZE, are resolved in
+ * software when the report is processed. Packets from those devices are not matched against the white list.
+ */
+/* STATIC */
+NimBLEResolvStats NimBLEDevice::getResolvStats() {
+    NimBLEResolvStats stats = {};
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY) && !defined(NIMBLE_NPL_POSIX)
+    ble_ll_resolv_stats llStats;
+    ble_ll_resolv_get_stats(&llStats);
+    stats.hwResolved = llStats.hw_resolved;
+    stats.swResolved = llStats.sw_resolved;
+    stats.unresolved = llStats.unresolved;
+    stats.hwEntries  = llStats.hw_entries;
+    stats.swEntries  = llStats.sw_entries;
+#endif
+    return stats;
+} // getResolvStats
 #endif
 
 /**
@@ -492,11 +1080,12 @@ uint16_t NimBLEDevice::getMTU() {
 }
 
 
-#ifdef ESP_PLATFORM
 /**
  * @brief Set the duplicate filter cache size for filtering scanned devices.
  * @param [in] cacheSize The number of advertisements filtered before the cache is reset.\n
- * Range is 10-1000, a larger value will reduce how often the same devices are reported.
+ * Range is 10-1000 on ESP32, a larger value will reduce how often the same devices are reported.\n
+ * On other targets the range is 1 to MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS), the memory for the cache
+ * is allocated at build time and the least recently seen device is forgotten when it is full.
  * @details Must only be called before calling NimBLEDevice::init.
  */
 /*STATIC*/
@@ -504,10 +1093,18 @@ void NimBLEDevice::setScanDuplicateCacheSize(uint16_t cacheSize) {
     if(initialized) {
         NIMBLE_LOGE(LOG_TAG, "Cannot change scan cache size while initialized");
         return;
-    } else if(cacheSize > 1000 || cacheSize <10) {
+    }
+#ifdef ESP_PLATFORM
+    if(cacheSize > 1000 || cacheSize <10) {
         NIMBLE_LOGE(LOG_TAG, "Invalid scan cache size; min=10 max=1000");
         return;
     }
+#else
+    if(cacheSize > MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS) || cacheSize < 1) {
+        NIMBLE_LOGE(LOG_TAG, "Invalid scan cache size; min=1 max=%d", MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS));
+        return;
+    }
+#endif
 
     m_scanDuplicateSize = cacheSize;
 }
@@ -524,21 +1121,26 @@ void NimBLEDevice::setScanDuplicateCacheSize(uint16_t cacheSize) {
  * * CONFIG_BTDM_SCAN_DUPL_TYPE_DATA_DEVICE (2)\n
      Filter by address and data, advertisements from the same address will be reported only once,\n
      except if the data in the advertisement has changed, then it will be reported again.
- * @details Must only be called before calling NimBLEDevice::init.
+ * @details Must only be called before calling NimBLEDevice::init.\n
+ * Filtering by data only is not available on targets other than ESP32.
  */
 /*STATIC*/
 void NimBLEDevice::setScanFilterMode(uint8_t mode) {
     if(initialized) {
         NIMBLE_LOGE(LOG_TAG, "Cannot change scan duplicate type while initialized");
         return;
-    } else if(mode > 2) {
+    }
+#ifdef ESP_PLATFORM
+    if(mode > 2) {
+#else
+    if(mode != 0 && mode != 2) {
+#endif
         NIMBLE_LOGE(LOG_TAG, "Invalid scan duplicate type");
         return;
     }
 
     m_scanFilterMode = mode;
 }
-#endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 /**
@@ -564,6 +1166,9 @@ int NimBLEDevice::getNumBonds() {
 /*STATIC*/
 void NimBLEDevice::deleteAllBonds() {
     ble_store_clear();
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) && CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    NimBLEClient::deleteAttributeCache(nullptr);
+#endif
 }
 
 
@@ -583,62 +1188,363 @@ bool NimBLEDevice::deleteBond(const NimBLEAddress &address) {
         return false;
     }
 
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) && CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED
+    NimBLEClient::deleteAttributeCache(&address);
+#endif
     return true;
 }
 
 
 /**
- * @brief Checks if a peer device is bonded.
- * @param [in] address The address to check for bonding.
- * @returns true if bonded.
+ * @brief Save the bond and CCCD changes that are waiting to be written to NVS.
+ * @details Changes are only held back when CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS is set,
+ * call this before a planned reset or sleep so they are not lost.
+ * @returns true on success.
  */
 /*STATIC*/
-bool NimBLEDevice::isBonded(const NimBLEAddress &address) {
-    ble_addr_t peer_id_addrs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
-    int num_peers, rc;
-
-    rc = ble_store_util_bonded_peers(&peer_id_addrs[0], &num_peers, MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+bool NimBLEDevice::flushBonds() {
+    int rc = ble_store_config_flush();
     if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_store_config_flush: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
         return false;
     }
 
-    for (int i = 0; i < num_peers; i++) {
-        NimBLEAddress storedAddr(peer_id_addrs[i]);
-        if(storedAddr == address) {
-            return true;
-        }
-    }
-
-    return false;
+    return true;
 }
 
 
 /**
- * @brief Get the address of a bonded peer device by index.
- * @param [in] index The index to retrieve the peer address of.
- * @returns NimBLEAddress of the found bonded peer or nullptr if not found.
+ * @brief Run the server, characteristic, descriptor and client callbacks from a pool of tasks
+ * instead of the host task, so user code does not block the host and the host task stack
+ * can be sized for the stack only.
+ * @param [in] numTasks The number of callback tasks.
+ * @param [in] queueSize The number of callbacks that can be waiting in all of the tasks.
+ * @param [in] taskStackSize The stack size in bytes of each callback task.
+ * @param [in] taskPriority The priority of the callback tasks.
+ * @param [in] taskCore The core to run the callback tasks on, -1 for the core set with setTaskAffinity.
+ * Only used on ESP32.
+ * @return True if the callback tasks were started.
+ * @details The callbacks of a connection are always run by the same task, in the order of the events.
+ * Callbacks are queued for onConnect, onDisconnect, onMTUChange and onAuthenticationComplete of
+ * NimBLEServerCallbacks, onWrite, onSubscribe and onStatus of NimBLECharacteristicCallbacks,
+ * onWrite of NimBLEDescriptorCallbacks and onDisconnect and onAuthenticationComplete of NimBLEClientCallbacks.\n
+ * onPassKeyRequest and onConfirmPIN of the server and client callbacks are queued too, their result is given
+ * to the stack from the callback task so waiting for the user does not hold up the other pairings.\n
+ * Callbacks that return a value to the stack or must run before it continues, such as onRead and onNotify,
+ * are still called from the host task. Client notifications
+ * can be moved with setNotifyQueue and scan results with NimBLEScan::setReportQueue.\n
+ * A queued onWrite reads the current value of the attribute, which a later write may have replaced.
+ * If the queue is full the callback is called from the host task, see getCallbackQueueFullCount.
+ * Can only be set once.
  */
-/*STATIC*/
-NimBLEAddress NimBLEDevice::getBondedAddress(int index) {
-    ble_addr_t peer_id_addrs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
-    int num_peers, rc;
+/* STATIC */
+bool NimBLEDevice::setCallbackTasks(uint8_t numTasks, uint16_t queueSize, uint32_t taskStackSize,
+                                    uint8_t taskPriority, int taskCore)
+{
+    if(m_callbackTasks != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Callback tasks already started");
+        return false;
+    }
 
-    rc = ble_store_util_bonded_peers(&peer_id_addrs[0], &num_peers, MYNEWT_VAL(BLE_STORE_MAX_BONDS));
-    if (rc != 0) {
-        return nullptr;
+    if(numTasks == 0 || queueSize == 0 || queueSize >= NIMBLE_CPP_NOTIFY_NONE) {
+        return false;
     }
 
-    if (index > num_peers || index < 0) {
-        return nullptr;
+    m_callbackPool = new ble_callback_entry_t[queueSize];
+    for(uint16_t i = 0; i < queueSize; i++) {
+        m_callbackPool[i].next = (i + 1 < queueSize) ? i + 1 : NIMBLE_CPP_NOTIFY_NONE;
     }
+    m_callbackFree = 0;
 
-    return NimBLEAddress(peer_id_addrs[index]);
-}
-#endif
+    ble_callback_task_t* pTasks = new ble_callback_task_t[numTasks];
+    for(uint8_t i = 0; i < numTasks; i++) {
+        pTasks[i].head = NIMBLE_CPP_NOTIFY_NONE;
+        pTasks[i].tail = NIMBLE_CPP_NOTIFY_NONE;
+        pTasks[i].task = nullptr;
+    }
 
-/**
- * @brief Checks if a peer device is whitelisted.
- * @param [in] address The address to check for in the whitelist.
+    for(uint8_t i = 0; i < numTasks; i++) {
+#ifdef ESP_PLATFORM
+        BaseType_t rc = xTaskCreatePinnedToCore(NimBLEDevice::callbackTask, "nimble_cb", taskStackSize,
+                                                &pTasks[i], taskPriority, &pTasks[i].task,
+                                                getTaskCore(taskCore));
+#else
+        (void)taskCore;
+        BaseType_t rc = xTaskCreate(NimBLEDevice::callbackTask, "nimble_cb", taskStackSize / sizeof(StackType_t),
+                                    &pTasks[i], taskPriority, &pTasks[i].task);
+#endif
+        if(rc != pdPASS) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to create callback task");
+            for(uint8_t j = 0; j < i; j++) {
+                vTaskDelete(pTasks[j].task);
+            }
+            delete[] pTasks;
+            delete[] m_callbackPool;
+            m_callbackPool = nullptr;
+            return false;
+        }
+    }
+
+    // Publish the tasks last, callbacks are not queued until the pool is ready.
+    m_numCallbackTasks = numTasks;
+    m_callbackTasks = pTasks;
+    return true;
+} // setCallbackTasks
+
+
+/**
+ * @brief Get the number of callbacks called from the host task because the callback queue was full.
+ * @return The number of callbacks not queued since the callback tasks were started.
+ */
+/* STATIC */
+uint32_t NimBLEDevice::getCallbackQueueFullCount() {
+    return m_callbackQueueFull;
+} // getCallbackQueueFullCount
+
+
+/**
+ * @brief Queue a callback to the task of its connection, or run it now if there are no callback tasks.
+ * @param [in] type The type of callback, one of CB_xxx.
+ * @param [in] pObj The object the callback is for.
+ * @param [in] connHandle The connection the callback is for, selects the task.
+ * @param [in] desc The connection descriptor passed to the callback, copied, can be nullptr.
+ * @param [in] arg A value passed to the callback (MTU, subscription value or status).
+ * @param [in] code A second value passed to the callback (status code).
+ */
+/* STATIC */
+void NimBLEDevice::dispatchCallback(uint8_t type, void* pObj, uint16_t connHandle,
+                                    const ble_gap_conn_desc* desc, int arg, int code)
+{
+    ble_callback_entry_t entry;
+    ble_callback_entry_t* pEntry = &entry;
+    uint16_t idx = NIMBLE_CPP_NOTIFY_NONE;
+
+    if(m_callbackTasks != nullptr) {
+        ble_npl_hw_enter_critical();
+        idx = m_callbackFree;
+        if(idx != NIMBLE_CPP_NOTIFY_NONE) {
+            m_callbackFree = m_callbackPool[idx].next;
+            pEntry = &m_callbackPool[idx];
+        } else {
+            m_callbackQueueFull++;
+        }
+        ble_npl_hw_exit_critical(0);
+    }
+
+    pEntry->next = NIMBLE_CPP_NOTIFY_NONE;
+    pEntry->type = type;
+    pEntry->pObj = pObj;
+    pEntry->arg  = arg;
+    pEntry->code = code;
+    if(desc != nullptr) {
+        pEntry->desc = *desc;
+    } else {
+        memset(&pEntry->desc, 0, sizeof(pEntry->desc));
+        pEntry->desc.conn_handle = connHandle;
+    }
+
+    if(idx == NIMBLE_CPP_NOTIFY_NONE) {
+        runCallback(pEntry);
+        return;
+    }
+
+    ble_callback_task_t* pTask = &m_callbackTasks[connHandle % m_numCallbackTasks];
+    ble_npl_hw_enter_critical();
+    if(pTask->tail != NIMBLE_CPP_NOTIFY_NONE) {
+        m_callbackPool[pTask->tail].next = idx;
+    } else {
+        pTask->head = idx;
+    }
+    pTask->tail = idx;
+    ble_npl_hw_exit_critical(0);
+
+    xTaskNotifyGive(pTask->task);
+} // dispatchCallback
+
+
+/**
+ * @brief Call the application callback of a queued callback entry.
+ * @param [in] pEntry The callback entry.
+ */
+/* STATIC */
+void NimBLEDevice::runCallback(ble_callback_entry_t* pEntry) {
+    switch(pEntry->type) {
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+        case CB_SERVER_CONNECT: {
+            NimBLEServer* pServer = (NimBLEServer*)pEntry->pObj;
+            uint8_t callbacks = pServer->m_pServerCallbacks->m_callbacks;
+            if(callbacks & NimBLEServerCallbacks::CB_ON_CONNECT) {
+                pServer->m_pServerCallbacks->onConnect(pServer);
+            }
+            if(callbacks & NimBLEServerCallbacks::CB_ON_CONNECT_DESC) {
+                pServer->m_pServerCallbacks->onConnect(pServer, &pEntry->desc);
+            }
+            break;
+        }
+        case CB_SERVER_DISCONNECT: {
+            NimBLEServer* pServer = (NimBLEServer*)pEntry->pObj;
+            uint8_t callbacks = pServer->m_pServerCallbacks->m_callbacks;
+            if(callbacks & NimBLEServerCallbacks::CB_ON_DISCONNECT) {
+                pServer->m_pServerCallbacks->onDisconnect(pServer);
+            }
+            if(callbacks & NimBLEServerCallbacks::CB_ON_DISCONNECT_DESC) {
+                pServer->m_pServerCallbacks->onDisconnect(pServer, &pEntry->desc);
+            }
+            break;
+        }
+        case CB_SERVER_MTU_CHANGE:
+            ((NimBLEServer*)pEntry->pObj)->m_pServerCallbacks->onMTUChange(pEntry->arg, &pEntry->desc);
+            break;
+        case CB_SERVER_AUTH_COMPLETE:
+            ((NimBLEServer*)pEntry->pObj)->m_pServerCallbacks->onAuthenticationComplete(&pEntry->desc);
+            break;
+        case CB_CHR_WRITE: {
+            NimBLECharacteristic* pChr = (NimBLECharacteristic*)pEntry->pObj;
+            uint8_t callbacks = pChr->m_pCallbacks->m_callbacks;
+            if(callbacks & NimBLECharacteristicCallbacks::CB_ON_WRITE) {
+                pChr->m_pCallbacks->onWrite(pChr);
+            }
+            if(callbacks & NimBLECharacteristicCallbacks::CB_ON_WRITE_DESC) {
+                pChr->m_pCallbacks->onWrite(pChr, &pEntry->desc);
+            }
+            break;
+        }
+        case CB_CHR_SUBSCRIBE: {
+            NimBLECharacteristic* pChr = (NimBLECharacteristic*)pEntry->pObj;
+            pChr->m_pCallbacks->onSubscribe(pChr, &pEntry->desc, pEntry->arg);
+            break;
+        }
+        case CB_CHR_STATUS: {
+            NimBLECharacteristic* pChr = (NimBLECharacteristic*)pEntry->pObj;
+            pChr->m_pCallbacks->onStatus(pChr, (NimBLECharacteristicCallbacks::Status)pEntry->arg,
+                                         pEntry->code);
+            break;
+        }
+        case CB_DSC_WRITE: {
+            NimBLEDescriptor* pDsc = (NimBLEDescriptor*)pEntry->pObj;
+            pDsc->m_pCallbacks->onWrite(pDsc);
+            break;
+        }
+        case CB_SERVER_PASSKEY:
+            ((NimBLEServer*)pEntry->pObj)->injectPasskey(pEntry->desc.conn_handle, pEntry->arg,
+                                                         (uint32_t)pEntry->code);
+            break;
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+        case CB_CLIENT_DISCONNECT:
+        case CB_CLIENT_AUTH_COMPLETE:
+        case CB_CLIENT_PASSKEY: {
+            // The client may have been deleted since the callback was queued.
+            NimBLEClient* pClient = (NimBLEClient*)pEntry->pObj;
+            if(std::find(m_cList.begin(), m_cList.end(), pClient) == m_cList.end()) {
+                break;
+            }
+
+            if(pEntry->type == CB_CLIENT_DISCONNECT) {
+                pClient->m_pClientCallbacks->onDisconnect(pClient);
+            } else if(pEntry->type == CB_CLIENT_PASSKEY) {
+                pClient->injectPasskey(pEntry->desc.conn_handle, pEntry->arg, (uint32_t)pEntry->code);
+            } else {
+                pClient->m_pClientCallbacks->onAuthenticationComplete(&pEntry->desc);
+            }
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+} // runCallback
+
+
+/**
+ * @brief A callback task, runs the callbacks queued to it in order.
+ * @param [in] param A pointer to the ble_callback_task_t of the task.
+ */
+/* STATIC */
+void NimBLEDevice::callbackTask(void *param) {
+    ble_callback_task_t* pTask = (ble_callback_task_t*)param;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for(;;) {
+            ble_npl_hw_enter_critical();
+            uint16_t idx = pTask->head;
+            if(idx != NIMBLE_CPP_NOTIFY_NONE) {
+                pTask->head = m_callbackPool[idx].next;
+                if(pTask->head == NIMBLE_CPP_NOTIFY_NONE) {
+                    pTask->tail = NIMBLE_CPP_NOTIFY_NONE;
+                }
+            }
+            ble_npl_hw_exit_critical(0);
+
+            if(idx == NIMBLE_CPP_NOTIFY_NONE) {
+                break;
+            }
+
+            runCallback(&m_callbackPool[idx]);
+
+            ble_npl_hw_enter_critical();
+            m_callbackPool[idx].next = m_callbackFree;
+            m_callbackFree = idx;
+            ble_npl_hw_exit_critical(0);
+        }
+    }
+} // callbackTask
+
+
+/**
+ * @brief Checks if a peer device is bonded.
+ * @param [in] address The address to check for bonding.
+ * @returns true if bonded.
+ */
+/*STATIC*/
+bool NimBLEDevice::isBonded(const NimBLEAddress &address) {
+    ble_addr_t peer_id_addrs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+    int num_peers, rc;
+
+    rc = ble_store_util_bonded_peers(&peer_id_addrs[0], &num_peers, MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+    if (rc != 0) {
+        return false;
+    }
+
+    for (int i = 0; i < num_peers; i++) {
+        NimBLEAddress storedAddr(peer_id_addrs[i]);
+        if(storedAddr == address) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Get the address of a bonded peer device by index.
+ * @param [in] index The index to retrieve the peer address of.
+ * @returns NimBLEAddress of the found bonded peer or an empty address if not found.
+ */
+/*STATIC*/
+NimBLEAddress NimBLEDevice::getBondedAddress(int index) {
+    ble_addr_t peer_id_addrs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+    int num_peers, rc;
+
+    rc = ble_store_util_bonded_peers(&peer_id_addrs[0], &num_peers, MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+    if (rc != 0) {
+        return NimBLEAddress();
+    }
+
+    if (index > num_peers || index < 0) {
+        return NimBLEAddress();
+    }
+
+    return NimBLEAddress(peer_id_addrs[index]);
+}
+#endif
+
+/**
+ * @brief Checks if a peer device is whitelisted.
+ * @param [in] address The address to check for in the whitelist.
  * @returns true if the address is in the whitelist.
  */
 /*STATIC*/
@@ -653,10 +1559,38 @@ bool NimBLEDevice::onWhiteList(const NimBLEAddress & address) {
 }
 
 
+/**
+ * @brief Program the controller whitelist with a list of addresses.
+ * @param [in] addresses The complete list of addresses.
+ * @returns true if successful.
+ */
+/*STATIC*/
+bool NimBLEDevice::whiteListApply(const std::vector<NimBLEAddress> & addresses) {
+    std::vector<ble_addr_t> wlVec;
+    wlVec.reserve(addresses.size());
+
+    for (auto &it : addresses) {
+        ble_addr_t wlAddr;
+        memcpy(&wlAddr.val, it.getNative(), 6);
+        wlAddr.type = it.getType();
+        wlVec.push_back(wlAddr);
+    }
+
+    int rc = ble_gap_wl_set(wlVec.data(), wlVec.size());
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Failed setting whitelist rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // whiteListApply
+
+
 /**
  * @brief Add a peer address to the whitelist.
  * @param [in] address The address to add to the whitelist.
  * @returns true if successful.
+ * @note Between whiteListBegin() and whiteListCommit() only the local list is changed.
  */
 /*STATIC*/
 bool NimBLEDevice::whiteListAdd(const NimBLEAddress & address) {
@@ -665,19 +1599,13 @@ bool NimBLEDevice::whiteListAdd(const NimBLEAddress & address) {
     }
 
     m_whiteList.push_back(address);
-    std::vector<ble_addr_t> wlVec;
-    wlVec.reserve(m_whiteList.size());
-
-    for (auto &it : m_whiteList) {
-        ble_addr_t wlAddr;
-        memcpy(&wlAddr.val, it.getNative(), 6);
-        wlAddr.type = it.getType();
-        wlVec.push_back(wlAddr);
+    if (m_whiteListBatch) {
+        return true;
     }
 
-    int rc = ble_gap_wl_set(&wlVec[0], wlVec.size());
-    if (rc != 0) {
-        NIMBLE_LOGE(LOG_TAG, "Failed adding to whitelist rc=%d", rc);
+    if (!whiteListApply(m_whiteList)) {
+        NIMBLE_LOGE(LOG_TAG, "Failed adding to whitelist");
+        m_whiteList.pop_back();
         return false;
     }
 
@@ -696,22 +1624,20 @@ bool NimBLEDevice::whiteListRemove(const NimBLEAddress & address) {
         return true;
     }
 
-    std::vector<ble_addr_t> wlVec;
-    wlVec.reserve(m_whiteList.size());
+    if (!m_whiteListBatch) {
+        std::vector<NimBLEAddress> wlVec;
+        wlVec.reserve(m_whiteList.size());
 
-    for (auto &it : m_whiteList) {
-        if (it != address) {
-            ble_addr_t wlAddr;
-            memcpy(&wlAddr.val, it.getNative(), 6);
-            wlAddr.type = it.getType();
-            wlVec.push_back(wlAddr);
+        for (auto &it : m_whiteList) {
+            if (it != address) {
+                wlVec.push_back(it);
+            }
         }
-    }
 
-    int rc = ble_gap_wl_set(&wlVec[0], wlVec.size());
-    if (rc != 0) {
-        NIMBLE_LOGE(LOG_TAG, "Failed removing from whitelist rc=%d", rc);
-        return false;
+        if (!whiteListApply(wlVec)) {
+            NIMBLE_LOGE(LOG_TAG, "Failed removing from whitelist");
+            return false;
+        }
     }
 
     // Don't remove from the list unless NimBLE returned success
@@ -726,6 +1652,72 @@ bool NimBLEDevice::whiteListRemove(const NimBLEAddress & address) {
 }
 
 
+/**
+ * @brief Replace the whitelist with a list of addresses.
+ * @param [in] addresses The new whitelist, duplicate addresses are only added once.
+ * @returns true if successful, on failure the whitelist is unchanged.
+ * @details The controller is programmed once with the final list instead of once per address.
+ * Between whiteListBegin() and whiteListCommit() only the local list is replaced.
+ */
+/*STATIC*/
+bool NimBLEDevice::whiteListSet(const std::vector<NimBLEAddress> & addresses) {
+    std::vector<NimBLEAddress> wlVec;
+    wlVec.reserve(addresses.size());
+
+    for (auto &it : addresses) {
+        if (std::find(wlVec.begin(), wlVec.end(), it) == wlVec.end()) {
+            wlVec.push_back(it);
+        }
+    }
+
+    if (!m_whiteListBatch && !whiteListApply(wlVec)) {
+        return false;
+    }
+
+    m_whiteList = std::move(wlVec);
+    return true;
+} // whiteListSet
+
+
+/**
+ * @brief Start a batch of whitelist changes.
+ * @details whiteListAdd, whiteListRemove and whiteListSet only change the local list until
+ * whiteListCommit() is called, which programs the controller once with the result.
+ */
+/*STATIC*/
+void NimBLEDevice::whiteListBegin() {
+    if (!m_whiteListBatch) {
+        m_whiteListCommitted = m_whiteList;
+        m_whiteListBatch = true;
+    }
+} // whiteListBegin
+
+
+/**
+ * @brief Program the controller with the changes made since whiteListBegin().
+ * @returns true if successful, on failure the whitelist is restored to what it was before whiteListBegin().
+ */
+/*STATIC*/
+bool NimBLEDevice::whiteListCommit() {
+    if (!m_whiteListBatch) {
+        return true;
+    }
+
+    m_whiteListBatch = false;
+    bool ret = true;
+    if (m_whiteList != m_whiteListCommitted) {
+        ret = whiteListApply(m_whiteList);
+        if (!ret) {
+            m_whiteList = std::move(m_whiteListCommitted);
+        }
+    }
+
+    m_whiteListCommitted.clear();
+    m_whiteListCommitted.shrink_to_fit();
+    return ret;
+} // whiteListCommit
+
+
 /**
  * @brief Gets the count of addresses in the whitelist.
  * @returns The number of addresses in the whitelist.
@@ -739,18 +1731,140 @@ size_t NimBLEDevice::getWhiteListCount() {
 /**
  * @brief Gets the address at the vector index.
  * @param [in] index The vector index to retrieve the address from.
- * @returns the NimBLEAddress at the whitelist index or nullptr if not found.
+ * @returns the NimBLEAddress at the whitelist index or an empty address if not found.
  */
 /*STATIC*/
 NimBLEAddress NimBLEDevice::getWhiteListAddress(size_t index) {
     if (index > m_whiteList.size()) {
         NIMBLE_LOGE(LOG_TAG, "Invalid index; %u", index);
-        return nullptr;
+        return NimBLEAddress();
     }
     return m_whiteList[index];
 }
 
 
+/**
+ * @brief Get the usage statistics of the host memory pools.
+ * @return A vector with one entry for each registered pool, this includes the msys pools
+ * used for ATT and L2CAP data, the ACL data pool and the HCI event pools.
+ * @details Use this to find which pool is exhausted when a notification fails or a
+ * procedure returns BLE_HS_ENOMEM, the minFree value shows how close a pool has come to running out.
+ */
+/* STATIC */
+std::vector<NimBLEMemPoolStats> NimBLEDevice::getMemStats() {
+    std::vector<NimBLEMemPoolStats> stats;
+    struct os_mempool_info omi;
+    struct os_mempool *mp = nullptr;
+
+    while((mp = os_mempool_info_get_next(mp, &omi)) != nullptr) {
+        NimBLEMemPoolStats pool;
+        pool.name      = omi.omi_name;
+        pool.blockSize = omi.omi_block_size;
+        pool.numBlocks = omi.omi_num_blocks;
+        pool.numFree   = omi.omi_num_free;
+        pool.minFree   = omi.omi_min_free;
+#ifndef CONFIG_NIMBLE_CPP_IDF
+        pool.numFail   = omi.omi_num_fail;
+        pool.maxChain  = omi.omi_max_chain;
+#else
+        pool.numFail   = 0;
+        pool.maxChain  = 0;
+#endif
+        stats.push_back(pool);
+    }
+
+    return stats;
+} // getMemStats
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+/**
+ * @brief Get the number of heap bytes used by the buffer of an attribute value.
+ */
+static size_t attValueHeapSize(const NimBLEAttValue &value) {
+    if(value.capacity() <= CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH) {
+        return 0;
+    }
+    return sizeof(uint32_t) + value.capacity() + 1;
+} // attValueHeapSize
+#endif
+
+
+/**
+ * @brief Get the RAM used by the host pools, the GATT database, the library objects, the scan results and the bond store.
+ * @return A NimBLEMemoryReport with the bytes used by each of them.
+ * @details Use it with getMemStats() to size the pools and the CONFIG_NIMBLE_CPP_* options for an application.
+ * Should not be called while services are being discovered or scan results are added.
+ */
+/* STATIC */
+NimBLEMemoryReport NimBLEDevice::getMemoryReport() {
+    NimBLEMemoryReport report = {};
+
+    for(auto &it : getMemStats()) {
+        size_t bytes = (size_t)it.blockSize * it.numBlocks;
+        if(it.name.compare(0, 4, "msys") == 0) {
+            report.msysPools += bytes;
+        } else if(it.name.find("acl") != std::string::npos) {
+            report.aclPools += bytes;
+        } else if(it.name == "ble_att_svr_entry_pool") {
+            report.attServer += bytes;
+        } else {
+            report.otherPools += bytes;
+        }
+    }
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    if(m_pServer != nullptr) {
+        report.server += sizeof(NimBLEServer);
+        for(auto &svc : m_pServer->m_svcVec) {
+            report.server += sizeof(NimBLEService) + sizeof(NimBLEService*);
+            for(auto &chr : svc->m_chrVec) {
+                report.server += sizeof(NimBLECharacteristic) + sizeof(NimBLECharacteristic*) +
+                                 attValueHeapSize(chr->m_value);
+                for(auto &dsc : chr->m_dscVec) {
+                    report.server += sizeof(NimBLEDescriptor) + sizeof(NimBLEDescriptor*) +
+                                     attValueHeapSize(dsc->m_value);
+                }
+            }
+        }
+    }
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    for(auto &client : m_cList) {
+        report.remote += sizeof(NimBLEClient);
+        for(auto &svc : client->m_servicesVector) {
+            report.remote += sizeof(NimBLERemoteService) + sizeof(NimBLERemoteService*);
+            for(auto &chr : *svc->getCharacteristics(false)) {
+                report.remote += sizeof(NimBLERemoteCharacteristic) + sizeof(NimBLERemoteCharacteristic*) +
+                                 attValueHeapSize(chr->m_value);
+                // Remote descriptor values are not stored.
+                report.remote += chr->getDescriptors(false)->size() *
+                                 (sizeof(NimBLERemoteDescriptor) + sizeof(NimBLERemoteDescriptor*));
+            }
+        }
+    }
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    size_t numDevices = 0;
+    if(m_pScan != nullptr) {
+        numDevices = m_pScan->m_scanResults.getCount();
+    }
+    // Devices in the pool do not use more memory, the pool is allocated at build time.
+    numDevices = std::max(numDevices, (size_t)CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE);
+    report.scanResults = numDevices * (sizeof(NimBLEAdvertisedDevice) + sizeof(NimBLEAdvertisedDevice*));
+#endif
+
+    report.bonds = MYNEWT_VAL(BLE_STORE_MAX_BONDS) * 2 * sizeof(struct ble_store_value_sec) +
+                   MYNEWT_VAL(BLE_STORE_MAX_CCCDS) * sizeof(struct ble_store_value_cccd);
+
+    report.total = report.msysPools + report.aclPools + report.attServer + report.otherPools +
+                   report.server + report.remote + report.scanResults + report.bonds;
+    return report;
+} // getMemoryReport
+
+
 /**
  * @brief Host reset, we pass the message so we don't make calls until resynced.
  * @param [in] reason The reason code for the reset.
@@ -763,9 +1877,12 @@ void NimBLEDevice::onReset(int reason)
     }
 
     m_synced = false;
+    m_resetTime = ble_npl_time_get();
+    m_recoveryStats.resets++;
 
     NIMBLE_LOGC(LOG_TAG, "Resetting state; reason=%d, %s", reason,
                         NimBLEUtils::returnCodeToString(reason));
+    NIMBLE_CPP_RADIO_RESET();
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
     if(initialized) {
@@ -820,10 +1937,343 @@ void NimBLEDevice::onSync(void)
             m_bleAdvertising->onHostSync();
         }
 #endif
+
+        if(m_resetTime != 0) {
+            restoreAfterReset();
+        }
     }
 } // onSync
 
 
+/**
+ * @brief Restore the white list and reconnect the clients after the host has reset and synced again.
+ * @details The controller clears its white list when it is reset, the committed list is programmed again.
+ * The clients that were connected are queued to the connection task with their attributes kept, the
+ * controller creates one connection at a time so they are reconnected one after another.
+ */
+/* STATIC */
+void NimBLEDevice::restoreAfterReset() {
+    m_recoveryStats.syncMs = ble_npl_time_ticks_to_ms32(ble_npl_time_get() - m_resetTime);
+    m_recoveryStats.restoreMs = 0;
+    m_recoveryStats.reconnected = 0;
+    m_recoveryStats.failed = 0;
+    // Held until all clients are queued so a connection failing meanwhile does not end the recovery.
+    m_recoveryPending = 1;
+
+    if(!m_whiteListCommitted.empty()) {
+        whiteListApply(m_whiteListCommitted);
+    }
+
+    int numClients = 0;
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    for(auto &it : m_cList) {
+        if(!it->m_reconnectOnSync) {
+            continue;
+        }
+
+        it->m_reconnectOnSync = false;
+        numClients++;
+        ble_npl_hw_enter_critical();
+        m_recoveryPending++;
+        ble_npl_hw_exit_critical(0);
+
+        if(!queueConnect({it, [](NimBLEClient* pClient, int rc) { recoveryConnected(rc); }, true, true})) {
+            recoveryConnected(BLE_HS_ENOMEM);
+        }
+    }
+#endif
+
+    NIMBLE_LOGI(LOG_TAG, "Host synced %" PRIu32 " ms after reset, %d clients to reconnect",
+                m_recoveryStats.syncMs, numClients);
+
+    recoveryConnected(0, false);
+} // restoreAfterReset
+
+
+/**
+ * @brief Count a reset recovery connection that was completed or failed.
+ * @param [in] rc 0 if the client was reconnected, otherwise the error code.
+ * @param [in] count If false, only the hold taken while queueing the clients is released.
+ */
+/* STATIC */
+void NimBLEDevice::recoveryConnected(int rc, bool count) {
+    bool done = false;
+
+    ble_npl_hw_enter_critical();
+    if(count) {
+        if(rc == 0) {
+            m_recoveryStats.reconnected++;
+        } else {
+            m_recoveryStats.failed++;
+        }
+    }
+    if(m_recoveryPending > 0 && --m_recoveryPending == 0) {
+        m_recoveryStats.restoreMs = ble_npl_time_ticks_to_ms32(ble_npl_time_get() - m_resetTime);
+        m_resetTime = 0;
+        done = true;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(done && m_recoveryStats.reconnected + m_recoveryStats.failed > 0) {
+        NIMBLE_LOGI(LOG_TAG, "Restored %" PRIu32 " ms after reset, reconnected: %d, failed: %d",
+                    m_recoveryStats.restoreMs, m_recoveryStats.reconnected, m_recoveryStats.failed);
+    }
+} // recoveryConnected
+
+
+/**
+ * @brief Reconnect the clients that were connected when the host resets, once it has synced again.
+ * @param [in] enable True to reconnect the clients, false (default) to leave them disconnected.
+ * @details Advertising and scanning are restarted and the white list is programmed again after a reset
+ * whether this is enabled or not. Reconnected clients keep the services discovered before the reset and
+ * encrypt with the stored bond if they were set to, see NimBLEClient::setConnectionParams for the parameters used.
+ */
+/* STATIC */
+void NimBLEDevice::setResetRecovery(bool enable) {
+    m_resetRecovery = enable;
+} // setResetRecovery
+
+
+/**
+ * @brief Get the times taken to recover from the last host reset.
+ * @return A NimBLEResetRecoveryStats with the times and the number of clients reconnected.
+ */
+/* STATIC */
+NimBLEResetRecoveryStats NimBLEDevice::getResetRecoveryStats() {
+    return m_recoveryStats;
+} // getResetRecoveryStats
+
+
+/**
+ * @brief Get the state of the adaptive controller to host flow control.
+ * @param [out] stats The statistics, unchanged on failure.
+ * @return True if CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE is enabled.
+ * @details The controller may send as many ACL packets as the host has buffers for, with the adaptive flow
+ * control the credits of freed buffers are held back while the msys pools run low or received data waits
+ * too long to be processed, so the peers are throttled by the link layer instead of the packets being dropped.
+ * Not available when using the NimBLE stack of esp-idf.
+ */
+/* STATIC */
+bool NimBLEDevice::getFlowCtrlStats(NimBLEFlowCtrlStats* stats) {
+#ifndef CONFIG_NIMBLE_CPP_IDF
+    struct ble_hs_flow_stats hsStats;
+    if (ble_hs_flow_get_stats(&hsStats) != 0) {
+        return false;
+    }
+
+    stats->window      = hsStats.window;
+    stats->windowMin   = hsStats.window_min;
+    stats->withheld    = hsStats.withheld;
+    stats->latencyMs   = hsStats.latency_ms;
+    stats->shrinks     = hsStats.shrinks;
+    stats->grows       = hsStats.grows;
+    stats->throttledMs = hsStats.throttled_ms;
+    return true;
+#else
+    return false;
+#endif
+} // getFlowCtrlStats
+
+
+/**
+ * @brief Share the radio time between scanning, advertising and connecting by priority.
+ * @param [in] scan The priority of scanning, 0 to use the scan window as set.
+ * @param [in] advertising The priority of advertising, 0 to use the advertising interval as set.
+ * @param [in] connect The priority of connecting, 0 to use the connection scan window as set.
+ * @details The time left by the connection events of the current connections is split between
+ * the roles that are running in proportion to their priorities, each time one of them starts:
+ * the scan window and the initiator scan window are shortened to their share of the interval and
+ * the legacy advertising interval is lengthened so the advertising events stay within their share,
+ * extended advertising instances keep the intervals they were configured with.
+ * A scan running when a client connects is paused and resumed when the attempt ends, instead of
+ * stopped. Set all priorities to 0 to disable the scheduler, the default.
+ */
+/* STATIC */
+void NimBLEDevice::setCoexPriorities(uint8_t scan, uint8_t advertising, uint8_t connect) {
+    m_coexPriority[0] = scan;
+    m_coexPriority[1] = advertising;
+    m_coexPriority[2] = connect;
+} // setCoexPriorities
+
+
+/**
+ * @brief Get the radio time the coexistence scheduler gives to each role now.
+ * @return A NimBLECoexDuty, the duty of a role that is not running is the one it would get if started.
+ */
+/* STATIC */
+NimBLECoexDuty NimBLEDevice::getCoexDuty() {
+    bool scanning = false;
+    bool connecting = false;
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    scanning = m_pScan != nullptr && m_pScan->isScanning();
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    connecting = ble_gap_conn_active();
+#endif
+    return coexDuty(scanning, coexAdvertising(), connecting);
+} // getCoexDuty
+
+
+#if CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+/**
+ * @brief Get the time spent and the estimated radio use of scanning, advertising and the connections.
+ * @return The activity since the device was initialized or since resetRadioActivity() was called.
+ */
+/* STATIC */
+NimBLERadioActivity NimBLEDevice::getRadioActivity() {
+    return NimBLERadioActivity::get();
+} // getRadioActivity
+
+
+/**
+ * @brief Set the radio activity values back to 0, to measure from now.
+ */
+/* STATIC */
+void NimBLEDevice::resetRadioActivity() {
+    NimBLERadioActivity::reset();
+} // resetRadioActivity
+#endif
+
+
+/**
+ * @brief Check if the coexistence scheduler is enabled.
+ */
+/* STATIC */
+bool NimBLEDevice::coexEnabled() {
+    return m_coexPriority[0] || m_coexPriority[1] || m_coexPriority[2];
+} // coexEnabled
+
+
+/**
+ * @brief Check if advertising, with any instance.
+ */
+/* STATIC */
+bool NimBLEDevice::coexAdvertising() {
+#if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+    return m_bleAdvertising != nullptr && m_bleAdvertising->isAdvertising();
+#else
+    return false;
+#endif
+} // coexAdvertising
+
+
+/**
+ * @brief Compute the radio time of each role from the connection load and the roles running.
+ * @param [in] scanning True if scanning, not counted while connecting as the scan is paused.
+ * @param [in] advertising True if advertising.
+ * @param [in] connecting True if a connection is being initiated.
+ * @return The duty of each role, 100 for the roles that are not scheduled.
+ */
+/* STATIC */
+NimBLECoexDuty NimBLEDevice::coexDuty(bool scanning, bool advertising, bool connecting) {
+    // The time reserved for each connection event, enough for a full size exchange in each direction.
+    const uint32_t connEventUs = 2500;
+    uint32_t load = 0; // In 1/1000 of the radio time.
+    ble_gap_conn_desc desc;
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    for(auto &it : m_cList) {
+        if(it->isConnected() && ble_gap_conn_find(it->getConnId(), &desc) == 0 && desc.conn_itvl > 0) {
+            load += connEventUs * 1000 / (desc.conn_itvl * 1250);
+        }
+    }
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    if(m_pServer != nullptr) {
+        for(auto &it : m_pServer->getPeerDevices()) {
+            if(ble_gap_conn_find(it, &desc) == 0 && desc.conn_itvl > 0) {
+                load += connEventUs * 1000 / (desc.conn_itvl * 1250);
+            }
+        }
+    }
+#endif
+
+    NimBLECoexDuty duty;
+    // Always leave some time to the other roles, the controller schedules the connection events first.
+    duty.connections = std::min<uint32_t>(load / 10, 90);
+    const uint32_t free = 100 - duty.connections;
+    const bool active[3] = {scanning && !connecting, advertising, connecting};
+    uint8_t* roles[3] = {&duty.scan, &duty.advertising, &duty.connect};
+
+    for(int i = 0; i < 3; i++) {
+        if(m_coexPriority[i] == 0) {
+            *roles[i] = 100;
+            continue;
+        }
+
+        // The share of the role among the others running, as if it was running too.
+        uint32_t total = m_coexPriority[i];
+        for(int j = 0; j < 3; j++) {
+            if(j != i && active[j]) {
+                total += m_coexPriority[j];
+            }
+        }
+        *roles[i] = std::max<uint32_t>(free * m_coexPriority[i] / total, 1);
+    }
+
+    return duty;
+} // coexDuty
+
+
+/**
+ * @brief Shorten a scan window to a duty of its interval.
+ * @param [in,out] itvl The scan interval in 0.625ms units, 0 for the host default.
+ * @param [in,out] window The scan window in 0.625ms units, 0 for the host default.
+ * @param [in] duty The largest percentage of the interval to scan.
+ */
+/* STATIC */
+void NimBLEDevice::coexScanWindow(uint16_t &itvl, uint16_t &window, uint8_t duty) {
+    if(itvl == 0) {
+        itvl = BLE_GAP_SCAN_FAST_INTERVAL_MIN;
+    }
+    if(window == 0) {
+        window = BLE_GAP_SCAN_FAST_WINDOW;
+    }
+
+    // The shortest window the controllers accept is 2.5ms.
+    uint16_t limit = std::max<uint32_t>((uint32_t)itvl * duty / 100, 4);
+    window = std::min(window, std::min(limit, itvl));
+} // coexScanWindow
+
+
+/**
+ * @brief Lengthen a legacy advertising interval so the advertising events stay within their duty.
+ * @param [in,out] itvlMin The minimum advertising interval in 0.625ms units, 0 for the host default.
+ * @param [in,out] itvlMax The maximum advertising interval in 0.625ms units, 0 for the host default.
+ * @param [in] scanResp True if the advertising events also listen for scan requests.
+ */
+/* STATIC */
+void NimBLEDevice::coexAdvInterval(uint16_t &itvlMin, uint16_t &itvlMax, bool scanResp) {
+    bool scanning = false;
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    scanning = m_pScan != nullptr && m_pScan->isScanning();
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    uint8_t duty = coexDuty(scanning, true, ble_gap_conn_active()).advertising;
+#else
+    uint8_t duty = coexDuty(scanning, true, false).advertising;
+#endif
+
+    if(itvlMin == 0) {
+        itvlMin = BLE_GAP_ADV_FAST_INTERVAL1_MIN;
+    }
+    if(itvlMax == 0) {
+        itvlMax = BLE_GAP_ADV_FAST_INTERVAL1_MAX;
+    }
+
+    // An event is sent on the 3 primary channels, with a scan request and response on each if enabled.
+    const uint32_t eventUs = scanResp ? 3000 : 1200;
+    uint32_t shortest = (eventUs * 100 / duty + 624) / 625;
+    shortest = std::min<uint32_t>(shortest, 0x4000);
+    if(itvlMin < shortest) {
+        itvlMin = shortest;
+    }
+    if(itvlMax < itvlMin) {
+        itvlMax = itvlMin;
+    }
+} // coexAdvInterval
+
+
 /**
  * @brief The main host task.
  */
@@ -832,9 +2282,17 @@ void NimBLEDevice::host_task(void *param)
 {
     NIMBLE_LOGI(LOG_TAG, "BLE Host Task Started");
 
+#if CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+    NimBLEStackProfile::m_hostTask = xTaskGetCurrentTaskHandle();
+#endif
+
     /* This function will return only when nimble_port_stop() is executed */
     nimble_port_run();
 
+#if CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+    NimBLEStackProfile::m_hostTask = nullptr;
+#endif
+
     nimble_port_freertos_deinit();
 } // host_task
 
@@ -872,6 +2330,9 @@ void NimBLEDevice::init(const std::string &deviceName) {
 #else
         bt_cfg.mode = ESP_BT_MODE_BLE;
         bt_cfg.ble_max_conn = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+        if(m_controllerCore >= 0) {
+            bt_cfg.controller_task_run_cpu = m_controllerCore;
+        }
 #endif
         bt_cfg.normal_adv_size = m_scanDuplicateSize;
         bt_cfg.scan_duplicate_type = m_scanFilterMode;
@@ -882,6 +2343,13 @@ void NimBLEDevice::init(const std::string &deviceName) {
 #endif
         nimble_port_init();
 
+#if !defined(ESP_PLATFORM) && !defined(NIMBLE_NPL_POSIX)
+        rc = ble_ll_scan_dup_cfg_set(m_scanDuplicateSize, m_scanFilterMode == 2);
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "ble_ll_scan_dup_cfg_set: rc=%d", rc);
+        }
+#endif
+
         // Setup callbacks for host events
         ble_hs_cfg.reset_cb = NimBLEDevice::onReset;
         ble_hs_cfg.sync_cb = NimBLEDevice::onSync;
@@ -902,6 +2370,11 @@ void NimBLEDevice::init(const std::string &deviceName) {
 
         ble_store_config_init();
 
+#if defined(ESP_PLATFORM) && !defined(CONFIG_NIMBLE_CPP_IDF)
+        if(m_hostCore >= 0) {
+            nimble_port_freertos_set_host_core(m_hostCore);
+        }
+#endif
         nimble_port_freertos_init(NimBLEDevice::host_task);
     }
 
@@ -921,6 +2394,17 @@ void NimBLEDevice::init(const std::string &deviceName) {
  */
 /* STATIC */
 void NimBLEDevice::deinit(bool clearAll) {
+    // The host must be running for nimble_port_stop to complete.
+    if(suspended) {
+        resume();
+    }
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    if (initialized) {
+        flushBonds();
+    }
+#endif
+
     int ret = nimble_port_stop();
     if (ret == 0) {
         nimble_port_deinit();
@@ -933,12 +2417,26 @@ void NimBLEDevice::deinit(bool clearAll) {
         initialized = false;
         m_synced = false;
 
+#if defined(CONFIG_BT_NIMBLE_MESH)
+        NimBLEMesh::deinit(clearAll);
+#endif
+
         if(clearAll) {
 #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
             if(NimBLEDevice::m_pServer != nullptr) {
                 delete NimBLEDevice::m_pServer;
                 NimBLEDevice::m_pServer = nullptr;
             }
+#  if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+            NimBLEArena::server().release();
+#  endif
+#endif
+
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+            if(NimBLEDevice::m_pL2CAPServer != nullptr) {
+                delete NimBLEDevice::m_pL2CAPServer;
+                NimBLEDevice::m_pL2CAPServer = nullptr;
+            }
 #endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
@@ -956,9 +2454,40 @@ void NimBLEDevice::deinit(bool clearAll) {
 #endif
 
 #if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
-            for(auto &it : m_cList) {
-                deleteClient(it);
-                m_cList.clear();
+            if(m_connectTask != nullptr) {
+                vTaskDelete(m_connectTask);
+                m_connectTask = nullptr;
+            }
+            m_connectQueue.clear();
+
+            if(m_notifyTask != nullptr) {
+                vTaskDelete(m_notifyTask);
+                m_notifyTask = nullptr;
+                delete[] m_notifyPool;
+                m_notifyPool = nullptr;
+                delete[] m_notifyData;
+                m_notifyData = nullptr;
+            }
+
+            // deleteClient removes the client from the list.
+            while(!m_cList.empty()) {
+                deleteClient(m_cList.front());
+            }
+#  if CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE > 0
+            NimBLEArena::client().release();
+#  endif
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+            if(m_callbackTasks != nullptr) {
+                for(uint8_t i = 0; i < m_numCallbackTasks; i++) {
+                    vTaskDelete(m_callbackTasks[i].task);
+                }
+                delete[] m_callbackTasks;
+                m_callbackTasks = nullptr;
+                delete[] m_callbackPool;
+                m_callbackPool = nullptr;
+                m_numCallbackTasks = 0;
             }
 #endif
 
@@ -971,6 +2500,130 @@ void NimBLEDevice::deinit(bool clearAll) {
     }
 } // deinit
 
+
+/**
+ * @brief Stop the host and power down the controller while keeping the state of the stack.
+ * @return True if the stack was suspended.
+ * @details Advertising and scanning are stopped and all connections are terminated, their
+ * disconnect callbacks are called before this returns. The GATT database, the bonds loaded from the store
+ * and all of the library objects are kept, so resume() only has to enable the controller and sync the host
+ * instead of running init() again.
+
+ * On ESP32 the controller is disabled but stays initialized, on other targets the controller is left idle.
+ */
+/* STATIC */
+bool NimBLEDevice::suspend() {
+    if(!initialized || suspended) {
+        return false;
+    }
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+    if(m_bleAdvertising != nullptr) {
+        stopAdvertising();
+    }
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    if(m_pScan != nullptr) {
+        m_pScan->stop();
+    }
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    flushBonds();
+#endif
+
+    int rc = ble_hs_stop(&suspendListener, NimBLEDevice::onHostStopped, xTaskGetCurrentTaskHandle());
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_hs_stop: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    m_synced = false;
+
+#ifdef ESP_PLATFORM
+    esp_err_t err = esp_bt_controller_disable();
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "esp_bt_controller_disable() failed with error: %d", err);
+    }
+#endif
+
+    suspended = true;
+    NIMBLE_LOGI(LOG_TAG, "BLE suspended");
+    return true;
+} // suspend
+
+
+/**
+ * @brief Power up the controller and restart the host after suspend().
+ * @return True if the host is synced with the controller.
+ * @details Advertising and scanning are not restarted, start them again when needed.
+ */
+/* STATIC */
+bool NimBLEDevice::resume() {
+    if(!suspended) {
+        return false;
+    }
+
+#ifdef ESP_PLATFORM
+    esp_err_t err = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "esp_bt_controller_enable() failed with error: %d", err);
+        return false;
+    }
+#endif
+
+    suspended = false;
+
+    // ble_hs_start must run on the host task.
+    ble_npl_event_init(&resumeEvent, NimBLEDevice::onResumeEvent, NULL);
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &resumeEvent);
+
+    while(!m_synced){
+        taskYIELD();
+    }
+
+    NIMBLE_LOGI(LOG_TAG, "BLE resumed");
+    return true;
+} // resume
+
+
+/**
+ * @brief Check if the stack is suspended.
+ * @return True if suspend() was called and resume() has not been called since.
+ */
+/* STATIC */
+bool NimBLEDevice::isSuspended() {
+    return suspended;
+} // isSuspended
+
+
+/**
+ * @brief Called when the host has stopped for suspend().
+ * @param [in] status 0 or the error code if the connections could not be terminated in time.
+ * @param [in] arg The handle of the task waiting in suspend().
+ */
+/* STATIC */
+void NimBLEDevice::onHostStopped(int status, void *arg) {
+    if(status != 0) {
+        NIMBLE_LOGW(LOG_TAG, "Host stopped; status=%d", status);
+    }
+    xTaskNotifyGive((TaskHandle_t)arg);
+} // onHostStopped
+
+
+/**
+ * @brief Restart the host on the host task for resume().
+ */
+/* STATIC */
+void NimBLEDevice::onResumeEvent(struct ble_npl_event *ev) {
+    (void)ev;
+    int rc = ble_hs_start();
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_hs_start: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+    }
+} // onResumeEvent
+
 /**
  * @brief Set the BLEDevice's name
  * @param [in] deviceName The device name of the device.
@@ -1134,6 +2787,67 @@ void NimBLEDevice::setOwnAddrType(uint8_t own_addr_type, bool useNRPA) {
             break;
     }
 } // setOwnAddrType
+
+
+/**
+ * @brief Set the cores the host, controller and library tasks run on.
+ * @param [in] hostCore The core of the host task, -1 to use CONFIG_BT_NIMBLE_PINNED_TO_CORE.
+ * Setting this is not supported when the library uses the NimBLE component of esp-idf.
+ * @param [in] controllerCore The core of the controller task, -1 to use the sdkconfig setting. ESP32 only.
+ * @param [in] appCore The core of the connect, notify, scan report and callback tasks when they
+ * are created with taskCore = -1, -1 for no affinity.
+ * @return True if the cores are valid and were set.
+ * @details The host and controller cores must be set before calling NimBLEDevice::init.
+ * Timer callouts are dispatched by the esp_timer task and handled on the host task, so they follow the host core.
+ * Putting the host and controller on one core and the library tasks and the application on the other
+ * keeps application work from delaying connection events, see NimBLE_Affinity_Benchmark to measure a split.
+ */
+/*STATIC*/
+bool NimBLEDevice::setTaskAffinity(int hostCore, int controllerCore, int appCore) {
+    if(hostCore >= portNUM_PROCESSORS || controllerCore >= portNUM_PROCESSORS ||
+       appCore >= portNUM_PROCESSORS)
+    {
+        NIMBLE_LOGE(LOG_TAG, "Invalid core; max=%d", portNUM_PROCESSORS - 1);
+        return false;
+    }
+
+    if(initialized && (hostCore != m_hostCore || controllerCore != m_controllerCore)) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change host or controller core while initialized");
+        return false;
+    }
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+    if(hostCore >= 0) {
+        NIMBLE_LOGE(LOG_TAG, "Host core is set by CONFIG_BT_NIMBLE_PINNED_TO_CORE with esp-idf");
+        return false;
+    }
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32C3) || defined(CONFIG_IDF_TARGET_ESP32S3)
+    if(controllerCore >= 0) {
+        NIMBLE_LOGE(LOG_TAG, "Controller core is set by sdkconfig on this target");
+        return false;
+    }
+#endif
+
+    m_hostCore = hostCore < 0 ? -1 : hostCore;
+    m_controllerCore = controllerCore < 0 ? -1 : controllerCore;
+    m_appCore = appCore < 0 ? -1 : appCore;
+    return true;
+} // setTaskAffinity
+
+
+/**
+ * @brief Get the core to create a library task on.
+ * @param [in] taskCore The core requested for the task, -1 to use the core set with setTaskAffinity.
+ */
+/*STATIC*/
+BaseType_t NimBLEDevice::getTaskCore(int taskCore) {
+    if(taskCore < 0) {
+        taskCore = m_appCore;
+    }
+    return taskCore < 0 ? tskNO_AFFINITY : taskCore;
+} // getTaskCore
 #endif
 
 /**
@@ -1156,16 +2870,11 @@ int NimBLEDevice::startSecurity(uint16_t conn_id) {
  * @brief Check if the device address is on our ignore list.
  * @param [in] address The address to look for.
  * @return True if ignoring.
+ * @details The ignore list is kept sorted so this is a binary search of the packed addresses.
  */
 /*STATIC*/
 bool NimBLEDevice::isIgnored(const NimBLEAddress &address) {
-    for(auto &it : m_ignoreList) {
-        if(it.equals(address)){
-            return true;
-        }
-    }
-
-    return false;
+    return std::binary_search(m_ignoreList.begin(), m_ignoreList.end(), uint64_t(address));
 }
 
 
@@ -1175,7 +2884,23 @@ bool NimBLEDevice::isIgnored(const NimBLEAddress &address) {
  */
 /*STATIC*/
 void NimBLEDevice::addIgnored(const NimBLEAddress &address) {
-    m_ignoreList.push_back(address);
+    uint64_t addr = uint64_t(address);
+    m_ignoreList.insert(std::upper_bound(m_ignoreList.begin(), m_ignoreList.end(), addr), addr);
+}
+
+
+/**
+ * @brief Add a number of devices to the ignore list.
+ * @param [in] addresses A vector containing the addresses of the devices we want to ignore.
+ * @details The list is sorted once after all the addresses are added.
+ */
+/*STATIC*/
+void NimBLEDevice::addIgnored(const std::vector<NimBLEAddress> &addresses) {
+    m_ignoreList.reserve(m_ignoreList.size() + addresses.size());
+    for(auto &it : addresses) {
+        m_ignoreList.push_back(uint64_t(it));
+    }
+    std::sort(m_ignoreList.begin(), m_ignoreList.end());
 }
 
 
@@ -1185,11 +2910,10 @@ void NimBLEDevice::addIgnored(const NimBLEAddress &address) {
  */
 /*STATIC*/
 void  NimBLEDevice::removeIgnored(const NimBLEAddress &address) {
-    for(auto it = m_ignoreList.begin(); it != m_ignoreList.end(); ++it) {
-        if((*it).equals(address)){
-            m_ignoreList.erase(it);
-            return;
-        }
+    uint64_t addr = uint64_t(address);
+    auto it = std::lower_bound(m_ignoreList.begin(), m_ignoreList.end(), addr);
+    if(it != m_ignoreList.end() && *it == addr) {
+        m_ignoreList.erase(it);
     }
 }
 
@@ -36,11 +36,23 @@
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 #include "NimBLEServer.h"
+#include "NimBLETypedCharacteristic.h"
+#endif
+
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+#include "NimBLEL2CAPServer.h"
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_MESH)
+#include "NimBLEMesh.h"
 #endif
 
 #include "NimBLEUtils.h"
 #include "NimBLESecurity.h"
 #include "NimBLEAddress.h"
+#include "NimBLEStackProfile.h"
+#include "NimBLETrace.h"
+#include "NimBLERadioActivity.h"
 
 #ifdef ESP_PLATFORM
 #  include "esp_bt.h"
@@ -49,6 +61,7 @@
 #include <map>
 #include <string>
 #include <list>
+#include <vector>
 
 #define BLEDevice                       NimBLEDevice
 #define BLEClient                       NimBLEClient
@@ -88,7 +101,83 @@
 
 typedef int (*gap_event_handler)(ble_gap_event *event, void *arg);
 
+/**
+ * @brief Usage statistics of a host memory pool, returned by NimBLEDevice::getMemStats().
+ */
+struct NimBLEMemPoolStats {
+    std::string name;      /**< The name of the pool, e.g. msys_1, msys_2, ble_hci_acl_pool. */
+    uint32_t    blockSize; /**< The size of each block in bytes. */
+    uint16_t    numBlocks; /**< The number of blocks in the pool. */
+    uint16_t    numFree;   /**< The number of blocks currently free. */
+    uint16_t    minFree;   /**< The lowest number of free blocks seen since the pool was created. */
+    uint16_t    numFail;   /**< The number of allocations that failed because the pool was empty. */
+    uint16_t    maxChain;  /**< The longest mbuf chain built from the pool, 0 for pools that do not hold mbufs. */
+};
+
+/**
+ * @brief The RAM in bytes used by each part of the stack and the library, returned by NimBLEDevice::getMemoryReport().
+ * @details Pools are counted at their full size. Library objects are counted with their heap value buffers,
+ * the vectors holding them and a value buffer shared by several values is counted for each of them.
+ */
+struct NimBLEMemoryReport {
+    size_t      msysPools;   /**< The msys mbuf pools used for all packets of the host. */
+    size_t      aclPools;    /**< The HCI ACL data buffer pools. */
+    size_t      attServer;   /**< The ATT server attribute entries of the registered GATT database. */
+    size_t      otherPools;  /**< All other host and transport pools, connections, GATT and SM procedures. */
+    size_t      server;      /**< The local services, characteristics and descriptors and their values. */
+    size_t      remote;      /**< The remote services, characteristics and descriptors of all clients and their values. */
+    size_t      scanResults; /**< The stored scan results and the advertised device pool. */
+    size_t      bonds;       /**< The RAM copy of the bond store, allocated for the maximum number of bonds. */
+    size_t      total;       /**< The sum of all of the above. */
+};
+
+/**
+ * @brief The state restored after the last host reset, returned by NimBLEDevice::getResetRecoveryStats().
+ */
+struct NimBLEResetRecoveryStats {
+    uint32_t    resets;      /**< The number of host resets since init. */
+    uint32_t    syncMs;      /**< The time in ms from the last reset until the host synced with the controller. */
+    uint32_t    restoreMs;   /**< The time in ms from the last reset until all clients were reconnected or failed, 0 while pending. */
+    uint8_t     reconnected; /**< The number of clients reconnected after the last reset. */
+    uint8_t     failed;      /**< The number of clients that failed to reconnect after the last reset. */
+};
+
+/**
+ * @brief The private address resolution of the controller while scanning, returned by NimBLEDevice::getResolvStats().
+ */
+struct NimBLEResolvStats {
+    uint32_t    hwResolved;  /**< The RPAs resolved by the radio while receiving. */
+    uint32_t    swResolved;  /**< The RPAs resolved in software with the entries that did not fit in the radio list. */
+    uint32_t    unresolved;  /**< The RPAs resolved by neither. */
+    uint8_t     hwEntries;   /**< The resolving list entries with a peer IRK resolved by the radio. */
+    uint8_t     swEntries;   /**< The resolving list entries with a peer IRK resolved in software. */
+};
+
+/**
+ * @brief The state of the adaptive controller to host flow control, returned by NimBLEDevice::getFlowCtrlStats().
+ */
+struct NimBLEFlowCtrlStats {
+    uint16_t    window;      /**< The number of ACL buffers the controller may currently send to the host. */
+    uint16_t    windowMin;   /**< The lowest window since the host synced. */
+    uint16_t    withheld;    /**< The freed ACL buffers not yet returned to the controller to limit the window. */
+    uint16_t    latencyMs;   /**< The average time in ms from the reception of an ACL buffer until it is freed. */
+    uint32_t    shrinks;     /**< The number of times the window was made smaller. */
+    uint32_t    grows;       /**< The number of times the window was made larger. */
+    uint32_t    throttledMs; /**< The total time in ms the window was smaller than the ACL buffer count. */
+};
+
+/**
+ * @brief The radio time in percent given to each role by the coexistence scheduler, see NimBLEDevice::setCoexPriorities().
+ */
+struct NimBLECoexDuty {
+    uint8_t     connections; /**< The time reserved for the connection events of the current connections. */
+    uint8_t     scan;        /**< The scan window as a percentage of the scan interval. */
+    uint8_t     advertising; /**< The advertising duty, it sets the shortest advertising interval. */
+    uint8_t     connect;     /**< The initiator scan window as a percentage of its interval. */
+};
+
 extern "C" void ble_store_config_init(void);
+extern "C" int ble_store_config_flush(void);
 
 /**
  * @brief A model of a %BLE Device from which all the BLE roles are created.
@@ -97,15 +186,32 @@ class NimBLEDevice {
 public:
     static void             init(const std::string &deviceName);
     static void             deinit(bool clearAll = false);
+    static bool             suspend();
+    static bool             resume();
+    static bool             isSuspended();
     static void             setDeviceName(const std::string &deviceName);
     static bool             getInitialized();
     static NimBLEAddress    getAddress();
     static std::string      toString();
     static bool             whiteListAdd(const NimBLEAddress & address);
     static bool             whiteListRemove(const NimBLEAddress & address);
+    static bool             whiteListSet(const std::vector<NimBLEAddress> & addresses);
+    static void             whiteListBegin();
+    static bool             whiteListCommit();
     static bool             onWhiteList(const NimBLEAddress & address);
     static size_t           getWhiteListCount();
     static NimBLEAddress    getWhiteListAddress(size_t index);
+    static std::vector<NimBLEMemPoolStats> getMemStats();
+    static NimBLEMemoryReport getMemoryReport();
+    static void             setResetRecovery(bool enable);
+    static NimBLEResetRecoveryStats getResetRecoveryStats();
+    static bool             getFlowCtrlStats(NimBLEFlowCtrlStats* stats);
+    static void             setCoexPriorities(uint8_t scan, uint8_t advertising, uint8_t connect);
+    static NimBLECoexDuty   getCoexDuty();
+#if CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+    static NimBLERadioActivity getRadioActivity();
+    static void             resetRadioActivity();
+#endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
     static NimBLEScan*      getScan();
@@ -116,16 +222,23 @@ public:
     static NimBLEServer*    getServer();
 #endif
 
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+    static NimBLEL2CAPServer* createL2CAPServer();
+    static NimBLEL2CAPServer* getL2CAPServer();
+#endif
+
 #ifdef ESP_PLATFORM
     static void             setPower(esp_power_level_t powerLevel, esp_ble_power_type_t powerType=ESP_BLE_PWR_TYPE_DEFAULT);
     static int              getPower(esp_ble_power_type_t powerType=ESP_BLE_PWR_TYPE_DEFAULT);
     static void             setOwnAddrType(uint8_t own_addr_type, bool useNRPA=false);
-    static void             setScanDuplicateCacheSize(uint16_t cacheSize);
-    static void             setScanFilterMode(uint8_t type);
+    static bool             setTaskAffinity(int hostCore, int controllerCore = -1, int appCore = -1);
 #else
     static void             setPower(int dbm);
     static int              getPower();
+    static NimBLEResolvStats getResolvStats();
 #endif
+    static void             setScanDuplicateCacheSize(uint16_t cacheSize);
+    static void             setScanFilterMode(uint8_t type);
 
     static void             setCustomGapHandler(gap_event_handler handler);
     static void             setSecurityAuth(bool bonding, bool mitm, bool sc);
@@ -141,6 +254,7 @@ public:
     static uint16_t         getMTU();
     static bool             isIgnored(const NimBLEAddress &address);
     static void             addIgnored(const NimBLEAddress &address);
+    static void             addIgnored(const std::vector<NimBLEAddress> &addresses);
     static void             removeIgnored(const NimBLEAddress &address);
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
@@ -167,6 +281,13 @@ public:
     static NimBLEClient*    getDisconnectedClient();
     static size_t           getClientListSize();
     static std::list<NimBLEClient*>* getClientList();
+    static bool             queueConnect(NimBLEClient* pClient, connect_callback callback = nullptr,
+                                         bool discover = true);
+    static bool             setNotifyQueue(uint16_t queueSize, uint16_t maxLength,
+                                           uint32_t taskStackSize = 4096, uint8_t taskPriority = 1,
+                                           int taskCore = -1, bool dropOldest = false);
+    static uint32_t         getNotifyDropCount();
+    static uint32_t         getNotifyTruncateCount();
 #endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
@@ -175,20 +296,39 @@ public:
     static bool             isBonded(const NimBLEAddress &address);
     static void             deleteAllBonds();
     static NimBLEAddress    getBondedAddress(int index);
+    static bool             flushBonds();
+    static bool             setCallbackTasks(uint8_t numTasks, uint16_t queueSize,
+                                             uint32_t taskStackSize = 4096, uint8_t taskPriority = 1,
+                                             int taskCore = -1);
+    static uint32_t         getCallbackQueueFullCount();
 #endif
 
 private:
 #if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
     friend class NimBLEClient;
+    friend class NimBLERemoteCharacteristic;
 #endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
     friend class NimBLEScan;
 #endif
 
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    friend class NimBLEMesh;
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    friend class NimBLELinkProfile;
+    friend class NimBLEPhyPolicy;
+    friend class NimBLEPowerPolicy;
+    friend class NimBLEConnParamsPolicy;
+#endif
+
 #if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
     friend class NimBLEServer;
     friend class NimBLECharacteristic;
+    friend class NimBLEDescriptor;
+    friend class NimBLEDfuService;
 #endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
@@ -203,6 +343,100 @@ private:
     static void        onSync(void);
     static void        host_task(void *param);
     static bool        m_synced;
+    static bool        m_resetRecovery;
+    static ble_npl_time_t m_resetTime;
+    static uint8_t     m_recoveryPending;
+    static void        restoreAfterReset();
+    static void        recoveryConnected(int rc, bool count = true);
+    static NimBLEResetRecoveryStats m_recoveryStats;
+    // The coexistence scheduler priorities of scanning, advertising and connecting, 0 if not scheduled.
+    static uint8_t     m_coexPriority[3];
+    static bool        coexEnabled();
+    static bool        coexAdvertising();
+    static NimBLECoexDuty coexDuty(bool scanning, bool advertising, bool connecting);
+    static void        coexScanWindow(uint16_t &itvl, uint16_t &window, uint8_t duty);
+    static void        coexAdvInterval(uint16_t &itvlMin, uint16_t &itvlMax, bool scanResp);
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    /**
+     * @brief The callbacks that can be run by the callback tasks.
+     */
+    enum {
+        CB_SERVER_CONNECT,
+        CB_SERVER_DISCONNECT,
+        CB_SERVER_MTU_CHANGE,
+        CB_SERVER_AUTH_COMPLETE,
+        CB_CHR_WRITE,
+        CB_CHR_SUBSCRIBE,
+        CB_CHR_STATUS,
+        CB_DSC_WRITE,
+        CB_SERVER_PASSKEY,
+        CB_CLIENT_DISCONNECT,
+        CB_CLIENT_AUTH_COMPLETE,
+        CB_CLIENT_PASSKEY,
+    };
+
+    /**
+     * @brief A callback waiting in the queue of a callback task.
+     */
+    typedef struct {
+        uint16_t          next;
+        uint8_t           type;
+        void*             pObj;
+        int               arg;
+        int               code;
+        ble_gap_conn_desc desc;
+    } ble_callback_entry_t;
+
+    /**
+     * @brief A callback task and its queue.
+     */
+    typedef struct {
+        TaskHandle_t      task;
+        uint16_t          head;
+        uint16_t          tail;
+    } ble_callback_task_t;
+
+    static void        dispatchCallback(uint8_t type, void* pObj, uint16_t connHandle,
+                                        const ble_gap_conn_desc* desc, int arg = 0, int code = 0);
+    static void        runCallback(ble_callback_entry_t* pEntry);
+    static void        callbackTask(void *param);
+
+    static ble_callback_task_t*       m_callbackTasks;
+    static ble_callback_entry_t*      m_callbackPool;
+    static uint8_t                    m_numCallbackTasks;
+    static uint16_t                   m_callbackFree;
+    static uint32_t                   m_callbackQueueFull;
+#endif
+
+#if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    /**
+     * @brief A connection request waiting in the connect queue.
+     */
+    typedef struct {
+        NimBLEClient*    pClient;
+        connect_callback callback;
+        bool             discover;
+        bool             recovery;
+    } ble_connect_req_t;
+
+    static bool        queueConnect(const ble_connect_req_t &request);
+    static void        connectTask(void *param);
+
+    /**
+     * @brief A notification waiting in the notify queue.
+     */
+    typedef struct {
+        uint16_t         next;
+        uint16_t         connHandle;
+        uint16_t         attrHandle;
+        uint16_t         length;
+        bool             isNotify;
+    } ble_notify_entry_t;
+
+    static bool        queueNotify(NimBLERemoteCharacteristic* pChr, const struct os_mbuf *om, bool isNotify);
+    static void        notifyTask(void *param);
+#endif
 
 #if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
     static NimBLEScan*                m_pScan;
@@ -212,6 +446,10 @@ private:
     static NimBLEServer*              m_pServer;
 #endif
 
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+    static NimBLEL2CAPServer*         m_pL2CAPServer;
+#endif
+
 #if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
 #  if CONFIG_BT_NIMBLE_EXT_ADV
     static NimBLEExtAdvertising*      m_bleAdvertising;
@@ -222,18 +460,72 @@ private:
 
 #if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
     static std::list <NimBLEClient*>  m_cList;
+    // The connected clients indexed by the host connection slot of their connection.
+    static NimBLEClient*              m_clientSlots[NIMBLE_MAX_CONNECTIONS];
+    static std::list <ble_connect_req_t> m_connectQueue;
+    static TaskHandle_t               m_connectTask;
+    static TaskHandle_t               m_notifyTask;
+    static ble_notify_entry_t*        m_notifyPool;
+    static uint8_t*                   m_notifyData;
+    static uint16_t                   m_notifyMaxLength;
+    static uint16_t                   m_notifyFree;
+    static uint16_t                   m_notifyHead;
+    static uint16_t                   m_notifyTail;
+    static bool                       m_notifyDropOldest;
+    static uint32_t                   m_notifyDrops;
+    static uint32_t                   m_notifyTruncated;
 #endif
-    static std::list <NimBLEAddress>  m_ignoreList;
+    static std::vector<uint64_t>      m_ignoreList;
     static NimBLESecurityCallbacks*   m_securityCallbacks;
     static uint32_t                   m_passkey;
     static ble_gap_event_listener     m_listener;
     static gap_event_handler          m_customGapHandler;
     static uint8_t                    m_own_addr_type;
-#ifdef ESP_PLATFORM
     static uint16_t                   m_scanDuplicateSize;
     static uint8_t                    m_scanFilterMode;
+#ifdef ESP_PLATFORM
+    static int                        m_hostCore;
+    static int                        m_controllerCore;
+    static int                        m_appCore;
+
+    static BaseType_t       getTaskCore(int taskCore);
 #endif
     static std::vector<NimBLEAddress> m_whiteList;
+    static std::vector<NimBLEAddress> m_whiteListCommitted;
+    static bool                       m_whiteListBatch;
+
+    static bool             whiteListApply(const std::vector<NimBLEAddress> & addresses);
+#if defined( CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    static void             setClientSlot(uint16_t conn_handle, NimBLEClient* pClient);
+    static void             clearClientSlot(NimBLEClient* pClient);
+#endif
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+    /**
+     * @brief The modules dispatchGapEvent() routes the connection events to.
+     */
+    enum : uint8_t {
+        GAP_SUB_LINK_PROFILE = 0x01,
+        GAP_SUB_PHY_POLICY   = 0x02,
+        GAP_SUB_POWER_POLICY = 0x04,
+        GAP_SUB_CONN_PARAMS  = 0x08,
+        GAP_SUB_CONN_STATS   = 0x10,
+        GAP_SUB_RADIO        = 0x20,
+    };
+
+    /**
+     * @brief The modules holding a state for a connection, they get its events until it is closed.
+     */
+    typedef struct {
+        uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE;
+        uint8_t  subs = 0;
+    } ble_gap_subs_t;
+
+    static ble_gap_subs_t   m_gapSubs[NIMBLE_MAX_CONNECTIONS];
+    static void             gapSubscribe(uint16_t conn_handle, uint8_t sub);
+    static void             dispatchGapEvent(struct ble_gap_event *event);
+#endif
+    static void             onHostStopped(int status, void *arg);
+    static void             onResumeEvent(struct ble_npl_event *ev);
 };
 
 
@@ -0,0 +1,651 @@
+/*
+ * NimBLEDfuService.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEDfuService.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+#include "NimBLEL2CAPServer.h"
+#endif
+
+#ifdef ESP_PLATFORM
+#include "esp_ota_ops.h"
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+#define NIMBLE_DFU_OP_START  0x01
+#define NIMBLE_DFU_OP_ABORT  0x02
+#define NIMBLE_DFU_OP_END    0x03
+#define NIMBLE_DFU_OP_READY  0x81
+#define NIMBLE_DFU_OP_ACK    0x82
+#define NIMBLE_DFU_OP_DONE   0x83
+
+static const char* LOG_TAG = "NimBLEDfuService";
+
+#ifdef ESP_PLATFORM
+static NimBLEDfuOtaCallbacks defaultCallbacks;
+#else
+static NimBLEDfuCallbacks defaultCallbacks;
+#endif
+
+
+/**
+ * @brief Create the firmware update service on a server.
+ * @param [in] pServer A pointer to the server to create the service on.
+ * @param [in] bufSize The size of each of the two receive buffers, a multiple of the flash sector
+ * size writes the flash most efficiently. The client may send twice this ahead of the flash.
+ * @details Call start() to start the update task and the service.
+ */
+NimBLEDfuService::NimBLEDfuService(NimBLEServer* pServer, size_t bufSize)
+: m_ctrlCallbacks(this),
+  m_pCallbacks(&defaultCallbacks),
+  m_task(nullptr),
+  m_bufSize(bufSize > 0 ? bufSize : 1),
+  m_fillIdx(0),
+  m_state(STATE_IDLE),
+  m_connHandle(BLE_HS_CONN_HANDLE_NONE),
+  m_imageSize(0),
+  m_received(0),
+  m_expectedCrc(0),
+  m_written(0),
+  m_cmdHead(0),
+  m_cmdTail(0)
+{
+    for(int i = 0; i < 2; i++) {
+        m_buf[i] = new uint8_t[m_bufSize];
+        m_bufLen[i] = 0;
+        m_bufBusy[i] = false;
+    }
+
+    m_pService = pServer->createService(NIMBLE_DFU_SERVICE_UUID);
+    m_pCtrlChr = new ControlCharacteristic(this, m_pService);
+    m_pService->addCharacteristic(m_pCtrlChr);
+    m_pCtrlChr->setCallbacks(&m_ctrlCallbacks);
+    m_pDataChr = new DataCharacteristic(this, m_pService);
+    m_pService->addCharacteristic(m_pDataChr);
+} // NimBLEDfuService
+
+
+NimBLEDfuService::~NimBLEDfuService() {
+    if(m_task != nullptr) {
+        vTaskDelete(m_task);
+    }
+
+    if(m_pCtrlChr->getCallbacks() == &m_ctrlCallbacks) {
+        m_pCtrlChr->setCallbacks(nullptr);
+    }
+
+    delete[] m_buf[0];
+    delete[] m_buf[1];
+} // ~NimBLEDfuService
+
+
+/**
+ * @brief Construct the control point of the service.
+ */
+NimBLEDfuService::ControlCharacteristic::ControlCharacteristic(NimBLEDfuService* pDfu, NimBLEService* pService)
+: NimBLECharacteristic(NIMBLE_DFU_CONTROL_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY,
+                       BLE_ATT_ATTR_MAX_LEN, pService),
+  m_pDfu(pDfu)
+{
+} // ControlCharacteristic
+
+
+/**
+ * @brief Handle a command written to the control point.
+ */
+int NimBLEDfuService::ControlCharacteristic::writeValueFrom(const struct os_mbuf* om) {
+    return m_pDfu->handleControl(om);
+} // writeValueFrom
+
+
+/**
+ * @brief Construct the data characteristic of the service.
+ */
+NimBLEDfuService::DataCharacteristic::DataCharacteristic(NimBLEDfuService* pDfu, NimBLEService* pService)
+: NimBLECharacteristic(NIMBLE_DFU_DATA_UUID, NIMBLE_PROPERTY::WRITE_NR,
+                       BLE_ATT_ATTR_MAX_LEN, pService),
+  m_pDfu(pDfu)
+{
+} // DataCharacteristic
+
+
+/**
+ * @brief Copy the written data into the receive buffers.
+ */
+int NimBLEDfuService::DataCharacteristic::writeValueFrom(const struct os_mbuf* om) {
+    m_pDfu->handleData(om);
+    return 0;
+} // writeValueFrom
+
+
+/**
+ * @brief Track the client subscribed to the control point, the update is aborted if it unsubscribes.
+ * @details Disconnecting also unsubscribes.
+ */
+void NimBLEDfuService::ControlCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic,
+                                                    ble_gap_conn_desc* desc, uint16_t subValue)
+{
+    if(subValue & 0x0001) {
+        if(m_pDfu->m_connHandle == BLE_HS_CONN_HANDLE_NONE || !m_pDfu->isInProgress()) {
+            m_pDfu->m_connHandle = desc->conn_handle;
+        }
+    } else if(m_pDfu->m_connHandle == desc->conn_handle) {
+        m_pDfu->abort(ERROR_DISCONNECTED);
+        m_pDfu->m_connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
+} // onSubscribe
+
+
+/**
+ * @brief Start the update task and the service.
+ * @param [in] taskStackSize The stack size in bytes of the update task, the flash is written on this stack.
+ * @param [in] taskPriority The priority of the update task.
+ * @param [in] taskCore The core to run the update task on, -1 for the core set with
+ * NimBLEDevice::setTaskAffinity. Only used on ESP32.
+ * @return True if the task and the service were started.
+ */
+bool NimBLEDfuService::start(uint32_t taskStackSize, uint8_t taskPriority, int taskCore) {
+    if(m_task == nullptr) {
+#ifdef ESP_PLATFORM
+        BaseType_t rc = xTaskCreatePinnedToCore(NimBLEDfuService::updateTask, "nimble_dfu", taskStackSize, this,
+                                                taskPriority, &m_task,
+                                                NimBLEDevice::getTaskCore(taskCore));
+#else
+        (void)taskCore;
+        BaseType_t rc = xTaskCreate(NimBLEDfuService::updateTask, "nimble_dfu", taskStackSize / sizeof(StackType_t),
+                                    this, taskPriority, &m_task);
+#endif
+
+        if(rc != pdPASS) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to create update task");
+            m_task = nullptr;
+            return false;
+        }
+    }
+
+    return m_pService->start();
+} // start
+
+
+/**
+ * @brief Get the service, to add it to the advertised services.
+ */
+NimBLEService* NimBLEDfuService::getService() {
+    return m_pService;
+} // getService
+
+
+/**
+ * @brief Set the callbacks that write the image to flash.
+ * @param [in] pCallbacks A pointer to the callbacks, nullptr for the default.
+ * @details Must not be changed while an update is in progress.
+ */
+void NimBLEDfuService::setCallbacks(NimBLEDfuCallbacks* pCallbacks) {
+    m_pCallbacks = pCallbacks != nullptr ? pCallbacks : &defaultCallbacks;
+} // setCallbacks
+
+
+/**
+ * @brief Check if an update has started and not yet ended.
+ */
+bool NimBLEDfuService::isInProgress() {
+    return m_state.load() != STATE_IDLE;
+} // isInProgress
+
+
+/**
+ * @brief Get the size of the image of the current or last update.
+ */
+uint32_t NimBLEDfuService::getImageSize() {
+    return m_imageSize;
+} // getImageSize
+
+
+/**
+ * @brief Get the number of bytes of the image written to flash.
+ */
+uint32_t NimBLEDfuService::getBytesWritten() {
+    return m_written.load();
+} // getBytesWritten
+
+
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+/**
+ * @brief Also receive the image in the SDU's of L2CAP channels opened to a PSM.
+ * @param [in] psm The PSM to listen on.
+ * @param [in] mtu The largest SDU the channels receive.
+ * @return True if the L2CAP server is listening on the PSM.
+ * @details Only the data of a channel on the connection of the client subscribed to the control
+ * point is used, the commands are still written to the control point.
+ */
+bool NimBLEDfuService::listenL2CAP(uint16_t psm, uint16_t mtu) {
+    return NimBLEDevice::createL2CAPServer()->listen(psm, mtu, this);
+} // listenL2CAP
+
+
+/**
+ * @brief Copy a received SDU into the receive buffers.
+ */
+void NimBLEDfuService::onRead(NimBLEL2CAPChannel* pChannel, struct os_mbuf* sdu) {
+    if(pChannel->getConnHandle() == m_connHandle) {
+        handleData(sdu);
+    }
+} // onRead
+#endif
+
+
+/**
+ * @brief Handle a command written to the control point, called from the host task.
+ * @return 0 or the ATT error to respond with.
+ */
+int NimBLEDfuService::handleControl(const struct os_mbuf* om) {
+    uint8_t cmd[5];
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    if(len < 1 || len > sizeof(cmd)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    os_mbuf_copydata(om, 0, len, cmd);
+    uint32_t value = len == 5 ? cmd[1] | (cmd[2] << 8) | (cmd[3] << 16) | ((uint32_t)cmd[4] << 24) : 0;
+
+    switch(cmd[0]) {
+        case NIMBLE_DFU_OP_START: {
+            if(len != 5) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+
+            // The buffers are released by the update task ahead of the command that ends an update.
+            if(m_connHandle == BLE_HS_CONN_HANDLE_NONE || value == 0 ||
+               m_state.load() != STATE_IDLE || m_bufBusy[0] || m_bufBusy[1])
+            {
+                return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+            }
+
+            m_imageSize = value;
+            m_received = 0;
+            m_written = 0;
+            m_fillIdx = 0;
+            m_bufLen[0] = 0;
+            m_bufLen[1] = 0;
+            m_state = STATE_PREPARING;
+            if(!postCmd(CMD_START, 0)) {
+                m_state = STATE_IDLE;
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+
+            NIMBLE_LOGI(LOG_TAG, "Update started, image size %u", value);
+            return 0;
+        }
+
+        case NIMBLE_DFU_OP_ABORT:
+            if(len != 1) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            abort(ERROR_ABORTED);
+            return 0;
+
+        case NIMBLE_DFU_OP_END: {
+            if(len != 5) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+
+            if(m_state.load() != STATE_RECEIVING) {
+                return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+            }
+
+            if(m_received != m_imageSize) {
+                abort(ERROR_SIZE);
+                return 0;
+            }
+
+            m_expectedCrc = value;
+            uint8_t state = STATE_RECEIVING;
+            if(!m_state.compare_exchange_strong(state, STATE_FINISHING)) {
+                return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+            }
+
+            uint8_t idx = m_fillIdx;
+            if(m_bufLen[idx] > 0) {
+                m_bufBusy[idx] = true;
+                postCmd(CMD_WRITE, idx);
+            }
+            postCmd(CMD_END, 0);
+            return 0;
+        }
+
+        default:
+            return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+    }
+} // handleControl
+
+
+/**
+ * @brief Copy received image data into the receive buffers, called from the host task.
+ * @details A full buffer is handed to the update task and filling continues in the other one,
+ * the update is aborted if that one is still being written because the client exceeded the window.
+ */
+void NimBLEDfuService::handleData(const struct os_mbuf* om) {
+    uint8_t state = m_state.load();
+    if(state != STATE_RECEIVING) {
+        if(state == STATE_PREPARING) {
+            NIMBLE_LOGE(LOG_TAG, "Data received before READY");
+            abort(ERROR_STATE);
+        }
+        return;
+    }
+
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    if(m_received + len > m_imageSize) {
+        NIMBLE_LOGE(LOG_TAG, "Data received past the image size");
+        abort(ERROR_SIZE);
+        return;
+    }
+
+    uint16_t off = 0;
+    while(off < len) {
+        uint8_t idx = m_fillIdx;
+        if(m_bufBusy[idx].load(std::memory_order_acquire)) {
+            NIMBLE_LOGE(LOG_TAG, "Data received past the window");
+            abort(ERROR_OVERFLOW);
+            return;
+        }
+
+        size_t n = std::min<size_t>(len - off, m_bufSize - m_bufLen[idx]);
+        os_mbuf_copydata(om, off, n, m_buf[idx] + m_bufLen[idx]);
+        m_bufLen[idx] += n;
+        off += n;
+
+        if(m_bufLen[idx] == m_bufSize) {
+            m_bufBusy[idx] = true;
+            if(!postCmd(CMD_WRITE, idx)) {
+                abort(ERROR_OVERFLOW);
+                return;
+            }
+            m_fillIdx = idx ^ 1;
+        }
+    }
+
+    m_received += len;
+} // handleData
+
+
+/**
+ * @brief Queue a command for the update task.
+ * @return True if the command was queued.
+ */
+bool NimBLEDfuService::postCmd(uint8_t type, uint8_t arg) {
+    // The host task, the update task and the callback tasks can all abort an update.
+    ble_npl_hw_enter_critical();
+    uint8_t head = m_cmdHead.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) % CMD_QUEUE_SIZE;
+    bool full = next == m_cmdTail.load(std::memory_order_acquire);
+    if(!full) {
+        m_cmds[head].type = type;
+        m_cmds[head].arg = arg;
+        m_cmdHead.store(next, std::memory_order_release);
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(full) {
+        NIMBLE_LOGE(LOG_TAG, "Command queue full");
+        return false;
+    }
+
+    xTaskNotifyGive(m_task);
+    return true;
+} // postCmd
+
+
+/**
+ * @brief End the update in progress with an error.
+ * @param [in] status The error notified in DONE.
+ * @details Does nothing if no update is in progress or it is already ending.
+ */
+void NimBLEDfuService::abort(Status status) {
+    uint8_t state = m_state.load();
+    while(state != STATE_IDLE && state != STATE_FINISHING) {
+        if(m_state.compare_exchange_weak(state, STATE_FINISHING)) {
+            NIMBLE_LOGW(LOG_TAG, "Update aborted, status %u", status);
+            postCmd(CMD_ABORT, status);
+            return;
+        }
+    }
+} // abort
+
+
+/**
+ * @brief Notify the client subscribed to the control point.
+ * @param [in] opcode The opcode of the notification.
+ * @param [in] value The little endian value following the opcode.
+ * @param [in] len The number of bytes of the value.
+ */
+void NimBLEDfuService::notifyControl(uint8_t opcode, uint32_t value, uint8_t len) {
+    uint16_t connHandle = m_connHandle;
+    if(connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    uint8_t data[5] = {opcode, (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    struct os_mbuf* om = ble_hs_mbuf_from_flat(data, len + 1);
+    if(om == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to allocate notification");
+        return;
+    }
+
+    int rc = ble_gattc_notify_custom(connHandle, m_pCtrlChr->getHandle(), om);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Notify failed, rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+    }
+} // notifyControl
+
+
+/**
+ * @brief End the update, notify DONE and call NimBLEDfuCallbacks::onComplete.
+ */
+void NimBLEDfuService::complete(Status status) {
+    NIMBLE_LOGI(LOG_TAG, "Update complete, status %u, %u bytes written", status, m_written.load());
+    m_state = STATE_IDLE;
+    notifyControl(NIMBLE_DFU_OP_DONE, status, 1);
+    m_pCallbacks->onComplete(this, status);
+} // complete
+
+
+/**
+ * @brief Run a command from the host task on the update task.
+ * @param [in] cmd The command.
+ * @param [in,out] active True between a successful NimBLEDfuCallbacks::onStart and onFinish.
+ * @param [in,out] crc The CRC of the image written so far.
+ * @param [in,out] failure The error that made the update inactive before it ended.
+ */
+void NimBLEDfuService::runCmd(const dfu_cmd_t &cmd, bool &active, uint32_t &crc, Status &failure) {
+    switch(cmd.type) {
+        case CMD_START: {
+            crc = 0;
+            failure = SUCCESS;
+            active = m_pCallbacks->onStart(this, m_imageSize);
+            if(!active) {
+                failure = ERROR_FLASH;
+                abort(ERROR_FLASH);
+                break;
+            }
+
+            // The state is no longer preparing if the update was aborted meanwhile.
+            uint8_t state = STATE_PREPARING;
+            if(m_state.compare_exchange_strong(state, STATE_RECEIVING)) {
+                notifyControl(NIMBLE_DFU_OP_READY, m_bufSize * 2, 4);
+            }
+            break;
+        }
+
+        case CMD_WRITE: {
+            uint8_t idx = cmd.arg;
+            size_t len = m_bufLen[idx];
+            bool written = false;
+
+            if(active) {
+                uint32_t offset = m_written.load();
+                written = m_pCallbacks->onWrite(this, offset, m_buf[idx], len);
+                if(written) {
+                    crc = NimBLEUtils::crc32(crc, m_buf[idx], len);
+                    m_written = offset + len;
+                } else {
+                    NIMBLE_LOGE(LOG_TAG, "Flash write failed at offset %u", offset);
+                    m_pCallbacks->onFinish(this, false);
+                    active = false;
+                    failure = ERROR_FLASH;
+                    abort(ERROR_FLASH);
+                }
+            }
+
+            m_bufLen[idx] = 0;
+            m_bufBusy[idx].store(false, std::memory_order_release);
+            if(written) {
+                notifyControl(NIMBLE_DFU_OP_ACK, m_written.load(), 4);
+            }
+            break;
+        }
+
+        case CMD_END: {
+            Status status = failure;
+            if(active) {
+                active = false;
+                if(crc != m_expectedCrc) {
+                    NIMBLE_LOGE(LOG_TAG, "Image CRC mismatch");
+                    m_pCallbacks->onFinish(this, false);
+                    status = ERROR_CRC;
+                } else {
+                    status = m_pCallbacks->onFinish(this, true) ? SUCCESS : ERROR_FLASH;
+                }
+            }
+            complete(status);
+            break;
+        }
+
+        case CMD_ABORT:
+            if(active) {
+                active = false;
+                m_pCallbacks->onFinish(this, false);
+            }
+            complete((Status)cmd.arg);
+            break;
+
+        default:
+            break;
+    }
+} // runCmd
+
+
+/**
+ * @brief Run the commands queued by the host task, the flash is only written from this task.
+ */
+void NimBLEDfuService::updateTask(void *pvParameters) {
+    NimBLEDfuService* pDfu = (NimBLEDfuService*)pvParameters;
+    bool active = false;
+    uint32_t crc = 0;
+    Status failure = SUCCESS;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint8_t tail = pDfu->m_cmdTail.load(std::memory_order_relaxed);
+        while(tail != pDfu->m_cmdHead.load(std::memory_order_acquire)) {
+            dfu_cmd_t cmd = pDfu->m_cmds[tail];
+            tail = (tail + 1) % CMD_QUEUE_SIZE;
+            pDfu->m_cmdTail.store(tail, std::memory_order_release);
+            pDfu->runCmd(cmd, active, crc, failure);
+        }
+    }
+} // updateTask
+
+
+bool NimBLEDfuCallbacks::onStart(NimBLEDfuService* pDfu, uint32_t imageSize) {
+    NIMBLE_LOGE("NimBLEDfuCallbacks", "onStart: default, no flash writer set");
+    return false;
+} // onStart
+
+bool NimBLEDfuCallbacks::onWrite(NimBLEDfuService* pDfu, uint32_t offset, const uint8_t* data, size_t length) {
+    NIMBLE_LOGD("NimBLEDfuCallbacks", "onWrite: default");
+    return false;
+} // onWrite
+
+bool NimBLEDfuCallbacks::onFinish(NimBLEDfuService* pDfu, bool success) {
+    NIMBLE_LOGD("NimBLEDfuCallbacks", "onFinish: default");
+    return false;
+} // onFinish
+
+void NimBLEDfuCallbacks::onComplete(NimBLEDfuService* pDfu, NimBLEDfuService::Status status) {
+    NIMBLE_LOGD("NimBLEDfuCallbacks", "onComplete: default");
+} // onComplete
+
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Begin writing the next OTA partition, this erases the size of the image.
+ */
+bool NimBLEDfuOtaCallbacks::onStart(NimBLEDfuService* pDfu, uint32_t imageSize) {
+    const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+    if(partition == nullptr || imageSize > partition->size) {
+        NIMBLE_LOGE(LOG_TAG, "No OTA partition for an image of %u bytes", imageSize);
+        return false;
+    }
+
+    esp_ota_handle_t handle;
+    esp_err_t err = esp_ota_begin(partition, imageSize, &handle);
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "esp_ota_begin: err=%d", err);
+        return false;
+    }
+
+    m_partition = partition;
+    m_handle = handle;
+    return true;
+} // onStart
+
+
+/**
+ * @brief Write a part of the image to the OTA partition.
+ */
+bool NimBLEDfuOtaCallbacks::onWrite(NimBLEDfuService* pDfu, uint32_t offset, const uint8_t* data, size_t length) {
+    esp_err_t err = esp_ota_write(m_handle, data, length);
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "esp_ota_write: err=%d", err);
+        return false;
+    }
+    return true;
+} // onWrite
+
+
+/**
+ * @brief Validate the image and set the OTA partition as the boot partition, or discard it.
+ */
+bool NimBLEDfuOtaCallbacks::onFinish(NimBLEDfuService* pDfu, bool success) {
+    if(!success) {
+        esp_ota_abort(m_handle);
+        return false;
+    }
+
+    esp_err_t err = esp_ota_end(m_handle);
+    if(err == ESP_OK) {
+        err = esp_ota_set_boot_partition((const esp_partition_t*)m_partition);
+    }
+
+    if(err != ESP_OK) {
+        NIMBLE_LOGE(LOG_TAG, "OTA image not accepted: err=%d", err);
+        return false;
+    }
+    return true;
+} // onFinish
+#endif /* ESP_PLATFORM */
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
@@ -0,0 +1,240 @@
+/*
+ * NimBLEDfuService.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEDFUSERVICE_H_
+#define NIMBLEDFUSERVICE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEServer.h"
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+#include "NimBLEL2CAPChannel.h"
+#endif
+
+#include <atomic>
+
+/** Firmware update service UUID */
+#define NIMBLE_DFU_SERVICE_UUID  "3E5A0001-9D2C-4B7E-A5C6-2F1B0D8E7C41"
+/** Control point characteristic, commands are written to it and the progress is notified */
+#define NIMBLE_DFU_CONTROL_UUID  "3E5A0002-9D2C-4B7E-A5C6-2F1B0D8E7C41"
+/** Data characteristic, the image is written to it without response */
+#define NIMBLE_DFU_DATA_UUID     "3E5A0003-9D2C-4B7E-A5C6-2F1B0D8E7C41"
+
+class NimBLEDfuCallbacks;
+
+/**
+ * @brief A firmware update service that writes the image to flash from its own task.
+ * @details The image is received in two buffers: while one is written to flash by the update task
+ * the other is filled from the host task, so the transfer is paced by the radio rather than by the
+ * flash.\n
+ * The client subscribes to the control point and writes, in little endian:
+ * - START `0x01, uint32 image size`, the server prepares the flash and notifies
+ *   READY `0x81, uint32 window`.
+ * - The image, in order, with writes without response to the data characteristic or in SDU's on the
+ *   L2CAP channel opened with listenL2CAP. The client may send at most `window` bytes past the last
+ *   ACK `0x82, uint32 bytes written` the server notifies when a buffer is written to flash.
+ * - END `0x03, uint32 CRC-32 of the image` once all of it is sent, or ABORT `0x02` at any time.
+ *
+ * The server notifies DONE `0x83, uint8 Status` when the update ends for any reason, including
+ * the client unsubscribing or disconnecting.\n
+ * The flash is written by a NimBLEDfuCallbacks, on ESP32 the default writes the next OTA partition
+ * and sets it as the boot partition when the update succeeds.
+ */
+class NimBLEDfuService
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+                       : public NimBLEL2CAPChannelCallbacks
+#endif
+{
+public:
+    /**
+     * @brief The result of an update, notified in DONE.
+     */
+    enum Status : uint8_t {
+        SUCCESS        = 0,
+        ERROR_FLASH    = 1,
+        ERROR_SIZE     = 2,
+        ERROR_OVERFLOW = 3,
+        ERROR_CRC      = 4,
+        ERROR_ABORTED  = 5,
+        ERROR_STATE    = 6,
+        ERROR_DISCONNECTED = 7,
+    };
+
+    NimBLEDfuService(NimBLEServer* pServer, size_t bufSize = 4096);
+    ~NimBLEDfuService();
+
+    bool            start(uint32_t taskStackSize = 4096, uint8_t taskPriority = 1, int taskCore = -1);
+    NimBLEService*  getService();
+    void            setCallbacks(NimBLEDfuCallbacks* pCallbacks);
+    bool            isInProgress();
+    uint32_t        getImageSize();
+    uint32_t        getBytesWritten();
+#if CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+    bool            listenL2CAP(uint16_t psm, uint16_t mtu = 512);
+
+    void            onRead(NimBLEL2CAPChannel* pChannel, struct os_mbuf* sdu) override;
+#endif
+
+private:
+    /**
+     * @brief The control point, parses the commands instead of storing them as the value.
+     */
+    class ControlCharacteristic : public NimBLECharacteristic {
+    public:
+        ControlCharacteristic(NimBLEDfuService* pDfu, NimBLEService* pService);
+    protected:
+        int writeValueFrom(const struct os_mbuf* om) override;
+    private:
+        NimBLEDfuService* m_pDfu;
+    };
+
+    /**
+     * @brief The data characteristic, copies the written data into the buffers instead of the value.
+     */
+    class DataCharacteristic : public NimBLECharacteristic {
+    public:
+        DataCharacteristic(NimBLEDfuService* pDfu, NimBLEService* pService);
+    protected:
+        int writeValueFrom(const struct os_mbuf* om) override;
+    private:
+        NimBLEDfuService* m_pDfu;
+    };
+
+    /**
+     * @brief Tracks the client subscribed to the control point.
+     */
+    class ControlCallbacks : public NimBLECharacteristicCallbacks {
+    public:
+        ControlCallbacks(NimBLEDfuService* pDfu) : m_pDfu(pDfu) {};
+        void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc,
+                         uint16_t subValue) override;
+    private:
+        NimBLEDfuService* m_pDfu;
+    };
+
+    enum : uint8_t {
+        STATE_IDLE,
+        STATE_PREPARING,
+        STATE_RECEIVING,
+        STATE_FINISHING,
+    };
+
+    enum : uint8_t {
+        CMD_START,
+        CMD_WRITE,
+        CMD_END,
+        CMD_ABORT,
+    };
+
+    enum : uint8_t {
+        CMD_QUEUE_SIZE = 8,
+    };
+
+    /**
+     * @brief A request from the host task to the update task.
+     */
+    typedef struct {
+        uint8_t  type;
+        uint8_t  arg;
+    } dfu_cmd_t;
+
+    static void           updateTask(void *pvParameters);
+    int                   handleControl(const struct os_mbuf* om);
+    void                  handleData(const struct os_mbuf* om);
+    bool                  postCmd(uint8_t type, uint8_t arg);
+    void                  abort(Status status);
+    void                  notifyControl(uint8_t opcode, uint32_t value, uint8_t len);
+    void                  runCmd(const dfu_cmd_t &cmd, bool &active, uint32_t &crc, Status &failure);
+    void                  complete(Status status);
+
+    NimBLEService*        m_pService;
+    ControlCharacteristic* m_pCtrlChr;
+    DataCharacteristic*   m_pDataChr;
+    ControlCallbacks      m_ctrlCallbacks;
+    NimBLEDfuCallbacks*   m_pCallbacks;
+    TaskHandle_t          m_task;
+    uint8_t*              m_buf[2];
+    size_t                m_bufSize;
+    size_t                m_bufLen[2];
+    std::atomic<bool>     m_bufBusy[2];
+    uint8_t               m_fillIdx;
+    std::atomic<uint8_t>  m_state;
+    volatile uint16_t     m_connHandle;
+    uint32_t              m_imageSize;
+    uint32_t              m_received;
+    uint32_t              m_expectedCrc;
+    std::atomic<uint32_t> m_written;
+    dfu_cmd_t             m_cmds[CMD_QUEUE_SIZE];
+    std::atomic<uint8_t>  m_cmdHead;
+    std::atomic<uint8_t>  m_cmdTail;
+}; // NimBLEDfuService
+
+
+/**
+ * @brief Writes the image of a NimBLEDfuService to flash, all methods are called from the update task.
+ */
+class NimBLEDfuCallbacks {
+public:
+    virtual ~NimBLEDfuCallbacks() {};
+
+    /**
+     * @brief Called when an update starts, prepare the flash for the image.
+     * @param [in] pDfu A pointer to the service.
+     * @param [in] imageSize The size of the image in bytes.
+     * @return True if the image can be written.
+     */
+    virtual bool onStart(NimBLEDfuService* pDfu, uint32_t imageSize);
+
+    /**
+     * @brief Called to write a part of the image, the parts are written in order.
+     * @param [in] pDfu A pointer to the service.
+     * @param [in] offset The offset of the data in the image.
+     * @param [in] data A pointer to the data.
+     * @param [in] length The length of the data.
+     * @return True if the data was written.
+     */
+    virtual bool onWrite(NimBLEDfuService* pDfu, uint32_t offset, const uint8_t* data, size_t length);
+
+    /**
+     * @brief Called when an update that started ends.
+     * @param [in] pDfu A pointer to the service.
+     * @param [in] success True if the whole image was written and its CRC matched, false if the
+     * update was aborted and the image must be discarded.
+     * @return True if the image was validated and will be used.
+     */
+    virtual bool onFinish(NimBLEDfuService* pDfu, bool success);
+
+    /**
+     * @brief Called after DONE was notified, restart here to boot the new image.
+     * @param [in] pDfu A pointer to the service.
+     * @param [in] status The result of the update.
+     */
+    virtual void onComplete(NimBLEDfuService* pDfu, NimBLEDfuService::Status status);
+}; // NimBLEDfuCallbacks
+
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Writes the image to the next OTA partition and sets it as the boot partition.
+ * @details The default callbacks of NimBLEDfuService on ESP32, the device is not restarted.
+ */
+class NimBLEDfuOtaCallbacks : public NimBLEDfuCallbacks {
+public:
+    bool onStart(NimBLEDfuService* pDfu, uint32_t imageSize) override;
+    bool onWrite(NimBLEDfuService* pDfu, uint32_t offset, const uint8_t* data, size_t length) override;
+    bool onFinish(NimBLEDfuService* pDfu, bool success) override;
+
+private:
+    const void*           m_partition = nullptr;
+    uint32_t              m_handle = 0;
+}; // NimBLEDfuOtaCallbacks
+#endif
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLEDFUSERVICE_H_ */
@@ -40,6 +40,58 @@ NimBLEEddystoneTLM::NimBLEEddystoneTLM() {
 } // NimBLEEddystoneTLM
 
 
+/**
+ * @brief Decode an unencrypted Eddystone TLM frame without copying or allocating.
+ * @param [in] data A pointer to the service data of the 0xFEAA UUID,
+ * as from NimBLEAdvertisedDevice::getServiceDataPtr.
+ * @param [in] length The length of the data.
+ * @param [out] pBeacon A pointer to storage for the decoded fields.
+ * @return True if the data is an unencrypted TLM frame, pBeacon is not modified otherwise.
+ */
+bool NimBLEEddystoneTLM::decode(const uint8_t* data, size_t length, BeaconData* pBeacon) {
+    if (data == nullptr || length < FRAME_LENGTH || data[0] != EDDYSTONE_TLM_FRAME_TYPE || data[1] != 0) {
+        return false;
+    }
+
+    pBeacon->version  = data[1];
+    pBeacon->volt     = (data[2] << 8) | data[3];
+    pBeacon->temp     = (int16_t)((data[4] << 8) | data[5]);
+    pBeacon->advCount = ((uint32_t)data[6] << 24) | ((uint32_t)data[7] << 16) | (data[8] << 8) | data[9];
+    pBeacon->tmil     = ((uint32_t)data[10] << 24) | ((uint32_t)data[11] << 16) | (data[12] << 8) | data[13];
+    return true;
+} // decode
+
+
+/**
+ * @brief Encode an unencrypted Eddystone TLM frame into a buffer for the service data of an advertisement.
+ * @param [in] beacon The fields of the frame.
+ * @param [in] buf A pointer to the buffer to write the frame to.
+ * @param [in] size The size of the buffer.
+ * @return The number of bytes written, 0 if the buffer is smaller than FRAME_LENGTH.
+ */
+size_t NimBLEEddystoneTLM::encode(const BeaconData& beacon, uint8_t* buf, size_t size) {
+    if (buf == nullptr || size < FRAME_LENGTH) {
+        return 0;
+    }
+
+    buf[0]  = EDDYSTONE_TLM_FRAME_TYPE;
+    buf[1]  = beacon.version;
+    buf[2]  = beacon.volt >> 8;
+    buf[3]  = beacon.volt & 0xFF;
+    buf[4]  = (uint16_t)beacon.temp >> 8;
+    buf[5]  = beacon.temp & 0xFF;
+    buf[6]  = beacon.advCount >> 24;
+    buf[7]  = (beacon.advCount >> 16) & 0xFF;
+    buf[8]  = (beacon.advCount >> 8) & 0xFF;
+    buf[9]  = beacon.advCount & 0xFF;
+    buf[10] = beacon.tmil >> 24;
+    buf[11] = (beacon.tmil >> 16) & 0xFF;
+    buf[12] = (beacon.tmil >> 8) & 0xFF;
+    buf[13] = beacon.tmil & 0xFF;
+    return FRAME_LENGTH;
+} // encode
+
+
 /**
  * @brief Retrieve the data that is being advertised.
  * @return The advertised data.
@@ -28,7 +28,24 @@
  */
 class NimBLEEddystoneTLM {
 public:
+    /**
+     * @brief The fields of an unencrypted Eddystone TLM frame in host byte order,
+     * used to decode and encode frames without allocating.
+     */
+    struct BeaconData {
+        uint8_t  version;
+        uint16_t volt;     /**< Battery voltage in millivolts. */
+        int16_t  temp;     /**< Temperature in 1/256 degrees Celsius. */
+        uint32_t advCount; /**< Advertisements sent since power up. */
+        uint32_t tmil;     /**< Time since power up in 0.1 seconds. */
+    };
+
+    /** @brief The length of an unencrypted TLM frame in the service data. */
+    static const size_t FRAME_LENGTH = 14;
+
     NimBLEEddystoneTLM();
+    static bool   decode(const uint8_t* data, size_t length, BeaconData* pBeacon);
+    static size_t encode(const BeaconData& beacon, uint8_t* buf, size_t size);
     std::string getData();
     NimBLEUUID   getUUID();
     uint8_t  getVersion();
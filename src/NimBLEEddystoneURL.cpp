@@ -75,79 +75,100 @@ std::string NimBLEEddystoneURL::getURL() {
  * @return The full URL.
  */
 std::string NimBLEEddystoneURL::getDecodedURL() {
-    std::string decodedURL = "";
-
-    switch (m_eddystoneData.url[0]) {
-        case 0x00:
-            decodedURL += "http://www.";
-            break;
-        case 0x01:
-            decodedURL += "https://www.";
-            break;
-        case 0x02:
-            decodedURL += "http://";
-            break;
-        case 0x03:
-            decodedURL += "https://";
-            break;
-        default:
-            decodedURL += m_eddystoneData.url[0];
+    char buf[128];
+    decodeURL(m_eddystoneData.url, lengthURL, buf, sizeof(buf));
+    return std::string(buf);
+} // getDecodedURL
+
+
+/**
+ * @brief Decode an Eddystone URL frame without copying or allocating.
+ * @param [in] data A pointer to the service data of the 0xFEAA UUID,
+ * as from NimBLEAdvertisedDevice::getServiceDataPtr.
+ * @param [in] length The length of the data.
+ * @param [out] pBeacon A pointer to storage for the decoded fields, the URL is left encoded, see decodeURL.
+ * @return True if the data is a URL frame, pBeacon is not modified otherwise.
+ */
+bool NimBLEEddystoneURL::decode(const uint8_t* data, size_t length, BeaconData* pBeacon) {
+    if (data == nullptr || length < FRAME_HEADER_LENGTH + 1 ||
+        length > FRAME_HEADER_LENGTH + sizeof(pBeacon->url) || data[0] != EDDYSTONE_URL_FRAME_TYPE)
+    {
+        return false;
+    }
+
+    pBeacon->advertisedTxPower = (int8_t)data[1];
+    pBeacon->urlLength         = length - FRAME_HEADER_LENGTH;
+    memcpy(pBeacon->url, data + FRAME_HEADER_LENGTH, pBeacon->urlLength);
+    return true;
+} // decode
+
+
+/**
+ * @brief Encode an Eddystone URL frame into a buffer for the service data of an advertisement.
+ * @param [in] beacon The fields of the frame.
+ * @param [in] buf A pointer to the buffer to write the frame to.
+ * @param [in] size The size of the buffer.
+ * @return The number of bytes written, 0 if the URL is invalid or the buffer is too small.
+ */
+size_t NimBLEEddystoneURL::encode(const BeaconData& beacon, uint8_t* buf, size_t size) {
+    size_t length = FRAME_HEADER_LENGTH + beacon.urlLength;
+    if (buf == nullptr || beacon.urlLength == 0 || beacon.urlLength > sizeof(beacon.url) || size < length) {
+        return 0;
     }
 
-    for (int i = 1; i < lengthURL; i++) {
-        if (m_eddystoneData.url[i] > 33 && m_eddystoneData.url[i] < 127) {
-            decodedURL += m_eddystoneData.url[i];
-        } else {
-            switch (m_eddystoneData.url[i]) {
-                case 0x00:
-                    decodedURL += ".com/";
-                    break;
-                case 0x01:
-                    decodedURL += ".org/";
-                    break;
-                case 0x02:
-                    decodedURL += ".edu/";
-                    break;
-                case 0x03:
-                    decodedURL += ".net/";
-                    break;
-                case 0x04:
-                    decodedURL += ".info/";
-                    break;
-                case 0x05:
-                    decodedURL += ".biz/";
-                    break;
-                case 0x06:
-                    decodedURL += ".gov/";
-                    break;
-                case 0x07:
-                    decodedURL += ".com";
-                    break;
-                case 0x08:
-                    decodedURL += ".org";
-                    break;
-                case 0x09:
-                    decodedURL += ".edu";
-                    break;
-                case 0x0A:
-                    decodedURL += ".net";
-                    break;
-                case 0x0B:
-                    decodedURL += ".info";
-                    break;
-                case 0x0C:
-                    decodedURL += ".biz";
-                    break;
-                case 0x0D:
-                    decodedURL += ".gov";
-                    break;
-                default:
-                    break;
+    buf[0] = EDDYSTONE_URL_FRAME_TYPE;
+    buf[1] = (uint8_t)beacon.advertisedTxPower;
+    memcpy(buf + FRAME_HEADER_LENGTH, beacon.url, beacon.urlLength);
+    return length;
+} // encode
+
+
+/**
+ * @brief Expand an encoded Eddystone URL into a buffer.
+ * @param [in] url A pointer to the scheme prefix code followed by the encoded URL.
+ * @param [in] length The length of the encoded URL including the scheme code.
+ * @param [in] buf A pointer to the buffer to write the null terminated URL to.
+ * @param [in] size The size of the buffer, the URL is truncated if it does not fit.
+ * @return The length of the URL written, not including the null terminator.
+ */
+size_t NimBLEEddystoneURL::decodeURL(const uint8_t* url, size_t length, char* buf, size_t size) {
+    static const char* const schemes[] = {"http://www.", "https://www.", "http://", "https://"};
+    static const char* const codes[]   = {".com/", ".org/", ".edu/", ".net/", ".info/", ".biz/", ".gov/",
+                                          ".com",  ".org",  ".edu",  ".net",  ".info",  ".biz",  ".gov"};
+    size_t pos = 0;
+
+    if (buf == nullptr || size == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        const char* str = nullptr;
+        char c = 0;
+
+        if (i == 0) {
+            if (url[0] < sizeof(schemes) / sizeof(schemes[0])) {
+                str = schemes[url[0]];
+            } else {
+                c = url[0];
             }
+        } else if (url[i] > 33 && url[i] < 127) {
+            c = url[i];
+        } else if (url[i] < sizeof(codes) / sizeof(codes[0])) {
+            str = codes[url[i]];
+        }
+
+        if (str != nullptr) {
+            while (*str != '\0' && pos < size - 1) {
+                buf[pos++] = *str++;
+            }
+        } else if (c != 0 && pos < size - 1) {
+            buf[pos++] = c;
         }
     }
-    return decodedURL;
-} // getDecodedURL
+
+    buf[pos] = '\0';
+    return pos;
+} // decodeURL
 
 
 
@@ -27,7 +27,22 @@
  */
 class NimBLEEddystoneURL {
 public:
+    /**
+     * @brief The fields of an Eddystone URL frame, used to decode and encode frames without allocating.
+     */
+    struct BeaconData {
+        int8_t   advertisedTxPower;
+        uint8_t  urlLength;  /**< The number of bytes used in url. */
+        uint8_t  url[18];    /**< The scheme prefix code followed by the encoded URL. */
+    };
+
+    /** @brief The length of a URL frame in the service data without the URL. */
+    static const size_t FRAME_HEADER_LENGTH = 2;
+
     NimBLEEddystoneURL();
+    static bool   decode(const uint8_t* data, size_t length, BeaconData* pBeacon);
+    static size_t encode(const BeaconData& beacon, uint8_t* buf, size_t size);
+    static size_t decodeURL(const uint8_t* url, size_t length, char* buf, size_t size);
     std::string getData();
     NimBLEUUID   getUUID();
     int8_t    getPower();
@@ -21,6 +21,14 @@
 #include "NimBLEUtils.h"
 #include "NimBLELog.h"
 
+#include <algorithm>
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
 static NimBLEExtAdvertisingCallbacks defaultCallbacks;
 static const char* LOG_TAG = "NimBLEExtAdvertising";
 
@@ -29,6 +37,11 @@ static const char* LOG_TAG = "NimBLEExtAdvertising";
  * @brief Destructor: deletes callback instances if requested.
  */
 NimBLEExtAdvertising::~NimBLEExtAdvertising() {
+    if(m_schedTimerInit) {
+        ble_npl_callout_stop(&m_schedTimer);
+        ble_npl_callout_deinit(&m_schedTimer);
+    }
+
     if(m_deleteCallbacks && m_pCallbacks != &defaultCallbacks) {
         delete m_pCallbacks;
     }
@@ -78,46 +91,162 @@ bool NimBLEExtAdvertising::setInstanceData(uint8_t inst_id, NimBLEExtAdvertiseme
 
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "Advertising config error: rc = %d", rc);
+        return false;
+    }
+
+    NIMBLE_CPP_RADIO_ADV_CONFIG(inst_id, adv.m_params.itvl_min, adv.m_params.itvl_max,
+                                NimBLERadioActivity::advEventUs(adv.m_params.legacy_pdu,
+                                    adv.m_params.scannable || adv.m_params.connectable,
+                                    adv.m_params.primary_phy));
+
+    return setInstancePayload(inst_id, adv);
+}
+
+
+/**
+ * @brief Set the advertisement or scan response data of a configured instance from an mbuf chain.
+ * @param [in] inst_id The extended advertisement instance ID, configured with setInstanceData.
+ * @param [in] data The chain holding the data, up to CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN bytes.
+ * The chain is always consumed, even on failure.
+ * @param [in] scanResponse True to set the scan response data of a scannable instance.
+ * @return True if successful.
+ * @details The host sends the chain to the controller in as many HCI commands as needed
+ * without copying it to a flat buffer first. While the instance is advertising the data
+ * must fit in a single command (251 bytes), stop the instance to set larger data.
+ */
+bool NimBLEExtAdvertising::setData(uint8_t inst_id, struct os_mbuf* data, bool scanResponse) {
+    int rc;
+
+    if (scanResponse) {
+        rc = ble_gap_ext_adv_rsp_set_data(inst_id, data);
     } else {
-        os_mbuf *buf;
-        buf = os_msys_get_pkthdr(adv.m_payload.size(), 0);
-        if (!buf) {
-            NIMBLE_LOGE(LOG_TAG, "Data buffer allocation failed");
-            return false;
+        rc = ble_gap_ext_adv_set_data(inst_id, data);
+    }
+
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Unable to set data: rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setData
+
+
+/**
+ * @brief Set the advertisement or scan response data of a configured instance from several buffers.
+ * @param [in] inst_id The extended advertisement instance ID, configured with setInstanceData.
+ * @param [in] segments The parts of the data, in order.
+ * @param [in] count The number of segments.
+ * @param [in] scanResponse True to set the scan response data of a scannable instance.
+ * @return True if successful.
+ * @details The segments are appended to an mbuf chain from the msys pools, large payloads
+ * need enough msys blocks to hold them.
+ */
+bool NimBLEExtAdvertising::setData(uint8_t inst_id, const ext_adv_segment_t* segments, size_t count,
+                                   bool scanResponse) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += segments[i].length;
+    }
+
+    if (total > CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN) {
+        NIMBLE_LOGE(LOG_TAG, "Data length %u exceeds the max of %u", (unsigned)total,
+                    CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN);
+        return false;
+    }
+
+    os_mbuf *buf = os_msys_get_pkthdr(total, 0);
+    if (!buf) {
+        NIMBLE_LOGE(LOG_TAG, "Data buffer allocation failed");
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (segments[i].length == 0) {
+            continue;
         }
 
-        rc = os_mbuf_append(buf, &adv.m_payload[0], adv.m_payload.size());
+        int rc = os_mbuf_append(buf, segments[i].data, segments[i].length);
         if (rc != 0) {
             NIMBLE_LOGE(LOG_TAG, "Unable to copy data: rc = %d", rc);
+            os_mbuf_free_chain(buf);
             return false;
+        }
+    }
+
+    return setData(inst_id, buf, scanResponse);
+} // setData
+
+
+/**
+ * @brief Set the fragment preference sent to the controller with the data of an instance.
+ * @param [in] inst_id The extended advertisement instance ID.
+ * @param [in] noFragment True to ask the controller to send the data in as few PDUs as possible,
+ * lowering the time to receive it. False to let the controller fragment the data as it likes,
+ * which may use less airtime per PDU.
+ * @return True if successful.
+ * @details The preference applies to data set after this call and is kept until the instance is removed.
+ */
+bool NimBLEExtAdvertising::setFragmentPreference(uint8_t inst_id, bool noFragment) {
+    int rc = ble_gap_ext_adv_set_fragment_pref(inst_id, noFragment ?
+                                               BLE_HCI_LE_SET_DATA_FRAG_PREF_NO_FRAG :
+                                               BLE_HCI_LE_SET_DATA_FRAG_PREF_ALLOW);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_ext_adv_set_fragment_pref rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setFragmentPreference
+
+
+/**
+ * @brief Set the data and address of a configured advertising instance.
+ * @param [in] inst_id The extended advertisement instance ID.
+ * @param [in] adv The extended advertisement with the data to set.
+ * @return True if successful.
+ */
+bool NimBLEExtAdvertising::setInstancePayload(uint8_t inst_id, NimBLEExtAdvertisement& adv) {
+    os_mbuf *buf;
+    buf = os_msys_get_pkthdr(adv.m_payload.size(), 0);
+    if (!buf) {
+        NIMBLE_LOGE(LOG_TAG, "Data buffer allocation failed");
+        return false;
+    }
+
+    int rc = os_mbuf_append(buf, &adv.m_payload[0], adv.m_payload.size());
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Unable to copy data: rc = %d", rc);
+        return false;
+    } else {
+        if (adv.m_params.scannable && !adv.m_params.legacy_pdu) {
+            rc = ble_gap_ext_adv_rsp_set_data(inst_id, buf);
         } else {
-            if (adv.m_params.scannable && !adv.m_params.legacy_pdu) {
-                rc = ble_gap_ext_adv_rsp_set_data(inst_id, buf);
-            } else {
-                rc = ble_gap_ext_adv_set_data(inst_id, buf);
+            rc = ble_gap_ext_adv_set_data(inst_id, buf);
+        }
+
+        if (rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Invalid advertisement data: rc = %d", rc);
+        } else {
+            if (adv.m_advAddress != NimBLEAddress("")) {
+                ble_addr_t addr;
+                memcpy(&addr.val, adv.m_advAddress.getNative(), 6);
+                // Custom advertising address must be random.
+                addr.type = BLE_OWN_ADDR_RANDOM;
+                rc = ble_gap_ext_adv_set_addr(inst_id, &addr);
             }
 
             if (rc != 0) {
-                NIMBLE_LOGE(LOG_TAG, "Invalid advertisement data: rc = %d", rc);
-            } else {
-                if (adv.m_advAddress != NimBLEAddress("")) {
-                    ble_addr_t addr;
-                    memcpy(&addr.val, adv.m_advAddress.getNative(), 6);
-                    // Custom advertising address must be random.
-                    addr.type = BLE_OWN_ADDR_RANDOM;
-                    rc = ble_gap_ext_adv_set_addr(inst_id, &addr);
-                }
-
-                if (rc != 0) {
-                    NIMBLE_LOGE(LOG_TAG, "Error setting advertisement address: rc = %d", rc);
-                    return false;
-                }
+                NIMBLE_LOGE(LOG_TAG, "Error setting advertisement address: rc = %d", rc);
+                return false;
             }
         }
     }
 
     return (rc == 0);
-}
+} // setInstancePayload
 
 
 /**
@@ -165,6 +294,7 @@ bool NimBLEExtAdvertising::start(uint8_t inst_id, int duration, int max_events)
     switch (rc) {
         case 0:
              m_advStatus[inst_id] = true;
+             NIMBLE_CPP_RADIO_ADV_START(inst_id);
              break;
 
         case BLE_HS_EINVAL:
@@ -246,6 +376,7 @@ bool NimBLEExtAdvertising::stop(uint8_t inst_id) {
     }
 
     m_advStatus[inst_id] = false;
+    NIMBLE_CPP_RADIO_ADV_STOP(inst_id);
     return true;
 } // stop
 
@@ -265,11 +396,335 @@ bool NimBLEExtAdvertising::stop() {
     for(auto it : m_advStatus) {
         it = false;
     }
+    NIMBLE_CPP_RADIO_ADV_STOP_ALL();
 
     return true;
 } // stop
 
 
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+/**
+ * @brief Configure periodic advertising for an instance.
+ * @param [in] inst_id The extended advertisement instance ID, its data must be set first with
+ * setInstanceData and it must be non-connectable, non-scannable and not anonymous.
+ * @param [in] minInterval The minimum periodic advertising interval in 1.25ms units, 6 to 65535.
+ * @param [in] maxInterval The maximum periodic advertising interval in 1.25ms units, 6 to 65535.
+ * @param [in] includeTxPower If true the transmit power is included in the periodic advertisements.
+ * @return True if successful.
+ */
+bool NimBLEExtAdvertising::setPeriodicParams(uint8_t inst_id, uint16_t minInterval,
+                                             uint16_t maxInterval, bool includeTxPower)
+{
+    ble_gap_periodic_adv_params params;
+    memset(&params, 0, sizeof(params));
+    params.include_tx_power = includeTxPower;
+    params.itvl_min         = minInterval;
+    params.itvl_max         = maxInterval;
+
+    int rc = ble_gap_periodic_adv_configure(inst_id, &params);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_configure rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setPeriodicParams
+
+
+/**
+ * @brief Set the data sent in the periodic advertisements of an instance.
+ * @param [in] inst_id The extended advertisement instance ID.
+ * @param [in] data The data to advertise, up to CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN bytes.
+ * @param [in] length The length of the data.
+ * @return True if successful.
+ * @details The data can be changed while periodic advertising is running,
+ * synced receivers get the new data in the next periodic advertisement.
+ */
+bool NimBLEExtAdvertising::setPeriodicData(uint8_t inst_id, const uint8_t* data, size_t length) {
+    os_mbuf *buf = os_msys_get_pkthdr(length, 0);
+    if (!buf) {
+        NIMBLE_LOGE(LOG_TAG, "Data buffer allocation failed");
+        return false;
+    }
+
+    int rc = os_mbuf_append(buf, data, length);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Unable to copy periodic data: rc = %d", rc);
+        os_mbuf_free_chain(buf);
+        return false;
+    }
+
+    // The host frees the buffer.
+    rc = ble_gap_periodic_adv_set_data(inst_id, buf);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_set_data rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setPeriodicData
+
+
+/**
+ * @brief Set the data sent in the periodic advertisements of an instance.
+ * @param [in] inst_id The extended advertisement instance ID.
+ * @param [in] adv A reference to a NimBLEExtAdvertisement that contains the data,
+ * the advertising parameters of the NimBLEExtAdvertisement are not used.
+ * @return True if successful.
+ */
+bool NimBLEExtAdvertising::setPeriodicData(uint8_t inst_id, NimBLEExtAdvertisement& adv) {
+    return setPeriodicData(inst_id, adv.m_payload.data(), adv.m_payload.size());
+} // setPeriodicData
+
+
+/**
+ * @brief Start periodic advertising on an instance.
+ * @param [in] inst_id The extended advertisement instance ID, configured with setPeriodicParams.
+ * @return True if successful.
+ * @details Receivers find the periodic train from the extended advertisements of the instance,
+ * so the instance must also be started with start().
+ */
+bool NimBLEExtAdvertising::startPeriodic(uint8_t inst_id) {
+    if(!NimBLEDevice::m_synced) {
+        NIMBLE_LOGE(LOG_TAG, "Host reset, wait for sync.");
+        return false;
+    }
+
+    int rc = ble_gap_periodic_adv_start(inst_id);
+    if (rc != 0 && rc != BLE_HS_EALREADY) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_start rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // startPeriodic
+
+
+/**
+ * @brief Stop periodic advertising on an instance.
+ * @param [in] inst_id The extended advertisement instance ID.
+ * @return True if successful.
+ */
+bool NimBLEExtAdvertising::stopPeriodic(uint8_t inst_id) {
+    int rc = ble_gap_periodic_adv_stop(inst_id);
+    if (rc != 0 && rc != BLE_HS_EALREADY) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_stop rc = %d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // stopPeriodic
+#endif
+
+
+/**
+ * @brief Add an advertisement to be rotated onto the instances by the scheduler.
+ * @param [in] adv The advertisement, it is copied.
+ * @param [in] slotMs How long the advertisement stays on an instance each time it is chosen.
+ * @param [in] weight How often the advertisement is chosen relative to the others, 1 or more.
+ * @return An ID to remove the advertisement with or -1 if the scheduler is running.
+ * @details Advertisements can only be added and removed while the scheduler is stopped.
+ */
+int NimBLEExtAdvertising::addScheduled(const NimBLEExtAdvertisement& adv, uint32_t slotMs, uint8_t weight) {
+    if(m_schedRunning) {
+        NIMBLE_LOGE(LOG_TAG, "Stop the scheduler before adding advertisements");
+        return -1;
+    }
+
+    ext_adv_sched_t entry{adv, m_schedNextId++, slotMs > 0 ? slotMs : 1,
+                          (uint8_t)(weight > 0 ? weight : 1), 0, -1};
+    m_schedule.push_back(entry);
+    return entry.id;
+} // addScheduled
+
+
+/**
+ * @brief Remove an advertisement from the scheduler.
+ * @param [in] id The ID returned by addScheduled.
+ * @return True if the advertisement was removed, false if it was not found or the scheduler is running.
+ */
+bool NimBLEExtAdvertising::removeScheduled(int id) {
+    if(m_schedRunning) {
+        NIMBLE_LOGE(LOG_TAG, "Stop the scheduler before removing advertisements");
+        return false;
+    }
+
+    for(auto it = m_schedule.begin(); it != m_schedule.end(); ++it) {
+        if(it->id == id) {
+            m_schedule.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+} // removeScheduled
+
+
+/**
+ * @brief Start rotating the scheduled advertisements onto a range of instances.
+ * @param [in] firstInst The first instance the scheduler may use.
+ * @param [in] numInst The number of instances the scheduler may use, starting at firstInst.
+ * @return True if the scheduler was started.
+ * @details Each instance shows one advertisement at a time. When its slot ends the instance is given the
+ * advertisement not shown elsewhere with the most accumulated weight (smooth weighted round robin).
+ * An instance keeps its advertisement without any HCI commands if it is chosen again, and only the data
+ * is replaced if the new advertisement has the same parameters. If there are no more advertisements than
+ * instances nothing is rotated. The instances must not be used with setInstanceData, start or stop
+ * while the scheduler runs.
+ */
+bool NimBLEExtAdvertising::startScheduler(uint8_t firstInst, uint8_t numInst) {
+    if(m_schedRunning) {
+        return true;
+    }
+
+    if(!NimBLEDevice::m_synced) {
+        NIMBLE_LOGE(LOG_TAG, "Host reset, wait for sync.");
+        return false;
+    }
+
+    if(numInst == 0 || firstInst + numInst > CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES || m_schedule.empty()) {
+        NIMBLE_LOGE(LOG_TAG, "Invalid scheduler instances or no advertisements");
+        return false;
+    }
+
+    if(!m_schedTimerInit) {
+        ble_npl_callout_init(&m_schedTimer, nimble_port_get_dflt_eventq(), NimBLEExtAdvertising::schedTimerCb, this);
+        m_schedTimerInit = true;
+    }
+
+    for(auto &it : m_schedule) {
+        it.credit   = 0;
+        it.instance = -1;
+    }
+
+    m_schedFirst = firstInst;
+    m_schedCurrent.assign(std::min<size_t>(numInst, m_schedule.size()), -1);
+    m_schedExpires.assign(m_schedCurrent.size(), 0);
+    m_schedRunning = true;
+
+    // Fill the instances in the host task so rotation is serialized with the GAP events.
+    ble_npl_callout_reset(&m_schedTimer, 0);
+    return true;
+} // startScheduler
+
+
+/**
+ * @brief Stop the scheduler and the instances it is using.
+ */
+void NimBLEExtAdvertising::stopScheduler() {
+    if(!m_schedRunning) {
+        return;
+    }
+
+    m_schedRunning = false;
+    ble_npl_callout_stop(&m_schedTimer);
+
+    for(size_t i = 0; i < m_schedCurrent.size(); i++) {
+        if(m_schedCurrent[i] >= 0) {
+            stop(m_schedFirst + i);
+            m_schedule[m_schedCurrent[i]].instance = -1;
+            m_schedCurrent[i] = -1;
+        }
+    }
+} // stopScheduler
+
+
+/**
+ * @brief Give an instance the next advertisement when its slot ends.
+ * @param [in] inst_id The extended advertisement instance ID.
+ */
+void NimBLEExtAdvertising::schedRotate(uint8_t inst_id) {
+    size_t slot = inst_id - m_schedFirst;
+    int current = m_schedCurrent[slot];
+    int chosen = -1;
+    int total = 0;
+
+    for(size_t i = 0; i < m_schedule.size(); i++) {
+        ext_adv_sched_t &entry = m_schedule[i];
+        if(entry.instance >= 0 && (int)i != current) {
+            continue;
+        }
+
+        entry.credit += entry.weight;
+        total += entry.weight;
+        if(chosen < 0 || entry.credit > m_schedule[chosen].credit) {
+            chosen = i;
+        }
+    }
+
+    ext_adv_sched_t &next = m_schedule[chosen];
+    next.credit -= total;
+    m_schedExpires[slot] = ble_npl_time_get() + ble_npl_time_ms_to_ticks32(next.slotMs);
+
+    if(chosen == current) {
+        // Restart if it was stopped, e.g. by a connection.
+        if(!m_advStatus[inst_id]) {
+            start(inst_id);
+        }
+        return;
+    }
+
+    bool reconfigure = true;
+    if(current >= 0) {
+        ext_adv_sched_t &prev = m_schedule[current];
+        stop(inst_id);
+        prev.instance = -1;
+        next.adv.m_params.sid = inst_id;
+        reconfigure = memcmp(&prev.adv.m_params, &next.adv.m_params, sizeof(next.adv.m_params)) != 0;
+    }
+
+    bool rc = reconfigure ? setInstanceData(inst_id, next.adv) : setInstancePayload(inst_id, next.adv);
+    m_schedCurrent[slot] = chosen;
+    next.instance = inst_id;
+
+    if(!rc || !start(inst_id)) {
+        NIMBLE_LOGE(LOG_TAG, "Scheduler could not start instance %u", inst_id);
+    }
+} // schedRotate
+
+
+/**
+ * @brief Scheduler timer callback, rotates the instances whose slot has ended.
+ */
+void NimBLEExtAdvertising::schedTimerCb(ble_npl_event *event) {
+    NimBLEExtAdvertising* pAdv = (NimBLEExtAdvertising*)ble_npl_event_get_arg(event);
+    if(!pAdv->m_schedRunning) {
+        return;
+    }
+
+    ble_npl_time_t now = ble_npl_time_get();
+    bool rotates = pAdv->m_schedule.size() > pAdv->m_schedCurrent.size();
+    ble_npl_time_t wait = 0;
+    bool waitSet = false;
+
+    for(size_t i = 0; i < pAdv->m_schedCurrent.size(); i++) {
+        uint8_t inst_id = pAdv->m_schedFirst + i;
+        if(pAdv->m_schedCurrent[i] < 0 || (rotates && (ble_npl_stime_t)(now - pAdv->m_schedExpires[i]) >= 0)) {
+            pAdv->schedRotate(inst_id);
+        } else if(!rotates && !pAdv->m_advStatus[inst_id]) {
+            pAdv->start(inst_id);
+        }
+
+        ble_npl_time_t left = pAdv->m_schedExpires[i] - now;
+        if(!waitSet || left < wait) {
+            wait = left;
+            waitSet = true;
+        }
+    }
+
+    // With an advertisement per instance only check that they are still running.
+    if(!rotates) {
+        wait = ble_npl_time_ms_to_ticks32(1000);
+    }
+
+    ble_npl_callout_reset(&pAdv->m_schedTimer, wait);
+} // schedTimerCb
+
+
 /**
  * @brief Set a callback to call when the advertisement stops.
  * @param [in] pCallbacks A pointer to a callback to be invoked when an advertisement stops.
@@ -319,6 +774,7 @@ void NimBLEExtAdvertising::onHostSync() {
     for(auto it : m_advStatus) {
         it = false;
     }
+    NIMBLE_CPP_RADIO_ADV_STOP_ALL();
 } // onHostSync
 
 
@@ -348,6 +804,7 @@ int NimBLEExtAdvertising::handleGapEvent(struct ble_gap_event *event, void *arg)
                     break;
             }
             pAdv->m_advStatus[event->adv_complete.instance] = false;
+            NIMBLE_CPP_RADIO_ADV_STOP(event->adv_complete.instance);
             pAdv->m_pCallbacks->onStopped(pAdv, event->adv_complete.reason,
                                           event->adv_complete.instance);
             break;
@@ -601,6 +1058,15 @@ void NimBLEExtAdvertisement::setData(const uint8_t * data, size_t length) {
 } // setData
 
 
+/**
+ * @brief Set the advertisement data built with a NimBLEAdvertisementBuilder.
+ * @param [in] data The builder holding the payload, it is copied.
+ */
+void NimBLEExtAdvertisement::setData(const NimBLEAdvertisementBuilder &data) {
+    setData(data.getData(), data.getLength());
+} // setData
+
+
 /**
  * @brief Add data to the payload to be advertised.
  * @param [in] data The data to be added to the payload.
@@ -25,6 +25,7 @@
 
 #include "NimBLEAddress.h"
 #include "NimBLEUUID.h"
+#include "NimBLEAdvertisementBuilder.h"
 
 #include <vector>
 
@@ -52,6 +53,7 @@ public:
     void   setServiceData(const NimBLEUUID &uuid, const std::string &data);
     void   setShortName(const std::string &name);
     void   setData(const uint8_t * data, size_t length);
+    void   setData(const NimBLEAdvertisementBuilder &data);
     void   addData(const std::string &data);
     void   addData(const uint8_t * data, size_t length);
     void   addTxPower();
@@ -91,14 +93,27 @@ private:
  */
 class NimBLEExtAdvertising {
 public:
+    /**
+     * @brief A segment of an advertisement payload given in parts.
+     */
+    typedef struct {
+        const uint8_t* data;
+        size_t         length;
+    } ext_adv_segment_t;
+
     /**
      * @brief Construct an extended advertising object.
      */
-    NimBLEExtAdvertising() :m_advStatus(CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES + 1, false) {}
+    NimBLEExtAdvertising() :m_advStatus(CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES + 1, false),
+                            m_schedRunning(false), m_schedTimerInit(false), m_schedNextId(0) {}
     ~NimBLEExtAdvertising();
     bool start(uint8_t inst_id, int duration = 0, int max_events = 0);
     bool setInstanceData(uint8_t inst_id, NimBLEExtAdvertisement& adv);
     bool setScanResponseData(uint8_t inst_id, NimBLEExtAdvertisement & data);
+    bool setData(uint8_t inst_id, struct os_mbuf* data, bool scanResponse = false);
+    bool setData(uint8_t inst_id, const ext_adv_segment_t* segments, size_t count,
+                 bool scanResponse = false);
+    bool setFragmentPreference(uint8_t inst_id, bool noFragment);
     bool removeInstance(uint8_t inst_id);
     bool removeAll();
     bool stop(uint8_t inst_id);
@@ -107,6 +122,18 @@ public:
     bool isAdvertising();
     void setCallbacks(NimBLEExtAdvertisingCallbacks* callbacks,
                       bool deleteCallbacks = true);
+    int  addScheduled(const NimBLEExtAdvertisement& adv, uint32_t slotMs = 1000, uint8_t weight = 1);
+    bool removeScheduled(int id);
+    bool startScheduler(uint8_t firstInst = 0, uint8_t numInst = CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES);
+    void stopScheduler();
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+    bool setPeriodicParams(uint8_t inst_id, uint16_t minInterval, uint16_t maxInterval,
+                           bool includeTxPower = false);
+    bool setPeriodicData(uint8_t inst_id, const uint8_t* data, size_t length);
+    bool setPeriodicData(uint8_t inst_id, NimBLEExtAdvertisement& adv);
+    bool startPeriodic(uint8_t inst_id);
+    bool stopPeriodic(uint8_t inst_id);
+#endif
 
 private:
     friend class NimBLEDevice;
@@ -114,12 +141,35 @@ private:
 
     void           onHostSync();
     static int     handleGapEvent(struct ble_gap_event *event, void *arg);
+    bool           setInstancePayload(uint8_t inst_id, NimBLEExtAdvertisement& adv);
+    void           schedRotate(uint8_t inst_id);
+    static void    schedTimerCb(ble_npl_event *event);
+
+    /**
+     * @brief An advertisement rotated onto the instances by the scheduler.
+     */
+    typedef struct {
+        NimBLEExtAdvertisement adv;
+        int                    id;
+        uint32_t               slotMs;
+        uint8_t                weight;
+        int                    credit;
+        int                    instance;
+    } ext_adv_sched_t;
 
     bool                            m_scanResp;
     bool                            m_deleteCallbacks;
     NimBLEExtAdvertisingCallbacks*  m_pCallbacks;
     ble_gap_ext_adv_params          m_advParams;
     std::vector<bool>               m_advStatus;
+    std::vector<ext_adv_sched_t>    m_schedule;
+    std::vector<int>                m_schedCurrent;
+    std::vector<ble_npl_time_t>     m_schedExpires;
+    uint8_t                         m_schedFirst;
+    bool                            m_schedRunning;
+    bool                            m_schedTimerInit;
+    int                             m_schedNextId;
+    ble_npl_callout                 m_schedTimer;
 };
 
 
@@ -17,6 +17,8 @@
 
 #include "NimBLEHIDDevice.h"
 #include "NimBLE2904.h"
+#include "NimBLEHIDReportSender.h"
+#include "NimBLEHIDTypingQueue.h"
 
 /**
  * @brief Construct a default NimBLEHIDDevice object.
@@ -61,6 +63,12 @@ NimBLEHIDDevice::NimBLEHIDDevice(NimBLEServer* server) {
 }
 
 NimBLEHIDDevice::~NimBLEHIDDevice() {
+	for (auto &it : m_reportSenders) {
+		delete it;
+	}
+	for (auto &it : m_typingQueues) {
+		delete it;
+	}
 }
 
 /**
@@ -72,6 +80,15 @@ void NimBLEHIDDevice::reportMap(uint8_t* map, uint16_t size) {
 	m_reportMapCharacteristic->setValue(map, size);
 }
 
+/**
+ * @brief Set the report map from constant data that is served to reads without a copy in RAM.
+ * @param [in] map A pointer to the report map, it must remain valid, such as a const array.
+ * @param [in] size The size of the report map.
+ */
+void NimBLEHIDDevice::staticReportMap(const uint8_t* map, uint16_t size) {
+	m_reportMapCharacteristic->setStaticValue(map, size);
+}
+
 /**
  * @brief Start the HID device services.\n
  * This function called when all the services have been created.
@@ -135,6 +152,31 @@ NimBLECharacteristic* NimBLEHIDDevice::inputReport(uint8_t reportID) {
 	return inputReportCharacteristic;
 }
 
+/**
+ * @brief Create input report characteristic with a low latency report sender, see NimBLEHIDReportSender.
+ * @param [in] reportID input report ID, the same as in report map for input object related to the characteristic
+ * @param [in] maxInterval The highest connection interval in 1.25ms units accepted without requesting
+ * the shortest interval, 0 to never request it.
+ * @return pointer to the report sender, owned by this HID device
+ */
+NimBLEHIDReportSender* NimBLEHIDDevice::inputReportSender(uint8_t reportID, uint16_t maxInterval) {
+	NimBLEHIDReportSender* sender = new NimBLEHIDReportSender(inputReport(reportID), maxInterval);
+	m_reportSenders.push_back(sender);
+	return sender;
+}
+
+/**
+ * @brief Create a queue to type keystrokes through a keyboard input report, see NimBLEHIDTypingQueue.
+ * @param [in] keyboardReport The keyboard input report characteristic, its callbacks are replaced by the queue.
+ * @param [in] size The maximum number of keys queued.
+ * @return pointer to the typing queue, owned by this HID device
+ */
+NimBLEHIDTypingQueue* NimBLEHIDDevice::typingQueue(NimBLECharacteristic* keyboardReport, size_t size) {
+	NimBLEHIDTypingQueue* queue = new NimBLEHIDTypingQueue(keyboardReport, size);
+	m_typingQueues.push_back(queue);
+	return queue;
+}
+
 /**
  * @brief Create output report characteristic
  * @param [in] reportID Output report ID, the same as in report map for output object related to the characteristic
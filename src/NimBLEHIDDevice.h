@@ -23,6 +23,8 @@
 #include "NimBLEDescriptor.h"
 #include "HIDTypes.h"
 
+#include <vector>
+
 #define GENERIC_HID		0x03C0
 #define HID_KEYBOARD	   0x03C1
 #define HID_MOUSE		  0x03C2
@@ -33,6 +35,8 @@
 #define HID_DIGITAL_PEN	0x03C7
 #define HID_BARCODE		0x03C8
 
+class NimBLEHIDReportSender;
+class NimBLEHIDTypingQueue;
 
 /**
  * @brief A model of a %BLE Human Interface Device.
@@ -43,6 +47,7 @@ public:
 	virtual ~NimBLEHIDDevice();
 
 	void reportMap(uint8_t* map, uint16_t);
+	void staticReportMap(const uint8_t* map, uint16_t);
 	void startServices();
 
 	NimBLEService* deviceInfo();
@@ -62,6 +67,8 @@ public:
 	//NimBLECharacteristic* 	reportMap();
 	NimBLECharacteristic* 	hidControl();
 	NimBLECharacteristic* 	inputReport(uint8_t reportID);
+	NimBLEHIDReportSender*	inputReportSender(uint8_t reportID, uint16_t maxInterval = 8);
+	NimBLEHIDTypingQueue*	typingQueue(NimBLECharacteristic* keyboardReport, size_t size = 64);
 	NimBLECharacteristic* 	outputReport(uint8_t reportID);
 	NimBLECharacteristic* 	featureReport(uint8_t reportID);
 	NimBLECharacteristic* 	protocolMode();
@@ -80,6 +87,8 @@ private:
 	NimBLECharacteristic* 	m_hidControlCharacteristic;		//0x2a4c
 	NimBLECharacteristic* 	m_protocolModeCharacteristic;	//0x2a4e
 	NimBLECharacteristic*	m_batteryLevelCharacteristic;	//0x2a19
+	std::vector<NimBLEHIDReportSender*> m_reportSenders;
+	std::vector<NimBLEHIDTypingQueue*>  m_typingQueues;
 };
 
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_BROADCASTER */
@@ -0,0 +1,311 @@
+/*
+ * NimBLEHIDReportSender.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEHIDReportSender.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+#define NIMBLE_SUB_NOTIFY   0x0001
+
+static const char* LOG_TAG = "NimBLEHIDReportSender";
+
+
+/**
+ * @brief Construct a report sender for an input report characteristic.
+ * @param [in] pReport A pointer to the input report characteristic, see NimBLEHIDDevice::inputReport.
+ * @param [in] maxInterval The highest connection interval in 1.25ms units accepted without requesting
+ * the shortest interval, 0 to never request it.
+ */
+NimBLEHIDReportSender::NimBLEHIDReportSender(NimBLECharacteristic* pReport, uint16_t maxInterval)
+: m_pReport(pReport),
+  m_maxInterval(maxInterval),
+  m_spare(nullptr),
+  m_pending(nullptr),
+  m_lastTx(0),
+  m_itvlTicks(0),
+  m_coalesced(0),
+  m_dropped(0)
+{
+    for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        m_requested[i] = BLE_HS_CONN_HANDLE_NONE;
+    }
+    ble_npl_callout_init(&m_flushTimer, nimble_port_get_dflt_eventq(), NimBLEHIDReportSender::flushCb, this);
+} // NimBLEHIDReportSender
+
+
+NimBLEHIDReportSender::~NimBLEHIDReportSender() {
+    ble_npl_callout_stop(&m_flushTimer);
+    ble_npl_callout_deinit(&m_flushTimer);
+
+    if(m_pending != nullptr) {
+        os_mbuf_free_chain(m_pending);
+    }
+    if(m_spare != nullptr) {
+        os_mbuf_free_chain(m_spare);
+    }
+} // ~NimBLEHIDReportSender
+
+
+/**
+ * @brief Send a report to the subscribed hosts, or replace the report waiting for the connection interval to end.
+ * @param [in] data A pointer to the report data, without the report ID.
+ * @param [in] length The length of the report.
+ * @return True if the report was sent or is waiting to be sent, false if no host is subscribed or no mbuf was available.
+ */
+bool NimBLEHIDReportSender::send(const uint8_t* data, size_t length) {
+    if(m_pReport->getSubscribedCount() == 0) {
+        return false;
+    }
+
+    // A report of the same length replaces the waiting one in place.
+    ble_npl_hw_enter_critical();
+    if(m_pending != nullptr && OS_MBUF_PKTLEN(m_pending) == length) {
+        os_mbuf_copyinto(m_pending, 0, data, length);
+        m_coalesced++;
+        ble_npl_hw_exit_critical(0);
+        return true;
+    }
+    struct os_mbuf* om = m_spare;
+    m_spare = nullptr;
+    ble_npl_hw_exit_critical(0);
+
+    if(om == nullptr) {
+        om = ble_hs_mbuf_att_pkt();
+    }
+    if(om == nullptr || os_mbuf_append(om, data, length) != 0) {
+        if(om != nullptr) {
+            os_mbuf_free_chain(om);
+        }
+        NIMBLE_LOGE(LOG_TAG, "send: Out of mbufs, report dropped");
+        m_dropped++;
+        return false;
+    }
+
+    ble_npl_time_t now = ble_npl_time_get();
+    ble_npl_time_t elapsed = now - m_lastTx;
+    struct os_mbuf* replaced = nullptr;
+
+    ble_npl_hw_enter_critical();
+    bool sendNow = m_pending == nullptr && elapsed >= m_itvlTicks;
+    if(!sendNow) {
+        replaced = m_pending;
+        m_pending = om;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(sendNow) {
+        bool sent = transmit(om);
+        fillSpare();
+        return sent;
+    }
+
+    if(replaced != nullptr) {
+        os_mbuf_free_chain(replaced);
+        m_coalesced++;
+    }
+
+    if(!ble_npl_callout_is_active(&m_flushTimer)) {
+        ble_npl_callout_reset(&m_flushTimer, elapsed < m_itvlTicks ? m_itvlTicks - elapsed : 1);
+    }
+    return true;
+} // send
+
+
+/**
+ * @brief Send the report waiting when the connection interval ends.
+ */
+void NimBLEHIDReportSender::flushCb(struct ble_npl_event *event) {
+    NimBLEHIDReportSender* pSender = (NimBLEHIDReportSender*)ble_npl_event_get_arg(event);
+
+    ble_npl_hw_enter_critical();
+    struct os_mbuf* om = pSender->m_pending;
+    pSender->m_pending = nullptr;
+    ble_npl_hw_exit_critical(0);
+
+    if(om != nullptr) {
+        pSender->transmit(om);
+    }
+    pSender->fillSpare();
+} // flushCb
+
+
+/**
+ * @brief Notify the subscribed hosts of a report.
+ * @param [in] om The mbuf holding the report, it is consumed.
+ * @return True if the report was sent to at least one host.
+ */
+bool NimBLEHIDReportSender::transmit(struct os_mbuf* om) {
+    bool reqSec = m_pReport->getProperties() & (BLE_GATT_CHR_F_READ_AUTHEN |
+                                                BLE_GATT_CHR_F_READ_AUTHOR |
+                                                BLE_GATT_CHR_F_READ_ENC);
+    uint16_t targets[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t numTargets = 0;
+    ble_npl_time_t itvlTicks = 0;
+
+    // Forget the requests for hosts that are gone so a reconnecting host is asked again.
+    for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        if(m_requested[i] == BLE_HS_CONN_HANDLE_NONE) {
+            continue;
+        }
+        uint8_t j = 0;
+        for(; j < m_pReport->m_subscribedCount; j++) {
+            if(m_pReport->m_subscribed[j].first == m_requested[i]) {
+                break;
+            }
+        }
+        if(j == m_pReport->m_subscribedCount) {
+            m_requested[i] = BLE_HS_CONN_HANDLE_NONE;
+        }
+    }
+
+    for(uint8_t i = 0; i < m_pReport->m_subscribedCount; i++) {
+        const std::pair<uint16_t, uint16_t> &it = m_pReport->m_subscribed[i];
+        if(!(it.second & NIMBLE_SUB_NOTIFY)) {
+            continue;
+        }
+
+        ble_gap_conn_desc desc;
+        if(ble_gap_conn_find(it.first, &desc) != 0 || (reqSec && !desc.sec_state.encrypted)) {
+            continue;
+        }
+
+        requestInterval(it.first, desc);
+
+        ble_npl_time_t ticks = ble_npl_time_ms_to_ticks32(desc.conn_itvl * 5 / 4);
+        if(itvlTicks == 0 || ticks < itvlTicks) {
+            itvlTicks = ticks;
+        }
+        targets[numTargets++] = it.first;
+    }
+
+    m_itvlTicks = itvlTicks;
+    m_lastTx = ble_npl_time_get();
+
+    if(numTargets == 0) {
+        os_mbuf_free_chain(om);
+        return false;
+    }
+
+    // Every host but the last is sent a duplicate as each host call consumes its mbuf chain.
+    NIMBLE_CPP_CONN_STATS_MARK(length, om);
+    bool sent = false;
+    ble_hs_mbuf_set_tx_prio(om, m_pReport->getTxPriority());
+    for(size_t i = 0; i < numTargets; i++) {
+        struct os_mbuf* txom = (i + 1 == numTargets) ? om : os_mbuf_dup(om);
+        if(txom == nullptr) {
+            NIMBLE_CPP_CONN_STATS_ADD(targets[i], mbufAllocFailures, 1);
+            m_dropped++;
+            continue;
+        }
+
+        if(ble_gattc_notify_custom(targets[i], m_pReport->getHandle(), txom) != 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(targets[i], txFailures, 1);
+            m_dropped++;
+            continue;
+        }
+
+        NIMBLE_CPP_CONN_STATS_ADD(targets[i], notifyTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(targets[i], notifyTxBytes, length);
+        sent = true;
+    }
+
+    return sent;
+} // transmit
+
+
+/**
+ * @brief Request the shortest connection interval once if the host connected with an interval above the maximum.
+ * @param [in] connHandle The connection handle of the host.
+ * @param [in] desc The connection description of the host.
+ */
+void NimBLEHIDReportSender::requestInterval(uint16_t connHandle, const ble_gap_conn_desc &desc) {
+    if(m_maxInterval == 0 || desc.conn_itvl <= m_maxInterval) {
+        return;
+    }
+
+    int freeSlot = -1;
+    for(int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        if(m_requested[i] == connHandle) {
+            return;
+        }
+        if(freeSlot < 0 && m_requested[i] == BLE_HS_CONN_HANDLE_NONE) {
+            freeSlot = i;
+        }
+    }
+
+    if(freeSlot < 0) {
+        return;
+    }
+
+    m_requested[freeSlot] = connHandle;
+    NIMBLE_LOGD(LOG_TAG, "Requesting interval %u-%u for conn_handle=%d, current %u",
+                BLE_HCI_CONN_ITVL_MIN, m_maxInterval, connHandle, desc.conn_itvl);
+    NimBLEDevice::getServer()->updateConnParams(connHandle, BLE_HCI_CONN_ITVL_MIN, m_maxInterval,
+                                                0, desc.supervision_timeout);
+} // requestInterval
+
+
+/**
+ * @brief Allocate the mbuf for the next report ahead of time, off the latency path.
+ */
+void NimBLEHIDReportSender::fillSpare() {
+    if(m_spare != nullptr) {
+        return;
+    }
+
+    struct os_mbuf* om = ble_hs_mbuf_att_pkt();
+    if(om == nullptr) {
+        return;
+    }
+
+    ble_npl_hw_enter_critical();
+    if(m_spare == nullptr) {
+        m_spare = om;
+        om = nullptr;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(om != nullptr) {
+        os_mbuf_free_chain(om);
+    }
+} // fillSpare
+
+
+/**
+ * @brief Get the input report characteristic the reports are sent with.
+ */
+NimBLECharacteristic* NimBLEHIDReportSender::getCharacteristic() {
+    return m_pReport;
+} // getCharacteristic
+
+
+/**
+ * @brief Get the number of reports that were replaced by a newer report before they were sent.
+ */
+uint32_t NimBLEHIDReportSender::getCoalescedCount() {
+    return m_coalesced;
+} // getCoalescedCount
+
+
+/**
+ * @brief Get the number of reports that could not be sent to a host, from a lack of mbufs or a host error.
+ */
+uint32_t NimBLEHIDReportSender::getDroppedCount() {
+    return m_dropped;
+} // getDroppedCount
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
@@ -0,0 +1,68 @@
+/*
+ * NimBLEHIDReportSender.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEHIDREPORTSENDER_H_
+#define NIMBLEHIDREPORTSENDER_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include "NimBLECharacteristic.h"
+
+/**
+ * @brief Sends the reports of a HID input report characteristic to the subscribed hosts with low latency.
+ * @details The report is copied once, straight into an mbuf allocated ahead of time, and sent as a
+ * notification without going through the characteristic value. At most one report is sent per connection
+ * interval, a report sent before the interval has passed replaces the one waiting, which is sent
+ * when the interval ends. This suits reports that carry the whole input state, like a gamepad,
+ * key presses and releases must not be replaced and should be sent with NimBLECharacteristic::notify.\n
+ * When a host connects with an interval above maxInterval the shortest interval is requested once.
+ */
+class NimBLEHIDReportSender {
+public:
+    NimBLEHIDReportSender(NimBLECharacteristic* pReport, uint16_t maxInterval = 8);
+    ~NimBLEHIDReportSender();
+
+    bool                  send(const uint8_t* data, size_t length);
+    NimBLECharacteristic* getCharacteristic();
+    uint32_t              getCoalescedCount();
+    uint32_t              getDroppedCount();
+
+private:
+    static void           flushCb(struct ble_npl_event *event);
+    bool                  transmit(struct os_mbuf* om);
+    void                  requestInterval(uint16_t connHandle, const ble_gap_conn_desc &desc);
+    void                  fillSpare();
+
+    NimBLECharacteristic* m_pReport;
+    uint16_t              m_maxInterval;
+    struct os_mbuf*       m_spare;
+    struct os_mbuf*       m_pending;
+    ble_npl_time_t        m_lastTx;
+    ble_npl_time_t        m_itvlTicks;
+    ble_npl_callout       m_flushTimer;
+    uint32_t              m_coalesced;
+    uint32_t              m_dropped;
+
+    // The connections the interval was requested for, cleared when the host unsubscribes or disconnects.
+    uint16_t              m_requested[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+}; // NimBLEHIDReportSender
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLEHIDREPORTSENDER_H_ */
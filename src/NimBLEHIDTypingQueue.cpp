@@ -0,0 +1,219 @@
+/*
+ * NimBLEHIDTypingQueue.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLEHIDTypingQueue.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+#include "HIDKeyboardTypes.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+#include <string.h>
+
+// Time to wait for the notification complete event of a report before sending it again.
+#define NIMBLE_CPP_HID_TYPING_RETRY_MS 100
+
+static const char* LOG_TAG = "NimBLEHIDTypingQueue";
+
+
+/**
+ * @brief Construct a typing queue for a keyboard input report characteristic.
+ * @param [in] pReport A pointer to the keyboard input report characteristic, see NimBLEHIDDevice::inputReport.
+ * @param [in] size The maximum number of keys queued.
+ */
+NimBLEHIDTypingQueue::NimBLEHIDTypingQueue(NimBLECharacteristic* pReport, size_t size)
+: m_pReport(pReport),
+  m_keys(size > 0 ? size : 1),
+  m_head(0),
+  m_count(0),
+  m_busy(false),
+  m_waiting(false)
+{
+    memset(m_report, 0, sizeof(m_report));
+    ble_npl_callout_init(&m_typingTimer, nimble_port_get_dflt_eventq(),
+                         NimBLEHIDTypingQueue::typingTimerCb, this);
+    m_pReport->setCallbacks(this);
+} // NimBLEHIDTypingQueue
+
+
+NimBLEHIDTypingQueue::~NimBLEHIDTypingQueue() {
+    ble_npl_callout_stop(&m_typingTimer);
+    ble_npl_callout_deinit(&m_typingTimer);
+
+    if(m_pReport->getCallbacks() == this) {
+        m_pReport->setCallbacks(nullptr);
+    }
+} // ~NimBLEHIDTypingQueue
+
+
+/**
+ * @brief Queue the keys to type a string.
+ * @param [in] text The null terminated string to type, characters without a key in the keymap are skipped.
+ * @return The number of characters handled, less than the length of the text if the queue is full.
+ */
+size_t NimBLEHIDTypingQueue::type(const char* text) {
+    size_t queued = 0;
+
+    for(const char* c = text; *c != '\0'; c++) {
+        uint8_t idx = (uint8_t)*c;
+        if(idx >= KEYMAP_SIZE || keymap[idx].usage == 0) {
+            queued++;
+            continue;
+        }
+
+        if(!push(keymap[idx].usage, keymap[idx].modifier)) {
+            NIMBLE_LOGW(LOG_TAG, "Typing queue full, %d characters not queued", strlen(c));
+            break;
+        }
+        queued++;
+    }
+
+    return queued;
+} // type
+
+
+/**
+ * @brief Queue a key press and release.
+ * @param [in] usage The HID key usage.
+ * @param [in] modifier The modifier keys held with the key, MODIFIER_KEY values.
+ * @return True if the key was queued, false if the usage is 0 or the queue is full.
+ */
+bool NimBLEHIDTypingQueue::typeKey(uint8_t usage, uint8_t modifier) {
+    if(usage == 0) {
+        return false;
+    }
+    return push(usage, modifier);
+} // typeKey
+
+
+/**
+ * @brief Add a key to the queue and start typing if idle.
+ */
+bool NimBLEHIDTypingQueue::push(uint8_t usage, uint8_t modifier) {
+    bool start = false;
+
+    ble_npl_hw_enter_critical();
+    if(m_count == m_keys.size()) {
+        ble_npl_hw_exit_critical(0);
+        return false;
+    }
+
+    m_keys[(m_head + m_count) % m_keys.size()] = (modifier << 8) | usage;
+    m_count++;
+    if(!m_busy) {
+        m_busy = true;
+        start = true;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    // The reports are sent from the host task.
+    if(start) {
+        ble_npl_callout_reset(&m_typingTimer, 1);
+    }
+    return true;
+} // push
+
+
+/**
+ * @brief Get the number of keys waiting to be typed.
+ */
+size_t NimBLEHIDTypingQueue::getCount() {
+    return m_count;
+} // getCount
+
+
+/**
+ * @brief Remove the keys waiting to be typed, a key being typed is still released.
+ */
+void NimBLEHIDTypingQueue::clear() {
+    ble_npl_hw_enter_critical();
+    m_count = 0;
+    ble_npl_hw_exit_critical(0);
+} // clear
+
+
+/**
+ * @brief Send the next report when the timer expires.
+ */
+void NimBLEHIDTypingQueue::typingTimerCb(struct ble_npl_event *event) {
+    NimBLEHIDTypingQueue* pQueue = (NimBLEHIDTypingQueue*)ble_npl_event_get_arg(event);
+    pQueue->sendNext();
+} // typingTimerCb
+
+
+/**
+ * @brief Send the release of the key pressed, the press of the next key, or the last report again
+ * if it was not completed.
+ */
+void NimBLEHIDTypingQueue::sendNext() {
+    if(m_waiting) {
+        NIMBLE_LOGD(LOG_TAG, "Report not completed, sending again");
+    } else if(m_report[2] != 0) {
+        memset(m_report, 0, sizeof(m_report));
+    } else {
+        ble_npl_hw_enter_critical();
+        if(m_count == 0) {
+            m_busy = false;
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+        uint16_t key = m_keys[m_head];
+        m_head = (m_head + 1) % m_keys.size();
+        m_count--;
+        ble_npl_hw_exit_critical(0);
+
+        m_report[0] = key >> 8;
+        m_report[2] = key & 0xFF;
+    }
+
+    // Armed before sending as the complete event can be called before notify returns.
+    m_waiting = true;
+    ble_npl_callout_reset(&m_typingTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_HID_TYPING_RETRY_MS));
+    m_pReport->notify(m_report, sizeof(m_report));
+} // sendNext
+
+
+/**
+ * @brief Get the shortest connection interval of the connected hosts in ticks.
+ */
+ble_npl_time_t NimBLEHIDTypingQueue::getIntervalTicks() {
+    NimBLEServer* pServer = NimBLEDevice::getServer();
+    uint16_t itvl = 0;
+
+    for(size_t i = 0; i < pServer->getConnectedCount(); i++) {
+        uint16_t connItvl = pServer->getPeerInfo(i).getConnInterval();
+        if(connItvl > 0 && (itvl == 0 || connItvl < itvl)) {
+            itvl = connItvl;
+        }
+    }
+
+    ble_npl_time_t ticks = ble_npl_time_ms_to_ticks32(itvl * 5 / 4);
+    return ticks > 0 ? ticks : 1;
+} // getIntervalTicks
+
+
+/**
+ * @brief Pace the next report one connection interval after the notification of the last one completed.
+ */
+void NimBLEHIDTypingQueue::onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) {
+    if(s != Status::SUCCESS_NOTIFY || !m_waiting) {
+        return;
+    }
+
+    m_waiting = false;
+    ble_npl_callout_reset(&m_typingTimer, getIntervalTicks());
+} // onStatus
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
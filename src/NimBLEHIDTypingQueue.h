@@ -0,0 +1,58 @@
+/*
+ * NimBLEHIDTypingQueue.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEHIDTYPINGQUEUE_H_
+#define NIMBLEHIDTYPINGQUEUE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLECharacteristic.h"
+
+#include <vector>
+
+/**
+ * @brief Types queued keystrokes through a keyboard input report, one press and one release report per key.
+ * @details The reports use the 8 byte boot keyboard format: modifiers, reserved and six key usages.
+ * Characters are mapped to key usages with the keymap of HIDKeyboardTypes.h, define US_KEYBOARD
+ * in the build flags for the US layout.\n
+ * The next report is sent one connection interval after the notification complete event of the
+ * previous one, so a report is not sent before the link has taken the last one. A report without a
+ * complete event within the retry time, from a lack of buffers or a host reconnecting, is sent again.
+ * The queue handles the status callbacks of the report characteristic, it replaces its callbacks.
+ */
+class NimBLEHIDTypingQueue : public NimBLECharacteristicCallbacks {
+public:
+    NimBLEHIDTypingQueue(NimBLECharacteristic* pReport, size_t size = 64);
+    ~NimBLEHIDTypingQueue();
+
+    size_t                type(const char* text);
+    bool                  typeKey(uint8_t usage, uint8_t modifier = 0);
+    size_t                getCount();
+    void                  clear();
+    void                  onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) override;
+
+private:
+    static void           typingTimerCb(struct ble_npl_event *event);
+    bool                  push(uint8_t usage, uint8_t modifier);
+    void                  sendNext();
+    ble_npl_time_t        getIntervalTicks();
+
+    NimBLECharacteristic* m_pReport;
+    // The modifier in the high byte and usage in the low byte of each key, m_count from m_head are queued.
+    std::vector<uint16_t> m_keys;
+    size_t                m_head;
+    size_t                m_count;
+    uint8_t               m_report[8];
+    bool                  m_busy;
+    bool                  m_waiting;
+    ble_npl_callout       m_typingTimer;
+}; // NimBLEHIDTypingQueue
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLEHIDTYPINGQUEUE_H_ */
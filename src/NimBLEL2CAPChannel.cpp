@@ -0,0 +1,475 @@
+/*
+ * NimBLEL2CAPChannel.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+
+#include "NimBLEL2CAPChannel.h"
+#include "NimBLEL2CAPServer.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#include <algorithm>
+
+static const char* LOG_TAG = "NimBLEL2CAPChannel";
+static NimBLEL2CAPChannelCallbacks defaultCallbacks;
+
+#if CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT > 0
+/* Each block holds one LE frame, the host appends frames to the SDU chain from the pool of the first mbuf. */
+#define L2CAP_RX_BLOCK_SIZE OS_ALIGN(MYNEWT_VAL(BLE_L2CAP_COC_MPS) + sizeof(struct os_mbuf) + \
+                                     sizeof(struct os_mbuf_pkthdr), OS_ALIGNMENT)
+
+static os_membuf_t l2capRxPoolMem[OS_MEMPOOL_SIZE(CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT, L2CAP_RX_BLOCK_SIZE)];
+static struct os_mempool l2capRxPool;
+static struct os_mbuf_pool l2capRxMbufPool;
+static bool l2capRxPoolInit = false;
+#endif
+
+
+/**
+ * @brief Construct a channel that is not connected.
+ * @param [in] psm The PSM of the channel.
+ * @param [in] mtu The largest SDU this device can receive.
+ * @param [in] pCallbacks The callbacks for the channel events, nullptr to use the defaults.
+ */
+NimBLEL2CAPChannel::NimBLEL2CAPChannel(uint16_t psm, uint16_t mtu, NimBLEL2CAPChannelCallbacks* pCallbacks) {
+    m_pChan      = nullptr;
+    m_pServer    = nullptr;
+    m_pCallbacks = pCallbacks != nullptr ? pCallbacks : &defaultCallbacks;
+    m_connHandle = BLE_HS_CONN_HANDLE_NONE;
+    m_psm        = psm;
+    m_mtu        = mtu;
+    m_peerMTU    = 0;
+    m_connecting = false;
+    m_chanFreed  = false;
+    m_txBusy     = false;
+    STAILQ_INIT(&m_txQueue);
+} // NimBLEL2CAPChannel
+
+
+NimBLEL2CAPChannel::~NimBLEL2CAPChannel() {
+    struct os_mbuf_pkthdr *hdr;
+
+    while((hdr = STAILQ_FIRST(&m_txQueue)) != nullptr) {
+        STAILQ_REMOVE_HEAD(&m_txQueue, omp_next);
+        os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(hdr));
+    }
+} // ~NimBLEL2CAPChannel
+
+
+/**
+ * @brief Open a channel to a peer.
+ * @param [in] connHandle The connection handle of the peer.
+ * @param [in] psm The PSM the peer listens on.
+ * @param [in] mtu The largest SDU this device can receive.
+ * @param [in] pCallbacks The callbacks for the channel events, nullptr to use the defaults.
+ * @return A pointer to the channel or nullptr if the request could not be sent.
+ * @details NimBLEL2CAPChannelCallbacks::onConnect is called when the peer accepts the channel,
+ * NimBLEL2CAPChannelCallbacks::onDisconnect if it is rejected.
+ */
+NimBLEL2CAPChannel* NimBLEL2CAPChannel::connect(uint16_t connHandle, uint16_t psm, uint16_t mtu,
+                                                NimBLEL2CAPChannelCallbacks* pCallbacks)
+{
+    NimBLEL2CAPChannel* pChannel = new NimBLEL2CAPChannel(psm, mtu, pCallbacks);
+    pChannel->m_connHandle = connHandle;
+
+    struct os_mbuf *sdu = allocRxBuffer(mtu);
+    if(sdu == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to allocate a receive buffer");
+        delete pChannel;
+        return nullptr;
+    }
+
+    // The host frees the buffer and sends a disconnect event if it fails after creating the channel.
+    pChannel->m_connecting = true;
+    int rc = ble_l2cap_connect(connHandle, psm, mtu, sdu, NimBLEL2CAPChannel::handleL2CAPEvent, pChannel);
+    pChannel->m_connecting = false;
+
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_l2cap_connect: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        if(!pChannel->m_chanFreed) {
+            os_mbuf_free_chain(sdu);
+        }
+        delete pChannel;
+        return nullptr;
+    }
+
+    return pChannel;
+} // connect
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+/**
+ * @brief Open a channel to the peer of a client.
+ * @param [in] pClient A pointer to the connected client.
+ * @param [in] psm The PSM the peer listens on.
+ * @param [in] mtu The largest SDU this device can receive.
+ * @param [in] pCallbacks The callbacks for the channel events, nullptr to use the defaults.
+ * @return A pointer to the channel or nullptr if the request could not be sent.
+ */
+NimBLEL2CAPChannel* NimBLEL2CAPChannel::connect(NimBLEClient* pClient, uint16_t psm, uint16_t mtu,
+                                                NimBLEL2CAPChannelCallbacks* pCallbacks)
+{
+    return connect(pClient->getConnId(), psm, mtu, pCallbacks);
+} // connect
+#endif
+
+
+/**
+ * @brief Queue data to send to the peer.
+ * @param [in] data A pointer to the data to send.
+ * @param [in] length The length of the data.
+ * @return True if the data was queued, false if the channel is not connected or out of buffers.
+ * @details The data is split into SDU's of the peer MTU, the next SDU is sent when the
+ * previous one has been sent.
+ */
+bool NimBLEL2CAPChannel::write(const uint8_t* data, size_t length) {
+    if(m_pChan == nullptr || m_peerMTU == 0) {
+        NIMBLE_LOGE(LOG_TAG, "Channel not connected");
+        return false;
+    }
+
+    STAILQ_HEAD(, os_mbuf_pkthdr) sdus = STAILQ_HEAD_INITIALIZER(sdus);
+    size_t offset = 0;
+
+    while(offset < length) {
+        uint16_t len = std::min(length - offset, (size_t)m_peerMTU);
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(data + offset, len);
+        if(om == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to allocate SDU");
+            struct os_mbuf_pkthdr *hdr;
+            while((hdr = STAILQ_FIRST(&sdus)) != nullptr) {
+                STAILQ_REMOVE_HEAD(&sdus, omp_next);
+                os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(hdr));
+            }
+            return false;
+        }
+
+        STAILQ_INSERT_TAIL(&sdus, OS_MBUF_PKTHDR(om), omp_next);
+        offset += len;
+    }
+
+    ble_npl_hw_enter_critical();
+    STAILQ_CONCAT(&m_txQueue, &sdus);
+    ble_npl_hw_exit_critical(0);
+
+    startTx();
+    return true;
+} // write
+
+
+/**
+ * @brief Start sending the queued SDU's if no other task is sending them.
+ */
+void NimBLEL2CAPChannel::startTx() {
+    ble_npl_hw_enter_critical();
+    if(m_txBusy) {
+        ble_npl_hw_exit_critical(0);
+        return;
+    }
+    m_txBusy = true;
+    ble_npl_hw_exit_critical(0);
+
+    continueTx(false);
+} // startTx
+
+
+/**
+ * @brief Send queued SDU's until the queue is empty or the peer runs out of credits.
+ * @param [in] sent True if an SDU has completed since the queue was last empty.
+ * @details Only called by the task that set m_txBusy, a stalled SDU is continued by the host
+ * and this is called again from the unstalled event.
+ */
+void NimBLEL2CAPChannel::continueTx(bool sent) {
+    for(;;) {
+        ble_npl_hw_enter_critical();
+        struct os_mbuf_pkthdr *hdr = STAILQ_FIRST(&m_txQueue);
+        if(hdr == nullptr) {
+            m_txBusy = false;
+            ble_npl_hw_exit_critical(0);
+            break;
+        }
+        STAILQ_REMOVE_HEAD(&m_txQueue, omp_next);
+        ble_npl_hw_exit_critical(0);
+
+        struct os_mbuf *om = OS_MBUF_PKTHDR_TO_MBUF(hdr);
+        int rc = m_pChan != nullptr ? ble_l2cap_send(m_pChan, om) : BLE_HS_ENOTCONN;
+        if(rc == 0) {
+            sent = true;
+            continue;
+        }
+
+        if(rc == BLE_HS_ESTALLED) {
+            return;
+        }
+
+        // The host does not take the SDU for these errors.
+        if(rc == BLE_HS_ENOTCONN || rc == BLE_HS_EBADDATA || rc == BLE_HS_EBUSY) {
+            os_mbuf_free_chain(om);
+        }
+
+        NIMBLE_LOGE(LOG_TAG, "ble_l2cap_send: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        flushTx(rc);
+        return;
+    }
+
+    if(sent) {
+        m_pCallbacks->onWriteComplete(this, 0);
+    }
+} // continueTx
+
+
+/**
+ * @brief Discard the queued SDU's and report the status if a write was in progress.
+ * @param [in] status The status to report to NimBLEL2CAPChannelCallbacks::onWriteComplete.
+ */
+void NimBLEL2CAPChannel::flushTx(int status) {
+    ble_npl_hw_enter_critical();
+    STAILQ_HEAD(, os_mbuf_pkthdr) sdus = STAILQ_HEAD_INITIALIZER(sdus);
+    STAILQ_CONCAT(&sdus, &m_txQueue);
+    bool pending = m_txBusy || !STAILQ_EMPTY(&sdus);
+    m_txBusy = false;
+    ble_npl_hw_exit_critical(0);
+
+    struct os_mbuf_pkthdr *hdr;
+    while((hdr = STAILQ_FIRST(&sdus)) != nullptr) {
+        STAILQ_REMOVE_HEAD(&sdus, omp_next);
+        os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(hdr));
+    }
+
+    if(pending) {
+        m_pCallbacks->onWriteComplete(this, status);
+    }
+} // flushTx
+
+
+/**
+ * @brief Allocate the first mbuf of a receive buffer.
+ * @param [in] mtu The largest SDU the buffer will hold.
+ * @return A pointer to the mbuf or nullptr if none are free.
+ * @details Uses the L2CAP receive pool if enabled, the host msys pools when it is empty.
+ */
+struct os_mbuf* NimBLEL2CAPChannel::allocRxBuffer(uint16_t mtu) {
+    struct os_mbuf *om = nullptr;
+
+#if CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT > 0
+    if(!l2capRxPoolInit) {
+        int rc = os_mempool_init(&l2capRxPool, CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT,
+                                 L2CAP_RX_BLOCK_SIZE, l2capRxPoolMem, "nimble_cpp_l2cap_rx_pool");
+        assert(rc == 0);
+        rc = os_mbuf_pool_init(&l2capRxMbufPool, &l2capRxPool, L2CAP_RX_BLOCK_SIZE,
+                               CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT);
+        assert(rc == 0);
+        l2capRxPoolInit = true;
+    }
+
+    om = os_mbuf_get_pkthdr(&l2capRxMbufPool, 0);
+    if(om == nullptr) {
+        NIMBLE_LOGD(LOG_TAG, "L2CAP receive pool exhausted, using msys");
+    }
+#endif
+
+    if(om == nullptr) {
+        om = os_msys_get_pkthdr(mtu, 0);
+    }
+
+    return om;
+} // allocRxBuffer
+
+
+/**
+ * @brief Give the host a buffer for the next SDU, which also returns the credits to the peer.
+ * @return True on success.
+ */
+bool NimBLEL2CAPChannel::postRxBuffer() {
+    struct os_mbuf *sdu = allocRxBuffer(m_mtu);
+    if(sdu == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to allocate a receive buffer");
+        return false;
+    }
+
+    int rc = ble_l2cap_recv_ready(m_pChan, sdu);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_l2cap_recv_ready: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        os_mbuf_free_chain(sdu);
+        return false;
+    }
+
+    return true;
+} // postRxBuffer
+
+
+/**
+ * @brief Close the channel.
+ * @return True if the request was sent, NimBLEL2CAPChannelCallbacks::onDisconnect is called when done.
+ */
+bool NimBLEL2CAPChannel::disconnect() {
+    if(m_pChan == nullptr) {
+        return false;
+    }
+
+    int rc = ble_l2cap_disconnect(m_pChan);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_l2cap_disconnect: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // disconnect
+
+
+/**
+ * @brief Check if the channel is connected.
+ */
+bool NimBLEL2CAPChannel::isConnected() {
+    return m_pChan != nullptr && m_peerMTU != 0;
+} // isConnected
+
+
+/**
+ * @brief Get the handle of the connection the channel uses.
+ */
+uint16_t NimBLEL2CAPChannel::getConnHandle() {
+    return m_connHandle;
+} // getConnHandle
+
+
+/**
+ * @brief Get the PSM of the channel.
+ */
+uint16_t NimBLEL2CAPChannel::getPSM() {
+    return m_psm;
+} // getPSM
+
+
+/**
+ * @brief Get the largest SDU this device can receive.
+ */
+uint16_t NimBLEL2CAPChannel::getMTU() {
+    return m_mtu;
+} // getMTU
+
+
+/**
+ * @brief Get the largest SDU the peer can receive, 0 if not connected.
+ */
+uint16_t NimBLEL2CAPChannel::getPeerMTU() {
+    return m_peerMTU;
+} // getPeerMTU
+
+
+/**
+ * @brief Handle the L2CAP events of the channel.
+ * @param [in] event The event from the host.
+ * @param [in] arg A pointer to the channel.
+ * @details Called by the host for channels opened with connect() and by the
+ * NimBLEL2CAPServer for the channels it accepted.
+ */
+int NimBLEL2CAPChannel::handleL2CAPEvent(struct ble_l2cap_event *event, void *arg) {
+    NimBLEL2CAPChannel* pChannel = (NimBLEL2CAPChannel*)arg;
+
+    switch(event->type) {
+        case BLE_L2CAP_EVENT_COC_CONNECTED: {
+            if(event->connect.status != 0) {
+                NIMBLE_LOGE(LOG_TAG, "Channel connect failed: rc=%d %s", event->connect.status,
+                            NimBLEUtils::returnCodeToString(event->connect.status));
+                pChannel->m_pChan = nullptr;
+                pChannel->m_pCallbacks->onDisconnect(pChannel);
+                delete pChannel;
+                return 0;
+            }
+
+            struct ble_l2cap_chan_info info;
+            pChannel->m_pChan = event->connect.chan;
+            if(ble_l2cap_get_chan_info(pChannel->m_pChan, &info) == 0) {
+                pChannel->m_peerMTU = info.peer_coc_mtu;
+            }
+
+            NIMBLE_LOGD(LOG_TAG, "Channel connected, psm=%u, peer mtu=%u", pChannel->m_psm, pChannel->m_peerMTU);
+            pChannel->m_pCallbacks->onConnect(pChannel);
+            return 0;
+        }
+
+        case BLE_L2CAP_EVENT_COC_DISCONNECTED: {
+            pChannel->m_pChan   = nullptr;
+            pChannel->m_peerMTU = 0;
+
+            // Failed inside connect(), which deletes the channel.
+            if(pChannel->m_connecting) {
+                pChannel->m_chanFreed = true;
+                return 0;
+            }
+
+            NIMBLE_LOGD(LOG_TAG, "Channel disconnected, psm=%u", pChannel->m_psm);
+            pChannel->flushTx(BLE_HS_ENOTCONN);
+            pChannel->m_pCallbacks->onDisconnect(pChannel);
+            if(pChannel->m_pServer != nullptr) {
+                pChannel->m_pServer->removeChannel(pChannel);
+            }
+            delete pChannel;
+            return 0;
+        }
+
+        case BLE_L2CAP_EVENT_COC_DATA_RECEIVED: {
+            struct os_mbuf *sdu = event->receive.sdu_rx;
+
+            // Return the credits before the application handles the data,
+            // if no buffer is free try again once this SDU is released.
+            bool posted = pChannel->postRxBuffer();
+            pChannel->m_pCallbacks->onRead(pChannel, sdu);
+            os_mbuf_free_chain(sdu);
+
+            if(!posted && pChannel->m_pChan != nullptr && !pChannel->postRxBuffer()) {
+                NIMBLE_LOGE(LOG_TAG, "No receive buffer, channel stalled, psm=%u", pChannel->m_psm);
+            }
+            return 0;
+        }
+
+        case BLE_L2CAP_EVENT_COC_TX_UNSTALLED: {
+            if(event->tx_unstalled.status != 0) {
+                pChannel->flushTx(event->tx_unstalled.status);
+            } else {
+                pChannel->continueTx(true);
+            }
+            return 0;
+        }
+
+        default:
+            return 0;
+    }
+} // handleL2CAPEvent
+
+
+bool NimBLEL2CAPChannelCallbacks::onAccept(NimBLEL2CAPChannel* pChannel) {
+    NIMBLE_LOGD("NimBLEL2CAPChannelCallbacks", "onAccept: default");
+    return true;
+} // onAccept
+
+void NimBLEL2CAPChannelCallbacks::onConnect(NimBLEL2CAPChannel* pChannel) {
+    NIMBLE_LOGD("NimBLEL2CAPChannelCallbacks", "onConnect: default");
+} // onConnect
+
+void NimBLEL2CAPChannelCallbacks::onDisconnect(NimBLEL2CAPChannel* pChannel) {
+    NIMBLE_LOGD("NimBLEL2CAPChannelCallbacks", "onDisconnect: default");
+} // onDisconnect
+
+void NimBLEL2CAPChannelCallbacks::onRead(NimBLEL2CAPChannel* pChannel, std::vector<uint8_t> &data) {
+    NIMBLE_LOGD("NimBLEL2CAPChannelCallbacks", "onRead: default");
+} // onRead
+
+void NimBLEL2CAPChannelCallbacks::onRead(NimBLEL2CAPChannel* pChannel, struct os_mbuf* sdu) {
+    std::vector<uint8_t> data(OS_MBUF_PKTLEN(sdu));
+    os_mbuf_copydata(sdu, 0, data.size(), data.data());
+    onRead(pChannel, data);
+} // onRead
+
+void NimBLEL2CAPChannelCallbacks::onWriteComplete(NimBLEL2CAPChannel* pChannel, int status) {
+    NIMBLE_LOGD("NimBLEL2CAPChannelCallbacks", "onWriteComplete: default");
+} // onWriteComplete
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0 */
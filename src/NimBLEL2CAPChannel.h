@@ -0,0 +1,161 @@
+/*
+ * NimBLEL2CAPChannel.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEL2CAPCHANNEL_H_
+#define NIMBLEL2CAPCHANNEL_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <vector>
+#include <string>
+
+class NimBLEClient;
+class NimBLEL2CAPServer;
+class NimBLEL2CAPChannelCallbacks;
+
+
+/**
+ * @brief An L2CAP LE credit based connection oriented channel.
+ * @details Data written to the channel is sent in SDU's of up to the MTU of the peer,
+ * the host sends each SDU in as many L2CAP packets as the peer has given credits for
+ * and continues when the peer returns more. Writes are queued so write() does not wait
+ * for credits, NimBLEL2CAPChannelCallbacks::onWriteComplete is called when all queued data is sent.\n
+ * Channels are created by NimBLEL2CAPChannel::connect or accepted by a NimBLEL2CAPServer
+ * and are deleted after NimBLEL2CAPChannelCallbacks::onDisconnect returns.\n
+ * Received SDU's are stored in mbufs from a pool shared by all channels when
+ * CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT is set, or from the host msys pools.
+ * The buffer for the next SDU is given to the host before the application reads the
+ * current one and the mbufs return to the pool when the read callback returns.
+ */
+class NimBLEL2CAPChannel {
+public:
+    static NimBLEL2CAPChannel* connect(uint16_t connHandle, uint16_t psm, uint16_t mtu,
+                                       NimBLEL2CAPChannelCallbacks* pCallbacks);
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+    static NimBLEL2CAPChannel* connect(NimBLEClient* pClient, uint16_t psm, uint16_t mtu,
+                                       NimBLEL2CAPChannelCallbacks* pCallbacks);
+#endif
+
+    bool                write(const uint8_t* data, size_t length);
+    bool                disconnect();
+    bool                isConnected();
+    uint16_t            getConnHandle();
+    uint16_t            getPSM();
+    uint16_t            getMTU();
+    uint16_t            getPeerMTU();
+
+    /**
+     * @brief Write a vector of bytes to the channel.
+     * @param [in] data The data to write.
+     * @return True if the data was queued to send.
+     */
+    bool write(const std::vector<uint8_t> &data) {
+        return write(data.data(), data.size());
+    }
+
+    /**
+     * @brief Write a string to the channel.
+     * @param [in] data The data to write.
+     * @return True if the data was queued to send.
+     */
+    bool write(const std::string &data) {
+        return write((uint8_t*)data.data(), data.length());
+    }
+
+private:
+    friend class NimBLEL2CAPServer;
+
+    NimBLEL2CAPChannel(uint16_t psm, uint16_t mtu, NimBLEL2CAPChannelCallbacks* pCallbacks);
+    ~NimBLEL2CAPChannel();
+
+    static int          handleL2CAPEvent(struct ble_l2cap_event *event, void *arg);
+    static struct os_mbuf* allocRxBuffer(uint16_t mtu);
+    bool                postRxBuffer();
+    void                startTx();
+    void                continueTx(bool sent);
+    void                flushTx(int status);
+
+    struct ble_l2cap_chan*       m_pChan;
+    NimBLEL2CAPServer*           m_pServer;
+    NimBLEL2CAPChannelCallbacks* m_pCallbacks;
+    uint16_t                     m_connHandle;
+    uint16_t                     m_psm;
+    uint16_t                     m_mtu;
+    uint16_t                     m_peerMTU;
+    bool                         m_connecting;
+    bool                         m_chanFreed;
+    bool                         m_txBusy;
+    STAILQ_HEAD(, os_mbuf_pkthdr) m_txQueue;
+}; // NimBLEL2CAPChannel
+
+
+/**
+ * @brief Callbacks for the events of an L2CAP channel.
+ */
+class NimBLEL2CAPChannelCallbacks {
+public:
+    virtual ~NimBLEL2CAPChannelCallbacks() {};
+
+    /**
+     * @brief Called when a peer requests to open a channel to a NimBLEL2CAPServer.
+     * @param [in] pChannel A pointer to the channel.
+     * @return True to accept the channel, false to reject it.
+     */
+    virtual bool onAccept(NimBLEL2CAPChannel* pChannel);
+
+    /**
+     * @brief Called when the channel is connected.
+     * @param [in] pChannel A pointer to the channel.
+     */
+    virtual void onConnect(NimBLEL2CAPChannel* pChannel);
+
+    /**
+     * @brief Called when the channel is disconnected or could not be connected.
+     * @param [in] pChannel A pointer to the channel, it is deleted when this returns.
+     */
+    virtual void onDisconnect(NimBLEL2CAPChannel* pChannel);
+
+    /**
+     * @brief Called when an SDU is received.
+     * @param [in] pChannel A pointer to the channel.
+     * @param [in] data The data of the SDU.
+     */
+    virtual void onRead(NimBLEL2CAPChannel* pChannel, std::vector<uint8_t> &data);
+
+    /**
+     * @brief Called when an SDU is received, before it is copied.
+     * @param [in] pChannel A pointer to the channel.
+     * @param [in] sdu The mbuf chain holding the SDU, it is freed when this returns.
+     * @details The default copies the SDU to a vector and calls onRead(pChannel, data),
+     * override this to read the data from the chain without the copy.
+     */
+    virtual void onRead(NimBLEL2CAPChannel* pChannel, struct os_mbuf* sdu);
+
+    /**
+     * @brief Called when all data queued by NimBLEL2CAPChannel::write has been sent.
+     * @param [in] pChannel A pointer to the channel.
+     * @param [in] status 0 on success or the error code if the data could not be sent,
+     * data that was still queued is discarded.
+     */
+    virtual void onWriteComplete(NimBLEL2CAPChannel* pChannel, int status);
+}; // NimBLEL2CAPChannelCallbacks
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0 */
+#endif /* NIMBLEL2CAPCHANNEL_H_ */
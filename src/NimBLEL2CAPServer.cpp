@@ -0,0 +1,142 @@
+/*
+ * NimBLEL2CAPServer.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+
+#include "NimBLEL2CAPServer.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#include <algorithm>
+
+static const char* LOG_TAG = "NimBLEL2CAPServer";
+
+
+/**
+ * @brief Construct an L2CAP server, use NimBLEDevice::createL2CAPServer to get the instance.
+ */
+NimBLEL2CAPServer::NimBLEL2CAPServer() {
+} // NimBLEL2CAPServer
+
+
+NimBLEL2CAPServer::~NimBLEL2CAPServer() {
+    for(auto &it : m_channels) {
+        delete it;
+    }
+
+    for(auto &it : m_listeners) {
+        delete it;
+    }
+} // ~NimBLEL2CAPServer
+
+
+/**
+ * @brief Accept channels opened by peers on a PSM.
+ * @param [in] psm The PSM to listen on, 0x0001 to 0x007F for fixed SIG assigned services,
+ * 0x0080 to 0x00FF for dynamic services.
+ * @param [in] mtu The largest SDU this device can receive on the channels.
+ * @param [in] pCallbacks The callbacks for the events of the channels accepted, nullptr to use the defaults.
+ * @return True if the server is listening on the PSM.
+ */
+bool NimBLEL2CAPServer::listen(uint16_t psm, uint16_t mtu, NimBLEL2CAPChannelCallbacks* pCallbacks) {
+    l2cap_listener_t* pListener = new l2cap_listener_t{this, pCallbacks, psm, mtu};
+
+    int rc = ble_l2cap_create_server(psm, mtu, NimBLEL2CAPServer::handleL2CAPEvent, pListener);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_l2cap_create_server: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        delete pListener;
+        return false;
+    }
+
+    m_listeners.push_back(pListener);
+    return true;
+} // listen
+
+
+/**
+ * @brief Get the channels accepted by the server that are connected.
+ */
+std::vector<NimBLEL2CAPChannel*> NimBLEL2CAPServer::getChannels() {
+    return m_channels;
+} // getChannels
+
+
+/**
+ * @brief Remove a channel that has disconnected from the list of channels.
+ * @param [in] pChannel A pointer to the channel.
+ */
+void NimBLEL2CAPServer::removeChannel(NimBLEL2CAPChannel* pChannel) {
+    auto it = std::find(m_channels.begin(), m_channels.end(), pChannel);
+    if(it != m_channels.end()) {
+        m_channels.erase(it);
+    }
+} // removeChannel
+
+
+/**
+ * @brief Handle the L2CAP events of the channels opened to a PSM the server listens on.
+ * @param [in] event The event from the host.
+ * @param [in] arg A pointer to the l2cap_listener_t of the PSM.
+ */
+int NimBLEL2CAPServer::handleL2CAPEvent(struct ble_l2cap_event *event, void *arg) {
+    l2cap_listener_t* pListener = (l2cap_listener_t*)arg;
+    NimBLEL2CAPServer* pServer = pListener->server;
+    struct ble_l2cap_chan* chan;
+
+    switch(event->type) {
+        case BLE_L2CAP_EVENT_COC_ACCEPT: {
+            NimBLEL2CAPChannel* pChannel = new NimBLEL2CAPChannel(pListener->psm,
+                                                                  pListener->mtu,
+                                                                  pListener->callbacks);
+            pChannel->m_pChan      = event->accept.chan;
+            pChannel->m_pServer    = pServer;
+            pChannel->m_connHandle = event->accept.conn_handle;
+            pChannel->m_peerMTU    = event->accept.peer_sdu_size;
+
+            if(!pChannel->m_pCallbacks->onAccept(pChannel)) {
+                NIMBLE_LOGD(LOG_TAG, "Channel rejected, psm=%u", pListener->psm);
+                delete pChannel;
+                return BLE_HS_EAUTHOR;
+            }
+
+            if(!pChannel->postRxBuffer()) {
+                delete pChannel;
+                return BLE_HS_ENOMEM;
+            }
+
+            pServer->m_channels.push_back(pChannel);
+            return 0;
+        }
+
+        case BLE_L2CAP_EVENT_COC_CONNECTED:
+            chan = event->connect.chan;
+            break;
+        case BLE_L2CAP_EVENT_COC_DISCONNECTED:
+            chan = event->disconnect.chan;
+            break;
+        case BLE_L2CAP_EVENT_COC_DATA_RECEIVED:
+            chan = event->receive.chan;
+            break;
+        case BLE_L2CAP_EVENT_COC_TX_UNSTALLED:
+            chan = event->tx_unstalled.chan;
+            break;
+        default:
+            return 0;
+    }
+
+    for(auto &it : pServer->m_channels) {
+        if(it->m_pChan == chan) {
+            return NimBLEL2CAPChannel::handleL2CAPEvent(event, it);
+        }
+    }
+
+    return 0;
+} // handleL2CAPEvent
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0 */
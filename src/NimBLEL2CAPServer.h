@@ -0,0 +1,55 @@
+/*
+ * NimBLEL2CAPServer.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEL2CAPSERVER_H_
+#define NIMBLEL2CAPSERVER_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+
+#include "NimBLEL2CAPChannel.h"
+
+#include <vector>
+
+/**
+ * @brief Accepts L2CAP connection oriented channels opened by peers.
+ * @details Get the instance with NimBLEDevice::createL2CAPServer. The host cannot remove
+ * a PSM once it listens on it, so listen() must be called again after NimBLEDevice::deinit.
+ */
+class NimBLEL2CAPServer {
+public:
+    bool                              listen(uint16_t psm, uint16_t mtu,
+                                             NimBLEL2CAPChannelCallbacks* pCallbacks);
+    std::vector<NimBLEL2CAPChannel*>  getChannels();
+
+private:
+    friend class NimBLEDevice;
+    friend class NimBLEL2CAPChannel;
+
+    NimBLEL2CAPServer();
+    ~NimBLEL2CAPServer();
+
+    /**
+     * @brief A PSM the server listens on.
+     */
+    typedef struct {
+        NimBLEL2CAPServer*           server;
+        NimBLEL2CAPChannelCallbacks* callbacks;
+        uint16_t                     psm;
+        uint16_t                     mtu;
+    } l2cap_listener_t;
+
+    static int          handleL2CAPEvent(struct ble_l2cap_event *event, void *arg);
+    void                removeChannel(NimBLEL2CAPChannel* pChannel);
+
+    std::vector<l2cap_listener_t*>   m_listeners;
+    std::vector<NimBLEL2CAPChannel*> m_channels;
+}; // NimBLEL2CAPServer
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0 */
+#endif /* NIMBLEL2CAPSERVER_H_ */
@@ -0,0 +1,187 @@
+/*
+ * NimBLELatencyHistogram.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#include "NimBLELatencyHistogram.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) && CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+
+#include <string.h>
+#include <stdio.h>
+
+static const char* const opNames[NimBLELatencyHistogram::OP_COUNT] = {
+    "connect",
+    "discover services",
+    "discover characteristics",
+    "discover descriptors",
+    "read",
+    "write",
+};
+
+
+/**
+ * @brief Construct an empty histogram.
+ */
+NimBLELatencyHistogram::NimBLELatencyHistogram() {
+    reset();
+} // NimBLELatencyHistogram
+
+
+/**
+ * @brief Add the latency of a completed operation.
+ * @param [in] latencyMs The time from the start of the request to its completion in milliseconds.
+ */
+void NimBLELatencyHistogram::record(uint32_t latencyMs) {
+    uint8_t bucket = 0;
+    while(bucket < NIMBLE_CPP_LATENCY_BUCKETS - 1 && latencyMs >= getBucketLimit(bucket)) {
+        bucket++;
+    }
+
+    m_buckets[bucket]++;
+    m_count++;
+    m_sum += latencyMs;
+    if(latencyMs < m_min) {
+        m_min = latencyMs;
+    }
+    if(latencyMs > m_max) {
+        m_max = latencyMs;
+    }
+} // record
+
+
+/**
+ * @brief Clear all of the recorded latencies.
+ */
+void NimBLELatencyHistogram::reset() {
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_min = UINT32_MAX;
+    m_max = 0;
+    m_sum = 0;
+} // reset
+
+
+/**
+ * @brief Get the number of operations recorded.
+ */
+uint32_t NimBLELatencyHistogram::getCount() const {
+    return m_count;
+} // getCount
+
+
+/**
+ * @brief Get the lowest latency recorded in milliseconds, 0 if none.
+ */
+uint32_t NimBLELatencyHistogram::getMin() const {
+    return m_count ? m_min : 0;
+} // getMin
+
+
+/**
+ * @brief Get the highest latency recorded in milliseconds.
+ */
+uint32_t NimBLELatencyHistogram::getMax() const {
+    return m_max;
+} // getMax
+
+
+/**
+ * @brief Get the mean latency recorded in milliseconds, 0 if none.
+ */
+uint32_t NimBLELatencyHistogram::getAverage() const {
+    return m_count ? (uint32_t)(m_sum / m_count) : 0;
+} // getAverage
+
+
+/**
+ * @brief Get an upper bound of a percentile of the latency from the buckets.
+ * @param [in] percent The percentile, 1 to 100.
+ * @return The limit of the bucket containing the percentile in milliseconds, capped at the maximum recorded.
+ */
+uint32_t NimBLELatencyHistogram::getPercentile(uint8_t percent) const {
+    if(m_count == 0) {
+        return 0;
+    }
+    if(percent > 100) {
+        percent = 100;
+    }
+
+    uint64_t target = ((uint64_t)m_count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for(uint8_t i = 0; i < NIMBLE_CPP_LATENCY_BUCKETS - 1; i++) {
+        seen += m_buckets[i];
+        if(seen >= target) {
+            uint32_t limit = getBucketLimit(i);
+            return limit < m_max ? limit : m_max;
+        }
+    }
+    return m_max;
+} // getPercentile
+
+
+/**
+ * @brief Get the number of operations recorded in a bucket.
+ * @param [in] bucket The bucket index, see getBucketLimit().
+ */
+uint32_t NimBLELatencyHistogram::getBucketCount(uint8_t bucket) const {
+    if(bucket >= NIMBLE_CPP_LATENCY_BUCKETS) {
+        return 0;
+    }
+    return m_buckets[bucket];
+} // getBucketCount
+
+
+/**
+ * @brief Get the exclusive upper limit of a bucket in milliseconds.
+ * @param [in] bucket The bucket index.
+ * @return 2^bucket, or UINT32_MAX for the last bucket.
+ */
+uint32_t NimBLELatencyHistogram::getBucketLimit(uint8_t bucket) {
+    if(bucket >= NIMBLE_CPP_LATENCY_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    return 1UL << bucket;
+} // getBucketLimit
+
+
+/**
+ * @brief Get the name of an operation type.
+ */
+const char* NimBLELatencyHistogram::opToString(op_t op) {
+    if(op >= OP_COUNT) {
+        return "unknown";
+    }
+    return opNames[op];
+} // opToString
+
+
+/**
+ * @brief Get a summary of the histogram.
+ * @return The count, min, average, p90 and max, followed by the non empty buckets.
+ */
+std::string NimBLELatencyHistogram::toString() const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "n=%u min=%u avg=%u p90<=%u max=%u ms",
+             (unsigned)getCount(), (unsigned)getMin(), (unsigned)getAverage(),
+             (unsigned)getPercentile(90), (unsigned)getMax());
+    std::string res(buf);
+
+    for(uint8_t i = 0; i < NIMBLE_CPP_LATENCY_BUCKETS; i++) {
+        if(m_buckets[i] == 0) {
+            continue;
+        }
+        if(i < NIMBLE_CPP_LATENCY_BUCKETS - 1) {
+            snprintf(buf, sizeof(buf), " <%u:%u", (unsigned)getBucketLimit(i), (unsigned)m_buckets[i]);
+        } else {
+            snprintf(buf, sizeof(buf), " >=%u:%u", (unsigned)getBucketLimit(i - 1), (unsigned)m_buckets[i]);
+        }
+        res += buf;
+    }
+    return res;
+} // toString
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL && CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM */
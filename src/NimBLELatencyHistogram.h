@@ -0,0 +1,85 @@
+/*
+ * NimBLELatencyHistogram.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLELATENCYHISTOGRAM_H_
+#define NIMBLELATENCYHISTOGRAM_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+
+#ifndef CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+#    define CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM 0
+#endif
+
+#if CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_npl.h"
+#else
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+#endif
+
+#include <stdint.h>
+#include <string>
+
+/** @brief The number of buckets, bucket i counts latencies below 2^i ms, the last counts the rest. */
+#define NIMBLE_CPP_LATENCY_BUCKETS 16
+
+/**
+ * @brief A histogram of the latency of one type of client operation.
+ * @details The buckets are powers of two of milliseconds so a few counters cover from
+ * a single connection interval to the supervision timeout. The resolution is the tick period.
+ */
+class NimBLELatencyHistogram {
+public:
+    /** @brief The client operations that are measured. */
+    enum op_t {
+        CONNECT,
+        DISCOVER_SERVICES,
+        DISCOVER_CHARACTERISTICS,
+        DISCOVER_DESCRIPTORS,
+        READ,
+        WRITE,
+        OP_COUNT
+    };
+
+    NimBLELatencyHistogram();
+
+    void            record(uint32_t latencyMs);
+    void            reset();
+    uint32_t        getCount() const;
+    uint32_t        getMin() const;
+    uint32_t        getMax() const;
+    uint32_t        getAverage() const;
+    uint32_t        getPercentile(uint8_t percent) const;
+    uint32_t        getBucketCount(uint8_t bucket) const;
+    std::string     toString() const;
+
+    static uint32_t getBucketLimit(uint8_t bucket);
+    static const char* opToString(op_t op);
+
+private:
+    uint32_t        m_buckets[NIMBLE_CPP_LATENCY_BUCKETS];
+    uint32_t        m_count;
+    uint32_t        m_min;
+    uint32_t        m_max;
+    uint64_t        m_sum;
+}; // NimBLELatencyHistogram
+
+#define NIMBLE_CPP_LATENCY_START(start) \
+    ble_npl_time_t start = ble_npl_time_get()
+#define NIMBLE_CPP_LATENCY_RECORD(client, op, start) \
+    (client)->recordLatency(NimBLELatencyHistogram::op, start)
+
+#else
+#define NIMBLE_CPP_LATENCY_START(start)
+#define NIMBLE_CPP_LATENCY_RECORD(client, op, start)
+#endif /* CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM */
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL */
+#endif /* NIMBLELATENCYHISTOGRAM_H_ */
@@ -0,0 +1,495 @@
+/*
+ * NimBLELinkProfile.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#include "NimBLELinkProfile.h"
+#include "NimBLEConnStates.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+// Time to wait for the peer to respond to each step before moving on.
+#define NIMBLE_CPP_LINK_STEP_TIMEOUT_MS 5000
+// Time to wait before retrying a step that was rejected or could not be started.
+#define NIMBLE_CPP_LINK_RETRY_MS 100
+
+static const char* LOG_TAG = "NimBLELinkProfile";
+
+enum {
+    LINK_STEP_PHY,
+    LINK_STEP_DATA_LEN,
+    LINK_STEP_MTU,
+    LINK_STEP_CONN_PARAMS,
+    LINK_STEP_DONE,
+};
+
+typedef struct {
+    uint16_t                connHandle = BLE_HS_CONN_HANDLE_NONE;
+    uint8_t                 step       = LINK_STEP_DONE;
+    uint8_t                 attempts   = 0;
+    bool                    waiting    = false;
+    bool                    mtuPending = false;
+    NimBLELinkProfile       profile;
+    link_profile_callback   callback;
+    NimBLELinkProfileResult result;
+    ble_npl_callout         timer;
+} ble_link_state_t;
+
+static NimBLEConnStates<ble_link_state_t> linkStates;
+
+static void linkRunStep(ble_link_state_t *state);
+
+
+/**
+ * @brief Construct a link profile that leaves every parameter unchanged.
+ */
+NimBLELinkProfile::NimBLELinkProfile() {
+    phyMask            = 0;
+    txOctets           = 0;
+    exchangeMTU        = false;
+    minInterval        = 0;
+    maxInterval        = 0;
+    latency            = 0;
+    supervisionTimeout = 0;
+    minCeLen           = 0;
+    maxCeLen           = 0;
+    retries            = 2;
+    parallel           = false;
+} // NimBLELinkProfile
+
+
+/**
+ * @brief Get a link profile for the highest throughput:\n
+ * 2M PHY, 251 byte data length, MTU exchange and a 7.5 - 15ms connection interval.
+ * @return The throughput link profile.
+ */
+NimBLELinkProfile NimBLELinkProfile::throughput() {
+    NimBLELinkProfile profile;
+    profile.phyMask            = BLE_GAP_LE_PHY_2M_MASK;
+    profile.txOctets           = 251;
+    profile.exchangeMTU        = true;
+    profile.minInterval        = 6;
+    profile.maxInterval        = 12;
+    profile.latency            = 0;
+    profile.supervisionTimeout = 400;
+    return profile;
+} // throughput
+
+
+/**
+ * @brief Get a link profile to prepare a new connection for discovery:\n
+ * 2M PHY, 251 byte data length and MTU exchange started together, the connection parameters are unchanged.
+ * @return The discovery link profile.
+ */
+NimBLELinkProfile NimBLELinkProfile::discovery() {
+    NimBLELinkProfile profile;
+    profile.phyMask     = BLE_GAP_LE_PHY_2M_MASK;
+    profile.txOctets    = 251;
+    profile.exchangeMTU = true;
+    profile.parallel    = true;
+    return profile;
+} // discovery
+
+
+/**
+ * @brief Find the negotiation state of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @return A pointer to the state or nullptr if the connection is not being negotiated.
+ */
+static ble_link_state_t* linkFindState(uint16_t conn_handle) {
+    return linkStates.find(conn_handle);
+} // linkFindState
+
+
+/**
+ * @brief Report the achieved parameters and release the negotiation state.
+ * @param [in] state The negotiation state.
+ * @param [in] connected False if the connection was lost.
+ */
+static void linkFinish(ble_link_state_t *state, bool connected) {
+    ble_npl_callout_stop(&state->timer);
+    ble_npl_callout_deinit(&state->timer);
+
+    NimBLELinkProfileResult result = state->result;
+    link_profile_callback callback = state->callback;
+
+    if(connected) {
+        struct ble_gap_conn_desc desc;
+        if(ble_gap_conn_find(state->connHandle, &desc) == 0) {
+            result.interval           = desc.conn_itvl;
+            result.latency            = desc.conn_latency;
+            result.supervisionTimeout = desc.supervision_timeout;
+        }
+
+        ble_gap_read_le_phy(state->connHandle, &result.txPhy, &result.rxPhy);
+        result.mtu = ble_att_mtu(state->connHandle);
+    }
+
+    state->callback = nullptr;
+    state->waiting  = false;
+    state->mtuPending = false;
+    state->step     = LINK_STEP_DONE;
+    state->connHandle = BLE_HS_CONN_HANDLE_NONE;
+
+    NIMBLE_LOGI(LOG_TAG, "Link profile done; conn_handle=%u phy=%u/%u mtu=%u interval=%u",
+                result.connHandle, result.txPhy, result.rxPhy, result.mtu, result.interval);
+
+    if(callback != nullptr) {
+        callback(result);
+    }
+} // linkFinish
+
+
+/**
+ * @brief Record the result of the current step.
+ * @param [in] state The negotiation state.
+ * @param [in] rc The result of the current step.
+ */
+static void linkSetStepRc(ble_link_state_t *state, int rc) {
+    switch(state->step) {
+        case LINK_STEP_PHY:
+            state->result.phyRc = rc;
+            break;
+        case LINK_STEP_DATA_LEN:
+            state->result.dataLenRc = rc;
+            break;
+        case LINK_STEP_MTU:
+            state->result.mtuRc = rc;
+            break;
+        case LINK_STEP_CONN_PARAMS:
+            state->result.connParamsRc = rc;
+            break;
+        default:
+            break;
+    }
+
+    if(rc != 0 && rc != -1) {
+        NIMBLE_LOGW(LOG_TAG, "Link profile step %u failed; rc=%d %s",
+                    state->step, rc, NimBLEUtils::returnCodeToString(rc));
+    }
+} // linkSetStepRc
+
+
+/**
+ * @brief Record the result of the current step and start the next one.
+ * @param [in] state The negotiation state.
+ * @param [in] rc The result of the current step.
+ */
+static void linkNextStep(ble_link_state_t *state, int rc) {
+    ble_npl_callout_stop(&state->timer);
+    linkSetStepRc(state, rc);
+
+    state->waiting  = false;
+    state->attempts = 0;
+    state->step++;
+    linkRunStep(state);
+} // linkNextStep
+
+
+/**
+ * @brief Retry the current step after a short delay.
+ * @param [in] state The negotiation state.
+ * @param [in] rc The reason for the retry.
+ * @return True if the step will be retried, false if there are no retries left.
+ */
+static bool linkRetryStep(ble_link_state_t *state, int rc) {
+    if(state->attempts >= state->profile.retries) {
+        return false;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "Retrying link profile step %u; rc=%d", state->step, rc);
+    state->attempts++;
+    state->waiting = false;
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_LINK_RETRY_MS));
+    return true;
+} // linkRetryStep
+
+
+/**
+ * @brief Wait for the peer to respond to the current step.
+ * @param [in] state The negotiation state.
+ */
+static void linkWait(ble_link_state_t *state) {
+    state->waiting = true;
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_LINK_STEP_TIMEOUT_MS));
+} // linkWait
+
+
+/**
+ * @brief MTU exchange callback for the link profile MTU step.
+ */
+static int linkMtuCb(uint16_t conn_handle, const struct ble_gatt_error *error,
+                     uint16_t mtu, void *arg)
+{
+    ble_link_state_t *state = (ble_link_state_t*)arg;
+    if(state->connHandle != conn_handle || !state->mtuPending) {
+        return 0;
+    }
+
+    state->mtuPending = false;
+    if(state->step == LINK_STEP_MTU && state->waiting) {
+        linkNextStep(state, error->status);
+    } else {
+        // Started with the PHY update, the MTU step uses the result when it is reached.
+        state->result.mtuRc = error->status;
+    }
+    return 0;
+} // linkMtuCb
+
+
+/**
+ * @brief Request the data length of the profile.
+ * @param [in] state The negotiation state.
+ * @return 0 on success, -1 if not requested or the error code.
+ */
+static int linkStartDataLen(ble_link_state_t *state) {
+    if(state->profile.txOctets == 0) {
+        return -1;
+    }
+#if defined(CONFIG_NIMBLE_CPP_IDF) && !defined(ESP_IDF_VERSION) || \
+  (ESP_IDF_VERSION_MAJOR * 100 + ESP_IDF_VERSION_MINOR * 10 + ESP_IDF_VERSION_PATCH) < 432
+    return BLE_HS_ENOTSUP;
+#else
+    // The host does not report the data length change, the controller applies it when
+    // the peer accepts so the next step can start immediately.
+    uint16_t txOctets = state->profile.txOctets;
+    int rc = ble_gap_set_data_len(state->connHandle, txOctets, (txOctets + 14) * 8);
+    if(rc == 0) {
+        state->result.txOctets = txOctets;
+    }
+    return rc;
+#endif
+} // linkStartDataLen
+
+
+/**
+ * @brief Start the MTU exchange of the profile, state->mtuPending is set while waiting for the peer.
+ * @param [in] state The negotiation state.
+ * @return 0 on success, -1 if not requested or the error code.
+ */
+static int linkStartMtu(ble_link_state_t *state) {
+    if(!state->profile.exchangeMTU) {
+        return -1;
+    }
+
+    // The MTU can only be exchanged once, skip it if it was already done.
+    if(ble_att_mtu(state->connHandle) >= ble_att_preferred_mtu()) {
+        return 0;
+    }
+
+    state->mtuPending = true;
+    int rc = ble_gattc_exchange_mtu(state->connHandle, linkMtuCb, state);
+    if(rc != 0) {
+        state->mtuPending = false;
+    }
+    return rc;
+} // linkStartMtu
+
+
+/**
+ * @brief Start the current step of the negotiation, must be called from the host task.
+ * @param [in] state The negotiation state.
+ */
+static void linkRunStep(ble_link_state_t *state) {
+    NimBLELinkProfile &profile = state->profile;
+    int rc = -1;
+
+    switch(state->step) {
+        case LINK_STEP_PHY: {
+            if(profile.parallel) {
+                // The data length and PHY updates are link layer procedures and the MTU exchange is an ATT
+                // request, the controller and the peer handle them together so none waits for another.
+                state->result.dataLenRc = linkStartDataLen(state);
+                state->result.mtuRc = linkStartMtu(state);
+            }
+
+            if(profile.phyMask == 0) {
+                break;
+            }
+
+            rc = ble_gap_set_prefered_le_phy(state->connHandle, profile.phyMask, profile.phyMask,
+                                             BLE_GAP_LE_PHY_CODED_ANY);
+            if(rc == 0) {
+                linkWait(state);
+                return;
+            }
+            break;
+        }
+
+        case LINK_STEP_DATA_LEN: {
+            rc = profile.parallel ? state->result.dataLenRc : linkStartDataLen(state);
+            break;
+        }
+
+        case LINK_STEP_MTU: {
+            if(!profile.parallel) {
+                rc = linkStartMtu(state);
+            } else {
+                rc = state->result.mtuRc;
+            }
+
+            if(rc == 0 && state->mtuPending) {
+                linkWait(state);
+                return;
+            }
+            break;
+        }
+
+        case LINK_STEP_CONN_PARAMS: {
+            if(profile.minInterval == 0) {
+                break;
+            }
+
+            ble_gap_upd_params params;
+            params.itvl_min            = profile.minInterval;
+            params.itvl_max            = profile.maxInterval;
+            params.latency             = profile.latency;
+            params.supervision_timeout = profile.supervisionTimeout;
+            params.min_ce_len          = profile.minCeLen;
+            params.max_ce_len          = profile.maxCeLen;
+
+            rc = ble_gap_update_params(state->connHandle, &params);
+            if(rc == 0) {
+                linkWait(state);
+                return;
+            }
+
+            // Another update procedure is in progress, try again later.
+            if(rc == BLE_HS_EALREADY && linkRetryStep(state, rc)) {
+                return;
+            }
+            break;
+        }
+
+        default:
+            linkFinish(state, true);
+            return;
+    }
+
+    linkNextStep(state, rc);
+} // linkRunStep
+
+
+/**
+ * @brief Timer callback, starts a step or handles a step that timed out waiting for the peer.
+ */
+static void linkTimerCb(ble_npl_event *event) {
+    ble_link_state_t *state = (ble_link_state_t*)ble_npl_event_get_arg(event);
+    if(state->connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    if(state->waiting) {
+        linkNextStep(state, BLE_HS_ETIMEOUT);
+    } else {
+        linkRunStep(state);
+    }
+} // linkTimerCb
+
+
+/**
+ * @brief Start negotiating a link profile on a connection.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] profile The link parameters to request.
+ * @param [in] callback The function to call with the achieved parameters when done.
+ * @return True if the negotiation was started.
+ */
+bool NimBLELinkProfile::apply(uint16_t conn_handle, const NimBLELinkProfile &profile,
+                              link_profile_callback callback)
+{
+    ble_link_state_t *state = linkStates.claim(conn_handle);
+    if(state == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Link profile already in progress or no state available");
+        return false;
+    }
+
+    NimBLEDevice::gapSubscribe(conn_handle, NimBLEDevice::GAP_SUB_LINK_PROFILE);
+
+    state->waiting  = false;
+    state->mtuPending = false;
+    state->profile  = profile;
+    state->callback = callback;
+    state->attempts = 0;
+    state->result   = {};
+    state->result.connHandle   = conn_handle;
+    state->result.phyRc        = -1;
+    state->result.dataLenRc    = -1;
+    state->result.mtuRc        = -1;
+    state->result.connParamsRc = -1;
+    state->step     = LINK_STEP_PHY;
+
+    // Run the steps in the host task so they are serialized with the events they wait for.
+    ble_npl_callout_init(&state->timer, nimble_port_get_dflt_eventq(), linkTimerCb, state);
+    ble_npl_callout_reset(&state->timer, 0);
+    return true;
+} // apply
+
+
+/**
+ * @brief Handle the GAP events of a connection being negotiated.
+ * @param [in] event The GAP event, called by the client and server event handlers.
+ */
+void NimBLELinkProfile::handleGapEvent(struct ble_gap_event *event) {
+    ble_link_state_t *state;
+
+    switch(event->type) {
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: {
+            state = linkFindState(event->phy_updated.conn_handle);
+            if(state != nullptr && state->step == LINK_STEP_PHY && state->waiting) {
+                state->result.txPhy = event->phy_updated.tx_phy;
+                state->result.rxPhy = event->phy_updated.rx_phy;
+                linkNextStep(state, event->phy_updated.status);
+            }
+            break;
+        }
+
+        case BLE_GAP_EVENT_CONN_UPDATE: {
+            state = linkFindState(event->conn_update.conn_handle);
+            if(state == nullptr || state->step != LINK_STEP_CONN_PARAMS || !state->waiting) {
+                break;
+            }
+
+            // Rejected, ask again for a longer interval.
+            if(event->conn_update.status != 0 && state->profile.maxInterval <= BLE_HCI_CONN_ITVL_MAX / 2) {
+                ble_npl_callout_stop(&state->timer);
+                if(linkRetryStep(state, event->conn_update.status)) {
+                    state->profile.minInterval *= 2;
+                    state->profile.maxInterval *= 2;
+                    break;
+                }
+            }
+
+            linkNextStep(state, event->conn_update.status);
+            break;
+        }
+
+        case BLE_GAP_EVENT_DISCONNECT: {
+            state = linkFindState(event->disconnect.conn.conn_handle);
+            if(state != nullptr) {
+                linkSetStepRc(state, BLE_HS_ENOTCONN);
+                linkFinish(state, false);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+} // handleGapEvent
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
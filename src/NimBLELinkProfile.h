@@ -0,0 +1,99 @@
+/*
+ * NimBLELinkProfile.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLELINKPROFILE_H_
+#define NIMBLELINKPROFILE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <functional>
+
+/**
+ * @brief The link parameters achieved by applying a NimBLELinkProfile.
+ * @details Each step result is 0 on success, BLE_HS_ETIMEOUT if the peer did not respond,
+ * the error code if the step was rejected or failed and -1 if the step was not requested.
+ */
+struct NimBLELinkProfileResult {
+    uint16_t connHandle;
+    uint8_t  txPhy;
+    uint8_t  rxPhy;
+    uint16_t txOctets;
+    uint16_t mtu;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t supervisionTimeout;
+    int      phyRc;
+    int      dataLenRc;
+    int      mtuRc;
+    int      connParamsRc;
+};
+
+typedef std::function<void (const NimBLELinkProfileResult &result)> link_profile_callback;
+
+
+/**
+ * @brief A set of link layer parameters negotiated in order after connecting:
+ * PHY, data length, MTU and then the connection parameters.
+ * @details A step is skipped if its value is 0 (exchangeMTU false for the MTU).
+ * The MTU offered is the one set with NimBLEDevice::setMTU. With parallel set the PHY, data length
+ * and MTU procedures are all started at once and the connection parameters follow when they are done.
+ */
+class NimBLELinkProfile {
+public:
+    NimBLELinkProfile();
+
+    static NimBLELinkProfile throughput();
+    static NimBLELinkProfile discovery();
+
+    /** @brief The preferred TX and RX PHY mask, BLE_GAP_LE_PHY_*_MASK. */
+    uint8_t  phyMask;
+    /** @brief The data length to request in octets, 27 to 251. */
+    uint16_t txOctets;
+    /** @brief Exchange the MTU if the current MTU is lower than the preferred MTU. */
+    bool     exchangeMTU;
+    /** @brief The minimum connection interval in 1.25ms units. */
+    uint16_t minInterval;
+    /** @brief The maximum connection interval in 1.25ms units. */
+    uint16_t maxInterval;
+    /** @brief The slave latency in connection events. */
+    uint16_t latency;
+    /** @brief The supervision timeout in 10ms units. */
+    uint16_t supervisionTimeout;
+    /** @brief The minimum connection event length in 0.625ms units. */
+    uint16_t minCeLen;
+    /** @brief The maximum connection event length in 0.625ms units. */
+    uint16_t maxCeLen;
+    /** @brief How many times to retry a rejected connection parameter update with a doubled interval. */
+    uint8_t  retries;
+    /** @brief Start the data length update and MTU exchange with the PHY update instead of after it. */
+    bool     parallel;
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    static bool apply(uint16_t conn_handle, const NimBLELinkProfile &profile,
+                      link_profile_callback callback);
+    static void handleGapEvent(struct ble_gap_event *event);
+}; // NimBLELinkProfile
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLELINKPROFILE_H_ */
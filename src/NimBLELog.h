@@ -12,15 +12,36 @@
 
 #if defined(CONFIG_BT_ENABLED)
 
+/**
+ * @brief A buffer for the string of a UUID or address in a log statement, the temporary
+ * lives until the end of the statement so the string is formatted without a heap allocation.
+ */
+struct NimBLELogStrBuf {
+    char str[40];
+};
+
+/** @brief Format a NimBLEUUID or NimBLEAddress for a log statement without allocating. */
+#define NIMBLE_CPP_STR(obj) (obj).toString(NimBLELogStrBuf().str, sizeof(NimBLELogStrBuf::str))
+
 #if defined(CONFIG_NIMBLE_CPP_IDF) // using esp-idf
 #  include "esp_log.h"
+#  include "esp_idf_version.h"
 #  ifndef CONFIG_NIMBLE_CPP_LOG_LEVEL
 #    define CONFIG_NIMBLE_CPP_LOG_LEVEL 0
 #  endif
 
+// esp_log filters by the runtime level only after the arguments are evaluated,
+// check it first so the arguments of filtered statements are not evaluated.
+#  if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#    define NIMBLE_CPP_LOG_ENABLED(level, tag) (esp_log_level_get(tag) >= level)
+#  else
+#    define NIMBLE_CPP_LOG_ENABLED(level, tag) (true)
+#  endif
+
 #  define NIMBLE_CPP_LOG_PRINT(level, tag, format, ...) do { \
-    if (CONFIG_NIMBLE_CPP_LOG_LEVEL >= level) \
-      ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__); \
+    if (CONFIG_NIMBLE_CPP_LOG_LEVEL >= level && LOG_LOCAL_LEVEL >= level && \
+        NIMBLE_CPP_LOG_ENABLED(level, tag)) \
+      ESP_LOG_LEVEL(level, tag, format, ##__VA_ARGS__); \
     } while(0)
 
 #  define NIMBLE_LOGD(tag, format, ...) \
@@ -0,0 +1,81 @@
+/*
+ * NimBLEMemory.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEMEMORY_H_
+#define NIMBLEMEMORY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+#ifndef CONFIG_NIMBLE_CPP_SCAN_PSRAM
+#    define CONFIG_NIMBLE_CPP_SCAN_PSRAM 0
+#endif
+
+#ifndef CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH
+#    define CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH 0
+#endif
+
+/*
+ * Allocators for data that tolerates the slower access of PSRAM, the memory is taken from
+ * the internal heap when PSRAM is not available or full. Free it with free().
+ */
+
+/**
+ * @brief Allocate memory in PSRAM if possible.
+ * @param [in] size The number of bytes to allocate.
+ * @return A pointer to the memory or nullptr if no memory is available.
+ */
+inline void* nimble_cpp_psram_malloc(size_t size) {
+#ifdef ESP_PLATFORM
+    void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr != nullptr) {
+        return ptr;
+    }
+#endif
+    return malloc(size);
+}
+
+/**
+ * @brief Allocate zeroed memory in PSRAM if possible.
+ * @param [in] size The number of bytes to allocate.
+ * @return A pointer to the memory or nullptr if no memory is available.
+ */
+inline void* nimble_cpp_psram_calloc(size_t size) {
+#ifdef ESP_PLATFORM
+    void* ptr = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr != nullptr) {
+        return ptr;
+    }
+#endif
+    return calloc(1, size);
+}
+
+/**
+ * @brief Resize memory, moving it to PSRAM if possible.
+ * @param [in] ptr The memory to resize, allocated from any heap.
+ * @param [in] size The new size in bytes.
+ * @return A pointer to the memory or nullptr if no memory is available, ptr is still valid then.
+ */
+inline void* nimble_cpp_psram_realloc(void* ptr, size_t size) {
+#ifdef ESP_PLATFORM
+    void* res = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (res != nullptr) {
+        return res;
+    }
+#endif
+    return realloc(ptr, size);
+}
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* NIMBLEMEMORY_H_ */
@@ -0,0 +1,526 @@
+/*
+ * NimBLEMesh.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_MESH)
+
+#include "NimBLEMesh.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "mesh/cfg_srv.h"
+#else
+#include "nimble/nimble/host/mesh/include/mesh/cfg_srv.h"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+
+static const char* LOG_TAG = "NimBLEMesh";
+
+std::vector<NimBLEMeshElement*>  NimBLEMesh::m_elements;
+std::vector<struct bt_mesh_elem> NimBLEMesh::m_elems;
+struct bt_mesh_comp              NimBLEMesh::m_comp;
+bool                             NimBLEMesh::m_initialized = false;
+
+#if CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT > 0
+/* Each block holds the largest access message with its MIC in one mbuf. */
+#define MESH_MSG_BLOCK_SIZE OS_ALIGN(BT_MESH_TX_SDU_MAX + sizeof(struct os_mbuf) + \
+                                     sizeof(struct os_mbuf_pkthdr), OS_ALIGNMENT)
+
+static os_membuf_t meshMsgPoolMem[OS_MEMPOOL_SIZE(CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT, MESH_MSG_BLOCK_SIZE)];
+static struct os_mempool meshMsgPool;
+static struct os_mbuf_pool meshMsgMbufPool;
+static bool meshMsgPoolInit = false;
+#endif
+
+
+/**
+ * @brief Construct a SIG model.
+ * @param [in] modelId The SIG assigned model ID.
+ */
+NimBLEMeshModel::NimBLEMeshModel(uint16_t modelId) {
+    m_companyId = 0;
+    m_modelId   = modelId;
+    m_vendor    = false;
+    m_pElement  = nullptr;
+    m_pModel    = nullptr;
+} // NimBLEMeshModel
+
+
+/**
+ * @brief Construct a vendor model.
+ * @param [in] companyId The company identifier of the vendor.
+ * @param [in] modelId The vendor assigned model ID.
+ */
+NimBLEMeshModel::NimBLEMeshModel(uint16_t companyId, uint16_t modelId) {
+    m_companyId = companyId;
+    m_modelId   = modelId;
+    m_vendor    = true;
+    m_pElement  = nullptr;
+    m_pModel    = nullptr;
+} // NimBLEMeshModel
+
+
+/**
+ * @brief Add an opcode that the model receives.
+ * @param [in] opcode The opcode, encoded with the BT_MESH_MODEL_OP_1, _2 or _3 macros.
+ * Vendor models can only use 3 octet opcodes and SIG models 1 or 2 octet opcodes.
+ * @param [in] minLength The minimum length of the message payload, shorter messages are dropped.
+ * @return True if the opcode was added.
+ */
+bool NimBLEMeshModel::addOpcode(uint32_t opcode, size_t minLength) {
+    if(NimBLEMesh::m_initialized) {
+        NIMBLE_LOGE(LOG_TAG, "Opcodes cannot be added after NimBLEMesh::init");
+        return false;
+    }
+
+    if((BT_MESH_MODEL_OP_LEN(opcode) == 3) != m_vendor) {
+        NIMBLE_LOGE(LOG_TAG, "Invalid opcode 0x%06x for %s model", (unsigned)opcode,
+                    m_vendor ? "vendor" : "SIG");
+        return false;
+    }
+
+    auto it = std::lower_bound(m_opcodes.begin(), m_opcodes.end(),
+                               std::pair<uint32_t, size_t>(opcode, 0));
+    if(it != m_opcodes.end() && it->first == opcode) {
+        it->second = minLength;
+        return true;
+    }
+
+    m_opcodes.insert(it, std::pair<uint32_t, size_t>(opcode, minLength));
+    return true;
+} // addOpcode
+
+
+/**
+ * @brief Send a message from this model.
+ * @param [in] ctx The destination, the app key index and TTL of the message, or the context of a
+ * received message to reply to.
+ * @param [in] opcode The opcode of the message.
+ * @param [in] data The payload of the message.
+ * @param [in] length The length of the payload.
+ * @return True if the message was queued to send.
+ */
+bool NimBLEMeshModel::sendMessage(struct bt_mesh_msg_ctx* ctx, uint32_t opcode,
+                                  const uint8_t* data, size_t length)
+{
+    if(m_pModel == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Model not registered, call NimBLEMesh::init first");
+        return false;
+    }
+
+    if(BT_MESH_MODEL_BUF_LEN(opcode, length) > BT_MESH_TX_SDU_MAX) {
+        NIMBLE_LOGE(LOG_TAG, "Message too long; %u bytes", (unsigned)length);
+        return false;
+    }
+
+    struct os_mbuf* msg = NimBLEMesh::allocMessage();
+    if(msg == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "No mesh message buffers available");
+        return false;
+    }
+
+    bt_mesh_model_msg_init(msg, opcode);
+    if(length > 0 && os_mbuf_append(msg, data, length) != 0) {
+        os_mbuf_free_chain(msg);
+        return false;
+    }
+
+    // The message is copied into the network buffers so it can be freed when this returns.
+    int rc = bt_mesh_model_send(m_pModel, ctx, msg, nullptr, nullptr);
+    os_mbuf_free_chain(msg);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "bt_mesh_model_send: rc=%d", rc);
+        return false;
+    }
+
+    return true;
+} // sendMessage
+
+
+/**
+ * @brief Get the model ID.
+ */
+uint16_t NimBLEMeshModel::getModelId() {
+    return m_modelId;
+} // getModelId
+
+
+/**
+ * @brief Get the company identifier of a vendor model, 0 for SIG models.
+ */
+uint16_t NimBLEMeshModel::getCompanyId() {
+    return m_companyId;
+} // getCompanyId
+
+
+/**
+ * @brief Get whether this is a vendor model.
+ */
+bool NimBLEMeshModel::isVendor() {
+    return m_vendor;
+} // isVendor
+
+
+/**
+ * @brief Get the element the model was added to.
+ * @return A pointer to the element or nullptr if not added to one.
+ */
+NimBLEMeshElement* NimBLEMeshModel::getElement() {
+    return m_pElement;
+} // getElement
+
+
+/**
+ * @brief Default handler for received messages, does nothing.
+ * @param [in] opcode The opcode of the message.
+ * @param [in] ctx The context of the message.
+ * @param [in] buf The payload of the message.
+ */
+void NimBLEMeshModel::onMessage(uint32_t opcode, struct bt_mesh_msg_ctx* ctx, struct os_mbuf* buf) {
+    NIMBLE_LOGD(LOG_TAG, "Unhandled opcode 0x%06x from 0x%04x", (unsigned)opcode, ctx->addr);
+} // onMessage
+
+
+/**
+ * @brief Handler for all opcodes of the models, the mesh stack has found the model and checked the length.
+ * @param [in] model The model of the stack, the user data is a pointer to the NimBLEMeshModel.
+ * @param [in] ctx The context of the message, holds the opcode.
+ * @param [in] buf The payload of the message.
+ */
+void NimBLEMeshModel::handleMessage(struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+                                    struct os_mbuf* buf)
+{
+    NimBLEMeshModel* pModel = (NimBLEMeshModel*)model->user_data;
+    pModel->onMessage(ctx->recv_op, ctx, buf);
+} // handleMessage
+
+
+/**
+ * @brief Fill in the composition data entry of the model for the mesh stack.
+ * @param [in] pModel A pointer to the zeroed entry.
+ * @details The stack declares the entries const for static composition data, these are
+ * built once at run time before they are registered.
+ */
+void NimBLEMeshModel::initModel(struct bt_mesh_model* pModel) {
+    m_ops.clear();
+    m_ops.reserve(m_opcodes.size() + 1);
+    for(auto &it : m_opcodes) {
+        m_ops.push_back(bt_mesh_model_op{it.first, it.second, NimBLEMeshModel::handleMessage});
+    }
+    m_ops.push_back(bt_mesh_model_op{0, 0, nullptr});
+
+    if(m_vendor) {
+        pModel->vnd.company = m_companyId;
+        pModel->vnd.id      = m_modelId;
+    } else {
+        *const_cast<uint16_t*>(&pModel->id) = m_modelId;
+    }
+
+    *const_cast<const struct bt_mesh_model_op**>(&pModel->op) = m_ops.data();
+    pModel->user_data = this;
+    m_pModel = pModel;
+} // initModel
+
+
+/**
+ * @brief Construct an element, use NimBLEMesh::createElement.
+ * @param [in] index The index of the element, 0 is the primary element.
+ * @param [in] location The GATT namespace location descriptor of the element.
+ */
+NimBLEMeshElement::NimBLEMeshElement(uint8_t index, uint16_t location) {
+    m_index    = index;
+    m_location = location;
+    m_sigCount = 0;
+    m_vndCount = 0;
+    m_pModels  = nullptr;
+} // NimBLEMeshElement
+
+
+NimBLEMeshElement::~NimBLEMeshElement() {
+    for(auto &it : m_models) {
+        delete it;
+    }
+
+    free(m_pModels);
+} // ~NimBLEMeshElement
+
+
+/**
+ * @brief Add a model to the element, the element takes ownership of the model.
+ * @param [in] pModel A pointer to the model.
+ * @return True if the model was added.
+ */
+bool NimBLEMeshElement::addModel(NimBLEMeshModel* pModel) {
+    if(NimBLEMesh::m_initialized) {
+        NIMBLE_LOGE(LOG_TAG, "Models cannot be added after NimBLEMesh::init");
+        return false;
+    }
+
+    for(auto &it : m_models) {
+        if(it == pModel || (it->m_vendor == pModel->m_vendor &&
+           it->m_companyId == pModel->m_companyId && it->m_modelId == pModel->m_modelId))
+        {
+            NIMBLE_LOGE(LOG_TAG, "Model 0x%04x already in element %u", pModel->m_modelId, m_index);
+            return false;
+        }
+    }
+
+    pModel->m_pElement = this;
+    m_models.push_back(pModel);
+    return true;
+} // addModel
+
+
+/**
+ * @brief Get the models of the element.
+ */
+std::vector<NimBLEMeshModel*> NimBLEMeshElement::getModels() {
+    return m_models;
+} // getModels
+
+
+/**
+ * @brief Get the unicast address of the element.
+ * @return The address or BT_MESH_ADDR_UNASSIGNED if the node is not provisioned.
+ */
+uint16_t NimBLEMeshElement::getAddress() {
+    if(!NimBLEMesh::m_initialized || m_index >= NimBLEMesh::m_elems.size()) {
+        return BT_MESH_ADDR_UNASSIGNED;
+    }
+
+    return NimBLEMesh::m_elems[m_index].addr;
+} // getAddress
+
+
+/**
+ * @brief Build the composition data entries of the models, SIG models first then vendor models.
+ * @return True if the memory for the entries was allocated.
+ * @details The primary element starts with the configuration server model.
+ */
+bool NimBLEMeshElement::initModels() {
+    bool primary = m_index == 0;
+    m_sigCount = primary ? 1 : 0;
+    m_vndCount = 0;
+    for(auto &it : m_models) {
+        if(it->m_vendor) {
+            m_vndCount++;
+        } else {
+            m_sigCount++;
+        }
+    }
+
+    free(m_pModels);
+    m_pModels = (struct bt_mesh_model*)calloc(m_sigCount + m_vndCount, sizeof(struct bt_mesh_model));
+    if(m_pModels == nullptr) {
+        return false;
+    }
+
+    uint8_t sig = 0;
+    uint8_t vnd = m_sigCount;
+    if(primary) {
+        struct bt_mesh_model* pCfgSrv = &m_pModels[sig++];
+        *const_cast<uint16_t*>(&pCfgSrv->id) = BT_MESH_MODEL_ID_CFG_SRV;
+        *const_cast<const struct bt_mesh_model_op**>(&pCfgSrv->op) = bt_mesh_cfg_srv_op;
+        *const_cast<const struct bt_mesh_model_cb**>(&pCfgSrv->cb) = &bt_mesh_cfg_srv_cb;
+    }
+
+    for(auto &it : m_models) {
+        it->initModel(it->m_vendor ? &m_pModels[vnd++] : &m_pModels[sig++]);
+    }
+
+    return true;
+} // initModels
+
+
+/**
+ * @brief Create an element, the first element created is the primary element.
+ * @param [in] location The GATT namespace location descriptor of the element.
+ * @return A pointer to the element or nullptr if it cannot be created after NimBLEMesh::init.
+ */
+NimBLEMeshElement* NimBLEMesh::createElement(uint16_t location) {
+    if(m_initialized) {
+        NIMBLE_LOGE(LOG_TAG, "Elements cannot be created after NimBLEMesh::init");
+        return nullptr;
+    }
+
+    NimBLEMeshElement* pElement = new NimBLEMeshElement(m_elements.size(), location);
+    m_elements.push_back(pElement);
+    return pElement;
+} // createElement
+
+
+/**
+ * @brief Get an element by index.
+ * @param [in] index The index of the element, 0 is the primary element.
+ * @return A pointer to the element or nullptr if not found.
+ */
+NimBLEMeshElement* NimBLEMesh::getElement(uint8_t index) {
+    if(index >= m_elements.size()) {
+        return nullptr;
+    }
+
+    return m_elements[index];
+} // getElement
+
+
+/**
+ * @brief Register the elements and models and start the mesh stack.
+ * @param [in] prov The provisioning properties and callbacks of the node, must remain valid.
+ * @param [in] companyId The company identifier of the node in the composition data.
+ * @param [in] productId The product identifier of the node.
+ * @param [in] versionId The product version identifier of the node.
+ * @return True if the mesh stack was started.
+ * @details Must be called after NimBLEDevice::init and, when the mesh proxy is enabled,
+ * before NimBLEServer::start so the proxy services are registered.
+ * A primary element is created if none were.
+ */
+bool NimBLEMesh::init(const struct bt_mesh_prov* prov, uint16_t companyId,
+                      uint16_t productId, uint16_t versionId)
+{
+    if(m_initialized) {
+        return true;
+    }
+
+    if(!NimBLEDevice::getInitialized()) {
+        NIMBLE_LOGE(LOG_TAG, "NimBLEDevice::init must be called first");
+        return false;
+    }
+
+    if(m_elements.empty()) {
+        createElement();
+    }
+
+#if CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT > 0
+    if(!meshMsgPoolInit) {
+        int rc = os_mempool_init(&meshMsgPool, CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT,
+                                 MESH_MSG_BLOCK_SIZE, meshMsgPoolMem, "nimble_cpp_mesh_msg_pool");
+        assert(rc == 0);
+        rc = os_mbuf_pool_init(&meshMsgMbufPool, &meshMsgPool, MESH_MSG_BLOCK_SIZE,
+                               CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT);
+        assert(rc == 0);
+        meshMsgPoolInit = true;
+    }
+#endif
+
+    m_elems.clear();
+    m_elems.reserve(m_elements.size());
+    for(auto &it : m_elements) {
+        if(!it->initModels()) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to allocate the mesh models");
+            return false;
+        }
+
+        m_elems.push_back(bt_mesh_elem{0, it->m_location, it->m_sigCount, it->m_vndCount,
+                                       it->m_pModels, it->m_pModels + it->m_sigCount});
+    }
+
+    m_comp.cid        = companyId;
+    m_comp.pid        = productId;
+    m_comp.vid        = versionId;
+    m_comp.elem_count = m_elems.size();
+    m_comp.elem       = m_elems.data();
+
+#if MYNEWT_VAL(BLE_MESH_PROXY)
+    bt_mesh_register_gatt();
+#endif
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    // Share one scan with NimBLEScan instead of the mesh stack running its own.
+    NimBLEDevice::getScan();
+    bt_mesh_scan_ctrl_set(NimBLEScan::meshScanControl);
+#endif
+
+    int rc = bt_mesh_init(NimBLEDevice::m_own_addr_type, prov, &m_comp);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "bt_mesh_init: rc=%d", rc);
+        return false;
+    }
+
+    m_initialized = true;
+    return true;
+} // init
+
+
+/**
+ * @brief Allow the node to be provisioned over the given bearers.
+ * @param [in] bearers The provisioning bearers, BT_MESH_PROV_ADV and/or BT_MESH_PROV_GATT.
+ * @return True if provisioning was enabled.
+ */
+bool NimBLEMesh::enableProvisioning(bt_mesh_prov_bearer_t bearers) {
+    if(!m_initialized) {
+        return false;
+    }
+
+    int rc = bt_mesh_prov_enable(bearers);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "bt_mesh_prov_enable: rc=%d", rc);
+        return false;
+    }
+
+    return true;
+} // enableProvisioning
+
+
+/**
+ * @brief Get whether the mesh stack was started with init().
+ */
+bool NimBLEMesh::isInitialized() {
+    return m_initialized;
+} // isInitialized
+
+
+/**
+ * @brief Get whether the node has been provisioned into a network.
+ */
+bool NimBLEMesh::isProvisioned() {
+    return m_initialized && bt_mesh_is_provisioned();
+} // isProvisioned
+
+
+/**
+ * @brief Get a buffer to build a model message in.
+ * @return A pointer to the buffer or nullptr if none are free.
+ */
+struct os_mbuf* NimBLEMesh::allocMessage() {
+#if CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT > 0
+    return os_mbuf_get_pkthdr(&meshMsgMbufPool, 0);
+#else
+    return os_msys_get_pkthdr(BT_MESH_TX_SDU_MAX, 0);
+#endif
+} // allocMessage
+
+
+/**
+ * @brief Called by NimBLEDevice::deinit after the host is stopped, init() must be called again after
+ * NimBLEDevice::init to restart the mesh stack.
+ * @param [in] clearAll If true, deletes the elements and models.
+ */
+void NimBLEMesh::deinit(bool clearAll) {
+    m_initialized = false;
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    bt_mesh_scan_ctrl_set(nullptr);
+    if(NimBLEDevice::m_pScan != nullptr) {
+        NimBLEDevice::m_pScan->m_meshScan = false;
+    }
+#endif
+
+    if(clearAll) {
+        for(auto &it : m_elements) {
+            delete it;
+        }
+
+        m_elements.clear();
+        m_elems.clear();
+    }
+} // deinit
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_MESH */
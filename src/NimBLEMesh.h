@@ -0,0 +1,145 @@
+/*
+ * NimBLEMesh.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEMESH_H_
+#define NIMBLEMESH_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_MESH)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "mesh/glue.h"
+#include "mesh/access.h"
+#include "mesh/main.h"
+#else
+#include "nimble/nimble/host/mesh/include/mesh/glue.h"
+#include "nimble/nimble/host/mesh/include/mesh/access.h"
+#include "nimble/nimble/host/mesh/include/mesh/main.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <vector>
+#include <utility>
+
+#ifndef CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT
+#define CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT 4
+#endif
+
+class NimBLEMeshElement;
+
+
+/**
+ * @brief A mesh model, derive from this class and override onMessage to handle the opcodes added with addOpcode.
+ * @details The opcodes of all models are indexed by the mesh stack when NimBLEMesh::init is called,
+ * so addOpcode must be called before then.
+ */
+class NimBLEMeshModel {
+public:
+    NimBLEMeshModel(uint16_t modelId);
+    NimBLEMeshModel(uint16_t companyId, uint16_t modelId);
+    virtual ~NimBLEMeshModel() {};
+
+    bool                addOpcode(uint32_t opcode, size_t minLength = 0);
+    bool                sendMessage(struct bt_mesh_msg_ctx* ctx, uint32_t opcode,
+                                    const uint8_t* data, size_t length);
+    uint16_t            getModelId();
+    uint16_t            getCompanyId();
+    bool                isVendor();
+    NimBLEMeshElement*  getElement();
+
+    /**
+     * @brief Called when a message with one of the opcodes of the model is received.
+     * @param [in] opcode The opcode of the message.
+     * @param [in] ctx The context of the message, use it with sendMessage to reply.
+     * @param [in] buf The payload of the message, after the opcode.
+     */
+    virtual void        onMessage(uint32_t opcode, struct bt_mesh_msg_ctx* ctx, struct os_mbuf* buf);
+
+private:
+    friend class NimBLEMeshElement;
+    friend class NimBLEMesh;
+
+    static void         handleMessage(struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+                                      struct os_mbuf* buf);
+    void                initModel(struct bt_mesh_model* pModel);
+
+    uint16_t                                 m_companyId;
+    uint16_t                                 m_modelId;
+    bool                                     m_vendor;
+    NimBLEMeshElement*                       m_pElement;
+    struct bt_mesh_model*                    m_pModel;
+    std::vector<std::pair<uint32_t, size_t>> m_opcodes;
+    std::vector<struct bt_mesh_model_op>     m_ops;
+}; // NimBLEMeshModel
+
+
+/**
+ * @brief A mesh element, an addressable group of models, create it with NimBLEMesh::createElement.
+ */
+class NimBLEMeshElement {
+public:
+    bool                           addModel(NimBLEMeshModel* pModel);
+    std::vector<NimBLEMeshModel*>  getModels();
+    uint16_t                       getAddress();
+
+private:
+    friend class NimBLEMesh;
+
+    NimBLEMeshElement(uint8_t index, uint16_t location);
+    ~NimBLEMeshElement();
+
+    bool                           initModels();
+
+    uint8_t                        m_index;
+    uint16_t                       m_location;
+    uint8_t                        m_sigCount;
+    uint8_t                        m_vndCount;
+    std::vector<NimBLEMeshModel*>  m_models;
+    struct bt_mesh_model*          m_pModels;
+}; // NimBLEMeshElement
+
+
+/**
+ * @brief Sets up the mesh node from the elements and models created and starts the mesh stack.
+ * @details NimBLEDevice::init must be called first. The configuration server model required
+ * on the primary element is added by init(). Messages sent by models are built in buffers
+ * from a pool of CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT buffers allocated once.\n
+ * The mesh stack shares the scanner with NimBLEScan, while the application is not scanning a
+ * continuous scan is run for the mesh, which an application scan replaces until it ends.
+ * Mesh advertisements are handled by the mesh stack and are not reported to NimBLEScan callbacks.
+ */
+class NimBLEMesh {
+public:
+    static NimBLEMeshElement*  createElement(uint16_t location = 0);
+    static NimBLEMeshElement*  getElement(uint8_t index);
+    static bool                init(const struct bt_mesh_prov* prov, uint16_t companyId = 0xFFFF,
+                                    uint16_t productId = 0, uint16_t versionId = 0);
+    static bool                enableProvisioning(bt_mesh_prov_bearer_t bearers);
+    static bool                isInitialized();
+    static bool                isProvisioned();
+
+private:
+    friend class NimBLEDevice;
+    friend class NimBLEMeshModel;
+    friend class NimBLEMeshElement;
+
+    static struct os_mbuf*     allocMessage();
+    static void                deinit(bool clearAll);
+
+    static std::vector<NimBLEMeshElement*> m_elements;
+    static std::vector<struct bt_mesh_elem> m_elems;
+    static struct bt_mesh_comp             m_comp;
+    static bool                            m_initialized;
+}; // NimBLEMesh
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_MESH */
+#endif /* NIMBLEMESH_H_ */
@@ -0,0 +1,89 @@
+/*
+ * NimBLENotifyPolicy.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLENotifyPolicy.h"
+
+#include <string.h>
+
+
+/**
+ * @brief Construct a disabled notify policy, notifications are sent when notify is called.
+ */
+NimBLENotifyPolicy::NimBLENotifyPolicy()
+: NimBLENotifyPolicy(0, 0, 0)
+{
+} // NimBLENotifyPolicy
+
+
+/**
+ * @brief Construct a notify policy.
+ * @param [in] minMs The shortest time between two notifications in milliseconds.
+ * @param [in] maxMs The longest time without a notification in milliseconds, 0 to only send on change.
+ * @param [in] threshold The smallest change from the value last sent that is notified, 0 for any change.
+ */
+NimBLENotifyPolicy::NimBLENotifyPolicy(uint32_t minMs, uint32_t maxMs, uint32_t threshold)
+: minIntervalMs(minMs),
+  maxIntervalMs(maxMs),
+  changeThreshold(threshold),
+  signedValue(false)
+{
+} // NimBLENotifyPolicy
+
+
+/**
+ * @brief Check if the policy limits the notifications.
+ * @return False if every notification is sent when notify is called.
+ */
+bool NimBLENotifyPolicy::isEnabled() const {
+    return minIntervalMs != 0 || maxIntervalMs != 0 || changeThreshold != 0;
+} // isEnabled
+
+
+/**
+ * @brief Check if a value differs enough from the value last sent to be notified.
+ * @param [in] last The value last sent.
+ * @param [in] lastLength The length of the value last sent.
+ * @param [in] value The new value.
+ * @param [in] length The length of the new value.
+ * @return True if the value should be notified.
+ */
+bool NimBLENotifyPolicy::isChange(const uint8_t* last, size_t lastLength,
+                                  const uint8_t* value, size_t length) const
+{
+    if(length != lastLength) {
+        return true;
+    }
+
+    if(changeThreshold == 0 || (length != 1 && length != 2 && length != 4)) {
+        return memcmp(last, value, length) != 0;
+    }
+
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for(size_t i = 0; i < length; i++) {
+        a |= (uint32_t)last[i] << (8 * i);
+        b |= (uint32_t)value[i] << (8 * i);
+    }
+
+    int64_t delta;
+    if(signedValue) {
+        uint32_t sign = 1UL << (8 * length - 1);
+        int64_t sa = (int64_t)(a ^ sign) - sign;
+        int64_t sb = (int64_t)(b ^ sign) - sign;
+        delta = sb - sa;
+    } else {
+        delta = (int64_t)b - a;
+    }
+
+    return (delta < 0 ? -delta : delta) >= changeThreshold;
+} // isChange
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
@@ -0,0 +1,53 @@
+/*
+ * NimBLENotifyPolicy.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLENOTIFYPOLICY_H_
+#define NIMBLENOTIFYPOLICY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include <stdint.h>
+#include <stddef.h>
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+/**
+ * @brief Limits the rate of the notifications of a characteristic.
+ * @details With a policy set, NimBLECharacteristic::notify stores the value and marks the characteristic
+ * dirty, the server then sends the latest value no sooner than minIntervalMs after the previous
+ * notification, and only if it differs from the value last sent by at least changeThreshold.
+ * With maxIntervalMs set the value is also sent when nothing was sent for that long, changed or not.
+ * Indications are not affected.
+ */
+class NimBLENotifyPolicy {
+public:
+    NimBLENotifyPolicy();
+    NimBLENotifyPolicy(uint32_t minMs, uint32_t maxMs = 0, uint32_t threshold = 0);
+
+    bool     isEnabled() const;
+    bool     isChange(const uint8_t* last, size_t lastLength, const uint8_t* value, size_t length) const;
+
+    /** @brief The shortest time between two notifications in milliseconds. */
+    uint32_t minIntervalMs;
+    /** @brief The longest time without a notification in milliseconds, 0 to only send on change. */
+    uint32_t maxIntervalMs;
+    /**
+     * @brief The smallest change from the value last sent that is notified, 0 for any change. Applied to
+     * values of 1, 2 or 4 bytes read as little endian integers, other values are sent on any change.
+     */
+    uint32_t changeThreshold;
+    /** @brief True to read the values as signed integers for the change threshold. */
+    bool     signedValue;
+}; // NimBLENotifyPolicy
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* NIMBLENOTIFYPOLICY_H_ */
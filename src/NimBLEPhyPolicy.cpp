@@ -0,0 +1,232 @@
+/*
+ * NimBLEPhyPolicy.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#include "NimBLEPhyPolicy.h"
+#include "NimBLEConnStates.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+// Number of readings to wait for a requested PHY update before requesting again.
+#define NIMBLE_CPP_PHY_PENDING_READINGS 5
+
+static const char* LOG_TAG = "NimBLEPhyPolicy";
+
+typedef struct {
+    uint16_t          connHandle  = BLE_HS_CONN_HANDLE_NONE;
+    uint8_t           strong      = 0;
+    uint8_t           weak        = 0;
+    uint8_t           pending     = 0;
+    uint8_t           requested   = 0;
+    uint8_t           unsupported = 0;
+    NimBLEPhyPolicy   policy;
+    ble_npl_callout   timer;
+} ble_phy_state_t;
+
+static NimBLEConnStates<ble_phy_state_t> phyStates;
+
+
+/**
+ * @brief Construct a disabled PHY policy.
+ */
+NimBLEPhyPolicy::NimBLEPhyPolicy() {
+    intervalMs   = 0;
+    rssi2M       = -60;
+    rssiCoded    = -85;
+    samples      = 3;
+    codedOptions = BLE_GAP_LE_PHY_CODED_ANY;
+} // NimBLEPhyPolicy
+
+
+/**
+ * @brief Get a PHY policy that reads the RSSI every 2 seconds and switches to 2M at -60dBm
+ * or above and to Coded at -85dBm or below after 3 readings.
+ * @return The adaptive PHY policy.
+ */
+NimBLEPhyPolicy NimBLEPhyPolicy::adaptive() {
+    NimBLEPhyPolicy policy;
+    policy.intervalMs = 2000;
+    return policy;
+} // adaptive
+
+
+/**
+ * @brief Find the policy state of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @return A pointer to the state or nullptr if the policy is not running on the connection.
+ */
+static ble_phy_state_t* phyFindState(uint16_t conn_handle) {
+    return phyStates.find(conn_handle);
+} // phyFindState
+
+
+/**
+ * @brief Timer callback, reads the RSSI and requests a PHY change when the thresholds are crossed.
+ */
+static void phyTimerCb(ble_npl_event *event) {
+    ble_phy_state_t *state = (ble_phy_state_t*)ble_npl_event_get_arg(event);
+    const NimBLEPhyPolicy &policy = state->policy;
+    int8_t rssi;
+    uint8_t txPhy;
+    uint8_t rxPhy;
+
+    if(state->connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+
+    if(ble_gap_conn_rssi(state->connHandle, &rssi) != 0 ||
+       ble_gap_read_le_phy(state->connHandle, &txPhy, &rxPhy) != 0) {
+        return;
+    }
+
+    if(rssi >= policy.rssi2M) {
+        state->weak = 0;
+        if(state->strong < policy.samples) {
+            state->strong++;
+        }
+    } else if(rssi <= policy.rssiCoded) {
+        state->strong = 0;
+        if(state->weak < policy.samples) {
+            state->weak++;
+        }
+    } else {
+        state->strong = 0;
+        state->weak   = 0;
+    }
+
+    if(state->pending > 0) {
+        state->pending--;
+        return;
+    }
+
+    uint8_t phy     = 0;
+    uint8_t mask    = 0;
+    uint16_t option = 0;
+
+    if(state->strong >= policy.samples) {
+        phy  = BLE_HCI_LE_PHY_2M;
+        mask = BLE_GAP_LE_PHY_2M_MASK;
+    } else if(state->weak >= policy.samples) {
+        phy    = BLE_HCI_LE_PHY_CODED;
+        mask   = BLE_GAP_LE_PHY_CODED_MASK;
+        option = policy.codedOptions;
+    }
+
+    if(mask == 0 || txPhy == phy || (state->unsupported & mask)) {
+        return;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "Requesting PHY %u; conn_handle=%u rssi=%d", phy, state->connHandle, rssi);
+    int rc = ble_gap_set_prefered_le_phy(state->connHandle, mask, mask, option);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "PHY update failed; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return;
+    }
+
+    state->requested = mask;
+    state->pending   = NIMBLE_CPP_PHY_PENDING_READINGS;
+} // phyTimerCb
+
+
+/**
+ * @brief Release the policy state of a connection.
+ * @param [in] state The policy state.
+ */
+static void phyStop(ble_phy_state_t *state) {
+    ble_npl_callout_stop(&state->timer);
+    ble_npl_callout_deinit(&state->timer);
+    state->connHandle = BLE_HS_CONN_HANDLE_NONE;
+} // phyStop
+
+
+/**
+ * @brief Start switching the PHY of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] policy The thresholds to switch at, the policy is not started if intervalMs is 0.
+ * @return True if the policy was started.
+ */
+bool NimBLEPhyPolicy::start(uint16_t conn_handle, const NimBLEPhyPolicy &policy) {
+    if(policy.intervalMs == 0) {
+        return false;
+    }
+
+    ble_phy_state_t *state = phyStates.claim(conn_handle);
+    if(state == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "PHY policy already running or no state available");
+        return false;
+    }
+
+    NimBLEDevice::gapSubscribe(conn_handle, NimBLEDevice::GAP_SUB_PHY_POLICY);
+
+    state->policy      = policy;
+    state->strong      = 0;
+    state->weak        = 0;
+    state->pending     = 0;
+    state->requested   = 0;
+    state->unsupported = 0;
+
+    ble_npl_callout_init(&state->timer, nimble_port_get_dflt_eventq(), phyTimerCb, state);
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+    return true;
+} // start
+
+
+/**
+ * @brief Handle the GAP events of a connection the policy is running on.
+ * @param [in] event The GAP event, called by the client and server event handlers.
+ */
+void NimBLEPhyPolicy::handleGapEvent(struct ble_gap_event *event) {
+    ble_phy_state_t *state;
+
+    switch(event->type) {
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: {
+            state = phyFindState(event->phy_updated.conn_handle);
+            if(state == nullptr || state->requested == 0) {
+                break;
+            }
+
+            uint8_t phy = state->requested == BLE_GAP_LE_PHY_2M_MASK ? BLE_HCI_LE_PHY_2M
+                                                                      : BLE_HCI_LE_PHY_CODED;
+            if(event->phy_updated.status != 0 || event->phy_updated.tx_phy != phy) {
+                NIMBLE_LOGD(LOG_TAG, "Peer did not switch to PHY %u; conn_handle=%u",
+                            phy, state->connHandle);
+                state->unsupported |= state->requested;
+            }
+
+            state->requested = 0;
+            state->pending   = 0;
+            break;
+        }
+
+        case BLE_GAP_EVENT_DISCONNECT: {
+            state = phyFindState(event->disconnect.conn.conn_handle);
+            if(state != nullptr) {
+                phyStop(state);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+} // handleGapEvent
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
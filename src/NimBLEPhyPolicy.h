@@ -0,0 +1,60 @@
+/*
+ * NimBLEPhyPolicy.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEPHYPOLICY_H_
+#define NIMBLEPHYPOLICY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+/**
+ * @brief Switches the PHY of a connection from the RSSI of the peer.
+ * @details The RSSI is read every interval, when it has been at or above rssi2M for the number of
+ * samples in a row the 2M PHY is requested, when it has been at or below rssiCoded the Coded PHY
+ * is requested. Between the two thresholds the current PHY is kept. A PHY the peer did not switch
+ * to is not requested again on that connection.
+ */
+class NimBLEPhyPolicy {
+public:
+    NimBLEPhyPolicy();
+
+    static NimBLEPhyPolicy adaptive();
+
+    /** @brief The time between RSSI readings in milliseconds, 0 disables the policy. */
+    uint32_t intervalMs;
+    /** @brief The RSSI at or above which the 2M PHY is requested. */
+    int8_t   rssi2M;
+    /** @brief The RSSI at or below which the Coded PHY is requested. */
+    int8_t   rssiCoded;
+    /** @brief The number of readings in a row past a threshold before switching. */
+    uint8_t  samples;
+    /** @brief The Coded PHY option, BLE_GAP_LE_PHY_CODED_ANY, _S2 or _S8. */
+    uint16_t codedOptions;
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    static bool start(uint16_t conn_handle, const NimBLEPhyPolicy &policy);
+    static void handleGapEvent(struct ble_gap_event *event);
+}; // NimBLEPhyPolicy
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLEPHYPOLICY_H_ */
@@ -0,0 +1,226 @@
+/*
+ * NimBLEPowerPolicy.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#include "NimBLEPowerPolicy.h"
+#include "NimBLEConnStates.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+#ifdef ESP_PLATFORM
+#include "esp_bt.h"
+#endif
+
+#include <algorithm>
+
+static const char* LOG_TAG = "NimBLEPowerPolicy";
+
+typedef struct {
+    uint16_t          connHandle = BLE_HS_CONN_HANDLE_NONE;
+    int16_t           rssiAvg    = 0; // In 1/16 dBm.
+    uint8_t           strong     = 0;
+    int8_t            dbm        = 0;
+    NimBLEPowerPolicy policy;
+    ble_npl_callout   timer;
+} ble_power_state_t;
+
+static NimBLEConnStates<ble_power_state_t> powerStates;
+
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Set the power of a connection with the ESP32 controller API.
+ * @details The levels are in 3dB steps from ESP_PWR_LVL_N12 on all of the ESP32 controllers,
+ * the power is rounded down to a level between -12 and +9dBm.
+ */
+static int espSetTxPower(uint16_t connHandle, int8_t dbm) {
+    if(connHandle > ESP_BLE_PWR_TYPE_CONN_HDL8 - ESP_BLE_PWR_TYPE_CONN_HDL0) {
+        return BLE_HS_ENOTSUP;
+    }
+
+    dbm = std::min<int8_t>(std::max<int8_t>(dbm, -12), 9);
+    esp_power_level_t level = (esp_power_level_t)(ESP_PWR_LVL_N12 + (dbm + 12) / 3);
+    esp_err_t err = esp_ble_tx_power_set((esp_ble_power_type_t)(ESP_BLE_PWR_TYPE_CONN_HDL0 + connHandle), level);
+    return err == ESP_OK ? 0 : BLE_HS_EUNKNOWN;
+} // espSetTxPower
+#endif
+
+
+/**
+ * @brief Construct a disabled power policy.
+ */
+NimBLEPowerPolicy::NimBLEPowerPolicy() {
+    intervalMs = 0;
+    rssiHigh   = -50;
+    rssiLow    = -70;
+    samples    = 3;
+    minDbm     = -12;
+    maxDbm     = 9;
+    stepDb     = 3;
+#ifdef ESP_PLATFORM
+    setTxPower = espSetTxPower;
+#else
+    setTxPower = nullptr;
+#endif
+} // NimBLEPowerPolicy
+
+
+/**
+ * @brief Get a power policy that reads the RSSI every second and keeps it between -70 and -50dBm,
+ * with the power between -12 and +9dBm in 3dB steps.
+ * @return The adaptive power policy.
+ */
+NimBLEPowerPolicy NimBLEPowerPolicy::adaptive() {
+    NimBLEPowerPolicy policy;
+    policy.intervalMs = 1000;
+    return policy;
+} // adaptive
+
+
+/**
+ * @brief Get the transmit power the policy set on a connection.
+ * @param [in] conn_handle The connection handle.
+ * @return The power in dBm, or 127 if the policy is not running on the connection.
+ */
+int8_t NimBLEPowerPolicy::getTxPower(uint16_t conn_handle) {
+    ble_npl_hw_enter_critical();
+    ble_power_state_t *state = powerStates.find(conn_handle);
+    int8_t dbm = state != nullptr ? state->dbm : 127;
+    ble_npl_hw_exit_critical(0);
+    return dbm;
+} // getTxPower
+
+
+/**
+ * @brief Set the transmit power of a connection.
+ * @param [in] state The policy state.
+ * @param [in] dbm The power in dBm, within the policy limits.
+ */
+static void powerSet(ble_power_state_t *state, int8_t dbm) {
+    int rc = state->policy.setTxPower(state->connHandle, dbm);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Set TX power failed; conn_handle=%u rc=%d", state->connHandle, rc);
+        return;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "TX power %d dBm; conn_handle=%u", dbm, state->connHandle);
+    state->dbm = dbm;
+} // powerSet
+
+
+/**
+ * @brief Timer callback, reads the RSSI and steps the power when it leaves the target range.
+ */
+static void powerTimerCb(ble_npl_event *event) {
+    ble_power_state_t *state = (ble_power_state_t*)ble_npl_event_get_arg(event);
+    const NimBLEPowerPolicy &policy = state->policy;
+    int8_t rssi;
+
+    if(state->connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+
+    if(ble_gap_conn_rssi(state->connHandle, &rssi) != 0 || rssi == 127) {
+        return;
+    }
+
+    // The first reading seeds the average, then each reading moves it by 1/4.
+    if(state->rssiAvg == 0) {
+        state->rssiAvg = rssi * 16;
+    } else {
+        state->rssiAvg += (rssi * 16 - state->rssiAvg) / 4;
+    }
+
+    int8_t avg = state->rssiAvg / 16;
+    if(avg < policy.rssiLow || rssi < policy.rssiLow) {
+        // Raise at once on a weak reading, so a fading link does not wait for the average.
+        state->strong = 0;
+        if(state->dbm < policy.maxDbm) {
+            powerSet(state, std::min<int>(state->dbm + policy.stepDb, policy.maxDbm));
+            // The RSSI the peer sees goes up with the power, so should the average.
+            state->rssiAvg += policy.stepDb * 16;
+        }
+    } else if(avg > policy.rssiHigh) {
+        if(++state->strong >= policy.samples && state->dbm > policy.minDbm) {
+            state->strong = 0;
+            powerSet(state, std::max<int>(state->dbm - policy.stepDb, policy.minDbm));
+            state->rssiAvg -= policy.stepDb * 16;
+        }
+    } else {
+        state->strong = 0;
+    }
+} // powerTimerCb
+
+
+/**
+ * @brief Start adjusting the transmit power of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] policy The target RSSI range and power limits, the policy is not started if intervalMs is 0.
+ * @return True if the policy was started.
+ */
+bool NimBLEPowerPolicy::start(uint16_t conn_handle, const NimBLEPowerPolicy &policy) {
+    if(policy.intervalMs == 0) {
+        return false;
+    }
+
+    if(policy.setTxPower == nullptr || policy.minDbm > policy.maxDbm || policy.stepDb == 0) {
+        NIMBLE_LOGE(LOG_TAG, "Power policy has no TX power setter or invalid limits");
+        return false;
+    }
+
+    ble_power_state_t *state = powerStates.claim(conn_handle);
+    if(state == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Power policy already running or no state available");
+        return false;
+    }
+
+    NimBLEDevice::gapSubscribe(conn_handle, NimBLEDevice::GAP_SUB_POWER_POLICY);
+
+    state->policy  = policy;
+    state->rssiAvg = 0;
+    state->strong  = 0;
+    state->dbm     = policy.maxDbm;
+    powerSet(state, policy.maxDbm);
+
+    ble_npl_callout_init(&state->timer, nimble_port_get_dflt_eventq(), powerTimerCb, state);
+    ble_npl_callout_reset(&state->timer, ble_npl_time_ms_to_ticks32(policy.intervalMs));
+    return true;
+} // start
+
+
+/**
+ * @brief Handle the GAP events of a connection the policy is running on.
+ * @param [in] event The GAP event, called by the client and server event handlers.
+ */
+void NimBLEPowerPolicy::handleGapEvent(struct ble_gap_event *event) {
+    if(event->type != BLE_GAP_EVENT_DISCONNECT) {
+        return;
+    }
+
+    ble_power_state_t *state = powerStates.find(event->disconnect.conn.conn_handle);
+    if(state != nullptr) {
+        ble_npl_callout_stop(&state->timer);
+        ble_npl_callout_deinit(&state->timer);
+        state->connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
+} // handleGapEvent
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
@@ -0,0 +1,74 @@
+/*
+ * NimBLEPowerPolicy.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEPOWERPOLICY_H_
+#define NIMBLEPOWERPOLICY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL) || defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+/**
+ * @brief Sets the transmit power of a connection, returns 0 on success or an error code.
+ */
+typedef int (*NimBLETxPowerSetter)(uint16_t connHandle, int8_t dbm);
+
+/**
+ * @brief Adjusts the transmit power of a connection from the RSSI of the peer.
+ * @details The RSSI is read every interval from the host task and averaged. When the average has
+ * been above rssiHigh for the number of samples in a row the transmit power is lowered by stepDb,
+ * as soon as it is below rssiLow it is raised by stepDb, so a fading link recovers in one interval.
+ * The link is assumed symmetric, the peer receives us about as well as we receive it.\n
+ * The power is set with setTxPower, on ESP32 the default sets the power of the connection handle
+ * with the controller vendor API. Other controllers need a setter, the policy is not started without one.
+ */
+class NimBLEPowerPolicy {
+public:
+    NimBLEPowerPolicy();
+
+    static NimBLEPowerPolicy adaptive();
+    static int8_t            getTxPower(uint16_t conn_handle);
+
+    /** @brief The time between RSSI readings in milliseconds, 0 disables the policy. */
+    uint32_t            intervalMs;
+    /** @brief The average RSSI above which the power is lowered. */
+    int8_t              rssiHigh;
+    /** @brief The average RSSI below which the power is raised. */
+    int8_t              rssiLow;
+    /** @brief The number of readings in a row above rssiHigh before lowering the power. */
+    uint8_t             samples;
+    /** @brief The lowest transmit power in dBm. */
+    int8_t              minDbm;
+    /** @brief The highest transmit power in dBm, also the power set when the connection starts. */
+    int8_t              maxDbm;
+    /** @brief The power change of each adjustment in dB. */
+    uint8_t             stepDb;
+    /** @brief The function setting the power of a connection, nullptr to use the default. */
+    NimBLETxPowerSetter setTxPower;
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    static bool start(uint16_t conn_handle, const NimBLEPowerPolicy &policy);
+    static void handleGapEvent(struct ble_gap_event *event);
+}; // NimBLEPowerPolicy
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_CENTRAL || CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) */
+#endif /* NIMBLEPOWERPOLICY_H_ */
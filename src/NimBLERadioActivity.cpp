@@ -0,0 +1,440 @@
+/*
+ * NimBLERadioActivity.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#include "NimBLERadioActivity.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+
+#include "NimBLEUtils.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+#  define NIMBLE_RADIO_ADV_INSTANCES (CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES + 1)
+#else
+#  define NIMBLE_RADIO_ADV_INSTANCES 1
+#endif
+
+/** The radio time of a connection event exchanging an empty packet in each direction. */
+#define NIMBLE_RADIO_CONN_EVENT_US 400
+
+typedef struct {
+    bool      active = false;
+    uint64_t  start = 0;
+    uint32_t  duty = 0;        // In 1/1000 of the time.
+} radio_scan_t;
+
+typedef struct {
+    bool      active = false;
+    uint64_t  start = 0;
+    uint32_t  itvlUs = 0;      // The mean time between advertising events.
+    uint16_t  eventUs = 0;
+} radio_adv_t;
+
+typedef struct {
+    uint16_t  connHandle = BLE_HS_CONN_HANDLE_NONE;
+    uint64_t  start = 0;
+    uint32_t  itvlUs = 0;
+} radio_conn_t;
+
+static NimBLERadioActivity totals;
+static uint64_t            resetTime = 0;
+static radio_scan_t        scanState;
+static radio_adv_t         advState[NIMBLE_RADIO_ADV_INSTANCES];
+static radio_conn_t        connState[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+
+
+/**
+ * @brief Add the time of the running scan up to now, call with interrupts disabled.
+ */
+static void addScan(NimBLERadioActivity &activity, uint64_t now) {
+    if(!scanState.active || now <= scanState.start) {
+        return;
+    }
+
+    uint64_t elapsed = now - scanState.start;
+    activity.scanUs += elapsed;
+    activity.scanRadioUs += elapsed * scanState.duty / 1000;
+} // addScan
+
+
+/**
+ * @brief Add the time of a running advertising instance up to now, call with interrupts disabled.
+ */
+static void addAdv(NimBLERadioActivity &activity, const radio_adv_t &adv, uint64_t now) {
+    if(!adv.active || now <= adv.start) {
+        return;
+    }
+
+    uint64_t elapsed = now - adv.start;
+    uint32_t events = adv.itvlUs ? elapsed / adv.itvlUs : 0;
+    activity.advUs += elapsed;
+    activity.advEvents += events;
+    activity.advRadioUs += (uint64_t)events * adv.eventUs;
+} // addAdv
+
+
+/**
+ * @brief Add the time of an open connection up to now, call with interrupts disabled.
+ */
+static void addConn(NimBLERadioActivity &activity, const radio_conn_t &conn, uint64_t now) {
+    if(conn.connHandle == BLE_HS_CONN_HANDLE_NONE || now <= conn.start) {
+        return;
+    }
+
+    uint64_t elapsed = now - conn.start;
+    uint32_t events = conn.itvlUs ? elapsed / conn.itvlUs : 0;
+    activity.connUs += elapsed;
+    activity.connEvents += events;
+    activity.connRadioUs += (uint64_t)events * NIMBLE_RADIO_CONN_EVENT_US;
+} // addConn
+
+
+/**
+ * @brief Find the state of a connection, call with interrupts disabled.
+ */
+static radio_conn_t* findConn(uint16_t connHandle) {
+    for(auto &it : connState) {
+        if(it.connHandle == connHandle) {
+            return &it;
+        }
+    }
+    return nullptr;
+} // findConn
+
+
+/**
+ * @brief Get the time of the connection interval of a connection.
+ */
+static uint32_t connItvlUs(uint16_t connHandle) {
+    ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(connHandle, &desc) != 0) {
+        return 0;
+    }
+    return desc.conn_itvl * 1250;
+} // connItvlUs
+
+
+/**
+ * @brief Get the share of the time the radio receives when scanning with an interval and window.
+ * @param [in] itvl The scan interval in 0.625ms units, 0 for the host default.
+ * @param [in] window The scan window in 0.625ms units, 0 for the host default.
+ * @return The duty in 1/1000 of the time.
+ */
+/* STATIC */
+uint16_t NimBLERadioActivity::scanDuty(uint16_t itvl, uint16_t window) {
+    if(itvl == 0) {
+        itvl = BLE_GAP_SCAN_FAST_INTERVAL_MIN;
+    }
+    if(window == 0) {
+        window = BLE_GAP_SCAN_FAST_WINDOW;
+    }
+    return window >= itvl ? 1000 : (uint32_t)window * 1000 / itvl;
+} // scanDuty
+
+
+/**
+ * @brief Estimate the radio time of an advertising event on the 3 primary channels.
+ * @param [in] legacy True for legacy PDU's, false for extended ones that also send an auxiliary packet.
+ * @param [in] scannable True if the advertiser listens for requests after each packet.
+ * @param [in] primaryPhy The primary PHY, BLE_HCI_LE_PHY_1M or BLE_HCI_LE_PHY_CODED.
+ * @return The estimated time in microseconds.
+ */
+/* STATIC */
+uint16_t NimBLERadioActivity::advEventUs(bool legacy, bool scannable, uint8_t primaryPhy) {
+    // A full legacy packet is 376us at 1M, each is followed by a listening window when scannable.
+    uint16_t us = legacy ? 1200 : 1800;
+    if(scannable) {
+        us += 500;
+    }
+    // The coded PHY sends 8 symbols per bit.
+    if(primaryPhy == BLE_HCI_LE_PHY_CODED) {
+        us *= 8;
+    }
+    return us;
+} // advEventUs
+
+
+/**
+ * @brief Get the activity since the last reset, including the activities still running.
+ */
+/* STATIC */
+NimBLERadioActivity NimBLERadioActivity::get() {
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    NimBLERadioActivity activity = totals;
+    addScan(activity, now);
+    for(auto &it : advState) {
+        addAdv(activity, it, now);
+    }
+    for(auto &it : connState) {
+        addConn(activity, it, now);
+    }
+    activity.periodUs = now - resetTime;
+    ble_npl_hw_exit_critical(0);
+    return activity;
+} // get
+
+
+/**
+ * @brief Set the values back to 0, the activities still running are counted from now.
+ */
+/* STATIC */
+void NimBLERadioActivity::reset() {
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    memset(&totals, 0, sizeof(totals));
+    resetTime = now;
+    scanState.start = now;
+    for(auto &it : advState) {
+        it.start = now;
+    }
+    for(auto &it : connState) {
+        it.start = now;
+    }
+    ble_npl_hw_exit_critical(0);
+} // reset
+
+
+/**
+ * @brief Called when a scan is started.
+ * @param [in] duty The share of the time the radio receives in 1/1000, summed over the PHYs scanned.
+ */
+/* STATIC */
+void NimBLERadioActivity::scanStart(uint32_t duty) {
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    addScan(totals, now);
+    scanState.active = true;
+    scanState.start = now;
+    scanState.duty = duty > 1000 ? 1000 : duty;
+    totals.scanStarts++;
+    ble_npl_hw_exit_critical(0);
+} // scanStart
+
+
+/**
+ * @brief Called when a scan is stopped or completes.
+ */
+/* STATIC */
+void NimBLERadioActivity::scanStop() {
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    addScan(totals, now);
+    scanState.active = false;
+    ble_npl_hw_exit_critical(0);
+} // scanStop
+
+
+/**
+ * @brief Set the parameters an advertising instance runs with the next time it is started.
+ * @param [in] inst The advertising instance, 0 for legacy advertising.
+ * @param [in] itvlMin The minimum advertising interval in 0.625ms units, 0 for the host default.
+ * @param [in] itvlMax The maximum advertising interval in 0.625ms units, 0 for the host default.
+ * @param [in] eventUs The estimated radio time of an advertising event, from advEventUs().
+ */
+/* STATIC */
+void NimBLERadioActivity::advConfigure(uint8_t inst, uint32_t itvlMin, uint32_t itvlMax, uint16_t eventUs) {
+    if(inst >= NIMBLE_RADIO_ADV_INSTANCES) {
+        return;
+    }
+
+    if(itvlMin == 0) {
+        itvlMin = BLE_GAP_ADV_FAST_INTERVAL1_MIN;
+    }
+    if(itvlMax < itvlMin) {
+        itvlMax = itvlMin < BLE_GAP_ADV_FAST_INTERVAL1_MAX ? BLE_GAP_ADV_FAST_INTERVAL1_MAX : itvlMin;
+    }
+
+    ble_npl_hw_enter_critical();
+    // The controller adds a random delay of 0 to 10ms to each interval.
+    advState[inst].itvlUs = (itvlMin + itvlMax) * 625 / 2 + 5000;
+    advState[inst].eventUs = eventUs;
+    ble_npl_hw_exit_critical(0);
+} // advConfigure
+
+
+/**
+ * @brief Called when an advertising instance is started.
+ * @param [in] inst The advertising instance, 0 for legacy advertising.
+ */
+/* STATIC */
+void NimBLERadioActivity::advStart(uint8_t inst) {
+    if(inst >= NIMBLE_RADIO_ADV_INSTANCES) {
+        return;
+    }
+
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    addAdv(totals, advState[inst], now);
+    advState[inst].active = true;
+    advState[inst].start = now;
+    totals.advStarts++;
+    ble_npl_hw_exit_critical(0);
+} // advStart
+
+
+/**
+ * @brief Called when an advertising instance is stopped or completes.
+ * @param [in] inst The advertising instance, 0 for legacy advertising.
+ */
+/* STATIC */
+void NimBLERadioActivity::advStop(uint8_t inst) {
+    if(inst >= NIMBLE_RADIO_ADV_INSTANCES) {
+        return;
+    }
+
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    addAdv(totals, advState[inst], now);
+    advState[inst].active = false;
+    ble_npl_hw_exit_critical(0);
+} // advStop
+
+
+/**
+ * @brief Called when all the advertising instances are stopped.
+ */
+/* STATIC */
+void NimBLERadioActivity::advStopAll() {
+    for(uint8_t i = 0; i < NIMBLE_RADIO_ADV_INSTANCES; i++) {
+        advStop(i);
+    }
+} // advStopAll
+
+
+/**
+ * @brief Called when the host resets, the controller stopped all the activities.
+ */
+/* STATIC */
+void NimBLERadioActivity::stopAll() {
+    uint64_t now = NimBLEUtils::getTimeUs();
+
+    ble_npl_hw_enter_critical();
+    addScan(totals, now);
+    scanState.active = false;
+    for(auto &it : advState) {
+        addAdv(totals, it, now);
+        it.active = false;
+    }
+    for(auto &it : connState) {
+        addConn(totals, it, now);
+        it.connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
+    ble_npl_hw_exit_critical(0);
+} // stopAll
+
+
+/**
+ * @brief Open, close and update the connections from the GAP events.
+ * @param [in] event The event from the server or client GAP event handler.
+ */
+/* STATIC */
+void NimBLERadioActivity::handleGapEvent(struct ble_gap_event *event) {
+    switch(event->type) {
+        case BLE_GAP_EVENT_CONNECT: {
+            if(event->connect.status != 0) {
+                return;
+            }
+
+            uint16_t connHandle = event->connect.conn_handle;
+            uint32_t itvlUs = connItvlUs(connHandle);
+            uint64_t now = NimBLEUtils::getTimeUs();
+#if !CONFIG_BT_NIMBLE_EXT_ADV
+            // Legacy advertising ends without an event when a central connects.
+            ble_gap_conn_desc desc;
+            if(ble_gap_conn_find(connHandle, &desc) == 0 && desc.role == BLE_GAP_ROLE_SLAVE) {
+                advStop(0);
+            }
+#endif
+
+            ble_npl_hw_enter_critical();
+            radio_conn_t* pConn = findConn(connHandle);
+            if(pConn == nullptr) {
+                pConn = findConn(BLE_HS_CONN_HANDLE_NONE);
+            }
+            if(pConn != nullptr) {
+                pConn->connHandle = connHandle;
+                pConn->start = now;
+                pConn->itvlUs = itvlUs;
+                totals.connections++;
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        case BLE_GAP_EVENT_CONN_UPDATE: {
+            if(event->conn_update.status != 0) {
+                return;
+            }
+
+            uint32_t itvlUs = connItvlUs(event->conn_update.conn_handle);
+            uint64_t now = NimBLEUtils::getTimeUs();
+
+            ble_npl_hw_enter_critical();
+            radio_conn_t* pConn = findConn(event->conn_update.conn_handle);
+            if(pConn != nullptr) {
+                addConn(totals, *pConn, now);
+                pConn->start = now;
+                pConn->itvlUs = itvlUs;
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        case BLE_GAP_EVENT_DISCONNECT: {
+            uint64_t now = NimBLEUtils::getTimeUs();
+
+            ble_npl_hw_enter_critical();
+            radio_conn_t* pConn = findConn(event->disconnect.conn.conn_handle);
+            if(pConn != nullptr) {
+                addConn(totals, *pConn, now);
+                pConn->connHandle = BLE_HS_CONN_HANDLE_NONE;
+            }
+            ble_npl_hw_exit_critical(0);
+            return;
+        }
+
+        default:
+            return;
+    }
+} // handleGapEvent
+
+
+/**
+ * @brief Get the values as a string.
+ */
+std::string NimBLERadioActivity::toString() const {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "period %ums, scan %ums/radio %ums/%u starts, "
+             "adv %ums/radio %ums/%u events/%u starts, "
+             "conn %ums/radio %ums/%u events/%u connections",
+             (unsigned)(periodUs / 1000),
+             (unsigned)(scanUs / 1000), (unsigned)(scanRadioUs / 1000), (unsigned)scanStarts,
+             (unsigned)(advUs / 1000), (unsigned)(advRadioUs / 1000),
+             (unsigned)advEvents, (unsigned)advStarts,
+             (unsigned)(connUs / 1000), (unsigned)(connRadioUs / 1000),
+             (unsigned)connEvents, (unsigned)connections);
+    return std::string(buf);
+} // toString
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_NIMBLE_CPP_RADIO_ACTIVITY */
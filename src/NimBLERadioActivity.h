@@ -0,0 +1,122 @@
+/*
+ * NimBLERadioActivity.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLERADIOACTIVITY_H_
+#define NIMBLERADIOACTIVITY_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#ifndef CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+#    define CONFIG_NIMBLE_CPP_RADIO_ACTIVITY 0
+#endif
+
+#if CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gap.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gap.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief The time spent and the radio events of each role, get them with NimBLEDevice::getRadioActivity().
+ * @details The host is not told when the controller uses the radio, so the radio time and the events
+ * are estimated from the parameters each role runs with: the scan window over the scan interval, one
+ * advertising event per advertising interval and one connection event per connection interval.
+ * The activities still running are counted up to the time the values are read.
+ */
+struct NimBLERadioActivity {
+    /** @brief Time since the values were reset, in microseconds. */
+    uint64_t periodUs;
+    /** @brief Time scanning, in microseconds. */
+    uint64_t scanUs;
+    /** @brief Estimated time the radio was receiving for the scans, in microseconds. */
+    uint64_t scanRadioUs;
+    /** @brief Scans started. */
+    uint32_t scanStarts;
+    /** @brief Time advertising, summed over the advertising instances, in microseconds. */
+    uint64_t advUs;
+    /** @brief Estimated time the radio was on for advertising, in microseconds. */
+    uint64_t advRadioUs;
+    /** @brief Estimated advertising events. */
+    uint32_t advEvents;
+    /** @brief Advertising started, per instance. */
+    uint32_t advStarts;
+    /** @brief Time connected, summed over the connections, in microseconds. */
+    uint64_t connUs;
+    /** @brief Estimated time the radio was on for the connection events, in microseconds. */
+    uint64_t connRadioUs;
+    /** @brief Estimated connection events. */
+    uint32_t connEvents;
+    /** @brief Connections established. */
+    uint32_t connections;
+
+    std::string                toString() const;
+
+    static uint16_t            scanDuty(uint16_t itvl, uint16_t window);
+    static uint16_t            advEventUs(bool legacy, bool scannable, uint8_t primaryPhy);
+
+private:
+    friend class NimBLEDevice;
+    friend class NimBLEScan;
+    friend class NimBLEAdvertising;
+    friend class NimBLEExtAdvertising;
+    friend class NimBLEServer;
+    friend class NimBLEClient;
+
+    static NimBLERadioActivity get();
+    static void                reset();
+    static void                scanStart(uint32_t duty);
+    static void                scanStop();
+    static void                advConfigure(uint8_t inst, uint32_t itvlMin, uint32_t itvlMax, uint16_t eventUs);
+    static void                advStart(uint8_t inst);
+    static void                advStop(uint8_t inst);
+    static void                advStopAll();
+    static void                handleGapEvent(struct ble_gap_event *event);
+    static void                stopAll();
+}; // NimBLERadioActivity
+
+#define NIMBLE_CPP_RADIO_SCAN_START(duty) \
+    NimBLERadioActivity::scanStart(duty)
+#define NIMBLE_CPP_RADIO_SCAN_STOP() \
+    NimBLERadioActivity::scanStop()
+#define NIMBLE_CPP_RADIO_ADV_CONFIG(inst, itvlMin, itvlMax, eventUs) \
+    NimBLERadioActivity::advConfigure(inst, itvlMin, itvlMax, eventUs)
+#define NIMBLE_CPP_RADIO_ADV_START(inst) \
+    NimBLERadioActivity::advStart(inst)
+#define NIMBLE_CPP_RADIO_ADV_STOP(inst) \
+    NimBLERadioActivity::advStop(inst)
+#define NIMBLE_CPP_RADIO_ADV_STOP_ALL() \
+    NimBLERadioActivity::advStopAll()
+#define NIMBLE_CPP_RADIO_GAP_EVENT(event) \
+    NimBLERadioActivity::handleGapEvent(event)
+#define NIMBLE_CPP_RADIO_RESET() \
+    NimBLERadioActivity::stopAll()
+
+#else
+#define NIMBLE_CPP_RADIO_SCAN_START(duty)
+#define NIMBLE_CPP_RADIO_SCAN_STOP()
+#define NIMBLE_CPP_RADIO_ADV_CONFIG(inst, itvlMin, itvlMax, eventUs)
+#define NIMBLE_CPP_RADIO_ADV_START(inst)
+#define NIMBLE_CPP_RADIO_ADV_STOP(inst)
+#define NIMBLE_CPP_RADIO_ADV_STOP_ALL()
+#define NIMBLE_CPP_RADIO_GAP_EVENT(event)
+#define NIMBLE_CPP_RADIO_RESET()
+#endif /* CONFIG_NIMBLE_CPP_RADIO_ACTIVITY */
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* NIMBLERADIOACTIVITY_H_ */
@@ -16,13 +16,26 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 
 #include "NimBLERemoteCharacteristic.h"
+#include "NimBLEDevice.h"
 #include "NimBLEUtils.h"
 #include "NimBLELog.h"
 
 #include <climits>
+#include <algorithm>
 
 static const char* LOG_TAG = "NimBLERemoteCharacteristic";
 
+/**
+ * @brief The state of an asynchronous read or write, allocated when the operation
+ * is started and deleted when the host reports completion.
+ */
+typedef struct {
+    NimBLERemoteCharacteristic* pChr;
+    NimBLEAttValue              value;
+    read_callback               readCallback;
+    write_callback              writeCallback;
+} ble_async_op_t;
+
 /**
  * @brief Constructor.
  * @param [in] reference to the service this characteristic belongs to.
@@ -58,8 +71,11 @@ static const char* LOG_TAG = "NimBLERemoteCharacteristic";
     m_charProp           = chr->properties;
     m_pRemoteService     = pRemoteService;
     m_notifyCallback     = nullptr;
+    m_notifyMbufCallback = nullptr;
+    m_notifyUpdateValue  = true;
+    m_txPrio             = BLE_HS_TX_PRIO_NORMAL;
 
-    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteCharacteristic(): %s", m_uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteCharacteristic(): %s", NIMBLE_CPP_STR(m_uuid));
  } // NimBLERemoteCharacteristic
 
 
@@ -70,6 +86,32 @@ NimBLERemoteCharacteristic::~NimBLERemoteCharacteristic() {
     deleteDescriptors();
 } // ~NimBLERemoteCharacteristic
 
+
+/**
+ * @brief Allocate a remote characteristic, from the arena of the client when one is configured.
+ * @param [in] size The size of the object.
+ * @param [in] pClient The client the characteristic belongs to.
+ */
+void* NimBLERemoteCharacteristic::operator new(size_t size, NimBLEClient* pClient) {
+    return NimBLEClient::allocAttribute(size, pClient);
+} // operator new
+
+
+/**
+ * @brief Return the memory of a remote characteristic that failed to construct.
+ */
+void NimBLERemoteCharacteristic::operator delete(void* ptr, NimBLEClient* pClient) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
+
+/**
+ * @brief Return a remote characteristic to the arena or the heap it was allocated from.
+ */
+void NimBLERemoteCharacteristic::operator delete(void* ptr) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
 /*
 #define BLE_GATT_CHR_PROP_BROADCAST                     0x01
 #define BLE_GATT_CHR_PROP_READ                          0x02
@@ -160,14 +202,15 @@ int NimBLERemoteCharacteristic::descriptorDiscCB(uint16_t conn_handle,
     switch (rc) {
         case 0: {
             if (uuid_filter != nullptr) {
-                if (ble_uuid_cmp(&uuid_filter->getNative()->u, &dsc->uuid.u) != 0) {
+                if (NimBLEUUID(&dsc->uuid) != *uuid_filter) {
                     return 0;
                 } else {
                     rc = BLE_HS_EDONE;
                 }
             }
 
-            NimBLERemoteDescriptor* pNewRemoteDescriptor = new NimBLERemoteDescriptor(characteristic, dsc);
+            NimBLEClient* pClient = characteristic->getRemoteService()->getClient();
+            NimBLERemoteDescriptor* pNewRemoteDescriptor = new (pClient) NimBLERemoteDescriptor(characteristic, dsc);
             characteristic->m_descriptorVector.push_back(pNewRemoteDescriptor);
             break;
         }
@@ -230,7 +273,7 @@ int NimBLERemoteCharacteristic::nextCharCB(uint16_t conn_handle,
  * @param [in] the end handle of the characteristic, or the service, whichever comes first.
  */
 bool NimBLERemoteCharacteristic::retrieveDescriptors(const NimBLEUUID *uuid_filter) {
-    NIMBLE_LOGD(LOG_TAG, ">> retrieveDescriptors() for characteristic: %s", getUUID().toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> retrieveDescriptors() for characteristic: %s", NIMBLE_CPP_STR(getUUID()));
 
     // If this is the last handle then there are no descriptors
     if (m_handle == getRemoteService()->getEndHandle()) {
@@ -238,8 +281,10 @@ bool NimBLERemoteCharacteristic::retrieveDescriptors(const NimBLEUUID *uuid_filt
     }
 
     int rc = 0;
+    NimBLEClientOperation op(getRemoteService()->getClient());
     TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
     ble_task_data_t taskData = {this, cur_task, 0, nullptr};
+    NIMBLE_CPP_LATENCY_START(latencyStart);
 
     // If we don't know the end handle of this characteristic retrieve the next one in the service
     // The end handle is the next characteristic definition handle -1.
@@ -288,6 +333,7 @@ bool NimBLERemoteCharacteristic::retrieveDescriptors(const NimBLEUUID *uuid_filt
     ulTaskNotifyValueClear(cur_task, ULONG_MAX);
 #endif
     ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    NIMBLE_CPP_LATENCY_RECORD(getRemoteService()->getClient(), DISCOVER_DESCRIPTORS, latencyStart);
 
     if (taskData.rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "Failed to retrieve descriptors; startHandle:%d endHandle:%d taskData.rc=%d",
@@ -305,47 +351,19 @@ bool NimBLERemoteCharacteristic::retrieveDescriptors(const NimBLEUUID *uuid_filt
  * @return The Remote descriptor (if present) or null if not present.
  */
 NimBLERemoteDescriptor* NimBLERemoteCharacteristic::getDescriptor(const NimBLEUUID &uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> getDescriptor: uuid: %s", uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> getDescriptor: uuid: %s", NIMBLE_CPP_STR(uuid));
 
     for(auto &it: m_descriptorVector) {
         if(it->getUUID() == uuid) {
-            NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: found the descriptor with uuid: %s", uuid.toString().c_str());
+            NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: found the descriptor with uuid: %s", NIMBLE_CPP_STR(uuid));
             return it;
         }
     }
 
+    // Only the requested descriptor is discovered and stored, matching any size of the UUID.
     size_t prev_size = m_descriptorVector.size();
-    if(retrieveDescriptors(&uuid)) {
-        if(m_descriptorVector.size() > prev_size) {
-            return m_descriptorVector.back();
-        }
-
-        // If the request was successful but 16/32 bit uuid not found
-        // try again with the 128 bit uuid.
-        if(uuid.bitSize() == BLE_UUID_TYPE_16 ||
-           uuid.bitSize() == BLE_UUID_TYPE_32)
-        {
-            NimBLEUUID uuid128(uuid);
-            uuid128.to128();
-            if(retrieveDescriptors(&uuid128)) {
-                if(m_descriptorVector.size() > prev_size) {
-                    return m_descriptorVector.back();
-                }
-            }
-        } else {
-            // If the request was successful but the 128 bit uuid not found
-            // try again with the 16 bit uuid.
-            NimBLEUUID uuid16(uuid);
-            uuid16.to16();
-            // if the uuid was 128 bit but not of the BLE base type this check will fail
-            if (uuid16.bitSize() == BLE_UUID_TYPE_16) {
-                if(retrieveDescriptors(&uuid16)) {
-                    if(m_descriptorVector.size() > prev_size) {
-                        return m_descriptorVector.back();
-                    }
-                }
-            }
-        }
+    if(retrieveDescriptors(&uuid) && m_descriptorVector.size() > prev_size) {
+        return m_descriptorVector.back();
     }
 
     NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: Not found");
@@ -420,6 +438,15 @@ NimBLERemoteService* NimBLERemoteCharacteristic::getRemoteService() {
 } // getRemoteService
 
 
+/**
+ * @brief Get a reference that reads and writes this characteristic by handle.
+ * @return The reference, it can be kept and copied after this object is deleted.
+ */
+NimBLERemoteCharacteristicRef NimBLERemoteCharacteristic::getRef() {
+    return NimBLERemoteCharacteristicRef(this);
+} // getRef
+
+
 /**
  * @brief Get the UUID for this characteristic.
  * @return The UUID for this characteristic.
@@ -488,38 +515,121 @@ float NimBLERemoteCharacteristic::readFloat() {
  * @return The value of the remote characteristic.
  */
 NimBLEAttValue NimBLERemoteCharacteristic::readValue(time_t *timestamp) {
+    return readValueReserve(CONFIG_NIMBLE_CPP_ATT_VALUE_INIT_LENGTH, timestamp);
+} // readValue
+
+
+/**
+ * @brief Read the value of the remote characteristic into storage allocated for the expected length.
+ * @param [in] capacity The number of bytes to allocate for the value before reading,
+ * a long value of a known size is then read without growing the storage for each chunk.
+ * @param [in] timestamp A pointer to a time_t struct to store the time the value was read.
+ * @return The value of the remote characteristic.
+ */
+NimBLEAttValue NimBLERemoteCharacteristic::readValueReserve(uint16_t capacity, time_t *timestamp) {
     NIMBLE_LOGD(LOG_TAG, ">> readValue(): uuid: %s, handle: %d 0x%.2x",
-                         getUUID().toString().c_str(), getHandle(), getHandle());
+                         NIMBLE_CPP_STR(getUUID()), getHandle(), getHandle());
 
     NimBLEClient* pClient = getRemoteService()->getClient();
-    NimBLEAttValue value;
+    NimBLEAttValue value(capacity);
 
     if (!pClient->isConnected()) {
         NIMBLE_LOGE(LOG_TAG, "Disconnected");
         return value;
     }
 
+    ble_task_data_t taskData = {this, xTaskGetCurrentTaskHandle(), 0, &value};
+    int rc = readLong(NimBLERemoteCharacteristic::onReadCB, &taskData);
+    if (rc != 0) {
+        return value;
+    }
+
+    NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), readTxPackets, 1);
+    NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), readTxBytes, value.size());
+
+    value.setTimeStamp();
+    m_value = value;
+    if(timestamp != nullptr) {
+        *timestamp = value.getTimeStamp();
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< readValue length: %d rc=%d", value.length(), rc);
+    return value;
+} // readValueReserve
+
+
+/**
+ * @brief Context of a chunked read, passed in the task data buffer.
+ */
+struct NimBLEChunkRead {
+    read_chunk_callback *callback;
+    uint16_t            offset;
+};
+
+
+/**
+ * @brief Read the value of the remote characteristic, passing each chunk to a callback as it is received.
+ * @param [in] chunkCallback The function called with each chunk and its offset in the value,
+ * return false from it to stop the read.
+ * @return True if the whole value was read or the callback stopped the read, false on an error.
+ * @details The callback is called from the host task while the calling task waits. The value is not
+ * stored, so a long value is processed as it arrives without holding it in memory.
+ */
+bool NimBLERemoteCharacteristic::readValueChunked(read_chunk_callback chunkCallback) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValueChunked(): handle: %d", getHandle());
+
+    NimBLEClient* pClient = getRemoteService()->getClient();
+
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    NimBLEChunkRead chunkRead = {&chunkCallback, 0};
+    ble_task_data_t taskData = {this, xTaskGetCurrentTaskHandle(), 0, &chunkRead};
+    int rc = readLong(NimBLERemoteCharacteristic::onReadChunkCB, &taskData);
+    if (rc != 0) {
+        return false;
+    }
+
+    NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), readTxPackets, 1);
+    NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), readTxBytes, chunkRead.offset);
+
+    NIMBLE_LOGD(LOG_TAG, "<< readValueChunked length: %d", chunkRead.offset);
+    return true;
+} // readValueChunked
+
+
+/**
+ * @brief Run a long read of the value and wait for it to complete, the read is retried once
+ * after securing the connection if the peer requires it.
+ * @param [in] cb The function called by the host with the read responses.
+ * @param [in] pTaskData The task data passed to the callback, the task is notified when the read ends.
+ * @return 0 on success or the error code.
+ */
+int NimBLERemoteCharacteristic::readLong(ble_gatt_attr_fn *cb, ble_task_data_t *pTaskData) {
+    NimBLEClient* pClient = getRemoteService()->getClient();
     int rc = 0;
     int retryCount = 1;
-    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
-    ble_task_data_t taskData = {this, cur_task, 0, &value};
+    NimBLEClientOperation op(pClient);
 
     do {
-        rc = ble_gattc_read_long(pClient->getConnId(), m_handle, 0,
-                                 NimBLERemoteCharacteristic::onReadCB,
-                                 &taskData);
+        NIMBLE_CPP_LATENCY_START(latencyStart);
+        rc = ble_gattc_read_long(pClient->getConnId(), m_handle, 0, cb, pTaskData);
         if (rc != 0) {
             NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d, %s",
                                   rc, NimBLEUtils::returnCodeToString(rc));
-            return value;
+            return rc;
         }
 
 #ifdef ulTaskNotifyValueClear
         // Clear the task notification value to ensure we block
-        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+        ulTaskNotifyValueClear(pTaskData->task, ULONG_MAX);
 #endif
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        rc = taskData.rc;
+        NIMBLE_CPP_LATENCY_RECORD(pClient, READ, latencyStart);
+        rc = pTaskData->rc;
+        NIMBLE_CPP_CONN_STATS_ATT_RESULT(pClient->getConnId(), rc);
 
         switch(rc){
             case 0:
@@ -539,19 +649,12 @@ NimBLEAttValue NimBLERemoteCharacteristic::readValue(time_t *timestamp) {
             /* Else falls through. */
             default:
                 NIMBLE_LOGE(LOG_TAG, "<< readValue rc=%d", rc);
-                return value;
+                return rc;
         }
     } while(rc != 0 && retryCount--);
 
-    value.setTimeStamp();
-    m_value = value;
-    if(timestamp != nullptr) {
-        *timestamp = value.getTimeStamp();
-    }
-
-    NIMBLE_LOGD(LOG_TAG, "<< readValue length: %d rc=%d", value.length(), rc);
-    return value;
-} // readValue
+    return rc;
+} // readLong
 
 
 /**
@@ -595,18 +698,149 @@ int NimBLERemoteCharacteristic::onReadCB(uint16_t conn_handle,
 }
 
 
+/**
+ * @brief Callback for a chunked characteristic read operation, passes each mbuf of the response
+ * to the chunk callback without copying.
+ * @return success == 0 or error code.
+ */
+int NimBLERemoteCharacteristic::onReadChunkCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLERemoteCharacteristic *characteristic = (NimBLERemoteCharacteristic*)pTaskData->pATT;
+    uint16_t conn_id = characteristic->getRemoteService()->getClient()->getConnId();
+
+    if(conn_id != conn_handle) {
+        return 0;
+    }
+
+    NimBLEChunkRead *pRead = (NimBLEChunkRead*)pTaskData->buf;
+    int rc = error->status;
+
+    if(rc == 0 && attr) {
+        bool more = true;
+        for(const struct os_mbuf *om = attr->om; om != nullptr && more; om = SLIST_NEXT(om, om_next)) {
+            if(om->om_len > 0) {
+                more = (*pRead->callback)(characteristic, om->om_data, om->om_len, pRead->offset);
+                pRead->offset += om->om_len;
+            }
+        }
+
+        if(more) {
+            return 0;
+        }
+
+        // Stopped by the callback, returning non-zero ends the procedure.
+        NIMBLE_LOGD(LOG_TAG, "Chunked read stopped at offset %d", pRead->offset);
+        rc = BLE_HS_EDONE;
+    }
+
+    pTaskData->rc = rc;
+    xTaskNotifyGive(pTaskData->task);
+
+    return rc;
+} // onReadChunkCB
+
+
+/**
+ * @brief Read the value of the remote characteristic without blocking the calling task.
+ * @param [in] readCallback The function to call with the value when the read completes.
+ * @return True if the read was started, the callback will be called with the result.
+ * @details The callback is called from the host task with rc == 0 on success, or the error code
+ * with an empty value on failure. The characteristic must not be deleted while the read is pending.
+ */
+bool NimBLERemoteCharacteristic::readValueAsync(read_callback readCallback) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValueAsync(): handle: %d", getHandle());
+
+    NimBLEClient* pClient = getRemoteService()->getClient();
+
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    ble_async_op_t* pOp = new ble_async_op_t{this, NimBLEAttValue(), readCallback, nullptr};
+
+    int rc = ble_gattc_read_long(pClient->getConnId(), m_handle, 0,
+                                 NimBLERemoteCharacteristic::onReadAsyncCB,
+                                 pOp);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d, %s",
+                              rc, NimBLEUtils::returnCodeToString(rc));
+        delete pOp;
+        return false;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< readValueAsync()");
+    return true;
+} // readValueAsync
+
+
+/**
+ * @brief Callback for an asynchronous characteristic read operation.
+ * @return success == 0 or error code.
+ */
+int NimBLERemoteCharacteristic::onReadAsyncCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg)
+{
+    ble_async_op_t *pOp = (ble_async_op_t*)arg;
+    int rc = error->status;
+
+    if(rc == 0) {
+        if(attr) {
+            uint16_t data_len = OS_MBUF_PKTLEN(attr->om);
+            if((pOp->value.size() + data_len) > BLE_ATT_ATTR_MAX_LEN) {
+                rc = BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            } else {
+                pOp->value.append(attr->om->om_data, data_len);
+                return 0;
+            }
+        }
+    }
+
+    NIMBLE_LOGI(LOG_TAG, "Async read complete; status=%d conn_handle=%d", rc, conn_handle);
+
+    // Characteristic is not long-readable, the first read has the whole value.
+    if(rc == BLE_HS_EDONE || rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_ATTR_NOT_LONG)) {
+        rc = 0;
+    }
+
+    if(rc == 0) {
+        pOp->value.setTimeStamp();
+        pOp->pChr->m_value = pOp->value;
+    } else {
+        pOp->value = NimBLEAttValue();
+    }
+
+    if(pOp->readCallback != nullptr) {
+        pOp->readCallback(pOp->pChr, pOp->value, rc);
+    }
+
+    delete pOp;
+    return rc;
+} // onReadAsyncCB
+
+
 /**
  * @brief Subscribe or unsubscribe for notifications or indications.
  * @param [in] val 0x00 to unsubscribe, 0x01 for notifications, 0x02 for indications.
  * @param [in] notifyCallback A callback to be invoked for a notification.
  * @param [in] response If write response required set this to true.
  * If NULL is provided then no callback is performed.
+ * @param [in] mbufCallback A callback to be invoked with the received mbuf chain for a notification.
+ * @param [in] updateValue If false the stored value is not updated when a notification is received.
  * @return false if writing to the descriptor failed.
  */
-bool NimBLERemoteCharacteristic::setNotify(uint16_t val, notify_callback notifyCallback, bool response) {
+bool NimBLERemoteCharacteristic::setNotify(uint16_t val, notify_callback notifyCallback, bool response,
+                                           notify_mbuf_callback mbufCallback, bool updateValue)
+{
     NIMBLE_LOGD(LOG_TAG, ">> setNotify(): %s, %02x", toString().c_str(), val);
 
-    m_notifyCallback = notifyCallback;
+    m_notifyCallback     = notifyCallback;
+    m_notifyMbufCallback = mbufCallback;
+    m_notifyUpdateValue  = updateValue;
 
     NimBLERemoteDescriptor* desc = getDescriptor(NimBLEUUID((uint16_t)0x2902));
     if(desc == nullptr) {
@@ -637,6 +871,76 @@ bool NimBLERemoteCharacteristic::subscribe(bool notifications, notify_callback n
 } // subscribe
 
 
+/**
+ * @brief Subscribe for notifications or indications, receiving the data without copying it.
+ * @param [in] notifications If true, subscribe for notifications, false subscribe for indications.
+ * @param [in] notifyCallback A callback to be invoked with the mbuf chain holding the received data.
+ * The chain is only valid during the callback, use os_mbuf_copydata() or walk the chain to read it.
+ * @param [in] response If true, require a write response from the descriptor write operation.
+ * @param [in] updateValue If false the value returned by getValue() is not updated on notification,
+ * saving a copy of every notification.
+ * @return false if writing to the descriptor failed.
+ */
+bool NimBLERemoteCharacteristic::subscribe(bool notifications, notify_mbuf_callback notifyCallback,
+                                           bool response, bool updateValue)
+{
+    return setNotify(notifications ? 0x01 : 0x02, nullptr, response, notifyCallback, updateValue);
+} // subscribe
+
+
+/**
+ * @brief Handle a notification or indication received for this characteristic.
+ * @param [in] om The mbuf chain holding the received data.
+ * @param [in] isNotify True if a notification, false if an indication.
+ */
+void NimBLERemoteCharacteristic::onNotify(const struct os_mbuf *om, bool isNotify) {
+    // The mbuf is only valid in the host task, the mbuf callback is always called from here.
+    if((m_notifyCallback != nullptr || m_notifyUpdateValue) && NimBLEDevice::queueNotify(this, om, isNotify)) {
+        if(m_notifyMbufCallback != nullptr) {
+            m_notifyMbufCallback(this, om, isNotify);
+        }
+        return;
+    }
+
+    uint16_t data_len = OS_MBUF_PKTLEN(om);
+    bool chained = SLIST_NEXT(om, om_next) != nullptr;
+
+    // The data callback needs a contiguous buffer, use the stored value if the data is split over mbufs.
+    if(m_notifyUpdateValue || (chained && m_notifyCallback != nullptr)) {
+        m_value.setValue(om->om_data, om->om_len);
+        for(const os_mbuf *next = SLIST_NEXT(om, om_next); next != nullptr; next = SLIST_NEXT(next, om_next)) {
+            m_value.append(next->om_data, next->om_len);
+        }
+    }
+
+    if(m_notifyMbufCallback != nullptr) {
+        m_notifyMbufCallback(this, om, isNotify);
+    }
+
+    if(m_notifyCallback != nullptr) {
+        uint8_t *data = chained ? (uint8_t*)m_value.data() : om->om_data;
+        m_notifyCallback(this, data, data_len, isNotify);
+    }
+} // onNotify
+
+
+/**
+ * @brief Deliver a notification copied from the notify queue, called from the notify task.
+ * @param [in] data A pointer to the notification data.
+ * @param [in] length The length of the data.
+ * @param [in] isNotify True if this was a notification, false if an indication.
+ */
+void NimBLERemoteCharacteristic::deliverNotify(uint8_t *data, size_t length, bool isNotify) {
+    if(m_notifyUpdateValue) {
+        m_value.setValue(data, length);
+    }
+
+    if(m_notifyCallback != nullptr) {
+        m_notifyCallback(this, data, length, isNotify);
+    }
+} // deliverNotify
+
+
 /**
  * @brief Unsubscribe for notifications or indications.
  * @param [in] response bool if true, require a write response from the descriptor write operation.
@@ -779,14 +1083,21 @@ bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length,
     // Check if the data length is longer than we can write in one connection event.
     // If so we must do a long write which requires a response.
     if(length <= mtu && !response) {
-        rc =  ble_gattc_write_no_rsp_flat(pClient->getConnId(), m_handle, data, length);
+        os_mbuf *om = txMbuf(data, length);
+        rc = om == nullptr ? BLE_HS_ENOMEM : ble_gattc_write_no_rsp(pClient->getConnId(), m_handle, om);
+        if(rc == 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxBytes, length);
+        }
         return (rc==0);
     }
 
+    NimBLEClientOperation op(pClient);
     TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
     ble_task_data_t taskData = {this, cur_task, 0, nullptr};
 
     do {
+        NIMBLE_CPP_LATENCY_START(latencyStart);
         if(length > mtu) {
             NIMBLE_LOGI(LOG_TAG,"long write %d bytes", length);
             os_mbuf *om = ble_hs_mbuf_from_flat(data, length);
@@ -794,10 +1105,11 @@ bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length,
                                       NimBLERemoteCharacteristic::onWriteCB,
                                       &taskData);
         } else {
-            rc = ble_gattc_write_flat(pClient->getConnId(), m_handle,
-                                      data, length,
-                                      NimBLERemoteCharacteristic::onWriteCB,
-                                      &taskData);
+            os_mbuf *om = txMbuf(data, length);
+            rc = om == nullptr ? BLE_HS_ENOMEM :
+                 ble_gattc_write(pClient->getConnId(), m_handle, om,
+                                 NimBLERemoteCharacteristic::onWriteCB,
+                                 &taskData);
         }
         if (rc != 0) {
             NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
@@ -809,7 +1121,9 @@ bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length,
         ulTaskNotifyValueClear(cur_task, ULONG_MAX);
 #endif
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        NIMBLE_CPP_LATENCY_RECORD(pClient, WRITE, latencyStart);
         rc = taskData.rc;
+        NIMBLE_CPP_CONN_STATS_ATT_RESULT(pClient->getConnId(), rc);
 
         switch(rc){
             case 0:
@@ -834,11 +1148,276 @@ bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length,
         }
     } while(rc != 0 && retryCount--);
 
+    if(rc == 0) {
+        NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxBytes, length);
+    }
+
     NIMBLE_LOGD(LOG_TAG, "<< writeValue, rc: %d", rc);
     return (rc == 0);
 } // writeValue
 
 
+/**
+ * @brief Context of a chunked write, passed in the task data buffer.
+ */
+struct NimBLEChunkWrite {
+    write_chunk_callback *callback;
+    std::vector<uint8_t> buf;
+};
+
+
+/**
+ * @brief Write a long value to the remote characteristic, getting each chunk from a callback as it is sent.
+ * @param [in] chunkCallback The function called to fill the buffer with the chunk at the offset in the value,
+ * it must return the size requested, any other value aborts the write.
+ * @param [in] length The total length of the value.
+ * @return True if the whole value was written.
+ * @details The callback is called from the host task while the calling task waits. Only one chunk
+ * is held in memory, so a long value can be written without a copy of it. If the write is restarted
+ * after securing the connection the callback is called again from offset 0.
+ */
+bool NimBLERemoteCharacteristic::writeValueChunked(write_chunk_callback chunkCallback, uint16_t length) {
+    NIMBLE_LOGD(LOG_TAG, ">> writeValueChunked(), length: %d", length);
+
+    NimBLEClient* pClient = getRemoteService()->getClient();
+
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    if (length == 0) {
+        return writeValue(nullptr, 0, true);
+    }
+
+    int rc = 0;
+    int retryCount = 1;
+    NimBLEClientOperation op(pClient);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+
+    // A prepare write carries at most the MTU less the opcode, handle and offset.
+    NimBLEChunkWrite chunkWrite;
+    chunkWrite.callback = &chunkCallback;
+    chunkWrite.buf.resize(ble_att_mtu(pClient->getConnId()) - 5);
+    ble_task_data_t taskData = {this, cur_task, 0, &chunkWrite};
+
+    do {
+        NIMBLE_CPP_LATENCY_START(latencyStart);
+        rc = ble_gattc_write_long_src(pClient->getConnId(), m_handle, length,
+                                      NimBLERemoteCharacteristic::onWriteChunkCB,
+                                      NimBLERemoteCharacteristic::onWriteCB,
+                                      &taskData);
+        if (rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
+            return false;
+        }
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        NIMBLE_CPP_LATENCY_RECORD(pClient, WRITE, latencyStart);
+        rc = taskData.rc;
+        NIMBLE_CPP_CONN_STATS_ATT_RESULT(pClient->getConnId(), rc);
+
+        switch(rc){
+            case 0:
+            case BLE_HS_EDONE:
+                rc = 0;
+                break;
+
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHOR):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC):
+                if (retryCount && pClient->secureConnection())
+                    break;
+            /* Else falls through. */
+            default:
+                NIMBLE_LOGE(LOG_TAG, "<< writeValueChunked, rc: %d", rc);
+                return false;
+        }
+    } while(rc != 0 && retryCount--);
+
+    if(rc == 0) {
+        NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(pClient->getConnId(), writeTxBytes, length);
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< writeValueChunked, rc: %d", rc);
+    return (rc == 0);
+} // writeValueChunked
+
+
+/**
+ * @brief Write a new value to the remote characteristic without blocking the calling task.
+ * @param [in] data A pointer to a data buffer, the data is copied before this returns.
+ * @param [in] length The length of the data in the data buffer.
+ * @param [in] writeCallback The function to call when the write completes, can be nullptr.
+ * @return True if the write was started.
+ * @details The write always requests a response so completion can be reported, a long write
+ * is used if the data is longer than the MTU allows. The callback is called from the host task
+ * with rc == 0 on success or the error code. The characteristic must not be deleted while the
+ * write is pending.
+ */
+bool NimBLERemoteCharacteristic::writeValueAsync(const uint8_t* data, size_t length,
+                                                 write_callback writeCallback)
+{
+    NIMBLE_LOGD(LOG_TAG, ">> writeValueAsync(), length: %d", length);
+
+    NimBLEClient* pClient = getRemoteService()->getClient();
+
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return false;
+    }
+
+    int rc = 0;
+    uint16_t mtu = ble_att_mtu(pClient->getConnId()) - 3;
+    ble_async_op_t* pOp = new ble_async_op_t{this, NimBLEAttValue(), nullptr, writeCallback};
+
+    if(length > mtu) {
+        NIMBLE_LOGI(LOG_TAG,"long write %d bytes", length);
+        os_mbuf *om = ble_hs_mbuf_from_flat(data, length);
+        rc = ble_gattc_write_long(pClient->getConnId(), m_handle, 0, om,
+                                  NimBLERemoteCharacteristic::onWriteAsyncCB,
+                                  pOp);
+    } else {
+        os_mbuf *om = txMbuf(data, length);
+        rc = om == nullptr ? BLE_HS_ENOMEM :
+             ble_gattc_write(pClient->getConnId(), m_handle, om,
+                             NimBLERemoteCharacteristic::onWriteAsyncCB,
+                             pOp);
+    }
+
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
+        delete pOp;
+        return false;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< writeValueAsync()");
+    return true;
+} // writeValueAsync
+
+
+/**
+ * @brief Stream data to the remote characteristic as back to back writes without response.
+ * @param [in] data A pointer to the data to send.
+ * @param [in] length The length of the data, it is sent in chunks of MTU - 3 bytes.
+ * @param [out] bytesPerSec If not nullptr, set to the throughput achieved.
+ * @param [in] timeoutMs The maximum time to wait for buffers to become available before giving up.
+ * @return The number of bytes sent, less than length if disconnected or timed out.
+ * @details Chunks are queued as fast as the host accepts them so the controller always has packets
+ * to send. When the host runs out of buffers the write waits for the controller to report sent
+ * packets, which returns the buffers, and then continues.
+ */
+size_t NimBLERemoteCharacteristic::writeStream(const uint8_t* data, size_t length,
+                                               uint32_t* bytesPerSec, uint32_t timeoutMs)
+{
+    NIMBLE_LOGD(LOG_TAG, ">> writeStream(), length: %d", length);
+
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    uint16_t mtu = ble_att_mtu(pClient->getConnId()) - 3;
+    ble_npl_time_t start = ble_npl_time_get();
+    ble_npl_time_t lastProgress = start;
+    ble_npl_time_t timeout = ble_npl_time_ms_to_ticks32(timeoutMs);
+    size_t sent = 0;
+
+    while (sent < length && pClient->isConnected()) {
+        uint16_t chunk = std::min((size_t)mtu, length - sent);
+        os_mbuf *om = txMbuf(data + sent, chunk);
+        int rc = om == nullptr ? BLE_HS_ENOMEM : ble_gattc_write_no_rsp(pClient->getConnId(), m_handle, om);
+
+        if (rc == 0) {
+            sent += chunk;
+            lastProgress = ble_npl_time_get();
+            continue;
+        }
+
+        if (rc != BLE_HS_ENOMEM) {
+            NIMBLE_LOGE(LOG_TAG, "writeStream failed; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+            break;
+        }
+
+        // Out of buffers, they are released as the controller reports completed packets.
+        if (ble_npl_time_get() - lastProgress > timeout) {
+            NIMBLE_LOGE(LOG_TAG, "writeStream timed out waiting for buffers");
+            break;
+        }
+        ble_npl_time_delay(1);
+    }
+
+    uint32_t elapsedMs = ble_npl_time_ticks_to_ms32(ble_npl_time_get() - start);
+    if (bytesPerSec != nullptr) {
+        *bytesPerSec = elapsedMs ? (uint32_t)((uint64_t)sent * 1000 / elapsedMs) : 0;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< writeStream(), sent %d bytes in %u ms", sent, elapsedMs);
+    return sent;
+} // writeStream
+
+
+/**
+ * @brief Set the transmit priority class of the writes to this characteristic.
+ * @param [in] prio One of BLE_HS_TX_PRIO_LOW, BLE_HS_TX_PRIO_NORMAL (default), BLE_HS_TX_PRIO_HIGH
+ * or BLE_HS_TX_PRIO_HIGHEST.
+ * @details When the controller has no free buffer, the packets waiting for the connection are sent highest
+ * class first. Long writes are sent with the normal class.
+ */
+void NimBLERemoteCharacteristic::setTxPriority(uint8_t prio) {
+    m_txPrio = prio < BLE_HS_TX_PRIO_CNT ? prio : BLE_HS_TX_PRIO_HIGHEST;
+} // setTxPriority
+
+
+/**
+ * @brief Get the transmit priority class of the writes to this characteristic.
+ */
+uint8_t NimBLERemoteCharacteristic::getTxPriority() {
+    return m_txPrio;
+} // getTxPriority
+
+
+/**
+ * @brief Copy the data of a write into an mbuf with the transmit priority class of the characteristic.
+ * @return The mbuf or nullptr if none is available.
+ */
+os_mbuf* NimBLERemoteCharacteristic::txMbuf(const uint8_t* data, size_t length) {
+    os_mbuf *om = ble_hs_mbuf_from_flat(data, length);
+    if(om != nullptr) {
+        ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+    }
+    return om;
+} // txMbuf
+
+
+/**
+ * @brief Callback for an asynchronous characteristic write operation.
+ * @return success == 0 or error code.
+ */
+int NimBLERemoteCharacteristic::onWriteAsyncCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg)
+{
+    ble_async_op_t *pOp = (ble_async_op_t*)arg;
+    int rc = error->status;
+
+    NIMBLE_LOGI(LOG_TAG, "Async write complete; status=%d conn_handle=%d", rc, conn_handle);
+
+    if(rc == BLE_HS_EDONE) {
+        rc = 0;
+    }
+
+    if(pOp->writeCallback != nullptr) {
+        pOp->writeCallback(pOp->pChr, rc);
+    }
+
+    delete pOp;
+    return 0;
+} // onWriteAsyncCB
+
+
 /**
  * @brief Callback for characteristic write operation.
  * @return success == 0 or error code.
@@ -862,4 +1441,30 @@ int NimBLERemoteCharacteristic::onWriteCB(uint16_t conn_handle,
     return 0;
 }
 
+
+/**
+ * @brief Callback for getting each chunk of a chunked write from the user callback.
+ * @return 0 if the chunk was appended, nonzero to abort the write.
+ */
+int NimBLERemoteCharacteristic::onWriteChunkCB(uint16_t conn_handle, uint16_t offset, uint16_t len,
+                                               struct os_mbuf *om, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLERemoteCharacteristic *characteristic = (NimBLERemoteCharacteristic*)pTaskData->pATT;
+    NimBLEChunkWrite *pWrite = (NimBLEChunkWrite*)pTaskData->buf;
+
+    if(len > pWrite->buf.size()) {
+        return BLE_HS_EINVAL;
+    }
+
+    size_t filled = (*pWrite->callback)(characteristic, pWrite->buf.data(), len, offset);
+    if(filled != len) {
+        NIMBLE_LOGE(LOG_TAG, "Chunk callback returned %d bytes at offset %d of %d requested",
+                    filled, offset, len);
+        return BLE_HS_EAPP;
+    }
+
+    return os_mbuf_append(om, pWrite->buf.data(), len);
+} // onWriteChunkCB
+
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL */
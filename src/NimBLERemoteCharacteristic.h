@@ -19,12 +19,15 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 
 #include "NimBLERemoteService.h"
+#include "NimBLEArena.h"
 #include "NimBLERemoteDescriptor.h"
+#include "NimBLERemoteCharacteristicRef.h"
 
 #include <vector>
 #include <functional>
 #include "NimBLELog.h"
 
+class NimBLEClient;
 class NimBLERemoteService;
 class NimBLERemoteDescriptor;
 
@@ -32,6 +35,20 @@ class NimBLERemoteDescriptor;
 typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
                                 uint8_t* pData, size_t length, bool isNotify)> notify_callback;
 
+typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                const struct os_mbuf* om, bool isNotify)> notify_mbuf_callback;
+
+typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                const NimBLEAttValue& value, int rc)> read_callback;
+
+typedef std::function<bool (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                const uint8_t* data, size_t length, uint16_t offset)> read_chunk_callback;
+
+typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic, int rc)> write_callback;
+
+typedef std::function<size_t (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                uint8_t* buf, size_t size, uint16_t offset)> write_chunk_callback;
+
 typedef struct {
     const NimBLEUUID *uuid;
     void *task_data;
@@ -43,6 +60,10 @@ typedef struct {
  */
 class NimBLERemoteCharacteristic {
 public:
+    static void*    operator new(size_t size, NimBLEClient* pClient);
+    static void     operator delete(void* ptr, NimBLEClient* pClient);
+    static void     operator delete(void* ptr);
+
     ~NimBLERemoteCharacteristic();
 
     // Public member functions
@@ -62,8 +83,12 @@ public:
     uint16_t                                       getDefHandle();
     NimBLEUUID                                     getUUID();
     NimBLEAttValue                                 readValue(time_t *timestamp = nullptr);
+    NimBLEAttValue                                 readValueReserve(uint16_t capacity, time_t *timestamp = nullptr);
+    bool                                           readValueChunked(read_chunk_callback chunkCallback);
+    bool                                           readValueAsync(read_callback readCallback);
     std::string                                    toString();
     NimBLERemoteService*                           getRemoteService();
+    NimBLERemoteCharacteristicRef                  getRef();
 
     uint8_t                                        readUInt8()  __attribute__ ((deprecated("Use template readValue<uint8_t>()")));
     uint16_t                                       readUInt16() __attribute__ ((deprecated("Use template readValue<uint16_t>()")));
@@ -74,6 +99,10 @@ public:
     bool                                           subscribe(bool notifications = true,
                                                              notify_callback notifyCallback = nullptr,
                                                              bool response = false);
+    bool                                           subscribe(bool notifications,
+                                                             notify_mbuf_callback notifyCallback,
+                                                             bool response,
+                                                             bool updateValue);
     bool                                           unsubscribe(bool response = false);
     bool                                           registerForNotify(notify_callback notifyCallback,
                                                                      bool notifications = true,
@@ -84,6 +113,14 @@ public:
                                                               bool response = false);
     bool                                           writeValue(const std::vector<uint8_t>& v, bool response = false);
     bool                                           writeValue(const char* s, bool response = false);
+    bool                                           writeValueAsync(const uint8_t* data, size_t length,
+                                                                   write_callback writeCallback = nullptr);
+    bool                                           writeValueChunked(write_chunk_callback chunkCallback, uint16_t length);
+    size_t                                         writeStream(const uint8_t* data, size_t length,
+                                                               uint32_t* bytesPerSec = nullptr,
+                                                               uint32_t timeoutMs = 1000);
+    void                                           setTxPriority(uint8_t prio);
+    uint8_t                                        getTxPriority();
 
 
     /*********************** Template Functions ************************/
@@ -131,8 +168,7 @@ public:
      */
     template<typename T>
     T getValue(time_t *timestamp = nullptr, bool skipSizeCheck = false) {
-        if(!skipSizeCheck && m_value.size() < sizeof(T)) return T();
-        return *((T *)m_value.getValue(timestamp));
+        return m_value.getValue<T>(timestamp, skipSizeCheck);
     }
 
     /**
@@ -147,8 +183,7 @@ public:
     template<typename T>
     T readValue(time_t *timestamp = nullptr, bool skipSizeCheck = false) {
         NimBLEAttValue value = readValue();
-        if(!skipSizeCheck && value.size() < sizeof(T)) return T();
-        return *((T *)value.getValue(timestamp));
+        return value.getValue<T>(timestamp, skipSizeCheck);
     }
 
 private:
@@ -156,16 +191,31 @@ private:
     NimBLERemoteCharacteristic(NimBLERemoteService *pRemoteservice, const struct ble_gatt_chr *chr);
 
     friend class      NimBLEClient;
+    friend class      NimBLEDevice;
     friend class      NimBLERemoteService;
     friend class      NimBLERemoteDescriptor;
+    friend class      NimBLERemoteCharacteristicRef;
 
     // Private member functions
-    bool              setNotify(uint16_t val, notify_callback notifyCallback = nullptr, bool response = true);
+    bool              setNotify(uint16_t val, notify_callback notifyCallback = nullptr, bool response = true,
+                                notify_mbuf_callback mbufCallback = nullptr, bool updateValue = true);
+    void              onNotify(const struct os_mbuf *om, bool isNotify);
+    void              deliverNotify(uint8_t *data, size_t length, bool isNotify);
     bool              retrieveDescriptors(const NimBLEUUID *uuid_filter = nullptr);
+    os_mbuf*          txMbuf(const uint8_t* data, size_t length);
+    int               readLong(ble_gatt_attr_fn *cb, ble_task_data_t *pTaskData);
     static int        onReadCB(uint16_t conn_handle, const struct ble_gatt_error *error,
                                struct ble_gatt_attr *attr, void *arg);
+    static int        onReadChunkCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                    struct ble_gatt_attr *attr, void *arg);
     static int        onWriteCB(uint16_t conn_handle, const struct ble_gatt_error *error,
                                 struct ble_gatt_attr *attr, void *arg);
+    static int        onWriteChunkCB(uint16_t conn_handle, uint16_t offset, uint16_t len,
+                                     struct os_mbuf *om, void *arg);
+    static int        onReadAsyncCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                    struct ble_gatt_attr *attr, void *arg);
+    static int        onWriteAsyncCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                     struct ble_gatt_attr *attr, void *arg);
     static int        descriptorDiscCB(uint16_t conn_handle, const struct ble_gatt_error *error,
                                        uint16_t chr_val_handle, const struct ble_gatt_dsc *dsc,
                                        void *arg);
@@ -181,6 +231,9 @@ private:
     NimBLERemoteService*    m_pRemoteService;
     NimBLEAttValue          m_value;
     notify_callback         m_notifyCallback;
+    notify_mbuf_callback    m_notifyMbufCallback;
+    bool                    m_notifyUpdateValue;
+    uint8_t                 m_txPrio;
 
     // We maintain a vector of descriptors owned by this characteristic.
     std::vector<NimBLERemoteDescriptor*> m_descriptorVector;
@@ -0,0 +1,393 @@
+/*
+ * NimBLERemoteCharacteristicRef.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+
+#include "NimBLERemoteCharacteristicRef.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#include <climits>
+
+static const char* LOG_TAG = "NimBLERemoteCharacteristicRef";
+
+/**
+ * @brief Construct an invalid reference.
+ */
+NimBLERemoteCharacteristicRef::NimBLERemoteCharacteristicRef()
+: m_pClient(nullptr),
+  m_handle(0),
+  m_mapGen(0),
+  m_charProp(0),
+  m_txPrio(0)
+{
+} // NimBLERemoteCharacteristicRef
+
+
+/**
+ * @brief Construct a reference to a remote characteristic.
+ * @param [in] pChr The characteristic, if nullptr the reference is invalid.
+ */
+NimBLERemoteCharacteristicRef::NimBLERemoteCharacteristicRef(NimBLERemoteCharacteristic *pChr)
+: NimBLERemoteCharacteristicRef()
+{
+    if(pChr == nullptr) {
+        return;
+    }
+
+    m_pClient  = pChr->getRemoteService()->getClient();
+    m_handle   = pChr->m_handle;
+    m_charProp = pChr->m_charProp;
+    m_txPrio   = pChr->m_txPrio;
+
+    if(!m_pClient->m_charHandleMapValid) {
+        m_pClient->buildCharHandleMap();
+    }
+    m_mapGen = m_pClient->m_charHandleMapGen;
+} // NimBLERemoteCharacteristicRef
+
+
+/**
+ * @brief Check that the characteristic is still known to the client at the same handle.
+ * @return True if the reference can be used.
+ * @details Only looks at the attributes of the client when they changed since the last check,
+ * the properties must match or the reference is cleared.
+ */
+bool NimBLERemoteCharacteristicRef::check() {
+    if(m_handle == 0) {
+        return false;
+    }
+
+    if(m_pClient->m_charHandleMapValid && m_pClient->m_charHandleMapGen == m_mapGen) {
+        return true;
+    }
+
+    NimBLERemoteCharacteristic *pChr = m_pClient->getCharacteristic(m_handle);
+    if(pChr == nullptr || pChr->m_charProp != m_charProp) {
+        NIMBLE_LOGW(LOG_TAG, "Characteristic at handle %d is no longer available", m_handle);
+        m_handle = 0;
+        return false;
+    }
+
+    m_txPrio = pChr->m_txPrio;
+    m_mapGen = m_pClient->m_charHandleMapGen;
+    return true;
+} // check
+
+
+/**
+ * @brief Check if the reference can be used.
+ * @return True if the characteristic is still known to the client at the same handle.
+ */
+bool NimBLERemoteCharacteristicRef::isValid() {
+    return check();
+} // isValid
+
+
+/**
+ * @brief Get the client of the characteristic.
+ * @return A pointer to the client or nullptr if the reference was never set.
+ */
+NimBLEClient* NimBLERemoteCharacteristicRef::getClient() const {
+    return m_pClient;
+} // getClient
+
+
+/**
+ * @brief Get the value handle of the characteristic.
+ * @return The handle or 0 if the reference is invalid.
+ */
+uint16_t NimBLERemoteCharacteristicRef::getHandle() const {
+    return m_handle;
+} // getHandle
+
+
+/**
+ * @brief Does the characteristic support reading?
+ * @return True if the characteristic supports reading.
+ */
+bool NimBLERemoteCharacteristicRef::canRead() const {
+    return (m_charProp & BLE_GATT_CHR_PROP_READ) != 0;
+} // canRead
+
+
+/**
+ * @brief Does the characteristic support writing?
+ * @return True if the characteristic supports writing.
+ */
+bool NimBLERemoteCharacteristicRef::canWrite() const {
+    return (m_charProp & BLE_GATT_CHR_PROP_WRITE) != 0;
+} // canWrite
+
+
+/**
+ * @brief Does the characteristic support writing with no response?
+ * @return True if the characteristic supports writing with no response.
+ */
+bool NimBLERemoteCharacteristicRef::canWriteNoResponse() const {
+    return (m_charProp & BLE_GATT_CHR_PROP_WRITE_NO_RSP) != 0;
+} // canWriteNoResponse
+
+
+/**
+ * @brief Does the characteristic support notifications?
+ * @return True if the characteristic supports notifications.
+ */
+bool NimBLERemoteCharacteristicRef::canNotify() const {
+    return (m_charProp & BLE_GATT_CHR_PROP_NOTIFY) != 0;
+} // canNotify
+
+
+/**
+ * @brief Does the characteristic support indications?
+ * @return True if the characteristic supports indications.
+ */
+bool NimBLERemoteCharacteristicRef::canIndicate() const {
+    return (m_charProp & BLE_GATT_CHR_PROP_INDICATE) != 0;
+} // canIndicate
+
+
+/**
+ * @brief Read the value of the remote characteristic.
+ * @param [out] rc If not nullptr, the result of the read, 0 on success.
+ * @return The value read, empty on an error.
+ * @details The value is not stored in the NimBLERemoteCharacteristic.
+ */
+NimBLEAttValue NimBLERemoteCharacteristicRef::readValue(int *rc) {
+    NimBLEAttValue value;
+    int ret = BLE_HS_ENOTCONN;
+
+    if(!check()) {
+        ret = BLE_HS_ENOENT;
+    } else if(m_pClient->isConnected()) {
+        NimBLEClientOperation op(m_pClient);
+        TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+        ble_task_data_t taskData = {this, cur_task, 0, &value};
+        int retryCount = 1;
+
+        do {
+            NIMBLE_CPP_LATENCY_START(latencyStart);
+            ret = ble_gattc_read_long(m_pClient->getConnId(), m_handle, 0,
+                                      NimBLERemoteCharacteristicRef::onReadCB, &taskData);
+            if(ret != 0) {
+                NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d, %s",
+                                      ret, NimBLEUtils::returnCodeToString(ret));
+                break;
+            }
+
+#ifdef ulTaskNotifyValueClear
+            // Clear the task notification value to ensure we block
+            ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            NIMBLE_CPP_LATENCY_RECORD(m_pClient, READ, latencyStart);
+            ret = taskData.rc;
+            NIMBLE_CPP_CONN_STATS_ATT_RESULT(m_pClient->getConnId(), ret);
+
+            switch(ret) {
+                case 0:
+                case BLE_HS_EDONE:
+                case BLE_HS_ATT_ERR(BLE_ATT_ERR_ATTR_NOT_LONG):
+                    ret = 0;
+                    break;
+                case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN):
+                case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHOR):
+                case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC):
+                    if(retryCount && m_pClient->secureConnection()) {
+                        value = NimBLEAttValue();
+                        break;
+                    }
+                /* Else falls through. */
+                default:
+                    retryCount = 0;
+                    break;
+            }
+        } while(ret != 0 && retryCount--);
+
+        if(ret == 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(m_pClient->getConnId(), readTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(m_pClient->getConnId(), readTxBytes, value.size());
+            value.setTimeStamp();
+        } else {
+            value = NimBLEAttValue();
+        }
+    }
+
+    if(rc != nullptr) {
+        *rc = ret;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< readValue handle: %d length: %d rc=%d", m_handle, value.length(), ret);
+    return value;
+} // readValue
+
+
+/**
+ * @brief Write a string to the remote characteristic.
+ * @param [in] s The string to write.
+ * @param [in] response Whether we require a response from the write.
+ * @return True if the write succeeded or was sent without response.
+ */
+bool NimBLERemoteCharacteristicRef::writeValue(const char *s, bool response) {
+    return writeValue((uint8_t*)s, strlen(s), response);
+} // writeValue
+
+
+/**
+ * @brief Write a new value to the remote characteristic.
+ * @param [in] data A pointer to the data to write.
+ * @param [in] length The length of the data.
+ * @param [in] response Whether we require a response from the write.
+ * @return True if the write succeeded or was sent without response.
+ */
+bool NimBLERemoteCharacteristicRef::writeValue(const uint8_t *data, size_t length, bool response) {
+    if(!check() || !m_pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "<< writeValue, handle %d not available", m_handle);
+        return false;
+    }
+
+    uint16_t connId = m_pClient->getConnId();
+    uint16_t mtu = ble_att_mtu(connId) - 3;
+    int rc = 0;
+
+    if(length <= mtu && !response) {
+        os_mbuf *om = ble_hs_mbuf_from_flat(data, length);
+        if(om == nullptr) {
+            return false;
+        }
+        ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+        rc = ble_gattc_write_no_rsp(connId, m_handle, om);
+        if(rc == 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(connId, writeTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(connId, writeTxBytes, length);
+        }
+        return rc == 0;
+    }
+
+    NimBLEClientOperation op(m_pClient);
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {this, cur_task, 0, nullptr};
+    int retryCount = 1;
+
+    do {
+        NIMBLE_CPP_LATENCY_START(latencyStart);
+        os_mbuf *om = ble_hs_mbuf_from_flat(data, length);
+        if(om == nullptr) {
+            return false;
+        }
+        ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+
+        if(length > mtu) {
+            rc = ble_gattc_write_long(connId, m_handle, 0, om,
+                                      NimBLERemoteCharacteristicRef::onWriteCB, &taskData);
+        } else {
+            rc = ble_gattc_write(connId, m_handle, om,
+                                 NimBLERemoteCharacteristicRef::onWriteCB, &taskData);
+        }
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
+            return false;
+        }
+
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        NIMBLE_CPP_LATENCY_RECORD(m_pClient, WRITE, latencyStart);
+        rc = taskData.rc;
+        NIMBLE_CPP_CONN_STATS_ATT_RESULT(connId, rc);
+
+        switch(rc) {
+            case 0:
+            case BLE_HS_EDONE:
+                rc = 0;
+                break;
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_ATTR_NOT_LONG):
+                NIMBLE_LOGE(LOG_TAG, "Long write not supported by peer; Truncating length to %d", mtu);
+                retryCount++;
+                length = mtu;
+                break;
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHOR):
+            case BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC):
+                if(retryCount && m_pClient->secureConnection())
+                    break;
+            /* Else falls through. */
+            default:
+                NIMBLE_LOGE(LOG_TAG, "<< writeValue, rc: %d", rc);
+                return false;
+        }
+    } while(rc != 0 && retryCount--);
+
+    if(rc == 0) {
+        NIMBLE_CPP_CONN_STATS_ADD(connId, writeTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(connId, writeTxBytes, length);
+    }
+
+    return rc == 0;
+} // writeValue
+
+
+/**
+ * @brief Callback for the read of a characteristic reference.
+ * @return success == 0 or error code.
+ */
+int NimBLERemoteCharacteristicRef::onReadCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLERemoteCharacteristicRef *pRef = (NimBLERemoteCharacteristicRef*)pTaskData->pATT;
+
+    if(pRef->m_pClient->getConnId() != conn_handle) {
+        return 0;
+    }
+
+    NimBLEAttValue *valBuf = (NimBLEAttValue*)pTaskData->buf;
+    int rc = error->status;
+
+    if(rc == 0 && attr) {
+        uint16_t data_len = OS_MBUF_PKTLEN(attr->om);
+        if((valBuf->size() + data_len) > BLE_ATT_ATTR_MAX_LEN) {
+            rc = BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        } else {
+            valBuf->append(attr->om->om_data, data_len);
+            return 0;
+        }
+    }
+
+    pTaskData->rc = rc;
+    xTaskNotifyGive(pTaskData->task);
+    return rc;
+} // onReadCB
+
+
+/**
+ * @brief Callback for the write of a characteristic reference.
+ * @return success == 0 or error code.
+ */
+int NimBLERemoteCharacteristicRef::onWriteCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg)
+{
+    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    NimBLERemoteCharacteristicRef *pRef = (NimBLERemoteCharacteristicRef*)pTaskData->pATT;
+
+    if(pRef->m_pClient->getConnId() != conn_handle) {
+        return 0;
+    }
+
+    pTaskData->rc = error->status;
+    xTaskNotifyGive(pTaskData->task);
+    return 0;
+} // onWriteCB
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL */
@@ -0,0 +1,121 @@
+/*
+ * NimBLERemoteCharacteristicRef.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEREMOTECHARACTERISTICREF_H_
+#define NIMBLEREMOTECHARACTERISTICREF_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_gatt.h"
+#else
+#include "nimble/nimble/host/include/host/ble_gatt.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include "NimBLEUtils.h"
+#include "NimBLEAttValue.h"
+
+class NimBLEClient;
+class NimBLERemoteCharacteristic;
+
+/**
+ * @brief A reference to a remote characteristic that reads and writes its value by handle.
+ * @details Get one from NimBLERemoteCharacteristic::getRef() or NimBLEClient::getCharacteristicRef()
+ * once the attributes are discovered and keep it instead of looking up the service and characteristic
+ * by UUID for every access. It holds only the client, the value handle and the properties,
+ * so it is cheap to copy, and the connection handle is taken from the client for each access.\n
+ * The reference stays usable across reconnections as long as the client has the characteristic at
+ * the same handle, for example when the attributes are kept or restored from the GATT cache. When the
+ * attributes of the client change the handle is checked once against them, if the characteristic
+ * is gone or its properties differ the reference becomes invalid.\n
+ * It must not be used after the client is deleted.
+ */
+class NimBLERemoteCharacteristicRef {
+public:
+    NimBLERemoteCharacteristicRef();
+    NimBLERemoteCharacteristicRef(NimBLERemoteCharacteristic *pChr);
+
+    bool             isValid();
+    NimBLEClient*    getClient() const;
+    uint16_t         getHandle() const;
+    bool             canRead() const;
+    bool             canWrite() const;
+    bool             canWriteNoResponse() const;
+    bool             canNotify() const;
+    bool             canIndicate() const;
+    NimBLEAttValue   readValue(int *rc = nullptr);
+    bool             writeValue(const uint8_t *data, size_t length, bool response = false);
+    bool             writeValue(const char *s, bool response = false);
+
+    /**
+     * @brief Template to write <type\>val to the remote characteristic.
+     * @param [in] s The value to write.
+     * @param [in] response True == request write response.
+     * @details Only used for non-arrays and types without a `c_str()` method.
+     */
+    template<typename T>
+#ifdef _DOXYGEN_
+    bool
+#else
+    typename std::enable_if<!std::is_array<T>::value && !Has_c_str_len<T>::value, bool>::type
+#endif
+    writeValue(const T& s, bool response = false) {
+        return writeValue((uint8_t*)&s, sizeof(T), response);
+    }
+
+    /**
+     * @brief Template to write <type\>val to the remote characteristic.
+     * @param [in] s The value to write.
+     * @param [in] response True == request write response.
+     * @details Only used if the <type\> has a `c_str()` method.
+     */
+    template<typename T>
+#ifdef _DOXYGEN_
+    bool
+#else
+    typename std::enable_if<Has_c_str_len<T>::value, bool>::type
+#endif
+    writeValue(const T& s, bool response = false) {
+        return writeValue((uint8_t*)s.c_str(), s.length(), response);
+    }
+
+    /**
+     * @brief Template to read the remote characteristic value as <type\>.
+     * @tparam T The type to convert the data to.
+     * @param [in] skipSizeCheck If true it will skip checking if the data size is less than <tt>sizeof(<type\>)</tt>.
+     * @return The data converted to <type\> or NULL if skipSizeCheck is false and the data is
+     * less than <tt>sizeof(<type\>)</tt>.
+     */
+    template<typename T>
+    T readValue(bool skipSizeCheck = false) {
+        NimBLEAttValue value = readValue();
+        return value.getValue<T>(nullptr, skipSizeCheck);
+    }
+
+private:
+    bool             check();
+    static int       onReadCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                              struct ble_gatt_attr *attr, void *arg);
+    static int       onWriteCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                               struct ble_gatt_attr *attr, void *arg);
+
+    NimBLEClient*    m_pClient;
+    uint16_t         m_handle;
+    uint16_t         m_mapGen;
+    uint8_t          m_charProp;
+    uint8_t          m_txPrio;
+}; // NimBLERemoteCharacteristicRef
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_CENTRAL */
+#endif /* NIMBLEREMOTECHARACTERISTICREF_H_ */
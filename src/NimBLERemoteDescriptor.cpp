@@ -49,10 +49,36 @@ NimBLERemoteDescriptor::NimBLERemoteDescriptor(NimBLERemoteCharacteristic* pRemo
     m_handle                = dsc->handle;
     m_pRemoteCharacteristic = pRemoteCharacteristic;
 
-    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteDescriptor(): %s", m_uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteDescriptor(): %s", NIMBLE_CPP_STR(m_uuid));
 }
 
 
+/**
+ * @brief Allocate a remote descriptor, from the arena of the client when one is configured.
+ * @param [in] size The size of the object.
+ * @param [in] pClient The client the descriptor belongs to.
+ */
+void* NimBLERemoteDescriptor::operator new(size_t size, NimBLEClient* pClient) {
+    return NimBLEClient::allocAttribute(size, pClient);
+} // operator new
+
+
+/**
+ * @brief Return the memory of a remote descriptor that failed to construct.
+ */
+void NimBLERemoteDescriptor::operator delete(void* ptr, NimBLEClient* pClient) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
+
+/**
+ * @brief Return a remote descriptor to the arena or the heap it was allocated from.
+ */
+void NimBLERemoteDescriptor::operator delete(void* ptr) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
+
 /**
  * @brief Retrieve the handle associated with this remote descriptor.
  * @return The handle associated with this remote descriptor.
@@ -127,6 +153,7 @@ NimBLEAttValue NimBLERemoteDescriptor::readValue() {
 
     int rc = 0;
     int retryCount = 1;
+    NimBLEClientOperation op(pClient);
     TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
     ble_task_data_t taskData = {this, cur_task, 0, &value};
 
@@ -306,6 +333,7 @@ bool NimBLERemoteDescriptor::writeValue(const uint8_t* data, size_t length, bool
         return (rc == 0);
     }
 
+    NimBLEClientOperation op(pClient);
     TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
     ble_task_data_t taskData = {this, cur_task, 0, nullptr};
 
@@ -19,13 +19,19 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 
 #include "NimBLERemoteCharacteristic.h"
+#include "NimBLEArena.h"
 
+class NimBLEClient;
 class NimBLERemoteCharacteristic;
 /**
  * @brief A model of remote %BLE descriptor.
  */
 class NimBLERemoteDescriptor {
 public:
+    static void*    operator new(size_t size, NimBLEClient* pClient);
+    static void     operator delete(void* ptr, NimBLEClient* pClient);
+    static void     operator delete(void* ptr);
+
     uint16_t                    getHandle();
     NimBLERemoteCharacteristic* getRemoteCharacteristic();
     NimBLEUUID                  getUUID();
@@ -85,12 +91,12 @@ public:
     template<typename T>
     T readValue(bool skipSizeCheck = false) {
         NimBLEAttValue value = readValue();
-        if(!skipSizeCheck && value.size() < sizeof(T)) return T();
-        return *((T *)value.data());
+        return value.getValue<T>(nullptr, skipSizeCheck);
     }
 
 private:
     friend class                NimBLERemoteCharacteristic;
+    friend class                NimBLEClient;
 
     NimBLERemoteDescriptor      (NimBLERemoteCharacteristic* pRemoteCharacteristic,
                                 const struct ble_gatt_dsc *dsc);
@@ -48,7 +48,7 @@ NimBLERemoteService::NimBLERemoteService(NimBLEClient* pClient, const struct ble
     }
     m_startHandle = service->start_handle;
     m_endHandle = service->end_handle;
-    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteService(): %s", m_uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, "<< NimBLERemoteService(): %s", NIMBLE_CPP_STR(m_uuid));
 }
 
 
@@ -60,6 +60,32 @@ NimBLERemoteService::~NimBLERemoteService() {
 }
 
 
+/**
+ * @brief Allocate a remote service, from the arena of the client when one is configured.
+ * @param [in] size The size of the object.
+ * @param [in] pClient The client the service belongs to.
+ */
+void* NimBLERemoteService::operator new(size_t size, NimBLEClient* pClient) {
+    return NimBLEClient::allocAttribute(size, pClient);
+} // operator new
+
+
+/**
+ * @brief Return the memory of a remote service that failed to construct.
+ */
+void NimBLERemoteService::operator delete(void* ptr, NimBLEClient* pClient) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
+
+/**
+ * @brief Return a remote service to the arena or the heap it was allocated from.
+ */
+void NimBLERemoteService::operator delete(void* ptr) {
+    NimBLEClient::freeAttribute(ptr);
+} // operator delete
+
+
 /**
  * @brief Get iterator to the beginning of the vector of remote characteristic pointers.
  * @return An iterator to the beginning of the vector of remote characteristic pointers.
@@ -94,47 +120,19 @@ NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(const char* u
  * @return A pointer to the characteristic object, or nullptr if not found.
  */
 NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(const NimBLEUUID &uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> getCharacteristic: uuid: %s", uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> getCharacteristic: uuid: %s", NIMBLE_CPP_STR(uuid));
 
     for(auto &it: m_characteristicVector) {
         if(it->getUUID() == uuid) {
-            NIMBLE_LOGD(LOG_TAG, "<< getCharacteristic: found the characteristic with uuid: %s", uuid.toString().c_str());
+            NIMBLE_LOGD(LOG_TAG, "<< getCharacteristic: found the characteristic with uuid: %s", NIMBLE_CPP_STR(uuid));
             return it;
         }
     }
 
+    // Only the requested characteristic is discovered and stored, matching any size of the UUID.
     size_t prev_size = m_characteristicVector.size();
-    if(retrieveCharacteristics(&uuid)) {
-        if(m_characteristicVector.size() > prev_size) {
-            return m_characteristicVector.back();
-        }
-
-        // If the request was successful but 16/32 bit uuid not found
-        // try again with the 128 bit uuid.
-        if(uuid.bitSize() == BLE_UUID_TYPE_16 ||
-           uuid.bitSize() == BLE_UUID_TYPE_32)
-        {
-            NimBLEUUID uuid128(uuid);
-            uuid128.to128();
-            if (retrieveCharacteristics(&uuid128)) {
-                if(m_characteristicVector.size() > prev_size) {
-                    return m_characteristicVector.back();
-                }
-            }
-        } else {
-            // If the request was successful but the 128 bit uuid not found
-            // try again with the 16 bit uuid.
-            NimBLEUUID uuid16(uuid);
-            uuid16.to16();
-            // if the uuid was 128 bit but not of the BLE base type this check will fail
-            if (uuid16.bitSize() == BLE_UUID_TYPE_16) {
-                if(retrieveCharacteristics(&uuid16)) {
-                    if(m_characteristicVector.size() > prev_size) {
-                        return m_characteristicVector.back();
-                    }
-                }
-            }
-        }
+    if(retrieveCharacteristics(&uuid) && m_characteristicVector.size() > prev_size) {
+        return m_characteristicVector.back();
     }
 
     NIMBLE_LOGD(LOG_TAG, "<< getCharacteristic: not found");
@@ -175,7 +173,8 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
     NIMBLE_LOGD(LOG_TAG,"Characteristic Discovered >> status: %d handle: %d",
                         error->status, (error->status == 0) ? chr->val_handle : -1);
 
-    ble_task_data_t *pTaskData = (ble_task_data_t*)arg;
+    chr_filter_t *filter = (chr_filter_t*)arg;
+    ble_task_data_t *pTaskData = (ble_task_data_t*)filter->task_data;
     NimBLERemoteService *service = (NimBLERemoteService*)pTaskData->pATT;
 
     // Make sure the discovery is for this device
@@ -184,13 +183,35 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
     }
 
     if(error->status == 0) {
-        // Found a service - add it to the vector
-        NimBLERemoteCharacteristic* pRemoteCharacteristic = new NimBLERemoteCharacteristic(service, chr);
+        if(filter->uuid != nullptr) {
+            // The declaration after the match gives its end handle, no need to look further.
+            if(filter->found != nullptr) {
+                filter->found->m_endHandle = chr->def_handle - 1;
+                pTaskData->rc = 0;
+                xTaskNotifyGive(pTaskData->task);
+                return BLE_HS_EDONE;
+            }
+
+            if(NimBLEUUID(&chr->uuid) != *filter->uuid) {
+                return 0;
+            }
+        }
+
+        // Found a characteristic - add it to the vector
+        NimBLERemoteCharacteristic* pRemoteCharacteristic =
+            new (service->getClient()) NimBLERemoteCharacteristic(service, chr);
         service->m_characteristicVector.push_back(pRemoteCharacteristic);
+        service->m_pClient->m_charHandleMapValid = false;
+        if(filter->uuid != nullptr) {
+            filter->found = pRemoteCharacteristic;
+        }
         return 0;
     }
 
     if(error->status == BLE_HS_EDONE) {
+        if(filter->found != nullptr) {
+            filter->found->m_endHandle = service->getEndHandle();
+        }
         pTaskData->rc = 0;
     } else {
         NIMBLE_LOGE(LOG_TAG, "characteristicDiscCB() rc=%d %s",
@@ -212,26 +233,22 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
  * @return True if successful.
  */
 bool NimBLERemoteService::retrieveCharacteristics(const NimBLEUUID *uuid_filter) {
-    NIMBLE_LOGD(LOG_TAG, ">> retrieveCharacteristics() for service: %s", getUUID().toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> retrieveCharacteristics() for service: %s", NIMBLE_CPP_STR(getUUID()));
 
     int rc = 0;
+    NimBLEClientOperation op(m_pClient);
     TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
     ble_task_data_t taskData = {this, cur_task, 0, nullptr};
+    chr_filter_t filter = {uuid_filter, &taskData, nullptr};
+    NIMBLE_CPP_LATENCY_START(latencyStart);
 
-    if(uuid_filter == nullptr) {
-        rc = ble_gattc_disc_all_chrs(m_pClient->getConnId(),
-                             m_startHandle,
-                             m_endHandle,
-                             NimBLERemoteService::characteristicDiscCB,
-                             &taskData);
-    } else {
-        rc = ble_gattc_disc_chrs_by_uuid(m_pClient->getConnId(),
-                             m_startHandle,
-                             m_endHandle,
-                             &uuid_filter->getNative()->u,
-                             NimBLERemoteService::characteristicDiscCB,
-                             &taskData);
-    }
+    // The filter is applied in the callback rather than with ble_gattc_disc_chrs_by_uuid so that
+    // 16 and 128 bit forms of the UUID match in one pass and discovery stops once it is found.
+    rc = ble_gattc_disc_all_chrs(m_pClient->getConnId(),
+                                 m_startHandle,
+                                 m_endHandle,
+                                 NimBLERemoteService::characteristicDiscCB,
+                                 &filter);
 
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_chrs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
@@ -243,22 +260,11 @@ bool NimBLERemoteService::retrieveCharacteristics(const NimBLEUUID *uuid_filter)
     ulTaskNotifyValueClear(cur_task, ULONG_MAX);
 #endif
     ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    NIMBLE_CPP_LATENCY_RECORD(m_pClient, DISCOVER_CHARACTERISTICS, latencyStart);
 
     if(taskData.rc == 0){
         if (uuid_filter == nullptr) {
-            if (m_characteristicVector.size() > 1) {
-                for (auto it = m_characteristicVector.begin(); it != m_characteristicVector.end(); ++it ) {
-                    auto nx = std::next(it, 1);
-                    if (nx == m_characteristicVector.end()) {
-                        break;
-                    }
-                    (*it)->m_endHandle = (*nx)->m_defHandle - 1;
-                }
-            }
-
-            if (m_characteristicVector.size() > 0) {
-                m_characteristicVector.back()->m_endHandle = getEndHandle();
-            }
+            setCharacteristicEndHandles();
         }
 
         NIMBLE_LOGD(LOG_TAG, "<< retrieveCharacteristics()");
@@ -271,6 +277,27 @@ bool NimBLERemoteService::retrieveCharacteristics(const NimBLEUUID *uuid_filter)
 } // retrieveCharacteristics
 
 
+/**
+ * @brief Set the end handle of each characteristic from the definition handle of the next one.
+ * @details Only valid when all the characteristics of the service have been discovered.
+ */
+void NimBLERemoteService::setCharacteristicEndHandles() {
+    if (m_characteristicVector.size() > 1) {
+        for (auto it = m_characteristicVector.begin(); it != m_characteristicVector.end(); ++it ) {
+            auto nx = std::next(it, 1);
+            if (nx == m_characteristicVector.end()) {
+                break;
+            }
+            (*it)->m_endHandle = (*nx)->m_defHandle - 1;
+        }
+    }
+
+    if (m_characteristicVector.size() > 0) {
+        m_characteristicVector.back()->m_endHandle = getEndHandle();
+    }
+} // setCharacteristicEndHandles
+
+
 /**
  * @brief Get the client associated with this service.
  * @return A reference to the client associated with this service.
@@ -310,7 +337,7 @@ NimBLEUUID NimBLERemoteService::getUUID() {
  * @returns a string containing the value or an empty string if not found or error.
  */
 std::string NimBLERemoteService::getValue(const NimBLEUUID &characteristicUuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> readValue: uuid: %s", characteristicUuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> readValue: uuid: %s", NIMBLE_CPP_STR(characteristicUuid));
 
     std::string ret = "";
     NimBLERemoteCharacteristic* pChar = getCharacteristic(characteristicUuid);
@@ -331,7 +358,7 @@ std::string NimBLERemoteService::getValue(const NimBLEUUID &characteristicUuid)
  * @returns true on success, false if not found or error
  */
 bool NimBLERemoteService::setValue(const NimBLEUUID &characteristicUuid, const std::string &value) {
-    NIMBLE_LOGD(LOG_TAG, ">> setValue: uuid: %s", characteristicUuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> setValue: uuid: %s", NIMBLE_CPP_STR(characteristicUuid));
 
     bool ret = false;
     NimBLERemoteCharacteristic* pChar = getCharacteristic(characteristicUuid);
@@ -357,6 +384,7 @@ void NimBLERemoteService::deleteCharacteristics() {
         delete it;
     }
     m_characteristicVector.clear();
+    m_pClient->m_charHandleMapValid = false;
     NIMBLE_LOGD(LOG_TAG, "<< deleteCharacteristics");
 } // deleteCharacteristics
 
@@ -373,6 +401,7 @@ size_t NimBLERemoteService::deleteCharacteristic(const NimBLEUUID &uuid) {
         if((*it)->getUUID() == uuid) {
             delete *it;
             m_characteristicVector.erase(it);
+            m_pClient->m_charHandleMapValid = false;
             break;
         }
     }
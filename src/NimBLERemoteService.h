@@ -19,6 +19,7 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
 
 #include "NimBLEClient.h"
+#include "NimBLEArena.h"
 #include "NimBLEUUID.h"
 #include "NimBLERemoteCharacteristic.h"
 
@@ -27,12 +28,22 @@
 class NimBLEClient;
 class NimBLERemoteCharacteristic;
 
+typedef struct {
+    const NimBLEUUID           *uuid;
+    void                       *task_data;
+    NimBLERemoteCharacteristic *found;
+} chr_filter_t;
+
 
 /**
  * @brief A model of a remote %BLE service.
  */
 class NimBLERemoteService {
 public:
+    static void*    operator new(size_t size, NimBLEClient* pClient);
+    static void     operator delete(void* ptr, NimBLEClient* pClient);
+    static void     operator delete(void* ptr);
+
     virtual ~NimBLERemoteService();
 
     // Public methods
@@ -61,6 +72,7 @@ private:
 
     // Private methods
     bool                retrieveCharacteristics(const NimBLEUUID *uuid_filter = nullptr);
+    void                setCharacteristicEndHandles();
     static int          characteristicDiscCB(uint16_t conn_handle,
                                              const struct ble_gatt_error *error,
                                              const struct ble_gatt_chr *chr,
@@ -18,12 +18,35 @@
 #include "NimBLEScan.h"
 #include "NimBLEDevice.h"
 #include "NimBLELog.h"
+#include "NimBLEBroadcastTransfer.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
 
 #include <string>
 #include <climits>
+#include <algorithm>
 
 static const char* LOG_TAG = "NimBLEScan";
 
+#if defined(CONFIG_BT_NIMBLE_MESH)
+/**
+ * @brief Check if an advertisement carries a mesh PDU or beacon, these are handled by the mesh stack.
+ */
+static bool isMeshReport(uint8_t eventType, bool isLegacyAdv, const uint8_t* data, uint8_t length) {
+    if(!isLegacyAdv || eventType != BLE_HCI_ADV_RPT_EVTYPE_NONCONN_IND || length < 2) {
+        return false;
+    }
+
+    return data[1] == BLE_HS_ADV_TYPE_MESH_PROV ||
+           data[1] == BLE_HS_ADV_TYPE_MESH_MESSAGE ||
+           data[1] == BLE_HS_ADV_TYPE_MESH_BEACON;
+} // isMeshReport
+#endif
+
 
 /**
  * @brief Scan constuctor.
@@ -35,11 +58,55 @@ NimBLEScan::NimBLEScan() {
     m_scan_params.window             = 0; // The duration of the LE scan. LE_Scan_Window shall be less than or equal to LE_Scan_Interval (units=0.625 msec)
     m_scan_params.limited            = 0; // If set, only discover devices in limited discoverable mode.
     m_scan_params.filter_duplicates  = 1; // If set, the controller ignores all but the first advertisement from each device.
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    m_scanPhys                       = BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_CODED_MASK;
+    memset(m_phyParams, 0, sizeof(m_phyParams)); // 0 interval and window use setInterval and setWindow.
+#endif
     m_pAdvertisedDeviceCallbacks     = nullptr;
     m_ignoreResults                  = false;
+    m_dupRefreshMs                   = 0;
+    m_scanEnd                        = 0;
+    m_paused                         = false;
+    m_dupRefreshUs                   = 0;
     m_pTaskData                      = nullptr;
     m_duration                       = BLE_HS_FOREVER; // make sure this is non-zero in the event of a host reset
     m_maxResults                     = 0xFF;
+    m_batchSize                      = 0;
+    m_reportOnChange                 = false;
+    m_changeAdType                   = 0;
+    m_changeRssiDelta                = 0;
+    m_maxAge                         = 0;
+    m_lastAgeCheck                   = 0;
+    m_evictOldest                    = false;
+    m_pBroadcastReceiver             = nullptr;
+    m_watchCount                     = 0;
+    m_watchOnly                      = false;
+    m_reportTask                     = nullptr;
+    m_reports                        = nullptr;
+    m_reportQueueSize                = 0;
+    m_reportHead                     = 0;
+    m_reportTail                     = 0;
+    m_reportDrops                    = 0;
+    m_discCompletePending            = false;
+    m_batchFlushPending              = false;
+    m_resultsHolds                   = 0;
+    m_resultsTask                    = nullptr;
+    m_resultsWaiters                 = 0;
+    ble_npl_sem_init(&m_resultsSem, 0);
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+    m_pPeriodicSyncCallbacks         = nullptr;
+#endif
+    m_discCompleteReason             = 0;
+    m_batchTimeout                   = 0;
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    m_meshScan                       = false;
+    m_appScan                        = false;
+#endif
+    clearFilters();
+
+    memset(&m_batchTimer, 0, sizeof(m_batchTimer));
+    ble_npl_callout_init(&m_batchTimer, nimble_port_get_dflt_eventq(),
+                         NimBLEScan::batchTimerCb, this);
 }
 
 
@@ -47,7 +114,14 @@ NimBLEScan::NimBLEScan() {
  * @brief Scan destructor, release any allocated resources.
  */
 NimBLEScan::~NimBLEScan() {
+     if(m_reportTask != nullptr) {
+         vTaskDelete(m_reportTask);
+         delete[] m_reports;
+     }
+
      clearResults();
+     ble_npl_callout_deinit(&m_batchTimer);
+     ble_npl_sem_deinit(&m_resultsSem);
 }
 
 /**
@@ -57,12 +131,47 @@ NimBLEScan::~NimBLEScan() {
  */
 /*STATIC*/int NimBLEScan::handleGapEvent(ble_gap_event* event, void* arg) {
     (void)arg;
+    NIMBLE_CPP_STACK_PROFILE(SCAN_GAP_EVENT, event->type);
+    NIMBLE_CPP_TRACE_GAP(SCAN_GAP, event);
     NimBLEScan* pScan = NimBLEDevice::getScan();
 
+    // Leaves the results when the event handling returns.
+    struct ResultsGuard {
+        NimBLEScan* pScan;
+        bool        entered;
+        ~ResultsGuard() {
+            if(entered) {
+                pScan->leaveResults();
+            }
+        }
+    };
+
+#if CONFIG_NIMBLE_CPP_RADIO_ACTIVITY
+    // Count the end of the scan when it happens, a queued completion could follow a new scan.
+    if(event->type == BLE_GAP_EVENT_DISC_COMPLETE && xTaskGetCurrentTaskHandle() != pScan->m_reportTask) {
+        NIMBLE_CPP_RADIO_SCAN_STOP();
+    }
+#endif
+
+    // If the report task is running, hand the scan events to it and return to the host quickly.
+    if(pScan->m_reportTask != nullptr && xTaskGetCurrentTaskHandle() != pScan->m_reportTask &&
+       (event->type == BLE_GAP_EVENT_DISC || event->type == BLE_GAP_EVENT_EXT_DISC ||
+        event->type == BLE_GAP_EVENT_DISC_COMPLETE)) {
+        pScan->queueReport(event);
+        return 0;
+    }
+
     switch(event->type) {
 
         case BLE_GAP_EVENT_EXT_DISC:
         case BLE_GAP_EVENT_DISC: {
+            // The results are not changed while a snapshot of them is held.
+            if(!pScan->enterResults()) {
+                pScan->m_reportDrops++;
+                return 0;
+            }
+            ResultsGuard guard = {pScan, true};
+
             if(pScan->m_ignoreResults) {
                 NIMBLE_LOGI(LOG_TAG, "Scan op in progress - ignoring results");
                 return 0;
@@ -75,39 +184,105 @@ NimBLEScan::~NimBLEScan() {
             const auto& disc = event->disc;
             const bool isLegacyAdv = true;
             const auto event_type = disc.event_type;
+#endif
+#if defined(CONFIG_BT_NIMBLE_MESH)
+            // The mesh stack receives these through its GAP event listener.
+            if(isMeshReport(event_type, isLegacyAdv, disc.data, disc.length_data)) {
+                return 0;
+            }
+#endif
+#if CONFIG_BT_NIMBLE_EXT_ADV
+            if(pScan->m_pBroadcastReceiver != nullptr && disc.data_status == BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE &&
+               pScan->m_pBroadcastReceiver->handleReport(disc.data, disc.length_data)) {
+                return 0;
+            }
+#else
+            if(pScan->m_pBroadcastReceiver != nullptr &&
+               pScan->m_pBroadcastReceiver->handleReport(disc.data, disc.length_data)) {
+                return 0;
+            }
 #endif
             NimBLEAddress advertisedAddress(disc.addr);
 
+            // Watched devices are dispatched from the watch index before any other processing.
+            if(pScan->m_watchCount > 0 || pScan->m_watchOnly) {
+                bool process = !pScan->m_watchOnly;
+                if(pScan->m_watchCount > 0) {
+#if CONFIG_BT_NIMBLE_EXT_ADV
+                    const uint8_t sid = disc.sid;
+                    const bool complete = disc.data_status != BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE;
+#else
+                    const uint8_t sid = 0;
+                    const bool complete = true;
+#endif
+                    NimBLEWatchReport report = {advertisedAddress, disc.rssi, sid, (uint8_t)event_type,
+                                                isLegacyAdv, complete, disc.data, disc.length_data,
+                                                NimBLEUtils::getTimeUs()};
+                    pScan->dispatchWatch(report, &process);
+                }
+
+                if(!process) {
+                    return 0;
+                }
+            }
+            const uint64_t now = NimBLEUtils::getTimeUs();
+            char addrStr[18];
+            (void)addrStr; // Only used when logging is enabled.
+
             // Examine our list of ignored addresses and stop processing if we don't want to see it or are already connected
             if(NimBLEDevice::isIgnored(advertisedAddress)) {
-                NIMBLE_LOGI(LOG_TAG, "Ignoring device: address: %s", advertisedAddress.toString().c_str());
+                NIMBLE_LOGI(LOG_TAG, "Ignoring device: address: %s",
+                            advertisedAddress.toString(addrStr, sizeof(addrStr)));
                 return 0;
             }
 
-            NimBLEAdvertisedDevice* advertisedDevice = nullptr;
+            // Remove devices that have not been seen within the max age, at most once per second.
+            // Devices not stored in the results are also kept for the duplicate refresh period.
+            if((pScan->m_maxAge > 0 || (pScan->m_maxResults == 0 && pScan->m_dupRefreshUs > 0)) &&
+               (uint32_t)(now / 1000000) != pScan->m_lastAgeCheck) {
+                pScan->m_lastAgeCheck = now / 1000000;
+                pScan->ageResults(now);
+            }
 
-            // If we've seen this device before get a pointer to it from the vector
-            for(auto &it: pScan->m_scanResults.m_advertisedDevicesVector) {
+            // If we've seen this device before get a pointer to it from the results index
 #if CONFIG_BT_NIMBLE_EXT_ADV
-                // Same address but different set ID should create a new advertised device.
-                if (it->getAddress() == advertisedAddress && it->getSetId() == disc.sid) {
+            // Same address but different set ID should create a new advertised device.
+            NimBLEAdvertisedDevice* advertisedDevice = pScan->m_scanResults.findDevice(advertisedAddress, disc.sid);
 #else
-                if (it->getAddress() == advertisedAddress) {
+            NimBLEAdvertisedDevice* advertisedDevice = pScan->m_scanResults.findDevice(advertisedAddress);
 #endif
-                    advertisedDevice = it;
-                    break;
-                }
+
+            // The scan response data is added to the advertisement data.
+            bool appendData = isLegacyAdv && event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP;
+            bool dataIncomplete = false;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+            // Chained extended advertisement data arrives in several reports, the fragments
+            // are added to the payload and the device is reported once the data is complete.
+            dataIncomplete = disc.data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE;
+            if (advertisedDevice != nullptr && advertisedDevice->m_dataIncomplete) {
+                appendData = true;
             }
+#endif
 
             // If we haven't seen this device before; create a new instance and insert it in the vector.
             // Otherwise just update the relevant parameters of the already known device.
             if (advertisedDevice == nullptr &&
                 (!isLegacyAdv || event_type != BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP)) {
-                // Check if we have reach the scan results limit, ignore this one if so.
+                // Reject devices that do not match the filters before creating a device for them,
+                // the filters are checked when the data is complete if it continues in the next report.
+                if (pScan->m_filterEnabled && !dataIncomplete &&
+                    !pScan->filterReport(disc.data, disc.length_data, disc.rssi, disc.addr.type)) {
+                    return 0;
+                }
+
+                // Check if we have reach the scan results limit, ignore this one if so
+                // unless the least recently seen device can be evicted to make room.
                 // We still need to store each device when maxResults is 0 to be able to append the scan results
                 if (pScan->m_maxResults > 0 && pScan->m_maxResults < 0xFF &&
                    (pScan->m_scanResults.m_advertisedDevicesVector.size() >= pScan->m_maxResults)) {
-                    return 0;
+                    if (!pScan->m_evictOldest || !pScan->evictOldest()) {
+                        return 0;
+                    }
                 }
 
                 advertisedDevice = new NimBLEAdvertisedDevice();
@@ -119,42 +294,68 @@ NimBLEScan::~NimBLEScan() {
                 advertisedDevice->setSecondaryPhy(disc.sec_phy);
                 advertisedDevice->setPeriodicInterval(disc.periodic_adv_itvl);
 #endif
-                pScan->m_scanResults.m_advertisedDevicesVector.push_back(advertisedDevice);
-                NIMBLE_LOGI(LOG_TAG, "New advertiser: %s", advertisedAddress.toString().c_str());
+                pScan->m_scanResults.addDevice(advertisedDevice);
+                NIMBLE_LOGI(LOG_TAG, "New advertiser: %s",
+                            advertisedAddress.toString(addrStr, sizeof(addrStr)));
             } else if (advertisedDevice != nullptr) {
-                NIMBLE_LOGI(LOG_TAG, "Updated advertiser: %s", advertisedAddress.toString().c_str());
+                NIMBLE_LOGI(LOG_TAG, "Updated advertiser: %s",
+                            advertisedAddress.toString(addrStr, sizeof(addrStr)));
             } else {
                 // Scan response from unknown device
                 return 0;
             }
 
-            advertisedDevice->m_timestamp = time(nullptr);
-            advertisedDevice->setRSSI(disc.rssi);
-            advertisedDevice->setPayload(disc.data, disc.length_data, (isLegacyAdv &&
-                                         event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP));
+            advertisedDevice->m_timestamp = now;
+            advertisedDevice->setRSSI(disc.rssi, isLegacyAdv && event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP);
+#if CONFIG_BT_NIMBLE_EXT_ADV
+            const bool wasIncomplete = advertisedDevice->m_dataIncomplete;
+            advertisedDevice->m_dataIncomplete = dataIncomplete;
+#endif
+            advertisedDevice->setPayload(disc.data, disc.length_data, appendData);
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+            if (dataIncomplete) {
+                return 0;
+            }
+
+            // The filters were not checked for a new device with chained data, check the complete data.
+            if (wasIncomplete && pScan->m_filterEnabled && !advertisedDevice->m_callbackSent &&
+                !pScan->filterReport(advertisedDevice->m_payload.data, advertisedDevice->m_payloadLength,
+                                     disc.rssi, disc.addr.type)) {
+                if (!advertisedDevice->m_batchPending) {
+                    pScan->m_scanResults.removeDevice(advertisedDevice);
+                    delete advertisedDevice;
+                }
+                return 0;
+            }
+#endif
 
             if (pScan->m_pAdvertisedDeviceCallbacks) {
-                if (pScan->m_scan_params.filter_duplicates && advertisedDevice->m_callbackSent) {
+                // With a host side duplicate refresh the device is reported again once the period passed.
+                if (pScan->m_scan_params.filter_duplicates && advertisedDevice->m_callbackSent &&
+                    (pScan->m_dupRefreshUs == 0 || now - advertisedDevice->m_callbackTime < pScan->m_dupRefreshUs)) {
                     return 0;
                 }
 
                 // If not active scanning or scan response is not available
                 // or extended advertisement scanning, report the result to the callback now.
-                if(pScan->m_scan_params.passive || !isLegacyAdv ||
-                  (advertisedDevice->getAdvType() != BLE_HCI_ADV_TYPE_ADV_IND &&
-                   advertisedDevice->getAdvType() != BLE_HCI_ADV_TYPE_ADV_SCAN_IND))
-                {
-                    advertisedDevice->m_callbackSent = true;
-                    pScan->m_pAdvertisedDeviceCallbacks->onResult(advertisedDevice);
-
                 // Otherwise, wait for the scan response so we can report the complete data.
-                } else if (isLegacyAdv && event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP) {
+                bool complete = pScan->m_scan_params.passive || !isLegacyAdv ||
+                                (advertisedDevice->getAdvType() != BLE_HCI_ADV_TYPE_ADV_IND &&
+                                 advertisedDevice->getAdvType() != BLE_HCI_ADV_TYPE_ADV_SCAN_IND) ||
+                                event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP;
+
+                if(complete && pScan->contentChanged(advertisedDevice)) {
                     advertisedDevice->m_callbackSent = true;
-                    pScan->m_pAdvertisedDeviceCallbacks->onResult(advertisedDevice);
+                    advertisedDevice->m_callbackTime = now;
+                    pScan->reportResult(advertisedDevice);
                 }
                 // If not storing results and we have invoked the callback, delete the device.
-                if(pScan->m_maxResults == 0 && advertisedDevice->m_callbackSent) {
-                    pScan->erase(advertisedAddress);
+                // Devices waiting in a batch are deleted when the batch is delivered.
+                if(pScan->m_maxResults == 0 && advertisedDevice->m_callbackSent &&
+                   !advertisedDevice->m_batchPending && pScan->m_dupRefreshUs == 0) {
+                    pScan->m_scanResults.removeDevice(advertisedDevice);
+                    delete advertisedDevice;
                 }
             }
 
@@ -164,17 +365,30 @@ NimBLEScan::~NimBLEScan() {
             NIMBLE_LOGD(LOG_TAG, "discovery complete; reason=%d",
                         event->disc_complete.reason);
 
+#if defined(CONFIG_BT_NIMBLE_MESH)
+            // Queued completions were already handled in the host task by queueReport.
+            if(xTaskGetCurrentTaskHandle() != pScan->m_reportTask) {
+                pScan->resumeMeshScan();
+            }
+#endif
+
+            // The completion is still reported while a snapshot holds the results, without changing them.
+            ResultsGuard guard = {pScan, pScan->enterResults()};
+
             // If a device advertised with scan response available and it was not received
             // the callback would not have been invoked, so do it here.
-            if(pScan->m_pAdvertisedDeviceCallbacks) {
-                for(auto &it : pScan->m_scanResults.m_advertisedDevicesVector) {
+            if(pScan->m_pAdvertisedDeviceCallbacks && guard.entered) {
+                // Delivering a full batch can delete devices from the results, so iterate a copy.
+                std::vector<NimBLEAdvertisedDevice*> devices = pScan->m_scanResults.m_advertisedDevicesVector;
+                for(auto &it : devices) {
                     if(!it->m_callbackSent) {
-                        pScan->m_pAdvertisedDeviceCallbacks->onResult(it);
+                        pScan->reportResult(it);
                     }
                 }
+                pScan->flushBatch();
             }
 
-            if(pScan->m_maxResults == 0) {
+            if(pScan->m_maxResults == 0 && guard.entered) {
                 pScan->clearResults();
             }
 
@@ -218,6 +432,19 @@ void NimBLEScan::setDuplicateFilter(bool enabled) {
 } // setDuplicateFilter
 
 
+/**
+ * @brief Report the devices again periodically while the duplicate filter is enabled, without restarting the scan.
+ * @param [in] periodMs The minimum time between two reports of a device in milliseconds, 0 to report them once.
+ * @details With extended advertising and a continuous scan the controller resets its duplicate cache each
+ * period, rounded to 1.28 second units, and pauses for 10ms at the start of each period. Otherwise the
+ * controller filter is disabled and each device is reported at most once per period by the host, which
+ * receives all of the advertisements. Takes effect on the next start of the scan.
+ */
+void NimBLEScan::setDuplicateRefresh(uint32_t periodMs) {
+    m_dupRefreshMs = periodMs;
+} // setDuplicateRefresh
+
+
 /**
  * @brief Set whether or not the BLE controller only report scan results
  * from devices advertising in limited discovery mode, i.e. directed advertising.
@@ -262,245 +489,1445 @@ void NimBLEScan::setMaxResults(uint8_t maxResults) {
 
 
 /**
- * @brief Set the call backs to be invoked.
- * @param [in] pAdvertisedDeviceCallbacks Call backs to be invoked.
- * @param [in] wantDuplicates  True if we wish to be called back with duplicates.  Default is false.
- */
-void NimBLEScan::setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks* pAdvertisedDeviceCallbacks,
-                                              bool wantDuplicates) {
-    setDuplicateFilter(!wantDuplicates);
-    m_pAdvertisedDeviceCallbacks = pAdvertisedDeviceCallbacks;
-} // setAdvertisedDeviceCallbacks
-
-
-/**
- * @brief Set the interval to scan.
- * @param [in] intervalMSecs The scan interval (how often) in milliseconds.
- */
-void NimBLEScan::setInterval(uint16_t intervalMSecs) {
-    m_scan_params.itvl = intervalMSecs / 0.625;
-} // setInterval
-
-
-/**
- * @brief Set the window to actively scan.
- * @param [in] windowMSecs How long to actively scan.
+ * @brief Set the time after which a device that has not advertised is removed from the results.
+ * @param [in] seconds The maximum age in seconds of a result, 0 = never remove (default).
+ * @details NimBLEAdvertisedDeviceCallbacks::onEvicted is called before each device is deleted.
  */
-void NimBLEScan::setWindow(uint16_t windowMSecs) {
-    m_scan_params.window = windowMSecs / 0.625;
-} // setWindow
+void NimBLEScan::setMaxResultAge(uint32_t seconds) {
+    m_maxAge = seconds;
+} // setMaxResultAge
 
 
 /**
- * @brief Get the status of the scanner.
- * @return true if scanning or scan starting.
+ * @brief Only report a device again when its advertised content changes or its RSSI moves.
+ * @param [in] enabled If true, repeated advertisements of a device are reported to the callbacks
+ * only when the content differs from the last report.
+ * @param [in] adType The AD type of the field compared, e.g. BLE_HS_ADV_TYPE_MFG_DATA,
+ * 0 to compare the whole payload.
+ * @param [in] rssiDelta Also report when the RSSI differs by this many dBm or more from the last report, 0 to ignore the RSSI.
+ * @details The content is compared by a hash kept with each device, so the devices must be stored in the
+ * results, maxResults must not be 0. Use with the duplicate filter disabled, see setDuplicateFilter,
+ * so every advertisement of a device reaches the host.
  */
-bool NimBLEScan::isScanning() {
-    return ble_gap_disc_active();
-}
+void NimBLEScan::setReportOnChange(bool enabled, uint8_t adType, uint8_t rssiDelta) {
+    m_reportOnChange  = enabled;
+    m_changeAdType    = adType;
+    m_changeRssiDelta = rssiDelta;
+} // setReportOnChange
 
 
 /**
- * @brief Start scanning.
- * @param [in] duration The duration in seconds for which to scan.
- * @param [in] scanCompleteCB A function to be called when scanning has completed.
- * @param [in] is_continue Set to true to save previous scan results, false to clear them.
- * @return True if scan started or false if there was an error.
+ * @brief Check if a device should be reported again when reporting on changes only.
+ * @param [in] pDevice A pointer to the device.
+ * @return True if the device has not been reported yet, its content changed or its RSSI moved past the threshold.
  */
-bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResults), bool is_continue) {
-    NIMBLE_LOGD(LOG_TAG, ">> start: duration=%" PRIu32, duration);
-
-    // Save the callback to be invoked when the scan completes.
-    m_scanCompleteCB = scanCompleteCB;
-    // Save the duration in the case that the host is reset so we can reuse it.
-    m_duration = duration;
-
-    // If 0 duration specified then we assume a continuous scan is desired.
-    if(duration == 0){
-        duration = BLE_HS_FOREVER;
-    }
-    else{
-        // convert duration to milliseconds
-        duration = duration * 1000;
+bool NimBLEScan::contentChanged(NimBLEAdvertisedDevice* pDevice) {
+    if(!m_reportOnChange) {
+        return true;
     }
 
-    // Set the flag to ignore the results while we are deleting the vector
-    if(!is_continue) {
-        m_ignoreResults = true;
+    const uint8_t* data = pDevice->m_payload.data;
+    size_t length = pDevice->m_payloadLength;
+    if(m_changeAdType != 0) {
+        size_t loc = 0;
+        if(pDevice->findAdvField(m_changeAdType, 0, &loc) > 0) {
+            data = &pDevice->m_payload.data[loc + 2];
+            length = pDevice->m_payload.data[loc] - 1;
+        } else {
+            length = 0;
+        }
     }
 
-# if CONFIG_BT_NIMBLE_EXT_ADV
-    ble_gap_ext_disc_params scan_params;
-    scan_params.passive = m_scan_params.passive;
-    scan_params.itvl    = m_scan_params.itvl;
-    scan_params.window  = m_scan_params.window;
-    int rc = ble_gap_ext_disc(NimBLEDevice::m_own_addr_type,
-                              duration/10,
-                              0,
-                              m_scan_params.filter_duplicates,
-                              m_scan_params.filter_policy,
-                              m_scan_params.limited,
-                              &scan_params,
-                              &scan_params,
-                              NimBLEScan::handleGapEvent,
-                              NULL);
-#else
-    int rc = ble_gap_disc(NimBLEDevice::m_own_addr_type,
-                          duration,
-                          &m_scan_params,
-                          NimBLEScan::handleGapEvent,
-                          NULL);
-#endif
-    switch(rc) {
-        case 0:
-            if(!is_continue) {
-                clearResults();
-            }
-            break;
-
-        case BLE_HS_EALREADY:
-            // Clear the cache if already scanning in case an advertiser was missed.
-            clearDuplicateCache();
-            break;
-
-        case BLE_HS_EBUSY:
-            NIMBLE_LOGE(LOG_TAG, "Unable to scan - connection in progress.");
-            break;
-
-        case BLE_HS_ETIMEOUT_HCI:
-        case BLE_HS_EOS:
-        case BLE_HS_ECONTROLLER:
-        case BLE_HS_ENOTSYNCED:
-            NIMBLE_LOGC(LOG_TAG, "Unable to scan - Host Reset");
-            break;
-
-        default:
-            NIMBLE_LOGE(LOG_TAG, "Error initiating GAP discovery procedure; rc=%d, %s",
-                        rc, NimBLEUtils::returnCodeToString(rc));
-            break;
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    for(size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619UL;
     }
 
-    m_ignoreResults = false;
-    NIMBLE_LOGD(LOG_TAG, "<< start()");
-
-    if(rc != 0 && rc != BLE_HS_EALREADY) {
+    int rssiDiff = pDevice->m_rssi - pDevice->m_reportedRssi;
+    if(pDevice->m_callbackSent && hash == pDevice->m_reportedHash &&
+       (m_changeRssiDelta == 0 || (rssiDiff < m_changeRssiDelta && -rssiDiff < m_changeRssiDelta))) {
         return false;
     }
+
+    pDevice->m_reportedHash = hash;
+    pDevice->m_reportedRssi = pDevice->m_rssi;
     return true;
-} // start
+} // contentChanged
 
 
 /**
- * @brief Start scanning and block until scanning has been completed.
- * @param [in] duration The duration in seconds for which to scan.
- * @param [in] is_continue Set to true to save previous scan results, false to clear them.
- * @return The NimBLEScanResults.
+ * @brief Set whether the least recently seen device is evicted when the results are full.
+ * @param [in] enabled If true, when the max results limit is reached the device that advertised least
+ * recently is removed to make room for a new device, otherwise new devices are ignored (default).
+ * @details NimBLEAdvertisedDeviceCallbacks::onEvicted is called before the device is deleted.
  */
-NimBLEScanResults NimBLEScan::start(uint32_t duration, bool is_continue) {
-    if(duration == 0) {
-        NIMBLE_LOGW(LOG_TAG, "Blocking scan called with duration = forever");
-    }
+void NimBLEScan::setEvictOldest(bool enabled) {
+    m_evictOldest = enabled;
+} // setEvictOldest
 
-    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
-    ble_task_data_t taskData = {nullptr, cur_task, 0, nullptr};
-    m_pTaskData = &taskData;
 
-    if(start(duration, nullptr, is_continue)) {
-#ifdef ulTaskNotifyValueClear
-        // Clear the task notification value to ensure we block
-        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
-#endif
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+/**
+ * @brief Remove a device from the results, invoking the eviction callback first.
+ * @param [in] pDevice A pointer to the device to remove and delete.
+ */
+void NimBLEScan::evictDevice(NimBLEAdvertisedDevice* pDevice) {
+    NIMBLE_LOGD(LOG_TAG, "Evicting device: %s", NIMBLE_CPP_STR(pDevice->getAddress()));
+
+    if(m_pAdvertisedDeviceCallbacks != nullptr) {
+        m_pAdvertisedDeviceCallbacks->onEvicted(pDevice);
     }
 
-    m_pTaskData = nullptr;
-    return m_scanResults;
-} // start
+    m_scanResults.removeDevice(pDevice);
+    delete pDevice;
+} // evictDevice
 
 
 /**
- * @brief Stop an in progress scan.
- * @return True if successful.
+ * @brief Remove the devices that have not advertised within the max result age.
+ * @param [in] now The current time from NimBLEUtils::getTimeUs.
  */
-bool NimBLEScan::stop() {
-    NIMBLE_LOGD(LOG_TAG, ">> stop()");
-
-    int rc = ble_gap_disc_cancel();
-    if (rc != 0 && rc != BLE_HS_EALREADY) {
-        NIMBLE_LOGE(LOG_TAG, "Failed to cancel scan; rc=%d", rc);
-        return false;
+void NimBLEScan::ageResults(uint64_t now) {
+    auto &devices = m_scanResults.m_advertisedDevicesVector;
+    uint64_t maxAge = (uint64_t)m_maxAge * 1000000;
+    // Without stored results the devices are only kept to rate limit their reports.
+    if(m_maxResults == 0 && m_dupRefreshUs > 0 && (maxAge == 0 || m_dupRefreshUs < maxAge)) {
+        maxAge = m_dupRefreshUs;
     }
 
-    if(m_maxResults == 0) {
-        clearResults();
+    for(size_t i = 0; i < devices.size();) {
+        NimBLEAdvertisedDevice* pDevice = devices[i];
+        if(!pDevice->m_batchPending && now - pDevice->m_timestamp >= maxAge) {
+            evictDevice(pDevice);
+        } else {
+            i++;
+        }
     }
+} // ageResults
 
-    if (rc != BLE_HS_EALREADY && m_scanCompleteCB != nullptr) {
-        m_scanCompleteCB(m_scanResults);
+
+/**
+ * @brief Remove the device that advertised least recently from the results.
+ * @return True if a device was removed.
+ * @details Devices waiting in a result batch are not removed.
+ */
+bool NimBLEScan::evictOldest() {
+    NimBLEAdvertisedDevice* pOldest = nullptr;
+
+    for(auto &it : m_scanResults.m_advertisedDevicesVector) {
+        if(!it->m_batchPending && (pOldest == nullptr || it->m_timestamp < pOldest->m_timestamp)) {
+            pOldest = it;
+        }
     }
 
-    if(m_pTaskData != nullptr) {
-        xTaskNotifyGive(m_pTaskData->task);
+    if(pOldest == nullptr) {
+        return false;
     }
 
-    NIMBLE_LOGD(LOG_TAG, "<< stop()");
+    evictDevice(pOldest);
     return true;
-} // stop
+} // evictOldest
 
 
 /**
- * @brief Clears the duplicate scan filter cache.
+ * @brief Only report devices advertising manufacturer data with the company ID.
+ * @param [in] companyId The company identifier, the first 2 bytes of the manufacturer data.
+ * @details The filters are checked on the advertisement data of a device not yet seen in this scan,
+ * devices that do not match all of the filters set are dropped before a NimBLEAdvertisedDevice is created.
+ * Data in the scan response is not used when filtering.
  */
-void NimBLEScan::clearDuplicateCache() {
-#ifdef CONFIG_IDF_TARGET_ESP32 // Not available for ESP32C3
-    esp_ble_scan_dupilcate_list_flush();
-#endif
-}
+void NimBLEScan::setFilterManufacturerId(uint16_t companyId) {
+    m_filterCompanyId = companyId;
+    m_filterCompanyIdSet = true;
+    m_filterEnabled = true;
+} // setFilterManufacturerId
 
 
 /**
- * @brief Delete peer device from the scan results vector.
- * @param [in] address The address of the device to delete from the results.
- * @details After disconnecting, it may be required in the case we were connected to a device without a public address.
+ * @brief Add a UUID to the service UUID filter.
+ * @param [in] uuid The service UUID to add.
+ * @details When the service UUID filter is set, only devices that advertise at least one
+ * of the service UUIDs in the filter are reported.
  */
-void NimBLEScan::erase(const NimBLEAddress &address) {
-    NIMBLE_LOGD(LOG_TAG, "erase device: %s", address.toString().c_str());
-
-    for(auto it = m_scanResults.m_advertisedDevicesVector.begin(); it != m_scanResults.m_advertisedDevicesVector.end(); ++it) {
-        if((*it)->getAddress() == address) {
-            delete *it;
-            m_scanResults.m_advertisedDevicesVector.erase(it);
-            break;
-        }
-    }
-}
+void NimBLEScan::addFilterServiceUUID(const NimBLEUUID &uuid) {
+    m_filterServiceUUIDs.push_back(uuid);
+    m_filterEnabled = true;
+} // addFilterServiceUUID
 
 
 /**
- * @brief Called when host reset, we set a flag to stop scanning until synced.
+ * @brief Only report devices that advertise a name starting with the prefix.
+ * @param [in] prefix The prefix the complete or shortened name must start with.
  */
-void NimBLEScan::onHostReset() {
-    m_ignoreResults = true;
-}
+void NimBLEScan::setFilterNamePrefix(const std::string &prefix) {
+    m_filterNamePrefix = prefix;
+    m_filterEnabled = true;
+} // setFilterNamePrefix
 
 
 /**
- * @brief If the host reset and re-synced this is called.
- * If the application was scanning indefinitely with a callback, restart it.
+ * @brief Only report devices received with an RSSI at or above the value.
+ * @param [in] minRSSI The minimum RSSI in dBm.
  */
-void NimBLEScan::onHostSync() {
-    m_ignoreResults = false;
+void NimBLEScan::setFilterRSSI(int8_t minRSSI) {
+    m_filterMinRSSI = minRSSI;
+    m_filterEnabled = true;
+} // setFilterRSSI
 
-    if(m_duration == 0 && m_pAdvertisedDeviceCallbacks != nullptr) {
-        start(m_duration, m_scanCompleteCB);
-    }
-}
 
 /**
- * @brief Get the results of the scan.
- * @return NimBLEScanResults object.
+ * @brief Only report devices using the address type.
+ * @param [in] addrType The address type, one of:
+ * * BLE_ADDR_PUBLIC      (0x00)
+ * * BLE_ADDR_RANDOM      (0x01)
+ * * BLE_ADDR_PUBLIC_ID   (0x02)
+ * * BLE_ADDR_RANDOM_ID   (0x03)
  */
-NimBLEScanResults NimBLEScan::getResults() {
+void NimBLEScan::setFilterAddressType(uint8_t addrType) {
+    m_filterAddrType = addrType;
+    m_filterEnabled = true;
+} // setFilterAddressType
+
+
+/**
+ * @brief Remove all scan filters, all devices will be reported.
+ */
+void NimBLEScan::clearFilters() {
+    m_filterEnabled      = false;
+    m_filterCompanyIdSet = false;
+    m_filterCompanyId    = 0;
+    m_filterMinRSSI      = INT8_MIN;
+    m_filterAddrType     = 0xFF;
+    m_filterNamePrefix.clear();
+    m_filterServiceUUIDs.clear();
+} // clearFilters
+
+
+/**
+ * @brief Check the raw advertisement data of a report against the scan filters.
+ * @param [in] data The advertisement data.
+ * @param [in] length The length of the advertisement data.
+ * @param [in] rssi The RSSI of the report.
+ * @param [in] addrType The address type of the advertiser.
+ * @return True if the report matches all of the filters that are set.
+ */
+bool NimBLEScan::filterReport(const uint8_t *data, size_t length, int8_t rssi, uint8_t addrType) {
+    if(rssi < m_filterMinRSSI) {
+        return false;
+    }
+
+    if(m_filterAddrType != 0xFF && addrType != m_filterAddrType) {
+        return false;
+    }
+
+    bool companyOk = !m_filterCompanyIdSet;
+    bool nameOk    = m_filterNamePrefix.empty();
+    bool uuidOk    = m_filterServiceUUIDs.empty();
+
+    for(size_t pos = 0; pos + 1 < length && !(companyOk && nameOk && uuidOk);) {
+        const uint8_t fieldLen = data[pos];
+        if(fieldLen == 0) {
+            pos++;
+            continue;
+        }
+        if(pos + 1 + fieldLen > length) {
+            break;
+        }
+
+        const uint8_t  type     = data[pos + 1];
+        const uint8_t* value    = &data[pos + 2];
+        const uint8_t  valueLen = fieldLen - 1;
+
+        switch(type) {
+            case BLE_HS_ADV_TYPE_MFG_DATA:
+                if(!companyOk && valueLen >= 2) {
+                    companyOk = (value[0] | (value[1] << 8)) == m_filterCompanyId;
+                }
+                break;
+
+            case BLE_HS_ADV_TYPE_COMP_NAME:
+            case BLE_HS_ADV_TYPE_INCOMP_NAME:
+                if(!nameOk && valueLen >= m_filterNamePrefix.length()) {
+                    nameOk = memcmp(value, m_filterNamePrefix.data(), m_filterNamePrefix.length()) == 0;
+                }
+                break;
+
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS128: {
+                if(uuidOk) {
+                    break;
+                }
+                const uint8_t uuidLen = type < BLE_HS_ADV_TYPE_INCOMP_UUIDS32 ? 2 :
+                                        type < BLE_HS_ADV_TYPE_INCOMP_UUIDS128 ? 4 : 16;
+                for(uint8_t i = 0; i + uuidLen <= valueLen && !uuidOk; i += uuidLen) {
+                    NimBLEUUID uuid(&value[i], uuidLen, false);
+                    for(auto &it : m_filterServiceUUIDs) {
+                        if(it == uuid) {
+                            uuidOk = true;
+                            break;
+                        }
+                    }
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        pos += 1 + fieldLen;
+    }
+
+    return companyOk && nameOk && uuidOk;
+} // filterReport
+
+
+/**
+ * @brief Enable batched delivery of scan results to NimBLEAdvertisedDeviceCallbacks::onResults.
+ * @param [in] count The number of results to collect before calling onResults, 0 disables batching.
+ * @param [in] timeoutMs The maximum time in milliseconds a result waits in a partial batch before
+ * it is delivered, 0 = wait until the batch is full or the scan ends.
+ * @details Batches are delivered from the host task, as onResult is.
+ */
+void NimBLEScan::setBatchSize(uint16_t count, uint32_t timeoutMs) {
+    flushBatch();
+    m_batchSize = count;
+    m_batchTimeout = timeoutMs;
+    m_batch.reserve(count);
+} // setBatchSize
+
+
+/**
+ * @brief Send a result to the application, immediately or by adding it to the current batch.
+ * @param [in] pDevice A pointer to the device to report.
+ */
+void NimBLEScan::reportResult(NimBLEAdvertisedDevice* pDevice) {
+    if(m_batchSize == 0) {
+        m_pAdvertisedDeviceCallbacks->onResult(pDevice);
+        return;
+    }
+
+    if(pDevice->m_batchPending) {
+        return;
+    }
+
+    pDevice->m_batchPending = true;
+    m_batch.push_back(pDevice);
+
+    if(m_batch.size() >= m_batchSize) {
+        flushBatch();
+    } else if(m_batch.size() == 1 && m_batchTimeout > 0) {
+        ble_npl_time_t ticks;
+        ble_npl_time_ms_to_ticks(m_batchTimeout, &ticks);
+        ble_npl_callout_reset(&m_batchTimer, ticks);
+    }
+} // reportResult
+
+
+/**
+ * @brief Deliver the pending batch of results to the application.
+ * @details If results are not being stored the devices are deleted after delivery.
+ */
+void NimBLEScan::flushBatch() {
+    ble_npl_callout_stop(&m_batchTimer);
+
+    if(m_batch.empty()) {
+        return;
+    }
+
+    if(m_pAdvertisedDeviceCallbacks != nullptr) {
+        m_pAdvertisedDeviceCallbacks->onResults(m_batch.data(), m_batch.size());
+    }
+
+    for(auto &it : m_batch) {
+        it->m_batchPending = false;
+        if(m_maxResults == 0) {
+            m_scanResults.removeDevice(it);
+            delete it;
+        }
+    }
+
+    m_batch.clear();
+} // flushBatch
+
+
+/**
+ * @brief Called when a partial batch has waited for the batch timeout.
+ */
+/*STATIC*/
+void NimBLEScan::batchTimerCb(ble_npl_event *event) {
+    NimBLEScan* pScan = (NimBLEScan*)ble_npl_event_get_arg(event);
+
+    // The results belong to the report task when it is running, let it deliver the batch.
+    if(pScan->m_reportTask != nullptr) {
+        pScan->m_batchFlushPending = true;
+        xTaskNotifyGive(pScan->m_reportTask);
+        return;
+    }
+
+    // Try again shortly if a snapshot holds the results.
+    if(!pScan->enterResults()) {
+        ble_npl_callout_reset(&pScan->m_batchTimer, 1);
+        return;
+    }
+
+    pScan->flushBatch();
+    pScan->leaveResults();
+} // batchTimerCb
+
+
+/**
+ * @brief Process advertisement reports in a separate task instead of the host task.
+ * @param [in] queueSize The number of reports that can be waiting to be processed,
+ * reports received when the queue is full are dropped.
+ * @param [in] taskStackSize The stack size in bytes of the report task.
+ * @param [in] taskPriority The priority of the report task.
+ * @param [in] taskCore The core to run the report task on, -1 for the core set with
+ * NimBLEDevice::setTaskAffinity. Only used on ESP32.
+ * @return True if the report task was started.
+ * @details The host task only copies each report into a lock-free single producer, single consumer ring buffer.
+ * Device lookup, payload parsing and all of the NimBLEAdvertisedDeviceCallbacks are run by the report task,
+ * so scanning does not delay connection events handled on the host task. Can only be set once.
+ */
+bool NimBLEScan::setReportQueue(uint16_t queueSize, uint32_t taskStackSize, uint8_t taskPriority, int taskCore) {
+    if(m_reportTask != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Report queue already started");
+        return false;
+    }
+
+    if(queueSize == 0) {
+        return false;
+    }
+
+    // One slot is always left empty to tell a full queue from an empty one.
+    m_reportQueueSize = queueSize + 1;
+    m_reports = new ble_scan_report_t[m_reportQueueSize];
+    m_reportHead = 0;
+    m_reportTail = 0;
+
+#ifdef ESP_PLATFORM
+    BaseType_t rc = xTaskCreatePinnedToCore(NimBLEScan::reportTask, "nimble_scan", taskStackSize, this,
+                                            taskPriority, &m_reportTask,
+                                            NimBLEDevice::getTaskCore(taskCore));
+#else
+    (void)taskCore;
+    BaseType_t rc = xTaskCreate(NimBLEScan::reportTask, "nimble_scan", taskStackSize / sizeof(StackType_t),
+                                this, taskPriority, &m_reportTask);
+#endif
+
+    if(rc != pdPASS) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to create scan report task");
+        m_reportTask = nullptr;
+        delete[] m_reports;
+        m_reports = nullptr;
+        return false;
+    }
+
+    return true;
+} // setReportQueue
+
+
+/**
+ * @brief Receive the blobs broadcast by a NimBLEBroadcastSender.
+ * @param [in] pReceiver A pointer to the receiver, nullptr to stop receiving.
+ * @details Reports holding a frame are passed to the receiver before any other processing and do
+ * not create advertised devices or callbacks. As every frame changes the advertising data, disable
+ * the duplicate filter with setDuplicateFilter(false) so the controller reports all of them.
+ */
+void NimBLEScan::setBroadcastReceiver(NimBLEBroadcastReceiver* pReceiver) {
+    m_pBroadcastReceiver = pReceiver;
+} // setBroadcastReceiver
+
+
+/**
+ * @brief Add a device to the watch list, its reports are passed to a callback before any other processing.
+ * @param [in] address The address of the device.
+ * @param [in] callback The function to call with the reports of the device.
+ * @param [in] arg A context passed to the callback.
+ * @param [in] sid The advertising set ID to watch, -1 for all sets of the device.
+ * @return True if the device was added, or its callback replaced if it was already watched.
+ * @details The watch list is a hash table indexed by the address, a report is matched with a single
+ * lookup whatever the number of watched devices and, unless the callback returns true, no
+ * NimBLEAdvertisedDevice is created or updated for it. Reports are dropped while the list is changed.
+ */
+bool NimBLEScan::addWatch(const NimBLEAddress &address, NimBLEWatchCallback callback, void* arg, int sid) {
+    if(callback == nullptr || sid < -1 || sid > 0x0F) {
+        return false;
+    }
+
+    holdResults();
+    const size_t mask = m_watchIndex.size() - 1;
+    for(size_t i = address.hash() & mask; !m_watchIndex.empty() && m_watchIndex[i].callback != nullptr;
+        i = (i + 1) & mask)
+    {
+        watch_entry_t &entry = m_watchIndex[i];
+        if(entry.address == address && entry.sid == sid) {
+            entry.callback = callback;
+            entry.arg = arg;
+            releaseResults();
+            return true;
+        }
+    }
+
+    // Keep the index load factor at or below 3/4 so the probe sequences stay short.
+    if((m_watchCount + 1) * 4 > m_watchIndex.size() * 3) {
+        resizeWatchIndex(m_watchIndex.empty() ? 16 : m_watchIndex.size() * 2);
+    }
+
+    size_t i = address.hash() & (m_watchIndex.size() - 1);
+    while(m_watchIndex[i].callback != nullptr) {
+        i = (i + 1) & (m_watchIndex.size() - 1);
+    }
+    m_watchIndex[i] = {address, callback, arg, (int16_t)sid};
+    m_watchCount++;
+    releaseResults();
+    return true;
+} // addWatch
+
+
+/**
+ * @brief Remove a device from the watch list.
+ * @param [in] address The address of the device.
+ * @param [in] sid The advertising set ID given to addWatch.
+ * @return True if the device was on the watch list.
+ */
+bool NimBLEScan::removeWatch(const NimBLEAddress &address, int sid) {
+    if(m_watchIndex.empty()) {
+        return false;
+    }
+
+    holdResults();
+    const size_t mask = m_watchIndex.size() - 1;
+    size_t i = address.hash() & mask;
+    for(; m_watchIndex[i].callback != nullptr; i = (i + 1) & mask) {
+        if(m_watchIndex[i].address == address && m_watchIndex[i].sid == sid) {
+            break;
+        }
+    }
+
+    bool found = m_watchIndex[i].callback != nullptr;
+    if(found) {
+        // Move the following entries of the probe sequence back so none is left behind the gap.
+        size_t gap = i;
+        for(size_t j = (i + 1) & mask; m_watchIndex[j].callback != nullptr; j = (j + 1) & mask) {
+            size_t home = m_watchIndex[j].address.hash() & mask;
+            if(((j - home) & mask) >= ((j - gap) & mask)) {
+                m_watchIndex[gap] = m_watchIndex[j];
+                gap = j;
+            }
+        }
+        m_watchIndex[gap].callback = nullptr;
+        m_watchCount--;
+    }
+
+    releaseResults();
+    return found;
+} // removeWatch
+
+
+/**
+ * @brief Remove all devices from the watch list.
+ */
+void NimBLEScan::clearWatchList() {
+    holdResults();
+    std::vector<watch_entry_t>().swap(m_watchIndex);
+    m_watchCount = 0;
+    releaseResults();
+} // clearWatchList
+
+
+/**
+ * @brief Get the number of entries on the watch list.
+ */
+size_t NimBLEScan::getWatchCount() {
+    return m_watchCount;
+} // getWatchCount
+
+
+/**
+ * @brief Drop the reports of the devices that are not on the watch list.
+ * @param [in] enabled True to only process the reports of watched devices.
+ * @details The reports are dropped right after the watch list lookup, before the ignore list,
+ * the filters or any NimBLEAdvertisedDevice work.
+ */
+void NimBLEScan::setWatchOnly(bool enabled) {
+    m_watchOnly = enabled;
+} // setWatchOnly
+
+
+/**
+ * @brief Pass a report to the callback of its device if it is watched.
+ * @param [in] report The report.
+ * @param [out] process Set to the return of the callback if the device is watched.
+ * @return True if the device is watched.
+ */
+bool NimBLEScan::dispatchWatch(const NimBLEWatchReport &report, bool* process) {
+    const size_t mask = m_watchIndex.size() - 1;
+    for(size_t i = report.address.hash() & mask; m_watchIndex[i].callback != nullptr; i = (i + 1) & mask) {
+        const watch_entry_t &entry = m_watchIndex[i];
+        if(entry.address == report.address && (entry.sid < 0 || entry.sid == report.sid)) {
+            // The callback may change the watch list, the entry is not used after it.
+            *process = entry.callback(report, entry.arg);
+            return true;
+        }
+    }
+    return false;
+} // dispatchWatch
+
+
+/**
+ * @brief Rebuild the watch index with a new capacity.
+ * @param [in] capacity The number of slots, a power of 2.
+ */
+void NimBLEScan::resizeWatchIndex(size_t capacity) {
+    std::vector<watch_entry_t> old;
+    old.swap(m_watchIndex);
+    m_watchIndex.assign(capacity, watch_entry_t{NimBLEAddress(), nullptr, nullptr, -1});
+
+    const size_t mask = capacity - 1;
+    for(auto &it : old) {
+        if(it.callback == nullptr) {
+            continue;
+        }
+
+        size_t i = it.address.hash() & mask;
+        while(m_watchIndex[i].callback != nullptr) {
+            i = (i + 1) & mask;
+        }
+        m_watchIndex[i] = it;
+    }
+} // resizeWatchIndex
+
+
+/**
+ * @brief Get the number of advertisement reports dropped because the report queue was full
+ * or a NimBLEScanSnapshot held the results.
+ * @return The number of reports dropped since the report queue was started.
+ */
+uint32_t NimBLEScan::getReportDropCount() {
+    return m_reportDrops;
+} // getReportDropCount
+
+
+/**
+ * @brief Hold the scan results unchanged until releaseResults is called, see NimBLEScanSnapshot.
+ * @details Blocks until the advertisement report being handled is finished, leaveResults wakes the
+ * waiting tasks whatever their priority. When called from a scan callback the results are held once
+ * the callback returns.
+ */
+void NimBLEScan::holdResults() {
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    for(;;) {
+        ble_npl_hw_enter_critical();
+        bool held = m_resultsTask == nullptr || m_resultsTask == cur_task;
+        if(held) {
+            m_resultsHolds++;
+        } else {
+            m_resultsWaiters++;
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(held) {
+            return;
+        }
+        ble_npl_sem_pend(&m_resultsSem, BLE_NPL_TIME_FOREVER);
+    }
+} // holdResults
+
+
+/**
+ * @brief Release a hold on the scan results taken with holdResults.
+ */
+void NimBLEScan::releaseResults() {
+    ble_npl_hw_enter_critical();
+    if(m_resultsHolds > 0) {
+        m_resultsHolds--;
+    }
+    ble_npl_hw_exit_critical(0);
+} // releaseResults
+
+
+/**
+ * @brief Start changing the results from the task handling the scan events.
+ * @return False if a snapshot holds the results, they must not be changed then.
+ */
+bool NimBLEScan::enterResults() {
+    ble_npl_hw_enter_critical();
+    bool entered = m_resultsHolds == 0;
+    if(entered) {
+        m_resultsTask = xTaskGetCurrentTaskHandle();
+    }
+    ble_npl_hw_exit_critical(0);
+    return entered;
+} // enterResults
+
+
+/**
+ * @brief Finish changing the results, started with enterResults.
+ */
+void NimBLEScan::leaveResults() {
+    ble_npl_hw_enter_critical();
+    m_resultsTask = nullptr;
+    uint8_t waiters = m_resultsWaiters;
+    m_resultsWaiters = 0;
+    ble_npl_hw_exit_critical(0);
+
+    while(waiters-- > 0) {
+        ble_npl_sem_release(&m_resultsSem);
+    }
+} // leaveResults
+
+
+/**
+ * @brief Copy a scan event into the report queue and wake the report task, called from the host task.
+ * @param [in] event The scan event to queue.
+ * @details Discovery complete is never dropped, it is flagged and handled after the queued reports.
+ */
+void NimBLEScan::queueReport(const ble_gap_event* event) {
+    if(event->type == BLE_GAP_EVENT_DISC_COMPLETE) {
+#if defined(CONFIG_BT_NIMBLE_MESH)
+        resumeMeshScan();
+#endif
+        m_discCompleteReason = event->disc_complete.reason;
+        m_discCompletePending.store(true, std::memory_order_release);
+        xTaskNotifyGive(m_reportTask);
+        return;
+    }
+
+    uint16_t head = m_reportHead.load(std::memory_order_relaxed);
+    uint16_t next = (head + 1) % m_reportQueueSize;
+    if(next == m_reportTail.load(std::memory_order_acquire)) {
+        m_reportDrops++;
+        return;
+    }
+
+    ble_scan_report_t* pReport = &m_reports[head];
+    pReport->event = *event;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    auto& disc = pReport->event.ext_disc;
+#else
+    auto& disc = pReport->event.disc;
+#endif
+    // The 8 bit length always fits a buffer of 255 bytes.
+#if NIMBLE_CPP_SCAN_REPORT_DATA_LEN < 255
+    if(disc.length_data > sizeof(pReport->data)) {
+        disc.length_data = sizeof(pReport->data);
+    }
+#endif
+    memcpy(pReport->data, disc.data, disc.length_data);
+    disc.data = pReport->data;
+
+    m_reportHead.store(next, std::memory_order_release);
+    xTaskNotifyGive(m_reportTask);
+} // queueReport
+
+
+/**
+ * @brief The report task, processes the queued scan events.
+ * @param [in] pvParameters A pointer to the scan instance.
+ */
+/*STATIC*/
+void NimBLEScan::reportTask(void *pvParameters) {
+    NimBLEScan* pScan = (NimBLEScan*)pvParameters;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Read the flag before draining so every report received before completion is processed first.
+        bool discComplete = pScan->m_discCompletePending.exchange(false, std::memory_order_acquire);
+
+        uint16_t tail = pScan->m_reportTail.load(std::memory_order_relaxed);
+        while(tail != pScan->m_reportHead.load(std::memory_order_acquire)) {
+            NimBLEScan::handleGapEvent(&pScan->m_reports[tail].event, nullptr);
+            tail = (tail + 1) % pScan->m_reportQueueSize;
+            pScan->m_reportTail.store(tail, std::memory_order_release);
+        }
+
+        if(pScan->m_batchFlushPending.exchange(false)) {
+            pScan->flushBatch();
+        }
+
+        if(discComplete) {
+            ble_gap_event event;
+            memset(&event, 0, sizeof(event));
+            event.type = BLE_GAP_EVENT_DISC_COMPLETE;
+            event.disc_complete.reason = pScan->m_discCompleteReason;
+            NimBLEScan::handleGapEvent(&event, nullptr);
+        }
+    }
+} // reportTask
+
+
+/**
+ * @brief Set the call backs to be invoked.
+ * @param [in] pAdvertisedDeviceCallbacks Call backs to be invoked.
+ * @param [in] wantDuplicates  True if we wish to be called back with duplicates.  Default is false.
+ */
+void NimBLEScan::setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks* pAdvertisedDeviceCallbacks,
+                                              bool wantDuplicates) {
+    setDuplicateFilter(!wantDuplicates);
+    m_pAdvertisedDeviceCallbacks = pAdvertisedDeviceCallbacks;
+} // setAdvertisedDeviceCallbacks
+
+
+/**
+ * @brief Set the interval to scan.
+ * @param [in] intervalMSecs The scan interval (how often) in milliseconds.
+ */
+void NimBLEScan::setInterval(uint16_t intervalMSecs) {
+    m_scan_params.itvl = intervalMSecs / 0.625;
+} // setInterval
+
+
+/**
+ * @brief Set the window to actively scan.
+ * @param [in] windowMSecs How long to actively scan.
+ */
+void NimBLEScan::setWindow(uint16_t windowMSecs) {
+    m_scan_params.window = windowMSecs / 0.625;
+} // setWindow
+
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+/**
+ * @brief Set the primary PHYs to scan on, the controller scans each PHY in turn with its own
+ * interval and window and the reports of all of them are handled as one result set.
+ * @param [in] phyMask BLE_GAP_LE_PHY_1M_MASK, BLE_GAP_LE_PHY_CODED_MASK or both, the default.
+ */
+void NimBLEScan::setPhy(uint8_t phyMask) {
+    phyMask &= BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_CODED_MASK;
+    if(phyMask == 0) {
+        NIMBLE_LOGE(LOG_TAG, "Invalid scan PHY mask");
+        return;
+    }
+
+    m_scanPhys = phyMask;
+} // setPhy
+
+
+/**
+ * @brief Set the interval and window of scanning on a primary PHY.
+ * @param [in] phyMask The PHYs to set, BLE_GAP_LE_PHY_1M_MASK and/or BLE_GAP_LE_PHY_CODED_MASK.
+ * @param [in] intervalMSecs The scan interval in milliseconds, 0 to use the one set with setInterval.
+ * @param [in] windowMSecs The scan window in milliseconds, 0 to use the one set with setWindow.
+ */
+void NimBLEScan::setPhyParams(uint8_t phyMask, uint16_t intervalMSecs, uint16_t windowMSecs) {
+    if(phyMask & BLE_GAP_LE_PHY_1M_MASK) {
+        m_phyParams[0].itvl   = intervalMSecs / 0.625;
+        m_phyParams[0].window = windowMSecs / 0.625;
+    }
+
+    if(phyMask & BLE_GAP_LE_PHY_CODED_MASK) {
+        m_phyParams[1].itvl   = intervalMSecs / 0.625;
+        m_phyParams[1].window = windowMSecs / 0.625;
+    }
+} // setPhyParams
+#endif
+
+
+/**
+ * @brief Get the status of the scanner.
+ * @return true if scanning or scan starting.
+ */
+bool NimBLEScan::isScanning() {
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    // The continuous scan run for the mesh stack is not reported.
+    if(!m_appScan) {
+        return false;
+    }
+#endif
+    return ble_gap_disc_active();
+}
+
+
+/**
+ * @brief Start scanning.
+ * @param [in] duration The duration in seconds for which to scan.
+ * @param [in] scanCompleteCB A function to be called when scanning has completed.
+ * @param [in] is_continue Set to true to save previous scan results, false to clear them.
+ * @return True if scan started or false if there was an error.
+ */
+bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResults), bool is_continue) {
+    NIMBLE_LOGD(LOG_TAG, ">> start: duration=%" PRIu32, duration);
+
+    // Save the callback to be invoked when the scan completes.
+    m_scanCompleteCB = scanCompleteCB;
+    // Save the duration in the case that the host is reset so we can reuse it.
+    m_duration = duration;
+
+    // If 0 duration specified then we assume a continuous scan is desired.
+    if(duration == 0){
+        duration = BLE_HS_FOREVER;
+    }
+    else{
+        // convert duration to milliseconds
+        duration = duration * 1000;
+    }
+
+    // Set the flag to ignore the results while we are deleting the vector
+    if(!is_continue) {
+        m_ignoreResults = true;
+    }
+
+    uint8_t filterDuplicates = m_scan_params.filter_duplicates;
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    if(NimBLEMesh::isInitialized() || m_meshScan) {
+        // The mesh nodes repeat their advertisements, let them all through the controller,
+        // the duplicates are still not reported to the callbacks.
+        filterDuplicates = 0;
+    }
+
+    // The application scan replaces the scan run for the mesh stack, which receives its reports.
+    if(m_meshScan && !m_appScan) {
+        ble_gap_disc_cancel();
+    }
+#endif
+
+    m_dupRefreshUs = 0;
+# if CONFIG_BT_NIMBLE_EXT_ADV
+    uint16_t period = 0;
+    uint16_t scanDuration = duration / 10;
+#endif
+    if(m_scan_params.filter_duplicates && m_dupRefreshMs > 0) {
+# if CONFIG_BT_NIMBLE_EXT_ADV
+        if(filterDuplicates && m_duration == 0 && m_dupRefreshMs >= 1280) {
+            // The controller scans for the duration at the start of each period and resets its
+            // duplicate cache every period, a duration 10ms shorter than the period keeps the gap short.
+            period = std::min<uint32_t>((m_dupRefreshMs + 640) / 1280, 512);
+            scanDuration = period * 128 - 1;
+            filterDuplicates = 2; // Enabled, reset for each scan period.
+            // The device is reported again when the controller first reports it in the next period.
+            m_dupRefreshUs = (uint64_t)period * 640000;
+        } else
+#endif
+        {
+            m_dupRefreshUs = (uint64_t)m_dupRefreshMs * 1000;
+            filterDuplicates = 0;
+        }
+    }
+
+# if CONFIG_BT_NIMBLE_EXT_ADV
+    ble_gap_ext_disc_params scan_params[2];
+    for(int i = 0; i < 2; i++) {
+        scan_params[i].passive = m_scan_params.passive;
+        scan_params[i].itvl    = m_phyParams[i].itvl ? m_phyParams[i].itvl : m_scan_params.itvl;
+        scan_params[i].window  = m_phyParams[i].window ? m_phyParams[i].window : m_scan_params.window;
+    }
+
+    if(NimBLEDevice::coexEnabled()) {
+        // The PHYs are scanned one after the other, they share the time given to scanning.
+        uint8_t duty = NimBLEDevice::coexDuty(true, NimBLEDevice::coexAdvertising(), false).scan;
+        if(m_scanPhys == (BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_CODED_MASK)) {
+            duty = std::max(duty / 2, 1);
+        }
+        for(int i = 0; i < 2; i++) {
+            NimBLEDevice::coexScanWindow(scan_params[i].itvl, scan_params[i].window, duty);
+        }
+    }
+
+    int rc = ble_gap_ext_disc(NimBLEDevice::m_own_addr_type,
+                              scanDuration,
+                              period,
+                              filterDuplicates,
+                              m_scan_params.filter_policy,
+                              m_scan_params.limited,
+                              (m_scanPhys & BLE_GAP_LE_PHY_1M_MASK) ? &scan_params[0] : NULL,
+                              (m_scanPhys & BLE_GAP_LE_PHY_CODED_MASK) ? &scan_params[1] : NULL,
+                              NimBLEScan::handleGapEvent,
+                              NULL);
+    if(rc == 0) {
+        NIMBLE_CPP_RADIO_SCAN_START(
+            ((m_scanPhys & BLE_GAP_LE_PHY_1M_MASK) ?
+                NimBLERadioActivity::scanDuty(scan_params[0].itvl, scan_params[0].window) : 0) +
+            ((m_scanPhys & BLE_GAP_LE_PHY_CODED_MASK) ?
+                NimBLERadioActivity::scanDuty(scan_params[1].itvl, scan_params[1].window) : 0));
+    }
+#else
+    ble_gap_disc_params scan_params = m_scan_params;
+    scan_params.filter_duplicates = filterDuplicates;
+    if(NimBLEDevice::coexEnabled()) {
+        NimBLEDevice::coexScanWindow(scan_params.itvl, scan_params.window,
+                                     NimBLEDevice::coexDuty(true, NimBLEDevice::coexAdvertising(), false).scan);
+    }
+    int rc = ble_gap_disc(NimBLEDevice::m_own_addr_type,
+                          duration,
+                          &scan_params,
+                          NimBLEScan::handleGapEvent,
+                          NULL);
+    if(rc == 0) {
+        NIMBLE_CPP_RADIO_SCAN_START(NimBLERadioActivity::scanDuty(scan_params.itvl, scan_params.window));
+    }
+#endif
+    switch(rc) {
+        case 0:
+#if defined(CONFIG_BT_NIMBLE_MESH)
+            m_appScan = true;
+#endif
+            m_scanEnd = m_duration ? NimBLEUtils::getTimeUs() + (uint64_t)m_duration * 1000000 : 0;
+            if(!is_continue) {
+                clearResults();
+            }
+            break;
+
+        case BLE_HS_EALREADY:
+            // Clear the cache if already scanning in case an advertiser was missed.
+            clearDuplicateCache();
+            break;
+
+        case BLE_HS_EBUSY:
+            NIMBLE_LOGE(LOG_TAG, "Unable to scan - connection in progress.");
+            break;
+
+        case BLE_HS_ETIMEOUT_HCI:
+        case BLE_HS_EOS:
+        case BLE_HS_ECONTROLLER:
+        case BLE_HS_ENOTSYNCED:
+            NIMBLE_LOGC(LOG_TAG, "Unable to scan - Host Reset");
+            break;
+
+        default:
+            NIMBLE_LOGE(LOG_TAG, "Error initiating GAP discovery procedure; rc=%d, %s",
+                        rc, NimBLEUtils::returnCodeToString(rc));
+            break;
+    }
+
+    m_ignoreResults = false;
+    NIMBLE_LOGD(LOG_TAG, "<< start()");
+
+    if(rc != 0 && rc != BLE_HS_EALREADY) {
+#if defined(CONFIG_BT_NIMBLE_MESH)
+        resumeMeshScan();
+#endif
+        return false;
+    }
+    return true;
+} // start
+
+
+/**
+ * @brief Start scanning and block until scanning has been completed.
+ * @param [in] duration The duration in seconds for which to scan.
+ * @param [in] is_continue Set to true to save previous scan results, false to clear them.
+ * @return The NimBLEScanResults.
+ */
+NimBLEScanResults NimBLEScan::start(uint32_t duration, bool is_continue) {
+    if(duration == 0) {
+        NIMBLE_LOGW(LOG_TAG, "Blocking scan called with duration = forever");
+    }
+
+    TaskHandle_t cur_task = xTaskGetCurrentTaskHandle();
+    ble_task_data_t taskData = {nullptr, cur_task, 0, nullptr};
+    m_pTaskData = &taskData;
+
+    if(start(duration, nullptr, is_continue)) {
+#ifdef ulTaskNotifyValueClear
+        // Clear the task notification value to ensure we block
+        ulTaskNotifyValueClear(cur_task, ULONG_MAX);
+#endif
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    m_pTaskData = nullptr;
+    return m_scanResults;
+} // start
+
+
+/**
+ * @brief Stop an in progress scan.
+ * @return True if successful.
+ */
+bool NimBLEScan::stop() {
+    NIMBLE_LOGD(LOG_TAG, ">> stop()");
+
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    // Leave the scan run for the mesh stack alone.
+    int rc = m_appScan ? ble_gap_disc_cancel() : BLE_HS_EALREADY;
+#else
+    int rc = ble_gap_disc_cancel();
+#endif
+    if (rc != 0 && rc != BLE_HS_EALREADY) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to cancel scan; rc=%d", rc);
+        return false;
+    }
+    NIMBLE_CPP_RADIO_SCAN_STOP();
+
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    resumeMeshScan();
+#endif
+
+    flushBatch();
+
+    if(m_maxResults == 0) {
+        clearResults();
+    }
+
+    if (rc != BLE_HS_EALREADY && m_scanCompleteCB != nullptr) {
+        m_scanCompleteCB(m_scanResults);
+    }
+
+    if(m_pTaskData != nullptr) {
+        xTaskNotifyGive(m_pTaskData->task);
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "<< stop()");
+    return true;
+} // stop
+
+
+/**
+ * @brief Pause the scan for a connection attempt, without completing it.
+ * @return True if the scan was running and is paused, resume it with resume().
+ */
+bool NimBLEScan::pause() {
+    if(!isScanning()) {
+        return false;
+    }
+
+    int rc = ble_gap_disc_cancel();
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to pause scan; rc=%d", rc);
+        return false;
+    }
+    NIMBLE_CPP_RADIO_SCAN_STOP();
+
+    m_paused = true;
+    return true;
+} // pause
+
+
+/**
+ * @brief Resume a scan paused with pause() for the time it had left, keeping the results.
+ */
+void NimBLEScan::resume() {
+    if(!m_paused) {
+        return;
+    }
+
+    m_paused = false;
+    uint32_t duration = 0;
+    if(m_scanEnd != 0) {
+        uint64_t now = NimBLEUtils::getTimeUs();
+        // Scan at least 1 second so the scan still completes through the usual path.
+        duration = now < m_scanEnd ? (uint32_t)((m_scanEnd - now + 999999) / 1000000) : 1;
+    }
+
+    start(duration, m_scanCompleteCB, true);
+} // resume
+
+
+#if defined(CONFIG_BT_NIMBLE_MESH)
+/**
+ * @brief Turn the scanning needed by the mesh stack on or off, called by the mesh stack.
+ * @param [in] enable True if the mesh stack needs to receive advertisements.
+ * @return 0 on success or the host return code.
+ * @details The mesh stack receives the reports of every scan through its GAP event listener,
+ * so nothing is started while the application is scanning. Otherwise the continuous
+ * scan of the mesh stack is run until the application starts a scan.
+ */
+/*STATIC*/
+int NimBLEScan::meshScanControl(bool enable) {
+    NimBLEScan* pScan = NimBLEDevice::getScan();
+    pScan->m_meshScan = enable;
+
+    if(pScan->m_appScan) {
+        return 0;
+    }
+
+    if(enable) {
+        return bt_mesh_scan_start(nullptr, nullptr);
+    }
+
+    int rc = ble_gap_disc_cancel();
+    return rc == BLE_HS_EALREADY ? 0 : rc;
+} // meshScanControl
+
+
+/**
+ * @brief Called when the application scan has ended, restarts the scan of the mesh stack if it needs one.
+ */
+void NimBLEScan::resumeMeshScan() {
+    m_appScan = false;
+
+    if(m_meshScan) {
+        int rc = bt_mesh_scan_start(nullptr, nullptr);
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Failed to restart the mesh scan; rc=%d", rc);
+        }
+    }
+} // resumeMeshScan
+#endif
+
+
+/**
+ * @brief Clears the duplicate scan filter cache.
+ */
+void NimBLEScan::clearDuplicateCache() {
+#ifdef CONFIG_IDF_TARGET_ESP32 // Not available for ESP32C3
+    esp_ble_scan_dupilcate_list_flush();
+#endif
+}
+
+
+/**
+ * @brief Delete peer device from the scan results vector.
+ * @param [in] address The address of the device to delete from the results.
+ * @details After disconnecting, it may be required in the case we were connected to a device without a public address.
+ */
+void NimBLEScan::erase(const NimBLEAddress &address) {
+    NIMBLE_LOGD(LOG_TAG, "erase device: %s", NIMBLE_CPP_STR(address));
+
+    NimBLEAdvertisedDevice* pDevice = m_scanResults.findDevice(address);
+    if(pDevice != nullptr) {
+        // Take it out of the batch waiting to be delivered so the batch does not point to it.
+        if(pDevice->m_batchPending) {
+            m_batch.erase(std::remove(m_batch.begin(), m_batch.end(), pDevice), m_batch.end());
+            if(m_batch.empty()) {
+                ble_npl_callout_stop(&m_batchTimer);
+            }
+        }
+
+        m_scanResults.removeDevice(pDevice);
+        delete pDevice;
+    }
+}
+
+
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+/**
+ * @brief Set the callbacks for the periodic advertising syncs.
+ * @param [in] pCallbacks A pointer to the callbacks, they must remain valid while syncs are active.
+ */
+void NimBLEScan::setPeriodicSyncCallbacks(NimBLEPeriodicSyncCallbacks* pCallbacks) {
+    m_pPeriodicSyncCallbacks = pCallbacks;
+} // setPeriodicSyncCallbacks
+
+
+/**
+ * @brief Sync to the periodic advertising train of an advertiser.
+ * @param [in] address The address of the advertiser.
+ * @param [in] sid The advertising set ID of the periodic train.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The time without receiving the train before the sync is lost, 100 to 163840ms.
+ * @return True if the sync procedure was started.
+ * @details The sync is established from the extended advertisements of the advertiser so a scan must
+ * be running, it can be stopped after NimBLEPeriodicSyncCallbacks::onSync is called.
+ * Only one sync can be pending at a time.
+ */
+bool NimBLEScan::createPeriodicSync(const NimBLEAddress &address, uint8_t sid,
+                                    uint16_t skip, uint32_t timeoutMs)
+{
+    ble_gap_periodic_sync_params params;
+    setSyncParams(&params, skip, timeoutMs);
+
+    ble_addr_t addr;
+    memcpy(&addr.val, address.getNative(), 6);
+    addr.type = address.getType();
+
+    int rc = ble_gap_periodic_adv_sync_create(&addr, sid, &params,
+                                              NimBLEScan::handlePeriodicSyncEvent, this);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_sync_create rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // createPeriodicSync
+
+
+/**
+ * @brief Fill the parameters of a periodic sync.
+ * @param [out] params The parameters to fill.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The sync timeout in milliseconds, limited to 100 to 163840ms.
+ */
+void NimBLEScan::setSyncParams(ble_gap_periodic_sync_params* params, uint16_t skip, uint32_t timeoutMs) {
+    memset(params, 0, sizeof(*params));
+    params->skip         = skip;
+    params->sync_timeout = std::max<uint32_t>(10, std::min<uint32_t>(timeoutMs / 10, 0x4000));
+} // setSyncParams
+
+
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+/**
+ * @brief Accept the next periodic sync sent by the peer of a connection.
+ * @param [in] conn_handle The connection handle.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The time without receiving the train before the sync is lost, 100 to 163840ms.
+ * @return True if successful.
+ */
+bool NimBLEScan::receivePeriodicSync(uint16_t conn_handle, uint16_t skip, uint32_t timeoutMs) {
+    ble_gap_periodic_sync_params params;
+    setSyncParams(&params, skip, timeoutMs);
+
+    int rc = ble_gap_periodic_adv_sync_receive(conn_handle, &params,
+                                               NimBLEScan::handlePeriodicSyncEvent, this);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_sync_receive rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // receivePeriodicSync
+#endif
+
+
+/**
+ * @brief Sync to the periodic advertising train of a scanned device.
+ * @param [in] pDevice A pointer to the device, NimBLEAdvertisedDevice::getPeriodicInterval is non-zero
+ * if the device has a periodic train.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The time without receiving the train before the sync is lost, 100 to 163840ms.
+ * @return True if the sync procedure was started.
+ */
+bool NimBLEScan::createPeriodicSync(NimBLEAdvertisedDevice* pDevice, uint16_t skip, uint32_t timeoutMs) {
+    return createPeriodicSync(pDevice->getAddress(), pDevice->getSetId(), skip, timeoutMs);
+} // createPeriodicSync
+
+
+/**
+ * @brief Cancel the pending sync procedure.
+ * @return True if successful.
+ */
+bool NimBLEScan::cancelPeriodicSync() {
+    int rc = ble_gap_periodic_adv_sync_create_cancel();
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_sync_create_cancel rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // cancelPeriodicSync
+
+
+/**
+ * @brief Terminate a periodic advertising sync.
+ * @param [in] syncHandle The handle of the sync given to NimBLEPeriodicSyncCallbacks::onSync.
+ * @return True if successful.
+ */
+bool NimBLEScan::terminatePeriodicSync(uint16_t syncHandle) {
+    int rc = ble_gap_periodic_adv_sync_terminate(syncHandle);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_periodic_adv_sync_terminate rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // terminatePeriodicSync
+
+
+/**
+ * @brief Handle the events of the periodic advertising syncs.
+ * @param [in] event The event from the host.
+ * @param [in] arg A pointer to the scan instance.
+ */
+int NimBLEScan::handlePeriodicSyncEvent(ble_gap_event* event, void* arg) {
+    NimBLEScan* pScan = (NimBLEScan*)arg;
+    NimBLEPeriodicSyncCallbacks* pCallbacks = pScan->m_pPeriodicSyncCallbacks;
+
+    switch(event->type) {
+        case BLE_GAP_EVENT_PERIODIC_SYNC: {
+            NIMBLE_LOGD(LOG_TAG, "periodic sync; status=%u handle=%u",
+                        event->periodic_sync.status, event->periodic_sync.sync_handle);
+            if(pCallbacks != nullptr) {
+                pCallbacks->onSync(event->periodic_sync.status,
+                                   event->periodic_sync.sync_handle,
+                                   NimBLEAddress(event->periodic_sync.adv_addr),
+                                   event->periodic_sync.sid,
+                                   event->periodic_sync.per_adv_ival);
+            }
+            break;
+        }
+
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+        case BLE_GAP_EVENT_PERIODIC_TRANSFER: {
+            NIMBLE_LOGD(LOG_TAG, "periodic sync transfer; status=%u handle=%u conn_handle=%u",
+                        event->periodic_transfer.status, event->periodic_transfer.sync_handle,
+                        event->periodic_transfer.conn_handle);
+            if(pCallbacks != nullptr) {
+                pCallbacks->onSyncTransfer(event->periodic_transfer.status,
+                                           event->periodic_transfer.sync_handle,
+                                           event->periodic_transfer.conn_handle,
+                                           event->periodic_transfer.service_data,
+                                           NimBLEAddress(event->periodic_transfer.adv_addr),
+                                           event->periodic_transfer.sid,
+                                           event->periodic_transfer.per_adv_itvl);
+            }
+            break;
+        }
+#endif
+
+        case BLE_GAP_EVENT_PERIODIC_REPORT: {
+            if(pCallbacks != nullptr) {
+                pCallbacks->onReport(event->periodic_report.sync_handle,
+                                     event->periodic_report.data,
+                                     event->periodic_report.data_length,
+                                     event->periodic_report.rssi,
+                                     event->periodic_report.data_status);
+            }
+            break;
+        }
+
+        case BLE_GAP_EVENT_PERIODIC_SYNC_LOST: {
+            NIMBLE_LOGD(LOG_TAG, "periodic sync lost; handle=%u reason=%d",
+                        event->periodic_sync_lost.sync_handle, event->periodic_sync_lost.reason);
+            if(pCallbacks != nullptr) {
+                pCallbacks->onSyncLost(event->periodic_sync_lost.sync_handle,
+                                       event->periodic_sync_lost.reason);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return 0;
+} // handlePeriodicSyncEvent
+#endif
+
+
+/**
+ * @brief Called when host reset, we set a flag to stop scanning until synced.
+ */
+void NimBLEScan::onHostReset() {
+    m_ignoreResults = true;
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    m_appScan = false;
+#endif
+}
+
+
+/**
+ * @brief If the host reset and re-synced this is called.
+ * If the application was scanning indefinitely with a callback, restart it.
+ */
+void NimBLEScan::onHostSync() {
+    m_ignoreResults = false;
+
+    if(m_duration == 0 && m_pAdvertisedDeviceCallbacks != nullptr) {
+        start(m_duration, m_scanCompleteCB);
+    }
+
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    if(!m_appScan) {
+        resumeMeshScan();
+    }
+#endif
+}
+
+/**
+ * @brief Get the results of the scan.
+ * @return NimBLEScanResults object.
+ */
+NimBLEScanResults NimBLEScan::getResults() {
     return m_scanResults;
 }
 
@@ -509,10 +1936,10 @@ NimBLEScanResults NimBLEScan::getResults() {
  * @brief Clear the results of the scan.
  */
 void NimBLEScan::clearResults() {
-    for(auto &it: m_scanResults.m_advertisedDevicesVector) {
-        delete it;
-    }
-    m_scanResults.m_advertisedDevicesVector.clear();
+    // Any results waiting in a batch are discarded with the devices.
+    ble_npl_callout_stop(&m_batchTimer);
+    m_batch.clear();
+    m_scanResults.clear();
     clearDuplicateCache();
 }
 
@@ -523,7 +1950,7 @@ void NimBLEScan::clearResults() {
 void NimBLEScanResults::dump() {
     NIMBLE_LOGD(LOG_TAG, ">> Dump scan results:");
     for (int i=0; i<getCount(); i++) {
-        NIMBLE_LOGI(LOG_TAG, "- %s", getDevice(i).toString().c_str());
+        NIMBLE_LOGI(LOG_TAG, "- %s", m_advertisedDevicesVector[i]->toString().c_str());
     }
 } // dump
 
@@ -548,6 +1975,16 @@ NimBLEAdvertisedDevice NimBLEScanResults::getDevice(uint32_t i) {
 }
 
 
+/**
+ * @brief Get a pointer to the device at the given index without copying it.
+ * @param [in] i The index of the device, between 0 and getCount()-1.
+ * @return A pointer to the device or nullptr if the index is out of range.
+ */
+NimBLEAdvertisedDevice* NimBLEScanResults::getDevicePtr(uint32_t i) const {
+    return i < m_advertisedDevicesVector.size() ? m_advertisedDevicesVector[i] : nullptr;
+}
+
+
 /**
  * @brief Get iterator to the beginning of the vector of advertised device pointers.
  * @return An iterator to the beginning of the vector of advertised device pointers.
@@ -573,13 +2010,260 @@ std::vector<NimBLEAdvertisedDevice*>::iterator NimBLEScanResults::end() {
  * @return A pointer to the device at the specified address.
  */
 NimBLEAdvertisedDevice *NimBLEScanResults::getDevice(const NimBLEAddress &address) {
-    for(size_t index = 0; index < m_advertisedDevicesVector.size(); index++) {
-        if(m_advertisedDevicesVector[index]->getAddress() == address) {
-            return m_advertisedDevicesVector[index];
+    return findDevice(address);
+}
+
+
+/**
+ * @brief Write the devices in the results to a buffer as compact binary records.
+ * @param [in] buf A pointer to the buffer to write to.
+ * @param [in] size The size of the buffer.
+ * @param [in] since Only export the devices seen at or after this time, 0 to export all devices.
+ * Pass the time of the previous export to only send the devices seen since.
+ * @param [out] count If not nullptr, set to the number of records written.
+ * @return The number of bytes written. Devices that do not fit in the buffer are not exported.
+ * @details Each record is, with multi byte values little endian:\n
+ * address (6 bytes, as NimBLEAddress::getNative), address type (1), RSSI (1, signed),
+ * timestamp (4, seconds as getTimestamp), payload length (2), raw advertisement payload.\n
+ * The header is EXPORT_HEADER_LENGTH bytes.
+ */
+size_t NimBLEScanResults::exportBinary(uint8_t* buf, size_t size, time_t since, size_t* count) {
+    size_t offset = 0;
+    size_t records = 0;
+
+    for(auto &it : m_advertisedDevicesVector) {
+        if(it->getTimestamp() < since) {
+            continue;
+        }
+
+        size_t length = it->getPayloadLength();
+        if(offset + EXPORT_HEADER_LENGTH + length > size) {
+            break;
+        }
+
+        uint8_t* rec = buf + offset;
+        uint32_t timestamp = (uint32_t)it->getTimestamp();
+        memcpy(rec, it->getAddress().getNative(), 6);
+        rec[6]  = it->getAddressType();
+        rec[7]  = (uint8_t)(int8_t)it->getRSSI();
+        rec[8]  = timestamp;
+        rec[9]  = timestamp >> 8;
+        rec[10] = timestamp >> 16;
+        rec[11] = timestamp >> 24;
+        rec[12] = length;
+        rec[13] = length >> 8;
+        memcpy(rec + EXPORT_HEADER_LENGTH, it->getPayload(), length);
+
+        offset += EXPORT_HEADER_LENGTH + length;
+        records++;
+    }
+
+    if(count != nullptr) {
+        *count = records;
+    }
+    return offset;
+} // exportBinary
+
+
+/**
+ * @brief Get the home slot in the device index for an address.
+ * @param [in] address The address to hash.
+ * @return The index slot the probe sequence for this address starts at.
+ * @details The set ID is not part of the hash so that all devices sharing an address
+ * are found in the same probe sequence.
+ */
+size_t NimBLEScanResults::indexSlot(const NimBLEAddress &address) {
+    return (size_t)address.hash() & (m_deviceIndex.size() - 1);
+} // indexSlot
+
+
+/**
+ * @brief Find a device in the results using the address index.
+ * @param [in] address The address of the device.
+ * @param [in] sid The advertising set ID of the device, -1 to match any set ID.
+ * @return A pointer to the device or nullptr if not found.
+ */
+NimBLEAdvertisedDevice* NimBLEScanResults::findDevice(const NimBLEAddress &address, int sid) {
+    if(m_deviceIndex.empty()) {
+        return nullptr;
+    }
+
+    const size_t mask = m_deviceIndex.size() - 1;
+    for(size_t i = indexSlot(address); m_deviceIndex[i] != nullptr; i = (i + 1) & mask) {
+        NimBLEAdvertisedDevice* pDevice = m_deviceIndex[i];
+        if(pDevice->getAddress() == address) {
+#if CONFIG_BT_NIMBLE_EXT_ADV
+            if(sid >= 0 && pDevice->getSetId() != sid) {
+                continue;
+            }
+#endif
+            return pDevice;
         }
     }
 
     return nullptr;
-}
+} // findDevice
+
+
+/**
+ * @brief Add a device to the results vector and the address index.
+ * @param [in] pDevice A pointer to the device to add.
+ */
+void NimBLEScanResults::addDevice(NimBLEAdvertisedDevice* pDevice) {
+    m_advertisedDevicesVector.push_back(pDevice);
+
+    // Keep the index load factor at or below 3/4 so the probe sequences stay short.
+    if(m_advertisedDevicesVector.size() * 4 > m_deviceIndex.size() * 3) {
+        resizeIndex(m_deviceIndex.empty() ? 16 : m_deviceIndex.size() * 2);
+        return;
+    }
+
+    const size_t mask = m_deviceIndex.size() - 1;
+    size_t i = indexSlot(pDevice->getAddress());
+    while(m_deviceIndex[i] != nullptr) {
+        i = (i + 1) & mask;
+    }
+    m_deviceIndex[i] = pDevice;
+} // addDevice
+
+
+/**
+ * @brief Remove a device from the results vector and the address index, does not delete the device.
+ * @param [in] pDevice A pointer to the device to remove.
+ */
+void NimBLEScanResults::removeDevice(NimBLEAdvertisedDevice* pDevice) {
+    for(auto it = m_advertisedDevicesVector.begin(); it != m_advertisedDevicesVector.end(); ++it) {
+        if(*it == pDevice) {
+            m_advertisedDevicesVector.erase(it);
+            break;
+        }
+    }
+
+    if(m_deviceIndex.empty()) {
+        return;
+    }
+
+    const size_t mask = m_deviceIndex.size() - 1;
+    size_t i = indexSlot(pDevice->getAddress());
+    while(m_deviceIndex[i] != pDevice) {
+        if(m_deviceIndex[i] == nullptr) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Shift the following entries of the probe sequence back so no tombstones are needed.
+    m_deviceIndex[i] = nullptr;
+    for(size_t j = (i + 1) & mask; m_deviceIndex[j] != nullptr; j = (j + 1) & mask) {
+        size_t home = indexSlot(m_deviceIndex[j]->getAddress());
+        bool inPlace = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if(!inPlace) {
+            m_deviceIndex[i] = m_deviceIndex[j];
+            m_deviceIndex[j] = nullptr;
+            i = j;
+        }
+    }
+} // removeDevice
+
+
+/**
+ * @brief Delete all the devices in the results and release the index.
+ */
+void NimBLEScanResults::clear() {
+    for(auto &it: m_advertisedDevicesVector) {
+        delete it;
+    }
+    m_advertisedDevicesVector.clear();
+    std::vector<NimBLEAdvertisedDevice*>().swap(m_deviceIndex);
+} // clear
+
+
+/**
+ * @brief Rebuild the address index from the results vector.
+ * @param [in] capacity The new number of index slots, must be a power of 2.
+ */
+void NimBLEScanResults::resizeIndex(size_t capacity) {
+    m_deviceIndex.assign(capacity, nullptr);
+
+    const size_t mask = capacity - 1;
+    for(auto &it : m_advertisedDevicesVector) {
+        size_t i = indexSlot(it->getAddress());
+        while(m_deviceIndex[i] != nullptr) {
+            i = (i + 1) & mask;
+        }
+        m_deviceIndex[i] = it;
+    }
+} // resizeIndex
+
+
+
+/**
+ * @brief Take a snapshot of the scan results, holding them until the snapshot is destroyed.
+ * @param [in] pScan A pointer to the scan, see NimBLEDevice::getScan.
+ */
+NimBLEScanSnapshot::NimBLEScanSnapshot(NimBLEScan* pScan)
+: m_pScan(pScan) {
+    m_pScan->holdResults();
+} // NimBLEScanSnapshot
+
+
+/**
+ * @brief Move the hold of a snapshot to a new snapshot.
+ */
+NimBLEScanSnapshot::NimBLEScanSnapshot(NimBLEScanSnapshot&& other)
+: m_pScan(other.m_pScan) {
+    other.m_pScan = nullptr;
+} // NimBLEScanSnapshot
+
+
+NimBLEScanSnapshot::~NimBLEScanSnapshot() {
+    if(m_pScan != nullptr) {
+        m_pScan->releaseResults();
+    }
+} // ~NimBLEScanSnapshot
+
+
+/**
+ * @brief Get the number of devices in the results.
+ */
+size_t NimBLEScanSnapshot::getCount() const {
+    return m_pScan != nullptr ? m_pScan->m_scanResults.m_advertisedDevicesVector.size() : 0;
+} // getCount
+
+
+/**
+ * @brief Get the device at the given index.
+ * @param [in] i The index of the device, between 0 and getCount()-1.
+ * @return A pointer to the device or nullptr if the index is out of range.
+ */
+NimBLEAdvertisedDevice* NimBLEScanSnapshot::getDevice(size_t i) const {
+    return i < getCount() ? m_pScan->m_scanResults.m_advertisedDevicesVector[i] : nullptr;
+} // getDevice
+
+
+/**
+ * @brief Get the device with the given address.
+ * @param [in] address The address of the device.
+ * @return A pointer to the device or nullptr if not found.
+ */
+NimBLEAdvertisedDevice* NimBLEScanSnapshot::getDevice(const NimBLEAddress &address) const {
+    return m_pScan != nullptr ? m_pScan->m_scanResults.findDevice(address) : nullptr;
+} // getDevice
+
+
+/**
+ * @brief Get an iterator to the beginning of the device pointers.
+ */
+std::vector<NimBLEAdvertisedDevice*>::const_iterator NimBLEScanSnapshot::begin() const {
+    return m_pScan->m_scanResults.m_advertisedDevicesVector.cbegin();
+} // begin
+
+
+/**
+ * @brief Get an iterator to the end of the device pointers.
+ */
+std::vector<NimBLEAdvertisedDevice*>::const_iterator NimBLEScanSnapshot::end() const {
+    return m_pScan->m_scanResults.m_advertisedDevicesVector.cend();
+} // end
 
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_OBSERVER */
@@ -27,12 +27,56 @@
 #endif
 
 #include <vector>
+#include <string>
+#include <atomic>
+
+/* The largest advertisement data carried by a single report event. */
+#if CONFIG_BT_NIMBLE_EXT_ADV && (CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN < 255)
+#  define NIMBLE_CPP_SCAN_REPORT_DATA_LEN CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN
+#elif CONFIG_BT_NIMBLE_EXT_ADV
+#  define NIMBLE_CPP_SCAN_REPORT_DATA_LEN 255
+#else
+#  define NIMBLE_CPP_SCAN_REPORT_DATA_LEN 31
+#endif
 
 class NimBLEDevice;
 class NimBLEScan;
 class NimBLEAdvertisedDevice;
 class NimBLEAdvertisedDeviceCallbacks;
 class NimBLEAddress;
+class NimBLEPeriodicSyncCallbacks;
+class NimBLEBroadcastReceiver;
+
+/**
+ * @brief An advertisement report of a device on the watch list of the scan.
+ */
+typedef struct {
+    NimBLEAddress  address;
+    int8_t         rssi;
+    uint8_t        sid;
+    uint8_t        eventType;
+    bool           isLegacy;
+    bool           isComplete;
+    const uint8_t* data;
+    size_t         length;
+    uint64_t       timestamp;
+} NimBLEWatchReport;
+
+/**
+ * @brief Called with the reports of a watched device.
+ * @param [in] report The report, the data is only valid during the call.
+ * @param [in] arg The context given to NimBLEScan::addWatch.
+ * @return True to also process the report as usual, creating or updating its NimBLEAdvertisedDevice.
+ */
+typedef bool (*NimBLEWatchCallback)(const NimBLEWatchReport &report, void* arg);
+
+/**
+ * @brief A copy of an advertisement report event, queued for the scan report task.
+ */
+typedef struct {
+    ble_gap_event event;
+    uint8_t       data[NIMBLE_CPP_SCAN_REPORT_DATA_LEN];
+} ble_scan_report_t;
 
 /**
  * @brief A class that contains and operates on the results of a BLE scan.
@@ -46,13 +90,29 @@ public:
     void                                           dump();
     int                                            getCount();
     NimBLEAdvertisedDevice                         getDevice(uint32_t i);
+    NimBLEAdvertisedDevice*                        getDevicePtr(uint32_t i) const;
     std::vector<NimBLEAdvertisedDevice*>::iterator begin();
     std::vector<NimBLEAdvertisedDevice*>::iterator end();
     NimBLEAdvertisedDevice                         *getDevice(const NimBLEAddress &address);
+    size_t                                         exportBinary(uint8_t* buf, size_t size, time_t since = 0,
+                                                                size_t* count = nullptr);
+
+    /** @brief The length of the record header written by exportBinary before the payload of each device. */
+    static const size_t                            EXPORT_HEADER_LENGTH = 14;
 
 private:
     friend NimBLEScan;
+    friend class NimBLEScanSnapshot;
+
+    NimBLEAdvertisedDevice*              findDevice(const NimBLEAddress &address, int sid = -1);
+    void                                 addDevice(NimBLEAdvertisedDevice* pDevice);
+    void                                 removeDevice(NimBLEAdvertisedDevice* pDevice);
+    void                                 clear();
+    void                                 resizeIndex(size_t capacity);
+    size_t                               indexSlot(const NimBLEAddress &address);
+
     std::vector<NimBLEAdvertisedDevice*> m_advertisedDevicesVector;
+    std::vector<NimBLEAdvertisedDevice*> m_deviceIndex;
 };
 
 /**
@@ -69,7 +129,12 @@ public:
     void                setActiveScan(bool active);
     void                setInterval(uint16_t intervalMSecs);
     void                setWindow(uint16_t windowMSecs);
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    void                setPhy(uint8_t phyMask);
+    void                setPhyParams(uint8_t phyMask, uint16_t intervalMSecs, uint16_t windowMSecs);
+#endif
     void                setDuplicateFilter(bool enabled);
+    void                setDuplicateRefresh(uint32_t periodMs);
     void                setLimitedOnly(bool enabled);
     void                setFilterPolicy(uint8_t filter);
     void                clearDuplicateCache();
@@ -78,26 +143,236 @@ public:
     NimBLEScanResults   getResults();
     void                setMaxResults(uint8_t maxResults);
     void                erase(const NimBLEAddress &address);
-
+    void                setMaxResultAge(uint32_t seconds);
+    void                setEvictOldest(bool enabled);
+    void                setFilterManufacturerId(uint16_t companyId);
+    void                addFilterServiceUUID(const NimBLEUUID &uuid);
+    void                setFilterNamePrefix(const std::string &prefix);
+    void                setFilterRSSI(int8_t minRSSI);
+    void                setFilterAddressType(uint8_t addrType);
+    void                clearFilters();
+    void                setBatchSize(uint16_t count, uint32_t timeoutMs = 0);
+    void                setReportOnChange(bool enabled, uint8_t adType = 0, uint8_t rssiDelta = 0);
+    bool                setReportQueue(uint16_t queueSize, uint32_t taskStackSize = 4096,
+                                       uint8_t taskPriority = 1, int taskCore = -1);
+    uint32_t            getReportDropCount();
+    void                setBroadcastReceiver(NimBLEBroadcastReceiver* pReceiver);
+    bool                addWatch(const NimBLEAddress &address, NimBLEWatchCallback callback,
+                                 void* arg = nullptr, int sid = -1);
+    bool                removeWatch(const NimBLEAddress &address, int sid = -1);
+    void                clearWatchList();
+    size_t              getWatchCount();
+    void                setWatchOnly(bool enabled);
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+    void                setPeriodicSyncCallbacks(NimBLEPeriodicSyncCallbacks* pCallbacks);
+    bool                createPeriodicSync(const NimBLEAddress &address, uint8_t sid,
+                                           uint16_t skip = 0, uint32_t timeoutMs = 10000);
+    bool                createPeriodicSync(NimBLEAdvertisedDevice* pDevice,
+                                           uint16_t skip = 0, uint32_t timeoutMs = 10000);
+    bool                cancelPeriodicSync();
+    bool                terminatePeriodicSync(uint16_t syncHandle);
+#endif
 
 private:
     friend class NimBLEDevice;
+    friend class NimBLEClient;
+    friend class NimBLEServer;
+    friend class NimBLEMesh;
+    friend class NimBLEScanSnapshot;
 
     NimBLEScan();
     ~NimBLEScan();
     static int          handleGapEvent(ble_gap_event*  event, void* arg);
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+    static int          handlePeriodicSyncEvent(ble_gap_event* event, void* arg);
+    static void         setSyncParams(ble_gap_periodic_sync_params* params, uint16_t skip, uint32_t timeoutMs);
+#endif
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+    bool                receivePeriodicSync(uint16_t conn_handle, uint16_t skip, uint32_t timeoutMs);
+#endif
     void                onHostReset();
     void                onHostSync();
+    bool                pause();
+    void                resume();
+    bool                filterReport(const uint8_t *data, size_t length, int8_t rssi, uint8_t addrType);
+    void                reportResult(NimBLEAdvertisedDevice* pDevice);
+    bool                contentChanged(NimBLEAdvertisedDevice* pDevice);
+    void                flushBatch();
+    static void         batchTimerCb(ble_npl_event *event);
+    static void         reportTask(void *pvParameters);
+    void                queueReport(const ble_gap_event* event);
+    void                holdResults();
+    void                releaseResults();
+    bool                enterResults();
+    void                leaveResults();
+    void                evictDevice(NimBLEAdvertisedDevice* pDevice);
+    void                ageResults(uint64_t now);
+    bool                evictOldest();
+    bool                dispatchWatch(const NimBLEWatchReport &report, bool* handled);
+    void                resizeWatchIndex(size_t capacity);
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    static int          meshScanControl(bool enable);
+    void                resumeMeshScan();
+#endif
 
     NimBLEAdvertisedDeviceCallbacks*    m_pAdvertisedDeviceCallbacks = nullptr;
     void                                (*m_scanCompleteCB)(NimBLEScanResults scanResults);
     ble_gap_disc_params                 m_scan_params;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+    uint8_t                             m_scanPhys;
+    ble_gap_ext_disc_params             m_phyParams[2]; // 1M, Coded
+#endif
     bool                                m_ignoreResults;
+    uint32_t                            m_dupRefreshMs;
+    uint64_t                            m_dupRefreshUs; // Minimum time between reports of a device, 0 for once.
     NimBLEScanResults                   m_scanResults;
     uint32_t                            m_duration;
+    uint64_t                            m_scanEnd; // The end of a timed scan from NimBLEUtils::getTimeUs, 0 if continuous.
+    bool                                m_paused;
     ble_task_data_t                     *m_pTaskData;
     uint8_t                             m_maxResults;
+    bool                                m_filterEnabled;
+    bool                                m_filterCompanyIdSet;
+    uint16_t                            m_filterCompanyId;
+    int8_t                              m_filterMinRSSI;
+    uint8_t                             m_filterAddrType;
+    std::string                         m_filterNamePrefix;
+    std::vector<NimBLEUUID>             m_filterServiceUUIDs;
+    bool                                m_reportOnChange;
+    uint8_t                             m_changeAdType;
+    uint8_t                             m_changeRssiDelta;
+    uint16_t                            m_batchSize;
+    uint32_t                            m_batchTimeout;
+    ble_npl_callout                     m_batchTimer;
+    std::vector<NimBLEAdvertisedDevice*> m_batch;
+    uint32_t                            m_maxAge;
+    uint32_t                            m_lastAgeCheck;
+    bool                                m_evictOldest;
+    NimBLEBroadcastReceiver*            m_pBroadcastReceiver;
+
+    /**
+     * @brief A device on the watch list, stored in an open addressed table indexed by the address hash.
+     */
+    typedef struct {
+        NimBLEAddress       address;
+        NimBLEWatchCallback callback;
+        void*               arg;
+        int16_t             sid;
+    } watch_entry_t;
+
+    std::vector<watch_entry_t>          m_watchIndex;
+    size_t                              m_watchCount;
+    bool                                m_watchOnly;
+    TaskHandle_t                        m_reportTask;
+    ble_scan_report_t*                  m_reports;
+    uint16_t                            m_reportQueueSize;
+    std::atomic<uint16_t>               m_reportHead;
+    std::atomic<uint16_t>               m_reportTail;
+    std::atomic<uint32_t>               m_reportDrops;
+    std::atomic<bool>                   m_discCompletePending;
+    std::atomic<bool>                   m_batchFlushPending;
+    // The snapshots holding the results, the task changing them and the tasks waiting for it, see holdResults.
+    uint8_t                             m_resultsHolds;
+    TaskHandle_t                        m_resultsTask;
+    uint8_t                             m_resultsWaiters;
+    ble_npl_sem                         m_resultsSem;
+    int                                 m_discCompleteReason;
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+    NimBLEPeriodicSyncCallbacks*        m_pPeriodicSyncCallbacks;
+#endif
+#if defined(CONFIG_BT_NIMBLE_MESH)
+    bool                                m_meshScan;
+    bool                                m_appScan;
+#endif
+};
+
+/**
+ * @brief A view of the scan results that holds them unchanged for its lifetime, without copying the devices.
+ * @details The devices are read in place, advertisement reports that arrive while a snapshot exists are
+ * dropped so the host cannot update or delete a device while it is read. Keep snapshots short lived
+ * and do not call the NimBLEScan methods that change the results, like clearResults, while holding one.
+ */
+class NimBLEScanSnapshot {
+public:
+    NimBLEScanSnapshot(NimBLEScan* pScan);
+    NimBLEScanSnapshot(NimBLEScanSnapshot&& other);
+    ~NimBLEScanSnapshot();
+
+    size_t                                               getCount() const;
+    NimBLEAdvertisedDevice*                              getDevice(size_t i) const;
+    NimBLEAdvertisedDevice*                              getDevice(const NimBLEAddress &address) const;
+    std::vector<NimBLEAdvertisedDevice*>::const_iterator begin() const;
+    std::vector<NimBLEAdvertisedDevice*>::const_iterator end() const;
+
+private:
+    NimBLEScanSnapshot(const NimBLEScanSnapshot&) = delete;
+    NimBLEScanSnapshot& operator=(const NimBLEScanSnapshot&) = delete;
+
+    NimBLEScan*                                          m_pScan;
 };
 
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+/**
+ * @brief Callbacks for the periodic advertising trains synced with NimBLEScan::createPeriodicSync.
+ * @details These are called from the host task.
+ */
+class NimBLEPeriodicSyncCallbacks {
+public:
+    virtual ~NimBLEPeriodicSyncCallbacks() {}
+
+    /**
+     * @brief Called when a sync is established or could not be established.
+     * @param [in] status 0 if the sync was established, otherwise the error code and the other
+     * parameters are not valid.
+     * @param [in] syncHandle The handle of the sync, used to terminate it.
+     * @param [in] address The address of the advertiser.
+     * @param [in] sid The advertising set ID.
+     * @param [in] interval The periodic advertising interval in 1.25ms units.
+     * @details Scanning is not needed to receive the periodic advertisements once the sync is established.
+     */
+    virtual void onSync(uint8_t status, uint16_t syncHandle, const NimBLEAddress &address,
+                        uint8_t sid, uint16_t interval) {};
+
+    /**
+     * @brief Called when a sync is received from a connected peer, see NimBLEClient::receivePeriodicSync
+     * and NimBLEServer::receivePeriodicSync.
+     * @param [in] status 0 if the sync was established, otherwise the error code and the other
+     * parameters are not valid.
+     * @param [in] syncHandle The handle of the sync, used to terminate it.
+     * @param [in] connHandle The handle of the connection the sync was received on.
+     * @param [in] serviceData The value given by the peer when it sent the sync.
+     * @param [in] address The address of the advertiser.
+     * @param [in] sid The advertising set ID.
+     * @param [in] interval The periodic advertising interval in 1.25ms units.
+     * @details The default calls onSync.
+     */
+    virtual void onSyncTransfer(uint8_t status, uint16_t syncHandle, uint16_t connHandle,
+                                uint16_t serviceData, const NimBLEAddress &address,
+                                uint8_t sid, uint16_t interval) {
+        onSync(status, syncHandle, address, sid, interval);
+    };
+
+    /**
+     * @brief Called when a periodic advertisement is received.
+     * @param [in] syncHandle The handle of the sync.
+     * @param [in] data The advertisement data.
+     * @param [in] length The length of the data.
+     * @param [in] rssi The RSSI of the advertisement, 127 if not available.
+     * @param [in] dataStatus BLE_HCI_PERIODIC_DATA_STATUS_COMPLETE, or _INCOMPLETE if the data continues
+     * in the next report, or _TRUNCATED if the rest of the data was not received.
+     */
+    virtual void onReport(uint16_t syncHandle, const uint8_t* data, size_t length,
+                          int8_t rssi, uint8_t dataStatus) {};
+
+    /**
+     * @brief Called when a sync is lost or terminated.
+     * @param [in] syncHandle The handle of the sync.
+     * @param [in] reason BLE_HS_ETIMEOUT if the advertiser was not received within the sync timeout,
+     * BLE_HS_EDONE if the sync was terminated.
+     */
+    virtual void onSyncLost(uint16_t syncHandle, int reason) {};
+};
+#endif
+
 #endif /* CONFIG_BT_ENABLED CONFIG_BT_NIMBLE_ROLE_OBSERVER */
 #endif /* COMPONENTS_NIMBLE_SCAN_H_ */
@@ -22,13 +22,30 @@
 #if defined(CONFIG_NIMBLE_CPP_IDF)
 #include "services/gap/ble_svc_gap.h"
 #include "services/gatt/ble_svc_gatt.h"
+#include "nimble/nimble_port.h"
 #else
 #include "nimble/nimble/host/services/gap/include/services/gap/ble_svc_gap.h"
 #include "nimble/nimble/host/services/gatt/include/services/gatt/ble_svc_gatt.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
 #endif
 
+#include <algorithm>
+
+#define NIMBLE_SUB_NOTIFY   0x0001
+
+// Time to wait before retrying queued notifications when no mbufs were available.
+#define NIMBLE_CPP_NOTIFY_RETRY_MS 5
+
+#define NULL_HANDLE (0xffff)
+
 static const char* LOG_TAG = "NimBLEServer";
-static NimBLEServerCallbacks defaultCallbacks;
+/** The callbacks of a server without its own, none of the CB_ON_* callbacks is called. */
+class NimBLEDefaultServerCallbacks : public NimBLEServerCallbacks {
+public:
+    NimBLEDefaultServerCallbacks() : NimBLEServerCallbacks(0) {}
+};
+
+static NimBLEDefaultServerCallbacks defaultCallbacks;
 
 
 /**
@@ -39,6 +56,9 @@ static NimBLEServerCallbacks defaultCallbacks;
  */
 NimBLEServer::NimBLEServer() {
     memset(m_indWait, BLE_HS_CONN_HANDLE_NONE, sizeof(m_indWait));
+    for(auto &it : m_peerState) {
+        it.connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
 //    m_svcChgChrHdl          = 0xffff; // Future Use
     m_pServerCallbacks      = &defaultCallbacks;
     m_gattsStarted          = false;
@@ -47,6 +67,16 @@ NimBLEServer::NimBLEServer() {
 #endif
     m_svcChanged            = false;
     m_deleteCallbacks       = true;
+    m_notifyQueueDepth      = 0;
+    m_indicateQueueDepth    = CONFIG_NIMBLE_CPP_INDICATE_QUEUE_DEPTH;
+    m_useLinkProfile        = false;
+
+    memset(&m_notifyRetryTimer, 0, sizeof(m_notifyRetryTimer));
+    ble_npl_callout_init(&m_notifyRetryTimer, nimble_port_get_dflt_eventq(),
+                         NimBLEServer::notifyRetryCb, this);
+    memset(&m_notifyPolicyTimer, 0, sizeof(m_notifyPolicyTimer));
+    ble_npl_callout_init(&m_notifyPolicyTimer, nimble_port_get_dflt_eventq(),
+                         NimBLEServer::notifyPolicyCb, this);
 } // NimBLEServer
 
 
@@ -61,6 +91,9 @@ NimBLEServer::~NimBLEServer() {
     if(m_deleteCallbacks && m_pServerCallbacks != &defaultCallbacks) {
         delete m_pServerCallbacks;
     }
+
+    ble_npl_callout_deinit(&m_notifyRetryTimer);
+    ble_npl_callout_deinit(&m_notifyPolicyTimer);
 }
 
 
@@ -80,16 +113,17 @@ NimBLEService* NimBLEServer::createService(const char* uuid) {
  * @return A reference to the new service object.
  */
 NimBLEService* NimBLEServer::createService(const NimBLEUUID &uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> createService - %s", uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> createService - %s", NIMBLE_CPP_STR(uuid));
 
     // Check that a service with the supplied UUID does not already exist.
     if(getServiceByUUID(uuid) != nullptr) {
         NIMBLE_LOGW(LOG_TAG, "Warning creating a duplicate service UUID: %s",
-                             std::string(uuid).c_str());
+                             NIMBLE_CPP_STR(uuid));
     }
 
     NimBLEService* pService = new NimBLEService(uuid);
     m_svcVec.push_back(pService);
+    m_svcIndex.clear();
     serviceChanged();
 
     NIMBLE_LOGD(LOG_TAG, "<< createService");
@@ -115,6 +149,10 @@ NimBLEService* NimBLEServer::getServiceByUUID(const char* uuid, uint16_t instanc
  * @return A pointer to the service object or nullptr if not found.
  */
 NimBLEService* NimBLEServer::getServiceByUUID(const NimBLEUUID &uuid, uint16_t instanceId) {
+    if(m_svcIndex.isBuilt()) {
+        return m_svcIndex.getByUUID(uuid, instanceId);
+    }
+
     uint16_t position = 0;
     for (auto &it : m_svcVec) {
         if (it->getUUID() == uuid) {
@@ -133,6 +171,10 @@ NimBLEService* NimBLEServer::getServiceByUUID(const NimBLEUUID &uuid, uint16_t i
  * @return A pointer to the service object or nullptr if not found.
  */
 NimBLEService *NimBLEServer::getServiceByHandle(uint16_t handle) {
+    if(m_svcIndex.isBuilt()) {
+        return m_svcIndex.getByHandle(handle);
+    }
+
     for (auto &it : m_svcVec) {
         if (it->getHandle() == handle) {
             return it;
@@ -222,10 +264,39 @@ void NimBLEServer::start() {
         for(auto &chr : svc->m_chrVec) {
             // if Notify / Indicate is enabled but we didn't create the descriptor
             // we do it now.
-            if((chr->m_properties & BLE_GATT_CHR_F_INDICATE) ||
-                (chr->m_properties & BLE_GATT_CHR_F_NOTIFY)) {
+            bool hasCccd = (chr->m_properties & BLE_GATT_CHR_F_INDICATE) ||
+                           (chr->m_properties & BLE_GATT_CHR_F_NOTIFY);
+            if(hasCccd) {
                 m_notifyChrVec.push_back(chr);
             }
+
+            // The stack does not report descriptor handles, they are registered in order
+            // after the value handle and the client configuration descriptor if present.
+            if(svc->m_removed == 0 && chr->m_removed == 0) {
+                uint16_t dscHandle = chr->m_handle + (hasCccd ? 2 : 1);
+                for(auto &dsc : chr->m_dscVec) {
+                    if(dsc->m_removed == 0) {
+                        dsc->setHandle(dscHandle++);
+                    }
+                }
+            }
+
+            chr->m_dscIndex.build(chr->m_dscVec);
+        }
+
+        svc->m_chrIndex.build(svc->m_chrVec);
+    }
+
+    m_svcIndex.build(m_svcVec);
+
+    for(auto &svcs : m_staticSvcVec) {
+        for(const ble_gatt_svc_def* svc = svcs; svc->type != 0; ++svc) {
+            for(const ble_gatt_chr_def* chr = svc->characteristics; chr != nullptr && chr->uuid != nullptr; ++chr) {
+                if(chr->access_cb == NimBLECharacteristic::handleGapEvent &&
+                   (chr->flags & (BLE_GATT_CHR_F_INDICATE | BLE_GATT_CHR_F_NOTIFY))) {
+                    m_notifyChrVec.push_back((NimBLECharacteristic*)chr->arg);
+                }
+            }
         }
     }
 
@@ -339,12 +410,16 @@ NimBLEConnInfo NimBLEServer::getPeerIDInfo(uint16_t id) {
  */
 /*STATIC*/
 int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
+    NIMBLE_CPP_STACK_PROFILE(SERVER_GAP_EVENT, event->type);
+    NIMBLE_CPP_TRACE_GAP(SERVER_GAP, event);
     NimBLEServer* server = NimBLEDevice::getServer();
     NIMBLE_LOGD(LOG_TAG, ">> handleGapEvent: %s",
                          NimBLEUtils::gapEventToString(event->type));
     int rc = 0;
     struct ble_gap_conn_desc desc;
 
+    NimBLEDevice::dispatchGapEvent(event);
+
     switch(event->type) {
 
         case BLE_GAP_EVENT_CONNECT: {
@@ -357,14 +432,32 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
             }
             else {
                 server->m_connectedPeersVec.push_back(event->connect.conn_handle);
+                server->updatePeerState(event->connect.conn_handle);
 
-                rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
-                if (rc != 0) {
-                    return 0;
+                uint8_t callbacks = server->m_pServerCallbacks->m_callbacks;
+                if(callbacks & NimBLEServerCallbacks::CB_ON_CONNECT_DESC) {
+                    rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
+                    if (rc != 0) {
+                        return 0;
+                    }
+                }
+
+                if(server->m_useLinkProfile) {
+                    NimBLELinkProfile::apply(event->connect.conn_handle, server->m_linkProfile,
+                                             server->m_linkProfileCb);
                 }
 
-                server->m_pServerCallbacks->onConnect(server);
-                server->m_pServerCallbacks->onConnect(server, &desc);
+                NimBLEPhyPolicy::start(event->connect.conn_handle, server->m_phyPolicy);
+                NimBLEPowerPolicy::start(event->connect.conn_handle, server->m_powerPolicy);
+                NimBLEConnParamsPolicy::start(event->connect.conn_handle, server->m_connParamsPolicy);
+
+                if(callbacks & NimBLEServerCallbacks::CB_ON_CONNECT_DESC) {
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_CONNECT, server,
+                                                   desc.conn_handle, &desc);
+                } else if(callbacks & NimBLEServerCallbacks::CB_ON_CONNECT) {
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_CONNECT, server,
+                                                   event->connect.conn_handle, nullptr);
+                }
             }
 
             return 0;
@@ -390,13 +483,17 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                                                           server->m_connectedPeersVec.end(),
                                                           event->disconnect.conn.conn_handle),
                                                           server->m_connectedPeersVec.end());
+            server->clearPeerState(event->disconnect.conn.conn_handle);
 
             if(server->m_svcChanged) {
                 server->resetGATT();
             }
 
-            server->m_pServerCallbacks->onDisconnect(server);
-            server->m_pServerCallbacks->onDisconnect(server, &event->disconnect.conn);
+            if(server->m_pServerCallbacks->m_callbacks & (NimBLEServerCallbacks::CB_ON_DISCONNECT |
+                                                          NimBLEServerCallbacks::CB_ON_DISCONNECT_DESC)) {
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_DISCONNECT, server,
+                                               event->disconnect.conn.conn_handle, &event->disconnect.conn);
+            }
 
 #if !CONFIG_BT_NIMBLE_EXT_ADV
             if(server->m_advertiseOnDisconnect) {
@@ -417,12 +514,16 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                        (it->getProperties() & BLE_GATT_CHR_F_READ_AUTHOR) ||
                        (it->getProperties() & BLE_GATT_CHR_F_READ_ENC))
                     {
-                        rc = ble_gap_conn_find(event->subscribe.conn_handle, &desc);
-                        if (rc != 0) {
-                            break;
+                        ble_peer_state_t* pPeer = server->getPeerState(event->subscribe.conn_handle);
+                        if(pPeer == nullptr) {
+                            server->updatePeerState(event->subscribe.conn_handle);
+                            pPeer = server->getPeerState(event->subscribe.conn_handle);
+                            if(pPeer == nullptr) {
+                                break;
+                            }
                         }
 
-                        if(!desc.sec_state.encrypted) {
+                        if(!pPeer->encrypted) {
                             NimBLEDevice::startSecurity(event->subscribe.conn_handle);
                         }
                     }
@@ -435,16 +536,41 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
             return 0;
         } // BLE_GAP_EVENT_SUBSCRIBE
 
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: {
+            if(event->phy_updated.status != 0) {
+                return 0;
+            }
+
+            if(!(server->m_pServerCallbacks->m_callbacks & NimBLEServerCallbacks::CB_ON_PHY_UPDATE)) {
+                return 0;
+            }
+
+            rc = ble_gap_conn_find(event->phy_updated.conn_handle, &desc);
+            if (rc != 0) {
+                return 0;
+            }
+
+            server->m_pServerCallbacks->onPhyUpdate(event->phy_updated.tx_phy,
+                                                    event->phy_updated.rx_phy, &desc);
+            return 0;
+        } // BLE_GAP_EVENT_PHY_UPDATE_COMPLETE
+
         case BLE_GAP_EVENT_MTU: {
             NIMBLE_LOGI(LOG_TAG, "mtu update event; conn_handle=%d mtu=%d",
                         event->mtu.conn_handle,
                         event->mtu.value);
+            server->updatePeerState(event->mtu.conn_handle);
+            if(!(server->m_pServerCallbacks->m_callbacks & NimBLEServerCallbacks::CB_ON_MTU_CHANGE)) {
+                return 0;
+            }
+
             rc = ble_gap_conn_find(event->mtu.conn_handle, &desc);
             if (rc != 0) {
                 return 0;
             }
 
-            server->m_pServerCallbacks->onMTUChange(event->mtu.value, &desc);
+            NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_MTU_CHANGE, server,
+                                           desc.conn_handle, &desc, event->mtu.value);
             return 0;
         } // BLE_GAP_EVENT_MTU
 
@@ -457,7 +583,16 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 }
             }
 
+            // A status of 0 only reports that the indication was sent, it is completed
+            // by the confirmation, a timeout or a failure. The next one queued for the peer can then be sent.
+            if(event->notify_tx.indication && event->notify_tx.status != 0) {
+                server->clearIndicateWait(event->notify_tx.conn_handle);
+            }
+
             if(pChar == nullptr) {
+                if(event->notify_tx.indication && event->notify_tx.status != 0) {
+                    server->sendQueuedIndicate();
+                }
                 return 0;
             }
 
@@ -467,7 +602,7 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 if(event->notify_tx.status != 0) {
                     if(event->notify_tx.status == BLE_HS_EDONE) {
                         statusRC = NimBLECharacteristicCallbacks::Status::SUCCESS_INDICATE;
-                    } else if(rc == BLE_HS_ETIMEOUT) {
+                    } else if(event->notify_tx.status == BLE_HS_ETIMEOUT) {
                         statusRC = NimBLECharacteristicCallbacks::Status::ERROR_INDICATE_TIMEOUT;
                     } else {
                         statusRC = NimBLECharacteristicCallbacks::Status::ERROR_INDICATE_FAILURE;
@@ -476,7 +611,13 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                     return 0;
                 }
 
-                server->clearIndicateWait(event->notify_tx.conn_handle);
+                if(pChar->m_pCallbacks->m_callbacks & NimBLECharacteristicCallbacks::CB_ON_STATUS) {
+                    NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CHR_STATUS, pChar,
+                                                   event->notify_tx.conn_handle, nullptr,
+                                                   statusRC, event->notify_tx.status);
+                }
+                server->sendQueuedIndicate();
+                return 0;
             } else {
                 if(event->notify_tx.status == 0) {
                     statusRC = NimBLECharacteristicCallbacks::Status::SUCCESS_NOTIFY;
@@ -485,7 +626,11 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 }
             }
 
-            pChar->m_pCallbacks->onStatus(pChar, statusRC, event->notify_tx.status);
+            if(pChar->m_pCallbacks->m_callbacks & NimBLECharacteristicCallbacks::CB_ON_STATUS) {
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_CHR_STATUS, pChar,
+                                               event->notify_tx.conn_handle, nullptr,
+                                               statusRC, event->notify_tx.status);
+            }
 
             return 0;
         } // BLE_GAP_EVENT_NOTIFY_TX
@@ -530,49 +675,34 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
             if(rc != 0) {
                 return BLE_ATT_ERR_INVALID_HANDLE;
             }
+            server->updatePeerState(event->enc_change.conn_handle);
             // Compatibility only - Do not use, should be removed the in future
             if(NimBLEDevice::m_securityCallbacks != nullptr) {
                 NimBLEDevice::m_securityCallbacks->onAuthenticationComplete(&desc);
             /////////////////////////////////////////////
             } else {
-                server->m_pServerCallbacks->onAuthenticationComplete(&desc);
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_AUTH_COMPLETE, server,
+                                               desc.conn_handle, &desc);
             }
 
             return 0;
         } // BLE_GAP_EVENT_ENC_CHANGE
 
         case BLE_GAP_EVENT_PASSKEY_ACTION: {
-            struct ble_sm_io pkey = {0,0};
-
-            if (event->passkey.params.action == BLE_SM_IOACT_DISP) {
-                pkey.action = event->passkey.params.action;
-                // backward compatibility
-                pkey.passkey = NimBLEDevice::getSecurityPasskey(); // This is the passkey to be entered on peer
-                // if the (static)passkey is the default, check the callback for custom value
-                // both values default to the same.
-                if(pkey.passkey == 123456) {
-                    pkey.passkey = server->m_pServerCallbacks->onPassKeyRequest();
-                }
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_DISP; ble_sm_inject_io result: %d", rc);
-
-            } else if (event->passkey.params.action == BLE_SM_IOACT_NUMCMP) {
-                NIMBLE_LOGD(LOG_TAG, "Passkey on device's display: %" PRIu32, event->passkey.params.numcmp);
-                pkey.action = event->passkey.params.action;
-                // Compatibility only - Do not use, should be removed the in future
-                if(NimBLEDevice::m_securityCallbacks != nullptr) {
-                    pkey.numcmp_accept = NimBLEDevice::m_securityCallbacks->onConfirmPIN(event->passkey.params.numcmp);
-                /////////////////////////////////////////////
-                } else {
-                    pkey.numcmp_accept = server->m_pServerCallbacks->onConfirmPIN(event->passkey.params.numcmp);
-                }
-
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_NUMCMP; ble_sm_inject_io result: %d", rc);
+            if (event->passkey.params.action == BLE_SM_IOACT_DISP ||
+                event->passkey.params.action == BLE_SM_IOACT_NUMCMP ||
+                event->passkey.params.action == BLE_SM_IOACT_INPUT) {
+                // The callbacks may wait for the user, the callback tasks run them when started
+                // so the host keeps serving the other pairings.
+                NimBLEDevice::dispatchCallback(NimBLEDevice::CB_SERVER_PASSKEY, server,
+                                               event->passkey.conn_handle, nullptr,
+                                               event->passkey.params.action,
+                                               (int)event->passkey.params.numcmp);
 
             //TODO: Handle out of band pairing
             } else if (event->passkey.params.action == BLE_SM_IOACT_OOB) {
                 static uint8_t tem_oob[16] = {0};
+                struct ble_sm_io pkey = {0,0};
                 pkey.action = event->passkey.params.action;
                 for (int i = 0; i < 16; i++) {
                     pkey.oob[i] = tem_oob[i];
@@ -580,21 +710,6 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
                 rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
                 NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_OOB; ble_sm_inject_io result: %d", rc);
             //////////////////////////////////
-            } else if (event->passkey.params.action == BLE_SM_IOACT_INPUT) {
-                NIMBLE_LOGD(LOG_TAG, "Enter the passkey");
-                pkey.action = event->passkey.params.action;
-
-                // Compatibility only - Do not use, should be removed the in future
-                if(NimBLEDevice::m_securityCallbacks != nullptr) {
-                    pkey.passkey = NimBLEDevice::m_securityCallbacks->onPassKeyRequest();
-                /////////////////////////////////////////////
-                } else {
-                    pkey.passkey = server->m_pServerCallbacks->onPassKeyRequest();
-                }
-
-                rc = ble_sm_inject_io(event->passkey.conn_handle, &pkey);
-                NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_INPUT; ble_sm_inject_io result: %d", rc);
-
             } else if (event->passkey.params.action == BLE_SM_IOACT_NONE) {
                 NIMBLE_LOGD(LOG_TAG, "No passkey action required");
             }
@@ -612,6 +727,61 @@ int NimBLEServer::handleGapEvent(struct ble_gap_event *event, void *arg) {
 } // handleGapEvent
 
 
+/**
+ * @brief Get the passkey or numeric comparison result from the callbacks and give it to the stack.
+ * @param [in] connHandle The connection being paired.
+ * @param [in] action The passkey action, BLE_SM_IOACT_DISP, BLE_SM_IOACT_NUMCMP or BLE_SM_IOACT_INPUT.
+ * @param [in] numcmp The number to compare for BLE_SM_IOACT_NUMCMP.
+ * @details Called from a callback task when they are started, otherwise from the host task.
+ */
+void NimBLEServer::injectPasskey(uint16_t connHandle, uint8_t action, uint32_t numcmp) {
+    struct ble_sm_io pkey = {0,0};
+    int rc = 0;
+
+    pkey.action = action;
+    if (action == BLE_SM_IOACT_DISP) {
+        // backward compatibility
+        pkey.passkey = NimBLEDevice::getSecurityPasskey(); // This is the passkey to be entered on peer
+        // if the (static)passkey is the default, check the callback for custom value
+        // both values default to the same.
+        if(pkey.passkey == 123456) {
+            pkey.passkey = m_pServerCallbacks->onPassKeyRequest();
+        }
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_DISP; ble_sm_inject_io result: %d", rc);
+
+    } else if (action == BLE_SM_IOACT_NUMCMP) {
+        NIMBLE_LOGD(LOG_TAG, "Passkey on device's display: %" PRIu32, numcmp);
+        // Compatibility only - Do not use, should be removed the in future
+        if(NimBLEDevice::m_securityCallbacks != nullptr) {
+            pkey.numcmp_accept = NimBLEDevice::m_securityCallbacks->onConfirmPIN(numcmp);
+        /////////////////////////////////////////////
+        } else {
+            pkey.numcmp_accept = m_pServerCallbacks->onConfirmPIN(numcmp);
+        }
+
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_NUMCMP; ble_sm_inject_io result: %d", rc);
+
+    } else if (action == BLE_SM_IOACT_INPUT) {
+        NIMBLE_LOGD(LOG_TAG, "Enter the passkey");
+
+        // Compatibility only - Do not use, should be removed the in future
+        if(NimBLEDevice::m_securityCallbacks != nullptr) {
+            pkey.passkey = NimBLEDevice::m_securityCallbacks->onPassKeyRequest();
+        /////////////////////////////////////////////
+        } else {
+            pkey.passkey = m_pServerCallbacks->onPassKeyRequest();
+        }
+
+        rc = ble_sm_inject_io(connHandle, &pkey);
+        NIMBLE_LOGD(LOG_TAG, "BLE_SM_IOACT_INPUT; ble_sm_inject_io result: %d", rc);
+    }
+
+    (void)rc;
+} // injectPasskey
+
+
 /**
  * @brief Set the server callbacks.
  *
@@ -641,10 +811,13 @@ void NimBLEServer::setCallbacks(NimBLEServerCallbacks* pCallbacks, bool deleteCa
  * available and can be re-added in the future. If desired a removed but not deleted service can
  * be deleted later by calling this method with deleteSvc set to true.
  *
- * @note The service will not be removed from the database until all open connections are closed
+ * @note A service that is only hidden stays registered, the service changed indication covers only its
+ * handle range and it can be restored by addService without resetting the GATT server.
+ *
+ * @note A deleted service will not be removed from the database until all open connections are closed
  * as it requires resetting the GATT server. In the interim the service will have it's visibility disabled.
  *
- * @note Advertising will need to be restarted by the user after calling this as we must stop
+ * @note Advertising will need to be restarted by the user after deleting a service as we must stop
  * advertising in order to remove the service.
  *
  * @param [in] service The service object to remove.
@@ -660,6 +833,7 @@ void NimBLEServer::removeService(NimBLEService* service, bool deleteSvc) {
                 if ((*it) == service) {
                     delete *it;
                     m_svcVec.erase(it);
+                    m_svcIndex.clear();
                     break;
                 }
             }
@@ -674,7 +848,14 @@ void NimBLEServer::removeService(NimBLEService* service, bool deleteSvc) {
     }
 
     service->m_removed = deleteSvc ? NIMBLE_ATT_REMOVE_DELETE : NIMBLE_ATT_REMOVE_HIDE;
-    serviceChanged();
+
+    // A hidden service stays registered with the stack so only its handle range has changed,
+    // deleting it requires the database to be rebuilt.
+    if(deleteSvc) {
+        serviceChanged();
+    } else {
+        ble_svc_gatt_changed(service->getHandle(), getServiceEndHandle(service));
+    }
 #if !CONFIG_BT_NIMBLE_EXT_ADV
     NimBLEDevice::getAdvertising()->removeServiceUUID(service->getUUID());
 #endif
@@ -692,13 +873,25 @@ void NimBLEServer::addService(NimBLEService* service) {
     // Check that a service with the supplied UUID does not already exist.
     if(getServiceByUUID(service->getUUID()) != nullptr) {
         NIMBLE_LOGW(LOG_TAG, "Warning creating a duplicate service UUID: %s",
-                             std::string(service->getUUID()).c_str());
+                             NIMBLE_CPP_STR(service->getUUID()));
     }
 
     // If adding a service that was not removed add it and return.
     // Else reset GATT and send service changed notification.
     if(service->m_removed == 0) {
         m_svcVec.push_back(service);
+        m_svcIndex.clear();
+        return;
+    }
+
+    // If the service was hidden and is still registered with the stack it can be
+    // restored in place without resetting the GATT server.
+    if(service->m_removed == NIMBLE_ATT_REMOVE_HIDE && m_gattsStarted &&
+       service->getHandle() != NULL_HANDLE &&
+       ble_gatts_svc_set_visibility(service->getHandle(), 1) == 0)
+    {
+        service->m_removed = 0;
+        ble_svc_gatt_changed(service->getHandle(), getServiceEndHandle(service));
         return;
     }
 
@@ -707,6 +900,121 @@ void NimBLEServer::addService(NimBLEService* service) {
 }
 
 
+/**
+ * @brief Get the last handle that may belong to a registered service.
+ * @param [in] service The service to find the end handle of.
+ * @return The handle before the next registered service or 0xffff if it is the last.
+ */
+uint16_t NimBLEServer::getServiceEndHandle(NimBLEService* service) {
+    uint16_t start = service->getHandle();
+    uint16_t end = 0xffff;
+
+    for(auto &svc : m_svcVec) {
+        uint16_t handle = svc->getHandle();
+        if(handle != NULL_HANDLE && handle > start && handle <= end) {
+            end = handle - 1;
+        }
+    }
+
+    for(auto &svcs : m_staticSvcVec) {
+        for(const ble_gatt_svc_def* svc = svcs; svc->type != 0; ++svc) {
+            uint16_t handle;
+            if(ble_gatts_find_svc(svc->uuid, &handle) == 0 && handle > start && handle <= end) {
+                end = handle - 1;
+            }
+        }
+    }
+
+    return end;
+} // getServiceEndHandle
+
+
+/**
+ * @brief Register a service table defined at compile time.
+ * @param [in] svcs A static array of services declared with NIMBLE_STATIC_SVC ending with NIMBLE_STATIC_SVC_END.
+ * @return True if the services were registered.
+ * @details The table is registered with the stack as is, so it can be const and placed in flash
+ * and no service or characteristic definitions are allocated. Characteristics and descriptors
+ * declared with NIMBLE_STATIC_CHR and NIMBLE_STATIC_DSC are bound to their objects, which take
+ * the UUID and properties from the table and provide the value and callbacks as usual.
+ * Static characteristics do not belong to a NimBLEService, NimBLECharacteristic::getService returns nullptr.
+ * Must be called before start(), the table must stay valid while the server exists.
+ * @code
+ * static NimBLECharacteristic batteryChr(NimBLEUUID((uint16_t)0x2a19), NIMBLE_PROPERTY::READ);
+ * static const ble_uuid16_t batterySvcUUID = {BLE_UUID_TYPE_16, 0x180f};
+ * static const ble_uuid16_t batteryChrUUID = {BLE_UUID_TYPE_16, 0x2a19};
+ * static const ble_gatt_chr_def batteryChrs[] = {
+ *     NIMBLE_STATIC_CHR(batteryChrUUID, batteryChr, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY, nullptr),
+ *     NIMBLE_STATIC_CHR_END
+ * };
+ * static const ble_gatt_svc_def gattTable[] = {
+ *     NIMBLE_STATIC_SVC(batterySvcUUID, batteryChrs),
+ *     NIMBLE_STATIC_SVC_END
+ * };
+ *
+ * pServer->addStaticServices(gattTable);
+ * @endcode
+ */
+bool NimBLEServer::addStaticServices(const struct ble_gatt_svc_def* svcs) {
+    if(m_gattsStarted) {
+        NIMBLE_LOGE(LOG_TAG, "Static services must be added before the server is started");
+        return false;
+    }
+
+    for(const ble_gatt_svc_def* svc = svcs; svc->type != 0; ++svc) {
+        for(const ble_gatt_chr_def* chr = svc->characteristics; chr != nullptr && chr->uuid != nullptr; ++chr) {
+            if(chr->access_cb != NimBLECharacteristic::handleGapEvent) {
+                continue;
+            }
+
+            NimBLECharacteristic* pChr = (NimBLECharacteristic*)chr->arg;
+            pChr->m_uuid = NimBLEUUID((const ble_uuid_any_t*)chr->uuid);
+            pChr->m_properties = chr->flags;
+
+            for(const ble_gatt_dsc_def* dsc = chr->descriptors; dsc != nullptr && dsc->uuid != nullptr; ++dsc) {
+                if(dsc->access_cb != NimBLEDescriptor::handleGapEvent) {
+                    continue;
+                }
+
+                NimBLEDescriptor* pDsc = (NimBLEDescriptor*)dsc->arg;
+                pDsc->m_uuid = NimBLEUUID((const ble_uuid_any_t*)dsc->uuid);
+                pDsc->m_properties = dsc->att_flags;
+                pDsc->m_pCharacteristic = pChr;
+            }
+        }
+    }
+
+    if(!registerStaticServices(svcs)) {
+        return false;
+    }
+
+    m_staticSvcVec.push_back(svcs);
+    return true;
+} // addStaticServices
+
+
+/**
+ * @brief Add a static service table to the stack.
+ * @param [in] svcs The service table.
+ * @return True if successful.
+ */
+bool NimBLEServer::registerStaticServices(const struct ble_gatt_svc_def* svcs) {
+    int rc = ble_gatts_count_cfg(svcs);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gatts_count_cfg failed, rc= %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    rc = ble_gatts_add_svcs(svcs);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gatts_add_svcs, rc= %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // registerStaticServices
+
+
 /**
  * @brief Resets the GATT server, used when services are added/removed after initialization.
  */
@@ -719,6 +1027,7 @@ void NimBLEServer::resetGATT() {
     ble_gatts_reset();
     ble_svc_gap_init();
     ble_svc_gatt_init();
+    m_svcIndex.clear();
 
     for(auto it = m_svcVec.begin(); it != m_svcVec.end(); ) {
         if ((*it)->m_removed > 0) {
@@ -726,6 +1035,8 @@ void NimBLEServer::resetGATT() {
                 delete *it;
                 it = m_svcVec.erase(it);
             } else {
+                // Hidden services are not registered again, their handle is no longer valid.
+                (*it)->m_handle = NULL_HANDLE;
                 ++it;
             }
             continue;
@@ -735,6 +1046,10 @@ void NimBLEServer::resetGATT() {
         ++it;
     }
 
+    for(auto &svcs : m_staticSvcVec) {
+        registerStaticServices(svcs);
+    }
+
     m_svcChanged = false;
     m_gattsStarted = false;
 }
@@ -851,25 +1166,880 @@ void NimBLEServer::setDataLen(uint16_t conn_handle, uint16_t tx_octets) {
 } // setDataLen
 
 
+/**
+ * @brief Set a link profile to negotiate on every new connection.
+ * @param [in] profile The link parameters to request, see NimBLELinkProfile::throughput.
+ * @param [in] callback The function to call with the achieved parameters of each connection.
+ */
+void NimBLEServer::setLinkProfile(const NimBLELinkProfile &profile, link_profile_callback callback) {
+    m_linkProfile    = profile;
+    m_linkProfileCb  = callback;
+    m_useLinkProfile = true;
+} // setLinkProfile
+
+
+/**
+ * @brief Negotiate a link profile on a connection.
+ * @details Requests the PHY, data length, MTU and connection parameters in that order, each step
+ * waits for the peer before the next is started. A rejected connection parameter update is retried
+ * with a longer interval.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] profile The link parameters to request.
+ * @param [in] callback The function to call with the achieved parameters when done.
+ * @return True if the negotiation was started.
+ */
+bool NimBLEServer::applyLinkProfile(uint16_t conn_handle, const NimBLELinkProfile &profile,
+                                    link_profile_callback callback)
+{
+    return NimBLELinkProfile::apply(conn_handle, profile, callback);
+} // applyLinkProfile
+
+
+/**
+ * @brief Request the PHY of a connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] txPhyMask The preferred transmit PHY mask, BLE_GAP_LE_PHY_1M_MASK, BLE_GAP_LE_PHY_2M_MASK,
+ * BLE_GAP_LE_PHY_CODED_MASK or BLE_GAP_LE_PHY_ANY_MASK.
+ * @param [in] rxPhyMask The preferred receive PHY mask.
+ * @param [in] phyOptions The Coded PHY option, BLE_GAP_LE_PHY_CODED_ANY, _S2 or _S8.
+ * @return True if the request was sent, NimBLEServerCallbacks::onPhyUpdate is called when the PHY changes.
+ */
+bool NimBLEServer::setPhy(uint16_t conn_handle, uint8_t txPhyMask, uint8_t rxPhyMask, uint16_t phyOptions) {
+    int rc = ble_gap_set_prefered_le_phy(conn_handle, txPhyMask, rxPhyMask, phyOptions);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Set PHY error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // setPhy
+
+
+/**
+ * @brief Read the PHY of a connection.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [out] txPhy The transmit PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+ * @param [out] rxPhy The receive PHY.
+ * @return True if the PHY was read.
+ */
+bool NimBLEServer::getPhy(uint16_t conn_handle, uint8_t* txPhy, uint8_t* rxPhy) {
+    int rc = ble_gap_read_le_phy(conn_handle, txPhy, rxPhy);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Get PHY error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // getPhy
+
+
+/**
+ * @brief Set a policy to switch the PHY from the RSSI on every new connection.
+ * @param [in] policy The thresholds to switch at, see NimBLEPhyPolicy::adaptive.
+ * A default constructed policy disables switching from the next connection.
+ */
+void NimBLEServer::setPhyPolicy(const NimBLEPhyPolicy &policy) {
+    m_phyPolicy = policy;
+} // setPhyPolicy
+
+
+/**
+ * @brief Set a policy to adjust the transmit power from the RSSI on every new connection.
+ * @param [in] policy The target RSSI range and power limits, see NimBLEPowerPolicy::adaptive.
+ * A default constructed policy disables the adjustment from the next connection.
+ */
+void NimBLEServer::setPowerPolicy(const NimBLEPowerPolicy &policy) {
+    m_powerPolicy = policy;
+} // setPowerPolicy
+
+
+/**
+ * @brief Set a policy to switch the connection parameters from the traffic on every new connection.
+ * @param [in] policy The profiles and rates to switch at, see NimBLEConnParamsPolicy::adaptive.
+ * A default constructed policy disables switching from the next connection.
+ */
+void NimBLEServer::setConnParamsPolicy(const NimBLEConnParamsPolicy &policy) {
+    m_connParamsPolicy = policy;
+} // setConnParamsPolicy
+
+
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+#  if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+/**
+ * @brief Send a periodic advertising sync to a client so it can receive the train without scanning.
+ * @param [in] conn_handle The connection handle of the client.
+ * @param [in] syncHandle The handle of a sync created with NimBLEScan::createPeriodicSync.
+ * @param [in] serviceData A value passed to the client with the sync.
+ * @return True if the transfer was started.
+ */
+bool NimBLEServer::transferPeriodicSync(uint16_t conn_handle, uint16_t syncHandle, uint16_t serviceData) {
+    int rc = ble_gap_periodic_adv_sync_transfer(syncHandle, conn_handle, serviceData);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Sync transfer error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // transferPeriodicSync
+
+
+/**
+ * @brief Accept the next periodic advertising sync sent by a client.
+ * @param [in] conn_handle The connection handle of the client.
+ * @param [in] skip The number of periodic advertisements that can be skipped after a successful receive.
+ * @param [in] timeoutMs The time without receiving the train before the sync is lost, 100 to 163840ms.
+ * @return True if successful.
+ * @details The sync is reported to NimBLEPeriodicSyncCallbacks::onSyncTransfer of the callbacks set with
+ * NimBLEScan::setPeriodicSyncCallbacks, followed by its reports. Only one sync is accepted per call.
+ */
+bool NimBLEServer::receivePeriodicSync(uint16_t conn_handle, uint16_t skip, uint32_t timeoutMs) {
+    return NimBLEDevice::getScan()->receivePeriodicSync(conn_handle, skip, timeoutMs);
+} // receivePeriodicSync
+#  endif
+
+
+#  if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+/**
+ * @brief Send the sync information of a periodic train this device advertises to a client.
+ * @param [in] conn_handle The connection handle of the client.
+ * @param [in] instId The extended advertising instance running periodic advertising.
+ * @param [in] serviceData A value passed to the client with the sync.
+ * @return True if the transfer was started.
+ */
+bool NimBLEServer::transferPeriodicAdvInfo(uint16_t conn_handle, uint8_t instId, uint16_t serviceData) {
+    int rc = ble_gap_periodic_adv_sync_set_info(instId, conn_handle, serviceData);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Sync set info error: %d, %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    return true;
+} // transferPeriodicAdvInfo
+#  endif
+#endif
+
+
+/**
+ * @brief Mark an indication to a peer as waiting for confirmation before sending it.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return True if the indication can be sent now, false if one is already waiting for
+ * confirmation or queued for the peer, the indication must then be queued.
+ */
 bool NimBLEServer::setIndicateWait(uint16_t conn_handle) {
+    ble_npl_hw_enter_critical();
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    bool claimed = (pState == nullptr || pState->indicateQueued == 0) && claimIndicateWait(conn_handle);
+    ble_npl_hw_exit_critical(0);
+
+    return claimed;
+} // setIndicateWait
+
+
+/**
+ * @brief Take the indication wait slot of a peer, called in a critical section.
+ * @return True if no indication is waiting for confirmation from the peer.
+ */
+bool NimBLEServer::claimIndicateWait(uint16_t conn_handle) {
+    int freeSlot = -1;
     for(auto i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
         if(m_indWait[i] == conn_handle) {
             return false;
         }
+        if(freeSlot < 0 && m_indWait[i] == BLE_HS_CONN_HANDLE_NONE) {
+            freeSlot = i;
+        }
     }
 
+    if(freeSlot < 0) {
+        return false;
+    }
+
+    m_indWait[freeSlot] = conn_handle;
     return true;
-}
+} // claimIndicateWait
 
 
+/**
+ * @brief Clear the indication waiting for confirmation from a peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ */
 void NimBLEServer::clearIndicateWait(uint16_t conn_handle) {
+    ble_npl_hw_enter_critical();
     for(auto i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
         if(m_indWait[i] == conn_handle) {
             m_indWait[i] = BLE_HS_CONN_HANDLE_NONE;
+            break;
+        }
+    }
+    ble_npl_hw_exit_critical(0);
+} // clearIndicateWait
+
+
+/**
+ * @brief Set the number of indications that can wait for the confirmation of the previous indication to each peer.
+ * @param [in] depth The number of indications per peer, 0 to not queue indications.
+ * Default is CONFIG_NIMBLE_CPP_INDICATE_QUEUE_DEPTH.
+ * @details Only one indication can wait for confirmation from a peer. Further indications to it are
+ * copied into its queue and sent in order as each is confirmed, while indications to other peers are
+ * sent right away. Each indication reports its completion, timeout or failure to
+ * NimBLECharacteristicCallbacks::onStatus. When the queue is full the indication is dropped and
+ * onStatus is called with ERROR_INDICATE_FAILURE and BLE_HS_ENOMEM.
+ */
+void NimBLEServer::setIndicateQueueDepth(uint8_t depth) {
+    m_indicateQueueDepth = depth;
+} // setIndicateQueueDepth
+
+
+/**
+ * @brief Get the number of indications waiting to be sent to a peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return The number of queued indications, not counting the one waiting for confirmation.
+ */
+uint8_t NimBLEServer::getIndicateQueueCount(uint16_t conn_handle) {
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    return pState != nullptr ? pState->indicateQueued : 0;
+} // getIndicateQueueCount
+
+
+/**
+ * @brief Copy an indication into the queue of a peer to be sent once the previous indication is confirmed.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] attr_handle The handle of the characteristic value.
+ * @param [in] value A pointer to the indication data.
+ * @param [in] length The length of the data.
+ * @param [in] txPrio The transmit priority class of the indication.
+ * @return True if the indication was queued, false if the queue of the peer is full or queueing is disabled.
+ */
+bool NimBLEServer::queueIndicate(uint16_t conn_handle, uint16_t attr_handle,
+                                 const uint8_t* value, size_t length, uint8_t txPrio)
+{
+    if(m_indicateQueueDepth == 0) {
+        return false;
+    }
+
+    std::list<ble_notify_pending_t> entry;
+    entry.push_back({conn_handle, attr_handle, std::vector<uint8_t>(value, value + length), txPrio,
+                     ble_npl_time_get()});
+
+    bool queued = false;
+    ble_npl_hw_enter_critical();
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    if(pState != nullptr && pState->indicateQueued < m_indicateQueueDepth) {
+        m_indicatePending.splice(m_indicatePending.end(), entry);
+        pState->indicateQueued++;
+        queued = true;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    // The confirmation may have arrived while queueing, send it now in that case.
+    if(queued) {
+        sendQueuedIndicate();
+    }
+
+    return queued;
+} // queueIndicate
+
+
+/**
+ * @brief Send the oldest queued indication of each peer without an indication waiting for confirmation.
+ */
+void NimBLEServer::sendQueuedIndicate() {
+    for(;;) {
+        std::list<ble_notify_pending_t> entry;
+        ble_npl_hw_enter_critical();
+        for(auto it = m_indicatePending.begin(); it != m_indicatePending.end(); ++it) {
+            if(claimIndicateWait(it->connHandle)) {
+                ble_peer_state_t* pState = getPeerState(it->connHandle);
+                if(pState != nullptr && pState->indicateQueued > 0) {
+                    pState->indicateQueued--;
+                }
+                entry.splice(entry.end(), m_indicatePending, it);
+                break;
+            }
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(entry.empty()) {
             return;
         }
+
+        ble_notify_pending_t &pending = entry.front();
+        os_mbuf *om = ble_hs_mbuf_from_flat(pending.value.data(), pending.value.size());
+        if(om == nullptr) {
+            // Put it back at the front of the queue and try again when buffers are available.
+            ble_npl_hw_enter_critical();
+            ble_peer_state_t* pState = getPeerState(pending.connHandle);
+            if(pState != nullptr) {
+                pState->indicateQueued++;
+            }
+            m_indicatePending.splice(m_indicatePending.begin(), entry);
+            ble_npl_hw_exit_critical(0);
+            clearIndicateWait(pending.connHandle);
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, mbufAllocFailures, 1);
+            ble_npl_callout_reset(&m_notifyRetryTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_NOTIFY_RETRY_MS));
+            return;
+        }
+
+        ble_hs_mbuf_set_tx_prio(om, pending.txPrio);
+        int rc = ble_gattc_indicate_custom(pending.connHandle, pending.attrHandle, om);
+        if(rc == 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, indicateTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, indicateTxBytes, pending.value.size());
+            continue;
+        }
+
+        clearIndicateWait(pending.connHandle);
+        NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, txFailures, 1);
+        for(auto &chr : m_notifyChrVec) {
+            if(chr->getHandle() == pending.attrHandle) {
+                chr->m_pCallbacks->onStatus(chr, NimBLECharacteristicCallbacks::Status::ERROR_INDICATE_FAILURE, rc);
+                break;
+            }
+        }
     }
-}
+} // sendQueuedIndicate
+
+
+/**
+ * @brief Remove the queued indications to a peer that can no longer be sent.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] attr_handle The handle of the characteristic value to remove the indications of, 0 for all.
+ */
+void NimBLEServer::dropQueuedIndicate(uint16_t conn_handle, uint16_t attr_handle) {
+    std::list<ble_notify_pending_t> dropped;
+    ble_npl_hw_enter_critical();
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    for(auto it = m_indicatePending.begin(); it != m_indicatePending.end();) {
+        if(it->connHandle == conn_handle && (attr_handle == 0 || it->attrHandle == attr_handle)) {
+            dropped.splice(dropped.end(), m_indicatePending, it++);
+            if(pState != nullptr && pState->indicateQueued > 0) {
+                pState->indicateQueued--;
+            }
+        } else {
+            ++it;
+        }
+    }
+    ble_npl_hw_exit_critical(0);
+
+    for(auto &it : dropped) {
+        for(auto &chr : m_notifyChrVec) {
+            if(chr->getHandle() == it.attrHandle) {
+                chr->m_pCallbacks->onStatus(chr, NimBLECharacteristicCallbacks::Status::ERROR_NO_CLIENT,
+                                            BLE_HS_ENOTCONN);
+                break;
+            }
+        }
+    }
+} // dropQueuedIndicate
+
+
+/**
+ * @brief Get the cached state of a connected peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return A pointer to the peer state or nullptr if the connection is not known to the server,
+ * for instance a connection created by a NimBLEClient.
+ * @details The state is stored at the slot index the host assigned to the connection, which is
+ * the connection handle modulo the number of connections unless that slot was taken, so this is
+ * usually found without searching. Safe to call from a critical section.
+ */
+NimBLEServer::ble_peer_state_t* NimBLEServer::getPeerState(uint16_t conn_handle) {
+    ble_peer_state_t* pState = &m_peerState[conn_handle % CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    if(pState->connHandle == conn_handle) {
+        return pState;
+    }
+
+    for(auto &it : m_peerState) {
+        if(it.connHandle == conn_handle) {
+            return &it;
+        }
+    }
+
+    return nullptr;
+} // getPeerState
+
+
+/**
+ * @brief Refresh the cached MTU and encryption state of a connected peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ */
+void NimBLEServer::updatePeerState(uint16_t conn_handle) {
+    ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(conn_handle, &desc) != 0) {
+        clearPeerState(conn_handle);
+        return;
+    }
+
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    if(pState == nullptr) {
+        uint8_t slot;
+        if(ble_gap_conn_slot(conn_handle, &slot) == 0 && slot < CONFIG_BT_NIMBLE_MAX_CONNECTIONS &&
+           m_peerState[slot].connHandle == BLE_HS_CONN_HANDLE_NONE) {
+            pState = &m_peerState[slot];
+        } else {
+            pState = getPeerState(BLE_HS_CONN_HANDLE_NONE);
+        }
+
+        if(pState == nullptr) {
+            return;
+        }
+    }
+
+    if(pState->connHandle != conn_handle) {
+        pState->connHandle     = conn_handle;
+        pState->notifyQueued   = 0;
+        pState->indicateQueued = 0;
+        pState->notifyServed   = false;
+    }
+
+    pState->mtu        = ble_att_mtu(conn_handle);
+    pState->encrypted  = desc.sec_state.encrypted;
+} // updatePeerState
+
+
+/**
+ * @brief Remove the cached state of a disconnected peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ */
+void NimBLEServer::clearPeerState(uint16_t conn_handle) {
+    clearConnValues(conn_handle);
+
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    if(pState == nullptr) {
+        return;
+    }
+
+    dropQueuedIndicate(conn_handle);
+    clearIndicateWait(conn_handle);
+
+    // Queued notifications for this peer can no longer be sent, free them outside the critical section.
+    std::list<ble_notify_pending_t> dropped;
+    ble_npl_hw_enter_critical();
+    for(auto it = m_notifyPending.begin(); it != m_notifyPending.end();) {
+        if(it->connHandle == conn_handle) {
+            dropped.splice(dropped.end(), m_notifyPending, it++);
+        } else {
+            ++it;
+        }
+    }
+    pState->connHandle     = BLE_HS_CONN_HANDLE_NONE;
+    pState->notifyQueued   = 0;
+    pState->indicateQueued = 0;
+    pState->notifyServed   = false;
+    ble_npl_hw_exit_critical(0);
+
+    for(auto &it : dropped) {
+        for(auto &chr : m_notifyChrVec) {
+            if(chr->getHandle() == it.attrHandle) {
+                chr->m_pCallbacks->onStatus(chr, NimBLECharacteristicCallbacks::Status::ERROR_NO_CLIENT,
+                                            BLE_HS_ENOTCONN);
+                break;
+            }
+        }
+    }
+} // clearPeerState
+
+
+/**
+ * @brief Remove the values set for a disconnected peer with NimBLECharacteristic::setConnValue.
+ * @param [in] conn_handle The connection handle of the peer.
+ */
+void NimBLEServer::clearConnValues(uint16_t conn_handle) {
+    for(auto &chr : m_connValueChrVec) {
+        chr->clearConnValue(conn_handle);
+    }
+} // clearConnValues
+
+
+/**
+ * @brief Set the number of notifications that can wait to be sent to each peer
+ * when no buffers are available to send them.
+ * @param [in] depth The number of notifications per peer, 0 to not queue notifications (default).
+ * @details When the buffer pool is exhausted notifications are copied into the queue of the peer and sent
+ * in order from the host task once buffers are available again. While a peer has queued notifications
+ * new notifications to it are queued behind them. When the queue is full the notification is dropped
+ * and NimBLECharacteristicCallbacks::onStatus is called with ERROR_GATT and BLE_HS_ENOMEM.
+ */
+void NimBLEServer::setNotifyQueueDepth(uint8_t depth) {
+    m_notifyQueueDepth = depth;
+} // setNotifyQueueDepth
+
+
+/**
+ * @brief Get the number of notifications waiting to be sent to a peer.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @return The number of queued notifications, producers can use this to throttle.
+ */
+uint8_t NimBLEServer::getNotifyQueueCount(uint16_t conn_handle) {
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    return pState != nullptr ? pState->notifyQueued : 0;
+} // getNotifyQueueCount
+
+
+/**
+ * @brief Notify the current values of several characteristics at once.
+ * @details Each peer is sent the values of the characteristics it subscribed to for notifications.
+ * When the peer enabled Multiple Handle Value Notifications, the values are packed into as few
+ * ATT_MULTIPLE_HANDLE_VALUE_NTF PDUs as the MTU allows. This requires CONFIG_BT_NIMBLE_GATT_NOTIFY_MULTIPLE.
+ * Otherwise the notifications are sent back to back so they can share a connection event.
+ * A peer with notifications waiting in its queue has the values queued behind them.
+ * @param [in] chrs The characteristics to notify.
+ * @param [in] conn_handle The connection handle of the peer to notify, BLE_HS_CONN_HANDLE_NONE for all peers.
+ * @return True if every value was sent or queued.
+ */
+bool NimBLEServer::notifyMultiple(const std::vector<NimBLECharacteristic*> &chrs, uint16_t conn_handle) {
+    uint16_t targets[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t numTargets = 0;
+
+    for(auto chr : chrs) {
+        for(uint8_t i = 0; i < chr->m_subscribedCount; i++) {
+            uint16_t peer = chr->m_subscribed[i].first;
+            if(!(chr->m_subscribed[i].second & NIMBLE_SUB_NOTIFY) ||
+               (conn_handle != BLE_HS_CONN_HANDLE_NONE && peer != conn_handle) ||
+               std::find(targets, targets + numTargets, peer) != targets + numTargets) {
+                continue;
+            }
+            targets[numTargets++] = peer;
+        }
+    }
+
+    for(auto chr : chrs) {
+        chr->m_pCallbacks->onNotify(chr);
+    }
+
+    bool success = true;
+    std::vector<ble_gatt_notif> tuples;
+    tuples.reserve(chrs.size());
+
+    for(size_t t = 0; t < numTargets; t++) {
+        uint16_t peer = targets[t];
+        ble_peer_state_t* pPeer = getPeerState(peer);
+        if(pPeer == nullptr) {
+            updatePeerState(peer);
+            pPeer = getPeerState(peer);
+        }
+        if(pPeer == nullptr || pPeer->mtu == 0) {
+            continue;
+        }
+
+        bool queueBehind = getNotifyQueueCount(peer) > 0;
+        tuples.clear();
+
+        for(auto chr : chrs) {
+            bool reqSec = chr->m_properties & (BLE_GATT_CHR_F_READ_AUTHEN |
+                                               BLE_GATT_CHR_F_READ_AUTHOR |
+                                               BLE_GATT_CHR_F_READ_ENC);
+            uint16_t sub = 0;
+            for(uint8_t i = 0; i < chr->m_subscribedCount; i++) {
+                if(chr->m_subscribed[i].first == peer) {
+                    sub = chr->m_subscribed[i].second;
+                    break;
+                }
+            }
+            if(!(sub & NIMBLE_SUB_NOTIFY) || (reqSec && !pPeer->encrypted)) {
+                continue;
+            }
+
+            if(queueBehind) {
+                if(!queueNotify(peer, chr->getHandle(), chr->m_value.data(),
+                                chr->m_value.length(), chr->m_notifyCoalesce, chr->m_txPrio)) {
+                    NIMBLE_LOGE(LOG_TAG, "notifyMultiple: queue full, dropped for conn_handle=%d", peer);
+                    success = false;
+                }
+                continue;
+            }
+
+            os_mbuf* om = ble_hs_mbuf_from_flat(chr->m_value.data(), chr->m_value.length());
+            if(om == nullptr) {
+                NIMBLE_CPP_CONN_STATS_ADD(peer, mbufAllocFailures, 1);
+                success = false;
+                continue;
+            }
+            tuples.push_back({chr->getHandle(), om});
+            NIMBLE_CPP_CONN_STATS_ADD(peer, notifyTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(peer, notifyTxBytes, chr->m_value.length());
+        }
+
+        if(tuples.empty()) {
+            continue;
+        }
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+        int rc = 0;
+        for(auto &it : tuples) {
+            int txRc = ble_gattc_notify_custom(peer, it.handle, it.value);
+            if(txRc != 0 && rc == 0) {
+                rc = txRc;
+            }
+        }
+#else
+        int rc = ble_gattc_notify_multiple_custom(peer, tuples.size(), tuples.data());
+#endif
+        if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "notifyMultiple: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+            NIMBLE_CPP_CONN_STATS_ADD(peer, txFailures, 1);
+            success = false;
+        }
+    }
+
+    return success;
+} // notifyMultiple
+
+
+/**
+ * @brief Copy a notification into the queue of a peer to be sent when buffers are available.
+ * @param [in] conn_handle The connection handle of the peer.
+ * @param [in] attr_handle The handle of the characteristic value.
+ * @param [in] value A pointer to the notification data.
+ * @param [in] length The length of the data.
+ * @param [in] coalesce If true, replace the value of a notification already queued for the characteristic
+ * and peer instead of adding another, the queue depth is not applied in this case.
+ * @param [in] txPrio The transmit priority class of the notification.
+ * @return True if the notification was queued, false if the queue of the peer is full or queueing is disabled.
+ */
+bool NimBLEServer::queueNotify(uint16_t conn_handle, uint16_t attr_handle,
+                               const uint8_t* value, size_t length, bool coalesce, uint8_t txPrio)
+{
+    if(m_notifyQueueDepth == 0 && !coalesce) {
+        return false;
+    }
+
+    // Allocate the entry outside of the critical section and splice it in.
+    // When coalescing the values are swapped instead and the old value is freed with the entry.
+    std::list<ble_notify_pending_t> entry;
+    entry.push_back({conn_handle, attr_handle, std::vector<uint8_t>(value, value + length), txPrio,
+                     ble_npl_time_get()});
+
+    bool queued = false;
+    ble_npl_hw_enter_critical();
+    ble_peer_state_t* pState = getPeerState(conn_handle);
+    if(pState != nullptr && coalesce) {
+        for(auto &it : m_notifyPending) {
+            if(it.connHandle == conn_handle && it.attrHandle == attr_handle) {
+                it.value.swap(entry.front().value);
+                queued = true;
+                break;
+            }
+        }
+    }
+
+    if(pState != nullptr && !queued && (coalesce || pState->notifyQueued < m_notifyQueueDepth)) {
+        m_notifyPending.splice(m_notifyPending.end(), entry);
+        pState->notifyQueued++;
+        queued = true;
+    }
+    ble_npl_hw_exit_critical(0);
+
+    if(queued && !ble_npl_callout_is_active(&m_notifyRetryTimer)) {
+        ble_npl_callout_reset(&m_notifyRetryTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_NOTIFY_RETRY_MS));
+    }
+
+    return queued;
+} // queueNotify
+
+
+/**
+ * @brief Find the next queued notification to send, call with interrupts disabled.
+ * @details The peers are served in rounds: the oldest notification of each peer is sent before
+ * the next one of any peer, so a peer with a long queue does not delay the others.
+ * @return An iterator to the oldest notification of a peer not served in this round, or end() if none are queued.
+ */
+std::list<NimBLEServer::ble_notify_pending_t>::iterator NimBLEServer::nextQueuedNotify() {
+    for(int round = 0; round < 2; round++) {
+        for(auto it = m_notifyPending.begin(); it != m_notifyPending.end(); ++it) {
+            ble_peer_state_t* pState = getPeerState(it->connHandle);
+            if(pState == nullptr || !pState->notifyServed) {
+                return it;
+            }
+        }
+
+        // Every peer with notifications queued had its turn, start the next round.
+        for(auto &it : m_peerState) {
+            it.notifyServed = false;
+        }
+    }
+
+    return m_notifyPending.end();
+} // nextQueuedNotify
+
+
+/**
+ * @brief Send the queued notifications until no more buffers are available, called from the host task.
+ * @details The notifications of each peer are sent in order, the peers take turns.
+ */
+void NimBLEServer::sendQueuedNotify() {
+    for(;;) {
+        std::list<ble_notify_pending_t> entry;
+        ble_npl_hw_enter_critical();
+        auto next = nextQueuedNotify();
+        if(next != m_notifyPending.end()) {
+            entry.splice(entry.end(), m_notifyPending, next);
+        }
+        ble_npl_hw_exit_critical(0);
+
+        if(entry.empty()) {
+            return;
+        }
+
+        ble_notify_pending_t &pending = entry.front();
+        os_mbuf *om = ble_hs_mbuf_from_flat(pending.value.data(), pending.value.size());
+        if(om == nullptr) {
+            // Still no buffers, put it back at the front and try again later, it is still the oldest of its peer.
+            ble_npl_hw_enter_critical();
+            m_notifyPending.splice(m_notifyPending.begin(), entry);
+            ble_npl_hw_exit_critical(0);
+            ble_npl_callout_reset(&m_notifyRetryTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_NOTIFY_RETRY_MS));
+            return;
+        }
+        ble_hs_mbuf_set_tx_prio(om, pending.txPrio);
+
+        ble_npl_hw_enter_critical();
+        ble_peer_state_t* pState = getPeerState(pending.connHandle);
+        if(pState != nullptr) {
+            if(pState->notifyQueued > 0) {
+                pState->notifyQueued--;
+            }
+            pState->notifyServed = true;
+        }
+        ble_npl_hw_exit_critical(0);
+
+        // The notify tx event reports the result to the characteristic callbacks.
+        if(ble_gattc_notify_custom(pending.connHandle, pending.attrHandle, om) == 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, notifyTxPackets, 1);
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, notifyTxBytes, pending.value.size());
+            NIMBLE_CPP_CONN_STATS_MAX(pending.connHandle, notifyQueueMaxMs,
+                                      ble_npl_time_ticks_to_ms32(ble_npl_time_get() - pending.queuedAt));
+        } else {
+            NIMBLE_CPP_CONN_STATS_ADD(pending.connHandle, txFailures, 1);
+        }
+    }
+} // sendQueuedNotify
+
+
+/**
+ * @brief Called when the notify retry timer expires to send the queued notifications.
+ */
+/*STATIC*/
+void NimBLEServer::notifyRetryCb(ble_npl_event *event) {
+    NimBLEServer* pServer = (NimBLEServer*)ble_npl_event_get_arg(event);
+    pServer->sendQueuedNotify();
+    pServer->sendQueuedIndicate();
+} // notifyRetryCb
+
+
+/**
+ * @brief Arm the notify policy timer for when the policy of a characteristic next allows it to send.
+ * @param [in] pChr A pointer to the characteristic.
+ */
+void NimBLEServer::scheduleNotify(NimBLECharacteristic* pChr) {
+    NimBLECharacteristic::ble_notify_policy_state_t* pState = pChr->m_pNotifyPolicy;
+    ble_npl_time_t now = ble_npl_time_get();
+    ble_npl_time_t delay = 1;
+
+    if(pState->sent) {
+        ble_npl_time_t due = pState->lastTx + ble_npl_time_ms_to_ticks32(pState->policy.minIntervalMs);
+        if((ble_npl_stime_t)(due - now) > 1) {
+            delay = due - now;
+        }
+    }
+
+    ble_npl_hw_enter_critical();
+    bool arm = !ble_npl_callout_is_active(&m_notifyPolicyTimer) ||
+               ble_npl_callout_remaining_ticks(&m_notifyPolicyTimer, now) > delay;
+    ble_npl_hw_exit_critical(0);
+
+    if(arm) {
+        ble_npl_callout_reset(&m_notifyPolicyTimer, delay);
+    }
+} // scheduleNotify
+
+
+/**
+ * @brief Send the notifications the policies of the characteristics allow and arm the timer for the next one,
+ * called from the host task.
+ */
+void NimBLEServer::sendPolicyNotify() {
+    ble_npl_time_t now = ble_npl_time_get();
+    ble_npl_time_t next = 0;
+    bool pending = false;
+
+    for(auto &chr : m_notifyChrVec) {
+        NimBLECharacteristic::ble_notify_policy_state_t* pState = chr->m_pNotifyPolicy;
+        if(pState == nullptr) {
+            continue;
+        }
+
+        ble_npl_hw_enter_critical();
+        NimBLENotifyPolicy policy = pState->policy;
+        ble_npl_hw_exit_critical(0);
+        if(!policy.isEnabled()) {
+            continue;
+        }
+
+        ble_npl_time_t minTicks = ble_npl_time_ms_to_ticks32(policy.minIntervalMs);
+        ble_npl_time_t maxTicks = ble_npl_time_ms_to_ticks32(policy.maxIntervalMs);
+        ble_npl_time_t elapsed = now - pState->lastTx;
+        bool send = false;
+        NimBLEAttValue value;
+
+        // The flag is cleared before the value is copied so an update made meanwhile is sent later.
+        if(pState->dirty && (!pState->sent || elapsed >= minTicks)) {
+            pState->dirty = false;
+            value = chr->getValue();
+            send = !pState->sent || policy.isChange(pState->lastValue.data(), pState->lastValue.size(),
+                                                    value.data(), value.size());
+        }
+
+        if(!send && maxTicks > 0 && (!pState->sent || elapsed >= maxTicks)) {
+            value = chr->getValue();
+            send = true;
+        }
+
+        if(send) {
+            pState->lastValue.assign(value.data(), value.data() + value.size());
+            pState->lastTx = now;
+            pState->sent = true;
+            chr->sendNotify(value.data(), value.size(), true);
+        }
+
+        if(!pState->sent) {
+            continue;
+        }
+
+        // The next time the characteristic has to be looked at.
+        elapsed = now - pState->lastTx;
+        ble_npl_time_t wait = 0;
+        bool has = false;
+        if(pState->dirty) {
+            wait = elapsed < minTicks ? minTicks - elapsed : 0;
+            has = true;
+        }
+        if(maxTicks > 0) {
+            ble_npl_time_t heartbeat = elapsed < maxTicks ? maxTicks - elapsed : 0;
+            if(!has || heartbeat < wait) {
+                wait = heartbeat;
+            }
+            has = true;
+        }
+        if(has && (!pending || wait < next)) {
+            next = wait;
+            pending = true;
+        }
+    }
+
+    if(pending) {
+        ble_npl_callout_reset(&m_notifyPolicyTimer, next > 0 ? next : 1);
+    }
+} // sendPolicyNotify
+
+
+/**
+ * @brief Called when the notify policy timer expires.
+ */
+/*STATIC*/
+void NimBLEServer::notifyPolicyCb(ble_npl_event *event) {
+    NimBLEServer* pServer = (NimBLEServer*)ble_npl_event_get_arg(event);
+    pServer->sendPolicyNotify();
+} // notifyPolicyCb
 
 
 /** Default callback handlers */
@@ -896,6 +2066,10 @@ void NimBLEServerCallbacks::onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) {
     NIMBLE_LOGD("NimBLEServerCallbacks", "onMTUChange(): Default");
 } // onMTUChange
 
+void NimBLEServerCallbacks::onPhyUpdate(uint8_t txPhy, uint8_t rxPhy, ble_gap_conn_desc* desc) {
+    NIMBLE_LOGD("NimBLEServerCallbacks", "onPhyUpdate(): Default");
+} // onPhyUpdate
+
 uint32_t NimBLEServerCallbacks::onPassKeyRequest(){
     NIMBLE_LOGD("NimBLEServerCallbacks", "onPassKeyRequest: default: 123456");
     return 123456;
@@ -33,13 +33,59 @@
 #include "NimBLEService.h"
 #include "NimBLESecurity.h"
 #include "NimBLEConnInfo.h"
+#include "NimBLELinkProfile.h"
+#include "NimBLEPhyPolicy.h"
+#include "NimBLEPowerPolicy.h"
+#include "NimBLEConnParamsPolicy.h"
+#include "NimBLEAttIndex.h"
+#include "NimBLECallbackBinding.h"
 
+#include <list>
+
+#ifndef CONFIG_NIMBLE_CPP_INDICATE_QUEUE_DEPTH
+#    define CONFIG_NIMBLE_CPP_INDICATE_QUEUE_DEPTH 4
+#endif
 
 class NimBLEService;
 class NimBLECharacteristic;
 class NimBLEServerCallbacks;
 
 
+/**
+ * @brief Declare a characteristic in a static service table bound to a NimBLECharacteristic for its callbacks and value.
+ * @param uuid A ble_uuid16_t, ble_uuid32_t or ble_uuid128_t with static storage, e.g. `{BLE_UUID_TYPE_16, 0x2a19}`.
+ * @param chr A NimBLECharacteristic object with static storage.
+ * @param props The NIMBLE_PROPERTY flags of the characteristic.
+ * @param dscs A static array of descriptors declared with NIMBLE_STATIC_DSC ending with NIMBLE_STATIC_DSC_END,
+ * or nullptr for none. The client configuration descriptor is added by the stack for notify and indicate.
+ */
+#define NIMBLE_STATIC_CHR(uuid, chr, props, dscs) \
+    { &(uuid).u, NimBLECharacteristic::staticAccessCb(), &(chr), (struct ble_gatt_dsc_def*)(dscs), \
+      (ble_gatt_chr_flags)(props), 0, NimBLECharacteristic::staticValHandle(chr) }
+/** @brief Terminates a static characteristic array. */
+#define NIMBLE_STATIC_CHR_END { nullptr, nullptr, nullptr, nullptr, 0, 0, nullptr }
+
+/**
+ * @brief Declare a descriptor in a static descriptor array bound to a NimBLEDescriptor.
+ * @param uuid A ble_uuid16_t, ble_uuid32_t or ble_uuid128_t with static storage.
+ * @param dsc A NimBLEDescriptor object with static storage.
+ * @param attFlags The BLE_ATT_F_* access flags of the descriptor.
+ */
+#define NIMBLE_STATIC_DSC(uuid, dsc, attFlags) \
+    { &(uuid).u, (uint8_t)(attFlags), 0, NimBLEDescriptor::staticAccessCb(), &(dsc) }
+/** @brief Terminates a static descriptor array. */
+#define NIMBLE_STATIC_DSC_END { nullptr, 0, 0, nullptr, nullptr }
+
+/**
+ * @brief Declare a primary service in a static service table.
+ * @param uuid A ble_uuid16_t, ble_uuid32_t or ble_uuid128_t with static storage.
+ * @param chrs A static array of characteristics declared with NIMBLE_STATIC_CHR ending with NIMBLE_STATIC_CHR_END.
+ */
+#define NIMBLE_STATIC_SVC(uuid, chrs) { BLE_GATT_SVC_TYPE_PRIMARY, &(uuid).u, nullptr, (chrs) }
+/** @brief Terminates a static service table. */
+#define NIMBLE_STATIC_SVC_END { 0, nullptr, nullptr, nullptr }
+
+
 /**
  * @brief The model of a %BLE server.
  */
@@ -50,6 +96,7 @@ public:
     NimBLEService*         createService(const NimBLEUUID &uuid);
     void                   removeService(NimBLEService* service, bool deleteSvc = false);
     void                   addService(NimBLEService* service);
+    bool                   addStaticServices(const struct ble_gatt_svc_def* svcs);
     void                   setCallbacks(NimBLEServerCallbacks* pCallbacks,
                                         bool deleteCallbacks = true);
 #if CONFIG_BT_NIMBLE_EXT_ADV
@@ -74,7 +121,35 @@ public:
                                             uint16_t minInterval, uint16_t maxInterval,
                                             uint16_t latency, uint16_t timeout);
     void                   setDataLen(uint16_t conn_handle, uint16_t tx_octets);
+    void                   setLinkProfile(const NimBLELinkProfile &profile,
+                                          link_profile_callback callback = nullptr);
+    bool                   applyLinkProfile(uint16_t conn_handle, const NimBLELinkProfile &profile,
+                                            link_profile_callback callback = nullptr);
+    bool                   setPhy(uint16_t conn_handle, uint8_t txPhyMask, uint8_t rxPhyMask,
+                                  uint16_t phyOptions = 0);
+    bool                   getPhy(uint16_t conn_handle, uint8_t* txPhy, uint8_t* rxPhy);
+    void                   setPhyPolicy(const NimBLEPhyPolicy &policy);
+    void                   setPowerPolicy(const NimBLEPowerPolicy &policy);
+    void                   setConnParamsPolicy(const NimBLEConnParamsPolicy &policy);
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+#  if defined(CONFIG_BT_NIMBLE_ROLE_OBSERVER)
+    bool                   transferPeriodicSync(uint16_t conn_handle, uint16_t syncHandle,
+                                                uint16_t serviceData = 0);
+    bool                   receivePeriodicSync(uint16_t conn_handle, uint16_t skip = 0,
+                                               uint32_t timeoutMs = 10000);
+#  endif
+#  if defined(CONFIG_BT_NIMBLE_ROLE_BROADCASTER)
+    bool                   transferPeriodicAdvInfo(uint16_t conn_handle, uint8_t instId,
+                                                   uint16_t serviceData = 0);
+#  endif
+#endif
     uint16_t               getPeerMTU(uint16_t conn_id);
+    void                   setNotifyQueueDepth(uint8_t depth);
+    uint8_t                getNotifyQueueCount(uint16_t conn_handle);
+    bool                   notifyMultiple(const std::vector<NimBLECharacteristic*> &chrs,
+                                          uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE);
+    void                   setIndicateQueueDepth(uint8_t depth);
+    uint8_t                getIndicateQueueCount(uint16_t conn_handle);
     std::vector<uint16_t>  getPeerDevices();
     NimBLEConnInfo         getPeerInfo(size_t index);
     NimBLEConnInfo         getPeerInfo(const NimBLEAddress& address);
@@ -87,6 +162,7 @@ private:
     NimBLEServer();
     ~NimBLEServer();
     friend class           NimBLECharacteristic;
+    friend class           NimBLEClient;
     friend class           NimBLEService;
     friend class           NimBLEDevice;
     friend class           NimBLEAdvertising;
@@ -102,19 +178,85 @@ private:
     bool                   m_svcChanged;
     NimBLEServerCallbacks* m_pServerCallbacks;
     bool                   m_deleteCallbacks;
+    bool                   m_useLinkProfile;
+    NimBLELinkProfile      m_linkProfile;
+    link_profile_callback  m_linkProfileCb;
+    NimBLEPhyPolicy        m_phyPolicy;
+    NimBLEPowerPolicy      m_powerPolicy;
+    NimBLEConnParamsPolicy m_connParamsPolicy;
+    /**
+     * @brief The MTU and encryption state of a connected peer, kept up to date from GAP events
+     * so that sending notifications does not need to look up the connection.
+     */
+    typedef struct {
+        uint16_t           connHandle;
+        uint16_t           mtu;
+        bool               encrypted;
+        uint8_t            notifyQueued;
+        uint8_t            indicateQueued;
+        // Sent a queued notification in the current round over the peers.
+        bool               notifyServed;
+    } ble_peer_state_t;
+
+    /**
+     * @brief A notification waiting for an mbuf to be sent, or an indication waiting for
+     * the confirmation of the previous indication to the peer.
+     */
+    typedef struct {
+        uint16_t             connHandle;
+        uint16_t             attrHandle;
+        std::vector<uint8_t> value;
+        uint8_t              txPrio;
+        ble_npl_time_t       queuedAt;
+    } ble_notify_pending_t;
+
+    // The connections with an indication waiting for confirmation.
     uint16_t               m_indWait[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    ble_peer_state_t       m_peerState[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
     std::vector<uint16_t>  m_connectedPeersVec;
 
 //    uint16_t               m_svcChgChrHdl; // Future use
 
     std::vector<NimBLEService*> m_svcVec;
+    NimBLEAttIndex<NimBLEService> m_svcIndex;
+    std::vector<const ble_gatt_svc_def*> m_staticSvcVec;
     std::vector<NimBLECharacteristic*> m_notifyChrVec;
+    // The characteristics with values set for single connections.
+    std::vector<NimBLECharacteristic*> m_connValueChrVec;
+    std::list<ble_notify_pending_t> m_notifyPending;
+    uint8_t                m_notifyQueueDepth;
+    std::list<ble_notify_pending_t> m_indicatePending;
+    uint8_t                m_indicateQueueDepth;
+    ble_npl_callout        m_notifyRetryTimer;
+    ble_npl_callout        m_notifyPolicyTimer;
 
     static int             handleGapEvent(struct ble_gap_event *event, void *arg);
+    void                   injectPasskey(uint16_t connHandle, uint8_t action, uint32_t numcmp);
     void                   serviceChanged();
     void                   resetGATT();
+    uint16_t               getServiceEndHandle(NimBLEService* service);
+    bool                   registerStaticServices(const struct ble_gatt_svc_def* svcs);
     bool                   setIndicateWait(uint16_t conn_handle);
+    bool                   claimIndicateWait(uint16_t conn_handle);
     void                   clearIndicateWait(uint16_t conn_handle);
+    bool                   queueIndicate(uint16_t conn_handle, uint16_t attr_handle,
+                                         const uint8_t* value, size_t length,
+                                         uint8_t txPrio = BLE_HS_TX_PRIO_NORMAL);
+    void                   sendQueuedIndicate();
+    void                   dropQueuedIndicate(uint16_t conn_handle, uint16_t attr_handle = 0);
+    ble_peer_state_t*      getPeerState(uint16_t conn_handle);
+    void                   updatePeerState(uint16_t conn_handle);
+    void                   clearPeerState(uint16_t conn_handle);
+    void                   clearConnValues(uint16_t conn_handle);
+    bool                   queueNotify(uint16_t conn_handle, uint16_t attr_handle,
+                                       const uint8_t* value, size_t length, bool coalesce = false,
+                                       uint8_t txPrio = BLE_HS_TX_PRIO_NORMAL);
+    std::list<ble_notify_pending_t>::iterator nextQueuedNotify();
+    void                   sendQueuedNotify();
+    static void            notifyRetryCb(ble_npl_event *event);
+    void                   scheduleNotify(NimBLECharacteristic* pChr);
+    void                   sendPolicyNotify();
+    static void            notifyPolicyCb(ble_npl_event *event);
 }; // NimBLEServer
 
 
@@ -123,6 +265,18 @@ private:
  */
 class NimBLEServerCallbacks {
 public:
+    /** @brief The callbacks of a NimBLEBoundServerCallbacks class that are called. */
+    enum {
+        CB_ON_CONNECT         = 0x01, /**< onConnect(pServer) */
+        CB_ON_CONNECT_DESC    = 0x02, /**< onConnect(pServer, desc) */
+        CB_ON_DISCONNECT      = 0x04, /**< onDisconnect(pServer) */
+        CB_ON_DISCONNECT_DESC = 0x08, /**< onDisconnect(pServer, desc) */
+        CB_ON_MTU_CHANGE      = 0x10, /**< onMTUChange */
+        CB_ON_PHY_UPDATE      = 0x20, /**< onPhyUpdate */
+        CB_ALL                = 0xFF
+    };
+
+    NimBLEServerCallbacks() : m_callbacks(CB_ALL) {}
     virtual ~NimBLEServerCallbacks() {};
 
     /**
@@ -165,6 +319,15 @@ public:
      */
     virtual void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc);
 
+    /**
+     * @brief Called when the PHY of a connection changes.
+     * @param [in] txPhy The transmit PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+     * @param [in] rxPhy The receive PHY, BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M or BLE_HCI_LE_PHY_CODED.
+     * @param [in] desc A pointer to the connection description structure containing information
+     * about the connection.
+     */
+    virtual void onPhyUpdate(uint8_t txPhy, uint8_t rxPhy, ble_gap_conn_desc* desc);
+
     /**
      * @brief Called when a client requests a passkey for pairing.
      * @return The passkey to be sent to the client.
@@ -187,7 +350,46 @@ public:
      * @return True to accept the pin.
      */
     virtual bool onConfirmPIN(uint32_t pin);
+
+protected:
+    explicit NimBLEServerCallbacks(uint8_t callbacks) : m_callbacks(callbacks) {}
+
+private:
+    friend class NimBLEServer;
+    friend class NimBLEDevice;
+
+    uint8_t m_callbacks;
 }; // NimBLEServerCallbacks
 
+
+/**
+ * @brief Server callbacks bound at compile time, only the callbacks T overrides are called.
+ * @details Derive the callbacks class from this template with itself as T instead of from NimBLEServerCallbacks,
+ * e.g. `class MyCallbacks : public NimBLEBoundServerCallbacks<MyCallbacks>`. The overload of onConnect and
+ * onDisconnect that is not implemented is not called and the connection is not looked up for the events
+ * without a callback. The passkey and authentication callbacks are always called. The callbacks of T must be public.
+ */
+template<class T>
+class NimBLEBoundServerCallbacks : public NimBLEServerCallbacks {
+public:
+    NimBLEBoundServerCallbacks() : NimBLEServerCallbacks(callbacks()) {
+        static_assert(callbacks() != 0, "No public callbacks found, declare the overrides public");
+    }
+
+    /** @brief The CB_ON_* bits of the callbacks T overrides. */
+    static constexpr uint8_t callbacks() {
+        typedef NimBLEServerCallbacks B;
+        return NIMBLE_CPP_CALLBACK_BIT(T, B, onConnect, void(NimBLEServer*), CB_ON_CONNECT) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onConnect, void(NimBLEServer*, ble_gap_conn_desc*),
+                                       CB_ON_CONNECT_DESC) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onDisconnect, void(NimBLEServer*), CB_ON_DISCONNECT) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onDisconnect, void(NimBLEServer*, ble_gap_conn_desc*),
+                                       CB_ON_DISCONNECT_DESC) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onMTUChange, void(uint16_t, ble_gap_conn_desc*), CB_ON_MTU_CHANGE) |
+               NIMBLE_CPP_CALLBACK_BIT(T, B, onPhyUpdate, void(uint8_t, uint8_t, ble_gap_conn_desc*),
+                                       CB_ON_PHY_UPDATE);
+    }
+}; // NimBLEBoundServerCallbacks
+
 #endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
 #endif /* MAIN_NIMBLESERVER_H_ */
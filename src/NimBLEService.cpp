@@ -70,13 +70,32 @@ NimBLEService::~NimBLEService() {
     }
 }
 
+
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+/**
+ * @brief Allocate a service from the server arena.
+ * @details Falls back to the heap if the arena is full.
+ */
+void* NimBLEService::operator new(size_t size) {
+    return NimBLEArena::server().alloc(size);
+} // operator new
+
+
+/**
+ * @brief Return a service to the server arena, or the heap if it was not allocated from the arena.
+ */
+void NimBLEService::operator delete(void* ptr) {
+    NimBLEArena::server().free(ptr);
+} // operator delete
+#endif
+
 /**
  * @brief Dump details of this BLE GATT service.
  * @return N/A.
  */
 void NimBLEService::dump() {
     NIMBLE_LOGD(LOG_TAG, "Service: uuid:%s, handle: 0x%2x",
-        m_uuid.toString().c_str(),
+        NIMBLE_CPP_STR(m_uuid),
         m_handle);
 
     std::string res;
@@ -141,6 +160,7 @@ bool NimBLEService::start() {
                 if ((*it)->m_removed == NIMBLE_ATT_REMOVE_DELETE) {
                     delete *it;
                     it = m_chrVec.erase(it);
+                    m_chrIndex.clear();
                 } else {
                     ++removedCount;
                     ++it;
@@ -173,6 +193,7 @@ bool NimBLEService::start() {
                         if ((*it)->m_removed == NIMBLE_ATT_REMOVE_DELETE) {
                             delete *it;
                             it = (*chr_it)->m_dscVec.erase(it);
+                            (*chr_it)->m_dscIndex.clear();
                         } else {
                             ++removedCount;
                             ++it;
@@ -276,7 +297,7 @@ NimBLECharacteristic* NimBLEService::createCharacteristic(const NimBLEUUID &uuid
 
     if (getCharacteristic(uuid) != nullptr) {
         NIMBLE_LOGD(LOG_TAG, "<< Adding a duplicate characteristic with UUID: %s",
-                             std::string(uuid).c_str());
+                             NIMBLE_CPP_STR(uuid));
     }
 
     addCharacteristic(pCharacteristic);
@@ -302,6 +323,7 @@ void NimBLEService::addCharacteristic(NimBLECharacteristic* pCharacteristic) {
 
     if(!foundRemoved) {
         m_chrVec.push_back(pCharacteristic);
+        m_chrIndex.clear();
     }
 
     pCharacteristic->setService(this);
@@ -322,8 +344,9 @@ void NimBLEService::removeCharacteristic(NimBLECharacteristic* pCharacteristic,
         if(deleteChr) {
             for(auto it = m_chrVec.begin(); it != m_chrVec.end(); ++it) {
                 if ((*it) == pCharacteristic) {
-                    m_chrVec.erase(it);
                     delete *it;
+                    m_chrVec.erase(it);
+                    m_chrIndex.clear();
                     break;
                 }
             }
@@ -354,6 +377,10 @@ NimBLECharacteristic* NimBLEService::getCharacteristic(const char* uuid, uint16_
  * @return A pointer to the characteristic object or nullptr if not found.
  */
 NimBLECharacteristic* NimBLEService::getCharacteristic(const NimBLEUUID &uuid, uint16_t instanceId) {
+    if(m_chrIndex.isBuilt()) {
+        return m_chrIndex.getByUUID(uuid, instanceId);
+    }
+
     uint16_t position = 0;
     for (auto &it : m_chrVec) {
         if (it->getUUID() == uuid) {
@@ -372,6 +399,10 @@ NimBLECharacteristic* NimBLEService::getCharacteristic(const NimBLEUUID &uuid, u
  * @return A pointer to the characteristic object or nullptr if not found.
  */
 NimBLECharacteristic *NimBLEService::getCharacteristicByHandle(uint16_t handle) {
+    if(m_chrIndex.isBuilt()) {
+        return m_chrIndex.getByHandle(handle);
+    }
+
     for (auto &it : m_chrVec) {
         if (it->getHandle() == handle) {
             return it;
@@ -19,8 +19,10 @@
 #if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
 
 #include "NimBLEServer.h"
+#include "NimBLEArena.h"
 #include "NimBLECharacteristic.h"
 #include "NimBLEUUID.h"
+#include "NimBLEAttIndex.h"
 
 
 class NimBLEServer;
@@ -33,6 +35,10 @@ class NimBLECharacteristic;
  */
 class NimBLEService {
 public:
+#if CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE > 0
+    static void*    operator new(size_t size);
+    static void     operator delete(void* ptr);
+#endif
 
     NimBLEService(const char* uuid);
     NimBLEService(const NimBLEUUID &uuid);
@@ -80,6 +86,7 @@ private:
     ble_gatt_svc_def*     m_pSvcDef;
     uint8_t               m_removed;
     std::vector<NimBLECharacteristic*> m_chrVec;
+    NimBLEAttIndex<NimBLECharacteristic> m_chrIndex;
 
 }; // NimBLEService
 
@@ -0,0 +1,166 @@
+/*
+ * NimBLEStackProfile.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#include "NimBLEStackProfile.h"
+#if defined(CONFIG_BT_ENABLED) && CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#include <string.h>
+
+static const char* LOG_TAG = "NimBLEStackProfile";
+
+static const char* const pointNames[NimBLEStackProfile::POINT_COUNT] = {
+    "NimBLEServer::handleGapEvent",
+    "NimBLEClient::handleGapEvent",
+    "NimBLEScan::handleGapEvent",
+    "NimBLECharacteristic::handleGapEvent",
+    "NimBLEDescriptor::handleGapEvent",
+};
+
+TaskHandle_t NimBLEStackProfile::m_hostTask = nullptr;
+uint32_t     NimBLEStackProfile::m_pointUsed[NimBLEStackProfile::POINT_COUNT] = {0};
+uint32_t     NimBLEStackProfile::m_gapEventUsed[NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS] = {0};
+
+
+/**
+ * @brief Get the high water mark of the host task stack in bytes, only valid in the host task.
+ */
+uint32_t NimBLEStackProfile::getHwm() {
+    return uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t);
+} // getHwm
+
+
+/**
+ * @brief Start profiling an entry point.
+ * @param [in] point The entry point that was called.
+ * @param [in] eventType The GAP event type handled, or -1 if the call is not for a GAP event.
+ */
+NimBLEStackProfile::Scope::Scope(point_t point, int eventType)
+: m_point(point), m_eventType(eventType), m_hwm(0) {
+    if(m_hostTask != nullptr && xTaskGetCurrentTaskHandle() == m_hostTask) {
+        m_hwm = getHwm();
+    }
+} // Scope
+
+
+/**
+ * @brief Record the stack usage if the high water mark dropped while the entry point ran.
+ */
+NimBLEStackProfile::Scope::~Scope() {
+    if(m_hwm == 0) {
+        return;
+    }
+
+    uint32_t hwm = getHwm();
+    if(hwm >= m_hwm) {
+        return;
+    }
+
+    uint32_t used = CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE - hwm;
+    if(used > m_pointUsed[m_point]) {
+        m_pointUsed[m_point] = used;
+    }
+
+    if(m_eventType >= 0 && m_eventType < NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS &&
+       used > m_gapEventUsed[m_eventType])
+    {
+        m_gapEventUsed[m_eventType] = used;
+    }
+} // ~Scope
+
+
+/**
+ * @brief Clear the usage recorded for the entry points and events.
+ * @details The high water mark of the task cannot be reset, so only deeper usage is recorded after this.
+ */
+void NimBLEStackProfile::reset() {
+    memset(m_pointUsed, 0, sizeof(m_pointUsed));
+    memset(m_gapEventUsed, 0, sizeof(m_gapEventUsed));
+} // reset
+
+
+/**
+ * @brief Get the deepest stack usage recorded for an entry point.
+ * @param [in] point The entry point.
+ * @return The number of bytes of the host task stack used, 0 if none was recorded.
+ */
+uint32_t NimBLEStackProfile::getUsed(point_t point) {
+    if(point >= POINT_COUNT) {
+        return 0;
+    }
+    return m_pointUsed[point];
+} // getUsed
+
+
+/**
+ * @brief Get the deepest stack usage recorded while handling a GAP event type.
+ * @param [in] eventType The BLE_GAP_EVENT_* type.
+ * @return The number of bytes of the host task stack used, 0 if none was recorded.
+ */
+uint32_t NimBLEStackProfile::getGapEventUsed(uint8_t eventType) {
+    if(eventType >= NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS) {
+        return 0;
+    }
+    return m_gapEventUsed[eventType];
+} // getGapEventUsed
+
+
+/**
+ * @brief Get the deepest usage of the host task stack since the task started.
+ * @return The number of bytes used, 0 if the host task is not running.
+ */
+uint32_t NimBLEStackProfile::getHostStackUsed() {
+    if(m_hostTask == nullptr) {
+        return 0;
+    }
+    return CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE -
+           uxTaskGetStackHighWaterMark(m_hostTask) * sizeof(StackType_t);
+} // getHostStackUsed
+
+
+/**
+ * @brief Get a value for CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE from the deepest usage so far.
+ * @return The usage with a 25% margin rounded up to 256 bytes, 0 if the host task is not running.
+ * @details Only paths that have run are measured, run all of the application use cases before reading this.
+ */
+uint32_t NimBLEStackProfile::getRecommendedStackSize() {
+    uint32_t used = getHostStackUsed();
+    if(used == 0) {
+        return 0;
+    }
+    used += used / 4;
+    return (used + 255) & ~255UL;
+} // getRecommendedStackSize
+
+
+/**
+ * @brief Log the stack usage recorded and the recommended host task stack size.
+ */
+void NimBLEStackProfile::dump() {
+    NIMBLE_LOGI(LOG_TAG, "Host task stack: size %u, used %u, recommended %u",
+                (unsigned)CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE,
+                (unsigned)getHostStackUsed(),
+                (unsigned)getRecommendedStackSize());
+
+    for(int i = 0; i < POINT_COUNT; i++) {
+        if(m_pointUsed[i] > 0) {
+            NIMBLE_LOGI(LOG_TAG, "- %s: %u", pointNames[i], (unsigned)m_pointUsed[i]);
+        }
+    }
+
+    for(int i = 0; i < NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS; i++) {
+        if(m_gapEventUsed[i] > 0) {
+            NIMBLE_LOGI(LOG_TAG, "- %s: %u", NimBLEUtils::gapEventToString(i), (unsigned)m_gapEventUsed[i]);
+        }
+    }
+} // dump
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE */
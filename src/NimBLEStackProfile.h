@@ -0,0 +1,91 @@
+/*
+ * NimBLEStackProfile.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLESTACKPROFILE_H_
+#define NIMBLESTACKPROFILE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#ifndef CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+#    define CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE 0
+#endif
+
+#if CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_npl.h"
+#else
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+#endif
+
+#include <stdint.h>
+
+/** @brief The number of GAP event types the stack usage is recorded for. */
+#define NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS 32
+
+/**
+ * @brief Records the deepest host task stack usage of the library callback entry points.
+ * @details When an entry point returns the high water mark of the host task stack is compared with the
+ * mark when it was entered, if it dropped the usage is recorded for the entry point and the GAP event type.
+ * Only new low marks are attributed, so the values per entry point and event are lower bounds
+ * while getHostStackUsed() is the deepest usage of the host task since it started.\n
+ * Reading the high water mark scans the stack, enable this only while sizing the stack.
+ */
+class NimBLEStackProfile {
+public:
+    /** @brief The callback entry points that are profiled. */
+    enum point_t {
+        SERVER_GAP_EVENT,
+        CLIENT_GAP_EVENT,
+        SCAN_GAP_EVENT,
+        CHR_ACCESS,
+        DSC_ACCESS,
+        POINT_COUNT
+    };
+
+    static void             reset();
+    static uint32_t         getUsed(point_t point);
+    static uint32_t         getGapEventUsed(uint8_t eventType);
+    static uint32_t         getHostStackUsed();
+    static uint32_t         getRecommendedStackSize();
+    static void             dump();
+
+    /**
+     * @brief Records the stack usage of an entry point when it goes out of scope.
+     */
+    class Scope {
+    public:
+        Scope(point_t point, int eventType = -1);
+        ~Scope();
+
+    private:
+        point_t             m_point;
+        int                 m_eventType;
+        uint32_t            m_hwm;
+    }; // Scope
+
+private:
+    friend class NimBLEDevice;
+
+    static uint32_t         getHwm();
+
+    static TaskHandle_t     m_hostTask;
+    static uint32_t         m_pointUsed[POINT_COUNT];
+    static uint32_t         m_gapEventUsed[NIMBLE_CPP_STACK_PROFILE_GAP_EVENTS];
+}; // NimBLEStackProfile
+
+#define NIMBLE_CPP_STACK_PROFILE(point, eventType) \
+    NimBLEStackProfile::Scope stackProfileScope(NimBLEStackProfile::point, eventType)
+
+#else
+#define NIMBLE_CPP_STACK_PROFILE(point, eventType)
+#endif /* CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE */
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* NIMBLESTACKPROFILE_H_ */
@@ -0,0 +1,207 @@
+/*
+ * NimBLETrace.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#include "NimBLETrace.h"
+#if defined(CONFIG_BT_ENABLED) && MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+
+#include "NimBLELog.h"
+
+static const char* LOG_TAG = "NimBLETrace";
+
+
+/**
+ * @brief Get the entries in the trace, oldest first.
+ * @return A vector of up to CONFIG_BT_NIMBLE_TRACE_SIZE entries.
+ */
+std::vector<ble_hs_trace_entry> NimBLETrace::getEntries() {
+    std::vector<ble_hs_trace_entry> entries(MYNEWT_VAL(BLE_HS_TRACE_SIZE));
+    int count = ble_hs_trace_read(entries.data(), entries.size());
+    entries.resize(count);
+    return entries;
+} // getEntries
+
+
+/**
+ * @brief Get the number of entries recorded since the trace was cleared.
+ * @return The count, including the entries that have been overwritten.
+ */
+uint32_t NimBLETrace::getCount() {
+    return ble_hs_trace_count();
+} // getCount
+
+
+/**
+ * @brief Remove all entries from the trace.
+ */
+void NimBLETrace::clear() {
+    ble_hs_trace_clear();
+} // clear
+
+
+/**
+ * @brief Get the name of a trace entry type.
+ * @param [in] type The BLE_HS_TRACE_* type.
+ */
+const char* NimBLETrace::typeToString(uint8_t type) {
+    switch(type) {
+        case BLE_HS_TRACE_ATT_RX:
+            return "ATT_RX";
+        case BLE_HS_TRACE_ATT_TX:
+            return "ATT_TX";
+        case BLE_HS_TRACE_MBUF_FAIL:
+            return "MBUF_FAIL";
+        case BLE_HS_TRACE_SERVER_GAP:
+            return "SERVER_GAP";
+        case BLE_HS_TRACE_CLIENT_GAP:
+            return "CLIENT_GAP";
+        case BLE_HS_TRACE_SCAN_GAP:
+            return "SCAN_GAP";
+        case BLE_HS_TRACE_CHR_ACCESS:
+            return "CHR_ACCESS";
+        case BLE_HS_TRACE_DSC_ACCESS:
+            return "DSC_ACCESS";
+        default:
+            return type >= BLE_HS_TRACE_USER ? "USER" : "UNKNOWN";
+    }
+} // typeToString
+
+
+/**
+ * @brief Log the entries in the trace with the time since the previous entry.
+ * @details The log output is formatted after the entries are copied, so it does not affect them.
+ */
+void NimBLETrace::dump() {
+#if CONFIG_NIMBLE_CPP_LOG_LEVEL >= 3
+    uint32_t total = getCount();
+    std::vector<ble_hs_trace_entry> entries = getEntries();
+
+    NIMBLE_LOGI(LOG_TAG, "Trace: %u entries, %u overwritten",
+                (unsigned)entries.size(), (unsigned)(total - entries.size()));
+
+    uint32_t prevTime = entries.empty() ? 0 : entries.front().time_us;
+    for(auto &it : entries) {
+        NIMBLE_LOGI(LOG_TAG, "%10u +%8u %-10s code %3u conn %5u attr %5u len %4u rc %d",
+                    (unsigned)it.time_us, (unsigned)(it.time_us - prevTime),
+                    typeToString(it.type), it.code, it.conn_handle,
+                    it.attr_handle, it.len, it.rc);
+        prevTime = it.time_us;
+    }
+#endif
+} // dump
+
+
+/**
+ * @brief Add an entry to the trace, types from BLE_HS_TRACE_USER up are free for the application.
+ * @param [in] type The entry type.
+ * @param [in] code The event code.
+ * @param [in] connHandle The connection handle or BLE_HS_CONN_HANDLE_NONE.
+ * @param [in] attrHandle The attribute handle.
+ * @param [in] length The length of the data.
+ * @param [in] rc The status.
+ */
+void NimBLETrace::record(uint8_t type, uint8_t code, uint16_t connHandle,
+                         uint16_t attrHandle, uint16_t length, int rc)
+{
+    ble_hs_trace_record(type, code, connHandle, attrHandle, length, rc);
+} // record
+
+
+/**
+ * @brief Record a GAP event received by a handleGapEvent function.
+ * @param [in] type The BLE_HS_TRACE_* type of the handler.
+ * @param [in] event The event, the connection, attribute, length and status are taken from it where available.
+ */
+void NimBLETrace::recordGapEvent(uint8_t type, const ble_gap_event* event) {
+    uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE;
+    uint16_t attrHandle = 0;
+    uint16_t length = 0;
+    int rc = 0;
+
+    switch(event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            connHandle = event->connect.conn_handle;
+            rc = event->connect.status;
+            break;
+        case BLE_GAP_EVENT_DISCONNECT:
+            connHandle = event->disconnect.conn.conn_handle;
+            rc = event->disconnect.reason;
+            break;
+        case BLE_GAP_EVENT_CONN_UPDATE:
+            connHandle = event->conn_update.conn_handle;
+            rc = event->conn_update.status;
+            break;
+        case BLE_GAP_EVENT_CONN_UPDATE_REQ:
+        case BLE_GAP_EVENT_L2CAP_UPDATE_REQ:
+            connHandle = event->conn_update_req.conn_handle;
+            break;
+        case BLE_GAP_EVENT_ENC_CHANGE:
+            connHandle = event->enc_change.conn_handle;
+            rc = event->enc_change.status;
+            break;
+        case BLE_GAP_EVENT_PASSKEY_ACTION:
+            connHandle = event->passkey.conn_handle;
+            break;
+        case BLE_GAP_EVENT_NOTIFY_RX:
+            connHandle = event->notify_rx.conn_handle;
+            attrHandle = event->notify_rx.attr_handle;
+            length = OS_MBUF_PKTLEN(event->notify_rx.om);
+            break;
+        case BLE_GAP_EVENT_NOTIFY_TX:
+            connHandle = event->notify_tx.conn_handle;
+            attrHandle = event->notify_tx.attr_handle;
+            rc = event->notify_tx.status;
+            break;
+        case BLE_GAP_EVENT_SUBSCRIBE:
+            connHandle = event->subscribe.conn_handle;
+            attrHandle = event->subscribe.attr_handle;
+            break;
+        case BLE_GAP_EVENT_MTU:
+            connHandle = event->mtu.conn_handle;
+            length = event->mtu.value;
+            break;
+        case BLE_GAP_EVENT_DISC:
+            length = event->disc.length_data;
+            break;
+        case BLE_GAP_EVENT_DISC_COMPLETE:
+            rc = event->disc_complete.reason;
+            break;
+        case BLE_GAP_EVENT_ADV_COMPLETE:
+            rc = event->adv_complete.reason;
+            break;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+        case BLE_GAP_EVENT_EXT_DISC:
+            length = event->ext_disc.length_data;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    ble_hs_trace_record(type, event->type, connHandle, attrHandle, length, rc);
+} // recordGapEvent
+
+
+/**
+ * @brief Record a GATT access to a local attribute.
+ * @param [in] type The BLE_HS_TRACE_* type of the handler.
+ * @param [in] connHandle The connection handle of the peer.
+ * @param [in] attrHandle The handle of the attribute accessed.
+ * @param [in] ctxt The access context, the op is recorded as the code and the length of the written data.
+ */
+void NimBLETrace::recordAccess(uint8_t type, uint16_t connHandle, uint16_t attrHandle,
+                               const ble_gatt_access_ctxt* ctxt)
+{
+    uint16_t length = 0;
+    if(ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR || ctxt->op == BLE_GATT_ACCESS_OP_WRITE_DSC) {
+        length = OS_MBUF_PKTLEN(ctxt->om);
+    }
+    ble_hs_trace_record(type, ctxt->op, connHandle, attrHandle, length, 0);
+} // recordAccess
+
+#endif /* CONFIG_BT_ENABLED && MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0 */
@@ -0,0 +1,65 @@
+/*
+ * NimBLETrace.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLETRACE_H_
+#define NIMBLETRACE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+
+#include <vector>
+
+/**
+ * @brief Access to the binary event trace of the host and the library.
+ * @details Enabled by setting CONFIG_BT_NIMBLE_TRACE_SIZE to the number of entries to keep.
+ * ATT PDUs sent and received, mbuf allocation failures and the events handled by the server,
+ * clients, scanner, characteristics and descriptors are recorded with a microsecond timestamp
+ * in a ring buffer, the oldest entries are overwritten when it is full.
+ * Recording does no formatting, so it can be left enabled to analyze latency in the field.
+ */
+class NimBLETrace {
+public:
+    static std::vector<ble_hs_trace_entry> getEntries();
+    static uint32_t                        getCount();
+    static void                            clear();
+    static void                            dump();
+    static const char*                     typeToString(uint8_t type);
+    static void                            record(uint8_t type, uint8_t code, uint16_t connHandle,
+                                                  uint16_t attrHandle = 0, uint16_t length = 0,
+                                                  int rc = 0);
+    static void                            recordGapEvent(uint8_t type, const ble_gap_event* event);
+    static void                            recordAccess(uint8_t type, uint16_t connHandle,
+                                                        uint16_t attrHandle,
+                                                        const ble_gatt_access_ctxt* ctxt);
+}; // NimBLETrace
+
+#define NIMBLE_CPP_TRACE_GAP(type, event) \
+    NimBLETrace::recordGapEvent(BLE_HS_TRACE_##type, event)
+#define NIMBLE_CPP_TRACE_ACCESS(type, connHandle, attrHandle, ctxt) \
+    NimBLETrace::recordAccess(BLE_HS_TRACE_##type, connHandle, attrHandle, ctxt)
+
+#else
+#define NIMBLE_CPP_TRACE_GAP(type, event)
+#define NIMBLE_CPP_TRACE_ACCESS(type, connHandle, attrHandle, ctxt)
+#endif /* MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0 */
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* NIMBLETRACE_H_ */
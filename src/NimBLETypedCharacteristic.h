@@ -0,0 +1,134 @@
+/*
+ * NimBLETypedCharacteristic.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef MAIN_NIMBLETYPEDCHARACTERISTIC_H_
+#define MAIN_NIMBLETYPEDCHARACTERISTIC_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+#include "NimBLECharacteristic.h"
+
+#include <type_traits>
+#include <algorithm>
+#include <string.h>
+
+/**
+ * @brief A characteristic that stores its value as a <type\> instead of a byte buffer.
+ * @tparam T A trivially copyable type, arithmetic types are sent in little endian byte order.
+ * @details The value is only converted to bytes when it is read, notified or written, the
+ * size is known at compile time so no length checks are made when reading.\n
+ * Create with `new NimBLETypedCharacteristic<T>(uuid, properties)` and add it to a service with
+ * NimBLEService::addCharacteristic(). Use get() and set() instead of getValue() and setValue().
+ */
+template<typename T>
+class NimBLETypedCharacteristic : public NimBLECharacteristic {
+    static_assert(std::is_trivially_copyable<T>::value, "NimBLETypedCharacteristic requires a trivially copyable type");
+    static_assert(sizeof(T) <= BLE_ATT_ATTR_MAX_LEN, "NimBLETypedCharacteristic type is larger than 512 bytes");
+
+public:
+    NimBLETypedCharacteristic(const NimBLEUUID &uuid,
+                              uint16_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                              const T &value = T())
+    : NimBLECharacteristic(uuid, properties, sizeof(T)), m_typedValue(value) {}
+
+    NimBLETypedCharacteristic(const char* uuid,
+                              uint16_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                              const T &value = T())
+    : NimBLETypedCharacteristic(NimBLEUUID(uuid), properties, value) {}
+
+    /** @brief Get a copy of the value. */
+    T get() const {
+        T res;
+        ble_npl_hw_enter_critical();
+        res = m_typedValue;
+        ble_npl_hw_exit_critical(0);
+        return res;
+    }
+
+    /**
+     * @brief Set the value.
+     * @param [in] value The value to set.
+     */
+    void set(const T &value) {
+        ble_npl_hw_enter_critical();
+        m_typedValue = value;
+        ble_npl_hw_exit_critical(0);
+    }
+
+    using NimBLECharacteristic::notify;
+    using NimBLECharacteristic::indicate;
+
+    /**
+     * @brief Send a notification or indication of the value.
+     * @param [in] is_notification if true sends a notification, false sends an indication.
+     */
+    void notify(bool is_notification = true) {
+        uint8_t buf[sizeof(T)];
+        toBytes(buf);
+        NimBLECharacteristic::notify(buf, sizeof(T), is_notification);
+    }
+
+    /** @brief Send an indication of the value. */
+    void indicate() {
+        notify(false);
+    }
+
+protected:
+    int readValueInto(struct os_mbuf *om, bool newRead, uint16_t mtu) override {
+        uint8_t buf[sizeof(T)];
+        toBytes(buf);
+        return os_mbuf_append(om, buf, sizeof(T)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    int writeValueFrom(const struct os_mbuf *om) override {
+        if(OS_MBUF_PKTLEN(om) != sizeof(T)) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+
+        uint8_t buf[sizeof(T)];
+        if(os_mbuf_copydata(om, 0, sizeof(T), buf) != 0) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+
+        T value;
+        fromBytes(buf, value);
+        set(value);
+        return 0;
+    }
+
+private:
+    /** @brief True if the bytes must be reversed to be in the little endian order of BLE. */
+    static constexpr bool swapBytes() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return std::is_arithmetic<T>::value;
+#else
+        return false;
+#endif
+    }
+
+    void toBytes(uint8_t *buf) const {
+        T value = get();
+        memcpy(buf, &value, sizeof(T));
+        if(swapBytes()) {
+            std::reverse(buf, buf + sizeof(T));
+        }
+    }
+
+    static void fromBytes(uint8_t *buf, T &value) {
+        if(swapBytes()) {
+            std::reverse(buf, buf + sizeof(T));
+        }
+        memcpy(&value, buf, sizeof(T));
+    }
+
+    T m_typedValue;
+}; // NimBLETypedCharacteristic
+
+#endif /* CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+#endif /* MAIN_NIMBLETYPEDCHARACTERISTIC_H_ */
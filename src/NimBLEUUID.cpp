@@ -41,33 +41,8 @@ static const char* LOG_TAG = "NimBLEUUID";
  *
  * @param [in] value The string to build a UUID from.
  */
- NimBLEUUID::NimBLEUUID(const std::string &value) {
-    m_valueSet = true;
-    if (value.length() == 4) {
-        m_uuid.u.type         = BLE_UUID_TYPE_16;
-        m_uuid.u16.value = strtoul(value.c_str(), NULL, 16);
-    }
-    else if (value.length() == 8) {
-        m_uuid.u.type         = BLE_UUID_TYPE_32;
-        m_uuid.u32.value = strtoul(value.c_str(), NULL, 16);
-    }
-    else if (value.length() == 16) {
-        *this = NimBLEUUID((uint8_t*)value.data(), 16, true);
-    }
-    else if (value.length() == 36) {
-        // If the length of the string is 36 bytes then we will assume it is a long hex string in
-        // UUID format.
-        char * position = const_cast<char *>(value.c_str());
-        uint32_t first =    strtoul(position, &position, 16);
-        uint16_t second =   strtoul(position + 1, &position, 16);
-        uint16_t third =    strtoul(position + 1, &position, 16);
-        uint16_t fourth =   strtoul(position + 1, &position, 16);
-        uint64_t fifth =    strtoull(position + 1, NULL, 16);
-        *this = NimBLEUUID(first, second, third, (uint64_t(fourth) << 48) + fifth);
-    }
-    else {
-        m_valueSet = false;
-    }
+NimBLEUUID::NimBLEUUID(const std::string &value)
+: NimBLEUUID(parse(value.data(), value.length())) {
 } // NimBLEUUID(std::string)
 
 
@@ -77,7 +52,8 @@ static const char* LOG_TAG = "NimBLEUUID";
  * @param [in] size The size of the data.
  * @param [in] msbFirst Is the MSB first in pData memory?
  */
-NimBLEUUID::NimBLEUUID(const uint8_t* pData, size_t size, bool msbFirst) {
+NimBLEUUID::NimBLEUUID(const uint8_t* pData, size_t size, bool msbFirst)
+: m_hash(0), m_valueSet(false), m_onBase(false) {
     uint8_t *uuidValue = nullptr;
 
     switch(size) {
@@ -104,68 +80,82 @@ NimBLEUUID::NimBLEUUID(const uint8_t* pData, size_t size, bool msbFirst) {
         memcpy(uuidValue, pData, size);
     }
     m_valueSet = true;
+    setHash();
 } // NimBLEUUID
 
 
 /**
- * @brief Create a UUID from the 16bit value.
- * @param [in] uuid The 16bit short form UUID.
- */
-NimBLEUUID::NimBLEUUID(uint16_t uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_16;
-    m_uuid.u16.value     = uuid;
-    m_valueSet           = true;
-} // NimBLEUUID
-
-
-/**
- * @brief Create a UUID from the 32bit value.
- * @param [in] uuid The 32bit short form UUID.
+ * @brief Create a UUID from the native UUID.
+ * @param [in] uuid The native UUID.
  */
-NimBLEUUID::NimBLEUUID(uint32_t uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_32;
-    m_uuid.u32.value     = uuid;
-    m_valueSet           = true;
+NimBLEUUID::NimBLEUUID(const ble_uuid128_t* uuid)
+: m_hash(0), m_valueSet(false), m_onBase(false) {
+    m_uuid.u.type        = BLE_UUID_TYPE_128;
+    memcpy(m_uuid.u128.value, uuid->value, 16);
+    m_valueSet = true;
+    setHash();
 } // NimBLEUUID
 
 
 /**
- * @brief Create a UUID from the native UUID.
+ * @brief Create a UUID from a native UUID of any size.
  * @param [in] uuid The native UUID.
  */
-NimBLEUUID::NimBLEUUID(const ble_uuid128_t* uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_128;
-    memcpy(m_uuid.u128.value, uuid->value, 16);
-    m_valueSet = true;
+NimBLEUUID::NimBLEUUID(const ble_uuid_any_t* uuid)
+: m_hash(0), m_valueSet(false), m_onBase(false) {
+    switch (uuid->u.type) {
+        case BLE_UUID_TYPE_16:
+        case BLE_UUID_TYPE_32:
+        case BLE_UUID_TYPE_128:
+            m_uuid = *uuid;
+            m_valueSet = true;
+            setHash();
+            break;
+        default:
+            m_valueSet = false;
+            break;
+    }
 } // NimBLEUUID
 
 
 /**
- * @brief Create a UUID from the 128bit value using hex parts instead of string,
- * instead of NimBLEUUID("ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6"), it becomes
- * NimBLEUUID(0xebe0ccb0, 0x7a0a, 0x4b0c, 0x8a1a6ff2997da3a6)
- *
- * @param [in] first  The first 32bit of the UUID.
- * @param [in] second The next 16bit of the UUID.
- * @param [in] third  The next 16bit of the UUID.
- * @param [in] fourth The last 64bit of the UUID, combining the last 2 parts of the string equivalent
+ * @brief Compute the hash of the UUID and if it is on the Bluetooth base UUID.
+ * @details UUIDs on the base UUID hash to their 16 or 32 bit short form so that equal
+ * UUIDs of different sizes have the same hash and can be compared without expanding them.
  */
-NimBLEUUID::NimBLEUUID(uint32_t first, uint16_t second, uint16_t third, uint64_t fourth) {
-    m_uuid.u.type        = BLE_UUID_TYPE_128;
-    memcpy(m_uuid.u128.value + 12, &first,  4);
-    memcpy(m_uuid.u128.value + 10, &second, 2);
-    memcpy(m_uuid.u128.value + 8,  &third,  2);
-    memcpy(m_uuid.u128.value,      &fourth, 8);
-    m_valueSet = true;
-}
+void NimBLEUUID::setHash() {
+    static const uint8_t base128[] = {0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00,
+                                      0x00, 0x80, 0x00, 0x10, 0x00, 0x00};
+
+    switch (m_uuid.u.type) {
+        case BLE_UUID_TYPE_16:
+            m_hash   = m_uuid.u16.value;
+            m_onBase = true;
+            break;
+        case BLE_UUID_TYPE_32:
+            m_hash   = m_uuid.u32.value;
+            m_onBase = true;
+            break;
+        default: {
+            uint32_t words[4];
+            memcpy(words, m_uuid.u128.value, sizeof(words));
+            m_onBase = memcmp(m_uuid.u128.value, base128, sizeof(base128)) == 0;
+            m_hash   = m_onBase ? words[3] : hash128(words[0], words[1], words[2], words[3]);
+            break;
+        }
+    }
+} // setHash
 
 
 /**
- * @brief Creates an empty UUID.
+ * @brief Get a hash of the UUID for use in lookup tables.
+ * @details Equal UUIDs have the same hash regardless of their size, UUIDs on the Bluetooth
+ * base UUID hash to their short form value.
+ * @return The hash of the UUID, 0 if not set.
  */
-NimBLEUUID::NimBLEUUID() {
-    m_valueSet = false;
-} // NimBLEUUID
+uint32_t NimBLEUUID::hash() const {
+    return m_valueSet ? m_hash : 0;
+} // hash
 
 
 /**
@@ -296,42 +286,42 @@ std::string NimBLEUUID::toString() const {
 } // toString
 
 
+/**
+ * @brief Write the string representation of the UUID to a buffer without allocating.
+ * @param [in] buf The buffer to write to, it should be at least BLE_UUID_STR_LEN (37) bytes.
+ * @param [in] size The size of the buffer.
+ * @return A pointer to buf, which holds the UUID or an empty string if it is too small or the UUID is not set.
+ */
+char* NimBLEUUID::toString(char* buf, size_t size) const {
+    if(size < BLE_UUID_STR_LEN || !m_valueSet) {
+        if(size > 0) {
+            buf[0] = '\0';
+        }
+        return buf;
+    }
+
+    return ble_uuid_to_str(&m_uuid.u, buf);
+} // toString
+
+
 /**
  * @brief Convenience operator to check if this UUID is equal to another.
  */
 bool NimBLEUUID::operator ==(const NimBLEUUID & rhs) const {
-    if(m_valueSet && rhs.m_valueSet) {
-        if(m_uuid.u.type != rhs.m_uuid.u.type) {
-            uint8_t uuidBase[16] = {
-                0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
-                0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-            };
-
-            if(m_uuid.u.type == BLE_UUID_TYPE_128){
-                if(rhs.m_uuid.u.type == BLE_UUID_TYPE_16){
-                    memcpy(uuidBase+12, &rhs.m_uuid.u16.value, 2);
-                } else if (rhs.m_uuid.u.type == BLE_UUID_TYPE_32){
-                    memcpy(uuidBase+12, &rhs.m_uuid.u32.value, 4);
-                }
-                return memcmp(m_uuid.u128.value,uuidBase,16) == 0;
-
-            } else if(rhs.m_uuid.u.type == BLE_UUID_TYPE_128) {
-                if(m_uuid.u.type == BLE_UUID_TYPE_16){
-                    memcpy(uuidBase+12, &m_uuid.u16.value, 2);
-                } else if (m_uuid.u.type == BLE_UUID_TYPE_32){
-                    memcpy(uuidBase+12, &m_uuid.u32.value, 4);
-                }
-                return memcmp(rhs.m_uuid.u128.value,uuidBase,16) == 0;
-
-            } else {
-                return false;
-            }
-        }
+    if(!m_valueSet || !rhs.m_valueSet) {
+        return m_valueSet == rhs.m_valueSet;
+    }
+
+    if(m_hash != rhs.m_hash || m_onBase != rhs.m_onBase) {
+        return false;
+    }
 
-        return ble_uuid_cmp(&m_uuid.u, &rhs.m_uuid.u) == 0;
+    // UUIDs on the base UUID are equal if their short form values are, which is the hash.
+    if(m_onBase) {
+        return true;
     }
 
-    return m_valueSet == rhs.m_valueSet;
+    return memcmp(m_uuid.u128.value, rhs.m_uuid.u128.value, 16) == 0;
 }
 
 
@@ -37,19 +37,68 @@
 class NimBLEUUID {
 public:
     NimBLEUUID(const std::string &uuid);
-    NimBLEUUID(uint16_t uuid);
-    NimBLEUUID(uint32_t uuid);
     NimBLEUUID(const ble_uuid128_t* uuid);
+    NimBLEUUID(const ble_uuid_any_t* uuid);
     NimBLEUUID(const uint8_t* pData, size_t size, bool msbFirst);
-    NimBLEUUID(uint32_t first, uint16_t second, uint16_t third, uint64_t fourth);
-    NimBLEUUID();
+
+    /**
+     * @brief Create a UUID from a string, parsed at compile time when the string is a literal.
+     * @details Accepts the same formats as NimBLEUUID(const std::string&), a constant declared with\n
+     * <tt>static constexpr NimBLEUUID uuid("6E400001-B5A3-F393-E0A9-E50E24DCCA9E");</tt> is stored in flash.
+     * @param [in] uuid The string to build a UUID from.
+     */
+    constexpr NimBLEUUID(const char* uuid)
+    : NimBLEUUID(parse(uuid, strLen(uuid))) {}
+
+    /**
+     * @brief Create a UUID from the 16bit value.
+     * @param [in] uuid The 16bit short form UUID.
+     */
+    constexpr NimBLEUUID(uint16_t uuid)
+    : m_uuid16{{BLE_UUID_TYPE_16}, uuid}, m_hash(uuid), m_valueSet(true), m_onBase(true) {}
+
+    /**
+     * @brief Create a UUID from the 32bit value.
+     * @param [in] uuid The 32bit short form UUID.
+     */
+    constexpr NimBLEUUID(uint32_t uuid)
+    : m_uuid32{{BLE_UUID_TYPE_32}, uuid}, m_hash(uuid), m_valueSet(true), m_onBase(true) {}
+
+    /**
+     * @brief Create a UUID from the 128bit value using hex parts instead of string,
+     * instead of NimBLEUUID("ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6"), it becomes
+     * NimBLEUUID(0xebe0ccb0, 0x7a0a, 0x4b0c, 0x8a1a6ff2997da3a6)
+     *
+     * @param [in] first  The first 32bit of the UUID.
+     * @param [in] second The next 16bit of the UUID.
+     * @param [in] third  The next 16bit of the UUID.
+     * @param [in] fourth The last 64bit of the UUID, combining the last 2 parts of the string equivalent
+     */
+    constexpr NimBLEUUID(uint32_t first, uint16_t second, uint16_t third, uint64_t fourth)
+    : m_uuid128{{BLE_UUID_TYPE_128}, {
+                 byteOf(fourth, 0), byteOf(fourth, 1), byteOf(fourth, 2), byteOf(fourth, 3),
+                 byteOf(fourth, 4), byteOf(fourth, 5), byteOf(fourth, 6), byteOf(fourth, 7),
+                 byteOf(third, 0),  byteOf(third, 1),  byteOf(second, 0), byteOf(second, 1),
+                 byteOf(first, 0),  byteOf(first, 1),  byteOf(first, 2),  byteOf(first, 3)}},
+      m_hash(isBase(second, third, fourth) ? first :
+             hash128((uint32_t)fourth, (uint32_t)(fourth >> 32), third | ((uint32_t)second << 16), first)),
+      m_valueSet(true),
+      m_onBase(isBase(second, third, fourth)) {}
+
+    /**
+     * @brief Creates an empty UUID.
+     */
+    constexpr NimBLEUUID()
+    : m_uuid{}, m_hash(0), m_valueSet(false), m_onBase(false) {}
 
     uint8_t               bitSize() const;
+    uint32_t              hash() const;
     bool                  equals(const NimBLEUUID &uuid) const;
     const ble_uuid_any_t* getNative() const;
     const NimBLEUUID &    to128();
     const NimBLEUUID&     to16();
     std::string           toString() const;
+    char*                 toString(char* buf, size_t size) const;
     static NimBLEUUID     fromString(const std::string &uuid);
 
     bool operator ==(const NimBLEUUID & rhs) const;
@@ -57,8 +106,78 @@ public:
     operator std::string() const;
 
 private:
-    ble_uuid_any_t m_uuid;
-    bool           m_valueSet = false;
+    void           setHash();
+
+    /*********************** Compile time parsing ************************/
+
+    static constexpr uint8_t  byteOf(uint64_t val, uint8_t idx) { return (uint8_t)(val >> (idx * 8)); }
+
+    static constexpr size_t   strLen(const char* s, size_t n = 0) { return s[n] ? strLen(s, n + 1) : n; }
+
+    static constexpr uint8_t  hexVal(char c) {
+        return (c >= '0' && c <= '9') ? c - '0' :
+               (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+               (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0xff;
+    }
+
+    static constexpr bool     isHex(const char* s, size_t from, size_t to) {
+        return from >= to || (hexVal(s[from]) != 0xff && isHex(s, from + 1, to));
+    }
+
+    static constexpr uint64_t hexOf(const char* s, size_t from, size_t to, uint64_t acc = 0) {
+        return from >= to ? acc : hexOf(s, from + 1, to, (acc << 4) | hexVal(s[from]));
+    }
+
+    static constexpr uint64_t bytesOf(const char* s, size_t from, size_t to, uint64_t acc = 0) {
+        return from >= to ? acc : bytesOf(s, from + 1, to, (acc << 8) | (uint8_t)s[from]);
+    }
+
+    // Skips a 0x prefix as strtoul does.
+    static constexpr size_t   hexStart(const char* s, size_t len) {
+        return (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) ? 2 : 0;
+    }
+
+    static constexpr bool     isShort(const char* s, size_t len) {
+        return hexStart(s, len) < len && isHex(s, hexStart(s, len), len);
+    }
+
+    static constexpr bool     isLong(const char* s) {
+        return s[8] == '-' && s[13] == '-' && s[18] == '-' && s[23] == '-' &&
+               isHex(s, 0, 8) && isHex(s, 9, 13) && isHex(s, 14, 18) && isHex(s, 19, 23) && isHex(s, 24, 36);
+    }
+
+    static constexpr bool     isBase(uint16_t second, uint16_t third, uint64_t fourth) {
+        return second == 0x0000 && third == 0x1000 && fourth == 0x800000805f9b34fb;
+    }
+
+    static constexpr uint32_t mix2(uint32_t h) { return h ^ (h >> 13); }
+    static constexpr uint32_t mix1(uint32_t h) { return mix2((h ^ (h >> 16)) * 0x85ebca6b); }
+
+    /** @brief Hash of a UUID that is not on the base UUID, from its 4 little endian words. */
+    static constexpr uint32_t hash128(uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3) {
+        return mix1(((w0 * 31 + w1) * 31 + w2) * 31 + w3);
+    }
+
+    static constexpr NimBLEUUID parse(const char* s, size_t len) {
+        return len == 4 && isShort(s, len) ? NimBLEUUID((uint16_t)hexOf(s, hexStart(s, len), len)) :
+               len == 8 && isShort(s, len) ? NimBLEUUID((uint32_t)hexOf(s, hexStart(s, len), len)) :
+               len == 16 ? NimBLEUUID((uint32_t)bytesOf(s, 0, 4), (uint16_t)bytesOf(s, 4, 6),
+                                      (uint16_t)bytesOf(s, 6, 8), bytesOf(s, 8, 16)) :
+               len == 36 && isLong(s) ? NimBLEUUID((uint32_t)hexOf(s, 0, 8), (uint16_t)hexOf(s, 9, 13),
+                                                   (uint16_t)hexOf(s, 14, 18),
+                                                   (hexOf(s, 19, 23) << 48) | hexOf(s, 24, 36)) :
+               NimBLEUUID();
+    }
+
+    union {
+        ble_uuid_any_t m_uuid;
+        ble_uuid16_t   m_uuid16;
+        ble_uuid32_t   m_uuid32;
+        ble_uuid128_t  m_uuid128;
+    };
+    uint32_t       m_hash;
+    bool           m_valueSet;
+    bool           m_onBase;
 }; // NimBLEUUID
 #endif /* CONFIG_BT_ENABLED */
 #endif /* COMPONENTS_NIMBLEUUID_H_ */
@@ -0,0 +1,717 @@
+/*
+ * NimBLEUartService.cpp
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) || defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL))
+
+#include "NimBLEUartService.h"
+#include "NimBLEDevice.h"
+#include "NimBLELog.h"
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+// Number of msys mbufs left free for the rest of the stack when sending from the TX buffer.
+#define NIMBLE_CPP_UART_MBUF_RESERVE 4
+// Time to wait for mbufs to be freed before sending from the TX buffer again.
+#define NIMBLE_CPP_UART_RETRY_MS     5
+
+static const char* LOG_TAG = "NimBLEUart";
+
+
+/**
+ * @brief Construct a ring buffer.
+ * @param [in] size The capacity of the buffer in bytes.
+ */
+NimBLEUartBuffer::NimBLEUartBuffer(size_t size)
+: m_buf(new uint8_t[size > 0 ? size : 1]),
+  m_size(size > 0 ? size : 1),
+  m_head(0),
+  m_tail(0),
+  m_len(0)
+{
+} // NimBLEUartBuffer
+
+
+NimBLEUartBuffer::~NimBLEUartBuffer() {
+    delete[] m_buf;
+} // ~NimBLEUartBuffer
+
+
+/**
+ * @brief Copy data into the buffer, called by the writer.
+ * @param [in] data A pointer to the data.
+ * @param [in] len The length of the data.
+ * @return The number of bytes copied, less than len if the buffer is full.
+ */
+size_t NimBLEUartBuffer::write(const uint8_t* data, size_t len) {
+    len = std::min(len, space());
+    if(len == 0) {
+        return 0;
+    }
+
+    size_t first = std::min(len, m_size - m_head);
+    memcpy(m_buf + m_head, data, first);
+    memcpy(m_buf, data + first, len - first);
+    m_head = (m_head + len) % m_size;
+
+    ble_npl_hw_enter_critical();
+    m_len += len;
+    ble_npl_hw_exit_critical(0);
+    return len;
+} // write
+
+
+/**
+ * @brief Copy all the data of an mbuf chain into the buffer, called by the writer.
+ * @param [in] om The mbuf chain holding the data.
+ * @return True if the data was copied, false if it does not fit and nothing was copied.
+ */
+bool NimBLEUartBuffer::writeFrom(const struct os_mbuf* om) {
+    size_t len = OS_MBUF_PKTLEN(om);
+    if(len > space()) {
+        return false;
+    }
+
+    size_t first = std::min(len, m_size - m_head);
+    os_mbuf_copydata(om, 0, first, m_buf + m_head);
+    os_mbuf_copydata(om, first, len - first, m_buf);
+    m_head = (m_head + len) % m_size;
+
+    ble_npl_hw_enter_critical();
+    m_len += len;
+    ble_npl_hw_exit_critical(0);
+    return true;
+} // writeFrom
+
+
+/**
+ * @brief Copy data out of the buffer and remove it, called by the reader.
+ * @param [in] data A pointer to the destination.
+ * @param [in] len The maximum number of bytes to copy.
+ * @return The number of bytes copied.
+ */
+size_t NimBLEUartBuffer::read(uint8_t* data, size_t len) {
+    len = std::min(len, available());
+    if(len == 0) {
+        return 0;
+    }
+
+    size_t first = std::min(len, m_size - m_tail);
+    memcpy(data, m_buf + m_tail, first);
+    memcpy(data + first, m_buf, len - first);
+    consume(len);
+    return len;
+} // read
+
+
+/**
+ * @brief Get the oldest byte without removing it, called by the reader.
+ * @return The byte or -1 if the buffer is empty.
+ */
+int NimBLEUartBuffer::peek() {
+    if(available() == 0) {
+        return -1;
+    }
+    return m_buf[m_tail];
+} // peek
+
+
+/**
+ * @brief Append the oldest data to an mbuf without removing it, called by the reader.
+ * @param [in] om The mbuf to append to.
+ * @param [in] len The maximum number of bytes to append.
+ * @return 0 on success or BLE_HS_ENOMEM if the mbuf could not be extended.
+ */
+int NimBLEUartBuffer::appendTo(struct os_mbuf* om, size_t len) {
+    len = std::min(len, available());
+    size_t first = std::min(len, m_size - m_tail);
+
+    if(os_mbuf_append(om, m_buf + m_tail, first) != 0 ||
+       (len > first && os_mbuf_append(om, m_buf, len - first) != 0)) {
+        return BLE_HS_ENOMEM;
+    }
+    return 0;
+} // appendTo
+
+
+/**
+ * @brief Remove the oldest data, called by the reader.
+ * @param [in] len The number of bytes to remove, at most the number available.
+ */
+void NimBLEUartBuffer::consume(size_t len) {
+    m_tail = (m_tail + len) % m_size;
+
+    ble_npl_hw_enter_critical();
+    m_len -= len;
+    ble_npl_hw_exit_critical(0);
+} // consume
+
+
+/**
+ * @brief Get the number of bytes stored.
+ */
+size_t NimBLEUartBuffer::available() {
+    return m_len;
+} // available
+
+
+/**
+ * @brief Get the number of bytes that can be written.
+ */
+size_t NimBLEUartBuffer::space() {
+    return m_size - m_len;
+} // space
+
+
+/**
+ * @brief Get the capacity of the buffer.
+ */
+size_t NimBLEUartBuffer::getSize() {
+    return m_size;
+} // getSize
+
+
+/**
+ * @brief Remove all the stored data, called by the reader.
+ */
+void NimBLEUartBuffer::clear() {
+    consume(available());
+} // clear
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+
+/**
+ * @brief Create the Nordic UART Service on a server.
+ * @param [in] pServer A pointer to the server to create the service on.
+ * @param [in] rxSize The size of the buffer holding the data written by the client.
+ * @param [in] txSize The size of the buffer holding the data waiting to be sent to the client.
+ * @details Call start() to start the service, or start the server.
+ */
+NimBLEUartService::NimBLEUartService(NimBLEServer* pServer, size_t rxSize, size_t txSize)
+: m_rxBuf(rxSize),
+  m_txBuf(txSize),
+  m_connHandle(BLE_HS_CONN_HANDLE_NONE),
+  m_rxDropped(0)
+{
+    m_pService = pServer->createService(NIMBLE_UART_SERVICE_UUID);
+    m_pRxChr = new RxCharacteristic(this, m_pService);
+    m_pService->addCharacteristic(m_pRxChr);
+    m_pTxChr = m_pService->createCharacteristic(NIMBLE_UART_TX_CHR_UUID, NIMBLE_PROPERTY::NOTIFY);
+    m_pTxChr->setCallbacks(this);
+
+    ble_npl_callout_init(&m_txTimer, nimble_port_get_dflt_eventq(), NimBLEUartService::txTimerCb, this);
+} // NimBLEUartService
+
+
+NimBLEUartService::~NimBLEUartService() {
+    ble_npl_callout_stop(&m_txTimer);
+    ble_npl_callout_deinit(&m_txTimer);
+
+    if(m_pTxChr->getCallbacks() == this) {
+        m_pTxChr->setCallbacks(nullptr);
+    }
+} // ~NimBLEUartService
+
+
+/**
+ * @brief Construct the RX characteristic of the service.
+ */
+NimBLEUartService::RxCharacteristic::RxCharacteristic(NimBLEUartService* pUart, NimBLEService* pService)
+: NimBLECharacteristic(NIMBLE_UART_RX_CHR_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR,
+                       BLE_ATT_ATTR_MAX_LEN, pService),
+  m_pUart(pUart)
+{
+} // RxCharacteristic
+
+
+/**
+ * @brief Copy the written data into the RX buffer.
+ * @return 0 on success or BLE_ATT_ERR_INSUFFICIENT_RES if the data does not fit.
+ */
+int NimBLEUartService::RxCharacteristic::writeValueFrom(const struct os_mbuf* om) {
+    if(!m_pUart->m_rxBuf.writeFrom(om)) {
+        m_pUart->m_rxDropped += OS_MBUF_PKTLEN(om);
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    return 0;
+} // writeValueFrom
+
+
+/**
+ * @brief Get the service, to add it to the advertised services.
+ */
+NimBLEService* NimBLEUartService::getService() {
+    return m_pService;
+} // getService
+
+
+/**
+ * @brief Start the service.
+ * @return True if the service was started.
+ */
+bool NimBLEUartService::start() {
+    return m_pService->start();
+} // start
+
+
+/**
+ * @brief Check if a client is subscribed to the TX characteristic.
+ */
+bool NimBLEUartService::isConnected() {
+    return m_connHandle != BLE_HS_CONN_HANDLE_NONE;
+} // isConnected
+
+
+/**
+ * @brief Get the connection handle of the client the data is exchanged with.
+ * @return The connection handle or BLE_HS_CONN_HANDLE_NONE if no client is subscribed.
+ */
+uint16_t NimBLEUartService::getConnHandle() {
+    return m_connHandle;
+} // getConnHandle
+
+
+/**
+ * @brief Get the number of received bytes waiting to be read.
+ */
+int NimBLEUartService::available() {
+    return m_rxBuf.available();
+} // available
+
+
+/**
+ * @brief Read a received byte.
+ * @return The byte or -1 if none is available.
+ */
+int NimBLEUartService::read() {
+    uint8_t c;
+    return m_rxBuf.read(&c, 1) == 1 ? c : -1;
+} // read
+
+
+/**
+ * @brief Read the received data.
+ * @param [in] buffer A pointer to the destination.
+ * @param [in] size The size of the destination.
+ * @return The number of bytes read.
+ */
+size_t NimBLEUartService::read(uint8_t* buffer, size_t size) {
+    return m_rxBuf.read(buffer, size);
+} // read
+
+
+/**
+ * @brief Get the next received byte without removing it.
+ * @return The byte or -1 if none is available.
+ */
+int NimBLEUartService::peek() {
+    return m_rxBuf.peek();
+} // peek
+
+
+/**
+ * @brief Queue a byte to send to the client.
+ * @return 1 if the byte was queued, 0 if the TX buffer is full.
+ */
+size_t NimBLEUartService::write(uint8_t c) {
+    return write(&c, 1);
+} // write
+
+
+/**
+ * @brief Queue data to send to the client.
+ * @param [in] data A pointer to the data.
+ * @param [in] length The length of the data.
+ * @return The number of bytes queued, less than length if the TX buffer is full.
+ * @details The data is kept while no client is subscribed and sent to the next client that subscribes.
+ */
+size_t NimBLEUartService::write(const uint8_t* data, size_t length) {
+    size_t len = m_txBuf.write(data, length);
+
+    // The data is sent from the host task.
+    if(len > 0 && !ble_npl_callout_is_active(&m_txTimer)) {
+        ble_npl_callout_reset(&m_txTimer, 1);
+    }
+    return len;
+} // write
+
+
+/**
+ * @brief Get the number of bytes that can be queued without blocking.
+ */
+int NimBLEUartService::availableForWrite() {
+    return m_txBuf.space();
+} // availableForWrite
+
+
+/**
+ * @brief Wait until the queued data is sent or the client is gone.
+ * @details Must not be called from a callback, the data is sent from the host task.
+ */
+void NimBLEUartService::flush() {
+    while(m_txBuf.available() > 0 && isConnected()) {
+        ble_npl_time_delay(1);
+    }
+} // flush
+
+
+/**
+ * @brief Get the number of bytes written by the client that did not fit in the RX buffer.
+ */
+uint32_t NimBLEUartService::getRxDroppedCount() {
+    return m_rxDropped;
+} // getRxDroppedCount
+
+
+/**
+ * @brief Track the client subscribed to the TX characteristic and send it the queued data.
+ */
+void NimBLEUartService::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc,
+                                    uint16_t subValue)
+{
+    if(subValue & 0x0001) {
+        m_connHandle = desc->conn_handle;
+        ble_npl_callout_reset(&m_txTimer, 1);
+    } else if(m_connHandle == desc->conn_handle) {
+        m_connHandle = BLE_HS_CONN_HANDLE_NONE;
+    }
+} // onSubscribe
+
+
+/**
+ * @brief Send the queued data from the host task.
+ */
+void NimBLEUartService::txTimerCb(struct ble_npl_event *event) {
+    NimBLEUartService* pUart = (NimBLEUartService*)ble_npl_event_get_arg(event);
+    pUart->sendPending();
+} // txTimerCb
+
+
+/**
+ * @brief Notify the client of the queued data in chunks of the MTU until the buffer is empty
+ * or the transmit mbufs run low.
+ */
+void NimBLEUartService::sendPending() {
+    uint16_t connHandle = m_connHandle;
+    if(connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
+    }
+
+    uint16_t mtu = ble_att_mtu(connHandle);
+    if(mtu <= 3) {
+        return;
+    }
+
+    while(m_txBuf.available() > 0) {
+        struct os_mbuf* om = nullptr;
+        if(os_msys_num_free() > NIMBLE_CPP_UART_MBUF_RESERVE) {
+            om = ble_hs_mbuf_att_pkt();
+        }
+
+        size_t len = std::min<size_t>(m_txBuf.available(), mtu - 3);
+        if(om == nullptr || m_txBuf.appendTo(om, len) != 0) {
+            if(om != nullptr) {
+                os_mbuf_free_chain(om);
+            }
+            ble_npl_callout_reset(&m_txTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_UART_RETRY_MS));
+            return;
+        }
+
+        ble_hs_mbuf_set_tx_prio(om, m_pTxChr->getTxPriority());
+        int rc = ble_gattc_notify_custom(connHandle, m_pTxChr->getHandle(), om);
+        if(rc != 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(connHandle, txFailures, 1);
+            if(rc == BLE_HS_ENOMEM) {
+                ble_npl_callout_reset(&m_txTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_UART_RETRY_MS));
+            } else {
+                NIMBLE_LOGW(LOG_TAG, "Notify failed, rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+            }
+            return;
+        }
+
+        NIMBLE_CPP_CONN_STATS_ADD(connHandle, notifyTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(connHandle, notifyTxBytes, len);
+        m_txBuf.consume(len);
+    }
+} // sendPending
+
+#endif /* CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+
+/**
+ * @brief Construct a Nordic UART Service client.
+ * @param [in] pClient A pointer to the client connected, or to be connected, to the server.
+ * @param [in] rxSize The size of the buffer holding the data notified by the server.
+ * @param [in] txSize The size of the buffer holding the data waiting to be sent to the server.
+ */
+NimBLEUartClient::NimBLEUartClient(NimBLEClient* pClient, size_t rxSize, size_t txSize)
+: m_pClient(pClient),
+  m_rxHandle(0),
+  m_txPrio(0),
+  m_rxBuf(rxSize),
+  m_txBuf(txSize),
+  m_rxDropped(0)
+{
+    ble_npl_callout_init(&m_txTimer, nimble_port_get_dflt_eventq(), NimBLEUartClient::txTimerCb, this);
+} // NimBLEUartClient
+
+
+NimBLEUartClient::~NimBLEUartClient() {
+    ble_npl_callout_stop(&m_txTimer);
+    ble_npl_callout_deinit(&m_txTimer);
+} // ~NimBLEUartClient
+
+
+/**
+ * @brief Find the Nordic UART Service of the connected server and subscribe to its TX characteristic.
+ * @return True if the service was found and the subscription succeeded.
+ * @details Call again after each reconnection, the queued data is sent once it succeeds.
+ */
+bool NimBLEUartClient::begin() {
+    m_rxHandle = 0;
+
+    if(!m_pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "begin: Not connected");
+        return false;
+    }
+
+    NimBLERemoteService* pSvc = m_pClient->getService(NIMBLE_UART_SERVICE_UUID);
+    if(pSvc == nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "begin: Nordic UART Service not found");
+        return false;
+    }
+
+    // The names are those of the server, the client writes to RX and is notified through TX.
+    NimBLERemoteCharacteristic* pRxChr = pSvc->getCharacteristic(NIMBLE_UART_RX_CHR_UUID);
+    NimBLERemoteCharacteristic* pTxChr = pSvc->getCharacteristic(NIMBLE_UART_TX_CHR_UUID);
+    if(pRxChr == nullptr || pTxChr == nullptr || !pRxChr->canWriteNoResponse() || !pTxChr->canNotify()) {
+        NIMBLE_LOGE(LOG_TAG, "begin: Nordic UART characteristics not found");
+        return false;
+    }
+
+    if(!pTxChr->subscribe(true, [this](NimBLERemoteCharacteristic* pChr, const struct os_mbuf* om, bool isNotify) {
+                              onNotify(om);
+                          }, true, false)) {
+        NIMBLE_LOGE(LOG_TAG, "begin: Subscribe failed");
+        return false;
+    }
+
+    m_txPrio = pRxChr->getTxPriority();
+    m_rxHandle = pRxChr->getHandle();
+    ble_npl_callout_reset(&m_txTimer, 1);
+    return true;
+} // begin
+
+
+/**
+ * @brief Stop sending to the server and unsubscribe from its TX characteristic, the buffers are kept.
+ */
+void NimBLEUartClient::end() {
+    ble_npl_callout_stop(&m_txTimer);
+    if(m_rxHandle == 0) {
+        return;
+    }
+
+    m_rxHandle = 0;
+    if(m_pClient->isConnected()) {
+        NimBLERemoteService* pSvc = m_pClient->getService(NIMBLE_UART_SERVICE_UUID);
+        NimBLERemoteCharacteristic* pTxChr = pSvc != nullptr ? pSvc->getCharacteristic(NIMBLE_UART_TX_CHR_UUID) : nullptr;
+        if(pTxChr != nullptr) {
+            pTxChr->unsubscribe();
+        }
+    }
+} // end
+
+
+/**
+ * @brief Check if the client is connected and begin() succeeded.
+ */
+bool NimBLEUartClient::isConnected() {
+    return m_rxHandle != 0 && m_pClient->isConnected();
+} // isConnected
+
+
+/**
+ * @brief Get the client the service is used through.
+ */
+NimBLEClient* NimBLEUartClient::getClient() {
+    return m_pClient;
+} // getClient
+
+
+/**
+ * @brief Get the number of received bytes waiting to be read.
+ */
+int NimBLEUartClient::available() {
+    return m_rxBuf.available();
+} // available
+
+
+/**
+ * @brief Read a received byte.
+ * @return The byte or -1 if none is available.
+ */
+int NimBLEUartClient::read() {
+    uint8_t c;
+    return m_rxBuf.read(&c, 1) == 1 ? c : -1;
+} // read
+
+
+/**
+ * @brief Read the received data.
+ * @param [in] buffer A pointer to the destination.
+ * @param [in] size The size of the destination.
+ * @return The number of bytes read.
+ */
+size_t NimBLEUartClient::read(uint8_t* buffer, size_t size) {
+    return m_rxBuf.read(buffer, size);
+} // read
+
+
+/**
+ * @brief Get the next received byte without removing it.
+ * @return The byte or -1 if none is available.
+ */
+int NimBLEUartClient::peek() {
+    return m_rxBuf.peek();
+} // peek
+
+
+/**
+ * @brief Queue a byte to send to the server.
+ * @return 1 if the byte was queued, 0 if the TX buffer is full.
+ */
+size_t NimBLEUartClient::write(uint8_t c) {
+    return write(&c, 1);
+} // write
+
+
+/**
+ * @brief Queue data to send to the server.
+ * @param [in] data A pointer to the data.
+ * @param [in] length The length of the data.
+ * @return The number of bytes queued, less than length if the TX buffer is full.
+ */
+size_t NimBLEUartClient::write(const uint8_t* data, size_t length) {
+    size_t len = m_txBuf.write(data, length);
+
+    // The data is sent from the host task.
+    if(len > 0 && !ble_npl_callout_is_active(&m_txTimer)) {
+        ble_npl_callout_reset(&m_txTimer, 1);
+    }
+    return len;
+} // write
+
+
+/**
+ * @brief Get the number of bytes that can be queued without blocking.
+ */
+int NimBLEUartClient::availableForWrite() {
+    return m_txBuf.space();
+} // availableForWrite
+
+
+/**
+ * @brief Wait until the queued data is sent or the server is gone.
+ * @details Must not be called from a callback, the data is sent from the host task.
+ */
+void NimBLEUartClient::flush() {
+    while(m_txBuf.available() > 0 && isConnected()) {
+        ble_npl_time_delay(1);
+    }
+} // flush
+
+
+/**
+ * @brief Get the number of bytes notified by the server that did not fit in the RX buffer.
+ */
+uint32_t NimBLEUartClient::getRxDroppedCount() {
+    return m_rxDropped;
+} // getRxDroppedCount
+
+
+/**
+ * @brief Copy a notification into the RX buffer, called from the host task.
+ */
+void NimBLEUartClient::onNotify(const struct os_mbuf* om) {
+    if(!m_rxBuf.writeFrom(om)) {
+        m_rxDropped += OS_MBUF_PKTLEN(om);
+    }
+} // onNotify
+
+
+/**
+ * @brief Send the queued data from the host task.
+ */
+void NimBLEUartClient::txTimerCb(struct ble_npl_event *event) {
+    NimBLEUartClient* pUart = (NimBLEUartClient*)ble_npl_event_get_arg(event);
+    pUart->sendPending();
+} // txTimerCb
+
+
+/**
+ * @brief Write the queued data to the server without response in chunks of the MTU until
+ * the buffer is empty or the transmit mbufs run low.
+ */
+void NimBLEUartClient::sendPending() {
+    if(!isConnected()) {
+        return;
+    }
+
+    uint16_t connHandle = m_pClient->getConnId();
+    uint16_t mtu = ble_att_mtu(connHandle);
+    if(mtu <= 3) {
+        return;
+    }
+
+    while(m_txBuf.available() > 0) {
+        struct os_mbuf* om = nullptr;
+        if(os_msys_num_free() > NIMBLE_CPP_UART_MBUF_RESERVE) {
+            om = ble_hs_mbuf_att_pkt();
+        }
+
+        size_t len = std::min<size_t>(m_txBuf.available(), mtu - 3);
+        if(om == nullptr || m_txBuf.appendTo(om, len) != 0) {
+            if(om != nullptr) {
+                os_mbuf_free_chain(om);
+            }
+            ble_npl_callout_reset(&m_txTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_UART_RETRY_MS));
+            return;
+        }
+
+        ble_hs_mbuf_set_tx_prio(om, m_txPrio);
+        int rc = ble_gattc_write_no_rsp(connHandle, m_rxHandle, om);
+        if(rc != 0) {
+            NIMBLE_CPP_CONN_STATS_ADD(connHandle, txFailures, 1);
+            if(rc == BLE_HS_ENOMEM) {
+                ble_npl_callout_reset(&m_txTimer, ble_npl_time_ms_to_ticks32(NIMBLE_CPP_UART_RETRY_MS));
+            } else {
+                NIMBLE_LOGW(LOG_TAG, "Write failed, rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+            }
+            return;
+        }
+
+        NIMBLE_CPP_CONN_STATS_ADD(connHandle, writeTxPackets, 1);
+        NIMBLE_CPP_CONN_STATS_ADD(connHandle, writeTxBytes, len);
+        m_txBuf.consume(len);
+    }
+} // sendPending
+
+#endif /* CONFIG_BT_NIMBLE_ROLE_CENTRAL */
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_PERIPHERAL || CONFIG_BT_NIMBLE_ROLE_CENTRAL) */
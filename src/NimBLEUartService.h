@@ -0,0 +1,199 @@
+/*
+ * NimBLEUartService.h
+ *
+ *  Created: on Oct 14 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef NIMBLEUARTSERVICE_H_
+#define NIMBLEUARTSERVICE_H_
+
+#include "nimconfig.h"
+#if defined(CONFIG_BT_ENABLED) && (defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) || defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL))
+
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+#ifdef NIMBLE_CPP_ARDUINO_STRING_AVAILABLE
+#include <Arduino.h>
+#endif
+
+/****  FIX COMPILATION ****/
+#undef min
+#undef max
+/**************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Nordic UART Service UUID */
+#define NIMBLE_UART_SERVICE_UUID "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
+/** The characteristic the client writes to, the RX of the server */
+#define NIMBLE_UART_RX_CHR_UUID  "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
+/** The characteristic the server notifies, the TX of the server */
+#define NIMBLE_UART_TX_CHR_UUID  "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
+
+/**
+ * @brief A byte ring buffer with one writer and one reader task.
+ * @details The writer only moves the head and the reader only moves the tail, the stored
+ * length is updated with the interrupts disabled so the two sides do not need a lock.
+ */
+class NimBLEUartBuffer {
+public:
+    NimBLEUartBuffer(size_t size);
+    ~NimBLEUartBuffer();
+
+    size_t      write(const uint8_t* data, size_t len);
+    bool        writeFrom(const struct os_mbuf* om);
+    size_t      read(uint8_t* data, size_t len);
+    int         peek();
+    int         appendTo(struct os_mbuf* om, size_t len);
+    void        consume(size_t len);
+    size_t      available();
+    size_t      space();
+    size_t      getSize();
+    void        clear();
+
+private:
+    uint8_t*    m_buf;
+    size_t      m_size;
+    size_t      m_head;
+    size_t      m_tail;
+    volatile size_t m_len;
+}; // NimBLEUartBuffer
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL)
+#include "NimBLEServer.h"
+
+/**
+ * @brief A Nordic UART Service server that streams between ring buffers and the connected client.
+ * @details Data written with write() is queued in the TX buffer and sent from the host task in
+ * notifications as large as the MTU allows, the buffer is drained until the transmit mbufs run low
+ * and continues when they are freed, so writing faster than the link only fills the buffer.
+ * Data written by the client, with or without response, is copied straight from the received
+ * mbufs into the RX buffer and read with read(). A write with response that does not fit is
+ * rejected so the client can send it again, a write without response that does not fit is dropped
+ * and counted.\n
+ * The data is exchanged with the last client that subscribed to the TX characteristic.
+ * When Arduino.h is available the class is a Stream and can be used where a serial port is.
+ * The service handles the callbacks of its characteristics.
+ */
+class NimBLEUartService : public NimBLECharacteristicCallbacks
+#ifdef NIMBLE_CPP_ARDUINO_STRING_AVAILABLE
+                        , public Stream
+#endif
+{
+public:
+    NimBLEUartService(NimBLEServer* pServer, size_t rxSize = 512, size_t txSize = 1024);
+    ~NimBLEUartService();
+
+    NimBLEService*  getService();
+    bool            start();
+    bool            isConnected();
+    uint16_t        getConnHandle();
+    int             available();
+    int             read();
+    size_t          read(uint8_t* buffer, size_t size);
+    int             peek();
+    size_t          write(uint8_t c);
+    size_t          write(const uint8_t* data, size_t length);
+    int             availableForWrite();
+    void            flush();
+    uint32_t        getRxDroppedCount();
+    void            onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc,
+                                uint16_t subValue) override;
+
+#ifdef NIMBLE_CPP_ARDUINO_STRING_AVAILABLE
+    using Print::write;
+#endif
+
+private:
+    /**
+     * @brief The RX characteristic, stores the written data in the RX buffer instead of the value.
+     */
+    class RxCharacteristic : public NimBLECharacteristic {
+    public:
+        RxCharacteristic(NimBLEUartService* pUart, NimBLEService* pService);
+    protected:
+        int writeValueFrom(const struct os_mbuf* om) override;
+    private:
+        NimBLEUartService* m_pUart;
+    };
+
+    static void           txTimerCb(struct ble_npl_event *event);
+    void                  sendPending();
+
+    NimBLEService*        m_pService;
+    NimBLECharacteristic* m_pTxChr;
+    RxCharacteristic*     m_pRxChr;
+    NimBLEUartBuffer      m_rxBuf;
+    NimBLEUartBuffer      m_txBuf;
+    volatile uint16_t     m_connHandle;
+    uint32_t              m_rxDropped;
+    ble_npl_callout       m_txTimer;
+}; // NimBLEUartService
+#endif /* CONFIG_BT_NIMBLE_ROLE_PERIPHERAL */
+
+
+#if defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL)
+#include "NimBLEClient.h"
+
+/**
+ * @brief A Nordic UART Service client that streams between ring buffers and the connected server.
+ * @details Call begin() once connected to find the service and subscribe to the TX characteristic of
+ * the server. Notifications are copied straight from the received mbufs into the RX buffer and read
+ * with read(), data that does not fit is dropped and counted. Data written with write() is queued in
+ * the TX buffer and sent from the host task with writes without response as large as the MTU allows,
+ * when the transmit mbufs run low sending continues once they are freed.\n
+ * When Arduino.h is available the class is a Stream and can be used where a serial port is.
+ */
+class NimBLEUartClient
+#ifdef NIMBLE_CPP_ARDUINO_STRING_AVAILABLE
+                        : public Stream
+#endif
+{
+public:
+    NimBLEUartClient(NimBLEClient* pClient, size_t rxSize = 512, size_t txSize = 1024);
+    ~NimBLEUartClient();
+
+    bool            begin();
+    void            end();
+    bool            isConnected();
+    NimBLEClient*   getClient();
+    int             available();
+    int             read();
+    size_t          read(uint8_t* buffer, size_t size);
+    int             peek();
+    size_t          write(uint8_t c);
+    size_t          write(const uint8_t* data, size_t length);
+    int             availableForWrite();
+    void            flush();
+    uint32_t        getRxDroppedCount();
+
+#ifdef NIMBLE_CPP_ARDUINO_STRING_AVAILABLE
+    using Print::write;
+#endif
+
+private:
+    static void                 txTimerCb(struct ble_npl_event *event);
+    void                        sendPending();
+    void                        onNotify(const struct os_mbuf* om);
+
+    NimBLEClient*               m_pClient;
+    // The value handle of the server RX characteristic, 0 until begin() found it.
+    volatile uint16_t           m_rxHandle;
+    uint8_t                     m_txPrio;
+    NimBLEUartBuffer            m_rxBuf;
+    NimBLEUartBuffer            m_txBuf;
+    uint32_t                    m_rxDropped;
+    ble_npl_callout             m_txTimer;
+}; // NimBLEUartClient
+#endif /* CONFIG_BT_NIMBLE_ROLE_CENTRAL */
+
+#endif /* CONFIG_BT_ENABLED && (CONFIG_BT_NIMBLE_ROLE_PERIPHERAL || CONFIG_BT_NIMBLE_ROLE_CENTRAL) */
+#endif /* NIMBLEUARTSERVICE_H_ */
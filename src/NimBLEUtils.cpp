@@ -12,11 +12,74 @@
 #include "NimBLEUtils.h"
 #include "NimBLELog.h"
 
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#elif defined(NIMBLE_NPL_POSIX)
+#include <time.h>
+#else
+#include "nimble/porting/nimble/include/os/os_cputime.h"
+#endif
+
 #include <stdlib.h>
 
 static const char* LOG_TAG = "NimBLEUtils";
 
 
+/**
+ * @brief Get the time since boot from a monotonic clock.
+ * @return The time in microseconds.
+ * @details Reads the esp_timer on ESP32, the monotonic clock on the POSIX port and the controller
+ * cputime otherwise, cheap enough to timestamp every received packet. The resolution is that of the clock, 1 microsecond on ESP32.
+ */
+uint64_t NimBLEUtils::getTimeUs() {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#elif defined(NIMBLE_NPL_POSIX)
+    // There is no controller cputime on a PC, the monotonic clock is used instead.
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    // Extend the 32 bit cputime, the function must be called at least once per wrap.
+    static uint32_t lastTicks = 0;
+    static uint32_t wraps = 0;
+
+    ble_npl_hw_enter_critical();
+    uint32_t ticks = os_cputime_get32();
+    if(ticks < lastTicks) {
+        wraps++;
+    }
+    lastTicks = ticks;
+    uint64_t ticks64 = ((uint64_t)wraps << 32) | ticks;
+    ble_npl_hw_exit_critical(0);
+
+    return ticks64 * 1000000 / MYNEWT_VAL(OS_CPUTIME_FREQ);
+#endif
+} // getTimeUs
+
+
+/**
+ * @brief Update a CRC-32 (IEEE 802.3) with more data.
+ * @param [in] crc The CRC of the data so far, 0 to start.
+ * @param [in] data A pointer to the data.
+ * @param [in] length The length of the data.
+ * @return The CRC including the data.
+ */
+uint32_t NimBLEUtils::crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for(size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+} // crc32
+
+
 /**
  * @brief A function for checking validity of connection parameters.
  * @param [in] params A pointer to the structure containing the parameters to check.
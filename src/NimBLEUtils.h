@@ -44,6 +44,8 @@ public:
     static const char*          advTypeToString(uint8_t advType);
     static const char*          returnCodeToString(int rc);
     static int                  checkConnParams(ble_gap_conn_params* params);
+    static uint64_t             getTimeUs();
+    static uint32_t             crc32(uint32_t crc, const uint8_t* data, size_t length);
 };
 
 
@@ -124,23 +124,27 @@ int ble_hci_trans_ll_evt_tx(uint8_t *hci_ev)
     return rc;
 }
 
+/* An ACL packet with its H4 packet type, ready to send to the controller. */
+struct ble_hci_acl_tx_pkt {
+    uint8_t *data;
+    uint16_t len;
+};
+
 /* Added; Called from the core NimBLE is running on, not used for unicore */
 #ifndef CONFIG_FREERTOS_UNICORE
 void ble_hci_trans_hs_acl_tx_on_core(void *arg)
 {
-    // Ugly but necessary as the arduino core does not provide enough IPC stack for variables.
-    esp_vhci_host_send_packet((uint8_t*)arg + 2, *(uint16_t*)arg);
+    struct ble_hci_acl_tx_pkt *pkt = arg;
+
+    esp_vhci_host_send_packet(pkt->data, pkt->len);
 }
 #endif
 
 /* Modified to use ipc calls in arduino to correct performance issues */
 int ble_hci_trans_hs_acl_tx(struct os_mbuf *om)
 {
-    uint16_t len = 0;
-    uint8_t data[MYNEWT_VAL(BLE_ACL_BUF_SIZE) + 3], rc = 0;
-#ifndef CONFIG_FREERTOS_UNICORE
-    bool tx_using_nimble_core = 0;
-#endif
+    struct ble_hci_acl_tx_pkt pkt;
+    uint8_t data[MYNEWT_VAL(BLE_ACL_BUF_SIZE) + 1], rc = 0;
     /* If this packet is zero length, just free it */
     if (OS_MBUF_PKTLEN(om) == 0) {
         os_mbuf_free_chain(om);
@@ -151,35 +155,32 @@ int ble_hci_trans_hs_acl_tx(struct os_mbuf *om)
         ESP_LOGD(TAG, "Controller not ready to receive packets");
     }
 
-    len = 1 + OS_MBUF_PKTLEN(om);
-/* Don't check core ID if unicore */
-#ifndef CONFIG_FREERTOS_UNICORE
-    tx_using_nimble_core = xPortGetCoreID() != CONFIG_BT_NIMBLE_PINNED_TO_CORE;
-    if (tx_using_nimble_core && !xPortInIsrContext()) {
-        data[0] = len;
-        data[1] = (len >> 8);
-        data[2] = BLE_HCI_UART_H4_ACL;
-        os_mbuf_copydata(om, 0, OS_MBUF_PKTLEN(om), &data[3]);
+    pkt.len = 1 + OS_MBUF_PKTLEN(om);
+
+    /*
+     * The host reserves a byte in front of the ACL header for the H4 packet
+     * type, when the packet is in a single mbuf it is sent from the mbuf
+     * itself as the controller copies the data before returning.
+     */
+    if (SLIST_NEXT(om, om_next) == NULL && OS_MBUF_LEADINGSPACE(om) >= 1) {
+        pkt.data = om->om_data - 1;
     } else {
-        data[0] = BLE_HCI_UART_H4_ACL;
+        pkt.data = data;
         os_mbuf_copydata(om, 0, OS_MBUF_PKTLEN(om), &data[1]);
     }
-#else /* Unicore */
-    data[0] = BLE_HCI_UART_H4_ACL;
-    os_mbuf_copydata(om, 0, OS_MBUF_PKTLEN(om), &data[1]);
-#endif
+    pkt.data[0] = BLE_HCI_UART_H4_ACL;
 
     if (xSemaphoreTake(vhci_send_sem, NIMBLE_VHCI_TIMEOUT_MS / portTICK_PERIOD_MS) == pdTRUE) {
 /* esp_ipc_call_blocking does not exist for solo */
 #ifndef CONFIG_FREERTOS_UNICORE
-        if (tx_using_nimble_core && !xPortInIsrContext()) {
+        if (xPortGetCoreID() != CONFIG_BT_NIMBLE_PINNED_TO_CORE && !xPortInIsrContext()) {
             esp_ipc_call_blocking(CONFIG_BT_NIMBLE_PINNED_TO_CORE,
-                                  ble_hci_trans_hs_acl_tx_on_core, data);
+                                  ble_hci_trans_hs_acl_tx_on_core, &pkt);
         } else {
-            esp_vhci_host_send_packet(data, len);
+            esp_vhci_host_send_packet(pkt.data, pkt.len);
         }
 #else /* Unicore */
-        esp_vhci_host_send_packet(data, len);
+        esp_vhci_host_send_packet(pkt.data, pkt.len);
 #endif
     } else {
         rc = BLE_HS_ETIMEOUT_HCI;
@@ -13,6 +13,14 @@
 #define MYNEWT_VAL(x)                           MYNEWT_VAL_ ## x
 
 /*** kernel/os */
+#ifndef MYNEWT_VAL_OS_MEMPOOL_LOCK_FREE
+#ifdef CONFIG_BT_NIMBLE_MEMPOOL_LOCK_FREE
+#define MYNEWT_VAL_OS_MEMPOOL_LOCK_FREE (CONFIG_BT_NIMBLE_MEMPOOL_LOCK_FREE)
+#else
+#define MYNEWT_VAL_OS_MEMPOOL_LOCK_FREE (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_MSYS_1_BLOCK_COUNT
 #ifdef CONFIG_BT_NIMBLE_MESH
 #define MYNEWT_VAL_MSYS_1_BLOCK_COUNT (CONFIG_BT_NIMBLE_MSYS1_BLOCK_COUNT + 8)
@@ -22,7 +30,7 @@
 #endif
 
 #ifndef MYNEWT_VAL_MSYS_1_BLOCK_SIZE
-#define MYNEWT_VAL_MSYS_1_BLOCK_SIZE (292)
+#define MYNEWT_VAL_MSYS_1_BLOCK_SIZE CONFIG_BT_NIMBLE_MSYS1_BLOCK_SIZE
 #endif
 
 #ifndef MYNEWT_VAL_MSYS_1_SANITY_MIN_COUNT
@@ -30,11 +38,31 @@
 #endif
 
 #ifndef MYNEWT_VAL_MSYS_2_BLOCK_COUNT
-#define MYNEWT_VAL_MSYS_2_BLOCK_COUNT (0)
+#define MYNEWT_VAL_MSYS_2_BLOCK_COUNT CONFIG_BT_NIMBLE_MSYS2_BLOCK_COUNT
 #endif
 
 #ifndef MYNEWT_VAL_MSYS_2_BLOCK_SIZE
-#define MYNEWT_VAL_MSYS_2_BLOCK_SIZE (0)
+#define MYNEWT_VAL_MSYS_2_BLOCK_SIZE CONFIG_BT_NIMBLE_MSYS2_BLOCK_SIZE
+#endif
+
+#ifndef MYNEWT_VAL_MSYS_3_BLOCK_COUNT
+#define MYNEWT_VAL_MSYS_3_BLOCK_COUNT CONFIG_BT_NIMBLE_MSYS3_BLOCK_COUNT
+#endif
+
+#ifndef MYNEWT_VAL_MSYS_3_BLOCK_SIZE
+#define MYNEWT_VAL_MSYS_3_BLOCK_SIZE CONFIG_BT_NIMBLE_MSYS3_BLOCK_SIZE
+#endif
+
+#ifndef MYNEWT_VAL_MSYS_4_BLOCK_COUNT
+#define MYNEWT_VAL_MSYS_4_BLOCK_COUNT CONFIG_BT_NIMBLE_MSYS4_BLOCK_COUNT
+#endif
+
+#ifndef MYNEWT_VAL_MSYS_4_BLOCK_SIZE
+#define MYNEWT_VAL_MSYS_4_BLOCK_SIZE CONFIG_BT_NIMBLE_MSYS4_BLOCK_SIZE
+#endif
+
+#ifndef MYNEWT_VAL_MSYS_CALIBRATE
+#define MYNEWT_VAL_MSYS_CALIBRATE CONFIG_BT_NIMBLE_MSYS_CALIBRATE
 #endif
 
 #ifndef MYNEWT_VAL_OS_CPUTIME_FREQ
@@ -128,6 +156,10 @@
 #define MYNEWT_VAL_BLE_LL_ADD_STRICT_SCHED_PERIODS (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_ADV_SCHED_MISSED_MAX
+#define MYNEWT_VAL_BLE_LL_ADV_SCHED_MISSED_MAX (2)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_CFG_FEAT_CONN_PARAM_REQ
 #define MYNEWT_VAL_BLE_LL_CFG_FEAT_CONN_PARAM_REQ (1)
 #endif
@@ -210,6 +242,10 @@
 #define MYNEWT_VAL_BLE_LL_NUM_SCAN_DUP_ADVS (8)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_SCAN_DUP_AGE_MS
+#define MYNEWT_VAL_BLE_LL_SCAN_DUP_AGE_MS (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_NUM_SCAN_RSP_ADVS
 #define MYNEWT_VAL_BLE_LL_NUM_SCAN_RSP_ADVS (8)
 #endif
@@ -246,6 +282,10 @@
 #define MYNEWT_VAL_BLE_LL_SYSVIEW (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_LL_TRACE_RING_SIZE
+#define MYNEWT_VAL_BLE_LL_TRACE_RING_SIZE (0)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_LL_TX_PWR_DBM
 #define MYNEWT_VAL_BLE_LL_TX_PWR_DBM (0)
 #endif
@@ -296,8 +336,12 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_PERIODIC_ADV_SYNC_TRANSFER
+#ifdef CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER
+#define MYNEWT_VAL_BLE_PERIODIC_ADV_SYNC_TRANSFER (CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER)
+#else
 #define MYNEWT_VAL_BLE_PERIODIC_ADV_SYNC_TRANSFER (0)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_VERSION
 #define MYNEWT_VAL_BLE_VERSION (50)
@@ -399,6 +443,22 @@
 #define MYNEWT_VAL_BLE_GATT_MAX_PROCS (4)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_GATT_NOTIFY_MULTIPLE
+#ifdef CONFIG_BT_NIMBLE_GATT_NOTIFY_MULTIPLE
+#define MYNEWT_VAL_BLE_GATT_NOTIFY_MULTIPLE (CONFIG_BT_NIMBLE_GATT_NOTIFY_MULTIPLE)
+#else
+#define MYNEWT_VAL_BLE_GATT_NOTIFY_MULTIPLE (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_GATT_ROBUST_CACHING
+#ifdef CONFIG_BT_NIMBLE_GATT_ROBUST_CACHING
+#define MYNEWT_VAL_BLE_GATT_ROBUST_CACHING (CONFIG_BT_NIMBLE_GATT_ROBUST_CACHING)
+#else
+#define MYNEWT_VAL_BLE_GATT_ROBUST_CACHING (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_GATT_NOTIFY
 #define MYNEWT_VAL_BLE_GATT_NOTIFY (1)
 #endif
@@ -440,8 +500,12 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_GATT_WRITE_MAX_ATTRS
+#ifdef CONFIG_BT_NIMBLE_GATT_WRITE_MAX_ATTRS
+#define MYNEWT_VAL_BLE_GATT_WRITE_MAX_ATTRS (CONFIG_BT_NIMBLE_GATT_WRITE_MAX_ATTRS)
+#else
 #define MYNEWT_VAL_BLE_GATT_WRITE_MAX_ATTRS (4)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_GATT_WRITE_NO_RSP
 #define MYNEWT_VAL_BLE_GATT_WRITE_NO_RSP (MYNEWT_VAL_BLE_ROLE_CENTRAL)
@@ -471,6 +535,14 @@
 #endif
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_TRACE_SIZE
+#ifdef CONFIG_BT_NIMBLE_TRACE_SIZE
+#define MYNEWT_VAL_BLE_HS_TRACE_SIZE (CONFIG_BT_NIMBLE_TRACE_SIZE)
+#else
+#define MYNEWT_VAL_BLE_HS_TRACE_SIZE (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_SM_SC_DEBUG_KEYS
 #ifdef CONFIG_BT_NIMBLE_SM_SC_DEBUG_KEYS
 #define MYNEWT_VAL_BLE_SM_SC_DEBUG_KEYS (1)
@@ -503,6 +575,46 @@
 #define MYNEWT_VAL_BLE_HS_FLOW_CTRL_TX_ON_DISCONNECT CONFIG_BT_NIMBLE_HS_FLOW_CTRL_TX_ON_DISCONNECT
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE
+#ifdef CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE (CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE)
+#else
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS
+#ifdef CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS (CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS)
+#else
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS (4)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE
+#ifdef CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE (CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE)
+#else
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE (4)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS
+#ifdef CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS (CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS)
+#else
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS (50)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_HCI_CMD_PIPELINE
+#ifdef CONFIG_BT_NIMBLE_HCI_CMD_PIPELINE
+#define MYNEWT_VAL_BLE_HS_HCI_CMD_PIPELINE (CONFIG_BT_NIMBLE_HCI_CMD_PIPELINE)
+#else
+#define MYNEWT_VAL_BLE_HS_HCI_CMD_PIPELINE (4)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_PHONY_HCI_ACKS
 #define MYNEWT_VAL_BLE_HS_PHONY_HCI_ACKS (0)
 #endif
@@ -511,6 +623,14 @@
 #define MYNEWT_VAL_BLE_HS_REQUIRE_OS (1)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_RX_ROUND_ROBIN
+#ifdef CONFIG_BT_NIMBLE_HS_RX_ROUND_ROBIN
+#define MYNEWT_VAL_BLE_HS_RX_ROUND_ROBIN (CONFIG_BT_NIMBLE_HS_RX_ROUND_ROBIN)
+#else
+#define MYNEWT_VAL_BLE_HS_RX_ROUND_ROBIN (1)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_STOP_ON_SHUTDOWN
 #define MYNEWT_VAL_BLE_HS_STOP_ON_SHUTDOWN (1)
 #endif
@@ -559,9 +679,37 @@
 #define MYNEWT_VAL_BLE_MONITOR_CONSOLE_BUFFER_SIZE (128)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_MONITOR_RAM
+#if defined(CONFIG_BT_NIMBLE_MONITOR_RAM_SIZE) && CONFIG_BT_NIMBLE_MONITOR_RAM_SIZE > 0
+#define MYNEWT_VAL_BLE_MONITOR_RAM (1)
+#else
+#define MYNEWT_VAL_BLE_MONITOR_RAM (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_MONITOR_RAM_BUFFER_SIZE
+#ifdef CONFIG_BT_NIMBLE_MONITOR_RAM_SIZE
+#define MYNEWT_VAL_BLE_MONITOR_RAM_BUFFER_SIZE (CONFIG_BT_NIMBLE_MONITOR_RAM_SIZE)
+#else
+#define MYNEWT_VAL_BLE_MONITOR_RAM_BUFFER_SIZE (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_MONITOR_REPLAY
+#ifdef CONFIG_BT_NIMBLE_MONITOR_REPLAY
+#define MYNEWT_VAL_BLE_MONITOR_REPLAY (1)
+#else
+#define MYNEWT_VAL_BLE_MONITOR_REPLAY (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_MONITOR_RTT
+#ifdef CONFIG_BT_NIMBLE_MONITOR_RTT
+#define MYNEWT_VAL_BLE_MONITOR_RTT (1)
+#else
 #define MYNEWT_VAL_BLE_MONITOR_RTT (0)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_RTT_BUFFERED
 #define MYNEWT_VAL_BLE_MONITOR_RTT_BUFFERED (1)
@@ -572,20 +720,54 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_RTT_BUFFER_SIZE
+#ifdef CONFIG_BT_NIMBLE_MONITOR_RTT_BUFFER_SIZE
+#define MYNEWT_VAL_BLE_MONITOR_RTT_BUFFER_SIZE (CONFIG_BT_NIMBLE_MONITOR_RTT_BUFFER_SIZE)
+#else
 #define MYNEWT_VAL_BLE_MONITOR_RTT_BUFFER_SIZE (256)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_UART
+#if defined(CONFIG_BT_NIMBLE_MONITOR_UART) && defined(ESP_PLATFORM)
+#define MYNEWT_VAL_BLE_MONITOR_UART (1)
+#else
 #define MYNEWT_VAL_BLE_MONITOR_UART (0)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_UART_BAUDRATE
+#ifdef CONFIG_BT_NIMBLE_MONITOR_UART_BAUDRATE
+#define MYNEWT_VAL_BLE_MONITOR_UART_BAUDRATE (CONFIG_BT_NIMBLE_MONITOR_UART_BAUDRATE)
+#else
 #define MYNEWT_VAL_BLE_MONITOR_UART_BAUDRATE (1000000)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_UART_BUFFER_SIZE
+#ifdef CONFIG_BT_NIMBLE_MONITOR_UART_BUFFER_SIZE
+#define MYNEWT_VAL_BLE_MONITOR_UART_BUFFER_SIZE (CONFIG_BT_NIMBLE_MONITOR_UART_BUFFER_SIZE)
+#elif defined(ESP_PLATFORM)
+#define MYNEWT_VAL_BLE_MONITOR_UART_BUFFER_SIZE (4096)
+#else
 #define MYNEWT_VAL_BLE_MONITOR_UART_BUFFER_SIZE (64)
 #endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_MONITOR_UART_PORT
+#ifdef CONFIG_BT_NIMBLE_MONITOR_UART_PORT
+#define MYNEWT_VAL_BLE_MONITOR_UART_PORT (CONFIG_BT_NIMBLE_MONITOR_UART_PORT)
+#else
+#define MYNEWT_VAL_BLE_MONITOR_UART_PORT (1)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_MONITOR_UART_TX_PIN
+#ifdef CONFIG_BT_NIMBLE_MONITOR_UART_TX_PIN
+#define MYNEWT_VAL_BLE_MONITOR_UART_TX_PIN (CONFIG_BT_NIMBLE_MONITOR_UART_TX_PIN)
+#else
+#define MYNEWT_VAL_BLE_MONITOR_UART_TX_PIN (-1)
+#endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MONITOR_UART_DEV
 #define MYNEWT_VAL_BLE_MONITOR_UART_DEV ("uart0")
@@ -599,6 +781,14 @@
 #endif
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_RPA_CACHE_SIZE
+#ifdef CONFIG_BT_NIMBLE_RPA_CACHE_SIZE
+#define MYNEWT_VAL_BLE_HS_RPA_CACHE_SIZE (CONFIG_BT_NIMBLE_RPA_CACHE_SIZE)
+#else
+#define MYNEWT_VAL_BLE_HS_RPA_CACHE_SIZE (8)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_RPA_TIMEOUT
 #define MYNEWT_VAL_BLE_RPA_TIMEOUT (CONFIG_BT_NIMBLE_RPA_TIMEOUT)
 #endif
@@ -624,8 +814,20 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_SM_MAX_PROCS
+#ifdef CONFIG_BT_NIMBLE_SM_MAX_PROCS
+#define MYNEWT_VAL_BLE_SM_MAX_PROCS (CONFIG_BT_NIMBLE_SM_MAX_PROCS)
+#else
 #define MYNEWT_VAL_BLE_SM_MAX_PROCS (1)
 #endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_SM_PAIR_QUEUE_SIZE
+#ifdef CONFIG_BT_NIMBLE_SM_PAIR_QUEUE_SIZE
+#define MYNEWT_VAL_BLE_SM_PAIR_QUEUE_SIZE (CONFIG_BT_NIMBLE_SM_PAIR_QUEUE_SIZE)
+#else
+#define MYNEWT_VAL_BLE_SM_PAIR_QUEUE_SIZE (0)
+#endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_SM_MITM
 #define MYNEWT_VAL_BLE_SM_MITM (0)
@@ -655,6 +857,30 @@
 #define MYNEWT_VAL_BLE_CRYPTO_STACK_MBEDTLS (CONFIG_BT_NIMBLE_CRYPTO_STACK_MBEDTLS)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK
+#ifdef CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK
+#define MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK (CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK)
+#else
+#define MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK_STACK_SIZE
+#ifdef CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK_STACK_SIZE
+#define MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK_STACK_SIZE (CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK_STACK_SIZE)
+#else
+#define MYNEWT_VAL_BLE_SM_SC_CRYPTO_TASK_STACK_SIZE (4096)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_SM_SC_KEY_ROTATE_MS
+#ifdef CONFIG_BT_NIMBLE_SM_SC_KEY_ROTATE_MS
+#define MYNEWT_VAL_BLE_SM_SC_KEY_ROTATE_MS (CONFIG_BT_NIMBLE_SM_SC_KEY_ROTATE_MS)
+#else
+#define MYNEWT_VAL_BLE_SM_SC_KEY_ROTATE_MS (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_STORE_MAX_BONDS
 #define MYNEWT_VAL_BLE_STORE_MAX_BONDS CONFIG_BT_NIMBLE_MAX_BONDS
 #endif
@@ -663,6 +889,30 @@
 #define MYNEWT_VAL_BLE_STORE_MAX_CCCDS CONFIG_BT_NIMBLE_MAX_CCCDS
 #endif
 
+#ifndef MYNEWT_VAL_BLE_STORE_NVS_COMMIT_DELAY_MS
+#ifdef CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS
+#define MYNEWT_VAL_BLE_STORE_NVS_COMMIT_DELAY_MS (CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS)
+#else
+#define MYNEWT_VAL_BLE_STORE_NVS_COMMIT_DELAY_MS (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_STORE_NVS_DEFER_SEC
+#ifdef CONFIG_BT_NIMBLE_NVS_DEFER_SEC
+#define MYNEWT_VAL_BLE_STORE_NVS_DEFER_SEC (CONFIG_BT_NIMBLE_NVS_DEFER_SEC)
+#else
+#define MYNEWT_VAL_BLE_STORE_NVS_DEFER_SEC (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_STORE_NVS_LAZY_LOAD
+#ifdef CONFIG_BT_NIMBLE_NVS_LAZY_LOAD
+#define MYNEWT_VAL_BLE_STORE_NVS_LAZY_LOAD (CONFIG_BT_NIMBLE_NVS_LAZY_LOAD)
+#else
+#define MYNEWT_VAL_BLE_STORE_NVS_LAZY_LOAD (0)
+#endif
+#endif
+
 /*** @apache-mynewt-nimble/nimble/host/mesh */
 #ifndef MYNEWT_VAL_BLE_MESH_ACCESS_LOG_LVL
 #define MYNEWT_VAL_BLE_MESH_ACCESS_LOG_LVL (1)
@@ -830,6 +1080,14 @@
 #endif
 #endif
 
+#ifndef MYNEWT_VAL_BLE_MESH_FRIEND_BUF_COUNT
+#ifdef CONFIG_BT_NIMBLE_MESH_FRIEND_BUF_COUNT
+#define MYNEWT_VAL_BLE_MESH_FRIEND_BUF_COUNT (CONFIG_BT_NIMBLE_MESH_FRIEND_BUF_COUNT)
+#else
+#define MYNEWT_VAL_BLE_MESH_FRIEND_BUF_COUNT (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_MESH_FRIEND_LOG_LVL
 #define MYNEWT_VAL_BLE_MESH_FRIEND_LOG_LVL (1)
 #endif
@@ -839,12 +1097,20 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_FRIEND_LPN_COUNT
+#ifdef CONFIG_BT_NIMBLE_MESH_FRIEND_LPN_COUNT
+#define MYNEWT_VAL_BLE_MESH_FRIEND_LPN_COUNT (CONFIG_BT_NIMBLE_MESH_FRIEND_LPN_COUNT)
+#else
 #define MYNEWT_VAL_BLE_MESH_FRIEND_LPN_COUNT (2)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_FRIEND_QUEUE_SIZE
+#ifdef CONFIG_BT_NIMBLE_MESH_FRIEND_QUEUE_SIZE
+#define MYNEWT_VAL_BLE_MESH_FRIEND_QUEUE_SIZE (CONFIG_BT_NIMBLE_MESH_FRIEND_QUEUE_SIZE)
+#else
 #define MYNEWT_VAL_BLE_MESH_FRIEND_QUEUE_SIZE (16)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_FRIEND_RECV_WIN
 #define MYNEWT_VAL_BLE_MESH_FRIEND_RECV_WIN (255)
@@ -978,9 +1244,21 @@
 #define MYNEWT_VAL_BLE_MESH_MODEL_LOG_MOD (16)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_MESH_OP_INDEX_SIZE
+#ifdef CONFIG_BT_NIMBLE_MESH_OP_INDEX_SIZE
+#define MYNEWT_VAL_BLE_MESH_OP_INDEX_SIZE (CONFIG_BT_NIMBLE_MESH_OP_INDEX_SIZE)
+#else
+#define MYNEWT_VAL_BLE_MESH_OP_INDEX_SIZE (64)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_MESH_MSG_CACHE_SIZE
+#ifdef CONFIG_BT_NIMBLE_MESH_MSG_CACHE_SIZE
+#define MYNEWT_VAL_BLE_MESH_MSG_CACHE_SIZE (CONFIG_BT_NIMBLE_MESH_MSG_CACHE_SIZE)
+#else
 #define MYNEWT_VAL_BLE_MESH_MSG_CACHE_SIZE (10)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_NET_LOG_LVL
 #define MYNEWT_VAL_BLE_MESH_NET_LOG_LVL (1)
@@ -1051,6 +1329,14 @@
 #define MYNEWT_VAL_BLE_MESH_CDB (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_MESH_PROV_QUEUE_SIZE
+#ifdef CONFIG_BT_NIMBLE_MESH_PROV_QUEUE_SIZE
+#define MYNEWT_VAL_BLE_MESH_PROV_QUEUE_SIZE CONFIG_BT_NIMBLE_MESH_PROV_QUEUE_SIZE
+#else
+#define MYNEWT_VAL_BLE_MESH_PROV_QUEUE_SIZE (0)
+#endif
+#endif
+
 #ifndef MYNEWT_VAL_BLE_MESH_PROV_LOG_LVL
 #define MYNEWT_VAL_BLE_MESH_PROV_LOG_LVL (1)
 #endif
@@ -1089,32 +1375,52 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_RPL_STORE_TIMEOUT
+#ifdef CONFIG_BT_NIMBLE_MESH_RPL_STORE_TIMEOUT
+#define MYNEWT_VAL_BLE_MESH_RPL_STORE_TIMEOUT (CONFIG_BT_NIMBLE_MESH_RPL_STORE_TIMEOUT)
+#else
 #define MYNEWT_VAL_BLE_MESH_RPL_STORE_TIMEOUT (5)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_RX_SDU_MAX
 #define MYNEWT_VAL_BLE_MESH_RX_SDU_MAX (72)
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_SEG_BUFS
+#ifdef CONFIG_BT_NIMBLE_MESH_SEG_BUFS
+#define MYNEWT_VAL_BLE_MESH_SEG_BUFS (CONFIG_BT_NIMBLE_MESH_SEG_BUFS)
+#else
 #define MYNEWT_VAL_BLE_MESH_SEG_BUFS (72)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_RX_SEG_MAX
+#ifdef CONFIG_BT_NIMBLE_MESH_RX_SEG_MAX
+#define MYNEWT_VAL_BLE_MESH_RX_SEG_MAX (CONFIG_BT_NIMBLE_MESH_RX_SEG_MAX)
+#else
 #define MYNEWT_VAL_BLE_MESH_RX_SEG_MAX (3)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_RX_SEG_MSG_COUNT
+#ifdef CONFIG_BT_NIMBLE_MESH_RX_SEG_MSG_COUNT
+#define MYNEWT_VAL_BLE_MESH_RX_SEG_MSG_COUNT (CONFIG_BT_NIMBLE_MESH_RX_SEG_MSG_COUNT)
+#else
 #define MYNEWT_VAL_BLE_MESH_RX_SEG_MSG_COUNT (2)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_SEG_RETRANSMIT_ATTEMPTS
 #define MYNEWT_VAL_BLE_MESH_SEG_RETRANSMIT_ATTEMPTS (4)
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_SEQ_STORE_RATE
+#ifdef CONFIG_BT_NIMBLE_MESH_SEQ_STORE_RATE
+#define MYNEWT_VAL_BLE_MESH_SEQ_STORE_RATE (CONFIG_BT_NIMBLE_MESH_SEQ_STORE_RATE)
+#else
 #define MYNEWT_VAL_BLE_MESH_SEQ_STORE_RATE (128)
 #endif
+#endif
 
 
 #ifndef MYNEWT_VAL_BLE_MESH_TX_SEG_RETRANS_COUNT
@@ -1195,8 +1501,12 @@
 #endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_STORE_TIMEOUT
+#ifdef CONFIG_BT_NIMBLE_MESH_STORE_TIMEOUT
+#define MYNEWT_VAL_BLE_MESH_STORE_TIMEOUT (CONFIG_BT_NIMBLE_MESH_STORE_TIMEOUT)
+#else
 #define MYNEWT_VAL_BLE_MESH_STORE_TIMEOUT (2)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_SUBNET_COUNT
 #define MYNEWT_VAL_BLE_MESH_SUBNET_COUNT (1)
@@ -1224,12 +1534,20 @@
 
 /* Overridden by apps/blemesh (defined by @apache-mynewt-nimble/nimble/host/mesh) */
 #ifndef MYNEWT_VAL_BLE_MESH_TX_SEG_MAX
+#ifdef CONFIG_BT_NIMBLE_MESH_TX_SEG_MAX
+#define MYNEWT_VAL_BLE_MESH_TX_SEG_MAX (CONFIG_BT_NIMBLE_MESH_TX_SEG_MAX)
+#else
 #define MYNEWT_VAL_BLE_MESH_TX_SEG_MAX (6)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_TX_SEG_MSG_COUNT
+#ifdef CONFIG_BT_NIMBLE_MESH_TX_SEG_MSG_COUNT
+#define MYNEWT_VAL_BLE_MESH_TX_SEG_MSG_COUNT (CONFIG_BT_NIMBLE_MESH_TX_SEG_MSG_COUNT)
+#else
 #define MYNEWT_VAL_BLE_MESH_TX_SEG_MSG_COUNT (4)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_MESH_UNPROV_BEACON_INT
 #define MYNEWT_VAL_BLE_MESH_UNPROV_BEACON_INT (5)
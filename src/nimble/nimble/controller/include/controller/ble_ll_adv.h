@@ -202,6 +202,42 @@ int ble_ll_adv_periodic_set_info_transfer(const uint8_t *cmdbuf, uint8_t len,
 /* Called to notify adv code about RPA rotation */
 void ble_ll_adv_rpa_timeout(void);
 
+/*
+ * Whether the advertising set missed BLE_LL_ADV_SCHED_MISSED_MAX events in a
+ * row, its next event then takes precedence over connection events.
+ */
+int ble_ll_adv_sched_overdue(struct ble_ll_adv_sm *advsm);
+
+/*
+ * Advertising event scheduling statistics of one advertising set, used to
+ * check that a set holds its interval next to connections and other sets.
+ *
+ *  events: Advertising events sent.
+ *  missed: Events not sent, for lack of room in the schedule or because
+ *  another item took their place.
+ *  overdue_events: Events sent after BLE_LL_ADV_SCHED_MISSED_MAX were missed
+ *  in a row, with precedence over connection events.
+ *  itvl_req_usecs: The advertising interval of the set.
+ *  itvl_avg_usecs/itvl_max_usecs: The average and longest time between the
+ *  start of two events sent, including the random advertising delay.
+ */
+struct ble_ll_adv_sched_stats
+{
+    uint32_t events;
+    uint32_t missed;
+    uint32_t overdue_events;
+    uint32_t itvl_req_usecs;
+    uint32_t itvl_avg_usecs;
+    uint32_t itvl_max_usecs;
+};
+
+/* Get the scheduling statistics of an advertising set */
+int ble_ll_adv_sched_stats_get(uint8_t instance,
+                               struct ble_ll_adv_sched_stats *stats);
+
+/* Clear the scheduling statistics of an advertising set */
+int ble_ll_adv_sched_stats_reset(uint8_t instance);
+
 #ifdef __cplusplus
 }
 #endif
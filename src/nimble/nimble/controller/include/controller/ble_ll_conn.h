@@ -211,6 +211,16 @@ struct hci_ext_create_conn
 };
 
 /* Connection state machine */
+/* Packets per connection event counters of a connection */
+struct ble_ll_conn_ce_stats
+{
+    uint32_t events;        /* connection events that have ended */
+    uint32_t tx_pdus;       /* PDUs transmitted, including empty PDUs */
+    uint32_t rx_pdus;       /* PDUs received with a valid CRC */
+    uint16_t max_pdus;      /* most PDUs (tx + rx) in one connection event */
+    uint16_t max_ce_usecs;  /* configured event length limit, 0: none */
+};
+
 struct ble_ll_conn_sm
 {
     /* Connection state machine flags */
@@ -318,6 +328,18 @@ struct ble_ll_conn_sm
     uint32_t slave_cur_window_widening;
     uint32_t last_rxd_pdu_cputime;  /* Used exclusively for supervision timer */
 
+    /*
+     * Connection event length limit set by ble_ll_conn_ce_len_set, 0 lets
+     * the event run while there is data until the next scheduled item.
+     */
+    uint16_t max_ce_usecs;
+    uint32_t max_ce_ticks;
+
+    /* Packets per connection event */
+    uint16_t ce_tx_pdus;
+    uint16_t ce_rx_pdus;
+    struct ble_ll_conn_ce_stats ce_stats;
+
     /*
      * Used to mark that identity address was used as InitA
      */
@@ -421,6 +443,13 @@ struct ble_ll_conn_sm *ble_ll_conn_find_active_conn(uint16_t handle);
 /* required for unit testing */
 uint8_t ble_ll_conn_calc_dci(struct ble_ll_conn_sm *conn, uint16_t latency);
 
+/* Limit the length of the connection events of a connection */
+int ble_ll_conn_ce_len_set(uint16_t handle, uint16_t max_ce_usecs);
+
+/* Get and reset the packets per connection event counters of a connection */
+int ble_ll_conn_ce_stats_get(uint16_t handle, struct ble_ll_conn_ce_stats *stats);
+int ble_ll_conn_ce_stats_reset(uint16_t handle);
+
 /* used to get anchor point for connection event specified */
 void ble_ll_conn_get_anchor(struct ble_ll_conn_sm *connsm, uint16_t conn_event,
                             uint32_t *anchor, uint8_t *anchor_usecs);
@@ -106,6 +106,29 @@ int ble_ll_resolv_rpa(const uint8_t *rpa, const uint8_t *irk);
 /* Try to resolve peer RPA and return index on RL if matched */
 int ble_ll_resolv_peer_rpa_any(const uint8_t *rpa);
 
+/* Address resolution statistics */
+struct ble_ll_resolv_stats
+{
+    /* RPAs resolved by HW while receiving */
+    uint32_t hw_resolved;
+    /* RPAs resolved in software by the RL entries not in HW list */
+    uint32_t sw_resolved;
+    /* RPAs not resolved by either */
+    uint32_t unresolved;
+    /* RL entries with peer IRK in HW list */
+    uint8_t hw_entries;
+    /* RL entries with peer IRK resolved in software */
+    uint8_t sw_entries;
+};
+
+/* Try to resolve peer RPA with the RL entries not in HW list */
+int ble_ll_resolv_peer_rpa_overflow(const uint8_t *rpa);
+
+/* Get address resolution statistics */
+void ble_ll_resolv_get_stats(struct ble_ll_resolv_stats *stats);
+
+extern struct ble_ll_resolv_stats g_ble_ll_resolv_stats;
+
 /* Initialize resolv*/
 void ble_ll_resolv_init(void);
 
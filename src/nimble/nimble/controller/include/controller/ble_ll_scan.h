@@ -230,6 +230,9 @@ int ble_ll_scan_can_chg_whitelist(void);
 /* Boolean function returning true if scanning enabled */
 int ble_ll_scan_enabled(void);
 
+/* Configure the size and data change detection of the duplicate filter */
+int ble_ll_scan_dup_cfg_set(uint16_t size, uint8_t data_filter);
+
 /* Boolean function returns true if whitelist is enabled for scanning */
 int ble_ll_scan_whitelist_enabled(void);
 
@@ -71,6 +71,7 @@ extern uint8_t g_ble_ll_sched_offset_ticks;
 #define BLE_LL_SCHED_TYPE_DTM       (5)
 #define BLE_LL_SCHED_TYPE_PERIODIC  (6)
 #define BLE_LL_SCHED_TYPE_SYNC      (7)
+#define BLE_LL_SCHED_TYPE_MAX       (7)
 
 /* Return values for schedule callback. */
 #define BLE_LL_SCHED_STATE_RUNNING  (0)
@@ -205,6 +206,40 @@ int ble_ll_sched_scan_req_over_aux_ptr(uint32_t chan, uint8_t phy_mode);
 /* Stop the scheduler */
 void ble_ll_sched_stop(void);
 
+/*
+ * Scheduler statistics, used to tune intervals when running many links.
+ *
+ *  insert_fail: Items that could not be put on the schedule, by type. For
+ *  connections these are skipped connection events.
+ *  removed: Items taken off the schedule by another item, by type.
+ *  preempt_scan/preempt_initiating: Scan windows cut short by an item.
+ *  overrun_adv/overrun_sync/overrun_conn: Events still running when the next
+ *  item had to start, so were halted.
+ *  late_starts: Items started later than the schedule offset.
+ *  max_late_ticks: The latest start seen, in cputime ticks.
+ *  conn_yield_adv: Connection events skipped or removed for the event of an
+ *  advertising set that missed BLE_LL_ADV_SCHED_MISSED_MAX events in a row.
+ */
+struct ble_ll_sched_stats
+{
+    uint32_t insert_fail[BLE_LL_SCHED_TYPE_MAX + 1];
+    uint32_t removed[BLE_LL_SCHED_TYPE_MAX + 1];
+    uint32_t preempt_scan;
+    uint32_t preempt_initiating;
+    uint32_t overrun_adv;
+    uint32_t overrun_sync;
+    uint32_t overrun_conn;
+    uint32_t late_starts;
+    uint32_t max_late_ticks;
+    uint32_t conn_yield_adv;
+};
+
+/* Get a copy of the scheduler statistics */
+void ble_ll_sched_stats_get(struct ble_ll_sched_stats *stats);
+
+/* Clear the scheduler statistics */
+void ble_ll_sched_stats_reset(void);
+
 #if MYNEWT_VAL(BLE_LL_DTM)
 int ble_ll_sched_dtm(struct ble_ll_sched_item *sch);
 #endif
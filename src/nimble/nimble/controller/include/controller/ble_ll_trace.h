@@ -40,6 +40,50 @@ extern "C" {
 #define BLE_LL_TRACE_ID_ADV_HALT                11
 #define BLE_LL_TRACE_ID_AUX_REF                 12
 #define BLE_LL_TRACE_ID_AUX_UNREF               13
+#define BLE_LL_TRACE_ID_SCHED_FAIL              14
+#define BLE_LL_TRACE_ID_SCHED_RMVD              15
+#define BLE_LL_TRACE_ID_SCHED_LATE              16
+#define BLE_LL_TRACE_ID_SCHED_OVERRUN           17
+#define BLE_LL_TRACE_ID_ADV_MISSED              18
+#define BLE_LL_TRACE_ID_SCHED_ADV_PRIO          19
+
+#define BLE_LL_TRACE_ID_COUNT                   20
+
+#if MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE) > 0
+
+/*
+ * Trace events are also kept in a ring buffer of BLE_LL_TRACE_RING_SIZE
+ * entries, which overwrites the oldest entries when full.
+ */
+struct ble_ll_trace_entry
+{
+    uint32_t cputime;
+    uint32_t id;
+    uint32_t p1;
+    uint32_t p2;
+    uint32_t p3;
+};
+
+void ble_ll_trace_ring_add(unsigned id, uint32_t p1, uint32_t p2, uint32_t p3);
+
+/*
+ * Copies up to max_entries of the oldest entries and removes them from the
+ * ring. Returns the number of entries copied.
+ */
+int ble_ll_trace_ring_read(struct ble_ll_trace_entry *entries,
+                           int max_entries);
+
+/* Number of entries overwritten before they were read */
+uint32_t ble_ll_trace_ring_lost(void);
+
+#define BLE_LL_TRACE_RING_ADD(_id, _p1, _p2, _p3) \
+    ble_ll_trace_ring_add(_id, _p1, _p2, _p3)
+
+#else
+
+#define BLE_LL_TRACE_RING_ADD(_id, _p1, _p2, _p3)
+
+#endif
 
 #if MYNEWT_VAL(BLE_LL_SYSVIEW)
 
@@ -51,18 +95,21 @@ static inline void
 ble_ll_trace_u32(unsigned id, uint32_t p1)
 {
     os_trace_api_u32(ble_ll_trace_off + id, p1);
+    BLE_LL_TRACE_RING_ADD(id, p1, 0, 0);
 }
 
 static inline void
 ble_ll_trace_u32x2(unsigned id, uint32_t p1, uint32_t p2)
 {
     os_trace_api_u32x2(ble_ll_trace_off + id, p1, p2);
+    BLE_LL_TRACE_RING_ADD(id, p1, p2, 0);
 }
 
 static inline void
 ble_ll_trace_u32x3(unsigned id, uint32_t p1, uint32_t p2, uint32_t p3)
 {
     os_trace_api_u32x3(ble_ll_trace_off + id, p1, p2, p3);
+    BLE_LL_TRACE_RING_ADD(id, p1, p2, p3);
 }
 
 #else
@@ -75,16 +122,19 @@ ble_ll_trace_init(void)
 static inline void
 ble_ll_trace_u32(unsigned id, uint32_t p1)
 {
+    BLE_LL_TRACE_RING_ADD(id, p1, 0, 0);
 }
 
 static inline void
 ble_ll_trace_u32x2(unsigned id, uint32_t p1, uint32_t p2)
 {
+    BLE_LL_TRACE_RING_ADD(id, p1, p2, 0);
 }
 
 static inline void
 ble_ll_trace_u32x3(unsigned id, uint32_t p1, uint32_t p2, uint32_t p3)
 {
+    BLE_LL_TRACE_RING_ADD(id, p1, p2, p3);
 }
 
 #endif
@@ -87,6 +87,29 @@ struct ble_ll_adv_sync {
     uint8_t payload_len;
 };
 
+/*
+ * Scheduling accounting of an advertising set
+ *
+ *  missed_run: Events missed in a row, cleared when an event is sent.
+ *  event_txd: The first PDU of the current event was sent.
+ *  last_valid: last_txd holds the start of an event sent since the set was
+ *  enabled.
+ *  last_txd: Start time of the last event sent, in cputime ticks.
+ *  itvl_sum/itvl_cnt/itvl_max: Ticks between the start of two events sent.
+ */
+struct ble_ll_adv_sched_acct {
+    uint8_t missed_run;
+    uint8_t event_txd : 1;
+    uint8_t last_valid : 1;
+    uint32_t last_txd;
+    uint32_t events;
+    uint32_t missed;
+    uint32_t overdue_events;
+    uint32_t itvl_cnt;
+    uint32_t itvl_max;
+    uint64_t itvl_sum;
+};
+
 /*
  * Advertising state machine
  *
@@ -135,6 +158,7 @@ struct ble_ll_adv_sm
     uint8_t *conn_comp_ev;
     struct ble_npl_event adv_txdone_ev;
     struct ble_ll_sched_item adv_sch;
+    struct ble_ll_adv_sched_acct sched_acct;
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_CSA2)
     uint16_t channel_id;
     uint16_t event_cntr;
@@ -444,6 +468,104 @@ ble_ll_adv_final_chan(struct ble_ll_adv_sm *advsm)
     return adv_chan;
 }
 
+/**
+ * Accounts an advertising event whose first PDU is being sent.
+ *
+ * Context: Interrupt (scheduler)
+ *
+ * @param advsm
+ * @param txstart The start time of the PDU, in cputime ticks.
+ */
+static void
+ble_ll_adv_sched_event_txd(struct ble_ll_adv_sm *advsm, uint32_t txstart)
+{
+    struct ble_ll_adv_sched_acct *acct;
+    uint32_t itvl;
+
+    acct = &advsm->sched_acct;
+    if (acct->event_txd) {
+        return;
+    }
+
+    if (acct->last_valid) {
+        itvl = txstart - acct->last_txd;
+        acct->itvl_sum += itvl;
+        acct->itvl_cnt++;
+        if (itvl > acct->itvl_max) {
+            acct->itvl_max = itvl;
+        }
+    }
+
+    if (ble_ll_adv_sched_overdue(advsm)) {
+        acct->overdue_events++;
+    }
+
+    acct->events++;
+    acct->missed_run = 0;
+    acct->event_txd = 1;
+    acct->last_valid = 1;
+    acct->last_txd = txstart;
+}
+
+/**
+ * Accounts the end of an advertising event, sent or not.
+ *
+ * Context: Link Layer task.
+ *
+ * @param advsm
+ */
+static void
+ble_ll_adv_sched_event_end(struct ble_ll_adv_sm *advsm)
+{
+    struct ble_ll_adv_sched_acct *acct;
+    uint8_t missed;
+    os_sr_t sr;
+
+    acct = &advsm->sched_acct;
+    missed = 0;
+
+    OS_ENTER_CRITICAL(sr);
+    if (!acct->event_txd) {
+        acct->missed++;
+        if (acct->missed_run < UINT8_MAX) {
+            acct->missed_run++;
+        }
+        missed = acct->missed_run;
+    }
+    acct->event_txd = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    if (missed) {
+        ble_ll_trace_u32x2(BLE_LL_TRACE_ID_ADV_MISSED, advsm->adv_instance,
+                           missed);
+    }
+}
+
+/**
+ * Checks if an advertising set missed enough events in a row that its next
+ * event takes precedence over connection events. This keeps a set with a long
+ * interval from being starved by connection events that always fall on it,
+ * a connection skips at most one event every BLE_LL_ADV_SCHED_MISSED_MAX + 1
+ * advertising events of the set.
+ *
+ * Context: Interrupt or Link Layer task.
+ *
+ * @param advsm
+ *
+ * @return int 1: overdue, 0: not overdue or the precedence is disabled
+ */
+int
+ble_ll_adv_sched_overdue(struct ble_ll_adv_sm *advsm)
+{
+#if MYNEWT_VAL(BLE_LL_ADV_SCHED_MISSED_MAX) > 0
+    return advsm->adv_enabled &&
+           advsm->sched_acct.missed_run >= MYNEWT_VAL(BLE_LL_ADV_SCHED_MISSED_MAX);
+#else
+    (void)advsm;
+    return 0;
+#endif
+}
+
 /**
  * Create the advertising legacy PDU
  *
@@ -1194,6 +1316,10 @@ ble_ll_adv_tx_start_cb(struct ble_ll_sched_item *sch)
     /* Count # of adv. sent */
     STATS_INC(ble_ll_stats, adv_txg);
 
+    if (advsm->adv_chan == ble_ll_adv_first_chan(advsm)) {
+        ble_ll_adv_sched_event_txd(advsm, txstart);
+    }
+
     return BLE_LL_SCHED_STATE_RUNNING;
 
 adv_tx_done:
@@ -2717,6 +2843,11 @@ ble_ll_adv_sm_start(struct ble_ll_adv_sm *advsm)
     }
 #endif
 
+    /* Intervals are only measured between events of this enable */
+    advsm->sched_acct.missed_run = 0;
+    advsm->sched_acct.event_txd = 0;
+    advsm->sched_acct.last_valid = 0;
+
     /* Set flag telling us that advertising is enabled */
     advsm->adv_enabled = 1;
 
@@ -4698,6 +4829,8 @@ ble_ll_adv_done(struct ble_ll_adv_sm *advsm)
 
         ble_ll_scan_chk_resume();
 
+        ble_ll_adv_sched_event_end(advsm);
+
         /* This event is over. Set adv channel to first one */
         advsm->adv_chan = ble_ll_adv_first_chan(advsm);
 
@@ -5087,6 +5220,89 @@ ble_ll_adv_enabled(void)
     return 0;
 }
 
+/**
+ * Get the scheduling statistics of an advertising set.
+ *
+ * @param instance The advertising instance, 0 with legacy advertising.
+ * @param stats Filled with the statistics.
+ *
+ * @return int 0: success, BLE_ERR_UNK_ADV_INDENT if the instance is unknown.
+ */
+int
+ble_ll_adv_sched_stats_get(uint8_t instance,
+                           struct ble_ll_adv_sched_stats *stats)
+{
+    struct ble_ll_adv_sm *advsm;
+    struct ble_ll_adv_sched_acct acct;
+    os_sr_t sr;
+
+    /* Only instance 0 exists with legacy advertising */
+    if (!ble_ll_hci_adv_mode_ext() && instance != 0) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    advsm = ble_ll_adv_sm_find_configured(instance);
+    if (!advsm) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    acct = advsm->sched_acct;
+    OS_EXIT_CRITICAL(sr);
+
+    stats->events = acct.events;
+    stats->missed = acct.missed;
+    stats->overdue_events = acct.overdue_events;
+    if (advsm->props & BLE_HCI_LE_SET_EXT_ADV_PROP_HD_DIRECTED) {
+        stats->itvl_req_usecs = BLE_LL_ADV_PDU_ITVL_HD_MS_MAX;
+    } else {
+        stats->itvl_req_usecs = (uint32_t)advsm->adv_itvl_max * BLE_LL_ADV_ITVL;
+    }
+    stats->itvl_avg_usecs = acct.itvl_cnt ?
+            os_cputime_ticks_to_usecs((uint32_t)(acct.itvl_sum / acct.itvl_cnt)) : 0;
+    stats->itvl_max_usecs = os_cputime_ticks_to_usecs(acct.itvl_max);
+
+    return 0;
+}
+
+/**
+ * Clear the scheduling statistics of an advertising set.
+ *
+ * @param instance The advertising instance, 0 with legacy advertising.
+ *
+ * @return int 0: success, BLE_ERR_UNK_ADV_INDENT if the instance is unknown.
+ */
+int
+ble_ll_adv_sched_stats_reset(uint8_t instance)
+{
+    struct ble_ll_adv_sm *advsm;
+    os_sr_t sr;
+
+    if (!ble_ll_hci_adv_mode_ext() && instance != 0) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    advsm = ble_ll_adv_sm_find_configured(instance);
+    if (!advsm) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    /* The event in progress and the missed run are kept, the interval is
+     * measured again from the next event sent.
+     */
+    OS_ENTER_CRITICAL(sr);
+    advsm->sched_acct.events = 0;
+    advsm->sched_acct.missed = 0;
+    advsm->sched_acct.overdue_events = 0;
+    advsm->sched_acct.itvl_cnt = 0;
+    advsm->sched_acct.itvl_max = 0;
+    advsm->sched_acct.itvl_sum = 0;
+    advsm->sched_acct.last_valid = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
 static void
 ble_ll_adv_sm_init(struct ble_ll_adv_sm *advsm)
 {
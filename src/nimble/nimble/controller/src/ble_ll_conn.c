@@ -853,6 +853,12 @@ ble_ll_conn_get_next_sched_time(struct ble_ll_conn_sm *connsm)
     }
 #endif
 
+    /* Do not run past the event length limit of the connection, if any */
+    if (connsm->max_ce_ticks &&
+        CPUTIME_LT(connsm->anchor_point + connsm->max_ce_ticks, ce_end)) {
+        ce_end = connsm->anchor_point + connsm->max_ce_ticks;
+    }
+
     return ce_end;
 }
 
@@ -1312,6 +1318,7 @@ conn_tx_pdu:
 
         /* Set last transmitted MD bit */
         CONN_F_LAST_TXD_MD(connsm) = md;
+        ++connsm->ce_tx_pdus;
 
         /* Increment packets transmitted */
         if (CONN_F_EMPTY_PDU_TXD(connsm)) {
@@ -1849,6 +1856,11 @@ ble_ll_conn_sm_new(struct ble_ll_conn_sm *connsm)
     connsm->csmflags.conn_flags = 0;
     connsm->event_cntr = 0;
     connsm->conn_state = BLE_LL_CONN_STATE_IDLE;
+    connsm->max_ce_usecs = 0;
+    connsm->max_ce_ticks = 0;
+    connsm->ce_tx_pdus = 0;
+    connsm->ce_rx_pdus = 0;
+    memset(&connsm->ce_stats, 0, sizeof(connsm->ce_stats));
     connsm->disconnect_reason = 0;
     connsm->rxd_disconnect_reason = 0;
     connsm->conn_features = BLE_LL_CONN_INITIAL_FEATURES;
@@ -2530,6 +2542,117 @@ ble_ll_conn_created(struct ble_ll_conn_sm *connsm, struct ble_mbuf_hdr *rxhdr)
     return rc;
 }
 
+/**
+ * Adds the packets of the connection event that ended to the packets per
+ * connection event counters and resets them for the next event.
+ *
+ * Context: Link-layer task
+ *
+ * @param connsm
+ */
+static void
+ble_ll_conn_ce_stats_update(struct ble_ll_conn_sm *connsm)
+{
+    uint16_t pdus;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    pdus = connsm->ce_tx_pdus + connsm->ce_rx_pdus;
+    ++connsm->ce_stats.events;
+    connsm->ce_stats.tx_pdus += connsm->ce_tx_pdus;
+    connsm->ce_stats.rx_pdus += connsm->ce_rx_pdus;
+    if (pdus > connsm->ce_stats.max_pdus) {
+        connsm->ce_stats.max_pdus = pdus;
+    }
+    connsm->ce_tx_pdus = 0;
+    connsm->ce_rx_pdus = 0;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Limits the length of the connection events of a connection. By default a
+ * connection event continues while either side has more data, until the
+ * next scheduled item or the next connection event, which packs as many
+ * PDUs per event as possible. A limit leaves the rest of the interval to
+ * other connections and to scanning and advertising.
+ *
+ * @param handle        Connection handle
+ * @param max_ce_usecs  Maximum connection event length in usecs, 0 for no
+ *                      limit.
+ *
+ * @return int 0 on success, BLE_ERR_UNK_CONN_ID if there is no connection
+ */
+int
+ble_ll_conn_ce_len_set(uint16_t handle, uint16_t max_ce_usecs)
+{
+    struct ble_ll_conn_sm *connsm;
+    os_sr_t sr;
+
+    connsm = ble_ll_conn_find_active_conn(handle);
+    if (!connsm) {
+        return BLE_ERR_UNK_CONN_ID;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    connsm->max_ce_usecs = max_ce_usecs;
+    connsm->max_ce_ticks = os_cputime_usecs_to_ticks(max_ce_usecs);
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+/**
+ * Gets the packets per connection event counters of a connection.
+ *
+ * @param handle    Connection handle
+ * @param stats     Filled with the counters
+ *
+ * @return int 0 on success, BLE_ERR_UNK_CONN_ID if there is no connection
+ */
+int
+ble_ll_conn_ce_stats_get(uint16_t handle, struct ble_ll_conn_ce_stats *stats)
+{
+    struct ble_ll_conn_sm *connsm;
+    os_sr_t sr;
+
+    connsm = ble_ll_conn_find_active_conn(handle);
+    if (!connsm) {
+        return BLE_ERR_UNK_CONN_ID;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    *stats = connsm->ce_stats;
+    stats->max_ce_usecs = connsm->max_ce_usecs;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+/**
+ * Resets the packets per connection event counters of a connection.
+ *
+ * @param handle    Connection handle
+ *
+ * @return int 0 on success, BLE_ERR_UNK_CONN_ID if there is no connection
+ */
+int
+ble_ll_conn_ce_stats_reset(uint16_t handle)
+{
+    struct ble_ll_conn_sm *connsm;
+    os_sr_t sr;
+
+    connsm = ble_ll_conn_find_active_conn(handle);
+    if (!connsm) {
+        return BLE_ERR_UNK_CONN_ID;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    memset(&connsm->ce_stats, 0, sizeof(connsm->ce_stats));
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
 /**
  * Called upon end of connection event
  *
@@ -2623,6 +2746,7 @@ ble_ll_conn_event_end(struct ble_npl_event *ev)
     /* Reset "per connection event" variables */
     connsm->cons_rxd_bad_crc = 0;
     connsm->csmflags.cfbit.pkt_rxd = 0;
+    ble_ll_conn_ce_stats_update(connsm);
 
     /* See if we need to start any control procedures */
     ble_ll_ctrl_chk_proc_start(connsm);
@@ -3900,6 +4024,7 @@ ble_ll_conn_rx_isr_end(uint8_t *rxbuf, struct ble_mbuf_hdr *rxhdr)
     } else {
         /* Reset consecutively received bad crcs (since this one was good!) */
         connsm->cons_rxd_bad_crc = 0;
+        ++connsm->ce_rx_pdus;
 
         /* Set last valid received pdu time (resets supervision timer) */
         connsm->last_rxd_pdu_cputime = begtime +
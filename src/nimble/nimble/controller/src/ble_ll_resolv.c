@@ -39,12 +39,15 @@ struct ble_ll_resolv_data
 {
     uint8_t addr_res_enabled;
     uint8_t rl_size;
+    uint8_t rl_hw_size;
     uint8_t rl_cnt_hw;
+    uint8_t rl_cnt_aar;
     uint8_t rl_cnt;
     ble_npl_time_t rpa_tmo;
     struct ble_npl_callout rpa_timer;
 };
 struct ble_ll_resolv_data g_ble_ll_resolv_data;
+struct ble_ll_resolv_stats g_ble_ll_resolv_stats;
 
 __attribute__((aligned(4)))
 struct ble_ll_resolv_entry g_ble_ll_resolv_list[MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE)];
@@ -200,6 +203,7 @@ ble_ll_resolv_list_clr(void)
 
     /* Sets total on list to 0. Clears HW resolve list */
     g_ble_ll_resolv_data.rl_cnt_hw = 0;
+    g_ble_ll_resolv_data.rl_cnt_aar = 0;
     g_ble_ll_resolv_data.rl_cnt = 0;
     ble_hw_resolv_list_clear();
 
@@ -353,12 +357,16 @@ ble_ll_resolv_list_add(const uint8_t *cmdbuf, uint8_t len)
     /* By default use privacy network mode */
     rl->rl_priv_mode = BLE_HCI_PRIVACY_NETWORK;
 
-    /* Add peers IRKs to HW resolving list. Should always succeed since we
-     * already checked if there is room for it.
+    /* Add peers IRKs to HW resolving list while there is room for them,
+     * the following entries with peer IRK are resolved in software. The new
+     * entry is the last one with peer IRK, so HW list stays in RL order.
      */
     if (rl->rl_has_peer) {
-        rc = ble_hw_resolv_list_add(rl->rl_peer_irk);
-        BLE_LL_ASSERT(rc == BLE_ERR_SUCCESS);
+        if (g_ble_ll_resolv_data.rl_cnt_aar < g_ble_ll_resolv_data.rl_hw_size) {
+            rc = ble_hw_resolv_list_add(rl->rl_peer_irk);
+            BLE_LL_ASSERT(rc == BLE_ERR_SUCCESS);
+            g_ble_ll_resolv_data.rl_cnt_aar++;
+        }
         g_ble_ll_resolv_data.rl_cnt_hw++;
     }
 
@@ -408,7 +416,17 @@ ble_ll_resolv_list_rmv(const uint8_t *cmdbuf, uint8_t len)
 
         /* Remove from HW list */
         if (position <= g_ble_ll_resolv_data.rl_cnt_hw) {
-            ble_hw_resolv_list_rmv(position - 1);
+            if (position <= g_ble_ll_resolv_data.rl_cnt_aar) {
+                ble_hw_resolv_list_rmv(position - 1);
+                g_ble_ll_resolv_data.rl_cnt_aar--;
+
+                /* First software resolved entry moved into the freed HW slot */
+                if (g_ble_ll_resolv_data.rl_cnt_hw > g_ble_ll_resolv_data.rl_cnt_aar + 1) {
+                    ble_hw_resolv_list_add(
+                        g_ble_ll_resolv_list[g_ble_ll_resolv_data.rl_cnt_aar].rl_peer_irk);
+                    g_ble_ll_resolv_data.rl_cnt_aar++;
+                }
+            }
             g_ble_ll_resolv_data.rl_cnt_hw--;
         }
 
@@ -708,6 +726,45 @@ ble_ll_resolv_peer_rpa_any(const uint8_t *rpa)
     return -1;
 }
 
+/**
+ * Try to resolve peer RPA with the RL entries that did not fit in HW
+ * resolving list. Called from LL task for packets HW did not resolve.
+ *
+ * @param rpa   Pointer to the RPA
+ *
+ * @return int Index on RL if matched, -1 otherwise
+ */
+int
+ble_ll_resolv_peer_rpa_overflow(const uint8_t *rpa)
+{
+    int i;
+
+    for (i = g_ble_ll_resolv_data.rl_cnt_aar;
+         i < g_ble_ll_resolv_data.rl_cnt_hw; i++) {
+        if (ble_ll_resolv_rpa(rpa, g_ble_ll_resolv_list[i].rl_peer_irk)) {
+            g_ble_ll_resolv_stats.sw_resolved++;
+            return i;
+        }
+    }
+
+    g_ble_ll_resolv_stats.unresolved++;
+    return -1;
+}
+
+/**
+ * Get address resolution statistics
+ *
+ * @param stats Statistics are copied here
+ */
+void
+ble_ll_resolv_get_stats(struct ble_ll_resolv_stats *stats)
+{
+    *stats = g_ble_ll_resolv_stats;
+    stats->hw_entries = g_ble_ll_resolv_data.rl_cnt_aar;
+    stats->sw_entries = g_ble_ll_resolv_data.rl_cnt_hw -
+                        g_ble_ll_resolv_data.rl_cnt_aar;
+}
+
 /**
  * Returns whether or not address resolution is enabled.
  *
@@ -739,11 +796,14 @@ ble_ll_resolv_init(void)
     /* Default is 15 minutes */
     g_ble_ll_resolv_data.rpa_tmo = ble_npl_time_ms_to_ticks32(15 * 60 * 1000);
 
+    /* Entries that do not fit in HW resolving list are resolved in software */
     hw_size = ble_hw_resolv_list_size();
     if (hw_size > MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE)) {
         hw_size = MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE);
     }
-    g_ble_ll_resolv_data.rl_size = hw_size;
+    g_ble_ll_resolv_data.rl_hw_size = hw_size;
+    g_ble_ll_resolv_data.rl_size = MYNEWT_VAL(BLE_LL_RESOLV_LIST_SIZE);
+    memset(&g_ble_ll_resolv_stats, 0, sizeof(g_ble_ll_resolv_stats));
 
     ble_npl_callout_init(&g_ble_ll_resolv_data.rpa_timer,
                          &g_ble_ll_data.ll_evq,
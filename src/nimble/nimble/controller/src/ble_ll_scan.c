@@ -125,14 +125,27 @@ g_ble_ll_scan_rsp_advs[MYNEWT_VAL(BLE_LL_NUM_SCAN_RSP_ADVS)];
 #define BLE_LL_SCAN_DUP_F_DIR_ADV_REPORT_SENT   (0x02)
 #define BLE_LL_SCAN_DUP_F_SCAN_RSP_SENT         (0x04)
 
+/*
+ * Entries are kept on a list in least recently used order, the oldest is
+ * reused when the cache is full, and are hashed by address so a lookup does
+ * not walk the whole cache.
+ */
+#define BLE_LL_SCAN_DUP_BUCKETS ((MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS) / 4) + 1)
+
 struct ble_ll_scan_dup_entry {
     uint8_t type;       /* entry type, see BLE_LL_SCAN_ENTRY_TYPE_* */
     uint8_t addr[6];
     uint8_t flags;      /* use BLE_LL_SCAN_DUP_F_xxx */
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
     uint16_t adi;
+#endif
+    uint16_t adv_data_hash;
+    uint16_t rsp_data_hash;
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGE_MS) > 0
+    uint32_t last_rpt_time;
 #endif
     TAILQ_ENTRY(ble_ll_scan_dup_entry) link;
+    SLIST_ENTRY(ble_ll_scan_dup_entry) hash_link;
 };
 
 static os_membuf_t g_scan_dup_mem[ OS_MEMPOOL_SIZE(
@@ -140,6 +153,15 @@ static os_membuf_t g_scan_dup_mem[ OS_MEMPOOL_SIZE(
                                    sizeof(struct ble_ll_scan_dup_entry)) ];
 static struct os_mempool g_scan_dup_pool;
 static TAILQ_HEAD(ble_ll_scan_dup_list, ble_ll_scan_dup_entry) g_scan_dup_list;
+static SLIST_HEAD(ble_ll_scan_dup_bucket, ble_ll_scan_dup_entry)
+                                    g_scan_dup_hash[BLE_LL_SCAN_DUP_BUCKETS];
+
+/* Number of entries in use and the most allowed by ble_ll_scan_dup_cfg_set */
+static uint16_t g_scan_dup_count;
+static uint16_t g_scan_dup_max = MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS);
+
+/* Report legacy advertisers again when their advertising data changes */
+static uint8_t g_scan_dup_data_filter;
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
 #if MYNEWT_VAL(BLE_LL_EXT_ADV_AUX_PTR_CNT) != 0
@@ -768,6 +790,76 @@ ble_ll_hci_send_dir_adv_report(const uint8_t *addr, uint8_t addr_type,
     return ble_ll_hci_event_send(hci_ev);
 }
 
+static void
+ble_ll_scan_dup_clear(void)
+{
+    os_mempool_clear(&g_scan_dup_pool);
+    TAILQ_INIT(&g_scan_dup_list);
+    memset(g_scan_dup_hash, 0, sizeof(g_scan_dup_hash));
+    g_scan_dup_count = 0;
+}
+
+static inline struct ble_ll_scan_dup_bucket *
+ble_ll_scan_dup_bucket(uint8_t type, const uint8_t *addr)
+{
+    uint32_t hash;
+    int i;
+
+    /* Anonymous entries have no address, they are hashed as all zeros */
+    hash = type;
+    for (i = 0; i < BLE_DEV_ADDR_LEN; i++) {
+        hash = (hash * 31) + (addr ? addr[i] : 0);
+    }
+
+    return &g_scan_dup_hash[hash % BLE_LL_SCAN_DUP_BUCKETS];
+}
+
+static uint16_t
+ble_ll_scan_dup_data_hash(const uint8_t *data, uint8_t len)
+{
+    uint16_t hash;
+
+    /* Hash includes the length so truncated data does not match */
+    hash = 0x811c ^ len;
+    while (len--) {
+        hash = (hash ^ *data++) * 0x0193;
+    }
+
+    return hash;
+}
+
+/**
+ * Configures the duplicate filter used when the host enables scanning with
+ * duplicate filtering.
+ *
+ * @param size          Number of advertisers remembered, at most
+ *                      BLE_LL_NUM_SCAN_DUP_ADVS. The least recently seen one
+ *                      is forgotten when the cache is full.
+ * @param data_filter   Report a legacy advertiser again when its advertising
+ *                      or scan response data changes. Extended advertisers
+ *                      are reported again when their ADI changes.
+ *
+ * @return int 0 on success, BLE_ERR_CMD_DISALLOWED while scanning or
+ *             BLE_ERR_INV_HCI_CMD_PARMS if size is out of range.
+ */
+int
+ble_ll_scan_dup_cfg_set(uint16_t size, uint8_t data_filter)
+{
+    if (g_ble_ll_scan_sm.scan_enabled) {
+        return BLE_ERR_CMD_DISALLOWED;
+    }
+
+    if ((size == 0) || (size > MYNEWT_VAL(BLE_LL_NUM_SCAN_DUP_ADVS))) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    g_scan_dup_max = size;
+    g_scan_dup_data_filter = !!data_filter;
+    ble_ll_scan_dup_clear();
+
+    return 0;
+}
+
 static int
 ble_ll_scan_dup_update_legacy(uint8_t addr_type, const uint8_t *addr,
                               uint8_t subev, uint8_t evtype)
@@ -795,6 +887,10 @@ ble_ll_scan_dup_update_legacy(uint8_t addr_type, const uint8_t *addr,
         }
     }
 
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGE_MS) > 0
+    e->last_rpt_time = os_cputime_get32();
+#endif
+
     return 0;
 }
 
@@ -1208,8 +1304,7 @@ ble_ll_scan_sm_start(struct ble_ll_scan_sm *scansm)
     /* Forget filtered advertisers from previous scan. */
     g_ble_ll_scan_num_rsp_advs = 0;
 
-    os_mempool_clear(&g_scan_dup_pool);
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
     /*
      * First scan window can start when RF is enabled. Add 1 tick since we are
@@ -2035,6 +2130,10 @@ ble_ll_scan_rx_filter(struct ble_mbuf_hdr *hdr, struct ble_ll_scan_addr_data *ad
             break;
         }
 
+        if (addrd->adva_present) {
+            g_ble_ll_resolv_stats.hw_resolved++;
+        }
+
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
         if (aux_data) {
             aux_data->rpa_index = rxinfo->rpa_index;
@@ -2856,11 +2955,20 @@ static inline struct ble_ll_scan_dup_entry *
 ble_ll_scan_dup_new(void)
 {
     struct ble_ll_scan_dup_entry *e;
+    struct ble_ll_scan_dup_bucket *bucket;
 
-    e = os_memblock_get(&g_scan_dup_pool);
-    if (!e) {
+    e = NULL;
+    if (g_scan_dup_count < g_scan_dup_max) {
+        e = os_memblock_get(&g_scan_dup_pool);
+    }
+
+    if (e) {
+        ++g_scan_dup_count;
+    } else {
         e = TAILQ_LAST(&g_scan_dup_list, ble_ll_scan_dup_list);
         TAILQ_REMOVE(&g_scan_dup_list, e, link);
+        bucket = ble_ll_scan_dup_bucket(e->type, e->addr);
+        SLIST_REMOVE(bucket, e, ble_ll_scan_dup_entry, hash_link);
     }
 
     memset(e, 0, sizeof(*e));
@@ -2868,27 +2976,71 @@ ble_ll_scan_dup_new(void)
     return e;
 }
 
+static inline void
+ble_ll_scan_dup_insert(struct ble_ll_scan_dup_entry *e)
+{
+    struct ble_ll_scan_dup_bucket *bucket;
+
+    bucket = ble_ll_scan_dup_bucket(e->type, e->addr);
+    SLIST_INSERT_HEAD(bucket, e, hash_link);
+    TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
+}
+
+/* Forgets the reports sent for an entry which was last reported too long ago */
+static inline void
+ble_ll_scan_dup_age(struct ble_ll_scan_dup_entry *e)
+{
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGE_MS) > 0
+    uint32_t age_ticks;
+
+    age_ticks = os_cputime_usecs_to_ticks(MYNEWT_VAL(BLE_LL_SCAN_DUP_AGE_MS) * 1000);
+    if (e->flags && ((uint32_t)(os_cputime_get32() - e->last_rpt_time) >= age_ticks)) {
+        e->flags = 0;
+    }
+#endif
+}
+
 static int
-ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type)
+ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type,
+                             uint8_t *rxbuf)
 {
     struct ble_ll_scan_dup_entry *e;
+    uint16_t data_hash;
     uint8_t type;
     int rc;
 
     type = BLE_LL_SCAN_ENTRY_TYPE_LEGACY(addr_type);
 
-    TAILQ_FOREACH(e, &g_scan_dup_list, link) {
+    /* Advertising or scan response data follows AdvA, direct adv has none */
+    data_hash = 0;
+    if (g_scan_dup_data_filter && (pdu_type != BLE_ADV_PDU_TYPE_ADV_DIRECT_IND)) {
+        data_hash = ble_ll_scan_dup_data_hash(rxbuf + BLE_LL_PDU_HDR_LEN +
+                                              BLE_DEV_ADDR_LEN,
+                                              rxbuf[1] - BLE_DEV_ADDR_LEN);
+    }
+
+    SLIST_FOREACH(e, ble_ll_scan_dup_bucket(type, addr), hash_link) {
         if ((e->type == type) && !memcmp(e->addr, addr, 6)) {
             break;
         }
     }
 
     if (e) {
+        ble_ll_scan_dup_age(e);
+
         if (pdu_type == BLE_ADV_PDU_TYPE_ADV_DIRECT_IND) {
             rc = e->flags & BLE_LL_SCAN_DUP_F_DIR_ADV_REPORT_SENT;
         } else if (pdu_type == BLE_ADV_PDU_TYPE_SCAN_RSP) {
+            if (e->rsp_data_hash != data_hash) {
+                e->rsp_data_hash = data_hash;
+                e->flags &= ~BLE_LL_SCAN_DUP_F_SCAN_RSP_SENT;
+            }
             rc = e->flags & BLE_LL_SCAN_DUP_F_SCAN_RSP_SENT;
         } else {
+            if (e->adv_data_hash != data_hash) {
+                e->adv_data_hash = data_hash;
+                e->flags &= ~BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
+            }
             rc = e->flags & BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
         }
 
@@ -2900,8 +3052,13 @@ ble_ll_scan_dup_check_legacy(uint8_t addr_type, uint8_t *addr, uint8_t pdu_type)
         e->flags = 0;
         e->type = type;
         memcpy(e->addr, addr, 6);
+        if (pdu_type == BLE_ADV_PDU_TYPE_SCAN_RSP) {
+            e->rsp_data_hash = data_hash;
+        } else if (pdu_type != BLE_ADV_PDU_TYPE_ADV_DIRECT_IND) {
+            e->adv_data_hash = data_hash;
+        }
 
-        TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
+        ble_ll_scan_dup_insert(e);
     }
 
     return rc;
@@ -2925,7 +3082,7 @@ ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr,
 
     type = BLE_LL_SCAN_ENTRY_TYPE_EXT(addr_type, has_aux, is_anon, adi);
 
-    TAILQ_FOREACH(e, &g_scan_dup_list, link) {
+    SLIST_FOREACH(e, ble_ll_scan_dup_bucket(type, addr), hash_link) {
         if ((e->type == type) &&
             (is_anon || !memcmp(e->addr, addr, BLE_DEV_ADDR_LEN))) {
             break;
@@ -2933,6 +3090,8 @@ ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr,
     }
 
     if (e) {
+        ble_ll_scan_dup_age(e);
+
         if (e->adi != adi) {
             rc = 0;
 
@@ -2954,7 +3113,7 @@ ble_ll_scan_dup_check_ext(uint8_t addr_type, uint8_t *addr,
             memcpy(e->addr, addr, 6);
         }
 
-        TAILQ_INSERT_HEAD(&g_scan_dup_list, e, link);
+        ble_ll_scan_dup_insert(e);
     }
 
     return rc;
@@ -2986,6 +3145,10 @@ ble_ll_scan_dup_update_ext(uint8_t addr_type, uint8_t *addr,
 
     e->flags |= BLE_LL_SCAN_DUP_F_ADV_REPORT_SENT;
 
+#if MYNEWT_VAL(BLE_LL_SCAN_DUP_AGE_MS) > 0
+    e->last_rpt_time = os_cputime_get32();
+#endif
+
     return 0;
 }
 #endif
@@ -3004,6 +3167,19 @@ ble_ll_scan_rx_pkt_in_restore_addr_data(struct ble_mbuf_hdr *hdr,
     addrd->adv_addr_type = addrd->adva_type;
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY)
+    /*
+     * RL entries that did not fit in HW resolving list are tried here, out
+     * of ISR. Packets dropped in ISR by the whitelist are not seen here.
+     */
+    if ((rxinfo->rpa_index < 0) && addrd->adva && ble_ll_resolv_enabled() &&
+        (ble_ll_addr_subtype(addrd->adva, addrd->adva_type) ==
+         BLE_LL_ADDR_SUBTYPE_RPA)) {
+        rxinfo->rpa_index = ble_ll_resolv_peer_rpa_overflow(addrd->adva);
+        if (rxinfo->rpa_index >= 0) {
+            rxinfo->flags |= BLE_MBUF_HDR_F_RESOLVED;
+        }
+    }
+
     if (rxinfo->rpa_index >= 0) {
         rl = &g_ble_ll_resolv_list[rxinfo->rpa_index];
         addrd->adv_addr = rl->rl_identity_addr;
@@ -3040,7 +3216,7 @@ ble_ll_scan_rx_pkt_in_on_legacy(uint8_t pdu_type, struct os_mbuf *om,
     send_hci_report = !scansm->scan_filt_dups ||
                       !ble_ll_scan_dup_check_legacy(addrd->adv_addr_type,
                                                     addrd->adv_addr,
-                                                    pdu_type);
+                                                    pdu_type, rxbuf);
     if (send_hci_report) {
         /* Sending advertising report will also update scan_dup list */
         ble_ll_scan_send_adv_report(pdu_type,
@@ -3940,8 +4116,7 @@ ble_ll_scan_reset(void)
     g_ble_ll_scan_num_rsp_advs = 0;
     memset(&g_ble_ll_scan_rsp_advs[0], 0, sizeof(g_ble_ll_scan_rsp_advs));
 
-    os_mempool_clear(&g_scan_dup_pool);
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
     /* clear memory pool for AUX scan results */
@@ -3979,7 +4154,7 @@ ble_ll_scan_init(void)
                           "ble_ll_scan_dup_pool");
     BLE_LL_ASSERT(err == 0);
 
-    TAILQ_INIT(&g_scan_dup_list);
+    ble_ll_scan_dup_clear();
 
     ble_ll_scan_common_init();
 }
@@ -56,6 +56,8 @@ int32_t g_ble_ll_sched_max_late;
 int32_t g_ble_ll_sched_max_early;
 #endif
 
+static struct ble_ll_sched_stats g_ble_ll_sched_stats;
+
 /* XXX: TODO:
  *  1) Add some accounting to the schedule code to see how late we are
  *  (min/max?)
@@ -126,6 +128,27 @@ ble_ll_sched_overlaps_current(struct ble_ll_sched_item *sch)
     return rc;
 }
 
+/* Counts and traces an item that could not be put on the schedule */
+static int
+ble_ll_sched_insert_result(uint8_t sched_type, int rc)
+{
+    if (rc) {
+        g_ble_ll_sched_stats.insert_fail[sched_type]++;
+        ble_ll_trace_u32(BLE_LL_TRACE_ID_SCHED_FAIL, sched_type);
+    }
+
+    return rc;
+}
+
+/* Counts and traces an item removed from the schedule by another one */
+static void
+ble_ll_sched_removed(struct ble_ll_sched_item *entry)
+{
+    g_ble_ll_sched_stats.removed[entry->sched_type]++;
+    ble_ll_trace_u32x2(BLE_LL_TRACE_ID_SCHED_RMVD, entry->sched_type,
+                       entry->start_time);
+}
+
 static int
 ble_ll_sched_conn_overlap(struct ble_ll_sched_item *entry)
 {
@@ -135,6 +158,7 @@ ble_ll_sched_conn_overlap(struct ble_ll_sched_item *entry)
     /* Should only be advertising or a connection here */
     if (entry->sched_type == BLE_LL_SCHED_TYPE_CONN) {
         connsm = (struct ble_ll_conn_sm *)entry->cb_arg;
+        ble_ll_sched_removed(entry);
         entry->enqueued = 0;
         TAILQ_REMOVE(&g_ble_ll_sched_q, entry, link);
         ble_ll_event_send(&connsm->conn_ev_end);
@@ -187,7 +211,7 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
 
     /* Better be past current time or we just leave */
     if (CPUTIME_LT(sch->start_time, os_cputime_get32())) {
-        return -1;
+        return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, -1);
     }
 
     /* We have to find a place for this schedule */
@@ -195,7 +219,7 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
 
     if (ble_ll_sched_overlaps_current(sch)) {
         OS_EXIT_CRITICAL(sr);
-        return -1;
+        return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, -1);
     }
 
     /* Stop timer since we will add an element */
@@ -217,6 +241,19 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
                 break;
             }
 
+            /*
+             * An advertising set that missed too many events in a row keeps
+             * its event, this connection event is skipped instead.
+             */
+            if (entry->sched_type == BLE_LL_SCHED_TYPE_ADV &&
+                ble_ll_adv_sched_overdue((struct ble_ll_adv_sm *)entry->cb_arg)) {
+                g_ble_ll_sched_stats.conn_yield_adv++;
+                ble_ll_trace_u32(BLE_LL_TRACE_ID_SCHED_ADV_PRIO, entry->start_time);
+                start_overlap = NULL;
+                rc = -1;
+                break;
+            }
+
             if (start_overlap == NULL) {
                 start_overlap = entry;
                 end_overlap = entry;
@@ -269,6 +306,7 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
             break;
         }
 
+        ble_ll_sched_removed(entry);
         TAILQ_REMOVE(&g_ble_ll_sched_q, entry, link);
         entry->enqueued = 0;
 
@@ -291,7 +329,7 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
     BLE_LL_ASSERT(sch != NULL);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
 }
 
 /**
@@ -456,7 +494,7 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm,
         /* Should never happen but if it does... */
         if (i == BLE_LL_SCHED_PERIODS) {
             OS_EXIT_CRITICAL(sr);
-            return rc;
+            return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
         }
     }
 
@@ -537,7 +575,7 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm,
 
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
 }
 #else
 int
@@ -720,7 +758,7 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm,
 
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
 }
 #endif
 
@@ -765,7 +803,7 @@ ble_ll_sched_slave_new(struct ble_ll_conn_sm *connsm)
     /* The schedule item must occur after current running item (if any) */
     if (ble_ll_sched_overlaps_current(sch)) {
         OS_EXIT_CRITICAL(sr);
-        return rc;
+        return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
     }
 
     entry = ble_ll_sched_insert_if_empty(sch);
@@ -822,7 +860,7 @@ ble_ll_sched_slave_new(struct ble_ll_conn_sm *connsm)
 
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_CONN, rc);
 }
 
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
@@ -894,7 +932,7 @@ ble_ll_sched_sync_reschedule(struct ble_ll_sched_item *sch,
 
     /* Better be past current time or we just leave */
     if (CPUTIME_LEQ(sch->start_time, os_cputime_get32())) {
-        return -1;
+        return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_SYNC, -1);
     }
 
     /* We have to find a place for this schedule */
@@ -902,7 +940,7 @@ ble_ll_sched_sync_reschedule(struct ble_ll_sched_item *sch,
 
     if (ble_ll_sched_sync_overlaps_current(sch)) {
         OS_EXIT_CRITICAL(sr);
-        return -1;
+        return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_SYNC, -1);
     }
 
     /* Try to find slot for sync scan. */
@@ -943,7 +981,7 @@ ble_ll_sched_sync_reschedule(struct ble_ll_sched_item *sch,
     BLE_LL_ASSERT(sch != NULL);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_SYNC, rc);
 }
 
 int
@@ -1028,7 +1066,7 @@ done:
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
     STATS_INC(ble_ll_stats, sync_scheduled);
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_SYNC, rc);
 }
 #endif
 
@@ -1164,7 +1202,41 @@ ble_ll_sched_periodic_adv(struct ble_ll_sched_item *sch, uint32_t *start,
     BLE_LL_ASSERT(sch != NULL);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_PERIODIC, rc);
+}
+
+/*
+ * Removes the connection events in the way of the advertising event of a set
+ * that missed BLE_LL_ADV_SCHED_MISSED_MAX events in a row, so that it is sent
+ * without its random delay being pushed out of range.
+ *
+ * Context: Link Layer task, called with interrupts disabled.
+ */
+static void
+ble_ll_sched_adv_preempt_conn(struct ble_ll_sched_item *sch,
+                              uint32_t duration)
+{
+    uint32_t end_time;
+    struct ble_ll_sched_item *entry;
+    struct ble_ll_sched_item *next_sch;
+
+    end_time = sch->start_time + duration;
+    entry = TAILQ_FIRST(&g_ble_ll_sched_q);
+    while (entry) {
+        next_sch = TAILQ_NEXT(entry, link);
+        if (CPUTIME_LEQ(end_time, entry->start_time)) {
+            break;
+        }
+
+        if (entry->sched_type == BLE_LL_SCHED_TYPE_CONN &&
+            CPUTIME_GT(entry->end_time, sch->start_time)) {
+            os_cputime_timer_stop(&g_ble_ll_sched_timer);
+            g_ble_ll_sched_stats.conn_yield_adv++;
+            ble_ll_trace_u32(BLE_LL_TRACE_ID_SCHED_ADV_PRIO, sch->start_time);
+            ble_ll_sched_conn_overlap(entry);
+        }
+        entry = next_sch;
+    }
 }
 
 int
@@ -1195,6 +1267,11 @@ ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch, uint32_t *start,
     rc = 0;
     OS_ENTER_CRITICAL(sr);
 
+    if (sch->sched_type == BLE_LL_SCHED_TYPE_ADV &&
+        ble_ll_adv_sched_overdue((struct ble_ll_adv_sm *)sch->cb_arg)) {
+        ble_ll_sched_adv_preempt_conn(sch, duration);
+    }
+
     entry = ble_ll_sched_insert_if_empty(sch);
     if (entry) {
         os_cputime_timer_stop(&g_ble_ll_sched_timer);
@@ -1289,7 +1366,7 @@ ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch, uint32_t *start,
     sch = TAILQ_FIRST(&g_ble_ll_sched_q);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_ADV, rc);
 }
 
 int
@@ -1326,7 +1403,7 @@ ble_ll_sched_adv_resched_pdu(struct ble_ll_sched_item *sch)
 
 adv_resched_pdu_fail:
     OS_EXIT_CRITICAL(sr);
-    return -1;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_ADV, -1);
 }
 
 /**
@@ -1457,23 +1534,31 @@ ble_ll_sched_execute_item(struct ble_ll_sched_item *sch)
     ble_phy_disable();
 
     if (lls == BLE_LL_STATE_SCANNING) {
+        g_ble_ll_sched_stats.preempt_scan++;
         ble_ll_state_set(BLE_LL_STATE_STANDBY);
         ble_ll_scan_halt();
     } else if (lls == BLE_LL_STATE_INITIATING) {
+        g_ble_ll_sched_stats.preempt_initiating++;
         ble_ll_state_set(BLE_LL_STATE_STANDBY);
         ble_ll_scan_halt();
         /* PHY is disabled - make sure we do not wait for AUX_CONNECT_RSP */
         ble_ll_conn_reset_pending_aux_conn_rsp();
     } else if (lls == BLE_LL_STATE_ADV) {
         STATS_INC(ble_ll_stats, sched_state_adv_errs);
+        g_ble_ll_sched_stats.overrun_adv++;
+        ble_ll_trace_u32x2(BLE_LL_TRACE_ID_SCHED_OVERRUN, lls, sch->sched_type);
         ble_ll_adv_halt();
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
     } else if (lls == BLE_LL_STATE_SYNC) {
         STATS_INC(ble_ll_stats, sched_state_sync_errs);
+        g_ble_ll_sched_stats.overrun_sync++;
+        ble_ll_trace_u32x2(BLE_LL_TRACE_ID_SCHED_OVERRUN, lls, sch->sched_type);
         ble_ll_sync_halt();
 #endif
     } else {
         STATS_INC(ble_ll_stats, sched_state_conn_errs);
+        g_ble_ll_sched_stats.overrun_conn++;
+        ble_ll_trace_u32x2(BLE_LL_TRACE_ID_SCHED_OVERRUN, lls, sch->sched_type);
         ble_ll_conn_event_halt();
     }
 
@@ -1496,17 +1581,28 @@ static void
 ble_ll_sched_run(void *arg)
 {
     struct ble_ll_sched_item *sch;
+    int32_t dt;
 
     BLE_LL_DEBUG_GPIO(SCHED_RUN, 1);
 
     /* Look through schedule queue */
     sch = TAILQ_FIRST(&g_ble_ll_sched_q);
     if (sch) {
-#if (BLE_LL_SCHED_DEBUG == 1)
-        int32_t dt;
+        dt = (int32_t)(os_cputime_get32() - sch->start_time);
 
+        /* Items start ahead of their tx/rx by the schedule offset, if we are
+         * later than that the item will likely miss its air time.
+         */
+        if (dt > g_ble_ll_sched_offset_ticks) {
+            g_ble_ll_sched_stats.late_starts++;
+            if ((uint32_t)dt > g_ble_ll_sched_stats.max_late_ticks) {
+                g_ble_ll_sched_stats.max_late_ticks = dt;
+            }
+            ble_ll_trace_u32x2(BLE_LL_TRACE_ID_SCHED_LATE, sch->sched_type, dt);
+        }
+
+#if (BLE_LL_SCHED_DEBUG == 1)
         /* Make sure we have passed the start time of the first event */
-        dt = (int32_t)(os_cputime_get32() - sch->start_time);
         if (dt > g_ble_ll_sched_max_late) {
             g_ble_ll_sched_max_late = dt;
         }
@@ -1601,6 +1697,7 @@ ble_ll_sched_scan_req_over_aux_ptr(uint32_t chan, uint8_t phy_mode)
         }
 
         ble_ll_scan_end_adv_evt((struct ble_ll_aux_data *)sch->cb_arg);
+        ble_ll_sched_removed(sch);
         TAILQ_REMOVE(&g_ble_ll_sched_q, sch, link);
         sch->enqueued = 0;
         sch = TAILQ_FIRST(&g_ble_ll_sched_q);
@@ -1720,7 +1817,7 @@ done:
     BLE_LL_ASSERT(sch != NULL);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_AUX_SCAN, rc);
 }
 #endif
 
@@ -1756,7 +1853,7 @@ int ble_ll_sched_dtm(struct ble_ll_sched_item *sch)
          */
         if (ble_ll_sched_is_overlap(sch, entry)) {
             OS_EXIT_CRITICAL(sr);
-            return -1;
+            return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_DTM, -1);
         }
     }
 
@@ -1779,9 +1876,29 @@ done:
     BLE_LL_ASSERT(sch != NULL);
     os_cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
 
-    return rc;
+    return ble_ll_sched_insert_result(BLE_LL_SCHED_TYPE_DTM, rc);
 }
 #endif
+void
+ble_ll_sched_stats_get(struct ble_ll_sched_stats *stats)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    *stats = g_ble_ll_sched_stats;
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+ble_ll_sched_stats_reset(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    memset(&g_ble_ll_sched_stats, 0, sizeof(g_ble_ll_sched_stats));
+    OS_EXIT_CRITICAL(sr);
+}
+
 /**
  * Stop the scheduler
  *
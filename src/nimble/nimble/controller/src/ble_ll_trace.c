@@ -20,6 +20,68 @@
 #include <stdint.h>
 #include "nimble/porting/nimble/include/syscfg/syscfg.h"
 #include "nimble/porting/nimble/include/os/os_trace_api.h"
+#include "../include/controller/ble_ll_trace.h"
+
+#if MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE) > 0
+#include "nimble/porting/nimble/include/os/os.h"
+#include "nimble/porting/nimble/include/os/os_cputime.h"
+
+static struct ble_ll_trace_entry g_ble_ll_trace_ring[MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE)];
+static uint16_t g_ble_ll_trace_ring_head;
+static uint16_t g_ble_ll_trace_ring_count;
+static uint32_t g_ble_ll_trace_ring_lost;
+
+void
+ble_ll_trace_ring_add(unsigned id, uint32_t p1, uint32_t p2, uint32_t p3)
+{
+    struct ble_ll_trace_entry *entry;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    entry = &g_ble_ll_trace_ring[g_ble_ll_trace_ring_head];
+    entry->cputime = os_cputime_get32();
+    entry->id = id;
+    entry->p1 = p1;
+    entry->p2 = p2;
+    entry->p3 = p3;
+
+    g_ble_ll_trace_ring_head = (g_ble_ll_trace_ring_head + 1) %
+                               MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE);
+    if (g_ble_ll_trace_ring_count < MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE)) {
+        g_ble_ll_trace_ring_count++;
+    } else {
+        g_ble_ll_trace_ring_lost++;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+int
+ble_ll_trace_ring_read(struct ble_ll_trace_entry *entries, int max_entries)
+{
+    uint16_t idx;
+    os_sr_t sr;
+    int i;
+
+    OS_ENTER_CRITICAL(sr);
+    idx = (g_ble_ll_trace_ring_head + MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE) -
+           g_ble_ll_trace_ring_count) % MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE);
+
+    for (i = 0; i < max_entries && g_ble_ll_trace_ring_count; i++) {
+        entries[i] = g_ble_ll_trace_ring[idx];
+        idx = (idx + 1) % MYNEWT_VAL(BLE_LL_TRACE_RING_SIZE);
+        g_ble_ll_trace_ring_count--;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return i;
+}
+
+uint32_t
+ble_ll_trace_ring_lost(void)
+{
+    return g_ble_ll_trace_ring_lost;
+}
+#endif
 
 #if MYNEWT_VAL(BLE_LL_SYSVIEW)
 
@@ -43,13 +105,20 @@ ble_ll_trace_module_send_desc(void)
     os_trace_module_desc(&g_ble_ll_trace_mod, "11 ll_adv_halt inst=%u");
     os_trace_module_desc(&g_ble_ll_trace_mod, "12 ll_aux_ref aux=%p ref=%u");
     os_trace_module_desc(&g_ble_ll_trace_mod, "13 ll_aux_unref aux=%p ref=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "14 ll_sched_fail type=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "15 ll_sched_rmvd type=%u start_time=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "16 ll_sched_late type=%u ticks=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "17 ll_sched_overrun lls=%u type=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "18 ll_adv_missed inst=%u run=%u");
+    os_trace_module_desc(&g_ble_ll_trace_mod, "19 ll_sched_adv_prio start_time=%u");
 }
 
 void
 ble_ll_trace_init(void)
 {
     ble_ll_trace_off =
-            os_trace_module_register(&g_ble_ll_trace_mod, "ble_ll", 12,
+            os_trace_module_register(&g_ble_ll_trace_mod, "ble_ll",
+                                     BLE_LL_TRACE_ID_COUNT,
                                      ble_ll_trace_module_send_desc);
 }
 #endif
@@ -56,6 +56,8 @@ struct os_mbuf;
 #define BLE_ATT_ERR_INSUFFICIENT_ENC        0x0f
 #define BLE_ATT_ERR_UNSUPPORTED_GROUP       0x10
 #define BLE_ATT_ERR_INSUFFICIENT_RES        0x11
+#define BLE_ATT_ERR_DB_OUT_OF_SYNC          0x12
+#define BLE_ATT_ERR_VALUE_NOT_ALLOWED       0x13
 
 #define BLE_ATT_OP_ERROR_RSP                0x01
 #define BLE_ATT_OP_MTU_REQ                  0x02
@@ -83,6 +85,7 @@ struct os_mbuf;
 #define BLE_ATT_OP_NOTIFY_REQ               0x1b
 #define BLE_ATT_OP_INDICATE_REQ             0x1d
 #define BLE_ATT_OP_INDICATE_RSP             0x1e
+#define BLE_ATT_OP_NOTIFY_MULTI_REQ         0x23
 #define BLE_ATT_OP_WRITE_CMD                0x52
 
 #define BLE_ATT_ATTR_MAX_LEN                512
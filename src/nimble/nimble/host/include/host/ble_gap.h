@@ -1001,6 +1001,19 @@ typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
  */
 int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc);
 
+/**
+ * Retrieves the slot index of a connection.  Each open connection has a
+ * distinct slot from 0 to MYNEWT_VAL(BLE_MAX_CONNECTIONS) - 1 that does not
+ * change while it is open, so it can be used to index per-connection state.
+ *
+ * @param handle    The connection handle to search for.
+ * @param out_slot  On success, the slot index of the connection.
+ *
+ * @return          0 on success, BLE_HS_ENOTCONN if no matching connection was
+ *                  found.
+ */
+int ble_gap_conn_slot(uint16_t handle, uint8_t *out_slot);
+
 /**
  * Searches for a connection with a peer with the specified address.
  * If a matching connection is found, the supplied connection descriptor
@@ -1345,6 +1358,21 @@ int ble_gap_ext_adv_set_data(uint8_t instance, struct os_mbuf *data);
 
 int ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data);
 
+/**
+ * Sets the fragment preference sent to the controller with the advertising
+ * and scan response data of specified advertising instance. The preference
+ * is kept until the instance is removed.
+ *
+ * @param instance            Instance ID
+ * @param pref                BLE_HCI_LE_SET_DATA_FRAG_PREF_ALLOW to let the
+ *                            controller fragment data into as many PDUs as it
+ *                            likes or BLE_HCI_LE_SET_DATA_FRAG_PREF_NO_FRAG to
+ *                            ask it to use as few PDUs as possible.
+ *
+ * @return          0 on success or error code on failure.
+ */
+int ble_gap_ext_adv_set_fragment_pref(uint8_t instance, uint8_t pref);
+
 /**
  * Remove existing advertising instance.
  *
@@ -1979,6 +2007,24 @@ int ble_gap_encryption_initiate(uint16_t conn_handle, uint8_t key_size,
  */
 int ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi);
 
+/**
+ * Retrieves the number of ACL data packets sent and received over the
+ * specified connection since it was established.  The counts wrap at
+ * UINT32_MAX.
+ *
+ * @param conn_handle           Specifies the connection to query.
+ * @param out_tx_pkts           On success, the count of packets sent to the
+ *                                  controller is written here.
+ * @param out_rx_pkts           On success, the count of packets received
+ *                                  from the controller is written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if there is no connection
+ *                                  with the specified handle.
+ */
+int ble_gap_conn_traffic(uint16_t conn_handle, uint32_t *out_tx_pkts,
+                         uint32_t *out_rx_pkts);
+
 /**
  * Unpairs a device with the specified address. The keys related to that peer
  * device are removed from storage and peer address is removed from the resolve
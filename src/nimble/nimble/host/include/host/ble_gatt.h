@@ -43,7 +43,14 @@ struct ble_hs_cfg;
 #define BLE_GATT_REGISTER_OP_DSC                        3
 
 #define BLE_GATT_SVC_UUID16                             0x1801
+#define BLE_GATT_DSC_EXT_PROP_UUID16                    0x2900
+#define BLE_GATT_DSC_USER_DESC_UUID16                   0x2901
 #define BLE_GATT_DSC_CLT_CFG_UUID16                     0x2902
+#define BLE_GATT_DSC_SVR_CFG_UUID16                     0x2903
+#define BLE_GATT_DSC_PRES_FMT_UUID16                    0x2904
+#define BLE_GATT_DSC_AGG_FMT_UUID16                     0x2905
+#define BLE_GATT_CHR_SERVICE_CHANGED_UUID16             0x2a05
+#define BLE_GATT_CHR_DB_HASH_UUID16                     0x2b2a
 
 #define BLE_GATT_CHR_PROP_BROADCAST                     0x01
 #define BLE_GATT_CHR_PROP_READ                          0x02
@@ -59,6 +66,14 @@ struct ble_hs_cfg;
 #define BLE_GATT_ACCESS_OP_READ_DSC                     2
 #define BLE_GATT_ACCESS_OP_WRITE_DSC                    3
 
+/** The length of the GATT Client Supported Features value. */
+#define BLE_GATT_CHR_CLI_SUP_FEAT_SZ                    1
+
+/** GATT Client Supported Features bits of the first byte. */
+#define BLE_GATT_CHR_CLI_SUP_FEAT_ROBUST_CACHING        0x01
+#define BLE_GATT_CHR_CLI_SUP_FEAT_EATT                  0x02
+#define BLE_GATT_CHR_CLI_SUP_FEAT_MULT_NTF              0x04
+
 #define BLE_GATT_CHR_F_BROADCAST                        0x0001
 #define BLE_GATT_CHR_F_READ                             0x0002
 #define BLE_GATT_CHR_F_WRITE_NO_RSP                     0x0004
@@ -137,6 +152,16 @@ typedef int ble_gatt_reliable_attr_fn(uint16_t conn_handle,
                                       struct ble_gatt_attr *attrs,
                                       uint8_t num_attrs, void *arg);
 
+/**
+ * Supplies the next part of a value written with ble_gattc_write_long_src().
+ * Exactly len bytes from the offset in the value must be appended to om.
+ * The same offset is requested again if the write is restarted.
+ *
+ * @return                      0 on success; nonzero to abort the write.
+ */
+typedef int ble_gatt_chunk_fn(uint16_t conn_handle, uint16_t offset,
+                              uint16_t len, struct os_mbuf *om, void *arg);
+
 typedef int ble_gatt_chr_fn(uint16_t conn_handle,
                             const struct ble_gatt_error *error,
                             const struct ble_gatt_chr *chr, void *arg);
@@ -434,6 +459,30 @@ int ble_gattc_write_long(uint16_t conn_handle, uint16_t attr_handle,
                          uint16_t offset, struct os_mbuf *om,
                          ble_gatt_attr_fn *cb, void *cb_arg);
 
+/**
+ * Initiates GATT procedure: Write Long Characteristic Values, with the value
+ * supplied one prepare write at a time by a callback.  Only the part being
+ * written is held in memory, so the memory used does not grow with the
+ * length of the value.
+ *
+ * @param conn_handle           The connection over which to execute the
+ *                                  procedure.
+ * @param attr_handle           The handle of the characteristic value to write
+ *                                  to.
+ * @param len                   The length of the value.
+ * @param src_cb                The function to call for each part of the
+ *                                  value.
+ * @param cb                    The function to call to report procedure status
+ *                                  updates; null for no callback.
+ * @param cb_arg                The optional argument to pass to both callback
+ *                                  functions.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int ble_gattc_write_long_src(uint16_t conn_handle, uint16_t attr_handle,
+                             uint16_t len, ble_gatt_chunk_fn *src_cb,
+                             ble_gatt_attr_fn *cb, void *cb_arg);
+
 /**
  * Initiates GATT procedure: Reliable Writes.  This function consumes the
  * supplied mbufs regardless of the outcome.
@@ -473,6 +522,37 @@ int ble_gattc_write_reliable(uint16_t conn_handle,
 int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle,
                             struct os_mbuf *om);
 
+/** A value sent with ble_gattc_notify_multiple_custom(). */
+struct ble_gatt_notif {
+    /** The characteristic value attribute handle. */
+    uint16_t handle;
+
+    /** The value, NULL to read it from the characteristic. */
+    struct os_mbuf *value;
+};
+
+/**
+ * Sends the values of several characteristics.  When the peer has enabled
+ * Multiple Handle Value Notifications in the GATT Client Supported Features
+ * characteristic, the values are packed in as few ATT Multiple Handle Value
+ * Notification PDUs as the MTU allows, otherwise each value is sent as a
+ * notification right after the previous one.  A notification transmit GAP
+ * event is reported for every value.  This function consumes the supplied
+ * mbufs regardless of the outcome.
+ *
+ * @param conn_handle           The connection over which to execute the
+ *                                  procedure.
+ * @param num_tuples            The number of values.
+ * @param tuples                The handles and values to send, the value
+ *                                  pointers are set to NULL as they are
+ *                                  consumed.
+ *
+ * @return                      0 on success; the first error otherwise, the
+ *                                  other values are still sent.
+ */
+int ble_gattc_notify_multiple_custom(uint16_t conn_handle, size_t num_tuples,
+                                     struct ble_gatt_notif *tuples);
+
 /**
  * Sends a characteristic notification.  The content of the message is read
  * from the specified characteristic.
@@ -487,6 +567,70 @@ int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle,
  */
 int ble_gattc_notify(uint16_t conn_handle, uint16_t chr_val_handle);
 
+/**
+ * Gets the GATT Client Supported Features a peer has written.
+ *
+ * @param conn_handle           The connection handle of the peer.
+ * @param out_supported_feat    The buffer to fill with the features.
+ * @param len                   The length of the buffer, at most
+ *                                  BLE_GATT_CHR_CLI_SUP_FEAT_SZ bytes are
+ *                                  written.
+ *
+ * @return                      0 on success; BLE_HS_ENOTCONN if there is no
+ *                                  such connection.
+ */
+int ble_gatts_peer_cl_sup_feat_get(uint16_t conn_handle,
+                                   uint8_t *out_supported_feat, uint8_t len);
+
+/**
+ * Stores the GATT Client Supported Features written by a peer, called by the
+ * GATT service.  Unknown bits are ignored.
+ *
+ * @param conn_handle           The connection handle of the peer.
+ * @param om                    The value written.
+ *
+ * @return                      0 on success; an ATT error if a feature the
+ *                                  peer enabled would be disabled.
+ */
+int ble_gatts_peer_cl_sup_feat_update(uint16_t conn_handle,
+                                      struct os_mbuf *om);
+
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+/**
+ * Gets the Database Hash of the attributes the peers can discover, computed
+ * with AES-CMAC the first time it is needed after the database changes.
+ *
+ * @param out_hash              The buffer of 16 bytes to fill with the hash,
+ *                                  little endian as for the characteristic.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int ble_gatts_db_hash(uint8_t *out_hash);
+
+/**
+ * Records a change of the database, called when a Service Changed indication
+ * is sent.  The hash is computed again and the connected clients that enabled
+ * robust caching become change-unaware until they confirm the indication or
+ * send a request after being told they are out of sync.
+ */
+void ble_gatts_db_changed(void);
+
+/**
+ * Checks whether an ATT PDU from the peer can be served.  A change-unaware
+ * peer is told once that it is out of sync, its next request makes it
+ * change-aware again.
+ *
+ * @param conn_handle           The connection of the peer.
+ * @param req                   1 for a request, 0 for a command.
+ *
+ * @return                      1 if the PDU can be served;
+ *                              0 if a request must be answered with
+ *                                  BLE_ATT_ERR_DB_OUT_OF_SYNC or a command
+ *                                  must be dropped.
+ */
+int ble_gatts_change_aware(uint16_t conn_handle, int req);
+#endif
+
 /**
  * Sends a "free-form" characteristic indication.  The provided mbuf contains
  * the indication payload.  This function consumes the supplied mbuf regardless
@@ -38,6 +38,7 @@
 #include "ble_hs_log.h"
 #include "ble_hs_mbuf.h"
 #include "ble_hs_stop.h"
+#include "ble_hs_trace.h"
 #include "ble_ibeacon.h"
 #include "ble_l2cap.h"
 #include "ble_sm.h"
@@ -381,6 +382,72 @@ void ble_hs_deinit(void);
  */
 int ble_hs_shutdown(int reason);
 
+/** Statistics of the adaptive controller to host flow control. */
+struct ble_hs_flow_stats {
+    /** The number of ACL buffers the controller may currently fill. */
+    uint16_t window;
+
+    /** The lowest window since the host started. */
+    uint16_t window_min;
+
+    /** The freed ACL buffers whose credits are held back from the controller. */
+    uint16_t withheld;
+
+    /** The average time from the reception of an ACL buffer to its release, in ms. */
+    uint16_t latency_ms;
+
+    /** The number of times the window was made smaller. */
+    uint32_t shrinks;
+
+    /** The number of times the window was made larger. */
+    uint32_t grows;
+
+    /** The total time the window was smaller than BLE_ACL_BUF_COUNT, in ms. */
+    uint32_t throttled_ms;
+};
+
+/**
+ * Retrieves the statistics of the adaptive controller to host flow control.
+ *
+ * @param out_stats             On success, the statistics are written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if BLE_HS_FLOW_CTRL_ADAPTIVE is
+ *                                  disabled.
+ */
+int ble_hs_flow_get_stats(struct ble_hs_flow_stats *out_stats);
+
+/** The received ACL data work of one connection, counted by the host. */
+struct ble_hs_rx_work {
+    /** The ACL data packets of the connection processed by the host. */
+    uint32_t packets;
+
+    /** The most packets of the connection waiting to be processed at once. */
+    uint16_t max_queued;
+
+    /**
+     * The most packets processed before one of the packets of the
+     * connection, once they were taken from the receive queue.
+     */
+    uint16_t max_wait;
+};
+
+/**
+ * Retrieves the received ACL data work of a connection.  The counters start
+ * when the connection receives its first packet and are cleared when it is
+ * closed.
+ *
+ * @param conn_handle           The handle of the connection.
+ * @param out_work              On success, the counters are written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if the connection has not
+ *                                  received data;
+ *                              BLE_HS_ENOTSUP if BLE_HS_RX_ROUND_ROBIN is
+ *                                  disabled.
+ */
+int ble_hs_rx_work_get(uint16_t conn_handle, struct ble_hs_rx_work *out_work);
+
 #ifdef __cplusplus
 }
 #endif
@@ -71,6 +71,52 @@ struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len);
 int ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len,
                         uint16_t *out_copy_len);
 
+/** Transmit priority classes, a connection sends queued packets of a higher class first. */
+#define BLE_HS_TX_PRIO_LOW      0
+#define BLE_HS_TX_PRIO_NORMAL   1
+#define BLE_HS_TX_PRIO_HIGH     2
+#define BLE_HS_TX_PRIO_HIGHEST  3
+#define BLE_HS_TX_PRIO_CNT      4
+
+/** Counters of the transmit priority classes, indexed by class. */
+struct ble_hs_tx_prio_stats {
+    /** Packets accepted for transmission. */
+    uint32_t tx_pkts[BLE_HS_TX_PRIO_CNT];
+    /** Packets queued because the controller had no free buffer. */
+    uint32_t queued_pkts[BLE_HS_TX_PRIO_CNT];
+    /** Queued packets placed ahead of packets of a lower class. */
+    uint32_t ahead_pkts[BLE_HS_TX_PRIO_CNT];
+};
+
+/**
+ * Sets the transmit priority class of a packet.  Packets the host creates
+ * and packets without a class set are BLE_HS_TX_PRIO_NORMAL.  The class is
+ * only used to order the packets waiting for a controller buffer on the same
+ * connection, a packet being fragmented is always completed first.
+ *
+ * @param om            The packet to send, the class is kept by the ATT
+ *                          notify, indicate and write commands.
+ * @param prio          One of the BLE_HS_TX_PRIO_* values.
+ */
+void ble_hs_mbuf_set_tx_prio(struct os_mbuf *om, uint8_t prio);
+
+/**
+ * Gets the transmit priority class of a packet.
+ *
+ * @param om            The packet.
+ *
+ * @return              One of the BLE_HS_TX_PRIO_* values.
+ */
+uint8_t ble_hs_mbuf_tx_prio(const struct os_mbuf *om);
+
+/**
+ * Reads the counters of the transmit priority classes.
+ *
+ * @param out_stats     The counters are written here.
+ * @param reset         Nonzero to clear the counters after reading them.
+ */
+void ble_hs_tx_prio_stats(struct ble_hs_tx_prio_stats *out_stats, int reset);
+
 #ifdef __cplusplus
 }
 #endif
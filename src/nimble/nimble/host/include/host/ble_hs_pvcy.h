@@ -64,6 +64,21 @@ extern "C" {
  *                       return appropriate error code otherwise
  */
 int ble_hs_pvcy_rpa_config(uint8_t enable);
+
+/**
+ * Looks up the identity address of a bonded peer from a resolvable private
+ * address it uses.  Recent results are cached until the next RPA timeout or
+ * resolving list change, so looking up the address of every advertising
+ * report does not cost an AES operation per bonded peer each time.
+ *
+ * @param addr              The address to resolve.
+ * @param out_id_addr       On success, the identity address of the peer.
+ *
+ * @return                  0 on success;
+ *                          BLE_HS_EINVAL if the address is not an RPA;
+ *                          BLE_HS_ENOENT if no bonded peer resolves it.
+ */
+int ble_hs_pvcy_resolve_addr(const ble_addr_t *addr, ble_addr_t *out_id_addr);
 #endif
 
 #ifdef __cplusplus
@@ -20,6 +20,10 @@
 #ifndef H_BLE_HS_STOP_
 #define H_BLE_HS_STOP_
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /** @typedef ble_hs_stop_fn
  * @brief Callback function; reports the result of a host stop procedure.
  *
@@ -67,4 +71,8 @@ struct ble_hs_stop_listener {
 int ble_hs_stop(struct ble_hs_stop_listener *listener, 
                 ble_hs_stop_fn *fn, void *arg);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
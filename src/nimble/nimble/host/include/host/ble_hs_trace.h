@@ -0,0 +1,120 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HS_TRACE_
+#define H_BLE_HS_TRACE_
+
+/**
+ * @brief Binary trace of host events for latency analysis.
+ *
+ * Each event is stored as a fixed size record in a ring buffer of
+ * MYNEWT_VAL(BLE_HS_TRACE_SIZE) entries, the oldest entries are overwritten
+ * when it is full.  Recording an event copies a few integers, so the trace
+ * can be left enabled in production builds.  The ring is compiled out when the
+ * size is 0.
+ */
+
+#include <inttypes.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** ATT PDU received; code is the opcode. */
+#define BLE_HS_TRACE_ATT_RX             0
+/** ATT PDU sent; code is the opcode. */
+#define BLE_HS_TRACE_ATT_TX             1
+/** Packet header mbuf allocation failed; length is the leading space. */
+#define BLE_HS_TRACE_MBUF_FAIL          2
+/** GAP event handled by the server; code is the event type. */
+#define BLE_HS_TRACE_SERVER_GAP         3
+/** GAP event handled by a client; code is the event type. */
+#define BLE_HS_TRACE_CLIENT_GAP         4
+/** GAP event handled by the scanner; code is the event type. */
+#define BLE_HS_TRACE_SCAN_GAP           5
+/** Characteristic access; code is the access op. */
+#define BLE_HS_TRACE_CHR_ACCESS         6
+/** Descriptor access; code is the access op. */
+#define BLE_HS_TRACE_DSC_ACCESS         7
+/** First type available to the application. */
+#define BLE_HS_TRACE_USER               0x80
+
+/** One trace record. */
+struct ble_hs_trace_entry {
+    /** Time of the event in microseconds, wraps around every 71 minutes. */
+    uint32_t time_us;
+    /** Connection handle, or BLE_HS_CONN_HANDLE_NONE. */
+    uint16_t conn_handle;
+    /** Attribute handle, or 0 if not applicable. */
+    uint16_t attr_handle;
+    /** Length of the data involved, or 0 if not applicable. */
+    uint16_t len;
+    /** Status of the event, clamped to 16 bits. */
+    int16_t rc;
+    /** One of the BLE_HS_TRACE_[...] types. */
+    uint8_t type;
+    /** Event code, depends on the type. */
+    uint8_t code;
+};
+
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+
+/**
+ * Adds an entry to the trace ring; safe to call from any task.
+ */
+void ble_hs_trace_record(uint8_t type, uint8_t code, uint16_t conn_handle,
+                         uint16_t attr_handle, uint16_t len, int rc);
+
+/**
+ * Copies the trace entries, oldest first.
+ *
+ * @param entries               The buffer to copy the entries to.
+ * @param max_entries           The capacity of the buffer.
+ *
+ * @return                      The number of entries copied.
+ */
+int ble_hs_trace_read(struct ble_hs_trace_entry *entries, int max_entries);
+
+/**
+ * Gets the number of entries recorded since the last clear, including
+ * entries that have been overwritten.
+ */
+uint32_t ble_hs_trace_count(void);
+
+/**
+ * Removes all entries from the trace ring.
+ */
+void ble_hs_trace_clear(void);
+
+#define BLE_HS_TRACE(type, code, conn_handle, attr_handle, len, rc) \
+    ble_hs_trace_record((type), (code), (conn_handle), (attr_handle), \
+                        (len), (rc))
+
+#else
+
+#define BLE_HS_TRACE(type, code, conn_handle, attr_handle, len, rc)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
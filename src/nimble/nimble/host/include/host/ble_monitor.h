@@ -23,7 +23,11 @@
 #include "nimble/porting/nimble/include/syscfg/syscfg.h"
 
 #undef BLE_MONITOR
-#define BLE_MONITOR (MYNEWT_VAL(BLE_MONITOR_UART) || MYNEWT_VAL(BLE_MONITOR_RTT))
+#define BLE_MONITOR (MYNEWT_VAL(BLE_MONITOR_UART) || MYNEWT_VAL(BLE_MONITOR_RTT) || \
+                     MYNEWT_VAL(BLE_MONITOR_RAM))
+
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +38,88 @@ int ble_monitor_log(int level, const char *fmt, ...);
 int ble_monitor_out(int c);
 void ble_monitor_deinit(void);
 
+/**
+ * Called with each chunk of an exported capture.
+ *
+ * @param data                  The bytes to write.
+ * @param len                   The number of bytes.
+ * @param arg                   The argument given to the export.
+ *
+ * @return                      0 to continue; nonzero to abort the export.
+ */
+typedef int ble_monitor_write_fn(const void *data, size_t len, void *arg);
+
+#if MYNEWT_VAL(BLE_MONITOR_RAM)
+/**
+ * Writes the packets held by the RAM capture ring as a btsnoop file
+ * (datalink 2001, the Linux monitor format read by btmon and Wireshark),
+ * oldest first.  The capture is held while exporting.
+ *
+ * @param cb                    Called with each chunk of the file.
+ * @param arg                   Passed to the callback.
+ *
+ * @return                      0 on success; the nonzero return code of the
+ *                                  callback if it aborted the export.
+ */
+int ble_monitor_ram_export(ble_monitor_write_fn *cb, void *arg);
+
+/**
+ * Empties the RAM capture ring and resets its drop count.
+ */
+void ble_monitor_ram_clear(void);
+
+/**
+ * Stops or resumes recording packets in the RAM capture ring, the packets
+ * held are kept.
+ *
+ * @param paused                1 to stop recording; 0 to resume.
+ */
+void ble_monitor_ram_pause(int paused);
+
+/**
+ * Gets the number of packets lost by the RAM capture ring: the oldest packets
+ * overwritten and the packets larger than the ring.
+ */
+uint32_t ble_monitor_ram_dropped(void);
+#endif
+
+#if MYNEWT_VAL(BLE_MONITOR_REPLAY)
+/** The host processing time of a replayed capture. */
+struct ble_monitor_replay_stats {
+    /** HCI events and ACL packets fed into the host. */
+    uint32_t events;
+    uint32_t acl_packets;
+
+    /** Packets not fed: host output, acknowledgements or no buffer. */
+    uint32_t skipped;
+
+    /** Total and longest host processing time, in microseconds. */
+    uint32_t event_us;
+    uint32_t event_max_us;
+    uint32_t acl_us;
+    uint32_t acl_max_us;
+};
+
+/**
+ * Feeds the controller to host packets of a btsnoop capture (datalink 2001)
+ * back into the host, as fast as the host processes them, and measures the
+ * host time spent on each one.  The packets are processed in the host task,
+ * the call blocks until all are done.  Command Complete, Command Status and
+ * Number Of Completed Packets events are skipped as they answer the traffic of
+ * the capturing host, every other event changes the host state as it would
+ * coming from the controller.
+ *
+ * @param data                  The btsnoop file.
+ * @param len                   The length of the file.
+ * @param stats                 Filled with the processing times.
+ *
+ * @return                      0 on success; BLE_HS_EINVAL if the file is not
+ *                                  a btsnoop monitor capture.
+ */
+int ble_monitor_replay(const uint8_t *data, size_t len,
+                       struct ble_monitor_replay_stats *stats);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -163,6 +163,9 @@ struct bt_mesh_msg_ctx {
 
 	/** TTL, or BT_MESH_TTL_DEFAULT for default TTL. */
 	uint8_t  send_ttl;
+
+	/** OpCode of a received message. Not used for sending. */
+	uint32_t recv_op;
 };
 
 struct bt_mesh_model_op {
@@ -148,6 +148,15 @@ void bt_mesh_cdb_node_del(struct bt_mesh_cdb_node *node, bool store);
  */
 struct bt_mesh_cdb_node *bt_mesh_cdb_node_get(uint16_t addr);
 
+/** @brief Get a node by device UUID.
+ *
+ *  @param uuid UUID of the device.
+ *
+ *  @return The node that was provisioned with the UUID or NULL if no such
+ *          node exists.
+ */
+struct bt_mesh_cdb_node *bt_mesh_cdb_node_get_by_uuid(const uint8_t uuid[16]);
+
 /** @brief Store node to persistent storage.
  *
  *  @param node Node to be stored.
@@ -54,6 +54,16 @@
 #include "nimble/ext/tinycrypt/include/tinycrypt/ecc_dh.h"
 #endif
 
+/* The nRF52 controller is built in, its ECB peripheral encrypts the blocks
+ * when mbedTLS is not used.
+ */
+#if !MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS) && \
+    defined(ARDUINO_ARCH_NRF5) && defined(NRF52_SERIES)
+#define BT_AES_HW_ECB 1
+#else
+#define BT_AES_HW_ECB 0
+#endif
+
 #if MYNEWT_VAL(BLE_MESH_SETTINGS)
 #include "config/config.h"
 #endif
@@ -334,6 +344,24 @@ uint8_t *bt_pub_key_get(void);
 int bt_rand(void *buf, size_t len);
 const char * bt_hex(const void *buf, size_t len);
 int bt_encrypt_be(const uint8_t *key, const uint8_t *plaintext, uint8_t *enc_data);
+
+/** AES-128 key set up once for the blocks of a CCM operation. */
+struct bt_aes_ctx {
+#if MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
+	mbedtls_aes_context aes;
+#elif BT_AES_HW_ECB
+	uint8_t key[16];
+#else
+	struct tc_aes_key_sched_struct sched;
+#endif
+};
+
+int bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16]);
+int bt_aes_ctx_encrypt(struct bt_aes_ctx *ctx, const uint8_t in[16],
+		       uint8_t out[16]);
+int bt_aes_ctx_ctr(struct bt_aes_ctx *ctx, uint8_t ctr[16],
+		   const uint8_t *in, uint8_t *out, size_t len);
+void bt_aes_ctx_free(struct bt_aes_ctx *ctx);
 int bt_ccm_decrypt(const uint8_t key[16], uint8_t nonce[13], const uint8_t *enc_data,
 		   size_t len, const uint8_t *aad, size_t aad_len,
 		   uint8_t *plaintext, size_t mic_size);
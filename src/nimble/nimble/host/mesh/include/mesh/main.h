@@ -444,6 +444,35 @@ int bt_mesh_suspend(void);
  */
 int bt_mesh_resume(void);
 
+/** @brief Callback to turn the advertising bearer scanning on or off.
+ *
+ *  @param enable true when the Mesh stack needs to receive advertisements.
+ *
+ *  @return 0 on success, or (negative) error code on failure.
+ */
+typedef int (*bt_mesh_scan_ctrl_t)(bool enable);
+
+/** @brief Let the application share the scanner with the Mesh stack.
+ *
+ *  By default the Mesh stack starts and stops its own continuous scan.
+ *  If a callback is set, the stack calls it instead and the application
+ *  is responsible for scanning while the stack needs it, either with its
+ *  own scan or with bt_mesh_scan_start(). The Mesh stack receives the
+ *  advertisements of any scan through its GAP event listener.
+ *
+ *  @param ctrl Callback, or NULL to let the Mesh stack scan on its own.
+ */
+void bt_mesh_scan_ctrl_set(bt_mesh_scan_ctrl_t ctrl);
+
+/** @brief Start the continuous scan used by the Mesh stack.
+ *
+ *  @param cb GAP event callback of the scan, may be NULL.
+ *  @param cb_arg Argument of the callback.
+ *
+ *  @return 0 on success, or (negative) error code on failure.
+ */
+int bt_mesh_scan_start(ble_gap_event_fn *cb, void *cb_arg);
+
 /** @brief Provision the local Mesh Node.
  *
  *  This API should normally not be used directly by the application. The
@@ -471,7 +500,13 @@ int bt_mesh_provision(const uint8_t net_key[16], uint16_t net_idx,
  *                available address will be chosen.
  * @param attention_duration The attention duration to be send to remote device
  *
- * @return Zero on success or (negative) error code otherwise.
+ * If another device is being provisioned and BLE_MESH_PROV_QUEUE_SIZE is set,
+ * the device is queued and provisioned when the link is free, the result is
+ * reported through the node_added and link_close callbacks as usual.
+ *
+ * @return Zero on success or (negative) error code otherwise. -EBUSY if
+ *         the link and the queue are in use, -EALREADY if the device is
+ *         already being provisioned or queued.
  */
 int bt_mesh_provision_adv(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
 			  uint8_t attention_duration);
@@ -548,6 +583,44 @@ void bt_mesh_lpn_set_cb(void (*cb)(uint16_t friend_addr, bool established));
  */
 int bt_mesh_friend_terminate(uint16_t lpn_addr);
 
+/** Friend Queue statistics of a friendship. */
+struct bt_mesh_friend_stats {
+	/** Number of PDUs in the Friend Queue. */
+	uint32_t queue_size;
+
+	/** Number of PDUs the Friend Queue may currently hold. */
+	uint32_t quota;
+
+	/** Number of queued PDUs discarded to make room for newer ones. */
+	uint32_t dropped;
+
+	/** Number of PDUs not queued for lack of space or buffers. */
+	uint32_t rejected;
+};
+
+/** @brief Get the Friend Queue statistics of a friendship.
+ *
+ *  The counters are cleared when the friendship ends.
+ *
+ *  @param lpn_addr Low Power Node address.
+ *  @param stats Statistics of the friendship.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_mesh_friend_stats_get(uint16_t lpn_addr,
+			     struct bt_mesh_friend_stats *stats);
+
+/** @brief Get the Network Message Cache statistics.
+ *
+ *  Every network PDU received on the advertising bearer is checked
+ *  against the cache, which is sized by BLE_MESH_MSG_CACHE_SIZE.
+ *
+ *  @param hits Number of PDUs dropped as duplicates, may be NULL.
+ *  @param misses Number of PDUs not found in the Network Message Cache,
+ *                may be NULL.
+ */
+void bt_mesh_net_cache_stats(uint32_t *hits, uint32_t *misses);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,18 @@
 static const struct bt_mesh_comp *dev_comp;
 static uint16_t dev_primary_addr;
 
+#if MYNEWT_VAL(BLE_MESH_OP_INDEX_SIZE) > 0
+/* Open addressing index of the opcodes of all models, keyed by element
+ * and opcode, so that received messages do not walk every op table.
+ */
+static struct op_index_entry {
+	uint32_t opcode;
+	const struct bt_mesh_model_op *op;
+	struct bt_mesh_model *model;
+} op_index[MYNEWT_VAL(BLE_MESH_OP_INDEX_SIZE)];
+static bool op_index_valid;
+#endif
+
 void bt_mesh_model_foreach(void (*func)(struct bt_mesh_model *mod,
 					struct bt_mesh_elem *elem,
 					bool vnd, bool primary,
@@ -55,6 +67,91 @@ void bt_mesh_model_foreach(void (*func)(struct bt_mesh_model *mod,
 	}
 }
 
+#if MYNEWT_VAL(BLE_MESH_OP_INDEX_SIZE) > 0
+static uint16_t op_index_hash(uint8_t elem_idx, uint32_t opcode)
+{
+	uint32_t key = opcode ^ ((uint32_t)elem_idx << 24);
+
+	key ^= key >> 16;
+	key *= 0x7feb352d;
+	key ^= key >> 15;
+
+	return key % ARRAY_SIZE(op_index);
+}
+
+static void op_index_add(struct bt_mesh_model *mod, struct bt_mesh_elem *elem,
+			 bool vnd, bool primary, void *user_data)
+{
+	const struct bt_mesh_model_op *op;
+	uint16_t i, n;
+
+	for (op = mod->op; op->func; op++) {
+		/* Only the lookup in the matching model list is indexed */
+		if ((BT_MESH_MODEL_OP_LEN(op->opcode) < 3) == vnd) {
+			continue;
+		}
+
+		i = op_index_hash(mod->elem_idx, op->opcode);
+		for (n = 0; n < ARRAY_SIZE(op_index); n++) {
+			if (!op_index[i].op) {
+				break;
+			}
+
+			/* The first model of the element with the opcode
+			 * receives it, as with the linear lookup.
+			 */
+			if (op_index[i].opcode == op->opcode &&
+			    op_index[i].model->elem_idx == mod->elem_idx) {
+				break;
+			}
+
+			i = (i + 1) % ARRAY_SIZE(op_index);
+		}
+
+		if (n == ARRAY_SIZE(op_index)) {
+			BT_WARN("OpCode index full, using linear lookup");
+			op_index_valid = false;
+			return;
+		}
+
+		if (!op_index[i].op) {
+			op_index[i].opcode = op->opcode;
+			op_index[i].op = op;
+			op_index[i].model = mod;
+		}
+	}
+}
+
+static void op_index_build(void)
+{
+	(void)memset(op_index, 0, sizeof(op_index));
+	op_index_valid = true;
+
+	bt_mesh_model_foreach(op_index_add, NULL);
+}
+
+static const struct bt_mesh_model_op *op_index_find(uint8_t elem_idx,
+						    uint32_t opcode,
+						    struct bt_mesh_model **model)
+{
+	uint16_t i, n;
+
+	i = op_index_hash(elem_idx, opcode);
+	for (n = 0; n < ARRAY_SIZE(op_index) && op_index[i].op; n++) {
+		if (op_index[i].opcode == opcode &&
+		    op_index[i].model->elem_idx == elem_idx) {
+			*model = op_index[i].model;
+			return op_index[i].op;
+		}
+
+		i = (i + 1) % ARRAY_SIZE(op_index);
+	}
+
+	*model = NULL;
+	return NULL;
+}
+#endif
+
 int32_t bt_mesh_model_pub_period_get(struct bt_mesh_model *mod)
 {
 	int period;
@@ -316,6 +413,12 @@ int bt_mesh_comp_register(const struct bt_mesh_comp *comp)
 	err = 0;
 	bt_mesh_model_foreach(mod_init, &err);
 
+#if MYNEWT_VAL(BLE_MESH_OP_INDEX_SIZE) > 0
+	if (!err) {
+		op_index_build();
+	}
+#endif
+
 	return err;
 }
 
@@ -567,6 +670,8 @@ void bt_mesh_model_recv(struct bt_mesh_net_rx *rx, struct os_mbuf *buf)
 
 	BT_DBG("OpCode 0x%08x", (unsigned) opcode);
 
+	rx->ctx.recv_op = opcode;
+
 	for (i = 0; i < dev_comp->elem_count; i++) {
 		struct bt_mesh_elem *elem = &dev_comp->elem[i];
 		struct net_buf_simple_state state;
@@ -583,7 +688,15 @@ void bt_mesh_model_recv(struct bt_mesh_net_rx *rx, struct os_mbuf *buf)
 			count = elem->vnd_model_count;
 		}
 
-		op = find_op(models, count, opcode, &model);
+#if MYNEWT_VAL(BLE_MESH_OP_INDEX_SIZE) > 0
+		if (op_index_valid) {
+			op = op_index_find(i, opcode, &model);
+		} else
+#endif
+		{
+			op = find_op(models, count, opcode, &model);
+		}
+
 		if (!op) {
 			BT_DBG("No OpCode 0x%08x for elem %d", opcode, i);
 			continue;
@@ -42,6 +42,9 @@
 
 static int32_t adv_int_min =  ADV_INT_DEFAULT_MS;
 
+/* Scanner shared with the application, if any */
+static bt_mesh_scan_ctrl_t scan_ctrl;
+
 /* TinyCrypt PRNG consumes a lot of stack space, so we need to have
  * an increased call stack whenever it's used.
  */
@@ -400,7 +403,12 @@ done:
 	return 0;
 }
 
-int bt_mesh_scan_enable(void)
+void bt_mesh_scan_ctrl_set(bt_mesh_scan_ctrl_t ctrl)
+{
+	scan_ctrl = ctrl;
+}
+
+int bt_mesh_scan_start(ble_gap_event_fn *cb, void *cb_arg)
 {
 	int err;
 
@@ -412,7 +420,7 @@ int bt_mesh_scan_enable(void)
 	BT_DBG("");
 
 	err =  ble_gap_ext_disc(g_mesh_addr_type, 0, 0, 0, 0, 0,
-				&uncoded_params, NULL, NULL, NULL);
+				&uncoded_params, NULL, cb, cb_arg);
 #else
 	struct ble_gap_disc_params scan_param =
 		{ .passive = 1, .filter_duplicates = 0, .itvl =
@@ -421,7 +429,7 @@ int bt_mesh_scan_enable(void)
 	BT_DBG("");
 
 	err =  ble_gap_disc(g_mesh_addr_type, BLE_HS_FOREVER, &scan_param,
-			    NULL, NULL);
+			    cb, cb_arg);
 #endif
 	if (err && err != BLE_HS_EALREADY) {
 		BT_ERR("starting scan failed (err %d)", err);
@@ -431,12 +439,25 @@ int bt_mesh_scan_enable(void)
 	return 0;
 }
 
+int bt_mesh_scan_enable(void)
+{
+	if (scan_ctrl) {
+		return scan_ctrl(true);
+	}
+
+	return bt_mesh_scan_start(NULL, NULL);
+}
+
 int bt_mesh_scan_disable(void)
 {
 	int err;
 
 	BT_DBG("");
 
+	if (scan_ctrl) {
+		return scan_ctrl(false);
+	}
+
 	err = ble_gap_disc_cancel();
 	if (err && err != BLE_HS_EALREADY) {
 		BT_ERR("stopping scan failed (err %d)", err);
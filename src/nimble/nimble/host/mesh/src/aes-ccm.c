@@ -32,7 +32,7 @@ static inline void xor16(uint8_t *dst, const uint8_t *a, const uint8_t *b)
 }
 
 /* pmsg is assumed to have the nonce already present in bytes 1-13 */
-static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t aad_len,
+static int ccm_calculate_X0(struct bt_aes_ctx *ctx, const uint8_t *aad, uint8_t aad_len,
 			    size_t mic_size, uint8_t msg_len, uint8_t b[16],
 			    uint8_t X0[16])
 {
@@ -43,7 +43,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 
 	sys_put_be16(msg_len, b + 14);
 
-	err = bt_encrypt_be(key, b, X0);
+	err = bt_aes_ctx_encrypt(ctx, b, X0);
 	if (err) {
 		return err;
 	}
@@ -67,7 +67,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 			aad_len -= 16;
 			i = 0;
 
-			err = bt_encrypt_be(key, b, X0);
+			err = bt_aes_ctx_encrypt(ctx, b, X0);
 			if (err) {
 				return err;
 			}
@@ -81,7 +81,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 			b[i] = X0[i];
 		}
 
-		err = bt_encrypt_be(key, b, X0);
+		err = bt_aes_ctx_encrypt(ctx, b, X0);
 		if (err) {
 			return err;
 		}
@@ -90,7 +90,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 	return 0;
 }
 
-static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
+static int ccm_auth(struct bt_aes_ctx *ctx, uint8_t nonce[13],
 		    const uint8_t *cleartext_msg, size_t msg_len, const uint8_t *aad,
 		    size_t aad_len, uint8_t *mic, size_t mic_size)
 {
@@ -110,12 +110,12 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 	/* S[0] = e(AppKey, 0x01 || nonce || 0x0000) */
 	sys_put_be16(0x0000, &b[14]);
 
-	err = bt_encrypt_be(key, b, s0);
+	err = bt_aes_ctx_encrypt(ctx, b, s0);
 	if (err) {
 		return err;
 	}
 
-	ccm_calculate_X0(key, aad, aad_len, mic_size, msg_len, b, Xn);
+	ccm_calculate_X0(ctx, aad, aad_len, mic_size, msg_len, b, Xn);
 
 	for (j = 0; j < blk_cnt; j++) {
 		/* X_1 = e(AppKey, X_0 ^ Payload[0-15]) */
@@ -129,7 +129,7 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 			xor16(b, Xn, &cleartext_msg[j * 16]);
 		}
 
-		err = bt_encrypt_be(key, b, Xn);
+		err = bt_aes_ctx_encrypt(ctx, b, Xn);
 		if (err) {
 			return err;
 		}
@@ -143,58 +143,44 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 	return 0;
 }
 
-static int ccm_crypt(const uint8_t key[16], const uint8_t nonce[13],
+static int ccm_crypt(struct bt_aes_ctx *ctx, const uint8_t nonce[13],
 		     const uint8_t *in_msg, uint8_t *out_msg, size_t msg_len)
 {
-	uint8_t a_i[16], s_i[16];
-	uint16_t last_blk, blk_cnt;
-	size_t i, j;
-	int err;
-
-	last_blk = msg_len % 16;
-	blk_cnt = (msg_len + 15) / 16;
-	if (!last_blk) {
-		last_blk = 16U;
-	}
+	uint8_t a_i[16];
 
+	/* S_1 = e(AppKey, 0x01 || nonce || 0x0001), the counter goes up by one
+	 * for each block so they are all encrypted in one batch.
+	 */
 	a_i[0] = 0x01;
 	memcpy(&a_i[1], nonce, 13);
+	sys_put_be16(0x0001, &a_i[14]);
 
-	for (j = 0; j < blk_cnt; j++) {
-		/* S_1 = e(AppKey, 0x01 || nonce || 0x0001) */
-		sys_put_be16(j + 1, &a_i[14]);
-
-		err = bt_encrypt_be(key, a_i, s_i);
-		if (err) {
-			return err;
-		}
-
-		/* Encrypted = Payload[0-15] ^ C_1 */
-		if (j < blk_cnt - 1) {
-			xor16(&out_msg[j * 16], s_i, &in_msg[j * 16]);
-		} else {
-			for (i = 0; i < last_blk; i++) {
-				out_msg[(j * 16) + i] =
-					in_msg[(j * 16) + i] ^ s_i[i];
-			}
-		}
-	}
-	return 0;
+	return bt_aes_ctx_ctr(ctx, a_i, in_msg, out_msg, msg_len);
 }
 
 int bt_ccm_decrypt(const uint8_t key[16], uint8_t nonce[13], const uint8_t *enc_msg,
 		   size_t msg_len, const uint8_t *aad, size_t aad_len,
 		   uint8_t *out_msg, size_t mic_size)
 {
+	struct bt_aes_ctx ctx;
 	uint8_t mic[16];
+	int err;
 
 	if (aad_len >= 0xff00 || mic_size > sizeof(mic)) {
 		return -EINVAL;
 	}
 
-	ccm_crypt(key, nonce, enc_msg, out_msg, msg_len);
+	/* The key schedule is set up once for all the blocks of the message */
+	err = bt_aes_ctx_init(&ctx, key);
+	if (err) {
+		return err;
+	}
+
+	ccm_crypt(&ctx, nonce, enc_msg, out_msg, msg_len);
 
-	ccm_auth(key, nonce, out_msg, msg_len, aad, aad_len, mic, mic_size);
+	ccm_auth(&ctx, nonce, out_msg, msg_len, aad, aad_len, mic, mic_size);
+
+	bt_aes_ctx_free(&ctx);
 
 	if (memcmp(mic, enc_msg + msg_len, mic_size)) {
 		return -EBADMSG;
@@ -207,7 +193,9 @@ int bt_ccm_encrypt(const uint8_t key[16], uint8_t nonce[13], const uint8_t *msg,
 		   size_t msg_len, const uint8_t *aad, size_t aad_len,
 		   uint8_t *out_msg, size_t mic_size)
 {
+	struct bt_aes_ctx ctx;
 	uint8_t *mic = out_msg + msg_len;
+	int err;
 
 	BT_DBG("key %s", bt_hex(key, 16));
 	BT_DBG("nonce %s", bt_hex(nonce, 13));
@@ -219,9 +207,16 @@ int bt_ccm_encrypt(const uint8_t key[16], uint8_t nonce[13], const uint8_t *msg,
 		return -EINVAL;
 	}
 
-	ccm_auth(key, nonce, out_msg, msg_len, aad, aad_len, mic, mic_size);
+	err = bt_aes_ctx_init(&ctx, key);
+	if (err) {
+		return err;
+	}
+
+	ccm_auth(&ctx, nonce, out_msg, msg_len, aad, aad_len, mic, mic_size);
+
+	ccm_crypt(&ctx, nonce, msg, out_msg, msg_len);
 
-	ccm_crypt(key, nonce, msg, out_msg, msg_len);
+	bt_aes_ctx_free(&ctx);
 
 	return 0;
 }
@@ -37,6 +37,94 @@ struct bt_mesh_cdb bt_mesh_cdb = {
 	},
 };
 
+#define NODE_IDX_NONE 0xffff
+#define UUID_BUCKET_COUNT NODE_COUNT
+
+/* Indexes of the used entries of bt_mesh_cdb.nodes, sorted by address. The
+ * address ranges of the nodes never overlap, so a node is found by looking
+ * for the last one that starts at or below the address.
+ */
+static uint16_t node_by_addr[NODE_COUNT];
+static uint16_t node_idx_count;
+
+/* Nodes hashed by device UUID and chained through uuid_next */
+static uint16_t uuid_bucket[UUID_BUCKET_COUNT] = {
+	[0 ... (UUID_BUCKET_COUNT - 1)] = NODE_IDX_NONE,
+};
+static uint16_t uuid_next[NODE_COUNT];
+
+static struct bt_mesh_cdb_node *node_at(uint16_t pos)
+{
+	return &bt_mesh_cdb.nodes[node_by_addr[pos]];
+}
+
+/* Number of indexed nodes whose first address is at or below addr */
+static uint16_t node_addr_bound(uint16_t addr)
+{
+	uint16_t lo = 0, hi = node_idx_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (node_at(mid)->addr <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static uint16_t uuid_hash(const uint8_t uuid[16])
+{
+	uint32_t hash = 0;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		hash = hash * 31 + uuid[i];
+	}
+
+	return hash % UUID_BUCKET_COUNT;
+}
+
+static void node_index_add(uint16_t idx)
+{
+	struct bt_mesh_cdb_node *node = &bt_mesh_cdb.nodes[idx];
+	uint16_t pos = node_addr_bound(node->addr);
+	uint16_t bucket = uuid_hash(node->uuid);
+
+	memmove(&node_by_addr[pos + 1], &node_by_addr[pos],
+		(node_idx_count - pos) * sizeof(node_by_addr[0]));
+	node_by_addr[pos] = idx;
+	node_idx_count++;
+
+	uuid_next[idx] = uuid_bucket[bucket];
+	uuid_bucket[bucket] = idx;
+}
+
+static void node_index_del(uint16_t idx)
+{
+	struct bt_mesh_cdb_node *node = &bt_mesh_cdb.nodes[idx];
+	uint16_t pos = node_addr_bound(node->addr);
+	uint16_t *link = &uuid_bucket[uuid_hash(node->uuid)];
+
+	if (pos > 0 && node_by_addr[pos - 1] == idx) {
+		node_idx_count--;
+		memmove(&node_by_addr[pos - 1], &node_by_addr[pos],
+			(node_idx_count - (pos - 1)) * sizeof(node_by_addr[0]));
+	}
+
+	while (*link != NODE_IDX_NONE) {
+		if (*link == idx) {
+			*link = uuid_next[idx];
+			break;
+		}
+
+		link = &uuid_next[*link];
+	}
+}
+
 /*
  * Check if an address range from addr_start for addr_start + num_elem - 1 is
  * free for use. When a conflict is found, next will be set to the next address
@@ -45,8 +133,9 @@ struct bt_mesh_cdb bt_mesh_cdb = {
 static int addr_is_free(uint16_t addr_start, uint8_t num_elem, uint16_t *next)
 {
 	uint16_t addr_end = addr_start + num_elem - 1;
-	uint16_t other_start, other_end;
-	int i;
+	struct bt_mesh_cdb_node *node;
+	uint16_t other_end;
+	uint16_t pos;
 
 	if (!BT_MESH_ADDR_IS_UNICAST(addr_start) ||
 	    !BT_MESH_ADDR_IS_UNICAST(addr_end) ||
@@ -54,23 +143,23 @@ static int addr_is_free(uint16_t addr_start, uint8_t num_elem, uint16_t *next)
 		return -EINVAL;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(bt_mesh_cdb.nodes); i++) {
-		struct bt_mesh_cdb_node *node = &bt_mesh_cdb.nodes[i];
-
-		if (node->addr == BT_MESH_ADDR_UNASSIGNED) {
-			continue;
-		}
-
-		other_start = node->addr;
-		other_end = other_start + node->num_elem - 1;
+	/* Only the last node starting at or below the end of the range can
+	 * overlap it, the ones before it end below its first address.
+	 */
+	pos = node_addr_bound(addr_end);
+	if (pos == 0) {
+		return 0;
+	}
 
-		if (!(addr_end < other_start || addr_start > other_end)) {
-			if (next) {
-				*next = other_end + 1;
-			}
+	node = node_at(pos - 1);
+	other_end = node->addr + node->num_elem - 1;
 
-			return -EAGAIN;
+	if (other_end >= addr_start) {
+		if (next) {
+			*next = other_end + 1;
 		}
+
+		return -EAGAIN;
 	}
 
 	return 0;
@@ -80,31 +169,35 @@ static int addr_is_free(uint16_t addr_start, uint8_t num_elem, uint16_t *next)
  * Find the lowest possible starting address that can fit num_elem elements. If
  * a free address range cannot be found, BT_MESH_ADDR_UNASSIGNED will be
  * returned. Otherwise the first address in the range is returned.
- *
- * NOTE: This is quite an ineffective algorithm as it might need to look
- *       through the array of nodes N+2 times. A more effective algorithm
- *       could be used if the nodes were stored in a sorted list.
  */
 static uint16_t find_lowest_free_addr(uint8_t num_elem)
 {
-	uint16_t addr = 1, next = 0;
-	int err, i;
+	struct bt_mesh_cdb_node *node;
+	uint32_t addr = 1;
+	uint16_t i;
+
+	if (num_elem == 0) {
+		return BT_MESH_ADDR_UNASSIGNED;
+	}
 
-	/*
-	 * It takes a maximum of node count + 2 to find a free address if there
-	 * is any. +1 for our own address and +1 for making sure that the
-	 * address range is valid.
+	/* Walk the nodes in address order and stop at the first gap that is
+	 * large enough.
 	 */
-	for (i = 0; i < ARRAY_SIZE(bt_mesh_cdb.nodes) + 2; ++i) {
-		err = addr_is_free(addr, num_elem, &next);
-		if (err == 0) {
-			break;
-		} else if (err != -EAGAIN) {
-			addr = BT_MESH_ADDR_UNASSIGNED;
+	for (i = 0; i < node_idx_count; i++) {
+		node = node_at(i);
+
+		if (addr + num_elem - 1 < node->addr) {
 			break;
 		}
 
-		addr = next;
+		if (node->addr + node->num_elem > addr) {
+			addr = node->addr + node->num_elem;
+		}
+	}
+
+	if (!BT_MESH_ADDR_IS_UNICAST(addr) ||
+	    !BT_MESH_ADDR_IS_UNICAST(addr + num_elem - 1)) {
+		return BT_MESH_ADDR_UNASSIGNED;
 	}
 
 	return addr;
@@ -274,6 +367,7 @@ struct bt_mesh_cdb_node *bt_mesh_cdb_node_alloc(const uint8_t uuid[16], uint16_t
 			node->num_elem = num_elem;
 			node->net_idx = net_idx;
 			atomic_set(node->flags, 0);
+			node_index_add(i);
 			return node;
 		}
 	}
@@ -289,20 +383,44 @@ void bt_mesh_cdb_node_del(struct bt_mesh_cdb_node *node, bool store)
 		bt_mesh_clear_cdb_node(node);
 	}
 
+	if (node->addr != BT_MESH_ADDR_UNASSIGNED) {
+		node_index_del(node - bt_mesh_cdb.nodes);
+	}
+
 	node->addr = BT_MESH_ADDR_UNASSIGNED;
 	memset(node->dev_key, 0, sizeof(node->dev_key));
 }
 
 struct bt_mesh_cdb_node *bt_mesh_cdb_node_get(uint16_t addr)
 {
-	int i;
+	struct bt_mesh_cdb_node *node;
+	uint16_t pos;
 
-	for (i = 0; i < ARRAY_SIZE(bt_mesh_cdb.nodes); i++) {
-		struct bt_mesh_cdb_node *node = &bt_mesh_cdb.nodes[i];
+	if (addr == BT_MESH_ADDR_UNASSIGNED) {
+		return NULL;
+	}
 
-		if (addr >= node->addr &&
-		    addr <= node->addr + node->num_elem - 1) {
-			return node;
+	pos = node_addr_bound(addr);
+	if (pos == 0) {
+		return NULL;
+	}
+
+	node = node_at(pos - 1);
+	if (addr <= node->addr + node->num_elem - 1) {
+		return node;
+	}
+
+	return NULL;
+}
+
+struct bt_mesh_cdb_node *bt_mesh_cdb_node_get_by_uuid(const uint8_t uuid[16])
+{
+	uint16_t idx;
+
+	for (idx = uuid_bucket[uuid_hash(uuid)]; idx != NODE_IDX_NONE;
+	     idx = uuid_next[idx]) {
+		if (!memcmp(bt_mesh_cdb.nodes[idx].uuid, uuid, 16)) {
+			return &bt_mesh_cdb.nodes[idx];
 		}
 	}
 
@@ -30,8 +30,14 @@
 
 /* We reserve one extra buffer for each friendship, since we need to be able
  * to resend the last sent PDU, which sits separately outside of the queue.
+ * A smaller pool may be set, then each friendship is limited to its share
+ * of the pool so that one LPN cannot take the buffers of the others.
  */
+#if MYNEWT_VAL(BLE_MESH_FRIEND_BUF_COUNT) > 0
+#define FRIEND_BUF_COUNT MYNEWT_VAL(BLE_MESH_FRIEND_BUF_COUNT)
+#else
 #define FRIEND_BUF_COUNT ((MYNEWT_VAL(BLE_MESH_FRIEND_QUEUE_SIZE) + 1) * MYNEWT_VAL(BLE_MESH_FRIEND_LPN_COUNT))
+#endif
 
 static os_membuf_t friend_buf_mem[OS_MEMPOOL_SIZE(
 		FRIEND_BUF_COUNT,
@@ -179,6 +185,8 @@ static void friend_clear(struct bt_mesh_friend *frnd)
 	frnd->pending_buf = 0;
 	frnd->fsn = 0;
 	frnd->queue_size = 0;
+	frnd->dropped = 0;
+	frnd->rejected = 0;
 	frnd->pending_req = 0;
 	memset(frnd->sub_list, 0, sizeof(frnd->sub_list));
 }
@@ -1420,6 +1428,7 @@ static void friend_lpn_enqueue_rx(struct bt_mesh_friend *frnd,
 	buf = create_friend_pdu(frnd, &info, sbuf);
 	if (!buf) {
 		BT_ERR("Failed to encode Friend buffer");
+		frnd->rejected++;
 		return;
 	}
 
@@ -1457,6 +1466,7 @@ static void friend_lpn_enqueue_tx(struct bt_mesh_friend *frnd,
 	buf = create_friend_pdu(frnd, &info, sbuf);
 	if (!buf) {
 		BT_ERR("Failed to encode Friend buffer");
+		frnd->rejected++;
 		return;
 	}
 
@@ -1518,13 +1528,36 @@ bool bt_mesh_friend_match(uint16_t net_idx, uint16_t addr)
 	return false;
 }
 
+/* Number of PDUs the Friend Queue of a friendship may hold, its share of
+ * the buffer pool with the other established friendships.
+ */
+static uint32_t friend_queue_quota(struct bt_mesh_friend *frnd)
+{
+	uint32_t count = 1;
+	uint32_t share;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(bt_mesh.frnd); i++) {
+		if (&bt_mesh.frnd[i] != frnd && bt_mesh.frnd[i].established) {
+			count++;
+		}
+	}
+
+	/* Each friendship also holds the last sent PDU */
+	share = FRIEND_BUF_COUNT / count;
+	share = share > 1 ? share - 1 : 1;
+
+	return MIN(share, CONFIG_BT_MESH_FRIEND_QUEUE_SIZE);
+}
+
 static bool friend_queue_has_space(struct bt_mesh_friend *frnd, uint16_t addr,
 				   uint64_t *seq_auth, uint8_t seg_count)
 {
+	uint32_t quota = friend_queue_quota(frnd);
 	uint32_t total = 0;
 	int i;
 
-	if (seg_count > CONFIG_BT_MESH_FRIEND_QUEUE_SIZE) {
+	if (seg_count > quota) {
 		return false;
 	}
 
@@ -1546,7 +1579,7 @@ static bool friend_queue_has_space(struct bt_mesh_friend *frnd, uint16_t addr,
 	 * is because we don't have a mechanism of aborting already pending
 	 * segmented messages to free up buffers.
 	 */
-	return (CONFIG_BT_MESH_FRIEND_QUEUE_SIZE - total) > seg_count;
+	return total + seg_count < quota;
 }
 
 bool bt_mesh_friend_queue_has_space(uint16_t net_idx, uint16_t src, uint16_t dst,
@@ -1588,25 +1621,27 @@ static bool friend_queue_prepare_space(struct bt_mesh_friend *frnd, uint16_t add
 				       uint64_t *seq_auth, uint8_t seg_count)
 {
 	bool pending_segments;
-	uint8_t avail_space;
+	uint32_t quota;
 
 	if (!friend_queue_has_space(frnd, addr, seq_auth, seg_count)) {
+		frnd->rejected++;
 		return false;
 	}
 
-	avail_space = CONFIG_BT_MESH_FRIEND_QUEUE_SIZE - frnd->queue_size;
+	quota = friend_queue_quota(frnd);
 	pending_segments = false;
 
-	while (pending_segments || avail_space < seg_count) {
+	while (pending_segments || frnd->queue_size + seg_count > quota) {
 		struct os_mbuf *buf = (void *)net_buf_slist_get(&frnd->queue);
 
 		if (!buf) {
 			BT_ERR("Unable to free up enough buffers");
+			frnd->rejected++;
 			return false;
 		}
 
 		frnd->queue_size--;
-		avail_space++;
+		frnd->dropped++;
 
 		pending_segments = (BT_MESH_ADV(buf)->flags & NET_BUF_FRAGS);
 		BT_DBG("PENDING SEGMENTS %d", pending_segments);
@@ -1711,6 +1746,24 @@ int bt_mesh_friend_terminate(uint16_t lpn_addr)
 	return 0;
 }
 
+int bt_mesh_friend_stats_get(uint16_t lpn_addr,
+			     struct bt_mesh_friend_stats *stats)
+{
+	struct bt_mesh_friend *frnd;
+
+	frnd = bt_mesh_friend_find(BT_MESH_KEY_ANY, lpn_addr, false, true);
+	if (!frnd) {
+		return -ENOENT;
+	}
+
+	stats->queue_size = frnd->queue_size;
+	stats->quota = friend_queue_quota(frnd);
+	stats->dropped = frnd->dropped;
+	stats->rejected = frnd->rejected;
+
+	return 0;
+}
+
 void bt_mesh_friend_clear_incomplete(struct bt_mesh_subnet *sub, uint16_t src,
 				     uint16_t dst, uint64_t *seq_auth)
 {
@@ -24,6 +24,9 @@
 
 #include "../include/mesh/glue.h"
 #include "adv.h"
+#if BT_AES_HW_ECB
+#include "nimble/nimble/controller/include/controller/ble_hw.h"
+#endif
 #ifndef MYNEWT
 #include "nimble/porting/nimble/include/nimble/nimble_port.h"
 #endif
@@ -135,6 +138,100 @@ bt_encrypt_be(const uint8_t *key, const uint8_t *plaintext, uint8_t *enc_data)
     return 0;
 }
 
+int
+bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16])
+{
+    mbedtls_aes_init(&ctx->aes);
+
+    if (mbedtls_aes_setkey_enc(&ctx->aes, key, 128) != 0) {
+        mbedtls_aes_free(&ctx->aes);
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+bt_aes_ctx_encrypt(struct bt_aes_ctx *ctx, const uint8_t in[16],
+                   uint8_t out[16])
+{
+    if (mbedtls_aes_crypt_ecb(&ctx->aes, MBEDTLS_AES_ENCRYPT, in, out) != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+/* All the blocks go to the AES accelerator in one call. */
+int
+bt_aes_ctx_ctr(struct bt_aes_ctx *ctx, uint8_t ctr[16],
+               const uint8_t *in, uint8_t *out, size_t len)
+{
+    uint8_t stream[16];
+    size_t off = 0;
+
+    if (mbedtls_aes_crypt_ctr(&ctx->aes, len, &off, ctr, stream,
+                              in, out) != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+void
+bt_aes_ctx_free(struct bt_aes_ctx *ctx)
+{
+    mbedtls_aes_free(&ctx->aes);
+}
+
+#elif BT_AES_HW_ECB
+int
+bt_encrypt_be(const uint8_t *key, const uint8_t *plaintext, uint8_t *enc_data)
+{
+    struct bt_aes_ctx ctx;
+
+    memcpy(ctx.key, key, 16);
+    return bt_aes_ctx_encrypt(&ctx, plaintext, enc_data);
+}
+
+int
+bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16])
+{
+    memcpy(ctx->key, key, 16);
+    return 0;
+}
+
+int
+bt_aes_ctx_encrypt(struct bt_aes_ctx *ctx, const uint8_t in[16],
+                   uint8_t out[16])
+{
+    struct ble_encryption_block ecb;
+    os_sr_t sr;
+    int rc;
+
+    /* The ECB takes the key and the block most significant byte first. */
+    memcpy(ecb.key, ctx->key, 16);
+    memcpy(ecb.plain_text, in, 16);
+
+    /* The controller uses the ECB too, a block takes a few microseconds. */
+    OS_ENTER_CRITICAL(sr);
+    rc = ble_hw_encrypt_block(&ecb);
+    OS_EXIT_CRITICAL(sr);
+
+    if (rc != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    memcpy(out, ecb.cipher_text, 16);
+    return 0;
+}
+
+void
+bt_aes_ctx_free(struct bt_aes_ctx *ctx)
+{
+    (void)ctx;
+}
+
 #else
 int
 bt_encrypt_be(const uint8_t *key, const uint8_t *plaintext, uint8_t *enc_data)
@@ -151,6 +248,68 @@ bt_encrypt_be(const uint8_t *key, const uint8_t *plaintext, uint8_t *enc_data)
 
     return 0;
 }
+
+int
+bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16])
+{
+    if (tc_aes128_set_encrypt_key(&ctx->sched, key) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+bt_aes_ctx_encrypt(struct bt_aes_ctx *ctx, const uint8_t in[16],
+                   uint8_t out[16])
+{
+    if (tc_aes_encrypt(out, in, &ctx->sched) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+void
+bt_aes_ctx_free(struct bt_aes_ctx *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+#endif
+
+#if !MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
+/**
+ * Counter mode as used by CCM, the counter is the big endian 16 bits at the
+ * end of the block and is left after the last block used.
+ */
+int
+bt_aes_ctx_ctr(struct bt_aes_ctx *ctx, uint8_t ctr[16],
+               const uint8_t *in, uint8_t *out, size_t len)
+{
+    uint8_t stream[16];
+    size_t n;
+    size_t i;
+    int err;
+
+    while (len > 0) {
+        err = bt_aes_ctx_encrypt(ctx, ctr, stream);
+        if (err) {
+            return err;
+        }
+
+        n = len < 16 ? len : 16;
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+
+        sys_put_be16(sys_get_be16(&ctr[14]) + 1, &ctr[14]);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    return 0;
+}
 #endif
 
 uint16_t
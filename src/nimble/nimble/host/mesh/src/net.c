@@ -59,11 +59,25 @@
 #define SRC(pdu)           (sys_get_be16(&(pdu)[5]))
 #define DST(pdu)           (sys_get_be16(&(pdu)[7]))
 
-static struct {
-	uint32_t src : 15, /* MSb of source is always 0 */
-	      seq : 17;
-} msg_cache[MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE)];
-static uint16_t msg_cache_next;
+#define NET_CACHE_SIZE     MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE)
+#define NET_CACHE_NONE     0xffff
+#define NET_CACHE_UNLINKED 0xfffe
+
+/* Fixed-size FIFO of 32-bit keys with a chained hash index, so that
+ * looking up a PDU does not scan the whole cache. The oldest entry is
+ * overwritten when the cache is full.
+ */
+struct net_cache {
+	uint32_t key[NET_CACHE_SIZE];
+	uint16_t chain[NET_CACHE_SIZE];  /* Next entry in bucket or UNLINKED */
+	uint16_t bucket[NET_CACHE_SIZE]; /* First entry in bucket or NONE */
+	uint16_t next;
+	uint32_t hits;
+	uint32_t misses;
+};
+
+/* Network message cache, keyed by SRC (MSb is always 0) and 17 bits of SEQ */
+static struct net_cache msg_cache;
 
 /* Singleton network context (the implementation only supports one) */
 struct bt_mesh_net bt_mesh = {
@@ -76,50 +90,122 @@ os_membuf_t loopback_mbuf_membuf[
 		OS_MEMPOOL_SIZE(LOOPBACK_MAX_PDU_LEN + BT_MESH_MBUF_HEADER_SIZE,
         MYNEWT_VAL(BLE_MESH_LOOPBACK_BUFS))];
 
-static uint32_t dup_cache[MYNEWT_VAL(BLE_MESH_MSG_CACHE_SIZE)];
-static int   dup_cache_next;
+/* Advertising bearer duplicate filter, keyed by the end of the PDU */
+static struct net_cache dup_cache;
 
-static bool check_dup(struct os_mbuf *data)
+static uint16_t net_cache_hash(uint32_t key)
 {
-	const uint8_t *tail = net_buf_simple_tail(data);
-	uint32_t val;
-	int i;
+	key ^= key >> 16;
+	key *= 0x7feb352d;
+	key ^= key >> 15;
 
-	val = sys_get_be32(tail - 4) ^ sys_get_be32(tail - 8);
+	return key % NET_CACHE_SIZE;
+}
 
-	for (i = 0; i < ARRAY_SIZE(dup_cache); i++) {
-		if (dup_cache[i] == val) {
-			return true;
-		}
-	}
+static void net_cache_reset(struct net_cache *cache)
+{
+	uint16_t i;
 
-	dup_cache[dup_cache_next++] = val;
-	dup_cache_next %= ARRAY_SIZE(dup_cache);
+	for (i = 0; i < NET_CACHE_SIZE; i++) {
+		cache->chain[i] = NET_CACHE_UNLINKED;
+		cache->bucket[i] = NET_CACHE_NONE;
+	}
 
-	return false;
+	cache->next = 0U;
 }
 
-static bool msg_cache_match(struct os_mbuf *pdu)
+static bool net_cache_find(struct net_cache *cache, uint32_t key)
 {
 	uint16_t i;
 
-	for (i = 0; i < ARRAY_SIZE(msg_cache); i++) {
-		if (msg_cache[i].src == SRC(pdu->om_data) &&
-		    msg_cache[i].seq == (SEQ(pdu->om_data) & BIT_MASK(17))) {
+	for (i = cache->bucket[net_cache_hash(key)]; i != NET_CACHE_NONE;
+	     i = cache->chain[i]) {
+		if (cache->key[i] == key) {
+			cache->hits++;
 			return true;
 		}
 	}
 
+	cache->misses++;
 	return false;
 }
 
+static void net_cache_remove(struct net_cache *cache, uint16_t idx)
+{
+	uint16_t *link;
+
+	if (cache->chain[idx] == NET_CACHE_UNLINKED) {
+		return;
+	}
+
+	link = &cache->bucket[net_cache_hash(cache->key[idx])];
+	while (*link != idx) {
+		link = &cache->chain[*link];
+	}
+
+	*link = cache->chain[idx];
+	cache->chain[idx] = NET_CACHE_UNLINKED;
+}
+
+static uint16_t net_cache_add(struct net_cache *cache, uint32_t key)
+{
+	uint16_t idx = cache->next;
+	uint16_t hash = net_cache_hash(key);
+
+	/* Evict the oldest entry */
+	net_cache_remove(cache, idx);
+
+	cache->key[idx] = key;
+	cache->chain[idx] = cache->bucket[hash];
+	cache->bucket[hash] = idx;
+	cache->next = (idx + 1) % NET_CACHE_SIZE;
+
+	return idx;
+}
+
+static bool check_dup(struct os_mbuf *data)
+{
+	const uint8_t *tail = net_buf_simple_tail(data);
+	uint32_t val;
+
+	val = sys_get_be32(tail - 4) ^ sys_get_be32(tail - 8);
+
+	if (net_cache_find(&dup_cache, val)) {
+		return true;
+	}
+
+	net_cache_add(&dup_cache, val);
+
+	return false;
+}
+
+static uint32_t msg_cache_key(uint16_t src, uint32_t seq)
+{
+	return ((uint32_t)src << 17) | (seq & BIT_MASK(17));
+}
+
+static bool msg_cache_match(struct os_mbuf *pdu)
+{
+	return net_cache_find(&msg_cache, msg_cache_key(SRC(pdu->om_data),
+							SEQ(pdu->om_data)));
+}
+
 static void msg_cache_add(struct bt_mesh_net_rx *rx)
 {
 	/* Add to the cache */
-	rx->msg_cache_idx = msg_cache_next++;
-	msg_cache[rx->msg_cache_idx].src = rx->ctx.addr;
-	msg_cache[rx->msg_cache_idx].seq = rx->seq;
-	msg_cache_next %= ARRAY_SIZE(msg_cache);
+	rx->msg_cache_idx = net_cache_add(&msg_cache,
+					  msg_cache_key(rx->ctx.addr, rx->seq));
+}
+
+void bt_mesh_net_cache_stats(uint32_t *hits, uint32_t *misses)
+{
+	if (hits) {
+		*hits = msg_cache.hits + dup_cache.hits;
+	}
+
+	if (misses) {
+		*misses = msg_cache.misses;
+	}
 }
 
 int bt_mesh_net_create(uint16_t idx, uint8_t flags, const uint8_t key[16],
@@ -142,8 +228,7 @@ int bt_mesh_net_create(uint16_t idx, uint8_t flags, const uint8_t key[16],
 		return err;
 	}
 
-	(void)memset(msg_cache, 0, sizeof(msg_cache));
-	msg_cache_next = 0U;
+	net_cache_reset(&msg_cache);
 
 	bt_mesh.iv_index = iv_index;
 	atomic_set_bit_to(bt_mesh.flags, BT_MESH_IVU_IN_PROGRESS,
@@ -797,9 +882,9 @@ void bt_mesh_net_recv(struct os_mbuf *data, int8_t rssi,
 	 */
 	if (bt_mesh_trans_recv(buf, &rx) == -EAGAIN) {
 		BT_WARN("Removing rejected message from Network Message Cache");
-		msg_cache[rx.msg_cache_idx].src = BT_MESH_ADDR_UNASSIGNED;
+		net_cache_remove(&msg_cache, rx.msg_cache_idx);
 		/* Rewind the next index now that we're not using this entry */
-		msg_cache_next = rx.msg_cache_idx;
+		msg_cache.next = rx.msg_cache_idx;
 	}
 
 	/* Relay if this was a group/virtual address, or if the destination
@@ -848,6 +933,9 @@ void bt_mesh_net_init(void)
 
 	k_delayed_work_init(&bt_mesh.ivu_timer, ivu_refresh);
 
+	net_cache_reset(&msg_cache);
+	net_cache_reset(&dup_cache);
+
 	k_work_init(&bt_mesh.local_work, bt_mesh_net_local);
 	net_buf_slist_init(&bt_mesh.local_queue);
 
@@ -78,6 +78,10 @@ struct bt_mesh_friend {
 	struct net_buf_slist_t queue;
 	uint32_t queue_size;
 
+	/* Friend Queue overflow statistics */
+	uint32_t dropped;
+	uint32_t rejected;
+
 	/* Friend Clear Procedure */
 	struct {
 		uint32_t start;                  /* Clear Procedure start */
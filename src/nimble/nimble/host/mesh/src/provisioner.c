@@ -35,6 +35,24 @@ static struct {
 static void send_pub_key(void);
 static void prov_dh_key_gen(void);
 static void pub_key_ready(const uint8_t *pkey);
+#if defined(CONFIG_BT_MESH_PB_ADV) && MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE) > 0
+/* Devices waiting for the provisioning link, they are provisioned one after
+ * the other in the order they were added.
+ */
+static struct prov_request {
+	uint8_t uuid[16];
+	uint16_t net_idx;
+	uint16_t addr;
+	uint8_t attention_duration;
+} prov_queue[MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE)];
+
+static uint8_t prov_queue_head;
+static uint8_t prov_queue_count;
+static struct ble_npl_callout prov_queue_work;
+static bool prov_queue_work_init;
+
+static void prov_queue_next(struct ble_npl_event *work);
+#endif
 
 static int reset_state(void)
 {
@@ -631,6 +649,13 @@ static void local_input_complete(void)
 static void prov_link_closed(void)
 {
 	reset_state();
+
+#if defined(CONFIG_BT_MESH_PB_ADV) && MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE) > 0
+	/* Start the next queued device once the link is released */
+	if (prov_queue_count) {
+		k_work_submit(&prov_queue_work);
+	}
+#endif
 }
 
 static void prov_link_opened(void)
@@ -721,8 +746,8 @@ int bt_mesh_prov_remote_pub_key_set(const uint8_t public_key[64])
 }
 
 #if defined(CONFIG_BT_MESH_PB_ADV)
-int bt_mesh_pb_adv_open(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
-			uint8_t attention_duration)
+static int pb_adv_open(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
+		       uint8_t attention_duration)
 {
 	int err;
 
@@ -746,5 +771,108 @@ int bt_mesh_pb_adv_open(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
 
 	return err;
 }
+
+#if MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE) > 0
+static struct prov_request *prov_queue_get(uint8_t i)
+{
+	return &prov_queue[(prov_queue_head + i) % ARRAY_SIZE(prov_queue)];
+}
+
+static int prov_queue_add(const uint8_t uuid[16], uint16_t net_idx,
+			  uint16_t addr, uint8_t attention_duration)
+{
+	struct prov_request *req;
+	uint8_t i;
+
+	if (atomic_test_bit(bt_mesh_prov_link.flags, LINK_ACTIVE) &&
+	    !memcmp(prov_device.uuid, uuid, 16)) {
+		return -EALREADY;
+	}
+
+	for (i = 0; i < prov_queue_count; i++) {
+		if (!memcmp(prov_queue_get(i)->uuid, uuid, 16)) {
+			return -EALREADY;
+		}
+	}
+
+	if (prov_queue_count == ARRAY_SIZE(prov_queue)) {
+		return -EBUSY;
+	}
+
+	if (!prov_queue_work_init) {
+		k_work_init(&prov_queue_work, prov_queue_next);
+		prov_queue_work_init = true;
+	}
+
+	req = prov_queue_get(prov_queue_count++);
+	memcpy(req->uuid, uuid, 16);
+	req->net_idx = net_idx;
+	req->addr = addr;
+	req->attention_duration = attention_duration;
+
+	BT_DBG("uuid %s queued (%u waiting)", bt_hex(uuid, 16),
+	       prov_queue_count);
+
+	return 0;
+}
+
+static void prov_queue_next(struct ble_npl_event *work)
+{
+	struct prov_request *req;
+	int err;
+
+	while (prov_queue_count) {
+		req = prov_queue_get(0);
+
+		err = pb_adv_open(req->uuid, req->net_idx, req->addr,
+				  req->attention_duration);
+		if (err == -EBUSY) {
+			/* Retried when the link that took it closes */
+			return;
+		}
+
+		if (err) {
+			BT_WARN("Failed to open link for %s (err %d)",
+				bt_hex(req->uuid, 16), err);
+		}
+
+		prov_queue_head = (prov_queue_head + 1) % ARRAY_SIZE(prov_queue);
+		prov_queue_count--;
+
+		if (!err) {
+			return;
+		}
+	}
+}
+
+void bt_mesh_pb_adv_queue_clear(void)
+{
+	prov_queue_head = 0;
+	prov_queue_count = 0;
+
+	if (prov_queue_work_init) {
+		ble_npl_callout_stop(&prov_queue_work);
+	}
+}
+#else
+void bt_mesh_pb_adv_queue_clear(void)
+{
+}
+#endif /* MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE) > 0 */
+
+int bt_mesh_pb_adv_open(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
+			uint8_t attention_duration)
+{
+	int err;
+
+	err = pb_adv_open(uuid, net_idx, addr, attention_duration);
+#if MYNEWT_VAL(BLE_MESH_PROV_QUEUE_SIZE) > 0
+	if (err == -EBUSY) {
+		err = prov_queue_add(uuid, net_idx, addr, attention_duration);
+	}
+#endif
+
+	return err;
+}
 #endif
 #endif /* MYNEWT_VAL(BLE_MESH) */
@@ -7,4 +7,6 @@
  */
 
 int bt_mesh_pb_adv_open(const uint8_t uuid[16], uint16_t net_idx, uint16_t addr,
-			uint8_t attention_duration);
\ No newline at end of file
+			uint8_t attention_duration);
+
+void bt_mesh_pb_adv_queue_clear(void);
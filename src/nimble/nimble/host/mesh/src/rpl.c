@@ -20,12 +20,80 @@
 #include "rpl.h"
 #include "settings.h"
 
-static struct bt_mesh_rpl replay_list[MYNEWT_VAL(BLE_MESH_CRPL)];
+#define RPL_SIZE MYNEWT_VAL(BLE_MESH_CRPL)
+
+static struct bt_mesh_rpl replay_list[RPL_SIZE];
+
+/* Chained hash index of the used entries by source address. The links are
+ * stored as entry index + 1 so that zero, the initial value, ends a chain.
+ */
+static uint16_t rpl_bucket[RPL_SIZE];
+static uint16_t rpl_chain[RPL_SIZE];
+static uint16_t rpl_count;
+
+static uint16_t *rpl_head(uint16_t src)
+{
+	/* Unicast addresses are mostly assigned consecutively */
+	return &rpl_bucket[src % RPL_SIZE];
+}
+
+static void rpl_link(struct bt_mesh_rpl *rpl, uint16_t src)
+{
+	uint16_t idx = rpl - replay_list;
+	uint16_t *head = rpl_head(src);
+
+	rpl->src = src;
+	rpl_chain[idx] = *head;
+	*head = idx + 1;
+	rpl_count++;
+}
+
+static void rpl_unlink(struct bt_mesh_rpl *rpl)
+{
+	uint16_t idx = rpl - replay_list;
+	uint16_t *link;
+
+	if (!rpl->src) {
+		return;
+	}
+
+	link = rpl_head(rpl->src);
+	while (*link != idx + 1) {
+		link = &rpl_chain[*link - 1];
+	}
+
+	*link = rpl_chain[idx];
+	rpl_chain[idx] = 0U;
+	rpl->src = 0U;
+	rpl_count--;
+}
+
+static struct bt_mesh_rpl *rpl_empty_slot(void)
+{
+	int i;
+
+	if (rpl_count == RPL_SIZE) {
+		return NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
+		if (!replay_list[i].src) {
+			return &replay_list[i];
+		}
+	}
+
+	return NULL;
+}
 
 void bt_mesh_rpl_update(struct bt_mesh_rpl *rpl,
 		struct bt_mesh_net_rx *rx)
 {
-	rpl->src = rx->ctx.addr;
+	/* Empty slot given by bt_mesh_rpl_check() */
+	if (rpl->src != rx->ctx.addr) {
+		rpl_unlink(rpl);
+		rpl_link(rpl, rx->ctx.addr);
+	}
+
 	rpl->seq = rx->seq;
 	rpl->old_iv = rx->old_iv;
 
@@ -42,7 +110,7 @@ void bt_mesh_rpl_update(struct bt_mesh_rpl *rpl,
 bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx,
 		struct bt_mesh_rpl **match)
 {
-	int i;
+	struct bt_mesh_rpl *rpl;
 
 	/* Don't bother checking messages from ourselves */
 	if (rx->net_if == BT_MESH_NET_IF_LOCAL) {
@@ -54,43 +122,32 @@ bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx,
 		return false;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		struct bt_mesh_rpl *rpl = &replay_list[i];
-
-		/* Empty slot */
-		if (!rpl->src) {
-			if (match) {
-				*match = rpl;
-			} else {
-				bt_mesh_rpl_update(rpl, rx);
-			}
-
-			return false;
-		}
-
+	rpl = bt_mesh_rpl_find(rx->ctx.addr);
+	if (rpl) {
 		/* Existing slot for given address */
-		if (rpl->src == rx->ctx.addr) {
-			if (rx->old_iv && !rpl->old_iv) {
-				return true;
-			}
-
-			if ((!rx->old_iv && rpl->old_iv) ||
-			    rpl->seq < rx->seq) {
-				if (match) {
-					*match = rpl;
-				} else {
-					bt_mesh_rpl_update(rpl, rx);
-				}
+		if (rx->old_iv && !rpl->old_iv) {
+			return true;
+		}
 
-				return false;
-			} else {
-				return true;
-			}
+		/* Neither from a newer IV Index nor a newer sequence number */
+		if ((rx->old_iv || !rpl->old_iv) && rpl->seq >= rx->seq) {
+			return true;
+		}
+	} else {
+		rpl = rpl_empty_slot();
+		if (!rpl) {
+			BT_ERR("RPL is full!");
+			return true;
 		}
 	}
 
-	BT_ERR("RPL is full!");
-	return true;
+	if (match) {
+		*match = rpl;
+	} else {
+		bt_mesh_rpl_update(rpl, rx);
+	}
+
+	return false;
 }
 
 void bt_mesh_rpl_clear(void)
@@ -101,16 +158,23 @@ void bt_mesh_rpl_clear(void)
 		bt_mesh_clear_rpl();
 	} else {
 		(void)memset(replay_list, 0, sizeof(replay_list));
+		(void)memset(rpl_bucket, 0, sizeof(rpl_bucket));
+		(void)memset(rpl_chain, 0, sizeof(rpl_chain));
+		rpl_count = 0U;
 	}
 }
 
 struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src)
 {
-	int i;
+	uint16_t i;
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		if (replay_list[i].src == src) {
-			return &replay_list[i];
+	if (!src) {
+		return NULL;
+	}
+
+	for (i = *rpl_head(src); i; i = rpl_chain[i - 1]) {
+		if (replay_list[i - 1].src == src) {
+			return &replay_list[i - 1];
 		}
 	}
 
@@ -119,16 +183,20 @@ struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src)
 
 struct bt_mesh_rpl *bt_mesh_rpl_alloc(uint16_t src)
 {
-	int i;
+	struct bt_mesh_rpl *rpl;
 
-	for (i = 0; i < ARRAY_SIZE(replay_list); i++) {
-		if (!replay_list[i].src) {
-			replay_list[i].src = src;
-			return &replay_list[i];
-		}
+	rpl = rpl_empty_slot();
+	if (rpl) {
+		rpl_link(rpl, src);
 	}
 
-	return NULL;
+	return rpl;
+}
+
+void bt_mesh_rpl_free(struct bt_mesh_rpl *rpl)
+{
+	rpl_unlink(rpl);
+	(void)memset(rpl, 0, sizeof(*rpl));
 }
 
 void bt_mesh_rpl_foreach(bt_mesh_rpl_func_t func, void *user_data)
@@ -152,7 +220,7 @@ void bt_mesh_rpl_reset(void)
 
 		if (rpl->src) {
 			if (rpl->old_iv) {
-				(void)memset(rpl, 0, sizeof(*rpl));
+				bt_mesh_rpl_free(rpl);
 			} else {
 				rpl->old_iv = true;
 			}
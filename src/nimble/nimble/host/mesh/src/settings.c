@@ -145,7 +145,11 @@ struct node_update {
 };
 
 #if MYNEWT_VAL(BLE_MESH_CDB)
+/* Nodes changed since the last store, kept packed at the start of the array so
+ * storing scales with the number of changes rather than the number of nodes.
+ */
 static struct node_update cdb_node_updates[MYNEWT_VAL(BLE_MESH_CDB_NODE_COUNT)];
+static uint16_t cdb_node_update_count;
 static struct key_update cdb_key_updates[
 					MYNEWT_VAL(BLE_MESH_CDB_SUBNET_COUNT) +
 					MYNEWT_VAL(BLE_MESH_CDB_APP_KEY_COUNT)];
@@ -279,9 +283,11 @@ static int seq_set(int argc, char **argv, char *val)
 	bt_mesh.seq = sys_get_le24(seq.val);
 
 	if (CONFIG_BT_MESH_SEQ_STORE_RATE > 0) {
-		/* Make sure we have a large enough sequence number. We
-		 * subtract 1 so that the first transmission causes a write
-		 * to the settings storage.
+		/* Make sure we have a large enough sequence number. The
+		 * stored value already reserves the block it was written
+		 * in, so this also covers a reservation written by an older
+		 * build. We subtract 1 so that the first transmission causes
+		 * a write to the settings storage.
 		 */
 		bt_mesh.seq += (CONFIG_BT_MESH_SEQ_STORE_RATE -
 				(bt_mesh.seq % CONFIG_BT_MESH_SEQ_STORE_RATE));
@@ -312,7 +318,7 @@ static int rpl_set(int argc, char **argv, char *val)
 
 	if (!val) {
 		if (entry) {
-			memset(entry, 0, sizeof(*entry));
+			bt_mesh_rpl_free(entry);
 		} else {
 			BT_WARN("Unable to find RPL entry for 0x%04x", src);
 		}
@@ -1037,14 +1043,17 @@ static int mesh_commit(void)
 
 /* Pending flags that use K_NO_WAIT as the storage timeout */
 #define NO_WAIT_PENDING_BITS (BIT(BT_MESH_NET_PENDING) |           \
-			      BIT(BT_MESH_IV_PENDING) |            \
-			      BIT(BT_MESH_SEQ_PENDING))
+			      BIT(BT_MESH_IV_PENDING))
 
-/* Pending flags that use CONFIG_BT_MESH_STORE_TIMEOUT */
+/* Pending flags that use CONFIG_BT_MESH_STORE_TIMEOUT. The Seq is
+ * only deferred while the stored value still reserves enough sequence
+ * numbers, see bt_mesh_store_seq().
+ */
 #define GENERIC_PENDING_BITS (BIT(BT_MESH_KEYS_PENDING) |          \
 			      BIT(BT_MESH_HB_PUB_PENDING) |        \
 			      BIT(BT_MESH_CFG_PENDING) |           \
-			      BIT(BT_MESH_MOD_PENDING))
+			      BIT(BT_MESH_MOD_PENDING) |           \
+			      BIT(BT_MESH_SEQ_PENDING))
 
 static void schedule_store(int flag)
 {
@@ -1171,10 +1180,18 @@ static void store_pending_seq(void)
 {
 	char buf[BT_SETTINGS_SIZE(sizeof(struct seq_val))];
 	struct seq_val seq;
+	uint32_t val;
 	char *str;
 	int err;
 
-	sys_put_le24(bt_mesh.seq, seq.val);
+	val = bt_mesh.seq;
+	if (CONFIG_BT_MESH_SEQ_STORE_RATE > 0) {
+		/* Reserve the rest of the current block */
+		val += CONFIG_BT_MESH_SEQ_STORE_RATE -
+		       (val % CONFIG_BT_MESH_SEQ_STORE_RATE);
+	}
+
+	sys_put_le24(val, seq.val);
 
 	str = settings_str_from_bytes(&seq, sizeof(seq), buf, sizeof(buf));
 	if (!str) {
@@ -1198,7 +1215,19 @@ void bt_mesh_store_seq(void)
 		return;
 	}
 
-	schedule_store(BT_MESH_SEQ_PENDING);
+	/* The stored value reserves a block of sequence numbers ahead, so
+	 * its write can wait to be batched with the other pending settings
+	 * until the next block is entered. Only if it is still pending then
+	 * is it written right away.
+	 */
+	if (CONFIG_BT_MESH_SEQ_STORE_RATE &&
+	    !atomic_test_bit(bt_mesh.flags, BT_MESH_SEQ_PENDING)) {
+		schedule_store(BT_MESH_SEQ_PENDING);
+		return;
+	}
+
+	atomic_set_bit(bt_mesh.flags, BT_MESH_SEQ_PENDING);
+	k_delayed_work_submit(&pending_store, K_NO_WAIT);
 }
 
 static void store_rpl(struct bt_mesh_rpl *entry)
@@ -1249,7 +1278,7 @@ static void clear_rpl(struct bt_mesh_rpl *rpl, void *user_data)
 		BT_DBG("Cleared RPL");
 	}
 
-	(void)memset(rpl, 0, sizeof(*rpl));
+	bt_mesh_rpl_free(rpl);
 }
 
 static void store_pending_rpl(struct bt_mesh_rpl *rpl, void *user_data)
@@ -1571,13 +1600,9 @@ static void store_pending_cdb_nodes(void)
 {
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(cdb_node_updates); ++i) {
+	for (i = 0; i < cdb_node_update_count; ++i) {
 		struct node_update *update = &cdb_node_updates[i];
 
-		if (update->addr == BT_MESH_ADDR_UNASSIGNED) {
-			continue;
-		}
-
 		BT_DBG("addr: 0x%04x, clear: %d", update->addr, update->clear);
 
 		if (update->clear) {
@@ -1595,6 +1620,8 @@ static void store_pending_cdb_nodes(void)
 
 		update->addr = BT_MESH_ADDR_UNASSIGNED;
 	}
+
+	cdb_node_update_count = 0;
 }
 
 static void store_cdb_subnet(const struct bt_mesh_cdb_subnet *sub)
@@ -1737,19 +1764,19 @@ static struct node_update *cdb_node_update_find(uint16_t addr,
 	match = NULL;
 	*free_slot = NULL;
 
-	for (i = 0; i < ARRAY_SIZE(cdb_node_updates); i++) {
+	for (i = 0; i < cdb_node_update_count; i++) {
 		struct node_update *update = &cdb_node_updates[i];
 
-		if (update->addr == BT_MESH_ADDR_UNASSIGNED) {
-			*free_slot = update;
-			continue;
-		}
-
 		if (update->addr == addr) {
 			match = update;
+			break;
 		}
 	}
 
+	if (cdb_node_update_count < ARRAY_SIZE(cdb_node_updates)) {
+		*free_slot = &cdb_node_updates[cdb_node_update_count];
+	}
+
 	return match;
 }
 #endif
@@ -2245,6 +2272,7 @@ void bt_mesh_store_cdb_node(const struct bt_mesh_cdb_node *node)
 
 	free_slot->addr = node->addr;
 	free_slot->clear = false;
+	cdb_node_update_count++;
 
 	schedule_cdb_store(BT_MESH_CDB_NODES_PENDING);
 }
@@ -2269,6 +2297,7 @@ void bt_mesh_clear_cdb_node(struct bt_mesh_cdb_node *node)
 
 	free_slot->addr = node->addr;
 	free_slot->clear = true;
+	cdb_node_update_count++;
 
 	schedule_cdb_store(BT_MESH_CDB_NODES_PENDING);
 }
@@ -67,6 +67,11 @@
 	(BT_MESH_ADDR_IS_UNICAST(tx->dst) ?                                    \
 		 SEG_RETRANSMIT_TIMEOUT_UNICAST(tx) :                          \
 		 SEG_RETRANSMIT_TIMEOUT_GROUP)
+/* The unicast retransmit timeout is doubled each time it expires without
+ * an ack, up to this many times the initial value, and restored when an
+ * ack acknowledges new segments.
+ */
+#define SEG_RETRANSMIT_BACKOFF_MAX  4
 /* How long to wait for available buffers before giving up */
 #define BUF_TIMEOUT                 K_NO_WAIT
 
@@ -90,7 +95,9 @@ static struct seg_tx {
 			      		  aszmic:1,      /* MIC size */
 			      		  started:1,     /* Start cb called */
 			      		  sending:1,     /* Sending is in progress */
-			      		  friend_cred:1; /* Using Friend credentials */
+			      		  friend_cred:1, /* Using Friend credentials */
+			      		  ack_wait:1;    /* Timer waits for an ack */
+	uint16_t              rtx_timeout;   /* Current retransmit timeout */
 	const struct bt_mesh_send_cb *cb;
 	void                  *cb_data;
 	struct k_delayed_work retransmit; /* Retransmit timer */
@@ -302,8 +309,9 @@ static void schedule_retransmit(struct seg_tx *tx)
 	 * called this from inside bt_mesh_net_send), we should continue the
 	 * retransmit immediately, as we just freed up a tx buffer.
 	 */
+	tx->ack_wait = !tx->seg_o;
 	k_delayed_work_submit(&tx->retransmit,
-			      tx->seg_o ? 0 : K_MSEC(SEG_RETRANSMIT_TIMEOUT(tx)));
+			      tx->seg_o ? 0 : K_MSEC(tx->rtx_timeout));
 }
 
 static void seg_send_start(uint16_t duration, int err, void *user_data)
@@ -424,8 +432,9 @@ static void seg_tx_send_unacked(struct seg_tx *tx)
 	tx->attempts--;
 end:
 	if (!tx->seg_pending) {
+		tx->ack_wait = 1U;
 		k_delayed_work_submit(&tx->retransmit,
-					  SEG_RETRANSMIT_TIMEOUT(tx));
+					  K_MSEC(tx->rtx_timeout));
 	}
 
 	tx->sending = 0U;
@@ -434,6 +443,17 @@ end:
 static void seg_retransmit(struct ble_npl_event *work)
 {
 	struct seg_tx *tx = ble_npl_event_get_arg(work);
+
+	/* No ack arrived in time, the path to the peer is slower or more
+	 * congested than expected so wait longer before the next attempt.
+	 */
+	if (tx->ack_wait && BT_MESH_ADDR_IS_UNICAST(tx->dst) &&
+	    tx->rtx_timeout < SEG_RETRANSMIT_BACKOFF_MAX * SEG_RETRANSMIT_TIMEOUT(tx)) {
+		tx->rtx_timeout = MIN(tx->rtx_timeout * 2,
+				      SEG_RETRANSMIT_BACKOFF_MAX * SEG_RETRANSMIT_TIMEOUT(tx));
+	}
+
+	tx->ack_wait = 0U;
 	seg_tx_send_unacked(tx);
 }
 
@@ -492,6 +512,8 @@ static int send_seg(struct bt_mesh_net_tx *net_tx, struct os_mbuf *sdu,
 	tx->ctl = !!ctl_op;
 
 	tx->ttl = net_tx->ctx->send_ttl;
+	tx->rtx_timeout = SEG_RETRANSMIT_TIMEOUT(tx);
+	tx->ack_wait = 0U;
 
 	BT_DBG("SeqZero 0x%04x (segs: %u)",
 	       (uint16_t)(tx->seq_auth & TRANS_SEQ_ZERO_MASK), tx->nack_count);
@@ -798,6 +820,7 @@ static int trans_ack(struct bt_mesh_net_rx *rx, uint8_t hdr,
 	unsigned int bit;
 	uint32_t ack;
 	uint16_t seq_zero;
+	uint8_t nack_count;
 	uint8_t obo;
 
 	if (buf->om_len < 6) {
@@ -846,6 +869,8 @@ static int trans_ack(struct bt_mesh_net_rx *rx, uint8_t hdr,
 	}
 
 	k_delayed_work_cancel(&tx->retransmit);
+	tx->ack_wait = 0U;
+	nack_count = tx->nack_count;
 
 	while ((bit = find_lsb_set(ack))) {
 		if (tx->seg[bit - 1]) {
@@ -856,6 +881,15 @@ static int trans_ack(struct bt_mesh_net_rx *rx, uint8_t hdr,
 		ack &= ~BIT(bit - 1);
 	}
 
+	/* The peer is reachable and receiving, so only the segments it is
+	 * missing are sent again at the initial timeout with the full number
+	 * of attempts.
+	 */
+	if (tx->nack_count < nack_count) {
+		tx->rtx_timeout = SEG_RETRANSMIT_TIMEOUT(tx);
+		tx->attempts = SEG_RETRANSMIT_ATTEMPTS;
+	}
+
 	if (tx->nack_count) {
 		seg_tx_send_unacked(tx);
 	} else {
@@ -29,6 +29,8 @@ extern "C" {
 struct ble_hs_cfg;
 
 #define BLE_SVC_GATT_CHR_SERVICE_CHANGED_UUID16     0x2a05
+#define BLE_SVC_GATT_CHR_CLIENT_SUPPORTED_FEATURES_UUID16 0x2b29
+#define BLE_SVC_GATT_CHR_DATABASE_HASH_UUID16       0x2b2a
 
 void ble_svc_gatt_changed(uint16_t start_handle, uint16_t end_handle);
 void ble_svc_gatt_init(void);
@@ -24,6 +24,12 @@
 #include "../include/services/gatt/ble_svc_gatt.h"
 
 static uint16_t ble_svc_gatt_changed_val_handle;
+#if MYNEWT_VAL(BLE_GATT_NOTIFY_MULTIPLE) || MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+static uint16_t ble_svc_gatt_cl_sup_feat_val_handle;
+#endif
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+static uint16_t ble_svc_gatt_db_hash_val_handle;
+#endif
 static uint16_t ble_svc_gatt_start_handle;
 static uint16_t ble_svc_gatt_end_handle;
 
@@ -42,6 +48,20 @@ static const struct ble_gatt_svc_def ble_svc_gatt_defs[] = {
             .val_handle = &ble_svc_gatt_changed_val_handle,
             .flags = BLE_GATT_CHR_F_INDICATE,
         }, {
+#if MYNEWT_VAL(BLE_GATT_NOTIFY_MULTIPLE) || MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+            .uuid = BLE_UUID16_DECLARE(BLE_SVC_GATT_CHR_CLIENT_SUPPORTED_FEATURES_UUID16),
+            .access_cb = ble_svc_gatt_access,
+            .val_handle = &ble_svc_gatt_cl_sup_feat_val_handle,
+            .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+        }, {
+#endif
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+            .uuid = BLE_UUID16_DECLARE(BLE_SVC_GATT_CHR_DATABASE_HASH_UUID16),
+            .access_cb = ble_svc_gatt_access,
+            .val_handle = &ble_svc_gatt_db_hash_val_handle,
+            .flags = BLE_GATT_CHR_F_READ,
+        }, {
+#endif
             0, /* No more characteristics in this service. */
         } },
     },
@@ -57,6 +77,45 @@ ble_svc_gatt_access(uint16_t conn_handle, uint16_t attr_handle,
 {
     uint8_t *u8p;
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    uint8_t hash[16];
+#endif
+#if MYNEWT_VAL(BLE_GATT_NOTIFY_MULTIPLE) || MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    uint8_t feat[BLE_GATT_CHR_CLI_SUP_FEAT_SZ];
+    int rc;
+
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    if (attr_handle == ble_svc_gatt_db_hash_val_handle) {
+        rc = ble_gatts_db_hash(hash);
+        if (rc != 0) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+
+        /* The peer read the current hash, its next request makes it
+         * change-aware.
+         */
+        (void)ble_gatts_change_aware(conn_handle, 1);
+
+        rc = os_mbuf_append(ctxt->om, hash, sizeof hash);
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+#endif
+
+    if (attr_handle == ble_svc_gatt_cl_sup_feat_val_handle) {
+        if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+            return ble_gatts_peer_cl_sup_feat_update(conn_handle, ctxt->om);
+        }
+
+        rc = ble_gatts_peer_cl_sup_feat_get(conn_handle, feat, sizeof feat);
+        if (rc != 0) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+
+        rc = os_mbuf_append(ctxt->om, feat, sizeof feat);
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+#endif
+
     /* The only operation allowed for this characteristic is indicate.  This
      * access callback gets called by the stack when it needs to read the
      * characteristic value to populate the outgoing indication command.
@@ -89,6 +148,9 @@ ble_svc_gatt_changed(uint16_t start_handle, uint16_t end_handle)
 {
     ble_svc_gatt_start_handle = start_handle;
     ble_svc_gatt_end_handle = end_handle;
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    ble_gatts_db_changed();
+#endif
     ble_gatts_chr_updated(ble_svc_gatt_changed_val_handle);
 }
 
@@ -399,6 +399,53 @@ ble_att_truncate_to_mtu(const struct ble_l2cap_chan *att_chan,
     }
 }
 
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+void
+ble_att_trace_pdu(uint8_t type, uint16_t conn_handle,
+                  const struct os_mbuf *om)
+{
+    uint16_t attr_handle;
+    uint8_t hdr[5];
+    uint8_t op;
+    int rc;
+
+    attr_handle = 0;
+    rc = 0;
+
+    if (os_mbuf_copydata(om, 0, 1, hdr) != 0) {
+        return;
+    }
+    op = hdr[0];
+
+    switch (op) {
+    case BLE_ATT_OP_READ_REQ:
+    case BLE_ATT_OP_READ_BLOB_REQ:
+    case BLE_ATT_OP_WRITE_REQ:
+    case BLE_ATT_OP_WRITE_CMD:
+    case BLE_ATT_OP_PREP_WRITE_REQ:
+    case BLE_ATT_OP_PREP_WRITE_RSP:
+    case BLE_ATT_OP_NOTIFY_REQ:
+    case BLE_ATT_OP_INDICATE_REQ:
+        if (os_mbuf_copydata(om, 1, 2, hdr + 1) == 0) {
+            attr_handle = get_le16(hdr + 1);
+        }
+        break;
+
+    case BLE_ATT_OP_ERROR_RSP:
+        if (os_mbuf_copydata(om, 1, 4, hdr + 1) == 0) {
+            attr_handle = get_le16(hdr + 2);
+            rc = hdr[4];
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    BLE_HS_TRACE(type, op, conn_handle, attr_handle, OS_MBUF_PKTLEN(om), rc);
+}
+#endif
+
 uint16_t
 ble_att_mtu(uint16_t conn_handle)
 {
@@ -468,6 +515,69 @@ ble_att_rx_handle_unknown_request(uint8_t op, uint16_t conn_handle,
     *om = NULL;
 }
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+/**
+ * Checks the requests and commands that access attributes by handle against
+ * the change-aware state of the peer.  A request from a change-unaware peer
+ * is answered with a Database Out Of Sync error, a command is dropped.
+ *
+ * @return                      0 if the PDU can be processed;
+ *                              BLE_HS_EAGAIN if it was consumed.
+ */
+static int
+ble_att_rx_change_aware(uint8_t op, uint16_t conn_handle, struct os_mbuf **om)
+{
+    uint16_t handle;
+    uint16_t uuid16;
+    int req;
+
+    switch (op) {
+    case BLE_ATT_OP_READ_TYPE_REQ:
+        /* Reading the Database Hash by type is how the peer gets aware. */
+        if (OS_MBUF_PKTLEN(*om) == 7 &&
+            os_mbuf_copydata(*om, 5, 2, &uuid16) == 0 &&
+            get_le16(&uuid16) == BLE_GATT_CHR_DB_HASH_UUID16) {
+            return 0;
+        }
+        /* fallthrough */
+    case BLE_ATT_OP_READ_REQ:
+    case BLE_ATT_OP_READ_BLOB_REQ:
+    case BLE_ATT_OP_READ_MULT_REQ:
+    case BLE_ATT_OP_WRITE_REQ:
+    case BLE_ATT_OP_PREP_WRITE_REQ:
+    case BLE_ATT_OP_EXEC_WRITE_REQ:
+        req = 1;
+        break;
+
+    case BLE_ATT_OP_WRITE_CMD:
+        req = 0;
+        break;
+
+    default:
+        return 0;
+    }
+
+    if (ble_gatts_change_aware(conn_handle, req)) {
+        return 0;
+    }
+
+    if (req) {
+        handle = 0;
+        if (op != BLE_ATT_OP_EXEC_WRITE_REQ &&
+            os_mbuf_copydata(*om, 1, 2, &handle) == 0) {
+            handle = get_le16(&handle);
+        }
+
+        os_mbuf_adj(*om, OS_MBUF_PKTLEN(*om));
+        ble_att_svr_tx_error_rsp(conn_handle, *om, op, handle,
+                                 BLE_ATT_ERR_DB_OUT_OF_SYNC);
+        *om = NULL;
+    }
+
+    return BLE_HS_EAGAIN;
+}
+#endif
+
 static int
 ble_att_rx(struct ble_l2cap_chan *chan)
 {
@@ -490,6 +600,10 @@ ble_att_rx(struct ble_l2cap_chan *chan)
         return BLE_HS_EMSGSIZE;
     }
 
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+    ble_att_trace_pdu(BLE_HS_TRACE_ATT_RX, conn_handle, *om);
+#endif
+
     entry = ble_att_rx_dispatch_entry_find(op);
     if (entry == NULL) {
         ble_att_rx_handle_unknown_request(op, conn_handle, om);
@@ -498,6 +612,13 @@ ble_att_rx(struct ble_l2cap_chan *chan)
 
     ble_att_inc_rx_stat(op);
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    rc = ble_att_rx_change_aware(op, conn_handle, om);
+    if (rc != 0) {
+        return rc;
+    }
+#endif
+
     /* Strip L2CAP ATT header from the front of the mbuf. */
     os_mbuf_adj(*om, 1);
 
@@ -692,6 +692,7 @@ ble_att_clt_tx_write_req(uint16_t conn_handle, uint16_t handle,
     }
 
     req->bawq_handle = htole16(handle);
+    ble_hs_mbuf_copy_tx_prio(txom2, txom);
     os_mbuf_concat(txom2, txom);
 
     return ble_att_tx(conn_handle, txom2);
@@ -729,6 +730,7 @@ ble_att_clt_tx_write_cmd(uint16_t conn_handle, uint16_t handle,
     }
 
     cmd->handle = htole16(handle);
+    ble_hs_mbuf_copy_tx_prio(txom2, txom);
     os_mbuf_concat(txom2, txom);
 
     return ble_att_tx(conn_handle, txom2);
@@ -898,6 +900,7 @@ ble_att_clt_tx_notify(uint16_t conn_handle, uint16_t handle,
     }
 
     req->banq_handle = htole16(handle);
+    ble_hs_mbuf_copy_tx_prio(txom2, txom);
     os_mbuf_concat(txom2, txom);
 
     return ble_att_tx(conn_handle, txom2);
@@ -907,6 +910,30 @@ err:
     return rc;
 }
 
+/**
+ * Sends a Multiple Handle Value Notification.  The supplied mbuf holds the
+ * handle, length and value tuples and is consumed.
+ */
+int
+ble_att_clt_tx_notify_mult(uint16_t conn_handle, struct os_mbuf *txom)
+{
+#if !NIMBLE_BLE_ATT_CLT_NOTIFY
+    os_mbuf_free_chain(txom);
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct os_mbuf *txom2;
+
+    if (ble_att_cmd_get(BLE_ATT_OP_NOTIFY_MULTI_REQ, 0, &txom2) == NULL) {
+        os_mbuf_free_chain(txom);
+        return BLE_HS_ENOMEM;
+    }
+
+    os_mbuf_concat(txom2, txom);
+
+    return ble_att_tx(conn_handle, txom2);
+}
+
 /*****************************************************************************
  * $handle value indication                                                  *
  *****************************************************************************/
@@ -935,6 +962,7 @@ ble_att_clt_tx_indicate(uint16_t conn_handle, uint16_t handle,
     }
 
     req->baiq_handle = htole16(handle);
+    ble_hs_mbuf_copy_tx_prio(txom2, txom);
     os_mbuf_concat(txom2, txom);
 
     return ble_att_tx(conn_handle, txom2);
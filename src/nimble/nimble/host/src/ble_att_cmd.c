@@ -73,6 +73,9 @@ ble_att_tx(uint16_t conn_handle, struct os_mbuf *txom)
         os_mbuf_free_chain(txom);
     } else {
         ble_att_truncate_to_mtu(chan, txom);
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+        ble_att_trace_pdu(BLE_HS_TRACE_ATT_TX, conn_handle, txom);
+#endif
         rc = ble_l2cap_tx(conn, chan, txom);
     }
 
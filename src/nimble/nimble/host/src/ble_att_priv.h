@@ -111,8 +111,8 @@ struct ble_att_prep_entry {
     uint16_t bape_handle;
     uint16_t bape_offset;
 
-    /* XXX: This is wasteful; we should use one mbuf chain for the entire
-     * prepared write, and compress the data into as few mbufs as possible.
+    /* Prepared writes that continue the last entry are appended to its
+     * value, so a long write in order uses a single entry and mbuf chain.
      */
     struct os_mbuf *bape_value;
 };
@@ -122,6 +122,8 @@ SLIST_HEAD(ble_att_prep_entry_list, ble_att_prep_entry);
 struct ble_att_svr_conn {
     /** This list is sorted by attribute handle ID. */
     struct ble_att_prep_entry_list basc_prep_list;
+    /** The last entry of basc_prep_list, NULL if the list is empty. */
+    struct ble_att_prep_entry *basc_prep_tail;
     ble_npl_time_t basc_prep_timeout_at;
 };
 
@@ -147,6 +149,8 @@ int ble_att_svr_register(const ble_uuid_t *uuid, uint8_t flags,
 
 struct ble_att_svr_entry {
     STAILQ_ENTRY(ble_att_svr_entry) ha_next;
+    /* Next entry, in handle order, in the same UUID index bucket. */
+    struct ble_att_svr_entry *ha_uuid_next;
 
     const ble_uuid_t *ha_uuid;
     uint8_t ha_flags;
@@ -164,6 +168,10 @@ struct ble_l2cap_chan *ble_att_create_chan(uint16_t conn_handle);
 int ble_att_conn_chan_find(uint16_t conn_handle, struct ble_hs_conn **out_conn,
                            struct ble_l2cap_chan **out_chan);
 void ble_att_inc_tx_stat(uint8_t att_op);
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+void ble_att_trace_pdu(uint8_t type, uint16_t conn_handle,
+                       const struct os_mbuf *om);
+#endif
 void ble_att_truncate_to_mtu(const struct ble_l2cap_chan *att_chan,
                              struct os_mbuf *txom);
 void ble_att_set_peer_mtu(struct ble_l2cap_chan *chan, uint16_t peer_mtu);
@@ -290,6 +298,7 @@ int ble_att_clt_rx_exec_write(uint16_t conn_handle, struct os_mbuf **rxom);
 int ble_att_clt_rx_write(uint16_t conn_handle, struct os_mbuf **rxom);
 int ble_att_clt_tx_notify(uint16_t conn_handle, uint16_t handle,
                           struct os_mbuf *txom);
+int ble_att_clt_tx_notify_mult(uint16_t conn_handle, struct os_mbuf *txom);
 int ble_att_clt_tx_indicate(uint16_t conn_handle, uint16_t handle,
                             struct os_mbuf *txom);
 int ble_att_clt_rx_indicate(uint16_t conn_handle, struct os_mbuf **rxom);
@@ -58,6 +58,26 @@ static uint16_t ble_att_svr_id;
 static void *ble_att_svr_entry_mem;
 static struct os_mempool ble_att_svr_entry_pool;
 
+/**
+ * Visible entries indexed by handle, starting at ble_att_svr_handle_base.
+ * Handles are assigned sequentially when the attributes are registered so
+ * the table is dense; hidden entries have a NULL slot.
+ */
+static struct ble_att_svr_entry **ble_att_svr_handle_table;
+static uint16_t ble_att_svr_handle_base;
+static uint16_t ble_att_svr_handle_table_len;
+
+/**
+ * Entries chained by UUID hash so that requests for an attribute type only
+ * walk the entries of that type.  Hidden entries stay in their chain and are
+ * skipped using the handle table.
+ */
+#define BLE_ATT_SVR_UUID_BUCKET_BITS    4
+#define BLE_ATT_SVR_UUID_BUCKETS        (1 << BLE_ATT_SVR_UUID_BUCKET_BITS)
+
+static struct ble_att_svr_entry *ble_att_svr_uuid_heads[BLE_ATT_SVR_UUID_BUCKETS];
+static struct ble_att_svr_entry *ble_att_svr_uuid_tails[BLE_ATT_SVR_UUID_BUCKETS];
+
 static os_membuf_t ble_att_svr_prep_entry_mem[
     OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_ATT_SVR_MAX_PREP_ENTRIES),
                     sizeof (struct ble_att_prep_entry))
@@ -84,6 +104,148 @@ ble_att_svr_entry_free(struct ble_att_svr_entry *entry)
     os_memblock_put(&ble_att_svr_entry_pool, entry);
 }
 
+/**
+ * Get the handle table slot of an attribute handle.
+ *
+ * @param handle_id             The handle of the attribute.
+ *
+ * @return                      A pointer to the slot; NULL if the handle is
+ *                                  not covered by the table.
+ */
+static struct ble_att_svr_entry **
+ble_att_svr_handle_slot(uint16_t handle_id)
+{
+    if (ble_att_svr_handle_table == NULL ||
+        handle_id < ble_att_svr_handle_base ||
+        handle_id - ble_att_svr_handle_base >= ble_att_svr_handle_table_len) {
+
+        return NULL;
+    }
+
+    return &ble_att_svr_handle_table[handle_id - ble_att_svr_handle_base];
+}
+
+static uint8_t
+ble_att_svr_uuid_bucket(const ble_uuid_t *uuid)
+{
+    const uint8_t *val;
+    uint32_t hash;
+    int i;
+
+    switch (uuid->type) {
+    case BLE_UUID_TYPE_16:
+        hash = BLE_UUID16(uuid)->value;
+        break;
+    case BLE_UUID_TYPE_32:
+        hash = BLE_UUID32(uuid)->value;
+        break;
+    default:
+        val = BLE_UUID128(uuid)->value;
+        hash = 0;
+        for (i = 0; i < 16; i += 4) {
+            hash ^= get_le32(val + i);
+        }
+        break;
+    }
+
+    return (hash * 0x9e3779b1) >> (32 - BLE_ATT_SVR_UUID_BUCKET_BITS);
+}
+
+static void
+ble_att_svr_uuid_index_clear(void)
+{
+    memset(ble_att_svr_uuid_heads, 0, sizeof ble_att_svr_uuid_heads);
+    memset(ble_att_svr_uuid_tails, 0, sizeof ble_att_svr_uuid_tails);
+}
+
+/**
+ * Indicates whether the UUID chains and the handle table can be used to
+ * find entries; they are only kept once the attribute memory is allocated.
+ */
+static int
+ble_att_svr_uuid_index_ready(void)
+{
+    return ble_att_svr_handle_table != NULL;
+}
+
+/**
+ * Walk a UUID chain for the next visible entry of a type.
+ *
+ * @param entry                 The chain entry to start at, inclusive.
+ * @param uuid                  The attribute type to search for.
+ * @param start_handle          The lowest handle to return.
+ * @param end_handle            The highest handle to return.
+ *
+ * @return                      The matching entry; NULL if there is none.
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_uuid_chain_find(struct ble_att_svr_entry *entry,
+                            const ble_uuid_t *uuid,
+                            uint16_t start_handle, uint16_t end_handle)
+{
+    struct ble_att_svr_entry **slot;
+
+    for (;
+         entry != NULL && entry->ha_handle_id <= end_handle;
+         entry = entry->ha_uuid_next) {
+
+        if (entry->ha_handle_id < start_handle) {
+            continue;
+        }
+
+        slot = ble_att_svr_handle_slot(entry->ha_handle_id);
+        if (slot != NULL && *slot != entry) {
+            /* Hidden. */
+            continue;
+        }
+
+        if (ble_uuid_cmp(entry->ha_uuid, uuid) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the entry to start a walk of the attribute list from.
+ *
+ * @param start_handle          The lowest handle of interest.
+ *
+ * @return                      The first visible entry with a handle of at
+ *                                  least start_handle when the handle table
+ *                                  covers it, otherwise the head of the
+ *                                  list; callers must still check the
+ *                                  handle of each entry they walk.
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_find_first(uint16_t start_handle)
+{
+    struct ble_att_svr_entry **slot;
+    uint16_t handle_id;
+
+    if (ble_att_svr_handle_table == NULL ||
+        start_handle <= ble_att_svr_handle_base) {
+
+        return STAILQ_FIRST(&ble_att_svr_list);
+    }
+
+    for (handle_id = start_handle;
+         handle_id != 0 && handle_id <= ble_att_svr_id;
+         handle_id++) {
+
+        slot = ble_att_svr_handle_slot(handle_id);
+        if (slot == NULL) {
+            return STAILQ_FIRST(&ble_att_svr_list);
+        }
+        if (*slot != NULL) {
+            return *slot;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  * Allocate the next handle id and return it.
  *
@@ -113,7 +275,9 @@ ble_att_svr_register(const ble_uuid_t *uuid, uint8_t flags,
                      uint8_t min_key_size, uint16_t *handle_id,
                      ble_att_svr_access_fn *cb, void *cb_arg)
 {
+    struct ble_att_svr_entry **slot;
     struct ble_att_svr_entry *entry;
+    uint8_t bucket;
 
     entry = ble_att_svr_entry_alloc();
     if (entry == NULL) {
@@ -129,6 +293,19 @@ ble_att_svr_register(const ble_uuid_t *uuid, uint8_t flags,
 
     STAILQ_INSERT_TAIL(&ble_att_svr_list, entry, ha_next);
 
+    slot = ble_att_svr_handle_slot(entry->ha_handle_id);
+    if (slot != NULL) {
+        *slot = entry;
+    }
+
+    bucket = ble_att_svr_uuid_bucket(uuid);
+    if (ble_att_svr_uuid_tails[bucket] == NULL) {
+        ble_att_svr_uuid_heads[bucket] = entry;
+    } else {
+        ble_att_svr_uuid_tails[bucket]->ha_uuid_next = entry;
+    }
+    ble_att_svr_uuid_tails[bucket] = entry;
+
     if (handle_id != NULL) {
         *handle_id = entry->ha_handle_id;
     }
@@ -159,8 +336,14 @@ ble_att_svr_prev_handle(void)
 struct ble_att_svr_entry *
 ble_att_svr_find_by_handle(uint16_t handle_id)
 {
+    struct ble_att_svr_entry **slot;
     struct ble_att_svr_entry *entry;
 
+    slot = ble_att_svr_handle_slot(handle_id);
+    if (slot != NULL) {
+        return *slot;
+    }
+
     for (entry = STAILQ_FIRST(&ble_att_svr_list);
          entry != NULL;
          entry = STAILQ_NEXT(entry, ha_next)) {
@@ -188,28 +371,65 @@ ble_att_svr_find_by_handle(uint16_t handle_id)
  *
  * @return                      0 on success; BLE_HS_ENOENT on not found.
  */
+static struct ble_att_svr_entry *
+ble_att_svr_find_by_uuid_at(struct ble_att_svr_entry *entry,
+                            const ble_uuid_t *uuid, uint16_t end_handle)
+{
+    for (;
+         entry != NULL && entry->ha_handle_id <= end_handle;
+         entry = STAILQ_NEXT(entry, ha_next)) {
+
+        if (uuid == NULL || ble_uuid_cmp(entry->ha_uuid, uuid) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
 struct ble_att_svr_entry *
 ble_att_svr_find_by_uuid(struct ble_att_svr_entry *prev, const ble_uuid_t *uuid,
                          uint16_t end_handle)
 {
     struct ble_att_svr_entry *entry;
 
+    /* Continue along the UUID chain when walking entries of one type. */
+    if (uuid != NULL && ble_att_svr_uuid_index_ready() &&
+        (prev == NULL || ble_uuid_cmp(prev->ha_uuid, uuid) == 0)) {
+
+        if (prev == NULL) {
+            entry = ble_att_svr_uuid_heads[ble_att_svr_uuid_bucket(uuid)];
+        } else {
+            entry = prev->ha_uuid_next;
+        }
+
+        return ble_att_svr_uuid_chain_find(entry, uuid, 0, end_handle);
+    }
+
     if (prev == NULL) {
         entry = STAILQ_FIRST(&ble_att_svr_list);
     } else {
         entry = STAILQ_NEXT(prev, ha_next);
     }
 
-    for (;
-         entry != NULL && entry->ha_handle_id <= end_handle;
-         entry = STAILQ_NEXT(entry, ha_next)) {
+    return ble_att_svr_find_by_uuid_at(entry, uuid, end_handle);
+}
 
-        if (uuid == NULL || ble_uuid_cmp(entry->ha_uuid, uuid) == 0) {
-            return entry;
-        }
+/**
+ * Find the first visible entry of a type in a handle range.
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_find_first_by_uuid(const ble_uuid_t *uuid, uint16_t start_handle,
+                               uint16_t end_handle)
+{
+    if (ble_att_svr_uuid_index_ready()) {
+        return ble_att_svr_uuid_chain_find(
+            ble_att_svr_uuid_heads[ble_att_svr_uuid_bucket(uuid)],
+            uuid, start_handle, end_handle);
     }
 
-    return NULL;
+    return ble_att_svr_find_by_uuid_at(ble_att_svr_find_first(start_handle),
+                                       uuid, end_handle);
 }
 
 static int
@@ -797,7 +1017,10 @@ ble_att_svr_fill_info(uint16_t start_handle, uint16_t end_handle,
     num_entries = 0;
     rc = 0;
 
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
+    for (ha = ble_att_svr_find_first(start_handle);
+         ha != NULL;
+         ha = STAILQ_NEXT(ha, ha_next)) {
+
         if (ha->ha_handle_id > end_handle) {
             rc = 0;
             goto done;
@@ -1043,6 +1266,99 @@ ble_att_svr_is_valid_group_end(const ble_uuid_t *uuid_group,
     }
 }
 
+/**
+ * Find the handle of the last attribute in the service group starting at a
+ * service declaration, using the UUID chains of the service declarations.
+ */
+static uint16_t
+ble_att_svr_svc_group_end(uint16_t handle_id)
+{
+    static const ble_uuid16_t uuid_pri =
+        BLE_UUID16_INIT(BLE_ATT_UUID_PRIMARY_SERVICE);
+    static const ble_uuid16_t uuid_sec =
+        BLE_UUID16_INIT(BLE_ATT_UUID_SECONDARY_SERVICE);
+    struct ble_att_svr_entry *next_pri;
+    struct ble_att_svr_entry *next_sec;
+    struct ble_att_svr_entry **slot;
+    uint16_t last;
+
+    if (handle_id == 0xffff) {
+        return handle_id;
+    }
+
+    next_pri = ble_att_svr_find_first_by_uuid(&uuid_pri.u, handle_id + 1,
+                                              0xffff);
+    next_sec = ble_att_svr_find_first_by_uuid(&uuid_sec.u, handle_id + 1,
+                                              0xffff);
+    if (next_pri == NULL ||
+        (next_sec != NULL && next_sec->ha_handle_id < next_pri->ha_handle_id)) {
+
+        next_pri = next_sec;
+    }
+
+    last = next_pri != NULL ? next_pri->ha_handle_id - 1 : ble_att_svr_id;
+
+    /* The group ends at the last visible attribute before the next service. */
+    while (last > handle_id) {
+        slot = ble_att_svr_handle_slot(last);
+        if (slot == NULL || *slot != NULL) {
+            break;
+        }
+        last--;
+    }
+
+    return last;
+}
+
+/**
+ * Fills a Find-By-Type-Value response for a service declaration type by
+ * walking only the service declarations.
+ *
+ * @return                      0 when the range was searched or the response
+ *                                  is full; nonzero on failure.
+ */
+static int
+ble_att_svr_fill_svc_type_value(uint16_t conn_handle,
+                                uint16_t start_handle, uint16_t end_handle,
+                                const ble_uuid_t *attr_type,
+                                struct os_mbuf *rxom, struct os_mbuf *txom,
+                                uint16_t mtu, uint8_t *out_att_err)
+{
+    struct ble_att_svr_entry *ha;
+    uint8_t buf[16];
+    uint16_t attr_len;
+    int rc;
+
+    for (ha = ble_att_svr_find_first_by_uuid(attr_type, start_handle,
+                                             end_handle);
+         ha != NULL;
+         ha = ble_att_svr_uuid_chain_find(ha->ha_uuid_next, attr_type,
+                                          start_handle, end_handle)) {
+
+        rc = ble_att_svr_read_flat(conn_handle, ha, 0, sizeof buf, buf,
+                                   &attr_len, out_att_err);
+        if (rc != 0) {
+            return rc;
+        }
+
+        /* value is at the end of req */
+        rc = os_mbuf_cmpf(rxom, sizeof(struct ble_att_find_type_value_req),
+                          buf, attr_len);
+        if (rc != 0) {
+            continue;
+        }
+
+        rc = ble_att_svr_fill_type_value_entry(
+            txom, ha->ha_handle_id,
+            ble_att_svr_svc_group_end(ha->ha_handle_id), mtu, out_att_err);
+        if (rc != BLE_HS_EAGAIN) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Fills the supplied mbuf with the variable length Handles-Information-List
  * field of a Find-By-Type-Value ATT response.
@@ -1078,11 +1394,25 @@ ble_att_svr_fill_type_value(uint16_t conn_handle,
     prev = 0;
     rc = 0;
 
+    /* Service discovery only needs to look at the service declarations. */
+    if (ble_att_svr_uuid_index_ready() &&
+        (ble_uuid_u16(&attr_type.u) == BLE_ATT_UUID_PRIMARY_SERVICE ||
+         ble_uuid_u16(&attr_type.u) == BLE_ATT_UUID_SECONDARY_SERVICE)) {
+
+        rc = ble_att_svr_fill_svc_type_value(conn_handle, start_handle,
+                                             end_handle, &attr_type.u, rxom,
+                                             txom, mtu, out_att_err);
+        goto done;
+    }
+
     /* Iterate through the attribute list, keeping track of the current
      * matching group.  For each attribute entry, determine if data needs to be
      * written to the response.
      */
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
+    for (ha = ble_att_svr_find_first(start_handle);
+         ha != NULL;
+         ha = STAILQ_NEXT(ha, ha_next)) {
+
         if (ha->ha_handle_id < start_handle) {
             continue;
         }
@@ -1307,7 +1637,12 @@ ble_att_svr_build_read_type_rsp(uint16_t conn_handle,
     /* Find all matching attributes, writing a record for each. */
     entry = NULL;
     while (1) {
-        entry = ble_att_svr_find_by_uuid(entry, uuid, end_handle);
+        if (entry == NULL) {
+            entry = ble_att_svr_find_first_by_uuid(uuid, start_handle,
+                                                   end_handle);
+        } else {
+            entry = ble_att_svr_find_by_uuid(entry, uuid, end_handle);
+        }
         if (entry == NULL) {
             rc = BLE_HS_ENOENT;
             break;
@@ -1734,7 +2069,10 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
 
     start_group_handle = 0;
     rsp->bagp_length = 0;
-    STAILQ_FOREACH(entry, &ble_att_svr_list, ha_next) {
+    for (entry = ble_att_svr_find_first(start_handle);
+         entry != NULL;
+         entry = STAILQ_NEXT(entry, ha_next)) {
+
         if (entry->ha_handle_id < start_handle) {
             continue;
         }
@@ -2252,10 +2590,38 @@ ble_att_svr_insert_prep_entry(uint16_t conn_handle,
 {
     struct ble_att_prep_entry *prep_entry;
     struct ble_att_prep_entry *prep_prev;
+    struct ble_att_prep_entry *prep_tail;
     struct ble_hs_conn *conn;
+    uint16_t prev_len;
     int rc;
 
     conn = ble_hs_conn_find_assert(conn_handle);
+    prep_tail = conn->bhc_att_svr.basc_prep_tail;
+
+    /* A write continuing the last prepared one is appended to its entry,
+     * keeping long writes linear in time and using one pool entry.
+     */
+    if (prep_tail != NULL && prep_tail->bape_handle == handle &&
+        prep_tail->bape_offset + OS_MBUF_PKTLEN(prep_tail->bape_value) ==
+        offset) {
+
+        prev_len = OS_MBUF_PKTLEN(prep_tail->bape_value);
+        rc = os_mbuf_appendfrom(
+            prep_tail->bape_value,
+            rxom,
+            sizeof(struct ble_att_prep_write_cmd),
+            OS_MBUF_PKTLEN(rxom) - sizeof(struct ble_att_prep_write_cmd));
+        if (rc != 0) {
+            /* Drop any part of the value appended before running out. */
+            os_mbuf_adj(prep_tail->bape_value,
+                        -(int)(OS_MBUF_PKTLEN(prep_tail->bape_value) -
+                               prev_len));
+            *out_att_err = BLE_ATT_ERR_PREPARE_QUEUE_FULL;
+            return rc;
+        }
+
+        goto done;
+    }
 
     prep_entry = ble_att_svr_prep_alloc(out_att_err);
     if (prep_entry == NULL) {
@@ -2282,8 +2648,18 @@ ble_att_svr_insert_prep_entry(uint16_t conn_handle,
         return rc;
     }
 
-    prep_prev = ble_att_svr_prep_find_prev(&conn->bhc_att_svr,
-                                           handle, offset);
+    /* Writes prepared in order go to the tail without walking the list. */
+    if (prep_tail != NULL &&
+        (prep_tail->bape_handle < handle ||
+         (prep_tail->bape_handle == handle &&
+          prep_tail->bape_offset <= offset))) {
+
+        prep_prev = prep_tail;
+    } else {
+        prep_prev = ble_att_svr_prep_find_prev(&conn->bhc_att_svr,
+                                               handle, offset);
+    }
+
     if (prep_prev == NULL) {
         SLIST_INSERT_HEAD(&conn->bhc_att_svr.basc_prep_list, prep_entry,
                           bape_next);
@@ -2291,6 +2667,11 @@ ble_att_svr_insert_prep_entry(uint16_t conn_handle,
         SLIST_INSERT_AFTER(prep_prev, prep_entry, bape_next);
     }
 
+    if (SLIST_NEXT(prep_entry, bape_next) == NULL) {
+        conn->bhc_att_svr.basc_prep_tail = prep_entry;
+    }
+
+done:
 #if BLE_HS_ATT_SVR_QUEUED_WRITE_TMO != 0
     conn->bhc_att_svr.basc_prep_timeout_at =
         ble_npl_time_get() + BLE_HS_ATT_SVR_QUEUED_WRITE_TMO;
@@ -2437,6 +2818,7 @@ done:
          */
         prep_list = conn->bhc_att_svr.basc_prep_list;
         SLIST_INIT(&conn->bhc_att_svr.basc_prep_list);
+        conn->bhc_att_svr.basc_prep_tail = NULL;
         ble_hs_unlock();
 
         if (flags) {
@@ -2582,6 +2964,7 @@ ble_att_svr_move_entries(struct ble_att_svr_entry_list *src,
                          uint16_t start_handle, uint16_t end_handle)
 {
 
+    struct ble_att_svr_entry **slot;
     struct ble_att_svr_entry *entry;
     struct ble_att_svr_entry *prev;
     struct ble_att_svr_entry *remove;
@@ -2618,6 +3001,12 @@ ble_att_svr_move_entries(struct ble_att_svr_entry_list *src,
             STAILQ_REMOVE_AFTER(src, remove, ha_next);
         }
 
+        /* Only entries in the visible list can be found by handle. */
+        slot = ble_att_svr_handle_slot(entry->ha_handle_id);
+        if (slot != NULL) {
+            *slot = dst == &ble_att_svr_list ? entry : NULL;
+        }
+
         /* Insert current element */
         if (insert == NULL) {
             STAILQ_INSERT_HEAD(dst, entry, ha_next);
@@ -2665,6 +3054,12 @@ ble_att_svr_reset(void)
         ble_att_svr_entry_free(entry);
     }
 
+    if (ble_att_svr_handle_table != NULL) {
+        memset(ble_att_svr_handle_table, 0,
+               ble_att_svr_handle_table_len * sizeof *ble_att_svr_handle_table);
+    }
+    ble_att_svr_uuid_index_clear();
+
     /* Note: prep entries do not get freed here because it is assumed there are
      * no established connections.
      */
@@ -2679,6 +3074,14 @@ ble_att_svr_free_start_mem(void)
     free(ble_att_svr_entry_mem);
 #endif
     ble_att_svr_entry_mem = NULL;
+
+#ifdef ESP_PLATFORM
+    nimble_platform_mem_free(ble_att_svr_handle_table);
+#else
+    free(ble_att_svr_handle_table);
+#endif
+    ble_att_svr_handle_table = NULL;
+    ble_att_svr_handle_table_len = 0;
 }
 
 int
@@ -2708,8 +3111,24 @@ ble_att_svr_start(void)
             rc = BLE_HS_EOS;
             goto err;
         }
+
+        /* The attributes registered from here on get the next handles. */
+#ifdef ESP_PLATFORM
+        ble_att_svr_handle_table = nimble_platform_mem_calloc(
+#else
+        ble_att_svr_handle_table = calloc(
+#endif
+            ble_hs_max_attrs, sizeof *ble_att_svr_handle_table);
+        if (ble_att_svr_handle_table == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
+        ble_att_svr_handle_base = ble_att_svr_id + 1;
+        ble_att_svr_handle_table_len = ble_hs_max_attrs;
     }
 
+    ble_att_svr_uuid_index_clear();
+
     return 0;
 
 err:
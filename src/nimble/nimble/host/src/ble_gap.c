@@ -187,11 +187,19 @@ struct ble_gap_slave_state {
     unsigned int high_duty_directed:1;
     unsigned int legacy_pdu:1;
     unsigned int rnd_addr_set:1;
+    unsigned int auto_addr:1; /** rnd_addr is the host address, not the app's */
+    unsigned int fragment_pref:1; /** Controller should not fragment data */
 #if MYNEWT_VAL(BLE_PERIODIC_ADV)
     unsigned int periodic_configured:1;
     uint8_t      periodic_op;
 #endif
     uint8_t rnd_addr[6];
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+    /* Kept to enable the instance again after a private address change. */
+    uint16_t duration;
+    uint8_t max_events;
+    ble_npl_time_t start_ticks;
+#endif
 #else
 /* timer is used only with legacy advertising */
     unsigned int exp_set:1;
@@ -508,6 +516,22 @@ ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc)
 #endif
 }
 
+int
+ble_gap_conn_slot(uint16_t handle, uint8_t *out_slot)
+{
+#if NIMBLE_BLE_CONNECT
+    int rc;
+
+    ble_hs_lock();
+    rc = ble_hs_conn_slot(handle, out_slot);
+    ble_hs_unlock();
+
+    return rc;
+#else
+    return BLE_HS_ENOTSUP;
+#endif
+}
+
 int
 ble_gap_conn_find_by_addr(const ble_addr_t *addr,
                           struct ble_gap_conn_desc *out_desc)
@@ -2280,29 +2304,49 @@ ble_gap_wl_busy(void)
            ble_gap_master.conn.using_wl;
 }
 
+/** Number of whitelist commands sent per HCI command batch. */
+#define BLE_GAP_WL_BATCH_SIZE   8
+
 static int
-ble_gap_wl_tx_add(const ble_addr_t *addr)
+ble_gap_wl_tx_set(const ble_addr_t *addrs, uint8_t white_list_count)
 {
-    struct ble_hci_le_add_whte_list_cp cmd;
+    struct ble_hci_le_add_whte_list_cp cmds[BLE_GAP_WL_BATCH_SIZE];
+    struct ble_hs_hci_batch_cmd batch[BLE_GAP_WL_BATCH_SIZE];
+    int num_cmds;
+    int rc;
+    int i;
 
-    if (addr->type > BLE_ADDR_RANDOM) {
-        return BLE_HS_EINVAL;
-    }
+    memset(batch, 0, sizeof(batch));
 
-    memcpy(cmd.addr, addr->val, BLE_DEV_ADDR_LEN);
-    cmd.addr_type = addr->type;
+    /* The clear goes out with the first chunk of additions. */
+    batch[0].opcode = BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                 BLE_HCI_OCF_LE_CLEAR_WHITE_LIST);
+    num_cmds = 1;
 
-    return ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                        BLE_HCI_OCF_LE_ADD_WHITE_LIST),
-                             &cmd, sizeof(cmd), NULL, 0);
-}
+    i = 0;
+    do {
+        while (num_cmds < BLE_GAP_WL_BATCH_SIZE && i < white_list_count) {
+            memcpy(cmds[num_cmds].addr, addrs[i].val, BLE_DEV_ADDR_LEN);
+            cmds[num_cmds].addr_type = addrs[i].type;
+
+            batch[num_cmds].opcode = BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                                BLE_HCI_OCF_LE_ADD_WHITE_LIST);
+            batch[num_cmds].cmd = &cmds[num_cmds];
+            batch[num_cmds].cmd_len = sizeof(cmds[num_cmds]);
+            num_cmds++;
+            i++;
+        }
 
-static int
-ble_gap_wl_tx_clear(void)
-{
-    return ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                        BLE_HCI_OCF_LE_CLEAR_WHITE_LIST),
-                             NULL, 0, NULL, 0 );
+        rc = ble_hs_hci_cmd_tx_batch(batch, num_cmds);
+        if (rc != 0) {
+            return rc;
+        }
+
+        memset(batch, 0, sizeof(batch));
+        num_cmds = 0;
+    } while (i < white_list_count);
+
+    return 0;
 }
 #endif
 
@@ -2366,19 +2410,16 @@ ble_gap_wl_set(const ble_addr_t *addrs, uint8_t white_list_count)
     ble_gap_log_wl(addrs, white_list_count);
     BLE_HS_LOG(INFO, "\n");
 
-    rc = ble_gap_wl_tx_clear();
-    if (rc != 0) {
-        goto done;
-    }
+    /* Don't hold the host lock while waiting on the controller; the commands
+     * are serialized by the HCI command mutex.
+     */
+    ble_hs_unlock();
 
-    for (i = 0; i < white_list_count; i++) {
-        rc = ble_gap_wl_tx_add(addrs + i);
-        if (rc != 0) {
-            goto done;
-        }
+    rc = ble_gap_wl_tx_set(addrs, white_list_count);
+    if (rc != 0) {
+        STATS_INC(ble_gap_stats, wl_set_fail);
     }
-
-    rc = 0;
+    return rc;
 
 done:
     ble_hs_unlock();
@@ -3065,6 +3106,9 @@ ble_gap_ext_adv_set_addr(uint8_t instance, const ble_addr_t *addr)
 
     ble_hs_lock();
     rc = ble_gap_ext_adv_set_addr_no_lock(instance, addr->val);
+    if (rc == 0) {
+        ble_gap_slave[instance].auto_addr = 0;
+    }
     ble_hs_unlock();
 
     return rc;
@@ -3111,7 +3155,8 @@ ble_gap_ext_adv_start(uint8_t instance, int duration, int max_events)
     switch (ble_gap_slave[instance].our_addr_type) {
     case BLE_OWN_ADDR_RANDOM:
     case BLE_OWN_ADDR_RPA_RANDOM_DEFAULT:
-        if (ble_gap_slave[instance].rnd_addr_set) {
+        if (ble_gap_slave[instance].rnd_addr_set &&
+            !ble_gap_slave[instance].auto_addr) {
             break;
         }
     /* fall through */
@@ -3127,9 +3172,11 @@ ble_gap_ext_adv_start(uint8_t instance, int duration, int max_events)
     }
 
     /* fallback to ID static random address if using random address and instance
-     * wasn't configured with own address
+     * wasn't configured with own address, the address is taken again on every
+     * start as the host may have changed it since
      */
-    if (!ble_gap_slave[instance].rnd_addr_set) {
+    if (!ble_gap_slave[instance].rnd_addr_set ||
+        ble_gap_slave[instance].auto_addr) {
         switch (ble_gap_slave[instance].our_addr_type) {
         case BLE_OWN_ADDR_RANDOM:
         case BLE_OWN_ADDR_RPA_RANDOM_DEFAULT:
@@ -3144,6 +3191,7 @@ ble_gap_ext_adv_start(uint8_t instance, int duration, int max_events)
                 ble_hs_unlock();
                 return rc;
             }
+            ble_gap_slave[instance].auto_addr = 1;
             break;
         default:
             break;
@@ -3168,6 +3216,11 @@ ble_gap_ext_adv_start(uint8_t instance, int duration, int max_events)
     }
 
     ble_gap_slave[instance].op = BLE_GAP_OP_S_ADV;
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+    ble_gap_slave[instance].duration = duration;
+    ble_gap_slave[instance].max_events = max_events;
+    ble_gap_slave[instance].start_ticks = ble_npl_time_get();
+#endif
 
     ble_hs_unlock();
     return 0;
@@ -3270,93 +3323,88 @@ ble_gap_ext_adv_set_data_validate(uint8_t instance, struct os_mbuf *data)
     return 0;
 }
 
-static int
-ble_gap_ext_adv_set(uint8_t instance, uint16_t opcode, struct os_mbuf **data)
-{
-    /* in that case we always fit all data in single HCI command */
-#if MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE) <= BLE_HCI_MAX_EXT_ADV_DATA_LEN
-    static uint8_t buf[sizeof(struct ble_hci_le_set_ext_adv_data_cp) + \
-                       MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE)];
-    struct ble_hci_le_set_ext_adv_data_cp *cmd = (void *)buf;
-    uint16_t len = OS_MBUF_PKTLEN(*data);
+/** Longest advertising data sent in one HCI command. */
+#define BLE_GAP_EXT_ADV_FRAG_LEN \
+    min(MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE), BLE_HCI_MAX_EXT_ADV_DATA_LEN)
 
-    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, opcode);
-    cmd->adv_handle = instance;
-    cmd->operation = BLE_HCI_LE_SET_DATA_OPER_COMPLETE;
-    cmd->fragment_pref = 0;
-    cmd->adv_data_len = len;
-    os_mbuf_copydata(*data, 0, len, cmd->adv_data);
+/** Number of fragments queued to the controller before waiting for them. */
+#define BLE_GAP_EXT_ADV_FRAG_BATCH \
+    min((MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE) + BLE_HCI_MAX_EXT_ADV_DATA_LEN - 1) / \
+        BLE_HCI_MAX_EXT_ADV_DATA_LEN, MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE))
 
-    os_mbuf_adj(*data, len);
-    *data = os_mbuf_trim_front(*data);
+/**
+ * Guards the fragment buffers below; the data is sent without holding the
+ * host lock.
+ */
+static struct ble_npl_mutex ble_gap_ext_adv_data_mutex;
 
-    return ble_hs_hci_cmd_tx(opcode, cmd, sizeof(*cmd) + cmd->adv_data_len,
-                             NULL, 0);
-#else
-    static uint8_t buf[sizeof(struct ble_hci_le_set_ext_adv_data_cp) + \
-                       BLE_HCI_MAX_EXT_ADV_DATA_LEN];
-    struct ble_hci_le_set_ext_adv_data_cp *cmd = (void *)buf;
+static uint8_t ble_gap_ext_adv_data_buf[BLE_GAP_EXT_ADV_FRAG_BATCH]
+                                       [sizeof(struct ble_hci_le_set_ext_adv_data_cp) +
+                                        BLE_GAP_EXT_ADV_FRAG_LEN];
+static struct ble_hs_hci_batch_cmd
+ble_gap_ext_adv_data_cmds[BLE_GAP_EXT_ADV_FRAG_BATCH];
+
+static int
+ble_gap_ext_adv_set(uint8_t instance, uint8_t fragment_pref, uint16_t opcode,
+                    struct os_mbuf **data)
+{
+    struct ble_hci_le_set_ext_adv_data_cp *cmd;
     uint16_t len = OS_MBUF_PKTLEN(*data);
-    uint8_t op;
+    uint16_t frag_len;
+    int num_cmds;
+    int first;
     int rc;
 
-    opcode =  BLE_HCI_OP(BLE_HCI_OGF_LE, opcode);
-
-    cmd->adv_handle = instance;
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, opcode);
+    first = 1;
 
-    /* complete data */
-    if (len <= BLE_HCI_MAX_EXT_ADV_DATA_LEN) {
-        cmd->operation = BLE_HCI_LE_SET_DATA_OPER_COMPLETE;
-        cmd->fragment_pref = 0;
-        cmd->adv_data_len = len;
-        os_mbuf_copydata(*data, 0, len, cmd->adv_data);
+    ble_npl_mutex_pend(&ble_gap_ext_adv_data_mutex, BLE_NPL_TIME_FOREVER);
 
-        os_mbuf_adj(*data, len);
-        *data = os_mbuf_trim_front(*data);
+    do {
+        memset(ble_gap_ext_adv_data_cmds, 0, sizeof(ble_gap_ext_adv_data_cmds));
+        num_cmds = 0;
+
+        while (num_cmds < BLE_GAP_EXT_ADV_FRAG_BATCH && (first || len > 0)) {
+            cmd = (void *)ble_gap_ext_adv_data_buf[num_cmds];
+            frag_len = min(len, BLE_GAP_EXT_ADV_FRAG_LEN);
+
+            if (frag_len == len) {
+                cmd->operation = first ? BLE_HCI_LE_SET_DATA_OPER_COMPLETE :
+                                         BLE_HCI_LE_SET_DATA_OPER_LAST;
+            } else {
+                cmd->operation = first ? BLE_HCI_LE_SET_DATA_OPER_FIRST :
+                                         BLE_HCI_LE_SET_DATA_OPER_INT;
+            }
 
-        return ble_hs_hci_cmd_tx(opcode, cmd, sizeof(*cmd) + cmd->adv_data_len,
-                                 NULL, 0);
-    }
+            cmd->adv_handle = instance;
+            cmd->fragment_pref = fragment_pref;
+            cmd->adv_data_len = frag_len;
+            os_mbuf_copydata(*data, 0, frag_len, cmd->adv_data);
 
-    /* first fragment  */
-    op = BLE_HCI_LE_SET_DATA_OPER_FIRST;
+            os_mbuf_adj(*data, frag_len);
+            *data = os_mbuf_trim_front(*data);
 
-    do {
-        cmd->operation = op;
-        cmd->fragment_pref = 0;
-        cmd->adv_data_len = BLE_HCI_MAX_EXT_ADV_DATA_LEN;
-        os_mbuf_copydata(*data, 0, BLE_HCI_MAX_EXT_ADV_DATA_LEN, cmd->adv_data);
+            ble_gap_ext_adv_data_cmds[num_cmds].opcode = opcode;
+            ble_gap_ext_adv_data_cmds[num_cmds].cmd = cmd;
+            ble_gap_ext_adv_data_cmds[num_cmds].cmd_len = sizeof(*cmd) + frag_len;
+            num_cmds++;
 
-        os_mbuf_adj(*data, BLE_HCI_MAX_EXT_ADV_DATA_LEN);
-        *data = os_mbuf_trim_front(*data);
-
-        rc = ble_hs_hci_cmd_tx(opcode, cmd, sizeof(*cmd) + cmd->adv_data_len,
-                               NULL, 0);
-        if (rc) {
-            return rc;
+            len -= frag_len;
+            first = 0;
         }
 
-        len -= BLE_HCI_MAX_EXT_ADV_DATA_LEN;
-        op = BLE_HCI_LE_SET_DATA_OPER_INT;
-    } while (len > BLE_HCI_MAX_EXT_ADV_DATA_LEN);
+        rc = ble_hs_hci_cmd_tx_batch(ble_gap_ext_adv_data_cmds, num_cmds);
+    } while (rc == 0 && len > 0);
 
-    /* last fragment */
-    cmd->operation = BLE_HCI_LE_SET_DATA_OPER_LAST;
-    cmd->fragment_pref = 0;
-    cmd->adv_data_len = len;
-    os_mbuf_copydata(*data, 0, len, cmd->adv_data);
-
-    os_mbuf_adj(*data, len);
-    *data = os_mbuf_trim_front(*data);
+    ble_npl_mutex_release(&ble_gap_ext_adv_data_mutex);
 
-    return ble_hs_hci_cmd_tx(opcode, cmd, sizeof(*cmd) + cmd->adv_data_len,
-                             NULL, 0);
-#endif
+    return rc;
 }
 
 int
 ble_gap_ext_adv_set_data(uint8_t instance, struct os_mbuf *data)
 {
+    uint8_t fragment_pref;
     int rc;
 
     if (instance >= BLE_ADV_INSTANCES) {
@@ -3371,20 +3419,39 @@ ble_gap_ext_adv_set_data(uint8_t instance, struct os_mbuf *data)
 
     ble_hs_lock();
     rc = ble_gap_ext_adv_set_data_validate(instance, data);
+    fragment_pref = ble_gap_slave[instance].fragment_pref;
+    ble_hs_unlock();
+
     if (rc != 0) {
-        ble_hs_unlock();
         goto done;
     }
 
-    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_ADV_DATA, &data);
-
-    ble_hs_unlock();
+    rc = ble_gap_ext_adv_set(instance, fragment_pref,
+                             BLE_HCI_OCF_LE_SET_EXT_ADV_DATA, &data);
 
 done:
     os_mbuf_free_chain(data);
     return rc;
 }
 
+int
+ble_gap_ext_adv_set_fragment_pref(uint8_t instance, uint8_t pref)
+{
+    if (instance >= BLE_ADV_INSTANCES) {
+        return BLE_HS_EINVAL;
+    }
+
+    if (pref > BLE_HCI_LE_SET_DATA_FRAG_PREF_NO_FRAG) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+    ble_gap_slave[instance].fragment_pref = pref;
+    ble_hs_unlock();
+
+    return 0;
+}
+
 static int
 ble_gap_ext_adv_rsp_set_validate(uint8_t instance,  struct os_mbuf *data)
 {
@@ -3429,6 +3496,7 @@ ble_gap_ext_adv_rsp_set_validate(uint8_t instance,  struct os_mbuf *data)
 int
 ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data)
 {
+    uint8_t fragment_pref;
     int rc;
 
     if (instance >= BLE_ADV_INSTANCES) {
@@ -3443,15 +3511,15 @@ ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data)
 
     ble_hs_lock();
     rc = ble_gap_ext_adv_rsp_set_validate(instance, data);
+    fragment_pref = ble_gap_slave[instance].fragment_pref;
+    ble_hs_unlock();
+
     if (rc != 0) {
-        ble_hs_unlock();
         goto done;
     }
 
-    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_SCAN_RSP_DATA,
-                             &data);
-
-    ble_hs_unlock();
+    rc = ble_gap_ext_adv_set(instance, fragment_pref,
+                             BLE_HCI_OCF_LE_SET_EXT_SCAN_RSP_DATA, &data);
 
 done:
     os_mbuf_free_chain(data);
@@ -6201,6 +6269,33 @@ ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi)
     return rc;
 }
 
+int
+ble_gap_conn_traffic(uint16_t conn_handle, uint32_t *out_tx_pkts,
+                     uint32_t *out_rx_pkts)
+{
+#if NIMBLE_BLE_CONNECT
+    struct ble_hs_conn *conn;
+    int rc;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        rc = BLE_HS_ENOTCONN;
+    } else {
+        *out_tx_pkts = conn->bhc_tx_pkts;
+        *out_rx_pkts = conn->bhc_rx_pkts;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+#else
+    return BLE_HS_ENOTSUP;
+#endif
+}
+
 /*****************************************************************************
  * $notify                                                                   *
  *****************************************************************************/
@@ -6434,6 +6529,160 @@ ble_gap_preempt_done(void)
     }
 }
 
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+#if NIMBLE_BLE_ADVERTISE && MYNEWT_VAL(BLE_EXT_ADV)
+static int
+ble_gap_ext_adv_enable_tx(uint8_t instance, int enable, uint16_t duration,
+                          uint8_t max_events)
+{
+    struct ble_hci_le_set_ext_adv_enable_cp *cmd;
+    uint8_t buf[sizeof(*cmd) + sizeof(cmd->sets[0])];
+
+    cmd = (void *) buf;
+
+    cmd->enable = enable;
+    cmd->num_sets = 1;
+    cmd->sets[0].adv_handle = instance;
+    cmd->sets[0].duration = htole16(duration);
+    cmd->sets[0].max_events = max_events;
+
+    return ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                        BLE_HCI_OCF_LE_SET_EXT_ADV_ENABLE),
+                             cmd, sizeof(buf), NULL, 0);
+}
+
+/**
+ * Gives an advertising instance that uses the host random address the new
+ * one.  The controller takes it while the instance advertises unless it is
+ * connectable, then the instance is disabled for the time of the commands and
+ * enabled again for the rest of its duration.  The count of extended
+ * advertising events starts again.
+ *
+ * Lock restrictions:
+ *     o Caller locks ble_hs_mutex.
+ */
+static int
+ble_gap_ext_adv_rotate_addr_no_lock(uint8_t instance, const uint8_t *addr)
+{
+    struct ble_gap_slave_state *slave;
+    ble_npl_time_t elapsed;
+    uint32_t elapsed_10ms;
+    uint16_t duration;
+    int rc;
+
+    slave = &ble_gap_slave[instance];
+    if (!slave->configured || !slave->auto_addr) {
+        return 0;
+    }
+
+    /* An instance that does not advertise takes it when started. */
+    if (slave->op != BLE_GAP_OP_S_ADV) {
+        return 0;
+    }
+
+    if (!slave->connectable) {
+        rc = ble_gap_ext_adv_set_addr_no_lock(instance, addr);
+        /* Controllers older than 5.2 may refuse it for any enabled set. */
+        if (rc != BLE_HS_HCI_ERR(BLE_ERR_CMD_DISALLOWED)) {
+            return rc;
+        }
+    }
+
+    duration = slave->duration;
+    if (duration != 0) {
+        elapsed = ble_npl_time_get() - slave->start_ticks;
+        elapsed_10ms = ble_npl_time_ticks_to_ms32(elapsed) / 10;
+        if (elapsed_10ms >= duration) {
+            duration = 1;
+        } else {
+            duration -= elapsed_10ms;
+        }
+    }
+
+    rc = ble_gap_ext_adv_enable_tx(instance, 0, 0, 0);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_gap_ext_adv_set_addr_no_lock(instance, addr);
+    if (rc == 0) {
+        rc = ble_gap_ext_adv_enable_tx(instance, 1, duration,
+                                       slave->max_events);
+    } else {
+        (void)ble_gap_ext_adv_enable_tx(instance, 1, duration,
+                                        slave->max_events);
+    }
+    if (rc == 0) {
+        slave->duration = duration;
+        slave->start_ticks = ble_npl_time_get();
+    }
+
+    return rc;
+}
+#endif
+
+/**
+ * Gives a new host generated private address to the controller without
+ * preempting the GAP.  Legacy advertising is disabled only for the time of
+ * the commands, the extended advertising instances that use the address are
+ * moved to it while they advertise, see ble_gap_ext_adv_rotate_addr_no_lock.
+ * No event is reported to the application.  The address cannot be changed
+ * while scanning or connecting, these need the GAP to be preempted.
+ *
+ * @param addr                  The new private address.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBUSY if a scan or connection procedure
+ *                                  is in progress;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_rotate_private_addr(const uint8_t *addr)
+{
+#if NIMBLE_BLE_ADVERTISE && MYNEWT_VAL(BLE_EXT_ADV)
+    int i;
+#elif NIMBLE_BLE_ADVERTISE
+    int adv;
+#endif
+    int rc;
+
+    ble_hs_lock();
+
+    if (ble_gap_is_preempted() || ble_gap_master.op != BLE_GAP_OP_NULL) {
+        ble_hs_unlock();
+        return BLE_HS_EBUSY;
+    }
+
+    /* On failure the advertising state is left as it is, the caller then
+     * preempts the GAP, which stops and reports the instances still active.
+     */
+#if NIMBLE_BLE_ADVERTISE && MYNEWT_VAL(BLE_EXT_ADV)
+    rc = ble_hs_id_set_private_rnd_no_lock(addr);
+    for (i = 0; i < BLE_ADV_INSTANCES && rc == 0; i++) {
+        rc = ble_gap_ext_adv_rotate_addr_no_lock(i, addr);
+    }
+#elif NIMBLE_BLE_ADVERTISE
+    adv = ble_gap_adv_active();
+    rc = 0;
+    if (adv) {
+        rc = ble_gap_adv_enable_tx(0);
+    }
+    if (rc == 0) {
+        rc = ble_hs_id_set_private_rnd_no_lock(addr);
+        if (adv && ble_gap_adv_enable_tx(1) != 0 && rc == 0) {
+            rc = BLE_HS_EUNKNOWN;
+        }
+    }
+#else
+    rc = ble_hs_id_set_private_rnd_no_lock(addr);
+#endif
+
+    ble_hs_unlock();
+
+    return rc;
+}
+#endif
+
 int
 ble_gap_event_listener_register(struct ble_gap_event_listener *listener,
                                 ble_gap_event_fn *fn, void *arg)
@@ -6521,6 +6770,9 @@ ble_gap_init(void)
 #endif
 
     ble_npl_mutex_init(&preempt_done_mutex);
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    ble_npl_mutex_init(&ble_gap_ext_adv_data_mutex);
+#endif
 
     SLIST_INIT(&ble_gap_update_entries);
     SLIST_INIT(&ble_gap_event_listener_list);
@@ -6558,4 +6810,7 @@ void
 ble_gap_deinit(void)
 {
     ble_npl_mutex_deinit(&preempt_done_mutex);
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    ble_npl_mutex_deinit(&ble_gap_ext_adv_data_mutex);
+#endif
 }
@@ -134,6 +134,9 @@ int ble_gap_master_in_progress(void);
 
 void ble_gap_preempt(void);
 void ble_gap_preempt_done(void);
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+int ble_gap_rotate_private_addr(const uint8_t *addr);
+#endif
 
 int ble_gap_terminate_with_conn(struct ble_hs_conn *conn, uint8_t hci_reason);
 void ble_gap_reset_state(int reason);
@@ -96,6 +96,16 @@ struct ble_gatts_conn {
     int num_clt_cfgs;
 
     uint16_t indicate_val_handle;
+
+    /* The GATT Client Supported Features written by the peer. */
+    uint8_t peer_cl_sup_feat[BLE_GATT_CHR_CLI_SUP_FEAT_SZ];
+
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    /* The database changed since the peer last learned of it. */
+    uint8_t change_unaware;
+    /* A Database Out Of Sync error was sent to the change-unaware peer. */
+    uint8_t out_of_sync_sent;
+#endif
 };
 
 /*** @client. */
@@ -135,6 +145,7 @@ int32_t ble_gattc_timer(void);
 
 int ble_gattc_any_jobs(void);
 int ble_gattc_init(void);
+void ble_gattc_deinit(void);
 
 /*** @server. */
 #define BLE_GATTS_CLT_CFG_F_NOTIFY              0x0001
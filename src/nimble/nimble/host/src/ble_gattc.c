@@ -34,10 +34,11 @@
  * callback.  The callback is executed when the procedure completes.
  *
  * Notes on thread-safety:
- * 1. The ble_hs mutex must never be locked when an application callback is
- *    executed.  A callback is free to initiate additional host procedures.
- * 2. The only resource protected by the mutex is the list of active procedures
- *    (ble_gattc_procs).  Thread-safety is achieved by locking the mutex during
+ * 1. The ble_hs and gattc mutexes must never be locked when an application
+ *    callback is executed.  A callback is free to initiate additional host
+ *    procedures.
+ * 2. The only resource protected by the gattc mutex is the set of active procedure
+ *    lists (ble_gattc_procs).  Thread-safety is achieved by locking the mutex during
  *    removal and insertion operations.  Procedure objects are only modified
  *    while they are not in the list.  This is sufficient, as the host parent
  *    task is the only task which inspects or modifies individual procedure
@@ -190,7 +191,13 @@ struct ble_gattc_proc {
 
         struct {
             struct ble_gatt_attr attr;
+            /* Read position of the next part in attr.om. */
+            struct os_mbuf_cursor cursor;
             uint16_t length;
+            /* With a source attr.om only holds the part at src_offset. */
+            ble_gatt_chunk_fn *src_cb;
+            uint16_t src_len;
+            uint16_t src_offset;
             ble_gatt_attr_fn *cb;
             void *cb_arg;
         } write_long;
@@ -413,8 +420,43 @@ static os_membuf_t ble_gattc_proc_mem[
 
 static struct os_mempool ble_gattc_proc_pool;
 
-/* The list of active GATT client procedures. */
-static struct ble_gattc_proc_list ble_gattc_procs;
+/* The lists of active GATT client procedures.  Procedures are kept in the
+ * list of their connection handle modulo the maximum number of connections,
+ * which is the slot the host prefers for the connection, so a response or a
+ * disconnect only inspects the procedures of its own connection.
+ */
+#define BLE_GATTC_PROC_LIST_CNT     MYNEWT_VAL(BLE_MAX_CONNECTIONS)
+static struct ble_gattc_proc_list ble_gattc_procs[BLE_GATTC_PROC_LIST_CNT];
+
+static struct ble_gattc_proc_list *
+ble_gattc_proc_list_get(uint16_t conn_handle)
+{
+    return &ble_gattc_procs[conn_handle % BLE_GATTC_PROC_LIST_CNT];
+}
+
+/* Protects the proc lists instead of the ble_hs mutex, so a task starting a
+ * procedure does not wait for the host task holding the ble_hs mutex while it
+ * processes other connections.  No other lock is taken while it is held.
+ */
+static struct ble_npl_mutex ble_gattc_mutex;
+
+static void
+ble_gattc_lock(void)
+{
+    int rc;
+
+    rc = ble_npl_mutex_pend(&ble_gattc_mutex, BLE_NPL_TIME_FOREVER);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == BLE_NPL_OS_NOT_STARTED);
+}
+
+static void
+ble_gattc_unlock(void)
+{
+    int rc;
+
+    rc = ble_npl_mutex_release(&ble_gattc_mutex);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == BLE_NPL_OS_NOT_STARTED);
+}
 
 /* The time when we should attempt to resume stalled procedures, in OS ticks.
  * A value of 0 indicates no stalled procedures.
@@ -470,14 +512,17 @@ ble_gattc_dbg_assert_proc_not_inserted(struct ble_gattc_proc *proc)
 {
 #if MYNEWT_VAL(BLE_HS_DEBUG)
     struct ble_gattc_proc *cur;
+    int i;
 
-    ble_hs_lock();
+    ble_gattc_lock();
 
-    STAILQ_FOREACH(cur, &ble_gattc_procs, next) {
-        BLE_HS_DBG_ASSERT(cur != proc);
+    for (i = 0; i < BLE_GATTC_PROC_LIST_CNT; i++) {
+        STAILQ_FOREACH(cur, &ble_gattc_procs[i], next) {
+            BLE_HS_DBG_ASSERT(cur != proc);
+        }
     }
 
-    ble_hs_unlock();
+    ble_gattc_unlock();
 #endif
 }
 
@@ -600,13 +645,27 @@ ble_gattc_log_write(uint16_t att_handle, uint16_t len, int expecting_rsp)
     BLE_HS_LOG(INFO, "att_handle=%d len=%d\n", att_handle, len);
 }
 
+/**
+ * Returns the length of the value written by a
+ * write-long-characteristic-value proc.
+ */
+static uint16_t
+ble_gattc_write_long_len(const struct ble_gattc_proc *proc)
+{
+    if (proc->write_long.src_cb != NULL) {
+        return proc->write_long.src_len;
+    }
+
+    return OS_MBUF_PKTLEN(proc->write_long.attr.om);
+}
+
 static void
 ble_gattc_log_write_long(struct ble_gattc_proc *proc)
 {
     ble_gattc_log_proc_init("write long; ");
     BLE_HS_LOG(INFO, "att_handle=%d len=%d\n",
                proc->write_long.attr.handle,
-               OS_MBUF_PKTLEN(proc->write_long.attr.om));
+               ble_gattc_write_long_len(proc));
 }
 
 static void
@@ -728,9 +787,9 @@ ble_gattc_proc_insert(struct ble_gattc_proc *proc)
 {
     ble_gattc_dbg_assert_proc_not_inserted(proc);
 
-    ble_hs_lock();
-    STAILQ_INSERT_TAIL(&ble_gattc_procs, proc, next);
-    ble_hs_unlock();
+    ble_gattc_lock();
+    STAILQ_INSERT_TAIL(ble_gattc_proc_list_get(proc->conn_handle), proc, next);
+    ble_gattc_unlock();
 }
 
 static void
@@ -920,40 +979,39 @@ ble_gattc_proc_matches_conn_rx_entry(struct ble_gattc_proc *proc, void *arg)
     return (criteria->matching_rx_entry != NULL);
 }
 
-static void
-ble_gattc_extract(ble_gattc_match_fn *cb, void *arg, int max_procs,
-                  struct ble_gattc_proc_list *dst_list)
+/**
+ * Moves the matching procedures of one proc list to the destination list.
+ * Lock restrictions: Caller must lock the gattc mutex.
+ *
+ * @return                      1 if max_procs have been extracted; 0 otherwise.
+ */
+static int
+ble_gattc_extract_list(struct ble_gattc_proc_list *list,
+                       ble_gattc_match_fn *cb, void *arg, int max_procs,
+                       int *num_extracted,
+                       struct ble_gattc_proc_list *dst_list)
 {
     struct ble_gattc_proc *proc;
     struct ble_gattc_proc *prev;
     struct ble_gattc_proc *next;
-    int num_extracted;
-
-    /* Only the parent task is allowed to remove entries from the list. */
-    BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
-
-    STAILQ_INIT(dst_list);
-    num_extracted = 0;
-
-    ble_hs_lock();
 
     prev = NULL;
-    proc = STAILQ_FIRST(&ble_gattc_procs);
+    proc = STAILQ_FIRST(list);
     while (proc != NULL) {
         next = STAILQ_NEXT(proc, next);
 
         if (cb(proc, arg)) {
             if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
+                STAILQ_REMOVE_HEAD(list, next);
             } else {
-                STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
+                STAILQ_REMOVE_AFTER(list, prev, next);
             }
             STAILQ_INSERT_TAIL(dst_list, proc, next);
 
             if (max_procs > 0) {
-                num_extracted++;
-                if (num_extracted >= max_procs) {
-                    break;
+                (*num_extracted)++;
+                if (*num_extracted >= max_procs) {
+                    return 1;
                 }
             }
         } else {
@@ -963,15 +1021,57 @@ ble_gattc_extract(ble_gattc_match_fn *cb, void *arg, int max_procs,
         proc = next;
     }
 
-    ble_hs_unlock();
+    return 0;
+}
+
+/**
+ * Removes the procedures matching the specified callback from the proc lists
+ * and inserts them into the destination list.
+ *
+ * @param conn_handle           The connection whose proc list is searched, or
+ *                                  BLE_HS_CONN_HANDLE_NONE to search the
+ *                                  lists of all connections.
+ */
+static void
+ble_gattc_extract(uint16_t conn_handle, ble_gattc_match_fn *cb, void *arg,
+                  int max_procs, struct ble_gattc_proc_list *dst_list)
+{
+    int num_extracted;
+    int i;
+
+    /* Only the parent task is allowed to remove entries from the list. */
+    BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
+
+    STAILQ_INIT(dst_list);
+    num_extracted = 0;
+
+    ble_gattc_lock();
+
+    if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+        ble_gattc_extract_list(ble_gattc_proc_list_get(conn_handle), cb, arg,
+                               max_procs, &num_extracted, dst_list);
+    } else {
+        for (i = 0; i < BLE_GATTC_PROC_LIST_CNT; i++) {
+            if (STAILQ_EMPTY(&ble_gattc_procs[i])) {
+                continue;
+            }
+            if (ble_gattc_extract_list(&ble_gattc_procs[i], cb, arg,
+                                       max_procs, &num_extracted,
+                                       dst_list)) {
+                break;
+            }
+        }
+    }
+
+    ble_gattc_unlock();
 }
 
 static struct ble_gattc_proc *
-ble_gattc_extract_one(ble_gattc_match_fn *cb, void *arg)
+ble_gattc_extract_one(uint16_t conn_handle, ble_gattc_match_fn *cb, void *arg)
 {
     struct ble_gattc_proc_list dst_list;
 
-    ble_gattc_extract(cb, arg, 1, &dst_list);
+    ble_gattc_extract(conn_handle, cb, arg, 1, &dst_list);
     return STAILQ_FIRST(&dst_list);
 }
 
@@ -984,7 +1084,8 @@ ble_gattc_extract_by_conn_op(uint16_t conn_handle, uint8_t op, int max_procs,
     criteria.conn_handle = conn_handle;
     criteria.op = op;
 
-    ble_gattc_extract(ble_gattc_proc_matches_conn_op, &criteria, max_procs, dst_list);
+    ble_gattc_extract(conn_handle, ble_gattc_proc_matches_conn_op, &criteria,
+                      max_procs, dst_list);
 }
 
 static struct ble_gattc_proc *
@@ -1005,7 +1106,8 @@ ble_gattc_proc_matches_stalled(struct ble_gattc_proc *proc, void *unused)
 static void
 ble_gattc_extract_stalled(struct ble_gattc_proc_list *dst_list)
 {
-    ble_gattc_extract(ble_gattc_proc_matches_stalled, NULL, 0, dst_list);
+    ble_gattc_extract(BLE_HS_CONN_HANDLE_NONE, ble_gattc_proc_matches_stalled,
+                      NULL, 0, dst_list);
 }
 
 /**
@@ -1021,7 +1123,8 @@ ble_gattc_extract_expired(struct ble_gattc_proc_list *dst_list)
     criteria.next_exp_in = BLE_HS_FOREVER;
 
     STAILQ_INIT(dst_list);
-    ble_gattc_extract(ble_gattc_proc_matches_expired, &criteria, 0, dst_list);
+    ble_gattc_extract(BLE_HS_CONN_HANDLE_NONE, ble_gattc_proc_matches_expired,
+                      &criteria, 0, dst_list);
 
     return criteria.next_exp_in;
 }
@@ -1039,7 +1142,8 @@ ble_gattc_extract_with_rx_entry(uint16_t conn_handle,
     criteria.num_rx_entries = num_rx_entries;
     criteria.matching_rx_entry = NULL;
 
-    proc = ble_gattc_extract_one(ble_gattc_proc_matches_conn_rx_entry,
+    proc = ble_gattc_extract_one(conn_handle,
+                                 ble_gattc_proc_matches_conn_rx_entry,
                                  &criteria);
     *out_rx_entry = criteria.matching_rx_entry;
 
@@ -1047,8 +1151,8 @@ ble_gattc_extract_with_rx_entry(uint16_t conn_handle,
 }
 
 /**
- * Searches the main proc list for an entry whose connection handle and op code
- * match those specified.  If a matching entry is found, it is removed from the
+ * Searches the connection's proc list for an entry whose connection handle
+ * and op code match those specified.  If a matching entry is found, it is removed from the
  * list and returned.
  *
  * @param conn_handle           The connection handle to match against.
@@ -3607,6 +3711,45 @@ ble_gattc_write_long_tmo(struct ble_gattc_proc *proc)
     ble_gattc_write_long_cb(proc, BLE_HS_ETIMEOUT, 0);
 }
 
+/**
+ * Gets the part of the value at the current offset from the source of a
+ * write-long-characteristic-value proc, unless it is already held from an
+ * earlier attempt to send it.
+ */
+static int
+ble_gattc_write_long_src_fill(struct ble_gattc_proc *proc, int write_len)
+{
+    struct os_mbuf *om;
+    int rc;
+
+    if (proc->write_long.attr.om != NULL &&
+        proc->write_long.src_offset == proc->write_long.attr.offset &&
+        OS_MBUF_PKTLEN(proc->write_long.attr.om) == write_len) {
+
+        return 0;
+    }
+
+    os_mbuf_free_chain(proc->write_long.attr.om);
+    proc->write_long.attr.om = NULL;
+
+    om = ble_hs_mbuf_bare_pkt();
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    rc = proc->write_long.src_cb(proc->conn_handle,
+                                 proc->write_long.attr.offset, write_len, om,
+                                 proc->write_long.cb_arg);
+    if (rc != 0 || OS_MBUF_PKTLEN(om) != write_len) {
+        os_mbuf_free_chain(om);
+        return BLE_HS_EAPP;
+    }
+
+    proc->write_long.attr.om = om;
+    proc->write_long.src_offset = proc->write_long.attr.offset;
+    return 0;
+}
+
 /**
  * Triggers a pending transmit for the specified
  * write-long-characteristic-value proc.
@@ -3631,7 +3774,7 @@ ble_gattc_write_long_tx(struct ble_gattc_proc *proc)
     }
 
     write_len = min(max_sz,
-                    OS_MBUF_PKTLEN(proc->write_long.attr.om) -
+                    ble_gattc_write_long_len(proc) -
                         proc->write_long.attr.offset);
 
     if (write_len <= 0) {
@@ -3640,6 +3783,13 @@ ble_gattc_write_long_tx(struct ble_gattc_proc *proc)
         goto done;
     }
 
+    if (proc->write_long.src_cb != NULL) {
+        rc = ble_gattc_write_long_src_fill(proc, write_len);
+        if (rc != 0) {
+            goto done;
+        }
+    }
+
     proc->write_long.length = write_len;
     om = ble_hs_mbuf_att_pkt();
     if (om == NULL) {
@@ -3647,14 +3797,31 @@ ble_gattc_write_long_tx(struct ble_gattc_proc *proc)
         goto done;
     }
 
-    rc = os_mbuf_appendfrom(om, proc->write_long.attr.om,
-                            proc->write_long.attr.offset,
-                            proc->write_long.length);
+    if (proc->write_long.src_cb != NULL) {
+        rc = os_mbuf_appendfrom(om, proc->write_long.attr.om, 0, write_len);
+        if (rc != 0) {
+            rc = BLE_HS_ENOMEM;
+            goto done;
+        }
+
+        goto tx;
+    }
+
+    /* The cursor continues from the end of the previous part instead of
+     * walking the value from its start for every part.
+     */
+    rc = os_mbuf_cursor_seek(&proc->write_long.cursor,
+                             proc->write_long.attr.offset);
+    if (rc == 0) {
+        rc = os_mbuf_cursor_appendto(&proc->write_long.cursor, om,
+                                     proc->write_long.length);
+    }
     if (rc != 0) {
         rc = BLE_HS_ENOMEM;
         goto done;
     }
 
+tx:
     rc = ble_att_clt_tx_prep_write(proc->conn_handle,
                                    proc->write_long.attr.handle,
                                    proc->write_long.attr.offset, om);
@@ -3698,8 +3865,7 @@ ble_gattc_write_long_err(struct ble_gattc_proc *proc, int status,
      * we could send the execute write command, then erase all queued data.
      */
     if (proc->write_long.attr.offset > 0 &&
-        proc->write_long.attr.offset <
-            OS_MBUF_PKTLEN(proc->write_long.attr.om)) {
+        proc->write_long.attr.offset < ble_gattc_write_long_len(proc)) {
 
         ble_att_clt_tx_exec_write(proc->conn_handle,
                                   BLE_ATT_EXEC_WRITE_F_CANCEL);
@@ -3733,9 +3899,7 @@ ble_gattc_write_long_rx_prep(struct ble_gattc_proc *proc,
     }
 
     /* Verify the response. */
-    if (proc->write_long.attr.offset >=
-        OS_MBUF_PKTLEN(proc->write_long.attr.om)) {
-
+    if (proc->write_long.attr.offset >= ble_gattc_write_long_len(proc)) {
         /* Expecting a prepare write response, not an execute write
          * response.
          */
@@ -3750,9 +3914,7 @@ ble_gattc_write_long_rx_prep(struct ble_gattc_proc *proc,
         rc = BLE_HS_EBADDATA;
         goto err;
     }
-    if (offset + OS_MBUF_PKTLEN(om) >
-        OS_MBUF_PKTLEN(proc->write_long.attr.om)) {
-
+    if (offset + OS_MBUF_PKTLEN(om) > ble_gattc_write_long_len(proc)) {
         rc = BLE_HS_EBADDATA;
         goto err;
     }
@@ -3760,8 +3922,10 @@ ble_gattc_write_long_rx_prep(struct ble_gattc_proc *proc,
         rc = BLE_HS_EBADDATA;
         goto err;
     }
+    /* A source proc only holds the part that was sent. */
     if (os_mbuf_cmpm(om, 0,
-                     proc->write_long.attr.om, offset,
+                     proc->write_long.attr.om,
+                     proc->write_long.src_cb != NULL ? 0 : offset,
                      proc->write_long.length) != 0) {
 
         rc = BLE_HS_EBADDATA;
@@ -3792,9 +3956,7 @@ ble_gattc_write_long_rx_exec(struct ble_gattc_proc *proc, int status)
 {
     ble_gattc_dbg_assert_proc_not_inserted(proc);
 
-    if (proc->write_long.attr.offset <
-        OS_MBUF_PKTLEN(proc->write_long.attr.om)) {
-
+    if (proc->write_long.attr.offset < ble_gattc_write_long_len(proc)) {
         /* Expecting an execute write response, not a prepare write
          * response.
          */
@@ -3830,6 +3992,7 @@ ble_gattc_write_long(uint16_t conn_handle, uint16_t attr_handle,
     proc->write_long.attr.handle = attr_handle;
     proc->write_long.attr.offset = offset;
     proc->write_long.attr.om = txom;
+    os_mbuf_cursor_init(&proc->write_long.cursor, txom);
     proc->write_long.cb = cb;
     proc->write_long.cb_arg = cb_arg;
 
@@ -3855,6 +4018,58 @@ done:
     return rc;
 }
 
+int
+ble_gattc_write_long_src(uint16_t conn_handle, uint16_t attr_handle,
+                         uint16_t len, ble_gatt_chunk_fn *src_cb,
+                         ble_gatt_attr_fn *cb, void *cb_arg)
+{
+#if !MYNEWT_VAL(BLE_GATT_WRITE_LONG)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct ble_gattc_proc *proc;
+    int rc;
+
+    STATS_INC(ble_gattc_stats, write_long);
+
+    if (src_cb == NULL || len == 0) {
+        rc = BLE_HS_EINVAL;
+        proc = NULL;
+        goto done;
+    }
+
+    proc = ble_gattc_proc_alloc();
+    if (proc == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto done;
+    }
+
+    proc->op = BLE_GATT_OP_WRITE_LONG;
+    proc->conn_handle = conn_handle;
+    proc->write_long.attr.handle = attr_handle;
+    proc->write_long.attr.offset = 0;
+    proc->write_long.attr.om = NULL;
+    proc->write_long.src_cb = src_cb;
+    proc->write_long.src_len = len;
+    proc->write_long.cb = cb;
+    proc->write_long.cb_arg = cb_arg;
+
+    ble_gattc_log_write_long(proc);
+
+    rc = ble_gattc_write_long_tx(proc);
+    if (rc != 0) {
+        goto done;
+    }
+
+done:
+    if (rc != 0) {
+        STATS_INC(ble_gattc_stats, write_long_fail);
+    }
+
+    ble_gattc_process_status(proc, rc);
+    return rc;
+}
+
 /*****************************************************************************
  * $write reliable                                                           *
  *****************************************************************************/
@@ -4199,6 +4414,166 @@ done:
     return rc;
 }
 
+/**
+ * Sends the values of tuples[start] to tuples[end - 1] in one Multiple Handle
+ * Value Notification.
+ */
+static int
+ble_gattc_notify_mult_tx(uint16_t conn_handle, struct ble_gatt_notif *tuples,
+                         size_t start, size_t end)
+{
+    struct os_mbuf *txom;
+    uint8_t hdr[4];
+    uint16_t len;
+    size_t i;
+    int rc;
+
+    txom = ble_hs_mbuf_att_pkt();
+    rc = txom == NULL ? BLE_HS_ENOMEM : 0;
+
+    for (i = start; i < end; i++) {
+        if (rc == 0) {
+            len = OS_MBUF_PKTLEN(tuples[i].value);
+            put_le16(hdr, tuples[i].handle);
+            put_le16(hdr + 2, len);
+            if (os_mbuf_append(txom, hdr, sizeof hdr) != 0 ||
+                os_mbuf_appendfrom(txom, tuples[i].value, 0, len) != 0) {
+                rc = BLE_HS_ENOMEM;
+            }
+        }
+        os_mbuf_free_chain(tuples[i].value);
+        tuples[i].value = NULL;
+    }
+
+    if (rc == 0) {
+        rc = ble_att_clt_tx_notify_mult(conn_handle, txom);
+    } else {
+        os_mbuf_free_chain(txom);
+    }
+
+    for (i = start; i < end; i++) {
+        STATS_INC(ble_gattc_stats, notify);
+        ble_gattc_log_notify(tuples[i].handle);
+        if (rc != 0) {
+            STATS_INC(ble_gattc_stats, notify_fail);
+        }
+        ble_gap_notify_tx_event(rc, conn_handle, tuples[i].handle, 0);
+    }
+
+    return rc;
+}
+
+int
+ble_gattc_notify_multiple_custom(uint16_t conn_handle, size_t num_tuples,
+                                 struct ble_gatt_notif *tuples)
+{
+#if !MYNEWT_VAL(BLE_GATT_NOTIFY)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    uint8_t feat[BLE_GATT_CHR_CLI_SUP_FEAT_SZ];
+    uint16_t pdu_len;
+    uint16_t mtu;
+    size_t start;
+    size_t i;
+    int first_rc;
+    int rc;
+
+    first_rc = 0;
+    memset(feat, 0, sizeof feat);
+    (void)ble_gatts_peer_cl_sup_feat_get(conn_handle, feat, sizeof feat);
+
+    /* Read the values that were not supplied. */
+    for (i = 0; i < num_tuples; i++) {
+        if (tuples[i].value != NULL) {
+            continue;
+        }
+
+        tuples[i].value = ble_hs_mbuf_att_pkt();
+        if (tuples[i].value == NULL) {
+            rc = BLE_HS_ENOMEM;
+        } else {
+            rc = ble_att_svr_read_handle(BLE_HS_CONN_HANDLE_NONE,
+                                         tuples[i].handle, 0,
+                                         tuples[i].value, NULL);
+            if (rc != 0) {
+                rc = BLE_HS_EAPP;
+            }
+        }
+
+        if (rc != 0) {
+            os_mbuf_free_chain(tuples[i].value);
+            tuples[i].value = NULL;
+            STATS_INC(ble_gattc_stats, notify_fail);
+            ble_gap_notify_tx_event(rc, conn_handle, tuples[i].handle, 0);
+            if (first_rc == 0) {
+                first_rc = rc;
+            }
+        }
+    }
+
+    if (!(feat[0] & BLE_GATT_CHR_CLI_SUP_FEAT_MULT_NTF)) {
+        for (i = 0; i < num_tuples; i++) {
+            if (tuples[i].value == NULL) {
+                continue;
+            }
+
+            rc = ble_gattc_notify_custom(conn_handle, tuples[i].handle,
+                                         tuples[i].value);
+            tuples[i].value = NULL;
+            if (rc != 0 && first_rc == 0) {
+                first_rc = rc;
+            }
+        }
+
+        return first_rc;
+    }
+
+    /* Each PDU holds as many tuples as fit in the MTU, a PDU with a single
+     * tuple is sent as a notification.
+     */
+    mtu = ble_att_mtu(conn_handle);
+    i = 0;
+    while (i < num_tuples) {
+        if (tuples[i].value == NULL) {
+            i++;
+            continue;
+        }
+
+        start = i;
+        pdu_len = 1;
+        while (i < num_tuples) {
+            if (tuples[i].value == NULL) {
+                break;
+            }
+            if (i > start &&
+                pdu_len + 4 + OS_MBUF_PKTLEN(tuples[i].value) > mtu) {
+                break;
+            }
+            pdu_len += 4 + OS_MBUF_PKTLEN(tuples[i].value);
+            i++;
+        }
+
+        if (i - start == 1 || pdu_len > mtu) {
+            /* A tuple too long for the PDU goes out truncated as a single
+             * notification, as with ble_gattc_notify_custom.
+             */
+            rc = ble_gattc_notify_custom(conn_handle, tuples[start].handle,
+                                         tuples[start].value);
+            tuples[start].value = NULL;
+            i = start + 1;
+        } else {
+            rc = ble_gattc_notify_mult_tx(conn_handle, tuples, start, i);
+        }
+
+        if (rc != 0 && first_rc == 0) {
+            first_rc = rc;
+        }
+    }
+
+    return first_rc;
+}
+
 int
 ble_gattc_notify(uint16_t conn_handle, uint16_t chr_val_handle)
 {
@@ -4779,15 +5154,31 @@ ble_gattc_connection_broken(uint16_t conn_handle)
 int
 ble_gattc_any_jobs(void)
 {
-    return !STAILQ_EMPTY(&ble_gattc_procs);
+    int i;
+
+    for (i = 0; i < BLE_GATTC_PROC_LIST_CNT; i++) {
+        if (!STAILQ_EMPTY(&ble_gattc_procs[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 int
 ble_gattc_init(void)
 {
     int rc;
+    int i;
+
+    for (i = 0; i < BLE_GATTC_PROC_LIST_CNT; i++) {
+        STAILQ_INIT(&ble_gattc_procs[i]);
+    }
 
-    STAILQ_INIT(&ble_gattc_procs);
+    rc = ble_npl_mutex_init(&ble_gattc_mutex);
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
 
     if (MYNEWT_VAL(BLE_GATT_MAX_PROCS) > 0) {
         rc = os_mempool_init(&ble_gattc_proc_pool,
@@ -4810,4 +5201,10 @@ ble_gattc_init(void)
     return 0;
 }
 
+void
+ble_gattc_deinit(void)
+{
+    ble_npl_mutex_deinit(&ble_gattc_mutex);
+}
+
 #endif
@@ -55,6 +55,15 @@ struct ble_gatts_svc_entry {
 static struct ble_gatts_svc_entry *ble_gatts_svc_entries;
 static uint16_t ble_gatts_num_svc_entries;
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+#if !NIMBLE_BLE_SM || !MYNEWT_VAL(BLE_SM_SC)
+#error "BLE_GATT_ROBUST_CACHING requires BLE_SM_SC for the AES-CMAC of the database hash"
+#endif
+
+static uint8_t ble_gatts_db_hash_val[16];
+static uint8_t ble_gatts_db_hash_valid;
+#endif
+
 static os_membuf_t *ble_gatts_clt_cfg_mem;
 static struct os_mempool ble_gatts_clt_cfg_pool;
 
@@ -1303,6 +1312,10 @@ ble_gatts_start(void)
         }
     }
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    ble_gatts_db_hash_valid = 0;
+#endif
+
 done:
     if (rc != 0) {
         ble_gatts_free_mem();
@@ -1338,9 +1351,279 @@ ble_gatts_conn_init(struct ble_gatts_conn *gatts_conn)
         gatts_conn->num_clt_cfgs = 0;
     }
 
+    memset(gatts_conn->peer_cl_sup_feat, 0,
+           sizeof gatts_conn->peer_cl_sup_feat);
+
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+    gatts_conn->change_unaware = 0;
+    gatts_conn->out_of_sync_sent = 0;
+#endif
+
+    return 0;
+}
+
+int
+ble_gatts_peer_cl_sup_feat_get(uint16_t conn_handle,
+                               uint8_t *out_supported_feat, uint8_t len)
+{
+    struct ble_hs_conn *conn;
+    int rc;
+
+    if (len > BLE_GATT_CHR_CLI_SUP_FEAT_SZ) {
+        len = BLE_GATT_CHR_CLI_SUP_FEAT_SZ;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        rc = BLE_HS_ENOTCONN;
+    } else {
+        memcpy(out_supported_feat, conn->bhc_gatt_svr.peer_cl_sup_feat, len);
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+int
+ble_gatts_peer_cl_sup_feat_update(uint16_t conn_handle, struct os_mbuf *om)
+{
+    uint8_t feat[BLE_GATT_CHR_CLI_SUP_FEAT_SZ];
+    struct ble_hs_conn *conn;
+    uint16_t len;
+    int rc;
+    int i;
+
+    memset(feat, 0, sizeof feat);
+    len = OS_MBUF_PKTLEN(om);
+    if (len > sizeof feat) {
+        len = sizeof feat;
+    }
+    os_mbuf_copydata(om, 0, len, feat);
+
+    /* Only the features this host knows are kept. */
+    feat[0] &= BLE_GATT_CHR_CLI_SUP_FEAT_ROBUST_CACHING |
+               BLE_GATT_CHR_CLI_SUP_FEAT_EATT |
+               BLE_GATT_CHR_CLI_SUP_FEAT_MULT_NTF;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        rc = BLE_HS_ENOTCONN;
+        goto done;
+    }
+
+    /* A client may not disable a feature it enabled. */
+    for (i = 0; i < BLE_GATT_CHR_CLI_SUP_FEAT_SZ; i++) {
+        if (conn->bhc_gatt_svr.peer_cl_sup_feat[i] & ~feat[i]) {
+            rc = BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+            goto done;
+        }
+    }
+
+    memcpy(conn->bhc_gatt_svr.peer_cl_sup_feat, feat, sizeof feat);
+    rc = 0;
+
+done:
+    ble_hs_unlock();
+
+    return rc;
+}
+
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+/**
+ * Adds one attribute to the database hash: the handle and type, followed by
+ * the value for the declarations and the extended properties.  Other
+ * attribute types are not part of the hash.
+ */
+static int
+ble_gatts_db_hash_add(struct ble_att_svr_entry *entry, struct os_mbuf *om)
+{
+    uint8_t buf[4 + BLE_GATT_CHR_DECL_SZ_128];
+    uint16_t type;
+    uint16_t len;
+    int rc;
+
+    type = ble_uuid_u16(entry->ha_uuid);
+    switch (type) {
+    case BLE_ATT_UUID_PRIMARY_SERVICE:
+    case BLE_ATT_UUID_SECONDARY_SERVICE:
+    case BLE_ATT_UUID_INCLUDE:
+    case BLE_ATT_UUID_CHARACTERISTIC:
+    case BLE_GATT_DSC_EXT_PROP_UUID16:
+        os_mbuf_adj(om, OS_MBUF_PKTLEN(om));
+        rc = ble_att_svr_read_handle(BLE_HS_CONN_HANDLE_NONE,
+                                     entry->ha_handle_id, 0, om, NULL);
+        if (rc != 0) {
+            return rc;
+        }
+
+        len = OS_MBUF_PKTLEN(om);
+        if (len > sizeof buf - 4) {
+            return BLE_HS_EBADDATA;
+        }
+        os_mbuf_copydata(om, 0, len, buf + 4);
+        break;
+
+    case BLE_GATT_DSC_USER_DESC_UUID16:
+    case BLE_GATT_DSC_CLT_CFG_UUID16:
+    case BLE_GATT_DSC_SVR_CFG_UUID16:
+    case BLE_GATT_DSC_PRES_FMT_UUID16:
+    case BLE_GATT_DSC_AGG_FMT_UUID16:
+        len = 0;
+        break;
+
+    default:
+        return 0;
+    }
+
+    put_le16(buf, entry->ha_handle_id);
+    put_le16(buf + 2, type);
+
+    return ble_sm_alg_cmac_update(buf, 4 + len);
+}
+
+int
+ble_gatts_db_hash(uint8_t *out_hash)
+{
+    static const uint8_t key[16] = { 0 };
+    struct ble_att_svr_entry *entry;
+    struct os_mbuf *om;
+    uint8_t hash[16];
+    int rc;
+    int i;
+
+    if (ble_gatts_db_hash_valid) {
+        memcpy(out_hash, ble_gatts_db_hash_val, sizeof hash);
+        return 0;
+    }
+
+    om = ble_hs_mbuf_bare_pkt();
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    rc = ble_sm_alg_cmac_start(key);
+    if (rc != 0) {
+        os_mbuf_free_chain(om);
+        return rc;
+    }
+
+    /* Walks the visible attributes in handle order, hidden services are not
+     * part of the database the peer can discover.
+     */
+    entry = NULL;
+    while ((entry = ble_att_svr_find_by_uuid(entry, NULL, 0xffff)) != NULL) {
+        rc = ble_gatts_db_hash_add(entry, om);
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    os_mbuf_free_chain(om);
+
+    /* The CMAC must be finished even on error to release its context. */
+    if (ble_sm_alg_cmac_finish(hash) != 0 && rc == 0) {
+        rc = BLE_HS_EUNKNOWN;
+    }
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* The CMAC is most significant byte first, the value is little endian. */
+    for (i = 0; i < 16; i++) {
+        ble_gatts_db_hash_val[i] = hash[15 - i];
+    }
+    ble_gatts_db_hash_valid = 1;
+
+    memcpy(out_hash, ble_gatts_db_hash_val, sizeof hash);
     return 0;
 }
 
+void
+ble_gatts_db_changed(void)
+{
+    struct ble_hs_conn *conn;
+    int i;
+
+    ble_gatts_db_hash_valid = 0;
+
+    ble_hs_lock();
+
+    /* The connected clients that cache the database must learn of the
+     * change before their requests are served again.
+     */
+    for (i = 0; ; i++) {
+        conn = ble_hs_conn_find_by_idx(i);
+        if (conn == NULL) {
+            break;
+        }
+
+        if (conn->bhc_gatt_svr.peer_cl_sup_feat[0] &
+            BLE_GATT_CHR_CLI_SUP_FEAT_ROBUST_CACHING) {
+
+            conn->bhc_gatt_svr.change_unaware = 1;
+            conn->bhc_gatt_svr.out_of_sync_sent = 0;
+        }
+    }
+
+    ble_hs_unlock();
+}
+
+int
+ble_gatts_change_aware(uint16_t conn_handle, int req)
+{
+    struct ble_hs_conn *conn;
+    int aware;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL || !conn->bhc_gatt_svr.change_unaware) {
+        aware = 1;
+    } else if (!req) {
+        /* Commands from a change-unaware client are ignored. */
+        aware = 0;
+    } else if (conn->bhc_gatt_svr.out_of_sync_sent) {
+        /* The client was told it is out of sync and still sends a request,
+         * it is now aware of the change.
+         */
+        conn->bhc_gatt_svr.change_unaware = 0;
+        conn->bhc_gatt_svr.out_of_sync_sent = 0;
+        aware = 1;
+    } else {
+        conn->bhc_gatt_svr.out_of_sync_sent = 1;
+        aware = 0;
+    }
+
+    ble_hs_unlock();
+
+    return aware;
+}
+
+/**
+ * Marks a change-unaware client aware once it confirms the Service Changed
+ * indication.
+ */
+static void
+ble_gatts_sc_ack(struct ble_hs_conn *conn, uint16_t chr_val_handle)
+{
+    struct ble_att_svr_entry *entry;
+
+    entry = ble_att_svr_find_by_handle(chr_val_handle);
+    if (entry != NULL &&
+        ble_uuid_u16(entry->ha_uuid) == BLE_GATT_CHR_SERVICE_CHANGED_UUID16) {
+
+        conn->bhc_gatt_svr.change_unaware = 0;
+        conn->bhc_gatt_svr.out_of_sync_sent = 0;
+    }
+}
+#endif
+
 
 /**
  * Schedules a notification or indication for the specified peer-CCCD pair.  If
@@ -1476,6 +1759,10 @@ ble_gatts_rx_indicate_ack(uint16_t conn_handle, uint16_t chr_val_handle)
         /* Mark that there is no longer an outstanding txed indicate. */
         conn->bhc_gatt_svr.indicate_val_handle = 0;
 
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+        ble_gatts_sc_ack(conn, chr_val_handle);
+#endif
+
         /* Determine if we need to persist that there is no pending indication
          * for this peer-characteristic pair.  If the characteristic has not
          * been modified since we sent the indication, there is no indication
@@ -2031,6 +2318,9 @@ ble_gatts_svc_set_visibility(uint16_t handle, int visible)
             } else {
                 ble_att_svr_hide_range(entry->handle, entry->end_group_handle);
             }
+#if MYNEWT_VAL(BLE_GATT_ROBUST_CACHING)
+            ble_gatts_db_hash_valid = 0;
+#endif
             return 0;
         }
     }
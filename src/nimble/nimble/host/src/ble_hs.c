@@ -85,6 +85,24 @@ static struct ble_npl_eventq *ble_hs_evq;
 
 static struct ble_mqueue ble_hs_rx_q;
 
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+/**
+ * The received ACL data packets of one connection waiting to be processed,
+ * a connection uses the slot of its handle modulo BLE_MAX_CONNECTIONS.
+ */
+struct ble_hs_rx_slot {
+    STAILQ_HEAD(, os_mbuf_pkthdr) pkts;
+    uint16_t conn_handle;
+    uint16_t queued;
+    struct ble_hs_rx_work work;
+};
+
+static struct ble_hs_rx_slot ble_hs_rx_slots[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+
+/* The slot served first by the next pass over the receive queue. */
+static uint8_t ble_hs_rx_first_slot;
+#endif
+
 static struct ble_npl_mutex ble_hs_mutex;
 
 /** These values keep track of required ATT and GATT resources counts.  They
@@ -241,18 +259,211 @@ ble_hs_unlock(void)
     ble_hs_unlock_nested();
 }
 
+static void
+ble_hs_process_rx_data(struct os_mbuf *om)
+{
+#if BLE_MONITOR
+    ble_monitor_send_om(BLE_MONITOR_OPCODE_ACL_RX_PKT, om);
+#endif
+
+    ble_hs_hci_evt_acl_process(om);
+}
+
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+static struct ble_hs_rx_slot *
+ble_hs_rx_slot_find(uint16_t conn_handle)
+{
+    struct ble_hs_rx_slot *slot;
+
+    slot = &ble_hs_rx_slots[conn_handle % MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+    if (slot->conn_handle != conn_handle) {
+        return NULL;
+    }
+
+    return slot;
+}
+
+/**
+ * Adds a received packet to the slot of its connection.  The counters of the
+ * slot start over when it is taken by another connection.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBADDATA if the packet is too short to
+ *                                  contain an ACL data header.
+ */
+static int
+ble_hs_rx_slot_put(struct os_mbuf *om)
+{
+    struct hci_data_hdr *hdr;
+    struct ble_hs_rx_slot *slot;
+    uint16_t conn_handle;
+
+    if (om->om_len < BLE_HCI_DATA_HDR_SZ) {
+        return BLE_HS_EBADDATA;
+    }
+
+    hdr = (struct hci_data_hdr *)om->om_data;
+    conn_handle = BLE_HCI_DATA_HANDLE(get_le16(&hdr->hdh_handle_pb_bc));
+    slot = &ble_hs_rx_slots[conn_handle % MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+
+    ble_hs_lock();
+
+    /* Connections sharing a slot keep the order they were received in. */
+    if (slot->conn_handle != conn_handle && slot->queued == 0) {
+        slot->conn_handle = conn_handle;
+        memset(&slot->work, 0, sizeof(slot->work));
+    }
+
+    STAILQ_INSERT_TAIL(&slot->pkts, OS_MBUF_PKTHDR(om), omp_next);
+    slot->queued++;
+    if (slot->queued > slot->work.max_queued) {
+        slot->work.max_queued = slot->queued;
+    }
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
+/**
+ * Removes the oldest packet of a slot.
+ *
+ * @param processed             The packets processed before this one in the
+ *                                  current pass, recorded as its wait.
+ */
+static struct os_mbuf *
+ble_hs_rx_slot_get(struct ble_hs_rx_slot *slot, uint16_t processed)
+{
+    struct os_mbuf_pkthdr *omp;
+
+    ble_hs_lock();
+
+    omp = STAILQ_FIRST(&slot->pkts);
+    if (omp != NULL) {
+        STAILQ_REMOVE_HEAD(&slot->pkts, omp_next);
+        slot->queued--;
+        slot->work.packets++;
+        if (processed > slot->work.max_wait) {
+            slot->work.max_wait = processed;
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (omp == NULL) {
+        return NULL;
+    }
+
+    return OS_MBUF_PKTHDR_TO_MBUF(omp);
+}
+
+static void
+ble_hs_rx_slots_clear(void)
+{
+    struct os_mbuf *om;
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        while ((om = ble_hs_rx_slot_get(&ble_hs_rx_slots[i], 0)) != NULL) {
+            os_mbuf_free_chain(om);
+        }
+    }
+}
+#endif
+
+/**
+ * Processes the received ACL data packets.  With BLE_HS_RX_ROUND_ROBIN the
+ * waiting packets are sorted by connection and one packet of each connection
+ * is processed in turn, so a peer that sends many packets at once, such as a
+ * long write, does not hold back the requests of the other peers.  The
+ * packets of a connection are always processed in order.
+ */
 void
 ble_hs_process_rx_data_queue(void)
 {
     struct os_mbuf *om;
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    uint16_t processed;
+    uint8_t slot;
+    int found;
+    int i;
 
     while ((om = ble_mqueue_get(&ble_hs_rx_q)) != NULL) {
-#if BLE_MONITOR
-        ble_monitor_send_om(BLE_MONITOR_OPCODE_ACL_RX_PKT, om);
+        if (ble_hs_rx_slot_put(om) != 0) {
+            /* Not sorted, processing reports the bad packet. */
+            ble_hs_process_rx_data(om);
+        }
+    }
+
+    processed = 0;
+    do {
+        found = 0;
+        for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+            slot = (ble_hs_rx_first_slot + i) % MYNEWT_VAL(BLE_MAX_CONNECTIONS);
+            om = ble_hs_rx_slot_get(&ble_hs_rx_slots[slot], processed);
+            if (om != NULL) {
+                ble_hs_process_rx_data(om);
+                processed++;
+                found = 1;
+            }
+        }
+    } while (found);
+
+    /* Every connection goes first in turn. */
+    ble_hs_rx_first_slot = (ble_hs_rx_first_slot + 1) %
+                           MYNEWT_VAL(BLE_MAX_CONNECTIONS);
+#else
+    while ((om = ble_mqueue_get(&ble_hs_rx_q)) != NULL) {
+        ble_hs_process_rx_data(om);
+    }
+#endif
+}
+
+/**
+ * Clears the received data counters of a connection that is closed, called
+ * with the host lock held.
+ */
+void
+ble_hs_rx_work_clear(uint16_t conn_handle)
+{
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    struct ble_hs_rx_slot *slot;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    slot = ble_hs_rx_slot_find(conn_handle);
+    if (slot != NULL) {
+        memset(&slot->work, 0, sizeof(slot->work));
+        if (slot->queued == 0) {
+            slot->conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        }
+    }
 #endif
+}
+
+int
+ble_hs_rx_work_get(uint16_t conn_handle, struct ble_hs_rx_work *out_work)
+{
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    struct ble_hs_rx_slot *slot;
+    int rc;
+
+    ble_hs_lock();
 
-        ble_hs_hci_evt_acl_process(om);
+    slot = ble_hs_rx_slot_find(conn_handle);
+    if (slot != NULL) {
+        *out_work = slot->work;
+        rc = 0;
+    } else {
+        rc = BLE_HS_ENOTCONN;
     }
+
+    ble_hs_unlock();
+
+    return rc;
+#else
+    return BLE_HS_ENOTSUP;
+#endif
 }
 
 static int
@@ -332,6 +543,10 @@ ble_hs_clear_rx_queue(void)
     while ((om = ble_mqueue_get(&ble_hs_rx_q)) != NULL) {
         os_mbuf_free_chain(om);
     }
+
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    ble_hs_rx_slots_clear();
+#endif
 }
 
 int
@@ -375,6 +590,12 @@ ble_hs_sync(void)
                        rc);
         }
 
+#if NIMBLE_BLE_CONNECT && NIMBLE_BLE_SM && \
+    MYNEWT_VAL(BLE_SM_SC) && MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+        /* Generate the secure connections key pair ahead of pairing. */
+        ble_sm_sc_synced();
+#endif
+
         if (ble_hs_cfg.sync_cb != NULL) {
             ble_hs_cfg.sync_cb();
         }
@@ -748,6 +969,9 @@ ble_hs_tx_data(struct os_mbuf *om)
 void
 ble_hs_init(void)
 {
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    int i;
+#endif
     int rc;
 
     /* Ensure this function only gets called by sysinit. */
@@ -808,6 +1032,15 @@ ble_hs_init(void)
 
     ble_mqueue_init(&ble_hs_rx_q, ble_hs_event_rx_data, NULL);
 
+#if MYNEWT_VAL(BLE_HS_RX_ROUND_ROBIN)
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        STAILQ_INIT(&ble_hs_rx_slots[i].pkts);
+        ble_hs_rx_slots[i].conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        ble_hs_rx_slots[i].queued = 0;
+    }
+    ble_hs_rx_first_slot = 0;
+#endif
+
     rc = stats_init_and_reg(
         STATS_HDR(ble_hs_stats), STATS_SIZE_INIT_PARMS(ble_hs_stats,
         STATS_SIZE_32), STATS_NAME_INIT_PARMS(ble_hs_stats), "ble_hs");
@@ -870,6 +1103,8 @@ ble_hs_deinit(void)
     ble_hs_flow_stop();
 
 #if NIMBLE_BLE_CONNECT
+    ble_gattc_deinit();
+
     ble_npl_event_deinit(&ble_hs_ev_tx_notifications);
 #endif
 
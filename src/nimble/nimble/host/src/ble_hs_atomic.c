@@ -34,7 +34,7 @@ ble_hs_atomic_conn_delete(uint16_t conn_handle)
         }
 #endif
         ble_hs_conn_free(conn);
-
+        ble_hs_rx_work_clear(conn_handle);
     }
     ble_hs_unlock();
 
@@ -29,6 +29,15 @@
 #define BLE_HS_CONN_MIN_CHANS       3
 
 static SLIST_HEAD(, ble_hs_conn) ble_hs_conns;
+
+/**
+ * Connections indexed by slot for lookups by handle; the list keeps the
+ * iteration order.  A connection is placed in the slot of its handle modulo
+ * the number of slots when that slot is free, so a lookup normally checks a
+ * single slot.
+ */
+#define BLE_HS_CONN_NUM_SLOTS   MYNEWT_VAL(BLE_MAX_CONNECTIONS)
+static struct ble_hs_conn *ble_hs_conn_slots[BLE_HS_CONN_NUM_SLOTS];
 static struct os_mempool ble_hs_conn_pool;
 
 static os_membuf_t ble_hs_conn_elem_mem[
@@ -38,6 +47,8 @@ static os_membuf_t ble_hs_conn_elem_mem[
 
 static const uint8_t ble_hs_conn_null_addr[6];
 
+static struct ble_hs_tx_prio_stats ble_hs_conn_tx_prio_stats;
+
 int
 ble_hs_conn_can_alloc(void)
 {
@@ -264,6 +275,73 @@ ble_hs_conn_free(struct ble_hs_conn *conn)
     STATS_INC(ble_hs_stats, conn_delete);
 }
 
+/**
+ * Queues a packet that is waiting for a controller buffer.  The packet is
+ * placed behind the queued packets of the same or a higher transmit priority
+ * class, and never ahead of a packet whose first fragments were sent.
+ */
+void
+ble_hs_conn_tx_enqueue(struct ble_hs_conn *conn, struct os_mbuf *om)
+{
+    struct os_mbuf_pkthdr *prev;
+    struct os_mbuf_pkthdr *cur;
+    uint8_t prio;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    prio = ble_hs_mbuf_tx_prio(om);
+    ble_hs_conn_tx_prio_stats.queued_pkts[prio]++;
+
+    /* Usually every packet has the same class, append without walking. */
+    cur = STAILQ_LAST(&conn->bhc_tx_q, os_mbuf_pkthdr, omp_next);
+    if (cur == NULL ||
+        ble_hs_mbuf_tx_prio(OS_MBUF_PKTHDR_TO_MBUF(cur)) >= prio) {
+        STAILQ_INSERT_TAIL(&conn->bhc_tx_q, OS_MBUF_PKTHDR(om), omp_next);
+        return;
+    }
+
+    prev = NULL;
+    STAILQ_FOREACH(cur, &conn->bhc_tx_q, omp_next) {
+        if (prev == NULL && (conn->bhc_flags & BLE_HS_CONN_F_TX_FRAG)) {
+            prev = cur;
+            continue;
+        }
+        if (ble_hs_mbuf_tx_prio(OS_MBUF_PKTHDR_TO_MBUF(cur)) < prio) {
+            break;
+        }
+        prev = cur;
+    }
+
+    ble_hs_conn_tx_prio_stats.ahead_pkts[prio]++;
+    if (prev == NULL) {
+        STAILQ_INSERT_HEAD(&conn->bhc_tx_q, OS_MBUF_PKTHDR(om), omp_next);
+    } else {
+        STAILQ_INSERT_AFTER(&conn->bhc_tx_q, prev, OS_MBUF_PKTHDR(om),
+                            omp_next);
+    }
+}
+
+/**
+ * Counts a packet accepted for transmission in its priority class.
+ */
+void
+ble_hs_conn_tx_accepted(const struct os_mbuf *om)
+{
+    ble_hs_conn_tx_prio_stats.tx_pkts[ble_hs_mbuf_tx_prio(om)]++;
+}
+
+void
+ble_hs_tx_prio_stats(struct ble_hs_tx_prio_stats *out_stats, int reset)
+{
+    ble_hs_lock();
+    *out_stats = ble_hs_conn_tx_prio_stats;
+    if (reset) {
+        memset(&ble_hs_conn_tx_prio_stats, 0,
+               sizeof ble_hs_conn_tx_prio_stats);
+    }
+    ble_hs_unlock();
+}
+
 void
 ble_hs_conn_insert(struct ble_hs_conn *conn)
 {
@@ -271,10 +349,26 @@ ble_hs_conn_insert(struct ble_hs_conn *conn)
     return;
 #endif
 
+    int slot;
+    int i;
+
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     BLE_HS_DBG_ASSERT_EVAL(ble_hs_conn_find(conn->bhc_handle) == NULL);
     SLIST_INSERT_HEAD(&ble_hs_conns, conn, bhc_next);
+
+    slot = conn->bhc_handle % BLE_HS_CONN_NUM_SLOTS;
+    for (i = 0; i < BLE_HS_CONN_NUM_SLOTS; i++) {
+        if (ble_hs_conn_slots[slot] == NULL) {
+            break;
+        }
+        slot = (slot + 1) % BLE_HS_CONN_NUM_SLOTS;
+    }
+
+    /* The pool holds one connection per slot. */
+    BLE_HS_DBG_ASSERT(ble_hs_conn_slots[slot] == NULL);
+    ble_hs_conn_slots[slot] = conn;
+    conn->bhc_slot = slot;
 }
 
 void
@@ -287,6 +381,10 @@ ble_hs_conn_remove(struct ble_hs_conn *conn)
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     SLIST_REMOVE(&ble_hs_conns, conn, ble_hs_conn, bhc_next);
+
+    if (ble_hs_conn_slots[conn->bhc_slot] == conn) {
+        ble_hs_conn_slots[conn->bhc_slot] = NULL;
+    }
 }
 
 struct ble_hs_conn *
@@ -297,18 +395,47 @@ ble_hs_conn_find(uint16_t conn_handle)
 #endif
 
     struct ble_hs_conn *conn;
+    int slot;
+    int i;
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
-        if (conn->bhc_handle == conn_handle) {
+    slot = conn_handle % BLE_HS_CONN_NUM_SLOTS;
+    for (i = 0; i < BLE_HS_CONN_NUM_SLOTS; i++) {
+        conn = ble_hs_conn_slots[slot];
+        if (conn != NULL && conn->bhc_handle == conn_handle) {
             return conn;
         }
+        slot = (slot + 1) % BLE_HS_CONN_NUM_SLOTS;
     }
 
     return NULL;
 }
 
+/**
+ * Retrieves the slot index of a connection.
+ *
+ * @param conn_handle           The handle of the connection.
+ * @param out_slot              On success, the slot index gets written here;
+ *                                  0 to MYNEWT_VAL(BLE_MAX_CONNECTIONS) - 1.
+ *
+ * @return                      0 on success; BLE_HS_ENOTCONN if there is no
+ *                                  connection with the handle.
+ */
+int
+ble_hs_conn_slot(uint16_t conn_handle, uint8_t *out_slot)
+{
+    struct ble_hs_conn *conn;
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        return BLE_HS_ENOTCONN;
+    }
+
+    *out_slot = conn->bhc_slot;
+    return 0;
+}
+
 struct ble_hs_conn *
 ble_hs_conn_find_assert(uint16_t conn_handle)
 {
@@ -598,6 +725,7 @@ ble_hs_conn_init(void)
     }
 
     SLIST_INIT(&ble_hs_conns);
+    memset(ble_hs_conn_slots, 0, sizeof ble_hs_conn_slots);
 
     return 0;
 }
@@ -50,6 +50,8 @@ typedef uint8_t ble_hs_conn_flags_t;
 struct ble_hs_conn {
     SLIST_ENTRY(ble_hs_conn) bhc_next;
     uint16_t bhc_handle;
+    /* Index of the connection in the slot table, set when inserted. */
+    uint8_t bhc_slot;
     uint8_t bhc_our_addr_type;
 #if MYNEWT_VAL(BLE_EXT_ADV)
     uint8_t bhc_our_rnd_addr[6];
@@ -80,6 +82,10 @@ struct ble_hs_conn {
      */
     uint16_t bhc_outstanding_pkts;
 
+    /** Count of ACL packets sent and received over this connection. */
+    uint32_t bhc_tx_pkts;
+    uint32_t bhc_rx_pkts;
+
 #if MYNEWT_VAL(BLE_HS_FLOW_CTRL)
     /**
      * Count of packets received over this connection that have been processed
@@ -117,6 +123,7 @@ void ble_hs_conn_free(struct ble_hs_conn *conn);
 void ble_hs_conn_insert(struct ble_hs_conn *conn);
 void ble_hs_conn_remove(struct ble_hs_conn *conn);
 struct ble_hs_conn *ble_hs_conn_find(uint16_t conn_handle);
+int ble_hs_conn_slot(uint16_t conn_handle, uint8_t *out_slot);
 struct ble_hs_conn *ble_hs_conn_find_assert(uint16_t conn_handle);
 struct ble_hs_conn *ble_hs_conn_find_by_addr(const ble_addr_t *addr);
 struct ble_hs_conn *ble_hs_conn_find_by_idx(int idx);
@@ -132,6 +139,8 @@ int ble_hs_conn_chan_insert(struct ble_hs_conn *conn,
 void ble_hs_conn_delete_chan(struct ble_hs_conn *conn,
                              struct ble_l2cap_chan *chan);
 
+void ble_hs_conn_tx_enqueue(struct ble_hs_conn *conn, struct os_mbuf *om);
+void ble_hs_conn_tx_accepted(const struct os_mbuf *om);
 void ble_hs_conn_addrs(const struct ble_hs_conn *conn,
                        struct ble_hs_conn_addrs *addrs);
 int32_t ble_hs_conn_timer(void);
@@ -43,6 +43,43 @@ static struct ble_npl_event ble_hs_flow_ev;
 /* Connection handle associated with each mbuf in ACL pool */
 static uint16_t ble_hs_flow_mbuf_conn_handle[ MYNEWT_VAL(BLE_ACL_BUF_COUNT) ];
 
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+
+/* The window is adapted at most this often. */
+#define BLE_HS_FLOW_ADAPT_TICKS     (BLE_HS_FLOW_ITVL_TICKS / 4 + 1)
+
+/* Buffers added to the window each time it grows. */
+#define BLE_HS_FLOW_GROW_STEP       \
+    ((MYNEWT_VAL(BLE_ACL_BUF_COUNT) + 7) / 8)
+
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS) < 1 || \
+    MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS) > MYNEWT_VAL(BLE_ACL_BUF_COUNT)
+#error "BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS must be between 1 and BLE_ACL_BUF_COUNT"
+#endif
+
+/**
+ * The number of buffers the controller may have in flight to the host.  All
+ * BLE_ACL_BUF_COUNT buffers are advertised at startup; the window is made
+ * smaller by keeping the credits of BLE_ACL_BUF_COUNT - window freed buffers
+ * unreported.
+ */
+static uint16_t ble_hs_flow_window;
+
+/* Average time from reception to release of an ACL buffer, in ms * 8. */
+static uint32_t ble_hs_flow_latency8;
+
+/* Buffers released since the window was last adapted. */
+static uint16_t ble_hs_flow_num_freed;
+
+static ble_npl_time_t ble_hs_flow_adapt_time;
+static ble_npl_time_t ble_hs_flow_throttle_start;
+static ble_npl_time_t ble_hs_flow_throttled_ticks;
+static struct ble_hs_flow_stats ble_hs_flow_stats;
+
+/* Reception time of each mbuf in ACL pool */
+static ble_npl_time_t ble_hs_flow_mbuf_rx_time[ MYNEWT_VAL(BLE_ACL_BUF_COUNT) ];
+#endif
+
 static inline int
 ble_hs_flow_mbuf_index(const struct os_mbuf *om)
 {
@@ -58,18 +95,54 @@ ble_hs_flow_mbuf_index(const struct os_mbuf *om)
 }
 
 static int
-ble_hs_flow_tx_num_comp_pkts(void)
+ble_hs_flow_tx_conn(struct ble_hs_conn *conn, uint16_t count)
 {
     uint8_t buf[
         sizeof(struct ble_hci_cb_host_num_comp_pkts_cp) +
         sizeof(struct ble_hci_cb_host_num_comp_pkts_entry)
     ];
     struct ble_hci_cb_host_num_comp_pkts_cp *cmd = (void *) buf;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    /* Only specify one connection per command. */
+    /* TODO could combine this in single HCI command */
+    cmd->handles = 1;
+
+    /* Append entry for this connection. */
+    cmd->h[0].handle = htole16(conn->bhc_handle);
+    cmd->h[0].count = htole16(count);
+
+    conn->bhc_completed_pkts -= count;
+    ble_hs_flow_num_completed_pkts -= count;
+
+    /* The host-number-of-completed-packets command does not elicit a
+     * response from the controller, so don't use the normal blocking
+     * HCI API when sending it.
+     */
+    return ble_hs_hci_cmd_tx_no_rsp(
+        BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
+                   BLE_HCI_OCF_CB_HOST_NUM_COMP_PKTS),
+        buf, sizeof(buf));
+}
+
+/**
+ * Reports up to max_pkts freed buffers to the controller.  The freed buffers
+ * of the connections that are gone are dropped from the count, the controller
+ * does not expect them.
+ */
+static int
+ble_hs_flow_tx_num_comp_pkts(uint16_t max_pkts)
+{
     struct ble_hs_conn *conn;
+    uint16_t pending;
+    uint16_t count;
     int rc;
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
+    pending = 0;
+
     /* For each connection with completed packets, send a separate
      * host-number-of-completed-packets command.
      */
@@ -77,34 +150,114 @@ ble_hs_flow_tx_num_comp_pkts(void)
          conn != NULL;
          conn = SLIST_NEXT(conn, bhc_next)) {
 
-        if (conn->bhc_completed_pkts > 0) {
-            /* Only specify one connection per command. */
-            /* TODO could combine this in single HCI command */
-            cmd->handles = 1;
-
-            /* Append entry for this connection. */
-            cmd->h[0].handle = htole16(conn->bhc_handle);
-            cmd->h[0].count = htole16(conn->bhc_completed_pkts);
-
-            conn->bhc_completed_pkts = 0;
-
-            /* The host-number-of-completed-packets command does not elicit a
-             * response from the controller, so don't use the normal blocking
-             * HCI API when sending it.
-             */
-            rc = ble_hs_hci_cmd_tx_no_rsp(
-                BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                           BLE_HCI_OCF_CB_HOST_NUM_COMP_PKTS),
-                buf, sizeof(buf));
+        count = min(conn->bhc_completed_pkts, max_pkts);
+        if (count > 0) {
+            rc = ble_hs_flow_tx_conn(conn, count);
             if (rc != 0) {
                 return rc;
             }
+            max_pkts -= count;
         }
+
+        pending += conn->bhc_completed_pkts;
     }
 
+    ble_hs_flow_num_completed_pkts = pending;
+
     return 0;
 }
 
+/**
+ * Returns the number of freed buffers that can be reported to the
+ * controller, those past the credits held back to limit the window.
+ */
+static uint16_t
+ble_hs_flow_num_reportable(void)
+{
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    uint16_t reserve;
+
+    reserve = MYNEWT_VAL(BLE_ACL_BUF_COUNT) - ble_hs_flow_window;
+    if (ble_hs_flow_num_completed_pkts <= reserve) {
+        return 0;
+    }
+
+    return ble_hs_flow_num_completed_pkts - reserve;
+#else
+    return ble_hs_flow_num_completed_pkts;
+#endif
+}
+
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+static void
+ble_hs_flow_set_window(uint16_t window, ble_npl_time_t now)
+{
+    if (ble_hs_flow_window == MYNEWT_VAL(BLE_ACL_BUF_COUNT)) {
+        ble_hs_flow_throttle_start = now;
+    } else if (window == MYNEWT_VAL(BLE_ACL_BUF_COUNT)) {
+        ble_hs_flow_throttled_ticks += now - ble_hs_flow_throttle_start;
+    }
+
+    ble_hs_flow_window = window;
+    if (window < ble_hs_flow_stats.window_min) {
+        ble_hs_flow_stats.window_min = window;
+    }
+}
+
+/**
+ * Makes the window smaller when the msys pools run low or the host takes too
+ * long to process the received data, and larger otherwise.
+ */
+static void
+ble_hs_flow_adapt(void)
+{
+    ble_npl_time_t now;
+    uint16_t window;
+    uint16_t step;
+    bool congested;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    now = ble_npl_time_get();
+    if ((ble_npl_stime_t)(now - ble_hs_flow_adapt_time) <
+        (ble_npl_stime_t)BLE_HS_FLOW_ADAPT_TICKS) {
+        return;
+    }
+    ble_hs_flow_adapt_time = now;
+
+    /* Nothing was processed, let the average age. */
+    if (ble_hs_flow_num_freed == 0) {
+        ble_hs_flow_latency8 -= ble_hs_flow_latency8 / 8;
+    }
+    ble_hs_flow_num_freed = 0;
+
+    congested = os_msys_num_free() <
+                MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE) ||
+                ble_hs_flow_latency8 >
+                MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS) * 8;
+
+    window = ble_hs_flow_window;
+    if (congested) {
+        if (window <= MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS)) {
+            return;
+        }
+        step = max(window / 4, 1);
+        window = max(window - step,
+                     MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS));
+        ble_hs_flow_stats.shrinks++;
+    } else {
+        if (window >= MYNEWT_VAL(BLE_ACL_BUF_COUNT)) {
+            return;
+        }
+        window = min(window + BLE_HS_FLOW_GROW_STEP,
+                     MYNEWT_VAL(BLE_ACL_BUF_COUNT));
+        ble_hs_flow_stats.grows++;
+    }
+
+    ble_hs_flow_set_window(window, now);
+}
+#endif
+
 static void
 ble_hs_flow_event_cb(struct ble_npl_event *ev)
 {
@@ -112,14 +265,24 @@ ble_hs_flow_event_cb(struct ble_npl_event *ev)
 
     ble_hs_lock();
 
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    ble_hs_flow_adapt();
+#endif
+
     if (ble_hs_flow_num_completed_pkts > 0) {
-        rc = ble_hs_flow_tx_num_comp_pkts();
+        rc = ble_hs_flow_tx_num_comp_pkts(ble_hs_flow_num_reportable());
         if (rc != 0) {
             ble_hs_sched_reset(rc);
+            ble_hs_flow_num_completed_pkts = 0;
         }
+    }
 
-        ble_hs_flow_num_completed_pkts = 0;
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    /* Credits are held back, check again later whether the window can grow. */
+    if (ble_hs_flow_num_completed_pkts > 0) {
+        ble_npl_callout_reset(&ble_hs_flow_timer, BLE_HS_FLOW_ITVL_TICKS);
     }
+#endif
 
     ble_hs_unlock();
 }
@@ -127,6 +290,7 @@ ble_hs_flow_event_cb(struct ble_npl_event *ev)
 static void
 ble_hs_flow_inc_completed_pkts(struct ble_hs_conn *conn)
 {
+    uint16_t num_reportable;
     uint16_t num_free;
 
     int rc;
@@ -141,14 +305,29 @@ ble_hs_flow_inc_completed_pkts(struct ble_hs_conn *conn)
         return;
     }
 
+    num_reportable = ble_hs_flow_num_reportable();
+    if (num_reportable == 0) {
+        /* Held back to limit the window, the timer grows it again. */
+        if (!ble_npl_callout_is_active(&ble_hs_flow_timer)) {
+            rc = ble_npl_callout_reset(&ble_hs_flow_timer,
+                                       BLE_HS_FLOW_ITVL_TICKS);
+            BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+        }
+        return;
+    }
+
     /* If the number of free buffers is at or below the configured threshold,
      * send an immediate number-of-copmleted-packets event.
      */
-    num_free = MYNEWT_VAL(BLE_ACL_BUF_COUNT) - ble_hs_flow_num_completed_pkts;
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    num_free = ble_hs_flow_window - num_reportable;
+#else
+    num_free = MYNEWT_VAL(BLE_ACL_BUF_COUNT) - num_reportable;
+#endif
     if (num_free <= MYNEWT_VAL(BLE_HS_FLOW_CTRL_THRESH)) {
         ble_npl_eventq_put(ble_hs_evq_get(), &ble_hs_flow_ev);
         ble_npl_callout_stop(&ble_hs_flow_timer);
-    } else if (ble_hs_flow_num_completed_pkts == 1) {
+    } else if (num_reportable == 1) {
         rc = ble_npl_callout_reset(&ble_hs_flow_timer, BLE_HS_FLOW_ITVL_TICKS);
         BLE_HS_DBG_ASSERT_EVAL(rc == 0);
     }
@@ -160,6 +339,9 @@ ble_hs_flow_acl_free(struct os_mempool_ext *mpe, void *data, void *arg)
     struct ble_hs_conn *conn;
     const struct os_mbuf *om;
     uint16_t conn_handle;
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    uint32_t latency_ms;
+#endif
     int idx;
     int rc;
 
@@ -167,6 +349,10 @@ ble_hs_flow_acl_free(struct os_mempool_ext *mpe, void *data, void *arg)
 
     idx = ble_hs_flow_mbuf_index(om);
     conn_handle = ble_hs_flow_mbuf_conn_handle[idx];
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    latency_ms = ble_npl_time_ticks_to_ms32(ble_npl_time_get() -
+                                            ble_hs_flow_mbuf_rx_time[idx]);
+#endif
 
     /* Free the mbuf back to its pool. */
     rc = os_memblock_put_from_cb(&mpe->mpe_mp, data);
@@ -179,6 +365,11 @@ ble_hs_flow_acl_free(struct os_mempool_ext *mpe, void *data, void *arg)
      */
     ble_hs_lock_nested();
 
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    ble_hs_flow_latency8 += latency_ms - ble_hs_flow_latency8 / 8;
+    ble_hs_flow_num_freed++;
+#endif
+
     conn = ble_hs_conn_find(conn_handle);
     if (conn != NULL) {
         ble_hs_flow_inc_completed_pkts(conn);
@@ -195,8 +386,19 @@ ble_hs_flow_connection_broken(uint16_t conn_handle)
 {
 #if MYNEWT_VAL(BLE_HS_FLOW_CTRL) &&                 \
     MYNEWT_VAL(BLE_HS_FLOW_CTRL_TX_ON_DISCONNECT)
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    struct ble_hs_conn *conn;
+#endif
+
     ble_hs_lock();
-    ble_hs_flow_tx_num_comp_pkts();
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    /* The credits of the broken link are not held back. */
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL && conn->bhc_completed_pkts > 0) {
+        ble_hs_flow_tx_conn(conn, conn->bhc_completed_pkts);
+    }
+#endif
+    ble_hs_flow_tx_num_comp_pkts(ble_hs_flow_num_reportable());
     ble_hs_unlock();
 #endif
 }
@@ -215,6 +417,37 @@ ble_hs_flow_track_data_mbuf(struct os_mbuf *om)
 
     hdr = (void *)om->om_data;
     ble_hs_flow_mbuf_conn_handle[idx] = BLE_HCI_DATA_HANDLE(hdr->hdh_handle_pb_bc);
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    ble_hs_flow_mbuf_rx_time[idx] = ble_npl_time_get();
+#endif
+#endif
+}
+
+int
+ble_hs_flow_get_stats(struct ble_hs_flow_stats *out_stats)
+{
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL) && MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    ble_npl_time_t throttled;
+
+    ble_hs_lock();
+
+    throttled = ble_hs_flow_throttled_ticks;
+    if (ble_hs_flow_window < MYNEWT_VAL(BLE_ACL_BUF_COUNT)) {
+        throttled += ble_npl_time_get() - ble_hs_flow_throttle_start;
+    }
+
+    *out_stats = ble_hs_flow_stats;
+    out_stats->window = ble_hs_flow_window;
+    out_stats->withheld = ble_hs_flow_num_completed_pkts -
+                          ble_hs_flow_num_reportable();
+    out_stats->latency_ms = min(ble_hs_flow_latency8 / 8, UINT16_MAX);
+    out_stats->throttled_ms = ble_npl_time_ticks_to_ms32(throttled);
+
+    ble_hs_unlock();
+
+    return 0;
+#else
+    return BLE_HS_ENOTSUP;
 #endif
 }
 
@@ -268,6 +501,15 @@ ble_hs_flow_startup(void)
 
     /* Flow control successfully enabled. */
     ble_hs_flow_num_completed_pkts = 0;
+#if MYNEWT_VAL(BLE_HS_FLOW_CTRL_ADAPTIVE)
+    ble_hs_flow_window = MYNEWT_VAL(BLE_ACL_BUF_COUNT);
+    ble_hs_flow_latency8 = 0;
+    ble_hs_flow_num_freed = 0;
+    ble_hs_flow_throttled_ticks = 0;
+    ble_hs_flow_adapt_time = ble_npl_time_get();
+    memset(&ble_hs_flow_stats, 0, sizeof(ble_hs_flow_stats));
+    ble_hs_flow_stats.window_min = ble_hs_flow_window;
+#endif
     ble_hci_trans_set_acl_free_cb(ble_hs_flow_acl_free, NULL);
     /* Stop flow control timer, if not already */
     ble_npl_callout_stop(&ble_hs_flow_timer);
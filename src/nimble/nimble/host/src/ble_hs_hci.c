@@ -36,6 +36,26 @@ static struct ble_hci_ev *ble_hs_hci_ack;
 static uint16_t ble_hs_hci_buf_sz;
 static uint8_t ble_hs_hci_max_pkts;
 
+/**
+ * The number of commands the controller can accept, the Num_HCI_Command_Packets
+ * field of the last Command Complete or Command Status event.  Only accessed in
+ * a critical section.
+ */
+static uint8_t ble_hs_hci_cmd_credits = 1;
+
+#if MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE) > 1
+/**
+ * The acknowledgements of the commands a batch has in flight, added by the
+ * transport and taken by the task sending the batch.  Only accessed in a
+ * critical section.
+ */
+static struct ble_hci_ev *
+ble_hs_hci_batch_acks[MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE)];
+static uint8_t ble_hs_hci_batch_ack_head;
+static uint8_t ble_hs_hci_batch_ack_count;
+static uint8_t ble_hs_hci_batch_active;
+#endif
+
 /* For now 32-bits of features is enough */
 static uint32_t ble_hs_hci_sup_feat;
 
@@ -195,14 +215,11 @@ ble_hs_hci_rx_cmd_status(const void *data, int len,
 }
 
 static int
-ble_hs_hci_process_ack(uint16_t expected_opcode,
-                       uint8_t *params_buf, uint8_t params_buf_len,
-                       struct ble_hs_hci_ack *out_ack)
+ble_hs_hci_parse_ack(const struct ble_hci_ev *ev,
+                     struct ble_hs_hci_ack *out_ack)
 {
     int rc;
 
-    BLE_HS_DBG_ASSERT(ble_hs_hci_ack != NULL);
-
     /* Count events received */
     STATS_INC(ble_hs_stats, hci_event);
 
@@ -210,15 +227,13 @@ ble_hs_hci_process_ack(uint16_t expected_opcode,
     /* Clear ack fields up front to silence spurious gcc warnings. */
     memset(out_ack, 0, sizeof *out_ack);
 
-    switch (ble_hs_hci_ack->opcode) {
+    switch (ev->opcode) {
     case BLE_HCI_EVCODE_COMMAND_COMPLETE:
-        rc = ble_hs_hci_rx_cmd_complete(ble_hs_hci_ack->data,
-                                        ble_hs_hci_ack->length, out_ack);
+        rc = ble_hs_hci_rx_cmd_complete(ev->data, ev->length, out_ack);
         break;
 
     case BLE_HCI_EVCODE_COMMAND_STATUS:
-        rc = ble_hs_hci_rx_cmd_status(ble_hs_hci_ack->data,
-                                      ble_hs_hci_ack->length, out_ack);
+        rc = ble_hs_hci_rx_cmd_status(ev->data, ev->length, out_ack);
         break;
 
     default:
@@ -227,6 +242,20 @@ ble_hs_hci_process_ack(uint16_t expected_opcode,
         break;
     }
 
+    return rc;
+}
+
+static int
+ble_hs_hci_process_ack(uint16_t expected_opcode,
+                       uint8_t *params_buf, uint8_t params_buf_len,
+                       struct ble_hs_hci_ack *out_ack)
+{
+    int rc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_hci_ack != NULL);
+
+    rc = ble_hs_hci_parse_ack(ble_hs_hci_ack, out_ack);
+
     if (rc == 0) {
         if (params_buf == NULL || out_ack->bha_params == NULL) {
             out_ack->bha_params_len = 0;
@@ -350,9 +379,265 @@ done:
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE) > 1 && !MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+/**
+ * Takes a command credit, one command can always be sent when none is in
+ * flight.
+ */
+static int
+ble_hs_hci_batch_take_credit(int in_flight)
+{
+    uint32_t sr;
+    int rc;
+
+    sr = ble_npl_hw_enter_critical();
+    if (ble_hs_hci_cmd_credits > 0) {
+        ble_hs_hci_cmd_credits--;
+        rc = 1;
+    } else {
+        rc = in_flight == 0;
+    }
+    ble_npl_hw_exit_critical(sr);
+
+    return rc;
+}
+
+static struct ble_hci_ev *
+ble_hs_hci_batch_take_ack(void)
+{
+    struct ble_hci_ev *ev;
+    uint32_t sr;
+
+    sr = ble_npl_hw_enter_critical();
+    if (ble_hs_hci_batch_ack_count == 0) {
+        ev = NULL;
+    } else {
+        ev = ble_hs_hci_batch_acks[ble_hs_hci_batch_ack_head];
+        ble_hs_hci_batch_ack_head = (ble_hs_hci_batch_ack_head + 1) %
+                                    MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE);
+        ble_hs_hci_batch_ack_count--;
+    }
+    ble_npl_hw_exit_critical(sr);
+
+    return ev;
+}
+
+static void
+ble_hs_hci_batch_set_active(int active)
+{
+    uint32_t sr;
+
+    sr = ble_npl_hw_enter_critical();
+    ble_hs_hci_batch_active = active;
+    ble_npl_hw_exit_critical(sr);
+}
+
+/**
+ * Completes the in flight command of the batch that an acknowledgement is
+ * for, the oldest one with the same opcode.
+ *
+ * @return                      0 if the acknowledgement completed a command.
+ */
+static int
+ble_hs_hci_batch_rx_ack(struct ble_hs_hci_batch_cmd *cmds, int num_sent,
+                        const struct ble_hci_ev *ev)
+{
+    struct ble_hs_hci_batch_cmd *cmd;
+    struct ble_hs_hci_ack ack;
+    int rc;
+    int i;
+
+#if BLE_MONITOR
+    ble_monitor_send(BLE_MONITOR_OPCODE_EVENT_PKT, (void *) ev,
+                     sizeof(*ev) + ev->length);
+#endif
+
+    rc = ble_hs_hci_parse_ack(ev, &ack);
+    if (rc != 0) {
+        STATS_INC(ble_hs_stats, hci_invalid_ack);
+        return rc;
+    }
+
+    for (i = 0; i < num_sent; i++) {
+        cmd = cmds + i;
+        if (cmd->pending && cmd->opcode == ack.bha_opcode) {
+            break;
+        }
+    }
+    if (i == num_sent) {
+        STATS_INC(ble_hs_stats, hci_invalid_ack);
+        return BLE_HS_ECONTROLLER;
+    }
+
+    cmd->pending = 0;
+    cmd->status = ack.bha_status;
+
+    if (cmd->rsp == NULL || ack.bha_params == NULL) {
+        ack.bha_params_len = 0;
+    } else {
+        if (ack.bha_params_len > cmd->rsp_len) {
+            ack.bha_params_len = cmd->rsp_len;
+        }
+        memcpy(cmd->rsp, ack.bha_params, ack.bha_params_len);
+    }
+
+    /* on success we should always get full response */
+    if (cmd->status == 0 && ack.bha_params_len != cmd->rsp_len) {
+        STATS_INC(ble_hs_stats, hci_invalid_ack);
+        cmd->status = BLE_HS_ECONTROLLER;
+        ble_hs_sched_reset(cmd->status);
+    }
+
+    return 0;
+}
+#endif
+
+int
+ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds)
+{
+#if MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE) > 1 && !MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    struct ble_hci_ev *ev;
+    int in_flight;
+    int next;
+    int rc;
+    int i;
+
+    if (num_cmds <= 0) {
+        return 0;
+    }
+
+    BLE_HS_DBG_ASSERT(ble_hs_hci_ack == NULL);
+    ble_hs_hci_lock();
+    ble_hs_hci_batch_set_active(1);
+
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].status = BLE_HS_EUNKNOWN;
+        cmds[i].pending = 0;
+    }
+
+    in_flight = 0;
+    next = 0;
+
+    for (;;) {
+        /* Keep as many commands in flight as the controller accepts, the
+         * acknowledgements are collected by the transport so the host task
+         * does not need to run for the batch to complete.
+         */
+        while (next < num_cmds &&
+               in_flight < MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE) &&
+               ble_hs_hci_batch_take_credit(in_flight)) {
+
+            rc = ble_hs_hci_cmd_send_buf(cmds[next].opcode, cmds[next].cmd,
+                                         cmds[next].cmd_len);
+            if (rc != 0) {
+                /* Fail the commands not sent, wait for the others. */
+                for (; next < num_cmds; next++) {
+                    cmds[next].status = rc;
+                }
+                break;
+            }
+
+            cmds[next].pending = 1;
+            in_flight++;
+            next++;
+        }
+
+        if (in_flight == 0) {
+            break;
+        }
+
+        rc = ble_npl_sem_pend(&ble_hs_hci_sem,
+                              ble_npl_time_ms_to_ticks32(BLE_HCI_CMD_TIMEOUT_MS));
+        if (rc != 0) {
+            if (rc == OS_TIMEOUT) {
+                rc = BLE_HS_ETIMEOUT_HCI;
+                STATS_INC(ble_hs_stats, hci_timeout);
+            } else {
+                rc = BLE_HS_EOS;
+            }
+            ble_hs_sched_reset(rc);
+
+            for (i = 0; i < num_cmds; i++) {
+                if (cmds[i].pending || i >= next) {
+                    cmds[i].pending = 0;
+                    cmds[i].status = rc;
+                }
+            }
+            break;
+        }
+
+        ev = ble_hs_hci_batch_take_ack();
+        if (ev == NULL) {
+            continue;
+        }
+
+        if (ble_hs_hci_batch_rx_ack(cmds, next, ev) == 0) {
+            in_flight--;
+        }
+        ble_hci_trans_buf_free((uint8_t *) ev);
+    }
+
+    /* Drop the acknowledgements that arrived after a timeout. */
+    ble_hs_hci_batch_set_active(0);
+    while ((ev = ble_hs_hci_batch_take_ack()) != NULL) {
+        ble_hci_trans_buf_free((uint8_t *) ev);
+    }
+    while (ble_npl_sem_get_count(&ble_hs_hci_sem) > 0) {
+        ble_npl_sem_pend(&ble_hs_hci_sem, 0);
+    }
+
+    ble_hs_hci_unlock();
+#else
+    int i;
+
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].status = ble_hs_hci_cmd_tx(cmds[i].opcode, cmds[i].cmd,
+                                           cmds[i].cmd_len, cmds[i].rsp,
+                                           cmds[i].rsp_len);
+        cmds[i].pending = 0;
+    }
+#endif
+
+    for (i = 0; i < num_cmds; i++) {
+        if (cmds[i].status != 0) {
+            return cmds[i].status;
+        }
+    }
+
+    return 0;
+}
+
 static void
 ble_hs_hci_rx_ack(uint8_t *ack_ev)
 {
+#if MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE) > 1
+    uint32_t sr;
+    int queued;
+    int idx;
+
+    sr = ble_npl_hw_enter_critical();
+    if (ble_hs_hci_batch_active) {
+        queued = ble_hs_hci_batch_ack_count <
+                 MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE);
+        if (queued) {
+            idx = (ble_hs_hci_batch_ack_head + ble_hs_hci_batch_ack_count) %
+                  MYNEWT_VAL(BLE_HS_HCI_CMD_PIPELINE);
+            ble_hs_hci_batch_acks[idx] = (struct ble_hci_ev *) ack_ev;
+            ble_hs_hci_batch_ack_count++;
+        }
+        ble_npl_hw_exit_critical(sr);
+
+        if (queued) {
+            ble_npl_sem_release(&ble_hs_hci_sem);
+        } else {
+            /* More acknowledgements than commands in flight; ignore it. */
+            ble_hci_trans_buf_free(ack_ev);
+        }
+        return;
+    }
+    ble_npl_hw_exit_critical(sr);
+#endif
+
     if (ble_npl_sem_get_count(&ble_hs_hci_sem) > 0) {
         /* This ack is unexpected; ignore it. */
         ble_hci_trans_buf_free(ack_ev);
@@ -367,6 +652,16 @@ ble_hs_hci_rx_ack(uint8_t *ack_ev)
     ble_npl_sem_release(&ble_hs_hci_sem);
 }
 
+static void
+ble_hs_hci_set_cmd_credits(uint8_t num_packets)
+{
+    uint32_t sr;
+
+    sr = ble_npl_hw_enter_critical();
+    ble_hs_hci_cmd_credits = num_packets;
+    ble_npl_hw_exit_critical(sr);
+}
+
 int
 ble_hs_hci_rx_evt(uint8_t *hci_ev, void *arg)
 {
@@ -379,9 +674,11 @@ ble_hs_hci_rx_evt(uint8_t *hci_ev, void *arg)
 
     switch (ev->opcode) {
     case BLE_HCI_EVCODE_COMMAND_COMPLETE:
+        ble_hs_hci_set_cmd_credits(cmd_complete->num_packets);
         enqueue = (cmd_complete->opcode == BLE_HCI_OPCODE_NOP);
         break;
     case BLE_HCI_EVCODE_COMMAND_STATUS:
+        ble_hs_hci_set_cmd_credits(cmd_status->num_packets);
         enqueue = (cmd_status->opcode == BLE_HCI_OPCODE_NOP);
         break;
     default:
@@ -543,6 +840,7 @@ ble_hs_hci_acl_tx_now(struct ble_hs_conn *conn, struct os_mbuf **om)
 
         /* Account for the controller buf that will hold the txed fragment. */
         conn->bhc_outstanding_pkts++;
+        conn->bhc_tx_pkts++;
         ble_hs_hci_avail_pkts--;
     }
 
@@ -626,6 +924,11 @@ ble_hs_hci_init(void)
     rc = ble_npl_mutex_init(&ble_hs_hci_mutex);
     BLE_HS_DBG_ASSERT_EVAL(rc == 0);
 
+    /* The host may send one command until the controller reports its
+     * credits.
+     */
+    ble_hs_hci_set_cmd_credits(1);
+
     rc = mem_init_mbuf_pool(ble_hs_hci_frag_data,
                             &ble_hs_hci_frag_mempool,
                             &ble_hs_hci_frag_mbuf_pool,
@@ -936,6 +936,8 @@ ble_hs_hci_evt_acl_process(struct os_mbuf *om)
         rc = BLE_HS_ENOTCONN;
         reject_cid = -1;
     } else {
+        conn->bhc_rx_pkts++;
+
         /* Forward ACL data to L2CAP. */
         rc = ble_l2cap_rx(conn, &hci_hdr, om, &rx_cb, &reject_cid);
         om = NULL;
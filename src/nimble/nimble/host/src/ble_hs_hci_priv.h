@@ -54,6 +54,20 @@ struct ble_hs_hci_ack {
     uint8_t bha_hci_handle;
 };
 
+/**
+ * One command of a batch sent with ble_hs_hci_cmd_tx_batch().  The command
+ * and response buffers must stay valid until the batch returns.
+ */
+struct ble_hs_hci_batch_cmd {
+    uint16_t opcode;
+    const void *cmd;
+    uint8_t cmd_len;
+    void *rsp;              /* Return parameters, may be NULL. */
+    uint8_t rsp_len;
+    int status;             /* Out: a BLE_HS_E<...> error. */
+    uint8_t pending;        /* Internal: sent and not yet acknowledged. */
+};
+
 #if MYNEWT_VAL(BLE_EXT_ADV)
 struct ble_hs_hci_ext_scan_param {
     uint8_t scan_type;
@@ -85,6 +99,10 @@ extern uint16_t ble_hs_hci_avail_pkts;
 int ble_hs_hci_cmd_tx_no_rsp(uint16_t opcode, const void *cmd, uint8_t cmd_len);
 int ble_hs_hci_cmd_tx(uint16_t opcode, const void *cmd, uint8_t cmd_len,
                       void *rsp, uint8_t rsp_len);
+/* Sends the commands in order without waiting for each acknowledgement
+ * while the controller has command credits, returns the first failure.
+ */
+int ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds);
 void ble_hs_hci_init(void);
 void ble_hs_hci_deinit(void);
 
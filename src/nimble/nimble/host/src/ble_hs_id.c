@@ -146,6 +146,34 @@ done:
     ble_hs_unlock();
     return rc;
 }
+
+/**
+ * Gives the controller a new RPA or NRPA generated by the host and records it
+ * as the device random address, the caller checks that the controller allows
+ * the change.
+ *
+ * Lock restrictions:
+ *     o Caller locks ble_hs_mutex.
+ *
+ * @param addr                  The private address to set.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+ble_hs_id_set_private_rnd_no_lock(const uint8_t *addr)
+{
+    int rc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    rc = ble_hs_hci_util_set_random_addr(addr);
+    if (rc != 0) {
+        return rc;
+    }
+
+    memcpy(ble_hs_id_rnd, addr, BLE_DEV_ADDR_LEN);
+    return 0;
+}
 #endif
 
 int
@@ -37,6 +37,7 @@ void ble_hs_id_rnd_reset(void);
 bool ble_hs_is_rpa(uint8_t *addr, uint8_t addr_type);
 int ble_hs_id_set_pseudo_rnd(const uint8_t *);
 int ble_hs_id_set_nrpa_rnd(void);
+int ble_hs_id_set_private_rnd_no_lock(const uint8_t *addr);
 #endif
 #ifdef __cplusplus
 }
@@ -31,6 +31,8 @@ ble_hs_mbuf_gen_pkt(uint16_t leading_space)
 
     om = os_msys_get_pkthdr(0, 0);
     if (om == NULL) {
+        BLE_HS_TRACE(BLE_HS_TRACE_MBUF_FAIL, 0, BLE_HS_CONN_HANDLE_NONE, 0,
+                     leading_space, BLE_HS_ENOMEM);
         return NULL;
     }
 
@@ -145,6 +147,37 @@ ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len,
     return rc;
 }
 
+/* The class is stored relative to the normal class so that packets without
+ * one, whose flags are zero, are normal.
+ */
+void
+ble_hs_mbuf_set_tx_prio(struct os_mbuf *om, uint8_t prio)
+{
+    struct os_mbuf_pkthdr *omp;
+
+    BLE_HS_DBG_ASSERT(OS_MBUF_IS_PKTHDR(om));
+
+    omp = OS_MBUF_PKTHDR(om);
+    omp->omp_flags = (omp->omp_flags & ~BLE_HS_MBUF_F_TX_PRIO_MASK) |
+                     ((prio - BLE_HS_TX_PRIO_NORMAL) & BLE_HS_MBUF_F_TX_PRIO_MASK);
+}
+
+uint8_t
+ble_hs_mbuf_tx_prio(const struct os_mbuf *om)
+{
+    const struct os_mbuf_pkthdr *omp;
+
+    omp = OS_MBUF_PKTHDR(om);
+    return ((omp->omp_flags & BLE_HS_MBUF_F_TX_PRIO_MASK) +
+            BLE_HS_TX_PRIO_NORMAL) & BLE_HS_MBUF_F_TX_PRIO_MASK;
+}
+
+void
+ble_hs_mbuf_copy_tx_prio(struct os_mbuf *dst, const struct os_mbuf *src)
+{
+    ble_hs_mbuf_set_tx_prio(dst, ble_hs_mbuf_tx_prio(src));
+}
+
 int
 ble_hs_mbuf_pullup_base(struct os_mbuf **om, int base_len)
 {
@@ -26,10 +26,14 @@ extern "C" {
 
 struct os_mbuf;
 
+/* Bits of the packet header flags holding the transmit priority class. */
+#define BLE_HS_MBUF_F_TX_PRIO_MASK  0x0003
+
 struct os_mbuf *ble_hs_mbuf_bare_pkt(void);
 struct os_mbuf *ble_hs_mbuf_acl_pkt(void);
 struct os_mbuf *ble_hs_mbuf_l2cap_pkt(void);
 int ble_hs_mbuf_pullup_base(struct os_mbuf **om, int base_len);
+void ble_hs_mbuf_copy_tx_prio(struct os_mbuf *dst, const struct os_mbuf *src);
 
 #ifdef __cplusplus
 }
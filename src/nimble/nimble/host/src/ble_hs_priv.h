@@ -103,6 +103,7 @@ extern uint16_t ble_hs_max_services;
 extern uint16_t ble_hs_max_client_configs;
 
 void ble_hs_process_rx_data_queue(void);
+void ble_hs_rx_work_clear(uint16_t conn_handle);
 int ble_hs_tx_data(struct os_mbuf *om);
 void ble_hs_wakeup_tx(void);
 void ble_hs_enqueue_hci_event(uint8_t *hci_evt);
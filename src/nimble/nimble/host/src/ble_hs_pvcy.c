@@ -331,4 +331,20 @@ ble_hs_pvcy_rpa_config(uint8_t enable)
 
     return rc;
 }
+
+int
+ble_hs_pvcy_resolve_addr(const ble_addr_t *addr, ble_addr_t *out_id_addr)
+{
+    int rc;
+
+    if (!ble_hs_is_rpa((uint8_t *)addr->val, addr->type)) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+    rc = ble_hs_resolv_id_from_rpa(addr->val, out_id_addr);
+    ble_hs_unlock();
+
+    return rc;
+}
 #endif
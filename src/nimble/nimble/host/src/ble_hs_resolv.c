@@ -53,6 +53,34 @@ struct ble_hs_resolv_data {
 /* NRPA bit: Enables NRPA as private address. */
 static bool nrpa_pvcy;
 
+#if MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE) > 0
+/* Recently resolved peer RPAs, including the ones no bonded peer resolves, so
+ * repeated advertising reports from the same address do not need an AES
+ * operation per IRK.  Cleared on RPA timeout and when the resolving list
+ * changes.
+ */
+struct ble_hs_resolv_cache_entry {
+    uint8_t rpa[BLE_DEV_ADDR_LEN];
+    ble_addr_t id_addr;
+    uint8_t used: 1;
+    uint8_t resolved: 1;
+};
+
+static struct ble_hs_resolv_cache_entry
+    ble_hs_resolv_cache[MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE)];
+/* Next entry to replace, oldest first */
+static uint8_t ble_hs_resolv_cache_next;
+#endif
+
+static void
+ble_hs_resolv_cache_clear(void)
+{
+#if MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE) > 0
+    memset(ble_hs_resolv_cache, 0, sizeof ble_hs_resolv_cache);
+    ble_hs_resolv_cache_next = 0;
+#endif
+}
+
 /*** APIs for Peer Device Records.
  *
  * These Peer records are necessary to take care of Peers with RPA address when
@@ -460,7 +488,33 @@ ble_hs_get_rpa_local(void)
 static void
 ble_hs_resolv_rpa_timer_cb(struct ble_npl_event *ev)
 {
+    struct ble_hs_resolv_entry *rl;
+    ble_addr_t nrpa_addr;
+    const uint8_t *addr;
+
     if (ble_host_rpa_enabled() || (nrpa_pvcy)) {
+        /* Peers rotate their RPAs on a similar period */
+        ble_hs_resolv_cache_clear();
+
+        if (nrpa_pvcy) {
+            ble_hs_id_gen_rnd(1, &nrpa_addr);
+            addr = nrpa_addr.val;
+        } else {
+            rl = &g_ble_hs_resolv_list[0];
+            ble_hs_resolv_gen_priv_addr(rl, 1);
+            addr = rl->rl_local_rpa;
+        }
+
+        /* Advertising keeps going with the new address, the GAP is preempted
+         * only if a scan or connection procedure also uses it.
+         */
+        if (ble_gap_rotate_private_addr(addr) == 0) {
+            BLE_HS_LOG(DEBUG, "RPA/NRPA Timeout; new Private address set\n");
+            ble_npl_callout_reset(&g_ble_hs_resolv_data.rpa_timer,
+                                  (int32_t)g_ble_hs_resolv_data.rpa_tmo);
+            return;
+        }
+
         BLE_HS_LOG(DEBUG, "RPA/NRPA Timeout; start active adv & scan with new Private address \n");
         ble_gap_preempt();
         /* Generate local private address */
@@ -611,6 +665,7 @@ ble_hs_resolv_list_add(uint8_t *cmdbuf)
     ble_hs_resolv_gen_priv_addr(rl, 1);
     ble_hs_resolv_gen_priv_addr(rl, 0);
     ++(g_ble_hs_resolv_data.rl_cnt);
+    ble_hs_resolv_cache_clear();
     BLE_HS_LOG(DEBUG, "Device added to RL, Resolving list count = %d\n", g_ble_hs_resolv_data.rl_cnt);
 
     return 0;
@@ -635,6 +690,7 @@ ble_hs_resolv_list_rmv(uint8_t addr_type, uint8_t *ident_addr)
                 (g_ble_hs_resolv_data.rl_cnt - position) * sizeof (struct
                         ble_hs_resolv_entry));
         --g_ble_hs_resolv_data.rl_cnt;
+        ble_hs_resolv_cache_clear();
 
         rc = 0;
     }
@@ -656,6 +712,7 @@ ble_hs_resolv_list_clear_all(void)
     g_ble_hs_resolv_data.rl_cnt = 0;
     memset(g_ble_hs_resolv_list, 0, BLE_RESOLV_LIST_SIZE * sizeof(struct
            ble_hs_resolv_entry));
+    ble_hs_resolv_cache_clear();
 
     /* Now delete peer device records as well */
     ble_rpa_peer_dev_rec_clear_all();
@@ -783,9 +840,73 @@ ble_hs_resolv_rpa(uint8_t *rpa, uint8_t *irk)
     return rc;
 }
 
+/**
+ * Finds the identity address of the peer that generated an RPA using the
+ * peer IRKs in the resolving list.  The result is remembered, a following
+ * call with the same RPA does not do any AES operation.
+ *
+ * @param rpa       The resolvable private address, 6 bytes.
+ * @param out_id    On success, the identity address of the peer.
+ *
+ * @return 0 on success, BLE_HS_ENOENT if no peer in the resolving list
+ * resolves the address.
+ */
+int
+ble_hs_resolv_id_from_rpa(const uint8_t *rpa, ble_addr_t *out_id)
+{
+    struct ble_hs_resolv_entry *rl;
+    ble_addr_t id_addr = {0};
+    bool resolved = false;
+    int i;
+
+#if MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE) > 0
+    struct ble_hs_resolv_cache_entry *entry;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE); i++) {
+        entry = &ble_hs_resolv_cache[i];
+        if (entry->used && !memcmp(entry->rpa, rpa, BLE_DEV_ADDR_LEN)) {
+            if (!entry->resolved) {
+                return BLE_HS_ENOENT;
+            }
+            *out_id = entry->id_addr;
+            return 0;
+        }
+    }
+#endif
+
+    /* Entry 0 holds the local device configuration */
+    rl = &g_ble_hs_resolv_list[1];
+    for (i = 1; i < g_ble_hs_resolv_data.rl_cnt; ++i, ++rl) {
+        if (ble_hs_resolv_rpa((uint8_t *)rpa, rl->rl_peer_irk) == 0) {
+            id_addr.type = rl->rl_addr_type;
+            memcpy(id_addr.val, rl->rl_identity_addr, BLE_DEV_ADDR_LEN);
+            resolved = true;
+            break;
+        }
+    }
+
+#if MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE) > 0
+    entry = &ble_hs_resolv_cache[ble_hs_resolv_cache_next];
+    memcpy(entry->rpa, rpa, BLE_DEV_ADDR_LEN);
+    entry->id_addr = id_addr;
+    entry->used = 1;
+    entry->resolved = resolved;
+    ble_hs_resolv_cache_next = (ble_hs_resolv_cache_next + 1) %
+                               MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE);
+#endif
+
+    if (!resolved) {
+        return BLE_HS_ENOENT;
+    }
+
+    *out_id = id_addr;
+    return 0;
+}
+
 void ble_hs_resolv_init(void)
 {
     g_ble_hs_resolv_data.rpa_tmo = ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_RPA_TIMEOUT) * 1000);
+    ble_hs_resolv_cache_clear();
 
     ble_npl_callout_init(&g_ble_hs_resolv_data.rpa_timer,
                          ble_hs_evq_get(),
@@ -101,6 +101,9 @@ int ble_hs_resolv_set_rpa_tmo(uint16_t);
 /* Resolve a resolvable private address */
 int ble_hs_resolv_rpa(uint8_t *rpa, uint8_t *irk);
 
+/* Find the identity address of the peer that generated an RPA, cached */
+int ble_hs_resolv_id_from_rpa(const uint8_t *rpa, ble_addr_t *out_id);
+
 /* Initialize resolv*/
 void ble_hs_resolv_init(void);
 
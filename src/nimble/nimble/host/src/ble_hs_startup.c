@@ -23,24 +23,51 @@
 #include "nimble/nimble/host/include/host/ble_hs_hci.h"
 #include "ble_hs_priv.h"
 
+/**
+ * The commands of the startup sequence that do not depend on the results of
+ * each other, sent as one batch after the controller version is known.
+ */
+struct ble_hs_startup_batch {
+    struct ble_hs_hci_batch_cmd cmds[7];
+    int num_cmds;
+
+    struct ble_hci_cb_set_event_mask_cp evmask;
+    struct ble_hci_cb_set_event_mask2_cp evmask2;
+    struct ble_hci_le_set_event_mask_cp le_evmask;
 #if !MYNEWT_VAL(BLE_CONTROLLER)
-static int
-ble_hs_startup_read_sup_f_tx(void)
+    struct ble_hci_ip_rd_loc_supp_feat_rp sup_f;
+#endif
+    struct ble_hci_le_rd_buf_size_rp le_buf_sz;
+    struct ble_hci_le_rd_loc_supp_feat_rp le_sup_f;
+    struct ble_hci_ip_rd_bd_addr_rp bd_addr;
+};
+
+static void
+ble_hs_startup_batch_add(struct ble_hs_startup_batch *batch, uint16_t opcode,
+                         const void *cmd, uint8_t cmd_len,
+                         void *rsp, uint8_t rsp_len)
 {
-    struct ble_hci_ip_rd_loc_supp_feat_rp rsp;
-    int rc;
+    struct ble_hs_hci_batch_cmd *bcmd;
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
-                                      BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT),
-                           NULL, 0, &rsp, sizeof(rsp));
-    if (rc != 0) {
-        return rc;
-    }
+    BLE_HS_DBG_ASSERT(batch->num_cmds <
+                      (int)(sizeof(batch->cmds) / sizeof(batch->cmds[0])));
+
+    bcmd = &batch->cmds[batch->num_cmds++];
+    bcmd->opcode = opcode;
+    bcmd->cmd = cmd;
+    bcmd->cmd_len = cmd_len;
+    bcmd->rsp = rsp;
+    bcmd->rsp_len = rsp_len;
+}
 
+#if !MYNEWT_VAL(BLE_CONTROLLER)
+static int
+ble_hs_startup_check_sup_f(const struct ble_hci_ip_rd_loc_supp_feat_rp *rsp)
+{
     /* for now we don't use it outside of init sequence so check this here
      * LE Supported (Controller) byte 4, bit 6
      */
-    if (!(rsp.features & 0x0000006000000000)) {
+    if (!(rsp->features & 0x0000006000000000)) {
         BLE_HS_LOG(ERROR, "Controller doesn't support LE\n");
         return BLE_HS_ECONTROLLER;
     }
@@ -68,43 +95,6 @@ ble_hs_startup_read_local_ver_tx(void)
     return 0;
 }
 
-static int
-ble_hs_startup_le_read_sup_f_tx(void)
-{
-    struct ble_hci_le_rd_loc_supp_feat_rp rsp;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
-                           NULL,0, &rsp, sizeof(rsp));
-    if (rc != 0) {
-        return rc;
-    }
-
-    ble_hs_hci_set_le_supported_feat(le64toh(rsp.features));
-
-    return 0;
-}
-
-static int
-ble_hs_startup_le_read_buf_sz_tx(uint16_t *out_pktlen, uint8_t *out_max_pkts)
-{
-    struct ble_hci_le_rd_buf_size_rp rsp;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_RD_BUF_SIZE), NULL, 0,
-                           &rsp, sizeof(rsp));
-    if (rc != 0) {
-        return rc;
-    }
-
-    *out_pktlen = le16toh(rsp.data_len);
-    *out_max_pkts = rsp.data_packets;
-
-    return 0;
-}
-
 static int
 ble_hs_startup_read_buf_sz_tx(uint16_t *out_pktlen, uint16_t *out_max_pkts)
 {
@@ -125,18 +115,16 @@ ble_hs_startup_read_buf_sz_tx(uint16_t *out_pktlen, uint16_t *out_max_pkts)
 }
 
 static int
-ble_hs_startup_read_buf_sz(void)
+ble_hs_startup_read_buf_sz(const struct ble_hci_le_rd_buf_size_rp *le_rsp)
 {
-    uint16_t le_pktlen = 0;
+    uint16_t le_pktlen;
     uint16_t max_pkts = 0;
     uint16_t pktlen = 0;
-    uint8_t le_max_pkts = 0;
+    uint8_t le_max_pkts;
     int rc;
 
-    rc = ble_hs_startup_le_read_buf_sz_tx(&le_pktlen, &le_max_pkts);
-    if (rc != 0) {
-        return rc;
-    }
+    le_pktlen = le16toh(le_rsp->data_len);
+    le_max_pkts = le_rsp->data_packets;
 
     if (le_pktlen != 0) {
         pktlen = le_pktlen;
@@ -156,44 +144,40 @@ ble_hs_startup_read_buf_sz(void)
     return 0;
 }
 
-static int
-ble_hs_startup_read_bd_addr(void)
-{
-    struct ble_hci_ip_rd_bd_addr_rp rsp;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
-                                      BLE_HCI_OCF_IP_RD_BD_ADDR),
-                           NULL, 0, &rsp, sizeof(rsp));
-    if (rc != 0) {
-        return rc;
-    }
-
-    ble_hs_id_set_pub(rsp.addr);
-    return 0;
-}
-
-static int
-ble_hs_startup_le_set_evmask_tx(void)
+static void
+ble_hs_startup_le_set_evmask_add(struct ble_hs_startup_batch *batch)
 {
-    struct ble_hci_le_set_event_mask_cp cmd;
     uint8_t version;
     uint64_t mask;
-    int rc;
 
     version = ble_hs_hci_get_hci_version();
 
     /* TODO should we also check for supported commands when setting this? */
 
+    /**
+     * Only the LE events the roles and features built in handle are enabled,
+     * so the host task is not woken up for events it would discard.  The
+     * Data Length Change and Channel Selection Algorithm events have no
+     * handler and are never enabled.
+     */
+    mask = 0;
+
+#if NIMBLE_BLE_CONNECT
     /**
      * Enable the following LE events:
      *     0x0000000000000001 LE Connection Complete Event
-     *     0x0000000000000002 LE Advertising Report Event
      *     0x0000000000000004 LE Connection Update Complete Event
      *     0x0000000000000008 LE Read Remote Used Features Complete Event
+     */
+    mask |= 0x000000000000000d;
+
+#if MYNEWT_VAL(BLE_ROLE_PERIPHERAL)
+    /**
+     * Enable the following LE events:
      *     0x0000000000000010 LE Long Term Key Request Event
      */
-    mask = 0x000000000000001f;
+    mask |= 0x0000000000000010;
+#endif
 
     if (version >= BLE_HCI_VER_BCS_4_1) {
         /**
@@ -205,28 +189,72 @@ ble_hs_startup_le_set_evmask_tx(void)
     if (version >= BLE_HCI_VER_BCS_4_2) {
         /**
          * Enable the following LE events:
-         *   0x0000000000000040 LE Data Length Change Event
          *   0x0000000000000200 LE Enhanced Connection Complete Event
-         *   0x0000000000000400 LE Directed Advertising Report Event
          */
-        mask |= 0x0000000000000640;
+        mask |= 0x0000000000000200;
     }
 
     if (version >= BLE_HCI_VER_BCS_5_0) {
         /**
          * Enable the following LE events:
          *   0x0000000000000800 LE PHY Update Complete Event
+         */
+        mask |= 0x0000000000000800;
+    }
+#endif
+
+#if NIMBLE_BLE_SCAN
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    /* The extended scan commands report all advertisements, directed ones
+     * included, with extended advertising reports.
+     */
+    if (version >= BLE_HCI_VER_BCS_5_0) {
+        /**
+         * Enable the following LE events:
          *   0x0000000000001000 LE Extended Advertising Report Event
+         *   0x0000000000010000 LE Extended Scan Timeout Event
+         */
+        mask |= 0x0000000000011000;
+    }
+#else
+    /**
+     * Enable the following LE events:
+     *     0x0000000000000002 LE Advertising Report Event
+     */
+    mask |= 0x0000000000000002;
+
+    if (version >= BLE_HCI_VER_BCS_4_2) {
+        /**
+         * Enable the following LE events:
+         *   0x0000000000000400 LE Directed Advertising Report Event
+         */
+        mask |= 0x0000000000000400;
+    }
+#endif
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    if (version >= BLE_HCI_VER_BCS_5_0) {
+        /**
+         * Enable the following LE events:
          *   0x0000000000002000 LE Periodic Advertising Sync Established Event
          *   0x0000000000004000 LE Periodic Advertising Report Event
          *   0x0000000000008000 LE Periodic Advertising Sync Lost Event
-         *   0x0000000000010000 LE Extended Scan Timeout Event
+         */
+        mask |= 0x000000000000e000;
+    }
+#endif
+#endif
+
+#if NIMBLE_BLE_ADVERTISE && MYNEWT_VAL(BLE_EXT_ADV)
+    if (version >= BLE_HCI_VER_BCS_5_0) {
+        /**
+         * Enable the following LE events:
          *   0x0000000000020000 LE Extended Advertising Set Terminated Event
          *   0x0000000000040000 LE Scan Request Received Event
-         *   0x0000000000080000 LE Channel Selection Algorithm Event
          */
-        mask |= 0x00000000000ff800;
+        mask |= 0x0000000000060000;
     }
+#endif
 
 #if MYNEWT_VAL(BLE_PERIODIC_ADV_SYNC_TRANSFER)
     if (version >= BLE_HCI_VER_BCS_5_1) {
@@ -238,25 +266,18 @@ ble_hs_startup_le_set_evmask_tx(void)
     }
 #endif
 
-    cmd.event_mask = htole64(mask);
+    batch->le_evmask.event_mask = htole64(mask);
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_SET_EVENT_MASK),
-                           &cmd, sizeof(cmd), NULL, 0);
-    if (rc != 0) {
-        return rc;
-    }
-
-    return 0;
+    ble_hs_startup_batch_add(batch, BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                               BLE_HCI_OCF_LE_SET_EVENT_MASK),
+                             &batch->le_evmask, sizeof(batch->le_evmask),
+                             NULL, 0);
 }
 
-static int
-ble_hs_startup_set_evmask_tx(void)
+static void
+ble_hs_startup_set_evmask_add(struct ble_hs_startup_batch *batch)
 {
-    struct ble_hci_cb_set_event_mask_cp cmd;
-    struct ble_hci_cb_set_event_mask2_cp cmd2;
     uint8_t version;
-    int rc;
 
     version = ble_hs_hci_get_hci_version();
 
@@ -269,30 +290,25 @@ ble_hs_startup_set_evmask_tx(void)
      *     0x0000800000000000 Encryption Key Refresh Complete Event
      *     0x2000000000000000 LE Meta-Event
      */
-    cmd.event_mask = htole64(0x2000800002008090);
+    batch->evmask.event_mask = htole64(0x2000800002008090);
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                                      BLE_HCI_OCF_CB_SET_EVENT_MASK),
-                           &cmd, sizeof(cmd), NULL, 0);
-    if (rc != 0) {
-        return rc;
-    }
+    ble_hs_startup_batch_add(batch,
+                             BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
+                                        BLE_HCI_OCF_CB_SET_EVENT_MASK),
+                             &batch->evmask, sizeof(batch->evmask), NULL, 0);
 
     if (version >= BLE_HCI_VER_BCS_4_1) {
         /**
          * Enable the following events:
          *     0x0000000000800000 Authenticated Payload Timeout Event
          */
-        cmd2.event_mask2 = htole64(0x0000000000800000);
-        rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                                          BLE_HCI_OCF_CB_SET_EVENT_MASK2),
-                               &cmd2, sizeof(cmd2), NULL, 0);
-        if (rc != 0) {
-            return rc;
-        }
+        batch->evmask2.event_mask2 = htole64(0x0000000000800000);
+        ble_hs_startup_batch_add(batch,
+                                 BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
+                                            BLE_HCI_OCF_CB_SET_EVENT_MASK2),
+                                 &batch->evmask2, sizeof(batch->evmask2),
+                                 NULL, 0);
     }
-
-    return 0;
 }
 
 static int
@@ -306,6 +322,7 @@ ble_hs_startup_reset_tx(void)
 int
 ble_hs_startup_go(void)
 {
+    struct ble_hs_startup_batch batch;
     int rc;
 
     rc = ble_hs_startup_reset_tx();
@@ -326,38 +343,58 @@ ble_hs_startup_go(void)
         BLE_HS_LOG(ERROR, "Required controller version is 4.0 (6)\n");
         return BLE_HS_ECONTROLLER;
     }
-
-    rc = ble_hs_startup_read_sup_f_tx();
-    if (rc != 0) {
-        return rc;
-    }
 #endif
 
-    rc = ble_hs_startup_set_evmask_tx();
-    if (rc != 0) {
-        return rc;
-    }
+    /* The rest of the sequence only depends on the version, send it without
+     * waiting for each Command Complete while the controller has credits.
+     */
+    memset(&batch, 0, sizeof(batch));
 
-    rc = ble_hs_startup_le_set_evmask_tx();
-    if (rc != 0) {
-        return rc;
-    }
+#if !MYNEWT_VAL(BLE_CONTROLLER)
+    ble_hs_startup_batch_add(&batch,
+                             BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                        BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT),
+                             NULL, 0, &batch.sup_f, sizeof(batch.sup_f));
+#endif
 
-    rc = ble_hs_startup_read_buf_sz();
+    ble_hs_startup_set_evmask_add(&batch);
+    ble_hs_startup_le_set_evmask_add(&batch);
+
+    ble_hs_startup_batch_add(&batch,
+                             BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                        BLE_HCI_OCF_LE_RD_BUF_SIZE),
+                             NULL, 0, &batch.le_buf_sz,
+                             sizeof(batch.le_buf_sz));
+    ble_hs_startup_batch_add(&batch,
+                             BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                        BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
+                             NULL, 0, &batch.le_sup_f,
+                             sizeof(batch.le_sup_f));
+    ble_hs_startup_batch_add(&batch,
+                             BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                        BLE_HCI_OCF_IP_RD_BD_ADDR),
+                             NULL, 0, &batch.bd_addr, sizeof(batch.bd_addr));
+
+    rc = ble_hs_hci_cmd_tx_batch(batch.cmds, batch.num_cmds);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_hs_startup_le_read_sup_f_tx();
+#if !MYNEWT_VAL(BLE_CONTROLLER)
+    rc = ble_hs_startup_check_sup_f(&batch.sup_f);
     if (rc != 0) {
         return rc;
     }
+#endif
 
-    rc = ble_hs_startup_read_bd_addr();
+    rc = ble_hs_startup_read_buf_sz(&batch.le_buf_sz);
     if (rc != 0) {
         return rc;
     }
 
+    ble_hs_hci_set_le_supported_feat(le64toh(batch.le_sup_f.features));
+    ble_hs_id_set_pub(batch.bd_addr.addr);
+
     ble_hs_pvcy_set_our_irk(NULL);
 
     /* If flow control is enabled, configure the controller to use it. */
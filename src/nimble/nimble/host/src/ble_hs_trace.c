@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+
+#if MYNEWT_VAL(BLE_HS_TRACE_SIZE) > 0
+
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+#include "nimble/nimble/host/include/host/ble_hs_trace.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include "nimble/porting/nimble/include/os/os_cputime.h"
+#endif
+
+static struct ble_hs_trace_entry ble_hs_trace_ring[MYNEWT_VAL(BLE_HS_TRACE_SIZE)];
+static uint32_t ble_hs_trace_total;
+
+static uint32_t
+ble_hs_trace_time_us(void)
+{
+#ifdef ESP_PLATFORM
+    return (uint32_t)esp_timer_get_time();
+#else
+    return os_cputime_ticks_to_usecs(os_cputime_get32());
+#endif
+}
+
+void
+ble_hs_trace_record(uint8_t type, uint8_t code, uint16_t conn_handle,
+                    uint16_t attr_handle, uint16_t len, int rc)
+{
+    struct ble_hs_trace_entry *entry;
+    uint32_t time_us;
+    uint32_t ctx;
+
+    time_us = ble_hs_trace_time_us();
+
+    if (rc > INT16_MAX) {
+        rc = INT16_MAX;
+    } else if (rc < INT16_MIN) {
+        rc = INT16_MIN;
+    }
+
+    ctx = ble_npl_hw_enter_critical();
+
+    entry = &ble_hs_trace_ring[ble_hs_trace_total %
+                               MYNEWT_VAL(BLE_HS_TRACE_SIZE)];
+    ble_hs_trace_total++;
+
+    entry->time_us = time_us;
+    entry->conn_handle = conn_handle;
+    entry->attr_handle = attr_handle;
+    entry->len = len;
+    entry->rc = rc;
+    entry->type = type;
+    entry->code = code;
+
+    ble_npl_hw_exit_critical(ctx);
+}
+
+int
+ble_hs_trace_read(struct ble_hs_trace_entry *entries, int max_entries)
+{
+    uint32_t count;
+    uint32_t first;
+    uint32_t ctx;
+    uint32_t i;
+
+    if (entries == NULL || max_entries <= 0) {
+        return 0;
+    }
+
+    ctx = ble_npl_hw_enter_critical();
+
+    count = ble_hs_trace_total;
+    if (count > MYNEWT_VAL(BLE_HS_TRACE_SIZE)) {
+        count = MYNEWT_VAL(BLE_HS_TRACE_SIZE);
+    }
+    if (count > (uint32_t)max_entries) {
+        count = max_entries;
+    }
+
+    /* Return the most recent entries when the buffer is too small. */
+    first = ble_hs_trace_total - count;
+    for (i = 0; i < count; i++) {
+        entries[i] = ble_hs_trace_ring[(first + i) %
+                                       MYNEWT_VAL(BLE_HS_TRACE_SIZE)];
+    }
+
+    ble_npl_hw_exit_critical(ctx);
+
+    return count;
+}
+
+uint32_t
+ble_hs_trace_count(void)
+{
+    return ble_hs_trace_total;
+}
+
+void
+ble_hs_trace_clear(void)
+{
+    uint32_t ctx;
+
+    ctx = ble_npl_hw_enter_critical();
+    ble_hs_trace_total = 0;
+    memset(ble_hs_trace_ring, 0, sizeof(ble_hs_trace_ring));
+    ble_npl_hw_exit_critical(ctx);
+}
+
+#endif
@@ -450,6 +450,8 @@ ble_l2cap_tx(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
         return BLE_HS_ENOMEM;
     }
 
+    ble_hs_conn_tx_accepted(txom);
+
     rc = ble_hs_hci_acl_tx(conn, &txom);
     switch (rc) {
     case 0:
@@ -457,8 +459,10 @@ ble_l2cap_tx(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
         return 0;
 
     case BLE_HS_EAGAIN:
-        /* Controller could not accommodate full packet.  Enqueue remainder. */
-        STAILQ_INSERT_TAIL(&conn->bhc_tx_q, OS_MBUF_PKTHDR(txom), omp_next);
+        /* Controller could not accommodate full packet.  Enqueue remainder
+         * by transmit priority class.
+         */
+        ble_hs_conn_tx_enqueue(conn, txom);
         return 0;
 
     default:
@@ -453,8 +453,11 @@ ble_l2cap_coc_continue_tx(struct ble_l2cap_chan *chan)
          * that for first packet we need to decrease data size by 2 bytes for sdu
          * size
          */
-        rc = os_mbuf_appendfrom(txom, tx->sdu, tx->data_offset,
-                                len - sdu_size_offset);
+        rc = os_mbuf_cursor_seek(&tx->sdu_cursor, tx->data_offset);
+        if (rc == 0) {
+            rc = os_mbuf_cursor_appendto(&tx->sdu_cursor, txom,
+                                         len - sdu_size_offset);
+        }
         if (rc) {
             rc = BLE_HS_ENOMEM;
             BLE_HS_LOG(DEBUG, "Could not append data rc=%d", rc);
@@ -610,6 +613,7 @@ ble_l2cap_coc_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx)
         return BLE_HS_EBUSY;
     }
     tx->sdu = sdu_tx;
+    os_mbuf_cursor_init(&tx->sdu_cursor, sdu_tx);
 
 
     /* leave the host locked on purpose when ble_l2cap_coc_continue_tx() */
@@ -39,6 +39,8 @@ struct ble_l2cap_chan;
 
 struct ble_l2cap_coc_endpoint {
     struct os_mbuf *sdu;
+    /* Read position of the next TX fragment in sdu. */
+    struct os_mbuf_cursor sdu_cursor;
     uint16_t mtu;
     uint16_t credits;
     uint16_t data_offset;
@@ -21,27 +21,70 @@
 
 #if BLE_MONITOR
 
-#if MYNEWT_VAL(BLE_MONITOR_UART) && MYNEWT_VAL(BLE_MONITOR_RTT)
-#error "Cannot enable monitor over UART and RTT at the same time!"
+#if (MYNEWT_VAL(BLE_MONITOR_UART) + MYNEWT_VAL(BLE_MONITOR_RTT) + \
+     MYNEWT_VAL(BLE_MONITOR_RAM)) > 1
+#error "Cannot enable more than one of monitor over UART, RTT and RAM!"
 #endif
 
+/*
+ * Outside of Mynewt the UART packets are queued in a ring drained by a task,
+ * a packet that does not fit is dropped instead of blocking the host.
+ */
+#if MYNEWT_VAL(BLE_MONITOR_UART) && defined(ESP_PLATFORM)
+#define MONITOR_UART_TASK 1
+#else
+#define MONITOR_UART_TASK 0
+#endif
+
+#define MONITOR_DROPS ((MYNEWT_VAL(BLE_MONITOR_RTT) && \
+                        MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)) || \
+                       MONITOR_UART_TASK)
+
 #include <stdarg.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include "nimble/porting/nimble/include/os/os.h"
 #include "nimble/porting/nimble/include/log/log.h"
-#if MYNEWT_VAL(BLE_MONITOR_UART)
+#if MONITOR_UART_TASK
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#elif MYNEWT_VAL(BLE_MONITOR_UART)
 #include "nimble/porting/nimble/include/uart/uart.h"
 #endif
 #if MYNEWT_VAL(BLE_MONITOR_RTT)
+#if defined(__has_include) && !__has_include("rtt/SEGGER_RTT.h")
+/* Arduino cores bundle RTT without the Mynewt directory. */
+#include "SEGGER_RTT.h"
+#else
 #include "rtt/SEGGER_RTT.h"
 #endif
+#endif
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#elif !defined(MYNEWT)
+#include "nimble/porting/nimble/include/os/os_cputime.h"
+#endif
 #include "ble_hs_priv.h"
 #include "ble_monitor_priv.h"
 
 struct ble_npl_mutex lock;
 
-#if MYNEWT_VAL(BLE_MONITOR_UART)
+#if MONITOR_UART_TASK
+static uint8_t tx_ringbuf[MYNEWT_VAL(BLE_MONITOR_UART_BUFFER_SIZE)];
+static struct {
+    /* The end of the last whole packet, written by the host side. */
+    volatile size_t head;
+    /* The next byte to send, written by the drain task. */
+    volatile size_t tail;
+    /* Write position and bytes left of the packet being queued. */
+    size_t pos;
+    size_t left;
+    bool discard;
+    bool with_drops;
+    TaskHandle_t task;
+} uart_tx;
+#elif MYNEWT_VAL(BLE_MONITOR_UART)
 struct uart_dev *uart;
 
 static uint8_t tx_ringbuf[MYNEWT_VAL(BLE_MONITOR_UART_BUFFER_SIZE)];
@@ -55,16 +98,44 @@ static int rtt_index;
 #if MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
 static uint8_t rtt_pktbuf[MYNEWT_VAL(BLE_MONITOR_RTT_BUFFER_SIZE)];
 static size_t rtt_pktbuf_pos;
+#endif
+#endif
+
+#if MONITOR_DROPS
 static struct {
     bool dropped;
     struct ble_npl_callout tmo;
     struct ble_monitor_drops_hdr drops_hdr;
-} rtt_drops;
+} drops;
+#endif
 
+#if MYNEWT_VAL(BLE_MONITOR_RAM)
+static uint8_t ram_buf[MYNEWT_VAL(BLE_MONITOR_RAM_BUFFER_SIZE)];
+static struct {
+    /* Oldest record, next write and bytes used in ram_buf. */
+    size_t tail;
+    size_t head;
+    size_t used;
+    /* Bytes left of a packet that is not recorded. */
+    size_t discard;
+    uint32_t dropped;
+    bool paused;
+} ram;
 #endif
+
+static int64_t
+monitor_time_usec(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#elif defined(MYNEWT)
+    return os_get_uptime_usec();
+#else
+    return os_cputime_ticks_to_usecs(os_cputime_get32());
 #endif
+}
 
-#if MYNEWT_VAL(BLE_MONITOR_UART)
+#if MYNEWT_VAL(BLE_MONITOR_UART) && !MONITOR_UART_TASK
 static inline int
 inc_and_wrap(int i, int max)
 {
@@ -130,54 +201,131 @@ monitor_write(const void *buf, size_t len)
 }
 #endif
 
-#if MYNEWT_VAL(BLE_MONITOR_RTT)
-
-#if MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
+#if MONITOR_DROPS
 static void
-update_drop_counters(struct ble_monitor_hdr *failed_hdr)
+update_drop_counters(uint16_t opcode)
 {
     uint8_t *cnt;
 
-    rtt_drops.dropped = true;
+    drops.dropped = true;
 
-    switch (failed_hdr->opcode) {
+    switch (opcode) {
     case BLE_MONITOR_OPCODE_COMMAND_PKT:
-        cnt = &rtt_drops.drops_hdr.cmd;
+        cnt = &drops.drops_hdr.cmd;
         break;
     case BLE_MONITOR_OPCODE_EVENT_PKT:
-        cnt = &rtt_drops.drops_hdr.evt;
+        cnt = &drops.drops_hdr.evt;
         break;
     case BLE_MONITOR_OPCODE_ACL_TX_PKT:
-        cnt = &rtt_drops.drops_hdr.acl_tx;
+        cnt = &drops.drops_hdr.acl_tx;
         break;
     case BLE_MONITOR_OPCODE_ACL_RX_PKT:
-        cnt = &rtt_drops.drops_hdr.acl_rx;
+        cnt = &drops.drops_hdr.acl_rx;
         break;
     default:
-        cnt = &rtt_drops.drops_hdr.other;
+        cnt = &drops.drops_hdr.other;
         break;
     }
 
     if (*cnt < UINT8_MAX) {
         (*cnt)++;
-        ble_npl_callout_reset(&rtt_drops.tmo, OS_TICKS_PER_SEC);
+        ble_npl_callout_reset(&drops.tmo, ble_npl_time_ms_to_ticks32(1000));
     }
 }
 
 static void
 reset_drop_counters(void)
 {
-    rtt_drops.dropped = false;
-    rtt_drops.drops_hdr.cmd = 0;
-    rtt_drops.drops_hdr.evt = 0;
-    rtt_drops.drops_hdr.acl_tx = 0;
-    rtt_drops.drops_hdr.acl_rx = 0;
-    rtt_drops.drops_hdr.other = 0;
-
-    ble_npl_callout_stop(&rtt_drops.tmo);
+    drops.dropped = false;
+    drops.drops_hdr.cmd = 0;
+    drops.drops_hdr.evt = 0;
+    drops.drops_hdr.acl_tx = 0;
+    drops.drops_hdr.acl_rx = 0;
+    drops.drops_hdr.other = 0;
+
+    ble_npl_callout_stop(&drops.tmo);
+}
+#endif
+
+#if MONITOR_UART_TASK
+static size_t
+monitor_uart_free(void)
+{
+    size_t used;
+
+    used = (uart_tx.pos + sizeof(tx_ringbuf) - uart_tx.tail) %
+           sizeof(tx_ringbuf);
+
+    /* One byte stays free to tell a full ring from an empty one. */
+    return sizeof(tx_ringbuf) - 1 - used;
+}
+
+static void
+monitor_uart_task(void *arg)
+{
+    size_t head;
+    size_t tail;
+    size_t len;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while ((head = uart_tx.head) != (tail = uart_tx.tail)) {
+            len = head > tail ? head - tail : sizeof(tx_ringbuf) - tail;
+
+            /* Blocks this task only, the driver feeds the FIFO from its ISR. */
+            uart_write_bytes(MYNEWT_VAL(BLE_MONITOR_UART_PORT),
+                             (const char *)tx_ringbuf + tail, len);
+            uart_tx.tail = (tail + len) % sizeof(tx_ringbuf);
+        }
+    }
+}
+
+/**
+ * Starts queueing a packet of the given total length, it is dropped if the
+ * ring does not have room for all of it.
+ */
+static void
+monitor_uart_start(uint16_t opcode, size_t len, bool with_drops)
+{
+    uart_tx.left = len;
+    uart_tx.with_drops = with_drops;
+    uart_tx.discard = len > monitor_uart_free();
+
+    if (uart_tx.discard) {
+        update_drop_counters(opcode);
+    }
+}
+
+static void
+monitor_write(const void *buf, size_t len)
+{
+    size_t first;
+
+    uart_tx.left -= min(len, uart_tx.left);
+
+    if (!uart_tx.discard) {
+        first = min(len, sizeof(tx_ringbuf) - uart_tx.pos);
+        memcpy(tx_ringbuf + uart_tx.pos, buf, first);
+        memcpy(tx_ringbuf, (const uint8_t *)buf + first, len - first);
+        uart_tx.pos = (uart_tx.pos + len) % sizeof(tx_ringbuf);
+    }
+
+    if (uart_tx.left > 0 || uart_tx.discard) {
+        return;
+    }
+
+    /* The drop counters were sent with this packet. */
+    if (uart_tx.with_drops) {
+        reset_drop_counters();
+    }
+
+    uart_tx.head = uart_tx.pos;
+    xTaskNotifyGive(uart_tx.task);
 }
 #endif
 
+#if MYNEWT_VAL(BLE_MONITOR_RTT)
 static void
 monitor_write(const void *buf, size_t len)
 {
@@ -205,7 +353,7 @@ monitor_write(const void *buf, size_t len)
     if (ret > 0) {
         reset_drop_counters();
     } else {
-        update_drop_counters(hdr);
+        update_drop_counters(hdr->opcode);
     }
 
     rtt_pktbuf_pos = 0;
@@ -215,6 +363,65 @@ monitor_write(const void *buf, size_t len)
 }
 #endif
 
+#if MYNEWT_VAL(BLE_MONITOR_RAM)
+static void
+monitor_ram_peek(size_t pos, void *dst, size_t len)
+{
+    size_t first;
+
+    first = min(len, sizeof(ram_buf) - pos);
+    memcpy(dst, ram_buf + pos, first);
+    memcpy((uint8_t *)dst + first, ram_buf, len - first);
+}
+
+/**
+ * Makes room for a packet of the given total length, overwriting the oldest
+ * packets.  A packet that cannot be recorded is discarded as it is written.
+ */
+static void
+monitor_ram_reserve(size_t len)
+{
+    uint16_t data_len;
+
+    if (ram.paused) {
+        ram.discard = len;
+        return;
+    }
+
+    if (len > sizeof(ram_buf)) {
+        ram.discard = len;
+        ram.dropped++;
+        return;
+    }
+
+    while (sizeof(ram_buf) - ram.used < len) {
+        monitor_ram_peek(ram.tail, &data_len, sizeof(data_len));
+        data_len = le16toh(data_len) + sizeof(data_len);
+        ram.tail = (ram.tail + data_len) % sizeof(ram_buf);
+        ram.used -= data_len;
+        ram.dropped++;
+    }
+}
+
+static void
+monitor_write(const void *buf, size_t len)
+{
+    size_t first;
+
+    if (ram.discard > 0) {
+        ram.discard -= min(len, ram.discard);
+        return;
+    }
+
+    first = min(len, sizeof(ram_buf) - ram.head);
+    memcpy(ram_buf + ram.head, buf, first);
+    memcpy(ram_buf, (const uint8_t *)buf + first, len - first);
+
+    ram.head = (ram.head + len) % sizeof(ram_buf);
+    ram.used += len;
+}
+#endif
+
 static void
 monitor_write_header(uint16_t opcode, uint16_t len)
 {
@@ -224,9 +431,9 @@ monitor_write_header(uint16_t opcode, uint16_t len)
     int64_t ts;
 
     hdr_len = sizeof(ts_hdr);
-#if MYNEWT_VAL(BLE_MONITOR_RTT) && MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
-    if (rtt_drops.dropped) {
-        hdr_len += sizeof(rtt_drops.drops_hdr);
+#if MONITOR_DROPS
+    if (drops.dropped) {
+        hdr_len += sizeof(drops.drops_hdr);
     }
 #endif
 
@@ -236,7 +443,15 @@ monitor_write_header(uint16_t opcode, uint16_t len)
     hdr.flags    = 0;
 
     /* Use uptime for timestamp */
-    ts = os_get_uptime_usec();
+    ts = monitor_time_usec();
+
+#if MYNEWT_VAL(BLE_MONITOR_RAM)
+    monitor_ram_reserve(sizeof(hdr) + hdr_len + len);
+#endif
+#if MONITOR_UART_TASK
+    monitor_uart_start(opcode, sizeof(hdr) + hdr_len + len,
+                       hdr_len > sizeof(ts_hdr));
+#endif
 
     /*
      * btsnoop specification states that fields of extended header must be
@@ -246,9 +461,9 @@ monitor_write_header(uint16_t opcode, uint16_t len)
 
     monitor_write(&hdr, sizeof(hdr));
 
-#if MYNEWT_VAL(BLE_MONITOR_RTT) && MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
-    if (rtt_drops.dropped) {
-        monitor_write(&rtt_drops.drops_hdr, sizeof(rtt_drops.drops_hdr));
+#if MONITOR_DROPS
+    if (drops.dropped) {
+        monitor_write(&drops.drops_hdr, sizeof(drops.drops_hdr));
     }
 #endif
 
@@ -258,6 +473,7 @@ monitor_write_header(uint16_t opcode, uint16_t len)
     monitor_write(&ts_hdr, sizeof(ts_hdr));
 }
 
+#ifdef MYNEWT
 static size_t
 btmon_write(FILE *instance, const char *bp, size_t n)
 {
@@ -271,12 +487,13 @@ static FILE *btmon = (FILE *) &(struct File) {
         .write = btmon_write,
     },
 };
+#endif
 
-#if MYNEWT_VAL(BLE_MONITOR_RTT) && MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
+#if MONITOR_DROPS
 static void
 drops_tmp_cb(struct ble_npl_event *ev)
 {
-    ble_npl_mutex_pend(&lock, OS_TIMEOUT_NEVER);
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
 
     /*
      * There's no "nop" in btsnoop protocol so we just send empty system note
@@ -293,7 +510,33 @@ drops_tmp_cb(struct ble_npl_event *ev)
 int
 ble_monitor_init(void)
 {
-#if MYNEWT_VAL(BLE_MONITOR_UART)
+#if MONITOR_UART_TASK
+    uart_config_t uc = {
+        .baud_rate = MYNEWT_VAL(BLE_MONITOR_UART_BAUDRATE),
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+    };
+    BaseType_t ret;
+
+    /* The driver needs a receive buffer larger than the FIFO. */
+    if (uart_driver_install(MYNEWT_VAL(BLE_MONITOR_UART_PORT),
+                            UART_FIFO_LEN + 1, 0, 0, NULL, 0) != ESP_OK ||
+        uart_param_config(MYNEWT_VAL(BLE_MONITOR_UART_PORT), &uc) != ESP_OK ||
+        uart_set_pin(MYNEWT_VAL(BLE_MONITOR_UART_PORT),
+                     MYNEWT_VAL(BLE_MONITOR_UART_TX_PIN), UART_PIN_NO_CHANGE,
+                     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        return -1;
+    }
+
+    ret = xTaskCreate(monitor_uart_task, "ble_monitor", 2048, NULL,
+                      tskIDLE_PRIORITY + 1, &uart_tx.task);
+    if (ret != pdPASS) {
+        uart_driver_delete(MYNEWT_VAL(BLE_MONITOR_UART_PORT));
+        return -1;
+    }
+#elif MYNEWT_VAL(BLE_MONITOR_UART)
     struct uart_conf uc = {
         .uc_speed = MYNEWT_VAL(BLE_MONITOR_UART_BAUDRATE),
         .uc_databits = 8,
@@ -312,17 +555,19 @@ ble_monitor_init(void)
     }
 #endif
 
-#if MYNEWT_VAL(BLE_MONITOR_RTT)
-#if MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
-    ble_npl_callout_init(&rtt_drops.tmo, ble_hs_evq_get(), drops_tmp_cb, NULL);
+#if MONITOR_DROPS
+    ble_npl_callout_init(&drops.tmo, ble_hs_evq_get(), drops_tmp_cb, NULL);
 
     /* Initialize types in header (we won't touch them later) */
-    rtt_drops.drops_hdr.type_cmd = BLE_MONITOR_EXTHDR_COMMAND_DROPS;
-    rtt_drops.drops_hdr.type_evt = BLE_MONITOR_EXTHDR_EVENT_DROPS;
-    rtt_drops.drops_hdr.type_acl_tx = BLE_MONITOR_EXTHDR_ACL_TX_DROPS;
-    rtt_drops.drops_hdr.type_acl_rx = BLE_MONITOR_EXTHDR_ACL_RX_DROPS;
-    rtt_drops.drops_hdr.type_other = BLE_MONITOR_EXTHDR_OTHER_DROPS;
+    drops.drops_hdr.type_cmd = BLE_MONITOR_EXTHDR_COMMAND_DROPS;
+    drops.drops_hdr.type_evt = BLE_MONITOR_EXTHDR_EVENT_DROPS;
+    drops.drops_hdr.type_acl_tx = BLE_MONITOR_EXTHDR_ACL_TX_DROPS;
+    drops.drops_hdr.type_acl_rx = BLE_MONITOR_EXTHDR_ACL_RX_DROPS;
+    drops.drops_hdr.type_other = BLE_MONITOR_EXTHDR_OTHER_DROPS;
+#endif
 
+#if MYNEWT_VAL(BLE_MONITOR_RTT)
+#if MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
     rtt_index = SEGGER_RTT_AllocUpBuffer(MYNEWT_VAL(BLE_MONITOR_RTT_BUFFER_NAME),
                                          rtt_buf, sizeof(rtt_buf),
                                          SEGGER_RTT_MODE_NO_BLOCK_SKIP);
@@ -345,8 +590,15 @@ ble_monitor_init(void)
 void
 ble_monitor_deinit(void)
 {
-#if MYNEWT_VAL(BLE_MONITOR_RTT) && MYNEWT_VAL(BLE_MONITOR_RTT_BUFFERED)
-    ble_npl_callout_deinit(&rtt_drops.tmo);
+#if MONITOR_UART_TASK
+    vTaskDelete(uart_tx.task);
+    uart_driver_delete(MYNEWT_VAL(BLE_MONITOR_UART_PORT));
+    uart_tx.head = 0;
+    uart_tx.tail = 0;
+    uart_tx.pos = 0;
+#endif
+#if MONITOR_DROPS
+    ble_npl_callout_deinit(&drops.tmo);
 #endif
     ble_npl_mutex_deinit(&lock);
 }
@@ -354,7 +606,7 @@ ble_monitor_deinit(void)
 int
 ble_monitor_send(uint16_t opcode, const void *data, size_t len)
 {
-    ble_npl_mutex_pend(&lock, OS_TIMEOUT_NEVER);
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
 
     monitor_write_header(opcode, len);
     monitor_write(data, len);
@@ -376,7 +628,7 @@ ble_monitor_send_om(uint16_t opcode, const struct os_mbuf *om)
         om_tmp = SLIST_NEXT(om_tmp, om_next);
     }
 
-    ble_npl_mutex_pend(&lock, OS_TIMEOUT_NEVER);
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
 
     monitor_write_header(opcode, length);
 
@@ -414,9 +666,22 @@ ble_monitor_log(int level, const char *fmt, ...)
     va_list va;
     int len;
 
+#ifndef MYNEWT
+    char msg[MYNEWT_VAL(BLE_MONITOR_CONSOLE_BUFFER_SIZE)];
+
+    /* No custom stream outside of Mynewt, the message is truncated instead. */
+    va_start(va, fmt);
+    len = vsnprintf(msg, sizeof(msg), fmt, va);
+    va_end(va);
+    if (len < 0) {
+        return len;
+    }
+    len = min(len, (int)sizeof(msg) - 1);
+#else
     va_start(va, fmt);
     len = vsnprintf(NULL, 0, fmt, va);
     va_end(va);
+#endif
 
     switch (level) {
     case LOG_LEVEL_ERROR:
@@ -438,16 +703,20 @@ ble_monitor_log(int level, const char *fmt, ...)
 
     ulog.ident_len = sizeof(id);
 
-    ble_npl_mutex_pend(&lock, OS_TIMEOUT_NEVER);
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
 
     monitor_write_header(BLE_MONITOR_OPCODE_USER_LOGGING,
                          sizeof(ulog) + sizeof(id) + len + 1);
     monitor_write(&ulog, sizeof(ulog));
     monitor_write(id, sizeof(id));
 
+#ifndef MYNEWT
+    monitor_write(msg, len);
+#else
     va_start(va, fmt);
     vfprintf(btmon, fmt, va);
     va_end(va);
+#endif
 
     /* null-terminate string */
     monitor_write("", 1);
@@ -479,4 +748,111 @@ ble_monitor_out(int c)
     return c;
 }
 
+#if MYNEWT_VAL(BLE_MONITOR_RAM)
+int
+ble_monitor_ram_export(ble_monitor_write_fn *cb, void *arg)
+{
+    struct ble_monitor_btsnoop_hdr file_hdr;
+    struct ble_monitor_btsnoop_rec rec;
+    struct ble_monitor_hdr hdr;
+    uint8_t ext_hdr[UINT8_MAX];
+    uint32_t ts32;
+    size_t payload_len;
+    size_t first;
+    size_t used;
+    size_t pos;
+    int rc;
+    int i;
+
+    memcpy(file_hdr.magic, BLE_MONITOR_BTSNOOP_MAGIC,
+           sizeof(file_hdr.magic));
+    put_be32(&file_hdr.version, BLE_MONITOR_BTSNOOP_VERSION);
+    put_be32(&file_hdr.datalink, BLE_MONITOR_BTSNOOP_MONITOR);
+
+    rc = cb(&file_hdr, sizeof(file_hdr), arg);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
+
+    pos = ram.tail;
+    used = ram.used;
+    while (used > 0) {
+        monitor_ram_peek(pos, &hdr, sizeof(hdr));
+        pos = (pos + sizeof(hdr)) % sizeof(ram_buf);
+        monitor_ram_peek(pos, ext_hdr, hdr.hdr_len);
+        pos = (pos + hdr.hdr_len) % sizeof(ram_buf);
+
+        /* Skip the drop counters, each a type and a count byte. */
+        ts32 = 0;
+        for (i = 0; i < hdr.hdr_len; ) {
+            if (ext_hdr[i] == BLE_MONITOR_EXTHDR_TS32) {
+                ts32 = get_le32(&ext_hdr[i + 1]);
+                break;
+            }
+            i += 2;
+        }
+
+        payload_len = le16toh(hdr.data_len) - 4 - hdr.hdr_len;
+        used -= sizeof(hdr) + hdr.hdr_len + payload_len;
+
+        put_be32(&rec.orig_len, payload_len);
+        put_be32(&rec.incl_len, payload_len);
+        put_be32(&rec.flags, le16toh(hdr.opcode));
+        put_be32(&rec.drops, 0);
+        put_be64(&rec.ts, BLE_MONITOR_BTSNOOP_EPOCH_DELTA +
+                          (uint64_t)ts32 * 100);
+
+        rc = cb(&rec, sizeof(rec), arg);
+        if (rc != 0) {
+            break;
+        }
+
+        first = min(payload_len, sizeof(ram_buf) - pos);
+        if (first > 0) {
+            rc = cb(ram_buf + pos, first, arg);
+        }
+        if (rc == 0 && payload_len > first) {
+            rc = cb(ram_buf, payload_len - first, arg);
+        }
+        if (rc != 0) {
+            break;
+        }
+        pos = (pos + payload_len) % sizeof(ram_buf);
+    }
+
+    ble_npl_mutex_release(&lock);
+
+    return rc;
+}
+
+void
+ble_monitor_ram_clear(void)
+{
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
+
+    ram.tail = 0;
+    ram.head = 0;
+    ram.used = 0;
+    ram.dropped = 0;
+
+    ble_npl_mutex_release(&lock);
+}
+
+void
+ble_monitor_ram_pause(int paused)
+{
+    ble_npl_mutex_pend(&lock, BLE_NPL_TIME_FOREVER);
+    ram.paused = paused;
+    ble_npl_mutex_release(&lock);
+}
+
+uint32_t
+ble_monitor_ram_dropped(void)
+{
+    return ram.dropped;
+}
+#endif
+
 #endif
@@ -48,6 +48,28 @@ extern "C" {
 #define BLE_MONITOR_EXTHDR_OTHER_DROPS      7
 #define BLE_MONITOR_EXTHDR_TS32             8
 
+/* btsnoop file format, with the Linux monitor datalink. */
+#define BLE_MONITOR_BTSNOOP_MAGIC       "btsnoop"
+#define BLE_MONITOR_BTSNOOP_VERSION     1
+#define BLE_MONITOR_BTSNOOP_MONITOR     2001
+/* Microseconds from year 0 to 1970, the btsnoop timestamp epoch. */
+#define BLE_MONITOR_BTSNOOP_EPOCH_DELTA 0x00E03AB44A676000ULL
+
+struct ble_monitor_btsnoop_hdr {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  datalink;
+} __attribute__((packed));
+
+/* All fields are big endian, the flags hold the index and the opcode. */
+struct ble_monitor_btsnoop_rec {
+    uint32_t  orig_len;
+    uint32_t  incl_len;
+    uint32_t  flags;
+    uint32_t  drops;
+    uint64_t  ts;
+} __attribute__((packed));
+
 struct ble_monitor_hdr {
     uint16_t  data_len;
     uint16_t  opcode;
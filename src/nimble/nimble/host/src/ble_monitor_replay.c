@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+
+#if MYNEWT_VAL(BLE_MONITOR_REPLAY)
+
+#include "nimble/nimble/include/nimble/ble_hci_trans.h"
+#include "nimble/nimble/host/include/host/ble_monitor.h"
+#include "ble_hs_priv.h"
+#include "ble_monitor_priv.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include "nimble/porting/nimble/include/os/os_cputime.h"
+#endif
+
+static struct {
+    const uint8_t *data;
+    size_t len;
+    struct ble_monitor_replay_stats *stats;
+    struct ble_npl_event ev;
+    struct ble_npl_sem done;
+} ble_monitor_replay_ctx;
+
+static uint32_t
+ble_monitor_replay_time_us(void)
+{
+#ifdef ESP_PLATFORM
+    return (uint32_t)esp_timer_get_time();
+#else
+    return os_cputime_ticks_to_usecs(os_cputime_get32());
+#endif
+}
+
+static void
+ble_monitor_replay_account(uint32_t start, uint32_t *total, uint32_t *max)
+{
+    uint32_t us;
+
+    us = ble_monitor_replay_time_us() - start;
+    *total += us;
+    if (us > *max) {
+        *max = us;
+    }
+}
+
+static void
+ble_monitor_replay_event(const uint8_t *pkt, size_t len,
+                         struct ble_monitor_replay_stats *stats)
+{
+    uint8_t *buf;
+    uint32_t start;
+
+    if (len < sizeof(struct ble_hci_ev) ||
+        len > MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE)) {
+        stats->skipped++;
+        return;
+    }
+
+    /* These answer the commands and data of the capturing host. */
+    switch (pkt[0]) {
+    case BLE_HCI_EVCODE_COMMAND_COMPLETE:
+    case BLE_HCI_EVCODE_COMMAND_STATUS:
+    case BLE_HCI_EVCODE_NUM_COMP_PKTS:
+        stats->skipped++;
+        return;
+    default:
+        break;
+    }
+
+    buf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+    if (buf == NULL) {
+        stats->skipped++;
+        return;
+    }
+    memcpy(buf, pkt, len);
+
+    start = ble_monitor_replay_time_us();
+    ble_hs_hci_evt_process((struct ble_hci_ev *)buf);
+    ble_monitor_replay_account(start, &stats->event_us, &stats->event_max_us);
+    stats->events++;
+}
+
+static void
+ble_monitor_replay_acl(const uint8_t *pkt, size_t len,
+                       struct ble_monitor_replay_stats *stats)
+{
+    struct os_mbuf *om;
+    uint32_t start;
+
+    om = os_msys_get_pkthdr(len, 0);
+    if (om == NULL) {
+        stats->skipped++;
+        return;
+    }
+
+    if (os_mbuf_append(om, pkt, len) != 0) {
+        os_mbuf_free_chain(om);
+        stats->skipped++;
+        return;
+    }
+
+    start = ble_monitor_replay_time_us();
+    ble_hs_hci_evt_acl_process(om);
+    ble_monitor_replay_account(start, &stats->acl_us, &stats->acl_max_us);
+    stats->acl_packets++;
+}
+
+static void
+ble_monitor_replay_run(struct ble_npl_event *ev)
+{
+    struct ble_monitor_replay_stats *stats;
+    const uint8_t *data;
+    uint32_t incl_len;
+    uint16_t opcode;
+    size_t off;
+
+    data = ble_monitor_replay_ctx.data;
+    stats = ble_monitor_replay_ctx.stats;
+
+    off = sizeof(struct ble_monitor_btsnoop_hdr);
+    while (off + sizeof(struct ble_monitor_btsnoop_rec) <=
+           ble_monitor_replay_ctx.len) {
+        incl_len = get_be32(data + off +
+                            offsetof(struct ble_monitor_btsnoop_rec, incl_len));
+        opcode = get_be32(data + off +
+                          offsetof(struct ble_monitor_btsnoop_rec, flags));
+        off += sizeof(struct ble_monitor_btsnoop_rec);
+
+        /* A truncated capture ends at the last whole packet. */
+        if (incl_len > ble_monitor_replay_ctx.len - off) {
+            break;
+        }
+
+        switch (opcode) {
+        case BLE_MONITOR_OPCODE_EVENT_PKT:
+            ble_monitor_replay_event(data + off, incl_len, stats);
+            break;
+        case BLE_MONITOR_OPCODE_ACL_RX_PKT:
+            ble_monitor_replay_acl(data + off, incl_len, stats);
+            break;
+        case BLE_MONITOR_OPCODE_COMMAND_PKT:
+        case BLE_MONITOR_OPCODE_ACL_TX_PKT:
+            stats->skipped++;
+            break;
+        default:
+            /* Index and log records are not HCI traffic. */
+            break;
+        }
+
+        off += incl_len;
+    }
+
+    if (ev != NULL) {
+        ble_npl_sem_release(&ble_monitor_replay_ctx.done);
+    }
+}
+
+int
+ble_monitor_replay(const uint8_t *data, size_t len,
+                   struct ble_monitor_replay_stats *stats)
+{
+    if (len < sizeof(struct ble_monitor_btsnoop_hdr) ||
+        memcmp(data, BLE_MONITOR_BTSNOOP_MAGIC,
+               sizeof(BLE_MONITOR_BTSNOOP_MAGIC)) != 0 ||
+        get_be32(data + offsetof(struct ble_monitor_btsnoop_hdr, version)) !=
+            BLE_MONITOR_BTSNOOP_VERSION ||
+        get_be32(data + offsetof(struct ble_monitor_btsnoop_hdr, datalink)) !=
+            BLE_MONITOR_BTSNOOP_MONITOR) {
+        return BLE_HS_EINVAL;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    ble_monitor_replay_ctx.data = data;
+    ble_monitor_replay_ctx.len = len;
+    ble_monitor_replay_ctx.stats = stats;
+
+    if (ble_hs_is_parent_task()) {
+        ble_monitor_replay_run(NULL);
+        return 0;
+    }
+
+    /* The host processes events in its own task only. */
+    ble_npl_sem_init(&ble_monitor_replay_ctx.done, 0);
+    ble_npl_event_init(&ble_monitor_replay_ctx.ev, ble_monitor_replay_run,
+                       NULL);
+    ble_npl_eventq_put(ble_hs_evq_get(), &ble_monitor_replay_ctx.ev);
+
+    ble_npl_sem_pend(&ble_monitor_replay_ctx.done, BLE_NPL_TIME_FOREVER);
+
+    ble_npl_event_deinit(&ble_monitor_replay_ctx.ev);
+    ble_npl_sem_deinit(&ble_monitor_replay_ctx.done);
+
+    return 0;
+}
+
+#endif
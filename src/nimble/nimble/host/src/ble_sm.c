@@ -144,6 +144,29 @@ static os_membuf_t ble_sm_proc_mem[
 
 static struct os_mempool ble_sm_proc_pool;
 
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+/**
+ * Pairings waiting for a free procedure, so a burst of pairings is served
+ * MYNEWT_VAL(BLE_SM_MAX_PROCS) at a time instead of failing.  The peer
+ * pairing requests are kept to be processed again once a procedure is free,
+ * the peer SMP timer keeps running while they wait.
+ */
+#define BLE_SM_PAIR_QUEUE_PAIR_REQ      0
+#define BLE_SM_PAIR_QUEUE_INITIATE      1
+#define BLE_SM_PAIR_QUEUE_SEC_REQ       2
+
+struct ble_sm_pair_queue_entry {
+    uint16_t conn_handle;
+    uint8_t type;
+    struct ble_sm_pair_cmd req;
+};
+
+static struct ble_sm_pair_queue_entry
+    ble_sm_pair_queue[MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE)];
+static uint8_t ble_sm_pair_queue_cnt;
+static struct ble_npl_event ble_sm_pair_queue_ev;
+#endif
+
 /* Maintains the list of active security manager procedures. */
 static struct ble_sm_proc_list ble_sm_procs;
 
@@ -406,13 +429,96 @@ ble_sm_proc_free(struct ble_sm_proc *proc)
 
     if (proc != NULL) {
         ble_sm_dbg_assert_not_inserted(proc);
+#if MYNEWT_VAL(BLE_SM_SC) && MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+        ble_sm_sc_proc_free(proc);
+#endif
 #if MYNEWT_VAL(BLE_HS_DEBUG)
         memset(proc, 0xff, sizeof *proc);
 #endif
         rc = os_memblock_put(&ble_sm_proc_pool, proc);
         BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+        if (ble_sm_pair_queue_cnt > 0) {
+            ble_npl_eventq_put(ble_hs_evq_get(), &ble_sm_pair_queue_ev);
+        }
+#endif
+    }
+}
+
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+/**
+ * Queues a pairing that found every procedure in use.  The queued pairings
+ * are started in arrival order from the host task as procedures are freed.
+ * A pairing request received again from a queued peer replaces the queued
+ * one.
+ *
+ * Lock restrictions:
+ *     o Caller locks ble_hs_mutex.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOMEM if the queue is full.
+ */
+static int
+ble_sm_pair_queue_add(uint16_t conn_handle, uint8_t type,
+                      const struct ble_sm_pair_cmd *req)
+{
+    struct ble_sm_pair_queue_entry *entry;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    entry = NULL;
+    for (i = 0; i < ble_sm_pair_queue_cnt; i++) {
+        if (ble_sm_pair_queue[i].conn_handle == conn_handle) {
+            entry = ble_sm_pair_queue + i;
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        if (ble_sm_pair_queue_cnt >= MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE)) {
+            return BLE_HS_ENOMEM;
+        }
+        entry = ble_sm_pair_queue + ble_sm_pair_queue_cnt;
+        ble_sm_pair_queue_cnt++;
+    }
+
+    entry->conn_handle = conn_handle;
+    entry->type = type;
+    if (req != NULL) {
+        entry->req = *req;
+    }
+
+    /* A procedure may have been freed since the allocation failed. */
+    if (ble_sm_proc_pool.mp_num_free > 0) {
+        ble_npl_eventq_put(ble_hs_evq_get(), &ble_sm_pair_queue_ev);
+    }
+
+    return 0;
+}
+
+/**
+ * Removes the queued pairing of a connection, if any.
+ *
+ * Lock restrictions:
+ *     o Caller locks ble_hs_mutex.
+ */
+static void
+ble_sm_pair_queue_remove(uint16_t conn_handle)
+{
+    int i;
+
+    for (i = 0; i < ble_sm_pair_queue_cnt; i++) {
+        if (ble_sm_pair_queue[i].conn_handle == conn_handle) {
+            ble_sm_pair_queue_cnt--;
+            memmove(ble_sm_pair_queue + i, ble_sm_pair_queue + i + 1,
+                    (ble_sm_pair_queue_cnt - i) * sizeof *ble_sm_pair_queue);
+            return;
+        }
     }
 }
+#endif
 
 static void
 ble_sm_proc_remove(struct ble_sm_proc *proc,
@@ -1868,6 +1974,13 @@ ble_sm_pair_req_rx(uint16_t conn_handle, struct os_mbuf **om,
             res->execute = 1;
         }
     }
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+    else if (ble_sm_pair_queue_add(conn_handle, BLE_SM_PAIR_QUEUE_PAIR_REQ,
+                                   req) != 0) {
+        res->sm_err = BLE_SM_ERR_UNSPECIFIED;
+        res->app_status = BLE_HS_ENOMEM;
+    }
+#endif
 
     ble_hs_unlock();
 
@@ -2511,7 +2624,15 @@ ble_sm_pair_initiate(uint16_t conn_handle)
 
     proc = ble_sm_proc_alloc();
     if (proc == NULL) {
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+        ble_hs_lock();
+        res.app_status = ble_sm_pair_queue_add(conn_handle,
+                                               BLE_SM_PAIR_QUEUE_INITIATE,
+                                               NULL);
+        ble_hs_unlock();
+#else
         res.app_status = BLE_HS_ENOMEM;
+#endif
     } else {
         proc->conn_handle = conn_handle;
         proc->state = BLE_SM_PROC_STATE_PAIR;
@@ -2551,7 +2672,13 @@ ble_sm_slave_initiate(uint16_t conn_handle)
     } else {
         proc = ble_sm_proc_alloc();
         if (proc == NULL) {
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+            res.app_status = ble_sm_pair_queue_add(conn_handle,
+                                                   BLE_SM_PAIR_QUEUE_SEC_REQ,
+                                                   NULL);
+#else
             res.app_status = BLE_HS_ENOMEM;
+#endif
         } else {
             proc->conn_handle = conn_handle;
             proc->state = BLE_SM_PROC_STATE_SEC_REQ;
@@ -2774,11 +2901,75 @@ ble_sm_inject_io(uint16_t conn_handle, struct ble_sm_io *pkey)
     return res.app_status;
 }
 
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+/**
+ * Starts the queued pairings while procedures are free.
+ */
+static void
+ble_sm_pair_queue_exec(struct ble_npl_event *ev)
+{
+    struct ble_sm_pair_queue_entry entry;
+    struct ble_sm_result res;
+    struct os_mbuf *om;
+
+    while (1) {
+        ble_hs_lock();
+        if (ble_sm_pair_queue_cnt == 0 ||
+            ble_sm_proc_pool.mp_num_free == 0) {
+
+            ble_hs_unlock();
+            return;
+        }
+
+        entry = ble_sm_pair_queue[0];
+        ble_sm_pair_queue_remove(entry.conn_handle);
+        ble_hs_unlock();
+
+        switch (entry.type) {
+        case BLE_SM_PAIR_QUEUE_PAIR_REQ:
+            om = ble_hs_mbuf_bare_pkt();
+            if (om == NULL ||
+                os_mbuf_append(om, &entry.req, sizeof entry.req) != 0) {
+
+                os_mbuf_free_chain(om);
+                memset(&res, 0, sizeof res);
+                res.sm_err = BLE_SM_ERR_UNSPECIFIED;
+                res.app_status = BLE_HS_ENOMEM;
+            } else {
+                memset(&res, 0, sizeof res);
+                ble_sm_pair_req_rx(entry.conn_handle, &om, &res);
+                os_mbuf_free_chain(om);
+            }
+            ble_sm_process_result(entry.conn_handle, &res);
+            break;
+
+        case BLE_SM_PAIR_QUEUE_INITIATE:
+            (void)ble_sm_pair_initiate(entry.conn_handle);
+            break;
+
+        case BLE_SM_PAIR_QUEUE_SEC_REQ:
+            (void)ble_sm_slave_initiate(entry.conn_handle);
+            break;
+
+        default:
+            BLE_HS_DBG_ASSERT(0);
+            break;
+        }
+    }
+}
+#endif
+
 void
 ble_sm_connection_broken(uint16_t conn_handle)
 {
     struct ble_sm_result res;
 
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+    ble_hs_lock();
+    ble_sm_pair_queue_remove(conn_handle);
+    ble_hs_unlock();
+#endif
+
     memset(&res, 0, sizeof res);
     res.app_status = BLE_HS_ENOTCONN;
     res.enc_cb = 1;
@@ -2802,6 +2993,11 @@ ble_sm_init(void)
         return rc;
     }
 
+#if MYNEWT_VAL(BLE_SM_PAIR_QUEUE_SIZE) > 0
+    ble_sm_pair_queue_cnt = 0;
+    ble_npl_event_init(&ble_sm_pair_queue_ev, ble_sm_pair_queue_exec, NULL);
+#endif
+
     ble_sm_sc_init();
 
     return 0;
@@ -59,6 +59,13 @@
 #if MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
 #if MYNEWT_VAL(BLE_SM_SC)
 static mbedtls_ecp_keypair keypair;
+
+/* Seeded once and shared by key generation and DHKey computation; gathering
+ * entropy on every call costs more than the hardware accelerated math.
+ */
+static mbedtls_entropy_context ble_sm_alg_entropy;
+static mbedtls_ctr_drbg_context ble_sm_alg_ctr_drbg;
+static uint8_t ble_sm_alg_drbg_seeded;
 #endif
 #else
 #if MYNEWT_VAL(BLE_SM_SC) && MYNEWT_VAL(TRNG)
@@ -321,6 +328,88 @@ ble_sm_alg_aes_cmac(const uint8_t *key, const uint8_t *in, size_t len,
 }
 #endif
 
+/* CMAC computed over a message supplied in parts, one at a time, used for the
+ * GATT database hash.
+ */
+#if MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
+static mbedtls_cipher_context_t ble_sm_alg_cmac_ctx;
+
+int
+ble_sm_alg_cmac_start(const uint8_t *key)
+{
+    const mbedtls_cipher_info_t *cipher_info;
+
+    mbedtls_cipher_init(&ble_sm_alg_cmac_ctx);
+
+    cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
+    if (cipher_info == NULL ||
+        mbedtls_cipher_setup(&ble_sm_alg_cmac_ctx, cipher_info) != 0 ||
+        mbedtls_cipher_cmac_starts(&ble_sm_alg_cmac_ctx, key, 128) != 0) {
+
+        mbedtls_cipher_free(&ble_sm_alg_cmac_ctx);
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+ble_sm_alg_cmac_update(const uint8_t *in, size_t len)
+{
+    if (mbedtls_cipher_cmac_update(&ble_sm_alg_cmac_ctx, in, len) != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+ble_sm_alg_cmac_finish(uint8_t *out)
+{
+    int rc;
+
+    rc = mbedtls_cipher_cmac_finish(&ble_sm_alg_cmac_ctx, out);
+    mbedtls_cipher_free(&ble_sm_alg_cmac_ctx);
+
+    return rc == 0 ? 0 : BLE_HS_EUNKNOWN;
+}
+
+#else
+static struct tc_aes_key_sched_struct ble_sm_alg_cmac_sched;
+static struct tc_cmac_struct ble_sm_alg_cmac_state;
+
+int
+ble_sm_alg_cmac_start(const uint8_t *key)
+{
+    if (tc_cmac_setup(&ble_sm_alg_cmac_state, key,
+                      &ble_sm_alg_cmac_sched) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+ble_sm_alg_cmac_update(const uint8_t *in, size_t len)
+{
+    if (tc_cmac_update(&ble_sm_alg_cmac_state, in, len) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+int
+ble_sm_alg_cmac_finish(uint8_t *out)
+{
+    if (tc_cmac_final(out, &ble_sm_alg_cmac_state) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+#endif
+
 int
 ble_sm_alg_f4(const uint8_t *u, const uint8_t *v, const uint8_t *x,
               uint8_t z, uint8_t *out_enc_data)
@@ -515,6 +604,28 @@ ble_sm_alg_g2(const uint8_t *u, const uint8_t *v, const uint8_t *x,
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
+static mbedtls_ctr_drbg_context *
+ble_sm_alg_drbg(void)
+{
+    if (!ble_sm_alg_drbg_seeded) {
+        mbedtls_entropy_init(&ble_sm_alg_entropy);
+        mbedtls_ctr_drbg_init(&ble_sm_alg_ctr_drbg);
+
+        if (mbedtls_ctr_drbg_seed(&ble_sm_alg_ctr_drbg, mbedtls_entropy_func,
+                                  &ble_sm_alg_entropy, NULL, 0) != 0) {
+            mbedtls_ctr_drbg_free(&ble_sm_alg_ctr_drbg);
+            mbedtls_entropy_free(&ble_sm_alg_entropy);
+            return NULL;
+        }
+
+        ble_sm_alg_drbg_seeded = 1;
+    }
+
+    return &ble_sm_alg_ctr_drbg;
+}
+#endif
+
 int
 ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_y,
                      const uint8_t *our_priv_key, uint8_t *out_dhkey)
@@ -523,16 +634,16 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     uint8_t pk[64];
     uint8_t priv[32];
     int rc = BLE_HS_EUNKNOWN;
+    ble_npl_time_t start = ble_npl_time_get();
 
     swap_buf(pk, peer_pub_key_x, 32);
     swap_buf(&pk[32], peer_pub_key_y, 32);
     swap_buf(priv, our_priv_key, 32);
 
 #if MYNEWT_VAL(BLE_CRYPTO_STACK_MBEDTLS)
-    struct mbedtls_ecp_point pt = {0}, Q = {0};
+    struct mbedtls_ecp_point Q = {0};
     mbedtls_mpi z = {0}, d = {0};
-    mbedtls_ctr_drbg_context ctr_drbg = {0};
-    mbedtls_entropy_context entropy = {0};
+    mbedtls_ctr_drbg_context *ctr_drbg;
 
     uint8_t pub[65] = {0};
     /* Hardcoded first byte of pub key for MBEDTLS_ECP_PF_UNCOMPRESSED */
@@ -540,34 +651,27 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     memcpy(&pub[1], pk, 64);
 
     /* Initialize the required structures here */
-    mbedtls_ecp_point_init(&pt);
     mbedtls_ecp_point_init(&Q);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-    mbedtls_entropy_init(&entropy);
     mbedtls_mpi_init(&d);
     mbedtls_mpi_init(&z);
 
-    /* Below 3 steps are to validate public key on curve secp256r1 */
-    if (mbedtls_ecp_group_load(&keypair.MBEDTLS_PRIVATE(grp), MBEDTLS_ECP_DP_SECP256R1) != 0) {
-        goto exit;
-    }
-
-    if (mbedtls_ecp_point_read_binary(&keypair.MBEDTLS_PRIVATE(grp), &pt, pub, 65) != 0) {
+    ctr_drbg = ble_sm_alg_drbg();
+    if (ctr_drbg == NULL) {
         goto exit;
     }
 
-    if (mbedtls_ecp_check_pubkey(&keypair.MBEDTLS_PRIVATE(grp), &pt) != 0) {
+    /* The group is left loaded by key generation */
+    if (keypair.MBEDTLS_PRIVATE(grp).id != MBEDTLS_ECP_DP_SECP256R1 &&
+        mbedtls_ecp_group_load(&keypair.MBEDTLS_PRIVATE(grp), MBEDTLS_ECP_DP_SECP256R1) != 0) {
         goto exit;
     }
 
-    /* Set PRNG */
-    if ( ( rc = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
-                                      NULL, 0) ) != 0) {
+    /* Prepare point Q from pub key and validate it on curve secp256r1 */
+    if (mbedtls_ecp_point_read_binary(&keypair.MBEDTLS_PRIVATE(grp), &Q, pub, 65) != 0) {
         goto exit;
     }
 
-    /* Prepare point Q from pub key */
-    if (mbedtls_ecp_point_read_binary(&keypair.MBEDTLS_PRIVATE(grp), &Q, pub, 65) != 0) {
+    if (mbedtls_ecp_check_pubkey(&keypair.MBEDTLS_PRIVATE(grp), &Q) != 0) {
         goto exit;
     }
 
@@ -576,7 +680,7 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     }
 
     rc = mbedtls_ecdh_compute_shared(&keypair.MBEDTLS_PRIVATE(grp), &z, &Q, &d,
-                                     mbedtls_ctr_drbg_random, &ctr_drbg);
+                                     mbedtls_ctr_drbg_random, ctr_drbg);
     if (rc != 0) {
         goto exit;
     }
@@ -587,12 +691,9 @@ ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x, const uint8_t *peer_pub_key_
     }
 
 exit:
-    mbedtls_ecp_point_free(&pt);
     mbedtls_mpi_free(&z);
     mbedtls_mpi_free(&d);
     mbedtls_ecp_point_free(&Q);
-    mbedtls_entropy_free(&entropy);
-    mbedtls_ctr_drbg_free(&ctr_drbg);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -608,6 +709,9 @@ exit:
     }
 #endif
 
+    BLE_HS_LOG(DEBUG, "ble_sm_alg_gen_dhkey() took %u ms\n",
+               (unsigned)ble_npl_time_ticks_to_ms32(ble_npl_time_get() - start));
+
     swap_buf(out_dhkey, dh, 32);
     return 0;
 }
@@ -637,25 +741,20 @@ static int
 mbedtls_gen_keypair(uint8_t *public_key, uint8_t *private_key)
 {
     int rc = BLE_HS_EUNKNOWN;
-    mbedtls_entropy_context entropy = {0};
-    mbedtls_ctr_drbg_context ctr_drbg = {0};
-
-
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_ctr_drbg_context *ctr_drbg;
 
     /* Free the previously allocate keypair */
     mbedtls_ecp_keypair_free(&keypair);
 
     mbedtls_ecp_keypair_init(&keypair);
 
-    if (( rc = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
-                                NULL, 0)) != 0) {
+    ctr_drbg = ble_sm_alg_drbg();
+    if (ctr_drbg == NULL) {
         goto exit;
     }
 
     if ((rc = mbedtls_ecp_gen_key(MBEDTLS_ECP_DP_SECP256R1, &keypair,
-                                  mbedtls_ctr_drbg_random, &ctr_drbg)) != 0) {
+                                  mbedtls_ctr_drbg_random, ctr_drbg)) != 0) {
         goto exit;
     }
 
@@ -674,8 +773,6 @@ mbedtls_gen_keypair(uint8_t *public_key, uint8_t *private_key)
     memcpy(public_key, &pub[1], 64);
 
 exit:
-    mbedtls_ctr_drbg_free( &ctr_drbg );
-    mbedtls_entropy_free( &entropy );
     if (rc != 0) {
         mbedtls_ecp_keypair_free(&keypair);
         return BLE_HS_EUNKNOWN;
@@ -687,6 +784,12 @@ exit:
 void mbedtls_free_keypair(void)
 {
     mbedtls_ecp_keypair_free(&keypair);
+
+    if (ble_sm_alg_drbg_seeded) {
+        mbedtls_ctr_drbg_free(&ble_sm_alg_ctr_drbg);
+        mbedtls_entropy_free(&ble_sm_alg_entropy);
+        ble_sm_alg_drbg_seeded = 0;
+    }
 }
 #endif
 
@@ -703,6 +806,7 @@ ble_sm_alg_gen_key_pair(uint8_t *pub, uint8_t *priv)
     swap_buf(priv, ble_sm_alg_dbg_priv_key, 32);
 #else
     uint8_t pk[64];
+    ble_npl_time_t start = ble_npl_time_get();
 
     do {
 
@@ -722,6 +826,9 @@ ble_sm_alg_gen_key_pair(uint8_t *pub, uint8_t *priv)
     swap_buf(pub, pk, 32);
     swap_buf(&pub[32], &pk[32], 32);
     swap_in_place(priv, 32);
+
+    BLE_HS_LOG(DEBUG, "ble_sm_alg_gen_key_pair() took %u ms\n",
+               (unsigned)ble_npl_time_ticks_to_ms32(ble_npl_time_get() - start));
 #endif
 
     return 0;
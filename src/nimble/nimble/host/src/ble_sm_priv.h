@@ -216,6 +216,8 @@ struct ble_sm_dhkey_check {
 #define BLE_SM_PROC_F_AUTHENTICATED         0x08
 #define BLE_SM_PROC_F_SC                    0x10
 #define BLE_SM_PROC_F_BONDING               0x20
+#define BLE_SM_PROC_F_DHKEY_PENDING         0x40
+#define BLE_SM_PROC_F_RANDOM_DEFERRED       0x80
 
 #define BLE_SM_KE_F_ENC_INFO                0x01
 #define BLE_SM_KE_F_MASTER_ID               0x02
@@ -241,6 +243,8 @@ struct ble_sm_keys {
     uint8_t addr[6];    /* Little endian. */
 };
 
+struct ble_sm_sc_dhkey_job;
+
 struct ble_sm_proc {
     STAILQ_ENTRY(ble_sm_proc) next;
 
@@ -271,6 +275,9 @@ struct ble_sm_proc {
     uint8_t dhkey[32];
     const struct ble_sm_sc_oob_data *oob_data_local;
     const struct ble_sm_sc_oob_data *oob_data_remote;
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+    struct ble_sm_sc_dhkey_job *dhkey_job;
+#endif
 #endif
 };
 
@@ -314,6 +321,9 @@ int ble_sm_alg_f6(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
                   const uint8_t *r, const uint8_t *iocap, uint8_t a1t,
                   const uint8_t *a1, uint8_t a2t, const uint8_t *a2,
                   uint8_t *check);
+int ble_sm_alg_cmac_start(const uint8_t *key);
+int ble_sm_alg_cmac_update(const uint8_t *in, size_t len);
+int ble_sm_alg_cmac_finish(uint8_t *out);
 int ble_sm_alg_gen_dhkey(const uint8_t *peer_pub_key_x,
                          const uint8_t *peer_pub_key_y,
                          const uint8_t *our_priv_key, uint8_t *out_dhkey);
@@ -360,6 +370,10 @@ bool ble_sm_sc_oob_data_check(struct ble_sm_proc *proc,
                               bool oob_data_remote_present);
 void ble_sm_sc_oob_confirm(struct ble_sm_proc *proc, struct ble_sm_result *res);
 void ble_sm_sc_init(void);
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+void ble_sm_sc_proc_free(struct ble_sm_proc *proc);
+void ble_sm_sc_synced(void);
+#endif
 #else
 #define ble_sm_sc_io_action(proc, action) (BLE_HS_ENOTSUP)
 #define ble_sm_sc_confirm_exec(proc, res)
@@ -24,6 +24,10 @@
 #include "ble_hs_priv.h"
 #include "ble_sm_priv.h"
 
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
+
 #if NIMBLE_BLE_CONNECT
 #if MYNEWT_VAL(BLE_SM_SC)
 
@@ -39,6 +43,46 @@ static uint8_t ble_sm_sc_priv_key[32];
  */
 static uint8_t ble_sm_sc_keys_generated;
 
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+/**
+ * Key pair generation and DHKey computation run in a separate task so the
+ * host task keeps serving other connections.  Results are posted back to the
+ * host event queue.
+ */
+#define BLE_SM_SC_DHKEY_JOB_FREE    0
+#define BLE_SM_SC_DHKEY_JOB_WORK    1
+#define BLE_SM_SC_DHKEY_JOB_DONE    2
+
+struct ble_sm_sc_dhkey_job {
+    struct ble_npl_event ev_work;
+    struct ble_npl_event ev_done;
+    struct ble_sm_proc *proc;
+    uint16_t conn_handle;
+    uint8_t state;
+    int status;
+    uint8_t peer_x[32];
+    uint8_t peer_y[32];
+    uint8_t priv[32];
+    uint8_t dhkey[32];
+};
+
+static struct ble_sm_sc_dhkey_job
+    ble_sm_sc_dhkey_jobs[MYNEWT_VAL(BLE_SM_MAX_PROCS)];
+
+static struct ble_npl_eventq ble_sm_sc_crypto_q;
+static struct ble_npl_mutex ble_sm_sc_crypto_mutex;
+static uint8_t ble_sm_sc_crypto_started;
+
+/* Key pair generated by the crypto task, installed once no pairing runs. */
+static uint8_t ble_sm_sc_next_pub_key[64];
+static uint8_t ble_sm_sc_next_priv_key[32];
+static volatile uint8_t ble_sm_sc_next_keys_ready;
+static int ble_sm_sc_keygen_status;
+static struct ble_npl_event ble_sm_sc_keygen_ev;
+static struct ble_npl_event ble_sm_sc_keygen_done_ev;
+static struct ble_npl_callout ble_sm_sc_rotate_timer;
+#endif
+
 /**
  * Create some shortened names for the passkey actions so that the table is
  * easier to read.
@@ -172,13 +216,39 @@ ble_sm_gen_pub_priv(uint8_t *pub, uint8_t *priv)
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+static void
+ble_sm_sc_install_next_keys(void)
+{
+    memcpy(ble_sm_sc_pub_key, ble_sm_sc_next_pub_key, sizeof ble_sm_sc_pub_key);
+    memcpy(ble_sm_sc_priv_key, ble_sm_sc_next_priv_key,
+           sizeof ble_sm_sc_priv_key);
+    ble_sm_sc_next_keys_ready = 0;
+    ble_sm_sc_keys_generated = 1;
+}
+#endif
+
 static int
 ble_sm_sc_ensure_keys_generated(void)
 {
     int rc;
 
     if (!ble_sm_sc_keys_generated) {
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+        /* Wait for the crypto task if it is generating the key pair, only
+         * generate it here if pairing starts before it runs.
+         */
+        ble_npl_mutex_pend(&ble_sm_sc_crypto_mutex, BLE_NPL_TIME_FOREVER);
+        if (ble_sm_sc_next_keys_ready) {
+            ble_sm_sc_install_next_keys();
+            rc = 0;
+        } else {
+            rc = ble_sm_gen_pub_priv(ble_sm_sc_pub_key, ble_sm_sc_priv_key);
+        }
+        ble_npl_mutex_release(&ble_sm_sc_crypto_mutex);
+#else
         rc = ble_sm_gen_pub_priv(ble_sm_sc_pub_key, ble_sm_sc_priv_key);
+#endif
         if (rc != 0) {
             return rc;
         }
@@ -196,6 +266,283 @@ ble_sm_sc_ensure_keys_generated(void)
     return 0;
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+static void
+ble_sm_sc_crypto_thread(void *arg)
+{
+    while (1) {
+        ble_npl_event_run(ble_npl_eventq_get(&ble_sm_sc_crypto_q,
+                                             BLE_NPL_TIME_FOREVER));
+    }
+}
+
+static void
+ble_sm_sc_keygen_exec(struct ble_npl_event *ev)
+{
+    ble_npl_mutex_pend(&ble_sm_sc_crypto_mutex, BLE_NPL_TIME_FOREVER);
+    ble_sm_sc_keygen_status = ble_sm_alg_gen_key_pair(ble_sm_sc_next_pub_key,
+                                                      ble_sm_sc_next_priv_key);
+    ble_sm_sc_next_keys_ready = ble_sm_sc_keygen_status == 0;
+    ble_npl_mutex_release(&ble_sm_sc_crypto_mutex);
+
+    ble_npl_eventq_put(ble_hs_evq_get(), &ble_sm_sc_keygen_done_ev);
+}
+
+static void
+ble_sm_sc_keygen_start(void)
+{
+    if (!ble_sm_sc_next_keys_ready &&
+        !ble_npl_event_is_queued(&ble_sm_sc_keygen_ev)) {
+
+        ble_npl_eventq_put(&ble_sm_sc_crypto_q, &ble_sm_sc_keygen_ev);
+    }
+}
+
+/**
+ * Replaces the key pair with the one generated by the crypto task.  This is
+ * only done while no pairing is in progress as the procedures use our keys
+ * until they complete.
+ */
+static void
+ble_sm_sc_keys_rotate(void)
+{
+    ble_npl_time_t ticks;
+    int busy;
+
+    if (!ble_sm_sc_next_keys_ready) {
+        return;
+    }
+
+    ble_hs_lock();
+    busy = ble_sm_num_procs() != 0;
+    if (!busy) {
+        ble_sm_sc_install_next_keys();
+    }
+    ble_hs_unlock();
+
+    if (busy) {
+        ticks = ble_npl_time_ms_to_ticks32(1000);
+    } else if (MYNEWT_VAL(BLE_SM_SC_KEY_ROTATE_MS) > 0) {
+        ticks = ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_SM_SC_KEY_ROTATE_MS));
+    } else {
+        return;
+    }
+
+    ble_npl_callout_reset(&ble_sm_sc_rotate_timer, ticks);
+}
+
+static void
+ble_sm_sc_keygen_done(struct ble_npl_event *ev)
+{
+    if (ble_sm_sc_keygen_status != 0) {
+        BLE_HS_LOG(ERROR, "key pair generation failed; rc=%d\n",
+                   ble_sm_sc_keygen_status);
+        return;
+    }
+
+    ble_sm_sc_keys_rotate();
+}
+
+static void
+ble_sm_sc_rotate_exp(struct ble_npl_event *ev)
+{
+    if (ble_sm_sc_next_keys_ready) {
+        ble_sm_sc_keys_rotate();
+    } else {
+        ble_sm_sc_keygen_start();
+    }
+}
+
+static void
+ble_sm_sc_dhkey_exec(struct ble_npl_event *ev)
+{
+    struct ble_sm_sc_dhkey_job *job;
+
+    job = ble_npl_event_get_arg(ev);
+
+    ble_npl_mutex_pend(&ble_sm_sc_crypto_mutex, BLE_NPL_TIME_FOREVER);
+    job->status = ble_sm_alg_gen_dhkey(job->peer_x, job->peer_y, job->priv,
+                                       job->dhkey);
+    ble_npl_mutex_release(&ble_sm_sc_crypto_mutex);
+
+    job->state = BLE_SM_SC_DHKEY_JOB_DONE;
+    ble_npl_eventq_put(ble_hs_evq_get(), &job->ev_done);
+}
+
+static void
+ble_sm_sc_dhkey_done(struct ble_npl_event *ev)
+{
+    struct ble_sm_sc_dhkey_job *job;
+    struct ble_sm_result res;
+    struct ble_sm_proc *proc;
+    uint16_t conn_handle;
+    uint32_t ctx;
+    int have_res;
+
+    job = ble_npl_event_get_arg(ev);
+    conn_handle = job->conn_handle;
+    have_res = 0;
+    memset(&res, 0, sizeof res);
+
+    ble_hs_lock();
+
+    ctx = ble_npl_hw_enter_critical();
+    proc = job->proc;
+    job->proc = NULL;
+    ble_npl_hw_exit_critical(ctx);
+
+    /* The procedure may have failed while the DHKey was computed. */
+    if (proc != NULL &&
+        ble_sm_proc_find(conn_handle, BLE_SM_PROC_STATE_NONE, -1,
+                         NULL) == proc) {
+
+        proc->dhkey_job = NULL;
+        proc->flags &= ~BLE_SM_PROC_F_DHKEY_PENDING;
+
+        if (job->status != 0) {
+            res.app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
+            res.sm_err = BLE_SM_ERR_DHKEY;
+            res.enc_cb = 1;
+            have_res = 1;
+        } else {
+            memcpy(proc->dhkey, job->dhkey, sizeof proc->dhkey);
+
+            if (proc->flags & BLE_SM_PROC_F_RANDOM_DEFERRED) {
+                proc->flags &= ~BLE_SM_PROC_F_RANDOM_DEFERRED;
+                ble_sm_sc_random_rx(proc, &res);
+                have_res = 1;
+            }
+        }
+    }
+
+    job->state = BLE_SM_SC_DHKEY_JOB_FREE;
+
+    ble_hs_unlock();
+
+    if (have_res) {
+        ble_sm_process_result(conn_handle, &res);
+    }
+}
+
+/**
+ * Hands the DHKey computation of a procedure to the crypto task.  The
+ * procedure continues up to the random exchange, which waits for the result.
+ * Must be called with the host lock held.
+ */
+static int
+ble_sm_sc_dhkey_start(struct ble_sm_proc *proc)
+{
+    struct ble_sm_sc_dhkey_job *job;
+    uint32_t ctx;
+    int i;
+
+    job = NULL;
+
+    ctx = ble_npl_hw_enter_critical();
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_MAX_PROCS); i++) {
+        if (ble_sm_sc_dhkey_jobs[i].state == BLE_SM_SC_DHKEY_JOB_FREE) {
+            job = &ble_sm_sc_dhkey_jobs[i];
+            job->state = BLE_SM_SC_DHKEY_JOB_WORK;
+            job->proc = proc;
+            proc->dhkey_job = job;
+            break;
+        }
+    }
+    ble_npl_hw_exit_critical(ctx);
+
+    if (job == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    job->conn_handle = proc->conn_handle;
+    memcpy(job->peer_x, proc->pub_key_peer.x, sizeof job->peer_x);
+    memcpy(job->peer_y, proc->pub_key_peer.y, sizeof job->peer_y);
+    memcpy(job->priv, ble_sm_sc_priv_key, sizeof job->priv);
+    proc->flags |= BLE_SM_PROC_F_DHKEY_PENDING;
+
+    ble_npl_eventq_put(&ble_sm_sc_crypto_q, &job->ev_work);
+    return 0;
+}
+
+void
+ble_sm_sc_proc_free(struct ble_sm_proc *proc)
+{
+    uint32_t ctx;
+
+    ctx = ble_npl_hw_enter_critical();
+    if (proc->dhkey_job != NULL) {
+        proc->dhkey_job->proc = NULL;
+        proc->dhkey_job = NULL;
+    }
+    ble_npl_hw_exit_critical(ctx);
+}
+
+void
+ble_sm_sc_synced(void)
+{
+    static uint8_t timer_init;
+
+    if (!timer_init) {
+        ble_npl_callout_init(&ble_sm_sc_rotate_timer, ble_hs_evq_get(),
+                             ble_sm_sc_rotate_exp, NULL);
+        timer_init = 1;
+    }
+
+    if (!ble_sm_sc_keys_generated) {
+        if (ble_sm_sc_next_keys_ready) {
+            ble_sm_sc_keys_rotate();
+        } else {
+            ble_sm_sc_keygen_start();
+        }
+    }
+}
+
+static void
+ble_sm_sc_crypto_init(void)
+{
+    struct ble_sm_sc_dhkey_job *job;
+    int i;
+
+    if (!ble_sm_sc_crypto_started) {
+        ble_npl_eventq_init(&ble_sm_sc_crypto_q);
+        ble_npl_mutex_init(&ble_sm_sc_crypto_mutex);
+        ble_npl_event_init(&ble_sm_sc_keygen_ev, ble_sm_sc_keygen_exec, NULL);
+
+        for (i = 0; i < MYNEWT_VAL(BLE_SM_MAX_PROCS); i++) {
+            job = &ble_sm_sc_dhkey_jobs[i];
+            ble_npl_event_init(&job->ev_work, ble_sm_sc_dhkey_exec, job);
+        }
+
+#ifdef ESP_PLATFORM
+        xTaskCreatePinnedToCore(ble_sm_sc_crypto_thread, "nimble_sm_sc",
+                                MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK_STACK_SIZE),
+                                NULL, (configMAX_PRIORITIES - 5), NULL,
+                                NIMBLE_CORE);
+#else
+        xTaskCreate(ble_sm_sc_crypto_thread, "nimble_sm_sc",
+                    MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK_STACK_SIZE) /
+                    sizeof(StackType_t), NULL, tskIDLE_PRIORITY + 1, NULL);
+#endif
+        ble_sm_sc_crypto_started = 1;
+    }
+
+    /* Events posted to the host queue before a host reset are lost, re-arm
+     * them.  Jobs still in the crypto task free themselves when done.
+     */
+    ble_npl_event_init(&ble_sm_sc_keygen_done_ev, ble_sm_sc_keygen_done, NULL);
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_MAX_PROCS); i++) {
+        job = &ble_sm_sc_dhkey_jobs[i];
+        job->proc = NULL;
+        if (job->state == BLE_SM_SC_DHKEY_JOB_DONE) {
+            job->state = BLE_SM_SC_DHKEY_JOB_FREE;
+        }
+        if (job->state == BLE_SM_SC_DHKEY_JOB_FREE) {
+            ble_npl_event_init(&job->ev_done, ble_sm_sc_dhkey_done, job);
+        }
+    }
+}
+#endif
+
 /* Initiator does not send a confirm when pairing algorithm is any of:
  *     o just works
  *     o numeric comparison
@@ -448,6 +795,14 @@ ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
     uint8_t rat;
     int rc;
 
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+    if (proc->flags & BLE_SM_PROC_F_DHKEY_PENDING) {
+        /* The mac key needs the DHKey, continue when it is ready. */
+        proc->flags |= BLE_SM_PROC_F_RANDOM_DEFERRED;
+        return;
+    }
+#endif
+
     if (proc->pair_alg != BLE_SM_PAIR_ALG_OOB && (
         proc->flags & BLE_SM_PROC_F_INITIATOR ||
         ble_sm_sc_responder_verifies_random(proc))) {
@@ -628,10 +983,14 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
     } else {
         memcpy(&proc->pub_key_peer, cmd, sizeof(*cmd));
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+        rc = ble_sm_sc_dhkey_start(proc);
+#else
         rc = ble_sm_alg_gen_dhkey(proc->pub_key_peer.x,
                                   proc->pub_key_peer.y,
                                   ble_sm_sc_priv_key,
                                   proc->dhkey);
+#endif
         if (rc != 0) {
             res->app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
             res->sm_err = BLE_SM_ERR_DHKEY;
@@ -912,6 +1271,9 @@ ble_sm_sc_init(void)
 {
     ble_sm_alg_ecc_init();
     ble_sm_sc_keys_generated = 0;
+#if MYNEWT_VAL(BLE_SM_SC_CRYPTO_TASK)
+    ble_sm_sc_crypto_init();
+#endif
 }
 
 #endif  /* MYNEWT_VAL(BLE_SM_SC) */
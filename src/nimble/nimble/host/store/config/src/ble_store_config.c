@@ -38,6 +38,120 @@ struct ble_store_value_cccd
     ble_store_config_cccds[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
 int ble_store_config_num_cccds;
 
+/*****************************************************************************
+ * $index                                                                    *
+ *****************************************************************************/
+
+/* Hash tables mapping a peer address, and the characteristic value handle for
+ * CCCDs, to the position of the entry in the arrays above so that lookups do
+ * not scan every bond. Open addressing with linear probing; a slot holds the
+ * array index + 1 and 0 marks a free slot.  The tables have twice as many
+ * slots as the arrays have entries so they never fill up.
+ */
+#define BLE_STORE_CONFIG_SEC_IDX_SZ     (MYNEWT_VAL(BLE_STORE_MAX_BONDS) * 2)
+#define BLE_STORE_CONFIG_CCCD_IDX_SZ    (MYNEWT_VAL(BLE_STORE_MAX_CCCDS) * 2)
+
+static uint16_t ble_store_config_our_sec_idx[BLE_STORE_CONFIG_SEC_IDX_SZ];
+static uint16_t ble_store_config_peer_sec_idx[BLE_STORE_CONFIG_SEC_IDX_SZ];
+static uint16_t ble_store_config_cccd_idx[BLE_STORE_CONFIG_CCCD_IDX_SZ];
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) && MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
+/* The arrays are filled from persistent storage on the first access instead
+ * of at init, so startup does not read every bond.
+ */
+static bool ble_store_config_loaded;
+#endif
+
+static uint32_t
+ble_store_config_hash(const ble_addr_t *addr, uint16_t chr_val_handle)
+{
+    uint32_t hash;
+    int i;
+
+    /* FNV-1a */
+    hash = 2166136261u;
+    hash = (hash ^ addr->type) * 16777619u;
+    for (i = 0; i < 6; i++) {
+        hash = (hash ^ addr->val[i]) * 16777619u;
+    }
+    hash = (hash ^ (chr_val_handle & 0xff)) * 16777619u;
+    hash = (hash ^ (chr_val_handle >> 8)) * 16777619u;
+
+    return hash;
+}
+
+static void
+ble_store_config_idx_add(uint16_t *table, int table_sz, uint32_t hash, int idx)
+{
+    int slot;
+
+    slot = hash % table_sz;
+    while (table[slot] != 0) {
+        slot = (slot + 1) % table_sz;
+    }
+
+    table[slot] = idx + 1;
+}
+
+static void
+ble_store_config_sec_idx_build(uint16_t *table,
+                               const struct ble_store_value_sec *value_secs,
+                               int num_value_secs)
+{
+    int i;
+
+    memset(table, 0, BLE_STORE_CONFIG_SEC_IDX_SZ * sizeof *table);
+    for (i = 0; i < num_value_secs; i++) {
+        ble_store_config_idx_add(table, BLE_STORE_CONFIG_SEC_IDX_SZ,
+                                 ble_store_config_hash(&value_secs[i].peer_addr,
+                                                       0),
+                                 i);
+    }
+}
+
+static void
+ble_store_config_cccd_idx_build(void)
+{
+    int i;
+
+    memset(ble_store_config_cccd_idx, 0, sizeof ble_store_config_cccd_idx);
+    for (i = 0; i < ble_store_config_num_cccds; i++) {
+        ble_store_config_idx_add(ble_store_config_cccd_idx,
+                                 BLE_STORE_CONFIG_CCCD_IDX_SZ,
+                                 ble_store_config_hash(
+                                     &ble_store_config_cccds[i].peer_addr,
+                                     ble_store_config_cccds[i].chr_val_handle),
+                                 i);
+    }
+}
+
+static void
+ble_store_config_idx_build(void)
+{
+    ble_store_config_sec_idx_build(ble_store_config_our_sec_idx,
+                                   ble_store_config_our_secs,
+                                   ble_store_config_num_our_secs);
+    ble_store_config_sec_idx_build(ble_store_config_peer_sec_idx,
+                                   ble_store_config_peer_secs,
+                                   ble_store_config_num_peer_secs);
+    ble_store_config_cccd_idx_build();
+}
+
+/* Loads the arrays from persistent storage if it has not been done yet.
+ * Called with the host lock held by every entry point of the store.
+ */
+static void
+ble_store_config_ensure_loaded(void)
+{
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) && MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
+    if (!ble_store_config_loaded) {
+        ble_store_config_loaded = true;
+        ble_store_config_conf_load();
+        ble_store_config_idx_build();
+    }
+#endif
+}
+
 /*****************************************************************************
  * $sec                                                                      *
  *****************************************************************************/
@@ -80,34 +194,64 @@ ble_store_config_print_key_sec(const struct ble_store_key_sec *key_sec)
     }
 }
 
+static int
+ble_store_config_sec_matches(const struct ble_store_key_sec *key_sec,
+                             const struct ble_store_value_sec *cur)
+{
+    if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
+        if (ble_addr_cmp(&cur->peer_addr, &key_sec->peer_addr)) {
+            return 0;
+        }
+    }
+
+    if (key_sec->ediv_rand_present) {
+        if (cur->ediv != key_sec->ediv) {
+            return 0;
+        }
+
+        if (cur->rand_num != key_sec->rand_num) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 static int
 ble_store_config_find_sec(const struct ble_store_key_sec *key_sec,
                           const struct ble_store_value_sec *value_secs,
-                          int num_value_secs)
+                          int num_value_secs, const uint16_t *index)
 {
-    const struct ble_store_value_sec *cur;
     int skipped;
+    int slot;
+    int best;
     int i;
 
-    skipped = 0;
-
-    for (i = 0; i < num_value_secs; i++) {
-        cur = value_secs + i;
-
-        if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
-            if (ble_addr_cmp(&cur->peer_addr, &key_sec->peer_addr)) {
-                continue;
+    /* The first entry of a peer is found through the index.  A peer can have
+     * more than one entry if its keys were replaced, so check the whole probe
+     * sequence and return the lowest position like the linear search does.
+     */
+    if (key_sec->idx == 0 && ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
+        best = -1;
+        slot = ble_store_config_hash(&key_sec->peer_addr, 0) %
+               BLE_STORE_CONFIG_SEC_IDX_SZ;
+        while (index[slot] != 0) {
+            i = index[slot] - 1;
+            if ((best == -1 || i < best) &&
+                ble_store_config_sec_matches(key_sec, value_secs + i)) {
+                best = i;
             }
+            slot = (slot + 1) % BLE_STORE_CONFIG_SEC_IDX_SZ;
         }
 
-        if (key_sec->ediv_rand_present) {
-            if (cur->ediv != key_sec->ediv) {
-                continue;
-            }
+        return best;
+    }
 
-            if (cur->rand_num != key_sec->rand_num) {
-                continue;
-            }
+    skipped = 0;
+
+    for (i = 0; i < num_value_secs; i++) {
+        if (!ble_store_config_sec_matches(key_sec, value_secs + i)) {
+            continue;
         }
 
         if (key_sec->idx > skipped) {
@@ -128,7 +272,8 @@ ble_store_config_read_our_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_config_find_sec(key_sec, ble_store_config_our_secs,
-                                    ble_store_config_num_our_secs);
+                                    ble_store_config_num_our_secs,
+                                    ble_store_config_our_sec_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -150,7 +295,8 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_config_find_sec(&key_sec, ble_store_config_our_secs,
-                                    ble_store_config_num_our_secs);
+                                    ble_store_config_num_our_secs,
+                                    ble_store_config_our_sec_idx);
     if (idx == -1) {
         if (ble_store_config_num_our_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting our sec; too many entries "
@@ -160,6 +306,10 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
 
         idx = ble_store_config_num_our_secs;
         ble_store_config_num_our_secs++;
+        ble_store_config_idx_add(ble_store_config_our_sec_idx,
+                                 BLE_STORE_CONFIG_SEC_IDX_SZ,
+                                 ble_store_config_hash(&value_sec->peer_addr, 0),
+                                 idx);
     }
 
     ble_store_config_our_secs[idx] = *value_sec;
@@ -196,12 +346,13 @@ ble_store_config_delete_obj(void *values, int value_size, int idx,
 static int
 ble_store_config_delete_sec(const struct ble_store_key_sec *key_sec,
                             struct ble_store_value_sec *value_secs,
-                            int *num_value_secs)
+                            int *num_value_secs, uint16_t *index)
 {
     int idx;
     int rc;
 
-    idx = ble_store_config_find_sec(key_sec, value_secs, *num_value_secs);
+    idx = ble_store_config_find_sec(key_sec, value_secs, *num_value_secs,
+                                    index);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -212,6 +363,9 @@ ble_store_config_delete_sec(const struct ble_store_key_sec *key_sec,
         return rc;
     }
 
+    /* The following entries moved down, their positions changed */
+    ble_store_config_sec_idx_build(index, value_secs, *num_value_secs);
+
     return 0;
 }
 
@@ -221,7 +375,8 @@ ble_store_config_delete_our_sec(const struct ble_store_key_sec *key_sec)
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_our_secs,
-                                     &ble_store_config_num_our_secs);
+                                     &ble_store_config_num_our_secs,
+                                     ble_store_config_our_sec_idx);
     if (rc != 0) {
         return rc;
     }
@@ -240,7 +395,8 @@ ble_store_config_delete_peer_sec(const struct ble_store_key_sec *key_sec)
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_peer_secs,
-                                  &ble_store_config_num_peer_secs);
+                                  &ble_store_config_num_peer_secs,
+                                  ble_store_config_peer_sec_idx);
     if (rc != 0) {
         return rc;
     }
@@ -260,7 +416,8 @@ ble_store_config_read_peer_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_config_find_sec(key_sec, ble_store_config_peer_secs,
-                             ble_store_config_num_peer_secs);
+                             ble_store_config_num_peer_secs,
+                             ble_store_config_peer_sec_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -281,7 +438,8 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_config_find_sec(&key_sec, ble_store_config_peer_secs,
-                                 ble_store_config_num_peer_secs);
+                                 ble_store_config_num_peer_secs,
+                                 ble_store_config_peer_sec_idx);
     if (idx == -1) {
         if (ble_store_config_num_peer_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting peer sec; too many entries "
@@ -291,6 +449,10 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
         idx = ble_store_config_num_peer_secs;
         ble_store_config_num_peer_secs++;
+        ble_store_config_idx_add(ble_store_config_peer_sec_idx,
+                                 BLE_STORE_CONFIG_SEC_IDX_SZ,
+                                 ble_store_config_hash(&value_sec->peer_addr, 0),
+                                 idx);
     }
 
     ble_store_config_peer_secs[idx] = *value_sec;
@@ -312,8 +474,30 @@ ble_store_config_find_cccd(const struct ble_store_key_cccd *key)
 {
     struct ble_store_value_cccd *cccd;
     int skipped;
+    int slot;
+    int best;
     int i;
 
+    /* A single CCCD of a peer is found through the index */
+    if (key->idx == 0 && key->chr_val_handle != 0 &&
+        ble_addr_cmp(&key->peer_addr, BLE_ADDR_ANY)) {
+        best = -1;
+        slot = ble_store_config_hash(&key->peer_addr, key->chr_val_handle) %
+               BLE_STORE_CONFIG_CCCD_IDX_SZ;
+        while (ble_store_config_cccd_idx[slot] != 0) {
+            i = ble_store_config_cccd_idx[slot] - 1;
+            cccd = ble_store_config_cccds + i;
+            if ((best == -1 || i < best) &&
+                cccd->chr_val_handle == key->chr_val_handle &&
+                !ble_addr_cmp(&cccd->peer_addr, &key->peer_addr)) {
+                best = i;
+            }
+            slot = (slot + 1) % BLE_STORE_CONFIG_CCCD_IDX_SZ;
+        }
+
+        return best;
+    }
+
     skipped = 0;
     for (i = 0; i < ble_store_config_num_cccds; i++) {
         cccd = ble_store_config_cccds + i;
@@ -360,6 +544,9 @@ ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
         return rc;
     }
 
+    /* The following entries moved down, their positions changed */
+    ble_store_config_cccd_idx_build();
+
     rc = ble_store_config_persist_cccds();
     if (rc != 0) {
         return rc;
@@ -401,6 +588,11 @@ ble_store_config_write_cccd(const struct ble_store_value_cccd *value_cccd)
 
         idx = ble_store_config_num_cccds;
         ble_store_config_num_cccds++;
+        ble_store_config_idx_add(ble_store_config_cccd_idx,
+                                 BLE_STORE_CONFIG_CCCD_IDX_SZ,
+                                 ble_store_config_hash(&value_cccd->peer_addr,
+                                                       value_cccd->chr_val_handle),
+                                 idx);
     }
 
     ble_store_config_cccds[idx] = *value_cccd;
@@ -428,6 +620,8 @@ ble_store_config_read(int obj_type, const union ble_store_key *key,
 {
     int rc;
 
+    ble_store_config_ensure_loaded();
+
     switch (obj_type) {
     case BLE_STORE_OBJ_TYPE_PEER_SEC:
         /* An encryption procedure (bonding) is being attempted.  The nimble
@@ -471,6 +665,8 @@ ble_store_config_write(int obj_type, const union ble_store_value *val)
 {
     int rc;
 
+    ble_store_config_ensure_loaded();
+
     switch (obj_type) {
     case BLE_STORE_OBJ_TYPE_PEER_SEC:
         rc = ble_store_config_write_peer_sec(&val->sec);
@@ -494,6 +690,8 @@ ble_store_config_delete(int obj_type, const union ble_store_key *key)
 {
     int rc;
 
+    ble_store_config_ensure_loaded();
+
     switch (obj_type) {
     case BLE_STORE_OBJ_TYPE_PEER_SEC:
         rc = ble_store_config_delete_peer_sec(&key->sec);
@@ -512,6 +710,21 @@ ble_store_config_delete(int obj_type, const union ble_store_key *key)
     }
 }
 
+/**
+ * Writes the store changes that have not been persisted yet.  Changes are
+ * only held back when the NVS commit delay is set, otherwise this does
+ * nothing.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ESTORE_FAIL or BLE_HS_ESTORE_CAP on
+ *                                  failure, the changes stay pending.
+ */
+int
+ble_store_config_flush(void)
+{
+    return ble_store_config_persist_flush();
+}
+
 void
 ble_store_config_init(void)
 {
@@ -526,6 +739,14 @@ ble_store_config_init(void)
     ble_store_config_num_our_secs = 0;
     ble_store_config_num_peer_secs = 0;
     ble_store_config_num_cccds = 0;
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) && MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
+    ble_store_config_loaded = false;
+#endif
 
     ble_store_config_conf_init();
+
+    /* The arrays were filled from persistent storage, unless they are loaded
+     * on the first access.
+     */
+    ble_store_config_idx_build();
 }
@@ -231,6 +231,13 @@ ble_store_config_persist_cccds(void)
     return 0;
 }
 
+int
+ble_store_config_persist_flush(void)
+{
+    /* Each change is saved when it is made */
+    return 0;
+}
+
 void
 ble_store_config_conf_init(void)
 {
@@ -41,13 +41,18 @@ extern int ble_store_config_num_cccds;
 int ble_store_config_persist_our_secs(void);
 int ble_store_config_persist_peer_secs(void);
 int ble_store_config_persist_cccds(void);
+int ble_store_config_persist_flush(void);
 void ble_store_config_conf_init(void);
+#if MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
+void ble_store_config_conf_load(void);
+#endif
 
 #else
 
 static inline int ble_store_config_persist_our_secs(void)   { return 0; }
 static inline int ble_store_config_persist_peer_secs(void)  { return 0; }
 static inline int ble_store_config_persist_cccds(void)      { return 0; }
+static inline int ble_store_config_persist_flush(void)      { return 0; }
 static inline void ble_store_config_conf_init(void)         { }
 
 #if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
@@ -33,6 +33,7 @@
 #include "esp_log.h"
 #include "nvs.h"
 #include "../../../src/ble_hs_resolv_priv.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
 
 
 #define NIMBLE_NVS_STR_NAME_MAX_LEN              16
@@ -46,6 +47,18 @@ typedef uint32_t nvs_handle_t;
 
 static const char *TAG = "NIMBLE_NVS";
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0
+#define NIMBLE_NVS_SYNC_MAX_ITEMS                                           \
+    (MYNEWT_VAL(BLE_STORE_MAX_CCCDS) > (MYNEWT_VAL(BLE_STORE_MAX_BONDS) + 1) ? \
+     MYNEWT_VAL(BLE_STORE_MAX_CCCDS) : (MYNEWT_VAL(BLE_STORE_MAX_BONDS) + 1))
+
+/* Object types changed in RAM and not yet written, one bit per type */
+static uint8_t ble_nvs_dirty;
+static bool ble_nvs_commit_initialized;
+static struct ble_npl_mutex ble_nvs_commit_mutex;
+static struct ble_npl_callout ble_nvs_commit_timer;
+#endif
+
 /*****************************************************************************
  * $ MISC                                                                    *
  *****************************************************************************/
@@ -503,11 +516,222 @@ ble_nvs_restore_peer_records(void)
 }
 #endif
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0
+/*****************************************************************************
+ * $ DEFERRED COMMIT                                                         *
+ *****************************************************************************/
+
+/* Makes the NVS entries of an object type match the RAM database, using an
+ * already open handle. Entries that are also in RAM are left untouched,
+ * stale entries are erased and the remaining RAM entries are written to the
+ * free indexes.
+ * @Returns              0 if success
+ *                       BLE_HS_ESTORE_FAIL if failure
+ *                       BLE_HS_ESTORE_CAP if no space in NVS
+ */
+static int
+ble_nvs_sync_obj(nvs_handle_t nimble_handle, int obj_type)
+{
+    union {
+        union ble_store_value val;
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+        struct ble_hs_dev_records dev_rec;
+#endif
+    } cur;
+    uint8_t in_nvs[NIMBLE_NVS_SYNC_MAX_ITEMS] = {0};
+    int free_idx[NIMBLE_NVS_SYNC_MAX_ITEMS];
+    char key_string[NIMBLE_NVS_STR_NAME_MAX_LEN];
+    const uint8_t *db;
+    size_t item_size, size;
+    int db_num, num_free = 0, next_free = 0;
+    int i, idx;
+    esp_err_t err;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        db = (const uint8_t *)ble_store_config_our_secs;
+        db_num = ble_store_config_num_our_secs;
+        item_size = sizeof(struct ble_store_value_sec);
+        break;
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        db = (const uint8_t *)ble_store_config_peer_secs;
+        db_num = ble_store_config_num_peer_secs;
+        item_size = sizeof(struct ble_store_value_sec);
+        break;
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        db = (const uint8_t *)ble_store_config_cccds;
+        db_num = ble_store_config_num_cccds;
+        item_size = sizeof(struct ble_store_value_cccd);
+        break;
+#if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
+    case BLE_STORE_OBJ_TYPE_PEER_DEV_REC:
+        db = (const uint8_t *)ble_rpa_get_peer_dev_records();
+        db_num = ble_rpa_get_num_peer_dev_records();
+        item_size = sizeof(struct ble_hs_dev_records);
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    for (i = 1; i <= get_nvs_max_obj_value(obj_type); i++) {
+        get_nvs_key_string(obj_type, i, key_string);
+
+        size = sizeof(cur);
+        err = nvs_get_blob(nimble_handle, key_string, &cur, &size);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            free_idx[num_free++] = i;
+            continue;
+        } else if (err != ESP_OK) {
+            ESP_LOGE(TAG, "NVS read operation failed !!");
+            return BLE_HS_ESTORE_FAIL;
+        }
+
+        idx = -1;
+        if (size == item_size) {
+            idx = get_nvs_matching_index(&cur, (void *)db, db_num, item_size);
+        }
+        if (idx >= 0 && !in_nvs[idx]) {
+            in_nvs[idx] = 1;
+            continue;
+        }
+
+        /* Not in RAM anymore or a duplicate, free the index */
+        err = nvs_erase_key(nimble_handle, key_string);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "NVS delete operation failed !!");
+            return BLE_HS_ESTORE_FAIL;
+        }
+        free_idx[num_free++] = i;
+    }
+
+    for (i = 0; i < db_num; i++) {
+        if (in_nvs[i]) {
+            continue;
+        }
+
+        if (next_free >= num_free) {
+            ESP_LOGD(TAG, "NVS size overflow.");
+            return BLE_HS_ESTORE_CAP;
+        }
+
+        get_nvs_key_string(obj_type, free_idx[next_free++], key_string);
+        err = nvs_set_blob(nimble_handle, key_string, db + i * item_size,
+                           item_size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "NVS write operation failed !!");
+            return BLE_HS_ESTORE_FAIL;
+        }
+    }
+
+    return 0;
+}
+
+/* Writes all object types changed since the last commit with a single NVS
+ * open/commit.
+ * @Returns              0 if success
+ *                       BLE_HS_ESTORE_FAIL or BLE_HS_ESTORE_CAP if failure,
+ *                       the types not written stay pending
+ */
+static int
+ble_nvs_commit_pending(void)
+{
+    nvs_handle_t nimble_handle;
+    esp_err_t err;
+    int obj_type;
+    int rc = 0;
+
+    if (!ble_nvs_commit_initialized) {
+        return 0;
+    }
+
+    ble_npl_mutex_pend(&ble_nvs_commit_mutex, BLE_NPL_TIME_FOREVER);
+    ble_npl_callout_stop(&ble_nvs_commit_timer);
+
+    if (ble_nvs_dirty == 0) {
+        goto done;
+    }
+
+    err = nvs_open(NIMBLE_NVS_NAMESPACE, NVS_READWRITE, &nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open operation failed !!");
+        rc = BLE_HS_ESTORE_FAIL;
+        goto done;
+    }
+
+    for (obj_type = BLE_STORE_OBJ_TYPE_OUR_SEC;
+         obj_type <= BLE_STORE_OBJ_TYPE_PEER_DEV_REC; obj_type++) {
+        if (!(ble_nvs_dirty & (1 << obj_type))) {
+            continue;
+        }
+
+        rc = ble_nvs_sync_obj(nimble_handle, obj_type);
+        if (rc != 0) {
+            ESP_LOGE(TAG, "NVS operation failed while persisting obj_type = %d",
+                     obj_type);
+            break;
+        }
+        ble_nvs_dirty &= ~(1 << obj_type);
+    }
+
+    /* Commit whatever was written, even if a later type failed */
+    err = nvs_commit(nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS commit operation failed !!");
+        rc = BLE_HS_ESTORE_FAIL;
+    }
+    nvs_close(nimble_handle);
+
+done:
+    ble_npl_mutex_release(&ble_nvs_commit_mutex);
+    return rc;
+}
+
+static void
+ble_nvs_commit_timer_cb(struct ble_npl_event *ev)
+{
+    if (ble_nvs_commit_pending() != 0) {
+        /* Keep the changes in RAM and try again later */
+        ble_npl_callout_reset(&ble_nvs_commit_timer,
+            ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS)));
+    }
+}
+
+/* Marks an object type as changed and starts the commit timer if it is not
+ * already running, so a burst of updates is written once.
+ */
+static int
+ble_nvs_defer_write(int obj_type)
+{
+    ble_npl_mutex_pend(&ble_nvs_commit_mutex, BLE_NPL_TIME_FOREVER);
+    ble_nvs_dirty |= (1 << obj_type);
+    if (!ble_npl_callout_is_active(&ble_nvs_commit_timer)) {
+        ble_npl_callout_reset(&ble_nvs_commit_timer,
+            ble_npl_time_ms_to_ticks32(MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS)));
+    }
+    ble_npl_mutex_release(&ble_nvs_commit_mutex);
+    return 0;
+}
+#endif /* MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0 */
+
+int ble_store_config_persist_flush(void)
+{
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0
+    return ble_nvs_commit_pending();
+#else
+    return 0;
+#endif
+}
+
 int ble_store_config_persist_cccds(void)
 {
     int nvs_count, nvs_idx;
     union ble_store_value val;
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0
+    return ble_nvs_defer_write(BLE_STORE_OBJ_TYPE_CCCD);
+#endif
+
     nvs_count = get_nvs_db_attribute(BLE_STORE_OBJ_TYPE_CCCD, 0, NULL, 0);
     if (nvs_count == -1) {
         ESP_LOGE(TAG, "NVS operation failed while persisting CCCD");
@@ -539,6 +763,10 @@ int ble_store_config_persist_peer_secs(void)
     int nvs_count, nvs_idx;
     union ble_store_value val;
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0 && MYNEWT_VAL(BLE_STORE_NVS_DEFER_SEC)
+    return ble_nvs_defer_write(BLE_STORE_OBJ_TYPE_PEER_SEC);
+#endif
+
     nvs_count = get_nvs_db_attribute(BLE_STORE_OBJ_TYPE_PEER_SEC, 0, NULL, 0);
     if (nvs_count == -1) {
         ESP_LOGE(TAG, "NVS operation failed while persisting peer sec");
@@ -570,6 +798,10 @@ int ble_store_config_persist_our_secs(void)
     int nvs_count, nvs_idx;
     union ble_store_value val;
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0 && MYNEWT_VAL(BLE_STORE_NVS_DEFER_SEC)
+    return ble_nvs_defer_write(BLE_STORE_OBJ_TYPE_OUR_SEC);
+#endif
+
     nvs_count = get_nvs_db_attribute(BLE_STORE_OBJ_TYPE_OUR_SEC, 0, NULL, 0);
     if (nvs_count == -1) {
         ESP_LOGE(TAG, "NVS operation failed while persisting our sec");
@@ -604,6 +836,10 @@ int ble_store_persist_peer_records(void)
     int ble_store_num_peer_dev_rec = ble_rpa_get_num_peer_dev_records();
     struct ble_hs_dev_records *peer_dev_rec = ble_rpa_get_peer_dev_records();
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0 && MYNEWT_VAL(BLE_STORE_NVS_DEFER_SEC)
+    return ble_nvs_defer_write(BLE_STORE_OBJ_TYPE_PEER_DEV_REC);
+#endif
+
     nvs_count = get_nvs_db_attribute(BLE_STORE_OBJ_TYPE_PEER_DEV_REC, 0, NULL, 0);
     if (nvs_count == -1) {
         ESP_LOGE(TAG, "NVS operation failed while persisting peer_dev_rec");
@@ -636,18 +872,43 @@ void ble_store_config_conf_init(void)
 {
     int err;
 
+#if MYNEWT_VAL(BLE_STORE_NVS_COMMIT_DELAY_MS) > 0
+    if (!ble_nvs_commit_initialized) {
+        ble_npl_mutex_init(&ble_nvs_commit_mutex);
+        ble_npl_callout_init(&ble_nvs_commit_timer, nimble_port_get_dflt_eventq(),
+                             ble_nvs_commit_timer_cb, NULL);
+        ble_nvs_commit_initialized = true;
+    }
+    ble_nvs_dirty = 0;
+#endif
+
+#if !MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
     err = ble_nvs_restore_sec_keys();
     if (err != 0) {
         ESP_LOGE(TAG, "NVS operation failed, can't retrieve the bonding info");
     }
+#endif
 #if MYNEWT_VAL(BLE_HOST_BASED_PRIVACY)
     err = ble_nvs_restore_peer_records();
     if (err != 0) {
         ESP_LOGE(TAG, "NVS operation failed, can't retrieve the peer records");
     }
 #endif
+    (void)err;
 }
 
+#if MYNEWT_VAL(BLE_STORE_NVS_LAZY_LOAD)
+/* Fills the RAM database with the keys and CCCDs stored in NVS, called on the
+ * first access to the store.
+ */
+void ble_store_config_conf_load(void)
+{
+    if (ble_nvs_restore_sec_keys() != 0) {
+        ESP_LOGE(TAG, "NVS operation failed, can't retrieve the bonding info");
+    }
+}
+#endif
+
 /***************************************************************************************/
 #endif /* MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) */
 #endif /* ESP_PLATFORM */
\ No newline at end of file
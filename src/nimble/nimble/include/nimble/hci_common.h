@@ -1276,6 +1276,9 @@ struct ble_hci_vs_rd_static_addr_rp {
 #define BLE_HCI_LE_SET_DATA_OPER_COMPLETE   (3)
 #define BLE_HCI_LE_SET_DATA_OPER_UNCHANGED  (4)
 
+#define BLE_HCI_LE_SET_DATA_FRAG_PREF_ALLOW     (0)
+#define BLE_HCI_LE_SET_DATA_FRAG_PREF_NO_FRAG   (1)
+
 /* --- LE set extended scan response data (OCF 0x0038) */
 #define BLE_HCI_MAX_EXT_SCAN_RSP_DATA_LEN           (251)
 
@@ -50,7 +50,11 @@ enum ble_npl_error {
 typedef enum ble_npl_error ble_npl_error_t;
 
 /* Include OS-specific definitions */
+#if defined(NIMBLE_NPL_POSIX)
+#include "nimble/porting/npl/posix/include/nimble/nimble_npl_os.h"
+#else
 #include "nimble/porting/npl/freertos/include/nimble/nimble_npl_os.h"
+#endif
 
 /*
  * Generic
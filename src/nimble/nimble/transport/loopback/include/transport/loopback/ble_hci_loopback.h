@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HCI_LOOPBACK_
+#define H_BLE_HCI_LOOPBACK_
+
+#include "nimble/nimble/include/nimble/ble_hci_trans.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts the in-process loopback controller. It answers the commands of the
+ * host startup sequence and completes every other command successfully, so
+ * the host syncs and can advertise and scan without a Bluetooth adapter. No
+ * packets go over the air; there are no advertising reports or connections.
+ *
+ * @param addr                  The public address the controller reports,
+ *                                  6 bytes in little endian order.
+ *
+ * @return                      0 on success; an errno value on failure.
+ */
+int ble_hci_loop_init(const uint8_t *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
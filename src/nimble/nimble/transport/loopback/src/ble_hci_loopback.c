@@ -0,0 +1,486 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * In-process loopback controller for the POSIX porting layer, selected by
+ * defining NIMBLE_HCI_LOOPBACK instead of using the HCI socket transport.
+ * A thread takes the commands in order and answers each with a Command
+ * Complete or Command Status, reporting the free command slots as the
+ * Num_HCI_Command_Packets.
+ */
+
+#if defined(NIMBLE_NPL_POSIX) && defined(NIMBLE_HCI_LOOPBACK)
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+#include "nimble/porting/nimble/include/os/os.h"
+#include "nimble/porting/nimble/include/os/os_mbuf.h"
+#include "nimble/nimble/include/nimble/ble.h"
+#include "nimble/nimble/include/nimble/hci_common.h"
+#include "nimble/nimble/include/nimble/ble_hci_trans.h"
+#include "../include/transport/loopback/ble_hci_loopback.h"
+
+/* The number of commands the controller queues, its Num_HCI_Command_Packets. */
+#define BLE_HCI_LOOP_CMD_SLOTS      4
+
+/* The ACL buffers reported to the host. */
+#define BLE_HCI_LOOP_ACL_LEN        251
+#define BLE_HCI_LOOP_ACL_PKTS       4
+
+/* LE Encryption, Data Packet Length Extension and LL Privacy. */
+#define BLE_HCI_LOOP_LE_FEATURES    0x0000000000000061ULL
+
+/* LE Supported (Controller) and Simultaneous LE and BR/EDR. */
+#define BLE_HCI_LOOP_FEATURES       0x0000006000000000ULL
+
+static uint8_t ble_hci_loop_addr[BLE_DEV_ADDR_LEN];
+
+static pthread_mutex_t ble_hci_loop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ble_hci_loop_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t ble_hci_loop_thread;
+
+static uint8_t ble_hci_loop_cmds[BLE_HCI_LOOP_CMD_SLOTS][BLE_HCI_TRANS_CMD_SZ];
+static uint8_t ble_hci_loop_cmd_head;
+static uint8_t ble_hci_loop_cmd_count;
+
+static ble_hci_trans_rx_cmd_fn *ble_hci_loop_rx_cmd_hs_cb;
+static void *ble_hci_loop_rx_cmd_hs_arg;
+
+static ble_hci_trans_rx_acl_fn *ble_hci_loop_rx_acl_hs_cb;
+static void *ble_hci_loop_rx_acl_hs_arg;
+
+static struct os_mempool ble_hci_loop_cmd_pool;
+static os_membuf_t ble_hci_loop_cmd_buf[
+        OS_MEMPOOL_SIZE(1, BLE_HCI_TRANS_CMD_SZ)
+];
+
+static struct os_mempool ble_hci_loop_evt_hi_pool;
+static os_membuf_t ble_hci_loop_evt_hi_buf[
+    OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HCI_EVT_HI_BUF_COUNT),
+                    MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE))
+];
+
+static struct os_mempool ble_hci_loop_evt_lo_pool;
+static os_membuf_t ble_hci_loop_evt_lo_buf[
+        OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HCI_EVT_LO_BUF_COUNT),
+                        MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE))
+];
+
+void
+ble_hci_trans_cfg_hs(ble_hci_trans_rx_cmd_fn *cmd_cb,
+                     void *cmd_arg,
+                     ble_hci_trans_rx_acl_fn *acl_cb,
+                     void *acl_arg)
+{
+    ble_hci_loop_rx_cmd_hs_cb = cmd_cb;
+    ble_hci_loop_rx_cmd_hs_arg = cmd_arg;
+    ble_hci_loop_rx_acl_hs_cb = acl_cb;
+    ble_hci_loop_rx_acl_hs_arg = acl_arg;
+}
+
+int
+ble_hci_trans_hs_cmd_tx(uint8_t *cmd)
+{
+    uint8_t idx;
+    int rc;
+
+    pthread_mutex_lock(&ble_hci_loop_lock);
+    if (ble_hci_loop_cmd_count == BLE_HCI_LOOP_CMD_SLOTS) {
+        /* The host sent more commands than it had credits for. */
+        rc = BLE_ERR_MEM_CAPACITY;
+    } else {
+        idx = (ble_hci_loop_cmd_head + ble_hci_loop_cmd_count) %
+              BLE_HCI_LOOP_CMD_SLOTS;
+        memcpy(ble_hci_loop_cmds[idx], cmd, sizeof(struct ble_hci_cmd) + cmd[2]);
+        ble_hci_loop_cmd_count++;
+        pthread_cond_signal(&ble_hci_loop_cond);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&ble_hci_loop_lock);
+
+    ble_hci_trans_buf_free(cmd);
+    return rc;
+}
+
+int
+ble_hci_trans_hs_acl_tx(struct os_mbuf *om)
+{
+    /* There are no connections to send data on. */
+    os_mbuf_free_chain(om);
+    return 0;
+}
+
+uint8_t *
+ble_hci_trans_buf_alloc(int type)
+{
+    uint8_t *buf;
+
+    switch (type) {
+    case BLE_HCI_TRANS_BUF_CMD:
+        buf = os_memblock_get(&ble_hci_loop_cmd_pool);
+        break;
+
+    case BLE_HCI_TRANS_BUF_EVT_HI:
+        buf = os_memblock_get(&ble_hci_loop_evt_hi_pool);
+        if (buf == NULL) {
+            /* If no high-priority event buffers remain, try to grab a
+             * low-priority one.
+             */
+            buf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+        }
+        break;
+
+    case BLE_HCI_TRANS_BUF_EVT_LO:
+        buf = os_memblock_get(&ble_hci_loop_evt_lo_pool);
+        break;
+
+    default:
+        assert(0);
+        buf = NULL;
+    }
+
+    return buf;
+}
+
+void
+ble_hci_trans_buf_free(uint8_t *buf)
+{
+    int rc;
+
+    if (os_memblock_from(&ble_hci_loop_evt_hi_pool, buf)) {
+        rc = os_memblock_put(&ble_hci_loop_evt_hi_pool, buf);
+        assert(rc == 0);
+    } else if (os_memblock_from(&ble_hci_loop_evt_lo_pool, buf)) {
+        rc = os_memblock_put(&ble_hci_loop_evt_lo_pool, buf);
+        assert(rc == 0);
+    } else {
+        assert(os_memblock_from(&ble_hci_loop_cmd_pool, buf));
+        rc = os_memblock_put(&ble_hci_loop_cmd_pool, buf);
+        assert(rc == 0);
+    }
+    (void)rc;
+}
+
+/**
+ * Unsupported; the loopback transport does not have a dedicated ACL data
+ * packet pool.
+ */
+int
+ble_hci_trans_set_acl_free_cb(os_mempool_put_fn *cb, void *arg)
+{
+    return BLE_ERR_UNSUPPORTED;
+}
+
+int
+ble_hci_trans_reset(void)
+{
+    /* No work to do, the host resets the controller with an HCI command. */
+    return 0;
+}
+
+static void
+ble_hci_loop_send_evt(uint8_t evcode, const void *params, uint8_t len)
+{
+    struct ble_hci_ev *ev;
+
+    ev = (void *)ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_HI);
+    if (ev == NULL) {
+        return;
+    }
+
+    ev->opcode = evcode;
+    ev->length = len;
+    memcpy(ev->data, params, len);
+
+    if (ble_hci_loop_rx_cmd_hs_cb == NULL ||
+        ble_hci_loop_rx_cmd_hs_cb((uint8_t *)ev, ble_hci_loop_rx_cmd_hs_arg) != 0) {
+        ble_hci_trans_buf_free((uint8_t *)ev);
+    }
+}
+
+static void
+ble_hci_loop_cmd_status(uint16_t opcode, uint8_t status, uint8_t credits)
+{
+    struct ble_hci_ev_command_status ev;
+
+    ev.status = status;
+    ev.num_packets = credits;
+    ev.opcode = htole16(opcode);
+
+    ble_hci_loop_send_evt(BLE_HCI_EVCODE_COMMAND_STATUS, &ev, sizeof(ev));
+}
+
+static void
+ble_hci_loop_cmd_complete(uint16_t opcode, uint8_t status, uint8_t credits,
+                          const void *rsp, uint8_t rsp_len)
+{
+    uint8_t buf[sizeof(struct ble_hci_ev_command_complete) + 64];
+    struct ble_hci_ev_command_complete *ev = (void *)buf;
+
+    assert(rsp_len <= sizeof(buf) - sizeof(*ev));
+
+    ev->num_packets = credits;
+    ev->opcode = htole16(opcode);
+    ev->status = status;
+    memcpy(ev->return_params, rsp, rsp_len);
+
+    ble_hci_loop_send_evt(BLE_HCI_EVCODE_COMMAND_COMPLETE, buf,
+                          sizeof(*ev) + rsp_len);
+}
+
+/* A pending connection attempt ends with an LE Connection Complete when cancelled. */
+static void
+ble_hci_loop_conn_cancelled(void)
+{
+    struct ble_hci_ev_le_subev_conn_complete ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.subev_code = BLE_HCI_LE_SUBEV_CONN_COMPLETE;
+    ev.status = BLE_ERR_UNK_CONN_ID;
+
+    ble_hci_loop_send_evt(BLE_HCI_EVCODE_LE_META, &ev, sizeof(ev));
+}
+
+static void
+ble_hci_loop_process(const struct ble_hci_cmd *cmd, uint8_t credits)
+{
+    union {
+        struct ble_hci_ip_rd_local_ver_rp local_ver;
+        struct ble_hci_ip_rd_loc_supp_cmd_rp supp_cmd;
+        struct ble_hci_ip_rd_loc_supp_feat_rp supp_feat;
+        struct ble_hci_ip_rd_bd_addr_rp bd_addr;
+        struct ble_hci_le_rd_buf_size_rp buf_size;
+        struct ble_hci_le_rd_loc_supp_feat_rp le_supp_feat;
+        struct ble_hci_le_rd_white_list_rp wl_size;
+        struct ble_hci_le_rand_rp rand;
+        struct ble_hci_le_rd_supp_states_rp supp_states;
+        struct ble_hci_le_rd_sugg_def_data_len_rp sugg_data_len;
+        struct ble_hci_le_rd_resolv_list_size_rp rl_size;
+        struct ble_hci_le_rd_max_data_len_rp max_data_len;
+        struct ble_hci_le_rd_adv_chan_txpwr_rp adv_txpwr;
+        struct ble_hci_le_set_ext_adv_params_rp ext_adv_params;
+        struct ble_hci_le_rd_max_adv_data_len_rp max_adv_data_len;
+        struct ble_hci_le_rd_num_of_adv_sets_rp num_adv_sets;
+        struct ble_hci_le_rd_transmit_power_rp txpwr;
+    } rsp;
+    uint16_t opcode = le16toh(cmd->opcode);
+    uint8_t status = BLE_ERR_SUCCESS;
+    uint8_t rsp_len = 0;
+    int i;
+
+    memset(&rsp, 0, sizeof(rsp));
+
+    switch (opcode) {
+    /* Commands answered with a Command Status. */
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CREATE_CONN):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_EXT_CREATE_CONN):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_PERIODIC_ADV_CREATE_SYNC):
+        /* Nothing is ever found, the host cancels on its timeout. */
+        ble_hci_loop_cmd_status(opcode, BLE_ERR_SUCCESS, credits);
+        return;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LINK_CTRL, BLE_HCI_OCF_DISCONNECT_CMD):
+    case BLE_HCI_OP(BLE_HCI_OGF_LINK_CTRL, BLE_HCI_OCF_RD_REM_VER_INFO):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CONN_UPDATE):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_REM_FEAT):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_START_ENCRYPT):
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PHY):
+        ble_hci_loop_cmd_status(opcode, BLE_ERR_UNK_CONN_ID, credits);
+        return;
+
+    /* Commands answered with a Command Complete with return parameters. */
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOCAL_VER):
+        rsp.local_ver.hci_ver = BLE_HCI_VER_BCS_5_0;
+        rsp.local_ver.lmp_ver = BLE_HCI_VER_BCS_5_0;
+        /* Reserved for testing. */
+        rsp.local_ver.manufacturer = htole16(0xFFFF);
+        rsp_len = sizeof(rsp.local_ver);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD):
+        rsp_len = sizeof(rsp.supp_cmd);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT):
+        rsp.supp_feat.features = htole64(BLE_HCI_LOOP_FEATURES);
+        rsp_len = sizeof(rsp.supp_feat);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_BD_ADDR):
+        memcpy(rsp.bd_addr.addr, ble_hci_loop_addr, BLE_DEV_ADDR_LEN);
+        rsp_len = sizeof(rsp.bd_addr);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_BUF_SIZE):
+        rsp.buf_size.data_len = htole16(BLE_HCI_LOOP_ACL_LEN);
+        rsp.buf_size.data_packets = BLE_HCI_LOOP_ACL_PKTS;
+        rsp_len = sizeof(rsp.buf_size);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT):
+        rsp.le_supp_feat.features = htole64(BLE_HCI_LOOP_LE_FEATURES);
+        rsp_len = sizeof(rsp.le_supp_feat);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_WHITE_LIST_SIZE):
+        rsp.wl_size.size = 8;
+        rsp_len = sizeof(rsp.wl_size);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RAND):
+        for (i = 0; i < (int)sizeof(rsp.rand); i++) {
+            ((uint8_t *)&rsp.rand)[i] = rand();
+        }
+        rsp_len = sizeof(rsp.rand);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_SUPP_STATES):
+        rsp_len = sizeof(rsp.supp_states);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_SUGG_DEF_DATA_LEN):
+        rsp.sugg_data_len.max_tx_octets = htole16(27);
+        rsp.sugg_data_len.max_tx_time = htole16(328);
+        rsp_len = sizeof(rsp.sugg_data_len);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_RESOLV_LIST_SIZE):
+        rsp.rl_size.size = 8;
+        rsp_len = sizeof(rsp.rl_size);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_MAX_DATA_LEN):
+        rsp.max_data_len.max_tx_octests = htole16(251);
+        rsp.max_data_len.max_tx_time = htole16(2120);
+        rsp.max_data_len.max_rx_octests = htole16(251);
+        rsp.max_data_len.max_rx_time = htole16(2120);
+        rsp_len = sizeof(rsp.max_data_len);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_ADV_CHAN_TXPWR):
+        rsp_len = sizeof(rsp.adv_txpwr);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_EXT_ADV_PARAM):
+        rsp_len = sizeof(rsp.ext_adv_params);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_MAX_ADV_DATA_LEN):
+        rsp.max_adv_data_len.max_adv_data_len = htole16(1650);
+        rsp_len = sizeof(rsp.max_adv_data_len);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_NUM_OF_ADV_SETS):
+        rsp.num_adv_sets.num_sets = 4;
+        rsp_len = sizeof(rsp.num_adv_sets);
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_TRANSMIT_POWER):
+        rsp.txpwr.min_tx_power = -20;
+        rsp.txpwr.max_tx_power = 10;
+        rsp_len = sizeof(rsp.txpwr);
+        break;
+
+    /* Not emulated, the host does its own AES. */
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_ENCRYPT):
+        status = BLE_ERR_UNKNOWN_HCI_CMD;
+        break;
+
+    case BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CREATE_CONN_CANCEL):
+        ble_hci_loop_cmd_complete(opcode, BLE_ERR_SUCCESS, credits, NULL, 0);
+        ble_hci_loop_conn_cancelled();
+        return;
+
+    default:
+        if (BLE_HCI_OGF(opcode) == BLE_HCI_OGF_VENDOR) {
+            status = BLE_ERR_UNKNOWN_HCI_CMD;
+        }
+        /* Everything else only returns a status, settings are accepted. */
+        break;
+    }
+
+    ble_hci_loop_cmd_complete(opcode, status, credits, &rsp, rsp_len);
+}
+
+static void *
+ble_hci_loop_task(void *arg)
+{
+    uint8_t cmd[BLE_HCI_TRANS_CMD_SZ];
+    uint8_t credits;
+
+    while (1) {
+        pthread_mutex_lock(&ble_hci_loop_lock);
+        while (ble_hci_loop_cmd_count == 0) {
+            pthread_cond_wait(&ble_hci_loop_cond, &ble_hci_loop_lock);
+        }
+
+        memcpy(cmd, ble_hci_loop_cmds[ble_hci_loop_cmd_head], sizeof(cmd));
+        ble_hci_loop_cmd_head = (ble_hci_loop_cmd_head + 1) % BLE_HCI_LOOP_CMD_SLOTS;
+        ble_hci_loop_cmd_count--;
+        credits = BLE_HCI_LOOP_CMD_SLOTS - ble_hci_loop_cmd_count;
+        pthread_mutex_unlock(&ble_hci_loop_lock);
+
+        ble_hci_loop_process((const struct ble_hci_cmd *)cmd, credits);
+    }
+
+    return NULL;
+}
+
+int
+ble_hci_loop_init(const uint8_t *addr)
+{
+    int rc;
+
+    rc = os_mempool_init(&ble_hci_loop_cmd_pool,
+                         1,
+                         BLE_HCI_TRANS_CMD_SZ,
+                         ble_hci_loop_cmd_buf,
+                         "ble_hci_loop_cmd_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    rc = os_mempool_init(&ble_hci_loop_evt_hi_pool,
+                         MYNEWT_VAL(BLE_HCI_EVT_HI_BUF_COUNT),
+                         MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE),
+                         ble_hci_loop_evt_hi_buf,
+                         "ble_hci_loop_evt_hi_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    rc = os_mempool_init(&ble_hci_loop_evt_lo_pool,
+                         MYNEWT_VAL(BLE_HCI_EVT_LO_BUF_COUNT),
+                         MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE),
+                         ble_hci_loop_evt_lo_buf,
+                         "ble_hci_loop_evt_lo_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    memcpy(ble_hci_loop_addr, addr, BLE_DEV_ADDR_LEN);
+
+    return pthread_create(&ble_hci_loop_thread, NULL, ble_hci_loop_task, NULL);
+}
+
+#endif /* NIMBLE_NPL_POSIX && NIMBLE_HCI_LOOPBACK */
@@ -16,7 +16,7 @@
  * specific language governing permissions and limitations
  * under the License.
  */
-#ifndef ESP_PLATFORM
+#if !defined(ESP_PLATFORM) && !defined(NIMBLE_NPL_POSIX)
 
 #include <assert.h>
 #include <errno.h>
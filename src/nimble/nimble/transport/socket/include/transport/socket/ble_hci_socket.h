@@ -0,0 +1,44 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HCI_SOCKET_
+#define H_BLE_HCI_SOCKET_
+
+#include "nimble/nimble/include/nimble/ble_hci_trans.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opens the HCI user channel of a Linux Bluetooth controller and starts the
+ * thread receiving its events and data. The controller must be down
+ * (`hciconfig hci0 down`) and the process needs the CAP_NET_ADMIN capability.
+ *
+ * @param dev                   The index of the controller, 0 for hci0.
+ *
+ * @return                      0 on success; an errno value on failure.
+ */
+int ble_hci_sock_init(uint16_t dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * HCI transport to a Linux Bluetooth controller through the HCI user
+ * channel socket, used with the POSIX porting layer to run the host on a PC.
+ */
+
+#if defined(NIMBLE_NPL_POSIX) && !defined(NIMBLE_HCI_LOOPBACK)
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+#include "nimble/porting/nimble/include/os/os.h"
+#include "nimble/porting/nimble/include/os/os_mbuf.h"
+#include "nimble/nimble/include/nimble/ble.h"
+#include "nimble/nimble/include/nimble/hci_common.h"
+#include "nimble/nimble/include/nimble/ble_hci_trans.h"
+#include "../include/transport/socket/ble_hci_socket.h"
+
+#ifndef AF_BLUETOOTH
+#define AF_BLUETOOTH            31
+#endif
+
+#define BTPROTO_HCI             1
+#define HCI_CHANNEL_USER        1
+
+#define BLE_HCI_SOCK_CMD        0x01
+#define BLE_HCI_SOCK_ACL        0x02
+#define BLE_HCI_SOCK_EVT        0x04
+
+/* The largest ACL packet with its indicator and header. */
+#define BLE_HCI_SOCK_RX_BUF_SZ  (1 + BLE_HCI_DATA_HDR_SZ + UINT16_MAX)
+
+struct ble_hci_sock_addr {
+    sa_family_t hci_family;
+    unsigned short hci_dev;
+    unsigned short hci_channel;
+};
+
+static int ble_hci_sock_fd = -1;
+static pthread_t ble_hci_sock_rx_thread;
+static uint8_t ble_hci_sock_rx_buf[BLE_HCI_SOCK_RX_BUF_SZ];
+
+static ble_hci_trans_rx_cmd_fn *ble_hci_sock_rx_cmd_hs_cb;
+static void *ble_hci_sock_rx_cmd_hs_arg;
+
+static ble_hci_trans_rx_acl_fn *ble_hci_sock_rx_acl_hs_cb;
+static void *ble_hci_sock_rx_acl_hs_arg;
+
+static struct os_mempool ble_hci_sock_cmd_pool;
+static os_membuf_t ble_hci_sock_cmd_buf[
+        OS_MEMPOOL_SIZE(1, BLE_HCI_TRANS_CMD_SZ)
+];
+
+static struct os_mempool ble_hci_sock_evt_hi_pool;
+static os_membuf_t ble_hci_sock_evt_hi_buf[
+    OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HCI_EVT_HI_BUF_COUNT),
+                    MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE))
+];
+
+static struct os_mempool ble_hci_sock_evt_lo_pool;
+static os_membuf_t ble_hci_sock_evt_lo_buf[
+        OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HCI_EVT_LO_BUF_COUNT),
+                        MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE))
+];
+
+void
+ble_hci_trans_cfg_hs(ble_hci_trans_rx_cmd_fn *cmd_cb,
+                     void *cmd_arg,
+                     ble_hci_trans_rx_acl_fn *acl_cb,
+                     void *acl_arg)
+{
+    ble_hci_sock_rx_cmd_hs_cb = cmd_cb;
+    ble_hci_sock_rx_cmd_hs_arg = cmd_arg;
+    ble_hci_sock_rx_acl_hs_cb = acl_cb;
+    ble_hci_sock_rx_acl_hs_arg = acl_arg;
+}
+
+static int
+ble_hci_sock_write(struct iovec *iov, int iovcnt)
+{
+    ssize_t len;
+
+    do {
+        len = writev(ble_hci_sock_fd, iov, iovcnt);
+    } while (len < 0 && errno == EINTR);
+
+    return len < 0 ? BLE_ERR_HW_FAIL : 0;
+}
+
+int
+ble_hci_trans_hs_cmd_tx(uint8_t *cmd)
+{
+    uint8_t ind = BLE_HCI_SOCK_CMD;
+    struct iovec iov[2];
+    int rc;
+
+    iov[0].iov_base = &ind;
+    iov[0].iov_len = 1;
+    iov[1].iov_base = cmd;
+    iov[1].iov_len = sizeof(struct ble_hci_cmd) + cmd[2];
+
+    rc = ble_hci_sock_write(iov, 2);
+    ble_hci_trans_buf_free(cmd);
+    return rc;
+}
+
+int
+ble_hci_trans_hs_acl_tx(struct os_mbuf *om)
+{
+    static uint8_t buf[1 + BLE_HCI_DATA_HDR_SZ + UINT16_MAX];
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    struct iovec iov[1];
+    int rc;
+
+    /* Only the host task sends data, so the buffer is not shared. */
+    buf[0] = BLE_HCI_SOCK_ACL;
+    os_mbuf_copydata(om, 0, len, buf + 1);
+    os_mbuf_free_chain(om);
+
+    iov[0].iov_base = buf;
+    iov[0].iov_len = 1 + len;
+
+    rc = ble_hci_sock_write(iov, 1);
+    return rc;
+}
+
+uint8_t *
+ble_hci_trans_buf_alloc(int type)
+{
+    uint8_t *buf;
+
+    switch (type) {
+    case BLE_HCI_TRANS_BUF_CMD:
+        buf = os_memblock_get(&ble_hci_sock_cmd_pool);
+        break;
+
+    case BLE_HCI_TRANS_BUF_EVT_HI:
+        buf = os_memblock_get(&ble_hci_sock_evt_hi_pool);
+        if (buf == NULL) {
+            /* If no high-priority event buffers remain, try to grab a
+             * low-priority one.
+             */
+            buf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+        }
+        break;
+
+    case BLE_HCI_TRANS_BUF_EVT_LO:
+        buf = os_memblock_get(&ble_hci_sock_evt_lo_pool);
+        break;
+
+    default:
+        assert(0);
+        buf = NULL;
+    }
+
+    return buf;
+}
+
+void
+ble_hci_trans_buf_free(uint8_t *buf)
+{
+    int rc;
+
+    if (os_memblock_from(&ble_hci_sock_evt_hi_pool, buf)) {
+        rc = os_memblock_put(&ble_hci_sock_evt_hi_pool, buf);
+        assert(rc == 0);
+    } else if (os_memblock_from(&ble_hci_sock_evt_lo_pool, buf)) {
+        rc = os_memblock_put(&ble_hci_sock_evt_lo_pool, buf);
+        assert(rc == 0);
+    } else {
+        assert(os_memblock_from(&ble_hci_sock_cmd_pool, buf));
+        rc = os_memblock_put(&ble_hci_sock_cmd_pool, buf);
+        assert(rc == 0);
+    }
+    (void)rc;
+}
+
+/**
+ * Unsupported; the socket transport does not have a dedicated ACL data packet
+ * pool.
+ */
+int
+ble_hci_trans_set_acl_free_cb(os_mempool_put_fn *cb, void *arg)
+{
+    return BLE_ERR_UNSUPPORTED;
+}
+
+int
+ble_hci_trans_reset(void)
+{
+    /* No work to do, the host resets the controller with an HCI command. */
+    return 0;
+}
+
+static void
+ble_hci_sock_rx_evt(const uint8_t *data, size_t len)
+{
+    uint8_t *buf;
+    int type;
+
+    if (len < sizeof(struct ble_hci_ev) || len > MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE) ||
+        data[1] + sizeof(struct ble_hci_ev) != len) {
+        return;
+    }
+
+    /* Advertising reports can be dropped, other events take any buffer left. */
+    if (data[0] == BLE_HCI_EVCODE_LE_META && len > sizeof(struct ble_hci_ev) &&
+        (data[2] == BLE_HCI_LE_SUBEV_ADV_RPT || data[2] == BLE_HCI_LE_SUBEV_EXT_ADV_RPT)) {
+        type = BLE_HCI_TRANS_BUF_EVT_LO;
+    } else {
+        type = BLE_HCI_TRANS_BUF_EVT_HI;
+    }
+
+    buf = ble_hci_trans_buf_alloc(type);
+    if (buf == NULL) {
+        return;
+    }
+
+    memcpy(buf, data, len);
+    if (ble_hci_sock_rx_cmd_hs_cb == NULL ||
+        ble_hci_sock_rx_cmd_hs_cb(buf, ble_hci_sock_rx_cmd_hs_arg) != 0) {
+        ble_hci_trans_buf_free(buf);
+    }
+}
+
+static void
+ble_hci_sock_rx_acl(const uint8_t *data, size_t len)
+{
+    struct os_mbuf *om;
+
+    if (len < BLE_HCI_DATA_HDR_SZ || get_le16(data + 2) + BLE_HCI_DATA_HDR_SZ != len) {
+        return;
+    }
+
+    om = os_msys_get_pkthdr(len, sizeof(struct ble_mbuf_hdr));
+    if (om == NULL) {
+        return;
+    }
+
+    if (os_mbuf_append(om, data, len) != 0 || ble_hci_sock_rx_acl_hs_cb == NULL) {
+        os_mbuf_free_chain(om);
+        return;
+    }
+
+    /* The host takes the mbuf, also on failure. */
+    ble_hci_sock_rx_acl_hs_cb(om, ble_hci_sock_rx_acl_hs_arg);
+}
+
+static void *
+ble_hci_sock_rx_task(void *arg)
+{
+    ssize_t len;
+
+    while (1) {
+        /* The user channel delivers one packet per read. */
+        len = read(ble_hci_sock_fd, ble_hci_sock_rx_buf, sizeof(ble_hci_sock_rx_buf));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (len < 1) {
+            continue;
+        }
+
+        switch (ble_hci_sock_rx_buf[0]) {
+        case BLE_HCI_SOCK_EVT:
+            ble_hci_sock_rx_evt(ble_hci_sock_rx_buf + 1, len - 1);
+            break;
+
+        case BLE_HCI_SOCK_ACL:
+            ble_hci_sock_rx_acl(ble_hci_sock_rx_buf + 1, len - 1);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int
+ble_hci_sock_init(uint16_t dev)
+{
+    struct ble_hci_sock_addr addr;
+    int rc;
+
+    rc = os_mempool_init(&ble_hci_sock_cmd_pool,
+                         1,
+                         BLE_HCI_TRANS_CMD_SZ,
+                         ble_hci_sock_cmd_buf,
+                         "ble_hci_sock_cmd_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    rc = os_mempool_init(&ble_hci_sock_evt_hi_pool,
+                         MYNEWT_VAL(BLE_HCI_EVT_HI_BUF_COUNT),
+                         MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE),
+                         ble_hci_sock_evt_hi_buf,
+                         "ble_hci_sock_evt_hi_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    rc = os_mempool_init(&ble_hci_sock_evt_lo_pool,
+                         MYNEWT_VAL(BLE_HCI_EVT_LO_BUF_COUNT),
+                         MYNEWT_VAL(BLE_HCI_EVT_BUF_SIZE),
+                         ble_hci_sock_evt_lo_buf,
+                         "ble_hci_sock_evt_lo_pool");
+    if (rc != 0) {
+        return EINVAL;
+    }
+
+    ble_hci_sock_fd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+    if (ble_hci_sock_fd < 0) {
+        return errno;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.hci_family = AF_BLUETOOTH;
+    addr.hci_dev = dev;
+    addr.hci_channel = HCI_CHANNEL_USER;
+
+    if (bind(ble_hci_sock_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        rc = errno;
+        close(ble_hci_sock_fd);
+        ble_hci_sock_fd = -1;
+        return rc;
+    }
+
+    rc = pthread_create(&ble_hci_sock_rx_thread, NULL, ble_hci_sock_rx_task, NULL);
+    if (rc != 0) {
+        close(ble_hci_sock_fd);
+        ble_hci_sock_fd = -1;
+        return rc;
+    }
+
+    return 0;
+}
+
+#endif /* NIMBLE_NPL_POSIX && !NIMBLE_HCI_LOOPBACK */
@@ -797,6 +797,34 @@ int os_msys_count(void);
  */
 int os_msys_num_free(void);
 
+/**
+ * A recommended msys pool, see os_msys_calibrate().
+ */
+struct os_msys_tier_cfg {
+    /** Size of each block including the mbuf header, MSYS_n_BLOCK_SIZE */
+    uint16_t block_size;
+    /** Number of blocks in the pool, MSYS_n_BLOCK_COUNT */
+    uint16_t block_count;
+};
+
+/**
+ * Recommend msys pool sizes from the packets seen since startup or the last
+ * call to os_msys_calibrate_reset().  Requires MSYS_CALIBRATE to be enabled,
+ * the size of each msys packet is recorded when it is freed.
+ *
+ * @param tiers     The array to fill with the recommended pools, sorted
+ *                      from the smallest to the largest block size.
+ * @param max_tiers The number of entries in the array.
+ *
+ * @return The number of recommended pools, 0 if no packets were recorded.
+ */
+int os_msys_calibrate(struct os_msys_tier_cfg *tiers, int max_tiers);
+
+/**
+ * Clear the packet sizes recorded for os_msys_calibrate().
+ */
+void os_msys_calibrate_reset(void);
+
 /**
  * Initialize a pool of mbufs.
  *
@@ -1125,6 +1153,94 @@ int os_mbuf_widen(struct os_mbuf *om, uint16_t off, uint16_t len);
 struct os_mbuf *os_mbuf_pack_chains(struct os_mbuf *m1, struct os_mbuf *m2);
 
 #endif
+
+/**
+ * A read position in an mbuf chain.  The cursor remembers the mbuf holding
+ * the position, so a chain that is read in order is walked only once instead
+ * of from the head for every read.  The chain must not be changed while the
+ * cursor is in use, except by appending data to its end.
+ */
+struct os_mbuf_cursor {
+    /** The head of the chain */
+    const struct os_mbuf *omc_head;
+    /** The mbuf holding the current position */
+    const struct os_mbuf *omc_om;
+    /** The offset in the chain of the first byte of omc_om */
+    uint16_t omc_om_start;
+    /** The offset of the current position in omc_om */
+    uint16_t omc_off;
+};
+
+/**
+ * Initializes a cursor at the start of an mbuf chain.
+ *
+ * @param omc                   The cursor to initialize.
+ * @param om                    The mbuf chain to read.
+ */
+void os_mbuf_cursor_init(struct os_mbuf_cursor *omc, const struct os_mbuf *om);
+
+/**
+ * Moves a cursor to the specified offset in its chain.  The chain is only
+ * walked from the head when the offset is before the current position.
+ *
+ * @param omc                   The cursor to move.
+ * @param off                   The offset from the start of the chain.
+ *
+ * @return                      0 on success; OS_EINVAL if the offset is past
+ *                                  the end of the chain, the cursor is not
+ *                                  moved in that case.
+ */
+int os_mbuf_cursor_seek(struct os_mbuf_cursor *omc, uint16_t off);
+
+/**
+ * Retrieves the offset of a cursor from the start of its chain.
+ */
+uint16_t os_mbuf_cursor_off(const struct os_mbuf_cursor *omc);
+
+/**
+ * Returns the contiguous data at the cursor position and advances the cursor
+ * past it.  Calling this until it returns NULL visits every segment of the
+ * chain from the cursor position without copying.
+ *
+ * @param omc                   The cursor to read from.
+ * @param max_len               The maximum length of the segment to return.
+ * @param out_len               On success, the length of the segment.
+ *
+ * @return                      A pointer to the segment; NULL at the end of
+ *                                  the chain.
+ */
+const uint8_t *os_mbuf_cursor_next(struct os_mbuf_cursor *omc,
+                                   uint16_t max_len, uint16_t *out_len);
+
+/**
+ * Copies data from the cursor position into a flat buffer and advances the
+ * cursor past it.
+ *
+ * @param omc                   The cursor to read from.
+ * @param len                   The number of bytes to copy.
+ * @param dst                   The buffer to copy into.
+ *
+ * @return                      0 on success; -1 if the chain holds fewer
+ *                                  than len bytes after the cursor.
+ */
+int os_mbuf_cursor_copydata(struct os_mbuf_cursor *omc, uint16_t len,
+                            void *dst);
+
+/**
+ * Appends data from the cursor position to another mbuf chain and advances
+ * the cursor past it.
+ *
+ * @param omc                   The cursor to read from.
+ * @param dst                   The mbuf chain to append to.
+ * @param len                   The number of bytes to append.
+ *
+ * @return                      0 on success; OS_EINVAL if the chain holds
+ *                                  fewer than len bytes after the cursor;
+ *                                  OS_ENOMEM on mbuf exhaustion.
+ */
+int os_mbuf_cursor_appendto(struct os_mbuf_cursor *omc, struct os_mbuf *dst,
+                            uint16_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -71,6 +71,18 @@ struct os_mempool {
     SLIST_HEAD(,os_memblock);
     /** Name for memory block */
     const char *name;
+    /** The number of allocations that failed because the pool was empty */
+    uint16_t mp_num_fail;
+    /** The longest mbuf chain built with os_mbuf_append() from this pool */
+    uint16_t mp_max_chain;
+#if MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE)
+    /**
+     * Free list head of a lock-free pool: index + 1 of the first free block
+     * in the low 16 bits (0 when empty), a tag incremented on every change in
+     * the high 16 bits.
+     */
+    uint32_t mp_free_head;
+#endif
 };
 
 /**
@@ -125,6 +137,10 @@ struct os_mempool_info {
     int omi_num_free;
     /** Minimum number of free memory blocks ever */
     int omi_min_free;
+    /** Number of allocations that failed because the pool was empty */
+    int omi_num_fail;
+    /** Longest mbuf chain built from the pool */
+    int omi_max_chain;
     /** Name of the memory pool */
     char omi_name[OS_MEMPOOL_INFO_NAME_LEN];
 };
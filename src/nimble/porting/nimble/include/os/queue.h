@@ -35,6 +35,54 @@
 
 /* The common BSD linked list queue macros are already defined here for ESP-IDF */
 #include <sys/queue.h>
+#include <stddef.h>
+
+/*
+ * The sys/queue.h of glibc, used by the POSIX port, lacks some of the macros
+ * the host uses.
+ */
+#ifndef SLIST_FOREACH_SAFE
+#define SLIST_FOREACH_SAFE(var, head, field, tvar)                     \
+    for ((var) = SLIST_FIRST((head));                                   \
+        (var) && ((tvar) = SLIST_NEXT((var), field), 1);                \
+        (var) = (tvar))
+#endif
+
+#ifndef STAILQ_FOREACH_SAFE
+#define STAILQ_FOREACH_SAFE(var, head, field, tvar)                    \
+    for ((var) = STAILQ_FIRST((head));                                  \
+        (var) && ((tvar) = STAILQ_NEXT((var), field), 1);               \
+        (var) = (tvar))
+#endif
+
+#ifndef TAILQ_FOREACH_SAFE
+#define TAILQ_FOREACH_SAFE(var, head, field, tvar)                     \
+    for ((var) = TAILQ_FIRST((head));                                   \
+        (var) && ((tvar) = TAILQ_NEXT((var), field), 1);                \
+        (var) = (tvar))
+#endif
+
+#ifndef STAILQ_LAST
+#define STAILQ_LAST(head, type, field)                                  \
+    (STAILQ_EMPTY((head)) ? NULL :                                      \
+        ((struct type *)(void *)                                        \
+        ((char *)((head)->stqh_last) - offsetof(struct type, field))))
+#endif
+
+#ifndef SLIST_REMOVE_AFTER
+#define SLIST_REMOVE_AFTER(elm, field) do {                             \
+    SLIST_NEXT(elm, field) =                                            \
+        SLIST_NEXT(SLIST_NEXT(elm, field), field);                      \
+} while (0)
+#endif
+
+#ifndef STAILQ_REMOVE_AFTER
+#define STAILQ_REMOVE_AFTER(head, elm, field) do {                      \
+    if ((STAILQ_NEXT(elm, field) =                                      \
+         STAILQ_NEXT(STAILQ_NEXT(elm, field), field)) == NULL)          \
+        (head)->stqh_last = &STAILQ_NEXT((elm), field);                 \
+} while (0)
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -773,6 +773,22 @@
 #define MYNEWT_VAL_BLE_HS_FLOW_CTRL_TX_ON_DISCONNECT (0)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE (0)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS (4)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE (4)
+#endif
+
+#ifndef MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS
+#define MYNEWT_VAL_BLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS (50)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_LOG_LVL
 #define MYNEWT_VAL_BLE_HS_LOG_LVL (1)
 #endif
@@ -789,6 +805,10 @@
 #define MYNEWT_VAL_BLE_HS_REQUIRE_OS (1)
 #endif
 
+#ifndef MYNEWT_VAL_BLE_HS_RX_ROUND_ROBIN
+#define MYNEWT_VAL_BLE_HS_RX_ROUND_ROBIN (1)
+#endif
+
 #ifndef MYNEWT_VAL_BLE_HS_STOP_ON_SHUTDOWN
 #define MYNEWT_VAL_BLE_HS_STOP_ON_SHUTDOWN (1)
 #endif
@@ -26,7 +26,9 @@
 #endif //CONFIG_BT_NIMBLE_ENABLED
 
 #include "../include/nimble/nimble_port.h"
+#if !defined(NIMBLE_NPL_POSIX)
 #include "../../npl/freertos/include/nimble/nimble_port_freertos.h"
+#endif
 #if NIMBLE_CFG_CONTROLLER
 #include "nimble/nimble/controller/include/controller/ble_ll.h"
 #include "nimble/nimble/transport/ram/include/transport/ram/ble_hci_ram.h"
@@ -54,8 +56,10 @@
 #include "esp_bt.h"
 #include "nimble/esp_port/esp-hci/include/esp_nimble_hci.h"
 #endif
+#if !defined(NIMBLE_NPL_POSIX)
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#endif
 
 #define NIMBLE_PORT_LOG_TAG          "BLE_INIT"
 
@@ -262,6 +266,39 @@ nimble_port_stop(void)
 void
 IRAM_ATTR nimble_port_run(void)
 {
+#if !CONFIG_NIMBLE_STACK_USE_MEM_POOLS && CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE > 1
+    struct ble_npl_event *evs[CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE];
+    int cnt;
+    int put;
+    int i;
+
+    while (1) {
+        cnt = ble_npl_eventq_get_batch(&g_eventq_dflt, evs,
+                                       CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE,
+                                       BLE_NPL_TIME_FOREVER);
+        for (i = 0; i < cnt; i++) {
+            /* Skip the events removed by the handlers run before. */
+            if (!ble_npl_event_claim(evs[i])) {
+                continue;
+            }
+
+            ble_npl_event_run(evs[i]);
+            if (evs[i] == &ble_hs_ev_stop) {
+                /* Put back the events taken after the stop event that are
+                 * still queued, so they are handled the same way as if they
+                 * had stayed in the queue. */
+                put = 0;
+                for (i++; i < cnt; i++) {
+                    if (ble_npl_event_claim(evs[i])) {
+                        evs[put++] = evs[i];
+                    }
+                }
+                ble_npl_eventq_put_batch(&g_eventq_dflt, evs, put);
+                return;
+            }
+        }
+    }
+#else
     struct ble_npl_event *ev;
 
     while (1) {
@@ -272,6 +309,7 @@ IRAM_ATTR nimble_port_run(void)
         }
 
     }
+#endif
 }
 
 struct ble_npl_eventq *
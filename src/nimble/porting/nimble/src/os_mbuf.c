@@ -51,6 +51,17 @@
 STAILQ_HEAD(, os_mbuf_pool) g_msys_pool_list =
     STAILQ_HEAD_INITIALIZER(g_msys_pool_list);
 
+#if MYNEWT_VAL(MSYS_CALIBRATE)
+/* Histogram of the size of the msys packets when they are freed, used by
+ * os_msys_calibrate().  The last bin counts all larger packets.
+ */
+#define OS_MSYS_CALIB_BIN_SIZE      (32)
+#define OS_MSYS_CALIB_NUM_BINS      (17)
+
+static uint32_t os_msys_calib_hist[OS_MSYS_CALIB_NUM_BINS];
+static uint16_t os_msys_calib_max_len;
+#endif
+
 
 int
 os_mqueue_init(struct os_mqueue *mq, ble_npl_event_fn *ev_cb, void *arg)
@@ -121,18 +132,21 @@ int
 os_msys_register(struct os_mbuf_pool *new_pool)
 {
     struct os_mbuf_pool *pool;
+    struct os_mbuf_pool *prev;
 
-    pool = NULL;
+    /* Keep the list sorted from the smallest to the largest block size. */
+    prev = NULL;
     STAILQ_FOREACH(pool, &g_msys_pool_list, omp_next) {
-        if (new_pool->omp_databuf_len > pool->omp_databuf_len) {
+        if (new_pool->omp_databuf_len < pool->omp_databuf_len) {
             break;
         }
+        prev = pool;
     }
 
-    if (pool) {
-        STAILQ_INSERT_AFTER(&g_msys_pool_list, pool, new_pool, omp_next);
+    if (prev) {
+        STAILQ_INSERT_AFTER(&g_msys_pool_list, prev, new_pool, omp_next);
     } else {
-        STAILQ_INSERT_TAIL(&g_msys_pool_list, new_pool, omp_next);
+        STAILQ_INSERT_HEAD(&g_msys_pool_list, new_pool, omp_next);
     }
 
     return (0);
@@ -147,9 +161,29 @@ os_msys_reset(void)
 static struct os_mbuf_pool *
 _os_msys_find_pool(uint16_t dsize)
 {
+    struct os_mbuf_pool *avail;
     struct os_mbuf_pool *pool;
 
-    pool = NULL;
+    /* The pools are sorted by block size; use the smallest pool that fits the
+     * data and has a free block.  If none of these has a free block, use the
+     * largest pool with a free block and let the data be chained.
+     */
+    avail = NULL;
+    STAILQ_FOREACH(pool, &g_msys_pool_list, omp_next) {
+        if (pool->omp_pool->mp_num_free == 0) {
+            continue;
+        }
+        if (dsize <= pool->omp_databuf_len) {
+            return (pool);
+        }
+        avail = pool;
+    }
+
+    if (avail) {
+        return (avail);
+    }
+
+    /* All pools are empty; the allocation fails on the best fitting pool. */
     STAILQ_FOREACH(pool, &g_msys_pool_list, omp_next) {
         if (dsize <= pool->omp_databuf_len) {
             break;
@@ -228,6 +262,110 @@ os_msys_num_free(void)
     return total;
 }
 
+#if MYNEWT_VAL(MSYS_CALIBRATE)
+static void
+os_msys_calib_record(const struct os_mbuf *om)
+{
+    struct os_mbuf_pool *omp;
+    uint16_t len;
+    int bin;
+
+    /* Only count packets allocated from msys. */
+    STAILQ_FOREACH(omp, &g_msys_pool_list, omp_next) {
+        if (omp == om->om_omp) {
+            break;
+        }
+    }
+
+    if (omp == NULL) {
+        return;
+    }
+
+    /* The space needed to hold the whole packet in one block. */
+    len = om->om_pkthdr_len + OS_MBUF_PKTHDR(om)->omp_len;
+
+    bin = len / OS_MSYS_CALIB_BIN_SIZE;
+    if (bin >= OS_MSYS_CALIB_NUM_BINS) {
+        bin = OS_MSYS_CALIB_NUM_BINS - 1;
+    }
+
+    os_msys_calib_hist[bin]++;
+    if (len > os_msys_calib_max_len) {
+        os_msys_calib_max_len = len;
+    }
+}
+#endif
+
+int
+os_msys_calibrate(struct os_msys_tier_cfg *tiers, int max_tiers)
+{
+#if MYNEWT_VAL(MSYS_CALIBRATE)
+    struct os_mbuf_pool *omp;
+    uint32_t in_tier;
+    uint32_t target;
+    uint32_t total;
+    uint32_t peak;
+    uint32_t cum;
+    uint16_t size;
+    int num_tiers;
+    int bin;
+
+    total = 0;
+    for (bin = 0; bin < OS_MSYS_CALIB_NUM_BINS; bin++) {
+        total += os_msys_calib_hist[bin];
+    }
+
+    if (total == 0 || max_tiers <= 0) {
+        return 0;
+    }
+
+    /* The most msys blocks that have been in use at the same time. */
+    peak = 0;
+    STAILQ_FOREACH(omp, &g_msys_pool_list, omp_next) {
+        peak += omp->omp_pool->mp_num_blocks - omp->omp_pool->mp_min_free;
+    }
+
+    /* Split the packets into tiers holding about the same number of packets,
+     * each tier is sized for its largest packet and gets a share of the peak
+     * block usage that matches its share of the packets.
+     */
+    num_tiers = 0;
+    cum = 0;
+    in_tier = 0;
+    for (bin = 0; bin < OS_MSYS_CALIB_NUM_BINS && num_tiers < max_tiers; bin++) {
+        cum += os_msys_calib_hist[bin];
+        in_tier += os_msys_calib_hist[bin];
+
+        target = (uint32_t)((uint64_t)total * (num_tiers + 1) / max_tiers);
+        if (in_tier == 0 || cum < target) {
+            continue;
+        }
+
+        size = (bin + 1) * OS_MSYS_CALIB_BIN_SIZE;
+        if (bin == OS_MSYS_CALIB_NUM_BINS - 1 || size > os_msys_calib_max_len) {
+            size = os_msys_calib_max_len;
+        }
+
+        tiers[num_tiers].block_size = OS_ALIGN(size + sizeof(struct os_mbuf), 4);
+        tiers[num_tiers].block_count = (peak * in_tier + total - 1) / total + 1;
+        num_tiers++;
+        in_tier = 0;
+    }
+
+    return num_tiers;
+#else
+    return 0;
+#endif
+}
+
+void
+os_msys_calibrate_reset(void)
+{
+#if MYNEWT_VAL(MSYS_CALIBRATE)
+    memset(os_msys_calib_hist, 0, sizeof(os_msys_calib_hist));
+    os_msys_calib_max_len = 0;
+#endif
+}
 
 int
 os_mbuf_pool_init(struct os_mbuf_pool *omp, struct os_mempool *mp,
@@ -331,6 +469,12 @@ os_mbuf_free_chain(struct os_mbuf *om)
 
     os_trace_api_u32(OS_TRACE_ID_MBUF_FREE_CHAIN, (uint32_t)(uintptr_t)om);
 
+#if MYNEWT_VAL(MSYS_CALIBRATE)
+    if (om != NULL && OS_MBUF_IS_PKTHDR(om)) {
+        os_msys_calib_record(om);
+    }
+#endif
+
     while (om != NULL) {
         next = SLIST_NEXT(om, om_next);
 
@@ -383,28 +527,30 @@ os_mbuf_len(const struct os_mbuf *om)
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
-int
-os_mbuf_append(struct os_mbuf *om, const void *data,  uint16_t len)
+/**
+ * Appends data after the last mbuf of a chain.
+ *
+ * @param om                    The head of the chain.
+ * @param last_ptr              The last mbuf in the chain; updated to the new
+ *                                  last mbuf.
+ * @param chain_len_ptr         The number of mbufs in the chain; updated with
+ *                                  the mbufs that were added.
+ */
+static int
+_os_mbuf_append_last(struct os_mbuf *om, struct os_mbuf **last_ptr,
+                     uint16_t *chain_len_ptr, const void *data, uint16_t len)
 {
     struct os_mbuf_pool *omp;
     struct os_mbuf *last;
     struct os_mbuf *new;
+    uint16_t chain_len;
     int remainder;
     int space;
     int rc;
 
-    if (om == NULL) {
-        rc = OS_EINVAL;
-        goto err;
-    }
-
     omp = om->om_omp;
-
-    /* Scroll to last mbuf in the chain */
-    last = om;
-    while (SLIST_NEXT(last, om_next) != NULL) {
-        last = SLIST_NEXT(last, om_next);
-    }
+    last = *last_ptr;
+    chain_len = *chain_len_ptr;
 
     remainder = len;
     space = OS_MBUF_TRAILINGSPACE(last);
@@ -439,6 +585,15 @@ os_mbuf_append(struct os_mbuf *om, const void *data,  uint16_t len)
         remainder -= new->om_len;
         SLIST_NEXT(last, om_next) = new;
         last = new;
+        chain_len++;
+    }
+
+    *last_ptr = last;
+    *chain_len_ptr = chain_len;
+
+    /* Record the longest chain for the pool statistics. */
+    if (omp != NULL && omp->omp_pool->mp_max_chain < chain_len) {
+        omp->omp_pool->mp_max_chain = chain_len;
     }
 
     /* Adjust the packet header length in the buffer */
@@ -458,33 +613,58 @@ err:
 }
 #pragma GCC diagnostic pop
 
+/**
+ * Finds the last mbuf of a chain and counts the mbufs in the chain.
+ */
+static struct os_mbuf *
+_os_mbuf_last(struct os_mbuf *om, uint16_t *out_chain_len)
+{
+    uint16_t chain_len;
+
+    chain_len = 1;
+    while (SLIST_NEXT(om, om_next) != NULL) {
+        om = SLIST_NEXT(om, om_next);
+        chain_len++;
+    }
+
+    *out_chain_len = chain_len;
+    return om;
+}
+
+int
+os_mbuf_append(struct os_mbuf *om, const void *data,  uint16_t len)
+{
+    struct os_mbuf *last;
+    uint16_t chain_len;
+
+    if (om == NULL) {
+        return (OS_EINVAL);
+    }
+
+    /* Scroll to last mbuf in the chain */
+    last = _os_mbuf_last(om, &chain_len);
+
+    return _os_mbuf_append_last(om, &last, &chain_len, data, len);
+}
+
 int
 os_mbuf_appendfrom(struct os_mbuf *dst, const struct os_mbuf *src,
                    uint16_t src_off, uint16_t len)
 {
-    const struct os_mbuf *src_cur_om;
-    uint16_t src_cur_off;
-    uint16_t chunk_sz;
+    struct os_mbuf_cursor omc;
     int rc;
 
-    src_cur_om = os_mbuf_off(src, src_off, &src_cur_off);
-    while (len > 0) {
-        if (src_cur_om == NULL) {
-            return OS_EINVAL;
-        }
-
-        chunk_sz = min(len, src_cur_om->om_len - src_cur_off);
-        rc = os_mbuf_append(dst, src_cur_om->om_data + src_cur_off, chunk_sz);
-        if (rc != 0) {
-            return rc;
-        }
+    if (len == 0) {
+        return 0;
+    }
 
-        len -= chunk_sz;
-        src_cur_om = SLIST_NEXT(src_cur_om, om_next);
-        src_cur_off = 0;
+    os_mbuf_cursor_init(&omc, src);
+    rc = os_mbuf_cursor_seek(&omc, src_off);
+    if (rc != 0) {
+        return rc;
     }
 
-    return 0;
+    return os_mbuf_cursor_appendto(&omc, dst, len);
 }
 
 struct os_mbuf *
@@ -593,6 +773,147 @@ os_mbuf_copydata(const struct os_mbuf *m, int off, int len, void *dst)
     return (len > 0 ? -1 : 0);
 }
 
+/**
+ * Moves the cursor off the end of its mbuf when a following mbuf exists, so
+ * the cursor only rests at the end of the last mbuf.
+ */
+static void
+_os_mbuf_cursor_skip_empty(struct os_mbuf_cursor *omc)
+{
+    while (omc->omc_off >= omc->omc_om->om_len &&
+           SLIST_NEXT(omc->omc_om, om_next) != NULL) {
+
+        omc->omc_off -= omc->omc_om->om_len;
+        omc->omc_om_start += omc->omc_om->om_len;
+        omc->omc_om = SLIST_NEXT(omc->omc_om, om_next);
+    }
+}
+
+void
+os_mbuf_cursor_init(struct os_mbuf_cursor *omc, const struct os_mbuf *om)
+{
+    omc->omc_head = om;
+    omc->omc_om = om;
+    omc->omc_om_start = 0;
+    omc->omc_off = 0;
+}
+
+uint16_t
+os_mbuf_cursor_off(const struct os_mbuf_cursor *omc)
+{
+    return omc->omc_om_start + omc->omc_off;
+}
+
+int
+os_mbuf_cursor_seek(struct os_mbuf_cursor *omc, uint16_t off)
+{
+    struct os_mbuf_cursor prev;
+
+    if (omc->omc_om == NULL) {
+        return (OS_EINVAL);
+    }
+
+    prev = *omc;
+
+    /* Only rewind to the head when moving backwards. */
+    if (off < omc->omc_om_start) {
+        omc->omc_om = omc->omc_head;
+        omc->omc_om_start = 0;
+    }
+
+    omc->omc_off = off - omc->omc_om_start;
+    _os_mbuf_cursor_skip_empty(omc);
+
+    if (omc->omc_off > omc->omc_om->om_len) {
+        /* Past the end, leave the cursor where it was. */
+        *omc = prev;
+        return (OS_EINVAL);
+    }
+
+    return (0);
+}
+
+const uint8_t *
+os_mbuf_cursor_next(struct os_mbuf_cursor *omc, uint16_t max_len,
+                    uint16_t *out_len)
+{
+    const uint8_t *data;
+    uint16_t len;
+
+    if (omc->omc_om == NULL) {
+        return (NULL);
+    }
+
+    _os_mbuf_cursor_skip_empty(omc);
+
+    len = min(omc->omc_om->om_len - omc->omc_off, max_len);
+    if (len == 0) {
+        return (NULL);
+    }
+
+    data = omc->omc_om->om_data + omc->omc_off;
+    omc->omc_off += len;
+    *out_len = len;
+
+    return (data);
+}
+
+int
+os_mbuf_cursor_copydata(struct os_mbuf_cursor *omc, uint16_t len, void *dst)
+{
+    const uint8_t *data;
+    uint8_t *udst;
+    uint16_t chunk;
+
+    udst = dst;
+    while (len > 0) {
+        data = os_mbuf_cursor_next(omc, len, &chunk);
+        if (data == NULL) {
+            return (-1);
+        }
+
+        memcpy(udst, data, chunk);
+        udst += chunk;
+        len -= chunk;
+    }
+
+    return (0);
+}
+
+int
+os_mbuf_cursor_appendto(struct os_mbuf_cursor *omc, struct os_mbuf *dst,
+                        uint16_t len)
+{
+    const uint8_t *data;
+    struct os_mbuf *last;
+    uint16_t chain_len;
+    uint16_t chunk;
+    int rc;
+
+    if (dst == NULL) {
+        return (OS_EINVAL);
+    }
+
+    /* The destination chain is walked once for all the source segments. */
+    last = _os_mbuf_last(dst, &chain_len);
+
+    while (len > 0) {
+        data = os_mbuf_cursor_next(omc, len, &chunk);
+        if (data == NULL) {
+            return (OS_EINVAL);
+        }
+
+        rc = _os_mbuf_append_last(dst, &last, &chain_len, data, chunk);
+        if (rc != 0) {
+            return (rc);
+        }
+
+        len -= chunk;
+    }
+
+    return (0);
+}
+
 void
 os_mbuf_adj(struct os_mbuf *mp, int req_len)
 {
@@ -116,6 +116,92 @@ os_mempool_guard_check(const struct os_mempool *mp, void *start)
 #define os_mempool_guard_check(mp, start)
 #endif
 
+#if MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE)
+#if !defined(__GCC_ATOMIC_INT_LOCK_FREE) || (__GCC_ATOMIC_INT_LOCK_FREE < 2) || \
+    (__GCC_ATOMIC_SHORT_LOCK_FREE < 2)
+#error "OS_MEMPOOL_LOCK_FREE requires a target with a hardware compare and swap"
+#endif
+
+/*
+ * The free list head of a lock-free pool is a block index and a tag in one
+ * 32 bit word so it can be swapped with a single compare and swap.  The tag is
+ * incremented on every change, a head read before a block was taken and given
+ * back does not match anymore (ABA) unless 65536 changes were made meanwhile.
+ */
+#define OS_MEMPOOL_LF_INDEX_MASK    (0x0000ffff)
+#define OS_MEMPOOL_LF_TAG_INC       (0x00010000)
+
+static inline struct os_memblock *
+os_mempool_lf_block(const struct os_mempool *mp, uint32_t head)
+{
+    uint32_t index;
+
+    index = head & OS_MEMPOOL_LF_INDEX_MASK;
+    if (index == 0) {
+        return NULL;
+    }
+
+    return (struct os_memblock *)(uintptr_t)(mp->mp_membuf_addr +
+                                             (index - 1) * OS_MEMPOOL_TRUE_BLOCK_SIZE(mp));
+}
+
+static inline uint32_t
+os_mempool_lf_index(const struct os_mempool *mp, const struct os_memblock *block)
+{
+    if (block == NULL) {
+        return 0;
+    }
+
+    return ((uint32_t)(uintptr_t)block - mp->mp_membuf_addr) /
+           OS_MEMPOOL_TRUE_BLOCK_SIZE(mp) + 1;
+}
+
+static struct os_memblock *
+os_mempool_lf_pop(struct os_mempool *mp)
+{
+    struct os_memblock *block;
+    uint32_t head;
+    uint32_t next;
+
+    head = __atomic_load_n(&mp->mp_free_head, __ATOMIC_ACQUIRE);
+    do {
+        block = os_mempool_lf_block(mp, head);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        /* The block can be taken and written by another context while this
+         * reads its link, the tag of the head then fails the exchange.
+         */
+        next = os_mempool_lf_index(mp, SLIST_NEXT(block, mb_next));
+        next |= (head & ~OS_MEMPOOL_LF_INDEX_MASK) + OS_MEMPOOL_LF_TAG_INC;
+    } while (!__atomic_compare_exchange_n(&mp->mp_free_head, &head, next, true,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return block;
+}
+
+static void
+os_mempool_lf_push(struct os_mempool *mp, struct os_memblock *block)
+{
+    uint32_t index;
+    uint32_t head;
+    uint32_t next;
+
+    index = os_mempool_lf_index(mp, block);
+    head = __atomic_load_n(&mp->mp_free_head, __ATOMIC_RELAXED);
+    do {
+        SLIST_NEXT(block, mb_next) = os_mempool_lf_block(mp, head);
+        next = index | ((head & ~OS_MEMPOOL_LF_INDEX_MASK) + OS_MEMPOOL_LF_TAG_INC);
+    } while (!__atomic_compare_exchange_n(&mp->mp_free_head, &head, next, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+#define OS_MEMPOOL_FIRST(mp) os_mempool_lf_block((mp), (mp)->mp_free_head)
+#else
+#define OS_MEMPOOL_FIRST(mp) SLIST_FIRST(mp)
+#endif
+
 static os_error_t
 os_mempool_init_internal(struct os_mempool *mp, uint16_t blocks,
                          uint32_t block_size, void *membuf, const char *name,
@@ -148,11 +234,16 @@ os_mempool_init_internal(struct os_mempool *mp, uint16_t blocks,
     mp->mp_block_size = block_size;
     mp->mp_num_free = blocks;
     mp->mp_min_free = blocks;
+    mp->mp_num_fail = 0;
+    mp->mp_max_chain = 0;
     mp->mp_flags = flags;
     mp->mp_num_blocks = blocks;
     mp->mp_membuf_addr = (uint32_t)(uintptr_t)membuf;
     mp->name = name;
     SLIST_FIRST(mp) = membuf;
+#if MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE)
+    mp->mp_free_head = blocks > 0 ? 1 : 0;
+#endif
 
     if (blocks > 0) {
         os_mempool_poison(mp, membuf);
@@ -259,9 +350,14 @@ os_mempool_clear(struct os_mempool *mp)
     /* cleanup the memory pool structure */
     mp->mp_num_free = mp->mp_num_blocks;
     mp->mp_min_free = mp->mp_num_blocks;
+    mp->mp_num_fail = 0;
+    mp->mp_max_chain = 0;
     os_mempool_poison(mp, (void *)mp->mp_membuf_addr);
     os_mempool_guard(mp, (void *)mp->mp_membuf_addr);
     SLIST_FIRST(mp) = (void *)(uintptr_t)mp->mp_membuf_addr;
+#if MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE)
+    mp->mp_free_head = mp->mp_num_blocks > 0 ? 1 : 0;
+#endif
 
     /* Chain the memory blocks to the free list */
     block_addr = (uint8_t *)(uintptr_t)mp->mp_membuf_addr;
@@ -299,7 +395,7 @@ os_mempool_is_sane(const struct os_mempool *mp)
     struct os_memblock *block;
 
     /* Verify that each block in the free list belongs to the mempool. */
-    SLIST_FOREACH(block, mp, mb_next) {
+    for (block = OS_MEMPOOL_FIRST(mp); block; block = SLIST_NEXT(block, mb_next)) {
         if (!os_memblock_from(mp, block)) {
             return false;
         }
@@ -337,6 +433,66 @@ os_memblock_from(const struct os_mempool *mp, const void *block_addr)
     return 1;
 }
 
+#if MYNEWT_VAL(OS_MEMPOOL_LOCK_FREE)
+void *
+os_memblock_get(struct os_mempool *mp)
+{
+    struct os_memblock *block;
+    uint16_t num_free;
+    uint16_t min_free;
+    uint16_t num_fail;
+
+    os_trace_api_u32(OS_TRACE_ID_MEMBLOCK_GET, (uint32_t)(uintptr_t)mp);
+
+    block = NULL;
+    if (mp) {
+        block = os_mempool_lf_pop(mp);
+        if (block) {
+            /* Decremented after the block is taken and incremented before
+             * one is given back so the count never falls below the list.
+             */
+            num_free = __atomic_sub_fetch(&mp->mp_num_free, 1, __ATOMIC_RELAXED);
+            min_free = __atomic_load_n(&mp->mp_min_free, __ATOMIC_RELAXED);
+            while (min_free > num_free &&
+                   !__atomic_compare_exchange_n(&mp->mp_min_free, &min_free, num_free,
+                                                true, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+            }
+
+            os_mempool_poison_check(mp, block);
+            os_mempool_guard_check(mp, block);
+        } else {
+            num_fail = __atomic_load_n(&mp->mp_num_fail, __ATOMIC_RELAXED);
+            while (num_fail < UINT16_MAX &&
+                   !__atomic_compare_exchange_n(&mp->mp_num_fail, &num_fail, num_fail + 1,
+                                                true, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+            }
+        }
+    }
+
+    os_trace_api_ret_u32(OS_TRACE_ID_MEMBLOCK_GET, (uint32_t)(uintptr_t)block);
+
+    return (void *)block;
+}
+
+os_error_t
+os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr)
+{
+    os_trace_api_u32x2(OS_TRACE_ID_MEMBLOCK_PUT_FROM_CB, (uint32_t)(uintptr_t)mp,
+                       (uint32_t)(uintptr_t)block_addr);
+
+    os_mempool_guard_check(mp, block_addr);
+    os_mempool_poison(mp, block_addr);
+
+    __atomic_add_fetch(&mp->mp_num_free, 1, __ATOMIC_RELAXED);
+    os_mempool_lf_push(mp, (struct os_memblock *)block_addr);
+
+    os_trace_api_ret_u32(OS_TRACE_ID_MEMBLOCK_PUT_FROM_CB, (uint32_t)OS_OK);
+
+    return OS_OK;
+}
+#else
 void *
 os_memblock_get(struct os_mempool *mp)
 {
@@ -362,6 +518,8 @@ os_memblock_get(struct os_mempool *mp)
             if (mp->mp_min_free > mp->mp_num_free) {
                 mp->mp_min_free = mp->mp_num_free;
             }
+        } else if (mp->mp_num_fail < UINT16_MAX) {
+            mp->mp_num_fail++;
         }
         OS_EXIT_CRITICAL(sr);
 
@@ -405,6 +563,7 @@ os_memblock_put_from_cb(struct os_mempool *mp, void *block_addr)
 
     return OS_OK;
 }
+#endif
 
 os_error_t
 os_memblock_put(struct os_mempool *mp, void *block_addr)
@@ -431,7 +590,7 @@ os_memblock_put(struct os_mempool *mp, void *block_addr)
     /*
      * Check for duplicate free.
      */
-    SLIST_FOREACH(block, mp, mb_next) {
+    for (block = OS_MEMPOOL_FIRST(mp); block; block = SLIST_NEXT(block, mb_next)) {
         assert(block != (struct os_memblock *)block_addr);
     }
 #endif
@@ -473,6 +632,8 @@ os_mempool_info_get_next(struct os_mempool *mp, struct os_mempool_info *omi)
     omi->omi_num_blocks = cur->mp_num_blocks;
     omi->omi_num_free = cur->mp_num_free;
     omi->omi_min_free = cur->mp_min_free;
+    omi->omi_num_fail = cur->mp_num_fail;
+    omi->omi_max_chain = cur->mp_max_chain;
     strncpy(omi->omi_name, cur->name, sizeof(omi->omi_name) - 1);
     omi->omi_name[sizeof(omi->omi_name) - 1] = '\0';
 
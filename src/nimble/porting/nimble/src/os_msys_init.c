@@ -35,11 +35,17 @@ static STAILQ_HEAD(, os_mbuf_pool) g_msys_pool_list =
 #define OS_MSYS_1_BLOCK_SIZE MYNEWT_VAL(MSYS_1_BLOCK_SIZE)
 #define OS_MSYS_2_BLOCK_COUNT MYNEWT_VAL(MSYS_2_BLOCK_COUNT)
 #define OS_MSYS_2_BLOCK_SIZE MYNEWT_VAL(MSYS_2_BLOCK_SIZE)
+#define OS_MSYS_3_BLOCK_COUNT MYNEWT_VAL(MSYS_3_BLOCK_COUNT)
+#define OS_MSYS_3_BLOCK_SIZE MYNEWT_VAL(MSYS_3_BLOCK_SIZE)
+#define OS_MSYS_4_BLOCK_COUNT MYNEWT_VAL(MSYS_4_BLOCK_COUNT)
+#define OS_MSYS_4_BLOCK_SIZE MYNEWT_VAL(MSYS_4_BLOCK_SIZE)
 #else
 #define OS_MSYS_1_BLOCK_COUNT CONFIG_BT_LE_MSYS_1_BLOCK_COUNT
 #define OS_MSYS_1_BLOCK_SIZE CONFIG_BT_LE_MSYS_1_BLOCK_SIZE
 #define OS_MSYS_2_BLOCK_COUNT CONFIG_BT_LE_MSYS_2_BLOCK_COUNT
 #define OS_MSYS_2_BLOCK_SIZE CONFIG_BT_LE_MSYS_2_BLOCK_SIZE
+#define OS_MSYS_3_BLOCK_COUNT 0
+#define OS_MSYS_4_BLOCK_COUNT 0
 #endif
 
 
@@ -74,6 +80,36 @@ static struct os_mbuf_pool os_msys_init_2_mbuf_pool;
 static struct os_mempool os_msys_init_2_mempool;
 #endif
 
+#if OS_MSYS_3_BLOCK_COUNT > 0
+#define SYSINIT_MSYS_3_MEMBLOCK_SIZE                \
+    OS_ALIGN(OS_MSYS_3_BLOCK_SIZE, 4)
+#define SYSINIT_MSYS_3_MEMPOOL_SIZE                 \
+    OS_MEMPOOL_SIZE(OS_MSYS_3_BLOCK_COUNT,  \
+                    SYSINIT_MSYS_3_MEMBLOCK_SIZE)
+#ifdef ESP_PLATFORM
+static os_membuf_t *os_msys_init_3_data;
+#else
+static os_membuf_t os_msys_init_3_data[SYSINIT_MSYS_3_MEMPOOL_SIZE];
+#endif
+static struct os_mbuf_pool os_msys_init_3_mbuf_pool;
+static struct os_mempool os_msys_init_3_mempool;
+#endif
+
+#if OS_MSYS_4_BLOCK_COUNT > 0
+#define SYSINIT_MSYS_4_MEMBLOCK_SIZE                \
+    OS_ALIGN(OS_MSYS_4_BLOCK_SIZE, 4)
+#define SYSINIT_MSYS_4_MEMPOOL_SIZE                 \
+    OS_MEMPOOL_SIZE(OS_MSYS_4_BLOCK_COUNT,  \
+                    SYSINIT_MSYS_4_MEMBLOCK_SIZE)
+#ifdef ESP_PLATFORM
+static os_membuf_t *os_msys_init_4_data;
+#else
+static os_membuf_t os_msys_init_4_data[SYSINIT_MSYS_4_MEMPOOL_SIZE];
+#endif
+static struct os_mbuf_pool os_msys_init_4_mbuf_pool;
+static struct os_mempool os_msys_init_4_mempool;
+#endif
+
 #define OS_MSYS_SANITY_ENABLED                  \
     (MYNEWT_VAL(MSYS_1_SANITY_MIN_COUNT) > 0 || \
      MYNEWT_VAL(MSYS_2_SANITY_MIN_COUNT) > 0)
@@ -104,8 +140,8 @@ IRAM_ATTR os_msys_sanity_min_count(int idx)
         return MYNEWT_VAL(MSYS_2_SANITY_MIN_COUNT);
 
     default:
-        BLE_LL_ASSERT(0);
-        return ESP_OK;
+        /* The additional pools have no minimum count. */
+        return 0;
     }
 }
 
@@ -163,6 +199,20 @@ os_msys_buf_alloc(void)
     }
 #endif
 
+#if OS_MSYS_3_BLOCK_COUNT > 0
+    os_msys_init_3_data = (os_membuf_t *)nimble_platform_mem_calloc(1, (sizeof(os_membuf_t) * SYSINIT_MSYS_3_MEMPOOL_SIZE));
+    if (!os_msys_init_3_data) {
+        return ESP_FAIL;
+    }
+#endif
+
+#if OS_MSYS_4_BLOCK_COUNT > 0
+    os_msys_init_4_data = (os_membuf_t *)nimble_platform_mem_calloc(1, (sizeof(os_membuf_t) * SYSINIT_MSYS_4_MEMPOOL_SIZE));
+    if (!os_msys_init_4_data) {
+        return ESP_FAIL;
+    }
+#endif
+
     return ESP_OK;
 }
 
@@ -179,6 +229,16 @@ os_msys_buf_free(void)
     os_msys_init_2_data = NULL;
 #endif
 
+#if OS_MSYS_3_BLOCK_COUNT > 0
+    nimble_platform_mem_free(os_msys_init_3_data);
+    os_msys_init_3_data = NULL;
+#endif
+
+#if OS_MSYS_4_BLOCK_COUNT > 0
+    nimble_platform_mem_free(os_msys_init_4_data);
+    os_msys_init_4_data = NULL;
+#endif
+
 }
 #endif
 
@@ -208,6 +268,24 @@ void os_msys_init(void)
                       "msys_2");
 #endif
 
+#if OS_MSYS_3_BLOCK_COUNT > 0
+    os_msys_init_once(os_msys_init_3_data,
+                      &os_msys_init_3_mempool,
+                      &os_msys_init_3_mbuf_pool,
+                      OS_MSYS_3_BLOCK_COUNT,
+                      SYSINIT_MSYS_3_MEMBLOCK_SIZE,
+                      "msys_3");
+#endif
+
+#if OS_MSYS_4_BLOCK_COUNT > 0
+    os_msys_init_once(os_msys_init_4_data,
+                      &os_msys_init_4_mempool,
+                      &os_msys_init_4_mbuf_pool,
+                      OS_MSYS_4_BLOCK_COUNT,
+                      SYSINIT_MSYS_4_MEMBLOCK_SIZE,
+                      "msys_4");
+#endif
+
 #if OS_MSYS_SANITY_ENABLED
     os_msys_sc.sc_func = os_msys_sanity;
     os_msys_sc.sc_checkin_itvl =
@@ -446,15 +446,42 @@ struct ble_npl_event {
     bool queued;
     ble_npl_event_fn *fn;
     void *arg;
+    /* Tick count when the event was put on a queue, used for latency stats. */
+    ble_npl_time_t queued_at;
+};
+
+/* Counters updated by the task that takes events from the queue. */
+struct ble_npl_eventq_stats {
+    /* Number of times the consumer woke up and found events. */
+    uint32_t num_wakeups;
+    /* Number of events taken from the queue. */
+    uint32_t num_events;
+    /* Largest number of events waiting at a wakeup. */
+    uint16_t max_depth;
+    /* Longest time in ticks an event waited on the queue. */
+    ble_npl_time_t max_latency;
 };
 
 struct ble_npl_eventq {
     QueueHandle_t q;
+    struct ble_npl_eventq_stats stats;
 };
 
+/* Callouts share one FreeRTOS timer instead of creating one timer each. */
+#if CONFIG_BT_NIMBLE_SHARED_CALLOUT_TIMER && !CONFIG_BT_NIMBLE_USE_ESP_TIMER
+#define NPL_FREERTOS_SHARED_CALLOUT_TIMER 1
+#else
+#define NPL_FREERTOS_SHARED_CALLOUT_TIMER 0
+#endif
+
 struct ble_npl_callout {
 #if CONFIG_BT_NIMBLE_USE_ESP_TIMER
    esp_timer_handle_t handle;
+#elif NPL_FREERTOS_SHARED_CALLOUT_TIMER
+    /* The next pending callout, the list is sorted by expiry. */
+    struct ble_npl_callout *next;
+    ble_npl_time_t expiry;
+    bool active;
 #else
     TimerHandle_t handle;
 #endif
@@ -494,6 +521,7 @@ static inline void
 ble_npl_eventq_init(struct ble_npl_eventq *evq)
 {
     evq->q = xQueueCreate(NIMBLE_EVT_QUEUE_SIZE, sizeof(struct ble_npl_eventq *));
+    memset(&evq->stats, 0, sizeof(evq->stats));
 }
 
 static inline void
@@ -514,6 +542,44 @@ ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
     npl_freertos_eventq_put(evq, ev);
 }
 
+/* Waits up to tmo for the first event, then takes up to max events without
+ * waiting. Returns the number of events stored in evs. */
+static inline int
+ble_npl_eventq_get_batch(struct ble_npl_eventq *evq, struct ble_npl_event **evs,
+                         int max, ble_npl_time_t tmo)
+{
+    return npl_freertos_eventq_get_batch(evq, evs, max, tmo);
+}
+
+static inline void
+ble_npl_eventq_put_batch(struct ble_npl_eventq *evq, struct ble_npl_event **evs,
+                         int cnt)
+{
+    npl_freertos_eventq_put_batch(evq, evs, cnt);
+}
+
+/* Takes an event returned by ble_npl_eventq_get_batch() before running it.
+ * Returns false if the event was removed from the queue since, it must not
+ * run in that case. */
+static inline bool
+ble_npl_event_claim(struct ble_npl_event *ev)
+{
+    return npl_freertos_event_claim(ev);
+}
+
+static inline void
+ble_npl_eventq_get_stats(struct ble_npl_eventq *evq,
+                         struct ble_npl_eventq_stats *stats)
+{
+    npl_freertos_eventq_get_stats(evq, stats);
+}
+
+static inline void
+ble_npl_eventq_clear_stats(struct ble_npl_eventq *evq)
+{
+    npl_freertos_eventq_clear_stats(evq);
+}
+
 static inline void
 ble_npl_eventq_remove(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
 {
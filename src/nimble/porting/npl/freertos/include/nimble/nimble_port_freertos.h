@@ -46,6 +46,13 @@ esp_err_t esp_nimble_enable(void *host_task);
  * @return esp_err_t
  */
 esp_err_t esp_nimble_disable(void);
+
+/**
+ * @brief nimble_port_freertos_set_host_core - Set the core the host task is created on
+ *
+ * @param core The core number or tskNO_AFFINITY, used by the next esp_nimble_enable
+ */
+void nimble_port_freertos_set_host_core(BaseType_t core);
 #endif
 
 void nimble_port_freertos_init(TaskFunction_t host_task_fn);
@@ -68,6 +68,22 @@ struct ble_npl_event *npl_freertos_eventq_get(struct ble_npl_eventq *evq,
 void npl_freertos_eventq_put(struct ble_npl_eventq *evq,
                              struct ble_npl_event *ev);
 
+int npl_freertos_eventq_get_batch(struct ble_npl_eventq *evq,
+                                  struct ble_npl_event **evs, int max,
+                                  ble_npl_time_t tmo);
+
+void npl_freertos_eventq_put_batch(struct ble_npl_eventq *evq,
+                                   struct ble_npl_event **evs, int cnt);
+
+bool npl_freertos_event_claim(struct ble_npl_event *ev);
+
+struct ble_npl_eventq_stats;
+
+void npl_freertos_eventq_get_stats(struct ble_npl_eventq *evq,
+                                   struct ble_npl_eventq_stats *stats);
+
+void npl_freertos_eventq_clear_stats(struct ble_npl_eventq *evq);
+
 void npl_freertos_eventq_remove(struct ble_npl_eventq *evq,
                                 struct ble_npl_event *ev);
 
@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#if !defined(NIMBLE_NPL_POSIX)
+
 #include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -44,6 +46,14 @@ static StaticTask_t hs_xTaskBuffer;
 static TaskHandle_t host_task_h = NULL;
 
 #ifdef ESP_PLATFORM
+static BaseType_t host_task_core = NIMBLE_CORE;
+
+void
+nimble_port_freertos_set_host_core(BaseType_t core)
+{
+    host_task_core = core;
+}
+
 /**
  * @brief esp_nimble_enable - Initialize the NimBLE host
  *
@@ -58,7 +68,7 @@ esp_err_t esp_nimble_enable(void *host_task)
      * default queue it is just easier to make separate task which does this.
      */
     xTaskCreatePinnedToCore(host_task, "nimble_host", NIMBLE_HS_STACK_SIZE,
-                            NULL, (configMAX_PRIORITIES - 4), &host_task_h, NIMBLE_CORE);
+                            NULL, (configMAX_PRIORITIES - 4), &host_task_h, host_task_core);
     return ESP_OK;
 
 }
@@ -132,3 +142,5 @@ nimble_port_freertos_get_hs_hwm(void)
 }
 
 #endif //ESP_PLATFORM
+
+#endif // !NIMBLE_NPL_POSIX
@@ -19,6 +19,8 @@
 
 #include "nimble/porting/nimble/include/syscfg/syscfg.h"
 
+#if !defined(NIMBLE_NPL_POSIX)
+
 #if CONFIG_NIMBLE_STACK_USE_MEM_POOLS
 
 #include <assert.h>
@@ -1409,16 +1411,53 @@ npl_freertos_hw_set_isr(int irqn, void (*addr)(void))
 }
 #endif
 
+static inline ble_npl_time_t
+npl_freertos_eventq_now(void)
+{
+    return in_isr() ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+}
+
+/* Updates the queue stats for a wakeup that took cnt events, depth is the
+ * number of events that were waiting including the ones taken. */
+static void
+npl_freertos_eventq_account(struct ble_npl_eventq *evq,
+                            struct ble_npl_event **evs, int cnt,
+                            UBaseType_t depth)
+{
+    ble_npl_time_t now;
+    ble_npl_time_t latency;
+    int i;
+
+    now = npl_freertos_eventq_now();
+
+    evq->stats.num_wakeups++;
+    evq->stats.num_events += cnt;
+    if (depth > evq->stats.max_depth) {
+        evq->stats.max_depth = depth > UINT16_MAX ? UINT16_MAX : depth;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        latency = now - evs[i]->queued_at;
+        if (latency > evq->stats.max_latency) {
+            evq->stats.max_latency = latency;
+        }
+    }
+}
+
 struct ble_npl_event *
 npl_freertos_eventq_get(struct ble_npl_eventq *evq, ble_npl_time_t tmo)
 {
     struct ble_npl_event *ev = NULL;
+    UBaseType_t waiting = 0;
     BaseType_t woken;
     BaseType_t ret;
 
     if (in_isr()) {
         assert(tmo == 0);
         ret = xQueueReceiveFromISR(evq->q, &ev, &woken);
+        if (ev) {
+            waiting = uxQueueMessagesWaitingFromISR(evq->q);
+        }
 #ifdef ESP_PLATFORM
         if( woken == pdTRUE ) {
             portYIELD_FROM_ISR();
@@ -1428,30 +1467,128 @@ npl_freertos_eventq_get(struct ble_npl_eventq *evq, ble_npl_time_t tmo)
 #endif
     } else {
         ret = xQueueReceive(evq->q, &ev, tmo);
+        if (ev) {
+            waiting = uxQueueMessagesWaiting(evq->q);
+        }
     }
     assert(ret == pdPASS || ret == errQUEUE_EMPTY);
 
     if (ev) {
+        npl_freertos_eventq_account(evq, &ev, 1, waiting + 1);
         ev->queued = false;
     }
 
     return ev;
 }
 
+int
+npl_freertos_eventq_get_batch(struct ble_npl_eventq *evq,
+                              struct ble_npl_event **evs, int max,
+                              ble_npl_time_t tmo)
+{
+    UBaseType_t waiting = 0;
+    BaseType_t woken = pdFALSE;
+    BaseType_t woken2;
+    int cnt = 0;
+
+    if (max <= 0) {
+        return 0;
+    }
+
+    if (in_isr()) {
+        assert(tmo == 0);
+        while (cnt < max &&
+               xQueueReceiveFromISR(evq->q, &evs[cnt], &woken2) == pdPASS) {
+            woken |= woken2;
+            cnt++;
+        }
+        if (cnt == max) {
+            waiting = uxQueueMessagesWaitingFromISR(evq->q);
+        }
+#ifdef ESP_PLATFORM
+        if( woken == pdTRUE ) {
+            portYIELD_FROM_ISR();
+        }
+#else
+        portYIELD_FROM_ISR(woken);
+#endif
+    } else {
+        /* Only the first receive blocks, the rest take what is already
+         * waiting so that the caller wakes up once for the whole batch. */
+        if (xQueueReceive(evq->q, &evs[0], tmo) == pdPASS) {
+            cnt = 1;
+            while (cnt < max && xQueueReceive(evq->q, &evs[cnt], 0) == pdPASS) {
+                cnt++;
+            }
+            if (cnt == max) {
+                waiting = uxQueueMessagesWaiting(evq->q);
+            }
+        }
+    }
+
+    /* The events stay queued until they are claimed, so that one waiting in
+     * the batch is not put a second time and can still be removed. */
+    if (cnt > 0) {
+        npl_freertos_eventq_account(evq, evs, cnt, waiting + cnt);
+    }
+
+    return cnt;
+}
+
+bool
+npl_freertos_event_claim(struct ble_npl_event *ev)
+{
+    uint32_t ctx;
+    bool queued;
+
+    ctx = ble_npl_hw_enter_critical();
+    queued = ev->queued;
+    ev->queued = false;
+    ble_npl_hw_exit_critical(ctx);
+
+    return queued;
+}
+
 void
 npl_freertos_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
 {
-    BaseType_t woken;
+    npl_freertos_eventq_put_batch(evq, &ev, 1);
+}
+
+void
+npl_freertos_eventq_put_batch(struct ble_npl_eventq *evq,
+                              struct ble_npl_event **evs, int cnt)
+{
+    ble_npl_time_t now;
+    BaseType_t woken = pdFALSE;
+    BaseType_t woken2;
     BaseType_t ret;
+    bool isr;
+    int i;
 
-    if (ev->queued) {
-        return;
-    }
+    isr = in_isr();
+    now = npl_freertos_eventq_now();
 
-    ev->queued = true;
+    for (i = 0; i < cnt; i++) {
+        if (evs[i]->queued) {
+            continue;
+        }
 
-    if (in_isr()) {
-        ret = xQueueSendToBackFromISR(evq->q, &ev, &woken);
+        evs[i]->queued = true;
+        evs[i]->queued_at = now;
+
+        if (isr) {
+            ret = xQueueSendToBackFromISR(evq->q, &evs[i], &woken2);
+            woken |= woken2;
+        } else {
+            ret = xQueueSendToBack(evq->q, &evs[i], portMAX_DELAY);
+        }
+
+        assert(ret == pdPASS);
+    }
+
+    /* Yield once after all events have been sent. */
+    if (isr) {
 #ifdef ESP_PLATFORM
         if( woken == pdTRUE ) {
             portYIELD_FROM_ISR();
@@ -1459,11 +1596,24 @@ npl_freertos_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
 #else
         portYIELD_FROM_ISR(woken);
 #endif
-    } else {
-        ret = xQueueSendToBack(evq->q, &ev, portMAX_DELAY);
     }
+}
 
-    assert(ret == pdPASS);
+void
+npl_freertos_eventq_get_stats(struct ble_npl_eventq *evq,
+                              struct ble_npl_eventq_stats *stats)
+{
+    ble_npl_hw_enter_critical();
+    *stats = evq->stats;
+    ble_npl_hw_exit_critical(0);
+}
+
+void
+npl_freertos_eventq_clear_stats(struct ble_npl_eventq *evq)
+{
+    ble_npl_hw_enter_critical();
+    memset(&evq->stats, 0, sizeof(evq->stats));
+    ble_npl_hw_exit_critical(0);
 }
 
 void
@@ -1481,6 +1631,10 @@ npl_freertos_eventq_remove(struct ble_npl_eventq *evq,
     }
 
     /*
+     * An event taken by ble_npl_eventq_get_batch() is no longer in the
+     * FreeRTOS queue but is still queued until it is claimed, clearing the
+     * flag below keeps it from running.
+     *
      * XXX We cannot extract element from inside FreeRTOS queue so as a quick
      * workaround we'll just remove all elements and add them back except the
      * one we need to remove. This is silly, but works for now - we probably
@@ -1695,6 +1849,279 @@ npl_freertos_sem_release(struct ble_npl_sem *sem)
 }
 
 
+#if NPL_FREERTOS_SHARED_CALLOUT_TIMER
+/*
+ * All callouts share one FreeRTOS timer.  The pending callouts are kept in a
+ * list sorted by expiry and the timer is only restarted when a callout is
+ * inserted at the head of the list.  Resetting or stopping any other callout
+ * sends no command to the timer task; when the head is removed the timer
+ * fires early and is restarted for the new head.
+ */
+static TimerHandle_t npl_freertos_co_timer;
+static struct ble_npl_callout *npl_freertos_co_list;
+/* Incremented when a callout is inserted at the head of the list. */
+static volatile uint32_t npl_freertos_co_gen;
+/* Set while the timer task runs the shared timer callback. */
+static bool npl_freertos_co_in_timer_cb;
+
+static inline uint32_t
+npl_freertos_co_lock(void)
+{
+#ifdef ESP_PLATFORM
+    portENTER_CRITICAL_SAFE(&ble_port_mutex);
+    return 0;
+#else
+    if (in_isr()) {
+        return taskENTER_CRITICAL_FROM_ISR();
+    }
+
+    vPortEnterCritical();
+    return 0;
+#endif
+}
+
+static inline void
+npl_freertos_co_unlock(uint32_t ctx)
+{
+#ifdef ESP_PLATFORM
+    (void)ctx;
+    portEXIT_CRITICAL_SAFE(&ble_port_mutex);
+#else
+    if (in_isr()) {
+        taskEXIT_CRITICAL_FROM_ISR(ctx);
+    } else {
+        vPortExitCritical();
+    }
+#endif
+}
+
+/* Lock restrictions: caller must hold the callout lock. */
+static void
+npl_freertos_co_unlink(struct ble_npl_callout *co)
+{
+    struct ble_npl_callout **prev;
+
+    if (!co->active) {
+        return;
+    }
+
+    for (prev = &npl_freertos_co_list; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == co) {
+            *prev = co->next;
+            break;
+        }
+    }
+
+    co->next = NULL;
+    co->active = false;
+}
+
+/**
+ * Inserts a callout in expiry order.
+ * Lock restrictions: caller must hold the callout lock.
+ *
+ * @return                      true if the callout is now the first to expire.
+ */
+static bool
+npl_freertos_co_insert(struct ble_npl_callout *co)
+{
+    struct ble_npl_callout **prev;
+
+    prev = &npl_freertos_co_list;
+    while (*prev != NULL &&
+           (ble_npl_stime_t)((*prev)->expiry - co->expiry) <= 0) {
+        prev = &(*prev)->next;
+    }
+
+    co->next = *prev;
+    *prev = co;
+    co->active = true;
+
+    return prev == &npl_freertos_co_list;
+}
+
+/* Restarts the shared timer for the callout at the head of the list. */
+static void
+npl_freertos_co_timer_arm(void)
+{
+    BaseType_t woken;
+    ble_npl_time_t delay;
+    TickType_t wait;
+    uint32_t ctx;
+    uint32_t gen;
+
+    /* The timer task must not block on its own command queue. */
+    wait = npl_freertos_co_in_timer_cb ? 0 : portMAX_DELAY;
+
+    do {
+        ctx = npl_freertos_co_lock();
+        gen = npl_freertos_co_gen;
+        if (npl_freertos_co_list == NULL) {
+            npl_freertos_co_unlock(ctx);
+            return;
+        }
+
+        delay = npl_freertos_co_list->expiry - xTaskGetTickCountFromISR();
+        if ((ble_npl_stime_t)delay <= 0) {
+            delay = 1;
+        }
+        npl_freertos_co_unlock(ctx);
+
+        if (in_isr()) {
+            woken = pdFALSE;
+            xTimerChangePeriodFromISR(npl_freertos_co_timer, delay, &woken);
+#ifdef ESP_PLATFORM
+            if (woken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+#else
+            portYIELD_FROM_ISR(woken);
+#endif
+        } else {
+            xTimerChangePeriod(npl_freertos_co_timer, delay, wait);
+        }
+
+        /* Another callout became the head while the command was sent. */
+    } while (gen != npl_freertos_co_gen);
+}
+
+static void
+npl_freertos_co_timer_cb(TimerHandle_t timer)
+{
+    struct ble_npl_callout *co;
+    ble_npl_time_t now;
+    uint32_t ctx;
+
+    (void)timer;
+    now = xTaskGetTickCount();
+    npl_freertos_co_in_timer_cb = true;
+
+    while (1) {
+        ctx = npl_freertos_co_lock();
+        co = npl_freertos_co_list;
+        if (co != NULL && (ble_npl_stime_t)(co->expiry - now) <= 0) {
+            npl_freertos_co_list = co->next;
+            co->next = NULL;
+            co->active = false;
+        } else {
+            co = NULL;
+        }
+        npl_freertos_co_unlock(ctx);
+
+        if (co == NULL) {
+            break;
+        }
+
+        if (co->evq) {
+            ble_npl_eventq_put(co->evq, &co->ev);
+        } else {
+            co->ev.fn(&co->ev);
+        }
+    }
+
+    npl_freertos_co_timer_arm();
+    npl_freertos_co_in_timer_cb = false;
+}
+
+void
+npl_freertos_callout_init(struct ble_npl_callout *co, struct ble_npl_eventq *evq,
+                          ble_npl_event_fn *ev_cb, void *ev_arg)
+{
+    struct ble_npl_callout **prev;
+    uint32_t ctx;
+
+    if (npl_freertos_co_timer == NULL) {
+        npl_freertos_co_timer = xTimerCreate("co", 1, pdFALSE, NULL,
+                                             npl_freertos_co_timer_cb);
+        assert(npl_freertos_co_timer);
+    }
+
+    /* The callout may not have been initialized before, so its fields are
+     * not trusted: it is only taken out of the list if it is found there. */
+    ctx = npl_freertos_co_lock();
+    for (prev = &npl_freertos_co_list; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == co) {
+            *prev = co->next;
+            break;
+        }
+    }
+    co->next = NULL;
+    co->expiry = 0;
+    co->active = false;
+    npl_freertos_co_unlock(ctx);
+
+    co->evq = evq;
+    ble_npl_event_init(&co->ev, ev_cb, ev_arg);
+}
+
+void
+npl_freertos_callout_deinit(struct ble_npl_callout *co)
+{
+    npl_freertos_callout_stop(co);
+    ble_npl_event_deinit(&co->ev);
+    memset(co, 0, sizeof(struct ble_npl_callout));
+}
+
+ble_npl_error_t
+npl_freertos_callout_reset(struct ble_npl_callout *co, ble_npl_time_t ticks)
+{
+    uint32_t ctx;
+    bool first;
+
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    ctx = npl_freertos_co_lock();
+    npl_freertos_co_unlink(co);
+    co->expiry = xTaskGetTickCountFromISR() + ticks;
+    first = npl_freertos_co_insert(co);
+    if (first) {
+        npl_freertos_co_gen++;
+    }
+    npl_freertos_co_unlock(ctx);
+
+    if (first) {
+        npl_freertos_co_timer_arm();
+    }
+
+    return BLE_NPL_OK;
+}
+
+void
+npl_freertos_callout_stop(struct ble_npl_callout *co)
+{
+    uint32_t ctx;
+
+    ctx = npl_freertos_co_lock();
+    npl_freertos_co_unlink(co);
+    npl_freertos_co_unlock(ctx);
+}
+
+bool
+npl_freertos_callout_is_active(struct ble_npl_callout *co)
+{
+    return co->active;
+}
+
+ble_npl_time_t
+npl_freertos_callout_get_ticks(struct ble_npl_callout *co)
+{
+    return co->expiry;
+}
+
+ble_npl_time_t
+npl_freertos_callout_remaining_ticks(struct ble_npl_callout *co,
+                                     ble_npl_time_t now)
+{
+    if ((ble_npl_stime_t)(co->expiry - now) > 0) {
+        return co->expiry - now;
+    }
+
+    return 0;
+}
+
+#else /* NPL_FREERTOS_SHARED_CALLOUT_TIMER */
 #if CONFIG_BT_NIMBLE_USE_ESP_TIMER
 static void
 ble_npl_event_fn_wrapper(void *arg)
@@ -1908,6 +2335,8 @@ npl_freertos_callout_remaining_ticks(struct ble_npl_callout *co,
     return rt;
 }
 
+#endif /* NPL_FREERTOS_SHARED_CALLOUT_TIMER */
+
 ble_npl_error_t
 npl_freertos_time_ms_to_ticks(uint32_t ms, ble_npl_time_t *out_ticks)
 {
@@ -1939,3 +2368,5 @@ npl_freertos_time_ticks_to_ms(ble_npl_time_t ticks, uint32_t *out_ms)
 }
 
 #endif // CONFIG_NIMBLE_STACK_USE_MEM_POOLS
+
+#endif // !NIMBLE_NPL_POSIX
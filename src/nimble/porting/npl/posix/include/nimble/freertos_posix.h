@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _FREERTOS_POSIX_H_
+#define _FREERTOS_POSIX_H_
+
+/*
+ * The subset of the FreeRTOS task API the C++ classes use, on top of the
+ * POSIX porting layer. Tasks are pthreads, a task notification is a counting
+ * semaphore and ticks are milliseconds like the NPL ticks. Priorities are
+ * recorded but not applied and nothing is pinned to a core.
+ */
+
+#include <sched.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+/* Stack sizes are given in bytes. */
+typedef uint8_t StackType_t;
+
+struct npl_posix_task;
+typedef struct npl_posix_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  (pdFALSE)
+#define pdPASS                  (pdTRUE)
+
+#define portMAX_DELAY           ((TickType_t)UINT32_MAX)
+#define portTICK_PERIOD_MS      ((TickType_t)1)
+#define configTICK_RATE_HZ      (1000)
+#define configMAX_PRIORITIES    (25)
+#define tskIDLE_PRIORITY        ((UBaseType_t)0)
+#define tskNO_AFFINITY          (0x7FFFFFFF)
+
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+#define taskYIELD()             sched_yield()
+
+BaseType_t npl_posix_task_create(TaskFunction_t fn, const char *name,
+                                 uint32_t stack_size, void *param,
+                                 UBaseType_t priority, TaskHandle_t *out_task);
+void npl_posix_task_delete(TaskHandle_t task);
+TaskHandle_t npl_posix_task_get_current(void);
+UBaseType_t npl_posix_task_get_priority(TaskHandle_t task);
+UBaseType_t npl_posix_task_get_stack_hwm(TaskHandle_t task);
+void npl_posix_task_notify_give(TaskHandle_t task);
+uint32_t npl_posix_task_notify_take(BaseType_t clear, TickType_t ticks);
+uint32_t npl_posix_task_notify_clear(TaskHandle_t task, uint32_t bits);
+void npl_posix_task_delay(TickType_t ticks);
+
+static inline BaseType_t
+xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+            void *param, UBaseType_t priority, TaskHandle_t *out_task)
+{
+    return npl_posix_task_create(fn, name, stack_depth * sizeof(StackType_t),
+                                 param, priority, out_task);
+}
+
+/* There are no cores to pin to, the core is ignored. */
+static inline BaseType_t
+xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                        uint32_t stack_depth, void *param,
+                        UBaseType_t priority, TaskHandle_t *out_task,
+                        BaseType_t core)
+{
+    (void)core;
+    return xTaskCreate(fn, name, stack_depth, param, priority, out_task);
+}
+
+/*
+ * Deleting another task takes effect when it next waits for a notification,
+ * the C++ task loops all do.
+ */
+static inline void
+vTaskDelete(TaskHandle_t task)
+{
+    npl_posix_task_delete(task);
+}
+
+static inline TaskHandle_t
+xTaskGetCurrentTaskHandle(void)
+{
+    return npl_posix_task_get_current();
+}
+
+static inline UBaseType_t
+uxTaskPriorityGet(TaskHandle_t task)
+{
+    return npl_posix_task_get_priority(task);
+}
+
+/* The stack is not measured, this is the size the task was created with. */
+static inline UBaseType_t
+uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return npl_posix_task_get_stack_hwm(task);
+}
+
+static inline BaseType_t
+xTaskNotifyGive(TaskHandle_t task)
+{
+    npl_posix_task_notify_give(task);
+    return pdPASS;
+}
+
+static inline uint32_t
+ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    return npl_posix_task_notify_take(clear, ticks);
+}
+
+/* A macro like in FreeRTOS so that callers can test for it with #ifdef. */
+#define ulTaskNotifyValueClear(task, bits) \
+    npl_posix_task_notify_clear((task), (bits))
+
+static inline void
+vTaskDelay(TickType_t ticks)
+{
+    npl_posix_task_delay(ticks);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FREERTOS_POSIX_H_ */
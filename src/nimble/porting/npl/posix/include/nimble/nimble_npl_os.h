@@ -0,0 +1,445 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _NIMBLE_NPL_OS_H_
+#define _NIMBLE_NPL_OS_H_
+
+/*
+ * POSIX implementation of the NimBLE porting layer, selected by defining
+ * NIMBLE_NPL_POSIX. Tasks are pthreads, ticks are milliseconds of the
+ * monotonic clock and the critical section is a process wide recursive mutex.
+ * It is meant to run the host on a PC, with an HCI transport like the Linux
+ * HCI socket one, for debugging and profiling.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "nimble/porting/nimble/include/syscfg/syscfg.h"
+#include "freertos_posix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(array) \
+        (sizeof(array) / sizeof((array)[0]))
+#endif
+
+#define IRAM_ATTR
+#define NIMBLE_CFG_CONTROLLER   0
+
+#define BLE_NPL_OS_ALIGNMENT    (__SIZEOF_POINTER__)
+
+#define BLE_NPL_TIME_FOREVER    (UINT32_MAX)
+
+/* Ticks are milliseconds. */
+typedef uint32_t ble_npl_time_t;
+typedef int32_t ble_npl_stime_t;
+
+struct ble_npl_event;
+typedef void ble_npl_event_fn(struct ble_npl_event *ev);
+
+struct ble_npl_event {
+    bool queued;
+    ble_npl_event_fn *fn;
+    void *arg;
+    /* Tick count when the event was put on a queue, used for latency stats. */
+    ble_npl_time_t queued_at;
+    /* The next event on the queue. */
+    struct ble_npl_event *next;
+};
+
+/* Counters updated by the task that takes events from the queue. */
+struct ble_npl_eventq_stats {
+    /* Number of times the consumer woke up and found events. */
+    uint32_t num_wakeups;
+    /* Number of events taken from the queue. */
+    uint32_t num_events;
+    /* Largest number of events waiting at a wakeup. */
+    uint16_t max_depth;
+    /* Longest time in ticks an event waited on the queue. */
+    ble_npl_time_t max_latency;
+};
+
+struct ble_npl_eventq {
+    struct ble_npl_event *head;
+    struct ble_npl_event *tail;
+    uint16_t depth;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct ble_npl_eventq_stats stats;
+};
+
+/* All callouts are run by one timer thread. */
+struct ble_npl_callout {
+    /* The next pending callout, the list is sorted by expiry. */
+    struct ble_npl_callout *next;
+    ble_npl_time_t expiry;
+    bool active;
+    struct ble_npl_eventq *evq;
+    struct ble_npl_event ev;
+};
+
+struct ble_npl_mutex {
+    pthread_mutex_t lock;
+};
+
+struct ble_npl_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint16_t count;
+};
+
+bool npl_posix_os_started(void);
+void *npl_posix_get_current_task_id(void);
+
+void npl_posix_eventq_init(struct ble_npl_eventq *evq);
+void npl_posix_eventq_deinit(struct ble_npl_eventq *evq);
+struct ble_npl_event *npl_posix_eventq_get(struct ble_npl_eventq *evq,
+                                           ble_npl_time_t tmo);
+void npl_posix_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev);
+int npl_posix_eventq_get_batch(struct ble_npl_eventq *evq,
+                               struct ble_npl_event **evs, int max,
+                               ble_npl_time_t tmo);
+void npl_posix_eventq_put_batch(struct ble_npl_eventq *evq,
+                                struct ble_npl_event **evs, int cnt);
+void npl_posix_eventq_get_stats(struct ble_npl_eventq *evq,
+                                struct ble_npl_eventq_stats *stats);
+void npl_posix_eventq_clear_stats(struct ble_npl_eventq *evq);
+void npl_posix_eventq_remove(struct ble_npl_eventq *evq,
+                             struct ble_npl_event *ev);
+bool npl_posix_eventq_is_empty(struct ble_npl_eventq *evq);
+
+ble_npl_error_t npl_posix_mutex_init(struct ble_npl_mutex *mu);
+ble_npl_error_t npl_posix_mutex_deinit(struct ble_npl_mutex *mu);
+ble_npl_error_t npl_posix_mutex_pend(struct ble_npl_mutex *mu,
+                                     ble_npl_time_t timeout);
+ble_npl_error_t npl_posix_mutex_release(struct ble_npl_mutex *mu);
+
+ble_npl_error_t npl_posix_sem_init(struct ble_npl_sem *sem, uint16_t tokens);
+ble_npl_error_t npl_posix_sem_deinit(struct ble_npl_sem *sem);
+ble_npl_error_t npl_posix_sem_pend(struct ble_npl_sem *sem,
+                                   ble_npl_time_t timeout);
+ble_npl_error_t npl_posix_sem_release(struct ble_npl_sem *sem);
+uint16_t npl_posix_sem_get_count(struct ble_npl_sem *sem);
+
+void npl_posix_callout_init(struct ble_npl_callout *co,
+                            struct ble_npl_eventq *evq,
+                            ble_npl_event_fn *ev_cb, void *ev_arg);
+void npl_posix_callout_deinit(struct ble_npl_callout *co);
+ble_npl_error_t npl_posix_callout_reset(struct ble_npl_callout *co,
+                                        ble_npl_time_t ticks);
+void npl_posix_callout_stop(struct ble_npl_callout *co);
+bool npl_posix_callout_is_active(struct ble_npl_callout *co);
+ble_npl_time_t npl_posix_callout_get_ticks(struct ble_npl_callout *co);
+ble_npl_time_t npl_posix_callout_remaining_ticks(struct ble_npl_callout *co,
+                                                 ble_npl_time_t now);
+
+ble_npl_time_t npl_posix_time_get(void);
+void npl_posix_time_delay(ble_npl_time_t ticks);
+
+uint32_t npl_posix_hw_enter_critical(void);
+void npl_posix_hw_exit_critical(uint32_t ctx);
+bool npl_posix_hw_is_in_critical(void);
+
+static inline bool
+ble_npl_os_started(void)
+{
+    return npl_posix_os_started();
+}
+
+static inline void *
+ble_npl_get_current_task_id(void)
+{
+    return npl_posix_get_current_task_id();
+}
+
+static inline void
+ble_npl_eventq_init(struct ble_npl_eventq *evq)
+{
+    npl_posix_eventq_init(evq);
+}
+
+static inline void
+ble_npl_eventq_deinit(struct ble_npl_eventq *evq)
+{
+    npl_posix_eventq_deinit(evq);
+}
+
+static inline struct ble_npl_event *
+ble_npl_eventq_get(struct ble_npl_eventq *evq, ble_npl_time_t tmo)
+{
+    return npl_posix_eventq_get(evq, tmo);
+}
+
+static inline void
+ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
+{
+    npl_posix_eventq_put(evq, ev);
+}
+
+/* Waits up to tmo for the first event, then takes up to max events without
+ * waiting. Returns the number of events stored in evs. */
+static inline int
+ble_npl_eventq_get_batch(struct ble_npl_eventq *evq, struct ble_npl_event **evs,
+                         int max, ble_npl_time_t tmo)
+{
+    return npl_posix_eventq_get_batch(evq, evs, max, tmo);
+}
+
+static inline void
+ble_npl_eventq_put_batch(struct ble_npl_eventq *evq, struct ble_npl_event **evs,
+                         int cnt)
+{
+    npl_posix_eventq_put_batch(evq, evs, cnt);
+}
+
+static inline void
+ble_npl_eventq_get_stats(struct ble_npl_eventq *evq,
+                         struct ble_npl_eventq_stats *stats)
+{
+    npl_posix_eventq_get_stats(evq, stats);
+}
+
+static inline void
+ble_npl_eventq_clear_stats(struct ble_npl_eventq *evq)
+{
+    npl_posix_eventq_clear_stats(evq);
+}
+
+static inline void
+ble_npl_eventq_remove(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
+{
+    npl_posix_eventq_remove(evq, ev);
+}
+
+static inline void
+ble_npl_event_run(struct ble_npl_event *ev)
+{
+    ev->fn(ev);
+}
+
+static inline bool
+ble_npl_eventq_is_empty(struct ble_npl_eventq *evq)
+{
+    return npl_posix_eventq_is_empty(evq);
+}
+
+static inline void
+ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn,
+                   void *arg)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->fn = fn;
+    ev->arg = arg;
+}
+
+static inline void
+ble_npl_event_deinit(struct ble_npl_event *ev)
+{
+
+}
+
+static inline bool
+ble_npl_event_is_queued(struct ble_npl_event *ev)
+{
+    return ev->queued;
+}
+
+static inline void *
+ble_npl_event_get_arg(struct ble_npl_event *ev)
+{
+    return ev->arg;
+}
+
+static inline void
+ble_npl_event_set_arg(struct ble_npl_event *ev, void *arg)
+{
+    ev->arg = arg;
+}
+
+static inline ble_npl_error_t
+ble_npl_mutex_init(struct ble_npl_mutex *mu)
+{
+    return npl_posix_mutex_init(mu);
+}
+
+static inline ble_npl_error_t
+ble_npl_mutex_deinit(struct ble_npl_mutex *mu)
+{
+    return npl_posix_mutex_deinit(mu);
+}
+
+static inline ble_npl_error_t
+ble_npl_mutex_pend(struct ble_npl_mutex *mu, ble_npl_time_t timeout)
+{
+    return npl_posix_mutex_pend(mu, timeout);
+}
+
+static inline ble_npl_error_t
+ble_npl_mutex_release(struct ble_npl_mutex *mu)
+{
+    return npl_posix_mutex_release(mu);
+}
+
+static inline ble_npl_error_t
+ble_npl_sem_init(struct ble_npl_sem *sem, uint16_t tokens)
+{
+    return npl_posix_sem_init(sem, tokens);
+}
+
+static inline ble_npl_error_t
+ble_npl_sem_deinit(struct ble_npl_sem *sem)
+{
+    return npl_posix_sem_deinit(sem);
+}
+
+static inline ble_npl_error_t
+ble_npl_sem_pend(struct ble_npl_sem *sem, ble_npl_time_t timeout)
+{
+    return npl_posix_sem_pend(sem, timeout);
+}
+
+static inline ble_npl_error_t
+ble_npl_sem_release(struct ble_npl_sem *sem)
+{
+    return npl_posix_sem_release(sem);
+}
+
+static inline uint16_t
+ble_npl_sem_get_count(struct ble_npl_sem *sem)
+{
+    return npl_posix_sem_get_count(sem);
+}
+
+static inline void
+ble_npl_callout_init(struct ble_npl_callout *co, struct ble_npl_eventq *evq,
+                     ble_npl_event_fn *ev_cb, void *ev_arg)
+{
+    npl_posix_callout_init(co, evq, ev_cb, ev_arg);
+}
+
+static inline void
+ble_npl_callout_deinit(struct ble_npl_callout *co)
+{
+    npl_posix_callout_deinit(co);
+}
+
+static inline ble_npl_error_t
+ble_npl_callout_reset(struct ble_npl_callout *co, ble_npl_time_t ticks)
+{
+    return npl_posix_callout_reset(co, ticks);
+}
+
+static inline void
+ble_npl_callout_stop(struct ble_npl_callout *co)
+{
+    npl_posix_callout_stop(co);
+}
+
+static inline bool
+ble_npl_callout_is_active(struct ble_npl_callout *co)
+{
+    return npl_posix_callout_is_active(co);
+}
+
+static inline ble_npl_time_t
+ble_npl_callout_get_ticks(struct ble_npl_callout *co)
+{
+    return npl_posix_callout_get_ticks(co);
+}
+
+static inline uint32_t
+ble_npl_callout_remaining_ticks(struct ble_npl_callout *co,
+                                ble_npl_time_t time)
+{
+    return npl_posix_callout_remaining_ticks(co, time);
+}
+
+static inline void
+ble_npl_callout_set_arg(struct ble_npl_callout *co, void *arg)
+{
+    co->ev.arg = arg;
+}
+
+static inline uint32_t
+ble_npl_time_get(void)
+{
+    return npl_posix_time_get();
+}
+
+static inline ble_npl_error_t
+ble_npl_time_ms_to_ticks(uint32_t ms, ble_npl_time_t *out_ticks)
+{
+    *out_ticks = ms;
+    return BLE_NPL_OK;
+}
+
+static inline ble_npl_error_t
+ble_npl_time_ticks_to_ms(ble_npl_time_t ticks, uint32_t *out_ms)
+{
+    *out_ms = ticks;
+    return BLE_NPL_OK;
+}
+
+static inline ble_npl_time_t
+ble_npl_time_ms_to_ticks32(uint32_t ms)
+{
+    return ms;
+}
+
+static inline uint32_t
+ble_npl_time_ticks_to_ms32(ble_npl_time_t ticks)
+{
+    return ticks;
+}
+
+static inline void
+ble_npl_time_delay(ble_npl_time_t ticks)
+{
+    npl_posix_time_delay(ticks);
+}
+
+static inline uint32_t
+ble_npl_hw_enter_critical(void)
+{
+    return npl_posix_hw_enter_critical();
+}
+
+static inline void
+ble_npl_hw_exit_critical(uint32_t ctx)
+{
+    npl_posix_hw_exit_critical(ctx);
+}
+
+static inline bool
+ble_npl_hw_is_in_critical(void)
+{
+    return npl_posix_hw_is_in_critical();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _NIMBLE_NPL_OS_H_ */
@@ -0,0 +1,239 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#if defined(NIMBLE_NPL_POSIX)
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+
+struct npl_posix_task {
+    TaskFunction_t fn;
+    void *param;
+    UBaseType_t priority;
+    uint32_t stack_size;
+    /* The notification value is the count of the semaphore. */
+    struct ble_npl_sem notify;
+    /* Set by vTaskDelete() from another task, the task exits on its next wait. */
+    volatile bool deleted;
+};
+
+static pthread_once_t npl_posix_task_once = PTHREAD_ONCE_INIT;
+static pthread_key_t npl_posix_task_key;
+
+/* Frees the task of a thread when the thread exits. */
+static void
+npl_posix_task_free(void *arg)
+{
+    struct npl_posix_task *task = arg;
+
+    ble_npl_sem_deinit(&task->notify);
+    free(task);
+}
+
+static void
+npl_posix_task_init_key(void)
+{
+    int rc;
+
+    rc = pthread_key_create(&npl_posix_task_key, npl_posix_task_free);
+    assert(rc == 0);
+    (void)rc;
+}
+
+static struct npl_posix_task *
+npl_posix_task_alloc(TaskFunction_t fn, void *param, UBaseType_t priority,
+                     uint32_t stack_size)
+{
+    struct npl_posix_task *task;
+
+    task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return NULL;
+    }
+
+    task->fn = fn;
+    task->param = param;
+    task->priority = priority;
+    task->stack_size = stack_size;
+    ble_npl_sem_init(&task->notify, 0);
+
+    return task;
+}
+
+static void *
+npl_posix_task_run(void *arg)
+{
+    struct npl_posix_task *task = arg;
+
+    pthread_setspecific(npl_posix_task_key, task);
+    task->fn(task->param);
+
+    /* Like FreeRTOS, returning from the task function is not allowed. */
+    assert(0);
+    return NULL;
+}
+
+BaseType_t
+npl_posix_task_create(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                      void *param, UBaseType_t priority, TaskHandle_t *out_task)
+{
+    struct npl_posix_task *task;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int rc;
+
+    (void)name;
+
+    pthread_once(&npl_posix_task_once, npl_posix_task_init_key);
+
+    task = npl_posix_task_alloc(fn, param, priority, stack_size);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+
+    /* The default thread stack is used, a PC build needs more than a target. */
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&thread, &attr, npl_posix_task_run, task);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        npl_posix_task_free(task);
+        return pdFAIL;
+    }
+
+    if (out_task != NULL) {
+        *out_task = task;
+    }
+
+    return pdPASS;
+}
+
+TaskHandle_t
+npl_posix_task_get_current(void)
+{
+    struct npl_posix_task *task;
+
+    pthread_once(&npl_posix_task_once, npl_posix_task_init_key);
+
+    task = pthread_getspecific(npl_posix_task_key);
+    if (task == NULL) {
+        /* A thread not created with xTaskCreate, like the main thread. */
+        task = npl_posix_task_alloc(NULL, NULL, tskIDLE_PRIORITY, 0);
+        assert(task != NULL);
+        pthread_setspecific(npl_posix_task_key, task);
+    }
+
+    return task;
+}
+
+void
+npl_posix_task_delete(TaskHandle_t task)
+{
+    if (task == NULL || task == npl_posix_task_get_current()) {
+        pthread_exit(NULL);
+    }
+
+    task->deleted = true;
+    ble_npl_sem_release(&task->notify);
+}
+
+UBaseType_t
+npl_posix_task_get_priority(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = npl_posix_task_get_current();
+    }
+
+    return task->priority;
+}
+
+UBaseType_t
+npl_posix_task_get_stack_hwm(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = npl_posix_task_get_current();
+    }
+
+    return task->stack_size / sizeof(StackType_t);
+}
+
+void
+npl_posix_task_notify_give(TaskHandle_t task)
+{
+    ble_npl_sem_release(&task->notify);
+}
+
+uint32_t
+npl_posix_task_notify_take(BaseType_t clear, TickType_t ticks)
+{
+    struct npl_posix_task *task = npl_posix_task_get_current();
+    uint32_t value;
+
+    if (task->deleted) {
+        pthread_exit(NULL);
+    }
+
+    if (ble_npl_sem_pend(&task->notify, ticks) != BLE_NPL_OK) {
+        return 0;
+    }
+
+    if (task->deleted) {
+        pthread_exit(NULL);
+    }
+
+    value = 1;
+    if (clear) {
+        while (ble_npl_sem_pend(&task->notify, 0) == BLE_NPL_OK) {
+            value++;
+        }
+    }
+
+    return value;
+}
+
+uint32_t
+npl_posix_task_notify_clear(TaskHandle_t task, uint32_t bits)
+{
+    uint32_t value = 0;
+
+    if (task == NULL) {
+        task = npl_posix_task_get_current();
+    }
+
+    /* Only the count is kept, any bits clear all of it. */
+    if (bits != 0) {
+        while (ble_npl_sem_pend(&task->notify, 0) == BLE_NPL_OK) {
+            value++;
+        }
+    }
+
+    return value;
+}
+
+void
+npl_posix_task_delay(TickType_t ticks)
+{
+    ble_npl_time_delay(ticks);
+}
+
+#endif /* NIMBLE_NPL_POSIX */
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#if defined(NIMBLE_NPL_POSIX)
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "../include/nimble/nimble_port_posix.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#include "nimble/porting/npl/freertos/include/nimble/nimble_port_freertos.h"
+
+static pthread_t host_thread;
+static bool host_thread_started;
+
+int
+nimble_port_posix_init(void *(*host_task_fn)(void *))
+{
+    int rc;
+
+    rc = pthread_create(&host_thread, NULL, host_task_fn, NULL);
+    host_thread_started = (rc == 0);
+    return rc;
+}
+
+void
+nimble_port_posix_deinit(void)
+{
+    if (host_thread_started) {
+        pthread_join(host_thread, NULL);
+        host_thread_started = false;
+    }
+}
+
+/*
+ * The FreeRTOS port entry points, used by NimBLEDevice, on a task of the
+ * FreeRTOS task shim.
+ */
+static TaskHandle_t host_task_h;
+
+void
+nimble_port_freertos_init(TaskFunction_t host_task_fn)
+{
+    xTaskCreate(host_task_fn, "ble", NIMBLE_HS_STACK_SIZE,
+                NULL, configMAX_PRIORITIES - 1, &host_task_h);
+}
+
+void
+nimble_port_freertos_deinit(void)
+{
+    TaskHandle_t task = host_task_h;
+
+    if (task) {
+        host_task_h = NULL;
+        vTaskDelete(task);
+    }
+}
+
+#endif /* NIMBLE_NPL_POSIX */
@@ -0,0 +1,675 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#if defined(NIMBLE_NPL_POSIX)
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include "nimble/nimble/include/nimble/nimble_npl.h"
+
+static pthread_mutex_t npl_posix_critical_lock;
+static __thread uint32_t npl_posix_critical_depth;
+
+static pthread_once_t npl_posix_init_once = PTHREAD_ONCE_INIT;
+static struct timespec npl_posix_start_time;
+
+static pthread_mutex_t npl_posix_callout_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t npl_posix_callout_cond;
+static struct ble_npl_callout *npl_posix_callout_head;
+static pthread_t npl_posix_callout_thread;
+
+static void *npl_posix_callout_task(void *arg);
+
+/* Initializes a condition variable on the monotonic clock the ticks are counted with. */
+static void
+npl_posix_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void
+npl_posix_init(void)
+{
+    pthread_mutexattr_t attr;
+    int rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &npl_posix_start_time);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&npl_posix_critical_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    npl_posix_cond_init(&npl_posix_callout_cond);
+
+    rc = pthread_create(&npl_posix_callout_thread, NULL, npl_posix_callout_task, NULL);
+    assert(rc == 0);
+    (void)rc;
+}
+
+/* Converts a timeout in ticks to the absolute monotonic time to wait until. */
+static void
+npl_posix_abs_time(ble_npl_time_t ticks, struct timespec *ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/* Waits on a condition variable for at most tmo ticks, returns false on timeout. */
+static bool
+npl_posix_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+                    const struct timespec *deadline, ble_npl_time_t tmo)
+{
+    if (tmo == BLE_NPL_TIME_FOREVER) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+bool
+npl_posix_os_started(void)
+{
+    return true;
+}
+
+void *
+npl_posix_get_current_task_id(void)
+{
+    return (void *)(uintptr_t)pthread_self();
+}
+
+ble_npl_time_t
+npl_posix_time_get(void)
+{
+    struct timespec now;
+
+    pthread_once(&npl_posix_init_once, npl_posix_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (ble_npl_time_t)((now.tv_sec - npl_posix_start_time.tv_sec) * 1000 +
+                            (now.tv_nsec - npl_posix_start_time.tv_nsec) / 1000000);
+}
+
+void
+npl_posix_time_delay(ble_npl_time_t ticks)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ticks / 1000;
+    ts.tv_nsec = (long)(ticks % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void
+npl_posix_eventq_init(struct ble_npl_eventq *evq)
+{
+    memset(evq, 0, sizeof(*evq));
+    pthread_mutex_init(&evq->lock, NULL);
+    npl_posix_cond_init(&evq->cond);
+}
+
+void
+npl_posix_eventq_deinit(struct ble_npl_eventq *evq)
+{
+    pthread_cond_destroy(&evq->cond);
+    pthread_mutex_destroy(&evq->lock);
+}
+
+/* Takes the first event, the queue lock must be held and the queue not empty. */
+static struct ble_npl_event *
+npl_posix_eventq_pop(struct ble_npl_eventq *evq)
+{
+    struct ble_npl_event *ev = evq->head;
+    ble_npl_time_t latency;
+
+    evq->head = ev->next;
+    if (evq->head == NULL) {
+        evq->tail = NULL;
+    }
+    evq->depth--;
+
+    ev->next = NULL;
+    ev->queued = false;
+
+    evq->stats.num_events++;
+    latency = npl_posix_time_get() - ev->queued_at;
+    if (latency > evq->stats.max_latency) {
+        evq->stats.max_latency = latency;
+    }
+
+    return ev;
+}
+
+/* Waits for the queue to have an event, the queue lock must be held. */
+static bool
+npl_posix_eventq_wait(struct ble_npl_eventq *evq, ble_npl_time_t tmo)
+{
+    struct timespec deadline;
+
+    if (evq->head == NULL && tmo != 0) {
+        if (tmo != BLE_NPL_TIME_FOREVER) {
+            npl_posix_abs_time(tmo, &deadline);
+        }
+        while (evq->head == NULL) {
+            if (!npl_posix_cond_wait(&evq->cond, &evq->lock, &deadline, tmo)) {
+                break;
+            }
+        }
+    }
+
+    if (evq->head == NULL) {
+        return false;
+    }
+
+    evq->stats.num_wakeups++;
+    if (evq->depth > evq->stats.max_depth) {
+        evq->stats.max_depth = evq->depth;
+    }
+    return true;
+}
+
+struct ble_npl_event *
+npl_posix_eventq_get(struct ble_npl_eventq *evq, ble_npl_time_t tmo)
+{
+    struct ble_npl_event *ev = NULL;
+
+    pthread_mutex_lock(&evq->lock);
+    if (npl_posix_eventq_wait(evq, tmo)) {
+        ev = npl_posix_eventq_pop(evq);
+    }
+    pthread_mutex_unlock(&evq->lock);
+
+    return ev;
+}
+
+int
+npl_posix_eventq_get_batch(struct ble_npl_eventq *evq,
+                           struct ble_npl_event **evs, int max,
+                           ble_npl_time_t tmo)
+{
+    int cnt = 0;
+
+    pthread_mutex_lock(&evq->lock);
+    if (npl_posix_eventq_wait(evq, tmo)) {
+        while (cnt < max && evq->head != NULL) {
+            evs[cnt++] = npl_posix_eventq_pop(evq);
+        }
+    }
+    pthread_mutex_unlock(&evq->lock);
+
+    return cnt;
+}
+
+/* Adds an event at the end of the queue, the queue lock must be held. */
+static void
+npl_posix_eventq_push(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
+{
+    if (ev->queued) {
+        return;
+    }
+
+    ev->queued = true;
+    ev->queued_at = npl_posix_time_get();
+    ev->next = NULL;
+    if (evq->tail == NULL) {
+        evq->head = ev;
+    } else {
+        evq->tail->next = ev;
+    }
+    evq->tail = ev;
+    evq->depth++;
+}
+
+void
+npl_posix_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
+{
+    pthread_mutex_lock(&evq->lock);
+    npl_posix_eventq_push(evq, ev);
+    pthread_cond_signal(&evq->cond);
+    pthread_mutex_unlock(&evq->lock);
+}
+
+void
+npl_posix_eventq_put_batch(struct ble_npl_eventq *evq,
+                           struct ble_npl_event **evs, int cnt)
+{
+    int i;
+
+    if (cnt <= 0) {
+        return;
+    }
+
+    /* The events were taken from the front of the queue, so they go back in front. */
+    pthread_mutex_lock(&evq->lock);
+    for (i = cnt - 1; i >= 0; i--) {
+        if (evs[i]->queued) {
+            continue;
+        }
+        evs[i]->queued = true;
+        evs[i]->queued_at = npl_posix_time_get();
+        evs[i]->next = evq->head;
+        evq->head = evs[i];
+        if (evq->tail == NULL) {
+            evq->tail = evs[i];
+        }
+        evq->depth++;
+    }
+    pthread_cond_signal(&evq->cond);
+    pthread_mutex_unlock(&evq->lock);
+}
+
+void
+npl_posix_eventq_get_stats(struct ble_npl_eventq *evq,
+                           struct ble_npl_eventq_stats *stats)
+{
+    pthread_mutex_lock(&evq->lock);
+    *stats = evq->stats;
+    pthread_mutex_unlock(&evq->lock);
+}
+
+void
+npl_posix_eventq_clear_stats(struct ble_npl_eventq *evq)
+{
+    pthread_mutex_lock(&evq->lock);
+    memset(&evq->stats, 0, sizeof(evq->stats));
+    pthread_mutex_unlock(&evq->lock);
+}
+
+void
+npl_posix_eventq_remove(struct ble_npl_eventq *evq, struct ble_npl_event *ev)
+{
+    struct ble_npl_event *prev = NULL;
+    struct ble_npl_event *cur;
+
+    pthread_mutex_lock(&evq->lock);
+    if (ev->queued) {
+        for (cur = evq->head; cur != NULL; prev = cur, cur = cur->next) {
+            if (cur != ev) {
+                continue;
+            }
+            if (prev == NULL) {
+                evq->head = ev->next;
+            } else {
+                prev->next = ev->next;
+            }
+            if (evq->tail == ev) {
+                evq->tail = prev;
+            }
+            evq->depth--;
+            break;
+        }
+        ev->next = NULL;
+        ev->queued = false;
+    }
+    pthread_mutex_unlock(&evq->lock);
+}
+
+bool
+npl_posix_eventq_is_empty(struct ble_npl_eventq *evq)
+{
+    bool empty;
+
+    pthread_mutex_lock(&evq->lock);
+    empty = (evq->head == NULL);
+    pthread_mutex_unlock(&evq->lock);
+
+    return empty;
+}
+
+ble_npl_error_t
+npl_posix_mutex_init(struct ble_npl_mutex *mu)
+{
+    pthread_mutexattr_t attr;
+
+    if (!mu) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mu->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t
+npl_posix_mutex_deinit(struct ble_npl_mutex *mu)
+{
+    if (!mu) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_mutex_destroy(&mu->lock);
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t
+npl_posix_mutex_pend(struct ble_npl_mutex *mu, ble_npl_time_t timeout)
+{
+    struct timespec deadline;
+    int rc;
+
+    if (!mu) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    if (timeout == BLE_NPL_TIME_FOREVER) {
+        rc = pthread_mutex_lock(&mu->lock);
+    } else if (timeout == 0) {
+        rc = pthread_mutex_trylock(&mu->lock);
+    } else {
+        /* pthread_mutex_timedlock only takes the realtime clock. */
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        rc = pthread_mutex_timedlock(&mu->lock, &deadline);
+    }
+
+    return rc == 0 ? BLE_NPL_OK : BLE_NPL_TIMEOUT;
+}
+
+ble_npl_error_t
+npl_posix_mutex_release(struct ble_npl_mutex *mu)
+{
+    if (!mu) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    if (pthread_mutex_unlock(&mu->lock) != 0) {
+        return BLE_NPL_BAD_MUTEX;
+    }
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t
+npl_posix_sem_init(struct ble_npl_sem *sem, uint16_t tokens)
+{
+    if (!sem) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_mutex_init(&sem->lock, NULL);
+    npl_posix_cond_init(&sem->cond);
+    sem->count = tokens;
+
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t
+npl_posix_sem_deinit(struct ble_npl_sem *sem)
+{
+    if (!sem) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t
+npl_posix_sem_pend(struct ble_npl_sem *sem, ble_npl_time_t timeout)
+{
+    struct timespec deadline;
+    ble_npl_error_t rc = BLE_NPL_OK;
+
+    if (!sem) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count == 0 && timeout != 0 && timeout != BLE_NPL_TIME_FOREVER) {
+        npl_posix_abs_time(timeout, &deadline);
+    }
+    while (sem->count == 0) {
+        if (timeout == 0 ||
+            !npl_posix_cond_wait(&sem->cond, &sem->lock, &deadline, timeout)) {
+            break;
+        }
+    }
+
+    if (sem->count > 0) {
+        sem->count--;
+    } else {
+        rc = BLE_NPL_TIMEOUT;
+    }
+    pthread_mutex_unlock(&sem->lock);
+
+    return rc;
+}
+
+ble_npl_error_t
+npl_posix_sem_release(struct ble_npl_sem *sem)
+{
+    if (!sem) {
+        return BLE_NPL_INVALID_PARAM;
+    }
+
+    pthread_mutex_lock(&sem->lock);
+    sem->count++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+
+    return BLE_NPL_OK;
+}
+
+uint16_t
+npl_posix_sem_get_count(struct ble_npl_sem *sem)
+{
+    uint16_t count;
+
+    pthread_mutex_lock(&sem->lock);
+    count = sem->count;
+    pthread_mutex_unlock(&sem->lock);
+
+    return count;
+}
+
+/* Removes a callout from the pending list, the callout lock must be held. */
+static void
+npl_posix_callout_unlink(struct ble_npl_callout *co)
+{
+    struct ble_npl_callout **pp;
+
+    if (!co->active) {
+        return;
+    }
+
+    for (pp = &npl_posix_callout_head; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == co) {
+            *pp = co->next;
+            break;
+        }
+    }
+    co->next = NULL;
+    co->active = false;
+}
+
+/* Runs the expired callouts by posting their events, sleeping until the next expiry. */
+static void *
+npl_posix_callout_task(void *arg)
+{
+    struct ble_npl_callout *co;
+    struct timespec deadline;
+    ble_npl_time_t now;
+
+    pthread_mutex_lock(&npl_posix_callout_lock);
+    while (1) {
+        co = npl_posix_callout_head;
+        if (co == NULL) {
+            pthread_cond_wait(&npl_posix_callout_cond, &npl_posix_callout_lock);
+            continue;
+        }
+
+        now = npl_posix_time_get();
+        if ((ble_npl_stime_t)(co->expiry - now) > 0) {
+            npl_posix_abs_time(co->expiry - now, &deadline);
+            pthread_cond_timedwait(&npl_posix_callout_cond, &npl_posix_callout_lock, &deadline);
+            continue;
+        }
+
+        npl_posix_callout_head = co->next;
+        co->next = NULL;
+        co->active = false;
+
+        if (co->evq != NULL) {
+            ble_npl_eventq_put(co->evq, &co->ev);
+        } else {
+            /* Without a queue the callout event runs on this thread. */
+            pthread_mutex_unlock(&npl_posix_callout_lock);
+            ble_npl_event_run(&co->ev);
+            pthread_mutex_lock(&npl_posix_callout_lock);
+        }
+    }
+
+    return NULL;
+}
+
+void
+npl_posix_callout_init(struct ble_npl_callout *co, struct ble_npl_eventq *evq,
+                       ble_npl_event_fn *ev_cb, void *ev_arg)
+{
+    pthread_once(&npl_posix_init_once, npl_posix_init);
+
+    memset(co, 0, sizeof(*co));
+    co->evq = evq;
+    ble_npl_event_init(&co->ev, ev_cb, ev_arg);
+}
+
+void
+npl_posix_callout_deinit(struct ble_npl_callout *co)
+{
+    npl_posix_callout_stop(co);
+}
+
+ble_npl_error_t
+npl_posix_callout_reset(struct ble_npl_callout *co, ble_npl_time_t ticks)
+{
+    struct ble_npl_callout **pp;
+
+    pthread_mutex_lock(&npl_posix_callout_lock);
+    npl_posix_callout_unlink(co);
+
+    co->expiry = npl_posix_time_get() + ticks;
+    co->active = true;
+    for (pp = &npl_posix_callout_head; *pp != NULL; pp = &(*pp)->next) {
+        if ((ble_npl_stime_t)(co->expiry - (*pp)->expiry) < 0) {
+            break;
+        }
+    }
+    co->next = *pp;
+    *pp = co;
+
+    if (npl_posix_callout_head == co) {
+        pthread_cond_signal(&npl_posix_callout_cond);
+    }
+    pthread_mutex_unlock(&npl_posix_callout_lock);
+
+    return BLE_NPL_OK;
+}
+
+void
+npl_posix_callout_stop(struct ble_npl_callout *co)
+{
+    pthread_mutex_lock(&npl_posix_callout_lock);
+    npl_posix_callout_unlink(co);
+    pthread_mutex_unlock(&npl_posix_callout_lock);
+
+    if (co->evq != NULL) {
+        ble_npl_eventq_remove(co->evq, &co->ev);
+    }
+}
+
+bool
+npl_posix_callout_is_active(struct ble_npl_callout *co)
+{
+    bool active;
+
+    pthread_mutex_lock(&npl_posix_callout_lock);
+    active = co->active;
+    pthread_mutex_unlock(&npl_posix_callout_lock);
+
+    return active;
+}
+
+ble_npl_time_t
+npl_posix_callout_get_ticks(struct ble_npl_callout *co)
+{
+    return co->expiry;
+}
+
+ble_npl_time_t
+npl_posix_callout_remaining_ticks(struct ble_npl_callout *co,
+                                  ble_npl_time_t now)
+{
+    ble_npl_time_t rt = 0;
+
+    pthread_mutex_lock(&npl_posix_callout_lock);
+    if (co->active && (ble_npl_stime_t)(co->expiry - now) > 0) {
+        rt = co->expiry - now;
+    }
+    pthread_mutex_unlock(&npl_posix_callout_lock);
+
+    return rt;
+}
+
+uint32_t
+npl_posix_hw_enter_critical(void)
+{
+    pthread_once(&npl_posix_init_once, npl_posix_init);
+    pthread_mutex_lock(&npl_posix_critical_lock);
+    npl_posix_critical_depth++;
+    return 0;
+}
+
+void
+npl_posix_hw_exit_critical(uint32_t ctx)
+{
+    (void)ctx;
+    npl_posix_critical_depth--;
+    pthread_mutex_unlock(&npl_posix_critical_lock);
+}
+
+bool
+npl_posix_hw_is_in_critical(void)
+{
+    return npl_posix_critical_depth > 0;
+}
+
+#endif /* NIMBLE_NPL_POSIX */
@@ -17,6 +17,7 @@
 
 /** @brief Un-comment to enable storing the timestamp when an attribute value is updated\n
  *  This allows for checking the last update time using getTimeStamp() or getValue(time_t*)\n
+ *  or, with microsecond resolution from a monotonic clock, getTimeStampUs().\n
  *  If disabled, the timestamp returned from these functions will be 0.\n
  *  Disabling timestamps will reduce the memory used for each value.\n
  *  1 = Enabled, 0 = Disabled; Default = Disabled
@@ -31,6 +32,104 @@
  */
 // #define CONFIG_NIMBLE_CPP_ATT_VALUE_INIT_LENGTH 20
 
+/** @brief Uncomment to set the size (bytes) of the buffer stored in each attribute value object.\n
+ *  Values up to this size do not use the heap, larger values are moved to a heap allocation.\n
+ *  Values constructed with an initial length larger than this are allocated on the heap immediately.\n
+ *  Default value is 20. Range: 0 : 512 (BLE_ATT_ATTR_MAX_LEN)
+ */
+// #define CONFIG_NIMBLE_CPP_ATT_VALUE_INLINE_LENGTH 20
+
+/** @brief Un-comment to set the number of advertised devices that are allocated from a static pool\n
+ *  while scanning instead of the heap. When the pool is exhausted devices are allocated from the heap.\n
+ *  Continuous scanning with setMaxResults(0) only needs a few devices to run without heap allocations.\n
+ *  Each device uses approx. 100 bytes, more if extended advertising is enabled.\n
+ *  Default value is 0 (pool disabled).
+ */
+// #define CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE 0
+
+/** @brief Un-comment to change the number of advertisement bytes stored in each device found by a scan when\n
+ *  extended advertising is enabled. Each device uses about 1.5 times this many bytes for the payload and the\n
+ *  offsets of its fields, longer advertisements are moved to the heap. Legacy devices always store 62 bytes.\n
+ *  Default value is 255.
+ */
+// #define CONFIG_NIMBLE_CPP_SCAN_PAYLOAD_INLINE_LEN 255
+
+/** @brief Un-comment to set the size (bytes) of a memory region that the server services, characteristics\n
+ *  and descriptors are allocated from instead of the heap. The region is reused once all of them are deleted.\n
+ *  When the region is full objects are allocated from the heap.\n
+ *  Default value is 0 (arena disabled).
+ */
+// #define CONFIG_NIMBLE_CPP_SERVER_ARENA_SIZE 0
+
+/** @brief Un-comment to set the size (bytes) of a memory region that the remote services, characteristics\n
+ *  and descriptors of all clients are allocated from instead of the heap during service discovery.\n
+ *  The region is reused once all of them are deleted. When the region is full objects are allocated from the heap.\n
+ *  Default value is 0 (arena disabled).
+ */
+// #define CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE 0
+
+/** @brief Un-comment to give each client its own region of CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE bytes.\n
+ *  The remote attributes of a peer are then stored together in discovery order and the region is freed\n
+ *  with the client. Requires CONFIG_NIMBLE_CPP_CLIENT_ARENA_SIZE.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_CLIENT_ARENA_PER_PEER 0
+
+/** @brief Un-comment to allocate the server and client arenas in PSRAM. ESP32 only.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_ARENA_PSRAM 0
+
+/** @brief Un-comment to allocate the advertised devices found by scans in PSRAM, the devices that do not\n
+ *  fit in the device pool when CONFIG_NIMBLE_CPP_SCAN_DEVICE_POOL_SIZE is set. ESP32 only.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_SCAN_PSRAM 0
+
+/** @brief Un-comment to allocate attribute value buffers of this size (bytes) or larger in PSRAM.\n
+ *  Shorter values stay in internal RAM. ESP32 only.\n
+ *  Default value is 0 (disabled).
+ */
+// #define CONFIG_NIMBLE_CPP_ATT_VALUE_PSRAM_LENGTH 0
+
+/** @brief Un-comment to change the default number of indications that can wait for the confirmation\n
+ *  of the previous indication to each peer, see NimBLEServer::setIndicateQueueDepth.\n
+ *  Default value is 4.
+ */
+// #define CONFIG_NIMBLE_CPP_INDICATE_QUEUE_DEPTH 4
+
+/** @brief Un-comment to store the attribute database of bonded peers in NVS so that reconnecting\n
+ *  clients can skip service discovery. The cache is validated with the peers Database Hash characteristic\n
+ *  when available and is deleted when the bond is deleted or a Service Changed indication is received.\n
+ *  ESP32 only.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_GATT_CACHE_ENABLED 0
+
+/** @brief Un-comment to record the host task stack usage of the server, client, scan and attribute callbacks\n
+ *  and of each GAP event type, NimBLEStackProfile::dump() logs them with a recommended\n
+ *  CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE. Adds a scan of the stack to each callback, use only while sizing the stack.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_HOST_STACK_PROFILE 0
+
+/** @brief Un-comment to record histograms of the connect, discovery, read and write latency of each client,\n
+ *  read them with NimBLEClient::getLatencyHistogram().\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_CLIENT_LATENCY_HISTOGRAM 0
+
+/** @brief Un-comment to keep throughput and error counters for each connection, read them with NimBLEConnInfo::getStats().\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_CONN_STATS 0
+
+/** @brief Un-comment to track the time spent and the estimated radio use of each role, read them with
+ *  NimBLEDevice::getRadioActivity().\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_NIMBLE_CPP_RADIO_ACTIVITY 0
+
 
 /****************************************************
  *         Extended advertising settings            *
@@ -52,6 +151,9 @@
 /** @brief Un-comment to change the maximum number of periodically synced devices */
 // #define CONFIG_BT_NIMBLE_MAX_PERIODIC_SYNCS 1
 
+/** @brief Un-comment to enable periodic advertising sync transfer over connections (PAST) */
+// #define CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER 1
+
 /****************************************************
  * END For use with ESP32C3, ESP32S3, ESP32H2 ONLY! *
  ***************************************************/
@@ -119,9 +221,124 @@
 /** @brief Un-comment to change the maximum number of CCCD subscriptions to store */
 // #define CONFIG_BT_NIMBLE_MAX_CCCDS 8
 
+/** @brief Un-comment to change the number of HCI commands of the startup, whitelist and extended advertising data\n
+ *  sequences sent before waiting for their Command Complete, limited by the credits the controller reports.\n
+ *  1 sends each command and waits for it. Default = 4
+ */
+// #define CONFIG_BT_NIMBLE_HCI_CMD_PIPELINE 4
+
+/** @brief Un-comment to save CCCD changes to NVS this long (in milliseconds) after the first change instead\n
+ *  of writing and committing each one. All changes made in that time are written with a single commit.\n
+ *  Unsaved changes are lost on a reset, call NimBLEDevice::flushBonds to save them now. ESP32 only.\n
+ *  Default = 0 (each change is committed immediately)
+ */
+// #define CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS 2000
+
+/** @brief Un-comment to also delay saving bond keys when CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS is set.\n
+ *  A reset before the keys are saved loses the bond and the peer has to pair again.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_NVS_DEFER_SEC 0
+
+/** @brief Un-comment to read the bonds and CCCDs from NVS on the first access to the bond store instead of in init.\n
+ *  Startup time then does not depend on the number of bonds, the first connection or bond query reads them.\n
+ *  ESP32 only.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_NVS_LAZY_LOAD 0
+
+/** @brief Un-comment to record GAP events, GATT accesses, ATT PDUs and mbuf allocation failures in a binary\n
+ *  trace ring of this many 16 byte entries, read it with NimBLETrace::getEntries() or log it with NimBLETrace::dump().\n
+ *  0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_TRACE_SIZE 0
+
+/** @brief Un-comment to capture the HCI commands, events and ACL data between the host and controller in a RAM\n
+ *  ring of this many bytes, export it as a btsnoop file with ble_monitor_ram_export().\n
+ *  0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_MONITOR_RAM_SIZE 0
+
+/** @brief Un-comment to add ble_monitor_replay(), which feeds the events of a btsnoop capture back into the host\n
+ *  and measures the host time spent on each.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_MONITOR_REPLAY 0
+
+/** @brief Un-comment to send the HCI traffic and host logs in the btmon format over a UART, without blocking the host.\n
+ *  The packets go through a ring of CONFIG_BT_NIMBLE_MONITOR_UART_BUFFER_SIZE bytes (default 4096), those that do not\n
+ *  fit are dropped and counted.\n
+ *  ESP32 only.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_MONITOR_UART 1
+
+/** @brief Un-comment to change the UART port and TX pin of the monitor.\n
+ *  Default port = 1, Default pin = -1 (the default pin of the port)
+ */
+// #define CONFIG_BT_NIMBLE_MONITOR_UART_PORT 1
+// #define CONFIG_BT_NIMBLE_MONITOR_UART_TX_PIN -1
+
+/** @brief Un-comment to change the baud rate of the monitor UART. Default = 1000000 */
+// #define CONFIG_BT_NIMBLE_MONITOR_UART_BAUDRATE 1000000
+
+/** @brief Un-comment to send the HCI traffic and host logs in the btmon format over SEGGER RTT, packets that do not\n
+ *  fit the RTT buffer of CONFIG_BT_NIMBLE_MONITOR_RTT_BUFFER_SIZE bytes (default 256) are dropped and counted.\n
+ *  nRF52 only, requires SEGGER_RTT.h from the core.\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_MONITOR_RTT 1
+
+/** @brief Un-comment to adapt the number of ACL buffers the controller may fill to the free msys blocks and to the time\n
+ *  the host takes to process the received data, the statistics are read with NimBLEDevice::getFlowCtrlStats().\n
+ *  1 = Enabled, 0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE 1
+
+/** @brief Un-comment to change the adaptive flow control limits: the smallest window, the free msys blocks and\n
+ *  the average processing time in ms below which the window grows again. Defaults = 4, 4 and 50
+ */
+// #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MIN_BUFS 4
+// #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_MSYS_RESERVE 4
+// #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ADAPTIVE_LATENCY_MS 50
+
+/** @brief Un-comment to process the received data in arrival order instead of taking one packet of each connection\n
+ *  in turn, the work of each connection is read with NimBLEConnStats when CONFIG_NIMBLE_CPP_CONN_STATS is enabled.\n
+ *  1 = Round robin, 0 = Arrival order; Default = Round robin
+ */
+// #define CONFIG_BT_NIMBLE_HS_RX_ROUND_ROBIN 0
+
+/** @brief Un-comment to change the maximum number of characteristics written by NimBLEClient::writeReliable,\n
+ *  each one adds 8 bytes to every GATT procedure of the host. Default = 4
+ */
+// #define CONFIG_BT_NIMBLE_GATT_WRITE_MAX_ATTRS 4
+
+/** @brief Un-comment to add the GATT Client Supported Features characteristic to the GATT service so that
+ *  NimBLEServer::notifyMultiple can send Multiple Handle Value Notifications to the peers that enable them.\n
+ *  This changes the handles of the attributes after the GATT service.\n
+ *  0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_GATT_NOTIFY_MULTIPLE 1
+
+/** @brief Un-comment to add the Database Hash and Client Supported Features characteristics to the GATT service
+ *  so that the peers that enable robust caching can keep the attributes and check the hash when they reconnect.
+
+ *  Requests from those peers get a Database Out Of Sync error after the database changes until they are aware
+ *  of the change. Requires security manager secure connections.
+
+ *  0 = Disabled; Default = Disabled
+ */
+// #define CONFIG_BT_NIMBLE_GATT_ROBUST_CACHING 1
+
 /** @brief Un-comment to change the random address refresh time (in seconds) */
 // #define CONFIG_BT_NIMBLE_RPA_TIMEOUT 900
 
+/** @brief Un-comment to change the number of resolved peer random addresses remembered by host based privacy.\n
+ *  Lets NimBLEAdvertisedDevice::getIdentityAddress resolve repeated reports without the AES operations.\n
+ *  0 = Disabled; Default = 8
+ */
+// #define CONFIG_BT_NIMBLE_RPA_CACHE_SIZE 8
+
 /**
  * @brief Un-comment to change the number of MSYS buffers available.
  * @details MSYS is a system level mbuf registry. For prepare write & prepare \n
@@ -130,6 +347,85 @@
  */
 // #define CONFIG_BT_NIMBLE_MSYS1_BLOCK_COUNT 12
 
+/**
+ * @brief Un-comment to add more MSYS pools with different block sizes.
+ * @details Up to 4 pools can be configured, each allocation is taken from the pool with the \n
+ * smallest blocks that fit the requested size. The block size includes the mbuf header. \n
+ * Enable CONFIG_BT_NIMBLE_MSYS_CALIBRATE and call os_msys_calibrate() to get recommended values.
+ */
+// #define CONFIG_BT_NIMBLE_MSYS1_BLOCK_SIZE 292
+// #define CONFIG_BT_NIMBLE_MSYS2_BLOCK_COUNT 0
+// #define CONFIG_BT_NIMBLE_MSYS2_BLOCK_SIZE 0
+// #define CONFIG_BT_NIMBLE_MSYS3_BLOCK_COUNT 0
+// #define CONFIG_BT_NIMBLE_MSYS3_BLOCK_SIZE 0
+// #define CONFIG_BT_NIMBLE_MSYS4_BLOCK_COUNT 0
+// #define CONFIG_BT_NIMBLE_MSYS4_BLOCK_SIZE 0
+
+/** @brief Un-comment to record the size of MSYS packets so os_msys_calibrate() can recommend pool sizes */
+// #define CONFIG_BT_NIMBLE_MSYS_CALIBRATE 1
+
+/** @brief Un-comment to take and give back memory pool blocks with a compare and swap instead of a critical section.\n
+ *  Needs a hardware compare and swap, ESP32 and ESP32-S3 or an ARM Cortex-M3 or higher.
+ */
+// #define CONFIG_BT_NIMBLE_MEMPOOL_LOCK_FREE 1
+
+/** @brief Un-comment to run all NimBLE callouts from one FreeRTOS timer instead of one timer each.\n
+ *  Not applied with CONFIG_NIMBLE_STACK_USE_MEM_POOLS or CONFIG_BT_NIMBLE_USE_ESP_TIMER, they keep their own callout timers.
+ */
+// #define CONFIG_BT_NIMBLE_SHARED_CALLOUT_TIMER 1
+
+/** @brief Un-comment to change the number of events the host task takes from its queue per wakeup */
+// #define CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE 8
+
+/** @brief Un-comment to use mbedTLS instead of tinycrypt for the security manager crypto (ESP32 only).\n
+ *  mbedTLS uses the AES and MPI hardware of the ESP32, making secure connections key generation\n
+ *  and DHKey computation much faster. Build with CONFIG_BT_NIMBLE_LOG_LEVEL 0 to log the time taken.
+ */
+// #define CONFIG_BT_NIMBLE_CRYPTO_STACK_MBEDTLS 1
+
+/** @brief Un-comment to generate the secure connections key pair and compute DHKeys in a separate task.\n
+ *  The key pair is generated when the host starts instead of at the first pairing and the host task\n
+ *  keeps handling other connections while a DHKey is computed.
+ */
+// #define CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK 1
+
+/** @brief Un-comment to change the stack size (bytes) of the secure connections crypto task */
+// #define CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK_STACK_SIZE 4096
+
+/** @brief Un-comment to replace the secure connections key pair periodically (in milliseconds).\n
+ *  Requires CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK, the new key pair is used once no pairing is in progress.\n
+ *  Out of band data generated before a rotation is no longer valid.
+ */
+// #define CONFIG_BT_NIMBLE_SM_SC_KEY_ROTATE_MS 3600000
+
+/** @brief Un-comment to change the number of pairings the security manager runs at the same time.\n
+ *  Each one uses about 200 bytes, and a DHKey job when CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK is set.
+ */
+// #define CONFIG_BT_NIMBLE_SM_MAX_PROCS 1
+
+/** @brief Un-comment to queue this many pairings that find CONFIG_BT_NIMBLE_SM_MAX_PROCS pairings running.\n
+ *  They are started in arrival order as the running pairings finish instead of failing.
+ */
+// #define CONFIG_BT_NIMBLE_SM_PAIR_QUEUE_SIZE 4
+
+/** @brief Un-comment to set the number of L2CAP connection oriented channels, enables NimBLEL2CAPServer and NimBLEL2CAPChannel */
+// #define CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM 1
+
+/** @brief Un-comment to set the number of L2CAP receive buffers shared by all channels instead of using the msys pools.\n
+ *  Each buffer holds one LE frame, approx. CONFIG_BT_NIMBLE_MSYS1_BLOCK_SIZE bytes, an SDU needs MTU / frame size buffers.\n
+ *  Default value is 0 (use msys).
+ */
+// #define CONFIG_NIMBLE_CPP_L2CAP_RX_BUF_COUNT 0
+
+/** @brief Un-comment to enable the BLE mesh stack and the NimBLEMesh classes */
+// #define CONFIG_BT_NIMBLE_MESH
+
+/** @brief Un-comment to set the number of buffers preallocated for sending mesh model messages.\n
+ *  Each buffer holds the largest message a model can send, if 0 the buffers are taken from msys.\n
+ *  Default value is 4.
+ */
+// #define CONFIG_NIMBLE_CPP_MESH_MSG_BUF_COUNT 4
+
 /** @brief Un-comment to use external PSRAM for the NimBLE host */
 // #define CONFIG_BT_NIMBLE_MEM_ALLOC_MODE_EXTERNAL 1
 
@@ -174,6 +470,10 @@
 #define CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE 4096
 #endif
 
+#ifndef CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE
+#define CONFIG_BT_NIMBLE_HOST_EVENT_BATCH_SIZE 8
+#endif
+
 #ifndef CONFIG_BT_NIMBLE_MEM_ALLOC_MODE_EXTERNAL
 #define CONFIG_BT_NIMBLE_MEM_ALLOC_MODE_INTERNAL 1
 #endif
@@ -190,6 +490,14 @@
 #define CONFIG_BT_NIMBLE_MAX_CCCDS 8
 #endif
 
+#ifndef CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS
+#define CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_NVS_DEFER_SEC
+#define CONFIG_BT_NIMBLE_NVS_DEFER_SEC 0
+#endif
+
 #ifndef CONFIG_BT_NIMBLE_SVC_GAP_DEVICE_NAME
 #define CONFIG_BT_NIMBLE_SVC_GAP_DEVICE_NAME "nimble"
 #endif
@@ -206,10 +514,46 @@
 #define CONFIG_BT_NIMBLE_MSYS1_BLOCK_COUNT 12
 #endif
 
+#ifndef CONFIG_BT_NIMBLE_MSYS1_BLOCK_SIZE
+#define CONFIG_BT_NIMBLE_MSYS1_BLOCK_SIZE 292
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS2_BLOCK_COUNT
+#define CONFIG_BT_NIMBLE_MSYS2_BLOCK_COUNT 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS2_BLOCK_SIZE
+#define CONFIG_BT_NIMBLE_MSYS2_BLOCK_SIZE 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS3_BLOCK_COUNT
+#define CONFIG_BT_NIMBLE_MSYS3_BLOCK_COUNT 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS3_BLOCK_SIZE
+#define CONFIG_BT_NIMBLE_MSYS3_BLOCK_SIZE 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS4_BLOCK_COUNT
+#define CONFIG_BT_NIMBLE_MSYS4_BLOCK_COUNT 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS4_BLOCK_SIZE
+#define CONFIG_BT_NIMBLE_MSYS4_BLOCK_SIZE 0
+#endif
+
+#ifndef CONFIG_BT_NIMBLE_MSYS_CALIBRATE
+#define CONFIG_BT_NIMBLE_MSYS_CALIBRATE 0
+#endif
+
 #ifndef CONFIG_BT_NIMBLE_RPA_TIMEOUT
 #define CONFIG_BT_NIMBLE_RPA_TIMEOUT 900
 #endif
 
+#ifndef CONFIG_BT_NIMBLE_RPA_CACHE_SIZE
+#define CONFIG_BT_NIMBLE_RPA_CACHE_SIZE 8
+#endif
+
 #ifndef CONFIG_BT_NIMBLE_LOG_LEVEL
 #define CONFIG_BT_NIMBLE_LOG_LEVEL 5
 #endif
@@ -250,7 +594,21 @@
 #define CONFIG_BT_NIMBLE_HCI_EVT_LO_BUF_COUNT 8
 
 /** @brief Maximum number of connection oriented channels */
+#ifndef CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM
 #define CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM 0
+#endif
+
+#ifdef CONFIG_BT_NIMBLE_MESH
+/** @brief Name of the device advertised by the mesh proxy service */
+#ifndef CONFIG_BT_NIMBLE_MESH_DEVICE_NAME
+#define CONFIG_BT_NIMBLE_MESH_DEVICE_NAME "nimble-mesh-node"
+#endif
+
+/** @brief Number of nodes stored by a provisioner */
+#ifndef CONFIG_BT_NIMBLE_MESH_NODE_COUNT
+#define CONFIG_BT_NIMBLE_MESH_NODE_COUNT 1
+#endif
+#endif
 
 #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL 1
 #define CONFIG_BT_NIMBLE_HS_FLOW_CTRL_ITVL 1000
@@ -299,6 +657,22 @@
 #  error Extended advertising must be enabled to use periodic advertising.
 #endif
 
+#if CONFIG_BT_NIMBLE_SM_SC_KEY_ROTATE_MS && !CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK
+#  error Secure connections key rotation requires CONFIG_BT_NIMBLE_SM_SC_CRYPTO_TASK.
+#endif
+
+#if CONFIG_BT_NIMBLE_NVS_DEFER_SEC && !CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS
+#  error CONFIG_BT_NIMBLE_NVS_DEFER_SEC requires CONFIG_BT_NIMBLE_NVS_COMMIT_DELAY_MS.
+#endif
+
+#if CONFIG_BT_NIMBLE_CRYPTO_STACK_MBEDTLS && !defined(ESP_PLATFORM)
+#  error mbedTLS crypto is only available on ESP32.
+#endif
+
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_SYNC_TRANSFER && !CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+#  error Periodic advertising must be enabled to use periodic advertising sync transfer.
+#endif
+
 /* Must have max instances and data length set if extended advertising is enabled */
 #if CONFIG_BT_NIMBLE_EXT_ADV
 #  if !defined(CONFIG_BT_NIMBLE_MAX_EXT_ADV_INSTANCES)